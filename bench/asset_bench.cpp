@@ -0,0 +1,164 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <SDL3/SDL_iostream.h>
+
+#include <io/asset_loader.h>
+#include <io/mesh.h>
+
+#include "bench.h"
+
+// quads per side
+const uint32_t TANGENT_GRID_SIZES[] = { 100, 1000 };
+const uint32_t GLTF_GRID_SIZE = 256;
+
+typedef struct {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+} Grid;
+
+// rolling height field, no two triangles share a tangent
+static Grid _createGrid(uint32_t size) {
+	Grid grid;
+	grid.vertices.reserve((size + 1) * (size + 1));
+	grid.indices.reserve(size * size * 6);
+
+	for (uint32_t z = 0; z <= size; z++) {
+		for (uint32_t x = 0; x <= size; x++) {
+			Vertex vertex = {};
+			vertex.position = glm::vec3(x, glm::sin(x * 0.3f) * glm::cos(z * 0.2f), z);
+			vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+			vertex.uv = glm::vec2(x, z) / static_cast<float>(size);
+
+			grid.vertices.push_back(vertex);
+		}
+	}
+
+	for (uint32_t z = 0; z < size; z++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint32_t i = z * (size + 1) + x;
+
+			grid.indices.insert(grid.indices.end(),
+					{ i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+		}
+	}
+
+	return grid;
+}
+
+static bool _writeFile(const std::filesystem::path &path, const void *pData, size_t size) {
+	SDL_IOStream *pStream = SDL_IOFromFile(path.c_str(), "wb");
+
+	if (pStream == nullptr)
+		return false;
+
+	bool isWritten = SDL_WriteIO(pStream, pData, size) == size;
+	return SDL_CloseIO(pStream) && isWritten;
+}
+
+// positions, normals, uvs and indices in one external buffer, tangents are left to loader
+static bool _writeGltf(const std::filesystem::path &path, const Grid &grid, uint32_t size) {
+	std::vector<uint8_t> buffer;
+
+	auto append = [&](const void *pData, size_t byteSize) {
+		size_t offset = buffer.size();
+		const uint8_t *pBytes = static_cast<const uint8_t *>(pData);
+		buffer.insert(buffer.end(), pBytes, pBytes + byteSize);
+
+		return offset;
+	};
+
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> uvs;
+
+	for (const Vertex &vertex : grid.vertices) {
+		positions.push_back(vertex.position);
+		normals.push_back(vertex.normal);
+		uvs.push_back(vertex.uv);
+	}
+
+	size_t vertexCount = grid.vertices.size();
+	size_t positionOffset = append(positions.data(), positions.size() * sizeof(glm::vec3));
+	size_t normalOffset = append(normals.data(), normals.size() * sizeof(glm::vec3));
+	size_t uvOffset = append(uvs.data(), uvs.size() * sizeof(glm::vec2));
+	size_t indexOffset = append(grid.indices.data(), grid.indices.size() * sizeof(uint32_t));
+
+	std::filesystem::path bufferPath = path;
+	bufferPath.replace_extension(".bin");
+
+	if (!_writeFile(bufferPath, buffer.data(), buffer.size()))
+		return false;
+
+	char json[2048];
+	int jsonSize = snprintf(json, sizeof(json),
+			"{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+			"\"nodes\":[{\"mesh\":0}],\"meshes\":[{\"primitives\":[{\"attributes\":"
+			"{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+			"\"buffers\":[{\"uri\":\"%s\",\"byteLength\":%zu}],\"bufferViews\":["
+			"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},"
+			"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},"
+			"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},"
+			"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],\"accessors\":["
+			"{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\","
+			"\"min\":[0,-1,0],\"max\":[%u,1,%u]},"
+			"{\"bufferView\":1,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+			"{\"bufferView\":2,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+			"{\"bufferView\":3,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+			bufferPath.filename().c_str(), buffer.size(), positionOffset,
+			normalOffset - positionOffset, normalOffset, uvOffset - normalOffset, uvOffset,
+			indexOffset - uvOffset, indexOffset, buffer.size() - indexOffset, vertexCount, size,
+			size, vertexCount, vertexCount, grid.indices.size());
+
+	return _writeFile(path, json, jsonSize);
+}
+
+void assetBenchRun(Bench &bench) {
+	for (uint32_t size : TANGENT_GRID_SIZES) {
+		char name[96];
+		snprintf(name, sizeof(name), "generateTangents grid %ux%u", size, size);
+
+		if (!bench.isSelected(name))
+			continue;
+
+		Grid grid = _createGrid(size);
+
+		VertexArray vertices = { grid.vertices.data(),
+			static_cast<uint32_t>(grid.vertices.size()) };
+		IndexArray indices = { grid.indices.data(), static_cast<uint32_t>(grid.indices.size()) };
+
+		bench.run(name, indices.count / 3, [&]() {
+			AssetLoader::generateTangents(indices, vertices);
+			benchKeep(vertices.pData[0].tangent);
+		});
+	}
+
+	char name[96];
+	snprintf(name, sizeof(name), "loadGltf grid %ux%u", GLTF_GRID_SIZE, GLTF_GRID_SIZE);
+
+	if (!bench.isSelected(name))
+		return;
+
+	// primitive goes through whole mesh loading, welding, tangents, optimization and lods
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "hayaku_bench.gltf";
+	Grid grid = _createGrid(GLTF_GRID_SIZE);
+
+	if (!_writeGltf(path, grid, GLTF_GRID_SIZE)) {
+		fprintf(stderr, "%s can not be written\n", path.c_str());
+		return;
+	}
+
+	// arena of scene releases its meshes on return
+	bench.run(name, grid.indices.size() / 3, [&]() {
+		AssetLoader::Scene scene = AssetLoader::loadGltf(path);
+		benchKeep(scene);
+	});
+
+	std::filesystem::remove(path);
+	std::filesystem::remove(std::filesystem::path(path).replace_extension(".bin"));
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include <job_system.h>
+#include <profiler.h>
+
+#include "bench.h"
+
+static double _toSeconds(uint64_t ticks) {
+	return ticks / static_cast<double>(SDL_GetPerformanceFrequency());
+}
+
+static void _printTime(char *pBuffer, size_t size, double seconds) {
+	if (seconds < 0.000001)
+		snprintf(pBuffer, size, "%.1f ns", seconds * 1000000000.0);
+	else if (seconds < 0.001)
+		snprintf(pBuffer, size, "%.2f us", seconds * 1000000.0);
+	else if (seconds < 1.0)
+		snprintf(pBuffer, size, "%.2f ms", seconds * 1000.0);
+	else
+		snprintf(pBuffer, size, "%.2f s", seconds);
+}
+
+void Bench::run(const char *name, uint64_t itemCount, const std::function<void()> &body) {
+	run(name, itemCount, nullptr, body);
+}
+
+void Bench::run(const char *name, uint64_t itemCount, const std::function<void()> &setup,
+		const std::function<void()> &body) {
+	if (!isSelected(name))
+		return;
+
+	// batch of count calls, setup excluded
+	auto batch = [&](uint64_t count) {
+		uint64_t ticks = 0;
+
+		for (uint64_t i = 0; i < count; i++) {
+			if (setup)
+				setup();
+
+			uint64_t begin = SDL_GetPerformanceCounter();
+			body();
+			ticks += SDL_GetPerformanceCounter() - begin;
+		}
+
+		return _toSeconds(ticks);
+	};
+
+	// caches and lazily built tables are warm before timing
+	batch(1);
+
+	uint64_t count = 1;
+
+	while (batch(count) < BENCH_MIN_BATCH_SECONDS && count < (1ull << 30))
+		count *= 2;
+
+	std::vector<double> samples;
+
+	for (uint32_t i = 0; i < BENCH_SAMPLE_COUNT; i++) {
+		samples.push_back(batch(count) / count);
+		_samples.add(name, static_cast<float>(samples.back() * 1000000000.0));
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	double median = samples[samples.size() / 2];
+
+	char minText[32], medianText[32];
+	_printTime(minText, sizeof(minText), samples.front());
+	_printTime(medianText, sizeof(medianText), median);
+
+	double itemsPerSecond = median > 0.0 ? itemCount / median : 0.0;
+
+	printf("%-56s %12s %12s %10.2f M/s\n", name, minText, medianText,
+			itemsPerSecond / 1000000.0);
+	fflush(stdout);
+}
+
+bool Bench::isSelected(const char *name) const {
+	return _filter.empty() || strstr(name, _filter.c_str()) != nullptr;
+}
+
+const BenchmarkSamples &Bench::getSamples() const {
+	return _samples;
+}
+
+Bench::Bench(const char *filter) : _filter(filter) {}
+
+static bool _writeSamples(const BenchmarkSamples &samples, const char *pFile) {
+	SDL_IOStream *pStream = SDL_IOFromFile(pFile, "w");
+
+	if (pStream == nullptr) {
+		fprintf(stderr, "Bench result %s can not be written!\n", pFile);
+		return false;
+	}
+
+	SDL_IOprintf(pStream, "{\n");
+	samples.write(pStream);
+	SDL_IOprintf(pStream, "\n}\n");
+
+	return SDL_CloseIO(pStream);
+}
+
+// prints benches that changed, false once any got slower
+static bool _compareSamples(
+		const BenchmarkSamples &samples, const BenchmarkSamples &baseline, float threshold) {
+	std::vector<BenchmarkComparison> comparisons = samples.compare(baseline, threshold);
+	uint32_t slowerCount = 0;
+
+	printf("\n%-56s %12s %12s %10s\n", "against baseline", "baseline", "median", "change");
+
+	for (const BenchmarkComparison &comparison : comparisons) {
+		if (comparison.verdict == BenchmarkVerdict::Slower)
+			slowerCount++;
+
+		printf("%-56s %9.1f ns %9.1f ns %+9.1f%% %s\n", comparison.name.c_str(),
+				comparison.baselineMedian, comparison.median, comparison.change * 100.0f,
+				comparison.verdict != BenchmarkVerdict::Unchanged
+						? BenchmarkSamples::getVerdictName(comparison.verdict)
+						: "");
+	}
+
+	printf("%s\n", slowerCount > 0 ? "slower" : "no regressions");
+	return slowerCount == 0;
+}
+
+// hayaku_bench [filter] [--image <file>]... [--output <file>] [--baseline <file>]
+// [--regression-threshold <percent>]
+int main(int argc, char **argv) {
+	const char *filter = "";
+	std::vector<const char *> images;
+
+	const char *pOutput = nullptr;
+	const char *pBaseline = nullptr;
+	float threshold = BENCHMARK_DEFAULT_THRESHOLD;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp("--image", argv[i]) == 0 && i < argc - 1)
+			images.push_back(argv[++i]);
+		else if (strcmp("--output", argv[i]) == 0 && i < argc - 1)
+			pOutput = argv[++i];
+		else if (strcmp("--baseline", argv[i]) == 0 && i < argc - 1)
+			pBaseline = argv[++i];
+		else if (strcmp("--regression-threshold", argv[i]) == 0 && i < argc - 1)
+			threshold = static_cast<float>(atof(argv[++i])) / 100.0f;
+		else
+			filter = argv[i];
+	}
+
+	// read before anything runs, missing baseline should not cost a whole run
+	BenchmarkSamples baseline;
+
+	if (pBaseline != nullptr && (!baseline.load(pBaseline) || baseline.isEmpty())) {
+		fprintf(stderr, "Bench baseline %s has no samples!\n", pBaseline);
+		return 1;
+	}
+
+	// loaders log every image, zones would only fill buffers nobody drains
+	SDL_LogSetAllPriority(SDL_LOG_PRIORITY_WARN);
+	Profiler::setEnabled(false);
+
+	// loaders decode on it as they do in the app
+	JobSystem::initialize();
+
+	printf("%-56s %12s %12s %14s\n", "benchmark", "min", "median", "items/s");
+
+	Bench bench(filter);
+
+	imageBenchRun(bench, images);
+	assetBenchRun(bench);
+	renderBenchRun(bench);
+
+	JobSystem::shutdown();
+
+	if (pOutput != nullptr && !_writeSamples(bench.getSamples(), pOutput))
+		return 1;
+
+	if (pBaseline != nullptr && !_compareSamples(bench.getSamples(), baseline, threshold))
+		return 1;
+
+	return 0;
+}
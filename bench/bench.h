@@ -0,0 +1,51 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <benchmark_samples.h>
+
+// batch of iterations is grown until it takes this long, timings are taken over whole batches
+const double BENCH_MIN_BATCH_SECONDS = 0.01;
+const uint32_t BENCH_SAMPLE_COUNT = 7;
+
+// Times a body in isolation on CPU. Every body runs once untimed, then in batches long enough
+// for counter resolution not to matter, minimum and median of batches are reported per call.
+// Batches are kept as samples in nanoseconds per call, like app benchmark keeps frame times.
+class Bench {
+private:
+	std::string _filter;
+	BenchmarkSamples _samples;
+
+public:
+	// items are what one call processes, texels or triangles, give throughput
+	void run(const char *name, uint64_t itemCount, const std::function<void()> &body);
+	// setup runs untimed before every call, for bodies consuming their input
+	void run(const char *name, uint64_t itemCount, const std::function<void()> &setup,
+			const std::function<void()> &body);
+
+	bool isSelected(const char *name) const;
+	const BenchmarkSamples &getSamples() const;
+
+	// substring of names to run, empty runs all
+	Bench(const char *filter);
+};
+
+// keeps result of body from being optimized away
+template <typename T> inline void benchKeep(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r"(&value) : "memory");
+#else
+	static volatile const void *pSink;
+	pSink = &value;
+#endif
+}
+
+void imageBenchRun(Bench &bench, const std::vector<const char *> &images);
+void assetBenchRun(Bench &bench);
+void renderBenchRun(Bench &bench);
+
+#endif // !BENCH_H
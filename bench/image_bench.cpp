@@ -0,0 +1,187 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include <io/image.h>
+#include <io/image_loader.h>
+
+#include "bench.h"
+
+const uint32_t IMAGE_SIZES[] = { 256, 1024, 4096 };
+
+// deterministic noise, runs are comparable and nothing in it is cheap to decode
+static uint32_t _random(uint32_t &state) {
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static Image _createImage(Image::Format format, uint32_t size) {
+	std::vector<uint8_t> data(Image::getLevelSize(format, size, size));
+	uint32_t state = size;
+
+	// floats made of noise would be NaN and infinite often, those take no usual path
+	if (format == Image::Format::RGBA32F) {
+		float *pTexels = reinterpret_cast<float *>(data.data());
+
+		for (size_t i = 0; i < data.size() / sizeof(float); i++)
+			pTexels[i] = (_random(state) & 0xFFFF) / 4096.0f;
+	} else {
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = static_cast<uint8_t>(_random(state));
+	}
+
+	return Image(size, size, format, std::move(data));
+}
+
+// uncompressed 32 bit, top left origin
+static std::vector<uint8_t> _createTga(uint32_t size) {
+	std::vector<uint8_t> file(18 + size * size * 4);
+
+	file[2] = 2;
+	file[12] = size & 0xFF;
+	file[13] = size >> 8;
+	file[14] = size & 0xFF;
+	file[15] = size >> 8;
+	file[16] = 32;
+	file[17] = 0x28;
+
+	uint32_t state = size;
+
+	for (size_t i = 18; i < file.size(); i++)
+		file[i] = static_cast<uint8_t>(_random(state));
+
+	return file;
+}
+
+// flat RGBE scanlines, first texel is not an RLE marker
+static std::vector<uint8_t> _createHdr(uint32_t size) {
+	char header[128];
+	int headerSize = snprintf(header, sizeof(header),
+			"#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %u +X %u\n", size, size);
+
+	std::vector<uint8_t> file(headerSize + size * size * 4);
+	memcpy(file.data(), header, headerSize);
+
+	uint32_t state = size;
+
+	for (size_t i = headerSize; i < file.size(); i += 4) {
+		file[i + 0] = static_cast<uint8_t>(_random(state));
+		file[i + 1] = static_cast<uint8_t>(_random(state));
+		file[i + 2] = static_cast<uint8_t>(_random(state));
+		file[i + 3] = static_cast<uint8_t>(120 + _random(state) % 16);
+	}
+
+	file[headerSize] = 128;
+
+	return file;
+}
+
+static void _convertRun(Bench &bench, Image::Format src, Image::Format dst, uint32_t size) {
+	char name[96];
+	snprintf(name, sizeof(name), "image convert %s to %s %ux%u", Image::getFormatName(src),
+			Image::getFormatName(dst), size, size);
+
+	if (!bench.isSelected(name))
+		return;
+
+	Image source = _createImage(src, size);
+	std::unique_ptr<Image> image;
+
+	bench.run(
+			name, static_cast<uint64_t>(size) * size,
+			[&]() { image = std::make_unique<Image>(source); },
+			[&]() {
+				image->convert(dst);
+				benchKeep(image->getData().data());
+			});
+}
+
+static void _decodeRun(Bench &bench, const char *name, const std::vector<uint8_t> &file) {
+	bench.run(name, 1, [&]() {
+		std::shared_ptr<Image> image = ImageLoader::loadFromMemory(file.data(), file.size());
+		benchKeep(image);
+	});
+}
+
+void imageBenchRun(Bench &bench, const std::vector<const char *> &images) {
+	const Image::Format RGBA8 = Image::Format::RGBA8;
+	const Image::Format RGB8 = Image::Format::RGB8;
+	const Image::Format R8 = Image::Format::R8;
+	const Image::Format RGBA16F = Image::Format::RGBA16F;
+	const Image::Format RGBA32F = Image::Format::RGBA32F;
+
+	for (uint32_t size : IMAGE_SIZES) {
+		_convertRun(bench, RGB8, RGBA8, size);
+		_convertRun(bench, RGBA8, RGB8, size);
+		_convertRun(bench, RGBA8, R8, size);
+		_convertRun(bench, RGBA32F, RGBA16F, size);
+		// per texel fallback
+		_convertRun(bench, RGBA8, RGBA16F, size);
+	}
+
+	for (uint32_t size : IMAGE_SIZES) {
+		char name[96];
+		snprintf(name, sizeof(name), "image getComponent %ux%u", size, size);
+
+		if (bench.isSelected(name)) {
+			Image image = _createImage(RGBA8, size);
+
+			bench.run(name, static_cast<uint64_t>(size) * size, [&]() {
+				std::unique_ptr<Image> component(image.getComponent(Image::Channel::G));
+				benchKeep(component);
+			});
+		}
+
+		snprintf(name, sizeof(name), "image getComponents %ux%u", size, size);
+
+		if (bench.isSelected(name)) {
+			Image image = _createImage(RGBA8, size);
+
+			bench.run(name, static_cast<uint64_t>(size) * size, [&]() {
+				std::unique_ptr<Image> components(
+						image.getComponents(Image::Channel::G, Image::Channel::B));
+				benchKeep(components);
+			});
+		}
+	}
+
+	for (uint32_t size : { 1024u, 2048u }) {
+		char name[96];
+		snprintf(name, sizeof(name), "image decode tga %ux%u", size, size);
+
+		if (bench.isSelected(name))
+			_decodeRun(bench, name, _createTga(size));
+
+		snprintf(name, sizeof(name), "image decode hdr %ux%u", size, size);
+
+		if (bench.isSelected(name))
+			_decodeRun(bench, name, _createHdr(size));
+	}
+
+	// PNG, JPEG, EXR and KTX2 have no encoder here, real files cover them
+	for (const char *pFile : images) {
+		char name[256];
+		snprintf(name, sizeof(name), "image decode %s", pFile);
+
+		if (!bench.isSelected(name))
+			continue;
+
+		size_t size;
+		uint8_t *pData = static_cast<uint8_t *>(SDL_LoadFile(pFile, &size));
+
+		if (pData == nullptr) {
+			fprintf(stderr, "%s can not be read\n", pFile);
+			continue;
+		}
+
+		std::vector<uint8_t> file(pData, pData + size);
+		SDL_free(pData);
+
+		_decodeRun(bench, name, file);
+	}
+}
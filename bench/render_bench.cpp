@@ -0,0 +1,227 @@
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/object_owner.h>
+#include <rendering/render_queue.h>
+#include <rendering/types/resource.h>
+
+#include "bench.h"
+
+const uint32_t OWNER_OBJECT_COUNTS[] = { 1000, 100000 };
+const uint32_t QUEUE_INSTANCE_COUNTS[] = { 1000, 10000, 50000 };
+
+// like real scenes, many instances share few meshes and materials
+const uint32_t QUEUE_MESH_COUNT = 256;
+const uint32_t QUEUE_MATERIAL_COUNT = 64;
+const uint32_t QUEUE_PRIMITIVE_COUNT = 2;
+
+// same as instance buffers of renderer
+const uint32_t QUEUE_MAX_TRANSFORMS = 65536;
+
+static uint32_t _random(uint32_t &state) {
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static void _ownerRun(Bench &bench, uint32_t count) {
+	char name[96];
+
+	std::vector<MeshInstanceRD> values(count);
+	uint32_t state = count;
+
+	for (MeshInstanceRD &value : values)
+		value.mesh = _random(state);
+
+	snprintf(name, sizeof(name), "ObjectOwner insert %u", count);
+
+	std::unique_ptr<ObjectOwner<MeshInstanceRD>> pOwner;
+
+	bench.run(
+			name, count, [&]() { pOwner = std::make_unique<ObjectOwner<MeshInstanceRD>>(); },
+			[&]() {
+				for (const MeshInstanceRD &value : values)
+					benchKeep(pOwner->insert(value));
+			});
+
+	// ids looked up in shuffled order, as scene updates touch them
+	ObjectOwner<MeshInstanceRD> owner;
+	std::vector<ObjectID> ids;
+
+	for (const MeshInstanceRD &value : values)
+		ids.push_back(owner.insert(value));
+
+	std::vector<ObjectID> shuffled = ids;
+
+	for (size_t i = shuffled.size() - 1; i > 0; i--)
+		std::swap(shuffled[i], shuffled[_random(state) % (i + 1)]);
+
+	snprintf(name, sizeof(name), "ObjectOwner lookup %u", count);
+
+	bench.run(name, count, [&]() {
+		ObjectID sum = 0;
+
+		for (ObjectID id : shuffled)
+			if (owner.has(id))
+				sum += owner[id].mesh;
+
+		benchKeep(sum);
+	});
+
+	snprintf(name, sizeof(name), "ObjectOwner iterate %u", count);
+
+	bench.run(name, count, [&]() {
+		ObjectID sum = 0;
+
+		for (const MeshInstanceRD &value : owner)
+			sum += value.mesh;
+
+		benchKeep(sum);
+	});
+
+	// every free moves last value into hole
+	snprintf(name, sizeof(name), "ObjectOwner free %u", count);
+
+	bench.run(
+			name, count,
+			[&]() {
+				pOwner = std::make_unique<ObjectOwner<MeshInstanceRD>>();
+
+				for (const MeshInstanceRD &value : values)
+					pOwner->insert(value);
+			},
+			[&]() {
+				for (ObjectID id : shuffled)
+					pOwner->free(id);
+			});
+}
+
+// state of a scene _buildQueues of renderer reads, without the device behind it
+typedef struct {
+	ObjectOwner<MeshRD> meshes;
+	ObjectOwner<MaterialRD> materials;
+	std::vector<ObjectID> meshIds;
+	std::vector<ObjectID> materialIds;
+
+	std::vector<MeshInstanceRD> instances;
+	std::vector<const MeshInstanceRD *> visibleInstances;
+} QueueScene;
+
+static void _createQueueScene(QueueScene &scene, uint32_t instanceCount) {
+	uint32_t state = instanceCount;
+
+	for (uint32_t i = 0; i < QUEUE_MATERIAL_COUNT; i++) {
+		MaterialRD material = {};
+		// fake handle, sets are only compared
+		material.textureSet = vk::DescriptorSet(reinterpret_cast<VkDescriptorSet>(
+				static_cast<uintptr_t>(i + 1)));
+		material.permutation = i % MATERIAL_PERMUTATION_COUNT;
+		material.index = i;
+
+		scene.materialIds.push_back(scene.materials.insert(material));
+	}
+
+	for (uint32_t i = 0; i < QUEUE_MESH_COUNT; i++) {
+		MeshRD mesh = {};
+		mesh.geometry.vertexOffset = i * 1024;
+
+		for (uint32_t primitive = 0; primitive < QUEUE_PRIMITIVE_COUNT; primitive++) {
+			PrimitiveRD primitiveRD = {};
+			primitiveRD.indexCount = 3000;
+			primitiveRD.firstIndex = (i * QUEUE_PRIMITIVE_COUNT + primitive) * 3000;
+			primitiveRD.material =
+					scene.materialIds[_random(state) % scene.materialIds.size()];
+			primitiveRD.lods.push_back({ 600, primitiveRD.firstIndex + 3000 });
+
+			mesh.primitives.push_back(primitiveRD);
+		}
+
+		scene.meshIds.push_back(scene.meshes.insert(mesh));
+	}
+
+	scene.instances.resize(instanceCount);
+
+	for (MeshInstanceRD &instance : scene.instances) {
+		instance.mesh = scene.meshIds[_random(state) % scene.meshIds.size()];
+		instance.lod = _random(state) % 2;
+	}
+
+	for (const MeshInstanceRD &instance : scene.instances)
+		scene.visibleInstances.push_back(&instance);
+}
+
+// mirrors _buildQueues of renderer, non bindless keys
+static void _buildQueues(const QueueScene &scene, RenderQueue &depthQueue,
+		RenderQueue &materialQueue, std::vector<glm::mat4> &transforms,
+		std::vector<uint32_t> &materials) {
+	depthQueue.clear();
+	materialQueue.clear();
+
+	for (const MeshInstanceRD *pMeshInstance : scene.visibleInstances) {
+		const MeshRD &mesh = scene.meshes[pMeshInstance->mesh];
+
+		for (uint32_t i = 0; i < mesh.primitives.size(); i++) {
+			const PrimitiveRD &primitive = mesh.primitives[i];
+			MaterialRD material = scene.materials.get_id_or_else(primitive.material, {});
+
+			uint32_t lodCount = static_cast<uint32_t>(primitive.lods.size());
+			uint32_t lod = glm::min(pMeshInstance->lod, lodCount);
+			uint32_t primitiveKey = i * (MAX_LOD_COUNT + 1) + lod;
+
+			DrawItem item = {};
+			item.pMesh = &mesh;
+			item.pPrimitive = &primitive;
+			item.pMeshInstance = pMeshInstance;
+			item.indexCount = lod > 0 ? primitive.lods[lod - 1].indexCount : primitive.indexCount;
+			item.firstIndex = lod > 0 ? primitive.lods[lod - 1].firstIndex : primitive.firstIndex;
+			item.vertexOffset = static_cast<int32_t>(mesh.geometry.vertexOffset);
+			item.materialIndex = material.index;
+
+			item.key = RenderQueue::makeKey(0, 0, pMeshInstance->mesh, primitiveKey);
+			depthQueue.add(item);
+
+			item.key = RenderQueue::makeKey(
+					material.permutation, primitive.material, pMeshInstance->mesh, primitiveKey);
+			item.textureSet = material.textureSet;
+			item.permutation = material.permutation;
+			materialQueue.add(item);
+		}
+	}
+
+	depthQueue.sort();
+	materialQueue.sort();
+
+	transforms.clear();
+	materials.clear();
+	depthQueue.batch(transforms, materials, QUEUE_MAX_TRANSFORMS);
+	materialQueue.batch(transforms, materials, QUEUE_MAX_TRANSFORMS);
+}
+
+void renderBenchRun(Bench &bench) {
+	for (uint32_t count : OWNER_OBJECT_COUNTS)
+		_ownerRun(bench, count);
+
+	for (uint32_t count : QUEUE_INSTANCE_COUNTS) {
+		char name[96];
+		snprintf(name, sizeof(name), "draw list build %u instances", count);
+
+		if (!bench.isSelected(name))
+			continue;
+
+		QueueScene scene;
+		_createQueueScene(scene, count);
+
+		RenderQueue depthQueue, materialQueue;
+		std::vector<glm::mat4> transforms;
+		std::vector<uint32_t> materials;
+
+		bench.run(name, count, [&]() {
+			_buildQueues(scene, depthQueue, materialQueue, transforms, materials);
+			benchKeep(materialQueue.batches().size());
+		});
+	}
+}
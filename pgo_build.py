@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+
+# Profile guided release build of hayaku, in one build directory:
+#   1. instrumented build, -DHAYAKU_PGO=generate
+#   2. --benchmark of every scene given, --stress-benchmark without any, write profiles
+#   3. same directory configured with -DHAYAKU_PGO=use and built again from profiles
+# usage: pgo_build.py <build directory> [scene...] [--frames <count>] [--no-lto]
+
+import os
+import shutil
+import subprocess
+import sys
+
+DEFAULT_FRAMES = 600
+
+def configure(build: str, pgo: str, lto: bool):
+    subprocess.run(["cmake", "-S", ".", "-B", build, "-DCMAKE_BUILD_TYPE=Release",
+                    f"-DHAYAKU_LTO={'ON' if lto else 'OFF'}", f"-DHAYAKU_PGO={pgo}"], check=True)
+
+def build(build: str):
+    subprocess.run(["cmake", "--build", build, "--target", "hayaku", "-j", str(os.cpu_count())],
+                   check=True)
+
+def train(build: str, scenes: list[str], frames: int):
+    executable = os.path.join(build, "hayaku")
+    runs: list[list[str]] = [["--benchmark", scene] for scene in scenes]
+
+    if len(runs) == 0:
+        runs.append(["--stress-benchmark"])
+
+    for i, run in enumerate(runs):
+        output = os.path.join(build, "pgo", f"benchmark_{i}.json")
+        args = [executable] + run + ["--frames", str(frames), "--benchmark-output", output]
+
+        # profile is written on exit, a failed run still counts what it went through
+        if subprocess.run(args).returncode != 0:
+            print(f"pgo_build: {' '.join(run)} failed, its profile is kept")
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: pgo_build.py <build directory> [scene...] [--frames <count>] [--no-lto]")
+        sys.exit(1)
+
+    build_dir: str = sys.argv[1]
+    scenes: list[str] = []
+    frames: int = DEFAULT_FRAMES
+    lto: bool = True
+
+    args = sys.argv[2:]
+    i = 0
+
+    while i < len(args):
+        if args[i] == "--frames" and i < len(args) - 1:
+            frames = int(args[i + 1])
+            i += 1
+        elif args[i] == "--no-lto":
+            lto = False
+        else:
+            scenes.append(os.path.abspath(args[i]))
+
+        i += 1
+
+    # profiles of older sources would only be partly matched
+    shutil.rmtree(os.path.join(build_dir, "pgo"), ignore_errors=True)
+
+    configure(build_dir, "generate", lto)
+    build(build_dir)
+    train(build_dir, scenes, frames)
+
+    configure(build_dir, "use", lto)
+    build(build_dir)
+
+main()
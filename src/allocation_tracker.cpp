@@ -0,0 +1,106 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "allocation_tracker.h"
+
+#ifdef HAYAKU_TRACK_ALLOCATIONS
+
+static std::atomic<uint64_t> _totalCount{ 0 };
+static std::atomic<uint64_t> _totalBytes{ 0 };
+// trivial, so reading them needs no initialization and works even while thread starts
+static thread_local uint64_t _threadCount = 0;
+static thread_local uint64_t _threadBytes = 0;
+
+static void *_allocate(std::size_t size) {
+	_threadCount++;
+	_threadBytes += size;
+	_totalCount.fetch_add(1, std::memory_order_relaxed);
+	_totalBytes.fetch_add(size, std::memory_order_relaxed);
+
+	// zero sized news still return distinct pointers
+	return std::malloc(size != 0 ? size : 1);
+}
+
+void *operator new(std::size_t size) {
+	void *p = _allocate(size);
+
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void *operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+	return _allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+	return _allocate(size);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+	std::free(p);
+}
+
+bool AllocationTracker::isAvailable() {
+	return true;
+}
+
+AllocationStats AllocationTracker::getTotal() {
+	AllocationStats stats;
+	stats.count = _totalCount.load(std::memory_order_relaxed);
+	stats.bytes = _totalBytes.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+AllocationStats AllocationTracker::getThread() {
+	AllocationStats stats;
+	stats.count = _threadCount;
+	stats.bytes = _threadBytes;
+
+	return stats;
+}
+
+#else
+
+bool AllocationTracker::isAvailable() {
+	return false;
+}
+
+AllocationStats AllocationTracker::getTotal() {
+	return {};
+}
+
+AllocationStats AllocationTracker::getThread() {
+	return {};
+}
+
+#endif
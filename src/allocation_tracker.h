@@ -0,0 +1,25 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <cstdint>
+
+struct AllocationStats {
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+};
+
+// Counts heap allocations made through operator new, of the whole process and of every thread,
+// differences of two reads then tell what a frame or a profiler zone allocated. Replacement
+// operators are only built with HAYAKU_TRACK_ALLOCATIONS, counts stay zero otherwise. malloc of C
+// libraries and drivers bypasses them, so do over-aligned news.
+class AllocationTracker {
+public:
+	static bool isAvailable();
+
+	// every thread since start, relaxed
+	static AllocationStats getTotal();
+	// calling thread since it started, no atomics, cheap enough for every zone
+	static AllocationStats getThread();
+};
+
+#endif // !ALLOCATION_TRACKER_H
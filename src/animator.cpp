@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "job_system.h"
+#include "profiler.h"
+#include "scene_graph.h"
+
+#include "animator.h"
+
+void Animator::_sample(const AnimationClip &clip, float time, std::vector<float> &frame) {
+	uint32_t frameSize = clip.getFrameSize();
+	frame.resize(frameSize);
+
+	float position = std::max(time, 0.0f) * ANIMATION_SAMPLE_RATE;
+	uint32_t first = std::min(static_cast<uint32_t>(position), clip.frameCount - 1);
+	uint32_t second = std::min(first + 1, clip.frameCount - 1);
+	float alpha = std::min(position - static_cast<float>(first), 1.0f);
+
+	const float *pA = &clip.samples[static_cast<size_t>(first) * frameSize];
+	const float *pB = &clip.samples[static_cast<size_t>(second) * frameSize];
+	const float *pWeights = clip.blendWeights.data();
+	float *pFrame = frame.data();
+
+	// every channel at once, step channels have weight 0 and keep first frame
+	for (uint32_t i = 0; i < frameSize; i++)
+		pFrame[i] = pA[i] + (pB[i] - pA[i]) * (alpha * pWeights[i]);
+
+	// blended rotations are shorter than unit, components lie in blocks of rotation count
+	uint32_t count = clip.rotationCount;
+	float *pX = pFrame + clip.translationCount * 3;
+	float *pY = pX + count;
+	float *pZ = pY + count;
+	float *pW = pZ + count;
+
+	for (uint32_t i = 0; i < count; i++) {
+		float lengthSquared = pX[i] * pX[i] + pY[i] * pY[i] + pZ[i] * pZ[i] + pW[i] * pW[i];
+		float scale = 1.0f / std::sqrt(lengthSquared);
+
+		pX[i] *= scale;
+		pY[i] *= scale;
+		pZ[i] *= scale;
+		pW[i] *= scale;
+	}
+}
+
+glm::mat4 Animator::_compose(const AnimationClip &clip, const AnimationClip::Target &target,
+		const std::vector<float> &frame) {
+	glm::vec3 translation = target.translation;
+	glm::quat rotation = target.rotation;
+	glm::vec3 scale = target.scale;
+
+	uint32_t translations = clip.translationCount;
+	uint32_t rotations = clip.rotationCount;
+	uint32_t scales = clip.scaleCount;
+
+	if (target.translationChannel != ANIMATION_NO_CHANNEL) {
+		const float *pBlock = frame.data() + target.translationChannel;
+		translation = glm::vec3(pBlock[0], pBlock[translations], pBlock[translations * 2]);
+	}
+
+	if (target.rotationChannel != ANIMATION_NO_CHANNEL) {
+		const float *pBlock = frame.data() + translations * 3 + target.rotationChannel;
+		rotation = glm::quat(pBlock[rotations * 3], pBlock[0], pBlock[rotations],
+				pBlock[rotations * 2]);
+	}
+
+	if (target.scaleChannel != ANIMATION_NO_CHANNEL) {
+		const float *pBlock =
+				frame.data() + translations * 3 + rotations * 4 + target.scaleChannel;
+		scale = glm::vec3(pBlock[0], pBlock[scales], pBlock[scales * 2]);
+	}
+
+	glm::mat4 transform = glm::mat4_cast(rotation);
+	transform[0] *= scale.x;
+	transform[1] *= scale.y;
+	transform[2] *= scale.z;
+	transform[3] = glm::vec4(translation, 1.0f);
+
+	return transform;
+}
+
+void Animator::_updateBounds(Player &player, const SceneGraph &graph) const {
+	const std::vector<AnimationClip::Target> &targets = player.pClip->targets;
+	glm::vec3 center = glm::vec3(0.0f);
+
+	for (const AnimationClip::Target &target : targets) {
+		uint32_t node = player.nodeOffset + static_cast<uint32_t>(target.node);
+		center += glm::vec3(graph.nodeGetWorldTransform(node)[3]);
+	}
+
+	center /= static_cast<float>(targets.size());
+
+	float radius = 0.0f;
+
+	for (const AnimationClip::Target &target : targets) {
+		uint32_t node = player.nodeOffset + static_cast<uint32_t>(target.node);
+		radius = std::max(
+				radius, glm::distance(center, glm::vec3(graph.nodeGetWorldTransform(node)[3])));
+	}
+
+	player.center = center;
+	player.radius = radius;
+}
+
+void Animator::play(const AnimationClip &clip, uint32_t nodeOffset, const SceneGraph &graph) {
+	if (clip.targets.empty() || clip.frameCount == 0)
+		return;
+
+	for (const AnimationClip::Target &target : clip.targets) {
+		if (nodeOffset + target.node >= graph.getNodeCount())
+			return;
+	}
+
+	Player player = {};
+	player.pClip = &clip;
+	player.nodeOffset = nodeOffset;
+	player.phase = static_cast<uint32_t>(_players.size());
+
+	_updateBounds(player, graph);
+	_players.push_back(player);
+}
+
+void Animator::update(SceneGraph &graph, float deltaTime, const glm::mat4 &cameraTransform) {
+	if (_players.empty())
+		return;
+
+	PROFILE_ZONE("animation update");
+
+	_frame++;
+
+	glm::vec3 eye = glm::vec3(cameraTransform[3]);
+	glm::vec3 forward = -glm::normalize(glm::vec3(cameraTransform[2]));
+
+	_sampled.clear();
+	_firstTransforms.clear();
+	uint32_t transformCount = 0;
+
+	for (uint32_t i = 0; i < _players.size(); i++) {
+		Player &player = _players[i];
+		const AnimationClip &clip = *player.pClip;
+
+		// time runs on between samples, skipped frames cost nothing but precision
+		player.time += deltaTime;
+
+		if (clip.duration > 0.0f)
+			player.time = std::fmod(player.time, clip.duration);
+		else
+			player.time = 0.0f;
+
+		glm::vec3 toCenter = player.center - eye;
+		float centerDistance = glm::length(toCenter);
+		float distance = std::max(centerDistance - player.radius, 0.0f);
+
+		uint32_t interval = std::min(1 + static_cast<uint32_t>(distance / ANIMATION_LOD_DISTANCE),
+				ANIMATION_MAX_INTERVAL);
+
+		// cone is widened by radius, players around camera count as seen
+		if (distance > 0.0f &&
+				glm::dot(toCenter, forward) < ANIMATION_VIEW_COS * centerDistance - player.radius)
+			interval = ANIMATION_HIDDEN_INTERVAL;
+
+		if ((_frame + player.phase) % interval != 0)
+			continue;
+
+		_sampled.push_back(i);
+		_firstTransforms.push_back(transformCount);
+		transformCount += static_cast<uint32_t>(clip.targets.size());
+	}
+
+	if (_sampled.empty())
+		return;
+
+	_transforms.resize(transformCount);
+
+	// graph is only read here, world transforms are of last update
+	JobSystem::parallelFor(static_cast<uint32_t>(_sampled.size()), ANIMATION_GRAIN,
+			[&](uint32_t first, uint32_t last) {
+				std::vector<float> frame;
+
+				for (uint32_t i = first; i < last; i++) {
+					Player &player = _players[_sampled[i]];
+					const AnimationClip &clip = *player.pClip;
+
+					_sample(clip, player.time, frame);
+
+					glm::mat4 *pTransforms = &_transforms[_firstTransforms[i]];
+
+					for (size_t j = 0; j < clip.targets.size(); j++)
+						pTransforms[j] = _compose(clip, clip.targets[j], frame);
+
+					_updateBounds(player, graph);
+				}
+			});
+
+	for (uint32_t i = 0; i < _sampled.size(); i++) {
+		const Player &player = _players[_sampled[i]];
+		const std::vector<AnimationClip::Target> &targets = player.pClip->targets;
+
+		for (size_t j = 0; j < targets.size(); j++) {
+			uint32_t node = player.nodeOffset + static_cast<uint32_t>(targets[j].node);
+			graph.nodeSetTransform(node, _transforms[_firstTransforms[i] + j]);
+		}
+	}
+}
+
+void Animator::clear() {
+	_players.clear();
+	_sampled.clear();
+	_firstTransforms.clear();
+	_transforms.clear();
+	_frame = 0;
+}
+
+uint32_t Animator::getPlayerCount() const {
+	return static_cast<uint32_t>(_players.size());
+}
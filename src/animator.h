@@ -0,0 +1,69 @@
+#ifndef ANIMATOR_H
+#define ANIMATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "io/animation.h"
+
+class SceneGraph;
+
+// players within it are sampled every frame, interval grows by a frame per step beyond it
+const float ANIMATION_LOD_DISTANCE = 20.0f;
+const uint32_t ANIMATION_MAX_INTERVAL = 8;
+// of players whose nodes lie outside of view cone
+const uint32_t ANIMATION_HIDDEN_INTERVAL = 16;
+// cosine of half angle of view cone, wider than any field of view camera takes
+const float ANIMATION_VIEW_COS = 0.5f;
+
+// players sampled by one job
+const uint32_t ANIMATION_GRAIN = 8;
+
+// Plays clips on placed nodes, looping. Players far away are sampled every few frames and those
+// behind camera rarely, intervals are staggered so sampled players spread across frames. Sampling
+// runs on job system, each player blends two frames of its clip and composes local transforms,
+// which are then set on scene graph in one pass, so its dirty subtrees carry instances, lights and
+// skins along on next update. Clips have to outlive players, prefabs own them.
+class Animator {
+private:
+	typedef struct {
+		const AnimationClip *pClip;
+		// first node of placed prefab, targets are offset by it
+		uint32_t nodeOffset;
+		float time;
+		// staggers sampling of players sharing an interval
+		uint32_t phase;
+
+		// sphere around world positions of targets as of last sample
+		glm::vec3 center;
+		float radius;
+	} Player;
+
+	std::vector<Player> _players;
+	uint32_t _frame = 0;
+
+	// per frame, of players sampled and their local transforms, each owns a range of targets
+	std::vector<uint32_t> _sampled;
+	std::vector<uint32_t> _firstTransforms;
+	std::vector<glm::mat4> _transforms;
+
+	// frame of floats, every channel of clip at time
+	static void _sample(const AnimationClip &clip, float time, std::vector<float> &frame);
+	static glm::mat4 _compose(const AnimationClip &clip, const AnimationClip::Target &target,
+			const std::vector<float> &frame);
+	void _updateBounds(Player &player, const SceneGraph &graph) const;
+
+public:
+	// nodes of clip start at node offset, graph has to have world transforms of them already
+	void play(const AnimationClip &clip, uint32_t nodeOffset, const SceneGraph &graph);
+
+	// camera world transform picks intervals, graph is read while sampling and written after
+	void update(SceneGraph &graph, float deltaTime, const glm::mat4 &cameraTransform);
+	void clear();
+
+	uint32_t getPlayerCount() const;
+};
+
+#endif // !ANIMATOR_H
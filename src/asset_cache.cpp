@@ -0,0 +1,77 @@
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#include "rendering/rendering_server.h"
+
+#include "asset_cache.h"
+
+static std::unordered_map<std::string, std::shared_ptr<Prefab>> _prefabs;
+
+std::string AssetCache::getKey(const std::filesystem::path &path) {
+	std::error_code error;
+
+	std::filesystem::path canonical = std::filesystem::canonical(path, error);
+	if (error)
+		return std::string();
+
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(canonical, error);
+	if (error)
+		return std::string();
+
+	return canonical.string() + "|" + std::to_string(time.time_since_epoch().count());
+}
+
+std::shared_ptr<Prefab> AssetCache::acquire(const std::string &key) {
+	auto it = _prefabs.find(key);
+
+	if (it == _prefabs.end())
+		return nullptr;
+
+	it->second->referenceCount++;
+	return it->second;
+}
+
+std::shared_ptr<Prefab> AssetCache::find(const std::filesystem::path &path) {
+	auto it = _prefabs.find(getKey(path));
+	return it != _prefabs.end() ? it->second : nullptr;
+}
+
+void AssetCache::insert(const std::string &key, const std::shared_ptr<Prefab> &prefab) {
+	if (key.empty() || prefab == nullptr || _prefabs.count(key) > 0)
+		return;
+
+	prefab->key = key;
+	_prefabs[key] = prefab;
+}
+
+void AssetCache::retain(const std::shared_ptr<Prefab> &prefab) {
+	if (prefab != nullptr)
+		prefab->referenceCount++;
+}
+
+void AssetCache::release(const std::shared_ptr<Prefab> &prefab) {
+	if (prefab == nullptr || prefab->referenceCount == 0 || --prefab->referenceCount > 0)
+		return;
+
+	// instances of it are gone already, meshes go before materials they draw with
+	for (ObjectID mesh : prefab->meshes)
+		RS::getSingleton().meshFree(mesh);
+
+	for (ObjectID material : prefab->materials)
+		RS::getSingleton().materialFree(material);
+
+	for (ObjectID texture : prefab->textures)
+		RS::getSingleton().textureFree(texture);
+
+	prefab->meshes.clear();
+	prefab->meshBounds.clear();
+	prefab->materials.clear();
+	prefab->textures.clear();
+
+	if (!prefab->key.empty())
+		_prefabs.erase(prefab->key);
+}
@@ -0,0 +1,70 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io/asset_loader.h"
+#include "rendering/types/aabb.h"
+
+typedef uint64_t ObjectID;
+
+// renderer resources of one loaded file and what instantiating it places
+struct Prefab {
+	std::vector<ObjectID> textures;
+	std::vector<ObjectID> materials;
+	std::vector<ObjectID> meshes;
+	// per mesh, mesh space
+	std::vector<AABB> meshBounds;
+
+	std::vector<AssetLoader::Node> nodes;
+	std::vector<AssetLoader::MeshInstance> meshInstances;
+	std::vector<AssetLoader::Skin> skins;
+	std::vector<AssetLoader::Light> lights;
+	// world space, applied by loading file and not moved by instantiating it elsewhere
+	LightProbeGrid lightProbes;
+	// world space like probes, renderer culls through its portals
+	CellPortalGraph cellPortals;
+	// targets are nodes of prefab, every placement plays first one, see Animator
+	std::vector<AnimationClip> animations;
+
+	// of file loaded with hot reload, empty otherwise, see Scene::setHotReload
+	std::vector<ObjectID> imageTextures;
+	std::vector<AssetLoader::ImageSource> imageSources;
+	std::vector<AssetLoader::Material> sceneMaterials;
+	std::vector<std::filesystem::path> bufferPaths;
+	// of converted images and of meshes, only those which differ are uploaded again
+	std::vector<uint64_t> imageHashes;
+	std::vector<uint64_t> meshHashes;
+
+	// scenes using it, resources are freed with last one
+	uint32_t referenceCount = 0;
+	// empty until prefab is cached
+	std::string key;
+};
+
+// Prefabs keyed by canonical path and modification time, so loading a file again shares its
+// meshes, materials and textures and a file changed on disk is loaded anew. Prefab leaves cache
+// once its last reference is released. Main thread only.
+class AssetCache {
+public:
+	// empty when file does not exist
+	static std::string getKey(const std::filesystem::path &path);
+
+	// adds reference, nullptr when nothing is cached under key
+	static std::shared_ptr<Prefab> acquire(const std::string &key);
+	// no reference is added
+	static std::shared_ptr<Prefab> find(const std::filesystem::path &path);
+
+	// fully created prefab, references it already has are kept
+	static void insert(const std::string &key, const std::shared_ptr<Prefab> &prefab);
+
+	static void retain(const std::shared_ptr<Prefab> &prefab);
+	// last reference frees resources, cached or not
+	static void release(const std::shared_ptr<Prefab> &prefab);
+};
+
+#endif // !ASSET_CACHE_H
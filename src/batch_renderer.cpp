@@ -0,0 +1,143 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "rendering/rendering_server.h"
+
+#include "batch_renderer.h"
+
+bool BatchRenderer::loadJobs(const char *pFile, std::vector<RenderJob> &jobs) {
+	size_t size;
+	char *pData = static_cast<char *>(SDL_LoadFile(pFile, &size));
+
+	if (pData == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Render jobs %s can not be read!", pFile);
+		return false;
+	}
+
+	jobs.clear();
+
+	// loaded files are null terminated
+	const char *pLine = pData;
+
+	while (*pLine != '\0') {
+		char scene[1024];
+		char output[1024];
+		RenderJob job;
+
+		if (*pLine != '#' &&
+				SDL_sscanf(pLine, "%1023s %1023s %f %f %f %f %f", scene, output,
+						&job.translation.x, &job.translation.y, &job.translation.z,
+						&job.rotation.x, &job.rotation.y) == 7) {
+			job.scene = scene;
+			job.output = output;
+			jobs.push_back(job);
+		}
+
+		const char *pEnd = SDL_strchr(pLine, '\n');
+		pLine = pEnd != nullptr ? pEnd + 1 : pLine + SDL_strlen(pLine);
+	}
+
+	SDL_free(pData);
+
+	if (jobs.empty()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Render jobs %s has no jobs!", pFile);
+		return false;
+	}
+
+	return true;
+}
+
+bool BatchRenderer::initialize(const std::vector<RenderJob> &jobs) {
+	if (!RS::getSingleton().isHeadless()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Batch rendering needs headless device!");
+		return false;
+	}
+
+	_jobs = jobs;
+	_job = 0;
+	_stage = Stage::Begin;
+
+	return !_jobs.empty();
+}
+
+void BatchRenderer::frameBegin(Scene &scene, CameraController &camera) {
+	if (_job == _jobs.size())
+		return;
+
+	const RenderJob &job = _jobs[_job];
+
+	if (_stage == Stage::Begin) {
+		_settleFrames = BATCH_VIEW_SETTLE_FRAMES;
+
+		// consecutive jobs of one scene only move camera
+		if (job.scene != _scene) {
+			_settleFrames = BATCH_SCENE_SETTLE_FRAMES;
+			_scene = scene.load(job.scene) ? job.scene : std::string();
+
+			if (_scene.empty()) {
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Batch: %s skipped",
+						job.output.c_str());
+				_job++;
+				return;
+			}
+		}
+
+		_stage = Stage::Loading;
+		_frame = 0;
+	}
+
+	camera.setPose(job.translation, job.rotation);
+
+	// last frame of settling is the one captured
+	if (_stage != Stage::Settling || _frame + 1 != _settleFrames)
+		return;
+
+	std::string output = job.output;
+
+	RS::getSingleton().requestCapture(
+			[this, output](std::shared_ptr<Image> image) { _writer.write(output, image); });
+}
+
+bool BatchRenderer::frameEnd(bool isLoading) {
+	_writer.collect();
+
+	switch (_stage) {
+		case Stage::Begin:
+			break;
+		case Stage::Loading:
+			if (isLoading)
+				break;
+
+			_stage = Stage::Settling;
+			_frame = 0;
+			break;
+		case Stage::Settling:
+			if (++_frame < _settleFrames)
+				break;
+
+			_stage = Stage::Begin;
+			_job++;
+			break;
+	}
+
+	if (_job < _jobs.size())
+		return true;
+
+	// copies of last frames in flight, then their encoding
+	RS::getSingleton().captureWait();
+	_writer.wait();
+
+	SDL_Log("Batch: %u of %zu renders written", _writer.getWrittenCount(), _jobs.size());
+	return false;
+}
+
+bool BatchRenderer::isWritten() const {
+	return _writer.getWrittenCount() == _jobs.size();
+}
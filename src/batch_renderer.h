@@ -0,0 +1,68 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera_controller.h"
+#include "capture_writer.h"
+#include "scene.h"
+
+// frames drawn before a job is read back, textures stream in and environment bakes meanwhile,
+// view of scene already loaded only waits for levels it asks for
+const uint32_t BATCH_SCENE_SETTLE_FRAMES = 60;
+const uint32_t BATCH_VIEW_SETTLE_FRAMES = 4;
+
+struct RenderJob {
+	std::string scene;
+	glm::vec3 translation;
+	// yaw and pitch
+	glm::vec2 rotation;
+	// EXR for .exr extension, PNG otherwise
+	std::string output;
+};
+
+// Renders a list of scene and camera jobs on headless device. Scene is loaded only when it
+// differs from that of previous job, so views of one scene follow each other every few frames.
+// Every job is captured without waiting, later jobs are drawn while GPU copies earlier ones and
+// images are encoded on background threads.
+class BatchRenderer {
+private:
+	enum class Stage {
+		Begin,
+		Loading,
+		Settling,
+	};
+
+	std::vector<RenderJob> _jobs;
+	size_t _job = 0;
+
+	Stage _stage = Stage::Begin;
+	uint32_t _frame = 0;
+	uint32_t _settleFrames = 0;
+
+	// last one asked to load, empty when load failed
+	std::string _scene;
+
+	CaptureWriter _writer;
+
+public:
+	// line per job of scene, output, translation, yaw and pitch, paths without spaces
+	static bool loadJobs(const char *pFile, std::vector<RenderJob> &jobs);
+
+	bool initialize(const std::vector<RenderJob> &jobs);
+
+	// before scene is updated and drawn, loads scene of job and poses camera
+	void frameBegin(Scene &scene, CameraController &camera);
+	// after frame is drawn, returns false once every job is written or failed
+	bool frameEnd(bool isLoading);
+
+	// every job was written
+	bool isWritten() const;
+};
+
+#endif // !BATCH_RENDERER_H
@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include "profiler.h"
+#include "rendering/rendering_server.h"
+
+#include "benchmark.h"
+
+static double _toMilliseconds(uint64_t ticks) {
+	return ticks * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+}
+
+// nearest rank
+static float _percentile(const std::vector<float> &sorted, float percentile) {
+	size_t rank = static_cast<size_t>(std::ceil(percentile * sorted.size()));
+	return sorted[std::clamp(rank, size_t(1), sorted.size()) - 1];
+}
+
+static void _writeString(SDL_IOStream *pStream, const std::string &string) {
+	SDL_IOprintf(pStream, "\"");
+
+	for (char c : string) {
+		if (c == '"' || c == '\\')
+			SDL_IOprintf(pStream, "\\%c", c);
+		else if (static_cast<unsigned char>(c) >= 0x20)
+			SDL_IOprintf(pStream, "%c", c);
+	}
+
+	SDL_IOprintf(pStream, "\"");
+}
+
+// classes of frames and averages of what they spent where, tells which optimizations pay off
+static void _writeBounds(SDL_IOStream *pStream, const std::vector<FrameBoundSample> &bounds) {
+	uint32_t counts[static_cast<size_t>(FrameBound::Count)] = {};
+	FrameBoundSample sum = {};
+	uint32_t gpuCount = 0;
+
+	for (const FrameBoundSample &bound : bounds) {
+		counts[static_cast<size_t>(bound.bound)]++;
+		sum.cpuMilliseconds += bound.cpuMilliseconds;
+		sum.fenceWaitMilliseconds += bound.fenceWaitMilliseconds;
+		sum.acquireMilliseconds += bound.acquireMilliseconds;
+		sum.presentMilliseconds += bound.presentMilliseconds;
+
+		if (bound.gpuMilliseconds >= 0.0f) {
+			sum.gpuMilliseconds += bound.gpuMilliseconds;
+			gpuCount++;
+		}
+	}
+
+	float count = static_cast<float>(std::max(bounds.size(), size_t(1)));
+
+	SDL_IOprintf(pStream,
+			"\t\"bound\": { \"verdict\": \"%s\", \"frames\": %u, \"cpu\": %u, \"gpu\": %u, "
+			"\"present\": %u, \"cpuMilliseconds\": %.4f, \"gpuMilliseconds\": %.4f, "
+			"\"fenceWaitMilliseconds\": %.4f, \"acquireMilliseconds\": %.4f, "
+			"\"presentMilliseconds\": %.4f },\n",
+			BoundAnalyzer::getName(BoundAnalyzer::getMajority(counts)),
+			static_cast<uint32_t>(bounds.size()), counts[static_cast<size_t>(FrameBound::Cpu)],
+			counts[static_cast<size_t>(FrameBound::Gpu)],
+			counts[static_cast<size_t>(FrameBound::Present)], sum.cpuMilliseconds / count,
+			gpuCount > 0 ? sum.gpuMilliseconds / static_cast<float>(gpuCount) : -1.0f,
+			sum.fenceWaitMilliseconds / count, sum.acquireMilliseconds / count,
+			sum.presentMilliseconds / count);
+}
+
+static void _writeTimes(SDL_IOStream *pStream, const char *name, std::vector<float> times) {
+	SDL_IOprintf(pStream, "\t\"%s\": ", name);
+
+	if (times.empty()) {
+		SDL_IOprintf(pStream, "null,\n");
+		return;
+	}
+
+	std::sort(times.begin(), times.end());
+
+	double sum = 0.0;
+
+	for (float time : times)
+		sum += time;
+
+	SDL_IOprintf(pStream,
+			"{ \"average\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+			sum / times.size(), _percentile(times, 0.50f), _percentile(times, 0.95f),
+			_percentile(times, 0.99f), times.back());
+}
+
+bool Benchmark::_write() const {
+	SDL_IOStream *pStream = SDL_IOFromFile(_output.c_str(), "w");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Benchmark result %s can not be written!",
+				_output.c_str());
+		return false;
+	}
+
+	SDL_IOprintf(pStream, "{\n\t\"scene\": ");
+	_writeString(pStream, _scene);
+	SDL_IOprintf(pStream, ",\n");
+
+	SDL_IOprintf(pStream, "\t\"frames\": %u,\n", _frameCount);
+	SDL_IOprintf(pStream, "\t\"runs\": %u,\n", _runCount);
+	SDL_IOprintf(pStream, "\t\"warmupFrames\": %u,\n", _warmupFrameCount);
+	SDL_IOprintf(pStream, "\t\"timeStep\": %.6f,\n", BENCHMARK_TIME_STEP);
+	SDL_IOprintf(pStream, "\t\"pathDuration\": %.4f,\n", _path.getDuration());
+
+	// time zones took until load finished, summed over threads, averages of runs
+	SDL_IOprintf(pStream, "\t\"loadMilliseconds\": %.3f,\n", _loadMilliseconds / _runCount);
+	SDL_IOprintf(pStream, "\t\"loadZones\": {");
+
+	for (size_t i = 0; i < _loadZones.size(); i++) {
+		SDL_IOprintf(pStream, "%s\n\t\t", i == 0 ? "" : ",");
+		_writeString(pStream, _loadZones[i].name);
+		SDL_IOprintf(pStream, ": %.3f", _loadZones[i].milliseconds / _runCount);
+	}
+
+	SDL_IOprintf(pStream, "\n\t},\n");
+
+	_writeTimes(pStream, "frameMilliseconds", _frameTimes);
+	_writeTimes(pStream, "cpuMilliseconds", _cpuTimes);
+	_writeTimes(pStream, "gpuMilliseconds", _gpuTimes);
+	_writeBounds(pStream, _bounds);
+
+	MemoryStats memory = RS::getSingleton().getMemoryStats();
+
+	SDL_IOprintf(pStream, "\t\"memory\": {\n");
+	SDL_IOprintf(pStream, "\t\t\"usage\": %llu,\n",
+			static_cast<unsigned long long>(memory.usage));
+	SDL_IOprintf(pStream, "\t\t\"budget\": %llu,\n",
+			static_cast<unsigned long long>(memory.budget));
+	SDL_IOprintf(pStream, "\t\t\"peak\": %llu,\n",
+			static_cast<unsigned long long>(memory.tracked.peakBytes));
+	SDL_IOprintf(pStream, "\t\t\"categories\": {");
+
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++) {
+		const MemoryCategoryStats &category = memory.categories[i];
+
+		SDL_IOprintf(pStream, "%s\n\t\t\t\"%s\": { \"bytes\": %llu, \"peak\": %llu }",
+				i == 0 ? "" : ",", MemoryTracker::getName(static_cast<MemoryCategory>(i)),
+				static_cast<unsigned long long>(category.bytes),
+				static_cast<unsigned long long>(category.peakBytes));
+	}
+
+	SDL_IOprintf(pStream, "\n\t\t}\n\t},\n");
+
+	if (!_baselineFile.empty()) {
+		SDL_IOprintf(pStream, "\t\"baseline\": ");
+		_writeString(pStream, _baselineFile);
+		SDL_IOprintf(pStream, ",\n\t\"threshold\": %.4f,\n", _threshold);
+		SDL_IOprintf(pStream, "\t\"comparison\": {");
+
+		for (size_t i = 0; i < _comparisons.size(); i++) {
+			const BenchmarkComparison &comparison = _comparisons[i];
+
+			SDL_IOprintf(pStream, "%s\n\t\t", i == 0 ? "" : ",");
+			_writeString(pStream, comparison.name);
+			SDL_IOprintf(pStream,
+					": { \"baseline\": %.4f, \"median\": %.4f, \"change\": %.4f, \"p\": %.6f, "
+					"\"verdict\": \"%s\" }",
+					comparison.baselineMedian, comparison.median, comparison.change,
+					comparison.pValue, BenchmarkSamples::getVerdictName(comparison.verdict));
+		}
+
+		SDL_IOprintf(pStream, "\n\t},\n");
+	}
+
+	// raw, baseline of later runs
+	_samples.write(pStream);
+	SDL_IOprintf(pStream, "\n}\n");
+
+	if (!SDL_CloseIO(pStream)) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Benchmark result write failed!");
+		return false;
+	}
+
+	return true;
+}
+
+bool Benchmark::initialize(const char *pScene, const char *pCameraPath, uint32_t frameCount,
+		const char *pOutput, uint32_t warmupFrameCount) {
+	if (pCameraPath != nullptr && !_path.load(pCameraPath))
+		return false;
+
+	_scene = pScene;
+	_output = pOutput;
+	_frameCount = std::max(frameCount, 1u);
+	_warmupFrameCount = warmupFrameCount;
+
+	_start = SDL_GetPerformanceCounter();
+	return true;
+}
+
+void Benchmark::setRunCount(uint32_t runCount) {
+	_runCount = std::max(runCount, 1u);
+}
+
+bool Benchmark::setBaseline(const char *pFile, float threshold) {
+	if (!_baseline.load(pFile) || _baseline.isEmpty()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Benchmark baseline %s has no samples!", pFile);
+		return false;
+	}
+
+	_baselineFile = pFile;
+	_threshold = threshold;
+	return true;
+}
+
+void Benchmark::_loadEnd(uint64_t end) {
+	double loadMilliseconds = _toMilliseconds(end - _start);
+
+	_loadMilliseconds += loadMilliseconds;
+	_samples.add("load", static_cast<float>(loadMilliseconds));
+
+	// profiler totals count since start, load of this run is what they grew by
+	for (const CpuZoneStats &zone : Profiler::getFrameSummary()) {
+		double milliseconds = zone.totalMilliseconds;
+
+		for (const LoadZone &total : _runZoneTotals)
+			if (total.name == zone.name)
+				milliseconds -= total.milliseconds;
+
+		auto it = std::find_if(_loadZones.begin(), _loadZones.end(),
+				[&](const LoadZone &loadZone) { return loadZone.name == zone.name; });
+
+		if (it != _loadZones.end())
+			it->milliseconds += milliseconds;
+		else
+			_loadZones.push_back({ zone.name, milliseconds });
+
+		_samples.add(std::string("load ") + zone.name, static_cast<float>(milliseconds));
+	}
+
+	SDL_Log("Benchmark: run %u of %u loaded in %.1f ms, warming up", _run + 1, _runCount,
+			loadMilliseconds);
+}
+
+void Benchmark::_measure(uint64_t end, uint64_t frameTicks) {
+	float frameMilliseconds = static_cast<float>(_toMilliseconds(frameTicks));
+	float cpuMilliseconds = static_cast<float>(_toMilliseconds(end - _frameBegin));
+
+	_frameTimes.push_back(frameMilliseconds);
+	_cpuTimes.push_back(cpuMilliseconds);
+
+	_samples.add("frame", frameMilliseconds);
+	_samples.add("cpu", cpuMilliseconds);
+
+	// of a frame as many as there are in flight earlier
+	for (const GpuTiming &timing : RS::getSingleton().getGpuTimings()) {
+		if (timing.name == "frame") {
+			_gpuTimes.push_back(timing.milliseconds);
+			_samples.add("gpu", timing.milliseconds);
+		} else {
+			_samples.add("gpu " + timing.name, timing.milliseconds);
+		}
+	}
+
+	// of previous frame, profiler sums zones once main loop ends it
+	for (const CpuZoneStats &zone : Profiler::getFrameSummary())
+		_samples.add(std::string("cpu ") + zone.name, zone.milliseconds);
+
+	FrameBoundSample bound = RS::getSingleton().getFrameBoundStats().last;
+
+	if (bound.bound != FrameBound::Unknown &&
+			(_bounds.empty() || _bounds.back().frameNumber != bound.frameNumber))
+		_bounds.push_back(bound);
+}
+
+void Benchmark::_compare() {
+	if (_baselineFile.empty())
+		return;
+
+	// a hundredth of millisecond is below what zones resolve between runs
+	_comparisons = _samples.compare(_baseline, _threshold, 0.01f);
+
+	uint32_t slowerCount = 0;
+	uint32_t fasterCount = 0;
+
+	for (const BenchmarkComparison &comparison : _comparisons) {
+		if (comparison.verdict == BenchmarkVerdict::Unchanged)
+			continue;
+
+		if (comparison.verdict == BenchmarkVerdict::Slower)
+			slowerCount++;
+		else
+			fasterCount++;
+
+		SDL_Log("Benchmark: %s %s by %.1f%%, %.3f -> %.3f ms (p %.4f)", comparison.name.c_str(),
+				BenchmarkSamples::getVerdictName(comparison.verdict),
+				std::abs(comparison.change) * 100.0f, comparison.baselineMedian,
+				comparison.median, comparison.pValue);
+	}
+
+	if (slowerCount > 0)
+		SDL_Log("Benchmark: slower than %s, %u sets regressed, %u improved",
+				_baselineFile.c_str(), slowerCount, fasterCount);
+	else if (fasterCount > 0)
+		SDL_Log("Benchmark: faster than %s, %u sets improved", _baselineFile.c_str(),
+				fasterCount);
+	else
+		SDL_Log("Benchmark: no change against %s above %.1f%%", _baselineFile.c_str(),
+				_threshold * 100.0f);
+}
+
+void Benchmark::frameBegin(CameraController &camera) {
+	_frameBegin = SDL_GetPerformanceCounter();
+
+	if (_path.isEmpty())
+		return;
+
+	// path loops when it is shorter than the run, it is held while loading and warming up
+	float time = 0.0f;
+	float duration = _path.getDuration();
+
+	if (_stage == Stage::Measuring && duration > 0.0f)
+		time = std::fmod(_frame * BENCHMARK_TIME_STEP, duration);
+
+	glm::vec3 translation;
+	glm::vec2 rotation;
+	_path.sample(time, translation, rotation);
+
+	camera.setPose(translation, rotation);
+}
+
+bool Benchmark::frameEnd(bool isLoading) {
+	uint64_t end = SDL_GetPerformanceCounter();
+	uint64_t frameTicks = _lastFrameEnd != 0 ? end - _lastFrameEnd : 0;
+	_lastFrameEnd = end;
+
+	switch (_stage) {
+		case Stage::Loading:
+			if (isLoading)
+				break;
+
+			_loadEnd(end);
+
+			_stage = Stage::Warmup;
+			_frame = 0;
+			break;
+		case Stage::Warmup:
+			if (++_frame < _warmupFrameCount)
+				break;
+
+			SDL_Log("Benchmark: measuring %u frames", _frameCount);
+
+			_stage = Stage::Measuring;
+			_frame = 0;
+			break;
+		case Stage::Measuring: {
+			_measure(end, frameTicks);
+
+			if (++_frame < _frameCount)
+				break;
+
+			// next run loads scene anew, loading is timed from here
+			if (++_run < _runCount) {
+				_runZoneTotals.clear();
+
+				for (const CpuZoneStats &zone : Profiler::getFrameSummary())
+					_runZoneTotals.push_back({ zone.name, zone.totalMilliseconds });
+
+				_isReloadRequested = true;
+				_start = end;
+				_stage = Stage::Loading;
+				break;
+			}
+
+			_compare();
+			_isWritten = _write();
+			_stage = Stage::Done;
+
+			if (_isWritten)
+				SDL_Log("Benchmark: result written to %s", _output.c_str());
+
+			return false;
+		}
+		case Stage::Done:
+			return false;
+	}
+
+	return true;
+}
+
+bool Benchmark::takeReload() {
+	bool isReloadRequested = _isReloadRequested;
+	_isReloadRequested = false;
+
+	return isReloadRequested;
+}
+
+bool Benchmark::isWritten() const {
+	return _isWritten;
+}
+
+bool Benchmark::isRegressed() const {
+	for (const BenchmarkComparison &comparison : _comparisons)
+		if (comparison.verdict == BenchmarkVerdict::Slower)
+			return true;
+
+	return false;
+}
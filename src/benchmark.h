@@ -0,0 +1,103 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark_samples.h"
+#include "camera_controller.h"
+#include "camera_path.h"
+#include "rendering/bound_analyzer.h"
+
+// step camera path advances per frame, so every run renders the same views
+const float BENCHMARK_TIME_STEP = 1.0f / 60.0f;
+
+// frames rendered after loading before measuring, pipelines and caches settle meanwhile
+const uint32_t BENCHMARK_WARMUP_FRAMES = 120;
+
+// Flies camera along a recorded path once scene has loaded, measures frame times over a fixed
+// number of frames and writes percentiles, load times and memory peaks as JSON. Runs after the
+// first load scene anew. Every sample goes into JSON as well, so a result can be the baseline
+// of later ones, frame times, CPU zones and GPU passes per frame and load time per run are
+// compared with it and sets that got slower are reported.
+class Benchmark {
+private:
+	enum class Stage {
+		Loading,
+		Warmup,
+		Measuring,
+		Done,
+	};
+
+	typedef struct {
+		std::string name;
+		double milliseconds;
+	} LoadZone;
+
+	Stage _stage = Stage::Loading;
+
+	CameraPath _path;
+	std::string _scene;
+	std::string _output;
+	uint32_t _frameCount = 0;
+	uint32_t _warmupFrameCount = BENCHMARK_WARMUP_FRAMES;
+	uint32_t _frame = 0;
+	uint32_t _runCount = 1;
+	uint32_t _run = 0;
+	bool _isReloadRequested = false;
+
+	uint64_t _start = 0;
+	uint64_t _frameBegin = 0;
+	uint64_t _lastFrameEnd = 0;
+
+	// summed over runs, zone totals of profiler when run began
+	double _loadMilliseconds = 0.0;
+	std::vector<LoadZone> _loadZones;
+	std::vector<LoadZone> _runZoneTotals;
+
+	// per measured frame, between two frame ends, of work done by CPU and of GPU commands
+	std::vector<float> _frameTimes;
+	std::vector<float> _cpuTimes;
+	std::vector<float> _gpuTimes;
+	// classified frames in flight late, measured ones that were classified until run ends
+	std::vector<FrameBoundSample> _bounds;
+
+	BenchmarkSamples _samples;
+
+	std::string _baselineFile;
+	BenchmarkSamples _baseline;
+	float _threshold = BENCHMARK_DEFAULT_THRESHOLD;
+	std::vector<BenchmarkComparison> _comparisons;
+
+	bool _isWritten = false;
+
+	void _loadEnd(uint64_t end);
+	void _measure(uint64_t end, uint64_t frameTicks);
+	// logs sets that changed, before result is written
+	void _compare();
+	bool _write() const;
+
+public:
+	// without camera path camera is left to caller, like replayed call log
+	bool initialize(const char *pScene, const char *pCameraPath, uint32_t frameCount,
+			const char *pOutput, uint32_t warmupFrameCount = BENCHMARK_WARMUP_FRAMES);
+	// load times get enough samples to be compared from about 5 runs on
+	void setRunCount(uint32_t runCount);
+	// result of an earlier run, threshold is fraction of its medians, false when file has no
+	// samples
+	bool setBaseline(const char *pFile, float threshold = BENCHMARK_DEFAULT_THRESHOLD);
+
+	// before scene is updated and drawn, poses camera
+	void frameBegin(CameraController &camera);
+	// after frame is drawn, returns false once benchmark is done
+	bool frameEnd(bool isLoading);
+	// true once after every run but last, caller loads scene anew before next frame
+	bool takeReload();
+
+	bool isWritten() const;
+	// some set is slower than in baseline
+	bool isRegressed() const;
+};
+
+#endif // !BENCHMARK_H
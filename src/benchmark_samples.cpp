@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "benchmark_samples.h"
+
+BenchmarkSamples::Set *BenchmarkSamples::_find(const std::string &name) {
+	for (Set &set : _sets)
+		if (set.name == name)
+			return &set;
+
+	return nullptr;
+}
+
+const BenchmarkSamples::Set *BenchmarkSamples::_find(const std::string &name) const {
+	for (const Set &set : _sets)
+		if (set.name == name)
+			return &set;
+
+	return nullptr;
+}
+
+double BenchmarkSamples::_mannWhitney(const std::vector<float> &a, const std::vector<float> &b) {
+	if (a.empty() || b.empty())
+		return 1.0;
+
+	// value and whether it came from a
+	std::vector<std::pair<float, bool>> values;
+	values.reserve(a.size() + b.size());
+
+	for (float value : a)
+		values.push_back({ value, true });
+
+	for (float value : b)
+		values.push_back({ value, false });
+
+	std::sort(values.begin(), values.end(),
+			[](const auto &x, const auto &y) { return x.first < y.first; });
+
+	// ties share mean of ranks they span
+	double rankSum = 0.0;
+	double tieSum = 0.0;
+
+	for (size_t i = 0; i < values.size();) {
+		size_t end = i;
+
+		while (end < values.size() && values[end].first == values[i].first)
+			end++;
+
+		double rank = (i + 1 + end) * 0.5;
+		double tieCount = static_cast<double>(end - i);
+		tieSum += tieCount * tieCount * tieCount - tieCount;
+
+		for (size_t j = i; j < end; j++)
+			if (values[j].second)
+				rankSum += rank;
+
+		i = end;
+	}
+
+	double n1 = static_cast<double>(a.size());
+	double n2 = static_cast<double>(b.size());
+	double n = n1 + n2;
+
+	double u = rankSum - n1 * (n1 + 1.0) * 0.5;
+	double mean = n1 * n2 * 0.5;
+	double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieSum / (n * (n - 1.0)));
+
+	// every value is the same
+	if (variance <= 0.0)
+		return 1.0;
+
+	// continuity correction towards mean
+	double z = std::max(std::abs(u - mean) - 0.5, 0.0) / std::sqrt(variance);
+
+	return std::erfc(z / std::sqrt(2.0));
+}
+
+float BenchmarkSamples::median(std::vector<float> values) {
+	if (values.empty())
+		return 0.0f;
+
+	size_t middle = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + middle, values.end());
+
+	if (values.size() % 2 == 1)
+		return values[middle];
+
+	float upper = values[middle];
+	float lower = *std::max_element(values.begin(), values.begin() + middle);
+
+	return (lower + upper) * 0.5f;
+}
+
+const char *BenchmarkSamples::getVerdictName(BenchmarkVerdict verdict) {
+	switch (verdict) {
+		case BenchmarkVerdict::Faster:
+			return "faster";
+		case BenchmarkVerdict::Slower:
+			return "slower";
+		default:
+			return "unchanged";
+	}
+}
+
+void BenchmarkSamples::add(const std::string &name, float value) {
+	Set *pSet = _find(name);
+
+	if (pSet == nullptr) {
+		_sets.push_back({ name, {} });
+		pSet = &_sets.back();
+	}
+
+	pSet->values.push_back(value);
+}
+
+bool BenchmarkSamples::isEmpty() const {
+	return _sets.empty();
+}
+
+void BenchmarkSamples::write(SDL_IOStream *pStream) const {
+	SDL_IOprintf(pStream, "\t\"samples\": {");
+
+	for (size_t i = 0; i < _sets.size(); i++) {
+		SDL_IOprintf(pStream, "%s\n\t\t\"", i == 0 ? "" : ",");
+
+		for (char c : _sets[i].name) {
+			if (c == '"' || c == '\\')
+				SDL_IOprintf(pStream, "\\%c", c);
+			else if (static_cast<unsigned char>(c) >= 0x20)
+				SDL_IOprintf(pStream, "%c", c);
+		}
+
+		SDL_IOprintf(pStream, "\": [");
+
+		for (size_t j = 0; j < _sets[i].values.size(); j++)
+			SDL_IOprintf(pStream, "%s%.7g", j == 0 ? "" : ", ", _sets[i].values[j]);
+
+		SDL_IOprintf(pStream, "]");
+	}
+
+	SDL_IOprintf(pStream, "\n\t}");
+}
+
+bool BenchmarkSamples::load(const char *pFile) {
+	size_t size;
+	char *pData = static_cast<char *>(SDL_LoadFile(pFile, &size));
+
+	if (pData == nullptr)
+		return false;
+
+	// loaded file is null terminated
+	const char *pCursor = strstr(pData, "\"samples\"");
+	bool isValid = pCursor != nullptr;
+
+	auto skipSpace = [&]() {
+		while (isspace(static_cast<unsigned char>(*pCursor)))
+			pCursor++;
+	};
+
+	// has to come next, skipping spaces before it
+	auto expect = [&](char c) {
+		skipSpace();
+
+		if (*pCursor != c)
+			return false;
+
+		pCursor++;
+		return true;
+	};
+
+	if (isValid) {
+		pCursor += strlen("\"samples\"");
+		isValid = expect(':') && expect('{');
+	}
+
+	_sets.clear();
+
+	while (isValid && !expect('}')) {
+		if (!_sets.empty() && !expect(',')) {
+			isValid = false;
+			break;
+		}
+
+		std::string name;
+		isValid = expect('"');
+
+		while (isValid && *pCursor != '"') {
+			if (*pCursor == '\\')
+				pCursor++;
+
+			if (*pCursor == '\0') {
+				isValid = false;
+				break;
+			}
+
+			name.push_back(*pCursor++);
+		}
+
+		isValid = isValid && expect('"') && expect(':') && expect('[');
+
+		// empty sets are never written
+		_sets.push_back({ name, {} });
+
+		while (isValid && !expect(']')) {
+			if (!_sets.back().values.empty() && !expect(',')) {
+				isValid = false;
+				break;
+			}
+
+			char *pEnd;
+			float value = strtof(pCursor, &pEnd);
+
+			isValid = pEnd != pCursor;
+			pCursor = pEnd;
+
+			_sets.back().values.push_back(value);
+		}
+	}
+
+	SDL_free(pData);
+
+	if (!isValid)
+		_sets.clear();
+
+	return isValid;
+}
+
+std::vector<BenchmarkComparison> BenchmarkSamples::compare(
+		const BenchmarkSamples &baseline, float threshold, float minDifference) const {
+	std::vector<BenchmarkComparison> comparisons;
+
+	for (const Set &set : _sets) {
+		const Set *pBaseline = baseline._find(set.name);
+
+		if (pBaseline == nullptr || pBaseline->values.empty() || set.values.empty())
+			continue;
+
+		BenchmarkComparison comparison;
+		comparison.name = set.name;
+		comparison.baselineMedian = median(pBaseline->values);
+		comparison.median = median(set.values);
+		comparison.pValue = _mannWhitney(set.values, pBaseline->values);
+
+		float difference = comparison.median - comparison.baselineMedian;
+
+		if (comparison.baselineMedian > 0.0f)
+			comparison.change = difference / comparison.baselineMedian;
+
+		bool isChanged = comparison.pValue < BENCHMARK_SIGNIFICANCE &&
+				std::abs(comparison.change) > threshold && std::abs(difference) > minDifference;
+
+		if (isChanged)
+			comparison.verdict =
+					difference > 0.0f ? BenchmarkVerdict::Slower : BenchmarkVerdict::Faster;
+
+		comparisons.push_back(comparison);
+	}
+
+	return comparisons;
+}
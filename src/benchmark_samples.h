@@ -0,0 +1,70 @@
+#ifndef BENCHMARK_SAMPLES_H
+#define BENCHMARK_SAMPLES_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+
+// change of median to count as regression or improvement, as fraction of baseline median
+const float BENCHMARK_DEFAULT_THRESHOLD = 0.05f;
+// two sided p-value distributions have to differ with
+const double BENCHMARK_SIGNIFICANCE = 0.01;
+
+enum class BenchmarkVerdict {
+	Unchanged,
+	Faster,
+	Slower,
+};
+
+// baseline against current samples of one set
+struct BenchmarkComparison {
+	std::string name;
+	float baselineMedian = 0.0f;
+	float median = 0.0f;
+	// of median, relative to baseline one
+	float change = 0.0f;
+	double pValue = 1.0;
+	BenchmarkVerdict verdict = BenchmarkVerdict::Unchanged;
+};
+
+// Named sets of timings where lower is better, written into benchmark results and read back
+// from them as baseline. Sets are compared with Mann-Whitney U test, which makes no assumption
+// about shape of distribution, frame times have long tails. Samples of consecutive frames are
+// not independent, so p-values come out lower than they are, threshold on median guards it.
+class BenchmarkSamples {
+private:
+	typedef struct {
+		std::string name;
+		std::vector<float> values;
+	} Set;
+
+	std::vector<Set> _sets;
+
+	Set *_find(const std::string &name);
+	const Set *_find(const std::string &name) const;
+
+	// normal approximation with tie correction
+	static double _mannWhitney(const std::vector<float> &a, const std::vector<float> &b);
+
+public:
+	static float median(std::vector<float> values);
+	static const char *getVerdictName(BenchmarkVerdict verdict);
+
+	// set is created on first value, sets keep order they were created in
+	void add(const std::string &name, float value);
+	bool isEmpty() const;
+
+	// "samples" member of JSON object, no comma follows
+	void write(SDL_IOStream *pStream) const;
+	// reads "samples" member of JSON written by write, false when file has none
+	bool load(const char *pFile);
+
+	// sets in both, slower or faster when median changed by more than threshold and by more
+	// than minDifference, in unit of samples, and test finds distributions different
+	std::vector<BenchmarkComparison> compare(
+			const BenchmarkSamples &baseline, float threshold, float minDifference = 0.0f) const;
+};
+
+#endif // !BENCHMARK_SAMPLES_H
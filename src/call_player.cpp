@@ -0,0 +1,695 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include "io/image.h"
+#include "io/light_probes.h"
+#include "io/mesh.h"
+#include "rendering/rendering_server.h"
+
+#include "call_player.h"
+
+typedef CallRecorder::Op Op;
+
+// arguments of one record or bytes of one payload, every read fails once they are exhausted
+struct ArgReader {
+	const uint8_t *pData;
+	size_t size;
+	size_t offset = 0;
+	bool isValid = true;
+
+	template <typename T> T read() {
+		T value = {};
+
+		if (size - offset < sizeof(T)) {
+			isValid = false;
+			return value;
+		}
+
+		memcpy(&value, pData + offset, sizeof(T));
+		offset += sizeof(T);
+
+		return value;
+	}
+
+	template <typename T> std::vector<T> read(uint32_t count) {
+		std::vector<T> values;
+
+		if ((size - offset) / sizeof(T) < count) {
+			isValid = false;
+			return values;
+		}
+
+		values.resize(count);
+
+		if (count > 0)
+			memcpy(values.data(), pData + offset, sizeof(T) * count);
+
+		offset += sizeof(T) * count;
+		return values;
+	}
+
+	// count first, like vectors recorder packs
+	template <typename T> std::vector<T> readArray() {
+		uint32_t count = read<uint32_t>();
+		return isValid ? read<T>(count) : std::vector<T>();
+	}
+
+	// isValid only holds once every argument was read
+	bool isDone() const {
+		return isValid && offset == size;
+	}
+};
+
+// arrays of mesh point into it until meshCreate returns
+typedef struct {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Meshlet> meshlets;
+	std::vector<std::vector<uint32_t>> lodIndices;
+	std::vector<Lod> lods;
+	std::vector<std::vector<MorphDelta>> morphDeltas;
+	std::vector<MorphTarget> morphTargets;
+} PrimitiveData;
+
+static bool _readMesh(ArgReader &payload, const std::vector<ObjectID> &materials,
+		std::vector<PrimitiveData> &data, std::vector<Primitive> &primitives, std::string &name) {
+	uint32_t primitiveCount = payload.read<uint32_t>();
+	std::vector<char> nameChars = payload.readArray<char>();
+
+	if (!payload.isValid || primitiveCount != materials.size())
+		return false;
+
+	name.assign(nameChars.begin(), nameChars.end());
+
+	data.resize(primitiveCount);
+	primitives.resize(primitiveCount);
+
+	for (uint32_t i = 0; i < primitiveCount && payload.isValid; i++) {
+		std::vector<uint32_t> counts = payload.read<uint32_t>(4);
+
+		if (!payload.isValid)
+			return false;
+
+		PrimitiveData &primitiveData = data[i];
+		primitiveData.vertices = payload.read<Vertex>(counts[0]);
+		primitiveData.indices = payload.read<uint32_t>(counts[1]);
+		primitiveData.meshlets = payload.read<Meshlet>(counts[2]);
+
+		for (uint32_t j = 0; j < counts[3] && payload.isValid; j++) {
+			float error = payload.read<float>();
+			primitiveData.lodIndices.push_back(payload.readArray<uint32_t>());
+			primitiveData.lods.push_back({ {}, error });
+		}
+
+		for (uint32_t j = 0; j < primitiveData.lods.size(); j++) {
+			std::vector<uint32_t> &indices = primitiveData.lodIndices[j];
+			primitiveData.lods[j].indices = { indices.data(),
+				static_cast<uint32_t>(indices.size()) };
+		}
+
+		uint32_t targetCount = payload.read<uint32_t>();
+
+		for (uint32_t j = 0; j < targetCount && payload.isValid; j++)
+			primitiveData.morphDeltas.push_back(payload.readArray<MorphDelta>());
+
+		for (std::vector<MorphDelta> &deltas : primitiveData.morphDeltas)
+			primitiveData.morphTargets.push_back(
+					{ deltas.data(), static_cast<uint32_t>(deltas.size()) });
+
+		Primitive &primitive = primitives[i];
+		primitive.vertices = { primitiveData.vertices.data(),
+			static_cast<uint32_t>(primitiveData.vertices.size()) };
+		primitive.indices = { primitiveData.indices.data(),
+			static_cast<uint32_t>(primitiveData.indices.size()) };
+		primitive.materialIndex = materials[i];
+		primitive.meshlets = { primitiveData.meshlets.data(),
+			static_cast<uint32_t>(primitiveData.meshlets.size()) };
+		primitive.lods = { primitiveData.lods.data(),
+			static_cast<uint32_t>(primitiveData.lods.size()) };
+		primitive.morphTargets = { primitiveData.morphTargets.data(),
+			static_cast<uint32_t>(primitiveData.morphTargets.size()) };
+	}
+
+	return payload.isDone();
+}
+
+static std::shared_ptr<Image> _readImage(ArgReader &payload) {
+	std::vector<uint32_t> properties = payload.read<uint32_t>(5);
+
+	if (!payload.isValid)
+		return nullptr;
+
+	std::vector<uint8_t> data = payload.read<uint8_t>(
+			static_cast<uint32_t>(payload.size - payload.offset));
+
+	std::shared_ptr<Image> image = std::make_shared<Image>(properties[0], properties[1],
+			static_cast<Image::Format>(properties[2]), std::move(data), properties[3]);
+	image->setSrgb(properties[4] != 0);
+
+	return image;
+}
+
+static bool _readLightProbes(ArgReader &payload, LightProbeGrid &grid) {
+	grid.origin = payload.read<glm::vec3>();
+	grid.spacing = payload.read<glm::vec3>();
+	grid.counts = payload.read<glm::uvec3>();
+
+	if (!payload.isValid)
+		return false;
+
+	size_t probeCount = (payload.size - payload.offset) / sizeof(glm::vec4);
+	grid.probes = payload.read<glm::vec4>(static_cast<uint32_t>(probeCount));
+
+	return payload.isDone();
+}
+
+static bool _readCellPortals(ArgReader &payload, CellPortalGraph &graph) {
+	std::vector<uint32_t> counts = payload.read<uint32_t>(3);
+
+	if (!payload.isValid)
+		return false;
+
+	graph.cells = payload.read<CellPortalGraph::Cell>(counts[0]);
+	graph.portals = payload.read<CellPortalGraph::Portal>(counts[1]);
+	graph.pvsWordCount = counts[2];
+
+	size_t pvsSize = (payload.size - payload.offset) / sizeof(uint64_t);
+	graph.pvs = payload.read<uint64_t>(static_cast<uint32_t>(pvsSize));
+
+	return payload.isDone();
+}
+
+ObjectID CallPlayer::_toObject(ObjectID recorded) const {
+	auto it = _objects.find(recorded);
+
+	// null handle and ids whose create failed stay invalid
+	return it != _objects.end() ? it->second : NULL_HANDLE;
+}
+
+bool CallPlayer::_run(Op op, const uint8_t *pArgs, size_t size, uint64_t &time) {
+	RS &rs = RS::getSingleton();
+	ArgReader args = { pArgs, size };
+
+	// payload of hash read from arguments, invalid reader when log lacks it
+	auto readPayload = [&]() {
+		uint64_t hash = args.read<uint64_t>();
+		auto it = _payloads.find(hash);
+
+		if (it == _payloads.end())
+			return ArgReader{ nullptr, 0, 0, false };
+
+		return ArgReader{ _file.getData() + it->second.offset, it->second.size };
+	};
+
+	auto readMaterialInfo = [&]() {
+		RS::MaterialInfo info = args.read<RS::MaterialInfo>();
+
+		info.albedo = _toObject(info.albedo);
+		info.normal = _toObject(info.normal);
+		info.metallicRoughness = _toObject(info.metallicRoughness);
+		info.lightmap = _toObject(info.lightmap);
+
+		return info;
+	};
+
+	auto readObjects = [&]() {
+		std::vector<ObjectID> objects = args.readArray<ObjectID>();
+
+		for (ObjectID &object : objects)
+			object = _toObject(object);
+
+		return objects;
+	};
+
+	switch (op) {
+		case Op::Payload:
+			return true;
+		case Op::Draw:
+			time = args.read<uint64_t>();
+			break;
+		case Op::CameraSetTransform:
+			rs.cameraSetTransform(args.read<glm::mat4>());
+			break;
+		case Op::CameraSetFovY:
+			rs.cameraSetFovY(args.read<float>());
+			break;
+		case Op::CameraSetZNear:
+			rs.cameraSetZNear(args.read<float>());
+			break;
+		case Op::CameraSetZFar:
+			rs.cameraSetZFar(args.read<float>());
+			break;
+		case Op::MeshCreate: {
+			ObjectID id = args.read<ObjectID>();
+			ArgReader payload = readPayload();
+			std::vector<ObjectID> materials = readObjects();
+
+			std::vector<PrimitiveData> data;
+			std::vector<Primitive> primitives;
+			std::string name;
+
+			if (!args.isValid || !payload.isValid ||
+					!_readMesh(payload, materials, data, primitives, name))
+				return false;
+
+			Mesh mesh = { primitives.data(), static_cast<uint32_t>(primitives.size()),
+				name.c_str() };
+
+			_objects[id] = rs.meshCreate(mesh);
+			break;
+		}
+		case Op::MeshUpdate: {
+			ObjectID id = args.read<ObjectID>();
+			ArgReader payload = readPayload();
+			std::vector<ObjectID> materials = readObjects();
+
+			std::vector<PrimitiveData> data;
+			std::vector<Primitive> primitives;
+			std::string name;
+
+			if (!args.isValid || !payload.isValid ||
+					!_readMesh(payload, materials, data, primitives, name))
+				return false;
+
+			Mesh mesh = { primitives.data(), static_cast<uint32_t>(primitives.size()),
+				name.c_str() };
+
+			rs.meshUpdate(_toObject(id), mesh);
+			break;
+		}
+		case Op::MeshFree: {
+			ObjectID id = args.read<ObjectID>();
+			rs.meshFree(_toObject(id));
+			_objects.erase(id);
+			break;
+		}
+		case Op::MeshInstanceCreate:
+			_objects[args.read<ObjectID>()] = rs.meshInstanceCreate();
+			break;
+		case Op::MeshInstanceCreateBatch: {
+			std::vector<ObjectID> ids = args.readArray<ObjectID>();
+			std::vector<ObjectID> meshInstances =
+					rs.meshInstanceCreateBatch(static_cast<uint32_t>(ids.size()));
+
+			for (size_t i = 0; i < ids.size(); i++)
+				_objects[ids[i]] = meshInstances[i];
+
+			break;
+		}
+		case Op::MeshInstanceSetMesh: {
+			ObjectID meshInstance = _toObject(args.read<ObjectID>());
+			rs.meshInstanceSetMesh(meshInstance, _toObject(args.read<ObjectID>()));
+			break;
+		}
+		case Op::MeshInstanceSetTransform: {
+			ObjectID meshInstance = _toObject(args.read<ObjectID>());
+			rs.meshInstanceSetTransform(meshInstance, args.read<glm::mat4>());
+			break;
+		}
+		case Op::MeshInstanceSetTransforms: {
+			std::vector<ObjectID> meshInstances = readObjects();
+			rs.meshInstanceSetTransforms(meshInstances, args.readArray<glm::mat4>());
+			break;
+		}
+		case Op::MeshInstanceSetJoints: {
+			ObjectID meshInstance = _toObject(args.read<ObjectID>());
+			rs.meshInstanceSetJoints(meshInstance, args.readArray<glm::mat4>());
+			break;
+		}
+		case Op::MeshInstanceSetMorphWeights: {
+			ObjectID meshInstance = _toObject(args.read<ObjectID>());
+			rs.meshInstanceSetMorphWeights(meshInstance, args.readArray<float>());
+			break;
+		}
+		case Op::MeshInstanceFree: {
+			ObjectID id = args.read<ObjectID>();
+			rs.meshInstanceFree(_toObject(id));
+			_objects.erase(id);
+			break;
+		}
+		case Op::LightCreate: {
+			ObjectID id = args.read<ObjectID>();
+			_objects[id] = rs.lightCreate(args.read<LightType>());
+			break;
+		}
+		case Op::LightSetTransform: {
+			ObjectID light = _toObject(args.read<ObjectID>());
+			rs.lightSetTransform(light, args.read<glm::mat4>());
+			break;
+		}
+		case Op::LightSetTransforms: {
+			std::vector<ObjectID> lights = readObjects();
+			rs.lightSetTransforms(lights, args.readArray<glm::mat4>());
+			break;
+		}
+		case Op::LightSetRange: {
+			ObjectID light = _toObject(args.read<ObjectID>());
+			rs.lightSetRange(light, args.read<float>());
+			break;
+		}
+		case Op::LightSetColor: {
+			ObjectID light = _toObject(args.read<ObjectID>());
+			rs.lightSetColor(light, args.read<glm::vec3>());
+			break;
+		}
+		case Op::LightSetIntensity: {
+			ObjectID light = _toObject(args.read<ObjectID>());
+			rs.lightSetIntensity(light, args.read<float>());
+			break;
+		}
+		case Op::LightSetDrawDistance: {
+			ObjectID light = _toObject(args.read<ObjectID>());
+			rs.lightSetDrawDistance(light, args.read<float>());
+			break;
+		}
+		case Op::LightSetShadow: {
+			ObjectID light = _toObject(args.read<ObjectID>());
+			rs.lightSetShadow(light, args.read<bool>());
+			break;
+		}
+		case Op::LightSetBaked: {
+			ObjectID light = _toObject(args.read<ObjectID>());
+			rs.lightSetBaked(light, args.read<bool>());
+			break;
+		}
+		case Op::LightFree: {
+			ObjectID id = args.read<ObjectID>();
+			rs.lightFree(_toObject(id));
+			_objects.erase(id);
+			break;
+		}
+		case Op::ParticleEmitterCreate: {
+			ObjectID id = args.read<ObjectID>();
+			_objects[id] = rs.particleEmitterCreate();
+			break;
+		}
+		case Op::ParticleEmitterSetMesh: {
+			ObjectID emitter = _toObject(args.read<ObjectID>());
+			rs.particleEmitterSetMesh(emitter, _toObject(args.read<ObjectID>()));
+			break;
+		}
+		case Op::ParticleEmitterSetTransform: {
+			ObjectID emitter = _toObject(args.read<ObjectID>());
+			rs.particleEmitterSetTransform(emitter, args.read<glm::mat4>());
+			break;
+		}
+		case Op::ParticleEmitterSetInfo: {
+			ObjectID emitter = _toObject(args.read<ObjectID>());
+			rs.particleEmitterSetInfo(emitter, args.read<RS::ParticleEmitterInfo>());
+			break;
+		}
+		case Op::ParticleEmitterFree: {
+			ObjectID id = args.read<ObjectID>();
+			rs.particleEmitterFree(_toObject(id));
+			_objects.erase(id);
+			break;
+		}
+		case Op::TextureCreate: {
+			ObjectID id = args.read<ObjectID>();
+			ArgReader payload = readPayload();
+
+			// null image was recorded with hash 0
+			std::shared_ptr<Image> image = payload.isValid ? _readImage(payload) : nullptr;
+			_objects[id] = rs.textureCreate(image);
+			break;
+		}
+		case Op::TextureUpdate: {
+			ObjectID id = args.read<ObjectID>();
+			ArgReader payload = readPayload();
+
+			std::shared_ptr<Image> image = payload.isValid ? _readImage(payload) : nullptr;
+			rs.textureUpdate(_toObject(id), image);
+			break;
+		}
+		case Op::TextureFree: {
+			ObjectID id = args.read<ObjectID>();
+			rs.textureFree(_toObject(id));
+			_objects.erase(id);
+			break;
+		}
+		case Op::MaterialCreate: {
+			ObjectID id = args.read<ObjectID>();
+			RS::MaterialInfo info = readMaterialInfo();
+
+			if (!args.isValid)
+				return false;
+
+			_objects[id] = rs.materialCreate(info);
+			break;
+		}
+		case Op::MaterialUpdate: {
+			ObjectID material = _toObject(args.read<ObjectID>());
+			rs.materialUpdate(material, readMaterialInfo());
+			break;
+		}
+		case Op::MaterialFree: {
+			ObjectID id = args.read<ObjectID>();
+			rs.materialFree(_toObject(id));
+			_objects.erase(id);
+			break;
+		}
+		case Op::SetExposure:
+			rs.setExposure(args.read<float>());
+			break;
+		case Op::SetAutoExposure:
+			rs.setAutoExposure(args.read<bool>());
+			break;
+		case Op::SetWhite:
+			rs.setWhite(args.read<float>());
+			break;
+		case Op::SetTonemapLook:
+			rs.setTonemapLook(args.read<TonemapLook>());
+			break;
+		case Op::SetTonemapLut:
+			rs.setTonemapLut(args.read<bool>());
+			break;
+		case Op::SetSkyLod:
+			rs.setSkyLod(args.read<float>());
+			break;
+		case Op::SetUpscaleFilter:
+			rs.setUpscaleFilter(args.read<UpscaleFilter>());
+			break;
+		case Op::SetDebugView:
+			rs.setDebugView(args.read<DebugView>());
+			break;
+		case Op::SetRenderScale:
+			rs.setRenderScale(args.read<float>());
+			break;
+		case Op::SetQuality:
+			rs.setQuality(args.read<QualitySettings>());
+			break;
+		case Op::EnvironmentAtmosphereSet:
+			rs.environmentAtmosphereSet(args.read<Atmosphere>());
+			break;
+		case Op::ReflectionProbeSet: {
+			ArgReader payload = readPayload();
+			std::shared_ptr<Image> image = payload.isValid ? _readImage(payload) : nullptr;
+			uint32_t index = args.read<uint32_t>();
+			ReflectionProbe probe = args.read<ReflectionProbe>();
+
+			rs.reflectionProbeSet(index, probe, image);
+			break;
+		}
+		case Op::TerrainSet: {
+			ArgReader heightmapPayload = readPayload();
+			std::shared_ptr<Image> heightmap =
+					heightmapPayload.isValid ? _readImage(heightmapPayload) : nullptr;
+			ArgReader splatmapPayload = readPayload();
+			std::shared_ptr<Image> splatmap =
+					splatmapPayload.isValid ? _readImage(splatmapPayload) : nullptr;
+
+			rs.terrainSet(args.read<Terrain>(), heightmap, splatmap);
+			break;
+		}
+		case Op::TerrainLayerSet: {
+			ArgReader payload = readPayload();
+			std::shared_ptr<Image> image = payload.isValid ? _readImage(payload) : nullptr;
+
+			rs.terrainLayerSet(args.read<uint32_t>(), image);
+			break;
+		}
+		case Op::EnvironmentSkyUpdate: {
+			ArgReader payload = readPayload();
+			std::shared_ptr<Image> image = payload.isValid ? _readImage(payload) : nullptr;
+			bool isProgressive = args.read<bool>();
+
+			if (image == nullptr)
+				return false;
+
+			rs.environmentSkyUpdate(image, isProgressive);
+			break;
+		}
+		case Op::EnvironmentSetSpecularSampleCount: {
+			uint32_t level = args.read<uint32_t>();
+			rs.environmentSetSpecularSampleCount(level, args.read<uint32_t>());
+			break;
+		}
+		case Op::EnvironmentSetMaxCubemapSize:
+			rs.environmentSetMaxCubemapSize(args.read<uint32_t>());
+			break;
+		case Op::LightProbesSet: {
+			ArgReader payload = readPayload();
+			LightProbeGrid grid;
+
+			if (!payload.isValid || !_readLightProbes(payload, grid))
+				return false;
+
+			rs.lightProbesSet(grid);
+			break;
+		}
+		case Op::CellPortalsSet: {
+			ArgReader payload = readPayload();
+			CellPortalGraph graph;
+
+			if (!payload.isValid || !_readCellPortals(payload, graph))
+				return false;
+
+			rs.cellPortalsSet(graph);
+			break;
+		}
+		case Op::DefragmentationStart:
+			rs.defragmentationStart();
+			break;
+		case Op::ViewSetCount:
+			rs.viewSetCount(args.read<uint32_t>());
+			break;
+		case Op::ViewSetRect: {
+			uint32_t view = args.read<uint32_t>();
+			rs.viewSetRect(view, args.read<glm::vec4>());
+			break;
+		}
+		case Op::ViewSetTransform: {
+			uint32_t view = args.read<uint32_t>();
+			rs.viewSetTransform(view, args.read<glm::mat4>());
+			break;
+		}
+		case Op::ViewSetFovY: {
+			uint32_t view = args.read<uint32_t>();
+			rs.viewSetFovY(view, args.read<float>());
+			break;
+		}
+		default:
+			return false;
+	}
+
+	// calls made with arguments read past record were made with zeros, log is corrupt
+	return args.isDone();
+}
+
+bool CallPlayer::load(const char *pFile, bool isTimed) {
+	if (!_file.open(pFile)) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Call log %s can not be read!", pFile);
+		return false;
+	}
+
+	const uint8_t *pData = _file.getData();
+	size_t size = _file.getSize();
+
+	CallRecorder::Header header;
+	bool isValid = size >= sizeof(CallRecorder::Header);
+
+	if (isValid) {
+		memcpy(&header, pData, sizeof(CallRecorder::Header));
+		isValid = memcmp(header.magic, CALL_LOG_MAGIC, sizeof(CALL_LOG_MAGIC)) == 0 &&
+				header.version == CALL_LOG_VERSION;
+	}
+
+	if (!isValid) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s is not a call log of this version!", pFile);
+		return false;
+	}
+
+	// payloads are looked up by hash while replaying, frames are counted for benchmarks
+	size_t offset = sizeof(CallRecorder::Header);
+
+	while (size - offset >= sizeof(CallRecorder::Record)) {
+		CallRecorder::Record record;
+		memcpy(&record, pData + offset, sizeof(CallRecorder::Record));
+
+		size_t argsOffset = offset + sizeof(CallRecorder::Record);
+
+		// log of crashed session ends within a record
+		if (size - argsOffset < record.size)
+			break;
+
+		if (record.op == static_cast<uint32_t>(Op::Payload) && record.size >= sizeof(uint64_t)) {
+			uint64_t hash;
+			memcpy(&hash, pData + argsOffset, sizeof(uint64_t));
+
+			_payloads[hash] = { argsOffset + sizeof(uint64_t), record.size - sizeof(uint64_t) };
+		}
+
+		if (record.op == static_cast<uint32_t>(Op::Draw))
+			_frameCount++;
+
+		offset = argsOffset + record.size;
+	}
+
+	_offset = sizeof(CallRecorder::Header);
+	_isTimed = isTimed;
+
+	SDL_Log("Replaying %u frames of %s%s", _frameCount, pFile,
+			isTimed ? " at recorded timing" : "");
+	return true;
+}
+
+bool CallPlayer::frameBegin() {
+	if (_frame >= _frameCount)
+		return false;
+
+	const uint8_t *pData = _file.getData();
+	size_t size = _file.getSize();
+
+	// calls of frame are made by the time its draw is reached
+	uint64_t time = UINT64_MAX;
+
+	while (time == UINT64_MAX && size - _offset >= sizeof(CallRecorder::Record)) {
+		CallRecorder::Record record;
+		memcpy(&record, pData + _offset, sizeof(CallRecorder::Record));
+
+		const uint8_t *pArgs = pData + _offset + sizeof(CallRecorder::Record);
+
+		// frames were counted up to last whole record
+		if (size - _offset - sizeof(CallRecorder::Record) < record.size)
+			break;
+
+		_offset += sizeof(CallRecorder::Record) + record.size;
+
+		if (!_run(static_cast<Op>(record.op), pArgs, record.size, time)) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Call log is corrupt, replay stops!");
+			_frame = _frameCount;
+			return false;
+		}
+	}
+
+	if (time == UINT64_MAX) {
+		_frame = _frameCount;
+		return false;
+	}
+
+	// frame is drawn no earlier than it was when recorded, relative to first one
+	if (_isTimed) {
+		if (_frame == 0)
+			_start = SDL_GetTicksNS() - time;
+
+		uint64_t elapsed = SDL_GetTicksNS() - _start;
+
+		if (time > elapsed)
+			SDL_DelayNS(time - elapsed);
+	}
+
+	_frame++;
+	return true;
+}
+
+uint32_t CallPlayer::getFrameCount() const {
+	return _frameCount;
+}
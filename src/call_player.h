@@ -0,0 +1,50 @@
+#ifndef CALL_PLAYER_H
+#define CALL_PLAYER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "io/mapped_file.h"
+#include "rendering/call_recorder.h"
+
+// Replays call log written with --record-calls into rendering server. Ids of recorded objects
+// map to ones created during replay, every call runs on calling thread, so replays of one log
+// make the same calls in the same order whatever threads recording came from. Frames run as
+// fast as they are drawn, or with timing held until as much time passed since replay began as
+// did since recording began.
+class CallPlayer {
+private:
+	typedef struct {
+		size_t offset;
+		size_t size;
+	} Payload;
+
+	MappedFile _file;
+	size_t _offset = 0;
+
+	std::unordered_map<uint64_t, Payload> _payloads;
+	std::unordered_map<ObjectID, ObjectID> _objects;
+
+	bool _isTimed = false;
+	uint64_t _start = 0;
+
+	uint32_t _frameCount = 0;
+	uint32_t _frame = 0;
+
+	ObjectID _toObject(ObjectID recorded) const;
+
+	// false for malformed records, replay stops at them
+	bool _run(CallRecorder::Op op, const uint8_t *pArgs, size_t size, uint64_t &time);
+
+public:
+	// whole log is read, frames are counted
+	bool load(const char *pFile, bool isTimed);
+
+	// before frame is drawn, runs its calls up to its draw, false once log has ended
+	bool frameBegin();
+
+	uint32_t getFrameCount() const;
+};
+
+#endif // !CALL_PLAYER_H
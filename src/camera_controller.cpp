@@ -5,15 +5,21 @@
 #include <SDL3/SDL_mouse.h>
 
 #include "rendering/rendering_server.h"
+#include "profiler.h"
 
 #include "camera_controller.h"
 
 void CameraController::_update() {
-	_transform = glm::mat4(1.0f);
-	_transform = glm::translate(_transform, _translation);
-	_transform = glm::rotate(_transform, _rotation.x, glm::vec3(0.0, 1.0f, 0.0)); // rotate Y
-	_transform = glm::rotate(_transform, _rotation.y, glm::vec3(1.0f, 0.0, 0.0)); // rotate X
+	glm::mat4 transform = glm::mat4(1.0f);
+	transform = glm::translate(transform, _translation);
+	transform = glm::rotate(transform, _rotation.x, glm::vec3(0.0, 1.0f, 0.0)); // rotate Y
+	transform = glm::rotate(transform, _rotation.y, glm::vec3(1.0f, 0.0, 0.0)); // rotate X
 
+	// still camera is not sent, on demand drawing goes idle
+	if (transform == _transform)
+		return;
+
+	_transform = transform;
 	RS::getSingleton().cameraSetTransform(_transform);
 }
 
@@ -29,6 +35,17 @@ void CameraController::_move(const glm::vec2 &input) {
 }
 
 void CameraController::update(float deltaTime) {
+	PROFILE_ZONE("camera update");
+
+	if (_isRecording) {
+		_recordingTime += deltaTime;
+
+		if (_recordingTime - _lastKeyTime >= CAMERA_PATH_KEY_INTERVAL) {
+			_recording.add(_recordingTime, _translation, glm::vec2(_rotation));
+			_lastKeyTime = _recordingTime;
+		}
+	}
+
 	if (SDL_GetRelativeMouseMode() == false) {
 		_reset = true;
 		return;
@@ -57,6 +74,40 @@ void CameraController::update(float deltaTime) {
 	_move(velocity);
 }
 
+void CameraController::setPose(const glm::vec3 &translation, const glm::vec2 &rotation) {
+	_translation = translation;
+	_rotation = glm::vec3(rotation, 0.0f);
+	_update();
+}
+
+void CameraController::recordBegin() {
+	_recording.clear();
+	_recording.add(0.0f, _translation, glm::vec2(_rotation));
+
+	_isRecording = true;
+	_recordingTime = 0.0f;
+	_lastKeyTime = 0.0f;
+}
+
+bool CameraController::recordEnd(const char *pFile) {
+	if (!_isRecording)
+		return false;
+
+	// pose camera was left at ends path
+	_recording.add(_recordingTime, _translation, glm::vec2(_rotation));
+	_isRecording = false;
+
+	return _recording.save(pFile);
+}
+
+const glm::mat4 &CameraController::getTransform() const {
+	return _transform;
+}
+
+bool CameraController::isRecording() const {
+	return _isRecording;
+}
+
 CameraController::CameraController() {
 	_update();
 }
@@ -4,6 +4,8 @@
 #include <SDL3/SDL.h>
 #include <glm/glm.hpp>
 
+#include "camera_path.h"
+
 class CameraController {
 public:
 	const float SPEED = 3.0f;
@@ -15,12 +17,26 @@ private:
 	glm::vec3 _rotation = glm::vec3(0.0f);
 	glm::mat4 _transform = glm::mat4(1.0f);
 
+	CameraPath _recording;
+	bool _isRecording = false;
+	float _recordingTime = 0.0f;
+	float _lastKeyTime = 0.0f;
+
 	void _update();
 	void _rotate(const glm::vec2 &input);
 	void _move(const glm::vec2 &input);
 
 public:
 	void update(float deltaTime);
+	// played back camera, rotation is yaw and pitch
+	void setPose(const glm::vec3 &translation, const glm::vec2 &rotation);
+	// world transform last sent to RS
+	const glm::mat4 &getTransform() const;
+
+	// key is added every CAMERA_PATH_KEY_INTERVAL while camera is flown
+	void recordBegin();
+	bool recordEnd(const char *pFile);
+	bool isRecording() const;
 
 	CameraController();
 };
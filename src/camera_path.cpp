@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "camera_path.h"
+
+template <typename T>
+static T _catmullRom(const T &p0, const T &p1, const T &p2, const T &p3, float t) {
+	float t2 = t * t;
+	float t3 = t2 * t;
+
+	return 0.5f *
+			((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+					(3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+void CameraPath::add(float time, const glm::vec3 &translation, const glm::vec2 &rotation) {
+	_keys.push_back({ time, translation, rotation });
+}
+
+void CameraPath::clear() {
+	_keys.clear();
+}
+
+void CameraPath::sample(float time, glm::vec3 &translation, glm::vec2 &rotation) const {
+	if (_keys.empty())
+		return;
+
+	time += _keys.front().time;
+
+	// first key after time, ends are held
+	auto it = std::upper_bound(_keys.begin(), _keys.end(), time,
+			[](float time, const Key &key) { return time < key.time; });
+
+	if (it == _keys.begin() || it == _keys.end()) {
+		const Key &key = it == _keys.begin() ? _keys.front() : _keys.back();
+		translation = key.translation;
+		rotation = key.rotation;
+		return;
+	}
+
+	size_t i2 = static_cast<size_t>(it - _keys.begin());
+	size_t i1 = i2 - 1;
+	size_t i0 = i1 > 0 ? i1 - 1 : i1;
+	size_t i3 = std::min(i2 + 1, _keys.size() - 1);
+
+	const Key &k1 = _keys[i1];
+	const Key &k2 = _keys[i2];
+
+	float span = k2.time - k1.time;
+	float t = span > 0.0f ? (time - k1.time) / span : 0.0f;
+
+	translation = _catmullRom(_keys[i0].translation, k1.translation, k2.translation,
+			_keys[i3].translation, t);
+	rotation = _catmullRom(
+			_keys[i0].rotation, k1.rotation, k2.rotation, _keys[i3].rotation, t);
+}
+
+float CameraPath::getDuration() const {
+	return _keys.empty() ? 0.0f : _keys.back().time - _keys.front().time;
+}
+
+bool CameraPath::isEmpty() const {
+	return _keys.empty();
+}
+
+bool CameraPath::load(const char *pFile) {
+	size_t size;
+	char *pData = static_cast<char *>(SDL_LoadFile(pFile, &size));
+
+	if (pData == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Camera path %s can not be read!", pFile);
+		return false;
+	}
+
+	_keys.clear();
+
+	// loaded files are null terminated
+	const char *pLine = pData;
+
+	while (*pLine != '\0') {
+		Key key;
+
+		if (SDL_sscanf(pLine, "%f %f %f %f %f %f", &key.time, &key.translation.x,
+					&key.translation.y, &key.translation.z, &key.rotation.x,
+					&key.rotation.y) == 6 &&
+				(_keys.empty() || key.time >= _keys.back().time))
+			_keys.push_back(key);
+
+		const char *pEnd = SDL_strchr(pLine, '\n');
+		pLine = pEnd != nullptr ? pEnd + 1 : pLine + SDL_strlen(pLine);
+	}
+
+	SDL_free(pData);
+
+	if (_keys.empty()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Camera path %s has no keys!", pFile);
+		return false;
+	}
+
+	return true;
+}
+
+bool CameraPath::save(const char *pFile) const {
+	SDL_IOStream *pStream = SDL_IOFromFile(pFile, "w");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Camera path %s can not be written!", pFile);
+		return false;
+	}
+
+	SDL_IOprintf(pStream, "# time, translation, yaw and pitch\n");
+
+	for (const Key &key : _keys)
+		SDL_IOprintf(pStream, "%.4f %.6f %.6f %.6f %.6f %.6f\n", key.time, key.translation.x,
+				key.translation.y, key.translation.z, key.rotation.x, key.rotation.y);
+
+	return SDL_CloseIO(pStream);
+}
@@ -0,0 +1,37 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// seconds between keys recorded from camera controller
+const float CAMERA_PATH_KEY_INTERVAL = 0.1f;
+
+// Camera translation and rotation over time, played back along a Catmull-Rom spline through
+// the keys. Stored as text, a key per line of time, translation and yaw and pitch in radians.
+class CameraPath {
+private:
+	typedef struct {
+		float time;
+		glm::vec3 translation;
+		glm::vec2 rotation;
+	} Key;
+
+	std::vector<Key> _keys;
+
+public:
+	// keys have to be added in order of time
+	void add(float time, const glm::vec3 &translation, const glm::vec2 &rotation);
+	void clear();
+
+	// seconds since first key, clamped to path
+	void sample(float time, glm::vec3 &translation, glm::vec2 &rotation) const;
+	float getDuration() const;
+	bool isEmpty() const;
+
+	bool load(const char *pFile);
+	bool save(const char *pFile) const;
+};
+
+#endif // !CAMERA_PATH_H
@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_log.h>
+
+#include "io/image_writer.h"
+
+#include "capture_writer.h"
+
+void CaptureWriter::write(
+		const std::string &file, std::shared_ptr<Image> image, uint32_t width, uint32_t height) {
+	if (image == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Capture %s failed!", file.c_str());
+		_failedCount++;
+		return;
+	}
+
+	Write write;
+	write.file = file;
+	write.write = std::async(std::launch::async, [file, image, width, height]() {
+		bool isLarger = width != 0 && height != 0 &&
+				(image->getWidth() > width || image->getHeight() > height);
+
+		if (!isLarger)
+			return ImageWriter::save(file.c_str(), *image);
+
+		std::unique_ptr<Image> downscaled(image->getDownscaled(width, height));
+		return downscaled != nullptr && ImageWriter::save(file.c_str(), *downscaled);
+	});
+
+	_writes.push_back(std::move(write));
+}
+
+size_t CaptureWriter::collect() {
+	for (size_t i = 0; i < _writes.size();) {
+		Write &write = _writes[i];
+
+		if (write.write.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+
+		if (write.write.get()) {
+			_writtenCount++;
+			SDL_Log("Capture written to %s", write.file.c_str());
+		} else {
+			_failedCount++;
+		}
+
+		_writes.erase(_writes.begin() + i);
+	}
+
+	return _writes.size();
+}
+
+void CaptureWriter::wait() {
+	for (Write &write : _writes)
+		write.write.wait();
+
+	collect();
+}
+
+uint32_t CaptureWriter::getWrittenCount() const {
+	return _writtenCount;
+}
+
+uint32_t CaptureWriter::getFailedCount() const {
+	return _failedCount;
+}
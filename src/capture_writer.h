@@ -0,0 +1,40 @@
+#ifndef CAPTURE_WRITER_H
+#define CAPTURE_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io/image.h"
+
+// Encodes captured frames on background threads, EXR for .exr files and PNG otherwise, so
+// frames keep rendering while images are compressed and written.
+class CaptureWriter {
+private:
+	typedef struct {
+		std::string file;
+		std::future<bool> write;
+	} Write;
+
+	std::vector<Write> _writes;
+
+	uint32_t _writtenCount = 0;
+	uint32_t _failedCount = 0;
+
+public:
+	// null image counts as failed write, image larger than non-zero size is box filtered down to
+	// it on background thread too
+	void write(const std::string &file, std::shared_ptr<Image> image, uint32_t width = 0,
+			uint32_t height = 0);
+	// finished writes are logged, returns count of those still running
+	size_t collect();
+	void wait();
+
+	uint32_t getWrittenCount() const;
+	uint32_t getFailedCount() const;
+};
+
+#endif // !CAPTURE_WRITER_H
@@ -0,0 +1,59 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// keys of glTF channels are resampled at this rate, cubic splines are evaluated while doing so
+const float ANIMATION_SAMPLE_RATE = 30.0f;
+
+// target property without channel keeps rest pose
+const uint32_t ANIMATION_NO_CHANNEL = UINT32_MAX;
+
+// Node transforms of one glTF animation, resampled so every channel has a key on every frame.
+// Frame holds x of every translation channel, then y and z, then x, y, z and w of rotations,
+// then x, y and z of scales, so sampling blends two frames in one flat loop across all channels
+// and normalizes rotations in another, both vectorize. Rotations of consecutive frames lie in
+// one hemisphere, blending them needs no sign check.
+struct AnimationClip {
+	// node driven by channels, rest pose fills properties without one
+	typedef struct {
+		uint64_t node;
+
+		glm::vec3 translation;
+		glm::quat rotation;
+		glm::vec3 scale;
+
+		// within their block of frame, ANIMATION_NO_CHANNEL for rest pose
+		uint32_t translationChannel;
+		uint32_t rotationChannel;
+		uint32_t scaleChannel;
+		uint32_t _padding;
+	} Target;
+
+	std::string name;
+	// seconds, last frame lies on it
+	float duration = 0.0f;
+	uint32_t frameCount = 0;
+
+	uint32_t translationCount = 0;
+	uint32_t rotationCount = 0;
+	uint32_t scaleCount = 0;
+
+	std::vector<Target> targets;
+
+	// frameCount frames of getFrameSize floats
+	std::vector<float> samples;
+	// per float of frame, 0 for step channels, which hold value of earlier frame
+	std::vector<float> blendWeights;
+
+	uint32_t getFrameSize() const {
+		return translationCount * 3 + rotationCount * 4 + scaleCount * 3;
+	}
+};
+
+#endif // !ANIMATION_H
@@ -1,9 +1,19 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <map>
 #include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -16,12 +26,22 @@
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include <SDL3/SDL_log.h>
 
+#include <profiler.h>
+#include <job_system.h>
+
+#include "async_reader.h"
 #include "image_loader.h"
+#include "image_resampler.h"
+#include "mapped_file.h"
 #include "mesh.h"
+#include "mesh_optimizer.h"
+#include "meshopt_decoder.h"
+#include "package.h"
 
 #include "asset_loader.h"
 
@@ -29,6 +49,26 @@ const float CANDELA_TO_LUMEN = 12.5663706144; // PI * 4
 
 using namespace AssetLoader;
 
+// set before loads start, read by their jobs
+static std::atomic<uint32_t> _maxImageSize{ 0 };
+
+// one per distinct image and usage
+typedef struct {
+	size_t imageIndex;
+	ImageUsage usage;
+
+	std::shared_ptr<Image> image;
+	uint32_t sceneIndex;
+	// empty when image is not a file of its own
+	std::filesystem::path path;
+} ImageJob;
+
+typedef struct {
+	std::optional<size_t> albedoJob;
+	std::optional<size_t> normalJob;
+	std::optional<size_t> metallicRoughnessJob;
+} MaterialJobs;
+
 glm::mat4 _extractTransform(const fastgltf::Node &node, const glm::mat4 &base = glm::mat4(1.0f)) {
 	if (const fastgltf::Node::TransformMatrix *pMatrix =
 					std::get_if<fastgltf::Node::TransformMatrix>(&node.transform))
@@ -45,23 +85,306 @@ glm::mat4 _extractTransform(const fastgltf::Node &node, const glm::mat4 &base =
 	return base;
 }
 
+// TRS of node, matrices which do not decompose are identity
+void _extractRestPose(
+		const fastgltf::Node &node, glm::vec3 &translation, glm::quat &rotation, glm::vec3 &scale) {
+	translation = glm::vec3(0.0f);
+	rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	scale = glm::vec3(1.0f);
+
+	if (const fastgltf::TRS *pTransform = std::get_if<fastgltf::TRS>(&node.transform)) {
+		translation = glm::make_vec3(pTransform->translation.data());
+		rotation = glm::make_quat(pTransform->rotation.data());
+		scale = glm::make_vec3(pTransform->scale.data());
+
+		return;
+	}
+
+	glm::vec3 skew;
+	glm::vec4 perspective;
+
+	if (!glm::decompose(_extractTransform(node), scale, rotation, translation, skew, perspective)) {
+		translation = glm::vec3(0.0f);
+		rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		scale = glm::vec3(1.0f);
+	}
+}
+
+// keys of one sampler, cubic splines hold in tangent, value and out tangent per key
+typedef struct {
+	uint32_t target;
+	fastgltf::AnimationPath path;
+	fastgltf::AnimationInterpolation interpolation;
+
+	std::vector<float> times;
+	// rotations are x, y, z and w, others leave w at 0
+	std::vector<glm::vec4> values;
+} AnimationTrack;
+
+glm::vec4 _evaluateTrack(const AnimationTrack &track, float time) {
+	bool isCubic = track.interpolation == fastgltf::AnimationInterpolation::CubicSpline;
+	bool isRotation = track.path == fastgltf::AnimationPath::Rotation;
+	size_t stride = isCubic ? 3 : 1;
+	size_t offset = isCubic ? 1 : 0;
+
+	auto it = std::upper_bound(track.times.begin(), track.times.end(), time);
+
+	if (it == track.times.begin())
+		return track.values[offset];
+
+	if (it == track.times.end())
+		return track.values[(track.times.size() - 1) * stride + offset];
+
+	size_t key = static_cast<size_t>(it - track.times.begin()) - 1;
+	float delta = track.times[key + 1] - track.times[key];
+	float t = delta > 0.0f ? (time - track.times[key]) / delta : 0.0f;
+
+	const glm::vec4 &a = track.values[key * stride + offset];
+	const glm::vec4 &b = track.values[(key + 1) * stride + offset];
+
+	if (track.interpolation == fastgltf::AnimationInterpolation::Step)
+		return a;
+
+	if (isCubic) {
+		const glm::vec4 &outTangent = track.values[key * stride + 2];
+		const glm::vec4 &inTangent = track.values[(key + 1) * stride];
+
+		float t2 = t * t;
+		float t3 = t2 * t;
+
+		glm::vec4 value = (2.0f * t3 - 3.0f * t2 + 1.0f) * a +
+				(t3 - 2.0f * t2 + t) * delta * outTangent + (-2.0f * t3 + 3.0f * t2) * b +
+				(t3 - t2) * delta * inTangent;
+
+		return isRotation ? glm::normalize(value) : value;
+	}
+
+	if (isRotation) {
+		glm::quat rotation = glm::slerp(
+				glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+
+		return glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+	}
+
+	return glm::mix(a, b, t);
+}
+
+// channels of nodes outside of traversal, morph weights and malformed samplers are skipped,
+// clip without channels left has no targets
+AnimationClip _loadAnimation(const fastgltf::Asset &asset, const fastgltf::Animation &animation,
+		const std::vector<uint64_t> &nodeIndices) {
+	AnimationClip clip = {};
+	clip.name = animation.name.c_str();
+
+	// target per asset node, first channel of a property wins
+	std::vector<uint32_t> targets(asset.nodes.size(), UINT32_MAX);
+	std::vector<AnimationTrack> tracks;
+
+	for (const fastgltf::AnimationChannel &channel : animation.channels) {
+		if (!channel.nodeIndex.has_value() || channel.samplerIndex >= animation.samplers.size() ||
+				channel.path == fastgltf::AnimationPath::Weights)
+			continue;
+
+		size_t assetNode = channel.nodeIndex.value();
+
+		if (assetNode >= nodeIndices.size() || nodeIndices[assetNode] == UINT64_MAX)
+			continue;
+
+		const fastgltf::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
+
+		if (sampler.inputAccessor >= asset.accessors.size() ||
+				sampler.outputAccessor >= asset.accessors.size())
+			continue;
+
+		const fastgltf::Accessor &input = asset.accessors[sampler.inputAccessor];
+		const fastgltf::Accessor &output = asset.accessors[sampler.outputAccessor];
+
+		bool isCubic = sampler.interpolation == fastgltf::AnimationInterpolation::CubicSpline;
+		size_t valueCount = input.count * (isCubic ? 3 : 1);
+		size_t components = channel.path == fastgltf::AnimationPath::Rotation ? 4 : 3;
+
+		if (input.count == 0 || output.count != valueCount ||
+				fastgltf::getNumComponents(output.type) != components ||
+				input.type != fastgltf::AccessorType::Scalar ||
+				!input.bufferViewIndex.has_value() || !output.bufferViewIndex.has_value())
+			continue;
+
+		if (targets[assetNode] == UINT32_MAX) {
+			const fastgltf::Node &node = asset.nodes[assetNode];
+			AnimationClip::Target target = {};
+			target.node = nodeIndices[assetNode];
+			target.translationChannel = ANIMATION_NO_CHANNEL;
+			target.rotationChannel = ANIMATION_NO_CHANNEL;
+			target.scaleChannel = ANIMATION_NO_CHANNEL;
+
+			_extractRestPose(node, target.translation, target.rotation, target.scale);
+
+			targets[assetNode] = static_cast<uint32_t>(clip.targets.size());
+			clip.targets.push_back(target);
+		}
+
+		AnimationClip::Target &target = clip.targets[targets[assetNode]];
+		uint32_t *pChannel = &target.scaleChannel;
+
+		if (channel.path == fastgltf::AnimationPath::Translation)
+			pChannel = &target.translationChannel;
+		else if (channel.path == fastgltf::AnimationPath::Rotation)
+			pChannel = &target.rotationChannel;
+
+		if (*pChannel != ANIMATION_NO_CHANNEL)
+			continue;
+
+		AnimationTrack track = {};
+		track.target = targets[assetNode];
+		track.path = channel.path;
+		track.interpolation = sampler.interpolation;
+		track.times.resize(input.count);
+		track.values.resize(valueCount, glm::vec4(0.0f));
+
+		fastgltf::iterateAccessorWithIndex<float>(
+				asset, input, [&](float time, size_t idx) { track.times[idx] = time; });
+
+		if (components == 4) {
+			fastgltf::iterateAccessorWithIndex<glm::vec4>(asset, output,
+					[&](const glm::vec4 &value, size_t idx) { track.values[idx] = value; });
+		} else {
+			fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, output,
+					[&](const glm::vec3 &value, size_t idx) {
+						track.values[idx] = glm::vec4(value, 0.0f);
+					});
+		}
+
+		// keys have to ascend, binary search of sampling relies on it
+		if (!std::is_sorted(track.times.begin(), track.times.end()))
+			continue;
+
+		if (channel.path == fastgltf::AnimationPath::Translation)
+			*pChannel = clip.translationCount++;
+		else if (channel.path == fastgltf::AnimationPath::Rotation)
+			*pChannel = clip.rotationCount++;
+		else
+			*pChannel = clip.scaleCount++;
+
+		clip.duration = std::max(clip.duration, track.times.back());
+		tracks.push_back(std::move(track));
+	}
+
+	if (tracks.empty()) {
+		clip.targets.clear();
+		return clip;
+	}
+
+	clip.frameCount = static_cast<uint32_t>(std::ceil(clip.duration * ANIMATION_SAMPLE_RATE)) + 1;
+
+	uint32_t frameSize = clip.getFrameSize();
+	uint32_t translationBase = 0;
+	uint32_t rotationBase = clip.translationCount * 3;
+	uint32_t scaleBase = rotationBase + clip.rotationCount * 4;
+
+	clip.samples.assign(static_cast<size_t>(clip.frameCount) * frameSize, 0.0f);
+	clip.blendWeights.assign(frameSize, 1.0f);
+
+	for (const AnimationTrack &track : tracks) {
+		const AnimationClip::Target &target = clip.targets[track.target];
+
+		uint32_t base = translationBase;
+		uint32_t count = clip.translationCount;
+		uint32_t channel = target.translationChannel;
+		uint32_t components = 3;
+
+		if (track.path == fastgltf::AnimationPath::Rotation) {
+			base = rotationBase;
+			count = clip.rotationCount;
+			channel = target.rotationChannel;
+			components = 4;
+		} else if (track.path == fastgltf::AnimationPath::Scale) {
+			base = scaleBase;
+			count = clip.scaleCount;
+			channel = target.scaleChannel;
+		}
+
+		float weight =
+				track.interpolation == fastgltf::AnimationInterpolation::Step ? 0.0f : 1.0f;
+
+		for (uint32_t c = 0; c < components; c++)
+			clip.blendWeights[base + c * count + channel] = weight;
+
+		glm::vec4 previous = glm::vec4(0.0f);
+
+		for (uint32_t frame = 0; frame < clip.frameCount; frame++) {
+			float time = std::min(frame / ANIMATION_SAMPLE_RATE, clip.duration);
+			glm::vec4 value = _evaluateTrack(track, time);
+
+			// both signs are one rotation, flat blend of frames needs them in one hemisphere
+			if (components == 4 && frame > 0 && glm::dot(previous, value) < 0.0f)
+				value = -value;
+
+			previous = value;
+
+			float *pFrame = &clip.samples[static_cast<size_t>(frame) * frameSize];
+
+			for (uint32_t c = 0; c < components; c++)
+				pFrame[base + c * count + channel] = value[c];
+		}
+	}
+
+	return clip;
+}
+
+// buffers are views into data read from files or embedded data, never copied again
+const uint8_t *_getBufferData(const fastgltf::Buffer &buffer) {
+	if (const fastgltf::sources::ByteView *pView =
+					std::get_if<fastgltf::sources::ByteView>(&buffer.data))
+		return reinterpret_cast<const uint8_t *>(pView->bytes.data());
+
+	if (const fastgltf::sources::Array *pArray =
+					std::get_if<fastgltf::sources::Array>(&buffer.data))
+		return pArray->bytes.data();
+
+	if (const fastgltf::sources::Vector *pVector =
+					std::get_if<fastgltf::sources::Vector>(&buffer.data))
+		return pVector->bytes.data();
+
+	return nullptr;
+}
+
+// decoders read straight from page cache, packaged images are inflated by image loader
+std::shared_ptr<Image> _loadImageFile(const std::filesystem::path &path, size_t offset) {
+	MappedFile mappedFile;
+
+	if (!mappedFile.open(path) || offset >= mappedFile.getSize())
+		return ImageLoader::loadFromFile(path.c_str());
+
+	return ImageLoader::loadFromMemory(
+			mappedFile.getData() + offset, mappedFile.getSize() - offset);
+}
+
+// of image stored whole in a file of its own, empty otherwise
+std::filesystem::path _getImagePath(
+		const fastgltf::Image &image, const std::filesystem::path &directory) {
+	const fastgltf::sources::URI *pFile = std::get_if<fastgltf::sources::URI>(&image.data);
+
+	if (pFile == nullptr || pFile->fileByteOffset != 0)
+		return {};
+
+	return directory / pFile->uri.path().data();
+}
+
 std::shared_ptr<Image> _loadImage(const fastgltf::Asset &asset, const fastgltf::Image &image,
 		const std::filesystem::path &directory) {
 	const fastgltf::sources::URI *pFile = std::get_if<fastgltf::sources::URI>(&image.data);
 
 	if (pFile != nullptr) {
-		assert(pFile->fileByteOffset == 0); // We don't support offsets with stbi.
-
 		std::filesystem::path path(directory / pFile->uri.path().data());
 		assert(path.is_absolute());
 
-		return ImageLoader::loadFromFile(path.c_str());
+		return _loadImageFile(path, pFile->fileByteOffset);
 	}
 
-	const fastgltf::sources::Vector *pVector = std::get_if<fastgltf::sources::Vector>(&image.data);
+	const fastgltf::sources::Array *pArray = std::get_if<fastgltf::sources::Array>(&image.data);
 
-	if (pVector != nullptr)
-		return ImageLoader::loadFromMemory(pVector->bytes.data(), pVector->bytes.size());
+	if (pArray != nullptr)
+		return ImageLoader::loadFromMemory(pArray->bytes.data(), pArray->bytes.size());
 
 	const fastgltf::sources::BufferView *pView =
 			std::get_if<fastgltf::sources::BufferView>(&image.data);
@@ -70,152 +393,674 @@ std::shared_ptr<Image> _loadImage(const fastgltf::Asset &asset, const fastgltf::
 		const fastgltf::BufferView &bufferView = asset.bufferViews[pView->bufferViewIndex];
 		const fastgltf::Buffer &buffer = asset.buffers[bufferView.bufferIndex];
 
-		const fastgltf::sources::Vector *pVector =
-				std::get_if<fastgltf::sources::Vector>(&buffer.data);
+		const uint8_t *pData = _getBufferData(buffer);
 
-		if (pVector != nullptr)
-			return ImageLoader::loadFromMemory(pVector->bytes.data(), pVector->bytes.size());
+		if (pData != nullptr) {
+			return ImageLoader::loadFromMemory(
+					pData + bufferView.byteOffset, bufferView.byteLength);
+		}
 	}
 
 	return nullptr;
 }
 
-void _generateTangents(const IndexArray &indices, VertexArray &vertices) {
+// uncompressed image into layout of usage, in place unless it is resampled or metallic
+// roughness, brought down to max image size first so conversion touches fewer texels
+std::shared_ptr<Image> _convertImage(const std::shared_ptr<Image> &source, ImageUsage usage) {
+	std::shared_ptr<Image> image;
+
+	switch (usage) {
+		case ImageUsage::Albedo:
+			// decoded by texture unit, levels are filtered in linear space
+			source->setSrgb(true);
+			image = ImageResampler::limit(source, getMaxImageSize());
+			image->convert(Image::Format::RGBA8);
+			return image;
+		case ImageUsage::Normal:
+			source->setSrgb(false);
+			image = ImageResampler::limit(source, getMaxImageSize());
+			image->convert(Image::Format::RG8);
+			return image;
+		case ImageUsage::MetallicRoughness:
+			// metallic in blue channel, roughness in green channel, shaders read both with one
+			// fetch
+			image = ImageResampler::limit(source, getMaxImageSize());
+			return std::shared_ptr<Image>(
+					image->getComponents(Image::Channel::B, Image::Channel::G));
+	}
+
+	return source;
+}
+
+// corners of accessor bounds, quantized positions are normalized like their data would be
+static bool _readPositionBounds(const fastgltf::Accessor &accessor, AABB &aabb) {
+	auto read = [&](const auto &bound, glm::vec3 &value) {
+		if (bound.size() < 3)
+			return false;
+
+		value = glm::vec3(bound[0], bound[1], bound[2]);
+		return true;
+	};
+
+	bool isRead = false;
+
+	if (const auto *pMin = std::get_if<FASTGLTF_STD_PMR_NS::vector<double>>(&accessor.min)) {
+		const auto *pMax = std::get_if<FASTGLTF_STD_PMR_NS::vector<double>>(&accessor.max);
+		isRead = pMax != nullptr && read(*pMin, aabb.min) && read(*pMax, aabb.max);
+	} else if (const auto *pMin =
+					   std::get_if<FASTGLTF_STD_PMR_NS::vector<std::int64_t>>(&accessor.min)) {
+		const auto *pMax = std::get_if<FASTGLTF_STD_PMR_NS::vector<std::int64_t>>(&accessor.max);
+		isRead = pMax != nullptr && read(*pMin, aabb.min) && read(*pMax, aabb.max);
+	}
+
+	if (!isRead || !accessor.normalized)
+		return isRead;
+
+	float scale = 1.0f;
+
+	switch (accessor.componentType) {
+		case fastgltf::ComponentType::Byte:
+			scale = 1.0f / 127.0f;
+			break;
+		case fastgltf::ComponentType::UnsignedByte:
+			scale = 1.0f / 255.0f;
+			break;
+		case fastgltf::ComponentType::Short:
+			scale = 1.0f / 32767.0f;
+			break;
+		case fastgltf::ComponentType::UnsignedShort:
+			scale = 1.0f / 65535.0f;
+			break;
+		default:
+			break;
+	}
+
+	aabb.min = glm::max(aabb.min * scale, glm::vec3(-1.0f));
+	aabb.max = glm::max(aabb.max * scale, glm::vec3(-1.0f));
+
+	return true;
+}
+
+std::optional<SceneInfo> AssetLoader::scanGltf(const std::filesystem::path &file) {
+	PROFILE_ZONE("gltf scan");
+
+	fastgltf::Parser parser(fastgltf::Extensions::KHR_lights_punctual |
+			fastgltf::Extensions::KHR_texture_basisu | fastgltf::Extensions::KHR_mesh_quantization |
+			fastgltf::Extensions::EXT_meshopt_compression);
+
+	// only pages of json are touched, binary chunk of GLB stays unread
+	MappedFile mappedFile;
+	fastgltf::GltfDataBuffer data;
+
+	size_t padding = fastgltf::getGltfBufferPadding();
+	std::vector<uint8_t> fileData;
+
+	if (mappedFile.open(file, padding))
+		data.fromByteView(mappedFile.getData(), mappedFile.getSize(), mappedFile.getCapacity());
+	else if (Package::load(file, fileData, padding))
+		data.fromByteView(fileData.data(), fileData.size() - padding, fileData.size());
+	else
+		data.loadFromFile(file);
+
+	// animations, skins, cameras and samplers do not show in summary
+	fastgltf::Category categories = fastgltf::Category::Buffers |
+			fastgltf::Category::BufferViews | fastgltf::Category::Accessors |
+			fastgltf::Category::Images | fastgltf::Category::Textures |
+			fastgltf::Category::Materials | fastgltf::Category::Meshes |
+			fastgltf::Category::Nodes | fastgltf::Category::Scenes | fastgltf::Category::Asset;
+
+	std::filesystem::path assetRoot = file.parent_path();
+	fastgltf::Expected<fastgltf::Asset> result =
+			parser.loadGltf(&data, assetRoot, fastgltf::Options::None, categories);
+
+	if (fastgltf::Error err = result.error(); err != fastgltf::Error::None) {
+		const char *pMsg = fastgltf::getErrorMessage(err).data();
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Asset scan failed: %s", pMsg);
+
+		return std::nullopt;
+	}
+
+	const fastgltf::Asset &asset = result.get();
+
+	SceneInfo info = {};
+	info.meshCount = static_cast<uint32_t>(asset.meshes.size());
+	info.materialCount = static_cast<uint32_t>(asset.materials.size());
+	info.textureCount = static_cast<uint32_t>(asset.textures.size());
+	info.imageCount = static_cast<uint32_t>(asset.images.size());
+	info.nodeCount = static_cast<uint32_t>(asset.nodes.size());
+
+	std::vector<uint64_t> meshTriangles(asset.meshes.size(), 0);
+	// mesh space, per mesh
+	std::vector<std::optional<AABB>> meshBounds(asset.meshes.size());
+
+	for (size_t i = 0; i < asset.meshes.size(); i++) {
+		for (const fastgltf::Primitive &primitive : asset.meshes[i].primitives) {
+			auto position = primitive.findAttribute("POSITION");
+
+			if (primitive.type != fastgltf::PrimitiveType::Triangles ||
+					position == primitive.attributes.end() ||
+					position->second >= asset.accessors.size())
+				continue;
+
+			const fastgltf::Accessor &positionAccessor = asset.accessors[position->second];
+			size_t indexCount = positionAccessor.count;
+
+			if (primitive.indicesAccessor.has_value() &&
+					primitive.indicesAccessor.value() < asset.accessors.size())
+				indexCount = asset.accessors[primitive.indicesAccessor.value()].count;
+
+			info.primitiveCount++;
+			info.vertexCount += positionAccessor.count;
+			meshTriangles[i] += indexCount / 3;
+
+			AABB aabb;
+
+			if (!_readPositionBounds(positionAccessor, aabb))
+				continue;
+
+			if (meshBounds[i].has_value()) {
+				meshBounds[i]->expand(aabb.min);
+				meshBounds[i]->expand(aabb.max);
+			} else {
+				meshBounds[i] = aabb;
+			}
+		}
+
+		info.triangleCount += meshTriangles[i];
+	}
+
+	for (const fastgltf::Image &image : asset.images) {
+		if (const auto *pView = std::get_if<fastgltf::sources::BufferView>(&image.data)) {
+			if (pView->bufferViewIndex < asset.bufferViews.size())
+				info.imageByteCount += asset.bufferViews[pView->bufferViewIndex].byteLength;
+		} else if (const auto *pUri = std::get_if<fastgltf::sources::URI>(&image.data)) {
+			// embedded data URIs have no file, they are left out
+			std::error_code error;
+			uintmax_t size = std::filesystem::file_size(assetRoot / pUri->uri.path().data(), error);
+
+			if (!error)
+				info.imageByteCount += size;
+		} else if (const auto *pArray = std::get_if<fastgltf::sources::Array>(&image.data)) {
+			info.imageByteCount += pArray->bytes.size();
+		}
+	}
+
+	// world transforms like loadGltf places nodes, every node not referenced as child is root
+	std::vector<bool> isChild(asset.nodes.size(), false);
+
+	for (const fastgltf::Node &node : asset.nodes) {
+		for (size_t child : node.children) {
+			if (child < isChild.size())
+				isChild[child] = true;
+		}
+	}
+
+	std::vector<std::pair<size_t, glm::mat4>> pendingNodes;
+	std::vector<bool> isVisited(asset.nodes.size(), false);
+
+	for (size_t i = 0; i < asset.nodes.size(); i++) {
+		if (!isChild[i])
+			pendingNodes.push_back({ i, glm::mat4(1.0f) });
+	}
+
+	while (!pendingNodes.empty()) {
+		auto [nodeIndex, parent] = pendingNodes.back();
+		pendingNodes.pop_back();
+
+		if (isVisited[nodeIndex])
+			continue;
+
+		isVisited[nodeIndex] = true;
+
+		const fastgltf::Node &node = asset.nodes[nodeIndex];
+		glm::mat4 transform = parent * _extractTransform(node);
+
+		for (size_t child : node.children) {
+			if (child < asset.nodes.size())
+				pendingNodes.push_back({ child, transform });
+		}
+
+		if (!node.meshIndex.has_value() || node.meshIndex.value() >= asset.meshes.size())
+			continue;
+
+		size_t meshIndex = node.meshIndex.value();
+
+		info.meshInstanceCount++;
+		info.instancedTriangleCount += meshTriangles[meshIndex];
+
+		if (!meshBounds[meshIndex].has_value())
+			continue;
+
+		AABB aabb = meshBounds[meshIndex]->transformed(transform);
+
+		if (info.hasBounds) {
+			info.bounds.expand(aabb.min);
+			info.bounds.expand(aabb.max);
+		} else {
+			info.bounds = aabb;
+			info.hasBounds = true;
+		}
+	}
+
+	return info;
+}
+
+std::future<Scene> AssetLoader::loadGltfAsync(const std::filesystem::path &file,
+		bool weldVertices, bool deriveTangents, const CancelToken &cancel) {
+	return JobSystem::async([file, weldVertices, deriveTangents, cancel]() {
+		return loadGltf(file, weldVertices, deriveTangents, cancel);
+	});
+}
+
+std::shared_ptr<Image> AssetLoader::loadImage(const ImageSource &source) {
+	if (source.path.empty())
+		return nullptr;
+
+	std::shared_ptr<Image> image = _loadImageFile(source.path, 0);
+
+	if (image == nullptr)
+		return nullptr;
+
+	if (!Image::isFormatCompressed(image->getFormat()))
+		return _convertImage(image, source.usage);
+
+	// compressed images are expected in layout of their usage, only pre-built levels past max
+	// size can be dropped
+	image = ImageResampler::limit(image, getMaxImageSize());
+
+	if (source.usage == ImageUsage::Albedo)
+		image->setSrgb(true);
+
+	return image;
+}
+
+void AssetLoader::setMaxImageSize(uint32_t size) {
+	_maxImageSize.store(size, std::memory_order_relaxed);
+}
+
+uint32_t AssetLoader::getMaxImageSize() {
+	return _maxImageSize.load(std::memory_order_relaxed);
+}
+
+void AssetLoader::generateTangents(const IndexArray &indices, VertexArray &vertices) {
 	assert(indices.count % 3 == 0);
 
-	uint32_t averageCount = vertices.count;
-	float *pAverage = (float *)calloc(averageCount, sizeof(float));
+	// accumulated apart from vertices, so scattered adds touch 12 bytes instead of whole vertex
+	std::vector<glm::vec3> tangents(vertices.count, glm::vec3(0.0f));
+
+	const Vertex *pVertices = vertices.pData;
 
 	for (size_t i = 0; i < indices.count; i += 3) {
-		Vertex &v0 = vertices.pData[indices.pData[i + 0]];
-		Vertex &v1 = vertices.pData[indices.pData[i + 1]];
-		Vertex &v2 = vertices.pData[indices.pData[i + 2]];
+		uint32_t i0 = indices.pData[i + 0];
+		uint32_t i1 = indices.pData[i + 1];
+		uint32_t i2 = indices.pData[i + 2];
 
-		glm::vec3 pos0 = v0.position;
-		glm::vec3 pos1 = v1.position;
-		glm::vec3 pos2 = v2.position;
+		glm::vec3 deltaPos1 = pVertices[i1].position - pVertices[i0].position;
+		glm::vec3 deltaPos2 = pVertices[i2].position - pVertices[i0].position;
 
-		glm::vec2 uv0 = v0.uv;
-		glm::vec2 uv1 = v1.uv;
-		glm::vec2 uv2 = v2.uv;
+		glm::vec2 deltaUV1 = pVertices[i1].uv - pVertices[i0].uv;
+		glm::vec2 deltaUV2 = pVertices[i2].uv - pVertices[i0].uv;
 
-		glm::vec3 deltaPos1 = pos1 - pos0;
-		glm::vec3 deltaPos2 = pos2 - pos0;
+		// degenerate uv would spread NaN to every vertex of the triangle
+		float det = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
 
-		glm::vec2 deltaUV1 = uv1 - uv0;
-		glm::vec2 deltaUV2 = uv2 - uv0;
+		if (det == 0.0f)
+			continue;
 
-		float r = 1.0 / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-		glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+		glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) / det;
 
-		v0.tangent += tangent;
-		v1.tangent += tangent;
-		v2.tangent += tangent;
+		tangents[i0] += tangent;
+		tangents[i1] += tangent;
+		tangents[i2] += tangent;
+	}
 
-		pAverage[indices.pData[i + 0]] += 1.0;
-		pAverage[indices.pData[i + 1]] += 1.0;
-		pAverage[indices.pData[i + 2]] += 1.0;
+	// shaders normalize tangent anyway, so sum is normalized instead of averaged
+	for (uint32_t i = 0; i < vertices.count; i++) {
+		float length = glm::length(tangents[i]);
+		vertices.pData[i].tangent = length > 0.0f ? tangents[i] / length : glm::vec3(0.0f);
 	}
+}
+
+// glTF normalization of integer components, unsigned ones map to [0, 1] and signed to [-1, 1]
+template <typename T> float _normalize(T value) {
+	if (std::is_signed<T>::value)
+		return std::max(static_cast<float>(value) / std::numeric_limits<T>::max(), -1.0f);
 
-	for (uint32_t i = 0; i < averageCount; i++) {
-		float denom = 1.0 / pAverage[i];
-		vertices.pData[i].tangent *= denom;
+	return static_cast<float>(value) / std::numeric_limits<T>::max();
+}
+
+template <typename T>
+void _convertComponents(const uint8_t *pSrc, size_t srcStride, size_t count,
+		uint32_t components, bool isNormalized, float *pDst, size_t dstStride) {
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t *pElement = pSrc + i * srcStride;
+		uint8_t *pElementDst = reinterpret_cast<uint8_t *>(pDst) + i * dstStride;
+		float *pFloats = reinterpret_cast<float *>(pElementDst);
+
+		for (uint32_t c = 0; c < components; c++) {
+			T value;
+			memcpy(&value, pElement + c * sizeof(T), sizeof(T));
+
+			pFloats[c] = isNormalized ? _normalize(value) : static_cast<float>(value);
+		}
 	}
 }
 
-Mesh _loadMesh(const fastgltf::Asset &asset, const fastgltf::Mesh &mesh) {
-	uint32_t primitiveCount = mesh.primitives.size();
-	Primitive *pPrimitives = (Primitive *)malloc(primitiveCount * sizeof(Primitive));
+// quantized attributes of KHR_mesh_quantization are converted in one loop per component type,
+// float ones are copied, sparse ones are left to per element iteration of fastgltf
+template <typename T>
+void _readAttribute(const fastgltf::Asset &asset, const fastgltf::Accessor &accessor,
+		VertexArray &vertices, T Vertex::*pMember) {
+	const uint32_t components = T::length();
 
-	size_t idx = 0;
-	for (const fastgltf::Primitive &primitive : mesh.primitives) {
-		VertexArray vertices = {};
-		IndexArray indices = {};
+	const fastgltf::BufferView &bufferView = asset.bufferViews[accessor.bufferViewIndex.value()];
+	const uint8_t *pData = _getBufferData(asset.buffers[bufferView.bufferIndex]);
 
-		// due to Options::GenerateMeshIndices, this should always be true
-		assert(primitive.indicesAccessor.has_value());
-		size_t accessorIndex = primitive.indicesAccessor.value();
-		const fastgltf::Accessor &indexAccessor = asset.accessors[accessorIndex];
+	if (accessor.sparse.has_value() || pData == nullptr ||
+			fastgltf::getNumComponents(accessor.type) != components) {
+		fastgltf::iterateAccessorWithIndex<T>(asset, accessor, [&](const T &value, size_t idx) {
+			vertices.pData[idx].*pMember = value;
+		});
 
-		indices.pData = (uint32_t *)malloc(indexAccessor.count * sizeof(uint32_t));
-		indices.count = indexAccessor.count;
+		return;
+	}
 
-		fastgltf::iterateAccessorWithIndex<uint32_t>(asset, indexAccessor,
-				[&](uint32_t index, size_t idx) { indices.pData[idx] = index; });
+	const uint8_t *pSrc = pData + bufferView.byteOffset + accessor.byteOffset;
+	size_t srcStride = bufferView.byteStride.value_or(
+			fastgltf::getElementByteSize(accessor.type, accessor.componentType));
+	size_t count = std::min<size_t>(accessor.count, vertices.count);
+
+	float *pDst = glm::value_ptr(vertices.pData[0].*pMember);
+	bool isNormalized = accessor.normalized;
+
+	switch (accessor.componentType) {
+		case fastgltf::ComponentType::Byte:
+			_convertComponents<int8_t>(
+					pSrc, srcStride, count, components, isNormalized, pDst, sizeof(Vertex));
+			break;
+		case fastgltf::ComponentType::UnsignedByte:
+			_convertComponents<uint8_t>(
+					pSrc, srcStride, count, components, isNormalized, pDst, sizeof(Vertex));
+			break;
+		case fastgltf::ComponentType::Short:
+			_convertComponents<int16_t>(
+					pSrc, srcStride, count, components, isNormalized, pDst, sizeof(Vertex));
+			break;
+		case fastgltf::ComponentType::UnsignedShort:
+			_convertComponents<uint16_t>(
+					pSrc, srcStride, count, components, isNormalized, pDst, sizeof(Vertex));
+			break;
+		case fastgltf::ComponentType::Float:
+			for (size_t i = 0; i < count; i++)
+				memcpy(&(vertices.pData[i].*pMember), pSrc + i * srcStride, sizeof(T));
+
+			break;
+		default:
+			fastgltf::iterateAccessorWithIndex<T>(asset, accessor,
+					[&](const T &value, size_t idx) { vertices.pData[idx].*pMember = value; });
+			break;
+	}
+}
 
-		{
-			size_t accessorIndex = primitive.findAttribute("POSITION")->second;
-			const fastgltf::Accessor &positionAccessor = asset.accessors[accessorIndex];
+// views compressed by EXT_meshopt_compression are decoded in parallel into buffers of their own,
+// accessors then read them like any other view, false when one can not be decoded
+bool _decodeCompressedViews(
+		fastgltf::Asset &asset, std::vector<std::vector<uint8_t>> &bufferData) {
+	std::vector<size_t> views;
 
-			// required
-			if (!positionAccessor.bufferViewIndex.has_value())
-				continue;
+	for (size_t i = 0; i < asset.bufferViews.size(); i++) {
+		if (asset.bufferViews[i].meshoptCompression != nullptr)
+			views.push_back(i);
+	}
 
-			vertices.pData = (Vertex *)malloc(positionAccessor.count * sizeof(Vertex));
-			vertices.count = positionAccessor.count;
+	if (views.empty())
+		return true;
 
-			fastgltf::iterateAccessorWithIndex<glm::vec3>(
-					asset, positionAccessor, [&](const glm::vec3 &position, size_t idx) {
-						vertices.pData[idx].position = position;
+	PROFILE_ZONE("meshopt decode");
 
-						// initialize tangent
-						vertices.pData[idx].tangent = glm::vec3(0.0);
-					});
-		}
+	// sized before jobs start, moving vectors keeps their storage
+	size_t firstData = bufferData.size();
+
+	for (size_t view : views) {
+		const fastgltf::CompressedBufferView &compression =
+				*asset.bufferViews[view].meshoptCompression;
 
-		for (const auto &attribute : primitive.attributes) {
-			const char *pName = attribute.first.data();
-			const fastgltf::Accessor &accessor = asset.accessors[attribute.second];
+		bufferData.emplace_back(compression.count * compression.byteStride);
+	}
+
+	std::vector<uint8_t> isDecoded(views.size(), false);
+	uint32_t viewCount = static_cast<uint32_t>(views.size());
+
+	JobSystem::parallelFor(viewCount, 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			const fastgltf::CompressedBufferView &compression =
+					*asset.bufferViews[views[i]].meshoptCompression;
 
-			if (!accessor.bufferViewIndex.has_value())
+			if (compression.bufferIndex >= asset.buffers.size())
 				continue;
 
-			if (strcmp(pName, "NORMAL") == 0) {
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(
-						asset, accessor, [&](const glm::vec3 &normal, size_t idx) {
-							vertices.pData[idx].normal = normal;
-						});
-			}
+			const fastgltf::Buffer &buffer = asset.buffers[compression.bufferIndex];
+			const uint8_t *pSrc = _getBufferData(buffer);
 
-			if (strcmp(pName, "TEXCOORD_0") == 0) {
-				fastgltf::iterateAccessorWithIndex<glm::vec2>(
-						asset, accessor, [&](const glm::vec2 &texCoord, size_t idx) {
-							vertices.pData[idx].uv = texCoord;
-						});
-			}
+			if (pSrc == nullptr ||
+					compression.byteOffset + compression.byteLength > buffer.byteLength)
+				continue;
+
+			// enums of fastgltf are in order of decoder
+			isDecoded[i] = MeshoptDecoder::decode(bufferData[firstData + i].data(),
+					compression.count, compression.byteStride, pSrc + compression.byteOffset,
+					compression.byteLength, static_cast<MeshoptDecoder::Mode>(compression.mode),
+					static_cast<MeshoptDecoder::Filter>(compression.filter));
 		}
+	});
+
+	for (size_t i = 0; i < views.size(); i++) {
+		if (!isDecoded[i]) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+					"Asset loading failed: buffer view %zu can not be decoded", views[i]);
+
+			return false;
+		}
+
+		const std::vector<uint8_t> &decoded = bufferData[firstData + i];
 
-		_generateTangents(indices, vertices);
+		fastgltf::sources::ByteView view = {};
+		view.bytes = fastgltf::span<const std::byte>(
+				reinterpret_cast<const std::byte *>(decoded.data()), decoded.size());
+
+		fastgltf::Buffer buffer = {};
+		buffer.byteLength = decoded.size();
+		buffer.data = view;
+
+		// fallback buffer of view holds no data
+		fastgltf::BufferView &bufferView = asset.bufferViews[views[i]];
+		bufferView.bufferIndex = asset.buffers.size();
+		bufferView.byteOffset = 0;
+		bufferView.byteLength = decoded.size();
+		bufferView.meshoptCompression.reset();
+
+		asset.buffers.push_back(std::move(buffer));
+	}
+
+	return true;
+}
 
-		uint64_t materialIndex = primitive.materialIndex.value_or(0);
+// positions and normals, tangents of targets are dropped, vertices with zero offsets are left out
+MorphTargetArray _readMorphTargets(const fastgltf::Asset &asset,
+		const fastgltf::Primitive &primitive, uint32_t vertexCount, MeshArena &arena) {
+	MorphTargetArray result = {};
 
-		pPrimitives[idx] = {
-			vertices,
-			indices,
-			materialIndex,
+	if (primitive.targets.empty() || vertexCount == 0)
+		return result;
+
+	result.pData = arena.allocate<MorphTarget>(primitive.targets.size());
+	result.count = static_cast<uint32_t>(primitive.targets.size());
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+
+	for (size_t i = 0; i < primitive.targets.size(); i++) {
+		positions.assign(vertexCount, glm::vec3(0.0f));
+		normals.assign(vertexCount, glm::vec3(0.0f));
+
+		auto readTarget = [&](const char *pName, std::vector<glm::vec3> &values) {
+			auto it = primitive.findTargetAttribute(i, pName);
+
+			if (it == primitive.targets[i].cend() || it->second >= asset.accessors.size())
+				return;
+
+			// accessor without view is all zeros unless sparse values follow
+			const fastgltf::Accessor &accessor = asset.accessors[it->second];
+
+			if (accessor.count != vertexCount || accessor.type != fastgltf::AccessorType::Vec3 ||
+					(!accessor.bufferViewIndex.has_value() && !accessor.sparse.has_value()))
+				return;
+
+			fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, accessor,
+					[&](const glm::vec3 &value, size_t idx) { values[idx] = value; });
 		};
 
-		idx++;
+		readTarget("POSITION", positions);
+		readTarget("NORMAL", normals);
+
+		uint32_t deltaCount = 0;
+
+		for (uint32_t j = 0; j < vertexCount; j++) {
+			if (positions[j] != glm::vec3(0.0f) || normals[j] != glm::vec3(0.0f))
+				deltaCount++;
+		}
+
+		MorphTarget &target = result.pData[i];
+		target.pDeltas = arena.allocate<MorphDelta>(deltaCount);
+		target.deltaCount = 0;
+
+		for (uint32_t j = 0; j < vertexCount; j++) {
+			if (positions[j] != glm::vec3(0.0f) || normals[j] != glm::vec3(0.0f))
+				target.pDeltas[target.deltaCount++] = { j, positions[j], normals[j] };
+		}
+	}
+
+	return result;
+}
+
+// safe to call from worker threads, asset is only read
+bool _loadPrimitive(const fastgltf::Asset &asset, const fastgltf::Primitive &primitive,
+		bool weldVertices, bool deriveTangents, MeshArena &arena, Primitive &out) {
+	VertexArray vertices = {};
+	IndexArray indices = {};
+
+	// due to Options::GenerateMeshIndices, this should always be true
+	assert(primitive.indicesAccessor.has_value());
+	size_t accessorIndex = primitive.indicesAccessor.value();
+	const fastgltf::Accessor &indexAccessor = asset.accessors[accessorIndex];
+
+	indices.pData = arena.allocate<uint32_t>(indexAccessor.count);
+	indices.count = indexAccessor.count;
+
+	fastgltf::iterateAccessorWithIndex<uint32_t>(asset, indexAccessor,
+			[&](uint32_t index, size_t idx) { indices.pData[idx] = index; });
+
+	{
+		size_t accessorIndex = primitive.findAttribute("POSITION")->second;
+		const fastgltf::Accessor &positionAccessor = asset.accessors[accessorIndex];
+
+		// required
+		if (!positionAccessor.bufferViewIndex.has_value())
+			return false;
+
+		// missing attributes stay zero, welding compares whole vertices
+		vertices.pData = arena.allocate<Vertex>(positionAccessor.count);
+		vertices.count = positionAccessor.count;
+
+		_readAttribute(asset, positionAccessor, vertices, &Vertex::position);
 	}
 
-	const char *pName = mesh.name.c_str();
+	for (const auto &attribute : primitive.attributes) {
+		const char *pName = attribute.first.data();
+		const fastgltf::Accessor &accessor = asset.accessors[attribute.second];
 
-	return {
-		pPrimitives,
-		primitiveCount,
-		pName,
+		if (!accessor.bufferViewIndex.has_value())
+			continue;
+
+		if (strcmp(pName, "NORMAL") == 0)
+			_readAttribute(asset, accessor, vertices, &Vertex::normal);
+
+		if (strcmp(pName, "TEXCOORD_0") == 0)
+			_readAttribute(asset, accessor, vertices, &Vertex::uv);
+
+		// unwrap made for lightmaps, LightmapBaker keeps it
+		if (strcmp(pName, "TEXCOORD_1") == 0)
+			_readAttribute(asset, accessor, vertices, &Vertex::lightmapUV);
+
+		// first set only, further influences are dropped
+		if (strcmp(pName, "JOINTS_0") == 0) {
+			fastgltf::iterateAccessorWithIndex<glm::uvec4>(
+					asset, accessor, [&](const glm::uvec4 &joints, size_t idx) {
+						vertices.pData[idx].joints = glm::u16vec4(joints);
+					});
+		}
+
+		if (strcmp(pName, "WEIGHTS_0") == 0)
+			_readAttribute(asset, accessor, vertices, &Vertex::weights);
+	}
+
+	out = {
+		vertices,
+		indices,
+		primitive.materialIndex.value_or(0),
 	};
+
+	out.morphTargets = _readMorphTargets(asset, primitive, vertices.count, arena);
+
+	// before tangents, welded vertices accumulate them from every triangle using them
+	if (weldVertices)
+		MeshOptimizer::weld(out);
+
+	// tangents serve normal maps only, other primitives keep them zero
+	if (!deriveTangents && primitive.materialIndex.has_value() &&
+			primitive.materialIndex.value() < asset.materials.size() &&
+			asset.materials[primitive.materialIndex.value()].normalTexture.has_value())
+		generateTangents(out.indices, out.vertices);
+
+	// exported order is rarely cache friendly, cooked scenes keep optimized order
+	MeshOptimizer::optimize(out);
+	MeshOptimizer::buildMeshlets(out, arena);
+	MeshOptimizer::buildLods(out, arena);
+
+	return true;
 }
 
-Scene AssetLoader::loadGltf(const std::filesystem::path &file) {
-	fastgltf::Parser parser(fastgltf::Extensions::KHR_lights_punctual);
+Scene AssetLoader::loadGltf(const std::filesystem::path &file, bool weldVertices,
+		bool deriveTangents, const CancelToken &cancel) {
+	PROFILE_ZONE("gltf load");
+
+	// quantized and compressed meshes as written by gltfpack
+	fastgltf::Parser parser(fastgltf::Extensions::KHR_lights_punctual |
+			fastgltf::Extensions::KHR_texture_basisu | fastgltf::Extensions::KHR_mesh_quantization |
+			fastgltf::Extensions::EXT_meshopt_compression);
+
+	// mapping and reads outlive asset, GLB and external buffers are views into them
+	MappedFile mappedFile;
+	AsyncReader reader;
 
 	fastgltf::GltfDataBuffer data;
-	data.loadFromFile(file);
 
-	fastgltf::Options options = fastgltf::Options::LoadExternalBuffers |
-								fastgltf::Options::LoadGLBBuffers |
-								fastgltf::Options::GenerateMeshIndices;
+	// json parser reads past end of data, padding is zeroed
+	size_t padding = fastgltf::getGltfBufferPadding();
+
+	// packaged files are inflated whole, json parser needs contiguous data
+	std::vector<uint8_t> fileData;
+	std::vector<std::vector<uint8_t>> bufferData;
+
+	if (mappedFile.open(file, padding))
+		data.fromByteView(mappedFile.getData(), mappedFile.getSize(), mappedFile.getCapacity());
+	else if (Package::load(file, fileData, padding))
+		data.fromByteView(fileData.data(), fileData.size() - padding, fileData.size());
+	else
+		data.loadFromFile(file);
+
+	// without load options GLB buffer is view into data, external buffers stay URIs
+	fastgltf::Options options = fastgltf::Options::GenerateMeshIndices;
 
 	std::filesystem::path assetRoot = file.parent_path();
 	fastgltf::Expected<fastgltf::Asset> result = parser.loadGltf(&data, assetRoot, options);
@@ -227,96 +1072,416 @@ Scene AssetLoader::loadGltf(const std::filesystem::path &file) {
 		return {};
 	}
 
+	if (cancel.isCancelled())
+		return {};
+
 	fastgltf::Asset &asset = result.get();
+	std::vector<std::filesystem::path> bufferPaths;
+
+	// external buffers are read first, images queued after them are read while buffers are
+	// bound and early images decode
+	std::vector<std::optional<uint32_t>> bufferReads(asset.buffers.size());
+
+	for (size_t i = 0; i < asset.buffers.size(); i++) {
+		const fastgltf::Buffer &buffer = asset.buffers[i];
+		const fastgltf::sources::URI *pFile = std::get_if<fastgltf::sources::URI>(&buffer.data);
+
+		if (pFile == nullptr)
+			continue;
+
+		std::filesystem::path path(assetRoot / pFile->uri.path().data());
+		bufferPaths.push_back(path);
+
+		bufferReads[i] = reader.add(path);
+	}
 
 	Scene scene;
+	scene.arena = std::make_shared<MeshArena>();
+	scene.bufferPaths = std::move(bufferPaths);
 
-	for (const fastgltf::Material &material : asset.materials) {
-		Material _material = {};
+	std::vector<ImageJob> imageJobs;
+	std::vector<MaterialJobs> materialJobs;
 
-		const std::optional<fastgltf::TextureInfo> &albedoInfo = material.pbrData.baseColorTexture;
+	// shared images are converted once per usage
+	std::map<std::pair<size_t, ImageUsage>, size_t> jobIndices;
 
-		if (albedoInfo.has_value()) {
-			const fastgltf::Image &image = asset.images[albedoInfo->textureIndex];
-			std::shared_ptr<Image> albedoMap(_loadImage(asset, image, file.parent_path()));
+	// and decoded once for all usages, textures of different samplers may share image
+	std::map<size_t, size_t> decodeIndices;
+	std::vector<size_t> decodeImages;
+	std::vector<std::optional<size_t>> decodeFallbacks;
+	std::vector<std::vector<size_t>> decodeJobs;
 
-			if (albedoMap != nullptr) {
-				albedoMap->convert(Image::Format::RGBA8);
+	auto addJob = [&](size_t textureIndex, ImageUsage usage) -> std::optional<size_t> {
+		if (textureIndex >= asset.textures.size())
+			return std::nullopt;
 
-				uint32_t idx = scene.images.size();
-				scene.images.push_back(albedoMap);
-				_material.albedoIndex = idx;
-			}
-		}
+		const fastgltf::Texture &texture = asset.textures[textureIndex];
 
-		const std::optional<fastgltf::NormalTextureInfo> &normalInfo = material.normalTexture;
+		std::optional<size_t> sourceIndex;
+		std::optional<size_t> basisuIndex;
 
-		if (normalInfo.has_value()) {
-			const fastgltf::Image &image = asset.images[normalInfo->textureIndex];
-			std::shared_ptr<Image> normalMap(_loadImage(asset, image, file.parent_path()));
+		if (texture.imageIndex.has_value() && texture.imageIndex.value() < asset.images.size())
+			sourceIndex = texture.imageIndex.value();
 
-			if (normalMap != nullptr) {
-				normalMap->convert(Image::Format::RG8);
+		if (texture.basisuImageIndex.has_value() &&
+				texture.basisuImageIndex.value() < asset.images.size())
+			basisuIndex = texture.basisuImageIndex.value();
 
-				uint32_t idx = scene.images.size();
-				scene.images.push_back(normalMap);
-				_material.normalIndex = idx;
-			}
+		// KHR_texture_basisu image is preferred, source is its fallback when it fails to load
+		std::optional<size_t> fallbackIndex;
+
+		if (basisuIndex.has_value() && sourceIndex != basisuIndex)
+			fallbackIndex = sourceIndex;
+
+		if (!basisuIndex.has_value() && !sourceIndex.has_value())
+			return std::nullopt;
+
+		size_t imageIndex = basisuIndex.value_or(sourceIndex.value_or(0));
+
+		std::pair<size_t, ImageUsage> key = { imageIndex, usage };
+		std::map<std::pair<size_t, ImageUsage>, size_t>::iterator it = jobIndices.find(key);
+
+		if (it != jobIndices.end())
+			return it->second;
+
+		size_t job = imageJobs.size();
+		imageJobs.push_back({ imageIndex, usage, {}, 0, {} });
+		jobIndices[key] = job;
+
+		std::map<size_t, size_t>::iterator decodeIt = decodeIndices.find(imageIndex);
+
+		if (decodeIt == decodeIndices.end()) {
+			decodeIt = decodeIndices.insert({ imageIndex, decodeImages.size() }).first;
+			decodeImages.push_back(imageIndex);
+			decodeFallbacks.push_back(fallbackIndex);
+			decodeJobs.emplace_back();
 		}
 
+		decodeJobs[decodeIt->second].push_back(job);
+		return job;
+	};
+
+	for (const fastgltf::Material &material : asset.materials) {
+		MaterialJobs jobs = {};
+
+		const std::optional<fastgltf::TextureInfo> &albedoInfo = material.pbrData.baseColorTexture;
+
+		if (albedoInfo.has_value())
+			jobs.albedoJob = addJob(albedoInfo->textureIndex, ImageUsage::Albedo);
+
+		const std::optional<fastgltf::NormalTextureInfo> &normalInfo = material.normalTexture;
+
+		if (normalInfo.has_value())
+			jobs.normalJob = addJob(normalInfo->textureIndex, ImageUsage::Normal);
+
 		const std::optional<fastgltf::TextureInfo> &metallicRoughnessInfo =
 				material.pbrData.metallicRoughnessTexture;
 
 		if (metallicRoughnessInfo.has_value()) {
-			const fastgltf::Image &image = asset.images[metallicRoughnessInfo->textureIndex];
-			std::shared_ptr<Image> _metallicRoughnessimage(
-					_loadImage(asset, image, file.parent_path()));
+			jobs.metallicRoughnessJob =
+					addJob(metallicRoughnessInfo->textureIndex, ImageUsage::MetallicRoughness);
+		}
 
-			if (_metallicRoughnessimage != nullptr) {
-				{
-					// metallic in blue channel
-					std::shared_ptr<Image> metallicMap(
-							_metallicRoughnessimage->getComponent(Image::Channel::B));
+		materialJobs.push_back(jobs);
+	}
 
-					uint32_t idx = scene.images.size();
-					scene.images.push_back(metallicMap);
+	// images stored as files of their own, read in the background and decoded as they arrive
+	uint32_t decodeCount = static_cast<uint32_t>(decodeImages.size());
+	std::vector<std::optional<uint32_t>> imageReads(decodeCount);
 
-					_material.metallicIndex = idx;
-				}
+	for (uint32_t i = 0; i < decodeCount; i++) {
+		std::filesystem::path path = _getImagePath(asset.images[decodeImages[i]], assetRoot);
+
+		if (!path.empty())
+			imageReads[i] = reader.add(path);
+	}
+
+	reader.submit();
+
+	for (size_t i = 0; i < asset.buffers.size(); i++) {
+		fastgltf::Buffer &buffer = asset.buffers[i];
+		const fastgltf::sources::URI *pFile = std::get_if<fastgltf::sources::URI>(&buffer.data);
+
+		if (pFile == nullptr || !bufferReads[i].has_value())
+			continue;
+
+		std::filesystem::path path(assetRoot / pFile->uri.path().data());
+
+		bufferData.emplace_back();
 
-				{
-					// roughness in green channel
-					std::shared_ptr<Image> roughnessMap(
-							_metallicRoughnessimage->getComponent(Image::Channel::G));
+		const uint8_t *pData = nullptr;
+		size_t size = 0;
 
-					uint32_t idx = scene.images.size();
-					scene.images.push_back(roughnessMap);
+		// packaged buffers are not files of their own
+		if (reader.wait(bufferReads[i].value(), bufferData.back()) ||
+				Package::load(path, bufferData.back())) {
+			pData = bufferData.back().data();
+			size = bufferData.back().size();
+		}
+
+		size_t offset = pFile->fileByteOffset;
+
+		if (pData == nullptr || offset + buffer.byteLength > size) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Asset loading failed: %s is missing",
+					path.c_str());
+
+			return {};
+		}
+
+		fastgltf::sources::ByteView view = {};
+		view.bytes = fastgltf::span<const std::byte>(
+				reinterpret_cast<const std::byte *>(pData + offset), buffer.byteLength);
+		view.mimeType = pFile->mimeType;
+
+		buffer.data = view;
+	}
+
+	if (!_decodeCompressedViews(asset, bufferData))
+		return {};
+
+	// decoding and conversion dominate load time, every image is independent
+	{
+		auto decodeImage = [&](uint32_t decode) {
+			// reads of images left are dropped with reader
+			if (cancel.isCancelled())
+				return;
+
+			const fastgltf::Image *pImage = &asset.images[decodeImages[decode]];
+			std::shared_ptr<Image> decoded;
+
+			std::vector<uint8_t> data;
 
-					_material.roughnessIndex = idx;
+			// packaged or unreadable files go through image loader
+			if (imageReads[decode].has_value() && reader.wait(imageReads[decode].value(), data))
+				decoded = ImageLoader::loadFromMemory(data.data(), data.size());
+			else
+				decoded = _loadImage(asset, *pImage, assetRoot);
+
+			std::optional<size_t> fallback = decodeFallbacks[decode];
+
+			if (decoded == nullptr && fallback.has_value()) {
+				pImage = &asset.images[fallback.value()];
+				decoded = _loadImage(asset, *pImage, assetRoot);
+			}
+
+			if (decoded == nullptr)
+				return;
+
+			// compressed image drops pre-built levels past max size once for all its usages
+			if (Image::isFormatCompressed(decoded->getFormat()))
+				decoded = ImageResampler::limit(decoded, getMaxImageSize());
+
+			const std::vector<size_t> &jobs = decodeJobs[decode];
+			std::filesystem::path path = _getImagePath(*pImage, assetRoot);
+
+			for (size_t i = 0; i < jobs.size(); i++) {
+				ImageJob &imageJob = imageJobs[jobs[i]];
+				imageJob.path = path;
+
+				// compressed images can not be converted, they are expected in layout of their
+				// usage, BC5 for normal and metallic roughness
+				if (Image::isFormatCompressed(decoded->getFormat())) {
+					imageJob.image = decoded;
+
+					// other usages of shared image keep its color space
+					if (imageJob.usage == ImageUsage::Albedo && !decoded->isSrgb()) {
+						if (jobs.size() > 1)
+							imageJob.image = std::make_shared<Image>(*decoded);
+
+						imageJob.image->setSrgb(true);
+					}
+
+					continue;
 				}
+
+				// conversion is in place, last usage takes decoded image itself, packing
+				// metallic roughness makes new image
+				std::shared_ptr<Image> source = decoded;
+
+				if (i < jobs.size() - 1 && imageJob.usage != ImageUsage::MetallicRoughness)
+					source = std::make_shared<Image>(*decoded);
+
+				imageJob.image = _convertImage(source, imageJob.usage);
 			}
+		};
+
+		JobSystem::parallelFor(decodeCount, 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t decode = first; decode < last; decode++)
+				decodeImage(decode);
+		});
+	}
+
+	if (cancel.isCancelled())
+		return {};
+
+	for (ImageJob &imageJob : imageJobs) {
+		if (imageJob.image == nullptr)
+			continue;
+
+		imageJob.sceneIndex = scene.images.size();
+		scene.images.push_back(imageJob.image);
+		scene.imageSources.push_back({ imageJob.path, imageJob.usage });
+	}
+
+	for (size_t i = 0; i < materialJobs.size(); i++) {
+		const MaterialJobs &jobs = materialJobs[i];
+		const fastgltf::Material &material = asset.materials[i];
+
+		Material _material = {};
+		_material.albedoFactor = glm::make_vec4(material.pbrData.baseColorFactor.data());
+		_material.emissiveFactor = glm::make_vec3(material.emissiveFactor.data());
+		_material.metallicFactor = material.pbrData.metallicFactor;
+		_material.roughnessFactor = material.pbrData.roughnessFactor;
+		_material.deriveTangents = deriveTangents;
+
+		if (jobs.albedoJob.has_value()) {
+			const ImageJob &imageJob = imageJobs[jobs.albedoJob.value()];
+
+			if (imageJob.image != nullptr)
+				_material.albedoIndex = imageJob.sceneIndex;
+		}
+
+		if (jobs.normalJob.has_value()) {
+			const ImageJob &imageJob = imageJobs[jobs.normalJob.value()];
+
+			if (imageJob.image != nullptr)
+				_material.normalIndex = imageJob.sceneIndex;
+		}
+
+		if (jobs.metallicRoughnessJob.has_value()) {
+			const ImageJob &imageJob = imageJobs[jobs.metallicRoughnessJob.value()];
+
+			if (imageJob.image != nullptr)
+				_material.metallicRoughnessIndex = imageJob.sceneIndex;
 		}
 
 		scene.materials.push_back(_material);
 	}
 
-	for (const fastgltf::Mesh &mesh : asset.meshes) {
-		Mesh _mesh = _loadMesh(asset, mesh);
-		scene.meshes.push_back(_mesh);
+	// primitives of all meshes share one run, scenes often have many single primitive meshes
+	{
+		typedef struct {
+			size_t mesh;
+			size_t primitive;
+			Primitive result;
+			bool isLoaded;
+		} PrimitiveJob;
+
+		std::vector<PrimitiveJob> primitiveJobs;
+
+		for (size_t i = 0; i < asset.meshes.size(); i++) {
+			for (size_t j = 0; j < asset.meshes[i].primitives.size(); j++)
+				primitiveJobs.push_back({ i, j, {}, false });
+		}
+
+		uint32_t jobCount = static_cast<uint32_t>(primitiveJobs.size());
+
+		JobSystem::parallelFor(jobCount, 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t job = first; job < last && !cancel.isCancelled(); job++) {
+				PrimitiveJob &primitiveJob = primitiveJobs[job];
+
+				const fastgltf::Mesh &mesh = asset.meshes[primitiveJob.mesh];
+				const fastgltf::Primitive &primitive = mesh.primitives[primitiveJob.primitive];
+
+				primitiveJob.isLoaded = _loadPrimitive(asset, primitive, weldVertices,
+						deriveTangents, *scene.arena, primitiveJob.result);
+			}
+		});
+
+		for (const fastgltf::Mesh &mesh : asset.meshes) {
+			Primitive *pPrimitives = scene.arena->allocate<Primitive>(mesh.primitives.size());
+
+			// asset is freed on return, name has to outlive it like primitives do
+			scene.meshes.push_back(
+					{ pPrimitives, 0, scene.arena->copyString(mesh.name.c_str()) });
+		}
+
+		// skipped primitives leave no gap
+		for (const PrimitiveJob &primitiveJob : primitiveJobs) {
+			if (!primitiveJob.isLoaded)
+				continue;
+
+			Mesh &mesh = scene.meshes[primitiveJob.mesh];
+			mesh.pPrimitives[mesh.primitiveCount++] = primitiveJob.result;
+		}
 	}
 
+	if (cancel.isCancelled())
+		return {};
+
+	// every node not referenced as child starts a subtree, whatever scene it is in
+	std::vector<bool> isChild(asset.nodes.size(), false);
+
 	for (const fastgltf::Node &node : asset.nodes) {
-		glm::mat4 transform = _extractTransform(node);
+		for (size_t child : node.children) {
+			if (child < isChild.size())
+				isChild[child] = true;
+		}
+	}
+
+	typedef struct {
+		size_t node;
+		std::optional<uint64_t> parentIndex;
+	} PendingNode;
+
+	std::vector<PendingNode> pendingNodes;
+
+	for (size_t i = asset.nodes.size(); i > 0; i--) {
+		if (!isChild[i - 1])
+			pendingNodes.push_back({ i - 1, {} });
+	}
+
+	// depth first, malformed graphs with shared children or cycles visit each node once
+	std::vector<bool> isVisited(asset.nodes.size(), false);
+	// scene node of every asset node, skins refer to asset nodes
+	std::vector<uint64_t> nodeIndices(asset.nodes.size(), UINT64_MAX);
+
+	while (!pendingNodes.empty()) {
+		PendingNode pendingNode = pendingNodes.back();
+		pendingNodes.pop_back();
+
+		if (isVisited[pendingNode.node])
+			continue;
+
+		isVisited[pendingNode.node] = true;
+
+		const fastgltf::Node &node = asset.nodes[pendingNode.node];
 		std::string name = node.name.c_str();
 
+		uint64_t nodeIndex = scene.nodes.size();
+		nodeIndices[pendingNode.node] = nodeIndex;
+		scene.nodes.push_back({ _extractTransform(node), pendingNode.parentIndex, name });
+
+		for (size_t i = node.children.size(); i > 0; i--) {
+			size_t child = node.children[i - 1];
+
+			if (child < asset.nodes.size())
+				pendingNodes.push_back({ child, nodeIndex });
+		}
+
 		const fastgltf::Optional<size_t> &meshIndex = node.meshIndex;
 		if (meshIndex.has_value()) {
 			MeshInstance meshInstance = {
-				transform,
+				nodeIndex,
 				node.meshIndex.value(),
 				name,
 			};
 
+			if (node.skinIndex.has_value() && node.skinIndex.value() < asset.skins.size())
+				meshInstance.skinIndex = node.skinIndex.value();
+
+			// one weight per target, missing ones are zero
+			if (meshIndex.value() < asset.meshes.size()) {
+				const fastgltf::Mesh &mesh = asset.meshes[meshIndex.value()];
+				size_t targetCount = mesh.primitives.empty() ? 0 : mesh.primitives[0].targets.size();
+				const auto &weights = node.weights.empty() ? mesh.weights : node.weights;
+
+				meshInstance.morphWeights.assign(targetCount, 0.0f);
+
+				for (size_t i = 0; i < targetCount && i < weights.size(); i++)
+					meshInstance.morphWeights[i] = static_cast<float>(weights[i]);
+			}
+
 			scene.meshInstances.push_back(meshInstance);
 		}
 
@@ -343,7 +1508,7 @@ Scene AssetLoader::loadGltf(const std::filesystem::path &file) {
 			}
 
 			Light _light = {
-				transform,
+				nodeIndex,
 				lightType,
 				color,
 				intensity,
@@ -355,5 +1520,46 @@ Scene AssetLoader::loadGltf(const std::filesystem::path &file) {
 		}
 	}
 
+	// joint never reached by traversal leaves skin empty, its instances stay in bind pose
+	for (const fastgltf::Skin &skin : asset.skins) {
+		Skin _skin = {};
+		_skin.name = skin.name.c_str();
+		_skin.inverseBindMatrices.assign(skin.joints.size(), glm::mat4(1.0f));
+
+		for (size_t joint : skin.joints) {
+			if (joint >= nodeIndices.size() || nodeIndices[joint] == UINT64_MAX) {
+				_skin.joints.clear();
+				break;
+			}
+
+			_skin.joints.push_back(nodeIndices[joint]);
+		}
+
+		// missing matrices are identity
+		if (skin.inverseBindMatrices.has_value()) {
+			const fastgltf::Accessor &accessor =
+					asset.accessors[skin.inverseBindMatrices.value()];
+
+			if (accessor.bufferViewIndex.has_value() && accessor.count == skin.joints.size()) {
+				fastgltf::iterateAccessorWithIndex<glm::mat4>(
+						asset, accessor, [&](const glm::mat4 &matrix, size_t idx) {
+							_skin.inverseBindMatrices[idx] = matrix;
+						});
+			}
+		}
+
+		if (_skin.joints.empty())
+			_skin.inverseBindMatrices.clear();
+
+		scene.skins.push_back(std::move(_skin));
+	}
+
+	for (const fastgltf::Animation &animation : asset.animations) {
+		AnimationClip clip = _loadAnimation(asset, animation, nodeIndices);
+
+		if (!clip.targets.empty())
+			scene.animations.push_back(std::move(clip));
+	}
+
 	return scene;
 }
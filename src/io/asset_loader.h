@@ -3,15 +3,24 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <future>
 #include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include <job_system.h>
+#include <rendering/types/aabb.h>
 #include <rendering/types/vertex.h>
 
+#include "animation.h"
+#include "cell_portals.h"
 #include "image.h"
+#include "light_probes.h"
 #include "mesh.h"
+#include "mesh_arena.h"
+
+class MappedFile;
 
 namespace AssetLoader {
 
@@ -20,22 +29,73 @@ enum class LightType {
 	Point,
 };
 
+enum class ImageUsage {
+	Albedo,
+	Normal,
+	MetallicRoughness,
+};
+
+// file image was decoded from and usage it was converted for, see loadImage
+struct ImageSource {
+	// empty for images embedded in scene or its buffers
+	std::filesystem::path path;
+	ImageUsage usage = ImageUsage::Albedo;
+};
+
 struct Material {
 	std::optional<uint64_t> albedoIndex;
 	std::optional<uint64_t> normalIndex;
-	std::optional<uint64_t> metallicIndex;
-	std::optional<uint64_t> roughnessIndex;
+	// metallic in red channel, roughness in green channel
+	std::optional<uint64_t> metallicRoughnessIndex;
+	// RGBA16F irradiance of baked lights, see LightmapBaker
+	std::optional<uint64_t> lightmapIndex;
+
+	// maps are multiplied by factors, missing ones take factor alone
+	glm::vec4 albedoFactor = glm::vec4(1.0f);
+	glm::vec3 emissiveFactor = glm::vec3(0.0f);
+	float metallicFactor = 1.0f;
+	float roughnessFactor = 1.0f;
+
+	// offset and size of map within its image, set for images packed by TextureAtlas
+	glm::vec4 albedoRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	glm::vec4 normalRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	glm::vec4 metallicRoughnessRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+	// normal map is applied in tangent frame derived per pixel, primitives keep zero tangents
+	bool deriveTangents = false;
+
 	std::string name;
 };
 
-struct MeshInstance {
+// depth first, parent comes before node and its subtree right after it
+struct Node {
+	// local to parent
 	glm::mat4 transform;
+	std::optional<uint64_t> parentIndex;
+	std::string name;
+};
+
+struct MeshInstance {
+	uint64_t nodeIndex;
 	uint64_t meshIndex;
 	std::string name;
+
+	// mesh is posed by joints of skin, node transform is ignored for it as glTF asks
+	std::optional<uint64_t> skinIndex;
+	// of morph targets of mesh, from node or else from mesh, empty for mesh without them
+	std::vector<float> morphWeights;
+};
+
+// joints are nodes, joints of vertices index into them
+struct Skin {
+	std::vector<uint64_t> joints;
+	// from mesh space into space of each joint at bind pose
+	std::vector<glm::mat4> inverseBindMatrices;
+	std::string name;
 };
 
 struct Light {
-	glm::mat4 transform;
+	uint64_t nodeIndex;
 	LightType type;
 
 	glm::vec3 color;
@@ -43,17 +103,88 @@ struct Light {
 
 	std::optional<float> range;
 	std::string name;
+
+	// in lightmaps, left out of runtime lighting
+	bool isBaked = false;
 };
 
 struct Scene {
 	std::vector<std::shared_ptr<Image>> images;
 	std::vector<Material> materials;
 	std::vector<Mesh> meshes;
+	std::vector<Node> nodes;
 	std::vector<MeshInstance> meshInstances;
+	std::vector<Skin> skins;
 	std::vector<Light> lights;
+	// empty unless baked by LightProbeBaker
+	LightProbeGrid lightProbes;
+	// from nodes named as CellPortalBaker expects, potentially visible set empty unless baked
+	CellPortalGraph cellPortals;
+	// clips of glTF scene, channels target nodes of scene
+	std::vector<AnimationClip> animations;
+
+	// per image of glTF scene, packing images into atlases clears them
+	std::vector<ImageSource> imageSources;
+	// external buffers of glTF scene, reading them again reads its meshes again
+	std::vector<std::filesystem::path> bufferPaths;
+
+	// primitives and mesh names of cooked scene point into it
+	std::shared_ptr<MappedFile> file;
+	// owns arrays of meshes and their names, released with scene once meshes are created
+	std::shared_ptr<MeshArena> arena;
+};
+
+// what scanGltf reads out of json alone, counts are of triangle primitives
+struct SceneInfo {
+	uint32_t meshCount = 0;
+	uint32_t primitiveCount = 0;
+	uint32_t materialCount = 0;
+	uint32_t textureCount = 0;
+	uint32_t imageCount = 0;
+	uint32_t nodeCount = 0;
+	uint32_t meshInstanceCount = 0;
+
+	// every mesh once
+	uint64_t vertexCount = 0;
+	uint64_t triangleCount = 0;
+	// every instance of every mesh, what drawing scene draws at full detail
+	uint64_t instancedTriangleCount = 0;
+
+	// encoded size of images, external ones are only looked up in file system
+	uint64_t imageByteCount = 0;
+
+	// world space, from position bounds of accessors, invalid while hasBounds is false
+	AABB bounds;
+	bool hasBounds = false;
 };
 
-Scene loadGltf(const std::filesystem::path &file);
+// parses json and accessor metadata only, mapped buffers are never read and images never
+// opened, fraction of load for listing many files, nullopt when file is no glTF scene
+std::optional<SceneInfo> scanGltf(const std::filesystem::path &file);
+
+// welding merges duplicate vertices, cooked scenes keep welded primitives, with deriveTangents
+// materials derive tangent frames per pixel and no vertex tangents are generated, cancelled
+// load returns empty scene
+Scene loadGltf(const std::filesystem::path &file, bool weldVertices = true,
+		bool deriveTangents = false, const CancelToken &cancel = {});
+// on background job of job system
+std::future<Scene> loadGltfAsync(const std::filesystem::path &file, bool weldVertices = true,
+		bool deriveTangents = false, const CancelToken &cancel = {});
+
+// decoded and converted like images of loadGltf, nullptr for embedded or missing ones
+std::shared_ptr<Image> loadImage(const ImageSource &source);
+
+// largest side of images loaded from then on, by every load function, larger ones are resampled
+// or drop pre-built levels past it, see ImageResampler::limit, 0 keeps them as they are
+void setMaxImageSize(uint32_t size);
+uint32_t getMaxImageSize();
+
+// .hyk written by cook, vertex and index blobs are used in place and images need no decoding
+Scene loadCooked(const std::filesystem::path &file);
+bool cook(const Scene &scene, const std::filesystem::path &file);
+
+// from uv gradients of triangles, zero where every triangle of vertex has degenerate uv
+void generateTangents(const IndexArray &indices, VertexArray &vertices);
 
 } // namespace AssetLoader
 
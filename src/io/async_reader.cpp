@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+#include <SDL3/SDL_log.h>
+
+#include "async_reader.h"
+
+// of submission queue, completion queue is twice as large
+const uint32_t RING_ENTRIES = 64;
+// large enough for device to stream, small enough for a file to span the queue
+const uint32_t CHUNK_SIZE = 1024 * 1024;
+// of data read ahead of waits, file waited for is read past it
+const size_t MAX_BUFFERED_SIZE = 256 * 1024 * 1024;
+
+#ifdef __linux__
+
+// raw system calls, liburing is not needed for plain reads
+static int _setup(uint32_t entries, io_uring_params *pParams) {
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, pParams));
+}
+
+static int _enter(int ring, uint32_t submitCount, uint32_t waitCount, uint32_t flags) {
+	return static_cast<int>(
+			syscall(__NR_io_uring_enter, ring, submitCount, waitCount, flags, nullptr, 0));
+}
+
+#endif
+
+bool AsyncReader::_readFile(
+		const std::filesystem::path &path, size_t padding, std::vector<uint8_t> &data) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(info.st_size);
+	data.assign(size + padding, 0);
+
+	size_t offset = 0;
+
+	while (offset < size) {
+		ssize_t count = pread(fd, data.data() + offset, size - offset, offset);
+
+		if (count < 0 && errno == EINTR)
+			continue;
+
+		if (count <= 0)
+			break;
+
+		offset += static_cast<size_t>(count);
+	}
+
+	::close(fd);
+
+	if (offset < size) {
+		data.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void AsyncReader::_start(uint32_t index, bool isUrgent) {
+	File &file = _files[index];
+	file.fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	struct stat info;
+
+	// empty files fail like they do when mapped
+	if (file.fd < 0 || fstat(file.fd, &info) != 0 || info.st_size == 0) {
+		_finish(file);
+		file.state = State::Failed;
+		return;
+	}
+
+	file.size = static_cast<size_t>(info.st_size);
+	file.data.assign(file.size + file.padding, 0);
+	file.state = State::Reading;
+
+	_bufferedSize += file.size;
+
+	if (isUrgent)
+		_submitting.push_front(index);
+	else
+		_submitting.push_back(index);
+}
+
+void AsyncReader::_finish(File &file) {
+	if (file.fd >= 0) {
+		::close(file.fd);
+		file.fd = -1;
+	}
+
+	if (file.state != State::Reading)
+		return;
+
+	file.state = file.isFailed ? State::Failed : State::Done;
+
+	if (file.isFailed) {
+		_bufferedSize -= file.size;
+		file.data = {};
+	}
+}
+
+void AsyncReader::_queueRead(uint32_t slot, const Chunk &chunk) {
+#ifdef __linux__
+	File &file = _files[chunk.file];
+	_slots[slot] = chunk;
+
+	// only this thread moves tail, kernel reads it
+	uint32_t tail = *_pSqTail;
+	uint32_t index = tail & _sqMask;
+
+	io_uring_sqe &sqe = _pSqes[index];
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_READ;
+	sqe.fd = file.fd;
+	sqe.off = chunk.offset;
+	sqe.addr = reinterpret_cast<uint64_t>(file.data.data() + chunk.offset);
+	sqe.len = chunk.size;
+	sqe.user_data = slot;
+
+	_pSqArray[index] = index;
+	__atomic_store_n(_pSqTail, tail + 1, __ATOMIC_RELEASE);
+
+	_inFlight++;
+	_unsubmitted++;
+#endif
+}
+
+void AsyncReader::_fill() {
+	while (!_freeSlots.empty()) {
+		if (_submitting.empty()) {
+			while (_nextFile < _files.size() && _files[_nextFile].state != State::Queued)
+				_nextFile++;
+
+			if (_nextFile == _files.size() || _bufferedSize >= MAX_BUFFERED_SIZE)
+				break;
+
+			_start(_nextFile, false);
+			continue;
+		}
+
+		uint32_t index = _submitting.front();
+		File &file = _files[index];
+
+		Chunk chunk;
+		chunk.file = index;
+		chunk.offset = file.submitted;
+		chunk.size = static_cast<uint32_t>(
+				std::min<size_t>(CHUNK_SIZE, file.size - file.submitted));
+
+		uint32_t slot = _freeSlots.back();
+		_freeSlots.pop_back();
+
+		_queueRead(slot, chunk);
+
+		file.submitted += chunk.size;
+		file.pendingChunks++;
+
+		if (file.submitted == file.size)
+			_submitting.pop_front();
+	}
+
+	_flush();
+}
+
+void AsyncReader::_flush() {
+#ifdef __linux__
+	while (_unsubmitted > 0) {
+		int count = _enter(_ring, _unsubmitted, 0, 0);
+
+		if (count < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				continue;
+
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Read submission failed: %s",
+					strerror(errno));
+			return;
+		}
+
+		_unsubmitted -= static_cast<uint32_t>(count);
+	}
+#endif
+}
+
+bool AsyncReader::_reap(bool wait) {
+#ifdef __linux__
+	_flush();
+
+	// kernel never saw some reads, waiting for them would block forever
+	if (wait && _unsubmitted > 0)
+		return false;
+
+	uint32_t head = *_pCqHead;
+	uint32_t tail = __atomic_load_n(_pCqTail, __ATOMIC_ACQUIRE);
+
+	while (wait && head == tail) {
+		int result = _enter(_ring, 0, 1, IORING_ENTER_GETEVENTS);
+
+		if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Read completion failed: %s",
+					strerror(errno));
+			return false;
+		}
+
+		tail = __atomic_load_n(_pCqTail, __ATOMIC_ACQUIRE);
+	}
+
+	for (; head != tail; head++) {
+		const io_uring_cqe &cqe = _pCqes[head & _cqMask];
+
+		uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+		Chunk chunk = _slots[slot];
+		File &file = _files[chunk.file];
+
+		_inFlight--;
+
+		// short read, rest of chunk is read again in the same slot
+		if (cqe.res > 0 && static_cast<uint32_t>(cqe.res) < chunk.size) {
+			chunk.offset += static_cast<uint32_t>(cqe.res);
+			chunk.size -= static_cast<uint32_t>(cqe.res);
+
+			_queueRead(slot, chunk);
+			continue;
+		}
+
+		_freeSlots.push_back(slot);
+
+		// end of file before its size, file was truncated while being read
+		if (cqe.res <= 0)
+			file.isFailed = true;
+
+		file.pendingChunks--;
+
+		if (file.pendingChunks == 0 && file.submitted == file.size)
+			_finish(file);
+	}
+
+	__atomic_store_n(_pCqHead, head, __ATOMIC_RELEASE);
+#endif
+
+	return true;
+}
+
+uint32_t AsyncReader::add(const std::filesystem::path &path, size_t padding) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	File file = {};
+	file.path = path;
+	file.padding = padding;
+	file.state = State::Queued;
+	file.fd = -1;
+
+	_files.push_back(std::move(file));
+	return static_cast<uint32_t>(_files.size() - 1);
+}
+
+void AsyncReader::submit() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_ring >= 0)
+		_fill();
+}
+
+bool AsyncReader::wait(uint32_t index, std::vector<uint8_t> &data) {
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	if (index >= _files.size())
+		return false;
+
+	File &file = _files[index];
+
+	// read outside of lock, threads waiting for different files read them in parallel
+	if (_ring < 0) {
+		if (file.state != State::Queued)
+			return false;
+
+		file.state = State::Taken;
+		std::filesystem::path path = file.path;
+		size_t padding = file.padding;
+
+		lock.unlock();
+		return _readFile(path, padding, data);
+	}
+
+	// reads of files started before it go on, this one is submitted first
+	if (file.state == State::Queued) {
+		_start(index, true);
+	} else {
+		auto it = std::find(_submitting.begin(), _submitting.end(), index);
+
+		if (it != _submitting.end()) {
+			_submitting.erase(it);
+			_submitting.push_front(index);
+		}
+	}
+
+	while (file.state == State::Reading) {
+		_fill();
+
+		if (!_reap(true))
+			return false;
+	}
+
+	if (file.state != State::Done)
+		return false;
+
+	data = std::move(file.data);
+	file.data = {};
+	file.state = State::Taken;
+	_bufferedSize -= file.size;
+
+	// budget it held goes to files read ahead
+	_fill();
+
+	return true;
+}
+
+bool AsyncReader::isAsync() const {
+	return _ring >= 0;
+}
+
+AsyncReader::AsyncReader() {
+#ifdef __linux__
+	io_uring_params params = {};
+	int ring = _setup(RING_ENTRIES, &params);
+
+	if (ring < 0)
+		return;
+
+	_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	bool isSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+	if (isSingleMap)
+		_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+	void *pSqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	void *pCqRing = pSqRing;
+
+	if (!isSingleMap && pSqRing != MAP_FAILED)
+		pCqRing = mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+
+	_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+	void *pSqes = MAP_FAILED;
+
+	if (pCqRing != MAP_FAILED)
+		pSqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ring, IORING_OFF_SQES);
+
+	if (pSqes == MAP_FAILED) {
+		if (pCqRing != MAP_FAILED && pCqRing != pSqRing)
+			munmap(pCqRing, _cqRingSize);
+
+		if (pSqRing != MAP_FAILED)
+			munmap(pSqRing, _sqRingSize);
+
+		::close(ring);
+		return;
+	}
+
+	_pSqRing = pSqRing;
+	_pCqRing = pCqRing;
+	_pSqes = static_cast<io_uring_sqe *>(pSqes);
+
+	uint8_t *pSq = static_cast<uint8_t *>(pSqRing);
+	_pSqTail = reinterpret_cast<uint32_t *>(pSq + params.sq_off.tail);
+	_pSqArray = reinterpret_cast<uint32_t *>(pSq + params.sq_off.array);
+	_sqMask = *reinterpret_cast<uint32_t *>(pSq + params.sq_off.ring_mask);
+
+	uint8_t *pCq = static_cast<uint8_t *>(pCqRing);
+	_pCqHead = reinterpret_cast<uint32_t *>(pCq + params.cq_off.head);
+	_pCqTail = reinterpret_cast<uint32_t *>(pCq + params.cq_off.tail);
+	_pCqes = reinterpret_cast<io_uring_cqe *>(pCq + params.cq_off.cqes);
+	_cqMask = *reinterpret_cast<uint32_t *>(pCq + params.cq_off.ring_mask);
+
+	// completions never overflow, every slot is in flight at most once
+	uint32_t slotCount = std::min(params.sq_entries, params.cq_entries);
+	_slots.resize(slotCount);
+
+	for (uint32_t i = 0; i < slotCount; i++)
+		_freeSlots.push_back(slotCount - 1 - i);
+
+	_ring = ring;
+#endif
+}
+
+AsyncReader::~AsyncReader() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// kernel writes into data of files until their chunks complete
+	while (_inFlight > 0 && _reap(true)) {
+	}
+
+	for (File &file : _files) {
+		if (file.fd >= 0)
+			::close(file.fd);
+	}
+
+	if (_ring < 0)
+		return;
+
+	munmap(_pSqes, _sqesSize);
+
+	if (_pCqRing != _pSqRing)
+		munmap(_pCqRing, _cqRingSize);
+
+	munmap(_pSqRing, _sqRingSize);
+	::close(_ring);
+}
@@ -0,0 +1,120 @@
+#ifndef ASYNC_READER_H
+#define ASYNC_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Reads whole files into memory with many requests in flight. On Linux reads go through an
+// io_uring, files are split into chunks so a single large one keeps device queue full too, cold
+// loads are bound by latency of each read otherwise. Files are read in order they were added,
+// ahead of waits as long as unclaimed data fits budget, file waited for is read next. Without
+// io_uring, kernels or containers refusing it, thread waiting for file reads it. Any thread,
+// reads in flight are finished before reader is destroyed.
+class AsyncReader {
+private:
+	enum class State {
+		Queued,
+		Reading,
+		Done,
+		Failed,
+		Taken,
+	};
+
+	typedef struct {
+		std::filesystem::path path;
+		size_t padding;
+		State state;
+
+		int fd;
+		// of file, without padding
+		size_t size;
+		std::vector<uint8_t> data;
+
+		// next chunk starts there
+		size_t submitted;
+		uint32_t pendingChunks;
+		bool isFailed;
+	} File;
+
+	// read of slot in flight, user data of its submission
+	typedef struct {
+		uint32_t file;
+		size_t offset;
+		uint32_t size;
+	} Chunk;
+
+	std::mutex _mutex;
+	// references stay valid as files are added
+	std::deque<File> _files;
+	// first file not yet started in order of adding
+	uint32_t _nextFile = 0;
+	// started files with chunks left to submit, waited ones go first
+	std::deque<uint32_t> _submitting;
+	// of files read or being read and not yet taken
+	size_t _bufferedSize = 0;
+
+	std::vector<Chunk> _slots;
+	std::vector<uint32_t> _freeSlots;
+	uint32_t _inFlight = 0;
+	// queued into ring, not yet passed to kernel
+	uint32_t _unsubmitted = 0;
+
+	// -1 without io_uring
+	int _ring = -1;
+
+	void *_pSqRing = nullptr;
+	size_t _sqRingSize = 0;
+	void *_pCqRing = nullptr;
+	size_t _cqRingSize = 0;
+	io_uring_sqe *_pSqes = nullptr;
+	size_t _sqesSize = 0;
+
+	uint32_t *_pSqTail = nullptr;
+	uint32_t *_pSqArray = nullptr;
+	uint32_t _sqMask = 0;
+
+	uint32_t *_pCqHead = nullptr;
+	uint32_t *_pCqTail = nullptr;
+	io_uring_cqe *_pCqes = nullptr;
+	uint32_t _cqMask = 0;
+
+	// opens file and sizes its data, urgent file is read before others started earlier
+	void _start(uint32_t index, bool isUrgent);
+	void _finish(File &file);
+
+	void _queueRead(uint32_t slot, const Chunk &chunk);
+	// submits chunks while slots are free, starting files within budget
+	void _fill();
+	void _flush();
+	// handles completions, with wait blocks for at least one, false once ring fails
+	bool _reap(bool wait);
+
+	static bool _readFile(const std::filesystem::path &path, size_t padding,
+			std::vector<uint8_t> &data);
+
+public:
+	AsyncReader(AsyncReader const &) = delete;
+	void operator=(AsyncReader const &) = delete;
+
+	// index of file, padding bytes after its end are zero, read once submitted
+	uint32_t add(const std::filesystem::path &path, size_t padding = 0);
+	// starts reading files added so far
+	void submit();
+
+	// blocks until file is read, its data is moved out, once, false when it can not be read
+	bool wait(uint32_t file, std::vector<uint8_t> &data);
+
+	bool isAsync() const;
+
+	AsyncReader();
+	~AsyncReader();
+};
+
+#endif // !ASYNC_READER_H
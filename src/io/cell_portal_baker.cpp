@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <SDL3/SDL_log.h>
+
+#include <job_system.h>
+#include <profiler.h>
+#include <rendering/culling/portal_culler.h>
+#include <rendering/types/aabb.h>
+
+#include "cell_portal_baker.h"
+#include "scene_raycaster.h"
+
+// sample points keep off faces cells share with neighbours
+const float PVS_SAMPLE_INSET = 0.02f;
+
+static uint32_t _findCell(const CellPortalGraph &graph, const glm::vec3 &point) {
+	for (uint32_t i = 0; i < graph.cells.size(); i++) {
+		const CellPortalGraph::Cell &cell = graph.cells[i];
+
+		if (glm::all(glm::greaterThanEqual(point, cell.min)) &&
+				glm::all(glm::lessThanEqual(point, cell.max)))
+			return i;
+	}
+
+	return PORTAL_NO_CELL;
+}
+
+CellPortalGraph CellPortalBaker::build(const AssetLoader::Scene &scene) {
+	CellPortalGraph graph = {};
+	std::vector<glm::mat4> worldTransforms = SceneRaycaster::computeWorldTransforms(scene);
+
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		if (scene.nodes[i].name.rfind(CELL_NODE_PREFIX, 0) != 0)
+			continue;
+
+		AABB aabb = AABB{ glm::vec3(-1.0f), glm::vec3(1.0f) }.transformed(worldTransforms[i]);
+		graph.cells.push_back({ aabb.min, aabb.max });
+	}
+
+	if (graph.cells.empty())
+		return graph;
+
+	uint32_t droppedCount = 0;
+
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		if (scene.nodes[i].name.rfind(PORTAL_NODE_PREFIX, 0) != 0)
+			continue;
+
+		const glm::mat4 &transform = worldTransforms[i];
+		const glm::vec2 corners[4] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f },
+			{ -1.0f, 1.0f } };
+
+		CellPortalGraph::Portal portal = {};
+
+		for (uint32_t j = 0; j < 4; j++)
+			portal.corners[j] = glm::vec3(transform * glm::vec4(corners[j], 0.0f, 1.0f));
+
+		glm::vec3 center = glm::vec3(transform[3]);
+		glm::vec3 normal = glm::normalize(glm::vec3(transform[2]));
+
+		portal.cells[0] = _findCell(graph, center + normal * PORTAL_PROBE_DISTANCE);
+		portal.cells[1] = _findCell(graph, center - normal * PORTAL_PROBE_DISTANCE);
+
+		if (portal.cells[0] == PORTAL_NO_CELL || portal.cells[1] == PORTAL_NO_CELL ||
+				portal.cells[0] == portal.cells[1]) {
+			droppedCount++;
+			continue;
+		}
+
+		graph.portals.push_back(portal);
+	}
+
+	SDL_Log("Built %u cells and %u portals, %u portals join no two cells",
+			static_cast<uint32_t>(graph.cells.size()), static_cast<uint32_t>(graph.portals.size()),
+			droppedCount);
+
+	return graph;
+}
+
+void CellPortalBaker::bake(CellPortalGraph &graph, uint32_t sampleCount) {
+	PROFILE_ZONE("pvs bake");
+
+	uint32_t cellCount = static_cast<uint32_t>(graph.cells.size());
+	uint32_t wordCount = (cellCount + 63) / 64;
+
+	graph.pvs.clear();
+	graph.pvsWordCount = 0;
+
+	if (cellCount == 0)
+		return;
+
+	sampleCount = std::max(sampleCount, 2u);
+
+	// faces of cube around sample point, 90 degrees wide, planes face inside
+	const glm::vec3 axes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f } };
+
+	std::vector<uint64_t> pvs(size_t(cellCount) * wordCount, 0);
+
+	JobSystem::parallelFor(cellCount, 1, [&](uint32_t first, uint32_t last) {
+		// traversal keeps scratch state, one culler per range
+		PortalCuller culler;
+		culler.set(graph);
+
+		std::vector<uint64_t> visible;
+
+		for (uint32_t i = first; i < last; i++) {
+			const CellPortalGraph::Cell &cell = graph.cells[i];
+			uint64_t *pRow = &pvs[size_t(i) * wordCount];
+
+			pRow[i / 64] |= uint64_t(1) << (i % 64);
+
+			glm::vec3 min = glm::mix(cell.min, cell.max, PVS_SAMPLE_INSET);
+			glm::vec3 max = glm::mix(cell.max, cell.min, PVS_SAMPLE_INSET);
+
+			for (uint32_t s = 0; s < sampleCount * sampleCount * sampleCount; s++) {
+				glm::uvec3 index = glm::uvec3(s % sampleCount, (s / sampleCount) % sampleCount,
+						s / (sampleCount * sampleCount));
+				glm::vec3 eye = glm::mix(min, max, glm::vec3(index) / float(sampleCount - 1));
+
+				for (uint32_t face = 0; face < 6; face++) {
+					glm::vec3 forward = axes[face / 2] * (face % 2 == 0 ? 1.0f : -1.0f);
+					glm::vec3 right = axes[(face / 2 + 1) % 3];
+					glm::vec3 up = axes[(face / 2 + 2) % 3];
+
+					glm::vec3 normals[4] = { forward - right, forward + right, forward - up,
+						forward + up };
+					glm::vec4 planes[4];
+
+					for (uint32_t p = 0; p < 4; p++) {
+						glm::vec3 n = glm::normalize(normals[p]);
+						planes[p] = glm::vec4(n, -glm::dot(n, eye));
+					}
+
+					culler.traverse(eye, planes, 4, visible);
+
+					for (uint32_t w = 0; w < wordCount; w++)
+						pRow[w] |= visible[w];
+				}
+			}
+
+			// eye outside every cell sets bits past last cell as well
+			if (cellCount % 64 != 0)
+				pRow[wordCount - 1] &= (uint64_t(1) << (cellCount % 64)) - 1;
+		}
+	});
+
+	graph.pvs = std::move(pvs);
+	graph.pvsWordCount = wordCount;
+
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = 0; i < cellCount; i++) {
+		for (uint32_t j = 0; j < cellCount; j++)
+			visibleCount += static_cast<uint32_t>(
+					(graph.pvs[size_t(i) * wordCount + j / 64] >> (j % 64)) & 1);
+	}
+
+	SDL_Log("Baked potentially visible set of %u cells, %.1f visible from each on average",
+			cellCount, static_cast<float>(visibleCount) / static_cast<float>(cellCount));
+}
@@ -0,0 +1,34 @@
+#ifndef CELL_PORTAL_BAKER_H
+#define CELL_PORTAL_BAKER_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "asset_loader.h"
+#include "cell_portals.h"
+
+// nodes named with these prefixes author cells and portals, cell is cube from -1 to 1 and
+// portal is quad from -1 to 1 on xy plane of node, both in world space of node
+const char CELL_NODE_PREFIX[] = "cell_";
+const char PORTAL_NODE_PREFIX[] = "portal_";
+
+// portal joins cells found this far in front of and behind its center
+const float PORTAL_PROBE_DISTANCE = 0.25f;
+
+// points per axis sampled within each cell, first and last lie just inside its corners
+const uint32_t PVS_SAMPLE_COUNT = 4;
+
+// Builds CellPortalGraph of a scene from its nodes and bakes potentially visible set of it on the
+// CPU. Every sample point of a cell traverses portals within six faces of a cube around it, so
+// set is sampled, cells seen only between sample points may be missed. Cells run in parallel on
+// JobSystem.
+class CellPortalBaker {
+public:
+	// portals not joining two cells are dropped
+	static CellPortalGraph build(const AssetLoader::Scene &scene);
+
+	static void bake(CellPortalGraph &graph, uint32_t sampleCount = PVS_SAMPLE_COUNT);
+};
+
+#endif // !CELL_PORTAL_BAKER_H
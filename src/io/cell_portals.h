@@ -0,0 +1,34 @@
+#ifndef CELL_PORTALS_H
+#define CELL_PORTALS_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Interior split into box cells joined by quad portals, see CellPortalBaker. Runtime sees
+// through portals the camera frustum passes, or looks rows of potentially visible set up when
+// it was baked. Empty graph leaves every instance visible.
+struct CellPortalGraph {
+	typedef struct {
+		glm::vec3 min;
+		glm::vec3 max;
+	} Cell;
+
+	typedef struct {
+		// joined cells, portal is seen through from either side
+		uint32_t cells[2];
+		// world space, in order around quad
+		glm::vec3 corners[4];
+	} Portal;
+
+	std::vector<Cell> cells;
+	std::vector<Portal> portals;
+
+	// row of pvsWordCount words per cell, bit of every cell seen from anywhere within it, empty
+	// unless baked
+	std::vector<uint64_t> pvs;
+	uint32_t pvsWordCount = 0;
+};
+
+#endif // !CELL_PORTALS_H
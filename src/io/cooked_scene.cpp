@@ -0,0 +1,989 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+
+#include <profiler.h>
+
+#include "mapped_file.h"
+#include "image_resampler.h"
+#include "mesh.h"
+#include "texture_compressor.h"
+
+#include "asset_loader.h"
+
+using namespace AssetLoader;
+
+const char COOKED_MAGIC[4] = { 'H', 'Y', 'K', 'S' };
+const uint32_t COOKED_VERSION = 16;
+
+// vertex and index arrays are used in place, mapping itself is page aligned
+const size_t COOKED_BLOB_ALIGNMENT = 16;
+
+// absent optional index or range
+const uint64_t COOKED_NONE = UINT64_MAX;
+
+// records follow header in this order: images, materials, meshes, primitives, nodes, mesh
+// instances, skins, lights, light probe grid, cell portal graph, animations, then blob section
+// holding pixels, vertices, indices, meshlets, levels of detail, morph deltas, joints, weights,
+// names, probes, cells, portals, potentially visible set and animation frames
+typedef struct {
+	char magic[4];
+	uint32_t version;
+
+	uint32_t imageCount;
+	uint32_t materialCount;
+	uint32_t meshCount;
+	uint32_t primitiveCount;
+	uint32_t nodeCount;
+	uint32_t meshInstanceCount;
+	uint32_t lightCount;
+	uint32_t skinCount;
+	uint32_t animationCount;
+	uint32_t _padding;
+
+	uint64_t blobOffset;
+	uint64_t blobSize;
+} CookedHeader;
+
+// offsets are relative to blob section, names are null terminated
+typedef struct {
+	uint64_t offset;
+	uint64_t size;
+} CookedBlob;
+
+// pixels are stored in the format they are uploaded in
+typedef struct {
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t mipLevels;
+	// uploaded with sRGB format, albedo
+	uint32_t isSrgb;
+	uint32_t _padding;
+
+	// every level, at Image::getLevelOffset
+	CookedBlob data;
+} CookedImage;
+
+typedef struct {
+	uint64_t albedoIndex;
+	uint64_t normalIndex;
+	uint64_t metallicRoughnessIndex;
+	uint64_t lightmapIndex;
+
+	glm::vec4 albedoFactor;
+	glm::vec3 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	// 0 or 1
+	uint32_t deriveTangents;
+
+	glm::vec4 albedoRect;
+	glm::vec4 normalRect;
+	glm::vec4 metallicRoughnessRect;
+
+	CookedBlob name;
+} CookedMaterial;
+
+typedef struct {
+	uint32_t firstPrimitive;
+	uint32_t primitiveCount;
+
+	CookedBlob name;
+} CookedMesh;
+
+typedef struct {
+	CookedBlob vertices;
+	CookedBlob indices;
+	CookedBlob meshlets;
+
+	// array of CookedLod
+	CookedBlob lods;
+	// array of CookedMorphTarget
+	CookedBlob morphTargets;
+
+	uint64_t materialIndex;
+} CookedPrimitive;
+
+typedef struct {
+	CookedBlob indices;
+
+	float error;
+	uint32_t _padding;
+} CookedLod;
+
+// array of MorphDelta, used in place like vertices
+typedef struct {
+	CookedBlob deltas;
+} CookedMorphTarget;
+
+typedef struct {
+	glm::mat4 transform;
+	uint64_t parentIndex;
+
+	CookedBlob name;
+} CookedNode;
+
+typedef struct {
+	uint64_t nodeIndex;
+	uint64_t meshIndex;
+	uint64_t skinIndex;
+	// floats
+	CookedBlob morphWeights;
+
+	CookedBlob name;
+} CookedMeshInstance;
+
+typedef struct {
+	// node indices as uint64_t, then one matrix per joint
+	CookedBlob joints;
+	CookedBlob inverseBindMatrices;
+
+	CookedBlob name;
+} CookedSkin;
+
+typedef struct {
+	uint64_t nodeIndex;
+	uint32_t type;
+
+	glm::vec3 color;
+	float intensity;
+
+	float range;
+	uint32_t hasRange;
+	uint32_t isBaked;
+
+	CookedBlob name;
+} CookedLight;
+
+// always present, counts are 0 for scene without probes
+typedef struct {
+	glm::vec3 origin;
+	glm::vec3 spacing;
+	glm::uvec3 counts;
+	uint32_t _padding;
+
+	CookedBlob probes;
+} CookedLightProbes;
+
+// always present, counts are 0 for scene without cells, pvs is empty unless baked
+typedef struct {
+	uint32_t cellCount;
+	uint32_t portalCount;
+	uint32_t pvsWordCount;
+	uint32_t _padding;
+
+	CookedBlob cells;
+	CookedBlob portals;
+	CookedBlob pvs;
+} CookedCellPortals;
+
+// resampled already, frames are read back as they were written
+typedef struct {
+	float duration;
+	uint32_t frameCount;
+	uint32_t translationCount;
+	uint32_t rotationCount;
+	uint32_t scaleCount;
+	uint32_t _padding;
+
+	// array of AnimationClip::Target
+	CookedBlob targets;
+	CookedBlob samples;
+	CookedBlob blendWeights;
+
+	CookedBlob name;
+} CookedAnimation;
+
+static size_t _alignBlob(size_t offset) {
+	return (offset + COOKED_BLOB_ALIGNMENT - 1) / COOKED_BLOB_ALIGNMENT * COOKED_BLOB_ALIGNMENT;
+}
+
+static CookedBlob _appendBlob(std::vector<uint8_t> &blobs, const void *pData, size_t size) {
+	size_t offset = _alignBlob(blobs.size());
+	blobs.resize(offset + size);
+
+	if (size > 0)
+		memcpy(blobs.data() + offset, pData, size);
+
+	return { offset, size };
+}
+
+static CookedBlob _appendName(std::vector<uint8_t> &blobs, const char *pName) {
+	if (pName == nullptr)
+		pName = "";
+
+	// terminator is stored, size excludes it
+	CookedBlob blob = _appendBlob(blobs, pName, strlen(pName) + 1);
+	blob.size--;
+
+	return blob;
+}
+
+template <typename T>
+static void _appendRecords(std::vector<uint8_t> &file, const std::vector<T> &records) {
+	size_t offset = file.size();
+	file.resize(offset + records.size() * sizeof(T));
+
+	if (!records.empty())
+		memcpy(file.data() + offset, records.data(), records.size() * sizeof(T));
+}
+
+template <typename T>
+static bool _readRecords(const MappedFile &file, size_t &offset, uint32_t count,
+		std::vector<T> &records) {
+	size_t size = static_cast<size_t>(count) * sizeof(T);
+
+	if (offset > file.getSize() || size > file.getSize() - offset)
+		return false;
+
+	records.resize(count);
+
+	if (size > 0)
+		memcpy(records.data(), file.getData() + offset, size);
+
+	offset += size;
+	return true;
+}
+
+// nullptr when blob is outside of file
+static uint8_t *_getBlob(const MappedFile &file, const CookedHeader &header,
+		const CookedBlob &blob, size_t terminatorSize = 0) {
+	uint64_t size = blob.size + terminatorSize;
+
+	if (blob.offset > header.blobSize || size > header.blobSize - blob.offset)
+		return nullptr;
+
+	return file.getData() + header.blobOffset + blob.offset;
+}
+
+static const char *_getName(const MappedFile &file, const CookedHeader &header,
+		const CookedBlob &blob) {
+	const char *pName = reinterpret_cast<const char *>(_getBlob(file, header, blob, 1));
+
+	if (pName == nullptr || pName[blob.size] != '\0')
+		return nullptr;
+
+	return pName;
+}
+
+static uint64_t _fromOptional(const std::optional<uint64_t> &index) {
+	return index.value_or(COOKED_NONE);
+}
+
+static std::optional<uint64_t> _toOptional(uint64_t index) {
+	if (index == COOKED_NONE)
+		return {};
+
+	return index;
+}
+
+bool AssetLoader::cook(const Scene &scene, const std::filesystem::path &file) {
+	std::vector<CookedImage> images;
+	std::vector<CookedMaterial> materials;
+	std::vector<CookedMesh> meshes;
+	std::vector<CookedPrimitive> primitives;
+	std::vector<CookedNode> nodes;
+	std::vector<CookedMeshInstance> meshInstances;
+	std::vector<CookedSkin> skins;
+	std::vector<CookedLight> lights;
+	std::vector<CookedAnimation> animations;
+
+	std::vector<uint8_t> blobs;
+
+	// usage decides how levels are filtered, scene images are not shared between usages
+	std::vector<TextureCompressor::Usage> usages(
+			scene.images.size(), TextureCompressor::Usage::Linear);
+
+	for (const Material &material : scene.materials) {
+		if (material.albedoIndex.has_value() && material.albedoIndex.value() < usages.size())
+			usages[material.albedoIndex.value()] = TextureCompressor::Usage::Color;
+
+		if (material.normalIndex.has_value() && material.normalIndex.value() < usages.size())
+			usages[material.normalIndex.value()] = TextureCompressor::Usage::Normal;
+	}
+
+	for (size_t i = 0; i < scene.images.size(); i++) {
+		// runtime uploads finished levels, no conversion or mip generation is left for it
+		std::shared_ptr<Image> image =
+				TextureCompressor::compress(scene.images[i], usages[i]);
+
+		const std::vector<uint8_t> &data = image->getData();
+
+		CookedImage _image = {};
+		_image.width = image->getWidth();
+		_image.height = image->getHeight();
+		_image.format = static_cast<uint32_t>(image->getFormat());
+		_image.mipLevels = image->getMipLevels();
+		_image.isSrgb = image->isSrgb() ? 1 : 0;
+		_image.data = _appendBlob(blobs, data.data(), data.size());
+
+		images.push_back(_image);
+	}
+
+	for (const Material &material : scene.materials) {
+		CookedMaterial _material = {};
+		_material.albedoIndex = _fromOptional(material.albedoIndex);
+		_material.normalIndex = _fromOptional(material.normalIndex);
+		_material.metallicRoughnessIndex = _fromOptional(material.metallicRoughnessIndex);
+		_material.lightmapIndex = _fromOptional(material.lightmapIndex);
+		_material.albedoFactor = material.albedoFactor;
+		_material.emissiveFactor = material.emissiveFactor;
+		_material.metallicFactor = material.metallicFactor;
+		_material.roughnessFactor = material.roughnessFactor;
+		_material.deriveTangents = material.deriveTangents ? 1 : 0;
+		_material.albedoRect = material.albedoRect;
+		_material.normalRect = material.normalRect;
+		_material.metallicRoughnessRect = material.metallicRoughnessRect;
+		_material.name = _appendName(blobs, material.name.c_str());
+
+		materials.push_back(_material);
+	}
+
+	for (const Mesh &mesh : scene.meshes) {
+		CookedMesh _mesh = {};
+		_mesh.firstPrimitive = static_cast<uint32_t>(primitives.size());
+		_mesh.primitiveCount = mesh.primitiveCount;
+		_mesh.name = _appendName(blobs, mesh.pName);
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			const Primitive &primitive = mesh.pPrimitives[i];
+
+			// same layout as RS::meshCreate reads, nothing is rebuilt on load
+			CookedPrimitive _primitive = {};
+			_primitive.vertices = _appendBlob(blobs, primitive.vertices.pData,
+					primitive.vertices.count * sizeof(Vertex));
+			_primitive.indices = _appendBlob(blobs, primitive.indices.pData,
+					primitive.indices.count * sizeof(uint32_t));
+			_primitive.meshlets = _appendBlob(blobs, primitive.meshlets.pData,
+					primitive.meshlets.count * sizeof(Meshlet));
+
+			std::vector<CookedLod> lods;
+
+			for (uint32_t j = 0; j < primitive.lods.count; j++) {
+				const Lod &lod = primitive.lods.pData[j];
+
+				CookedLod _lod = {};
+				_lod.indices = _appendBlob(
+						blobs, lod.indices.pData, lod.indices.count * sizeof(uint32_t));
+				_lod.error = lod.error;
+
+				lods.push_back(_lod);
+			}
+
+			_primitive.lods = _appendBlob(blobs, lods.data(), lods.size() * sizeof(CookedLod));
+
+			std::vector<CookedMorphTarget> morphTargets;
+
+			for (uint32_t j = 0; j < primitive.morphTargets.count; j++) {
+				const MorphTarget &target = primitive.morphTargets.pData[j];
+
+				CookedMorphTarget _target = {};
+				_target.deltas = _appendBlob(
+						blobs, target.pDeltas, target.deltaCount * sizeof(MorphDelta));
+
+				morphTargets.push_back(_target);
+			}
+
+			_primitive.morphTargets = _appendBlob(blobs, morphTargets.data(),
+					morphTargets.size() * sizeof(CookedMorphTarget));
+			_primitive.materialIndex = primitive.materialIndex;
+
+			primitives.push_back(_primitive);
+		}
+
+		meshes.push_back(_mesh);
+	}
+
+	for (const Node &node : scene.nodes) {
+		CookedNode _node = {};
+		_node.transform = node.transform;
+		_node.parentIndex = node.parentIndex.value_or(COOKED_NONE);
+		_node.name = _appendName(blobs, node.name.c_str());
+
+		nodes.push_back(_node);
+	}
+
+	for (const MeshInstance &meshInstance : scene.meshInstances) {
+		CookedMeshInstance _meshInstance = {};
+		_meshInstance.nodeIndex = meshInstance.nodeIndex;
+		_meshInstance.meshIndex = meshInstance.meshIndex;
+		_meshInstance.skinIndex = _fromOptional(meshInstance.skinIndex);
+		_meshInstance.morphWeights = _appendBlob(blobs, meshInstance.morphWeights.data(),
+				meshInstance.morphWeights.size() * sizeof(float));
+		_meshInstance.name = _appendName(blobs, meshInstance.name.c_str());
+
+		meshInstances.push_back(_meshInstance);
+	}
+
+	for (const Skin &skin : scene.skins) {
+		CookedSkin _skin = {};
+		_skin.joints =
+				_appendBlob(blobs, skin.joints.data(), skin.joints.size() * sizeof(uint64_t));
+		_skin.inverseBindMatrices = _appendBlob(blobs, skin.inverseBindMatrices.data(),
+				skin.inverseBindMatrices.size() * sizeof(glm::mat4));
+		_skin.name = _appendName(blobs, skin.name.c_str());
+
+		skins.push_back(_skin);
+	}
+
+	for (const Light &light : scene.lights) {
+		CookedLight _light = {};
+		_light.nodeIndex = light.nodeIndex;
+		_light.type = static_cast<uint32_t>(light.type);
+		_light.color = light.color;
+		_light.intensity = light.intensity;
+		_light.range = light.range.value_or(0.0f);
+		_light.hasRange = light.range.has_value();
+		_light.isBaked = light.isBaked;
+		_light.name = _appendName(blobs, light.name.c_str());
+
+		lights.push_back(_light);
+	}
+
+	for (const AnimationClip &clip : scene.animations) {
+		CookedAnimation animation = {};
+		animation.duration = clip.duration;
+		animation.frameCount = clip.frameCount;
+		animation.translationCount = clip.translationCount;
+		animation.rotationCount = clip.rotationCount;
+		animation.scaleCount = clip.scaleCount;
+		animation.targets = _appendBlob(blobs, clip.targets.data(),
+				clip.targets.size() * sizeof(AnimationClip::Target));
+		animation.samples =
+				_appendBlob(blobs, clip.samples.data(), clip.samples.size() * sizeof(float));
+		animation.blendWeights = _appendBlob(
+				blobs, clip.blendWeights.data(), clip.blendWeights.size() * sizeof(float));
+		animation.name = _appendName(blobs, clip.name.c_str());
+
+		animations.push_back(animation);
+	}
+
+	CookedHeader header = {};
+	memcpy(header.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC));
+	header.version = COOKED_VERSION;
+	header.imageCount = static_cast<uint32_t>(images.size());
+	header.materialCount = static_cast<uint32_t>(materials.size());
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.primitiveCount = static_cast<uint32_t>(primitives.size());
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+	header.meshInstanceCount = static_cast<uint32_t>(meshInstances.size());
+	header.lightCount = static_cast<uint32_t>(lights.size());
+	header.skinCount = static_cast<uint32_t>(skins.size());
+	header.animationCount = static_cast<uint32_t>(animations.size());
+
+	const LightProbeGrid &grid = scene.lightProbes;
+
+	CookedLightProbes lightProbes = {};
+	lightProbes.origin = grid.origin;
+	lightProbes.spacing = grid.spacing;
+	lightProbes.counts = grid.probes.empty() ? glm::uvec3(0) : grid.counts;
+	lightProbes.probes =
+			_appendBlob(blobs, grid.probes.data(), grid.probes.size() * sizeof(glm::vec4));
+
+	const CellPortalGraph &graph = scene.cellPortals;
+
+	CookedCellPortals cellPortals = {};
+	cellPortals.cellCount = static_cast<uint32_t>(graph.cells.size());
+	cellPortals.portalCount = static_cast<uint32_t>(graph.portals.size());
+	cellPortals.pvsWordCount = graph.pvsWordCount;
+	cellPortals.cells = _appendBlob(
+			blobs, graph.cells.data(), graph.cells.size() * sizeof(CellPortalGraph::Cell));
+	cellPortals.portals = _appendBlob(
+			blobs, graph.portals.data(), graph.portals.size() * sizeof(CellPortalGraph::Portal));
+	cellPortals.pvs = _appendBlob(blobs, graph.pvs.data(), graph.pvs.size() * sizeof(uint64_t));
+
+	std::vector<uint8_t> data;
+	data.resize(sizeof(CookedHeader));
+
+	_appendRecords(data, images);
+	_appendRecords(data, materials);
+	_appendRecords(data, meshes);
+	_appendRecords(data, primitives);
+	_appendRecords(data, nodes);
+	_appendRecords(data, meshInstances);
+	_appendRecords(data, skins);
+	_appendRecords(data, lights);
+	_appendRecords(data, std::vector<CookedLightProbes> { lightProbes });
+	_appendRecords(data, std::vector<CookedCellPortals> { cellPortals });
+	_appendRecords(data, animations);
+
+	header.blobOffset = _alignBlob(data.size());
+	header.blobSize = blobs.size();
+
+	data.resize(header.blobOffset);
+	memcpy(data.data(), &header, sizeof(CookedHeader));
+
+	SDL_IOStream *pStream = SDL_IOFromFile(file.c_str(), "wb");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Opening cooked scene (%s) failed",
+				file.c_str());
+		return false;
+	}
+
+	size_t written = SDL_WriteIO(pStream, data.data(), data.size());
+	written += SDL_WriteIO(pStream, blobs.data(), blobs.size());
+
+	SDL_CloseIO(pStream);
+
+	if (written != data.size() + blobs.size()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Writing cooked scene (%s) failed",
+				file.c_str());
+		remove(file.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+Scene AssetLoader::loadCooked(const std::filesystem::path &file) {
+	PROFILE_ZONE("cooked scene load");
+
+	std::shared_ptr<MappedFile> mappedFile = std::make_shared<MappedFile>();
+
+	if (!mappedFile->open(file)) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Asset loading failed: %s is missing",
+				file.c_str());
+		return {};
+	}
+
+	CookedHeader header;
+	size_t offset = sizeof(CookedHeader);
+
+	bool isValid = mappedFile->getSize() >= sizeof(CookedHeader);
+
+	if (isValid) {
+		memcpy(&header, mappedFile->getData(), sizeof(CookedHeader));
+
+		isValid = memcmp(header.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC)) == 0 &&
+				header.version == COOKED_VERSION &&
+				header.blobOffset % COOKED_BLOB_ALIGNMENT == 0 &&
+				header.blobOffset <= mappedFile->getSize() &&
+				header.blobSize == mappedFile->getSize() - header.blobOffset;
+	}
+
+	std::vector<CookedImage> images;
+	std::vector<CookedMaterial> materials;
+	std::vector<CookedMesh> meshes;
+	std::vector<CookedPrimitive> primitives;
+	std::vector<CookedNode> nodes;
+	std::vector<CookedMeshInstance> meshInstances;
+	std::vector<CookedSkin> skins;
+	std::vector<CookedLight> lights;
+	std::vector<CookedLightProbes> lightProbes;
+	std::vector<CookedCellPortals> cellPortals;
+	std::vector<CookedAnimation> animations;
+
+	isValid = isValid && _readRecords(*mappedFile, offset, header.imageCount, images) &&
+			_readRecords(*mappedFile, offset, header.materialCount, materials) &&
+			_readRecords(*mappedFile, offset, header.meshCount, meshes) &&
+			_readRecords(*mappedFile, offset, header.primitiveCount, primitives) &&
+			_readRecords(*mappedFile, offset, header.nodeCount, nodes) &&
+			_readRecords(*mappedFile, offset, header.meshInstanceCount, meshInstances) &&
+			_readRecords(*mappedFile, offset, header.skinCount, skins) &&
+			_readRecords(*mappedFile, offset, header.lightCount, lights) &&
+			_readRecords(*mappedFile, offset, 1, lightProbes) &&
+			_readRecords(*mappedFile, offset, 1, cellPortals) &&
+			_readRecords(*mappedFile, offset, header.animationCount, animations) &&
+			offset <= header.blobOffset;
+
+	if (!isValid) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Asset loading failed: %s is not cooked scene",
+				file.c_str());
+		return {};
+	}
+
+	Scene scene;
+	scene.arena = std::make_shared<MeshArena>();
+
+	for (const CookedImage &image : images) {
+		Image::Format format = static_cast<Image::Format>(image.format);
+		const uint8_t *pData = _getBlob(*mappedFile, header, image.data);
+
+		// formats past BC7 are not written by cook, level count is checked before size
+		bool isValid = pData != nullptr &&
+				image.format <= static_cast<uint32_t>(Image::Format::BC7) && image.width > 0 &&
+				image.height > 0 && image.mipLevels > 0 && image.mipLevels <= 32 &&
+				(std::max(image.width, image.height) >> (image.mipLevels - 1)) > 0;
+
+		size_t size = 0;
+
+		if (isValid)
+			size = Image::getDataSize(format, image.width, image.height, image.mipLevels);
+
+		if (!isValid || image.data.size != size) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Asset loading failed: %s is corrupted",
+					file.c_str());
+			return {};
+		}
+
+		// levels past max image size are never copied out of file, images without levels to
+		// drop are resampled
+		uint32_t maxSize = getMaxImageSize();
+		uint32_t side = std::max(image.width, image.height);
+		uint32_t level = 0;
+
+		while (maxSize > 0 && level + 1 < image.mipLevels && (side >> level) > maxSize)
+			level++;
+
+		uint64_t offset = Image::getLevelOffset(format, image.width, image.height, level);
+		std::vector<uint8_t> data(pData + offset, pData + size);
+
+		std::shared_ptr<Image> _image = std::make_shared<Image>(std::max(image.width >> level, 1u),
+				std::max(image.height >> level, 1u), format, std::move(data),
+				image.mipLevels - level);
+		_image->setSrgb(image.isSrgb != 0);
+
+		scene.images.push_back(ImageResampler::limit(_image, maxSize));
+	}
+
+	for (const CookedMaterial &material : materials) {
+		const char *pName = _getName(*mappedFile, header, material.name);
+
+		Material _material = {};
+		_material.albedoIndex = _toOptional(material.albedoIndex);
+		_material.normalIndex = _toOptional(material.normalIndex);
+		_material.metallicRoughnessIndex = _toOptional(material.metallicRoughnessIndex);
+		_material.lightmapIndex = _toOptional(material.lightmapIndex);
+		_material.albedoFactor = material.albedoFactor;
+		_material.emissiveFactor = material.emissiveFactor;
+		_material.metallicFactor = material.metallicFactor;
+		_material.roughnessFactor = material.roughnessFactor;
+		_material.deriveTangents = material.deriveTangents != 0;
+		_material.albedoRect = material.albedoRect;
+		_material.normalRect = material.normalRect;
+		_material.metallicRoughnessRect = material.metallicRoughnessRect;
+		_material.name = pName != nullptr ? pName : "";
+
+		scene.materials.push_back(_material);
+	}
+
+	for (const CookedMesh &mesh : meshes) {
+		if (mesh.firstPrimitive > primitives.size() ||
+				mesh.primitiveCount > primitives.size() - mesh.firstPrimitive) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Asset loading failed: %s is corrupted",
+					file.c_str());
+			return {};
+		}
+
+		Primitive *pPrimitives = scene.arena->allocate<Primitive>(mesh.primitiveCount);
+
+		// vertices, indices and name point into mapping, file outlives scene load
+		scene.meshes.push_back({ pPrimitives, 0, _getName(*mappedFile, header, mesh.name) });
+		Mesh &_mesh = scene.meshes.back();
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			const CookedPrimitive &primitive = primitives[mesh.firstPrimitive + i];
+
+			uint8_t *pVertices = _getBlob(*mappedFile, header, primitive.vertices);
+			uint8_t *pIndices = _getBlob(*mappedFile, header, primitive.indices);
+
+			if (pVertices == nullptr || pIndices == nullptr ||
+					primitive.vertices.size % sizeof(Vertex) != 0 ||
+					primitive.indices.size % sizeof(uint32_t) != 0 ||
+					primitive.vertices.offset % COOKED_BLOB_ALIGNMENT != 0 ||
+					primitive.indices.offset % COOKED_BLOB_ALIGNMENT != 0) {
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Skipping corrupted primitive");
+				continue;
+			}
+
+			Primitive _primitive = {};
+			_primitive.vertices.pData = reinterpret_cast<Vertex *>(pVertices);
+			_primitive.vertices.count =
+					static_cast<uint32_t>(primitive.vertices.size / sizeof(Vertex));
+			_primitive.indices.pData = reinterpret_cast<uint32_t *>(pIndices);
+			_primitive.indices.count =
+					static_cast<uint32_t>(primitive.indices.size / sizeof(uint32_t));
+			_primitive.materialIndex = primitive.materialIndex;
+
+			// meshlets only speed up culling, primitive is drawn whole without them
+			uint8_t *pMeshlets = _getBlob(*mappedFile, header, primitive.meshlets);
+			uint32_t meshletCount =
+					static_cast<uint32_t>(primitive.meshlets.size / sizeof(Meshlet));
+
+			bool isMeshletValid = pMeshlets != nullptr &&
+					primitive.meshlets.size % sizeof(Meshlet) == 0 &&
+					primitive.meshlets.offset % COOKED_BLOB_ALIGNMENT == 0;
+
+			for (uint32_t j = 0; j < meshletCount && isMeshletValid; j++) {
+				const Meshlet &meshlet = reinterpret_cast<const Meshlet *>(pMeshlets)[j];
+
+				isMeshletValid = meshlet.firstIndex <= _primitive.indices.count &&
+						meshlet.indexCount <= _primitive.indices.count - meshlet.firstIndex;
+			}
+
+			if (isMeshletValid) {
+				_primitive.meshlets.pData = reinterpret_cast<Meshlet *>(pMeshlets);
+				_primitive.meshlets.count = meshletCount;
+			}
+
+			// levels end at first invalid one, coarser levels cannot skip it
+			const uint8_t *pLods = _getBlob(*mappedFile, header, primitive.lods);
+			uint32_t lodCount = 0;
+
+			if (pLods != nullptr && primitive.lods.size % sizeof(CookedLod) == 0)
+				lodCount = static_cast<uint32_t>(primitive.lods.size / sizeof(CookedLod));
+
+			if (lodCount > 0)
+				_primitive.lods.pData = scene.arena->allocate<Lod>(lodCount);
+
+			for (uint32_t j = 0; j < lodCount; j++) {
+				CookedLod lod;
+				memcpy(&lod, pLods + j * sizeof(CookedLod), sizeof(CookedLod));
+
+				uint8_t *pLodIndices = _getBlob(*mappedFile, header, lod.indices);
+
+				if (pLodIndices == nullptr || lod.indices.size % sizeof(uint32_t) != 0 ||
+						lod.indices.offset % COOKED_BLOB_ALIGNMENT != 0)
+					break;
+
+				Lod &_lod = _primitive.lods.pData[_primitive.lods.count++];
+				_lod.indices.pData = reinterpret_cast<uint32_t *>(pLodIndices);
+				_lod.indices.count = static_cast<uint32_t>(lod.indices.size / sizeof(uint32_t));
+				_lod.error = lod.error;
+			}
+
+			// targets end at first invalid one, like levels, weights past them are ignored
+			const CookedBlob &targets = primitive.morphTargets;
+			const uint8_t *pTargets = _getBlob(*mappedFile, header, targets);
+			uint32_t targetCount = 0;
+
+			if (pTargets != nullptr && targets.size % sizeof(CookedMorphTarget) == 0)
+				targetCount = static_cast<uint32_t>(targets.size / sizeof(CookedMorphTarget));
+
+			if (targetCount > 0)
+				_primitive.morphTargets.pData = scene.arena->allocate<MorphTarget>(targetCount);
+
+			for (uint32_t j = 0; j < targetCount; j++) {
+				CookedMorphTarget target;
+				memcpy(&target, pTargets + j * sizeof(CookedMorphTarget), sizeof(CookedMorphTarget));
+
+				uint8_t *pDeltas = _getBlob(*mappedFile, header, target.deltas);
+				uint32_t deltaCount = static_cast<uint32_t>(target.deltas.size / sizeof(MorphDelta));
+
+				bool isTargetValid = pDeltas != nullptr &&
+						target.deltas.size % sizeof(MorphDelta) == 0 &&
+						target.deltas.offset % COOKED_BLOB_ALIGNMENT == 0;
+
+				const MorphDelta *pTargetDeltas = reinterpret_cast<const MorphDelta *>(pDeltas);
+
+				for (uint32_t k = 0; k < deltaCount && isTargetValid; k++)
+					isTargetValid = pTargetDeltas[k].vertex < _primitive.vertices.count;
+
+				if (!isTargetValid)
+					break;
+
+				MorphTarget &_target =
+						_primitive.morphTargets.pData[_primitive.morphTargets.count++];
+				_target.pDeltas = reinterpret_cast<MorphDelta *>(pDeltas);
+				_target.deltaCount = deltaCount;
+			}
+
+			_mesh.pPrimitives[_mesh.primitiveCount++] = _primitive;
+		}
+	}
+
+	for (const CookedNode &node : nodes) {
+		const char *pName = _getName(*mappedFile, header, node.name);
+
+		// parent has to come first, anything else breaks depth first order, node becomes root
+		std::optional<uint64_t> parentIndex = _toOptional(node.parentIndex);
+
+		if (parentIndex.has_value() && parentIndex.value() >= scene.nodes.size())
+			parentIndex = {};
+
+		scene.nodes.push_back({ node.transform, parentIndex, pName != nullptr ? pName : "" });
+	}
+
+	for (const CookedMeshInstance &meshInstance : meshInstances) {
+		if (meshInstance.meshIndex >= scene.meshes.size() ||
+				meshInstance.nodeIndex >= scene.nodes.size())
+			continue;
+
+		const char *pName = _getName(*mappedFile, header, meshInstance.name);
+
+		MeshInstance _meshInstance = {
+			meshInstance.nodeIndex,
+			meshInstance.meshIndex,
+			pName != nullptr ? pName : "",
+		};
+
+		if (meshInstance.skinIndex < skins.size())
+			_meshInstance.skinIndex = meshInstance.skinIndex;
+
+		const uint8_t *pWeights = _getBlob(*mappedFile, header, meshInstance.morphWeights);
+
+		if (pWeights != nullptr && meshInstance.morphWeights.size % sizeof(float) == 0) {
+			_meshInstance.morphWeights.resize(meshInstance.morphWeights.size / sizeof(float));
+			memcpy(_meshInstance.morphWeights.data(), pWeights, meshInstance.morphWeights.size);
+		}
+
+		scene.meshInstances.push_back(_meshInstance);
+	}
+
+	for (const CookedSkin &skin : skins) {
+		const uint8_t *pJoints = _getBlob(*mappedFile, header, skin.joints);
+		const uint8_t *pMatrices = _getBlob(*mappedFile, header, skin.inverseBindMatrices);
+		const char *pName = _getName(*mappedFile, header, skin.name);
+
+		size_t jointCount = skin.joints.size / sizeof(uint64_t);
+
+		Skin _skin = {};
+		_skin.name = pName != nullptr ? pName : "";
+
+		// skin that does not match its nodes stays empty, its instances keep bind pose
+		bool isValid = pJoints != nullptr && pMatrices != nullptr &&
+				skin.joints.size % sizeof(uint64_t) == 0 &&
+				skin.inverseBindMatrices.size == jointCount * sizeof(glm::mat4);
+
+		if (isValid) {
+			_skin.joints.resize(jointCount);
+			_skin.inverseBindMatrices.resize(jointCount);
+
+			memcpy(_skin.joints.data(), pJoints, skin.joints.size);
+			memcpy(_skin.inverseBindMatrices.data(), pMatrices, skin.inverseBindMatrices.size);
+		}
+
+		for (uint64_t joint : _skin.joints) {
+			if (joint < scene.nodes.size())
+				continue;
+
+			_skin.joints.clear();
+			_skin.inverseBindMatrices.clear();
+			break;
+		}
+
+		scene.skins.push_back(std::move(_skin));
+	}
+
+	for (const CookedLight &light : lights) {
+		if (light.type > static_cast<uint32_t>(LightType::Point) ||
+				light.nodeIndex >= scene.nodes.size())
+			continue;
+
+		const char *pName = _getName(*mappedFile, header, light.name);
+
+		std::optional<float> range = {};
+
+		if (light.hasRange)
+			range = light.range;
+
+		Light _light = {
+			light.nodeIndex,
+			static_cast<LightType>(light.type),
+			light.color,
+			light.intensity,
+			range,
+			pName != nullptr ? pName : "",
+			light.isBaked != 0,
+		};
+
+		scene.lights.push_back(_light);
+	}
+
+	const CookedLightProbes &probes = lightProbes[0];
+	const uint8_t *pProbes = _getBlob(*mappedFile, header, probes.probes);
+	uint64_t probeCount = static_cast<uint64_t>(probes.counts.x) * probes.counts.y * probes.counts.z;
+
+	// grid which does not match its probes is dropped rather than sampled out of bounds
+	if (pProbes != nullptr && probeCount > 0 &&
+			probes.probes.size == probeCount * sizeof(glm::vec4)) {
+		scene.lightProbes.origin = probes.origin;
+		scene.lightProbes.spacing = probes.spacing;
+		scene.lightProbes.counts = probes.counts;
+		scene.lightProbes.probes.resize(probeCount);
+		memcpy(scene.lightProbes.probes.data(), pProbes, probes.probes.size);
+	}
+
+	const CookedCellPortals &graph = cellPortals[0];
+	const uint8_t *pCells = _getBlob(*mappedFile, header, graph.cells);
+	const uint8_t *pPortals = _getBlob(*mappedFile, header, graph.portals);
+	const uint8_t *pPvs = _getBlob(*mappedFile, header, graph.pvs);
+
+	// like probes, graph whose arrays do not match its counts is dropped
+	if (pCells != nullptr && pPortals != nullptr && graph.cellCount > 0 &&
+			graph.cells.size == uint64_t(graph.cellCount) * sizeof(CellPortalGraph::Cell) &&
+			graph.portals.size == uint64_t(graph.portalCount) * sizeof(CellPortalGraph::Portal)) {
+		CellPortalGraph &cellGraph = scene.cellPortals;
+		cellGraph.cells.resize(graph.cellCount);
+		cellGraph.portals.resize(graph.portalCount);
+		memcpy(cellGraph.cells.data(), pCells, graph.cells.size);
+		memcpy(cellGraph.portals.data(), pPortals, graph.portals.size);
+
+		uint64_t pvsSize = uint64_t(graph.cellCount) * graph.pvsWordCount * sizeof(uint64_t);
+
+		// set of another cell count is left out, portals are traversed instead
+		if (pPvs != nullptr && graph.pvsWordCount == (graph.cellCount + 63) / 64 &&
+				graph.pvs.size == pvsSize) {
+			cellGraph.pvs.resize(pvsSize / sizeof(uint64_t));
+			cellGraph.pvsWordCount = graph.pvsWordCount;
+			memcpy(cellGraph.pvs.data(), pPvs, pvsSize);
+		}
+	}
+
+	for (const CookedAnimation &animation : animations) {
+		const uint8_t *pTargets = _getBlob(*mappedFile, header, animation.targets);
+		const uint8_t *pSamples = _getBlob(*mappedFile, header, animation.samples);
+		const uint8_t *pWeights = _getBlob(*mappedFile, header, animation.blendWeights);
+		const char *pName = _getName(*mappedFile, header, animation.name);
+
+		AnimationClip clip = {};
+		clip.name = pName != nullptr ? pName : "";
+		clip.duration = animation.duration;
+		clip.frameCount = animation.frameCount;
+		clip.translationCount = animation.translationCount;
+		clip.rotationCount = animation.rotationCount;
+		clip.scaleCount = animation.scaleCount;
+
+		uint64_t frameSize = clip.getFrameSize();
+
+		// clip whose frames do not match its channels is dropped, its nodes keep rest pose
+		if (pTargets == nullptr || pSamples == nullptr || pWeights == nullptr ||
+				clip.frameCount == 0 ||
+				animation.targets.size % sizeof(AnimationClip::Target) != 0 ||
+				animation.samples.size != clip.frameCount * frameSize * sizeof(float) ||
+				animation.blendWeights.size != frameSize * sizeof(float))
+			continue;
+
+		clip.targets.resize(animation.targets.size / sizeof(AnimationClip::Target));
+		clip.samples.resize(clip.frameCount * frameSize);
+		clip.blendWeights.resize(frameSize);
+
+		memcpy(clip.targets.data(), pTargets, animation.targets.size);
+		memcpy(clip.samples.data(), pSamples, animation.samples.size);
+		memcpy(clip.blendWeights.data(), pWeights, animation.blendWeights.size);
+
+		bool isValid = true;
+
+		for (const AnimationClip::Target &target : clip.targets) {
+			isValid = isValid && target.node < scene.nodes.size() &&
+					(target.translationChannel < clip.translationCount ||
+							target.translationChannel == ANIMATION_NO_CHANNEL) &&
+					(target.rotationChannel < clip.rotationCount ||
+							target.rotationChannel == ANIMATION_NO_CHANNEL) &&
+					(target.scaleChannel < clip.scaleCount ||
+							target.scaleChannel == ANIMATION_NO_CHANNEL);
+		}
+
+		if (isValid)
+			scene.animations.push_back(std::move(clip));
+	}
+
+	scene.file = mappedFile;
+	return scene;
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "environment_cache.h"
+
+const char CACHE_MAGIC[4] = { 'H', 'B', 'A', 'K' };
+
+std::string EnvironmentCache::_getPath(uint64_t key) {
+	// resolved once, empty when there is no writable location
+	static const std::string DIRECTORY = []() {
+		char *pPath = SDL_GetPrefPath("hayaku", "cache");
+
+		if (pPath == nullptr)
+			return std::string();
+
+		std::string path = pPath;
+		SDL_free(pPath);
+		return path;
+	}();
+
+	if (DIRECTORY.empty())
+		return std::string();
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016" PRIx64 ".bake", key);
+
+	return DIRECTORY + name;
+}
+
+uint64_t EnvironmentCache::hash(const void *pData, size_t size, uint64_t seed) {
+	const uint64_t PRIME = 0x100000001b3;
+
+	const uint8_t *pBytes = reinterpret_cast<const uint8_t *>(pData);
+	uint64_t value = seed;
+
+	// word at a time, byte wise FNV is too slow for hundreds of megabytes
+	size_t wordCount = size / sizeof(uint64_t);
+
+	for (size_t i = 0; i < wordCount; i++) {
+		uint64_t word;
+		memcpy(&word, pBytes + i * sizeof(uint64_t), sizeof(uint64_t));
+
+		value ^= word;
+		value *= PRIME;
+	}
+
+	for (size_t i = wordCount * sizeof(uint64_t); i < size; i++) {
+		value ^= pBytes[i];
+		value *= PRIME;
+	}
+
+	return value;
+}
+
+size_t EnvironmentCache::getDataSize(const Entry &entry) {
+	size_t dataSize = 0;
+
+	for (uint32_t level = 0; level < entry.levelCount; level++) {
+		size_t levelSize = std::max(entry.size >> level, 1u);
+		dataSize += levelSize * levelSize * entry.layerCount * entry.texelSize;
+	}
+
+	return dataSize;
+}
+
+bool EnvironmentCache::load(uint64_t key, Entry &entry) {
+	std::string path = _getPath(key);
+
+	if (path.empty())
+		return false;
+
+	size_t fileSize;
+	uint8_t *pFile = static_cast<uint8_t *>(SDL_LoadFile(path.c_str(), &fileSize));
+
+	if (pFile == nullptr)
+		return false;
+
+	Header header;
+	bool isValid = fileSize >= sizeof(Header);
+
+	if (isValid) {
+		memcpy(&header, pFile, sizeof(Header));
+
+		isValid = memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+				header.version == ENVIRONMENT_CACHE_VERSION && header.key == key &&
+				header.dataSize == fileSize - sizeof(Header);
+	}
+
+	if (isValid) {
+		entry.format = header.format;
+		entry.texelSize = header.texelSize;
+		entry.size = header.size;
+		entry.layerCount = header.layerCount;
+		entry.levelCount = header.levelCount;
+
+		for (uint32_t i = 0; i < 9; i++)
+			entry.irradianceSH[i] = header.irradianceSH[i];
+
+		// truncated or foreign file
+		isValid = getDataSize(entry) == header.dataSize;
+	}
+
+	if (isValid) {
+		const uint8_t *pData = pFile + sizeof(Header);
+		entry.data.assign(pData, pData + header.dataSize);
+	}
+
+	SDL_free(pFile);
+	return isValid;
+}
+
+void EnvironmentCache::save(uint64_t key, const Entry &entry) {
+	std::string path = _getPath(key);
+
+	if (path.empty())
+		return;
+
+	Header header = {};
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = ENVIRONMENT_CACHE_VERSION;
+	header.key = key;
+
+	header.format = entry.format;
+	header.texelSize = entry.texelSize;
+	header.size = entry.size;
+	header.layerCount = entry.layerCount;
+	header.levelCount = entry.levelCount;
+
+	for (uint32_t i = 0; i < 9; i++)
+		header.irradianceSH[i] = entry.irradianceSH[i];
+
+	header.dataSize = entry.data.size();
+
+	SDL_IOStream *pStream = SDL_IOFromFile(path.c_str(), "wb");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Opening cache file (%s) failed", path.c_str());
+		return;
+	}
+
+	size_t written = SDL_WriteIO(pStream, &header, sizeof(Header));
+	written += SDL_WriteIO(pStream, entry.data.data(), entry.data.size());
+
+	SDL_CloseIO(pStream);
+
+	// partial file would be rejected on load, remove it right away
+	if (written != sizeof(Header) + entry.data.size()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Writing cache file (%s) failed", path.c_str());
+		remove(path.c_str());
+	}
+}
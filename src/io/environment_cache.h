@@ -0,0 +1,67 @@
+#ifndef ENVIRONMENT_CACHE_H
+#define ENVIRONMENT_CACHE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// bumped whenever container layout or bake output changes, older files are then ignored
+const uint32_t ENVIRONMENT_CACHE_VERSION = 2;
+
+// Baked images on disk, files are named by key of their source and bake parameters. Container
+// is header followed by tightly packed levels, largest first, every level holds all layers.
+class EnvironmentCache {
+public:
+	typedef struct {
+		// vk::Format of texels
+		uint32_t format;
+		uint32_t texelSize;
+
+		uint32_t size;
+		uint32_t layerCount;
+		uint32_t levelCount;
+
+		// zero when image is not an environment
+		std::array<glm::vec4, 9> irradianceSH;
+
+		std::vector<uint8_t> data;
+	} Entry;
+
+private:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+
+		uint32_t format;
+		uint32_t texelSize;
+		uint32_t size;
+		uint32_t layerCount;
+		uint32_t levelCount;
+		uint32_t _padding;
+
+		glm::vec4 irradianceSH[9];
+		uint64_t dataSize;
+	};
+
+	static std::string _getPath(uint64_t key);
+
+public:
+	// 64 bit FNV-1a over words, not cryptographic, seed chains hashes of several inputs
+	static uint64_t hash(const void *pData, size_t size, uint64_t seed = 0xcbf29ce484222325);
+
+	// bytes of all levels, returns 0 when entry was not initialized
+	static size_t getDataSize(const Entry &entry);
+
+	// safe to call from any thread, false for missing or stale file
+	static bool load(uint64_t key, Entry &entry);
+
+	// failure only disables caching of this entry, it is logged
+	static void save(uint64_t key, const Entry &entry);
+};
+
+#endif // !ENVIRONMENT_CACHE_H
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "file_watcher.h"
+
+std::filesystem::path FileWatcher::watch(const std::filesystem::path &path) {
+	std::error_code error;
+	std::filesystem::path canonical = std::filesystem::canonical(path, error);
+
+	if (error)
+		return {};
+
+	for (const File &file : _files) {
+		if (file.path == canonical)
+			return canonical;
+	}
+
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(canonical, error);
+	_files.push_back({ canonical, time });
+
+#ifdef __linux__
+	if (_fd < 0)
+		_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	std::filesystem::path directory = canonical.parent_path();
+
+	for (const auto &[wd, watched] : _directories) {
+		if (watched == directory)
+			return canonical;
+	}
+
+	// written in place or renamed over, other events leave file as it was
+	int wd = inotify_add_watch(_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+	if (wd >= 0)
+		_directories[wd] = directory;
+#endif
+
+	return canonical;
+}
+
+void FileWatcher::clear() {
+	_files.clear();
+
+#ifdef __linux__
+	// watches go with descriptor
+	if (_fd >= 0)
+		close(_fd);
+
+	_fd = -1;
+	_directories.clear();
+#endif
+}
+
+std::vector<std::filesystem::path> FileWatcher::poll() {
+	std::vector<std::filesystem::path> changed;
+
+	auto add = [&](const std::filesystem::path &path) {
+		if (std::find(changed.begin(), changed.end(), path) == changed.end())
+			changed.push_back(path);
+	};
+
+#ifdef __linux__
+	if (_fd < 0)
+		return changed;
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t size;
+
+	while ((size = read(_fd, buffer, sizeof(buffer))) > 0) {
+		for (ssize_t offset = 0; offset < size;) {
+			const inotify_event *pEvent = reinterpret_cast<const inotify_event *>(buffer + offset);
+			offset += sizeof(inotify_event) + pEvent->len;
+
+			auto it = _directories.find(pEvent->wd);
+
+			if (it == _directories.end() || pEvent->len == 0)
+				continue;
+
+			std::filesystem::path path = it->second / pEvent->name;
+
+			for (const File &file : _files) {
+				if (file.path == path)
+					add(path);
+			}
+		}
+	}
+#else
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	if (now - _pollTime < FILE_WATCHER_POLL_INTERVAL)
+		return changed;
+
+	_pollTime = now;
+
+	for (File &file : _files) {
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(file.path, error);
+
+		// file being replaced is missing for a moment, it is seen once it is back
+		if (error || time == file.time)
+			continue;
+
+		file.time = time;
+		add(file.path);
+	}
+#endif
+
+	return changed;
+}
+
+FileWatcher::~FileWatcher() {
+	clear();
+}
@@ -0,0 +1,47 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <vector>
+
+// modification times are compared this often where directories can not be watched
+const std::chrono::milliseconds FILE_WATCHER_POLL_INTERVAL(500);
+
+// Files written since last poll. On Linux directories of watched files are watched with inotify,
+// so files editors save by renaming a copy over them are caught too, elsewhere modification times
+// are compared once per interval. Paths are canonical. Main thread only.
+class FileWatcher {
+private:
+	typedef struct {
+		std::filesystem::path path;
+		std::filesystem::file_time_type time;
+	} File;
+
+	std::vector<File> _files;
+
+#ifdef __linux__
+	int _fd = -1;
+	// by watch descriptor, several files share watch of their directory
+	std::map<int, std::filesystem::path> _directories;
+#else
+	std::chrono::steady_clock::time_point _pollTime;
+#endif
+
+public:
+	FileWatcher(FileWatcher const &) = delete;
+	void operator=(FileWatcher const &) = delete;
+
+	// returns canonical path, empty when file does not exist
+	std::filesystem::path watch(const std::filesystem::path &path);
+	void clear();
+
+	// each changed file once, however often it was written since last poll
+	std::vector<std::filesystem::path> poll();
+
+	FileWatcher() = default;
+	~FileWatcher();
+};
+
+#endif // !FILE_WATCHER_H
@@ -1,8 +1,27 @@
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <utility>
 #include <vector>
 
+#include <glm/gtc/packing.hpp>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
 #include "image.h"
 
+// largest finite half, bright HDR texels would become infinity
+const float HALF_MAX = 65504.0f;
+
 typedef struct {
 	float r, g, b, a;
 } Color;
@@ -36,6 +55,15 @@ static Color _getPixel(const uint8_t *pBytes, const Image::Format &format, uint3
 			color.b = pBytes[ofs + 2] / 255.0;
 			color.a = pBytes[ofs + 3] / 255.0;
 			break;
+		case Image::Format::RGBA16F: {
+			const uint16_t *pData = reinterpret_cast<const uint16_t *>(pBytes);
+
+			color.r = glm::unpackHalf1x16(pData[ofs + 0]);
+			color.g = glm::unpackHalf1x16(pData[ofs + 1]);
+			color.b = glm::unpackHalf1x16(pData[ofs + 2]);
+			color.a = glm::unpackHalf1x16(pData[ofs + 3]);
+			break;
+		}
 		case Image::Format::RGBA32F:
 			// uint8_t to float
 			const float *pData = reinterpret_cast<const float *>(pBytes);
@@ -73,6 +101,15 @@ static void _setPixel(
 			pBytes[ofs + 2] = color.b * 255;
 			pBytes[ofs + 3] = color.a * 255;
 			break;
+		case Image::Format::RGBA16F: {
+			uint16_t *pData = reinterpret_cast<uint16_t *>(pBytes);
+
+			pData[ofs + 0] = glm::packHalf1x16(std::min(color.r, HALF_MAX));
+			pData[ofs + 1] = glm::packHalf1x16(std::min(color.g, HALF_MAX));
+			pData[ofs + 2] = glm::packHalf1x16(std::min(color.b, HALF_MAX));
+			pData[ofs + 3] = glm::packHalf1x16(std::min(color.a, HALF_MAX));
+			break;
+		}
 		case Image::Format::RGBA32F:
 			// uint8_t to float
 			float *pData = reinterpret_cast<float *>(pBytes);
@@ -85,6 +122,192 @@ static void _setPixel(
 	}
 }
 
+// 8 bit formats are converted byte to byte, kernels are picked per channel count pair and
+// skip float round trip of _getPixel and _setPixel
+
+static const int FILL_ZERO = -1;
+static const int FILL_OPAQUE = -2;
+
+static bool _isUnorm8(const Image::Format &format) {
+	switch (format) {
+		case Image::Format::R8:
+		case Image::Format::RG8:
+		case Image::Format::RGB8:
+		case Image::Format::RGBA8:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// source byte of RGBA channel, missing channels follow _getPixel, negative for constant ones
+static constexpr int _getSourceByte(uint32_t channelCount, uint32_t channel) {
+	if (channel < channelCount)
+		return static_cast<int>(channel);
+
+	// gray
+	if (channelCount == 1 && channel < 3)
+		return 0;
+
+	return channel == 3 ? FILL_OPAQUE : FILL_ZERO;
+}
+
+static uint8_t _getFill(int byte) {
+	return byte == FILL_OPAQUE ? 255 : 0;
+}
+
+template <uint32_t SrcChannels, uint32_t DstChannels>
+static void _convertUnorm8(const uint8_t *pSrc, uint8_t *pDst, size_t count) {
+	size_t i = 0;
+
+#if defined(__SSSE3__)
+	if constexpr (SrcChannels == 3 && DstChannels == 4) {
+		const __m128i shuffle =
+				_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+		// 16 bytes are loaded for 12 used, last texels are left for scalar loop
+		for (; i + 6 <= count; i += 4) {
+			__m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + i * 3));
+			__m128i rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + i * 4), rgba);
+		}
+	}
+#elif defined(__ARM_NEON)
+	if constexpr (SrcChannels == 3 && DstChannels == 4) {
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x3_t rgb = vld3q_u8(pSrc + i * 3);
+			uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255) } };
+
+			vst4q_u8(pDst + i * 4, rgba);
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		for (uint32_t c = 0; c < DstChannels; c++) {
+			int byte = _getSourceByte(SrcChannels, c);
+			pDst[i * DstChannels + c] = byte >= 0 ? pSrc[i * SrcChannels + byte] : _getFill(byte);
+		}
+	}
+}
+
+// channels of source are written in given order
+template <uint32_t SrcChannels, uint32_t DstChannels>
+static void _extractUnorm8(
+		const uint8_t *pSrc, uint8_t *pDst, size_t count, const Image::Channel *pChannels) {
+	int bytes[DstChannels];
+	bool isPresent = true;
+
+	for (uint32_t c = 0; c < DstChannels; c++) {
+		bytes[c] = _getSourceByte(SrcChannels, static_cast<uint32_t>(pChannels[c]));
+		isPresent = isPresent && bytes[c] >= 0;
+	}
+
+	size_t i = 0;
+
+#if defined(__SSSE3__)
+	if constexpr (SrcChannels == 4) {
+		if (isPresent) {
+			// 4 texels per shuffle, unused lanes are zeroed
+			alignas(16) int8_t mask[16];
+			std::memset(mask, -1, sizeof(mask));
+
+			for (uint32_t t = 0; t < 4; t++) {
+				for (uint32_t c = 0; c < DstChannels; c++)
+					mask[t * DstChannels + c] = static_cast<int8_t>(t * 4 + bytes[c]);
+			}
+
+			const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+
+			for (; i + 4 <= count; i += 4) {
+				__m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + i * 4));
+				__m128i picked = _mm_shuffle_epi8(rgba, shuffle);
+
+				if constexpr (DstChannels == 1) {
+					int32_t texels = _mm_cvtsi128_si32(picked);
+					std::memcpy(pDst + i, &texels, sizeof(texels));
+				} else {
+					_mm_storel_epi64(reinterpret_cast<__m128i *>(pDst + i * DstChannels), picked);
+				}
+			}
+		}
+	}
+#elif defined(__ARM_NEON)
+	if constexpr (SrcChannels == 4) {
+		if (isPresent) {
+			for (; i + 16 <= count; i += 16) {
+				uint8x16x4_t rgba = vld4q_u8(pSrc + i * 4);
+
+				if constexpr (DstChannels == 1) {
+					vst1q_u8(pDst + i, rgba.val[bytes[0]]);
+				} else {
+					uint8x16x2_t picked = { { rgba.val[bytes[0]], rgba.val[bytes[1]] } };
+					vst2q_u8(pDst + i * 2, picked);
+				}
+			}
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		for (uint32_t c = 0; c < DstChannels; c++) {
+			int byte = bytes[c];
+			pDst[i * DstChannels + c] = byte >= 0 ? pSrc[i * SrcChannels + byte] : _getFill(byte);
+		}
+	}
+}
+
+typedef void (*ConvertKernel)(const uint8_t *pSrc, uint8_t *pDst, size_t count);
+typedef void (*ExtractKernel)(
+		const uint8_t *pSrc, uint8_t *pDst, size_t count, const Image::Channel *pChannels);
+
+template <uint32_t SrcChannels> static ConvertKernel _getConvertKernel(uint32_t dstChannels) {
+	switch (dstChannels) {
+		case 1:
+			return _convertUnorm8<SrcChannels, 1>;
+		case 2:
+			return _convertUnorm8<SrcChannels, 2>;
+		case 3:
+			return _convertUnorm8<SrcChannels, 3>;
+		case 4:
+			return _convertUnorm8<SrcChannels, 4>;
+	}
+
+	return nullptr;
+}
+
+static ConvertKernel _getConvertKernel(uint32_t srcChannels, uint32_t dstChannels) {
+	switch (srcChannels) {
+		case 1:
+			return _getConvertKernel<1>(dstChannels);
+		case 2:
+			return _getConvertKernel<2>(dstChannels);
+		case 3:
+			return _getConvertKernel<3>(dstChannels);
+		case 4:
+			return _getConvertKernel<4>(dstChannels);
+	}
+
+	return nullptr;
+}
+
+template <uint32_t DstChannels> static ExtractKernel _getExtractKernel(uint32_t srcChannels) {
+	switch (srcChannels) {
+		case 1:
+			return _extractUnorm8<1, DstChannels>;
+		case 2:
+			return _extractUnorm8<2, DstChannels>;
+		case 3:
+			return _extractUnorm8<3, DstChannels>;
+		case 4:
+			return _extractUnorm8<4, DstChannels>;
+	}
+
+	return nullptr;
+}
+
 uint32_t Image::getFormatByteSize(const Format &format) {
 	switch (format) {
 		case Image::Format::R8:
@@ -95,8 +318,16 @@ uint32_t Image::getFormatByteSize(const Format &format) {
 			return 3;
 		case Image::Format::RGBA8:
 			return 4;
+		case Image::Format::RGBA16F:
+			return 8;
 		case Image::Format::RGBA32F:
 			return 16;
+		case Image::Format::BC1:
+		case Image::Format::BC4:
+			return 8;
+		case Image::Format::BC5:
+		case Image::Format::BC7:
+			return 16;
 	}
 
 	return 0;
@@ -105,13 +336,18 @@ uint32_t Image::getFormatByteSize(const Format &format) {
 uint32_t Image::getFormatChannelCount(const Format &format) {
 	switch (format) {
 		case Image::Format::R8:
+		case Image::Format::BC4:
 			return 1;
 		case Image::Format::RG8:
+		case Image::Format::BC5:
 			return 2;
 		case Image::Format::RGB8:
 			return 3;
 		case Image::Format::RGBA8:
+		case Image::Format::RGBA16F:
 		case Image::Format::RGBA32F:
+		case Image::Format::BC1:
+		case Image::Format::BC7:
 			return 4;
 	}
 
@@ -128,14 +364,98 @@ const char *Image::getFormatName(const Format &format) {
 			return "RGB8";
 		case Image::Format::RGBA8:
 			return "RGBA8";
+		case Image::Format::RGBA16F:
+			return "RGBA16F";
 		case Image::Format::RGBA32F:
 			return "RGBA32F";
+		case Image::Format::BC1:
+			return "BC1";
+		case Image::Format::BC4:
+			return "BC4";
+		case Image::Format::BC5:
+			return "BC5";
+		case Image::Format::BC7:
+			return "BC7";
 	}
 
 	return "";
 }
 
+bool Image::isFormatCompressed(const Format &format) {
+	switch (format) {
+		case Image::Format::BC1:
+		case Image::Format::BC4:
+		case Image::Format::BC5:
+		case Image::Format::BC7:
+			return true;
+		default:
+			return false;
+	}
+}
+
+uint64_t Image::getLevelSize(const Format &format, uint32_t width, uint32_t height) {
+	if (!isFormatCompressed(format))
+		return static_cast<uint64_t>(width) * height * getFormatByteSize(format);
+
+	// partial blocks are stored whole
+	uint64_t blockCount = static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4);
+	return blockCount * getFormatByteSize(format);
+}
+
+uint64_t Image::getLevelOffset(
+		const Format &format, uint32_t width, uint32_t height, uint32_t level) {
+	uint64_t offset = 0;
+
+	for (uint32_t i = 0; i < level; i++) {
+		uint32_t levelWidth = std::max(width >> i, 1u);
+		uint32_t levelHeight = std::max(height >> i, 1u);
+
+		offset += getLevelSize(format, levelWidth, levelHeight);
+		offset = (offset + IMAGE_LEVEL_ALIGNMENT - 1) & ~(IMAGE_LEVEL_ALIGNMENT - 1);
+	}
+
+	return offset;
+}
+
+uint64_t Image::getDataSize(
+		const Format &format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+	uint32_t last = mipLevels - 1;
+	uint32_t lastWidth = std::max(width >> last, 1u);
+	uint32_t lastHeight = std::max(height >> last, 1u);
+
+	return getLevelOffset(format, width, height, last) +
+		   getLevelSize(format, lastWidth, lastHeight);
+}
+
+void Image::packHalfs(const float *pSrc, uint16_t *pDst, size_t count) {
+	size_t i = 0;
+
+#if defined(__F16C__)
+	const __m128 max = _mm_set1_ps(HALF_MAX);
+
+	// NaN is second operand so it passes through like in scalar path
+	for (; i + 4 <= count; i += 4) {
+		__m128 value = _mm_min_ps(max, _mm_loadu_ps(pSrc + i));
+		__m128i halves = _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(pDst + i), halves);
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const float32x4_t max = vdupq_n_f32(HALF_MAX);
+
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t value = vminq_f32(vld1q_f32(pSrc + i), max);
+		vst1_u16(pDst + i, vreinterpret_u16_f16(vcvt_f16_f32(value)));
+	}
+#endif
+
+	for (; i < count; i++)
+		pDst[i] = glm::packHalf1x16(std::min(pSrc[i], HALF_MAX));
+}
+
 void Image::convert(const Format &format) {
+	if (isFormatCompressed(_format) || isFormatCompressed(format))
+		return;
+
 	uint32_t pixelCount = _width * _height;
 	uint32_t byteSize = getFormatByteSize(format);
 
@@ -147,16 +467,56 @@ void Image::convert(const Format &format) {
 	uint8_t *pDstData = data.data();
 	Format dstFormat = format;
 
+	if (_isUnorm8(srcFormat) && _isUnorm8(dstFormat)) {
+		ConvertKernel kernel = _getConvertKernel(
+				getFormatChannelCount(srcFormat), getFormatChannelCount(dstFormat));
+		kernel(pSrcData, pDstData, pixelCount);
+
+		_format = format;
+		_mipLevels = 1;
+		_data = std::move(data);
+		return;
+	}
+
+	if (srcFormat == Format::RGBA32F && dstFormat == Format::RGBA16F) {
+		packHalfs(reinterpret_cast<const float *>(pSrcData),
+				reinterpret_cast<uint16_t *>(pDstData), static_cast<size_t>(pixelCount) * 4);
+
+		_format = format;
+		_mipLevels = 1;
+		_data = std::move(data);
+		return;
+	}
+
 	for (uint32_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
 		Color color = _getPixel(pSrcData, srcFormat, pixelIdx);
 		_setPixel(pDstData, dstFormat, pixelIdx, color);
 	}
 
 	_format = format;
-	_data = data;
+	_mipLevels = 1;
+	_data = std::move(data);
+}
+
+static float _getChannel(const Color &color, const Image::Channel &channel) {
+	switch (channel) {
+		case Image::Channel::R:
+			return color.r;
+		case Image::Channel::G:
+			return color.g;
+		case Image::Channel::B:
+			return color.b;
+		case Image::Channel::A:
+			return color.a;
+	}
+
+	return 0.0f;
 }
 
 Image *Image::getComponent(const Channel &channel) const {
+	if (isFormatCompressed(_format))
+		return nullptr;
+
 	uint32_t pixelCount = _width * _height;
 
 	std::vector<uint8_t> data(pixelCount);
@@ -167,30 +527,103 @@ Image *Image::getComponent(const Channel &channel) const {
 	uint8_t *pDstData = data.data();
 	Format dstFormat = Format::R8;
 
+	if (_isUnorm8(srcFormat)) {
+		ExtractKernel kernel = _getExtractKernel<1>(getFormatChannelCount(srcFormat));
+		kernel(pSrcData, pDstData, pixelCount, &channel);
+
+		return new Image(_width, _height, Format::R8, std::move(data));
+	}
+
 	for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
 		Color src = _getPixel(pSrcData, srcFormat, pixelIdx);
 		Color color = {};
 
 		// swizzle
-		switch (channel) {
-			case Channel::R:
-				color.r = src.r;
-				break;
-			case Channel::G:
-				color.r = src.g;
-				break;
-			case Channel::B:
-				color.r = src.b;
-				break;
-			case Channel::A:
-				color.r = src.a;
-				break;
-		}
+		color.r = _getChannel(src, channel);
+
+		_setPixel(pDstData, dstFormat, pixelIdx, color);
+	}
+
+	return new Image(_width, _height, Format::R8, std::move(data));
+}
+
+Image *Image::getComponents(const Channel &first, const Channel &second) const {
+	if (isFormatCompressed(_format))
+		return nullptr;
+
+	uint32_t pixelCount = _width * _height;
+
+	std::vector<uint8_t> data(pixelCount * 2);
+
+	const uint8_t *pSrcData = _data.data();
+	Format srcFormat = _format;
+
+	uint8_t *pDstData = data.data();
+	Format dstFormat = Format::RG8;
+
+	if (_isUnorm8(srcFormat)) {
+		Channel channels[2] = { first, second };
+
+		ExtractKernel kernel = _getExtractKernel<2>(getFormatChannelCount(srcFormat));
+		kernel(pSrcData, pDstData, pixelCount, channels);
+
+		return new Image(_width, _height, Format::RG8, std::move(data));
+	}
+
+	for (size_t pixelIdx = 0; pixelIdx < pixelCount; pixelIdx++) {
+		Color src = _getPixel(pSrcData, srcFormat, pixelIdx);
+		Color color = {};
+
+		// swizzle
+		color.r = _getChannel(src, first);
+		color.g = _getChannel(src, second);
 
 		_setPixel(pDstData, dstFormat, pixelIdx, color);
 	}
 
-	return new Image(_width, _height, Format::R8, data);
+	return new Image(_width, _height, Format::RG8, std::move(data));
+}
+
+Image *Image::getDownscaled(uint32_t width, uint32_t height) const {
+	if (isFormatCompressed(_format))
+		return nullptr;
+
+	width = std::clamp(width, 1u, _width);
+	height = std::clamp(height, 1u, _height);
+
+	std::vector<uint8_t> data(getLevelSize(_format, width, height));
+
+	for (uint32_t y = 0; y < height; y++) {
+		// texels of source covered by destination one, every one is covered once
+		uint32_t srcY0 = y * _height / height;
+		uint32_t srcY1 = std::max((y + 1) * _height / height, srcY0 + 1);
+
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t srcX0 = x * _width / width;
+			uint32_t srcX1 = std::max((x + 1) * _width / width, srcX0 + 1);
+
+			Color sum = {};
+
+			for (uint32_t srcY = srcY0; srcY < srcY1; srcY++) {
+				for (uint32_t srcX = srcX0; srcX < srcX1; srcX++) {
+					Color src = _getPixel(_data.data(), _format, srcY * _width + srcX);
+					sum.r += src.r;
+					sum.g += src.g;
+					sum.b += src.b;
+					sum.a += src.a;
+				}
+			}
+
+			float weight = 1.0f / static_cast<float>((srcX1 - srcX0) * (srcY1 - srcY0));
+			Color color = { sum.r * weight, sum.g * weight, sum.b * weight, sum.a * weight };
+
+			_setPixel(data.data(), _format, y * width + x, color);
+		}
+	}
+
+	Image *pImage = new Image(width, height, _format, std::move(data));
+	pImage->setSrgb(_isSrgb);
+	return pImage;
 }
 
 uint32_t Image::getWidth() const {
@@ -205,13 +638,31 @@ Image::Format Image::getFormat() const {
 	return _format;
 }
 
-std::vector<uint8_t> Image::getData() const {
+uint32_t Image::getMipLevels() const {
+	return _mipLevels;
+}
+
+uint64_t Image::getByteSize() const {
+	return _data.size();
+}
+
+void Image::setSrgb(bool isSrgb) {
+	_isSrgb = isSrgb;
+}
+
+bool Image::isSrgb() const {
+	return _isSrgb;
+}
+
+const std::vector<uint8_t> &Image::getData() const {
 	return _data;
 }
 
-Image::Image(uint32_t width, uint32_t height, Format format, const std::vector<uint8_t> &data) {
+Image::Image(uint32_t width, uint32_t height, Format format, std::vector<uint8_t> data,
+		uint32_t mipLevels) {
 	_width = width;
 	_height = height;
 	_format = format;
-	_data = data;
+	_mipLevels = mipLevels;
+	_data = std::move(data);
 }
@@ -1,9 +1,13 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+// mip levels start aligned to it, copies from staging need offsets multiple of block size
+const uint64_t IMAGE_LEVEL_ALIGNMENT = 16;
+
 class Image {
 public:
 	enum class Format {
@@ -11,7 +15,14 @@ public:
 		RG8,
 		RGB8,
 		RGBA8,
+		RGBA16F,
 		RGBA32F,
+
+		// block compressed, 4x4 texels per block, they are not converted and go to GPU as is
+		BC1,
+		BC4,
+		BC5,
+		BC7,
 	};
 
 	enum class Channel {
@@ -24,22 +35,51 @@ public:
 private:
 	uint32_t _width, _height;
 	Format _format = Format::R8;
+	uint32_t _mipLevels = 1;
+	// 8 bit and BC1/BC7 color is uploaded as sRGB then, texture unit decodes it when sampled
+	bool _isSrgb = false;
 	std::vector<uint8_t> _data = {};
 
 public:
+	// per texel, per block for compressed formats
 	static uint32_t getFormatByteSize(const Format &format);
 	static uint32_t getFormatChannelCount(const Format &format);
 	static const char *getFormatName(const Format &format);
+	static bool isFormatCompressed(const Format &format);
+
+	static uint64_t getLevelSize(const Format &format, uint32_t width, uint32_t height);
+	static uint64_t getLevelOffset(
+			const Format &format, uint32_t width, uint32_t height, uint32_t level);
+	static uint64_t getDataSize(
+			const Format &format, uint32_t width, uint32_t height, uint32_t mipLevels);
+	// values past largest finite half are clamped, vectorized where F16C or NEON is available
+	static void packHalfs(const float *pSrc, uint16_t *pDst, size_t count);
 
+	// only first level is kept, conversions of compressed images are ignored
 	void convert(const Format &format);
+	// nullptr for compressed images
 	Image *getComponent(const Channel &channel) const;
+	// two channels packed into RG8, one pass instead of two getComponent calls
+	Image *getComponents(const Channel &first, const Channel &second) const;
+	// first level box filtered to at most its size, texels are averaged as stored, nullptr for
+	// compressed images
+	Image *getDownscaled(uint32_t width, uint32_t height) const;
 
 	uint32_t getWidth() const;
 	uint32_t getHeight() const;
 	Format getFormat() const;
-	std::vector<uint8_t> getData() const;
+	// levels past first are pre-built, renderer generates them only for images with one level
+	uint32_t getMipLevels() const;
+	uint64_t getByteSize() const;
+	// values are kept as they are, only how they are read changes
+	void setSrgb(bool isSrgb);
+	bool isSrgb() const;
+	// valid until image is converted or destroyed, copy it to keep it longer
+	const std::vector<uint8_t> &getData() const;
 
-	Image(uint32_t width, uint32_t height, Format format, const std::vector<uint8_t> &data);
+	// data holds every level, each at getLevelOffset, pass it with std::move to skip the copy
+	Image(uint32_t width, uint32_t height, Format format, std::vector<uint8_t> data,
+			uint32_t mipLevels = 1);
 };
 
 #endif // !IMAGE_H
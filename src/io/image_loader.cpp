@@ -1,19 +1,229 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <future>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <glm/gtc/packing.hpp>
+
 #include <stb/stb_image.h>
 #include <tinyexr/tinyexr.h>
 
-#include <SDL3/SDL_iostream.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <SDL3/SDL_log.h>
 
+#include <job_system.h>
+#include <profiler.h>
+
 #include "image_loader.h"
+#include "package.h"
 
 #define STBI_FAILURE 0
 #define STBI_SUCCESS 1
 
+const uint8_t KTX2_IDENTIFIER[12] = {
+	0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+typedef struct {
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+} Ktx2Header;
+static_assert(sizeof(Ktx2Header) == 80, "Ktx2Header is not 80 bytes");
+
+// follows header, one per level from largest
+typedef struct {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+} Ktx2Level;
+
+// VkFormat values, sRGB variants load as unorm with sRGB flag of image set
+static bool _fromVkFormat(uint32_t vkFormat, Image::Format &format, bool &isSrgb) {
+	isSrgb = vkFormat == 43 || vkFormat == 134 || vkFormat == 146;
+
+	switch (vkFormat) {
+		case 9: // VK_FORMAT_R8_UNORM
+			format = Image::Format::R8;
+			return true;
+		case 16: // VK_FORMAT_R8G8_UNORM
+			format = Image::Format::RG8;
+			return true;
+		case 37: // VK_FORMAT_R8G8B8A8_UNORM
+		case 43: // VK_FORMAT_R8G8B8A8_SRGB
+			format = Image::Format::RGBA8;
+			return true;
+		case 97: // VK_FORMAT_R16G16B16A16_SFLOAT
+			format = Image::Format::RGBA16F;
+			return true;
+		case 109: // VK_FORMAT_R32G32B32A32_SFLOAT
+			format = Image::Format::RGBA32F;
+			return true;
+		case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+		case 134: // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+			format = Image::Format::BC1;
+			return true;
+		case 139: // VK_FORMAT_BC4_UNORM_BLOCK
+			format = Image::Format::BC4;
+			return true;
+		case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+			format = Image::Format::BC5;
+			return true;
+		case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+		case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+			format = Image::Format::BC7;
+			return true;
+		default:
+			return false;
+	}
+}
+
+// half float one, default alpha of images without it
+const uint16_t HALF_ONE = 0x3C00;
+
+// decoded channels of scanline image or one tile, texel x, y of block is at y * stride + x
+typedef struct {
+	uint8_t **ppChannels;
+	int32_t x, y;
+	int32_t width, height;
+	int32_t stride;
+} ExrBlock;
+
+// planes of R, G, B and A into RGBA texels
+static void _interleaveHalves(const uint16_t *const *ppPlanes, uint16_t *pDst, size_t count) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 8 <= count; i += 8) {
+		__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ppPlanes[0] + i));
+		__m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ppPlanes[1] + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ppPlanes[2] + i));
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ppPlanes[3] + i));
+
+		__m128i rgLow = _mm_unpacklo_epi16(r, g);
+		__m128i rgHigh = _mm_unpackhi_epi16(r, g);
+		__m128i baLow = _mm_unpacklo_epi16(b, a);
+		__m128i baHigh = _mm_unpackhi_epi16(b, a);
+
+		__m128i *pTexels = reinterpret_cast<__m128i *>(pDst + i * 4);
+		_mm_storeu_si128(pTexels + 0, _mm_unpacklo_epi32(rgLow, baLow));
+		_mm_storeu_si128(pTexels + 1, _mm_unpackhi_epi32(rgLow, baLow));
+		_mm_storeu_si128(pTexels + 2, _mm_unpacklo_epi32(rgHigh, baHigh));
+		_mm_storeu_si128(pTexels + 3, _mm_unpackhi_epi32(rgHigh, baHigh));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 8 <= count; i += 8) {
+		uint16x8x4_t texels;
+		texels.val[0] = vld1q_u16(ppPlanes[0] + i);
+		texels.val[1] = vld1q_u16(ppPlanes[1] + i);
+		texels.val[2] = vld1q_u16(ppPlanes[2] + i);
+		texels.val[3] = vld1q_u16(ppPlanes[3] + i);
+		vst4q_u16(pDst + i * 4, texels);
+	}
+#endif
+
+	for (; i < count; i++) {
+		for (int c = 0; c < 4; c++)
+			pDst[i * 4 + c] = ppPlanes[c][i];
+	}
+}
+
+// region past edge keeps last texel, zero size extends to edge
+static void _clampRegion(const ImageLoader::Region &region, int32_t width, int32_t height,
+		int32_t &x, int32_t &y, int32_t &regionWidth, int32_t &regionHeight) {
+	x = std::min<int64_t>(region.x, width - 1);
+	y = std::min<int64_t>(region.y, height - 1);
+
+	regionWidth = region.width == 0 ? width - x : std::min<int64_t>(region.width, width - x);
+	regionHeight = region.height == 0 ? height - y : std::min<int64_t>(region.height, height - y);
+}
+
+// formats other than EXR are decoded whole, downscale takes every scale-th texel of region
+static Image *_cropImage(Image *pImage, const ImageLoader::Region &region) {
+	if (pImage == nullptr || Image::isFormatCompressed(pImage->getFormat()))
+		return pImage;
+
+	int32_t srcWidth = pImage->getWidth();
+	int32_t srcHeight = pImage->getHeight();
+
+	int32_t x, y, regionWidth, regionHeight;
+	_clampRegion(region, srcWidth, srcHeight, x, y, regionWidth, regionHeight);
+
+	int32_t scale = std::max<int32_t>(region.scale, 1);
+
+	if (scale == 1 && regionWidth == srcWidth && regionHeight == srcHeight)
+		return pImage;
+
+	uint32_t width = (regionWidth + scale - 1) / scale;
+	uint32_t height = (regionHeight + scale - 1) / scale;
+
+	Image::Format format = pImage->getFormat();
+	uint32_t texelSize = Image::getFormatByteSize(format);
+
+	std::vector<uint8_t> data(static_cast<size_t>(width) * height * texelSize);
+	const uint8_t *pSrc = pImage->getData().data();
+
+	for (uint32_t dstY = 0; dstY < height; dstY++) {
+		for (uint32_t dstX = 0; dstX < width; dstX++) {
+			size_t srcTexel = static_cast<size_t>(y + dstY * scale) * srcWidth + x + dstX * scale;
+			size_t dstTexel = static_cast<size_t>(dstY) * width + dstX;
+			memcpy(&data[dstTexel * texelSize], pSrc + srcTexel * texelSize, texelSize);
+		}
+	}
+
+	Image *pCropped = new Image(width, height, format, std::move(data));
+	delete pImage;
+
+	return pCropped;
+}
+
+// formats of stb that have magic bytes, some of their headers span more than probe reads
+static bool _hasStbMagic(const uint8_t *pBuffer, size_t bufferSize) {
+	const char *MAGICS[] = {
+		"\x89PNG",
+		"\xFF\xD8\xFF",
+		"GIF8",
+		"BM",
+		"8BPS",
+		"#?RADIANCE",
+		"#?RGBE",
+		"P5",
+		"P6",
+	};
+
+	for (const char *pMagic : MAGICS) {
+		size_t size = strlen(pMagic);
+
+		if (bufferSize >= size && memcmp(pBuffer, pMagic, size) == 0)
+			return true;
+	}
+
+	return false;
+}
+
 void ImageLoader::_printInfo(const Image *pImage, const char *pFile) {
 	const SDL_LogCategory CATEGORY = SDL_LOG_CATEGORY_APPLICATION;
 
@@ -38,7 +248,7 @@ void ImageLoader::_printInfo(const Image *pImage, const char *pFile) {
 	SDL_LogVerbose(CATEGORY, "Width: %d", pImage->getWidth());
 	SDL_LogVerbose(CATEGORY, "Height: %d", pImage->getHeight());
 	SDL_LogVerbose(CATEGORY, "Format: %s", Image::getFormatName(format));
-	SDL_LogVerbose(CATEGORY, "Bytes: %ld", pImage->getData().size());
+	SDL_LogVerbose(CATEGORY, "Bytes: %ld", pImage->getByteSize());
 }
 
 Image *ImageLoader::_stbiLoad(const uint8_t *pBuffer, size_t bufferSize) {
@@ -50,6 +260,7 @@ Image *ImageLoader::_stbiLoad(const uint8_t *pBuffer, size_t bufferSize) {
 
 	size_t byteSize = width * height * numChannels;
 
+	// stb owns its buffer, this is the only copy, image takes vector over
 	std::vector<uint8_t> bytes(byteSize);
 	memcpy(bytes.data(), pData, byteSize);
 	stbi_image_free(pData);
@@ -71,7 +282,7 @@ Image *ImageLoader::_stbiLoad(const uint8_t *pBuffer, size_t bufferSize) {
 			break;
 	}
 
-	return new Image(width, height, format, bytes);
+	return new Image(width, height, format, std::move(bytes));
 }
 
 Image *ImageLoader::_stbiLoadHDR(const uint8_t *pBuffer, size_t bufferSize) {
@@ -82,34 +293,40 @@ Image *ImageLoader::_stbiLoadHDR(const uint8_t *pBuffer, size_t bufferSize) {
 		return nullptr;
 
 	uint32_t pixelCount = width * height;
-	std::vector<float> data(pixelCount * 4);
 
-	for (uint32_t pixel = 0; pixel < pixelCount; pixel++) {
-		float channels[4] = { 0.0, 0.0, 0.0, 1.0 };
+	// halves are packed straight into bytes image takes over
+	std::vector<uint8_t> bytes(static_cast<size_t>(pixelCount) * 4 * sizeof(uint16_t));
+	uint16_t *pHalves = reinterpret_cast<uint16_t *>(bytes.data());
 
-		for (int i = 0; i < numChannels; i++) {
-			size_t offset = pixel * numChannels;
-			channels[i] = pData[offset + i];
-		}
+	if (numChannels == 4) {
+		Image::packHalfs(pData, pHalves, static_cast<size_t>(pixelCount) * 4);
+	} else {
+		// expanded to RGBA a row at a time, whole row is packed at once
+		std::vector<float> row(static_cast<size_t>(width) * 4);
 
-		size_t offset = (pixel * 4);
+		for (int y = 0; y < height; y++) {
+			const float *pSrc = pData + static_cast<size_t>(y) * width * numChannels;
 
-		data[offset + 0] = channels[0];
-		data[offset + 1] = channels[1];
-		data[offset + 2] = channels[2];
-		data[offset + 3] = channels[3];
-	}
+			for (int x = 0; x < width; x++) {
+				float channels[4] = { 0.0, 0.0, 0.0, 1.0 };
 
-	size_t byteSize = data.size() * sizeof(float);
+				for (int i = 0; i < numChannels; i++)
+					channels[i] = pSrc[x * numChannels + i];
+
+				memcpy(&row[x * 4], channels, sizeof(channels));
+			}
+
+			Image::packHalfs(row.data(), pHalves + row.size() * y, row.size());
+		}
+	}
 
-	std::vector<uint8_t> bytes(byteSize);
-	memcpy(bytes.data(), data.data(), byteSize);
 	stbi_image_free(pData);
 
-	return new Image(width, height, Image::Format::RGBA32F, bytes);
+	return new Image(width, height, Image::Format::RGBA16F, std::move(bytes));
 }
 
-Image *ImageLoader::_tinyexrLoad(const uint8_t *pBuffer, size_t bufferSize) {
+Image *ImageLoader::_tinyexrLoad(
+		const uint8_t *pBuffer, size_t bufferSize, const Region &region) {
 	EXRVersion version;
 	int err = ParseEXRVersionFromMemory(&version, pBuffer, bufferSize);
 
@@ -128,12 +345,7 @@ Image *ImageLoader::_tinyexrLoad(const uint8_t *pBuffer, size_t bufferSize) {
 	if (err != TINYEXR_SUCCESS)
 		return nullptr;
 
-	// read 16-bit float as 32-bit
-	for (int i = 0; i < header.num_channels; i++) {
-		if (header.pixel_types[i] == TINYEXR_PIXELTYPE_HALF)
-			header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
-	}
-
+	// 16-bit float is requested as it is and copied without conversion
 	EXRImage image;
 	InitEXRImage(&image);
 	err = LoadEXRImageFromMemory(&image, &header, pBuffer, bufferSize, nullptr);
@@ -150,103 +362,290 @@ Image *ImageLoader::_tinyexrLoad(const uint8_t *pBuffer, size_t bufferSize) {
 		return nullptr;
 	}
 
-	if (image.images == nullptr) {
+	// scanline image is one block, tiles of tiled image are blocks of their own
+	std::vector<ExrBlock> blocks;
+
+	if (image.images != nullptr) {
+		blocks.push_back({ image.images, 0, 0, image.width, image.height, image.width });
+	} else if (image.tiles != nullptr) {
+		for (int i = 0; i < image.num_tiles; i++) {
+			const EXRTile &tile = image.tiles[i];
+
+			blocks.push_back({ tile.images, tile.offset_x * header.tile_size_x,
+					tile.offset_y * header.tile_size_y, tile.width, tile.height,
+					header.tile_size_x });
+		}
+	}
+
+	if (blocks.empty()) {
 		FreeEXRImage(&image);
 		FreeEXRHeader(&header);
 		return nullptr;
 	}
 
-	// load
+	int32_t regionX, regionY, regionWidth, regionHeight;
+	_clampRegion(region, image.width, image.height, regionX, regionY, regionWidth, regionHeight);
 
-	uint32_t width = image.width;
-	uint32_t height = image.height;
+	int32_t scale = std::max<int32_t>(region.scale, 1);
+	uint32_t width = (regionWidth + scale - 1) / scale;
+	uint32_t height = (regionHeight + scale - 1) / scale;
 
-	uint32_t pixelCount = width * height;
-	const float *const *pData = reinterpret_cast<float **>(image.images);
+	size_t valueCount = static_cast<size_t>(width) * height * 4;
+	int channelCount = image.num_channels;
+
+	std::vector<uint8_t> bytes(valueCount * sizeof(uint16_t));
+	uint16_t *pHalves = reinterpret_cast<uint16_t *>(bytes.data());
+
+	// channels are in reverse order, RGBA channel c is stored at channelCount - 1 - c
+	bool isHalf[MAX_CHANNELS] = {};
+
+	for (int c = 0; c < channelCount; c++)
+		isHalf[c] = header.requested_pixel_types[channelCount - 1 - c] == TINYEXR_PIXELTYPE_HALF;
+
+	if (scale == 1) {
+		// missing channels read constant rows, float channels are packed into rows of halves
+		int32_t rowSize = std::max(image.width, header.tile_size_x);
+		std::vector<uint16_t> zeros(rowSize, 0);
+		std::vector<uint16_t> ones(rowSize, HALF_ONE);
+		std::vector<uint16_t> packed(static_cast<size_t>(rowSize) * MAX_CHANNELS);
+
+		const uint16_t *planes[4] = { zeros.data(), zeros.data(), zeros.data(), ones.data() };
+
+		for (const ExrBlock &block : blocks) {
+			int32_t x0 = std::max(block.x, regionX);
+			int32_t y0 = std::max(block.y, regionY);
+			int32_t x1 = std::min(block.x + block.width, regionX + regionWidth);
+			int32_t y1 = std::min(block.y + block.height, regionY + regionHeight);
+
+			for (int32_t y = y0; y < y1; y++) {
+				size_t offset = static_cast<size_t>(y - block.y) * block.stride + (x0 - block.x);
 
-	std::vector<float> data(pixelCount * 4);
+				for (int c = 0; c < channelCount; c++) {
+					const uint8_t *pChannel = block.ppChannels[channelCount - 1 - c];
 
-	for (uint32_t pixel = 0; pixel < pixelCount; pixel++) {
-		// default alpha is 1.0
-		float channels[4] = { 0.0, 0.0, 0.0, 1.0 };
+					if (isHalf[c]) {
+						planes[c] = reinterpret_cast<const uint16_t *>(pChannel) + offset;
+						continue;
+					}
 
-		int idx = 0;
+					uint16_t *pPacked = &packed[static_cast<size_t>(c) * rowSize];
+					Image::packHalfs(reinterpret_cast<const float *>(pChannel) + offset, pPacked,
+							x1 - x0);
+					planes[c] = pPacked;
+				}
 
-		// channels are in reverse order
-		for (int i = image.num_channels - 1; i >= 0; i -= 1) {
-			channels[idx] = pData[i][pixel];
-			idx++;
+				size_t dstOffset = static_cast<size_t>(y - regionY) * width + (x0 - regionX);
+				_interleaveHalves(planes, pHalves + dstOffset * 4, x1 - x0);
+			}
 		}
+	} else {
+		// box filtered, sums are divided by texels that fell into each destination texel
+		std::vector<float> sums(valueCount, 0.0f);
+
+		for (const ExrBlock &block : blocks) {
+			int32_t x0 = std::max(block.x, regionX);
+			int32_t y0 = std::max(block.y, regionY);
+			int32_t x1 = std::min(block.x + block.width, regionX + regionWidth);
+			int32_t y1 = std::min(block.y + block.height, regionY + regionHeight);
+
+			for (int32_t y = y0; y < y1; y++) {
+				size_t offset = static_cast<size_t>(y - block.y) * block.stride;
+				float *pSums = &sums[static_cast<size_t>((y - regionY) / scale) * width * 4];
+
+				for (int c = 0; c < channelCount; c++) {
+					const uint8_t *pChannel = block.ppChannels[channelCount - 1 - c];
+					const uint16_t *pHalfRow = reinterpret_cast<const uint16_t *>(pChannel) + offset;
+					const float *pFloatRow = reinterpret_cast<const float *>(pChannel) + offset;
+
+					for (int32_t x = x0; x < x1; x++) {
+						int32_t i = x - block.x;
+						float value = isHalf[c] ? glm::unpackHalf1x16(pHalfRow[i]) : pFloatRow[i];
+
+						pSums[((x - regionX) / scale) * 4 + c] += value;
+					}
+				}
+			}
+		}
+
+		for (uint32_t y = 0; y < height; y++) {
+			int32_t texelsY = std::min(scale, regionHeight - static_cast<int32_t>(y) * scale);
+
+			for (uint32_t x = 0; x < width; x++) {
+				int32_t texelsX = std::min(scale, regionWidth - static_cast<int32_t>(x) * scale);
+				float *pTexel = &sums[(static_cast<size_t>(y) * width + x) * 4];
 
-		size_t offset = (pixel * 4);
+				// default alpha is 1.0
+				for (int c = 0; c < 4; c++)
+					pTexel[c] = c < channelCount ? pTexel[c] / (texelsX * texelsY)
+												 : (c == 3 ? 1.0f : 0.0f);
+			}
+		}
 
-		data[offset + 0] = channels[0];
-		data[offset + 1] = channels[1];
-		data[offset + 2] = channels[2];
-		data[offset + 3] = channels[3];
+		Image::packHalfs(sums.data(), pHalves, valueCount);
 	}
 
 	FreeEXRImage(&image);
 	FreeEXRHeader(&header);
 
-	size_t byteSize = data.size() * sizeof(float);
-	std::vector<uint8_t> bytes(byteSize);
-	memcpy(bytes.data(), data.data(), byteSize);
+	return new Image(width, height, Image::Format::RGBA16F, std::move(bytes));
+}
 
-	return new Image(width, height, Image::Format::RGBA32F, bytes);
+bool ImageLoader::_isKtx2(const uint8_t *pBuffer, size_t bufferSize) {
+	return bufferSize >= sizeof(Ktx2Header) &&
+		   memcmp(pBuffer, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
 }
 
-bool ImageLoader::isImage(const char *pFile) {
-	size_t bufferSize;
-	uint8_t *pBuffer = static_cast<uint8_t *>(SDL_LoadFile(pFile, &bufferSize));
+Image *ImageLoader::_ktx2Load(const uint8_t *pBuffer, size_t bufferSize) {
+	const SDL_LogCategory CATEGORY = SDL_LOG_CATEGORY_APPLICATION;
 
-	int w, h, c;
-	int result = stbi_info_from_memory(pBuffer, bufferSize, &w, &h, &c);
+	Ktx2Header header;
+	memcpy(&header, pBuffer, sizeof(Ktx2Header));
 
-	if (result == STBI_SUCCESS)
-		return true;
+	// BasisLZ and UASTC need transcoder, Zstd needs inflating, neither is linked
+	if (header.supercompressionScheme != 0 || header.vkFormat == 0) {
+		SDL_LogError(CATEGORY, "KTX2 with Basis or supercompressed payload is unsupported");
+		return nullptr;
+	}
 
-	if (IsEXRFromMemory(pBuffer, bufferSize) == TINYEXR_SUCCESS)
-		return true;
+	Image::Format format;
+	bool isSrgb;
 
-	return false;
+	if (!_fromVkFormat(header.vkFormat, format, isSrgb)) {
+		SDL_LogError(CATEGORY, "KTX2 format (%u) is unsupported", header.vkFormat);
+		return nullptr;
+	}
+
+	// arrays, cubemaps and volumes are not textures of materials
+	if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 ||
+			header.layerCount > 1 || header.faceCount != 1) {
+		SDL_LogError(CATEGORY, "KTX2 other than 2D texture is unsupported");
+		return nullptr;
+	}
+
+	uint32_t width = header.pixelWidth;
+	uint32_t height = header.pixelHeight;
+
+	// zero asks for generated levels
+	uint32_t mipLevels = std::max(header.levelCount, 1u);
+	uint32_t maxMipLevels = 1;
+
+	while ((std::max(width, height) >> maxMipLevels) > 0)
+		maxMipLevels++;
+
+	if (mipLevels > maxMipLevels ||
+			bufferSize < sizeof(Ktx2Header) + mipLevels * sizeof(Ktx2Level))
+		return nullptr;
+
+	std::vector<uint8_t> data(Image::getDataSize(format, width, height, mipLevels));
+
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		Ktx2Level _level;
+		memcpy(&_level, pBuffer + sizeof(Ktx2Header) + level * sizeof(Ktx2Level),
+				sizeof(Ktx2Level));
+
+		uint32_t levelWidth = std::max(width >> level, 1u);
+		uint32_t levelHeight = std::max(height >> level, 1u);
+		uint64_t size = Image::getLevelSize(format, levelWidth, levelHeight);
+
+		if (_level.byteLength != size || _level.byteOffset > bufferSize ||
+				size > bufferSize - _level.byteOffset)
+			return nullptr;
+
+		uint64_t offset = Image::getLevelOffset(format, width, height, level);
+		memcpy(data.data() + offset, pBuffer + _level.byteOffset, size);
+	}
+
+	Image *pImage = new Image(width, height, format, std::move(data), mipLevels);
+	pImage->setSrgb(isSrgb);
+
+	return pImage;
 }
 
-std::shared_ptr<Image> ImageLoader::loadFromFile(const char *pFile) {
-	size_t bufferSize;
-	uint8_t *pBuffer = static_cast<uint8_t *>(SDL_LoadFile(pFile, &bufferSize));
+ImageLoader::Type ImageLoader::_getType(const uint8_t *pBuffer, size_t bufferSize) {
+	if (_isKtx2(pBuffer, bufferSize))
+		return Type::Ktx2;
+
+	if (IsEXRFromMemory(pBuffer, bufferSize) == TINYEXR_SUCCESS)
+		return Type::Exr;
 
 	int w, h, c;
-	int result = stbi_info_from_memory(pBuffer, bufferSize, &w, &h, &c);
 
-	Image *pImage = nullptr;
+	// stb needs more than prefix for some headers, JPEG with large EXIF among them
+	if (!_hasStbMagic(pBuffer, bufferSize) &&
+			stbi_info_from_memory(pBuffer, bufferSize, &w, &h, &c) != STBI_SUCCESS)
+		return Type::Unknown;
 
-	if (result == STBI_SUCCESS) {
-		if (stbi_is_hdr_from_memory(pBuffer, bufferSize)) {
-			pImage = _stbiLoadHDR(pBuffer, bufferSize);
-		} else {
-			pImage = _stbiLoad(pBuffer, bufferSize);
-		}
-	} else {
-		pImage = _tinyexrLoad(pBuffer, bufferSize);
+	if (stbi_is_hdr_from_memory(pBuffer, bufferSize))
+		return Type::StbHDR;
+
+	return Type::Stb;
+}
+
+Image *ImageLoader::_load(
+		const uint8_t *pBuffer, size_t bufferSize, Type type, const Region &region) {
+	switch (type) {
+		case Type::Stb:
+			return _cropImage(_stbiLoad(pBuffer, bufferSize), region);
+		case Type::StbHDR:
+			return _cropImage(_stbiLoadHDR(pBuffer, bufferSize), region);
+		case Type::Exr:
+			return _tinyexrLoad(pBuffer, bufferSize, region);
+		case Type::Ktx2:
+			return _cropImage(_ktx2Load(pBuffer, bufferSize), region);
+		default:
+			return nullptr;
+	}
+}
+
+ImageLoader::Type ImageLoader::probe(const char *pFile) {
+	std::vector<uint8_t> buffer;
+
+	if (!Package::loadPrefix(pFile, buffer, IMAGE_PROBE_SIZE))
+		return Type::Unknown;
+
+	return _getType(buffer.data(), buffer.size());
+}
+
+bool ImageLoader::isImage(const char *pFile) {
+	return probe(pFile) != Type::Unknown;
+}
+
+std::shared_ptr<Image> ImageLoader::loadFromFile(
+		const char *pFile, Type type, const Region &region) {
+	PROFILE_ZONE("image load");
+
+	// file on disk or package member
+	std::vector<uint8_t> buffer;
+
+	if (!Package::load(pFile, buffer)) {
+		_printInfo(nullptr, pFile);
+		return nullptr;
 	}
 
+	if (type == Type::Unknown)
+		type = _getType(buffer.data(), buffer.size());
+
+	Image *pImage = _load(buffer.data(), buffer.size(), type, region);
+
 	_printInfo(pImage, pFile);
 	return std::shared_ptr<Image>(pImage);
 }
 
 std::shared_ptr<Image> ImageLoader::loadFromMemory(const uint8_t *pBuffer, size_t bufferSize) {
-	int w, h, c;
-	int result = stbi_info_from_memory(pBuffer, bufferSize, &w, &h, &c);
-
-	Image *pImage = nullptr;
+	PROFILE_ZONE("image load");
 
-	if (result == STBI_SUCCESS) {
-		pImage = _stbiLoad(pBuffer, bufferSize);
-	} else {
-		pImage = _tinyexrLoad(pBuffer, bufferSize);
-	}
+	Image *pImage = _load(pBuffer, bufferSize, _getType(pBuffer, bufferSize), {});
 
 	_printInfo(pImage, nullptr);
 	return std::shared_ptr<Image>(pImage);
 }
+
+std::future<std::shared_ptr<Image>> ImageLoader::loadFromFileAsync(
+		const std::string &file, Type type, const CancelToken &cancel) {
+	return JobSystem::async([file, type, cancel]() -> std::shared_ptr<Image> {
+		if (cancel.isCancelled())
+			return nullptr;
+
+		return loadFromFile(file.c_str(), type);
+	});
+}
@@ -1,24 +1,66 @@
 #ifndef IMAGE_LOADER_H
 #define IMAGE_LOADER_H
 
+#include <cstddef>
 #include <cstdint>
+#include <future>
 #include <memory>
+#include <string>
+
+#include <job_system.h>
 
 #include "image.h"
 
+// bytes probe reads, covers magic and header of every supported format
+const size_t IMAGE_PROBE_SIZE = 4096;
+
 class ImageLoader {
+public:
+	enum class Type {
+		Unknown,
+		Stb,
+		StbHDR,
+		Exr,
+		Ktx2,
+	};
+
+	// texels from x, y, zero size extends to edge, scale of 2 or more box filters EXR and
+	// takes every scale-th texel of others, previews of large skies read much less
+	typedef struct {
+		uint32_t x, y;
+		uint32_t width, height;
+		uint32_t scale;
+	} Region;
+
 private:
 	static void _printInfo(const Image *pImage, const char *pFile);
 
 	static Image *_stbiLoad(const uint8_t *pBuffer, size_t bufferSize);
 	static Image *_stbiLoadHDR(const uint8_t *pBuffer, size_t bufferSize);
-	static Image *_tinyexrLoad(const uint8_t *pBuffer, size_t bufferSize);
+	// tiles and scanlines are decoded on all cores, region is read out of planar channels
+	static Image *_tinyexrLoad(
+			const uint8_t *pBuffer, size_t bufferSize, const Region &region);
+
+	// block compressed and plain formats without supercompression, Basis payloads are rejected
+	static bool _isKtx2(const uint8_t *pBuffer, size_t bufferSize);
+	static Image *_ktx2Load(const uint8_t *pBuffer, size_t bufferSize);
+
+	static Type _getType(const uint8_t *pBuffer, size_t bufferSize);
+	static Image *_load(
+			const uint8_t *pBuffer, size_t bufferSize, Type type, const Region &region);
 
 public:
+	// reads only start of file, result passed to loadFromFile spares it detecting format again
+	static Type probe(const char *pFile);
 	static bool isImage(const char *pFile);
 
-	static std::shared_ptr<Image> loadFromFile(const char *pFile);
+	static std::shared_ptr<Image> loadFromFile(
+			const char *pFile, Type type = Type::Unknown, const Region &region = {});
 	static std::shared_ptr<Image> loadFromMemory(const uint8_t *pBuffer, size_t bufferSize);
+
+	// on background job of job system, nullptr when cancelled before it started decoding
+	static std::future<std::shared_ptr<Image>> loadFromFileAsync(const std::string &file,
+			Type type = Type::Unknown, const CancelToken &cancel = {});
 };
 
 #endif // !IMAGE_LOADER_H
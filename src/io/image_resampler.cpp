@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <job_system.h>
+
+#include "image.h"
+
+#include "image_resampler.h"
+
+// lobes of sinc on each side of texel, in source texels once kernel is scaled down
+const float RESAMPLE_RADIUS = 3.0f;
+// higher ones taper sinc sooner, less ringing for less sharpness
+const float KAISER_BETA = 4.0f;
+// destination rows of one job, source rows kernel reaches past them are filtered by both bands
+const uint32_t RESAMPLE_BAND_ROWS = 32;
+
+static float _toLinear(float value) {
+	if (value <= 0.04045f)
+		return value / 12.92f;
+
+	return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float _toSRGB(float value) {
+	if (value <= 0.0031308f)
+		return value * 12.92f;
+
+	return 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static uint8_t _quantize(float value) {
+	return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// modified Bessel function of first kind and order zero, series converges in few terms for
+// arguments up to beta of window
+static float _besselI0(float x) {
+	float sum = 1.0f;
+	float term = 1.0f;
+
+	for (int k = 1; k < 16; k++) {
+		term *= x * 0.5f / static_cast<float>(k);
+		sum += term * term;
+	}
+
+	return sum;
+}
+
+// t in texels of kernel spacing
+static float _getWeight(float t) {
+	if (std::abs(t) >= RESAMPLE_RADIUS)
+		return 0.0f;
+
+	float u = t / RESAMPLE_RADIUS;
+	float window = _besselI0(KAISER_BETA * std::sqrt(1.0f - u * u)) / _besselI0(KAISER_BETA);
+
+	if (std::abs(t) < 1e-6f)
+		return window;
+
+	float x = glm::pi<float>() * t;
+	return std::sin(x) / x * window;
+}
+
+// weighted sum of count consecutive texels, four channels each
+static void _filterTexel(const float *pSrc, const float *pWeights, uint32_t count, float *pDst) {
+#if defined(__SSE2__)
+	__m128 sum = _mm_setzero_ps();
+
+	for (uint32_t i = 0; i < count; i++)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pSrc + i * 4), _mm_set1_ps(pWeights[i])));
+
+	_mm_storeu_ps(pDst, sum);
+#elif defined(__ARM_NEON)
+	float32x4_t sum = vdupq_n_f32(0.0f);
+
+	for (uint32_t i = 0; i < count; i++)
+		sum = vmlaq_n_f32(sum, vld1q_f32(pSrc + i * 4), pWeights[i]);
+
+	vst1q_f32(pDst, sum);
+#else
+	float sum[4] = {};
+
+	for (uint32_t i = 0; i < count; i++) {
+		for (uint32_t c = 0; c < 4; c++)
+			sum[c] += pSrc[i * 4 + c] * pWeights[i];
+	}
+
+	std::memcpy(pDst, sum, sizeof(sum));
+#endif
+}
+
+// row scaled by weight onto destination row
+static void _accumulateRow(float *pDst, const float *pSrc, float weight, size_t count) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128 scale = _mm_set1_ps(weight);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_add_ps(_mm_loadu_ps(pDst + i), _mm_mul_ps(_mm_loadu_ps(pSrc + i), scale));
+		_mm_storeu_ps(pDst + i, sum);
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 4 <= count; i += 4)
+		vst1q_f32(pDst + i, vmlaq_n_f32(vld1q_f32(pDst + i), vld1q_f32(pSrc + i), weight));
+#endif
+
+	for (; i < count; i++)
+		pDst[i] += pSrc[i] * weight;
+}
+
+ImageResampler::Kernel ImageResampler::_buildKernel(uint32_t srcSize, uint32_t dstSize) {
+	Kernel kernel;
+	kernel.taps.resize(dstSize);
+
+	float scale = static_cast<float>(srcSize) / static_cast<float>(dstSize);
+	// scaled down kernel widens over texels source drops, scaled up one keeps source spacing
+	float kernelScale = std::max(scale, 1.0f);
+	float support = RESAMPLE_RADIUS * kernelScale;
+	int32_t lastTexel = static_cast<int32_t>(srcSize) - 1;
+
+	for (uint32_t x = 0; x < dstSize; x++) {
+		float center = (static_cast<float>(x) + 0.5f) * scale - 0.5f;
+		int32_t first = static_cast<int32_t>(std::ceil(center - support));
+		int32_t last = static_cast<int32_t>(std::floor(center + support));
+
+		int32_t clampedFirst = std::clamp(first, 0, lastTexel);
+		int32_t clampedLast = std::clamp(last, 0, lastTexel);
+
+		Taps &taps = kernel.taps[x];
+		taps.first = static_cast<uint32_t>(clampedFirst);
+		taps.count = static_cast<uint32_t>(clampedLast - clampedFirst + 1);
+		taps.offset = static_cast<uint32_t>(kernel.weights.size());
+		kernel.weights.resize(taps.offset + taps.count, 0.0f);
+
+		float *pWeights = kernel.weights.data() + taps.offset;
+		float sum = 0.0f;
+
+		// taps past edge weigh edge texel
+		for (int32_t i = first; i <= last; i++) {
+			float weight = _getWeight((static_cast<float>(i) - center) / kernelScale);
+			pWeights[std::clamp(i, 0, lastTexel) - clampedFirst] += weight;
+			sum += weight;
+		}
+
+		// flat areas stay flat
+		if (sum > 0.0f) {
+			for (uint32_t i = 0; i < taps.count; i++)
+				pWeights[i] /= sum;
+		}
+	}
+
+	return kernel;
+}
+
+void ImageResampler::_widenRow(const Image &image, uint32_t row, float *pDst) {
+	static const std::array<float, 256> LINEAR = [] {
+		std::array<float, 256> values;
+
+		for (uint32_t i = 0; i < 256; i++)
+			values[i] = static_cast<float>(i) / 255.0f;
+
+		return values;
+	}();
+	static const std::array<float, 256> SRGB = [] {
+		std::array<float, 256> values;
+
+		for (uint32_t i = 0; i < 256; i++)
+			values[i] = _toLinear(static_cast<float>(i) / 255.0f);
+
+		return values;
+	}();
+
+	Image::Format format = image.getFormat();
+	uint32_t width = image.getWidth();
+	const uint8_t *pData = image.getData().data();
+	size_t rowTexel = static_cast<size_t>(row) * width;
+
+	if (format == Image::Format::RGBA16F) {
+		const uint16_t *pSrc = reinterpret_cast<const uint16_t *>(pData) + rowTexel * 4;
+
+		for (size_t i = 0; i < static_cast<size_t>(width) * 4; i++)
+			pDst[i] = glm::unpackHalf1x16(pSrc[i]);
+
+		return;
+	}
+
+	if (format == Image::Format::RGBA32F) {
+		std::memcpy(pDst, reinterpret_cast<const float *>(pData) + rowTexel * 4,
+				static_cast<size_t>(width) * 4 * sizeof(float));
+		return;
+	}
+
+	// missing channels are filtered too, but never stored
+	uint32_t channelCount = Image::getFormatChannelCount(format);
+	const uint8_t *pSrc = pData + rowTexel * channelCount;
+	const float *pColor = image.isSrgb() ? SRGB.data() : LINEAR.data();
+
+	for (uint32_t x = 0; x < width; x++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			float fill = c == 3 ? 1.0f : 0.0f;
+
+			if (c >= channelCount)
+				pDst[x * 4 + c] = fill;
+			else if (c == 3)
+				pDst[x * 4 + c] = LINEAR[pSrc[x * channelCount + c]];
+			else
+				pDst[x * 4 + c] = pColor[pSrc[x * channelCount + c]];
+		}
+	}
+}
+
+void ImageResampler::_narrowRow(
+		float *pSrc, uint32_t width, Image::Format format, bool isSrgb, uint8_t *pDst) {
+	if (format == Image::Format::RGBA16F || format == Image::Format::RGBA32F) {
+		for (size_t i = 0; i < static_cast<size_t>(width) * 4; i++)
+			pSrc[i] = std::max(pSrc[i], 0.0f);
+
+		if (format == Image::Format::RGBA16F)
+			Image::packHalfs(pSrc, reinterpret_cast<uint16_t *>(pDst), width * 4);
+		else
+			std::memcpy(pDst, pSrc, static_cast<size_t>(width) * 4 * sizeof(float));
+
+		return;
+	}
+
+	uint32_t channelCount = Image::getFormatChannelCount(format);
+
+	for (uint32_t x = 0; x < width; x++) {
+		for (uint32_t c = 0; c < channelCount; c++) {
+			float value = pSrc[x * 4 + c];
+
+			if (isSrgb && c < 3)
+				value = _toSRGB(std::clamp(value, 0.0f, 1.0f));
+
+			pDst[x * channelCount + c] = _quantize(value);
+		}
+	}
+}
+
+Image *ImageResampler::resample(const Image &image, uint32_t width, uint32_t height) {
+	Image::Format format = image.getFormat();
+
+	if (Image::isFormatCompressed(format))
+		return nullptr;
+
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+
+	uint32_t srcWidth = image.getWidth();
+	uint32_t srcHeight = image.getHeight();
+	bool isSrgb = image.isSrgb();
+
+	Kernel horizontal = _buildKernel(srcWidth, width);
+	Kernel vertical = _buildKernel(srcHeight, height);
+
+	std::vector<uint8_t> data(Image::getLevelSize(format, width, height));
+	uint64_t rowSize = Image::getLevelSize(format, width, 1);
+	size_t rowLength = static_cast<size_t>(width) * 4;
+
+	uint32_t bandCount = (height + RESAMPLE_BAND_ROWS - 1) / RESAMPLE_BAND_ROWS;
+
+	JobSystem::parallelFor(bandCount, 1, [&](uint32_t firstBand, uint32_t lastBand) {
+		std::vector<float> srcRow(static_cast<size_t>(srcWidth) * 4);
+		std::vector<float> dstRow(rowLength);
+		// source rows of band filtered horizontally
+		std::vector<float> rows;
+
+		for (uint32_t band = firstBand; band < lastBand; band++) {
+			uint32_t firstRow = band * RESAMPLE_BAND_ROWS;
+			uint32_t lastRow = std::min(firstRow + RESAMPLE_BAND_ROWS, height);
+
+			// taps move down with rows
+			const Taps &firstTaps = vertical.taps[firstRow];
+			const Taps &lastTaps = vertical.taps[lastRow - 1];
+			uint32_t srcFirst = firstTaps.first;
+			uint32_t srcLast = lastTaps.first + lastTaps.count;
+
+			rows.resize((srcLast - srcFirst) * rowLength);
+
+			for (uint32_t srcY = srcFirst; srcY < srcLast; srcY++) {
+				_widenRow(image, srcY, srcRow.data());
+				float *pRow = rows.data() + (srcY - srcFirst) * rowLength;
+
+				for (uint32_t x = 0; x < width; x++) {
+					const Taps &taps = horizontal.taps[x];
+
+					_filterTexel(srcRow.data() + static_cast<size_t>(taps.first) * 4,
+							horizontal.weights.data() + taps.offset, taps.count, pRow + x * 4);
+				}
+			}
+
+			for (uint32_t y = firstRow; y < lastRow; y++) {
+				const Taps &taps = vertical.taps[y];
+				std::fill(dstRow.begin(), dstRow.end(), 0.0f);
+
+				for (uint32_t i = 0; i < taps.count; i++) {
+					const float *pRow = rows.data() + (taps.first + i - srcFirst) * rowLength;
+					_accumulateRow(dstRow.data(), pRow, vertical.weights[taps.offset + i],
+							rowLength);
+				}
+
+				_narrowRow(dstRow.data(), width, format, isSrgb, data.data() + y * rowSize);
+			}
+		}
+	});
+
+	Image *pImage = new Image(width, height, format, std::move(data));
+	pImage->setSrgb(isSrgb);
+	return pImage;
+}
+
+std::shared_ptr<Image> ImageResampler::limit(
+		const std::shared_ptr<Image> &image, uint32_t maxSize) {
+	uint32_t width = image->getWidth();
+	uint32_t height = image->getHeight();
+	uint32_t side = std::max(width, height);
+
+	if (maxSize == 0 || side <= maxSize)
+		return image;
+
+	Image::Format format = image->getFormat();
+	uint32_t mipLevels = image->getMipLevels();
+
+	// pre-built levels are filtered already, compressed ones could not be filtered again
+	if (mipLevels > 1) {
+		uint32_t level = 0;
+
+		while (level + 1 < mipLevels && (side >> level) > maxSize)
+			level++;
+
+		const std::vector<uint8_t> &data = image->getData();
+		uint64_t offset = Image::getLevelOffset(format, width, height, level);
+
+		std::shared_ptr<Image> levels = std::make_shared<Image>(std::max(width >> level, 1u),
+				std::max(height >> level, 1u), format,
+				std::vector<uint8_t>(data.begin() + offset, data.end()), mipLevels - level);
+		levels->setSrgb(image->isSrgb());
+		return levels;
+	}
+
+	if (Image::isFormatCompressed(format))
+		return image;
+
+	uint32_t scaledWidth = static_cast<uint32_t>(
+			(static_cast<uint64_t>(width) * maxSize + side / 2) / side);
+	uint32_t scaledHeight = static_cast<uint32_t>(
+			(static_cast<uint64_t>(height) * maxSize + side / 2) / side);
+
+	return std::shared_ptr<Image>(resample(*image, scaledWidth, scaledHeight));
+}
@@ -0,0 +1,49 @@
+#ifndef IMAGE_RESAMPLER_H
+#define IMAGE_RESAMPLER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "image.h"
+
+// Scales images with a separable Kaiser windowed sinc, which keeps detail a box filter blurs and
+// aliases less than point sampling. Texels are widened to four floats and filtered a texel at a
+// time with SSE2 or NEON, color of sRGB images in linear space. Destination rows are split into
+// bands run as jobs, each one filters the source rows it covers horizontally first, so no image
+// sized float copy is ever made. Import brings images down to a largest side with it, low end
+// targets then skip decode, upload and memory of levels they would never sample.
+class ImageResampler {
+private:
+	// source texels one destination texel weighs along an axis, edges are clamped into range
+	typedef struct {
+		uint32_t first;
+		uint32_t count;
+		// into weights of kernel
+		uint32_t offset;
+	} Taps;
+
+	typedef struct {
+		std::vector<Taps> taps;
+		std::vector<float> weights;
+	} Kernel;
+
+	static Kernel _buildKernel(uint32_t srcSize, uint32_t dstSize);
+
+	// row of first level into four floats per texel, linear values
+	static void _widenRow(const Image &image, uint32_t row, float *pDst);
+	// floating point texels are clamped in place first, ringing must not make them negative
+	static void _narrowRow(
+			float *pSrc, uint32_t width, Image::Format format, bool isSrgb, uint8_t *pDst);
+
+public:
+	// first level filtered to size, nullptr for compressed images
+	static Image *resample(const Image &image, uint32_t width, uint32_t height);
+
+	// largest side brought down to maxSize keeping aspect, images with pre-built levels drop
+	// those past it instead, compressed ones without them and smaller images are returned as
+	// they are, 0 keeps every image
+	static std::shared_ptr<Image> limit(const std::shared_ptr<Image> &image, uint32_t maxSize);
+};
+
+#endif // !IMAGE_RESAMPLER_H
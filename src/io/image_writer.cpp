@@ -0,0 +1,175 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <tinyexr/tinyexr.h>
+#include <zlib/zlib.h>
+
+#include "image_writer.h"
+
+const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+static void _writeBigEndian(std::vector<uint8_t> &data, uint32_t value) {
+	data.push_back(static_cast<uint8_t>(value >> 24));
+	data.push_back(static_cast<uint8_t>(value >> 16));
+	data.push_back(static_cast<uint8_t>(value >> 8));
+	data.push_back(static_cast<uint8_t>(value));
+}
+
+// length, type, data and CRC of type and data
+static void _writeChunk(std::vector<uint8_t> &png, const char type[4],
+		const uint8_t *pData, size_t size) {
+	_writeBigEndian(png, static_cast<uint32_t>(size));
+
+	size_t typeOffset = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), pData, pData + size);
+
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, png.data() + typeOffset, static_cast<uInt>(size + 4));
+
+	_writeBigEndian(png, static_cast<uint32_t>(crc));
+}
+
+// pre-built levels are dropped, rows then follow each other
+static Image _getFirstLevel(const Image &image) {
+	const std::vector<uint8_t> &data = image.getData();
+	uint64_t size = Image::getLevelSize(image.getFormat(), image.getWidth(), image.getHeight());
+
+	return Image(image.getWidth(), image.getHeight(), image.getFormat(),
+			std::vector<uint8_t>(data.begin(), data.begin() + size));
+}
+
+static float _toLinear(uint8_t value) {
+	float c = value / 255.0f;
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+bool ImageWriter::savePng(const char *pFile, const Image &image) {
+	Image::Format format = image.getFormat();
+	Image converted = _getFirstLevel(image);
+
+	if (format != Image::Format::R8 && format != Image::Format::RGB8 &&
+			format != Image::Format::RGBA8)
+		converted.convert(Image::Format::RGBA8);
+
+	if (Image::isFormatCompressed(converted.getFormat())) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Compressed image %s can not be saved!", pFile);
+		return false;
+	}
+
+	uint32_t width = converted.getWidth();
+	uint32_t height = converted.getHeight();
+	uint32_t channelCount = Image::getFormatChannelCount(converted.getFormat());
+	size_t rowSize = static_cast<size_t>(width) * channelCount;
+
+	// filter type byte ahead of every row, no filtering
+	std::vector<uint8_t> rows((rowSize + 1) * height);
+	const uint8_t *pPixels = converted.getData().data();
+
+	for (uint32_t y = 0; y < height; y++) {
+		rows[y * (rowSize + 1)] = 0;
+		memcpy(&rows[y * (rowSize + 1) + 1], pPixels + y * rowSize, rowSize);
+	}
+
+	uLongf compressedSize = compressBound(static_cast<uLong>(rows.size()));
+	std::vector<uint8_t> compressed(compressedSize);
+
+	int err = compress2(compressed.data(), &compressedSize, rows.data(),
+			static_cast<uLong>(rows.size()), Z_DEFAULT_COMPRESSION);
+
+	if (err != Z_OK) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Image %s compression failed!", pFile);
+		return false;
+	}
+
+	const uint8_t colorTypes[5] = { 0, 0, 0, 2, 6 };
+
+	std::vector<uint8_t> header;
+	_writeBigEndian(header, width);
+	_writeBigEndian(header, height);
+	header.push_back(8);
+	header.push_back(colorTypes[channelCount]);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+
+	std::vector<uint8_t> png(PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+	_writeChunk(png, "IHDR", header.data(), header.size());
+	_writeChunk(png, "IDAT", compressed.data(), compressedSize);
+	_writeChunk(png, "IEND", nullptr, 0);
+
+	SDL_IOStream *pStream = SDL_IOFromFile(pFile, "wb");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Image %s can not be written!", pFile);
+		return false;
+	}
+
+	size_t written = SDL_WriteIO(pStream, png.data(), png.size());
+
+	if (!SDL_CloseIO(pStream) || written != png.size()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Image %s write failed!", pFile);
+		return false;
+	}
+
+	return true;
+}
+
+bool ImageWriter::saveExr(const char *pFile, const Image &image) {
+	Image::Format format = image.getFormat();
+
+	if (Image::isFormatCompressed(format)) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Compressed image %s can not be saved!", pFile);
+		return false;
+	}
+
+	uint32_t width = image.getWidth();
+	uint32_t height = image.getHeight();
+	size_t pixelCount = static_cast<size_t>(width) * height;
+
+	std::vector<float> pixels(pixelCount * 4);
+	Image converted = _getFirstLevel(image);
+
+	if (format == Image::Format::RGBA16F || format == Image::Format::RGBA32F) {
+		converted.convert(Image::Format::RGBA32F);
+
+		memcpy(pixels.data(), converted.getData().data(), pixels.size() * sizeof(float));
+	} else {
+		converted.convert(Image::Format::RGBA8);
+
+		const uint8_t *pData = converted.getData().data();
+
+		for (size_t i = 0; i < pixelCount * 4; i++)
+			pixels[i] = i % 4 == 3 ? pData[i] / 255.0f : _toLinear(pData[i]);
+	}
+
+	const char *pError = nullptr;
+	int err = SaveEXR(pixels.data(), static_cast<int>(width), static_cast<int>(height), 4, 1,
+			pFile, &pError);
+
+	if (err != TINYEXR_SUCCESS) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Image %s can not be written: %s", pFile,
+				pError != nullptr ? pError : "unknown error");
+
+		if (pError != nullptr)
+			FreeEXRErrorMessage(pError);
+
+		return false;
+	}
+
+	return true;
+}
+
+bool ImageWriter::save(const char *pFile, const Image &image) {
+	size_t length = SDL_strlen(pFile);
+
+	if (length >= 4 && SDL_strcasecmp(pFile + length - 4, ".exr") == 0)
+		return saveExr(pFile, image);
+
+	return savePng(pFile, image);
+}
@@ -0,0 +1,19 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "image.h"
+
+// Encodes first level of an image to file. Blocking and thread safe, so captures are encoded on
+// worker threads while frames keep rendering.
+class ImageWriter {
+public:
+	// R8, RGB8 and RGBA8 are written as they are, other formats are converted to RGBA8
+	static bool savePng(const char *pFile, const Image &image);
+	// half floats, 8 bit channels are taken as sRGB and stored linear, alpha as it is
+	static bool saveExr(const char *pFile, const Image &image);
+
+	// EXR for .exr extension, PNG otherwise
+	static bool save(const char *pFile, const Image &image);
+};
+
+#endif // !IMAGE_WRITER_H
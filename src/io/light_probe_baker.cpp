@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <SDL3/SDL_log.h>
+
+#include <job_system.h>
+#include <profiler.h>
+
+#include "light_probe_baker.h"
+#include "scene_raycaster.h"
+
+// real spherical harmonics basis of bands 0 and 1
+const float SH_L0 = 0.282095f;
+const float SH_L1 = 0.488603f;
+
+// cosine lobe convolution over pi, fully visible probe evaluates to 1
+const float CONVOLUTION_L1 = 2.0f / 3.0f;
+
+// ray origin is lifted off surfaces it may start on
+const float RAY_BIAS = 0.001f;
+
+std::vector<glm::vec3> LightProbeBaker::_computeDirections(uint32_t count) {
+	std::vector<glm::vec3> result(count);
+	const float goldenAngle = 3.14159265f * (3.0f - std::sqrt(5.0f));
+
+	// fibonacci sphere, rings of equal area with one point each
+	for (uint32_t i = 0; i < count; i++) {
+		float y = 1.0f - (static_cast<float>(i) + 0.5f) * 2.0f / static_cast<float>(count);
+		float radius = std::sqrt(std::max(1.0f - y * y, 0.0f));
+		float phi = goldenAngle * static_cast<float>(i);
+
+		result[i] = glm::vec3(std::cos(phi) * radius, y, std::sin(phi) * radius);
+	}
+
+	return result;
+}
+
+void LightProbeBaker::_fillBuried(LightProbeGrid &grid, const std::vector<bool> &isValid) {
+	const glm::ivec3 offsets[6] = {
+		{ -1, 0, 0 },
+		{ 1, 0, 0 },
+		{ 0, -1, 0 },
+		{ 0, 1, 0 },
+		{ 0, 0, -1 },
+		{ 0, 0, 1 },
+	};
+
+	glm::ivec3 counts = glm::ivec3(grid.counts);
+	std::vector<glm::vec4> probes = grid.probes;
+
+	for (int32_t z = 0; z < counts.z; z++) {
+		for (int32_t y = 0; y < counts.y; y++) {
+			for (int32_t x = 0; x < counts.x; x++) {
+				size_t index = (static_cast<size_t>(z) * counts.y + y) * counts.x + x;
+
+				if (isValid[index])
+					continue;
+
+				glm::vec4 sum = glm::vec4(0.0f);
+				uint32_t validCount = 0;
+
+				for (const glm::ivec3 &offset : offsets) {
+					glm::ivec3 neighbour = glm::ivec3(x, y, z) + offset;
+
+					if (glm::any(glm::lessThan(neighbour, glm::ivec3(0))) ||
+							glm::any(glm::greaterThanEqual(neighbour, counts)))
+						continue;
+
+					size_t neighbourIndex =
+							(static_cast<size_t>(neighbour.z) * counts.y + neighbour.y) * counts.x +
+							neighbour.x;
+
+					if (!isValid[neighbourIndex])
+						continue;
+
+					sum += grid.probes[neighbourIndex];
+					validCount++;
+				}
+
+				// surrounded by geometry, nothing is seen from there anyway
+				if (validCount > 0)
+					probes[index] = sum / static_cast<float>(validCount);
+				else
+					probes[index] = glm::vec4(0.0f);
+			}
+		}
+	}
+
+	grid.probes = std::move(probes);
+}
+
+LightProbeGrid LightProbeBaker::bake(const AssetLoader::Scene &scene, float spacing) {
+	PROFILE_ZONE("light probe bake");
+
+	SceneRaycaster raycaster;
+	raycaster.build(scene);
+
+	const AABB &sceneBounds = raycaster.getBounds();
+
+	LightProbeGrid grid = {};
+
+	if (sceneBounds.min.x > sceneBounds.max.x)
+		return grid;
+
+	glm::vec3 size = sceneBounds.max - sceneBounds.min;
+	glm::uvec3 counts;
+
+	// sparser grid rather than one too large to upload or bake
+	while (true) {
+		counts = glm::uvec3(glm::ceil(size / spacing)) + 1u;
+
+		if (static_cast<uint64_t>(counts.x) * counts.y * counts.z <= LIGHT_PROBE_MAX_COUNT)
+			break;
+
+		spacing *= 1.25f;
+	}
+
+	grid.spacing = glm::vec3(spacing);
+	grid.counts = counts;
+	grid.origin = sceneBounds.center() - glm::vec3(counts - 1u) * spacing * 0.5f;
+	grid.probes.resize(static_cast<size_t>(counts.x) * counts.y * counts.z);
+
+	std::vector<glm::vec3> directions = _computeDirections(LIGHT_PROBE_RAY_COUNT);
+	std::vector<bool> isValid(grid.probes.size());
+	// vector<bool> packs bits, neighbouring probes of other threads would share bytes
+	std::vector<uint8_t> isBuried(grid.probes.size(), 0);
+
+	float weight = 4.0f * 3.14159265f / static_cast<float>(LIGHT_PROBE_RAY_COUNT);
+
+	uint32_t probeCount = static_cast<uint32_t>(grid.probes.size());
+
+	JobSystem::parallelFor(probeCount, 16, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			glm::uvec3 cell = glm::uvec3(i % counts.x, (i / counts.x) % counts.y,
+					i / (counts.x * counts.y));
+			glm::vec3 position = grid.origin + glm::vec3(cell) * grid.spacing;
+
+			glm::vec4 coefficients = glm::vec4(0.0f);
+			uint32_t backFaceCount = 0;
+
+			for (const glm::vec3 &direction : directions) {
+				glm::vec3 origin = position + direction * RAY_BIAS;
+				float visibility = 1.0f;
+				SceneRaycaster::Hit hit;
+
+				if (raycaster.raycast(origin, direction, INFINITY, hit)) {
+					visibility = LIGHT_PROBE_BOUNCE;
+					backFaceCount += glm::dot(hit.normal, direction) > 0.0f ? 1 : 0;
+				}
+
+				coefficients += visibility *
+						glm::vec4(SH_L0, SH_L1 * direction.y, SH_L1 * direction.z,
+								SH_L1 * direction.x);
+			}
+
+			coefficients *= weight;
+			coefficients *= glm::vec4(1.0f, CONVOLUTION_L1, CONVOLUTION_L1, CONVOLUTION_L1);
+
+			grid.probes[i] = coefficients;
+			isBuried[i] = backFaceCount > LIGHT_PROBE_BURIED_RATIO * LIGHT_PROBE_RAY_COUNT;
+		}
+	});
+
+	uint32_t buriedCount = 0;
+
+	for (size_t i = 0; i < grid.probes.size(); i++) {
+		isValid[i] = isBuried[i] == 0;
+		buriedCount += isBuried[i];
+	}
+
+	_fillBuried(grid, isValid);
+
+	SDL_Log("Baked %u light probes (%u x %u x %u, %.2f apart), %u inside geometry", probeCount,
+			counts.x, counts.y, counts.z, spacing, buriedCount);
+
+	return grid;
+}
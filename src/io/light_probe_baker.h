@@ -0,0 +1,40 @@
+#ifndef LIGHT_PROBE_BAKER_H
+#define LIGHT_PROBE_BAKER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "asset_loader.h"
+#include "light_probes.h"
+
+// distance between probes unless grid would exceed LIGHT_PROBE_MAX_COUNT
+const float LIGHT_PROBE_SPACING = 2.0f;
+const uint32_t LIGHT_PROBE_MAX_COUNT = 32768;
+
+// rays cast from every probe, spread evenly over sphere
+const uint32_t LIGHT_PROBE_RAY_COUNT = 256;
+
+// visibility of a ray which hits geometry, stands in for light bounced off it
+const float LIGHT_PROBE_BOUNCE = 0.25f;
+
+// probe is inside geometry when more rays than this hit back faces, neighbours replace it
+const float LIGHT_PROBE_BURIED_RATIO = 0.25f;
+
+// Bakes sky visibility of a scene into a LightProbeGrid on the CPU. Grid covers bounds of mesh
+// instances, every probe casts rays through a SceneRaycaster and projects hits and misses onto
+// L1 spherical harmonics. Probes run in parallel on JobSystem.
+class LightProbeBaker {
+private:
+	static std::vector<glm::vec3> _computeDirections(uint32_t count);
+
+	// buried probes take average of valid neighbours along axes
+	static void _fillBuried(LightProbeGrid &grid, const std::vector<bool> &isValid);
+
+public:
+	static LightProbeGrid bake(
+			const AssetLoader::Scene &scene, float spacing = LIGHT_PROBE_SPACING);
+};
+
+#endif // !LIGHT_PROBE_BAKER_H
@@ -0,0 +1,23 @@
+#ifndef LIGHT_PROBES_H
+#define LIGHT_PROBES_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Regular grid of probes storing how much of the sky each direction sees, as L1 spherical
+// harmonics already convolved with cosine lobe. Shading multiplies sky irradiance by visibility
+// blended from the 8 probes around a point, so indoor areas darken without rebaking on sky
+// change. Empty grid counts as fully visible everywhere.
+struct LightProbeGrid {
+	// world position of first probe and distance between neighbours
+	glm::vec3 origin = glm::vec3(0.0f);
+	glm::vec3 spacing = glm::vec3(0.0f);
+	glm::uvec3 counts = glm::uvec3(0);
+
+	// x fastest, then y, then z, coefficients in order of L0, y, z, x
+	std::vector<glm::vec4> probes;
+};
+
+#endif // !LIGHT_PROBES_H
@@ -0,0 +1,608 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <SDL3/SDL_log.h>
+
+#include <job_system.h>
+#include <profiler.h>
+
+#include "image.h"
+#include "mesh_optimizer.h"
+
+#include "lightmap_baker.h"
+
+// density shrinks by it after charts failed to fit
+const float PACK_SHRINK = 0.8f;
+const uint32_t PACK_ATTEMPTS = 32;
+
+static float _cross(const glm::vec2 &a, const glm::vec2 &b) {
+	return a.x * b.y - a.y * b.x;
+}
+
+void LightmapBaker::_buildCharts(const Target &target,
+		const std::vector<glm::mat4> &worldTransforms, uint32_t targetIndex,
+		std::vector<Chart> &charts) {
+	const Primitive &primitive = *target.pPrimitive;
+	const glm::mat4 &transform = worldTransforms[target.nodeIndex];
+	uint32_t triangleCount = primitive.indices.count / 3;
+
+	std::vector<glm::vec3> positions(primitive.vertices.count);
+	bool hasLightmapUV = false;
+
+	for (uint32_t i = 0; i < primitive.vertices.count; i++) {
+		const Vertex &vertex = primitive.vertices.pData[i];
+
+		positions[i] = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+		hasLightmapUV = hasLightmapUV || vertex.lightmapUV != glm::vec2(0.0f);
+	}
+
+	auto addChart = [&](Chart &chart) {
+		chart.target = targetIndex;
+		chart.min = glm::vec2(INFINITY);
+		chart.max = glm::vec2(-INFINITY);
+
+		for (const glm::vec2 &coord : chart.coords) {
+			chart.min = glm::min(chart.min, coord);
+			chart.max = glm::max(chart.max, coord);
+		}
+
+		charts.push_back(std::move(chart));
+	};
+
+	// loaded uv keeps its layout as one chart, scaled to world size of primitive
+	if (hasLightmapUV) {
+		Chart chart = {};
+		float worldArea = 0.0f;
+		float uvArea = 0.0f;
+
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			const uint32_t *pIndices = primitive.indices.pData + i * 3;
+			glm::vec2 uvs[3];
+
+			for (uint32_t k = 0; k < 3; k++)
+				uvs[k] = primitive.vertices.pData[pIndices[k]].lightmapUV;
+
+			glm::vec3 edge0 = positions[pIndices[1]] - positions[pIndices[0]];
+			glm::vec3 edge1 = positions[pIndices[2]] - positions[pIndices[0]];
+
+			worldArea += glm::length(glm::cross(edge0, edge1));
+			uvArea += std::abs(_cross(uvs[1] - uvs[0], uvs[2] - uvs[0]));
+
+			chart.triangles.push_back(i * 3);
+			chart.coords.insert(chart.coords.end(), uvs, uvs + 3);
+		}
+
+		float scale = uvArea > 0.0f ? std::sqrt(worldArea / uvArea) : 0.0f;
+
+		for (glm::vec2 &coord : chart.coords)
+			coord *= scale;
+
+		addChart(chart);
+		return;
+	}
+
+	// loader splits vertices along normal and uv seams, faces meet at equal positions
+	std::unordered_map<glm::vec3, uint32_t> welded;
+	std::vector<uint32_t> canonical(primitive.vertices.count);
+
+	for (uint32_t i = 0; i < primitive.vertices.count; i++)
+		canonical[i] =
+				welded.emplace(positions[i], static_cast<uint32_t>(welded.size())).first->second;
+
+	std::vector<glm::vec3> normals(triangleCount);
+	std::vector<std::pair<uint64_t, uint32_t>> edges;
+	edges.reserve(primitive.indices.count);
+
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		const uint32_t *pIndices = primitive.indices.pData + i * 3;
+
+		glm::vec3 normal = glm::cross(positions[pIndices[1]] - positions[pIndices[0]],
+				positions[pIndices[2]] - positions[pIndices[0]]);
+		normals[i] = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+
+		for (uint32_t k = 0; k < 3; k++) {
+			uint64_t a = canonical[pIndices[k]];
+			uint64_t b = canonical[pIndices[(k + 1) % 3]];
+
+			if (a != b)
+				edges.push_back({ std::min(a, b) << 32 | std::max(a, b), i });
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<std::vector<uint32_t>> neighbours(triangleCount);
+
+	for (size_t first = 0; first < edges.size();) {
+		size_t last = first + 1;
+
+		while (last < edges.size() && edges[last].first == edges[first].first)
+			last++;
+
+		for (size_t i = first; i < last; i++) {
+			for (size_t j = i + 1; j < last; j++) {
+				neighbours[edges[i].second].push_back(edges[j].second);
+				neighbours[edges[j].second].push_back(edges[i].second);
+			}
+		}
+
+		first = last;
+	}
+
+	std::vector<bool> isAssigned(triangleCount, false);
+	std::vector<uint32_t> queue;
+
+	for (uint32_t seed = 0; seed < triangleCount; seed++) {
+		if (isAssigned[seed])
+			continue;
+
+		glm::vec3 normal = normals[seed];
+		glm::vec3 tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+
+		// degenerate seed stays alone, any plane does for it
+		if (glm::dot(normal, normal) > 0.0f) {
+			glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+													   : glm::vec3(0.0f, 1.0f, 0.0f);
+
+			tangent = glm::normalize(glm::cross(axis, normal));
+			bitangent = glm::cross(normal, tangent);
+		}
+
+		Chart chart = {};
+		isAssigned[seed] = true;
+		queue.push_back(seed);
+
+		while (!queue.empty()) {
+			uint32_t triangle = queue.back();
+			queue.pop_back();
+
+			chart.triangles.push_back(triangle * 3);
+
+			for (uint32_t k = 0; k < 3; k++) {
+				const glm::vec3 &position = positions[primitive.indices.pData[triangle * 3 + k]];
+				chart.coords.push_back(
+						glm::vec2(glm::dot(position, tangent), glm::dot(position, bitangent)));
+			}
+
+			for (uint32_t neighbour : neighbours[triangle]) {
+				if (isAssigned[neighbour] ||
+						glm::dot(normals[neighbour], normal) <= LIGHTMAP_CHART_COS)
+					continue;
+
+				isAssigned[neighbour] = true;
+				queue.push_back(neighbour);
+			}
+		}
+
+		addChart(chart);
+	}
+}
+
+bool LightmapBaker::_pack(std::vector<Chart> &charts, float density) {
+	for (Chart &chart : charts) {
+		glm::uvec2 size = glm::uvec2(glm::max(glm::ceil((chart.max - chart.min) * density), 1.0f));
+
+		chart.width = size.x + 2 * LIGHTMAP_PADDING;
+		chart.height = size.y + 2 * LIGHTMAP_PADDING;
+	}
+
+	std::vector<uint32_t> order(charts.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	std::sort(order.begin(), order.end(),
+			[&](uint32_t a, uint32_t b) { return charts[a].height > charts[b].height; });
+
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t shelfHeight = 0;
+
+	// first chart of shelf is its tallest
+	for (uint32_t index : order) {
+		Chart &chart = charts[index];
+
+		if (chart.width > LIGHTMAP_SIZE)
+			return false;
+
+		if (x + chart.width > LIGHTMAP_SIZE) {
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+
+		if (y + chart.height > LIGHTMAP_SIZE)
+			return false;
+
+		chart.x = x;
+		chart.y = y;
+
+		x += chart.width;
+		shelfHeight = std::max(shelfHeight, chart.height);
+	}
+
+	return true;
+}
+
+void LightmapBaker::_remap(const Target &target, const std::vector<Chart> &charts,
+		const std::vector<uint32_t> &targetCharts, float density, MeshArena &arena) {
+	const Primitive &primitive = *target.pPrimitive;
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	indices.reserve(primitive.indices.count);
+
+	// chart vertex was last copied into, copy is reused within it
+	std::vector<uint32_t> stamps(primitive.vertices.count, UINT32_MAX);
+	std::vector<uint32_t> remap(primitive.vertices.count);
+
+	for (uint32_t index : targetCharts) {
+		const Chart &chart = charts[index];
+
+		// chart is centered in its texels, so tiny ones still cover a texel center
+		glm::vec2 extent = (chart.max - chart.min) * density;
+		glm::vec2 inner = glm::vec2(chart.width, chart.height) - 2.0f * LIGHTMAP_PADDING;
+		glm::vec2 offset = glm::vec2(chart.x, chart.y) + static_cast<float>(LIGHTMAP_PADDING) +
+				(inner - extent) * 0.5f;
+
+		for (size_t i = 0; i < chart.triangles.size(); i++) {
+			for (uint32_t k = 0; k < 3; k++) {
+				uint32_t vertex = primitive.indices.pData[chart.triangles[i] + k];
+
+				if (stamps[vertex] != index) {
+					glm::vec2 texel = (chart.coords[i * 3 + k] - chart.min) * density + offset;
+
+					stamps[vertex] = index;
+					remap[vertex] = static_cast<uint32_t>(vertices.size());
+
+					vertices.push_back(primitive.vertices.pData[vertex]);
+					vertices.back().lightmapUV = texel / static_cast<float>(LIGHTMAP_SIZE);
+				}
+
+				indices.push_back(remap[vertex]);
+			}
+		}
+	}
+
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+	// former arrays may point into cooked file, they are left to arena or file
+	Primitive &result = *target.pPrimitive;
+	result.vertices = { arena.allocate<Vertex>(vertexCount), vertexCount };
+	result.indices = { arena.allocate<uint32_t>(indexCount), indexCount };
+	result.meshlets = {};
+	result.lods = {};
+
+	memcpy(result.vertices.pData, vertices.data(), vertexCount * sizeof(Vertex));
+	memcpy(result.indices.pData, indices.data(), indexCount * sizeof(uint32_t));
+
+	// charts split vertices, order is redone like for loaded primitives
+	MeshOptimizer::optimize(result);
+	MeshOptimizer::buildMeshlets(result, arena);
+	MeshOptimizer::buildLods(result, arena);
+}
+
+void LightmapBaker::_rasterize(const Target &target, const glm::mat4 &worldTransform,
+		std::vector<Texel> &texels) {
+	const Primitive &primitive = *target.pPrimitive;
+	glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(worldTransform));
+	float size = static_cast<float>(LIGHTMAP_SIZE);
+
+	for (uint32_t i = 0; i + 2 < primitive.indices.count; i += 3) {
+		const Vertex *pCorners[3];
+		glm::vec2 points[3];
+
+		for (uint32_t k = 0; k < 3; k++) {
+			pCorners[k] = &primitive.vertices.pData[primitive.indices.pData[i + k]];
+			points[k] = pCorners[k]->lightmapUV * size;
+		}
+
+		float area = _cross(points[1] - points[0], points[2] - points[0]);
+
+		if (area == 0.0f)
+			continue;
+
+		auto cover = [&](uint32_t x, uint32_t y, const glm::vec3 &weights) {
+			glm::vec3 position = weights.x * pCorners[0]->position +
+					weights.y * pCorners[1]->position + weights.z * pCorners[2]->position;
+			glm::vec3 normal = normalMatrix *
+					(weights.x * pCorners[0]->normal + weights.y * pCorners[1]->normal +
+							weights.z * pCorners[2]->normal);
+
+			Texel &texel = texels[static_cast<size_t>(y) * LIGHTMAP_SIZE + x];
+			texel.position = glm::vec3(worldTransform * glm::vec4(position, 1.0f));
+			texel.normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : normal;
+			texel.isCovered = true;
+		};
+
+		glm::vec2 min = glm::min(glm::min(points[0], points[1]), points[2]);
+		glm::vec2 max = glm::max(glm::max(points[0], points[1]), points[2]);
+
+		glm::uvec2 first = glm::uvec2(glm::clamp(glm::floor(min), 0.0f, size - 1.0f));
+		glm::uvec2 last = glm::uvec2(glm::clamp(glm::ceil(max), 0.0f, size - 1.0f));
+
+		bool isCovered = false;
+
+		for (uint32_t y = first.y; y <= last.y; y++) {
+			for (uint32_t x = first.x; x <= last.x; x++) {
+				glm::vec2 center = glm::vec2(x, y) + 0.5f;
+				glm::vec3 weights = glm::vec3(_cross(points[2] - points[1], center - points[1]),
+											  _cross(points[0] - points[2], center - points[2]),
+											  _cross(points[1] - points[0], center - points[0])) /
+						area;
+
+				if (glm::any(glm::lessThan(weights, glm::vec3(0.0f))))
+					continue;
+
+				cover(x, y, weights);
+				isCovered = true;
+			}
+		}
+
+		// sliver between texel centers still gets the texel under its centroid
+		if (!isCovered) {
+			glm::uvec2 texel = glm::uvec2(glm::clamp(
+					glm::floor((points[0] + points[1] + points[2]) / 3.0f), 0.0f, size - 1.0f));
+			cover(texel.x, texel.y, glm::vec3(1.0f / 3.0f));
+		}
+	}
+}
+
+glm::vec3 LightmapBaker::_shade(const AssetLoader::Scene &scene, const SceneRaycaster &raycaster,
+		const Texel &texel) {
+	const std::vector<glm::mat4> &worldTransforms = raycaster.getWorldTransforms();
+
+	glm::vec3 irradiance = glm::vec3(0.0f);
+	glm::vec3 origin = texel.position + texel.normal * LIGHTMAP_BIAS;
+
+	for (const AssetLoader::Light &light : scene.lights) {
+		const glm::mat4 &transform = worldTransforms[light.nodeIndex];
+		glm::vec3 radiance = light.color * light.intensity;
+
+		// ray toward light, distance is in its lengths
+		glm::vec3 toLight;
+		float maxDistance;
+
+		if (light.type == AssetLoader::LightType::Directional) {
+			toLight = -glm::normalize(glm::mat3(transform) * glm::vec3(0.0f, 0.0f, -1.0f));
+			maxDistance = INFINITY;
+		} else {
+			toLight = glm::vec3(transform[3]) - origin;
+			maxDistance = 1.0f;
+
+			float distance = glm::length(toLight);
+
+			if (distance == 0.0f)
+				continue;
+
+			// same falloff as runtime point lights in lighting_incl.glsl
+			float attenuation = 1.0f / (distance * distance);
+
+			if (light.range.has_value() && light.range.value() > 0.0f) {
+				float ratio = distance / light.range.value();
+				attenuation *= std::pow(glm::clamp(1.0f - std::pow(ratio, 4.0f), 0.0f, 1.0f), 2.0f);
+			}
+
+			radiance *= attenuation;
+		}
+
+		float nDotL = glm::dot(texel.normal, glm::normalize(toLight));
+
+		if (nDotL <= 0.0f || radiance == glm::vec3(0.0f))
+			continue;
+
+		SceneRaycaster::Hit hit;
+
+		if (raycaster.raycast(origin, toLight, maxDistance, hit))
+			continue;
+
+		irradiance += radiance * nDotL;
+	}
+
+	return irradiance;
+}
+
+void LightmapBaker::_dilate(std::vector<glm::vec3> &irradiance, std::vector<Texel> &texels) {
+	const glm::ivec2 offsets[4] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+	int32_t size = static_cast<int32_t>(LIGHTMAP_SIZE);
+
+	for (uint32_t pass = 0; pass < LIGHTMAP_DILATION_PASSES; pass++) {
+		std::vector<size_t> grown;
+
+		for (int32_t y = 0; y < size; y++) {
+			for (int32_t x = 0; x < size; x++) {
+				size_t index = static_cast<size_t>(y) * size + x;
+
+				if (texels[index].isCovered)
+					continue;
+
+				glm::vec3 sum = glm::vec3(0.0f);
+				uint32_t count = 0;
+
+				for (const glm::ivec2 &offset : offsets) {
+					glm::ivec2 neighbour = glm::ivec2(x, y) + offset;
+
+					if (neighbour.x < 0 || neighbour.y < 0 || neighbour.x >= size ||
+							neighbour.y >= size)
+						continue;
+
+					size_t neighbourIndex = static_cast<size_t>(neighbour.y) * size + neighbour.x;
+
+					if (!texels[neighbourIndex].isCovered)
+						continue;
+
+					sum += irradiance[neighbourIndex];
+					count++;
+				}
+
+				if (count == 0)
+					continue;
+
+				irradiance[index] = sum / static_cast<float>(count);
+				grown.push_back(index);
+			}
+		}
+
+		// marked after pass, so texels grow from covered ones only
+		for (size_t index : grown)
+			texels[index].isCovered = true;
+	}
+}
+
+void LightmapBaker::bake(AssetLoader::Scene &scene) {
+	PROFILE_ZONE("lightmap bake");
+
+	if (scene.lights.empty())
+		return;
+
+	// cooked scene carries its lightmap already
+	for (const AssetLoader::Light &light : scene.lights) {
+		if (light.isBaked)
+			return;
+	}
+
+	// instanced meshes would share one place in lightmap, only unique ones are baked
+	std::vector<uint32_t> instanceCounts(scene.meshes.size(), 0);
+	std::vector<uint64_t> meshNodes(scene.meshes.size());
+	// skinned and morphed meshes move away from light baked at rest pose
+	std::vector<bool> isSkinned(scene.meshes.size(), false);
+
+	for (const AssetLoader::MeshInstance &instance : scene.meshInstances) {
+		instanceCounts[instance.meshIndex]++;
+		meshNodes[instance.meshIndex] = instance.nodeIndex;
+
+		if (instance.skinIndex.has_value() || !instance.morphWeights.empty())
+			isSkinned[instance.meshIndex] = true;
+	}
+
+	std::vector<Target> targets;
+
+	for (size_t i = 0; i < scene.meshes.size(); i++) {
+		if (instanceCounts[i] != 1 || isSkinned[i])
+			continue;
+
+		const Mesh &mesh = scene.meshes[i];
+
+		for (uint32_t j = 0; j < mesh.primitiveCount; j++) {
+			if (mesh.pPrimitives[j].indices.count >= 3)
+				targets.push_back({ &mesh.pPrimitives[j], meshNodes[i] });
+		}
+	}
+
+	if (targets.empty())
+		return;
+
+	std::vector<glm::mat4> worldTransforms = SceneRaycaster::computeWorldTransforms(scene);
+	std::vector<Chart> charts;
+
+	for (uint32_t i = 0; i < targets.size(); i++)
+		_buildCharts(targets[i], worldTransforms, i, charts);
+
+	float density = LIGHTMAP_TEXELS_PER_UNIT;
+	bool isPacked = false;
+
+	for (uint32_t i = 0; i < PACK_ATTEMPTS && !isPacked; i++) {
+		isPacked = _pack(charts, density);
+
+		if (!isPacked)
+			density *= PACK_SHRINK;
+	}
+
+	if (!isPacked) {
+		SDL_Log("Lightmap skipped, %zu charts do not fit %u x %u", charts.size(), LIGHTMAP_SIZE,
+				LIGHTMAP_SIZE);
+		return;
+	}
+
+	std::vector<std::vector<uint32_t>> targetCharts(targets.size());
+
+	for (uint32_t i = 0; i < charts.size(); i++)
+		targetCharts[charts[i].target].push_back(i);
+
+	uint32_t targetCount = static_cast<uint32_t>(targets.size());
+
+	// charts do not overlap, targets write texels of their own
+	std::vector<Texel> texels(static_cast<size_t>(LIGHTMAP_SIZE) * LIGHTMAP_SIZE);
+
+	JobSystem::parallelFor(targetCount, 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			_remap(targets[i], charts, targetCharts[i], density, *scene.arena);
+			_rasterize(targets[i], worldTransforms[targets[i].nodeIndex], texels);
+		}
+	});
+
+	// built over remapped primitives, positions are the same
+	SceneRaycaster raycaster;
+	raycaster.build(scene);
+
+	uint32_t texelCount = LIGHTMAP_SIZE * LIGHTMAP_SIZE;
+	std::vector<glm::vec3> irradiance(texelCount, glm::vec3(0.0f));
+
+	JobSystem::parallelFor(texelCount, 256, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			if (!texels[i].isCovered)
+				continue;
+
+			irradiance[i] = _shade(scene, raycaster, texels[i]);
+		}
+	});
+
+	uint32_t coveredCount = 0;
+
+	for (const Texel &texel : texels)
+		coveredCount += texel.isCovered ? 1 : 0;
+
+	_dilate(irradiance, texels);
+
+	std::vector<float> pixels(static_cast<size_t>(texelCount) * 4, 1.0f);
+
+	for (uint32_t i = 0; i < texelCount; i++)
+		memcpy(&pixels[i * 4], &irradiance[i], sizeof(glm::vec3));
+
+	std::vector<uint8_t> data(Image::getLevelSize(Image::Format::RGBA16F, LIGHTMAP_SIZE,
+			LIGHTMAP_SIZE));
+	Image::packHalfs(pixels.data(), reinterpret_cast<uint16_t *>(data.data()), pixels.size());
+
+	uint64_t imageIndex = scene.images.size();
+	scene.images.push_back(std::make_shared<Image>(
+			LIGHTMAP_SIZE, LIGHTMAP_SIZE, Image::Format::RGBA16F, std::move(data)));
+
+	// materials shared with unbaked primitives are copied, those keep runtime look
+	std::vector<std::optional<uint64_t>> copies(scene.materials.size());
+
+	for (const Target &target : targets) {
+		uint64_t &materialIndex = target.pPrimitive->materialIndex;
+
+		if (materialIndex >= copies.size())
+			continue;
+
+		if (!copies[materialIndex].has_value()) {
+			AssetLoader::Material material = scene.materials[materialIndex];
+			material.lightmapIndex = imageIndex;
+			material.name += " lightmap";
+
+			copies[materialIndex] = scene.materials.size();
+			scene.materials.push_back(std::move(material));
+		}
+
+		materialIndex = copies[materialIndex].value();
+	}
+
+	for (AssetLoader::Light &light : scene.lights)
+		light.isBaked = true;
+
+	SDL_Log("Baked lightmap of %zu charts at %.2f texels per unit, %u texels covered, %zu lights",
+			charts.size(), density, coveredCount, scene.lights.size());
+}
@@ -0,0 +1,84 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "asset_loader.h"
+#include "scene_raycaster.h"
+
+// side of the one square lightmap of scene
+const uint32_t LIGHTMAP_SIZE = 1024;
+
+// texel density charts get unless they would not fit, halved density quarters their texels
+const float LIGHTMAP_TEXELS_PER_UNIT = 8.0f;
+
+// empty texels around every chart, filtering and dilation stay within them
+const uint32_t LIGHTMAP_PADDING = 2;
+
+// face joins chart while cosine between its normal and normal of chart seed is above it
+const float LIGHTMAP_CHART_COS = 0.7f;
+
+// shadow rays start this far off surface, along its normal
+const float LIGHTMAP_BIAS = 0.01f;
+
+// passes growing charts into their padding, so filtering never reads empty texels
+const uint32_t LIGHTMAP_DILATION_PASSES = 2;
+
+// Bakes direct light of scene lights into one RGBA16F lightmap on the CPU. Meshes drawn once are
+// unwrapped into charts of connected faces facing about the same way, each projected on its
+// plane, while loaded lightmap uv stays a chart of its own. Charts are shelf packed and every
+// texel casts shadow rays through a SceneRaycaster, texels run in parallel on JobSystem. Baked
+// primitives get a copy of their material referencing lightmap and lights are marked baked,
+// renderer then leaves them out of runtime lighting. Bounced light is left to probes and
+// environment.
+class LightmapBaker {
+private:
+	typedef struct {
+		Primitive *pPrimitive;
+		uint64_t nodeIndex;
+	} Target;
+
+	typedef struct {
+		uint32_t target;
+		// first index of every triangle
+		std::vector<uint32_t> triangles;
+		// per corner of triangles, world units
+		std::vector<glm::vec2> coords;
+		glm::vec2 min;
+		glm::vec2 max;
+
+		// texels, padding included
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	} Chart;
+
+	typedef struct {
+		glm::vec3 position;
+		glm::vec3 normal;
+		bool isCovered;
+	} Texel;
+
+	static void _buildCharts(const Target &target, const std::vector<glm::mat4> &worldTransforms,
+			uint32_t targetIndex, std::vector<Chart> &charts);
+	// false when charts do not fit at density
+	static bool _pack(std::vector<Chart> &charts, float density);
+	// new vertices of target, one per vertex of every chart it is used in
+	static void _remap(const Target &target, const std::vector<Chart> &charts,
+			const std::vector<uint32_t> &targetCharts, float density, MeshArena &arena);
+	static void _rasterize(const Target &target, const glm::mat4 &worldTransform,
+			std::vector<Texel> &texels);
+	static glm::vec3 _shade(const AssetLoader::Scene &scene, const SceneRaycaster &raycaster,
+			const Texel &texel);
+	// empty texels next to covered ones take their average, coverage grows by one each pass
+	static void _dilate(std::vector<glm::vec3> &irradiance, std::vector<Texel> &texels);
+
+public:
+	static void bake(AssetLoader::Scene &scene);
+};
+
+#endif // !LIGHTMAP_BAKER_H
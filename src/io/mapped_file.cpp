@@ -0,0 +1,84 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+bool MappedFile::open(const std::filesystem::path &path, size_t padding) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(info.st_size);
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t capacity = (size + padding + pageSize - 1) / pageSize * pageSize;
+
+	// pages past end of file would fault, anonymous reservation backs them and file is mapped
+	// over its start
+	void *pReserved =
+			mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (pReserved == MAP_FAILED) {
+		::close(fd);
+		return false;
+	}
+
+	void *pFile = mmap(pReserved, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+	::close(fd);
+
+	if (pFile == MAP_FAILED) {
+		munmap(pReserved, capacity);
+		return false;
+	}
+
+	// cold loads touch most of the file, start reading ahead right away
+	madvise(pFile, size, MADV_WILLNEED);
+
+	_pData = static_cast<uint8_t *>(pFile);
+	_size = size;
+	_capacity = capacity;
+
+	return true;
+}
+
+void MappedFile::close() {
+	if (_pData == nullptr)
+		return;
+
+	munmap(_pData, _capacity);
+
+	_pData = nullptr;
+	_size = 0;
+	_capacity = 0;
+}
+
+uint8_t *MappedFile::getData() const {
+	return _pData;
+}
+
+size_t MappedFile::getSize() const {
+	return _size;
+}
+
+size_t MappedFile::getCapacity() const {
+	return _capacity;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Read only view of a whole file, pages are loaded on first access and shared with page cache.
+// Mapping is private, so writes stay in process and never reach the file.
+class MappedFile {
+private:
+	uint8_t *_pData = nullptr;
+	size_t _size = 0;
+	size_t _capacity = 0;
+
+public:
+	MappedFile(MappedFile const &) = delete;
+	void operator=(MappedFile const &) = delete;
+
+	// padding bytes after end of file are zero, parsers reading past end need them
+	bool open(const std::filesystem::path &path, size_t padding = 0);
+	void close();
+
+	uint8_t *getData() const;
+	size_t getSize() const;
+	// size plus padding, rounded up to page size
+	size_t getCapacity() const;
+
+	MappedFile() = default;
+	~MappedFile();
+};
+
+#endif // !MAPPED_FILE_H
@@ -14,10 +14,73 @@ typedef struct {
 	uint32_t count;
 } IndexArray;
 
+// triangles culled together, their indices are contiguous in index array
+typedef struct {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+
+	// bounding sphere
+	glm::vec3 center;
+	float radius;
+
+	// every triangle faces away from viewer once dot(view direction, axis) is above cutoff, 1
+	// when triangles spread too far for cone to reject anything
+	glm::vec3 coneAxis;
+	float coneCutoff;
+} Meshlet;
+
+typedef struct {
+	Meshlet *pData;
+	uint32_t count;
+} MeshletArray;
+
+// levels built after full detail one
+const uint32_t MAX_LOD_COUNT = 4;
+
+// coarser triangles over vertices of primitive
+typedef struct {
+	IndexArray indices;
+
+	// furthest a surface point moved, mesh space
+	float error;
+} Lod;
+
+typedef struct {
+	Lod *pData;
+	uint32_t count;
+} LodArray;
+
+// offset of one vertex at full weight of its target, mesh space
+typedef struct {
+	uint32_t vertex;
+	glm::vec3 position;
+	glm::vec3 normal;
+} MorphDelta;
+
+// blend shape, vertices it does not move are left out, ascending by vertex
+typedef struct {
+	MorphDelta *pDeltas;
+	uint32_t deltaCount;
+} MorphTarget;
+
+typedef struct {
+	MorphTarget *pData;
+	uint32_t count;
+} MorphTargetArray;
+
 typedef struct {
 	VertexArray vertices;
 	IndexArray indices;
 	uint64_t materialIndex;
+
+	// empty until built by MeshOptimizer
+	MeshletArray meshlets;
+
+	// coarser and with larger error each
+	LodArray lods;
+
+	// every primitive of mesh has the same count, weights of instance apply to all of them
+	MorphTargetArray morphTargets;
 } Primitive;
 
 typedef struct {
@@ -27,4 +90,30 @@ typedef struct {
 	const char *pName;
 } Mesh;
 
+// per axis, sum over targets of largest offset of any vertex, bounds grown by it hold every pose
+// with weights between -1 and 1
+inline glm::vec3 getMorphExtent(const Mesh &mesh) {
+	glm::vec3 extent = glm::vec3(0.0f);
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const MorphTargetArray &targets = mesh.pPrimitives[i].morphTargets;
+		glm::vec3 primitiveExtent = glm::vec3(0.0f);
+
+		for (uint32_t j = 0; j < targets.count; j++) {
+			glm::vec3 targetExtent = glm::vec3(0.0f);
+
+			const MorphTarget &target = targets.pData[j];
+
+			for (uint32_t k = 0; k < target.deltaCount; k++)
+				targetExtent = glm::max(targetExtent, glm::abs(target.pDeltas[k].position));
+
+			primitiveExtent += targetExtent;
+		}
+
+		extent = glm::max(extent, primitiveExtent);
+	}
+
+	return extent;
+}
+
 #endif // !MESH_H
@@ -0,0 +1,52 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "mesh_arena.h"
+
+void *MeshArena::_allocate(size_t size, size_t alignment) {
+	if (size == 0)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (!_blocks.empty()) {
+		Block &block = _blocks.back();
+		size_t offset = (block.used + alignment - 1) & ~(alignment - 1);
+
+		if (offset + size <= block.size) {
+			block.used = offset + size;
+			return block.pData + offset;
+		}
+	}
+
+	// calloc aligns for any type, blocks are never reused so every allocation stays zeroed
+	if (size > MESH_ARENA_BLOCK_SIZE / 4) {
+		uint8_t *pData = static_cast<uint8_t *>(calloc(size, 1));
+
+		// in front of block being bumped, its free tail stays usable
+		_blocks.insert(_blocks.empty() ? _blocks.end() : _blocks.end() - 1, { pData, size, size });
+		return pData;
+	}
+
+	uint8_t *pData = static_cast<uint8_t *>(calloc(MESH_ARENA_BLOCK_SIZE, 1));
+	_blocks.push_back({ pData, MESH_ARENA_BLOCK_SIZE, size });
+
+	return pData;
+}
+
+const char *MeshArena::copyString(const char *pString) {
+	size_t length = strlen(pString);
+	char *pCopy = allocate<char>(length + 1);
+
+	memcpy(pCopy, pString, length);
+
+	return pCopy;
+}
+
+MeshArena::~MeshArena() {
+	for (Block &block : _blocks)
+		free(block.pData);
+}
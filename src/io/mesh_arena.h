@@ -0,0 +1,45 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// blocks allocations are bumped out of, larger allocations take a block of their own
+const size_t MESH_ARENA_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// Owns CPU side geometry of one decoded scene, its vertex, index, meshlet, level and primitive
+// arrays and mesh names. Allocations are bumped out of large zeroed blocks and never freed one by
+// one, all of them go with arena once scene is uploaded. Safe to allocate from any thread,
+// primitives are loaded in parallel.
+class MeshArena {
+private:
+	typedef struct {
+		uint8_t *pData;
+		size_t size;
+		size_t used;
+	} Block;
+
+	std::vector<Block> _blocks;
+	std::mutex _mutex;
+
+	// last block is the one allocations are bumped out of
+	void *_allocate(size_t size, size_t alignment);
+
+public:
+	MeshArena(MeshArena const &) = delete;
+	void operator=(MeshArena const &) = delete;
+
+	// zeroed, nullptr for zero count
+	template <typename T> T *allocate(size_t count) {
+		return static_cast<T *>(_allocate(count * sizeof(T), alignof(T)));
+	}
+
+	const char *copyString(const char *pString);
+
+	MeshArena() = default;
+	~MeshArena();
+};
+
+#endif // !MESH_ARENA_H
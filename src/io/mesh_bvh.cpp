@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <profiler.h>
+
+#include "mesh_bvh.h"
+
+const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+// leaves are split past this size even when SAH asks for a leaf, keeps worst query bounded
+const uint32_t MAX_LEAF_SIZE = 4 * MESH_BVH_LEAF_SIZE;
+
+float MeshBVH::_area(const AABB &aabb) {
+	glm::vec3 size = aabb.max - aabb.min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+uint32_t MeshBVH::_buildBinary(std::vector<BuildNode> &nodes, std::vector<uint32_t> &order,
+		const std::vector<AABB> &bounds, const std::vector<glm::vec3> &centroids, uint32_t first,
+		uint32_t count) {
+	AABB aabb = bounds[order[first]];
+	AABB centroidBounds = { centroids[order[first]], centroids[order[first]] };
+
+	for (uint32_t i = first; i < first + count; i++) {
+		aabb.expand(bounds[order[i]].min);
+		aabb.expand(bounds[order[i]].max);
+		centroidBounds.expand(centroids[order[i]]);
+	}
+
+	uint32_t index = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({ aabb, EMPTY_SLOT, EMPTY_SLOT, first, count });
+
+	if (count <= MESH_BVH_LEAF_SIZE)
+		return index;
+
+	glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+	uint32_t axis = extent.x > extent.y ? 0 : 1;
+	axis = extent[axis] > extent.z ? axis : 2;
+
+	uint32_t *pBegin = order.data() + first;
+	uint32_t *pEnd = pBegin + count;
+	uint32_t *pMiddle = pBegin;
+
+	if (extent[axis] > 0.0f) {
+		AABB binBounds[MESH_BVH_BIN_COUNT];
+		uint32_t binCounts[MESH_BVH_BIN_COUNT] = {};
+
+		float binScale = MESH_BVH_BIN_COUNT / extent[axis];
+
+		auto getBin = [&](uint32_t triangle) {
+			float offset = centroids[triangle][axis] - centroidBounds.min[axis];
+			uint32_t bin = static_cast<uint32_t>(offset * binScale);
+			return std::min(bin, MESH_BVH_BIN_COUNT - 1);
+		};
+
+		for (uint32_t *pIt = pBegin; pIt != pEnd; pIt++) {
+			uint32_t bin = getBin(*pIt);
+
+			if (binCounts[bin] == 0)
+				binBounds[bin] = bounds[*pIt];
+
+			binBounds[bin].expand(bounds[*pIt].min);
+			binBounds[bin].expand(bounds[*pIt].max);
+			binCounts[bin]++;
+		}
+
+		// cost of every split plane from both sides, triangle and node tests weigh the same
+		float leftCosts[MESH_BVH_BIN_COUNT] = {};
+		AABB sweep;
+		uint32_t sweepCount = 0;
+
+		for (uint32_t i = 0; i + 1 < MESH_BVH_BIN_COUNT; i++) {
+			if (binCounts[i] > 0) {
+				if (sweepCount == 0)
+					sweep = binBounds[i];
+
+				sweep.expand(binBounds[i].min);
+				sweep.expand(binBounds[i].max);
+				sweepCount += binCounts[i];
+			}
+
+			leftCosts[i] = sweepCount > 0 ? _area(sweep) * sweepCount : 0.0f;
+		}
+
+		float bestCost = INFINITY;
+		uint32_t bestSplit = 0;
+		sweepCount = 0;
+
+		for (uint32_t i = MESH_BVH_BIN_COUNT - 1; i > 0; i--) {
+			if (binCounts[i] > 0) {
+				if (sweepCount == 0)
+					sweep = binBounds[i];
+
+				sweep.expand(binBounds[i].min);
+				sweep.expand(binBounds[i].max);
+				sweepCount += binCounts[i];
+			}
+
+			float rightCost = sweepCount > 0 ? _area(sweep) * sweepCount : 0.0f;
+			float cost = leftCosts[i - 1] + rightCost;
+
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		float leafCost = _area(aabb) * count;
+
+		if (bestCost >= leafCost && count <= MAX_LEAF_SIZE)
+			return index;
+
+		pMiddle = std::partition(
+				pBegin, pEnd, [&](uint32_t triangle) { return getBin(triangle) < bestSplit; });
+	}
+
+	// centroids fall in one bin, halves by centroid order still shrink bounds
+	if (pMiddle == pBegin || pMiddle == pEnd) {
+		pMiddle = pBegin + count / 2;
+		std::nth_element(pBegin, pMiddle, pEnd, [&](uint32_t a, uint32_t b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+	}
+
+	uint32_t leftCount = static_cast<uint32_t>(pMiddle - pBegin);
+
+	uint32_t left = _buildBinary(nodes, order, bounds, centroids, first, leftCount);
+	uint32_t right =
+			_buildBinary(nodes, order, bounds, centroids, first + leftCount, count - leftCount);
+
+	nodes[index].left = left;
+	nodes[index].right = right;
+
+	return index;
+}
+
+uint32_t MeshBVH::_collapse(const std::vector<BuildNode> &nodes, uint32_t node) {
+	uint32_t slots[MESH_BVH_WIDTH];
+	uint32_t slotCount = 0;
+
+	if (nodes[node].left == EMPTY_SLOT) {
+		slots[slotCount++] = node;
+	} else {
+		slots[slotCount++] = nodes[node].left;
+		slots[slotCount++] = nodes[node].right;
+	}
+
+	// inner child with largest surface is opened until node is full
+	while (slotCount < MESH_BVH_WIDTH) {
+		uint32_t largest = EMPTY_SLOT;
+		float largestArea = -1.0f;
+
+		for (uint32_t i = 0; i < slotCount; i++) {
+			const BuildNode &child = nodes[slots[i]];
+
+			if (child.left != EMPTY_SLOT && _area(child.aabb) > largestArea) {
+				largest = i;
+				largestArea = _area(child.aabb);
+			}
+		}
+
+		if (largest == EMPTY_SLOT)
+			break;
+
+		uint32_t opened = slots[largest];
+		slots[largest] = nodes[opened].left;
+		slots[slotCount++] = nodes[opened].right;
+	}
+
+	uint32_t wide = static_cast<uint32_t>(_nodes.size());
+	_nodes.emplace_back();
+
+	for (uint32_t i = 0; i < MESH_BVH_WIDTH; i++) {
+		_nodes[wide].minX[i] = _nodes[wide].minY[i] = _nodes[wide].minZ[i] = INFINITY;
+		_nodes[wide].maxX[i] = _nodes[wide].maxY[i] = _nodes[wide].maxZ[i] = -INFINITY;
+		_nodes[wide].children[i] = EMPTY_SLOT;
+		_nodes[wide].counts[i] = 0;
+	}
+
+	for (uint32_t i = 0; i < slotCount; i++) {
+		const BuildNode &child = nodes[slots[i]];
+
+		// children are appended after node, it is looked up again every time
+		uint32_t target = child.left == EMPTY_SLOT ? child.first : _collapse(nodes, slots[i]);
+		Node &wideNode = _nodes[wide];
+
+		wideNode.minX[i] = child.aabb.min.x;
+		wideNode.minY[i] = child.aabb.min.y;
+		wideNode.minZ[i] = child.aabb.min.z;
+		wideNode.maxX[i] = child.aabb.max.x;
+		wideNode.maxY[i] = child.aabb.max.y;
+		wideNode.maxZ[i] = child.aabb.max.z;
+
+		wideNode.children[i] = target;
+		wideNode.counts[i] = child.left == EMPTY_SLOT ? child.count : 0;
+	}
+
+	return wide;
+}
+
+bool MeshBVH::_intersect(const Triangle &triangle, const glm::vec3 &origin,
+		const glm::vec3 &direction, float &distance) const {
+	const glm::vec3 &p0 = _positions[triangle.indices[0]];
+	glm::vec3 edge1 = _positions[triangle.indices[1]] - p0;
+	glm::vec3 edge2 = _positions[triangle.indices[2]] - p0;
+
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+
+	// ray parallel to triangle, both faces are hit otherwise
+	if (std::abs(determinant) < 1e-12f)
+		return false;
+
+	float invDeterminant = 1.0f / determinant;
+	glm::vec3 offset = origin - p0;
+
+	float u = glm::dot(offset, p) * invDeterminant;
+
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	glm::vec3 q = glm::cross(offset, edge1);
+	float v = glm::dot(direction, q) * invDeterminant;
+
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	float t = glm::dot(edge2, q) * invDeterminant;
+
+	if (t < 0.0f || t >= distance)
+		return false;
+
+	distance = t;
+	return true;
+}
+
+void MeshBVH::build(const Mesh &mesh) {
+	PROFILE_ZONE("mesh bvh build");
+
+	_nodes.clear();
+	_triangles.clear();
+	_positions.clear();
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const Primitive &primitive = mesh.pPrimitives[i];
+		uint32_t base = static_cast<uint32_t>(_positions.size());
+
+		for (uint32_t j = 0; j < primitive.vertices.count; j++)
+			_positions.push_back(primitive.vertices.pData[j].position);
+
+		for (uint32_t j = 0; j + 2 < primitive.indices.count; j += 3) {
+			const uint32_t *pIndices = primitive.indices.pData + j;
+			_triangles.push_back(
+					{ { base + pIndices[0], base + pIndices[1], base + pIndices[2] }, i, j });
+		}
+	}
+
+	if (_triangles.empty())
+		return;
+
+	uint32_t triangleCount = static_cast<uint32_t>(_triangles.size());
+
+	std::vector<AABB> bounds(triangleCount);
+	std::vector<glm::vec3> centroids(triangleCount);
+	std::vector<uint32_t> order(triangleCount);
+
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		const Triangle &triangle = _triangles[i];
+		const glm::vec3 &p0 = _positions[triangle.indices[0]];
+
+		bounds[i] = { p0, p0 };
+		bounds[i].expand(_positions[triangle.indices[1]]);
+		bounds[i].expand(_positions[triangle.indices[2]]);
+
+		centroids[i] = bounds[i].center();
+		order[i] = i;
+	}
+
+	std::vector<BuildNode> nodes;
+	nodes.reserve(2 * triangleCount / MESH_BVH_LEAF_SIZE + 1);
+
+	uint32_t root = _buildBinary(nodes, order, bounds, centroids, 0, triangleCount);
+	_collapse(nodes, root);
+
+	// leaves refer to ranges of build order
+	std::vector<Triangle> sorted(triangleCount);
+
+	for (uint32_t i = 0; i < triangleCount; i++)
+		sorted[i] = _triangles[order[i]];
+
+	_triangles = std::move(sorted);
+}
+
+bool MeshBVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+		Hit &hit) const {
+	if (_nodes.empty())
+		return false;
+
+	// infinite along axes ray does not move on, slabs of those pass or fail as a whole
+	glm::vec3 invDirection = 1.0f / direction;
+
+	float closest = maxDistance;
+	const Triangle *pClosest = nullptr;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty()) {
+		const Node &node = _nodes[stack.back()];
+		stack.pop_back();
+
+		float entries[MESH_BVH_WIDTH];
+
+		// all slabs of node at once, empty slots are masked after
+		for (uint32_t i = 0; i < MESH_BVH_WIDTH; i++) {
+			float x0 = (node.minX[i] - origin.x) * invDirection.x;
+			float x1 = (node.maxX[i] - origin.x) * invDirection.x;
+			float y0 = (node.minY[i] - origin.y) * invDirection.y;
+			float y1 = (node.maxY[i] - origin.y) * invDirection.y;
+			float z0 = (node.minZ[i] - origin.z) * invDirection.z;
+			float z1 = (node.maxZ[i] - origin.z) * invDirection.z;
+
+			float enter = std::max(std::max(std::min(x0, x1), std::min(y0, y1)),
+					std::max(std::min(z0, z1), 0.0f));
+			float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)),
+					std::min(std::max(z0, z1), closest));
+
+			entries[i] = enter <= exit ? enter : INFINITY;
+		}
+
+		uint32_t slots[MESH_BVH_WIDTH];
+		uint32_t slotCount = 0;
+
+		// nearest first
+		for (uint32_t i = 0; i < MESH_BVH_WIDTH; i++) {
+			if (node.children[i] == EMPTY_SLOT || entries[i] == INFINITY)
+				continue;
+
+			uint32_t j = slotCount++;
+
+			for (; j > 0 && entries[slots[j - 1]] > entries[i]; j--)
+				slots[j] = slots[j - 1];
+
+			slots[j] = i;
+		}
+
+		for (uint32_t i = 0; i < slotCount; i++) {
+			uint32_t slot = slots[i];
+
+			if (node.counts[slot] == 0 || entries[slot] >= closest)
+				continue;
+
+			for (uint32_t j = 0; j < node.counts[slot]; j++) {
+				const Triangle &triangle = _triangles[node.children[slot] + j];
+
+				if (_intersect(triangle, origin, direction, closest))
+					pClosest = &triangle;
+			}
+		}
+
+		// farthest is pushed first, so nearest inner child is popped next
+		for (uint32_t i = slotCount; i > 0; i--) {
+			uint32_t slot = slots[i - 1];
+
+			if (node.counts[slot] == 0 && entries[slot] < closest)
+				stack.push_back(node.children[slot]);
+		}
+	}
+
+	if (pClosest == nullptr)
+		return false;
+
+	const glm::vec3 &p0 = _positions[pClosest->indices[0]];
+
+	hit.distance = closest;
+	hit.primitive = pClosest->primitive;
+	hit.firstIndex = pClosest->firstIndex;
+	hit.normal = glm::cross(_positions[pClosest->indices[1]] - p0,
+			_positions[pClosest->indices[2]] - p0);
+
+	return true;
+}
+
+uint32_t MeshBVH::getTriangleCount() const {
+	return static_cast<uint32_t>(_triangles.size());
+}
+
+size_t MeshBVH::getMemorySize() const {
+	return _nodes.size() * sizeof(Node) + _triangles.size() * sizeof(Triangle) +
+			_positions.size() * sizeof(glm::vec3);
+}
@@ -0,0 +1,95 @@
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/types/aabb.h>
+
+#include "mesh.h"
+
+// width of BVH nodes, children bounds of a node are tested together
+const uint32_t MESH_BVH_WIDTH = 4;
+
+// leaf is not split further at or below this many triangles
+const uint32_t MESH_BVH_LEAF_SIZE = 4;
+
+// buckets centroids are sorted into when split is searched for
+const uint32_t MESH_BVH_BIN_COUNT = 12;
+
+// Bounding volume hierarchy over triangles of every primitive of mesh, answers ray casts on the
+// CPU. Splits minimize surface area heuristic over binned centroids, binary tree is collapsed
+// into nodes of MESH_BVH_WIDTH children whose bounds are stored as structure of arrays, so one
+// slab test covers the whole node in straight vector code. Positions are copied, mesh may be
+// freed once built.
+class MeshBVH {
+public:
+	typedef struct {
+		// along ray, in lengths of its direction
+		float distance;
+		uint32_t primitive;
+		// first index of triangle in index array of primitive
+		uint32_t firstIndex;
+		// mesh space, not normalized
+		glm::vec3 normal;
+	} Hit;
+
+private:
+	typedef struct {
+		float minX[MESH_BVH_WIDTH];
+		float minY[MESH_BVH_WIDTH];
+		float minZ[MESH_BVH_WIDTH];
+		float maxX[MESH_BVH_WIDTH];
+		float maxY[MESH_BVH_WIDTH];
+		float maxZ[MESH_BVH_WIDTH];
+
+		// node of inner child, first triangle of leaf child, UINT32_MAX for empty slot
+		uint32_t children[MESH_BVH_WIDTH];
+		// triangles of leaf child, 0 for inner child
+		uint32_t counts[MESH_BVH_WIDTH];
+	} Node;
+
+	typedef struct {
+		uint32_t indices[3];
+		uint32_t primitive;
+		uint32_t firstIndex;
+	} Triangle;
+
+	// binary tree of build, leaves hold a range of triangles
+	typedef struct {
+		AABB aabb;
+		uint32_t left;
+		uint32_t right;
+		uint32_t first;
+		uint32_t count;
+	} BuildNode;
+
+	std::vector<Node> _nodes;
+	std::vector<Triangle> _triangles;
+	std::vector<glm::vec3> _positions;
+
+	static float _area(const AABB &aabb);
+
+	// reorders triangles of range in order so children of returned node hold contiguous parts
+	static uint32_t _buildBinary(std::vector<BuildNode> &nodes, std::vector<uint32_t> &order,
+			const std::vector<AABB> &bounds, const std::vector<glm::vec3> &centroids,
+			uint32_t first, uint32_t count);
+	uint32_t _collapse(const std::vector<BuildNode> &nodes, uint32_t node);
+	// Moller-Trumbore, false for miss or hit not closer than distance
+	bool _intersect(const Triangle &triangle, const glm::vec3 &origin,
+			const glm::vec3 &direction, float &distance) const;
+
+public:
+	void build(const Mesh &mesh);
+
+	// closest hit closer than maxDistance, direction needs not be normalized
+	bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+			Hit &hit) const;
+
+	uint32_t getTriangleCount() const;
+	size_t getMemorySize() const;
+};
+
+#endif // !MESH_BVH_H
@@ -0,0 +1,651 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+#include "mesh_optimizer.h"
+
+const uint32_t INVALID_VERTEX = UINT32_MAX;
+
+// one entry per vertex, entry is cached while fewer than VERTEX_CACHE_SIZE misses followed it
+class FifoCache {
+private:
+	std::vector<uint32_t> _timestamps;
+	uint32_t _time = VERTEX_CACHE_SIZE + 1;
+
+public:
+	// true on miss
+	bool access(uint32_t vertex) {
+		if (_time - _timestamps[vertex] <= VERTEX_CACHE_SIZE)
+			return false;
+
+		_timestamps[vertex] = _time++;
+		return true;
+	}
+
+	void flush() {
+		_time += VERTEX_CACHE_SIZE + 1;
+	}
+
+	FifoCache(uint32_t vertexCount) : _timestamps(vertexCount, 0) {}
+};
+
+float MeshOptimizer::getACMR(const uint32_t *pIndices, uint32_t indexCount, uint32_t vertexCount) {
+	if (indexCount < 3)
+		return 0.0f;
+
+	FifoCache cache(vertexCount);
+	uint32_t missCount = 0;
+
+	for (uint32_t i = 0; i < indexCount; i++)
+		missCount += cache.access(pIndices[i]);
+
+	return static_cast<float>(missCount) / static_cast<float>(indexCount / 3);
+}
+
+void MeshOptimizer::_orderForCache(const uint32_t *pIndices, uint32_t indexCount,
+		uint32_t vertexCount, std::vector<uint32_t> &result, std::vector<uint32_t> &clusters) {
+	uint32_t triangleCount = indexCount / 3;
+
+	// triangles around every vertex, offsets are prefix sums of use counts
+	std::vector<uint32_t> liveCounts(vertexCount, 0);
+
+	for (uint32_t i = 0; i < indexCount; i++)
+		liveCounts[pIndices[i]]++;
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	std::partial_sum(liveCounts.begin(), liveCounts.end(), offsets.begin() + 1);
+
+	std::vector<uint32_t> adjacency(indexCount);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+	for (uint32_t i = 0; i < indexCount; i++)
+		adjacency[fill[pIndices[i]]++] = i / 3;
+
+	std::vector<uint32_t> cacheTimes(vertexCount, 0);
+	std::vector<bool> isEmitted(triangleCount, false);
+
+	// recently used vertices, revisited before jumping elsewhere in mesh
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+	uint32_t cursor = 0;
+
+	uint32_t fanning = 0;
+	bool isJump = true;
+
+	result.clear();
+	result.reserve(indexCount);
+
+	while (fanning != INVALID_VERTEX) {
+		candidates.clear();
+
+		for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+			uint32_t triangle = adjacency[i];
+
+			if (isEmitted[triangle])
+				continue;
+
+			// cache is cold after jump, new cluster starts here
+			if (isJump) {
+				clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+				isJump = false;
+			}
+
+			for (uint32_t j = 0; j < 3; j++) {
+				uint32_t vertex = pIndices[triangle * 3 + j];
+
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+
+				liveCounts[vertex]--;
+
+				if (time - cacheTimes[vertex] > VERTEX_CACHE_SIZE)
+					cacheTimes[vertex] = time++;
+			}
+
+			isEmitted[triangle] = true;
+		}
+
+		// neighbour still in cache once its remaining triangles are emitted, oldest first
+		uint32_t next = INVALID_VERTEX;
+		int32_t bestPriority = -1;
+
+		for (uint32_t vertex : candidates) {
+			if (liveCounts[vertex] == 0)
+				continue;
+
+			int32_t priority = 0;
+			uint32_t age = time - cacheTimes[vertex];
+
+			if (age + 2 * liveCounts[vertex] <= VERTEX_CACHE_SIZE)
+				priority = static_cast<int32_t>(age);
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		while (next == INVALID_VERTEX && !deadEnds.empty()) {
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+
+			if (liveCounts[vertex] > 0)
+				next = vertex;
+		}
+
+		while (next == INVALID_VERTEX && cursor < vertexCount) {
+			if (liveCounts[cursor] > 0) {
+				next = cursor;
+				isJump = true;
+			}
+
+			cursor++;
+		}
+
+		fanning = next;
+	}
+}
+
+void MeshOptimizer::_splitClusters(const uint32_t *pIndices, uint32_t indexCount,
+		uint32_t vertexCount, std::vector<uint32_t> &clusters) {
+	uint32_t triangleCount = indexCount / 3;
+
+	std::vector<uint32_t> hardClusters;
+	hardClusters.swap(clusters);
+
+	FifoCache cache(vertexCount);
+
+	for (size_t i = 0; i < hardClusters.size(); i++) {
+		uint32_t begin = hardClusters[i];
+		uint32_t end = i + 1 < hardClusters.size() ? hardClusters[i + 1] : triangleCount;
+
+		const uint32_t *pCluster = pIndices + begin * 3;
+		float acmr = getACMR(pCluster, (end - begin) * 3, vertexCount);
+
+		// soft boundary where cluster started so far is as cache friendly as the whole one
+		cache.flush();
+		clusters.push_back(begin);
+
+		uint32_t missCount = 0;
+		uint32_t clusterBegin = begin;
+
+		for (uint32_t triangle = begin; triangle < end; triangle++) {
+			for (uint32_t j = 0; j < 3; j++)
+				missCount += cache.access(pIndices[triangle * 3 + j]);
+
+			uint32_t count = triangle + 1 - clusterBegin;
+
+			if (triangle + 1 < end && missCount <= OVERDRAW_THRESHOLD * acmr * count) {
+				cache.flush();
+				clusters.push_back(triangle + 1);
+
+				missCount = 0;
+				clusterBegin = triangle + 1;
+			}
+		}
+	}
+}
+
+void MeshOptimizer::_sortClusters(const Vertex *pVertices, uint32_t *pIndices,
+		uint32_t indexCount, const std::vector<uint32_t> &clusters) {
+	uint32_t triangleCount = indexCount / 3;
+
+	typedef struct {
+		uint32_t begin;
+		uint32_t end;
+		float sortKey;
+	} Cluster;
+
+	std::vector<Cluster> sorted;
+	std::vector<glm::vec3> centroids;
+	std::vector<glm::vec3> normals;
+
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t i = 0; i < clusters.size(); i++) {
+		uint32_t begin = clusters[i];
+		uint32_t end = i + 1 < clusters.size() ? clusters[i + 1] : triangleCount;
+
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		// area weighted, cross product length is twice the area
+		for (uint32_t triangle = begin; triangle < end; triangle++) {
+			glm::vec3 p0 = pVertices[pIndices[triangle * 3 + 0]].position;
+			glm::vec3 p1 = pVertices[pIndices[triangle * 3 + 1]].position;
+			glm::vec3 p2 = pVertices[pIndices[triangle * 3 + 2]].position;
+
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		sorted.push_back({ begin, end, 0.0f });
+		centroids.push_back(area > 0.0f ? centroid / area : centroid);
+		normals.push_back(glm::length(normal) > 0.0f ? glm::normalize(normal) : normal);
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// clusters facing away from center likely occlude the rest, they are drawn first
+	for (size_t i = 0; i < sorted.size(); i++)
+		sorted[i].sortKey = glm::dot(centroids[i] - meshCentroid, normals[i]);
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+			[](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indexCount);
+
+	for (const Cluster &cluster : sorted)
+		result.insert(result.end(), pIndices + cluster.begin * 3, pIndices + cluster.end * 3);
+
+	std::copy(result.begin(), result.end(), pIndices);
+}
+
+void MeshOptimizer::_remapVertices(Primitive &primitive) {
+	VertexArray &vertices = primitive.vertices;
+	IndexArray &indices = primitive.indices;
+
+	std::vector<uint32_t> remap(vertices.count, INVALID_VERTEX);
+	uint32_t vertexCount = 0;
+
+	for (uint32_t i = 0; i < indices.count; i++) {
+		uint32_t &vertex = remap[indices.pData[i]];
+
+		if (vertex == INVALID_VERTEX)
+			vertex = vertexCount++;
+
+		indices.pData[i] = vertex;
+	}
+
+	// arena never frees, remapped order goes back into same array
+	std::vector<Vertex> remapped(vertexCount);
+
+	for (uint32_t i = 0; i < vertices.count; i++) {
+		if (remap[i] != INVALID_VERTEX)
+			remapped[remap[i]] = vertices.pData[i];
+	}
+
+	std::copy(remapped.begin(), remapped.end(), vertices.pData);
+	vertices.count = vertexCount;
+
+	// deltas of dropped vertices go, the rest follow their vertex and are sorted again
+	for (uint32_t i = 0; i < primitive.morphTargets.count; i++) {
+		MorphTarget &target = primitive.morphTargets.pData[i];
+		uint32_t deltaCount = 0;
+
+		for (uint32_t j = 0; j < target.deltaCount; j++) {
+			MorphDelta delta = target.pDeltas[j];
+
+			if (delta.vertex >= remap.size() || remap[delta.vertex] == INVALID_VERTEX)
+				continue;
+
+			delta.vertex = remap[delta.vertex];
+			target.pDeltas[deltaCount++] = delta;
+		}
+
+		target.deltaCount = deltaCount;
+
+		std::sort(target.pDeltas, target.pDeltas + deltaCount,
+				[](const MorphDelta &a, const MorphDelta &b) { return a.vertex < b.vertex; });
+	}
+}
+
+void MeshOptimizer::_clusterVertices(
+		const Primitive &primitive, float cellSize, std::vector<uint32_t> &result) {
+	const VertexArray &vertices = primitive.vertices;
+	const IndexArray &indices = primitive.indices;
+
+	// cells are numbered in order of first vertex in them
+	std::unordered_map<uint64_t, uint32_t> cellIndices;
+	std::vector<uint32_t> cells(vertices.count);
+
+	std::vector<glm::vec3> sums;
+	std::vector<uint32_t> counts;
+
+	for (uint32_t i = 0; i < vertices.count; i++) {
+		const glm::vec3 &position = vertices.pData[i].position;
+		glm::ivec3 cell = glm::ivec3(glm::floor(position / cellSize));
+
+		// 21 bits per axis
+		uint64_t key = (uint64_t(cell.x & 0x1FFFFF) << 42) | (uint64_t(cell.y & 0x1FFFFF) << 21) |
+				uint64_t(cell.z & 0x1FFFFF);
+
+		auto inserted = cellIndices.emplace(key, static_cast<uint32_t>(sums.size()));
+
+		if (inserted.second) {
+			sums.push_back(glm::vec3(0.0f));
+			counts.push_back(0);
+		}
+
+		cells[i] = inserted.first->second;
+		sums[cells[i]] += position;
+		counts[cells[i]]++;
+	}
+
+	// representative is a real vertex, so its attributes stay valid
+	std::vector<uint32_t> representatives(sums.size(), INVALID_VERTEX);
+	std::vector<float> distances(sums.size(), FLT_MAX);
+
+	for (uint32_t i = 0; i < vertices.count; i++) {
+		uint32_t cell = cells[i];
+		glm::vec3 mean = sums[cell] / static_cast<float>(counts[cell]);
+		float distance = glm::length(vertices.pData[i].position - mean);
+
+		if (distance < distances[cell]) {
+			distances[cell] = distance;
+			representatives[cell] = i;
+		}
+	}
+
+	result.clear();
+
+	// triangles collapsed to line or point are dropped
+	for (uint32_t i = 0; i + 2 < indices.count; i += 3) {
+		uint32_t a = representatives[cells[indices.pData[i + 0]]];
+		uint32_t b = representatives[cells[indices.pData[i + 1]]];
+		uint32_t c = representatives[cells[indices.pData[i + 2]]];
+
+		if (a == b || b == c || a == c)
+			continue;
+
+		result.push_back(a);
+		result.push_back(b);
+		result.push_back(c);
+	}
+}
+
+Meshlet MeshOptimizer::_computeMeshletBounds(
+		const Primitive &primitive, uint32_t firstIndex, uint32_t indexCount) {
+	const Vertex *pVertices = primitive.vertices.pData;
+	const uint32_t *pIndices = primitive.indices.pData + firstIndex;
+
+	glm::vec3 min = pVertices[pIndices[0]].position;
+	glm::vec3 max = min;
+
+	for (uint32_t i = 1; i < indexCount; i++) {
+		min = glm::min(min, pVertices[pIndices[i]].position);
+		max = glm::max(max, pVertices[pIndices[i]].position);
+	}
+
+	glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+
+	for (uint32_t i = 0; i < indexCount; i++)
+		radius = glm::max(radius, glm::length(pVertices[pIndices[i]].position - center));
+
+	// cone around average of triangle normals, degenerate triangles have no say
+	std::vector<glm::vec3> normals;
+
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+		glm::vec3 p0 = pVertices[pIndices[i + 0]].position;
+		glm::vec3 p1 = pVertices[pIndices[i + 1]].position;
+		glm::vec3 p2 = pVertices[pIndices[i + 2]].position;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+
+		if (length > 0.0f)
+			normals.push_back(normal / length);
+	}
+
+	glm::vec3 axis(0.0f);
+
+	for (const glm::vec3 &normal : normals)
+		axis += normal;
+
+	float axisLength = glm::length(axis);
+	float cutoff = 1.0f;
+
+	if (axisLength > 0.0f) {
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+
+		for (const glm::vec3 &normal : normals)
+			minDot = glm::min(minDot, glm::dot(normal, axis));
+
+		// half angle of cone plus angle of view direction have to stay below 90 degrees, cone
+		// wider than hemisphere never rejects
+		if (minDot > 0.0f)
+			cutoff = glm::sqrt(1.0f - minDot * minDot);
+	}
+
+	Meshlet meshlet = {};
+	meshlet.firstIndex = firstIndex;
+	meshlet.indexCount = indexCount;
+	meshlet.center = center;
+	meshlet.radius = radius;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = cutoff;
+
+	return meshlet;
+}
+
+void MeshOptimizer::weld(Primitive &primitive) {
+	VertexArray &vertices = primitive.vertices;
+	IndexArray &indices = primitive.indices;
+
+	// vertices equal at rest may morph apart
+	if (vertices.count < 2 || primitive.morphTargets.count > 0)
+		return;
+
+	for (uint32_t i = 0; i < indices.count; i++) {
+		if (indices.pData[i] >= vertices.count)
+			return;
+	}
+
+	// open addressing with linear probing, at most half full keeps probe sequences short
+	size_t capacity = 1;
+	while (capacity < static_cast<size_t>(vertices.count) * 2)
+		capacity <<= 1;
+
+	std::vector<uint32_t> table(capacity, INVALID_VERTEX);
+	std::vector<uint32_t> remap(vertices.count);
+	std::hash<Vertex> hasher;
+
+	uint32_t vertexCount = 0;
+
+	// unique vertices are compacted in place, slot written is never ahead of one read
+	for (uint32_t i = 0; i < vertices.count; i++) {
+		const Vertex vertex = vertices.pData[i];
+		size_t slot = hasher(vertex) & (capacity - 1);
+
+		while (table[slot] != INVALID_VERTEX && !(vertices.pData[table[slot]] == vertex))
+			slot = (slot + 1) & (capacity - 1);
+
+		if (table[slot] == INVALID_VERTEX) {
+			vertices.pData[vertexCount] = vertex;
+			table[slot] = vertexCount++;
+		}
+
+		remap[i] = table[slot];
+	}
+
+	for (uint32_t i = 0; i < indices.count; i++)
+		indices.pData[i] = remap[indices.pData[i]];
+
+	// tail past unique vertices goes with arena
+	vertices.count = vertexCount;
+}
+
+void MeshOptimizer::optimize(Primitive &primitive) {
+	VertexArray &vertices = primitive.vertices;
+	IndexArray &indices = primitive.indices;
+
+	if (indices.count < 3 || indices.count % 3 != 0 || vertices.count == 0)
+		return;
+
+	// out of range index would be read past end of every per vertex array
+	for (uint32_t i = 0; i < indices.count; i++) {
+		if (indices.pData[i] >= vertices.count)
+			return;
+	}
+
+	std::vector<uint32_t> ordered;
+	std::vector<uint32_t> clusters;
+
+	_orderForCache(indices.pData, indices.count, vertices.count, ordered, clusters);
+	_splitClusters(ordered.data(), indices.count, vertices.count, clusters);
+	_sortClusters(vertices.pData, ordered.data(), indices.count, clusters);
+
+	std::copy(ordered.begin(), ordered.end(), indices.pData);
+	_remapVertices(primitive);
+}
+
+void MeshOptimizer::buildMeshlets(Primitive &primitive, MeshArena &arena) {
+	const VertexArray &vertices = primitive.vertices;
+	const IndexArray &indices = primitive.indices;
+
+	primitive.meshlets = {};
+
+	if (indices.count < 3 || indices.count % 3 != 0)
+		return;
+
+	for (uint32_t i = 0; i < indices.count; i++) {
+		if (indices.pData[i] >= vertices.count)
+			return;
+	}
+
+	// vertex belongs to current meshlet when its stamp is index of it
+	std::vector<uint32_t> stamps(vertices.count, INVALID_VERTEX);
+	std::vector<Meshlet> meshlets;
+
+	uint32_t firstIndex = 0;
+	uint32_t vertexCount = 0;
+
+	for (uint32_t i = 0; i < indices.count; i += 3) {
+		uint32_t meshlet = static_cast<uint32_t>(meshlets.size());
+		uint32_t newVertexCount = 0;
+
+		for (uint32_t j = 0; j < 3; j++)
+			newVertexCount += stamps[indices.pData[i + j]] != meshlet;
+
+		uint32_t triangleCount = (i - firstIndex) / 3;
+
+		if (vertexCount + newVertexCount > MESHLET_MAX_VERTICES ||
+				triangleCount == MESHLET_MAX_TRIANGLES) {
+			meshlets.push_back(_computeMeshletBounds(primitive, firstIndex, i - firstIndex));
+
+			firstIndex = i;
+			vertexCount = 0;
+			meshlet++;
+		}
+
+		for (uint32_t j = 0; j < 3; j++) {
+			uint32_t &stamp = stamps[indices.pData[i + j]];
+
+			if (stamp != meshlet) {
+				stamp = meshlet;
+				vertexCount++;
+			}
+		}
+	}
+
+	meshlets.push_back(_computeMeshletBounds(primitive, firstIndex, indices.count - firstIndex));
+
+	MeshletArray &result = primitive.meshlets;
+	result.pData = arena.allocate<Meshlet>(meshlets.size());
+	result.count = static_cast<uint32_t>(meshlets.size());
+
+	std::copy(meshlets.begin(), meshlets.end(), result.pData);
+}
+
+void MeshOptimizer::buildLods(Primitive &primitive, MeshArena &arena) {
+	const VertexArray &vertices = primitive.vertices;
+	const IndexArray &indices = primitive.indices;
+
+	primitive.lods = {};
+
+	if (indices.count / 3 < LOD_MIN_TRIANGLES || indices.count % 3 != 0)
+		return;
+
+	for (uint32_t i = 0; i < indices.count; i++) {
+		if (indices.pData[i] >= vertices.count)
+			return;
+	}
+
+	glm::vec3 min = vertices.pData[indices.pData[0]].position;
+	glm::vec3 max = min;
+
+	for (uint32_t i = 1; i < indices.count; i++) {
+		min = glm::min(min, vertices.pData[indices.pData[i]].position);
+		max = glm::max(max, vertices.pData[indices.pData[i]].position);
+	}
+
+	glm::vec3 size = max - min;
+	float extent = glm::max(glm::max(size.x, size.y), size.z);
+
+	if (extent <= 0.0f)
+		return;
+
+	// about length of average edge, doubled until level is small enough
+	float cellSize = extent / glm::sqrt(static_cast<float>(indices.count / 3));
+
+	std::vector<Lod> lods;
+	std::vector<uint32_t> simplified;
+	std::vector<uint32_t> ordered;
+	std::vector<uint32_t> clusters;
+
+	uint32_t previousCount = indices.count;
+
+	while (lods.size() < MAX_LOD_COUNT && previousCount / 3 >= LOD_MIN_TRIANGLES &&
+			cellSize <= extent) {
+		_clusterVertices(primitive, cellSize, simplified);
+
+		float error = cellSize * glm::sqrt(3.0f);
+		cellSize *= 2.0f;
+
+		if (simplified.empty())
+			break;
+
+		if (simplified.size() > previousCount * LOD_REDUCTION)
+			continue;
+
+		uint32_t count = static_cast<uint32_t>(simplified.size());
+
+		ordered.clear();
+		clusters.clear();
+		_orderForCache(simplified.data(), count, vertices.count, ordered, clusters);
+
+		Lod lod = {};
+		lod.indices.pData = arena.allocate<uint32_t>(count);
+		lod.indices.count = count;
+		lod.error = error;
+
+		std::copy(ordered.begin(), ordered.end(), lod.indices.pData);
+
+		lods.push_back(lod);
+		previousCount = count;
+	}
+
+	if (lods.empty())
+		return;
+
+	LodArray &result = primitive.lods;
+	result.pData = arena.allocate<Lod>(lods.size());
+	result.count = static_cast<uint32_t>(lods.size());
+
+	std::copy(lods.begin(), lods.end(), result.pData);
+}
@@ -0,0 +1,67 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+#include "mesh_arena.h"
+
+// post-transform cache size orderings are tuned for, FIFO of 16 is close to most GPUs
+const uint32_t VERTEX_CACHE_SIZE = 16;
+
+// cluster is split once its ACMR is within this factor of ACMR of the whole cluster, larger
+// value gives smaller clusters, better overdraw and worse cache efficiency
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+// meshlet limits, common mesh shader output limits so meshlets could feed that path too
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// level is kept once it has at most this fraction of indices of previous one
+const float LOD_REDUCTION = 0.5f;
+
+// coarser levels are not built for fewer triangles
+const uint32_t LOD_MIN_TRIANGLES = 64;
+
+// Welds duplicate vertices and reorders triangles and vertices of primitive. Triangles are
+// ordered for vertex cache with Tipsify, clusters it leaves are sorted so outward facing ones are
+// drawn first, which fills depth early and cuts overdraw. Vertices are then renumbered in order
+// of first use, so fetches walk memory forward. Meshlets are cut from optimized order. Levels
+// of detail are built by vertex clustering, they index vertices of primitive.
+class MeshOptimizer {
+private:
+	// start triangle of every cluster is appended to clusters
+	static void _orderForCache(const uint32_t *pIndices, uint32_t indexCount, uint32_t vertexCount,
+			std::vector<uint32_t> &result, std::vector<uint32_t> &clusters);
+	static void _splitClusters(const uint32_t *pIndices, uint32_t indexCount,
+			uint32_t vertexCount, std::vector<uint32_t> &clusters);
+	static void _sortClusters(const Vertex *pVertices, uint32_t *pIndices, uint32_t indexCount,
+			const std::vector<uint32_t> &clusters);
+	// morph deltas follow their vertices
+	static void _remapVertices(Primitive &primitive);
+	// vertices in one grid cell collapse into one nearest to their mean
+	static void _clusterVertices(
+			const Primitive &primitive, float cellSize, std::vector<uint32_t> &result);
+	static Meshlet _computeMeshletBounds(const Primitive &primitive, uint32_t firstIndex,
+			uint32_t indexCount);
+
+public:
+	// average vertex shader invocations per triangle with FIFO cache of VERTEX_CACHE_SIZE
+	static float getACMR(const uint32_t *pIndices, uint32_t indexCount, uint32_t vertexCount);
+
+	// bitwise equal vertices are merged, exporters often split them per face, primitives with
+	// morph targets are left as they are
+	static void weld(Primitive &primitive);
+
+	// vertices unused by indices are dropped, remaining ones are compacted in place
+	static void optimize(Primitive &primitive);
+
+	// consecutive triangles are grouped, order of indices is kept
+	static void buildMeshlets(Primitive &primitive, MeshArena &arena);
+
+	// has to follow optimize, vertices are not renumbered after
+	static void buildLods(Primitive &primitive, MeshArena &arena);
+};
+
+#endif // !MESH_OPTIMIZER_H
@@ -0,0 +1,585 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "meshopt_decoder.h"
+
+const uint8_t VERTEX_HEADER = 0xA0;
+const uint8_t TRIANGLES_HEADER = 0xE0;
+const uint8_t SEQUENCE_HEADER = 0xD0;
+
+// vertices are decoded in blocks of at most this many bytes and vertices
+const size_t VERTEX_BLOCK_BYTES = 8192;
+const size_t VERTEX_BLOCK_MAX_COUNT = 256;
+
+const size_t BYTE_GROUP_SIZE = 16;
+// most one byte group reads, data ends with tail of at least VERTEX_TAIL_SIZE
+const size_t BYTE_GROUP_MAX_SIZE = 24;
+const size_t VERTEX_TAIL_SIZE = 32;
+
+// table of triangle codes 0xf0 to 0xfd at end of triangle data
+const size_t CODE_TABLE_SIZE = 16;
+// sequence data ends with padding, longest index is five bytes
+const size_t SEQUENCE_TAIL_SIZE = 4;
+
+static void _writeIndex(uint8_t *pDst, size_t stride, size_t i, uint32_t index) {
+	if (stride == 2)
+		reinterpret_cast<uint16_t *>(pDst)[i] = static_cast<uint16_t>(index);
+	else
+		reinterpret_cast<uint32_t *>(pDst)[i] = index;
+}
+
+// 16 values of 0, 2, 4 or 8 bits, packed values of all ones are escapes for a byte after them
+static const uint8_t *_decodeGroup(const uint8_t *pData, uint8_t *pBuffer, int bitsLog2) {
+	if (bitsLog2 == 0) {
+		memset(pBuffer, 0, BYTE_GROUP_SIZE);
+		return pData;
+	}
+
+	if (bitsLog2 == 3) {
+		memcpy(pBuffer, pData, BYTE_GROUP_SIZE);
+		return pData + BYTE_GROUP_SIZE;
+	}
+
+	uint32_t bits = bitsLog2 == 1 ? 2 : 4;
+	uint32_t escape = (1u << bits) - 1;
+	uint32_t perByte = 8 / bits;
+
+	// escaped bytes follow packed ones, first value is in high bits
+	const uint8_t *pExtra = pData + BYTE_GROUP_SIZE / perByte;
+
+	for (size_t i = 0; i < BYTE_GROUP_SIZE / perByte; i++) {
+		uint8_t byte = pData[i];
+
+		for (uint32_t j = 0; j < perByte; j++) {
+			uint32_t value = (byte >> (8 - bits * (j + 1))) & escape;
+			*pBuffer++ = value == escape ? *pExtra++ : static_cast<uint8_t>(value);
+		}
+	}
+
+	return pExtra;
+}
+
+const uint8_t *MeshoptDecoder::_decodeBytes(
+		const uint8_t *pData, const uint8_t *pEnd, uint8_t *pBuffer, size_t size) {
+	// two bits per group, four groups per header byte
+	const uint8_t *pHeader = pData;
+	size_t groupCount = size / BYTE_GROUP_SIZE;
+	size_t headerSize = (groupCount + 3) / 4;
+
+	if (static_cast<size_t>(pEnd - pData) < headerSize)
+		return nullptr;
+
+	pData += headerSize;
+
+	for (size_t group = 0; group < groupCount; group++) {
+		if (static_cast<size_t>(pEnd - pData) < BYTE_GROUP_MAX_SIZE)
+			return nullptr;
+
+		int bitsLog2 = (pHeader[group / 4] >> ((group % 4) * 2)) & 3;
+		pData = _decodeGroup(pData, pBuffer + group * BYTE_GROUP_SIZE, bitsLog2);
+	}
+
+	return pData;
+}
+
+// zigzag deltas into running sum continuing from previous, 16 at a time
+static void _accumulateDeltas(const uint8_t *pDeltas, uint8_t previous, uint8_t *pResult) {
+#if defined(__SSE2__)
+	__m128i deltas = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pDeltas));
+
+	// no byte shifts, low bit of each next byte is masked off instead
+	__m128i half = _mm_and_si128(_mm_srli_epi16(deltas, 1), _mm_set1_epi8(0x7F));
+	__m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(deltas, _mm_set1_epi8(1)));
+	__m128i sum = _mm_xor_si128(half, sign);
+
+	sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+	sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+	sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+	sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+	sum = _mm_add_epi8(sum, _mm_set1_epi8(static_cast<char>(previous)));
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(pResult), sum);
+#elif defined(__ARM_NEON)
+	uint8x16_t deltas = vld1q_u8(pDeltas);
+	uint8x16_t zero = vdupq_n_u8(0);
+
+	int8x16_t sign = vnegq_s8(vreinterpretq_s8_u8(vandq_u8(deltas, vdupq_n_u8(1))));
+	uint8x16_t sum = veorq_u8(vshrq_n_u8(deltas, 1), vreinterpretq_u8_s8(sign));
+
+	sum = vaddq_u8(sum, vextq_u8(zero, sum, 15));
+	sum = vaddq_u8(sum, vextq_u8(zero, sum, 14));
+	sum = vaddq_u8(sum, vextq_u8(zero, sum, 12));
+	sum = vaddq_u8(sum, vextq_u8(zero, sum, 8));
+	sum = vaddq_u8(sum, vdupq_n_u8(previous));
+
+	vst1q_u8(pResult, sum);
+#else
+	for (size_t i = 0; i < BYTE_GROUP_SIZE; i++) {
+		uint8_t delta = (pDeltas[i] >> 1) ^ static_cast<uint8_t>(-(pDeltas[i] & 1));
+		previous = static_cast<uint8_t>(previous + delta);
+		pResult[i] = previous;
+	}
+#endif
+}
+
+bool MeshoptDecoder::_decodeVertices(
+		uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc, size_t size) {
+	size_t tailSize = std::max(stride, VERTEX_TAIL_SIZE);
+
+	if (size < 1 + tailSize || pSrc[0] != VERTEX_HEADER)
+		return false;
+
+	const uint8_t *pData = pSrc + 1;
+	const uint8_t *pEnd = pSrc + size;
+
+	// first vertex is a delta from tail
+	uint8_t last[256];
+	memcpy(last, pEnd - stride, stride);
+
+	size_t blockCount = std::min(
+			(VERTEX_BLOCK_BYTES / stride) & ~(BYTE_GROUP_SIZE - 1), VERTEX_BLOCK_MAX_COUNT);
+
+	// each byte of vertex is a stream of its own within block
+	uint8_t deltas[VERTEX_BLOCK_MAX_COUNT];
+	uint8_t values[BYTE_GROUP_SIZE];
+
+	for (size_t first = 0; first < count; first += blockCount) {
+		size_t blockSize = std::min(blockCount, count - first);
+		size_t alignedSize = (blockSize + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+
+		for (size_t k = 0; k < stride; k++) {
+			pData = _decodeBytes(pData, pEnd, deltas, alignedSize);
+
+			if (pData == nullptr)
+				return false;
+
+			uint8_t *pVertex = pDst + first * stride + k;
+			uint8_t previous = last[k];
+
+			for (size_t i = 0; i < blockSize; i += BYTE_GROUP_SIZE) {
+				_accumulateDeltas(deltas + i, previous, values);
+
+				size_t valueCount = std::min(BYTE_GROUP_SIZE, blockSize - i);
+
+				for (size_t j = 0; j < valueCount; j++)
+					pVertex[(i + j) * stride] = values[j];
+
+				previous = values[valueCount - 1];
+			}
+
+			last[k] = previous;
+		}
+	}
+
+	return static_cast<size_t>(pEnd - pData) == tailSize;
+}
+
+// variable length, seven bits per byte with high bit set while more follow
+static uint32_t _decodeVarint(const uint8_t *&pData) {
+	uint8_t lead = *pData++;
+
+	if (lead < 128)
+		return lead;
+
+	uint32_t result = lead & 127;
+
+	for (uint32_t shift = 7; shift < 35; shift += 7) {
+		uint8_t group = *pData++;
+		result |= static_cast<uint32_t>(group & 127) << shift;
+
+		if (group < 128)
+			break;
+	}
+
+	return result;
+}
+
+static uint32_t _unzigzag(uint32_t value) {
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+bool MeshoptDecoder::_decodeTriangles(
+		uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc, size_t size) {
+	// a code byte per triangle
+	if (count % 3 != 0 || size < 1 + count / 3 + CODE_TABLE_SIZE)
+		return false;
+
+	if ((pSrc[0] & 0xF0) != TRIANGLES_HEADER)
+		return false;
+
+	// version 1 spends codes 13 and 14 on index next to last free one
+	uint32_t version = pSrc[0] & 0x0F;
+
+	if (version > 1)
+		return false;
+
+	uint32_t fifoCodes = version == 1 ? 13 : 15;
+
+	uint32_t edges[16][2];
+	uint32_t vertices[16];
+	memset(edges, 0xFF, sizeof(edges));
+	memset(vertices, 0xFF, sizeof(vertices));
+
+	size_t edgeOffset = 0;
+	size_t vertexOffset = 0;
+
+	auto pushEdge = [&](uint32_t a, uint32_t b) {
+		edges[edgeOffset][0] = a;
+		edges[edgeOffset][1] = b;
+		edgeOffset = (edgeOffset + 1) & 15;
+	};
+
+	auto pushVertex = [&](uint32_t v, bool isPushed = true) {
+		vertices[vertexOffset] = v;
+		vertexOffset = (vertexOffset + (isPushed ? 1 : 0)) & 15;
+	};
+
+	// first use of a vertex takes next, free indices are deltas from last one
+	uint32_t next = 0;
+	uint32_t last = 0;
+
+	const uint8_t *pCodes = pSrc + 1;
+	const uint8_t *pData = pCodes + count / 3;
+	const uint8_t *pTable = pSrc + size - CODE_TABLE_SIZE;
+
+	for (size_t i = 0; i < count; i += 3) {
+		// a triangle reads at most 16 bytes, table is past its data
+		if (pData > pTable)
+			return false;
+
+		uint8_t code = *pCodes++;
+		uint32_t a, b, c;
+
+		if (code < 0xF0) {
+			// edge of recent triangle, high half picks it
+			const uint32_t *pEdge = edges[(edgeOffset - 1 - (code >> 4)) & 15];
+			a = pEdge[0];
+			b = pEdge[1];
+
+			uint32_t vertexCode = code & 15;
+
+			if (vertexCode == 0) {
+				c = next++;
+				pushVertex(c);
+			} else if (vertexCode < fifoCodes) {
+				c = vertices[(vertexOffset - 1 - vertexCode) & 15];
+				pushVertex(c, false);
+			} else {
+				// 13 and 14 are last - 1 and last + 1
+				c = vertexCode == 15 ? last + _unzigzag(_decodeVarint(pData))
+									 : last + (vertexCode == 13 ? -1 : 1);
+				last = c;
+				pushVertex(c);
+			}
+
+			pushEdge(c, b);
+			pushEdge(a, c);
+		} else {
+			// codes of b and c, from table or from byte of their own
+			uint8_t aux = code < 0xFE ? pTable[code & 15] : *pData++;
+
+			uint32_t bCode = aux >> 4;
+			uint32_t cCode = aux & 15;
+
+			if (code >= 0xFE && aux == 0)
+				next = 0;
+
+			// every new vertex takes next in order a, b, c before free ones are read
+			a = code == 0xFF ? 0 : next++;
+			b = bCode == 0 ? next++ : vertices[(vertexOffset - bCode) & 15];
+			c = cCode == 0 ? next++ : vertices[(vertexOffset - cCode) & 15];
+
+			if (code == 0xFF)
+				a = last = last + _unzigzag(_decodeVarint(pData));
+
+			if (code >= 0xFE && bCode == 15)
+				b = last = last + _unzigzag(_decodeVarint(pData));
+
+			if (code >= 0xFE && cCode == 15)
+				c = last = last + _unzigzag(_decodeVarint(pData));
+
+			pushVertex(a);
+			pushVertex(b, bCode == 0 || bCode == 15);
+			pushVertex(c, cCode == 0 || cCode == 15);
+
+			pushEdge(b, a);
+			pushEdge(c, b);
+			pushEdge(a, c);
+		}
+
+		_writeIndex(pDst, stride, i + 0, a);
+		_writeIndex(pDst, stride, i + 1, b);
+		_writeIndex(pDst, stride, i + 2, c);
+	}
+
+	return pData == pTable;
+}
+
+bool MeshoptDecoder::_decodeSequence(
+		uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc, size_t size) {
+	// a byte per index at least
+	if (size < 1 + count + SEQUENCE_TAIL_SIZE)
+		return false;
+
+	if ((pSrc[0] & 0xF0) != SEQUENCE_HEADER || (pSrc[0] & 0x0F) > 1)
+		return false;
+
+	const uint8_t *pData = pSrc + 1;
+	const uint8_t *pEnd = pSrc + size - SEQUENCE_TAIL_SIZE;
+
+	// low bit picks which of two baselines index is a delta from
+	uint32_t last[2] = {};
+
+	for (size_t i = 0; i < count; i++) {
+		if (pData >= pEnd)
+			return false;
+
+		uint32_t value = _decodeVarint(pData);
+		uint32_t baseline = value & 1;
+
+		last[baseline] += _unzigzag(value >> 1);
+		_writeIndex(pDst, stride, i, last[baseline]);
+	}
+
+	return pData == pEnd;
+}
+
+#if defined(__SSE2__)
+// rows of four int32 into columns, in place
+static void _transpose(__m128i &r0, __m128i &r1, __m128i &r2, __m128i &r3) {
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+	r0 = _mm_unpacklo_epi64(t0, t1);
+	r1 = _mm_unpackhi_epi64(t0, t1);
+	r2 = _mm_unpacklo_epi64(t2, t3);
+	r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+// to nearest, halves away from zero
+static __m128i _roundToInt(__m128 value) {
+	__m128 sign = _mm_and_ps(value, _mm_set1_ps(-0.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(value, _mm_or_ps(_mm_set1_ps(0.5f), sign)));
+}
+
+// columns x, y, z of four elements, z becomes length left after x and y
+static void _unfoldOctahedral4(__m128i &x, __m128i &y, __m128i &z, float max) {
+	__m128 signMask = _mm_set1_ps(-0.0f);
+
+	__m128 fx = _mm_cvtepi32_ps(x);
+	__m128 fy = _mm_cvtepi32_ps(y);
+	__m128 fz = _mm_sub_ps(_mm_cvtepi32_ps(z),
+			_mm_add_ps(_mm_andnot_ps(signMask, fx), _mm_andnot_ps(signMask, fy)));
+
+	// lower hemisphere is folded over diagonals, t is negative there and moves x, y outward
+	__m128 t = _mm_min_ps(fz, _mm_setzero_ps());
+	fx = _mm_add_ps(fx, _mm_xor_ps(t, _mm_and_ps(fx, signMask)));
+	fy = _mm_add_ps(fy, _mm_xor_ps(t, _mm_and_ps(fy, signMask)));
+
+	__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy)),
+			_mm_mul_ps(fz, fz)));
+	__m128 scale = _mm_div_ps(_mm_set1_ps(max), length);
+
+	x = _roundToInt(_mm_mul_ps(fx, scale));
+	y = _roundToInt(_mm_mul_ps(fy, scale));
+	z = _roundToInt(_mm_mul_ps(fz, scale));
+}
+#endif
+
+// z carries one at precision of x and y, fourth component is left as it is
+template <typename T> static void _unfoldOctahedral(T *pData, size_t count) {
+	const float max = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+
+	for (size_t i = 0; i < count; i++) {
+		T *pElement = pData + i * 4;
+
+		float x = pElement[0];
+		float y = pElement[1];
+		float z = pElement[2] - std::fabs(x) - std::fabs(y);
+
+		float t = std::min(z, 0.0f);
+		x += x >= 0.0f ? t : -t;
+		y += y >= 0.0f ? t : -t;
+
+		float scale = max / std::sqrt(x * x + y * y + z * z);
+
+		pElement[0] = static_cast<T>(static_cast<int32_t>(x * scale + (x >= 0.0f ? 0.5f : -0.5f)));
+		pElement[1] = static_cast<T>(static_cast<int32_t>(y * scale + (y >= 0.0f ? 0.5f : -0.5f)));
+		pElement[2] = static_cast<T>(static_cast<int32_t>(z * scale + (z >= 0.0f ? 0.5f : -0.5f)));
+	}
+}
+
+void MeshoptDecoder::_filterOctahedral8(int8_t *pData, size_t count) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 4 <= count; i += 4) {
+		__m128i *pElements = reinterpret_cast<__m128i *>(pData + i * 4);
+		__m128i bytes = _mm_loadu_si128(pElements);
+
+		// sign extended by shifting duplicated bytes down
+		__m128i low = _mm_unpacklo_epi8(bytes, bytes);
+		__m128i high = _mm_unpackhi_epi8(bytes, bytes);
+
+		// element per row, transposed so each component is a column
+		__m128i x = _mm_srai_epi32(_mm_unpacklo_epi16(low, low), 24);
+		__m128i y = _mm_srai_epi32(_mm_unpackhi_epi16(low, low), 24);
+		__m128i z = _mm_srai_epi32(_mm_unpacklo_epi16(high, high), 24);
+		__m128i w = _mm_srai_epi32(_mm_unpackhi_epi16(high, high), 24);
+
+		_transpose(x, y, z, w);
+		_unfoldOctahedral4(x, y, z, 127.0f);
+		_transpose(x, y, z, w);
+
+		__m128i packed = _mm_packs_epi16(_mm_packs_epi32(x, y), _mm_packs_epi32(z, w));
+		_mm_storeu_si128(pElements, packed);
+	}
+#endif
+
+	_unfoldOctahedral(pData + i * 4, count - i);
+}
+
+void MeshoptDecoder::_filterOctahedral16(int16_t *pData, size_t count) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 4 <= count; i += 4) {
+		__m128i *pElements = reinterpret_cast<__m128i *>(pData + i * 4);
+		__m128i first = _mm_loadu_si128(pElements);
+		__m128i second = _mm_loadu_si128(pElements + 1);
+
+		__m128i x = _mm_srai_epi32(_mm_unpacklo_epi16(first, first), 16);
+		__m128i y = _mm_srai_epi32(_mm_unpackhi_epi16(first, first), 16);
+		__m128i z = _mm_srai_epi32(_mm_unpacklo_epi16(second, second), 16);
+		__m128i w = _mm_srai_epi32(_mm_unpackhi_epi16(second, second), 16);
+
+		_transpose(x, y, z, w);
+		_unfoldOctahedral4(x, y, z, 32767.0f);
+		_transpose(x, y, z, w);
+
+		_mm_storeu_si128(pElements, _mm_packs_epi32(x, y));
+		_mm_storeu_si128(pElements + 1, _mm_packs_epi32(z, w));
+	}
+#endif
+
+	_unfoldOctahedral(pData + i * 4, count - i);
+}
+
+// three smallest components scaled by 1 / sqrt(2), two low bits of fourth tell index of largest
+void MeshoptDecoder::_filterQuaternion(int16_t *pData, size_t count) {
+	const float scale = 1.0f / std::sqrt(2.0f);
+
+	for (size_t i = 0; i < count; i++) {
+		int16_t *pElement = pData + i * 4;
+
+		// scale is kept in high bits of fourth component
+		float componentScale = scale / static_cast<float>(pElement[3] | 3);
+
+		float x = pElement[0] * componentScale;
+		float y = pElement[1] * componentScale;
+		float z = pElement[2] * componentScale;
+		float w = std::sqrt(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+
+		uint32_t largest = pElement[3] & 3;
+
+		pElement[(largest + 1) & 3] =
+				static_cast<int16_t>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f));
+		pElement[(largest + 2) & 3] =
+				static_cast<int16_t>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f));
+		pElement[(largest + 3) & 3] =
+				static_cast<int16_t>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f));
+		pElement[largest] = static_cast<int16_t>(w * 32767.0f + 0.5f);
+	}
+}
+
+// 24 bit signed mantissa and 8 bit signed exponent into float
+void MeshoptDecoder::_filterExponential(uint32_t *pData, size_t count) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 4 <= count; i += 4) {
+		__m128i *pValues = reinterpret_cast<__m128i *>(pData + i);
+		__m128i values = _mm_loadu_si128(pValues);
+
+		__m128i mantissa = _mm_srai_epi32(_mm_slli_epi32(values, 8), 8);
+		__m128i exponent = _mm_srai_epi32(values, 24);
+
+		// power of two from exponent bits, ldexp without its range handling
+		__m128 power = _mm_castsi128_ps(
+				_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23));
+		__m128 result = _mm_mul_ps(power, _mm_cvtepi32_ps(mantissa));
+
+		_mm_storeu_si128(pValues, _mm_castps_si128(result));
+	}
+#endif
+
+	for (; i < count; i++) {
+		int32_t mantissa = static_cast<int32_t>(pData[i] << 8) >> 8;
+		int32_t exponent = static_cast<int32_t>(pData[i]) >> 24;
+
+		uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+		float power;
+		memcpy(&power, &bits, sizeof(power));
+
+		float result = power * static_cast<float>(mantissa);
+		memcpy(pData + i, &result, sizeof(result));
+	}
+}
+
+bool MeshoptDecoder::decode(uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc,
+		size_t size, Mode mode, Filter filter) {
+	if (size == 0)
+		return false;
+
+	if (mode == Mode::Triangles || mode == Mode::Indices) {
+		if ((stride != 2 && stride != 4) || filter != Filter::None)
+			return false;
+
+		if (mode == Mode::Triangles)
+			return _decodeTriangles(pDst, count, stride, pSrc, size);
+
+		return _decodeSequence(pDst, count, stride, pSrc, size);
+	}
+
+	if (stride == 0 || stride % 4 != 0 || stride > 256)
+		return false;
+
+	if (!_decodeVertices(pDst, count, stride, pSrc, size))
+		return false;
+
+	switch (filter) {
+		case Filter::Octahedral:
+			if (stride == 4)
+				_filterOctahedral8(reinterpret_cast<int8_t *>(pDst), count);
+			else if (stride == 8)
+				_filterOctahedral16(reinterpret_cast<int16_t *>(pDst), count);
+			else
+				return false;
+
+			break;
+		case Filter::Quaternion:
+			if (stride != 8)
+				return false;
+
+			_filterQuaternion(reinterpret_cast<int16_t *>(pDst), count);
+			break;
+		case Filter::Exponential:
+			_filterExponential(reinterpret_cast<uint32_t *>(pDst), count * stride / 4);
+			break;
+		default:
+			break;
+	}
+
+	return true;
+}
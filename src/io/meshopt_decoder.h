@@ -0,0 +1,49 @@
+#ifndef MESHOPT_DECODER_H
+#define MESHOPT_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Decodes buffer views compressed by EXT_meshopt_compression, as written by gltfpack or
+// meshoptimizer. Attributes are byte deltas between vertices, packed in groups of 16 with 0 to 8
+// bits each, indices are triangles coded against FIFOs of recent edges and vertices or a delta
+// sequence. Filters undo quantization of normals, quaternions and exponents once attributes are
+// decoded, with SSE2 or NEON where available. Any thread.
+class MeshoptDecoder {
+public:
+	enum class Mode {
+		Attributes,
+		Triangles,
+		Indices,
+	};
+
+	enum class Filter {
+		None,
+		Octahedral,
+		Quaternion,
+		Exponential,
+	};
+
+private:
+	static const uint8_t *_decodeBytes(
+			const uint8_t *pData, const uint8_t *pEnd, uint8_t *pBuffer, size_t size);
+	static bool _decodeVertices(
+			uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc, size_t size);
+	static bool _decodeTriangles(
+			uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc, size_t size);
+	static bool _decodeSequence(
+			uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc, size_t size);
+
+	static void _filterOctahedral8(int8_t *pData, size_t count);
+	static void _filterOctahedral16(int16_t *pData, size_t count);
+	static void _filterQuaternion(int16_t *pData, size_t count);
+	static void _filterExponential(uint32_t *pData, size_t count);
+
+public:
+	// count elements of stride bytes are written to destination, false when data is malformed or
+	// mode and filter do not fit stride
+	static bool decode(uint8_t *pDst, size_t count, size_t stride, const uint8_t *pSrc,
+			size_t size, Mode mode, Filter filter);
+};
+
+#endif // !MESHOPT_DECODER_H
@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include <zlib/zlib.h>
+
+#include <job_system.h>
+
+#include "package.h"
+
+const char PACKAGE_MAGIC[4] = { 'H', 'P', 'A', 'K' };
+const uint32_t PACKAGE_VERSION = 1;
+
+// chunks inflated by one job of read, a few of them outweigh scheduling
+const uint32_t READ_CHUNK_GRAIN = 2;
+
+bool Package::_writeMember(SDL_IOStream *pStream, const std::filesystem::path &path,
+		uint64_t &offset, Entry &entry, std::vector<Chunk> &chunks) {
+	std::error_code error;
+	uintmax_t fileSize = std::filesystem::file_size(path, error);
+
+	if (error)
+		return false;
+
+	entry.size = fileSize;
+
+	if (fileSize == 0)
+		return true;
+
+	MappedFile source;
+
+	if (!source.open(path))
+		return false;
+
+	std::vector<uint8_t> compressed(compressBound(PACKAGE_CHUNK_SIZE));
+
+	for (uint64_t begin = 0; begin < entry.size; begin += PACKAGE_CHUNK_SIZE) {
+		const uint8_t *pSrc = source.getData() + begin;
+		uint64_t remaining = entry.size - begin;
+		uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(PACKAGE_CHUNK_SIZE, remaining));
+
+		// cooking is offline, spend time on ratio
+		uLongf compressedSize = compressed.size();
+		int result = compress2(compressed.data(), &compressedSize, pSrc, size, Z_BEST_COMPRESSION);
+
+		Chunk chunk = {};
+		chunk.offset = offset;
+
+		// already compressed data like png does not shrink, it is stored and read in place
+		if (result == Z_OK && compressedSize < size) {
+			chunk.size = static_cast<uint32_t>(compressedSize);
+			pSrc = compressed.data();
+		} else {
+			chunk.size = size;
+			chunk.isStored = true;
+		}
+
+		if (SDL_WriteIO(pStream, pSrc, chunk.size) != chunk.size)
+			return false;
+
+		offset += chunk.size;
+		chunks.push_back(chunk);
+	}
+
+	return true;
+}
+
+bool Package::_inflate(const Entry &entry, uint64_t chunk, uint8_t *pDst) const {
+	const Chunk &_chunk = _chunks[entry.firstChunk + chunk];
+	const uint8_t *pSrc = _file.getData() + _chunk.offset;
+
+	uint64_t begin = chunk * _header.chunkSize;
+	uint64_t size = std::min<uint64_t>(_header.chunkSize, entry.size - begin);
+
+	if (_chunk.isStored) {
+		if (_chunk.size != size)
+			return false;
+
+		memcpy(pDst, pSrc, size);
+		return true;
+	}
+
+	uLongf inflatedSize = size;
+	int result = uncompress(pDst, &inflatedSize, pSrc, _chunk.size);
+
+	return result == Z_OK && inflatedSize == size;
+}
+
+const Package::Entry *Package::_find(const std::string &name) const {
+	std::unordered_map<std::string, size_t>::const_iterator it = _entryIndices.find(name);
+
+	if (it == _entryIndices.end())
+		return nullptr;
+
+	return &_entries[it->second];
+}
+
+bool Package::create(const std::filesystem::path &directory, const std::filesystem::path &file) {
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+
+	for (const std::filesystem::directory_entry &entry :
+			std::filesystem::recursive_directory_iterator(directory, error)) {
+		if (entry.is_regular_file())
+			paths.push_back(entry.path());
+	}
+
+	if (error) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Reading directory (%s) failed",
+				directory.c_str());
+		return false;
+	}
+
+	// same input gives same archive
+	std::sort(paths.begin(), paths.end());
+
+	SDL_IOStream *pStream = SDL_IOFromFile(file.c_str(), "wb");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Opening package (%s) failed", file.c_str());
+		return false;
+	}
+
+	Header header = {};
+	memcpy(header.magic, PACKAGE_MAGIC, sizeof(PACKAGE_MAGIC));
+	header.version = PACKAGE_VERSION;
+	header.chunkSize = PACKAGE_CHUNK_SIZE;
+
+	// rewritten once index offset is known
+	bool isWritten = SDL_WriteIO(pStream, &header, sizeof(Header)) == sizeof(Header);
+	uint64_t offset = sizeof(Header);
+
+	std::vector<Entry> entries;
+	std::vector<Chunk> chunks;
+	std::string names;
+
+	for (const std::filesystem::path &path : paths) {
+		if (!isWritten)
+			break;
+
+		std::string name = path.lexically_relative(directory).generic_string();
+
+		Entry entry = {};
+		entry.nameOffset = names.size();
+		entry.nameSize = name.size();
+		entry.firstChunk = chunks.size();
+
+		isWritten = _writeMember(pStream, path, offset, entry, chunks);
+
+		if (!isWritten) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Packing file (%s) failed", path.c_str());
+			break;
+		}
+
+		entry.chunkCount = chunks.size() - entry.firstChunk;
+
+		names += name;
+		entries.push_back(entry);
+	}
+
+	header.entryCount = static_cast<uint32_t>(entries.size());
+	header.chunkCount = chunks.size();
+	header.indexOffset = offset;
+	header.namesSize = names.size();
+
+	if (isWritten) {
+		size_t entriesSize = entries.size() * sizeof(Entry);
+		size_t chunksSize = chunks.size() * sizeof(Chunk);
+
+		isWritten = SDL_WriteIO(pStream, entries.data(), entriesSize) == entriesSize &&
+				SDL_WriteIO(pStream, chunks.data(), chunksSize) == chunksSize &&
+				SDL_WriteIO(pStream, names.data(), names.size()) == names.size() &&
+				SDL_SeekIO(pStream, 0, SDL_IO_SEEK_SET) == 0 &&
+				SDL_WriteIO(pStream, &header, sizeof(Header)) == sizeof(Header);
+	}
+
+	SDL_CloseIO(pStream);
+
+	if (!isWritten) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Writing package (%s) failed", file.c_str());
+		remove(file.c_str());
+	}
+
+	return isWritten;
+}
+
+bool Package::split(
+		const std::filesystem::path &path, std::filesystem::path &package, std::string &name) {
+	std::filesystem::path normalPath = path.lexically_normal();
+	std::filesystem::path prefix;
+
+	for (std::filesystem::path::iterator it = normalPath.begin(); it != normalPath.end(); it++) {
+		prefix /= *it;
+
+		// directory may be named like package too
+		if (it->extension() != PACKAGE_EXTENSION || !std::filesystem::is_regular_file(prefix))
+			continue;
+
+		std::filesystem::path member;
+
+		for (it++; it != normalPath.end(); it++)
+			member /= *it;
+
+		if (member.empty())
+			return false;
+
+		package = prefix;
+		name = member.generic_string();
+		return true;
+	}
+
+	return false;
+}
+
+bool Package::load(const std::filesystem::path &path, std::vector<uint8_t> &data, size_t padding) {
+	std::filesystem::path packagePath;
+	std::string name;
+
+	if (split(path, packagePath, name)) {
+		Package package;
+		return package.open(packagePath) && package.read(name, data, padding);
+	}
+
+	size_t size;
+	uint8_t *pFile = static_cast<uint8_t *>(SDL_LoadFile(path.c_str(), &size));
+
+	if (pFile == nullptr)
+		return false;
+
+	data.assign(pFile, pFile + size);
+	data.resize(size + padding, 0);
+
+	SDL_free(pFile);
+	return true;
+}
+
+bool Package::loadPrefix(
+		const std::filesystem::path &path, std::vector<uint8_t> &data, size_t size) {
+	std::filesystem::path packagePath;
+	std::string name;
+
+	data.clear();
+
+	if (split(path, packagePath, name)) {
+		Package package;
+
+		if (!package.open(packagePath) || !package.contains(name))
+			return false;
+
+		// stopping early fails stream, chunks read by then are kept
+		package.stream(name, [&data, size](const uint8_t *pData, size_t chunkSize) {
+			size_t count = std::min(chunkSize, size - data.size());
+			data.insert(data.end(), pData, pData + count);
+			return data.size() < size;
+		});
+
+		return true;
+	}
+
+	SDL_IOStream *pStream = SDL_IOFromFile(path.c_str(), "rb");
+
+	if (pStream == nullptr)
+		return false;
+
+	data.resize(size);
+	data.resize(SDL_ReadIO(pStream, data.data(), size));
+
+	SDL_CloseIO(pStream);
+	return true;
+}
+
+bool Package::open(const std::filesystem::path &path) {
+	close();
+
+	if (!_file.open(path))
+		return false;
+
+	const uint8_t *pData = _file.getData();
+	uint64_t fileSize = _file.getSize();
+
+	bool isValid = fileSize >= sizeof(Header);
+
+	if (isValid) {
+		memcpy(&_header, pData, sizeof(Header));
+
+		isValid = memcmp(_header.magic, PACKAGE_MAGIC, sizeof(PACKAGE_MAGIC)) == 0 &&
+				_header.version == PACKAGE_VERSION && _header.chunkSize > 0 &&
+				_header.indexOffset >= sizeof(Header) && _header.indexOffset <= fileSize &&
+				_header.chunkCount <= fileSize / sizeof(Chunk) && _header.namesSize <= fileSize;
+	}
+
+	if (isValid) {
+		uint64_t entriesSize = _header.entryCount * sizeof(Entry);
+		uint64_t chunksSize = _header.chunkCount * sizeof(Chunk);
+
+		isValid = entriesSize + chunksSize + _header.namesSize == fileSize - _header.indexOffset;
+	}
+
+	if (!isValid) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s is not package", path.c_str());
+		close();
+		return false;
+	}
+
+	const uint8_t *pIndex = pData + _header.indexOffset;
+
+	_entries.resize(_header.entryCount);
+	memcpy(_entries.data(), pIndex, _entries.size() * sizeof(Entry));
+	pIndex += _entries.size() * sizeof(Entry);
+
+	_chunks.resize(_header.chunkCount);
+	memcpy(_chunks.data(), pIndex, _chunks.size() * sizeof(Chunk));
+	pIndex += _chunks.size() * sizeof(Chunk);
+
+	const char *pNames = reinterpret_cast<const char *>(pIndex);
+
+	for (const Chunk &chunk : _chunks) {
+		if (chunk.offset > _header.indexOffset || chunk.size > _header.indexOffset - chunk.offset)
+			isValid = false;
+	}
+
+	for (size_t i = 0; i < _entries.size() && isValid; i++) {
+		const Entry &entry = _entries[i];
+
+		uint64_t chunkCount = (entry.size + _header.chunkSize - 1) / _header.chunkSize;
+
+		isValid = entry.nameOffset <= _header.namesSize &&
+				entry.nameSize <= _header.namesSize - entry.nameOffset &&
+				entry.firstChunk <= _chunks.size() &&
+				entry.chunkCount <= _chunks.size() - entry.firstChunk &&
+				entry.chunkCount == chunkCount;
+
+		if (isValid)
+			_entryIndices[std::string(pNames + entry.nameOffset, entry.nameSize)] = i;
+	}
+
+	if (!isValid) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s is corrupted", path.c_str());
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void Package::close() {
+	_file.close();
+	_header = {};
+
+	_entries.clear();
+	_chunks.clear();
+	_entryIndices.clear();
+}
+
+bool Package::contains(const std::string &name) const {
+	return _find(name) != nullptr;
+}
+
+uint64_t Package::getSize(const std::string &name) const {
+	const Entry *pEntry = _find(name);
+	return pEntry != nullptr ? pEntry->size : 0;
+}
+
+bool Package::stream(const std::string &name, const ChunkCallback &callback) const {
+	const Entry *pEntry = _find(name);
+
+	if (pEntry == nullptr)
+		return false;
+
+	std::vector<uint8_t> buffer;
+
+	for (uint64_t i = 0; i < pEntry->chunkCount; i++) {
+		const Chunk &chunk = _chunks[pEntry->firstChunk + i];
+		uint64_t remaining = pEntry->size - i * _header.chunkSize;
+		uint64_t size = std::min<uint64_t>(_header.chunkSize, remaining);
+
+		// stored chunk is passed straight from mapping
+		if (chunk.isStored && chunk.size == size) {
+			if (!callback(_file.getData() + chunk.offset, size))
+				return false;
+
+			continue;
+		}
+
+		buffer.resize(_header.chunkSize);
+
+		if (!_inflate(*pEntry, i, buffer.data())) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Inflating %s failed", name.c_str());
+			return false;
+		}
+
+		if (!callback(buffer.data(), size))
+			return false;
+	}
+
+	return true;
+}
+
+bool Package::read(const std::string &name, std::vector<uint8_t> &data, size_t padding) const {
+	const Entry *pEntry = _find(name);
+
+	if (pEntry == nullptr)
+		return false;
+
+	data.assign(pEntry->size + padding, 0);
+
+	uint8_t *pData = data.data();
+	std::atomic<bool> isValid{ true };
+
+	// chunks are deflated on their own and land in place, so they are inflated in parallel
+	// with no intermediate buffer
+	JobSystem::parallelFor(static_cast<uint32_t>(pEntry->chunkCount), READ_CHUNK_GRAIN,
+			[&](uint32_t first, uint32_t last) {
+				for (uint64_t i = first; i < last && isValid.load(std::memory_order_relaxed); i++) {
+					if (!_inflate(*pEntry, i, pData + i * _header.chunkSize))
+						isValid.store(false, std::memory_order_relaxed);
+				}
+			});
+
+	if (!isValid) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Inflating %s failed", name.c_str());
+		return false;
+	}
+
+	return true;
+}
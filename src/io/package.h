@@ -0,0 +1,107 @@
+#ifndef PACKAGE_H
+#define PACKAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+
+#include "mapped_file.h"
+
+const char PACKAGE_EXTENSION[] = ".hpk";
+
+// uncompressed size of every chunk but last one of a member
+const uint32_t PACKAGE_CHUNK_SIZE = 256 * 1024;
+
+// Archive of zlib compressed files. Members are split into chunks deflated on their own, so a
+// member is inflated chunk by chunk into small buffer and reader never holds compressed copy.
+// Archive is mapped, any number of threads can read members at once, read inflates chunks of a
+// member on workers of JobSystem. Paths with a component ending in .hpk name a member,
+// "assets.hpk/textures/albedo.png" is textures/albedo.png of assets.hpk.
+class Package {
+public:
+	// receives inflated chunks in order, returning false stops the stream
+	typedef std::function<bool(const uint8_t *pData, size_t size)> ChunkCallback;
+
+private:
+	typedef struct {
+		char magic[4];
+		uint32_t version;
+
+		uint32_t entryCount;
+		uint32_t chunkSize;
+		uint64_t chunkCount;
+
+		// index follows compressed chunks
+		uint64_t indexOffset;
+		uint64_t namesSize;
+	} Header;
+
+	typedef struct {
+		uint64_t nameOffset;
+		uint64_t nameSize;
+
+		uint64_t firstChunk;
+		uint64_t chunkCount;
+
+		uint64_t size;
+	} Entry;
+
+	// chunk not smaller once deflated is stored as is
+	typedef struct {
+		uint64_t offset;
+		uint32_t size;
+		uint32_t isStored;
+	} Chunk;
+
+	MappedFile _file;
+	Header _header;
+
+	std::vector<Entry> _entries;
+	std::vector<Chunk> _chunks;
+	std::unordered_map<std::string, size_t> _entryIndices;
+
+	static bool _writeMember(SDL_IOStream *pStream, const std::filesystem::path &path,
+			uint64_t &offset, Entry &entry, std::vector<Chunk> &chunks);
+
+	// pDst holds uncompressed size of chunk
+	bool _inflate(const Entry &entry, uint64_t chunk, uint8_t *pDst) const;
+	const Entry *_find(const std::string &name) const;
+
+public:
+	Package(Package const &) = delete;
+	void operator=(Package const &) = delete;
+
+	// every regular file under directory, names are relative to it
+	static bool create(const std::filesystem::path &directory, const std::filesystem::path &file);
+
+	// false when path does not point into package
+	static bool split(const std::filesystem::path &path, std::filesystem::path &package,
+			std::string &name);
+
+	// reads file on disk or package member, padding bytes after data are zeroed
+	static bool load(
+			const std::filesystem::path &path, std::vector<uint8_t> &data, size_t padding = 0);
+	// first size bytes at most, enough to tell format without reading whole file
+	static bool loadPrefix(
+			const std::filesystem::path &path, std::vector<uint8_t> &data, size_t size);
+
+	bool open(const std::filesystem::path &path);
+	void close();
+
+	bool contains(const std::string &name) const;
+	// uncompressed size, 0 for missing member
+	uint64_t getSize(const std::string &name) const;
+
+	bool stream(const std::string &name, const ChunkCallback &callback) const;
+	bool read(const std::string &name, std::vector<uint8_t> &data, size_t padding = 0) const;
+
+	Package() = default;
+};
+
+#endif // !PACKAGE_H
@@ -0,0 +1,23 @@
+#ifndef REFLECTION_PROBES_H
+#define REFLECTION_PROBES_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// slots of probes, each one is a cube of the probe array
+const uint32_t MAX_REFLECTION_PROBE_COUNT = 16;
+
+// Local reflections of a room, captured offline as equirectangular HDR image at its position.
+// Reflections are box projected, a ray leaving the surface is intersected with the box and the
+// capture is sampled towards the hit, so they line up with walls the box matches. Shading
+// inside the box uses it in place of sky, fading to the sky over blend distance at its faces.
+// Smaller boxes cover larger ones they overlap.
+struct ReflectionProbe {
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 boxMin = glm::vec3(-1.0f);
+	glm::vec3 boxMax = glm::vec3(1.0f);
+	float blendDistance = 0.5f;
+};
+
+#endif // !REFLECTION_PROBES_H
@@ -0,0 +1,134 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <job_system.h>
+#include <profiler.h>
+
+#include "scene_raycaster.h"
+
+std::vector<glm::mat4> SceneRaycaster::computeWorldTransforms(const AssetLoader::Scene &scene) {
+	std::vector<glm::mat4> result(scene.nodes.size());
+
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		const AssetLoader::Node &node = scene.nodes[i];
+
+		if (node.parentIndex.has_value() && node.parentIndex.value() < i)
+			result[i] = result[node.parentIndex.value()] * node.transform;
+		else
+			result[i] = node.transform;
+	}
+
+	return result;
+}
+
+void SceneRaycaster::build(const AssetLoader::Scene &scene) {
+	PROFILE_ZONE("scene raycaster build");
+
+	_pScene = &scene;
+	_worldTransforms = computeWorldTransforms(scene);
+	_invTransforms.resize(_worldTransforms.size());
+	_normalMatrices.resize(_worldTransforms.size());
+
+	for (size_t i = 0; i < _worldTransforms.size(); i++) {
+		_invTransforms[i] = glm::inverse(_worldTransforms[i]);
+		_normalMatrices[i] = glm::inverseTranspose(glm::mat3(_worldTransforms[i]));
+	}
+
+	std::vector<bool> isUsed(scene.meshes.size(), false);
+
+	for (const AssetLoader::MeshInstance &instance : scene.meshInstances)
+		isUsed[instance.meshIndex] = true;
+
+	std::vector<uint32_t> usedMeshes;
+
+	for (uint32_t i = 0; i < scene.meshes.size(); i++) {
+		if (isUsed[i])
+			usedMeshes.push_back(i);
+	}
+
+	_bvhs.clear();
+	_bvhs.resize(scene.meshes.size());
+	_meshBounds.assign(scene.meshes.size(), { glm::vec3(INFINITY), glm::vec3(-INFINITY) });
+
+	uint32_t usedCount = static_cast<uint32_t>(usedMeshes.size());
+
+	JobSystem::parallelFor(usedCount, 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			uint32_t meshIndex = usedMeshes[i];
+			const Mesh &mesh = scene.meshes[meshIndex];
+
+			for (uint32_t j = 0; j < mesh.primitiveCount; j++) {
+				const VertexArray &vertices = mesh.pPrimitives[j].vertices;
+
+				for (uint32_t k = 0; k < vertices.count; k++)
+					_meshBounds[meshIndex].expand(vertices.pData[k].position);
+			}
+
+			_bvhs[meshIndex].build(mesh);
+		}
+	});
+
+	_tree.clear();
+	_bounds = { glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+
+	for (uint64_t i = 0; i < scene.meshInstances.size(); i++) {
+		const AssetLoader::MeshInstance &instance = scene.meshInstances[i];
+		const AABB &bounds = _meshBounds[instance.meshIndex];
+
+		if (bounds.min.x > bounds.max.x)
+			continue;
+
+		AABB worldBounds = bounds.transformed(_worldTransforms[instance.nodeIndex]);
+		_tree.insert(worldBounds, i);
+
+		_bounds.expand(worldBounds.min);
+		_bounds.expand(worldBounds.max);
+	}
+}
+
+bool SceneRaycaster::raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+		float maxDistance, Hit &hit) const {
+	// bakers cast millions of rays, candidates are not allocated for each
+	static thread_local std::vector<uint64_t> candidates;
+
+	candidates.clear();
+	_tree.queryRay(origin, direction, maxDistance, candidates);
+
+	float closest = maxDistance;
+	bool isHit = false;
+
+	for (uint64_t index : candidates) {
+		const AssetLoader::MeshInstance &instance = _pScene->meshInstances[index];
+		const glm::mat4 &invTransform = _invTransforms[instance.nodeIndex];
+
+		// mesh space direction keeps distances in lengths of world one
+		glm::vec3 meshOrigin = glm::vec3(invTransform * glm::vec4(origin, 1.0f));
+		glm::vec3 meshDirection = glm::mat3(invTransform) * direction;
+
+		MeshBVH::Hit meshHit;
+
+		if (!_bvhs[instance.meshIndex].raycast(meshOrigin, meshDirection, closest, meshHit))
+			continue;
+
+		closest = meshHit.distance;
+		isHit = true;
+
+		hit.distance = meshHit.distance;
+		hit.meshInstance = index;
+		hit.normal = _normalMatrices[instance.nodeIndex] * meshHit.normal;
+	}
+
+	return isHit;
+}
+
+const AABB &SceneRaycaster::getBounds() const {
+	return _bounds;
+}
+
+const std::vector<glm::mat4> &SceneRaycaster::getWorldTransforms() const {
+	return _worldTransforms;
+}
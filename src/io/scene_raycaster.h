@@ -0,0 +1,58 @@
+#ifndef SCENE_RAYCASTER_H
+#define SCENE_RAYCASTER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/culling/aabb_tree.h>
+#include <rendering/types/aabb.h>
+
+#include "asset_loader.h"
+#include "mesh_bvh.h"
+
+// Casts rays against mesh instances of a loaded scene on the CPU, for offline bakers. Every
+// instanced mesh gets a MeshBVH, built in parallel on JobSystem, and instances are found through
+// an AABBTree of their world bounds. Scene has to outlive it. Casts only read and may run on
+// several threads at once.
+class SceneRaycaster {
+public:
+	typedef struct {
+		// along ray, in lengths of its direction
+		float distance;
+		uint64_t meshInstance;
+		// world space, not normalized, faces side triangle is wound towards
+		glm::vec3 normal;
+	} Hit;
+
+private:
+	const AssetLoader::Scene *_pScene = nullptr;
+
+	std::vector<MeshBVH> _bvhs;
+	// per mesh, empty one has min above max
+	std::vector<AABB> _meshBounds;
+
+	std::vector<glm::mat4> _worldTransforms;
+	std::vector<glm::mat4> _invTransforms;
+	std::vector<glm::mat3> _normalMatrices;
+
+	AABBTree _tree;
+	AABB _bounds;
+
+public:
+	// depth first, parent comes before its children
+	static std::vector<glm::mat4> computeWorldTransforms(const AssetLoader::Scene &scene);
+
+	void build(const AssetLoader::Scene &scene);
+
+	// closest hit closer than maxDistance, direction needs not be normalized
+	bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+			Hit &hit) const;
+
+	// of every instance, min is above max for scene without geometry
+	const AABB &getBounds() const;
+	const std::vector<glm::mat4> &getWorldTransforms() const;
+};
+
+#endif // !SCENE_RAYCASTER_H
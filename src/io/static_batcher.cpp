@@ -0,0 +1,206 @@
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <profiler.h>
+
+#include "mesh_optimizer.h"
+
+#include "static_batcher.h"
+
+std::vector<glm::mat4> StaticBatcher::_computeWorldTransforms(const AssetLoader::Scene &scene) {
+	std::vector<glm::mat4> result(scene.nodes.size());
+
+	// depth first, parent comes before its children
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		const AssetLoader::Node &node = scene.nodes[i];
+
+		if (node.parentIndex.has_value() && node.parentIndex.value() < i)
+			result[i] = result[node.parentIndex.value()] * node.transform;
+		else
+			result[i] = node.transform;
+	}
+
+	return result;
+}
+
+glm::vec3 StaticBatcher::_computeCenter(const Mesh &mesh, const glm::mat4 &transform) {
+	glm::vec3 min = glm::vec3(INFINITY);
+	glm::vec3 max = glm::vec3(-INFINITY);
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const VertexArray &vertices = mesh.pPrimitives[i].vertices;
+
+		for (uint32_t j = 0; j < vertices.count; j++) {
+			min = glm::min(min, vertices.pData[j].position);
+			max = glm::max(max, vertices.pData[j].position);
+		}
+	}
+
+	glm::vec3 center = min.x <= max.x ? (min + max) * 0.5f : glm::vec3(0.0f);
+	return glm::vec3(transform * glm::vec4(center, 1.0f));
+}
+
+Primitive StaticBatcher::_merge(
+		const std::vector<Piece> &pieces, uint64_t materialIndex, MeshArena &arena) {
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+
+	for (const Piece &piece : pieces) {
+		vertexCount += piece.pPrimitive->vertices.count;
+		indexCount += piece.pPrimitive->indices.count;
+	}
+
+	Primitive result = {};
+	result.vertices = { arena.allocate<Vertex>(vertexCount), vertexCount };
+	result.indices = { arena.allocate<uint32_t>(indexCount), indexCount };
+	result.materialIndex = materialIndex;
+
+	uint32_t vertexOffset = 0;
+	uint32_t indexOffset = 0;
+
+	for (const Piece &piece : pieces) {
+		const Primitive &primitive = *piece.pPrimitive;
+		glm::mat3 basis = glm::mat3(piece.transform);
+		glm::mat3 normalMatrix = glm::inverseTranspose(basis);
+
+		for (uint32_t i = 0; i < primitive.vertices.count; i++) {
+			const Vertex &in = primitive.vertices.pData[i];
+			Vertex &out = result.vertices.pData[vertexOffset + i];
+
+			glm::vec3 normal = normalMatrix * in.normal;
+			glm::vec3 tangent = basis * in.tangent;
+
+			out.position = glm::vec3(piece.transform * glm::vec4(in.position, 1.0f));
+			out.normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : in.normal;
+			out.tangent = glm::length(tangent) > 0.0f ? glm::normalize(tangent) : in.tangent;
+			out.uv = in.uv;
+			out.lightmapUV = in.lightmapUV;
+		}
+
+		// mirroring transform flips winding, triangles are turned back
+		bool isMirrored = glm::determinant(basis) < 0.0f;
+
+		for (uint32_t i = 0; i + 2 < primitive.indices.count; i += 3) {
+			uint32_t *pOut = result.indices.pData + indexOffset + i;
+
+			pOut[0] = vertexOffset + primitive.indices.pData[i];
+			pOut[1] = vertexOffset + primitive.indices.pData[i + (isMirrored ? 2 : 1)];
+			pOut[2] = vertexOffset + primitive.indices.pData[i + (isMirrored ? 1 : 2)];
+		}
+
+		vertexOffset += primitive.vertices.count;
+		indexOffset += primitive.indices.count;
+	}
+
+	// pieces were optimized alone, order across them is redone
+	MeshOptimizer::optimize(result);
+	MeshOptimizer::buildMeshlets(result, arena);
+	MeshOptimizer::buildLods(result, arena);
+
+	return result;
+}
+
+void StaticBatcher::batch(AssetLoader::Scene &scene, float cellSize) {
+	PROFILE_ZONE("static batch");
+
+	std::vector<uint32_t> useCounts(scene.meshes.size(), 0);
+
+	for (const AssetLoader::MeshInstance &instance : scene.meshInstances)
+		useCounts[instance.meshIndex]++;
+
+	std::vector<glm::mat4> worldTransforms = _computeWorldTransforms(scene);
+
+	// nodes moved by animations and their subtrees, parent comes before its children
+	std::vector<bool> isAnimated(scene.nodes.size(), false);
+
+	for (const AnimationClip &clip : scene.animations) {
+		for (const AnimationClip::Target &target : clip.targets)
+			isAnimated[target.node] = true;
+	}
+
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		const std::optional<uint64_t> &parent = scene.nodes[i].parentIndex;
+
+		if (parent.has_value() && parent.value() < i && isAnimated[parent.value()])
+			isAnimated[i] = true;
+	}
+
+	// cells in order of their first instance, pieces of cell by material
+	std::map<std::tuple<int32_t, int32_t, int32_t>, size_t> cellIndices;
+	std::vector<std::map<uint64_t, std::vector<Piece>>> cells;
+	std::vector<AssetLoader::MeshInstance> keptInstances;
+
+	for (const AssetLoader::MeshInstance &instance : scene.meshInstances) {
+		// skinned mesh is posed in its own space, merging would bake bind pose into world, and
+		// morphed or animated ones would stop following their weights or node
+		if (useCounts[instance.meshIndex] != 1 || instance.skinIndex.has_value() ||
+				!instance.morphWeights.empty() || isAnimated[instance.nodeIndex]) {
+			keptInstances.push_back(instance);
+			continue;
+		}
+
+		const Mesh &mesh = scene.meshes[instance.meshIndex];
+		const glm::mat4 &transform = worldTransforms[instance.nodeIndex];
+
+		glm::ivec3 cell = glm::ivec3(glm::floor(_computeCenter(mesh, transform) / cellSize));
+		auto [it, isNew] = cellIndices.try_emplace({ cell.x, cell.y, cell.z }, cells.size());
+
+		if (isNew)
+			cells.emplace_back();
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			const Primitive &primitive = mesh.pPrimitives[i];
+			cells[it->second][primitive.materialIndex].push_back({ &primitive, transform });
+		}
+	}
+
+	if (cells.empty())
+		return;
+
+	// instanced meshes are renumbered, batched ones are dropped
+	std::vector<Mesh> meshes;
+	std::vector<uint64_t> meshIndices(scene.meshes.size(), UINT64_MAX);
+
+	for (AssetLoader::MeshInstance &instance : keptInstances) {
+		if (meshIndices[instance.meshIndex] == UINT64_MAX) {
+			meshIndices[instance.meshIndex] = meshes.size();
+			meshes.push_back(scene.meshes[instance.meshIndex]);
+		}
+
+		instance.meshIndex = meshIndices[instance.meshIndex];
+	}
+
+	for (size_t i = 0; i < cells.size(); i++) {
+		Mesh mesh;
+		mesh.primitiveCount = static_cast<uint32_t>(cells[i].size());
+		mesh.pPrimitives = scene.arena->allocate<Primitive>(mesh.primitiveCount);
+
+		std::string name = "static batch " + std::to_string(i);
+		mesh.pName = scene.arena->copyString(name.c_str());
+
+		uint32_t primitive = 0;
+
+		for (const auto &[materialIndex, pieces] : cells[i])
+			mesh.pPrimitives[primitive++] = _merge(pieces, materialIndex, *scene.arena);
+
+		// root at origin, vertices are in world space already
+		AssetLoader::Node node;
+		node.transform = glm::mat4(1.0f);
+		node.name = name;
+
+		keptInstances.push_back({ scene.nodes.size(), meshes.size(), name });
+		scene.nodes.push_back(node);
+		meshes.push_back(mesh);
+	}
+
+	scene.meshes = std::move(meshes);
+	scene.meshInstances = std::move(keptInstances);
+}
@@ -0,0 +1,36 @@
+#ifndef STATIC_BATCHER_H
+#define STATIC_BATCHER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "asset_loader.h"
+
+// edge of grid cells batched geometry is split into, cells are culled as a whole
+const float STATIC_BATCH_CELL_SIZE = 32.0f;
+
+// Merges instances of meshes which are drawn once into one mesh per grid cell, with one
+// primitive per material and transforms applied to vertices, so a level of unique pieces takes
+// a few draws instead of one per piece. Cell is picked by bounds center of instance. Meshes
+// drawn several times and animated nodes stay instanced. Batched geometry hangs off a new root
+// node per cell and no longer follows nodes it came from.
+class StaticBatcher {
+private:
+	typedef struct {
+		const Primitive *pPrimitive;
+		glm::mat4 transform;
+	} Piece;
+
+	static std::vector<glm::mat4> _computeWorldTransforms(const AssetLoader::Scene &scene);
+	static glm::vec3 _computeCenter(const Mesh &mesh, const glm::mat4 &transform);
+	// pieces share material, result is optimized like loaded primitives are
+	static Primitive _merge(
+			const std::vector<Piece> &pieces, uint64_t materialIndex, MeshArena &arena);
+
+public:
+	static void batch(AssetLoader::Scene &scene, float cellSize = STATIC_BATCH_CELL_SIZE);
+};
+
+#endif // !STATIC_BATCHER_H
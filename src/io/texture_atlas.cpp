@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <profiler.h>
+
+#include "image.h"
+
+#include "texture_atlas.h"
+
+static bool _isPowerOfTwo(uint32_t value) {
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+static uint32_t _ceilPowerOfTwo(uint32_t value) {
+	uint32_t result = 1;
+
+	while (result < value)
+		result <<= 1;
+
+	return result;
+}
+
+std::vector<std::vector<TextureAtlas::Tile>> TextureAtlas::_place(
+		const AssetLoader::Scene &scene, std::vector<uint64_t> &images) {
+	std::sort(images.begin(), images.end(), [&scene](uint64_t a, uint64_t b) {
+		const Image &imageA = *scene.images[a];
+		const Image &imageB = *scene.images[b];
+
+		if (imageA.getHeight() != imageB.getHeight())
+			return imageA.getHeight() > imageB.getHeight();
+
+		return imageA.getWidth() > imageB.getWidth();
+	});
+
+	std::vector<std::vector<Tile>> atlases(1);
+
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t shelfHeight = 0;
+
+	for (uint64_t image : images) {
+		uint32_t width = scene.images[image]->getWidth();
+		uint32_t height = scene.images[image]->getHeight();
+
+		// shelves are stacked from tallest, y is then a multiple of every height on them
+		x = (x + width - 1) / width * width;
+
+		if (x + width > ATLAS_MAX_SIZE) {
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+
+		if (y + height > ATLAS_MAX_SIZE) {
+			atlases.emplace_back();
+			x = 0;
+			y = 0;
+			shelfHeight = 0;
+		}
+
+		shelfHeight = std::max(shelfHeight, height);
+
+		atlases.back().push_back({ image, x, y });
+		x += width;
+	}
+
+	return atlases;
+}
+
+std::shared_ptr<Image> TextureAtlas::_build(
+		const AssetLoader::Scene &scene, const std::vector<Tile> &tiles) {
+	Image::Format format = scene.images[tiles[0].image]->getFormat();
+	uint32_t texelSize = Image::getFormatByteSize(format);
+
+	uint32_t width = 1;
+	uint32_t height = 1;
+
+	for (const Tile &tile : tiles) {
+		width = std::max(width, tile.x + scene.images[tile.image]->getWidth());
+		height = std::max(height, tile.y + scene.images[tile.image]->getHeight());
+	}
+
+	// power of two keeps every level of atlas aligned with tiles
+	width = _ceilPowerOfTwo(width);
+	height = _ceilPowerOfTwo(height);
+
+	std::vector<uint8_t> data(static_cast<size_t>(width) * height * texelSize, 0);
+
+	for (const Tile &tile : tiles) {
+		const Image &image = *scene.images[tile.image];
+		size_t rowSize = static_cast<size_t>(image.getWidth()) * texelSize;
+
+		for (uint32_t row = 0; row < image.getHeight(); row++) {
+			size_t dstOffset = (static_cast<size_t>(tile.y + row) * width + tile.x) * texelSize;
+			memcpy(data.data() + dstOffset, image.getData().data() + row * rowSize, rowSize);
+		}
+	}
+
+	// tiles of one atlas share usage, so color space too
+	std::shared_ptr<Image> atlas = std::make_shared<Image>(width, height, format, std::move(data));
+	atlas->setSrgb(scene.images[tiles[0].image]->isSrgb());
+
+	return atlas;
+}
+
+void TextureAtlas::pack(AssetLoader::Scene &scene, uint32_t maxTileSize) {
+	PROFILE_ZONE("texture atlas");
+
+	// map slot each image is used by, loader does not share images between usages
+	std::vector<std::optional<uint32_t>> slots(scene.images.size());
+	std::vector<bool> isPackable(scene.images.size(), true);
+
+	for (const AssetLoader::Material &material : scene.materials) {
+		std::optional<uint64_t> indices[3] = {
+			material.albedoIndex,
+			material.normalIndex,
+			material.metallicRoughnessIndex,
+		};
+
+		for (uint32_t slot = 0; slot < 3; slot++) {
+			if (!indices[slot].has_value() || indices[slot].value() >= scene.images.size())
+				continue;
+
+			uint64_t image = indices[slot].value();
+
+			if (slots[image].has_value() && slots[image].value() != slot)
+				isPackable[image] = false;
+
+			slots[image] = slot;
+		}
+	}
+
+	// same format and usage share atlas, usage decides how cooking compresses it
+	std::map<std::pair<Image::Format, uint32_t>, std::vector<uint64_t>> groups;
+
+	for (uint64_t i = 0; i < scene.images.size(); i++) {
+		const std::shared_ptr<Image> &image = scene.images[i];
+
+		if (image == nullptr || !slots[i].has_value() || !isPackable[i])
+			continue;
+
+		bool isSmall = image->getWidth() <= maxTileSize && image->getHeight() <= maxTileSize;
+		bool isAligned = _isPowerOfTwo(image->getWidth()) && _isPowerOfTwo(image->getHeight());
+
+		if (!isSmall || !isAligned || image->getMipLevels() > 1 ||
+				Image::isFormatCompressed(image->getFormat()))
+			continue;
+
+		groups[{ image->getFormat(), slots[i].value() }].push_back(i);
+	}
+
+	// new index and rect of every packed image, others keep their index
+	std::vector<std::optional<uint64_t>> atlasIndices(scene.images.size());
+	std::vector<glm::vec4> rects(scene.images.size(), glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	std::vector<std::shared_ptr<Image>> atlases;
+
+	for (auto &[key, images] : groups) {
+		if (images.size() < 2)
+			continue;
+
+		for (const std::vector<Tile> &tiles : _place(scene, images)) {
+			// lone tile gains nothing from atlas
+			if (tiles.size() < 2)
+				continue;
+
+			std::shared_ptr<Image> atlas = _build(scene, tiles);
+
+			for (const Tile &tile : tiles) {
+				const Image &image = *scene.images[tile.image];
+
+				float atlasWidth = static_cast<float>(atlas->getWidth());
+				float atlasHeight = static_cast<float>(atlas->getHeight());
+
+				atlasIndices[tile.image] = atlases.size();
+				rects[tile.image] = glm::vec4(tile.x / atlasWidth, tile.y / atlasHeight,
+						image.getWidth() / atlasWidth, image.getHeight() / atlasHeight);
+			}
+
+			atlases.push_back(atlas);
+		}
+	}
+
+	if (atlases.empty())
+		return;
+
+	// packed images are dropped, atlases follow ones kept
+	std::vector<std::shared_ptr<Image>> images;
+	std::vector<uint64_t> indices(scene.images.size());
+
+	for (uint64_t i = 0; i < scene.images.size(); i++) {
+		if (atlasIndices[i].has_value())
+			continue;
+
+		indices[i] = images.size();
+		images.push_back(scene.images[i]);
+	}
+
+	for (uint64_t i = 0; i < scene.images.size(); i++) {
+		if (atlasIndices[i].has_value())
+			indices[i] = images.size() + atlasIndices[i].value();
+	}
+
+	images.insert(images.end(), atlases.begin(), atlases.end());
+
+	for (AssetLoader::Material &material : scene.materials) {
+		std::optional<uint64_t> *pIndices[3] = {
+			&material.albedoIndex,
+			&material.normalIndex,
+			&material.metallicRoughnessIndex,
+		};
+
+		glm::vec4 *pRects[3] = {
+			&material.albedoRect,
+			&material.normalRect,
+			&material.metallicRoughnessRect,
+		};
+
+		for (uint32_t slot = 0; slot < 3; slot++) {
+			if (!pIndices[slot]->has_value() || pIndices[slot]->value() >= indices.size())
+				continue;
+
+			uint64_t image = pIndices[slot]->value();
+
+			*pIndices[slot] = indices[image];
+			*pRects[slot] = rects[image];
+		}
+	}
+
+	scene.images = std::move(images);
+
+	// atlases have no file of their own, indices of sources no longer match
+	scene.imageSources.clear();
+}
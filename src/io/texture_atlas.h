@@ -0,0 +1,39 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "asset_loader.h"
+
+// images up to this size on both sides are packed, larger ones stay alone
+const uint32_t ATLAS_MAX_TILE_SIZE = 128;
+// atlases are cut at this size and shrunk to power of two covering their tiles
+const uint32_t ATLAS_MAX_SIZE = 2048;
+
+// Packs small images of scene which share format and usage into atlases, materials then address
+// their maps through rects, so pixel art scenes take a few textures and texture sets instead of
+// one per image. Tiles are power of two sized and placed at multiples of their size, levels
+// generated from atlas stay within tiles. Material shaders repeat uv within rect and keep
+// filtering half a texel off its edges. Compressed images and ones with levels already are left
+// alone, so packing goes before cooking.
+class TextureAtlas {
+private:
+	typedef struct {
+		uint64_t image;
+		uint32_t x;
+		uint32_t y;
+	} Tile;
+
+	// sorted from tallest, shelves then line up with tiles on them
+	static std::vector<std::vector<Tile>> _place(
+			const AssetLoader::Scene &scene, std::vector<uint64_t> &images);
+	static std::shared_ptr<Image> _build(
+			const AssetLoader::Scene &scene, const std::vector<Tile> &tiles);
+
+public:
+	static void pack(AssetLoader::Scene &scene, uint32_t maxTileSize = ATLAS_MAX_TILE_SIZE);
+};
+
+#endif // !TEXTURE_ATLAS_H
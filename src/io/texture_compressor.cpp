@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <job_system.h>
+
+#include "image.h"
+
+#include "texture_compressor.h"
+
+// BC7 interpolation weights of 4 bit indices
+const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static float _toLinear(float value) {
+	if (value <= 0.04045f)
+		return value / 12.92f;
+
+	return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float _toSRGB(float value) {
+	if (value <= 0.0031308f)
+		return value * 12.92f;
+
+	return 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static uint8_t _quantize(float value) {
+	return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// bits are written from least significant bit of first byte
+static void _writeBits(uint8_t *pBlock, uint32_t &offset, uint32_t value, uint32_t bitCount) {
+	for (uint32_t i = 0; i < bitCount; i++, offset++) {
+		if ((value >> i) & 1)
+			pBlock[offset / 8] |= static_cast<uint8_t>(1 << (offset % 8));
+	}
+}
+
+TextureCompressor::Level TextureCompressor::_downsample(
+		const Level &level, uint32_t channelCount, Usage usage) {
+	Level next = {};
+	next.width = std::max(level.width / 2, 1u);
+	next.height = std::max(level.height / 2, 1u);
+	next.texels.resize(static_cast<size_t>(next.width) * next.height * channelCount);
+
+	for (uint32_t y = 0; y < next.height; y++) {
+		for (uint32_t x = 0; x < next.width; x++) {
+			float sum[4] = {};
+
+			// odd edge repeats last texel
+			for (uint32_t i = 0; i < 4; i++) {
+				uint32_t srcX = std::min(x * 2 + (i & 1), level.width - 1);
+				uint32_t srcY = std::min(y * 2 + (i >> 1), level.height - 1);
+
+				size_t src = static_cast<size_t>(srcY) * level.width + srcX;
+				const float *pSrc = &level.texels[src * channelCount];
+
+				if (usage == Usage::Normal) {
+					float nx = pSrc[0] * 2.0f - 1.0f;
+					float ny = pSrc[1] * 2.0f - 1.0f;
+
+					sum[0] += nx;
+					sum[1] += ny;
+					sum[2] += std::sqrt(std::max(1.0f - nx * nx - ny * ny, 0.0f));
+					continue;
+				}
+
+				for (uint32_t c = 0; c < channelCount; c++)
+					sum[c] += pSrc[c];
+			}
+
+			float *pDst = &next.texels[(static_cast<size_t>(y) * next.width + x) * channelCount];
+
+			if (usage == Usage::Normal) {
+				float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+
+				// opposite normals cancel out, flat one stands in
+				if (length == 0.0f) {
+					pDst[0] = 0.5f;
+					pDst[1] = 0.5f;
+					continue;
+				}
+
+				pDst[0] = sum[0] / length * 0.5f + 0.5f;
+				pDst[1] = sum[1] / length * 0.5f + 0.5f;
+				continue;
+			}
+
+			for (uint32_t c = 0; c < channelCount; c++)
+				pDst[c] = sum[c] * 0.25f;
+		}
+	}
+
+	return next;
+}
+
+void TextureCompressor::_encodeBC4Block(const uint8_t *pTexels, uint32_t stride, uint8_t *pBlock) {
+	uint8_t minValue = 255;
+	uint8_t maxValue = 0;
+
+	for (uint32_t i = 0; i < 16; i++) {
+		minValue = std::min(minValue, pTexels[i * stride]);
+		maxValue = std::max(maxValue, pTexels[i * stride]);
+	}
+
+	memset(pBlock, 0, 8);
+	pBlock[0] = maxValue;
+	pBlock[1] = minValue;
+
+	// equal endpoints decode every index 0 to it
+	if (maxValue == minValue)
+		return;
+
+	// first endpoint larger selects 6 interpolated values between them
+	uint32_t palette[8] = { maxValue, minValue };
+
+	for (uint32_t i = 2; i < 8; i++)
+		palette[i] = ((8 - i) * maxValue + (i - 1) * minValue) / 7;
+
+	uint32_t offset = 16;
+
+	for (uint32_t i = 0; i < 16; i++) {
+		int32_t value = pTexels[i * stride];
+
+		uint32_t bestIndex = 0;
+		int32_t bestError = INT32_MAX;
+
+		for (uint32_t j = 0; j < 8; j++) {
+			int32_t error = std::abs(value - static_cast<int32_t>(palette[j]));
+
+			if (error < bestError) {
+				bestError = error;
+				bestIndex = j;
+			}
+		}
+
+		_writeBits(pBlock, offset, bestIndex, 3);
+	}
+}
+
+void TextureCompressor::_encodeBC7Block(const uint8_t *pTexels, uint8_t *pBlock) {
+	float mean[4] = {};
+
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t c = 0; c < 4; c++)
+			mean[c] += pTexels[i * 4 + c] / 16.0f;
+	}
+
+	float covariance[4][4] = {};
+
+	for (uint32_t i = 0; i < 16; i++) {
+		float d[4];
+
+		for (uint32_t c = 0; c < 4; c++)
+			d[c] = pTexels[i * 4 + c] - mean[c];
+
+		for (uint32_t r = 0; r < 4; r++) {
+			for (uint32_t c = 0; c < 4; c++)
+				covariance[r][c] += d[r] * d[c];
+		}
+	}
+
+	// principal axis by power iteration, converges in few steps for 4x4 matrix
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	for (uint32_t iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {};
+
+		for (uint32_t r = 0; r < 4; r++) {
+			for (uint32_t c = 0; c < 4; c++)
+				next[r] += covariance[r][c] * axis[c];
+		}
+
+		float length = std::sqrt(
+				next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+
+		if (length == 0.0f)
+			break;
+
+		for (uint32_t c = 0; c < 4; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float tMin = 0.0f;
+	float tMax = 0.0f;
+
+	for (uint32_t i = 0; i < 16; i++) {
+		float t = 0.0f;
+
+		for (uint32_t c = 0; c < 4; c++)
+			t += (pTexels[i * 4 + c] - mean[c]) * axis[c];
+
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+
+	// 7 bit endpoints with shared low bit per endpoint, the one closer to endpoint is kept
+	uint32_t endpoints[2][4];
+	uint32_t pBits[2];
+
+	for (uint32_t e = 0; e < 2; e++) {
+		float t = e == 0 ? tMin : tMax;
+		uint32_t bestError = UINT32_MAX;
+
+		for (uint32_t p = 0; p < 2; p++) {
+			uint32_t quantized[4];
+			uint32_t error = 0;
+
+			for (uint32_t c = 0; c < 4; c++) {
+				float value = std::clamp(mean[c] + axis[c] * t, 0.0f, 255.0f);
+				int32_t q = static_cast<int32_t>(std::round((value - p) / 2.0f));
+
+				quantized[c] = static_cast<uint32_t>(std::clamp(q, 0, 127));
+
+				int32_t decoded = static_cast<int32_t>(quantized[c] * 2 + p);
+				int32_t d = decoded - static_cast<int32_t>(value + 0.5f);
+				error += static_cast<uint32_t>(d * d);
+			}
+
+			if (error < bestError) {
+				bestError = error;
+				pBits[e] = p;
+				memcpy(endpoints[e], quantized, sizeof(quantized));
+			}
+		}
+	}
+
+	uint32_t palette[16][4];
+
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			uint32_t a = endpoints[0][c] * 2 + pBits[0];
+			uint32_t b = endpoints[1][c] * 2 + pBits[1];
+
+			palette[i][c] = ((64 - BC7_WEIGHTS[i]) * a + BC7_WEIGHTS[i] * b + 32) >> 6;
+		}
+	}
+
+	uint32_t indices[16];
+
+	for (uint32_t i = 0; i < 16; i++) {
+		uint32_t bestError = UINT32_MAX;
+
+		for (uint32_t j = 0; j < 16; j++) {
+			uint32_t error = 0;
+
+			for (uint32_t c = 0; c < 4; c++) {
+				int32_t d = static_cast<int32_t>(pTexels[i * 4 + c]) -
+						static_cast<int32_t>(palette[j][c]);
+				error += static_cast<uint32_t>(d * d);
+			}
+
+			if (error < bestError) {
+				bestError = error;
+				indices[i] = j;
+			}
+		}
+	}
+
+	// highest bit of first index is implied zero, endpoints are swapped to keep it so
+	if (indices[0] >= 8) {
+		for (uint32_t c = 0; c < 4; c++)
+			std::swap(endpoints[0][c], endpoints[1][c]);
+
+		std::swap(pBits[0], pBits[1]);
+
+		for (uint32_t i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(pBlock, 0, 16);
+	uint32_t offset = 0;
+
+	// mode 6 is six zero bits and one
+	_writeBits(pBlock, offset, 1 << 6, 7);
+
+	for (uint32_t c = 0; c < 4; c++) {
+		_writeBits(pBlock, offset, endpoints[0][c], 7);
+		_writeBits(pBlock, offset, endpoints[1][c], 7);
+	}
+
+	_writeBits(pBlock, offset, pBits[0], 1);
+	_writeBits(pBlock, offset, pBits[1], 1);
+
+	for (uint32_t i = 0; i < 16; i++)
+		_writeBits(pBlock, offset, indices[i], i == 0 ? 3 : 4);
+}
+
+std::shared_ptr<Image> TextureCompressor::compress(
+		const std::shared_ptr<Image> &image, Usage usage) {
+	Image::Format format = image->getFormat();
+
+	if (Image::isFormatCompressed(format) || format == Image::Format::RGBA16F ||
+			format == Image::Format::RGBA32F)
+		return image;
+
+	Image source = *image;
+
+	// alpha is stored by BC7 anyway
+	if (format == Image::Format::RGB8)
+		source.convert(Image::Format::RGBA8);
+
+	uint32_t channelCount = Image::getFormatChannelCount(source.getFormat());
+
+	Image::Format compressedFormat = Image::Format::BC7;
+
+	if (channelCount == 1)
+		compressedFormat = Image::Format::BC4;
+	else if (channelCount == 2)
+		compressedFormat = Image::Format::BC5;
+
+	if (usage == Usage::Normal && channelCount != 2)
+		usage = Usage::Linear;
+
+	if (usage == Usage::Color && channelCount != 4)
+		usage = Usage::Linear;
+
+	uint32_t width = source.getWidth();
+	uint32_t height = source.getHeight();
+
+	const std::vector<uint8_t> &data = source.getData();
+
+	std::vector<Level> levels(1);
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].texels.resize(data.size());
+
+	for (size_t i = 0; i < data.size(); i++) {
+		float value = data[i] / 255.0f;
+
+		// color is averaged in linear space, alpha stays linear
+		if (usage == Usage::Color && i % 4 != 3)
+			value = _toLinear(value);
+
+		levels[0].texels[i] = value;
+	}
+
+	while (levels.back().width > 1 || levels.back().height > 1)
+		levels.push_back(_downsample(levels.back(), channelCount, usage));
+
+	uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+	uint32_t blockSize = Image::getFormatByteSize(compressedFormat);
+
+	std::vector<uint8_t> compressed(
+			Image::getDataSize(compressedFormat, width, height, mipLevels), 0);
+
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		const Level &_level = levels[level];
+
+		std::vector<uint8_t> texels(_level.texels.size());
+
+		for (size_t i = 0; i < texels.size(); i++) {
+			float value = _level.texels[i];
+
+			if (usage == Usage::Color && i % 4 != 3)
+				value = _toSRGB(value);
+
+			texels[i] = _quantize(value);
+		}
+
+		uint32_t blocksX = (_level.width + 3) / 4;
+		uint32_t blocksY = (_level.height + 3) / 4;
+
+		uint8_t *pLevel = compressed.data() +
+				Image::getLevelOffset(compressedFormat, width, height, level);
+
+		JobSystem::parallelFor(blocksY, 1, [&](uint32_t firstRow, uint32_t lastRow) {
+			for (uint32_t blockY = firstRow; blockY < lastRow; blockY++) {
+				uint8_t block[16 * 4];
+
+				for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+					// partial blocks repeat edge texels
+					for (uint32_t i = 0; i < 16; i++) {
+						uint32_t x = std::min(blockX * 4 + (i % 4), _level.width - 1);
+						uint32_t y = std::min(blockY * 4 + (i / 4), _level.height - 1);
+
+						const uint8_t *pTexel =
+								&texels[(static_cast<size_t>(y) * _level.width + x) * channelCount];
+						memcpy(&block[i * channelCount], pTexel, channelCount);
+					}
+
+					uint8_t *pBlock =
+							pLevel + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize;
+
+					switch (compressedFormat) {
+						case Image::Format::BC4:
+							_encodeBC4Block(block, 1, pBlock);
+							break;
+						case Image::Format::BC5:
+							_encodeBC4Block(block, 2, pBlock);
+							_encodeBC4Block(block + 1, 2, pBlock + 8);
+							break;
+						default:
+							_encodeBC7Block(block, pBlock);
+							break;
+					}
+				}
+			}
+		});
+	}
+
+	std::shared_ptr<Image> result = std::make_shared<Image>(
+			width, height, compressedFormat, std::move(compressed), mipLevels);
+	result->setSrgb(usage == Usage::Color);
+
+	return result;
+}
@@ -0,0 +1,45 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "image.h"
+
+// Builds mip chains and encodes every level into block compressed format, used by cooking so
+// runtime uploads levels as they are. Color is filtered in linear space and stored as sRGB,
+// normals are renormalized per level. One channel becomes BC4, two channels BC5 and color BC7,
+// block rows are encoded as jobs.
+class TextureCompressor {
+public:
+	enum class Usage {
+		// sRGB color, alpha is linear
+		Color,
+		// xy of unit vector, z is reconstructed
+		Normal,
+		// filtered as is
+		Linear,
+	};
+
+private:
+	// channels interleaved, in [0, 1]
+	typedef struct {
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> texels;
+	} Level;
+
+	static Level _downsample(const Level &level, uint32_t channelCount, Usage usage);
+
+	// 16 texels, stride apart, into 8 bytes
+	static void _encodeBC4Block(const uint8_t *pTexels, uint32_t stride, uint8_t *pBlock);
+	// 16 RGBA texels into 16 bytes of mode 6, one subset with endpoints along principal axis
+	static void _encodeBC7Block(const uint8_t *pTexels, uint8_t *pBlock);
+
+public:
+	// compressed and floating point images are returned as they are
+	static std::shared_ptr<Image> compress(const std::shared_ptr<Image> &image, Usage usage);
+};
+
+#endif // !TEXTURE_COMPRESSOR_H
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "job_system.h"
+
+typedef struct {
+	JobSystem::Job job;
+	JobCounter *pCounter;
+} QueuedJob;
+
+struct JobQueue {
+	std::mutex mutex;
+	std::deque<QueuedJob> jobs;
+};
+
+// deque per thread index, outside threads share the one of initializing thread
+static JobQueue _queues[MAX_JOB_THREAD_COUNT];
+static std::vector<std::thread> _workers;
+static std::atomic<uint32_t> _threadCount{ 1 };
+static std::atomic<bool> _isRunning{ false };
+
+// jobs in every deque, changed under lock of deque so it never drops below zero
+static std::atomic<uint32_t> _queuedCount{ 0 };
+
+// taken under _mutex, only by workers
+static std::deque<JobSystem::Job> _backgroundJobs;
+static uint32_t _backgroundRunning = 0;
+static uint32_t _backgroundLimit = 1;
+
+// idle threads sleep on it, new jobs and finished counters wake them
+static std::mutex _mutex;
+static std::condition_variable _condition;
+static bool _isStopping = false;
+
+static thread_local uint32_t _threadIndex = 0;
+static thread_local bool _isJobThread = false;
+
+static bool _pop(QueuedJob &job) {
+	uint32_t threadCount = _threadCount.load(std::memory_order_relaxed);
+
+	// newest job of own deque is likely still in cache
+	{
+		JobQueue &queue = _queues[_threadIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// oldest jobs of others are stolen, those tend to be largest
+	for (uint32_t i = 1; i < threadCount; i++) {
+		JobQueue &queue = _queues[(_threadIndex + i) % threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void _execute(const QueuedJob &job) {
+	job.job();
+
+	if (job.pCounter == nullptr ||
+			job.pCounter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	// counter may be gone once it reaches zero, only globals are touched after it
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+	}
+
+	_condition.notify_all();
+}
+
+// under _mutex
+static bool _isBackgroundReady() {
+	return !_backgroundJobs.empty() && _backgroundRunning < _backgroundLimit;
+}
+
+static void _workerLoop(uint32_t threadIndex) {
+	_threadIndex = threadIndex;
+	_isJobThread = true;
+
+	while (true) {
+		QueuedJob job;
+
+		if (_pop(job)) {
+			_execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		// frame jobs go first, background ones are taken only once none are queued
+		if (_isBackgroundReady()) {
+			JobSystem::Job backgroundJob = std::move(_backgroundJobs.front());
+			_backgroundJobs.pop_front();
+			_backgroundRunning++;
+
+			lock.unlock();
+			backgroundJob();
+			lock.lock();
+
+			_backgroundRunning--;
+
+			// next background job may wait for a free slot
+			_condition.notify_all();
+			continue;
+		}
+
+		_condition.wait(lock, [] {
+			return _isStopping || _queuedCount.load() > 0 || _isBackgroundReady();
+		});
+
+		if (_isStopping && _queuedCount.load() == 0 && _backgroundJobs.empty())
+			return;
+	}
+}
+
+void JobSystem::run(const Job &job, JobCounter *pCounter) {
+	if (pCounter != nullptr)
+		pCounter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	if (!_isRunning.load(std::memory_order_acquire)) {
+		_execute({ job, pCounter });
+		return;
+	}
+
+	JobQueue &queue = _queues[_isJobThread ? _threadIndex : 0];
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back({ job, pCounter });
+		_queuedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// outside threads waiting on counters sleep on it too, every sleeper is woken
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+	}
+
+	_condition.notify_all();
+}
+
+void JobSystem::runBackground(const Job &job) {
+	if (!_isRunning.load(std::memory_order_acquire)) {
+		job();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_backgroundJobs.push_back(job);
+	}
+
+	_condition.notify_all();
+}
+
+void JobSystem::wait(JobCounter &counter) {
+	while (counter.pending.load(std::memory_order_acquire) > 0) {
+		QueuedJob job;
+
+		if (_isJobThread && _pop(job)) {
+			_execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_condition.wait(lock, [&counter] {
+			return counter.pending.load(std::memory_order_acquire) == 0 ||
+					(_isJobThread && _queuedCount.load() > 0);
+		});
+	}
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const RangeJob &job) {
+	if (count == 0)
+		return;
+
+	grain = std::max(grain, 1u);
+
+	// few ranges per thread even out ranges of uneven cost
+	uint32_t rangeCount = std::min((count - 1) / grain + 1, getThreadCount() * 4);
+
+	if (rangeCount == 1) {
+		job(0, count);
+		return;
+	}
+
+	JobCounter counter;
+
+	for (uint32_t i = 1; i < rangeCount; i++) {
+		uint32_t begin = static_cast<uint32_t>(uint64_t(i) * count / rangeCount);
+		uint32_t end = static_cast<uint32_t>(uint64_t(i + 1) * count / rangeCount);
+
+		run([&job, begin, end]() { job(begin, end); }, &counter);
+	}
+
+	job(0, count / rangeCount);
+	wait(counter);
+}
+
+uint32_t JobSystem::getThreadIndex() {
+	return _isJobThread ? _threadIndex : 0;
+}
+
+uint32_t JobSystem::getThreadCount() {
+	return _threadCount.load(std::memory_order_relaxed);
+}
+
+void JobSystem::initialize(uint32_t workerCount) {
+	if (_isRunning.load())
+		return;
+
+	if (workerCount == 0)
+		workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	workerCount = std::min(workerCount, MAX_JOB_THREAD_COUNT - 1);
+
+	_threadIndex = 0;
+	_isJobThread = true;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isStopping = false;
+		_backgroundLimit = std::max(workerCount / 2, 1u);
+	}
+
+	_threadCount.store(workerCount + 1);
+	_isRunning.store(true, std::memory_order_release);
+
+	for (uint32_t i = 1; i <= workerCount; i++)
+		_workers.emplace_back(_workerLoop, i);
+}
+
+void JobSystem::shutdown() {
+	if (!_isRunning.exchange(false))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isStopping = true;
+	}
+
+	_condition.notify_all();
+
+	for (std::thread &worker : _workers)
+		worker.join();
+
+	_workers.clear();
+
+	// pushed while workers were leaving
+	QueuedJob job;
+
+	while (_pop(job))
+		_execute(job);
+
+	while (!_backgroundJobs.empty()) {
+		Job backgroundJob = std::move(_backgroundJobs.front());
+		_backgroundJobs.pop_front();
+		backgroundJob();
+	}
+
+	_threadCount.store(1);
+}
@@ -0,0 +1,83 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <utility>
+
+// threads jobs run on, the one that initialized the system and every worker
+const uint32_t MAX_JOB_THREAD_COUNT = 64;
+
+// jobs run with it that are not finished yet, has to outlive them
+struct JobCounter {
+	std::atomic<uint32_t> pending{ 0 };
+};
+
+// copies share one flag, owner of a background job cancels it and job gives up at its next
+// check, result of cancelled job is whatever it had by then
+class CancelToken {
+private:
+	std::shared_ptr<std::atomic<bool>> _pCancelled = std::make_shared<std::atomic<bool>>(false);
+
+public:
+	void cancel() const {
+		_pCancelled->store(true, std::memory_order_relaxed);
+	}
+
+	bool isCancelled() const {
+		return _pCancelled->load(std::memory_order_relaxed);
+	}
+};
+
+// Engine wide pool of workers sized to the hardware. Every thread has a deque of its own, jobs
+// are pushed to and popped from its back while idle threads steal from the front of others.
+// Waiting on a counter runs queued jobs instead of blocking, so jobs may wait on jobs they run
+// themselves. Threads other than workers and the initializing one only block while waiting,
+// their jobs go to deque of the initializing thread. Without workers jobs run inline. Background
+// jobs, loads taking seconds, share one queue that only idle workers take from, at most half of
+// them at once, waits never run them, so frames stall neither on them nor for want of workers.
+class JobSystem {
+public:
+	typedef std::function<void()> Job;
+	// first and one past last index of range
+	typedef std::function<void(uint32_t, uint32_t)> RangeJob;
+
+	static void run(const Job &job, JobCounter *pCounter = nullptr);
+	static void wait(JobCounter &counter);
+
+	// oldest first, any thread
+	static void runBackground(const Job &job);
+
+	// background job whose result arrives through future, dropping future does not wait for it
+	template <typename Function>
+	static std::future<decltype(std::declval<Function>()())> async(Function &&function) {
+		typedef decltype(std::declval<Function>()()) Result;
+
+		// job has to be copyable, task is not
+		std::shared_ptr<std::packaged_task<Result()>> pTask =
+				std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+
+		std::future<Result> future = pTask->get_future();
+		runBackground([pTask]() { (*pTask)(); });
+
+		return future;
+	}
+
+	// splits count into ranges of at least grain, calling thread runs one of them
+	static void parallelFor(uint32_t count, uint32_t grain, const RangeJob &job);
+
+	// unique among threads running jobs at once, 0 for initializing thread and outside threads
+	static uint32_t getThreadIndex();
+	// workers and initializing thread
+	static uint32_t getThreadCount();
+
+	// 0 is one worker per hardware thread besides calling one
+	static void initialize(uint32_t workerCount = 0);
+	// queued jobs are finished first, later ones run inline
+	static void shutdown();
+};
+
+#endif // !JOB_SYSTEM_H
@@ -1,6 +1,14 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #define SDL_MAIN_USE_CALLBACKS
 #include <SDL3/SDL_main.h>
@@ -9,61 +17,814 @@
 #include <SDL3/SDL_error.h>
 #include <SDL3/SDL_events.h>
 #include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
 #include <SDL3/SDL_video.h>
+#include <SDL3/SDL_vulkan.h>
 
+#include "allocation_tracker.h"
+#include "batch_renderer.h"
+#include "benchmark.h"
+#include "call_player.h"
 #include "camera_controller.h"
+#include "capture_writer.h"
+#include "io/asset_loader.h"
+#include "io/cell_portal_baker.h"
 #include "io/image_loader.h"
+#include "io/light_probe_baker.h"
+#include "io/lightmap_baker.h"
+#include "io/package.h"
+#include "io/texture_atlas.h"
+#include "job_system.h"
+#include "profiler.h"
 #include "rendering/rendering_server.h"
+#include "rendering/shader_library.h"
 #include "scene.h"
+#include "stress_scene.h"
+#include "thumbnail_cache.h"
 #include "timer.h"
 
 typedef struct {
 	SDL_Window *pWindow;
 
+	// --mirror-window shows every frame in a second window too, sharing device with first one
+	SDL_Window *pMirrorWindow;
+	ObjectID mirror;
+
 	CameraController camera;
 	Timer timer;
 	Scene scene;
+
+	// --stress-scene builds it in place of a loaded scene
+	StressScene stress;
+
+	// skies decoded in background, handed to renderer once ready
+	std::vector<std::future<std::shared_ptr<Image>>> skyLoads;
+	// sky dropped later replaces skies still loading
+	CancelToken skyCancel;
+
+	// F8 captures, encoded in background
+	CaptureWriter captures;
+	uint32_t captureCount;
+
+	// --frame-stats prints a summary every second
+	bool isPrintingFrameStats;
+	float frameStatsTime;
+
+	// heap allocations of every thread, at last iteration and from it to the one before
+	AllocationStats allocations;
+	AllocationStats frameAllocations;
+
+	// --startup-stats prints steps of initialization once first frame is drawn
+	bool isPrintingStartupStats;
+	// performance counter at begin of app init
+	uint64_t startupCounter;
+
+	// --benchmark flies camera path instead of taking input and quits once done
+	Benchmark benchmark;
+	bool isBenchmarking;
+	// scene is loaded anew with options of first load for every run after it
+	std::function<void()> benchmarkReload;
+
+	// --replay plays recorded calls back in place of scene and input, quits once log ends
+	CallPlayer replay;
+	bool isReplaying;
+
+	// --render-jobs renders list of jobs without window and quits once they are written
+	BatchRenderer batch;
+	bool isBatchRendering;
+
+	// --thumbnails renders thumbnails of assets missing from cache the same way
+	ThumbnailCache thumbnails;
+	bool isThumbnailing;
+
+	// --on-demand draws only once something changed, for viewers left open
+	bool isOnDemand;
 } AppState;
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+// of batch renders, --render-size <width> <height> overrides it
+const uint32_t RENDER_WIDTH = 512;
+const uint32_t RENDER_HEIGHT = 512;
+
+// sleep of frame loop with nothing to draw, events end it early
+const int32_t IDLE_WAIT_MILLISECONDS = 100;
+// decoding scene or sky is polled more often meanwhile
+const int32_t LOADING_WAIT_MILLISECONDS = 5;
+
+// comma separated counts, list ends at first one which is not
+static std::vector<uint64_t> _parseCounts(const char *pList) {
+	std::vector<uint64_t> values;
+	const char *pCursor = pList;
+
+	while (*pCursor != '\0') {
+		char *pEnd = nullptr;
+		unsigned long long value = strtoull(pCursor, &pEnd, 10);
+
+		if (pEnd == pCursor || value == 0)
+			break;
+
+		values.push_back(value);
+		pCursor = *pEnd == ',' ? pEnd + 1 : pEnd;
+	}
+
+	return values;
+}
+
+static bool _isIdle(const AppState *pState) {
+	// benchmarks, replays and batch renders need every frame
+	if (pState->isBenchmarking || pState->isReplaying || pState->isBatchRendering ||
+			pState->isThumbnailing)
+		return false;
+
+	// nothing of window is seen
+	SDL_WindowFlags hiddenFlags = SDL_WINDOW_MINIMIZED | SDL_WINDOW_OCCLUDED | SDL_WINDOW_HIDDEN;
+
+	if ((SDL_GetWindowFlags(pState->pWindow) & hiddenFlags) != 0)
+		return true;
+
+	return pState->isOnDemand && !RS::getSingleton().isRedrawNeeded();
+}
+
+static void _printStartupStats(uint64_t startupCounter) {
+	StartupStats stats = RS::getSingleton().getStartupStats();
+
+	float milliseconds = static_cast<float>(SDL_GetPerformanceCounter() - startupCounter) *
+			1000.0f / static_cast<float>(SDL_GetPerformanceFrequency());
+
+	SDL_Log("startup: %.2f ms to first frame, instance %.2f ms, device %.2f ms, resources %.2f "
+			"ms, environment %.2f ms, pipeline wait %.2f ms",
+			milliseconds, stats.instanceMilliseconds, stats.deviceMilliseconds,
+			stats.resourcesMilliseconds, stats.environmentMilliseconds,
+			stats.pipelineWaitMilliseconds);
+}
+
+static void _printFrameStats(float deltaTime, const AllocationStats &allocations) {
+	FrameStats stats = RS::getSingleton().getFrameStats();
+
+	SDL_Log("frame: %.2f ms, %u draws, %u instances, %llu triangles, %u pipeline binds, %u set "
+			"binds, %u push constants",
+			deltaTime * 1000.0f, stats.drawCount, stats.instanceCount,
+			static_cast<unsigned long long>(stats.triangleCount), stats.pipelineBindCount,
+			stats.setBindCount, stats.pushConstantCount);
+	SDL_Log("frame: %u of %u instances culled, %llu KiB uploaded, %u directional, %u point, %u "
+			"shadowed lights",
+			stats.culledInstanceCount, stats.submittedInstanceCount,
+			static_cast<unsigned long long>(stats.uploadedBytes / 1024),
+			stats.directionalLightCount, stats.pointLightCount, stats.shadowedLightCount);
+
+	FramePacingStats pacing = RS::getSingleton().getFramePacingStats();
+
+	SDL_Log("pacing: %.2f ms (median %.2f ms), fence wait %.2f ms, acquire %.2f ms, submit at "
+			"%.2f ms, present at %.2f ms, shown at %.2f ms, %llu hitches",
+			pacing.last.milliseconds, pacing.medianMilliseconds,
+			pacing.last.fenceWaitMilliseconds, pacing.last.acquireMilliseconds,
+			pacing.last.submitOffset, pacing.last.presentOffset, pacing.last.displayOffset,
+			static_cast<unsigned long long>(pacing.hitchCount));
+
+	FrameBoundStats bounds = RS::getSingleton().getFrameBoundStats();
+	const uint32_t *pCounts = bounds.counts;
+
+	SDL_Log("bound: %s (%u cpu, %u gpu, %u present of %u frames), cpu %.2f ms, gpu %.2f ms, "
+			"fence wait %.2f ms, acquire %.2f ms, present %.2f ms",
+			BoundAnalyzer::getName(bounds.bound), pCounts[static_cast<size_t>(FrameBound::Cpu)],
+			pCounts[static_cast<size_t>(FrameBound::Gpu)],
+			pCounts[static_cast<size_t>(FrameBound::Present)], bounds.sampleCount,
+			bounds.averageCpuMilliseconds, bounds.averageGpuMilliseconds,
+			bounds.averageFenceWaitMilliseconds, bounds.averageAcquireMilliseconds,
+			bounds.averagePresentMilliseconds);
+
+	// empty unless --pipeline-stats enabled them
+	for (const PipelineStats &pass : RS::getSingleton().getPipelineStats())
+		SDL_Log("pipeline: %s, %llu vertex invocations, %llu primitives, %llu fragment "
+				"invocations",
+				pass.name.c_str(), static_cast<unsigned long long>(pass.vertexInvocations),
+				static_cast<unsigned long long>(pass.clippingPrimitives),
+				static_cast<unsigned long long>(pass.fragmentInvocations));
+
+	vk::Extent2D extent = RS::getSingleton().getRenderExtent();
+
+	SDL_Log("resolution: %ux%u, render scale %.2f, dynamic scale %.2f", extent.width,
+			extent.height, RS::getSingleton().getRenderScale(),
+			RS::getSingleton().getDynamicScale());
+
+	// steady frames should read zero, zones that allocate are listed by F3
+	if (AllocationTracker::isAvailable())
+		SDL_Log("heap: %llu allocations, %.1f KiB",
+				static_cast<unsigned long long>(allocations.count),
+				static_cast<double>(allocations.bytes) / 1024.0);
+}
+
+// F6 starts and stops tracing to it
+static const char *_traceFile = "trace.json";
+
+// F7 starts and stops recording camera to it, benchmark plays it back
+static const char *_cameraPathFile = "camera_path.txt";
+
+// F8 captures frame to it, numbered, --capture-format exr writes linear EXR instead
+static const char *_captureFormat = "png";
+
 int SDL_AppInit(void **appstate, int argc, char **argv) {
+	uint64_t startupCounter = SDL_GetPerformanceCounter();
+
+	// cooking compresses textures on it too
+	JobSystem::initialize();
+
+	// offline tools, app exits once they are done
+	for (int i = 1; i < argc; i++) {
+		// --cook <source> <destination> [--texture-atlas] [--lightmaps] [--light-probes]
+		// [--derived-tangents] [--pvs] [--max-texture-size <size>]
+		if (strcmp("--cook", argv[i]) == 0 && i < argc - 2) {
+			bool isAtlased = false;
+			bool isProbed = false;
+			bool isLightmapped = false;
+			bool isTangentDerived = false;
+			bool isPvsBaked = false;
+
+			for (int j = i + 3; j < argc; j++) {
+				isAtlased = isAtlased || strcmp("--texture-atlas", argv[j]) == 0;
+				isProbed = isProbed || strcmp("--light-probes", argv[j]) == 0;
+				isLightmapped = isLightmapped || strcmp("--lightmaps", argv[j]) == 0;
+				isTangentDerived = isTangentDerived || strcmp("--derived-tangents", argv[j]) == 0;
+				isPvsBaked = isPvsBaked || strcmp("--pvs", argv[j]) == 0;
+
+				// cooked scene keeps images resampled to it, loads skip decoding full size
+				if (strcmp("--max-texture-size", argv[j]) == 0 && j < argc - 1) {
+					AssetLoader::setMaxImageSize(
+							static_cast<uint32_t>(std::max(atoi(argv[j + 1]), 0)));
+				}
+			}
+
+			AssetLoader::Scene scene = AssetLoader::loadGltf(argv[i + 1], true, isTangentDerived);
+
+			// atlases are compressed along with other images
+			if (isAtlased)
+				TextureAtlas::pack(scene);
+
+			if (isLightmapped)
+				LightmapBaker::bake(scene);
+
+			// baked once here, loading cooked scene then skips it
+			if (isProbed)
+				scene.lightProbes = LightProbeBaker::bake(scene);
+
+			// graph is cooked either way, set only when asked for
+			scene.cellPortals = CellPortalBaker::build(scene);
+
+			if (isPvsBaked)
+				CellPortalBaker::bake(scene.cellPortals);
+
+			return AssetLoader::cook(scene, argv[i + 2]) ? 1 : -1;
+		}
+
+		// --scan <file>, summary of glTF scene without loading it
+		if (strcmp("--scan", argv[i]) == 0 && i < argc - 1) {
+			std::optional<AssetLoader::SceneInfo> info = AssetLoader::scanGltf(argv[i + 1]);
+
+			if (!info.has_value())
+				return -1;
+
+			SDL_Log("%u meshes, %u primitives, %u instances, %u materials, %u textures",
+					info->meshCount, info->primitiveCount, info->meshInstanceCount,
+					info->materialCount, info->textureCount);
+			SDL_Log("%llu vertices, %llu triangles, %llu drawn, %u images of %.2f MB",
+					static_cast<unsigned long long>(info->vertexCount),
+					static_cast<unsigned long long>(info->triangleCount),
+					static_cast<unsigned long long>(info->instancedTriangleCount), info->imageCount,
+					static_cast<double>(info->imageByteCount) / (1024.0 * 1024.0));
+
+			if (info->hasBounds) {
+				SDL_Log("bounds (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f)", info->bounds.min.x,
+						info->bounds.min.y, info->bounds.min.z, info->bounds.max.x,
+						info->bounds.max.y, info->bounds.max.z);
+			}
+
+			return 1;
+		}
+
+		// --pack <directory> <destination>
+		if (strcmp("--pack", argv[i]) == 0 && i < argc - 2)
+			return Package::create(argv[i + 1], argv[i + 2]) ? 1 : -1;
+	}
+
+	// --trace <file>, startup is traced too
+	for (int i = 1; i < argc; i++) {
+		if (strcmp("--trace", argv[i]) == 0 && i < argc - 1) {
+			_traceFile = argv[i + 1];
+			Profiler::traceBegin(_traceFile);
+		}
+	}
+
+	// --shader-hot-reload <source root>, before renderer builds its pipelines
+	for (int i = 1; i < argc; i++) {
+		if (strcmp("--shader-hot-reload", argv[i]) == 0 && i < argc - 1)
+			ShaderLibrary::enableHotReload(argv[i + 1]);
+	}
+
+	const char *pUploadBenchmark = nullptr;
+	UploadBenchmarkSettings uploadSettings;
+
+	for (int i = 1; i < argc; i++) {
+		// --upload-benchmark <output> [--upload-count <count>] [--upload-texture-count <count>]
+		// [--upload-sizes <bytes,...>] [--upload-texture-sizes <side,...>]
+		if (strcmp("--upload-benchmark", argv[i]) == 0 && i < argc - 1)
+			pUploadBenchmark = argv[i + 1];
+
+		if (strcmp("--upload-count", argv[i]) == 0 && i < argc - 1)
+			uploadSettings.count = std::max(static_cast<uint32_t>(atoi(argv[i + 1])), 1u);
+
+		if (strcmp("--upload-texture-count", argv[i]) == 0 && i < argc - 1)
+			uploadSettings.textureCount = std::max(static_cast<uint32_t>(atoi(argv[i + 1])), 1u);
+
+		if (strcmp("--upload-sizes", argv[i]) == 0 && i < argc - 1)
+			uploadSettings.bufferSizes = _parseCounts(argv[i + 1]);
+
+		if (strcmp("--upload-texture-sizes", argv[i]) == 0 && i < argc - 1) {
+			uploadSettings.textureSizes.clear();
+
+			for (uint64_t side : _parseCounts(argv[i + 1]))
+				uploadSettings.textureSizes.push_back(static_cast<uint32_t>(side));
+		}
+	}
+
+	// device comes up headless, app exits once result is written
+	if (pUploadBenchmark != nullptr) {
+		RS::getSingleton().initialize(argc, argv);
+		RS::getSingleton().headlessInit(RENDER_WIDTH, RENDER_HEIGHT);
+
+		std::vector<UploadBenchmarkCase> cases = RS::getSingleton().measureUploads(uploadSettings);
+		UploadBenchmark::log(cases);
+
+		bool isWritten = UploadBenchmark::write(pUploadBenchmark, cases);
+		RS::getSingleton().finish();
+
+		return isWritten ? 1 : -1;
+	}
+
+	const char *pRenderJobs = nullptr;
+	uint32_t renderWidth = RENDER_WIDTH;
+	uint32_t renderHeight = RENDER_HEIGHT;
+
+	for (int i = 1; i < argc; i++) {
+		// --render-jobs <file> [--render-size <width> <height>]
+		if (strcmp("--render-jobs", argv[i]) == 0 && i < argc - 1)
+			pRenderJobs = argv[i + 1];
+
+		if (strcmp("--render-size", argv[i]) == 0 && i < argc - 2) {
+			renderWidth = std::max(static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10)), 1u);
+			renderHeight = std::max(static_cast<uint32_t>(strtoul(argv[i + 2], nullptr, 10)), 1u);
+		}
+	}
+
+	// --thumbnails <file>, images are as large as largest job asks for
+	const char *pThumbnailJobs = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp("--thumbnails", argv[i]) == 0 && i < argc - 1)
+			pThumbnailJobs = argv[i + 1];
+	}
+
+	if (pThumbnailJobs != nullptr) {
+		std::vector<ThumbnailJob> jobs;
+
+		if (!ThumbnailCache::loadJobs(pThumbnailJobs, jobs))
+			return -1;
+
+		uint32_t size = ThumbnailCache::getRenderSize(jobs);
+
+		RS::getSingleton().initialize(argc, argv);
+		RS::getSingleton().headlessInit(size, size);
+		AssetLoader::setMaxImageSize(RS::getSingleton().getQuality().maxTextureSize);
+
+		AppState *pState = new AppState;
+		pState->pWindow = nullptr;
+		pState->pMirrorWindow = nullptr;
+		pState->captureCount = 0;
+		pState->isPrintingFrameStats = false;
+		pState->frameStatsTime = 0.0f;
+		pState->isPrintingStartupStats = false;
+		pState->startupCounter = startupCounter;
+		pState->isBenchmarking = false;
+		pState->isReplaying = false;
+		pState->isBatchRendering = false;
+		pState->isThumbnailing = true;
+		pState->isOnDemand = false;
+
+		appstate[0] = reinterpret_cast<void *>(pState);
+
+		return pState->thumbnails.initialize(jobs) ? 0 : -1;
+	}
+
+	if (pRenderJobs != nullptr) {
+		std::vector<RenderJob> jobs;
+
+		if (!BatchRenderer::loadJobs(pRenderJobs, jobs))
+			return -1;
+
+		// device comes up headless, no display is needed
+		RS::getSingleton().initialize(argc, argv);
+		RS::getSingleton().headlessInit(renderWidth, renderHeight);
+		AssetLoader::setMaxImageSize(RS::getSingleton().getQuality().maxTextureSize);
+
+		AppState *pState = new AppState;
+		pState->pWindow = nullptr;
+		pState->captureCount = 0;
+		pState->isPrintingFrameStats = false;
+		pState->frameStatsTime = 0.0f;
+		pState->isPrintingStartupStats = false;
+		pState->startupCounter = startupCounter;
+		pState->isBenchmarking = false;
+		pState->isReplaying = false;
+		pState->isBatchRendering = true;
+		pState->isThumbnailing = false;
+		pState->isOnDemand = false;
+
+		appstate[0] = reinterpret_cast<void *>(pState);
+
+		return pState->batch.initialize(jobs) ? 0 : -1;
+	}
+
+	// loader is loaded before instance and window race for it
+	if (!SDL_InitSubSystem(SDL_INIT_VIDEO) || !SDL_Vulkan_LoadLibrary(nullptr)) {
+		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "%s", SDL_GetError());
+		return -1;
+	}
+
+	// instance comes up on a worker while window is created, device needs surface of window
+	std::future<void> initialization = std::async(
+			std::launch::async, [argc, argv]() { RS::getSingleton().initialize(argc, argv); });
+
 	SDL_WindowFlags flags = SDL_WINDOW_RESIZABLE | SDL_WINDOW_VULKAN;
 	SDL_Window *pWindow = SDL_CreateWindow("Hayaku Engine", WIDTH, HEIGHT, flags);
 
+	initialization.get();
+
+	// window holds loader on its own
+	SDL_Vulkan_UnloadLibrary();
+
 	if (pWindow == nullptr) {
 		SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION, "%s", SDL_GetError());
 		return -1;
 	}
 
-	RS::getSingleton().initialize(argc, argv);
 	RS::getSingleton().windowInit(pWindow);
 
+	// scenes load at size quality asks for, see QualitySettings::maxTextureSize
+	AssetLoader::setMaxImageSize(RS::getSingleton().getQuality().maxTextureSize);
+
 	AppState *pState = new AppState;
 	pState->pWindow = pWindow;
+	pState->pMirrorWindow = nullptr;
+	pState->mirror = NULL_HANDLE;
+	pState->captureCount = 0;
+	pState->isPrintingFrameStats = false;
+	pState->frameStatsTime = 0.0f;
+	pState->isPrintingStartupStats = false;
+	pState->startupCounter = startupCounter;
+	pState->isBenchmarking = false;
+	pState->isReplaying = false;
+	pState->isBatchRendering = false;
+	pState->isThumbnailing = false;
+	pState->isOnDemand = false;
+
+	appstate[0] = reinterpret_cast<void *>(pState);
+
+	const char *pScene = nullptr;
+	bool isStaticBatched = false;
+	bool isAtlased = false;
+	bool isProbed = false;
+	bool isLightmapped = false;
+	bool isTangentDerived = false;
+
+	const char *pBenchmarkScene = nullptr;
+	const char *pBenchmarkOutput = "benchmark.json";
+	uint32_t benchmarkFrames = 1000;
+	uint32_t benchmarkRuns = 1;
+	const char *pBaseline = nullptr;
+	float regressionThreshold = BENCHMARK_DEFAULT_THRESHOLD;
+
+	const char *pReplay = nullptr;
+	bool isReplayTimed = false;
+	bool isReplayBenchmarked = false;
+
+	bool isStress = false;
+	bool isStressBenchmarked = false;
+	StressSceneSettings stressSettings;
 
 	for (int i = 1; i < argc; i++) {
+		if (strcmp("--frame-stats", argv[i]) == 0)
+			pState->isPrintingFrameStats = true;
+
+		if (strcmp("--on-demand", argv[i]) == 0)
+			pState->isOnDemand = true;
+
+		if (strcmp("--startup-stats", argv[i]) == 0)
+			pState->isPrintingStartupStats = true;
+
+		// counted per pass, printed along with --frame-stats
+		if (strcmp("--pipeline-stats", argv[i]) == 0 &&
+				!RS::getSingleton().setPipelineStatistics(true))
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Pipeline statistics not supported!");
+
+		if (strcmp("--mirror-window", argv[i]) == 0 && pState->pMirrorWindow == nullptr) {
+			pState->pMirrorWindow = SDL_CreateWindow("Hayaku Engine Mirror", WIDTH, HEIGHT, flags);
+
+			if (pState->pMirrorWindow != nullptr)
+				pState->mirror = RS::getSingleton().windowAdd(pState->pMirrorWindow);
+		}
+
+		// --capture-format <png|exr>
+		if (strcmp("--capture-format", argv[i]) == 0 && i < argc - 1)
+			_captureFormat = argv[i + 1];
+
 		// --scene <path>
-		if (strcmp("--scene", argv[i]) == 0 && i < argc - 1) {
-			const char *pFile = argv[i + 1];
-			pState->scene.load(pFile);
+		if (strcmp("--scene", argv[i]) == 0 && i < argc - 1)
+			pScene = argv[i + 1];
+
+		// merges geometry drawn once, for levels built of unique pieces
+		if (strcmp("--static-batching", argv[i]) == 0)
+			isStaticBatched = true;
+
+		// packs small textures of same format, for pixel art scenes
+		if (strcmp("--texture-atlas", argv[i]) == 0)
+			isAtlased = true;
+
+		// bakes sky visibility probes, for interiors lit by sky
+		if (strcmp("--light-probes", argv[i]) == 0)
+			isProbed = true;
+
+		// bakes lights into meshes drawn once, for static levels
+		if (strcmp("--lightmaps", argv[i]) == 0)
+			isLightmapped = true;
+
+		// derives tangents of normal maps per pixel, for scenes limited by vertex fetch or load
+		if (strcmp("--derived-tangents", argv[i]) == 0)
+			isTangentDerived = true;
+
+		// watches files of loaded scenes and updates what changed in place, for asset iteration
+		if (strcmp("--hot-reload", argv[i]) == 0)
+			pState->scene.setHotReload(true);
+
+		// adapts exposure to scene, for scenes going between interiors and sky
+		if (strcmp("--auto-exposure", argv[i]) == 0)
+			RS::getSingleton().setAutoExposure(true);
+
+		// bakes tonemap curve into a lookup volume, for low end devices at high resolutions
+		if (strcmp("--tonemap-lut", argv[i]) == 0)
+			RS::getSingleton().setTonemapLut(true);
+
+		// --camera-path <file>
+		if (strcmp("--camera-path", argv[i]) == 0 && i < argc - 1)
+			_cameraPathFile = argv[i + 1];
+
+		// --benchmark <scene> [--frames <count>] [--benchmark-output <file>]
+		if (strcmp("--benchmark", argv[i]) == 0 && i < argc - 1)
+			pBenchmarkScene = argv[i + 1];
+
+		if (strcmp("--frames", argv[i]) == 0 && i < argc - 1)
+			benchmarkFrames = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+
+		if (strcmp("--benchmark-output", argv[i]) == 0 && i < argc - 1)
+			pBenchmarkOutput = argv[i + 1];
+
+		// --runs <count> [--baseline <file>] [--regression-threshold <percent>], result of an
+		// earlier benchmark is compared with and run fails once something got slower
+		if (strcmp("--runs", argv[i]) == 0 && i < argc - 1)
+			benchmarkRuns = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+
+		if (strcmp("--baseline", argv[i]) == 0 && i < argc - 1)
+			pBaseline = argv[i + 1];
+
+		if (strcmp("--regression-threshold", argv[i]) == 0 && i < argc - 1)
+			regressionThreshold = static_cast<float>(atof(argv[i + 1])) / 100.0f;
+
+		// --replay <file> [--replay-timing], log of a session run with --record-calls
+		if (strcmp("--replay", argv[i]) == 0 && i < argc - 1)
+			pReplay = argv[i + 1];
+
+		if (strcmp("--replay-timing", argv[i]) == 0)
+			isReplayTimed = true;
+
+		// --benchmark-replay <file> [--benchmark-output <file>], every frame of log is measured
+		if (strcmp("--benchmark-replay", argv[i]) == 0 && i < argc - 1) {
+			pReplay = argv[i + 1];
+			isReplayBenchmarked = true;
+		}
+
+		// --stress-scene [--stress-meshes <count>] [--stress-instances <count>]
+		// [--stress-materials <count>] [--stress-textures <count>] [--stress-point-lights <count>]
+		// [--stress-directional-lights <count>] [--stress-seed <seed>], synthetic scene in place
+		// of --scene, for scaling tests
+		if (strcmp("--stress-scene", argv[i]) == 0)
+			isStress = true;
+
+		// --stress-benchmark [--frames <count>] [--benchmark-output <file>], measures stress
+		// scene from above instead of flying camera path through a file
+		if (strcmp("--stress-benchmark", argv[i]) == 0) {
+			isStress = true;
+			isStressBenchmarked = true;
+		}
+
+		if (i < argc - 1) {
+			uint32_t value = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+
+			if (strcmp("--stress-meshes", argv[i]) == 0)
+				stressSettings.meshCount = value;
+
+			if (strcmp("--stress-instances", argv[i]) == 0)
+				stressSettings.instanceCount = value;
+
+			if (strcmp("--stress-materials", argv[i]) == 0)
+				stressSettings.materialCount = value;
+
+			if (strcmp("--stress-textures", argv[i]) == 0)
+				stressSettings.textureCount = value;
+
+			if (strcmp("--stress-point-lights", argv[i]) == 0)
+				stressSettings.pointLightCount = value;
+
+			if (strcmp("--stress-directional-lights", argv[i]) == 0)
+				stressSettings.directionalLightCount = value;
+
+			if (strcmp("--stress-seed", argv[i]) == 0)
+				stressSettings.seed = value;
 		}
 	}
 
-	appstate[0] = reinterpret_cast<void *>(pState);
+	// log creates everything it draws, no scene is loaded
+	if (pReplay != nullptr) {
+		if (!pState->replay.load(pReplay, isReplayTimed))
+			return -1;
+
+		pState->isReplaying = true;
+
+		// creates of recorded session are replayed within its frames, they are measured too
+		if (isReplayBenchmarked) {
+			if (!pState->benchmark.initialize(pReplay, nullptr, pState->replay.getFrameCount(),
+						pBenchmarkOutput, 0))
+				return -1;
+
+			if (pBaseline != nullptr &&
+					!pState->benchmark.setBaseline(pBaseline, regressionThreshold))
+				return -1;
+
+			pState->isBenchmarking = true;
+		}
+
+		return 0;
+	}
+
+	// built at once through renderer, no file is loaded
+	if (isStress) {
+		pState->stress.build(stressSettings);
+
+		glm::vec3 translation;
+		glm::vec2 rotation;
+		pState->stress.getCameraPose(translation, rotation);
+		pState->camera.setPose(translation, rotation);
+
+		if (isStressBenchmarked) {
+			// camera stays where it was put, results are named by counts
+			std::string name = StressScene::getName(stressSettings);
+
+			if (!pState->benchmark.initialize(
+						name.c_str(), nullptr, benchmarkFrames, pBenchmarkOutput))
+				return -1;
+
+			if (pBaseline != nullptr &&
+					!pState->benchmark.setBaseline(pBaseline, regressionThreshold))
+				return -1;
+
+			pState->benchmark.setRunCount(benchmarkRuns);
+			pState->isBenchmarking = true;
+
+			pState->benchmarkReload = [=]() { pState->stress.build(stressSettings); };
+		}
+
+		return 0;
+	}
+
+	if (pBenchmarkScene != nullptr) {
+		if (!pState->benchmark.initialize(
+					pBenchmarkScene, _cameraPathFile, benchmarkFrames, pBenchmarkOutput))
+			return -1;
+
+		if (pBaseline != nullptr && !pState->benchmark.setBaseline(pBaseline, regressionThreshold))
+			return -1;
+
+		pState->benchmark.setRunCount(benchmarkRuns);
+		pState->isBenchmarking = true;
+		pScene = pBenchmarkScene;
+
+		// last reference frees cached resources, so every run loads from disk
+		std::string path = pBenchmarkScene;
+
+		pState->benchmarkReload = [=]() {
+			pState->scene.clear();
+			pState->scene.load(
+					path, isStaticBatched, isAtlased, isProbed, isLightmapped, isTangentDerived);
+		};
+	}
+
+	if (pScene != nullptr)
+		pState->scene.load(
+				pScene, isStaticBatched, isAtlased, isProbed, isLightmapped, isTangentDerived);
+
 	return 0;
 }
 
 int SDL_AppIterate(void *appstate) {
 	AppState *pState = reinterpret_cast<AppState *>(appstate);
 
+	// events handled in between count toward frame before
+	AllocationStats allocations = AllocationTracker::getTotal();
+	pState->frameAllocations.count = allocations.count - pState->allocations.count;
+	pState->frameAllocations.bytes = allocations.bytes - pState->allocations.bytes;
+	pState->allocations = allocations;
+
+	// with low latency, input is sampled as late as GPU allows, with frame rate limit as late
+	// as deadline of frame allows
+	RS::getSingleton().frameWait();
+
 	pState->timer.tick();
 
 	float deltaTime = pState->timer.deltaTime();
-	pState->camera.update(deltaTime);
+
+	if (pState->isBatchRendering)
+		pState->batch.frameBegin(pState->scene, pState->camera);
+	else if (pState->isThumbnailing)
+		pState->thumbnails.frameBegin(pState->scene, pState->camera);
+	else if (pState->isBenchmarking)
+		pState->benchmark.frameBegin(pState->camera);
+	else if (!pState->isReplaying)
+		pState->camera.update(deltaTime);
+
+	// benchmark of replay keeps drawing last frame of log until it has measured as many
+	if (pState->isReplaying && !pState->replay.frameBegin() && !pState->isBenchmarking)
+		return 1;
+
+	for (size_t i = 0; i < pState->skyLoads.size();) {
+		std::future<std::shared_ptr<Image>> &skyLoad = pState->skyLoads[i];
+
+		if (skyLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+
+		std::shared_ptr<Image> image = skyLoad.get();
+
+		if (image != nullptr)
+			RS::getSingleton().environmentSkyUpdate(image);
+
+		pState->skyLoads.erase(pState->skyLoads.begin() + i);
+	}
+
+	pState->scene.animate(deltaTime, pState->camera.getTransform());
+	pState->scene.update();
+
+	if (_isIdle(pState)) {
+		bool isLoading = pState->scene.isLoading() || !pState->skyLoads.empty();
+
+		// returns early once an event is queued, it is handled before next iteration
+		SDL_WaitEventTimeout(
+				nullptr, isLoading ? LOADING_WAIT_MILLISECONDS : IDLE_WAIT_MILLISECONDS);
+
+		Profiler::frameEnd();
+		return 0;
+	}
 
 	RS::getSingleton().draw();
+	pState->captures.collect();
+
+	if (pState->isPrintingStartupStats) {
+		_printStartupStats(pState->startupCounter);
+		pState->isPrintingStartupStats = false;
+	}
+
+	if (pState->isBenchmarking && !pState->benchmark.frameEnd(pState->scene.isLoading()))
+		return pState->benchmark.isWritten() && !pState->benchmark.isRegressed() ? 1 : -1;
+
+	if (pState->isBenchmarking && pState->benchmark.takeReload())
+		pState->benchmarkReload();
+
+	if (pState->isBatchRendering && !pState->batch.frameEnd(pState->scene.isLoading()))
+		return pState->batch.isWritten() ? 1 : -1;
+
+	if (pState->isThumbnailing && !pState->thumbnails.frameEnd(pState->scene.isLoading()))
+		return pState->thumbnails.isWritten() ? 1 : -1;
+
+	if (pState->isPrintingFrameStats) {
+		pState->frameStatsTime += deltaTime;
+
+		if (pState->frameStatsTime >= 1.0f) {
+			_printFrameStats(deltaTime, pState->frameAllocations);
+			pState->frameStatsTime = 0.0f;
+		}
+	}
+
+	// zones of every thread recorded since last frame end up in this one
+	Profiler::frameEnd();
 
 	return 0;
 }
@@ -74,6 +835,32 @@ int SDL_AppEvent(void *appstate, const SDL_Event *event) {
 	if (event->type == SDL_EVENT_QUIT)
 		return 1;
 
+	// contents of uncovered window are gone on some platforms
+	if (event->type == SDL_EVENT_WINDOW_EXPOSED) {
+		RS::getSingleton().requestRedraw();
+		return 0;
+	}
+
+	bool isMirrorEvent = pState->pMirrorWindow != nullptr &&
+			event->type >= SDL_EVENT_WINDOW_FIRST && event->type <= SDL_EVENT_WINDOW_LAST &&
+			event->window.windowID == SDL_GetWindowID(pState->pMirrorWindow);
+
+	if (event->type == SDL_EVENT_WINDOW_RESIZED && isMirrorEvent) {
+		int width, height;
+		SDL_GetWindowSizeInPixels(pState->pMirrorWindow, &width, &height);
+		RS::getSingleton().windowSetSize(pState->mirror, width, height);
+		return 0;
+	}
+
+	// closing mirror leaves first window running, it is hidden until its surface is destroyed
+	if (event->type == SDL_EVENT_WINDOW_CLOSE_REQUESTED && isMirrorEvent) {
+		RS::getSingleton().windowRemove(pState->mirror);
+		pState->mirror = NULL_HANDLE;
+
+		SDL_HideWindow(pState->pMirrorWindow);
+		return 0;
+	}
+
 	if (event->type == SDL_EVENT_WINDOW_RESIZED) {
 		int width, height;
 		SDL_GetWindowSizeInPixels(pState->pWindow, &width, &height);
@@ -84,13 +871,22 @@ int SDL_AppEvent(void *appstate, const SDL_Event *event) {
 	if (event->type == SDL_EVENT_DROP_FILE) {
 		const char *pFile = event->drop.data;
 
-		if (ImageLoader::isImage(pFile)) {
-			std::shared_ptr<Image> image = ImageLoader::loadFromFile(pFile);
-			RS::getSingleton().environmentSkyUpdate(image);
+		// only start of file is read, scenes of gigabytes are not loaded twice
+		ImageLoader::Type type = ImageLoader::probe(pFile);
+
+		if (type != ImageLoader::Type::Unknown) {
+			// futures of replaced skies are dropped without waiting for them
+			pState->skyCancel.cancel();
+			pState->skyCancel = CancelToken();
+			pState->skyLoads.clear();
+
+			// decoding large HDRI takes seconds, frames keep rendering meanwhile
+			pState->skyLoads.push_back(
+					ImageLoader::loadFromFileAsync(pFile, type, pState->skyCancel));
 			return 0;
 		}
 
-		pState->scene.clear();
+		// previous scene is freed, new one streams in over following frames
 		pState->scene.load(pFile);
 		return 0;
 	}
@@ -100,11 +896,189 @@ int SDL_AppEvent(void *appstate, const SDL_Event *event) {
 		return 0;
 	}
 
+	if (event->type == SDL_EVENT_KEY_DOWN && event->key.keysym.sym == SDLK_F3) {
+		DrawStats depth = RS::getSingleton().getDepthDrawStats();
+		DrawStats material = RS::getSingleton().getMaterialDrawStats();
+
+		SDL_Log("depth: %u draws (%u instances), %u mesh binds (%u skipped)", depth.drawCount,
+				depth.instanceCount, depth.meshBindCount, depth.meshBindSkipCount);
+		SDL_Log("material: %u draws (%u instances), %u mesh binds (%u skipped), %u material "
+				"binds (%u skipped), %u pipeline binds",
+				material.drawCount, material.instanceCount, material.meshBindCount,
+				material.meshBindSkipCount, material.materialBindCount,
+				material.materialBindSkipCount, material.pipelineBindCount);
+
+		_printFrameStats(pState->timer.deltaTime(), pState->frameAllocations);
+
+		CullStats cull = RS::getSingleton().getCullStats();
+
+		SDL_Log("gpu culling: %u drawn, %u frustum culled, %u occlusion culled, %u backface "
+				"culled",
+				cull.drawnCount, cull.frustumCulledCount, cull.occlusionCulledCount,
+				cull.backfaceCulledCount);
+
+		MemoryStats memory = RS::getSingleton().getMemoryStats();
+		const uint64_t MiB = 1024 * 1024;
+
+		SDL_Log("memory: %llu / %llu MiB, %u streamed textures %llu / %llu MiB resident",
+				static_cast<unsigned long long>(memory.usage / MiB),
+				static_cast<unsigned long long>(memory.budget / MiB), memory.streamedTextureCount,
+				static_cast<unsigned long long>(memory.textureResidentSize / MiB),
+				static_cast<unsigned long long>(memory.textureFullSize / MiB));
+
+		if (memory.streamedMeshCount > 0) {
+			SDL_Log("geometry streaming: %u / %u meshes, %llu / %llu MiB resident",
+					memory.residentMeshCount, memory.streamedMeshCount,
+					static_cast<unsigned long long>(memory.geometryResidentSize / MiB),
+					static_cast<unsigned long long>(memory.geometryFullSize / MiB));
+		}
+
+		SDL_Log("uploads: %u waiting, %u cancelled", memory.uploadRequestCount,
+				memory.uploadCancelledCount);
+
+		for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++) {
+			const MemoryCategoryStats &category = memory.categories[i];
+
+			SDL_Log("memory %s: %.1f MiB in %u allocations (%.1f MiB peak)",
+					MemoryTracker::getName(static_cast<MemoryCategory>(i)),
+					static_cast<double>(category.bytes) / MiB, category.allocationCount,
+					static_cast<double>(category.peakBytes) / MiB);
+		}
+
+		SDL_Log("memory allocator: %.1f MiB in %u allocations, %.1f MiB in %u blocks, "
+				"%.1f MiB tracked",
+				static_cast<double>(memory.allocationBytes) / MiB, memory.allocationCount,
+				static_cast<double>(memory.blockBytes) / MiB, memory.blockCount,
+				static_cast<double>(memory.tracked.bytes) / MiB);
+
+		for (const CpuZoneStats &zone : Profiler::getFrameSummary()) {
+			SDL_Log("cpu %s: %.3f ms in %u calls (%.3f ms average, %.1f ms total)", zone.name,
+					zone.milliseconds, zone.callCount, zone.averageMilliseconds,
+					zone.totalMilliseconds);
+
+			if (zone.allocationCount > 0)
+				SDL_Log("cpu %s: %u heap allocations, %.1f KiB", zone.name, zone.allocationCount,
+						static_cast<double>(zone.allocationBytes) / 1024.0);
+		}
+
+		for (const GpuTiming &timing : RS::getSingleton().getGpuTimings())
+			SDL_Log("gpu %s: %.3f ms (%.3f ms average of %u)", timing.name.c_str(),
+					timing.milliseconds, timing.averageMilliseconds, timing.sampleCount);
+
+		DefragmentationStats defragmentation = RS::getSingleton().getDefragmentationStats();
+
+		SDL_Log("defragmentation: %.1f%% -> %.1f%% unused, %u allocations (%llu MiB) moved%s",
+				defragmentation.fragmentationBefore * 100.0f,
+				defragmentation.fragmentationAfter * 100.0f, defragmentation.allocationsMoved,
+				static_cast<unsigned long long>(defragmentation.bytesMoved / MiB),
+				RS::getSingleton().isDefragmenting() ? ", running" : "");
+		return 0;
+	}
+
+	if (event->type == SDL_EVENT_KEY_DOWN && event->key.keysym.sym == SDLK_F4) {
+		RS::getSingleton().defragmentationStart();
+		return 0;
+	}
+
+	if (event->type == SDL_EVENT_KEY_DOWN && event->key.keysym.sym == SDLK_F5) {
+		const vk::PresentModeKHR presentModes[] = { vk::PresentModeKHR::eFifo,
+			vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eMailbox,
+			vk::PresentModeKHR::eImmediate };
+		const size_t presentModeCount = sizeof(presentModes) / sizeof(presentModes[0]);
+
+		vk::PresentModeKHR current = RS::getSingleton().getPresentMode();
+		size_t next = 0;
+
+		for (size_t i = 0; i < presentModeCount; i++)
+			if (presentModes[i] == current)
+				next = (i + 1) % presentModeCount;
+
+		RS::getSingleton().setPresentMode(presentModes[next]);
+
+		SDL_Log("Present mode: %s, applied next frame",
+				vk::to_string(presentModes[next]).c_str());
+		return 0;
+	}
+
+	if (event->type == SDL_EVENT_KEY_DOWN && event->key.keysym.sym == SDLK_F6) {
+		if (Profiler::isTracing()) {
+			Profiler::traceEnd();
+			SDL_Log("Trace written to %s", _traceFile);
+		} else if (Profiler::traceBegin(_traceFile)) {
+			SDL_Log("Tracing to %s", _traceFile);
+		}
+
+		return 0;
+	}
+
+	if (event->type == SDL_EVENT_KEY_DOWN && event->key.keysym.sym == SDLK_F7) {
+		if (!pState->camera.isRecording()) {
+			pState->camera.recordBegin();
+			SDL_Log("Recording camera path");
+		} else if (pState->camera.recordEnd(_cameraPathFile)) {
+			SDL_Log("Camera path written to %s", _cameraPathFile);
+		}
+
+		return 0;
+	}
+
+	if (event->type == SDL_EVENT_KEY_DOWN && event->key.keysym.sym == SDLK_F8) {
+		char file[64];
+		SDL_snprintf(file, sizeof(file), "capture_%03u.%s", pState->captureCount++,
+				_captureFormat);
+
+		std::string path = file;
+		CaptureWriter *pCaptures = &pState->captures;
+
+		CaptureCallback onCapture = [pCaptures, path](std::shared_ptr<Image> image) {
+			pCaptures->write(path, image);
+		};
+
+		if (!RS::getSingleton().requestCapture(onCapture))
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Swapchain does not support capture!");
+
+		return 0;
+	}
+
+	if (event->type == SDL_EVENT_KEY_DOWN && event->key.keysym.sym == SDLK_F9) {
+		const char *names[] = { "none", "overdraw", "light complexity", "mip level" };
+		const uint32_t viewCount = sizeof(names) / sizeof(names[0]);
+
+		uint32_t next = (static_cast<uint32_t>(RS::getSingleton().getDebugView()) + 1) % viewCount;
+		RS::getSingleton().setDebugView(static_cast<DebugView>(next));
+
+		SDL_Log("Debug view: %s", names[next]);
+		return 0;
+	}
+
 	return 0;
 }
 
 void SDL_AppQuit(void *appstate) {
 	AppState *pState = reinterpret_cast<AppState *>(appstate);
-	SDL_DestroyWindow(pState->pWindow);
+
+	Profiler::traceEnd();
+
+	// nothing was created when app only cooked a scene
+	if (pState == nullptr) {
+		JobSystem::shutdown();
+		return;
+	}
+
+	// captures still in flight are finished
+	RS::getSingleton().captureWait();
+	pState->captures.wait();
+
+	RS::getSingleton().pipelineCacheSave();
+	RS::getSingleton().finish();
+
+	// batch renders and thumbnails have no window
+	if (pState->pWindow != nullptr)
+		SDL_DestroyWindow(pState->pWindow);
+
+	if (pState->pMirrorWindow != nullptr)
+		SDL_DestroyWindow(pState->pMirrorWindow);
+
+	JobSystem::shutdown();
 	free(pState);
 }
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include "profiler.h"
+
+typedef struct {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+	AllocationStats allocations;
+} ZoneRecord;
+
+// written by its thread only, read by frameEnd, capacity is a power of two so indices can wrap
+struct ThreadBuffer {
+	// lane of thread in trace
+	uint32_t threadId;
+
+	ZoneRecord records[PROFILER_THREAD_CAPACITY];
+	std::atomic<uint32_t> head{ 0 };
+	std::atomic<uint32_t> tail{ 0 };
+	// thread exited, buffer is freed once drained
+	std::atomic<bool> isRetired{ false };
+};
+
+struct ThreadRegistration {
+	ThreadBuffer *pBuffer = nullptr;
+
+	~ThreadRegistration() {
+		if (pBuffer != nullptr)
+			pBuffer->isRetired.store(true, std::memory_order_release);
+	}
+};
+
+typedef struct {
+	const char *name;
+	// of frame being drained
+	uint64_t ticks;
+	uint32_t callCount;
+	AllocationStats allocations;
+
+	uint64_t frameTicks[PROFILER_FRAME_WINDOW];
+	uint64_t windowTicks;
+	uint64_t totalTicks;
+} Zone;
+
+static std::mutex _threadsMutex;
+static std::vector<ThreadBuffer *> _threads;
+static uint32_t _nextThreadId = 0;
+static thread_local ThreadRegistration _registration;
+
+static std::atomic<bool> _isEnabled{ true };
+static std::atomic<uint64_t> _droppedCount{ 0 };
+
+// touched by frameEnd thread only
+static std::vector<Zone> _zones;
+static std::vector<CpuZoneStats> _summary;
+static uint32_t _windowFrame = 0;
+static uint32_t _windowFrameCount = 0;
+static uint64_t _lastFrameEnd = 0;
+
+const uint32_t TRACE_CPU_PROCESS = 1;
+const uint32_t TRACE_GPU_PROCESS = 2;
+
+// trace is written by frameEnd and by threads collecting GPU zones
+static std::mutex _traceMutex;
+static std::atomic<bool> _isTracing{ false };
+static SDL_IOStream *_pTrace = nullptr;
+static uint64_t _traceStart = 0;
+static bool _isTraceEmpty = true;
+// lanes with name written, GPU lane index is its thread in trace
+static std::vector<uint32_t> _tracedThreads;
+static std::vector<const char *> _gpuLanes;
+
+static void _traceEvent(const char *pEvent) {
+	SDL_IOprintf(_pTrace, "%s%s", _isTraceEmpty ? "\n" : ",\n", pEvent);
+	_isTraceEmpty = false;
+}
+
+static void _traceName(const char *type, uint32_t process, uint32_t thread, const char *name) {
+	char event[256];
+	SDL_snprintf(event, sizeof(event),
+			"{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			type, process, thread, name);
+
+	_traceEvent(event);
+}
+
+// names are literals, they have nothing to escape
+static void _traceZone(
+		uint32_t process, uint32_t thread, const char *name, uint64_t begin, uint64_t end) {
+	// zones begun before trace would start at negative time
+	if (begin < _traceStart)
+		return;
+
+	double usPerTick = 1000000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+
+	char event[256];
+	SDL_snprintf(event, sizeof(event),
+			"{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			name, process, thread, (begin - _traceStart) * usPerTick,
+			(end - begin) * usPerTick);
+
+	_traceEvent(event);
+}
+
+static Zone &_getZone(const char *name) {
+	// literals of one name usually share address, comparing text covers those that do not
+	for (Zone &zone : _zones)
+		if (zone.name == name || strcmp(zone.name, name) == 0)
+			return zone;
+
+	Zone zone = {};
+	zone.name = name;
+
+	_zones.push_back(zone);
+
+	return _zones.back();
+}
+
+static void _drain(ThreadBuffer &buffer) {
+	uint32_t head = buffer.head.load(std::memory_order_relaxed);
+	uint32_t tail = buffer.tail.load(std::memory_order_acquire);
+
+	bool isTraced = _pTrace != nullptr && head != tail;
+
+	if (isTraced &&
+			std::find(_tracedThreads.begin(), _tracedThreads.end(), buffer.threadId) ==
+					_tracedThreads.end()) {
+		// thread calling frameEnd is the main one
+		char name[32];
+
+		if (&buffer == _registration.pBuffer)
+			SDL_snprintf(name, sizeof(name), "main");
+		else
+			SDL_snprintf(name, sizeof(name), "thread %u", buffer.threadId);
+
+		_traceName("thread_name", TRACE_CPU_PROCESS, buffer.threadId, name);
+		_tracedThreads.push_back(buffer.threadId);
+	}
+
+	for (uint32_t i = head; i != tail; i++) {
+		const ZoneRecord &record = buffer.records[i % PROFILER_THREAD_CAPACITY];
+
+		Zone &zone = _getZone(record.name);
+		zone.ticks += record.end - record.begin;
+		zone.callCount++;
+		zone.allocations.count += record.allocations.count;
+		zone.allocations.bytes += record.allocations.bytes;
+
+		if (isTraced)
+			_traceZone(TRACE_CPU_PROCESS, buffer.threadId, record.name, record.begin,
+					record.end);
+	}
+
+	buffer.head.store(tail, std::memory_order_release);
+}
+
+void Profiler::record(
+		const char *name, uint64_t begin, uint64_t end, const AllocationStats &allocations) {
+	if (_registration.pBuffer == nullptr) {
+		_registration.pBuffer = new ThreadBuffer();
+
+		std::lock_guard<std::mutex> lock(_threadsMutex);
+		_registration.pBuffer->threadId = _nextThreadId++;
+		_threads.push_back(_registration.pBuffer);
+	}
+
+	ThreadBuffer &buffer = *_registration.pBuffer;
+
+	uint32_t tail = buffer.tail.load(std::memory_order_relaxed);
+
+	if (tail - buffer.head.load(std::memory_order_acquire) == PROFILER_THREAD_CAPACITY) {
+		_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer.records[tail % PROFILER_THREAD_CAPACITY] = { name, begin, end, allocations };
+	buffer.tail.store(tail + 1, std::memory_order_release);
+}
+
+void Profiler::frameEnd() {
+	uint64_t now = SDL_GetPerformanceCounter();
+
+	std::unique_lock<std::mutex> traceLock(_traceMutex);
+
+	// frame lane of main thread, zones of it nest inside
+	if (_pTrace != nullptr && _lastFrameEnd != 0 && _registration.pBuffer != nullptr)
+		_traceZone(TRACE_CPU_PROCESS, _registration.pBuffer->threadId, "frame", _lastFrameEnd,
+				now);
+
+	_lastFrameEnd = now;
+
+	{
+		// only registration of new threads contends with this
+		std::lock_guard<std::mutex> lock(_threadsMutex);
+
+		for (size_t i = 0; i < _threads.size();) {
+			ThreadBuffer *pBuffer = _threads[i];
+
+			// retirement is seen before records written ahead of it are drained
+			bool isRetired = pBuffer->isRetired.load(std::memory_order_acquire);
+			_drain(*pBuffer);
+
+			if (isRetired) {
+				delete pBuffer;
+				_threads[i] = _threads.back();
+				_threads.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+
+	traceLock.unlock();
+
+	double msPerTick = 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+
+	_windowFrameCount = std::min(_windowFrameCount + 1, PROFILER_FRAME_WINDOW);
+	_summary.clear();
+
+	for (Zone &zone : _zones) {
+		zone.windowTicks -= zone.frameTicks[_windowFrame];
+		zone.frameTicks[_windowFrame] = zone.ticks;
+		zone.windowTicks += zone.ticks;
+		zone.totalTicks += zone.ticks;
+
+		CpuZoneStats stats;
+		stats.name = zone.name;
+		stats.milliseconds = static_cast<float>(zone.ticks * msPerTick);
+		stats.callCount = zone.callCount;
+		stats.averageMilliseconds =
+				static_cast<float>(zone.windowTicks * msPerTick / _windowFrameCount);
+		stats.totalMilliseconds = zone.totalTicks * msPerTick;
+		stats.allocationCount = static_cast<uint32_t>(zone.allocations.count);
+		stats.allocationBytes = zone.allocations.bytes;
+
+		_summary.push_back(stats);
+
+		zone.ticks = 0;
+		zone.callCount = 0;
+		zone.allocations = {};
+	}
+
+	_windowFrame = (_windowFrame + 1) % PROFILER_FRAME_WINDOW;
+}
+
+const std::vector<CpuZoneStats> &Profiler::getFrameSummary() {
+	return _summary;
+}
+
+uint64_t Profiler::getDroppedCount() {
+	return _droppedCount.load(std::memory_order_relaxed);
+}
+
+void Profiler::setEnabled(bool isEnabled) {
+	_isEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+bool Profiler::isEnabled() {
+	return _isEnabled.load(std::memory_order_relaxed);
+}
+
+bool Profiler::traceBegin(const char *pFile) {
+	traceEnd();
+
+	std::lock_guard<std::mutex> lock(_traceMutex);
+
+	_pTrace = SDL_IOFromFile(pFile, "wb");
+
+	if (_pTrace == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Trace %s can not be written!", pFile);
+		return false;
+	}
+
+	_traceStart = SDL_GetPerformanceCounter();
+	_isTraceEmpty = true;
+	_tracedThreads.clear();
+	_gpuLanes.clear();
+
+	SDL_IOprintf(_pTrace, "[");
+
+	_traceName("process_name", TRACE_CPU_PROCESS, 0, "CPU");
+	_traceName("process_name", TRACE_GPU_PROCESS, 0, "GPU");
+
+	_isTracing.store(true);
+
+	// zones are only drained once a frame ends
+	setEnabled(true);
+	return true;
+}
+
+void Profiler::traceEnd() {
+	std::lock_guard<std::mutex> lock(_traceMutex);
+
+	if (_pTrace == nullptr)
+		return;
+
+	SDL_IOprintf(_pTrace, "\n]\n");
+
+	if (!SDL_CloseIO(_pTrace))
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Trace write failed!");
+
+	_pTrace = nullptr;
+	_isTracing.store(false);
+}
+
+bool Profiler::isTracing() {
+	return _isTracing.load();
+}
+
+void Profiler::traceGpuZone(const char *lane, const char *name, uint64_t begin, uint64_t end) {
+	std::lock_guard<std::mutex> lock(_traceMutex);
+
+	if (_pTrace == nullptr)
+		return;
+
+	uint32_t thread = 0;
+
+	for (; thread < _gpuLanes.size(); thread++)
+		if (strcmp(_gpuLanes[thread], lane) == 0)
+			break;
+
+	if (thread == _gpuLanes.size()) {
+		_traceName("thread_name", TRACE_GPU_PROCESS, thread, lane);
+		_gpuLanes.push_back(lane);
+	}
+
+	_traceZone(TRACE_GPU_PROCESS, thread, name, begin, end);
+}
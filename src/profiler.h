@@ -0,0 +1,92 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <SDL3/SDL_timer.h>
+
+#include "allocation_tracker.h"
+
+// zones a thread records between two summaries, later ones are dropped
+const uint32_t PROFILER_THREAD_CAPACITY = 4096;
+
+// frames average of every zone is taken over
+const uint32_t PROFILER_FRAME_WINDOW = 64;
+
+struct CpuZoneStats {
+	const char *name;
+	// inclusive time of every call in last frame, summed over threads
+	float milliseconds;
+	uint32_t callCount;
+	// frames without the zone count as zero
+	float averageMilliseconds;
+	// since start, for zones of loading that run once
+	double totalMilliseconds;
+
+	// heap allocations of every call in last frame, inclusive like time, zero unless allocation
+	// tracker is built in
+	uint32_t allocationCount;
+	uint64_t allocationBytes;
+};
+
+// CPU zones timed with performance counter. Every thread writes its zones to a buffer of its own
+// without locking, frameEnd drains every buffer on main thread and sums zones by name. While
+// tracing, drained zones are also written as Chrome trace events, thread per lane, next to GPU
+// zones already converted to performance counter.
+class Profiler {
+public:
+	// name has to be a literal, zones with same name are summed
+	static void record(const char *name, uint64_t begin, uint64_t end,
+			const AllocationStats &allocations = {});
+
+	// has to be called once per frame from one thread
+	static void frameEnd();
+	// zones of last frame in order they were first seen
+	static const std::vector<CpuZoneStats> &getFrameSummary();
+	static uint64_t getDroppedCount();
+
+	static void setEnabled(bool isEnabled);
+	static bool isEnabled();
+
+	// JSON array of trace events, loads in chrome://tracing and Perfetto even when cut short
+	static bool traceBegin(const char *pFile);
+	static void traceEnd();
+	static bool isTracing();
+	// any thread, lane is a literal naming queue zone ran on
+	static void traceGpuZone(const char *lane, const char *name, uint64_t begin, uint64_t end);
+};
+
+// times its scope, cheap enough for hot paths
+class ProfileZone {
+private:
+	const char *_name;
+	uint64_t _begin;
+	AllocationStats _allocations;
+
+public:
+	ProfileZone(const char *name) : _name(name) {
+		_begin = Profiler::isEnabled() ? SDL_GetPerformanceCounter() : 0;
+		_allocations = AllocationTracker::getThread();
+	}
+
+	~ProfileZone() {
+		if (_begin == 0)
+			return;
+
+		AllocationStats allocations = AllocationTracker::getThread();
+		allocations.count -= _allocations.count;
+		allocations.bytes -= _allocations.bytes;
+
+		Profiler::record(_name, _begin, SDL_GetPerformanceCounter(), allocations);
+	}
+
+	ProfileZone(const ProfileZone &) = delete;
+	ProfileZone &operator=(const ProfileZone &) = delete;
+};
+
+#define PROFILE_ZONE_CONCAT_(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_CONCAT(_profileZone, __LINE__)(name)
+
+#endif // !PROFILER_H
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_pacer.h"
+
+#include "bound_analyzer.h"
+
+FrameBoundSample BoundAnalyzer::classify(const FrameTiming &timing, float gpuMilliseconds) {
+	FrameBoundSample sample = {};
+	sample.frameNumber = timing.frameNumber;
+	sample.milliseconds = timing.milliseconds;
+	sample.gpuMilliseconds = gpuMilliseconds;
+	sample.fenceWaitMilliseconds = timing.fenceWaitMilliseconds;
+	sample.acquireMilliseconds = timing.acquireMilliseconds;
+
+	// frames that never submitted, like those with swapchain recreated, did not present either
+	if (timing.submitOffset > 0.0f)
+		sample.presentMilliseconds = std::max(timing.presentOffset - timing.submitOffset, 0.0f);
+
+	float waits =
+			sample.fenceWaitMilliseconds + sample.acquireMilliseconds + sample.presentMilliseconds;
+	sample.cpuMilliseconds = std::max(sample.milliseconds - waits, 0.0f);
+
+	if (sample.milliseconds <= 0.0f) {
+		sample.bound = FrameBound::Unknown;
+	} else if (waits <= sample.milliseconds * BOUND_WAIT_RATIO) {
+		sample.bound = FrameBound::Cpu;
+	} else {
+		bool isGpuBusy = gpuMilliseconds >= 0.0f
+				? gpuMilliseconds >= sample.milliseconds * BOUND_GPU_RATIO
+				: sample.fenceWaitMilliseconds >=
+						sample.acquireMilliseconds + sample.presentMilliseconds;
+
+		sample.bound = isGpuBusy ? FrameBound::Gpu : FrameBound::Present;
+	}
+
+	return sample;
+}
+
+FrameBound BoundAnalyzer::getMajority(const uint32_t *pCounts) {
+	FrameBound bound = FrameBound::Unknown;
+	uint32_t count = 0;
+
+	for (size_t i = static_cast<size_t>(FrameBound::Cpu);
+			i < static_cast<size_t>(FrameBound::Count); i++) {
+		if (pCounts[i] > count) {
+			bound = static_cast<FrameBound>(i);
+			count = pCounts[i];
+		}
+	}
+
+	return bound;
+}
+
+const char *BoundAnalyzer::getName(FrameBound bound) {
+	switch (bound) {
+		case FrameBound::Cpu:
+			return "cpu";
+		case FrameBound::Gpu:
+			return "gpu";
+		case FrameBound::Present:
+			return "present";
+		default:
+			return "unknown";
+	}
+}
+
+void BoundAnalyzer::add(const FrameTiming &timing, float gpuMilliseconds) {
+	FrameBoundSample sample = classify(timing, gpuMilliseconds);
+
+	if (sample.bound == FrameBound::Unknown)
+		return;
+
+	_samples[_nextSample] = sample;
+	_nextSample = (_nextSample + 1) % BOUND_ANALYSIS_WINDOW;
+	_sampleCount = std::min(_sampleCount + 1, BOUND_ANALYSIS_WINDOW);
+
+	_totals[static_cast<size_t>(sample.bound)]++;
+}
+
+FrameBoundStats BoundAnalyzer::getStats() const {
+	FrameBoundStats stats = {};
+	stats.sampleCount = _sampleCount;
+	std::copy(_totals, _totals + static_cast<size_t>(FrameBound::Count), stats.totals);
+
+	if (_sampleCount == 0)
+		return stats;
+
+	stats.last = _samples[(_nextSample + BOUND_ANALYSIS_WINDOW - 1) % BOUND_ANALYSIS_WINDOW];
+
+	uint32_t gpuCount = 0;
+
+	for (uint32_t i = 0; i < _sampleCount; i++) {
+		const FrameBoundSample &sample = _samples[i];
+
+		stats.counts[static_cast<size_t>(sample.bound)]++;
+		stats.averageMilliseconds += sample.milliseconds;
+		stats.averageCpuMilliseconds += sample.cpuMilliseconds;
+		stats.averageFenceWaitMilliseconds += sample.fenceWaitMilliseconds;
+		stats.averageAcquireMilliseconds += sample.acquireMilliseconds;
+		stats.averagePresentMilliseconds += sample.presentMilliseconds;
+
+		if (sample.gpuMilliseconds >= 0.0f) {
+			stats.averageGpuMilliseconds += sample.gpuMilliseconds;
+			gpuCount++;
+		}
+	}
+
+	float count = static_cast<float>(_sampleCount);
+	stats.averageMilliseconds /= count;
+	stats.averageCpuMilliseconds /= count;
+	stats.averageFenceWaitMilliseconds /= count;
+	stats.averageAcquireMilliseconds /= count;
+	stats.averagePresentMilliseconds /= count;
+	stats.averageGpuMilliseconds =
+			gpuCount > 0 ? stats.averageGpuMilliseconds / static_cast<float>(gpuCount) : -1.0f;
+
+	stats.bound = getMajority(stats.counts);
+
+	return stats;
+}
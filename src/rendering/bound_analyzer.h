@@ -0,0 +1,85 @@
+#ifndef BOUND_ANALYZER_H
+#define BOUND_ANALYZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_pacer.h"
+
+// frames rolling class and averages are taken over
+const uint32_t BOUND_ANALYSIS_WINDOW = 64;
+
+// CPU that waited less than this part of frame is what paced it
+const float BOUND_WAIT_RATIO = 0.1f;
+// waits while GPU was busy for this part of frame or more were on GPU
+const float BOUND_GPU_RATIO = 0.85f;
+
+enum class FrameBound {
+	Unknown,
+	Cpu,
+	Gpu,
+	// swapchain, vsync or compositor paced frame, neither processor was saturated
+	Present,
+	Count,
+};
+
+// milliseconds of one frame, from its begin to return of present
+struct FrameBoundSample {
+	uint64_t frameNumber;
+	float milliseconds;
+	// what is left of frame without waits, recording and everything else render thread did
+	float cpuMilliseconds;
+	// frame scope on device, negative without timestamps
+	float gpuMilliseconds;
+	float fenceWaitMilliseconds;
+	float acquireMilliseconds;
+	// within present, blocks once swapchain has no room for another image
+	float presentMilliseconds;
+	FrameBound bound;
+};
+
+struct FrameBoundStats {
+	FrameBoundSample last;
+	// class of most frames in window
+	FrameBound bound;
+	// frames of window and since start, indexed by FrameBound
+	uint32_t counts[static_cast<size_t>(FrameBound::Count)];
+	uint64_t totals[static_cast<size_t>(FrameBound::Count)];
+	uint32_t sampleCount;
+
+	// of window, GPU one of frames with timestamps only
+	float averageMilliseconds;
+	float averageCpuMilliseconds;
+	float averageGpuMilliseconds;
+	float averageFenceWaitMilliseconds;
+	float averageAcquireMilliseconds;
+	float averagePresentMilliseconds;
+};
+
+// Tells of every frame whether CPU, GPU or presentation paced it, from waits FramePacer recorded
+// and frame scope of GpuProfiler, once timestamps of frame are read as many frames later as there
+// are frames in flight. Rules are fixed ratios of frame time, same timings always give same
+// class. CPU that barely waited paced frame itself, waits while GPU was busy for most of frame
+// were on GPU and other waits on swapchain. Without timestamps fence wait against swapchain waits
+// decides. Idle waits and sleeps of frame rate limit are outside frames, held back frames read as
+// CPU bound with short frame times.
+class BoundAnalyzer {
+private:
+	FrameBoundSample _samples[BOUND_ANALYSIS_WINDOW] = {};
+	uint32_t _nextSample = 0;
+	uint32_t _sampleCount = 0;
+
+	uint64_t _totals[static_cast<size_t>(FrameBound::Count)] = {};
+
+public:
+	// gpuMilliseconds is negative when frame has no timestamps
+	static FrameBoundSample classify(const FrameTiming &timing, float gpuMilliseconds);
+	// most counted class, ties go to earlier one, Unknown without any
+	static FrameBound getMajority(const uint32_t *pCounts);
+	static const char *getName(FrameBound bound);
+
+	void add(const FrameTiming &timing, float gpuMilliseconds);
+	FrameBoundStats getStats() const;
+};
+
+#endif // !BOUND_ANALYZER_H
@@ -0,0 +1,217 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include <io/environment_cache.h>
+
+#include "call_recorder.h"
+
+// buffered records are written once they grow past it, even within a frame
+const size_t CALL_LOG_FLUSH_SIZE = 4 * 1024 * 1024;
+
+void CallRecorder::_appendBytes(std::vector<uint8_t> &bytes, const void *pData, size_t size) {
+	size_t offset = bytes.size();
+	bytes.resize(offset + size);
+
+	if (size > 0)
+		memcpy(bytes.data() + offset, pData, size);
+}
+
+void CallRecorder::_pack(Packed &packed, const Mesh &mesh) {
+	// geometry alone, materials differ between loads of the same mesh
+	std::vector<uint8_t> payload;
+	std::vector<ObjectID> materials(mesh.primitiveCount);
+
+	const char *pName = mesh.pName != nullptr ? mesh.pName : "";
+	uint32_t nameSize = static_cast<uint32_t>(strlen(pName));
+
+	_appendBytes(payload, &mesh.primitiveCount, sizeof(uint32_t));
+	_appendBytes(payload, &nameSize, sizeof(uint32_t));
+	_appendBytes(payload, pName, nameSize);
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const Primitive &primitive = mesh.pPrimitives[i];
+		materials[i] = primitive.materialIndex;
+
+		uint32_t counts[4] = { primitive.vertices.count, primitive.indices.count,
+			primitive.meshlets.count, primitive.lods.count };
+
+		_appendBytes(payload, counts, sizeof(counts));
+		_appendBytes(payload, primitive.vertices.pData, sizeof(Vertex) * counts[0]);
+		_appendBytes(payload, primitive.indices.pData, sizeof(uint32_t) * counts[1]);
+		_appendBytes(payload, primitive.meshlets.pData, sizeof(Meshlet) * counts[2]);
+
+		for (uint32_t j = 0; j < counts[3]; j++) {
+			const Lod &lod = primitive.lods.pData[j];
+
+			_appendBytes(payload, &lod.error, sizeof(float));
+			_appendBytes(payload, &lod.indices.count, sizeof(uint32_t));
+			_appendBytes(payload, lod.indices.pData, sizeof(uint32_t) * lod.indices.count);
+		}
+
+		_appendBytes(payload, &primitive.morphTargets.count, sizeof(uint32_t));
+
+		for (uint32_t j = 0; j < primitive.morphTargets.count; j++) {
+			const MorphTarget &target = primitive.morphTargets.pData[j];
+
+			_appendBytes(payload, &target.deltaCount, sizeof(uint32_t));
+			_appendBytes(payload, target.pDeltas, sizeof(MorphDelta) * target.deltaCount);
+		}
+	}
+
+	_packPayload(packed, std::move(payload));
+	_pack(packed, materials);
+}
+
+void CallRecorder::_pack(Packed &packed, const std::shared_ptr<Image> &image) {
+	if (image == nullptr) {
+		_pack(packed, uint64_t(0));
+		return;
+	}
+
+	const std::vector<uint8_t> &data = image->getData();
+
+	uint32_t properties[5] = { image->getWidth(), image->getHeight(),
+		static_cast<uint32_t>(image->getFormat()), image->getMipLevels(),
+		image->isSrgb() ? 1u : 0u };
+
+	std::vector<uint8_t> payload;
+	payload.reserve(sizeof(properties) + data.size());
+
+	_appendBytes(payload, properties, sizeof(properties));
+	_appendBytes(payload, data.data(), data.size());
+
+	_packPayload(packed, std::move(payload));
+}
+
+void CallRecorder::_pack(Packed &packed, const LightProbeGrid &grid) {
+	std::vector<uint8_t> payload;
+
+	_appendBytes(payload, &grid.origin, sizeof(glm::vec3));
+	_appendBytes(payload, &grid.spacing, sizeof(glm::vec3));
+	_appendBytes(payload, &grid.counts, sizeof(glm::uvec3));
+	_appendBytes(payload, grid.probes.data(), sizeof(glm::vec4) * grid.probes.size());
+
+	_packPayload(packed, std::move(payload));
+}
+
+void CallRecorder::_pack(Packed &packed, const CellPortalGraph &graph) {
+	std::vector<uint8_t> payload;
+
+	uint32_t counts[3] = { static_cast<uint32_t>(graph.cells.size()),
+		static_cast<uint32_t>(graph.portals.size()), graph.pvsWordCount };
+
+	_appendBytes(payload, counts, sizeof(counts));
+	_appendBytes(payload, graph.cells.data(), sizeof(CellPortalGraph::Cell) * counts[0]);
+	_appendBytes(payload, graph.portals.data(), sizeof(CellPortalGraph::Portal) * counts[1]);
+	_appendBytes(payload, graph.pvs.data(), sizeof(uint64_t) * graph.pvs.size());
+
+	_packPayload(packed, std::move(payload));
+}
+
+void CallRecorder::_packPayload(Packed &packed, std::vector<uint8_t> payload) {
+	// outside of lock, loader threads hash their meshes in parallel
+	uint64_t hash = EnvironmentCache::hash(payload.data(), payload.size());
+
+	_pack(packed, hash);
+	packed.payloads.push_back({ hash, std::move(payload) });
+}
+
+void CallRecorder::_write(Op op, const Packed &packed) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_pStream == nullptr)
+		return;
+
+	// payload precedes first call referring to it
+	for (const auto &[hash, payload] : packed.payloads) {
+		if (!_payloads.insert(hash).second)
+			continue;
+
+		Record record = { static_cast<uint32_t>(Op::Payload),
+			static_cast<uint32_t>(sizeof(uint64_t) + payload.size()) };
+
+		_appendBytes(_buffer, &record, sizeof(Record));
+		_appendBytes(_buffer, &hash, sizeof(uint64_t));
+		_appendBytes(_buffer, payload.data(), payload.size());
+	}
+
+	Record record = { static_cast<uint32_t>(op), static_cast<uint32_t>(packed.args.size()) };
+
+	_appendBytes(_buffer, &record, sizeof(Record));
+	_appendBytes(_buffer, packed.args.data(), packed.args.size());
+
+	if (_buffer.size() >= CALL_LOG_FLUSH_SIZE)
+		_flush();
+}
+
+void CallRecorder::_flush() {
+	if (_buffer.empty())
+		return;
+
+	if (SDL_WriteIO(_pStream, _buffer.data(), _buffer.size()) != _buffer.size())
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Call log %s write failed!", _file.c_str());
+
+	_buffer.clear();
+}
+
+bool CallRecorder::begin(const char *pFile) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_pStream = SDL_IOFromFile(pFile, "wb");
+
+	if (_pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Call log %s can not be written!", pFile);
+		return false;
+	}
+
+	Header header;
+	memcpy(header.magic, CALL_LOG_MAGIC, sizeof(CALL_LOG_MAGIC));
+	header.version = CALL_LOG_VERSION;
+
+	_appendBytes(_buffer, &header, sizeof(Header));
+
+	_file = pFile;
+	_start = SDL_GetTicksNS();
+
+	SDL_Log("Recording calls to %s", pFile);
+	return true;
+}
+
+void CallRecorder::end() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_pStream == nullptr)
+		return;
+
+	_flush();
+
+	if (!SDL_CloseIO(_pStream))
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Call log %s write failed!", _file.c_str());
+	else
+		SDL_Log("Calls recorded to %s", _file.c_str());
+
+	_pStream = nullptr;
+	_payloads.clear();
+}
+
+bool CallRecorder::isRecording() const {
+	return _pStream != nullptr;
+}
+
+void CallRecorder::frame() {
+	uint64_t time = SDL_GetTicksNS() - _start;
+	record(Op::Draw, time);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_pStream != nullptr)
+		_flush();
+}
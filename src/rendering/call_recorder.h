@@ -0,0 +1,193 @@
+#ifndef CALL_RECORDER_H
+#define CALL_RECORDER_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+
+#include <io/cell_portals.h>
+#include <io/image.h>
+#include <io/light_probes.h>
+#include <io/mesh.h>
+
+#include "object_owner.h"
+
+const char CALL_LOG_MAGIC[4] = { 'H', 'C', 'A', 'L' };
+
+// bumped whenever a call or layout of its arguments changes, older logs are then refused
+const uint32_t CALL_LOG_VERSION = 14;
+
+// Writes calls made to rendering server into a binary log, see CallPlayer. Each record is op
+// and size followed by packed arguments. Meshes, images, probe grids and cell graphs go into
+// payload records once per content hash, calls refer to them by hash, so resources loaded again
+// cost a few bytes. Draw records hold time since recording began and end a frame, buffered records
+// are written to file with them.
+class CallRecorder {
+public:
+	// values are stored in logs, new ops go last
+	enum class Op : uint32_t {
+		Payload,
+		Draw,
+
+		CameraSetTransform,
+		CameraSetFovY,
+		CameraSetZNear,
+		CameraSetZFar,
+
+		MeshCreate,
+		MeshFree,
+
+		MeshInstanceCreate,
+		MeshInstanceCreateBatch,
+		MeshInstanceSetMesh,
+		MeshInstanceSetTransform,
+		MeshInstanceSetTransforms,
+		MeshInstanceSetJoints,
+		MeshInstanceFree,
+
+		LightCreate,
+		LightSetTransform,
+		LightSetTransforms,
+		LightSetRange,
+		LightSetColor,
+		LightSetIntensity,
+		LightSetShadow,
+		LightSetBaked,
+		LightFree,
+
+		TextureCreate,
+		TextureFree,
+
+		MaterialCreate,
+		MaterialUpdate,
+		MaterialFree,
+
+		SetExposure,
+		SetAutoExposure,
+		SetWhite,
+		SetTonemapLook,
+		SetTonemapLut,
+		SetSkyLod,
+		SetUpscaleFilter,
+		SetRenderScale,
+
+		EnvironmentSkyUpdate,
+		EnvironmentSetSpecularSampleCount,
+		LightProbesSet,
+
+		DefragmentationStart,
+
+		MeshUpdate,
+		TextureUpdate,
+
+		ViewSetCount,
+		ViewSetRect,
+		ViewSetTransform,
+		ViewSetFovY,
+
+		LightSetDrawDistance,
+
+		ParticleEmitterCreate,
+		ParticleEmitterSetMesh,
+		ParticleEmitterSetTransform,
+		ParticleEmitterSetInfo,
+		ParticleEmitterFree,
+
+		EnvironmentSetMaxCubemapSize,
+
+		SetDebugView,
+
+		CellPortalsSet,
+
+		MeshInstanceSetMorphWeights,
+
+		SetQuality,
+
+		EnvironmentAtmosphereSet,
+
+		ReflectionProbeSet,
+
+		TerrainSet,
+		TerrainLayerSet,
+	};
+
+	typedef struct {
+		char magic[4];
+		uint32_t version;
+	} Header;
+
+	typedef struct {
+		uint32_t op;
+		// of arguments following it
+		uint32_t size;
+	} Record;
+
+private:
+	typedef struct {
+		std::vector<uint8_t> args;
+		// content hash and bytes of each payload call refers to
+		std::vector<std::pair<uint64_t, std::vector<uint8_t>>> payloads;
+	} Packed;
+
+	SDL_IOStream *_pStream = nullptr;
+	std::string _file;
+	uint64_t _start = 0;
+
+	// calls come from client and loader threads
+	std::mutex _mutex;
+	std::vector<uint8_t> _buffer;
+	std::unordered_set<uint64_t> _payloads;
+
+	static void _appendBytes(std::vector<uint8_t> &bytes, const void *pData, size_t size);
+
+	template <typename T> static void _pack(Packed &packed, const T &value) {
+		static_assert(std::is_trivially_copyable<T>::value, "argument has to be plain data");
+		_appendBytes(packed.args, &value, sizeof(T));
+	}
+
+	template <typename T> static void _pack(Packed &packed, const std::vector<T> &values) {
+		static_assert(std::is_trivially_copyable<T>::value, "argument has to be plain data");
+		uint32_t count = static_cast<uint32_t>(values.size());
+
+		_appendBytes(packed.args, &count, sizeof(uint32_t));
+		_appendBytes(packed.args, values.data(), sizeof(T) * count);
+	}
+
+	// hash of payload followed by material of every primitive
+	static void _pack(Packed &packed, const Mesh &mesh);
+	// hash of payload, 0 for null image
+	static void _pack(Packed &packed, const std::shared_ptr<Image> &image);
+	static void _pack(Packed &packed, const LightProbeGrid &grid);
+	static void _pack(Packed &packed, const CellPortalGraph &graph);
+
+	static void _packPayload(Packed &packed, std::vector<uint8_t> payload);
+
+	void _write(Op op, const Packed &packed);
+	void _flush();
+
+public:
+	// false when file can not be opened, calls are then not recorded
+	bool begin(const char *pFile);
+	void end();
+	bool isRecording() const;
+
+	// any thread, arguments are copied before it returns
+	template <typename... Args> void record(Op op, const Args &...args) {
+		Packed packed;
+		(_pack(packed, args), ...);
+
+		_write(op, packed);
+	}
+
+	// draw record ends the frame, log is written up to it
+	void frame();
+};
+
+#endif // !CALL_RECORDER_H
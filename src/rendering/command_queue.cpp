@@ -0,0 +1,78 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "command_queue.h"
+
+bool CommandQueue::_isReady() const {
+	const Slot &slot = _slots[_head % COMMAND_QUEUE_CAPACITY];
+
+	// sequentially consistent, see push
+	return slot.sequence.load() == _head + 1;
+}
+
+void CommandQueue::push(Command command) {
+	uint64_t position = _tail.load(std::memory_order_relaxed);
+	Slot *pSlot;
+
+	while (true) {
+		pSlot = &_slots[position % COMMAND_QUEUE_CAPACITY];
+
+		uint64_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+		int64_t difference = static_cast<int64_t>(sequence - position);
+
+		if (difference == 0) {
+			if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		} else if (difference < 0) {
+			// full, slot still holds command of previous lap
+			std::this_thread::yield();
+			position = _tail.load(std::memory_order_relaxed);
+		} else {
+			position = _tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	pSlot->command = std::move(command);
+	// stores and loads on both sides are sequentially consistent, either consumer sees command
+	// before it sleeps or it is seen sleeping here
+	pSlot->sequence.store(position + 1);
+
+	if (!_isConsumerSleeping.load())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+	}
+
+	_condition.notify_one();
+}
+
+bool CommandQueue::pop(Command &command) {
+	if (!_isReady())
+		return false;
+
+	Slot &slot = _slots[_head % COMMAND_QUEUE_CAPACITY];
+
+	command = std::move(slot.command);
+	slot.command = nullptr;
+	slot.sequence.store(_head + COMMAND_QUEUE_CAPACITY, std::memory_order_release);
+
+	_head++;
+	return true;
+}
+
+void CommandQueue::wait() {
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	_isConsumerSleeping.store(true);
+	_condition.wait(lock, [this] { return _isReady(); });
+	_isConsumerSleeping.store(false);
+}
+
+CommandQueue::CommandQueue() {
+	for (uint32_t i = 0; i < COMMAND_QUEUE_CAPACITY; i++)
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
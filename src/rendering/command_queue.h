@@ -0,0 +1,175 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// commands queued at once, producers wait for a free slot when it is full
+const uint32_t COMMAND_QUEUE_CAPACITY = 4096;
+// captures of a command up to it are kept in its slot, larger ones are allocated
+const size_t COMMAND_INLINE_SIZE = 112;
+
+// Bounded ring with many producers and one consumer, after Vyukov's bounded queue. Producers
+// claim a slot with one compare exchange and publish it through sequence of slot, nothing is
+// locked on push or pop. Consumer sleeps only while ring is empty, producers wake it.
+class CommandQueue {
+public:
+	// Move only void() callable in place of std::function, whose inline buffer holds two
+	// pointers at most, so nearly every client call allocated its captures. Captures of
+	// transforms, cameras and settings fit here instead.
+	class Command {
+	private:
+		// destination nullptr destroys source, otherwise callable is moved and source destroyed
+		typedef void (*Manage)(void *pDst, void *pSrc);
+		typedef void (*Invoke)(void *pCallable);
+
+		alignas(std::max_align_t) unsigned char _storage[COMMAND_INLINE_SIZE];
+		Invoke _invoke = nullptr;
+		Manage _manage = nullptr;
+
+		template <typename F>
+		static void _invokeInline(void *pCallable) {
+			(*static_cast<F *>(pCallable))();
+		}
+
+		template <typename F>
+		static void _manageInline(void *pDst, void *pSrc) {
+			F *pCallable = static_cast<F *>(pSrc);
+
+			if (pDst != nullptr)
+				new (pDst) F(std::move(*pCallable));
+
+			pCallable->~F();
+		}
+
+		// storage holds pointer to callable
+		template <typename F>
+		static void _invokeHeap(void *pCallable) {
+			(**static_cast<F **>(pCallable))();
+		}
+
+		template <typename F>
+		static void _manageHeap(void *pDst, void *pSrc) {
+			F *pCallable = *static_cast<F **>(pSrc);
+
+			if (pDst != nullptr)
+				new (pDst) F *(pCallable);
+			else
+				delete pCallable;
+		}
+
+		void _take(Command &other) {
+			if (other._manage == nullptr)
+				return;
+
+			other._manage(_storage, other._storage);
+			_invoke = other._invoke;
+			_manage = other._manage;
+
+			other._invoke = nullptr;
+			other._manage = nullptr;
+		}
+
+		void _reset() {
+			if (_manage != nullptr)
+				_manage(nullptr, _storage);
+
+			_invoke = nullptr;
+			_manage = nullptr;
+		}
+
+	public:
+		void operator()() {
+			_invoke(_storage);
+		}
+
+		explicit operator bool() const {
+			return _invoke != nullptr;
+		}
+
+		Command &operator=(Command &&other) noexcept {
+			if (this != &other) {
+				_reset();
+				_take(other);
+			}
+
+			return *this;
+		}
+
+		Command &operator=(std::nullptr_t) {
+			_reset();
+			return *this;
+		}
+
+		Command() {}
+		Command(std::nullptr_t) {}
+
+		template <typename F,
+				typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Command>::value>>
+		Command(F &&callable) {
+			typedef std::decay_t<F> Callable;
+
+			// moves out of a slot must not throw, such callables go to heap as well
+			if constexpr (sizeof(Callable) <= COMMAND_INLINE_SIZE &&
+					alignof(Callable) <= alignof(std::max_align_t) &&
+					std::is_nothrow_move_constructible<Callable>::value) {
+				new (_storage) Callable(std::forward<F>(callable));
+				_invoke = &_invokeInline<Callable>;
+				_manage = &_manageInline<Callable>;
+			} else {
+				new (_storage) Callable *(new Callable(std::forward<F>(callable)));
+				_invoke = &_invokeHeap<Callable>;
+				_manage = &_manageHeap<Callable>;
+			}
+		}
+
+		Command(Command &&other) noexcept {
+			_take(other);
+		}
+
+		~Command() {
+			_reset();
+		}
+
+		Command(const Command &) = delete;
+		Command &operator=(const Command &) = delete;
+	};
+
+private:
+	struct Slot {
+		// position slot is written at next, that plus one once it holds a command
+		std::atomic<uint64_t> sequence;
+		Command command;
+	};
+
+	Slot _slots[COMMAND_QUEUE_CAPACITY];
+
+	// next position producers claim and next one consumer reads
+	std::atomic<uint64_t> _tail{ 0 };
+	uint64_t _head = 0;
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::atomic<bool> _isConsumerSleeping{ false };
+
+	bool _isReady() const;
+
+public:
+	// any thread
+	void push(Command command);
+
+	// consumer only, false when empty
+	bool pop(Command &command);
+	// consumer only, returns once pop has a command
+	void wait();
+
+	CommandQueue();
+};
+
+#endif // !COMMAND_QUEUE_H
@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "aabb_tree.h"
+
+const uint32_t PLANE_COUNT = 6;
+const uint32_t ALL_PLANES = (1 << PLANE_COUNT) - 1;
+
+AABB AABBTree::_merge(const AABB &a, const AABB &b) {
+	return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+float AABBTree::_area(const AABB &aabb) {
+	glm::vec3 size = aabb.max - aabb.min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool AABBTree::_contains(const AABB &outer, const AABB &inner) {
+	return glm::all(glm::lessThanEqual(outer.min, inner.min)) &&
+			glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+bool AABBTree::_isLeaf(uint32_t node) const {
+	return _nodes[node].right == AABB_TREE_NULL;
+}
+
+uint32_t AABBTree::_allocate() {
+	uint32_t node;
+
+	if (_freeNode != AABB_TREE_NULL) {
+		node = _freeNode;
+		_freeNode = _nodes[node].parent;
+	} else {
+		node = static_cast<uint32_t>(_nodes.size());
+		_nodes.emplace_back();
+	}
+
+	_nodes[node] = {};
+	_nodes[node].parent = AABB_TREE_NULL;
+	_nodes[node].left = AABB_TREE_NULL;
+	_nodes[node].right = AABB_TREE_NULL;
+	_nodes[node].height = 0;
+
+	return node;
+}
+
+void AABBTree::_release(uint32_t node) {
+	_nodes[node].parent = _freeNode;
+	_nodes[node].height = -1;
+	_freeNode = node;
+}
+
+void AABBTree::_replaceChild(uint32_t parent, uint32_t child, uint32_t replacement) {
+	_nodes[replacement].parent = parent;
+
+	if (parent == AABB_TREE_NULL)
+		_root = replacement;
+	else if (_nodes[parent].left == child)
+		_nodes[parent].left = replacement;
+	else
+		_nodes[parent].right = replacement;
+}
+
+void AABBTree::_insertLeaf(uint32_t leaf) {
+	if (_root == AABB_TREE_NULL) {
+		_root = leaf;
+		_nodes[leaf].parent = AABB_TREE_NULL;
+		return;
+	}
+
+	AABB leafAABB = _nodes[leaf].aabb;
+	uint32_t sibling = _root;
+
+	// descends while pushing leaf into a child costs less than new parent at this node
+	while (!_isLeaf(sibling)) {
+		const Node &node = _nodes[sibling];
+
+		float area = _area(node.aabb);
+		float combinedArea = _area(_merge(node.aabb, leafAABB));
+
+		float cost = 2.0f * combinedArea;
+		// every ancestor of new parent grows by the same
+		float inheritance = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		uint32_t children[2] = { node.left, node.right };
+
+		for (uint32_t i = 0; i < 2; i++) {
+			const Node &child = _nodes[children[i]];
+			float grown = _area(_merge(child.aabb, leafAABB));
+
+			if (!_isLeaf(children[i]))
+				grown -= _area(child.aabb);
+
+			childCosts[i] = grown + inheritance;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+
+		sibling = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	uint32_t oldParent = _nodes[sibling].parent;
+	uint32_t parent = _allocate();
+
+	_nodes[parent].aabb = _merge(_nodes[sibling].aabb, leafAABB);
+	_nodes[parent].left = sibling;
+	_nodes[parent].right = leaf;
+	_nodes[parent].height = _nodes[sibling].height + 1;
+
+	_replaceChild(oldParent, sibling, parent);
+	_nodes[sibling].parent = parent;
+	_nodes[leaf].parent = parent;
+
+	_refit(parent);
+}
+
+void AABBTree::_removeLeaf(uint32_t leaf) {
+	if (leaf == _root) {
+		_root = AABB_TREE_NULL;
+		return;
+	}
+
+	uint32_t parent = _nodes[leaf].parent;
+	uint32_t grandParent = _nodes[parent].parent;
+	uint32_t sibling = _nodes[parent].left == leaf ? _nodes[parent].right : _nodes[parent].left;
+
+	// sibling takes place of parent
+	_replaceChild(grandParent, parent, sibling);
+	_release(parent);
+
+	_refit(grandParent);
+}
+
+void AABBTree::_refit(uint32_t node) {
+	while (node != AABB_TREE_NULL) {
+		node = _balance(node);
+
+		Node &current = _nodes[node];
+		const Node &left = _nodes[current.left];
+		const Node &right = _nodes[current.right];
+
+		current.aabb = _merge(left.aabb, right.aabb);
+		current.height = 1 + std::max(left.height, right.height);
+
+		node = current.parent;
+	}
+}
+
+uint32_t AABBTree::_balance(uint32_t node) {
+	if (_isLeaf(node) || _nodes[node].height < 2)
+		return node;
+
+	int32_t balance = _nodes[_nodes[node].right].height - _nodes[_nodes[node].left].height;
+
+	if (balance > 1)
+		return _rotate(node, _nodes[node].right);
+
+	if (balance < -1)
+		return _rotate(node, _nodes[node].left);
+
+	return node;
+}
+
+uint32_t AABBTree::_rotate(uint32_t node, uint32_t child) {
+	uint32_t first = _nodes[child].left;
+	uint32_t second = _nodes[child].right;
+
+	// child is lifted into place of node, node becomes its left child
+	_replaceChild(_nodes[node].parent, node, child);
+	_nodes[child].left = node;
+	_nodes[node].parent = child;
+
+	// taller grandchild stays with child, the other one goes under node in place of child
+	bool isFirstTaller = _nodes[first].height > _nodes[second].height;
+	uint32_t kept = isFirstTaller ? first : second;
+	uint32_t moved = isFirstTaller ? second : first;
+
+	_nodes[child].right = kept;
+	_nodes[kept].parent = child;
+
+	if (_nodes[node].left == child)
+		_nodes[node].left = moved;
+	else
+		_nodes[node].right = moved;
+
+	_nodes[moved].parent = node;
+
+	Node &lowered = _nodes[node];
+	lowered.aabb = _merge(_nodes[lowered.left].aabb, _nodes[lowered.right].aabb);
+	lowered.height = 1 + std::max(_nodes[lowered.left].height, _nodes[lowered.right].height);
+
+	Node &lifted = _nodes[child];
+	lifted.aabb = _merge(lowered.aabb, _nodes[kept].aabb);
+	lifted.height = 1 + std::max(lowered.height, _nodes[kept].height);
+
+	return child;
+}
+
+uint32_t AABBTree::insert(const AABB &aabb, uint64_t userData) {
+	uint32_t leaf = _allocate();
+
+	_nodes[leaf].aabb = { aabb.min - AABB_TREE_MARGIN, aabb.max + AABB_TREE_MARGIN };
+	_nodes[leaf].userData = userData;
+
+	_insertLeaf(leaf);
+	_leafCount++;
+
+	return leaf;
+}
+
+bool AABBTree::update(uint32_t proxy, const AABB &aabb) {
+	const AABB &fat = _nodes[proxy].aabb;
+
+	// bounds that shrank well within fattened ones are refit too, so queries stay tight
+	float looseMargin = 4.0f * AABB_TREE_MARGIN;
+	AABB loose = { aabb.min - looseMargin, aabb.max + looseMargin };
+
+	if (_contains(fat, aabb) && _contains(loose, fat))
+		return false;
+
+	_removeLeaf(proxy);
+	_nodes[proxy].aabb = { aabb.min - AABB_TREE_MARGIN, aabb.max + AABB_TREE_MARGIN };
+	_insertLeaf(proxy);
+
+	return true;
+}
+
+void AABBTree::remove(uint32_t proxy) {
+	_removeLeaf(proxy);
+	_release(proxy);
+	_leafCount--;
+}
+
+void AABBTree::clear() {
+	_nodes.clear();
+	_root = AABB_TREE_NULL;
+	_freeNode = AABB_TREE_NULL;
+	_leafCount = 0;
+}
+
+uint64_t AABBTree::getUserData(uint32_t proxy) const {
+	return _nodes[proxy].userData;
+}
+
+const AABB &AABBTree::getFatAABB(uint32_t proxy) const {
+	return _nodes[proxy].aabb;
+}
+
+uint32_t AABBTree::getLeafCount() const {
+	return _leafCount;
+}
+
+void AABBTree::queryAABB(const AABB &aabb, std::vector<uint64_t> &results) const {
+	if (_root == AABB_TREE_NULL)
+		return;
+
+	std::vector<StackEntry> stack;
+	stack.reserve(64);
+	stack.push_back({ _root, 0 });
+
+	while (!stack.empty()) {
+		uint32_t index = stack.back().node;
+		stack.pop_back();
+
+		const Node &node = _nodes[index];
+
+		if (glm::any(glm::greaterThan(node.aabb.min, aabb.max)) ||
+				glm::any(glm::lessThan(node.aabb.max, aabb.min)))
+			continue;
+
+		if (_isLeaf(index)) {
+			results.push_back(node.userData);
+			continue;
+		}
+
+		stack.push_back({ node.left, 0 });
+		stack.push_back({ node.right, 0 });
+	}
+}
+
+void AABBTree::querySphere(
+		const glm::vec3 &center, float radius, std::vector<uint64_t> &results) const {
+	if (_root == AABB_TREE_NULL)
+		return;
+
+	std::vector<StackEntry> stack;
+	stack.reserve(64);
+	stack.push_back({ _root, 0 });
+
+	while (!stack.empty()) {
+		uint32_t index = stack.back().node;
+		stack.pop_back();
+
+		const Node &node = _nodes[index];
+		glm::vec3 offset = glm::clamp(center, node.aabb.min, node.aabb.max) - center;
+
+		if (glm::dot(offset, offset) > radius * radius)
+			continue;
+
+		if (_isLeaf(index)) {
+			results.push_back(node.userData);
+			continue;
+		}
+
+		stack.push_back({ node.left, 0 });
+		stack.push_back({ node.right, 0 });
+	}
+}
+
+void AABBTree::queryFrustum(const glm::vec4 *pPlanes, std::vector<uint64_t> &results) const {
+	if (_root == AABB_TREE_NULL)
+		return;
+
+	std::vector<StackEntry> stack;
+	stack.reserve(64);
+	stack.push_back({ _root, ALL_PLANES });
+
+	while (!stack.empty()) {
+		StackEntry entry = stack.back();
+		stack.pop_back();
+
+		const Node &node = _nodes[entry.node];
+
+		glm::vec3 center = node.aabb.center();
+		glm::vec3 extent = node.aabb.extent();
+
+		uint32_t planeMask = entry.planeMask;
+		bool isOutside = false;
+
+		for (uint32_t p = 0; p < PLANE_COUNT && !isOutside; p++) {
+			if ((planeMask & (1 << p)) == 0)
+				continue;
+
+			glm::vec3 normal = glm::vec3(pPlanes[p]);
+			float distance = glm::dot(normal, center) + pPlanes[p].w;
+			float radius = glm::dot(glm::abs(normal), extent);
+
+			isOutside = distance < -radius;
+
+			// children are inside this plane as well
+			if (distance >= radius)
+				planeMask &= ~(1 << p);
+		}
+
+		if (isOutside)
+			continue;
+
+		if (_isLeaf(entry.node)) {
+			results.push_back(node.userData);
+			continue;
+		}
+
+		stack.push_back({ node.left, planeMask });
+		stack.push_back({ node.right, planeMask });
+	}
+}
+
+void AABBTree::queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+		std::vector<uint64_t> &results) const {
+	if (_root == AABB_TREE_NULL)
+		return;
+
+	// infinite along axes ray does not move on, slabs of those pass or fail as a whole
+	glm::vec3 invDirection = 1.0f / direction;
+
+	std::vector<StackEntry> stack;
+	stack.reserve(64);
+	stack.push_back({ _root, 0 });
+
+	while (!stack.empty()) {
+		uint32_t index = stack.back().node;
+		stack.pop_back();
+
+		const Node &node = _nodes[index];
+
+		glm::vec3 t0 = (node.aabb.min - origin) * invDirection;
+		glm::vec3 t1 = (node.aabb.max - origin) * invDirection;
+
+		glm::vec3 tMin = glm::min(t0, t1);
+		glm::vec3 tMax = glm::max(t0, t1);
+
+		float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+		float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+
+		if (enter > exit)
+			continue;
+
+		if (_isLeaf(index)) {
+			results.push_back(node.userData);
+			continue;
+		}
+
+		stack.push_back({ node.left, 0 });
+		stack.push_back({ node.right, 0 });
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/types/aabb.h>
+
+// proxy which is not in tree
+const uint32_t AABB_TREE_NULL = UINT32_MAX;
+
+// leaves are fattened by this on every side, bounds moving within it leave tree untouched
+const float AABB_TREE_MARGIN = 0.1f;
+
+// Dynamic bounding volume hierarchy over world space AABBs, leaves carry user data of caller.
+// Leaf goes next to sibling growing surface area the least and tree is kept balanced by
+// rotations, so insert, update and remove cost log of leaf count and queries skip whole
+// subtrees. Leaves store fattened bounds, queries may report leaves a little outside of them.
+class AABBTree {
+private:
+	typedef struct {
+		AABB aabb;
+		uint64_t userData;
+
+		// next free node while node is free
+		uint32_t parent;
+		uint32_t left;
+		// AABB_TREE_NULL for leaf
+		uint32_t right;
+
+		// 0 for leaf, -1 for free node
+		int32_t height;
+	} Node;
+
+	typedef struct {
+		uint32_t node;
+		// frustum planes node is not yet known to be inside of
+		uint32_t planeMask;
+	} StackEntry;
+
+	std::vector<Node> _nodes;
+	uint32_t _root = AABB_TREE_NULL;
+	uint32_t _freeNode = AABB_TREE_NULL;
+	uint32_t _leafCount = 0;
+
+	static AABB _merge(const AABB &a, const AABB &b);
+	static float _area(const AABB &aabb);
+	static bool _contains(const AABB &outer, const AABB &inner);
+
+	bool _isLeaf(uint32_t node) const;
+	uint32_t _allocate();
+	void _release(uint32_t node);
+
+	void _replaceChild(uint32_t parent, uint32_t child, uint32_t replacement);
+	void _insertLeaf(uint32_t leaf);
+	void _removeLeaf(uint32_t leaf);
+	// walks to root, balancing and refitting every node on the way
+	void _refit(uint32_t node);
+	// returns node now in place of given one
+	uint32_t _balance(uint32_t node);
+	uint32_t _rotate(uint32_t node, uint32_t child);
+
+public:
+	uint32_t insert(const AABB &aabb, uint64_t userData);
+	// returns true when leaf was moved, bounds still inside fattened ones keep it in place
+	bool update(uint32_t proxy, const AABB &aabb);
+	void remove(uint32_t proxy);
+	void clear();
+
+	uint64_t getUserData(uint32_t proxy) const;
+	const AABB &getFatAABB(uint32_t proxy) const;
+	uint32_t getLeafCount() const;
+
+	// queries append user data of leaves they touch, in no particular order, they only read tree
+	// and may run on several threads at once
+	void queryAABB(const AABB &aabb, std::vector<uint64_t> &results) const;
+	void querySphere(const glm::vec3 &center, float radius, std::vector<uint64_t> &results) const;
+	// planes as extracted by FrustumCuller, subtrees inside every plane are not tested further
+	void queryFrustum(const glm::vec4 *pPlanes, std::vector<uint64_t> &results) const;
+	// direction needs not be normalized, distance is in its lengths
+	void queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+			std::vector<uint64_t> &results) const;
+};
+
+#endif // !AABB_TREE_H
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+
+#include <rendering/shaders/depth_reduce.gen.h>
+
+#include "depth_pyramid.h"
+
+const vk::Format FORMAT = vk::Format::eR32Sfloat;
+const uint32_t GROUP_SIZE = 16;
+
+static uint32_t previousPowerOfTwo(uint32_t value) {
+	uint32_t result = 1;
+
+	while (result * 2 <= value)
+		result *= 2;
+
+	return result;
+}
+
+void DepthPyramid::_create(uint32_t width, uint32_t height) {
+	RD &rd = RD::getSingleton();
+
+	// power of two keeps every level exactly half of previous one
+	_width = previousPowerOfTwo(width);
+	_height = previousPowerOfTwo(height);
+
+	_levelCount = 1;
+	while ((std::max(_width, _height) >> _levelCount) > 0)
+		_levelCount++;
+
+	_levelCount = std::min(_levelCount, MAX_PYRAMID_LEVEL_COUNT);
+
+	_image = rd.imageCreate(MemoryCategory::RenderTarget, _width, _height, FORMAT, _levelCount,
+			vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+
+	rd.imageLayoutTransition(_image.image, FORMAT, _levelCount, 1, vk::ImageLayout::eUndefined,
+			vk::ImageLayout::eGeneral);
+
+	_imageView = rd.imageViewCreate(_image.image, FORMAT, _levelCount);
+
+	for (uint32_t i = 0; i < _levelCount; i++) {
+		vk::ImageSubresourceRange subresourceRange;
+		subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		subresourceRange.setBaseMipLevel(i);
+		subresourceRange.setLevelCount(1);
+		subresourceRange.setBaseArrayLayer(0);
+		subresourceRange.setLayerCount(1);
+
+		vk::ImageViewCreateInfo createInfo;
+		createInfo.setImage(_image.image);
+		createInfo.setViewType(vk::ImageViewType::e2D);
+		createInfo.setFormat(FORMAT);
+		createInfo.setSubresourceRange(subresourceRange);
+
+		_levelViews[i] = _device.createImageView(createInfo);
+	}
+
+	for (uint32_t i = 0; i < _levelCount; i++) {
+		vk::DescriptorImageInfo srcInfo;
+		srcInfo.setSampler(_sampler);
+
+		if (i == 0) {
+			srcInfo.setImageView(_depthView);
+			srcInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		} else {
+			srcInfo.setImageView(_levelViews[i - 1]);
+			srcInfo.setImageLayout(vk::ImageLayout::eGeneral);
+		}
+
+		vk::DescriptorImageInfo dstInfo;
+		dstInfo.setImageView(_levelViews[i]);
+		dstInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+		std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+		writeInfos[0].setDstSet(_sets[i]);
+		writeInfos[0].setDstBinding(0);
+		writeInfos[0].setDstArrayElement(0);
+		writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfos[0].setDescriptorCount(1);
+		writeInfos[0].setImageInfo(srcInfo);
+
+		writeInfos[1].setDstSet(_sets[i]);
+		writeInfos[1].setDstBinding(1);
+		writeInfos[1].setDstArrayElement(0);
+		writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+		writeInfos[1].setDescriptorCount(1);
+		writeInfos[1].setImageInfo(dstInfo);
+
+		_device.updateDescriptorSets(writeInfos, nullptr);
+	}
+
+	MipGenerator &mipGenerator = rd.getMipGenerator();
+	_isGenerated = _levelCount > 1 && mipGenerator.isSupported(FORMAT, _width, _height);
+
+	if (_isGenerated)
+		_mipTarget = mipGenerator.targetCreate(_image.image, FORMAT, _width, _height, _levelCount);
+
+	_isBuilt = false;
+}
+
+void DepthPyramid::_destroy() {
+	if (_levelCount == 0)
+		return;
+
+	RD &rd = RD::getSingleton();
+
+	if (_isGenerated)
+		rd.getMipGenerator().targetDestroy(_mipTarget);
+
+	for (uint32_t i = 0; i < _levelCount; i++)
+		_device.destroyImageView(_levelViews[i]);
+
+	rd.imageViewDestroy(_imageView);
+	rd.imageDestroy(_image);
+
+	_levelCount = 0;
+	_isGenerated = false;
+	_isBuilt = false;
+}
+
+bool DepthPyramid::ensure(const Attachment &depth, vk::Extent2D extent) {
+	if (depth.getImageView() == _depthView && extent == _depthExtent)
+		return false;
+
+	// earlier frames may still read pyramid and sets
+	RD::getSingleton().framesInFlightWait();
+
+	_destroy();
+
+	_depthView = depth.getImageView();
+	_depthExtent = extent;
+
+	_create(extent.width, extent.height);
+	return true;
+}
+
+void DepthPyramid::build(
+		vk::CommandBuffer commandBuffer, const Attachment &depth, vk::Extent2D drawn) {
+	if (depth.getImageView() != _depthView)
+		return;
+
+	vk::ImageSubresourceRange depthRange;
+	depthRange.setAspectMask(vk::ImageAspectFlagBits::eDepth);
+	depthRange.setBaseMipLevel(0);
+	depthRange.setLevelCount(1);
+	depthRange.setBaseArrayLayer(0);
+	depthRange.setLayerCount(1);
+
+	vk::ImageMemoryBarrier depthBarrier;
+	depthBarrier.setOldLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+	depthBarrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	depthBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	depthBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	depthBarrier.setImage(depth.getImage());
+	depthBarrier.setSubresourceRange(depthRange);
+	depthBarrier.setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+	depthBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+	// previous reads of pyramid, by culling, have to finish before it is overwritten
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests |
+										  vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, depthBarrier);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+
+	uint32_t srcWidth = std::min(drawn.width, _depthExtent.width);
+	uint32_t srcHeight = std::min(drawn.height, _depthExtent.height);
+
+	// generator takes over after first level
+	uint32_t reducedCount = _isGenerated ? 1 : _levelCount;
+
+	for (uint32_t i = 0; i < reducedCount; i++) {
+		uint32_t dstWidth = std::max(_width >> i, 1u);
+		uint32_t dstHeight = std::max(_height >> i, 1u);
+
+		ReduceConstants constants = {};
+		constants.srcSize[0] = srcWidth;
+		constants.srcSize[1] = srcHeight;
+		constants.dstSize[0] = dstWidth;
+		constants.dstSize[1] = dstHeight;
+
+		commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _sets[i], nullptr);
+		commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+				sizeof(ReduceConstants), &constants);
+
+		uint32_t groupCountX = (dstWidth + GROUP_SIZE - 1) / GROUP_SIZE;
+		uint32_t groupCountY = (dstHeight + GROUP_SIZE - 1) / GROUP_SIZE;
+		commandBuffer.dispatch(groupCountX, groupCountY, 1);
+
+		// counters of generator are cleared by transfer, previous build has to be done with them
+		vk::MemoryBarrier barrier;
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+				vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+				{}, barrier, nullptr, nullptr);
+
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
+
+	if (_isGenerated) {
+		RD::getSingleton().getMipGenerator().record(
+				commandBuffer, _mipTarget, MipGenerator::Reduction::Min);
+
+		vk::MemoryBarrier barrier;
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+				vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+	}
+
+	// depth is cleared by next render pass, only reads have to be finished
+	depthBarrier.setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	depthBarrier.setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+	depthBarrier.setSrcAccessMask({});
+	depthBarrier.setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eEarlyFragmentTests, {}, nullptr, nullptr, depthBarrier);
+
+	_isBuilt = true;
+}
+
+vk::ImageView DepthPyramid::getImageView() const {
+	return _imageView;
+}
+
+vk::Sampler DepthPyramid::getSampler() const {
+	return _sampler;
+}
+
+uint32_t DepthPyramid::getWidth() const {
+	return _width;
+}
+
+uint32_t DepthPyramid::getHeight() const {
+	return _height;
+}
+
+uint32_t DepthPyramid::getLevelCount() const {
+	return _levelCount;
+}
+
+bool DepthPyramid::isBuilt() const {
+	return _isBuilt;
+}
+
+void DepthPyramid::initialize(vk::Device device, vk::DescriptorPool descriptorPool) {
+	if (_initialized)
+		return;
+
+	_device = device;
+
+	std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {};
+	bindings[0].setBinding(0);
+	bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	bindings[0].setDescriptorCount(1);
+	bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	bindings[1].setBinding(1);
+	bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+	bindings[1].setDescriptorCount(1);
+	bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Depth pyramid descriptor set layout creation failed!");
+
+	std::array<vk::DescriptorSetLayout, MAX_PYRAMID_LEVEL_COUNT> layouts;
+	layouts.fill(_setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Depth pyramid descriptor set allocation failed!");
+
+	// texels are fetched and reduced manually, sampler only has to be nearest
+	vk::SamplerCreateInfo samplerInfo;
+	samplerInfo.setMagFilter(vk::Filter::eNearest);
+	samplerInfo.setMinFilter(vk::Filter::eNearest);
+	samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+	samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setMinLod(0.0f);
+	samplerInfo.setMaxLod(static_cast<float>(MAX_PYRAMID_LEVEL_COUNT));
+
+	_sampler = device.createSampler(samplerInfo);
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(ReduceConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	DepthReduceShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Depth reduce compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
@@ -0,0 +1,73 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/mip_generator.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+
+const uint32_t MAX_PYRAMID_LEVEL_COUNT = 16;
+
+// Hierarchical depth, each texel holds furthest depth of area it covers. First level is reduced
+// from depth, the rest come from one MipGenerator dispatch when pyramid fits in it.
+class DepthPyramid {
+private:
+	struct ReduceConstants {
+		uint32_t srcSize[2];
+		uint32_t dstSize[2];
+	};
+
+	vk::Device _device;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_PYRAMID_LEVEL_COUNT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	vk::Sampler _sampler;
+
+	AllocatedImage _image;
+	vk::ImageView _imageView;
+	vk::ImageView _levelViews[MAX_PYRAMID_LEVEL_COUNT];
+
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	uint32_t _levelCount = 0;
+
+	// levels after first one, when format and size allow it
+	MipGenerator::Target _mipTarget;
+	bool _isGenerated = false;
+
+	// source depth and its size, pyramid is recreated when either changes
+	vk::ImageView _depthView;
+	vk::Extent2D _depthExtent;
+
+	bool _isBuilt = false;
+	bool _initialized = false;
+
+	void _create(uint32_t width, uint32_t height);
+	void _destroy();
+
+public:
+	// returns true when pyramid was recreated, frames in flight are waited for before it is
+	bool ensure(const Attachment &depth, vk::Extent2D extent);
+	// drawn part of depth at its top left, at most extent of ensure, covers whole pyramid
+	void build(vk::CommandBuffer commandBuffer, const Attachment &depth, vk::Extent2D drawn);
+
+	vk::ImageView getImageView() const;
+	vk::Sampler getSampler() const;
+
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+	uint32_t getLevelCount() const;
+
+	bool isBuilt() const;
+
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool);
+};
+
+#endif // !DEPTH_PYRAMID_H
@@ -0,0 +1,97 @@
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum_culler.h"
+
+const uint32_t PLANE_COUNT = 6;
+
+void FrustumCuller::extractPlanes(const glm::mat4 &projView, glm::vec4 *pPlanes) {
+	// Gribb-Hartmann, rows of column-major matrix
+	glm::vec4 row0(projView[0][0], projView[1][0], projView[2][0], projView[3][0]);
+	glm::vec4 row1(projView[0][1], projView[1][1], projView[2][1], projView[3][1]);
+	glm::vec4 row2(projView[0][2], projView[1][2], projView[2][2], projView[3][2]);
+	glm::vec4 row3(projView[0][3], projView[1][3], projView[2][3], projView[3][3]);
+
+	pPlanes[0] = row3 + row0; // left
+	pPlanes[1] = row3 - row0; // right
+	pPlanes[2] = row3 + row1; // bottom
+	pPlanes[3] = row3 - row1; // top
+
+	// Vulkan clip space depth is in [0, w], holds for reverse Z as well
+	pPlanes[4] = row2;
+	pPlanes[5] = row3 - row2;
+
+	for (uint32_t i = 0; i < PLANE_COUNT; i++) {
+		float length = glm::length(glm::vec3(pPlanes[i]));
+		pPlanes[i] /= length;
+	}
+}
+
+void FrustumCuller::clear() {
+	_minX.clear();
+	_minY.clear();
+	_minZ.clear();
+
+	_maxX.clear();
+	_maxY.clear();
+	_maxZ.clear();
+}
+
+void FrustumCuller::add(const AABB &aabb) {
+	_minX.push_back(aabb.min.x);
+	_minY.push_back(aabb.min.y);
+	_minZ.push_back(aabb.min.z);
+
+	_maxX.push_back(aabb.max.x);
+	_maxY.push_back(aabb.max.y);
+	_maxZ.push_back(aabb.max.z);
+}
+
+uint32_t FrustumCuller::size() const {
+	return static_cast<uint32_t>(_minX.size());
+}
+
+void FrustumCuller::cull(const glm::mat4 &projView, std::vector<uint32_t> &visible) {
+	glm::vec4 planes[PLANE_COUNT];
+	extractPlanes(projView, planes);
+
+	uint32_t count = size();
+	_mask.resize(count);
+
+	const float *pMinX = _minX.data();
+	const float *pMinY = _minY.data();
+	const float *pMinZ = _minZ.data();
+
+	const float *pMaxX = _maxX.data();
+	const float *pMaxY = _maxY.data();
+	const float *pMaxZ = _maxZ.data();
+
+	uint8_t *pMask = _mask.data();
+
+	for (uint32_t i = 0; i < count; i++)
+		pMask[i] = 1;
+
+	// one plane per pass keeps the inner loop branchless and vectorizable
+	for (uint32_t p = 0; p < PLANE_COUNT; p++) {
+		const glm::vec4 plane = planes[p];
+
+		for (uint32_t i = 0; i < count; i++) {
+			// test corner furthest along plane normal
+			float x = plane.x > 0.0f ? pMaxX[i] : pMinX[i];
+			float y = plane.y > 0.0f ? pMaxY[i] : pMinY[i];
+			float z = plane.z > 0.0f ? pMaxZ[i] : pMinZ[i];
+
+			float distance = plane.x * x + plane.y * y + plane.z * z + plane.w;
+			pMask[i] &= static_cast<uint8_t>(distance >= 0.0f);
+		}
+	}
+
+	visible.clear();
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (pMask[i] != 0)
+			visible.push_back(i);
+	}
+}
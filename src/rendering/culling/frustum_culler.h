@@ -0,0 +1,36 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/types/aabb.h>
+
+// Tests world space AABBs against view frustum. Bounds are kept as structure of arrays, so the
+// plane tests compile to straight vector code.
+class FrustumCuller {
+private:
+	std::vector<float> _minX;
+	std::vector<float> _minY;
+	std::vector<float> _minZ;
+
+	std::vector<float> _maxX;
+	std::vector<float> _maxY;
+	std::vector<float> _maxZ;
+
+	std::vector<uint8_t> _mask;
+
+public:
+	static void extractPlanes(const glm::mat4 &projView, glm::vec4 *pPlanes);
+
+	void clear();
+	void add(const AABB &aabb);
+	uint32_t size() const;
+
+	// writes indices of bounds intersecting frustum into visible
+	void cull(const glm::mat4 &projView, std::vector<uint32_t> &visible);
+};
+
+#endif // !FRUSTUM_CULLER_H
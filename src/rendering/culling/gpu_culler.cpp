@@ -0,0 +1,511 @@
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/render_queue.h>
+#include <rendering/rendering_device.h>
+
+#include <rendering/shaders/cull.gen.h>
+
+#include "frustum_culler.h"
+
+#include "gpu_culler.h"
+
+const uint32_t GROUP_SIZE = 64;
+
+// item drawn only at full detail
+const uint32_t INVALID_COMMAND = UINT32_MAX;
+
+// cone is kept only under rotation and uniform scale, mirroring flips winding
+static void _transformMeshlet(
+		const glm::mat4 &transform, const Meshlet &meshlet, glm::vec4 &sphere, glm::vec4 &cone) {
+	glm::mat3 basis(transform);
+	glm::vec3 scales(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+	float scale = glm::max(glm::max(scales.x, scales.y), scales.z);
+
+	glm::vec3 center = glm::vec3(transform * glm::vec4(meshlet.center, 1.0f));
+	sphere = glm::vec4(center, meshlet.radius * scale);
+	cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	glm::vec3 tolerance(scale * 1e-3f);
+	bool isUniform = glm::all(glm::lessThanEqual(glm::abs(scales - scale), tolerance));
+
+	if (meshlet.coneCutoff >= 1.0f || !isUniform || glm::determinant(basis) <= 0.0f)
+		return;
+
+	cone = glm::vec4(glm::normalize(basis * meshlet.coneAxis), meshlet.coneCutoff);
+}
+
+void GpuCuller::update(const RenderQueue &queue) {
+	_instances.clear();
+	_templates.clear();
+	_batchCommands.clear();
+
+	const std::vector<DrawItem> &items = queue.items();
+	const std::vector<DrawBatch> &batches = queue.batches();
+
+	uint32_t instanceCount = 0;
+
+	for (const DrawBatch &batch : batches)
+		instanceCount += batch.instanceCount;
+
+	// every extra command takes slot per instance, levels of detail come first, then meshlets
+	uint64_t spareSlotCount = MAX_INSTANCE_COUNT - glm::min(instanceCount, MAX_INSTANCE_COUNT);
+	uint32_t slot = 0;
+
+	for (const DrawBatch &batch : batches) {
+		const PrimitiveRD *pPrimitive = batch.pPrimitive;
+
+		uint32_t lodCount = 0;
+		uint32_t meshletCount = 0;
+
+		// primitive without levels of its own is drawn whole at every level of mesh
+		if (pPrimitive != nullptr && !pPrimitive->lods.empty()) {
+			lodCount = glm::min(static_cast<uint32_t>(batch.pMesh->lodErrors.size()), MAX_LOD_COUNT);
+			uint64_t extraSlotCount = uint64_t(batch.instanceCount) * lodCount;
+
+			if (extraSlotCount <= spareSlotCount)
+				spareSlotCount -= extraSlotCount;
+			else
+				lodCount = 0;
+		}
+
+		if (pPrimitive != nullptr && pPrimitive->meshlets.size() > 1) {
+			uint32_t count = static_cast<uint32_t>(pPrimitive->meshlets.size());
+			uint64_t extraSlotCount = uint64_t(batch.instanceCount) * (count - 1);
+
+			if (extraSlotCount <= spareSlotCount) {
+				spareSlotCount -= extraSlotCount;
+				meshletCount = count;
+			}
+		}
+
+		bool isSplit = meshletCount > 0;
+
+		// full detail commands, one per meshlet when split, followed by one per level
+		uint32_t firstCommand = static_cast<uint32_t>(_templates.size());
+		uint32_t commandCount = isSplit ? meshletCount : 1;
+		uint32_t lodCommand = firstCommand + commandCount;
+
+		_batchCommands.push_back(firstCommand);
+
+		for (uint32_t i = 0; i < commandCount + lodCount; i++) {
+			uint32_t indexCount = batch.indexCount;
+			uint32_t firstIndex = batch.firstIndex;
+
+			if (i >= commandCount) {
+				uint32_t lod = glm::min(i - commandCount, uint32_t(pPrimitive->lods.size() - 1));
+
+				indexCount = pPrimitive->lods[lod].indexCount;
+				firstIndex = pPrimitive->lods[lod].firstIndex;
+			} else if (isSplit) {
+				indexCount = pPrimitive->meshlets[i].indexCount;
+				firstIndex = pPrimitive->meshlets[i].firstIndex;
+			}
+
+			vk::DrawIndexedIndirectCommand command = {};
+			command.setIndexCount(indexCount);
+			command.setInstanceCount(0);
+			command.setFirstIndex(firstIndex);
+			command.setVertexOffset(batch.vertexOffset);
+			command.setFirstInstance(slot);
+
+			_templates.push_back(command);
+			slot += batch.instanceCount;
+		}
+
+		// batching keeps item order, item n is instance n of queue
+		for (uint32_t j = 0; j < batch.instanceCount; j++) {
+			const MeshInstanceRD *pMeshInstance = items[batch.firstInstance + j].pMeshInstance;
+
+			glm::mat3 basis = glm::mat3(pMeshInstance->transform);
+			float scale = glm::max(glm::max(glm::length(basis[0]), glm::length(basis[1])),
+					glm::length(basis[2]));
+
+			InstanceData instance = {};
+			instance.transform = pMeshInstance->drawTransform;
+			instance.normal = pMeshInstance->normalTransform;
+			instance.aabbMin = glm::vec4(pMeshInstance->aabb.min, 1.0f);
+			instance.aabbMax = glm::vec4(pMeshInstance->aabb.max, 1.0f);
+			instance.sphere = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+			instance.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			instance.material = items[batch.firstInstance + j].materialIndex;
+			instance.lodCount = lodCount;
+
+			for (uint32_t i = 0; i < lodCount; i++)
+				instance.lodErrors[i] = batch.pMesh->lodErrors[i] * scale;
+
+			for (uint32_t i = 0; i < commandCount; i++) {
+				instance.command = firstCommand + i;
+
+				// coarser level of split instance is drawn by its first item only
+				instance.lodCommand = i == 0 ? lodCommand : INVALID_COMMAND;
+
+				if (isSplit) {
+					_transformMeshlet(pMeshInstance->transform, pPrimitive->meshlets[i],
+							instance.sphere, instance.cone);
+				}
+
+				_instances.push_back(instance);
+			}
+		}
+	}
+
+	_batchCommands.push_back(static_cast<uint32_t>(_templates.size()));
+	_generation++;
+}
+
+void GpuCuller::_updatePyramidSets() {
+	vk::DescriptorImageInfo imageInfo;
+	imageInfo.setSampler(_pyramid.getSampler());
+	imageInfo.setImageView(_pyramid.getImageView());
+	imageInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+	for (uint32_t i = 0; i < RD::getSingleton().getFramesInFlight(); i++) {
+		vk::WriteDescriptorSet writeInfo;
+		writeInfo.setDstSet(_sets[i]);
+		writeInfo.setDstBinding(4);
+		writeInfo.setDstArrayElement(0);
+		writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfo.setDescriptorCount(1);
+		writeInfo.setImageInfo(imageInfo);
+
+		_device.updateDescriptorSets(writeInfo, nullptr);
+	}
+}
+
+void GpuCuller::dispatch(vk::CommandBuffer commandBuffer, uint32_t frame,
+		const glm::mat4 &projView, const glm::vec3 &cameraPosition, float lodScale) {
+	RD &rd = RD::getSingleton();
+
+	// pyramid waits for frames in flight when recreated, so sets are not in use here
+	if (_pyramid.ensure(rd.getDepthAttachment(), rd.getAttachmentExtent()))
+		_updatePyramidSets();
+
+	rd.bufferInvalidate(_statsBuffers[frame]);
+	memcpy(&_stats, _statsAllocInfos[frame].pMappedData, sizeof(CullStats));
+
+	if (_uploadedGenerations[frame] != _generation) {
+		memcpy(_instanceAllocInfos[frame].pMappedData, _instances.data(),
+				sizeof(InstanceData) * _instances.size());
+		memcpy(_templateAllocInfos[frame].pMappedData, _templates.data(),
+				sizeof(vk::DrawIndexedIndirectCommand) * _templates.size());
+
+		_uploadedGenerations[frame] = _generation;
+	}
+
+	if (_templates.empty())
+		return;
+
+	CullUniforms uniforms = {};
+	FrustumCuller::extractPlanes(projView, uniforms.planes);
+	uniforms.pyramidProjView = _pyramidProjView;
+	uniforms.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+	uniforms.pyramidSize = glm::vec2(_pyramid.getWidth(), _pyramid.getHeight());
+	uniforms.pyramidLevelCount = _pyramid.getLevelCount();
+	uniforms.instanceCount = static_cast<uint32_t>(_instances.size());
+	uniforms.useOcclusion = _pyramid.isBuilt();
+	uniforms.lodScale = lodScale / LOD_PIXEL_ERROR;
+	uniforms.lodHysteresis = LOD_HYSTERESIS;
+
+	memcpy(_uniformAllocInfos[frame].pMappedData, &uniforms, sizeof(CullUniforms));
+
+	// levels of detail are written by every frame, previous dispatch has to finish first
+	vk::MemoryBarrier lodBarrier;
+	lodBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	lodBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite |
+								vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader, {},
+			lodBarrier, nullptr, nullptr);
+
+	// items moved, levels start from full detail
+	if (_lodGeneration != _generation) {
+		commandBuffer.fillBuffer(_lodBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+		_lodGeneration = _generation;
+	}
+
+	commandBuffer.fillBuffer(_statsBuffers[frame].buffer, 0, sizeof(CullStats), 0);
+
+	// reset instance counts
+	vk::BufferCopy copyInfo;
+	copyInfo.setSrcOffset(0);
+	copyInfo.setDstOffset(0);
+	copyInfo.setSize(sizeof(vk::DrawIndexedIndirectCommand) * _templates.size());
+
+	commandBuffer.copyBuffer(
+			_templateBuffers[frame].buffer, _commandBuffers[frame].buffer, copyInfo);
+
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _sets[frame], nullptr);
+
+	uint32_t groupCount = (uniforms.instanceCount + GROUP_SIZE - 1) / GROUP_SIZE;
+	commandBuffer.dispatch(groupCount, 1, 1);
+
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead |
+							 vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eHostRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader |
+					vk::PipelineStageFlagBits::eHost,
+			{}, barrier, nullptr, nullptr);
+}
+
+void GpuCuller::buildDepthPyramid(vk::CommandBuffer commandBuffer, const glm::mat4 &projView) {
+	RD &rd = RD::getSingleton();
+	_pyramid.build(commandBuffer, rd.getDepthAttachment(), rd.getRenderExtent());
+	_pyramidProjView = projView;
+}
+
+void GpuCuller::draw(vk::CommandBuffer commandBuffer, uint32_t frame, const RenderQueue &queue,
+		vk::PipelineLayout pipelineLayout, const ObjectOwner<TextureSetRD> *pTextureSets,
+		bool bindPipelines, DrawStats &stats) const {
+	stats = {};
+
+	RD &rd = RD::getSingleton();
+
+	const std::vector<DrawBatch> &batches = queue.batches();
+	const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+	const GeometryArena &geometryArena = rd.getGeometryArena();
+	geometryArena.bind(commandBuffer);
+	stats.meshBindCount = 1;
+
+	vk::IndexType boundIndexType = vk::IndexType::eUint32;
+	vk::Pipeline boundPipeline = VK_NULL_HANDLE;
+
+	uint32_t scenePermutation = rd.getScenePermutation();
+
+	// distance of instances is known on GPU only, rate follows material alone
+	bool setShadingRate = bindPipelines && rd.getShadingRateMode() != ShadingRateMode::Off;
+	vk::Extent2D boundShadingRate = vk::Extent2D(0, 0);
+
+	vk::Buffer buffer = _commandBuffers[frame].buffer;
+
+	uint32_t i = 0;
+
+	while (i < batches.size()) {
+		const DrawBatch &batch = batches[i];
+
+		// geometry is shared, only material, permutation and index type split commands
+		vk::IndexType indexType = batch.pMesh->geometry.indexType;
+
+		uint32_t count = 1;
+		while (i + count < batches.size() &&
+				batches[i + count].pMesh->geometry.indexType == indexType &&
+				(pTextureSets == nullptr || batches[i + count].textureSetId == batch.textureSetId) &&
+				(!bindPipelines || batches[i + count].permutation == batch.permutation))
+			count++;
+
+		if (bindPipelines) {
+			vk::Pipeline pipeline = rd.getMaterialPipeline(batch.permutation | scenePermutation);
+
+			if (pipeline != boundPipeline) {
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+				boundPipeline = pipeline;
+				stats.pipelineBindCount++;
+			}
+		}
+
+		if (setShadingRate) {
+			vk::Extent2D shadingRate = rd.getShadingRate(batch.permutation, false);
+
+			if (shadingRate != boundShadingRate) {
+				rd.setShadingRate(commandBuffer, shadingRate);
+				boundShadingRate = shadingRate;
+			}
+		}
+
+		if (indexType != boundIndexType) {
+			geometryArena.bindIndices(commandBuffer, indexType);
+			boundIndexType = indexType;
+			stats.meshBindCount++;
+		}
+
+		if (pTextureSets != nullptr && batch.textureSetId != 0) {
+			rd.textureSetBind(commandBuffer, pipelineLayout, (*pTextureSets)[batch.textureSetId]);
+			stats.materialBindCount++;
+			stats.setBindCount++;
+		}
+
+		// commands of consecutive batches are consecutive too
+		uint32_t firstCommand = _batchCommands[i];
+		uint32_t commandCount = _batchCommands[i + count] - firstCommand;
+
+		if (_isMultiDrawSupported) {
+			commandBuffer.drawIndexedIndirect(buffer, firstCommand * stride, commandCount, stride);
+			stats.drawCount++;
+		} else {
+			for (uint32_t j = 0; j < commandCount; j++) {
+				commandBuffer.drawIndexedIndirect(
+						buffer, (firstCommand + j) * stride, 1, stride);
+			}
+
+			stats.drawCount += commandCount;
+		}
+
+		for (uint32_t j = 0; j < count; j++)
+			stats.instanceCount += batches[i + j].instanceCount;
+
+		i += count;
+	}
+
+	if (stats.drawCount > stats.meshBindCount)
+		stats.meshBindSkipCount = stats.drawCount - stats.meshBindCount;
+}
+
+CullStats GpuCuller::getStats() const {
+	return _stats;
+}
+
+void GpuCuller::initialize(vk::Device device, vk::DescriptorPool descriptorPool, bool multiDraw) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_isMultiDrawSupported = multiDraw;
+
+	RD &rd = RD::getSingleton();
+
+	_pyramid.initialize(device, descriptorPool);
+
+	std::array<vk::DescriptorSetLayoutBinding, 9> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	bindings[3].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+	bindings[4].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Cull descriptor set layout creation failed!");
+
+	uint32_t framesInFlight = RD::getSingleton().getFramesInFlight();
+
+	std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Cull descriptor set allocation failed!");
+
+	_lodBuffer = rd.bufferCreate(MemoryCategory::Other, BufferClass::Static,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			sizeof(uint32_t) * MAX_INSTANCE_COUNT);
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_instanceBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+				vk::BufferUsageFlagBits::eStorageBuffer,
+				sizeof(InstanceData) * MAX_INSTANCE_COUNT, &_instanceAllocInfos[i]);
+
+		_templateBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Staging,
+				vk::BufferUsageFlagBits::eTransferSrc,
+				sizeof(vk::DrawIndexedIndirectCommand) * MAX_INSTANCE_COUNT,
+				&_templateAllocInfos[i]);
+
+		_commandBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Static,
+				vk::BufferUsageFlagBits::eStorageBuffer |
+						vk::BufferUsageFlagBits::eIndirectBuffer |
+						vk::BufferUsageFlagBits::eTransferDst,
+				sizeof(vk::DrawIndexedIndirectCommand) * MAX_INSTANCE_COUNT);
+
+		_uniformBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+				vk::BufferUsageFlagBits::eUniformBuffer,
+				sizeof(CullUniforms), &_uniformAllocInfos[i]);
+
+		_statsBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Readback,
+				vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+				sizeof(CullStats), &_statsAllocInfos[i]);
+
+		memset(_statsAllocInfos[i].pMappedData, 0, sizeof(CullStats));
+
+		std::array<vk::DescriptorBufferInfo, 8> bufferInfos = {
+			_instanceBuffers[i].getBufferInfo(),
+			_commandBuffers[i].getBufferInfo(),
+			rd.getInstanceBuffer(i).getBufferInfo(),
+			_uniformBuffers[i].getBufferInfo(),
+			_statsBuffers[i].getBufferInfo(),
+			rd.getInstanceMaterialBuffer(i).getBufferInfo(),
+			_lodBuffer.getBufferInfo(),
+			rd.getInstanceNormalBuffer(i).getBufferInfo(),
+		};
+
+		// pyramid sampler is written once pyramid exists
+		std::array<uint32_t, 8> bindingIndices = { 0, 1, 2, 3, 5, 6, 7, 8 };
+
+		std::array<vk::WriteDescriptorSet, 8> writeInfos = {};
+
+		for (uint32_t j = 0; j < writeInfos.size(); j++) {
+			writeInfos[j].setDstSet(_sets[i]);
+			writeInfos[j].setDstBinding(bindingIndices[j]);
+			writeInfos[j].setDstArrayElement(0);
+			writeInfos[j].setDescriptorType(bindings[bindingIndices[j]].descriptorType);
+			writeInfos[j].setDescriptorCount(1);
+			writeInfos[j].setBufferInfo(bufferInfos[j]);
+		}
+
+		device.updateDescriptorSets(writeInfos, nullptr);
+	}
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	CullShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Cull compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
@@ -0,0 +1,139 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/object_owner.h>
+#include <rendering/render_queue.h>
+#include <rendering/rendering_device.h>
+#include <rendering/types/allocated.h>
+
+#include "depth_pyramid.h"
+
+struct CullStats {
+	uint32_t drawnCount = 0;
+	uint32_t frustumCulledCount = 0;
+	uint32_t occlusionCulledCount = 0;
+	uint32_t backfaceCulledCount = 0;
+};
+
+// Frustum and occlusion culls instances in compute and fills indirect draw commands, drawn
+// transforms and material indices are written into instance buffers of RenderingDevice. Occlusion is tested against
+// depth pyramid of previous frame. Primitives with meshlets are culled per meshlet, every
+// meshlet has its own command and is also rejected when its normal cone faces away from camera.
+// Level of detail is selected per instance by projected error, every level has its own command.
+class GpuCuller {
+private:
+	// one per meshlet of split instance
+	struct InstanceData {
+		InstanceTransform transform;
+		InstanceTransform normal;
+		glm::vec4 aabbMin;
+		glm::vec4 aabbMax;
+
+		// world space, w of sphere is radius and is negative for instance drawn whole
+		glm::vec4 sphere;
+		glm::vec4 cone;
+
+		// world space error of levels after full detail one
+		glm::vec4 lodErrors;
+
+		uint32_t command;
+		uint32_t material;
+
+		// command of first coarser level, full detail one is in command
+		uint32_t lodCommand;
+		uint32_t lodCount;
+	};
+	static_assert(sizeof(InstanceData) % 16 == 0, "InstanceData is not multiple of 16");
+
+	struct CullUniforms {
+		glm::vec4 planes[6];
+		glm::mat4 pyramidProjView;
+		glm::vec4 cameraPosition;
+		glm::vec2 pyramidSize;
+		uint32_t pyramidLevelCount;
+		uint32_t instanceCount;
+		uint32_t useOcclusion;
+		float lodScale;
+		float lodHysteresis;
+		uint32_t _padding;
+	};
+	static_assert(sizeof(CullUniforms) % 16 == 0, "CullUniforms is not multiple of 16");
+
+	vk::Device _device;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_FRAMES_IN_FLIGHT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	AllocatedBuffer _instanceBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _instanceAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	AllocatedBuffer _templateBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _templateAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	AllocatedBuffer _commandBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	// level of detail every item selected last, shared by frames
+	AllocatedBuffer _lodBuffer;
+	uint64_t _lodGeneration = 0;
+
+	AllocatedBuffer _uniformBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _uniformAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	// written by cull shader, read back once frame is finished
+	AllocatedBuffer _statsBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _statsAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	CullStats _stats;
+
+	DepthPyramid _pyramid;
+	glm::mat4 _pyramidProjView = glm::mat4(1.0f);
+
+	std::vector<InstanceData> _instances;
+	std::vector<vk::DrawIndexedIndirectCommand> _templates;
+
+	// first command of every batch, followed by command count
+	std::vector<uint32_t> _batchCommands;
+
+	// frame buffers are refreshed lazily, once their previous use is finished
+	uint64_t _generation = 1;
+	uint64_t _uploadedGenerations[MAX_FRAMES_IN_FLIGHT] = {};
+
+	bool _isMultiDrawSupported = false;
+	bool _initialized = false;
+
+	void _updatePyramidSets();
+
+public:
+	// queue has to be sorted and batched, one command is created per batch or per meshlet of it
+	// while instance slots last
+	void update(const RenderQueue &queue);
+
+	// has to be recorded before render pass
+	// lodScale is pixels per unit at distance of one
+	void dispatch(vk::CommandBuffer commandBuffer, uint32_t frame, const glm::mat4 &projView,
+			const glm::vec3 &cameraPosition, float lodScale);
+
+	// has to be recorded after render pass, used for culling of next frame
+	void buildDepthPyramid(vk::CommandBuffer commandBuffer, const glm::mat4 &projView);
+
+	// batches bind their texture sets when pTextureSets is given
+	void draw(vk::CommandBuffer commandBuffer, uint32_t frame, const RenderQueue &queue,
+			vk::PipelineLayout pipelineLayout, const ObjectOwner<TextureSetRD> *pTextureSets,
+			bool bindPipelines, DrawStats &stats) const;
+
+	// results are late by frames in flight
+	CullStats getStats() const;
+
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool, bool multiDraw);
+};
+
+#endif // !GPU_CULLER_H
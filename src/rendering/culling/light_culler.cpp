@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/culling/frustum_culler.h>
+#include <rendering/memory_tracker.h>
+#include <rendering/rendering_device.h>
+#include <rendering/shaders/light_cull.gen.h>
+
+#include "light_culler.h"
+
+const uint32_t GROUP_SIZE = 64;
+
+static_assert(CLUSTER_COUNT % GROUP_SIZE == 0, "Light cull group spans two views");
+
+void LightCuller::_updateBinding(uint32_t frame, uint32_t binding, AllocatedBuffer buffer) {
+	vk::DescriptorBufferInfo bufferInfo = buffer.getBufferInfo();
+
+	vk::WriteDescriptorSet writeInfo;
+	writeInfo.setDstSet(_sets[frame]);
+	writeInfo.setDstBinding(binding);
+	writeInfo.setDstArrayElement(0);
+	writeInfo.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfo.setDescriptorCount(1);
+	writeInfo.setBufferInfo(bufferInfo);
+
+	_device.updateDescriptorSets(writeInfo, nullptr);
+}
+
+void LightCuller::_createClusterBuffer(
+		uint32_t frame, uint32_t viewCount, LightStorage &lightStorage) {
+	if (_clusterViewCounts[frame] > 0) {
+		MemoryTracker::untrack(_clusterBuffers[frame].allocation);
+		vmaDestroyBuffer(_allocator, _clusterBuffers[frame].buffer,
+				_clusterBuffers[frame].allocation);
+	}
+
+	vk::DeviceSize clusterSize = sizeof(uint32_t) * CLUSTER_COUNT *
+			(MAX_VIEW_COUNT + MAX_LIGHTS_PER_CLUSTER * viewCount);
+
+	// written on async compute, read by material shader on graphics queue
+	_clusterBuffers[frame] = AllocatedBuffer::create(_allocator, MemoryCategory::Light,
+			BufferClass::Static, vk::BufferUsageFlagBits::eStorageBuffer, clusterSize, nullptr,
+			RD::getSingleton().getSharedQueueFamilies());
+	_clusterViewCounts[frame] = viewCount;
+
+	_updateBinding(frame, 2, _clusterBuffers[frame]);
+
+	// material shader reads the same buffers through light set
+	lightStorage.bindClusters(frame, _uniformBuffers[frame], _clusterBuffers[frame]);
+}
+
+void LightCuller::dispatch(vk::CommandBuffer commandBuffer, uint32_t frame, const View *pViews,
+		uint32_t viewCount, float zNear, float zFar, LightStorage &lightStorage, bool isAsync) {
+	viewCount = std::min(viewCount, MAX_VIEW_COUNT);
+
+	// set of this frame is not in use, previous submission is finished
+	if (viewCount > _clusterViewCounts[frame])
+		_createClusterBuffer(frame, viewCount, lightStorage);
+
+	glm::vec4 planes[MAX_VIEW_COUNT * 6];
+	glm::vec3 positions[MAX_VIEW_COUNT];
+
+	for (uint32_t i = 0; i < viewCount; i++) {
+		FrustumCuller::extractPlanes(pViews[i].proj * pViews[i].view, planes + i * 6);
+		positions[i] = glm::vec3(glm::inverse(pViews[i].view)[3]);
+	}
+
+	uint32_t visibleCount = lightStorage.updateVisible(frame, planes, positions, viewCount);
+
+	AllocatedBuffer pointBuffer = lightStorage.getPointBuffer(frame);
+
+	if (pointBuffer.buffer != _boundPointBuffers[frame]) {
+		_updateBinding(frame, 1, pointBuffer);
+		_boundPointBuffers[frame] = pointBuffer.buffer;
+	}
+
+	ClusterUniforms uniforms = {};
+
+	for (uint32_t i = 0; i < viewCount; i++) {
+		uniforms.views[i] = pViews[i].view;
+		uniforms.invProjs[i] = glm::inverse(pViews[i].proj);
+	}
+
+	uniforms.zNear = zNear;
+	uniforms.zFar = zFar;
+	uniforms.lightCount = visibleCount;
+	uniforms.viewCount = viewCount;
+
+	memcpy(_uniformAllocInfos[frame].pMappedData, &uniforms, sizeof(ClusterUniforms));
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _sets[frame], nullptr);
+
+	uint32_t groupCount = CLUSTER_COUNT * viewCount / GROUP_SIZE;
+	commandBuffer.dispatch(groupCount, 1, 1);
+
+	// semaphore of compute submit orders it before material shader
+	if (isAsync)
+		return;
+
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eFragmentShader, {}, barrier, nullptr, nullptr);
+}
+
+void LightCuller::initialize(vk::Device device, VmaAllocator allocator,
+		vk::DescriptorPool descriptorPool, LightStorage &lightStorage) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_allocator = allocator;
+
+	std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	bindings[0].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Light cull descriptor set layout creation failed!");
+
+	uint32_t framesInFlight = RD::getSingleton().getFramesInFlight();
+
+	std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Light cull descriptor set allocation failed!");
+
+	// written on async compute, read by material shader on graphics queue
+	const std::vector<uint32_t> &sharedFamilies = RD::getSingleton().getSharedQueueFamilies();
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_uniformBuffers[i] = AllocatedBuffer::create(allocator, MemoryCategory::Light,
+				BufferClass::Dynamic, vk::BufferUsageFlagBits::eUniformBuffer,
+				sizeof(ClusterUniforms), &_uniformAllocInfos[i], sharedFamilies);
+
+		vk::DescriptorBufferInfo uniformInfo = _uniformBuffers[i].getBufferInfo();
+		vk::DescriptorBufferInfo pointLightInfo = lightStorage.getPointBuffer(i).getBufferInfo();
+		_boundPointBuffers[i] = lightStorage.getPointBuffer(i).buffer;
+
+		// cluster buffer is written once it is created below
+		std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+		for (uint32_t j = 0; j < writeInfos.size(); j++) {
+			writeInfos[j].setDstSet(_sets[i]);
+			writeInfos[j].setDstBinding(j);
+			writeInfos[j].setDstArrayElement(0);
+			writeInfos[j].setDescriptorType(bindings[j].descriptorType);
+			writeInfos[j].setDescriptorCount(1);
+		}
+
+		writeInfos[0].setBufferInfo(uniformInfo);
+		writeInfos[1].setBufferInfo(pointLightInfo);
+
+		device.updateDescriptorSets(writeInfos, nullptr);
+
+		_createClusterBuffer(i, 1, lightStorage);
+	}
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	LightCullShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Light cull compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
@@ -0,0 +1,81 @@
+#ifndef LIGHT_CULLER_H
+#define LIGHT_CULLER_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/storage/light_storage.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/frame.h>
+
+// has to match shaders/include/cluster_incl.glsl
+const uint32_t CLUSTER_X = 16;
+const uint32_t CLUSTER_Y = 9;
+const uint32_t CLUSTER_Z = 24;
+const uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+const uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+// Bins point lights into view space froxels by their range, material shader reads only lights
+// of the cluster containing the fragment. Cluster buffers are bound through light set. Light
+// storage compacts point lights reaching into view frustums first, only those are uploaded and
+// binned, cluster lists index into that compacted buffer. Every view has its own
+// clusters over region it covers, all are binned by one dispatch.
+class LightCuller {
+public:
+	typedef struct {
+		glm::mat4 view;
+		glm::mat4 proj;
+	} View;
+
+private:
+	struct ClusterUniforms {
+		glm::mat4 views[MAX_VIEW_COUNT];
+		glm::mat4 invProjs[MAX_VIEW_COUNT];
+		float zNear;
+		float zFar;
+		uint32_t lightCount;
+		uint32_t viewCount;
+	};
+	static_assert(sizeof(ClusterUniforms) % 16 == 0, "ClusterUniforms is not multiple of 16");
+
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_FRAMES_IN_FLIGHT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	AllocatedBuffer _uniformBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _uniformAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	// light counts of every cluster followed by fixed size index lists, counts have room for
+	// every view, lists only for as many views as were binned so far
+	AllocatedBuffer _clusterBuffers[MAX_FRAMES_IN_FLIGHT];
+	uint32_t _clusterViewCounts[MAX_FRAMES_IN_FLIGHT] = {};
+
+	// light storage reallocates point buffer as visible count changes
+	vk::Buffer _boundPointBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	void _updateBinding(uint32_t frame, uint32_t binding, AllocatedBuffer buffer);
+	// frame has to be finished, light set of frame is rewritten
+	void _createClusterBuffer(uint32_t frame, uint32_t viewCount, LightStorage &lightStorage);
+
+	bool _initialized = false;
+
+public:
+	// has to be recorded before render pass, after light storage is updated, isAsync when
+	// command buffer is one of async compute, barrier before fragment shader is left out
+	void dispatch(vk::CommandBuffer commandBuffer, uint32_t frame, const View *pViews,
+			uint32_t viewCount, float zNear, float zFar, LightStorage &lightStorage,
+			bool isAsync = false);
+
+	void initialize(vk::Device device, VmaAllocator allocator, vk::DescriptorPool descriptorPool,
+			LightStorage &lightStorage);
+};
+
+#endif // !LIGHT_CULLER_H
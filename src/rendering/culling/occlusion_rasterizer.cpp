@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "occlusion_rasterizer.h"
+
+// vertices closer to eye than this are behind near plane of rasterizer
+const float OCCLUSION_NEAR = 0.01f;
+
+// inverse depth of occluder has to exceed that of bounds by this much, rounding of plane
+// equations never hides bounds lying on occluder itself
+const float OCCLUSION_DEPTH_BIAS = 1e-5f;
+
+// vertices close to near plane land far off screen, clamped before conversion
+static int32_t _toPixel(float coordinate, uint32_t size) {
+	return static_cast<int32_t>(std::clamp(coordinate, -1.0f, static_cast<float>(size)));
+}
+
+std::shared_ptr<const OccluderMesh> OcclusionRasterizer::buildOccluder(const Mesh &mesh) {
+	uint32_t levelCount = 1;
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const Primitive &primitive = mesh.pPrimitives[i];
+		levelCount = std::max(levelCount, primitive.lods.count + 1);
+
+		for (uint32_t j = 0; j < primitive.vertices.count; j++) {
+			if (primitive.vertices.pData[j].weights != glm::vec4(0.0f))
+				return nullptr;
+		}
+	}
+
+	// level 0 is full detail, primitives with fewer levels take their last one
+	auto getIndices = [&](const Primitive &primitive, uint32_t level) -> const IndexArray & {
+		if (level == 0 || primitive.lods.count == 0)
+			return primitive.indices;
+
+		return primitive.lods.pData[std::min(level, primitive.lods.count) - 1].indices;
+	};
+
+	uint32_t level = 0;
+
+	for (; level < levelCount; level++) {
+		uint64_t triangleCount = 0;
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++)
+			triangleCount += getIndices(mesh.pPrimitives[i], level).count / 3;
+
+		if (triangleCount <= OCCLUDER_MAX_TRIANGLE_COUNT)
+			break;
+	}
+
+	if (level == levelCount)
+		return nullptr;
+
+	std::shared_ptr<OccluderMesh> occluder = std::make_shared<OccluderMesh>();
+	occluder->isTagged = mesh.pName != nullptr &&
+			strncmp(mesh.pName, OCCLUDER_MESH_PREFIX, strlen(OCCLUDER_MESH_PREFIX)) == 0;
+
+	std::vector<uint32_t> remap;
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const Primitive &primitive = mesh.pPrimitives[i];
+		const IndexArray &indices = getIndices(primitive, level);
+
+		uint32_t indexCount = indices.count / 3 * 3;
+		remap.assign(primitive.vertices.count, UINT32_MAX);
+
+		for (uint32_t j = 0; j < indexCount; j++) {
+			uint32_t index = indices.pData[j];
+
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = static_cast<uint32_t>(occluder->positions.size());
+				occluder->positions.push_back(primitive.vertices.pData[index].position);
+			}
+
+			occluder->indices.push_back(remap[index]);
+		}
+	}
+
+	if (occluder->indices.empty())
+		return nullptr;
+
+	return occluder;
+}
+
+glm::vec4 OcclusionRasterizer::_toScreen(const glm::vec4 &clip) const {
+	if (clip.w < OCCLUSION_NEAR)
+		return glm::vec4(0.0f);
+
+	float invW = 1.0f / clip.w;
+
+	return glm::vec4((clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+			(clip.y * invW * 0.5f + 0.5f) * OCCLUSION_HEIGHT, invW, 1.0f);
+}
+
+void OcclusionRasterizer::_rasterizeTriangle(
+		const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+	// ordered counterclockwise, both windings occlude
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+
+	if (std::abs(area) < 1e-6f)
+		return;
+
+	const glm::vec4 &v0 = a;
+	const glm::vec4 &v1 = area > 0.0f ? b : c;
+	const glm::vec4 &v2 = area > 0.0f ? c : b;
+	area = std::abs(area);
+
+	// pixel centers within bounds of triangle
+	int32_t minX = _toPixel(std::ceil(std::min({ v0.x, v1.x, v2.x }) - 0.5f), OCCLUSION_WIDTH);
+	int32_t minY = _toPixel(std::ceil(std::min({ v0.y, v1.y, v2.y }) - 0.5f), OCCLUSION_HEIGHT);
+	int32_t maxX = _toPixel(std::floor(std::max({ v0.x, v1.x, v2.x }) - 0.5f), OCCLUSION_WIDTH);
+	int32_t maxY = _toPixel(std::floor(std::max({ v0.y, v1.y, v2.y }) - 0.5f), OCCLUSION_HEIGHT);
+
+	minX = std::max(minX, 0);
+	minY = std::max(minY, 0);
+	maxX = std::min(maxX, static_cast<int32_t>(OCCLUSION_WIDTH) - 1);
+	maxY = std::min(maxY, static_cast<int32_t>(OCCLUSION_HEIGHT) - 1);
+
+	if (minX > maxX || minY > maxY)
+		return;
+
+	_triangleCount++;
+
+	// edge functions step by their x coefficient along row, each is weight of vertex opposite
+	float e0x = v1.y - v2.y, e0y = v2.x - v1.x;
+	float e1x = v2.y - v0.y, e1y = v0.x - v2.x;
+	float e2x = v0.y - v1.y, e2y = v1.x - v0.x;
+
+	float invArea = 1.0f / area;
+	float depthX = (e0x * v0.z + e1x * v1.z + e2x * v2.z) * invArea;
+
+	for (int32_t y = minY; y <= maxY; y++) {
+		float px = static_cast<float>(minX) + 0.5f;
+		float py = static_cast<float>(y) + 0.5f;
+
+		float w0 = e0x * (px - v1.x) + e0y * (py - v1.y);
+		float w1 = e1x * (px - v2.x) + e1y * (py - v2.y);
+		float w2 = e2x * (px - v0.x) + e2y * (py - v0.y);
+		float depth = (w0 * v0.z + w1 * v1.z + w2 * v2.z) * invArea;
+
+		float *pRow = &_depth[static_cast<size_t>(y) * OCCLUSION_WIDTH];
+		int32_t count = maxX - minX + 1;
+
+		for (int32_t i = 0; i < count; i++) {
+			float x = static_cast<float>(i);
+			bool isInside = (w0 + e0x * x >= 0.0f) & (w1 + e1x * x >= 0.0f) &
+					(w2 + e2x * x >= 0.0f);
+			float d = depth + depthX * x;
+			float current = pRow[minX + i];
+
+			pRow[minX + i] = isInside & (d > current) ? d : current;
+		}
+	}
+}
+
+void OcclusionRasterizer::begin(const glm::mat4 &projView) {
+	_projView = projView;
+	_depth.assign(static_cast<size_t>(OCCLUSION_WIDTH) * OCCLUSION_HEIGHT, 0.0f);
+	_triangleCount = 0;
+}
+
+void OcclusionRasterizer::rasterize(const OccluderMesh &occluder, const glm::mat4 &transform) {
+	glm::mat4 toClip = _projView * transform;
+
+	_screenPositions.resize(occluder.positions.size());
+
+	for (size_t i = 0; i < occluder.positions.size(); i++)
+		_screenPositions[i] = _toScreen(toClip * glm::vec4(occluder.positions[i], 1.0f));
+
+	for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+		const glm::vec4 &a = _screenPositions[occluder.indices[i + 0]];
+		const glm::vec4 &b = _screenPositions[occluder.indices[i + 1]];
+		const glm::vec4 &c = _screenPositions[occluder.indices[i + 2]];
+
+		// clipping would be exact, occluding a little less is cheaper
+		if (a.w == 0.0f || b.w == 0.0f || c.w == 0.0f)
+			continue;
+
+		_rasterizeTriangle(a, b, c);
+	}
+}
+
+bool OcclusionRasterizer::isVisible(const AABB &aabb) const {
+	glm::vec2 min(INFINITY);
+	glm::vec2 max(-INFINITY);
+	float nearest = 0.0f;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		glm::vec3 corner((i & 1) != 0 ? aabb.max.x : aabb.min.x,
+				(i & 2) != 0 ? aabb.max.y : aabb.min.y, (i & 4) != 0 ? aabb.max.z : aabb.min.z);
+		glm::vec4 screen = _toScreen(_projView * glm::vec4(corner, 1.0f));
+
+		// bounds reaching behind eye cover whatever is in front of it
+		if (screen.w == 0.0f)
+			return true;
+
+		min = glm::min(min, glm::vec2(screen));
+		max = glm::max(max, glm::vec2(screen));
+		nearest = std::max(nearest, screen.z);
+	}
+
+	// every pixel bounds touch, not only those whose centers they cover
+	int32_t minX = std::max(_toPixel(std::floor(min.x), OCCLUSION_WIDTH), 0);
+	int32_t minY = std::max(_toPixel(std::floor(min.y), OCCLUSION_HEIGHT), 0);
+	int32_t maxX = std::min(_toPixel(std::floor(max.x), OCCLUSION_WIDTH),
+			static_cast<int32_t>(OCCLUSION_WIDTH) - 1);
+	int32_t maxY = std::min(_toPixel(std::floor(max.y), OCCLUSION_HEIGHT),
+			static_cast<int32_t>(OCCLUSION_HEIGHT) - 1);
+
+	// frustum culling let it through, screen edges are not tested
+	if (minX > maxX || minY > maxY)
+		return true;
+
+	float threshold = nearest + OCCLUSION_DEPTH_BIAS;
+
+	for (int32_t y = minY; y <= maxY; y++) {
+		const float *pRow = &_depth[static_cast<size_t>(y) * OCCLUSION_WIDTH];
+		uint32_t isUncovered = 0;
+
+		for (int32_t x = minX; x <= maxX; x++)
+			isUncovered |= static_cast<uint32_t>(pRow[x] < threshold);
+
+		if (isUncovered != 0)
+			return true;
+	}
+
+	return false;
+}
+
+uint32_t OcclusionRasterizer::getTriangleCount() const {
+	return _triangleCount;
+}
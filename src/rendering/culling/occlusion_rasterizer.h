@@ -0,0 +1,63 @@
+#ifndef OCCLUSION_RASTERIZER_H
+#define OCCLUSION_RASTERIZER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <io/mesh.h>
+#include <rendering/types/aabb.h>
+
+// resolution of depth buffer, columns are contiguous
+const uint32_t OCCLUSION_WIDTH = 256;
+const uint32_t OCCLUSION_HEIGHT = 128;
+
+// triangles of an occluder, finer meshes occlude with their first level below it
+const uint32_t OCCLUDER_MAX_TRIANGLE_COUNT = 1024;
+
+// meshes named with it are drawn into depth buffer before any other occluder
+const char OCCLUDER_MESH_PREFIX[] = "occluder_";
+
+// mesh space triangles of a mesh, positions are compacted to those indices use
+struct OccluderMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	bool isTagged = false;
+};
+
+// Low resolution depth buffer drawn on the CPU from a few large occluders, bounds hidden behind
+// them are culled before draws are recorded. Buffer holds inverse view depth, which
+// interpolates linearly across screen, triangles crossing near plane are left out. Loops are
+// branchless over rows so compilers vectorize them like FrustumCuller, rather than relying on
+// intrinsics of one instruction set. Same frame occluders are drawn in, so nothing lags a
+// frame behind like depth pyramid of GPU culling.
+class OcclusionRasterizer {
+private:
+	glm::mat4 _projView = glm::mat4(1.0f);
+
+	// 0 where nothing was drawn
+	std::vector<float> _depth;
+	// x and y in pixels, z inverse depth, w 0 behind near plane
+	std::vector<glm::vec4> _screenPositions;
+
+	uint32_t _triangleCount = 0;
+
+	glm::vec4 _toScreen(const glm::vec4 &clip) const;
+	void _rasterizeTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+
+public:
+	// nullptr when no level of mesh is coarse enough, skinned meshes move away from it
+	static std::shared_ptr<const OccluderMesh> buildOccluder(const Mesh &mesh);
+
+	void begin(const glm::mat4 &projView);
+	void rasterize(const OccluderMesh &occluder, const glm::mat4 &transform);
+	// false when every pixel bounds cover has occluder in front of their nearest corner
+	bool isVisible(const AABB &aabb) const;
+
+	// drawn since begin
+	uint32_t getTriangleCount() const;
+};
+
+#endif // !OCCLUSION_RASTERIZER_H
@@ -0,0 +1,228 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum_culler.h"
+
+#include "portal_culler.h"
+
+// eye closer to plane of portal looks through its opening, edges through eye would be
+// degenerate, so frustum so far is kept
+const float PORTAL_NEAR_DISTANCE = 0.05f;
+
+void PortalCuller::_markVisible(uint32_t cell) {
+	_visible[cell / 64] |= uint64_t(1) << (cell % 64);
+}
+
+void PortalCuller::_clip(const CellPortalGraph::Portal &portal, uint32_t depth) {
+	std::vector<glm::vec3> &polygon = _polygons[depth];
+	polygon.assign(portal.corners, portal.corners + 4);
+
+	for (const glm::vec4 &plane : _planes[depth]) {
+		_clipScratch.clear();
+
+		for (size_t i = 0; i < polygon.size(); i++) {
+			const glm::vec3 &a = polygon[i];
+			const glm::vec3 &b = polygon[(i + 1) % polygon.size()];
+
+			float da = glm::dot(glm::vec3(plane), a) + plane.w;
+			float db = glm::dot(glm::vec3(plane), b) + plane.w;
+
+			if (da >= 0.0f)
+				_clipScratch.push_back(a);
+
+			if ((da >= 0.0f) != (db >= 0.0f))
+				_clipScratch.push_back(a + (b - a) * (da / (da - db)));
+		}
+
+		polygon.swap(_clipScratch);
+
+		if (polygon.size() < 3) {
+			polygon.clear();
+			return;
+		}
+	}
+}
+
+void PortalCuller::_traverse(const glm::vec3 &eye, uint32_t cell, uint32_t depth) {
+	_markVisible(cell);
+
+	if (depth == PORTAL_MAX_DEPTH)
+		return;
+
+	for (uint32_t p : _cellPortals[cell]) {
+		// path looping back through a portal sees nothing new
+		if (_isEntered[p])
+			continue;
+
+		const CellPortalGraph::Portal &portal = _graph.portals[p];
+		uint32_t next = portal.cells[0] == cell ? portal.cells[1] : portal.cells[0];
+
+		_clip(portal, depth);
+
+		const std::vector<glm::vec3> &polygon = _polygons[depth];
+
+		if (polygon.empty())
+			continue;
+
+		std::vector<glm::vec4> &planes = _planes[depth + 1];
+
+		glm::vec3 normal = glm::cross(
+				portal.corners[1] - portal.corners[0], portal.corners[2] - portal.corners[0]);
+		float normalLength = glm::length(normal);
+
+		if (normalLength == 0.0f ||
+				std::abs(glm::dot(normal, eye - portal.corners[0])) <
+						PORTAL_NEAR_DISTANCE * normalLength) {
+			planes = _planes[depth];
+		} else {
+			planes.clear();
+
+			glm::vec3 centroid(0.0f);
+
+			for (const glm::vec3 &vertex : polygon)
+				centroid += vertex;
+
+			centroid /= static_cast<float>(polygon.size());
+
+			// plane through eye and each edge, facing inside of polygon
+			for (size_t i = 0; i < polygon.size(); i++) {
+				glm::vec3 edgeNormal =
+						glm::cross(polygon[i] - eye, polygon[(i + 1) % polygon.size()] - eye);
+				float length = glm::length(edgeNormal);
+
+				// edges clipping left almost collapsed narrow nothing
+				if (length < 1e-6f)
+					continue;
+
+				edgeNormal /= length;
+				float w = -glm::dot(edgeNormal, eye);
+
+				if (glm::dot(edgeNormal, centroid) + w < 0.0f) {
+					edgeNormal = -edgeNormal;
+					w = -w;
+				}
+
+				planes.push_back(glm::vec4(edgeNormal, w));
+			}
+		}
+
+		_isEntered[p] = true;
+		_traverse(eye, next, depth + 1);
+		_isEntered[p] = false;
+	}
+}
+
+void PortalCuller::set(const CellPortalGraph &graph) {
+	_graph = graph;
+
+	uint32_t cellCount = static_cast<uint32_t>(_graph.cells.size());
+	uint32_t wordCount = (cellCount + 63) / 64;
+
+	// rows of another graph would light up wrong cells
+	if (_graph.pvsWordCount != wordCount || _graph.pvs.size() != size_t(cellCount) * wordCount) {
+		_graph.pvs.clear();
+		_graph.pvsWordCount = 0;
+	}
+
+	_cellPortals.assign(cellCount, {});
+
+	for (uint32_t i = 0; i < _graph.portals.size(); i++) {
+		const CellPortalGraph::Portal &portal = _graph.portals[i];
+
+		if (portal.cells[0] >= cellCount || portal.cells[1] >= cellCount ||
+				portal.cells[0] == portal.cells[1])
+			continue;
+
+		_cellPortals[portal.cells[0]].push_back(i);
+		_cellPortals[portal.cells[1]].push_back(i);
+	}
+
+	_isEntered.assign(_graph.portals.size(), false);
+	_visible.assign(wordCount, 0);
+	_isAllVisible = true;
+}
+
+const CellPortalGraph &PortalCuller::getGraph() const {
+	return _graph;
+}
+
+bool PortalCuller::isEmpty() const {
+	return _graph.cells.empty();
+}
+
+uint32_t PortalCuller::findCell(const glm::vec3 &point) const {
+	for (uint32_t i = 0; i < _graph.cells.size(); i++) {
+		const CellPortalGraph::Cell &cell = _graph.cells[i];
+
+		if (glm::all(glm::greaterThanEqual(point, cell.min)) &&
+				glm::all(glm::lessThanEqual(point, cell.max)))
+			return i;
+	}
+
+	return PORTAL_NO_CELL;
+}
+
+uint32_t PortalCuller::findCell(const AABB &aabb) const {
+	uint32_t index = findCell(aabb.center());
+
+	if (index == PORTAL_NO_CELL)
+		return PORTAL_NO_CELL;
+
+	const CellPortalGraph::Cell &cell = _graph.cells[index];
+
+	if (glm::all(glm::greaterThanEqual(aabb.min, cell.min)) &&
+			glm::all(glm::lessThanEqual(aabb.max, cell.max)))
+		return index;
+
+	return PORTAL_NO_CELL;
+}
+
+void PortalCuller::traverse(const glm::vec3 &eye, const glm::vec4 *pPlanes, uint32_t planeCount,
+		std::vector<uint64_t> &visible) {
+	uint32_t cell = findCell(eye);
+
+	if (cell == PORTAL_NO_CELL) {
+		visible.assign(_visible.size(), UINT64_MAX);
+		return;
+	}
+
+	_visible.assign(_visible.size(), 0);
+	_planes[0].assign(pPlanes, pPlanes + planeCount);
+	_traverse(eye, cell, 0);
+
+	visible = _visible;
+}
+
+void PortalCuller::clear() {
+	_visible.assign(_visible.size(), 0);
+	_isAllVisible = _graph.cells.empty();
+}
+
+void PortalCuller::addView(const glm::vec3 &position, const glm::mat4 &projView) {
+	if (_isAllVisible)
+		return;
+
+	uint32_t cell = findCell(position);
+
+	if (cell == PORTAL_NO_CELL) {
+		_isAllVisible = true;
+		return;
+	}
+
+	if (!_graph.pvs.empty()) {
+		const uint64_t *pRow = &_graph.pvs[size_t(cell) * _graph.pvsWordCount];
+
+		for (uint32_t i = 0; i < _graph.pvsWordCount; i++)
+			_visible[i] |= pRow[i];
+
+		return;
+	}
+
+	_planes[0].resize(6);
+	FrustumCuller::extractPlanes(projView, _planes[0].data());
+
+	_traverse(position, cell, 0);
+}
@@ -0,0 +1,71 @@
+#ifndef PORTAL_CULLER_H
+#define PORTAL_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <io/cell_portals.h>
+#include <rendering/types/aabb.h>
+
+// portals seen through one another before traversal gives up on a path
+const uint32_t PORTAL_MAX_DEPTH = 16;
+
+// returned for bounds in no cell or spanning several, such instances are always candidates
+const uint32_t PORTAL_NO_CELL = UINT32_MAX;
+
+// Finds cells visible from views of a frame. Traversal starts in cell of camera and recurses
+// into cells behind portals it sees, polygon of each portal is clipped by planes of frustum so
+// far and its edges narrow frustum of cell behind it. Baked graphs look row of their cell up in
+// potentially visible set instead. Views outside every cell see every cell.
+class PortalCuller {
+private:
+	CellPortalGraph _graph;
+
+	// portals touching each cell
+	std::vector<std::vector<uint32_t>> _cellPortals;
+
+	std::vector<uint64_t> _visible;
+	bool _isAllVisible = true;
+
+	// portal is on current path of traversal
+	std::vector<bool> _isEntered;
+
+	// per depth, reused between frames
+	std::vector<glm::vec4> _planes[PORTAL_MAX_DEPTH + 1];
+	std::vector<glm::vec3> _polygons[PORTAL_MAX_DEPTH + 1];
+	std::vector<glm::vec3> _clipScratch;
+
+	void _markVisible(uint32_t cell);
+	// planes of depth 0 have to be set
+	void _traverse(const glm::vec3 &eye, uint32_t cell, uint32_t depth);
+
+	// Sutherland-Hodgman against planes of depth, result goes into polygon of depth
+	void _clip(const CellPortalGraph::Portal &portal, uint32_t depth);
+
+public:
+	void set(const CellPortalGraph &graph);
+	const CellPortalGraph &getGraph() const;
+	bool isEmpty() const;
+
+	// first cell containing point, PORTAL_NO_CELL outside every cell
+	uint32_t findCell(const glm::vec3 &point) const;
+	// cell containing center of bounds when it contains bounds as a whole
+	uint32_t findCell(const AABB &aabb) const;
+
+	// by traversal alone within planes, ignores potentially visible set, visible gets a bit
+	// per cell, eye outside every cell sets every bit
+	void traverse(const glm::vec3 &eye, const glm::vec4 *pPlanes, uint32_t planeCount,
+			std::vector<uint64_t> &visible);
+
+	// views of frame are added after clearing, instances are tested after all views
+	void clear();
+	void addView(const glm::vec3 &position, const glm::mat4 &projView);
+	bool isVisible(uint32_t cell) const {
+		return _isAllVisible || cell == PORTAL_NO_CELL ||
+				(_visible[cell / 64] & (uint64_t(1) << (cell % 64))) != 0;
+	}
+};
+
+#endif // !PORTAL_CULLER_H
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "descriptor_allocator.h"
+
+vk::DescriptorPool DescriptorAllocator::_createPool() {
+	std::vector<vk::DescriptorPoolSize> poolSizes = _setSizes;
+
+	for (vk::DescriptorPoolSize &poolSize : poolSizes)
+		poolSize.descriptorCount *= _poolSetCount;
+
+	vk::DescriptorPoolCreateInfo createInfo;
+	createInfo.setMaxSets(_poolSetCount);
+	createInfo.setPoolSizes(poolSizes);
+
+	if (_isFreeable)
+		createInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+
+	vk::DescriptorPool pool = _device.createDescriptorPool(createInfo);
+	_pools.push_back(pool);
+
+	return pool;
+}
+
+DescriptorAllocator::Allocation DescriptorAllocator::allocate(vk::DescriptorSetLayout setLayout) {
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setSetLayouts(setLayout);
+
+	Allocation allocation = {};
+
+	// full pool reports out of memory, fragmented one may fit smaller sets later
+	for (; _currentPool < _pools.size(); _currentPool++) {
+		allocInfo.setDescriptorPool(_pools[_currentPool]);
+
+		vk::Result err = _device.allocateDescriptorSets(&allocInfo, &allocation.set);
+
+		if (err == vk::Result::eSuccess) {
+			allocation.pool = _pools[_currentPool];
+			return allocation;
+		}
+
+		if (err != vk::Result::eErrorOutOfPoolMemory && err != vk::Result::eErrorFragmentedPool)
+			throw std::runtime_error("Descriptor set allocation failed!");
+	}
+
+	allocInfo.setDescriptorPool(_createPool());
+
+	vk::Result err = _device.allocateDescriptorSets(&allocInfo, &allocation.set);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Descriptor set allocation failed!");
+
+	allocation.pool = allocInfo.descriptorPool;
+	return allocation;
+}
+
+void DescriptorAllocator::free(const Allocation &allocation) {
+	if (!_isFreeable)
+		throw std::runtime_error("Descriptor set free from transient allocator failed!");
+
+	_device.freeDescriptorSets(allocation.pool, allocation.set);
+
+	// pool has room again, allocations look there first
+	size_t index = std::find(_pools.begin(), _pools.end(), allocation.pool) - _pools.begin();
+	_currentPool = std::min(_currentPool, index);
+}
+
+void DescriptorAllocator::reset() {
+	for (vk::DescriptorPool pool : _pools)
+		_device.resetDescriptorPool(pool);
+
+	_currentPool = 0;
+}
+
+void DescriptorAllocator::destroy() {
+	for (vk::DescriptorPool pool : _pools)
+		_device.destroyDescriptorPool(pool);
+
+	_pools.clear();
+	_currentPool = 0;
+}
+
+void DescriptorAllocator::initialize(vk::Device device,
+		const std::vector<vk::DescriptorPoolSize> &setSizes, uint32_t poolSetCount,
+		bool freeable) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_setSizes = setSizes;
+	_poolSetCount = poolSetCount;
+	_isFreeable = freeable;
+
+	_initialized = true;
+}
@@ -0,0 +1,47 @@
+#ifndef DESCRIPTOR_ALLOCATOR_H
+#define DESCRIPTOR_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Allocates sets of one kind from a chain of pools, another pool is created once every one is
+// full. Freeable allocator returns sets one by one, transient one returns all of them at once.
+class DescriptorAllocator {
+public:
+	typedef struct {
+		vk::DescriptorSet set;
+		vk::DescriptorPool pool;
+	} Allocation;
+
+private:
+	vk::Device _device;
+
+	// descriptors of one set, scaled by set count for every pool
+	std::vector<vk::DescriptorPoolSize> _setSizes;
+	uint32_t _poolSetCount = 0;
+	bool _isFreeable = false;
+
+	std::vector<vk::DescriptorPool> _pools;
+	// pools before this one are full
+	size_t _currentPool = 0;
+
+	bool _initialized = false;
+
+	vk::DescriptorPool _createPool();
+
+public:
+	Allocation allocate(vk::DescriptorSetLayout setLayout);
+	// allocator has to be freeable, set must not be used by pending frames
+	void free(const Allocation &allocation);
+
+	// every set is returned, none of them may be used by pending frames, pools are kept
+	void reset();
+	void destroy();
+
+	void initialize(vk::Device device, const std::vector<vk::DescriptorPoolSize> &setSizes,
+			uint32_t poolSetCount, bool freeable);
+};
+
+#endif // !DESCRIPTOR_ALLOCATOR_H
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include <SDL3/SDL_timer.h>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+
+#include "shaders/auto_exposure_histogram.gen.h"
+#include "shaders/auto_exposure_reduce.gen.h"
+
+#include "auto_exposure.h"
+
+const uint32_t BIN_COUNT = 256;
+const uint32_t GROUP_SIZE = 16;
+
+vk::Pipeline AutoExposure::_createPipeline(vk::Device device, vk::PipelineLayout layout,
+		const uint32_t *pCode, size_t codeSize) {
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(pCode);
+	moduleCreateInfo.setCodeSize(codeSize);
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(layout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Auto exposure compute pipeline creation failed!");
+
+	device.destroyShaderModule(computeModule);
+
+	return result.value;
+}
+
+bool AutoExposure::ensure(const Attachment &color) {
+	if (color.getImageView() == _colorView)
+		return false;
+
+	// earlier frames may still read set
+	RD::getSingleton().framesInFlightWait();
+
+	_colorView = color.getImageView();
+
+	vk::DescriptorImageInfo imageInfo;
+	imageInfo.setImageView(_colorView);
+	imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	imageInfo.setSampler(_sampler);
+
+	vk::WriteDescriptorSet writeInfo;
+	writeInfo.setDstSet(_set);
+	writeInfo.setDstBinding(0);
+	writeInfo.setDstArrayElement(0);
+	writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfo.setDescriptorCount(1);
+	writeInfo.setImageInfo(imageInfo);
+
+	_device.updateDescriptorSets(writeInfo, nullptr);
+	return true;
+}
+
+void AutoExposure::invalidate() {
+	_isExposureValid = false;
+}
+
+void AutoExposure::record(vk::CommandBuffer commandBuffer, vk::Extent2D inputExtent) {
+	uint64_t time = SDL_GetTicksNS();
+	float timeStep = static_cast<float>(time - _time) * 1e-9f;
+	_time = time;
+
+	// reduce and tonemap passes of earlier frames are done with both buffers
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	vk::PipelineStageFlags srcStage =
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader;
+
+	if (!_isExposureValid) {
+		vk::MemoryBarrier clearBarrier;
+		clearBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		clearBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+
+		commandBuffer.pipelineBarrier(srcStage, vk::PipelineStageFlagBits::eTransfer, {},
+				clearBarrier, nullptr, nullptr);
+		commandBuffer.fillBuffer(_histogramBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		barrier.setSrcAccessMask(
+				vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+		srcStage |= vk::PipelineStageFlagBits::eTransfer;
+	}
+
+	commandBuffer.pipelineBarrier(srcStage, vk::PipelineStageFlagBits::eComputeShader, {},
+			barrier, nullptr, nullptr);
+
+	ExposureConstants constants = {};
+	constants.inputSize[0] = inputExtent.width;
+	constants.inputSize[1] = inputExtent.height;
+	constants.minLogLuminance = EXPOSURE_MIN_LOG_LUMINANCE;
+	constants.logLuminanceRange = EXPOSURE_MAX_LOG_LUMINANCE - EXPOSURE_MIN_LOG_LUMINANCE;
+	constants.adaptation = 1.0f -
+			std::exp(-std::min(timeStep, EXPOSURE_MAX_TIME_STEP) * EXPOSURE_ADAPTATION_SPEED);
+	constants.middleGray = EXPOSURE_MIDDLE_GRAY;
+	constants.isExposureValid = _isExposureValid ? 1 : 0;
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _set, nullptr);
+	commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+			sizeof(ExposureConstants), &constants);
+
+	commandBuffer.bindPipeline(bindPoint, _histogramPipeline);
+
+	uint32_t groupCountX = (inputExtent.width + GROUP_SIZE - 1) / GROUP_SIZE;
+	uint32_t groupCountY = (inputExtent.height + GROUP_SIZE - 1) / GROUP_SIZE;
+	commandBuffer.dispatch(groupCountX, groupCountY, 1);
+
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+
+	commandBuffer.bindPipeline(bindPoint, _reducePipeline);
+	commandBuffer.dispatch(1, 1, 1);
+
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eFragmentShader, {}, barrier, nullptr, nullptr);
+
+	_isExposureValid = true;
+}
+
+vk::DescriptorSetLayout AutoExposure::getExposureSetLayout() const {
+	return _exposureSetLayout;
+}
+
+vk::DescriptorSet AutoExposure::getExposureSet() const {
+	return _exposureSet;
+}
+
+void AutoExposure::initialize(
+		vk::Device device, vk::DescriptorPool descriptorPool, vk::Sampler colorSampler) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_sampler = colorSampler;
+
+	std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(i == 0 ? vk::DescriptorType::eCombinedImageSampler
+											 : vk::DescriptorType::eStorageBuffer);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Auto exposure descriptor set layout creation failed!");
+
+	vk::DescriptorSetLayoutBinding exposureBinding = bindings[2];
+	exposureBinding.setBinding(0);
+	exposureBinding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	createInfo.setBindings(exposureBinding);
+
+	err = device.createDescriptorSetLayout(&createInfo, nullptr, &_exposureSetLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Exposure descriptor set layout creation failed!");
+
+	std::array<vk::DescriptorSetLayout, 2> layouts = { _setLayout, _exposureSetLayout };
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	std::array<vk::DescriptorSet, 2> sets;
+	err = device.allocateDescriptorSets(&allocInfo, sets.data());
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Auto exposure descriptor set allocation failed!");
+
+	_set = sets[0];
+	_exposureSet = sets[1];
+
+	RD &rd = RD::getSingleton();
+
+	// written by device only, persist across frames
+	_histogramBuffer = rd.bufferCreate(MemoryCategory::RenderTarget, BufferClass::Static,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			sizeof(uint32_t) * BIN_COUNT);
+	// exposure and average luminance
+	_exposureBuffer = rd.bufferCreate(MemoryCategory::RenderTarget, BufferClass::Static,
+			vk::BufferUsageFlagBits::eStorageBuffer, sizeof(float) * 2);
+
+	vk::DescriptorBufferInfo histogramInfo = _histogramBuffer.getBufferInfo();
+	vk::DescriptorBufferInfo exposureInfo = _exposureBuffer.getBufferInfo();
+
+	std::array<vk::WriteDescriptorSet, 3> writeInfos = {};
+
+	for (uint32_t i = 0; i < writeInfos.size(); i++) {
+		writeInfos[i].setDstSet(i < 2 ? _set : _exposureSet);
+		writeInfos[i].setDstBinding(i < 2 ? i + 1 : 0);
+		writeInfos[i].setDstArrayElement(0);
+		writeInfos[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writeInfos[i].setDescriptorCount(1);
+	}
+
+	writeInfos[0].setBufferInfo(histogramInfo);
+	writeInfos[1].setBufferInfo(exposureInfo);
+	writeInfos[2].setBufferInfo(exposureInfo);
+
+	device.updateDescriptorSets(writeInfos, nullptr);
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(ExposureConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	AutoExposureHistogramShader histogramShader;
+	_histogramPipeline = _createPipeline(device, _pipelineLayout, histogramShader.computeCode,
+			sizeof(histogramShader.computeCode));
+
+	AutoExposureReduceShader reduceShader;
+	_reducePipeline = _createPipeline(device, _pipelineLayout, reduceShader.computeCode,
+			sizeof(reduceShader.computeCode));
+
+	_time = SDL_GetTicksNS();
+
+	_initialized = true;
+}
@@ -0,0 +1,85 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+
+// luminance range of histogram, in stops, pixels outside of it fall into its end bins
+const float EXPOSURE_MIN_LOG_LUMINANCE = -10.0f;
+const float EXPOSURE_MAX_LOG_LUMINANCE = 8.0f;
+
+// average luminance of frame is brought onto it, before exposure of tonemap pass is applied
+const float EXPOSURE_MIDDLE_GRAY = 0.18f;
+// rate exposure follows target with, per second
+const float EXPOSURE_ADAPTATION_SPEED = 1.5f;
+// frames further apart adapt as far as this, stalls do not snap exposure
+const float EXPOSURE_MAX_TIME_STEP = 0.25f;
+
+// Eye adaptation without readback. One pass builds log luminance histogram of scene color,
+// a second one reduces it to average luminance and moves exposure towards the one bringing it
+// onto middle gray, in a device local buffer the tonemap pass reads directly. Histogram is
+// cleared by the reduce pass for next frame.
+class AutoExposure {
+private:
+	struct ExposureConstants {
+		uint32_t inputSize[2];
+		float minLogLuminance;
+		float logLuminanceRange;
+		float adaptation;
+		float middleGray;
+		uint32_t isExposureValid;
+	};
+
+	vk::Device _device;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _set;
+	// exposure buffer alone, read by fragment shader
+	vk::DescriptorSetLayout _exposureSetLayout;
+	vk::DescriptorSet _exposureSet;
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _histogramPipeline;
+	vk::Pipeline _reducePipeline;
+
+	vk::Sampler _sampler;
+
+	AllocatedBuffer _histogramBuffer;
+	AllocatedBuffer _exposureBuffer;
+
+	// set is written again when scene color changes
+	vk::ImageView _colorView;
+
+	// of last record, in nanoseconds
+	uint64_t _time = 0;
+	// histogram is cleared and exposure snaps to target on next record otherwise
+	bool _isExposureValid = false;
+
+	bool _initialized = false;
+
+	static vk::Pipeline _createPipeline(vk::Device device, vk::PipelineLayout layout,
+			const uint32_t *pCode, size_t codeSize);
+
+public:
+	// returns true when set was written again, frames in flight are waited for before it is
+	bool ensure(const Attachment &color);
+	// next record snaps exposure to that of its frame
+	void invalidate();
+
+	// pass of graph, color is sampled at render extent, exposure is readable by fragment
+	// shaders once it is recorded
+	void record(vk::CommandBuffer commandBuffer, vk::Extent2D inputExtent);
+
+	// storage buffer with exposure as its first float, for fragment stage
+	vk::DescriptorSetLayout getExposureSetLayout() const;
+	vk::DescriptorSet getExposureSet() const;
+
+	void initialize(
+			vk::Device device, vk::DescriptorPool descriptorPool, vk::Sampler colorSampler);
+};
+
+#endif // !AUTO_EXPOSURE_H
@@ -1,16 +1,35 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
+#include <SDL3/SDL_log.h>
+
+#include <io/image.h>
+#include <profiler.h>
 #include <rendering/rendering_device.h>
-#include <rendering/types/attachment.h>
+#include <rendering/shader_library.h>
 
 #include "shaders/brdf.gen.h"
 #include "shaders/cubemap.gen.h"
-#include "shaders/irradiance_filter.gen.h"
+#include "shaders/cubemap_downsample.gen.h"
+#include "shaders/sh_project.gen.h"
 #include "shaders/specular_filter.gen.h"
 
 #include "environment_effects.h"
 
+// half floats are enough for lighting, storage support is mandatory for this format
+const vk::Format ENVIRONMENT_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+const uint32_t ENVIRONMENT_TEXEL_SIZE = 8;
+
 static vk::ShaderModule createModule(vk::Device device, const uint32_t *pCode, size_t size) {
 	vk::ShaderModuleCreateInfo createInfo = {};
 	createInfo.setPCode(pCode);
@@ -19,211 +38,114 @@ static vk::ShaderModule createModule(vk::Device device, const uint32_t *pCode, s
 	return device.createShaderModule(createInfo);
 }
 
-static vk::Pipeline createPipeline(vk::Device device, vk::ShaderModule vertexStage,
-		vk::ShaderModule fragmentStage, vk::PipelineLayout pipelineLayout,
-		vk::RenderPass renderPass) {
-	vk::PipelineShaderStageCreateInfo vertexStageInfo;
-	vertexStageInfo.setModule(vertexStage);
-	vertexStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
-	vertexStageInfo.setPName("main");
-
-	vk::PipelineShaderStageCreateInfo fragmentStageInfo;
-	fragmentStageInfo.setModule(fragmentStage);
-	fragmentStageInfo.setStage(vk::ShaderStageFlagBits::eFragment);
-	fragmentStageInfo.setPName("main");
-
-	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertexStageInfo, fragmentStageInfo };
-
-	vk::PipelineVertexInputStateCreateInfo vertexInput = {};
-
-	vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
-	inputAssembly.setTopology(vk::PrimitiveTopology::eTriangleList);
-
-	vk::PipelineViewportStateCreateInfo viewportState;
-	viewportState.setViewportCount(1);
-	viewportState.setScissorCount(1);
-
-	vk::PipelineRasterizationStateCreateInfo rasterizer;
-	rasterizer.setDepthBiasEnable(VK_FALSE);
-	rasterizer.setRasterizerDiscardEnable(VK_FALSE);
-	rasterizer.setPolygonMode(vk::PolygonMode::eFill);
-	rasterizer.setLineWidth(1.0f);
-	rasterizer.setCullMode(vk::CullModeFlagBits::eBack);
-	rasterizer.setFrontFace(vk::FrontFace::eCounterClockwise);
-	rasterizer.setDepthBiasEnable(VK_FALSE);
-
-	vk::PipelineMultisampleStateCreateInfo multisampling;
-	multisampling.setSampleShadingEnable(VK_FALSE);
-	multisampling.setRasterizationSamples(vk::SampleCountFlagBits::e1);
-
-	vk::PipelineDepthStencilStateCreateInfo depthStencil;
-	depthStencil.setDepthTestEnable(VK_FALSE);
-	depthStencil.setDepthWriteEnable(VK_FALSE);
-	depthStencil.setDepthBoundsTestEnable(VK_FALSE);
-	depthStencil.setStencilTestEnable(VK_FALSE);
-
-	vk::ColorComponentFlags colorWriteMask =
-			vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-			vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-
-	vk::PipelineColorBlendAttachmentState colorBlendAttachment;
-	colorBlendAttachment.setColorWriteMask(colorWriteMask);
-	colorBlendAttachment.setBlendEnable(VK_FALSE);
-
-	vk::PipelineColorBlendStateCreateInfo colorBlending;
-	colorBlending.setLogicOpEnable(VK_FALSE);
-	colorBlending.setLogicOp(vk::LogicOp::eCopy);
-	colorBlending.setAttachments(colorBlendAttachment);
-	colorBlending.setBlendConstants({ 0.0f, 0.0f, 0.0f, 0.0f });
-
-	std::vector<vk::DynamicState> dynamicStates = {
-		vk::DynamicState::eViewport,
-		vk::DynamicState::eScissor,
-	};
+// code comes from shader library, built in one is passed for when hot reload is off
+static vk::Pipeline createComputePipeline(vk::Device device, const std::string &shader,
+		const uint32_t *pCode, size_t size, vk::PipelineLayout pipelineLayout) {
+	std::vector<uint32_t> code = ShaderLibrary::getCode(shader, ShaderStage::Compute, pCode, size);
+	vk::ShaderModule computeModule =
+			createModule(device, code.data(), code.size() * sizeof(uint32_t));
 
-	vk::PipelineDynamicStateCreateInfo dynamicState;
-	dynamicState.setDynamicStates(dynamicStates);
-
-	vk::GraphicsPipelineCreateInfo createInfo;
-	createInfo.setStages(shaderStages);
-	createInfo.setPVertexInputState(&vertexInput);
-	createInfo.setPInputAssemblyState(&inputAssembly);
-	createInfo.setPViewportState(&viewportState);
-	createInfo.setPRasterizationState(&rasterizer);
-	createInfo.setPMultisampleState(&multisampling);
-	createInfo.setPDepthStencilState(&depthStencil);
-	createInfo.setPColorBlendState(&colorBlending);
-	createInfo.setPDynamicState(&dynamicState);
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo createInfo = {};
+	createInfo.setStage(computeStageInfo);
 	createInfo.setLayout(pipelineLayout);
-	createInfo.setRenderPass(renderPass);
-	createInfo.setSubpass(0);
 
-	vk::ResultValue<vk::Pipeline> result = device.createGraphicsPipeline(nullptr, createInfo);
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), createInfo);
+
+	device.destroyShaderModule(computeModule);
 
 	if (result.result != vk::Result::eSuccess)
-		throw std::runtime_error("Graphics pipeline creation failed!");
+		throw std::runtime_error("Compute pipeline creation failed!");
 
 	return result.value;
 }
 
-static vk::Sampler createSampler(vk::Device device, uint32_t mipLevels) {
-	float maxLod = static_cast<float>(mipLevels);
-
-	vk::SamplerCreateInfo createInfo = {};
-	createInfo.setMagFilter(vk::Filter::eLinear);
-	createInfo.setMinFilter(vk::Filter::eLinear);
-	createInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
-	createInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
-	createInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
-	createInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
-	createInfo.setUnnormalizedCoordinates(false);
-	createInfo.setCompareEnable(false);
-	createInfo.setCompareOp(vk::CompareOp::eAlways);
-	createInfo.setMipmapMode(vk::SamplerMipmapMode::eLinear);
-	createInfo.setMinLod(0.0f);
-	createInfo.setMaxLod(maxLod);
-	createInfo.setMipLodBias(0.0f);
-
-	return device.createSampler(createInfo);
+// storage images are bound one level at a time
+static vk::ImageView createLevelView(vk::Device device, vk::Image image, uint32_t level,
+		vk::ImageViewType viewType, uint32_t layerCount = 6) {
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(level);
+	subresourceRange.setLevelCount(1);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(layerCount);
+
+	vk::ImageViewCreateInfo createInfo;
+	createInfo.setImage(image);
+	createInfo.setViewType(viewType);
+	createInfo.setFormat(ENVIRONMENT_FORMAT);
+	createInfo.setSubresourceRange(subresourceRange);
+
+	return device.createImageView(createInfo);
 }
 
-RenderTarget RenderTarget::create(
-		vk::Device device, uint32_t size, vk::PhysicalDeviceMemoryProperties memProperties) {
-	vk::Format format = vk::Format::eR32G32B32A32Sfloat;
-	vk::ImageUsageFlags usage =
-			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
-
-	vk::ImageAspectFlagBits aspectFlags = vk::ImageAspectFlagBits::eColor;
-
-	assert(size > 0);
-
-	uint32_t arrayLayers = 6;
-
-	Attachment color = Attachment::create(device, size, size, format, usage, aspectFlags,
-			memProperties, arrayLayers, vk::ImageViewType::eCube,
-			vk::ImageCreateFlagBits::eCubeCompatible);
-
-	vk::AttachmentDescription colorAttachmentDescription = {};
-	colorAttachmentDescription.setFormat(format);
-	colorAttachmentDescription.setSamples(vk::SampleCountFlagBits::e1);
-	colorAttachmentDescription.setLoadOp(vk::AttachmentLoadOp::eDontCare);
-	colorAttachmentDescription.setStoreOp(vk::AttachmentStoreOp::eStore);
-	colorAttachmentDescription.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
-	colorAttachmentDescription.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
-	colorAttachmentDescription.setInitialLayout(vk::ImageLayout::eUndefined);
-	colorAttachmentDescription.setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
-
-	vk::AttachmentReference colorRef = {};
-	colorRef.setAttachment(0);
-	colorRef.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
-
-	vk::SubpassDescription subpass = {};
-	subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
-	subpass.setColorAttachments(colorRef);
-
-	// write from layer 0 (last bit) to layer 5
-	uint32_t viewMask = 0b00111111;
-	uint32_t correlationMask = 0b00111111;
-
-	vk::RenderPassMultiviewCreateInfo multiviewCreateInfo = {};
-	multiviewCreateInfo.setSubpassCount(1);
-	multiviewCreateInfo.setViewMasks(viewMask);
-	multiviewCreateInfo.setCorrelationMasks(correlationMask);
-
-	vk::RenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.setAttachments(colorAttachmentDescription);
-	renderPassInfo.setSubpasses(subpass);
-	renderPassInfo.setPNext(&multiviewCreateInfo);
-
-	vk::RenderPass renderPass = device.createRenderPass(renderPassInfo);
-
-	vk::ImageView colorView = color.getImageView();
-
-	vk::FramebufferCreateInfo framebufferInfo = {};
-	framebufferInfo.setRenderPass(renderPass);
-	framebufferInfo.setAttachments(colorView);
-	framebufferInfo.setWidth(size);
-	framebufferInfo.setHeight(size);
-	framebufferInfo.setLayers(1);
-
-	vk::Framebuffer framebuffer;
-	vk::Result err = device.createFramebuffer(&framebufferInfo, nullptr, &framebuffer);
-
-	if (err != vk::Result::eSuccess)
-		throw std::runtime_error("Failed to create multiview framebuffer!");
-
-	return RenderTarget(framebuffer, renderPass, color, size);
-}
-
-vk::Framebuffer RenderTarget::getFramebuffer() const {
-	return _framebuffer;
+static vk::ImageMemoryBarrier imageBarrier(vk::Image image, uint32_t mipLevels,
+		uint32_t arrayLayers, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask) {
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(0);
+	subresourceRange.setLevelCount(mipLevels);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(arrayLayers);
+
+	vk::ImageMemoryBarrier barrier;
+	barrier.setOldLayout(oldLayout);
+	barrier.setNewLayout(newLayout);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setSrcAccessMask(srcAccessMask);
+	barrier.setDstAccessMask(dstAccessMask);
+	barrier.setImage(image);
+	barrier.setSubresourceRange(subresourceRange);
+
+	return barrier;
 }
 
-vk::RenderPass RenderTarget::getRenderPass() const {
-	return _renderPass;
-}
-
-Attachment RenderTarget::getColorAttachment() const {
-	return _color;
-}
+// tightly packed levels of cache entry, every level holds all layers
+static std::vector<vk::BufferImageCopy> levelRegions(
+		uint32_t size, uint32_t levelCount, uint32_t layerCount, uint32_t texelSize) {
+	std::vector<vk::BufferImageCopy> regions;
+	vk::DeviceSize offset = 0;
+
+	for (uint32_t level = 0; level < levelCount; level++) {
+		uint32_t levelSize = std::max(size >> level, 1u);
+
+		vk::ImageSubresourceLayers imageSubresource;
+		imageSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		imageSubresource.setMipLevel(level);
+		imageSubresource.setBaseArrayLayer(0);
+		imageSubresource.setLayerCount(layerCount);
+
+		vk::BufferImageCopy region;
+		region.setBufferOffset(offset);
+		region.setBufferRowLength(0);
+		region.setBufferImageHeight(0);
+		region.setImageSubresource(imageSubresource);
+		region.setImageOffset(vk::Offset3D{ 0, 0, 0 });
+		region.setImageExtent(vk::Extent3D{ levelSize, levelSize, 1 });
+
+		regions.push_back(region);
+		offset += static_cast<vk::DeviceSize>(levelSize) * levelSize * layerCount * texelSize;
+	}
 
-uint32_t RenderTarget::getSize() const {
-	return _size;
+	return regions;
 }
 
-void RenderTarget::destroy(vk::Device device) {
-	_color.destroy(device);
-
-	device.destroyFramebuffer(_framebuffer, nullptr);
-	device.destroyRenderPass(_renderPass, nullptr);
-}
+static EnvironmentCache::Entry specularEntry(uint32_t size) {
+	EnvironmentCache::Entry entry = {};
+	entry.format = static_cast<uint32_t>(ENVIRONMENT_FORMAT);
+	entry.texelSize = ENVIRONMENT_TEXEL_SIZE;
+	entry.size = size;
+	entry.layerCount = 6;
+	entry.levelCount = SPECULAR_LEVEL_COUNT;
 
-RenderTarget::RenderTarget(
-		vk::Framebuffer framebuffer, vk::RenderPass renderPass, Attachment color, uint32_t size) {
-	_framebuffer = framebuffer;
-	_renderPass = renderPass;
-	_color = color;
-	_size = size;
+	return entry;
 }
 
 void EnvironmentEffects::_createDescriptors(vk::DescriptorPool descriptorPool) {
@@ -255,7 +177,7 @@ void EnvironmentEffects::_createDescriptors(vk::DescriptorPool descriptorPool) {
 			throw std::runtime_error("Failed to allocate BRDF set!");
 	}
 
-	// cubemap
+	// downsample of cubemap and its source
 
 	{
 		std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {};
@@ -278,133 +200,159 @@ void EnvironmentEffects::_createDescriptors(vk::DescriptorPool descriptorPool) {
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("Failed to create cubemap set layout!");
 
+		std::vector<vk::DescriptorSetLayout> layouts(MAX_CUBEMAP_LEVELS - 1, _cubemapSetLayout);
+
 		vk::DescriptorSetAllocateInfo allocInfo = {};
 		allocInfo.setDescriptorPool(descriptorPool);
-		allocInfo.setDescriptorSetCount(1);
-		allocInfo.setSetLayouts(_cubemapSetLayout);
+		allocInfo.setSetLayouts(layouts);
 
-		err = _device.allocateDescriptorSets(&allocInfo, &_cubemapSet);
+		err = _device.allocateDescriptorSets(&allocInfo, _downsampleSets);
 
 		if (err != vk::Result::eSuccess)
-			throw std::runtime_error("Failed to allocate cubemap set!");
+			throw std::runtime_error("Failed to allocate downsample sets!");
+
+		err = _device.allocateDescriptorSets(&allocInfo, _equirectangularDownsampleSets);
+
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to allocate downsample sets!");
 	}
 
 	// filter
 
 	{
-		vk::DescriptorSetLayoutBinding binding = {};
-		binding.setBinding(0);
-		binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		binding.setDescriptorCount(1);
-		binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {};
+		bindings[0].setBinding(0);
+		bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		bindings[0].setDescriptorCount(1);
+		bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+		bindings[1].setBinding(1);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+		bindings[1].setDescriptorCount(1);
+		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
 		vk::DescriptorSetLayoutCreateInfo createInfo = {};
-		createInfo.setBindings(binding);
+		createInfo.setBindings(bindings);
 
 		vk::Result err = _device.createDescriptorSetLayout(&createInfo, nullptr, &_filterSetLayout);
 
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("Failed to create filter set layout!");
 
+		std::vector<vk::DescriptorSetLayout> layouts(SPECULAR_LEVEL_COUNT, _filterSetLayout);
+
 		vk::DescriptorSetAllocateInfo allocInfo = {};
 		allocInfo.setDescriptorPool(descriptorPool);
-		allocInfo.setDescriptorSetCount(1);
+		allocInfo.setSetLayouts(layouts);
+
+		err = _device.allocateDescriptorSets(&allocInfo, _filterSets);
+
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to allocate filter sets!");
+
+		// cubemap samples its source like filters sample cubemap
 		allocInfo.setSetLayouts(_filterSetLayout);
 
-		err = _device.allocateDescriptorSets(&allocInfo, &_filterSet);
+		err = _device.allocateDescriptorSets(&allocInfo, &_cubemapSet);
 
 		if (err != vk::Result::eSuccess)
-			throw std::runtime_error("Failed to allocate filter set!");
+			throw std::runtime_error("Failed to allocate cubemap set!");
 	}
-}
 
-void EnvironmentEffects::_createPipelines() {
-	{
-		vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
-		layoutCreateInfo.setSetLayouts(_brdfSetLayout);
+	// sh projection
 
-		_brdfPipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
-
-		BrdfShader shader;
+	{
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {};
+		bindings[0].setBinding(0);
+		bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		bindings[0].setDescriptorCount(1);
+		bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
-		uint32_t codeSize = sizeof(shader.computeCode);
-		vk::ShaderModule computeModule = createModule(_device, shader.computeCode, codeSize);
+		bindings[1].setBinding(1);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[1].setDescriptorCount(1);
+		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
 
-		vk::PipelineShaderStageCreateInfo computeStageInfo = {};
-		computeStageInfo.setModule(computeModule);
-		computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
-		computeStageInfo.setPName("main");
+		vk::DescriptorSetLayoutCreateInfo createInfo = {};
+		createInfo.setBindings(bindings);
 
-		vk::ComputePipelineCreateInfo createInfo = {};
-		createInfo.setStage(computeStageInfo);
-		createInfo.setLayout(_brdfPipelineLayout);
+		vk::Result err =
+				_device.createDescriptorSetLayout(&createInfo, nullptr, &_projectSetLayout);
 
-		vk::ResultValue<vk::Pipeline> result = _device.createComputePipeline({}, createInfo);
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to create SH projection set layout!");
 
-		if (result.result != vk::Result::eSuccess)
-			throw std::runtime_error("Failed to create BRDF compute pipeline!");
+		vk::DescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.setDescriptorPool(descriptorPool);
+		allocInfo.setDescriptorSetCount(1);
+		allocInfo.setSetLayouts(_projectSetLayout);
 
-		_brdfPipeline = result.value;
+		err = _device.allocateDescriptorSets(&allocInfo, &_projectSet);
 
-		_device.destroyShaderModule(computeModule);
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to allocate SH projection set!");
 	}
+}
 
+void EnvironmentEffects::_createPipelines() {
 	{
 		vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
-		layoutCreateInfo.setSetLayouts(_cubemapSetLayout);
-
-		_cubemapPipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
-
-		CubemapShader shader;
-
-		uint32_t codeSize = sizeof(shader.computeCode);
-		vk::ShaderModule computeModule = createModule(_device, shader.computeCode, codeSize);
-
-		vk::PipelineShaderStageCreateInfo computeStageInfo = {};
-		computeStageInfo.setModule(computeModule);
-		computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
-		computeStageInfo.setPName("main");
+		layoutCreateInfo.setSetLayouts(_brdfSetLayout);
 
-		vk::ComputePipelineCreateInfo createInfo = {};
-		createInfo.setStage(computeStageInfo);
-		createInfo.setLayout(_cubemapPipelineLayout);
+		_brdfPipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
 
-		vk::ResultValue<vk::Pipeline> result = _device.createComputePipeline({}, createInfo);
+		_pipelineRecipes.push_back({ &_brdfPipeline, "brdf", [this]() {
+			return createComputePipeline(_device, "brdf", BrdfShader::computeCode,
+					sizeof(BrdfShader::computeCode), _brdfPipelineLayout);
+		} });
+	}
 
-		if (result.result != vk::Result::eSuccess)
-			throw std::runtime_error("Failed to create cubemap compute pipeline!");
+	{
+		vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.setSetLayouts(_filterSetLayout);
 
-		_cubemapPipeline = result.value;
+		_cubemapPipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
 
-		_device.destroyShaderModule(computeModule);
+		_pipelineRecipes.push_back({ &_cubemapPipeline, "cubemap", [this]() {
+			return createComputePipeline(_device, "cubemap", CubemapShader::computeCode,
+					sizeof(CubemapShader::computeCode), _cubemapPipelineLayout);
+		} });
 	}
 
-	RenderTarget rt = RenderTarget::create(_device, 1, _memProperties);
-
 	{
 		vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
-		layoutCreateInfo.setSetLayouts(_filterSetLayout);
+		layoutCreateInfo.setSetLayouts(_cubemapSetLayout);
 
-		_irradiancePipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
+		_downsamplePipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
 
-		IrradianceFilterShader shader;
+		_pipelineRecipes.push_back({ &_downsamplePipeline, "cubemap_downsample", [this]() {
+			return createComputePipeline(_device, "cubemap_downsample",
+					CubemapDownsampleShader::computeCode,
+					sizeof(CubemapDownsampleShader::computeCode), _downsamplePipelineLayout);
+		} });
+	}
 
-		uint32_t codeSize = sizeof(shader.vertexCode);
-		vk::ShaderModule vertexStage = createModule(_device, shader.vertexCode, codeSize);
+	{
+		vk::PushConstantRange pushConstants;
+		pushConstants.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+		pushConstants.setOffset(0);
+		pushConstants.setSize(sizeof(ProjectConstants));
 
-		codeSize = sizeof(shader.fragmentCode);
-		vk::ShaderModule fragmentStage = createModule(_device, shader.fragmentCode, codeSize);
+		vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.setPushConstantRanges(pushConstants);
+		layoutCreateInfo.setSetLayouts(_projectSetLayout);
 
-		_irradiancePipeline = createPipeline(
-				_device, vertexStage, fragmentStage, _irradiancePipelineLayout, rt.getRenderPass());
+		_projectPipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
 
-		_device.destroyShaderModule(vertexStage);
-		_device.destroyShaderModule(fragmentStage);
+		_pipelineRecipes.push_back({ &_projectPipeline, "sh_project", [this]() {
+			return createComputePipeline(_device, "sh_project", ShProjectShader::computeCode,
+					sizeof(ShProjectShader::computeCode), _projectPipelineLayout);
+		} });
 	}
 
 	{
 		vk::PushConstantRange pushConstants;
-		pushConstants.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		pushConstants.setStageFlags(vk::ShaderStageFlagBits::eCompute);
 		pushConstants.setOffset(0);
 		pushConstants.setSize(sizeof(SpecularFilterConstants));
 
@@ -414,22 +362,35 @@ void EnvironmentEffects::_createPipelines() {
 
 		_specularPipelineLayout = _device.createPipelineLayout(layoutCreateInfo);
 
-		SpecularFilterShader shader;
+		_pipelineRecipes.push_back({ &_specularPipeline, "specular_filter", [this]() {
+			return createComputePipeline(_device, "specular_filter",
+					SpecularFilterShader::computeCode,
+					sizeof(SpecularFilterShader::computeCode), _specularPipelineLayout);
+		} });
+	}
 
-		uint32_t codeSize = sizeof(shader.vertexCode);
-		vk::ShaderModule vertexStage = createModule(_device, shader.vertexCode, codeSize);
+	for (const PipelineRecipe &recipe : _pipelineRecipes)
+		_pipelineBuilds.push_back(std::async(
+				std::launch::async, [recipe]() { *recipe.pPipeline = recipe.build(); }));
+}
 
-		codeSize = sizeof(shader.fragmentCode);
-		vk::ShaderModule fragmentStage = createModule(_device, shader.fragmentCode, codeSize);
+void EnvironmentEffects::_waitPipelines() {
+	for (std::future<void> &build : _pipelineBuilds)
+		build.get();
 
-		_specularPipeline = createPipeline(
-				_device, vertexStage, fragmentStage, _specularPipelineLayout, rt.getRenderPass());
+	_pipelineBuilds.clear();
+}
 
-		_device.destroyShaderModule(vertexStage);
-		_device.destroyShaderModule(fragmentStage);
-	}
+bool EnvironmentEffects::reloadShaders(const std::vector<std::string> &shaders) {
+	_waitPipelines();
 
-	rt.destroy(_device);
+	// fence of last bake has signaled, nothing uses replaced pipelines
+	std::vector<vk::Pipeline> replaced = ShaderLibrary::rebuild(_pipelineRecipes, shaders);
+
+	for (vk::Pipeline pipeline : replaced)
+		_device.destroyPipeline(pipeline);
+
+	return !replaced.empty();
 }
 
 void EnvironmentEffects::_updateBrdfSet(vk::ImageView dstImageView) {
@@ -447,25 +408,53 @@ void EnvironmentEffects::_updateBrdfSet(vk::ImageView dstImageView) {
 	_device.updateDescriptorSets(writeInfo, nullptr);
 }
 
-void EnvironmentEffects::_updateCubemapSet(
-		vk::ImageView srcImageView, vk::ImageView dstCubemapView) {
+void EnvironmentEffects::_updateStorageSet(
+		vk::DescriptorSet set, vk::ImageView srcImageView, vk::ImageView dstImageView) {
 	std::array<vk::DescriptorImageInfo, 2> imageInfos = {};
 
 	imageInfos[0].setImageView(srcImageView);
 	imageInfos[0].setImageLayout(vk::ImageLayout::eGeneral);
 
-	imageInfos[1].setImageView(dstCubemapView);
+	imageInfos[1].setImageView(dstImageView);
 	imageInfos[1].setImageLayout(vk::ImageLayout::eGeneral);
 
 	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
 
-	writeInfos[0].setDstSet(_cubemapSet);
+	writeInfos[0].setDstSet(set);
 	writeInfos[0].setDstBinding(0);
 	writeInfos[0].setDescriptorType(vk::DescriptorType::eStorageImage);
 	writeInfos[0].setDescriptorCount(1);
 	writeInfos[0].setImageInfo(imageInfos[0]);
 
-	writeInfos[1].setDstSet(_cubemapSet);
+	writeInfos[1].setDstSet(set);
+	writeInfos[1].setDstBinding(1);
+	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+	writeInfos[1].setDescriptorCount(1);
+	writeInfos[1].setImageInfo(imageInfos[1]);
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
+}
+
+void EnvironmentEffects::_updateFilterSet(vk::DescriptorSet set, vk::ImageView srcImageView,
+		vk::Sampler sampler, vk::ImageView dstImageView) {
+	std::array<vk::DescriptorImageInfo, 2> imageInfos = {};
+
+	imageInfos[0].setImageView(srcImageView);
+	imageInfos[0].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	imageInfos[0].setSampler(sampler);
+
+	imageInfos[1].setImageView(dstImageView);
+	imageInfos[1].setImageLayout(vk::ImageLayout::eGeneral);
+
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+	writeInfos[0].setDstSet(set);
+	writeInfos[0].setDstBinding(0);
+	writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfos[0].setDescriptorCount(1);
+	writeInfos[0].setImageInfo(imageInfos[0]);
+
+	writeInfos[1].setDstSet(set);
 	writeInfos[1].setDstBinding(1);
 	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageImage);
 	writeInfos[1].setDescriptorCount(1);
@@ -474,139 +463,536 @@ void EnvironmentEffects::_updateCubemapSet(
 	_device.updateDescriptorSets(writeInfos, nullptr);
 }
 
-void EnvironmentEffects::_updateFilterSet(vk::ImageView srcImageView, vk::Sampler sampler) {
+void EnvironmentEffects::_updateProjectSet(vk::ImageView srcImageView, vk::Sampler sampler,
+		vk::Buffer dstBuffer, vk::DeviceSize size) {
 	vk::DescriptorImageInfo imageInfo = {};
 	imageInfo.setImageView(srcImageView);
 	imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
 	imageInfo.setSampler(sampler);
 
-	vk::WriteDescriptorSet writeInfo = {};
-	writeInfo.setDstSet(_filterSet);
-	writeInfo.setDstBinding(0);
-	writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-	writeInfo.setDescriptorCount(1);
-	writeInfo.setImageInfo(imageInfo);
+	vk::DescriptorBufferInfo bufferInfo(dstBuffer, 0, size);
 
-	_device.updateDescriptorSets(writeInfo, nullptr);
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+	writeInfos[0].setDstSet(_projectSet);
+	writeInfos[0].setDstBinding(0);
+	writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfos[0].setDescriptorCount(1);
+	writeInfos[0].setImageInfo(imageInfo);
+
+	writeInfos[1].setDstSet(_projectSet);
+	writeInfos[1].setDstBinding(1);
+	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[1].setDescriptorCount(1);
+	writeInfos[1].setBufferInfo(bufferInfo);
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
 }
 
-void EnvironmentEffects::_drawIrradianceFilter(
-		vk::CommandBuffer commandBuffer, RenderTarget renderTarget) {
-	vk::Viewport viewport = {};
-	viewport.setX(0.0f);
-	viewport.setY(0.0f);
-	viewport.setWidth(renderTarget.getSize());
-	viewport.setHeight(renderTarget.getSize());
-	viewport.setMinDepth(0.0f);
-	viewport.setMaxDepth(1.0f);
+uint32_t EnvironmentEffects::_getSliceCount() const {
+	// conversion, filtered levels one face at a time, projection and release
+	if (_bake.cache.isCached)
+		return 2;
 
-	vk::Extent2D extent(renderTarget.getSize(), renderTarget.getSize());
-	vk::Offset2D offset(0, 0);
+	return 2 + (SPECULAR_LEVEL_COUNT - 1) * 6;
+}
 
-	vk::Rect2D scissor = {};
-	scissor.setExtent(extent);
-	scissor.setOffset(offset);
+void EnvironmentEffects::_recordConvert(vk::CommandBuffer commandBuffer) {
+	uint32_t width = _bake.image->getWidth();
+	uint32_t height = _bake.image->getHeight();
 
-	vk::Rect2D renderArea = {};
-	renderArea.setExtent(extent);
-	renderArea.setOffset(offset);
+	uint32_t size = _bake.size;
+	uint32_t mipLevels = _bake.mipLevels;
+	uint32_t sourceLevels = _bake.equirectangularLevels;
 
-	vk::RenderPassBeginInfo renderPassBeginInfo = {};
-	renderPassBeginInfo.setRenderPass(renderTarget.getRenderPass());
-	renderPassBeginInfo.setFramebuffer(renderTarget.getFramebuffer());
-	renderPassBeginInfo.setRenderArea(renderArea);
+	vk::Image equirectangular = _bake.equirectangular.image;
+	vk::Image cubemap = _bake.data.cubemap.image;
+	vk::Image specular = _bake.data.specular.image;
 
-	commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	vk::PipelineStageFlags computeStage = vk::PipelineStageFlagBits::eComputeShader;
 
-	commandBuffer.setViewport(0, viewport);
-	commandBuffer.setScissor(0, scissor);
+	// source upload, compute queues support transfers
 
-	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
-	commandBuffer.bindPipeline(bindPoint, _irradiancePipeline);
-	commandBuffer.bindDescriptorSets(bindPoint, _irradiancePipelineLayout, 0, _filterSet, nullptr);
+	{
+		vk::ImageMemoryBarrier barrier = imageBarrier(equirectangular, sourceLevels, 1,
+				vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+				vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+		vk::ImageSubresourceLayers imageSubresource;
+		imageSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		imageSubresource.setMipLevel(0);
+		imageSubresource.setBaseArrayLayer(0);
+		imageSubresource.setLayerCount(1);
+
+		vk::BufferImageCopy region;
+		region.setBufferOffset(0);
+		region.setBufferRowLength(0);
+		region.setBufferImageHeight(0);
+		region.setImageSubresource(imageSubresource);
+		region.setImageOffset(vk::Offset3D{ 0, 0, 0 });
+		region.setImageExtent(vk::Extent3D{ width, height, 1 });
+
+		commandBuffer.copyBufferToImage(_bake.staging.buffer, equirectangular,
+				vk::ImageLayout::eTransferDstOptimal, region);
+	}
 
-	commandBuffer.draw(3, 1, 0, 0);
+	{
+		std::array<vk::ImageMemoryBarrier, 3> barriers = {
+			imageBarrier(equirectangular, sourceLevels, 1, vk::ImageLayout::eTransferDstOptimal,
+					vk::ImageLayout::eGeneral, vk::AccessFlagBits::eTransferWrite,
+					vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite),
+			imageBarrier(cubemap, mipLevels, 6, vk::ImageLayout::eUndefined,
+					vk::ImageLayout::eGeneral, vk::AccessFlagBits::eNone,
+					vk::AccessFlagBits::eShaderWrite),
+			imageBarrier(specular, SPECULAR_LEVEL_COUNT, 6, vk::ImageLayout::eUndefined,
+					vk::ImageLayout::eGeneral, vk::AccessFlagBits::eNone,
+					vk::AccessFlagBits::eShaderWrite),
+		};
+
+		if (_bake.cache.isCached) {
+			barriers[2].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+			barriers[2].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+		}
 
-	commandBuffer.endRenderPass();
-}
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe |
+						vk::PipelineStageFlagBits::eTransfer,
+				computeStage | vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr,
+				barriers);
+	}
 
-void EnvironmentEffects::_drawSpecularFilter(vk::CommandBuffer commandBuffer,
-		RenderTarget renderTarget, uint32_t size, float roughness) {
-	vk::Viewport viewport = {};
-	viewport.setX(0.0f);
-	viewport.setY(0.0f);
-	viewport.setWidth(renderTarget.getSize());
-	viewport.setHeight(renderTarget.getSize());
-	viewport.setMinDepth(0.0f);
-	viewport.setMaxDepth(1.0f);
+	if (_bake.cache.isCached) {
+		const EnvironmentCache::Entry &entry = _bake.cache.entry;
 
-	vk::Extent2D extent(renderTarget.getSize(), renderTarget.getSize());
-	vk::Offset2D offset(0, 0);
+		std::vector<vk::BufferImageCopy> regions =
+				levelRegions(entry.size, entry.levelCount, entry.layerCount, entry.texelSize);
 
-	vk::Rect2D scissor = {};
-	scissor.setExtent(extent);
-	scissor.setOffset(offset);
+		commandBuffer.copyBufferToImage(_bake.specularTransfer.buffer, specular,
+				vk::ImageLayout::eTransferDstOptimal, regions);
+	}
 
-	vk::Rect2D renderArea = {};
-	renderArea.setExtent(extent);
-	renderArea.setOffset(offset);
+	// levels of source, cubemap reads them filtered
 
-	vk::RenderPassBeginInfo renderPassBeginInfo = {};
-	renderPassBeginInfo.setRenderPass(renderTarget.getRenderPass());
-	renderPassBeginInfo.setFramebuffer(renderTarget.getFramebuffer());
-	renderPassBeginInfo.setRenderArea(renderArea);
+	{
+		vk::MemoryBarrier barrier;
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
 
-	commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
+		commandBuffer.bindPipeline(bindPoint, _downsamplePipeline);
 
-	commandBuffer.setViewport(0, viewport);
-	commandBuffer.setScissor(0, scissor);
+		for (uint32_t level = 1; level < sourceLevels; level++) {
+			if (level > 1) {
+				commandBuffer.pipelineBarrier(
+						computeStage, computeStage, {}, barrier, nullptr, nullptr);
+			}
 
-	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
-	commandBuffer.bindPipeline(bindPoint, _specularPipeline);
-	commandBuffer.bindDescriptorSets(bindPoint, _specularPipelineLayout, 0, _filterSet, nullptr);
+			uint32_t groupCountX = (std::max(width >> level, 1u) + 7) / 8;
+			uint32_t groupCountY = (std::max(height >> level, 1u) + 7) / 8;
+
+			commandBuffer.bindDescriptorSets(bindPoint, _downsamplePipelineLayout, 0,
+					_equirectangularDownsampleSets[level - 1], nullptr);
+			commandBuffer.dispatch(groupCountX, groupCountY, 1);
+		}
+
+		vk::ImageMemoryBarrier imageMemoryBarrier = imageBarrier(equirectangular, sourceLevels, 1,
+				vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.pipelineBarrier(
+				computeStage, computeStage, {}, nullptr, nullptr, imageMemoryBarrier);
+	}
+
+	// equirectangular to cubemap
+
+	{
+		uint32_t groupCount = (size + 15) / 16;
+
+		commandBuffer.bindPipeline(bindPoint, _cubemapPipeline);
+		commandBuffer.bindDescriptorSets(
+				bindPoint, _cubemapPipelineLayout, 0, _cubemapSet, nullptr);
+		commandBuffer.dispatch(groupCount, groupCount, 6);
+	}
+
+	// mip chain, every level reads the previous one
+
+	{
+		vk::MemoryBarrier barrier;
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.bindPipeline(bindPoint, _downsamplePipeline);
+
+		for (uint32_t level = 1; level < mipLevels; level++) {
+			commandBuffer.pipelineBarrier(
+					computeStage, computeStage, {}, barrier, nullptr, nullptr);
+
+			uint32_t levelSize = std::max(size >> level, 1u);
+			uint32_t groupCount = (levelSize + 7) / 8;
+
+			commandBuffer.bindDescriptorSets(bindPoint, _downsamplePipelineLayout, 0,
+					_downsampleSets[level - 1], nullptr);
+			commandBuffer.dispatch(groupCount, groupCount, 6);
+		}
+
+		vk::ImageMemoryBarrier imageMemoryBarrier = imageBarrier(cubemap, mipLevels, 6,
+				vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.pipelineBarrier(
+				computeStage, computeStage, {}, nullptr, nullptr, imageMemoryBarrier);
+	}
+
+	// mirror level is a single fetch per texel, not worth a slice of its own
+	if (!_bake.cache.isCached)
+		_recordFilter(commandBuffer, 0, 0, 6);
+}
+
+void EnvironmentEffects::_recordFilter(
+		vk::CommandBuffer commandBuffer, uint32_t level, uint32_t firstFace, uint32_t faceCount) {
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+
+	uint32_t levelSize = _bake.specularSize >> level;
+	uint32_t groupCount = (levelSize + 7) / 8;
 
 	SpecularFilterConstants constants = {};
-	constants.size = size;
-	constants.roughness = roughness;
+	constants.size = _bake.size;
+	constants.roughness = static_cast<float>(level) / static_cast<float>(SPECULAR_LEVEL_COUNT - 1);
+	constants.sampleCount = _bake.sampleCounts[level];
+	constants.firstFace = firstFace;
 
-	commandBuffer.pushConstants(_specularPipelineLayout, vk::ShaderStageFlagBits::eFragment, 0,
+	commandBuffer.bindPipeline(bindPoint, _specularPipeline);
+	commandBuffer.bindDescriptorSets(
+			bindPoint, _specularPipelineLayout, 0, _filterSets[level], nullptr);
+	commandBuffer.pushConstants(_specularPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
 			sizeof(constants), &constants);
+	commandBuffer.dispatch(groupCount, groupCount, faceCount);
+}
+
+void EnvironmentEffects::_recordFinish(vk::CommandBuffer commandBuffer) {
+	uint32_t size = _bake.size;
+	uint32_t mipLevels = _bake.mipLevels;
+
+	vk::Image cubemap = _bake.data.cubemap.image;
+	vk::Image specular = _bake.data.specular.image;
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	vk::PipelineStageFlags computeStage = vk::PipelineStageFlagBits::eComputeShader;
+
+	// irradiance projection and readback for cache
+
+	if (!_bake.cache.isCached) {
+		uint32_t groupCount = SH_SAMPLE_SIZE / 8;
+
+		ProjectConstants constants = {};
+		constants.sampleSize = SH_SAMPLE_SIZE;
+		constants.lod = std::max(std::log2(static_cast<float>(size) / SH_SAMPLE_SIZE), 0.0f);
+
+		commandBuffer.bindPipeline(bindPoint, _projectPipeline);
+		commandBuffer.bindDescriptorSets(
+				bindPoint, _projectPipelineLayout, 0, _projectSet, nullptr);
+		commandBuffer.pushConstants(_projectPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+				sizeof(constants), &constants);
+		commandBuffer.dispatch(groupCount, groupCount, 6);
+	}
+
+	if (_bake.isSaved) {
+		const EnvironmentCache::Entry &entry = _bake.cache.entry;
+
+		vk::ImageMemoryBarrier barrier = imageBarrier(specular, SPECULAR_LEVEL_COUNT, 6,
+				vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+
+		commandBuffer.pipelineBarrier(computeStage, vk::PipelineStageFlagBits::eTransfer, {},
+				nullptr, nullptr, barrier);
+
+		std::vector<vk::BufferImageCopy> regions =
+				levelRegions(entry.size, entry.levelCount, entry.layerCount, entry.texelSize);
+
+		commandBuffer.copyImageToBuffer(specular, vk::ImageLayout::eTransferSrcOptimal,
+				_bake.specularTransfer.buffer, regions);
+	}
+
+	vk::PipelineStageFlags bakeStages = computeStage | vk::PipelineStageFlagBits::eTransfer;
+
+	vk::MemoryBarrier hostBarrier;
+	hostBarrier.setSrcAccessMask(
+			vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+	hostBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+
+	std::array<vk::ImageMemoryBarrier, 2> barriers = {
+		imageBarrier(cubemap, mipLevels, 6, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eShaderWrite,
+				vk::AccessFlagBits::eShaderRead),
+		imageBarrier(specular, SPECULAR_LEVEL_COUNT, 6, _bake.specularLayout,
+				vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+				vk::AccessFlagBits::eShaderRead),
+	};
+
+	if (_computeQueueFamily == _graphicsQueueFamily) {
+		// later frames on the same queue are ordered after the bake
+		commandBuffer.pipelineBarrier(bakeStages,
+				vk::PipelineStageFlagBits::eAllCommands | vk::PipelineStageFlagBits::eHost, {},
+				hostBarrier, nullptr, barriers);
+		return;
+	}
+
+	commandBuffer.pipelineBarrier(
+			bakeStages, vk::PipelineStageFlagBits::eHost, {}, hostBarrier, nullptr, nullptr);
+
+	// release on compute queue, acquired by bakePoll
+	for (vk::ImageMemoryBarrier &barrier : barriers) {
+		barrier.setSrcQueueFamilyIndex(_computeQueueFamily);
+		barrier.setDstQueueFamilyIndex(_graphicsQueueFamily);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eNone);
+	}
+
+	commandBuffer.pipelineBarrier(bakeStages, vk::PipelineStageFlagBits::eBottomOfPipe, {},
+			nullptr, nullptr, barriers);
+}
+
+void EnvironmentEffects::_recordSlice(vk::CommandBuffer commandBuffer, uint32_t slice) {
+	uint32_t sliceCount = _getSliceCount();
+
+	if (slice == 0) {
+		uint32_t scope = _profiler.scopeCreate("environment convert");
+		_profiler.scopeBegin(commandBuffer, scope);
+		_recordConvert(commandBuffer);
+		_profiler.scopeEnd(commandBuffer, scope);
+		return;
+	}
 
-	commandBuffer.draw(3, 1, 0, 0);
+	if (slice == sliceCount - 1) {
+		uint32_t scope = _profiler.scopeCreate("environment finish");
+		_profiler.scopeBegin(commandBuffer, scope);
+		_recordFinish(commandBuffer);
+		_profiler.scopeEnd(commandBuffer, scope);
+		return;
+	}
+
+	// slices are in submission order, barriers of conversion slice still apply
+	uint32_t level = 1 + (slice - 1) / 6;
+	uint32_t face = (slice - 1) % 6;
 
-	commandBuffer.endRenderPass();
+	uint32_t scope = _profiler.scopeCreate("environment filter face");
+	_profiler.scopeBegin(commandBuffer, scope);
+	_recordFilter(commandBuffer, level, face, 1);
+	_profiler.scopeEnd(commandBuffer, scope);
 }
 
-void EnvironmentEffects::_copyImageToLevel(
-		vk::Image srcImage, vk::Image dstImage, uint32_t level, uint32_t size) {
-	vk::ImageSubresourceLayers srcSubresource = {};
-	srcSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
-	srcSubresource.setMipLevel(0);
-	srcSubresource.setBaseArrayLayer(0);
-	srcSubresource.setLayerCount(6);
+void EnvironmentEffects::_submitSlices(uint32_t sliceCount) {
+	_device.resetCommandPool(_commandPool);
+
+	vk::CommandBufferBeginInfo beginInfo = { vk::CommandBufferUsageFlagBits::eOneTimeSubmit };
+	_commandBuffer.begin(beginInfo);
+
+	uint64_t timestamp, counter;
+
+	if (Profiler::isTracing() && RD::getSingleton().getCalibratedTimestamp(timestamp, counter))
+		_profiler.calibrate(timestamp, counter);
 
-	vk::ImageSubresourceLayers dstSubresource = {};
-	dstSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
-	dstSubresource.setMipLevel(level);
-	dstSubresource.setBaseArrayLayer(0);
-	dstSubresource.setLayerCount(6);
+	// fence of previous submit was waited for
+	_profiler.begin(_commandBuffer, 0);
 
-	vk::Extent3D extent(size, size, 1);
+	for (uint32_t i = 0; i < sliceCount; i++)
+		_recordSlice(_commandBuffer, _bake.slice + i);
 
-	vk::ImageCopy copyInfo = {};
-	copyInfo.setSrcSubresource(srcSubresource);
-	copyInfo.setDstSubresource(dstSubresource);
-	copyInfo.setExtent(extent);
+	_commandBuffer.end();
+
+	vk::SubmitInfo submitInfo;
+	submitInfo.setCommandBuffers(_commandBuffer);
 
 	{
-		vk::CommandBuffer commandBuffer = RD::getSingleton().beginSingleTimeCommands();
+		std::lock_guard<std::mutex> lock(RD::getSingleton().getQueueMutex());
+		_computeQueue.submit(submitInfo, _fence);
+	}
+
+	_profiler.submitted(0);
+
+	_bake.slice += sliceCount;
+}
+
+void EnvironmentEffects::_submitBake() {
+	RD &rd = RD::getSingleton();
+
+	_waitPipelines();
+
+	uint32_t width = _bake.image->getWidth();
+	uint32_t height = _bake.image->getHeight();
+
+	uint32_t size = _bake.size;
+	uint32_t mipLevels = _bake.mipLevels;
+
+	uint32_t sourceLevels = _bake.equirectangularLevels;
+
+	// levels are downsampled as storage images, cubemap filters between them
+	_bake.equirectangular = rd.imageCreate(MemoryCategory::Environment, width, height,
+			ENVIRONMENT_FORMAT, sourceLevels,
+			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage |
+					vk::ImageUsageFlagBits::eSampled);
+	_bake.equirectangularView =
+			rd.imageViewCreate(_bake.equirectangular.image, ENVIRONMENT_FORMAT, sourceLevels);
+
+	for (uint32_t level = 0; level < sourceLevels; level++) {
+		vk::ImageView view = createLevelView(_device, _bake.equirectangular.image, level,
+				vk::ImageViewType::e2DArray, 1);
+		_bake.equirectangularLevelViews.push_back(view);
+	}
+
+	EnvironmentData &data = _bake.data;
+
+	data.cubemap = rd.imageCubeCreate(MemoryCategory::Environment, size, ENVIRONMENT_FORMAT,
+			mipLevels, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+	data.cubemapView = rd.imageViewCreate(
+			data.cubemap.image, ENVIRONMENT_FORMAT, mipLevels, 6, vk::ImageViewType::eCube);
+	data.cubemapSampler = rd.samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge);
+
+	data.specular = rd.imageCubeCreate(MemoryCategory::Environment, _bake.specularSize,
+			ENVIRONMENT_FORMAT, SPECULAR_LEVEL_COUNT,
+			vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled |
+					vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+	data.specularView = rd.imageViewCreate(data.specular.image, ENVIRONMENT_FORMAT,
+			SPECULAR_LEVEL_COUNT, 6, vk::ImageViewType::eCube);
+	data.specularSampler =
+			rd.samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge);
+	data.specularSize = _bake.specularSize;
+
+	// cubemap level 0 is written as cube, downsampled levels as layers
+	_bake.cubemapLevelViews.push_back(
+			createLevelView(_device, data.cubemap.image, 0, vk::ImageViewType::eCube));
+
+	for (uint32_t level = 1; level < mipLevels; level++) {
+		vk::ImageView view =
+				createLevelView(_device, data.cubemap.image, level, vk::ImageViewType::e2DArray);
+		_bake.cubemapLevelViews.push_back(view);
+	}
+
+	// level 0 of downsample reads layer view, cube view is only for its writer
+	vk::ImageView baseLayersView =
+			createLevelView(_device, data.cubemap.image, 0, vk::ImageViewType::e2DArray);
+	_bake.cubemapLevelViews.push_back(baseLayersView);
+
+	// filter shader picks level itself, anisotropy would only cost
+	_bake.filterSampler = rd.samplerGet(
+			vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, 0.0f, false);
+
+	_updateFilterSet(_cubemapSet, _bake.equirectangularView, _bake.filterSampler,
+			_bake.cubemapLevelViews[0]);
+
+	for (uint32_t level = 1; level < sourceLevels; level++) {
+		_updateStorageSet(_equirectangularDownsampleSets[level - 1],
+				_bake.equirectangularLevelViews[level - 1], _bake.equirectangularLevelViews[level]);
+	}
+
+	for (uint32_t level = 1; level < mipLevels; level++) {
+		vk::ImageView srcView = level == 1 ? baseLayersView : _bake.cubemapLevelViews[level - 1];
+		_updateStorageSet(_downsampleSets[level - 1], srcView, _bake.cubemapLevelViews[level]);
+	}
+
+	EnvironmentCache::Entry &entry = _bake.cache.entry;
+	_bake.isSaved = !_bake.cache.isCached && !_bake.isProgressive;
+
+	if (_bake.cache.isCached) {
+		_bake.specularTransfer = rd.bufferCreate(MemoryCategory::Staging, BufferClass::Staging,
+				vk::BufferUsageFlagBits::eTransferSrc, entry.data.size(),
+				&_bake.specularTransferAllocInfo);
+		_bake.specularLayout = vk::ImageLayout::eTransferDstOptimal;
+
+		memcpy(_bake.specularTransferAllocInfo.pMappedData, entry.data.data(),
+				entry.data.size());
+		rd.bufferFlush(_bake.specularTransfer);
+	} else {
+		entry = specularEntry(_bake.specularSize);
+		_bake.specularLayout = vk::ImageLayout::eGeneral;
+
+		if (_bake.isSaved) {
+			_bake.specularTransfer = rd.bufferCreate(MemoryCategory::Staging, BufferClass::Readback,
+					vk::BufferUsageFlagBits::eTransferDst, EnvironmentCache::getDataSize(entry),
+					&_bake.specularTransferAllocInfo);
+			_bake.specularLayout = vk::ImageLayout::eTransferSrcOptimal;
+		}
+
+		for (uint32_t level = 0; level < SPECULAR_LEVEL_COUNT; level++) {
+			vk::ImageView view = createLevelView(
+					_device, data.specular.image, level, vk::ImageViewType::e2DArray);
+			_bake.specularLevelViews.push_back(view);
+
+			_updateFilterSet(_filterSets[level], data.cubemapView, _bake.filterSampler, view);
+		}
+
+		vk::DeviceSize partialsSize = sizeof(glm::vec4) * SH_PARTIAL_STRIDE * SH_PARTIAL_COUNT;
+
+		_bake.partials = rd.bufferCreate(MemoryCategory::Environment, BufferClass::Readback,
+				vk::BufferUsageFlagBits::eStorageBuffer, partialsSize, &_bake.partialsAllocInfo);
+
+		_updateProjectSet(
+				data.cubemapView, _bake.filterSampler, _bake.partials.buffer, partialsSize);
+	}
+
+	_submitSlices(_bake.isProgressive ? 1 : _getSliceCount());
+	_bake.isSubmitted = true;
+}
+
+std::array<glm::vec4, 9> EnvironmentEffects::reduceIrradiance(const glm::vec4 *pPartials) {
+	std::array<glm::vec4, 9> coefficients = {};
+	float weight = 0.0f;
+
+	for (uint32_t i = 0; i < SH_PARTIAL_COUNT; i++) {
+		for (uint32_t j = 0; j < 9; j++)
+			coefficients[j] += pPartials[i * SH_PARTIAL_STRIDE + j];
+
+		weight += pPartials[i * SH_PARTIAL_STRIDE + 9].x;
+	}
+
+	// texel weights sum to sphere, cosine lobe convolution per band divided by pi
+	const float PI = 3.14159265359f;
+	const std::array<float, 9> BAND_FACTORS = {
+		1.0f,
+		2.0f / 3.0f,
+		2.0f / 3.0f,
+		2.0f / 3.0f,
+		0.25f,
+		0.25f,
+		0.25f,
+		0.25f,
+		0.25f,
+	};
+
+	float scale = weight > 0.0f ? 4.0f * PI / weight : 0.0f;
+
+	for (uint32_t i = 0; i < 9; i++)
+		coefficients[i] *= scale * BAND_FACTORS[i];
+
+	return coefficients;
+}
+
+void EnvironmentEffects::_releaseBake() {
+	RD &rd = RD::getSingleton();
+
+	rd.bufferDestroy(_bake.staging);
+
+	if (_bake.isSubmitted) {
+		rd.imageViewDestroy(_bake.equirectangularView);
+		rd.imageDestroy(_bake.equirectangular);
 
-		// clone framebuffer image level 0 to level i of filteredCube
-		commandBuffer.copyImage(srcImage, vk::ImageLayout::eTransferSrcOptimal, dstImage,
-				vk::ImageLayout::eTransferDstOptimal, copyInfo);
+		for (vk::ImageView view : _bake.equirectangularLevelViews)
+			rd.imageViewDestroy(view);
 
-		RD::getSingleton().endSingleTimeCommands(commandBuffer);
+		for (vk::ImageView view : _bake.cubemapLevelViews)
+			rd.imageViewDestroy(view);
+
+		for (vk::ImageView view : _bake.specularLevelViews)
+			rd.imageViewDestroy(view);
+
+		rd.bufferDestroy(_bake.partials);
+		rd.bufferDestroy(_bake.specularTransfer);
 	}
+
+	_bake = {};
+	_isBaking = false;
 }
 
 AllocatedImage EnvironmentEffects::generateBRDF() {
@@ -614,9 +1000,42 @@ AllocatedImage EnvironmentEffects::generateBRDF() {
 
 	const vk::Format FORMAT = vk::Format::eR16G16Sfloat;
 	const uint32_t SIZE = 256;
+	const uint32_t TEXEL_SIZE = 4;
+
+	AllocatedImage outImage = rd.imageCreate(MemoryCategory::Environment, SIZE, SIZE, FORMAT, 1,
+			vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled |
+					vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+
+	const uint32_t PARAMETERS[] = { SIZE, static_cast<uint32_t>(FORMAT) };
+	uint64_t key = EnvironmentCache::hash(PARAMETERS, sizeof(PARAMETERS));
+
+	EnvironmentCache::Entry entry = {};
+
+	if (EnvironmentCache::load(key, entry) && entry.size == SIZE && entry.levelCount == 1 &&
+			entry.layerCount == 1 && entry.texelSize == TEXEL_SIZE) {
+		rd.imageLayoutTransition(outImage.image, FORMAT, 1, 1, vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eTransferDstOptimal);
+
+		rd.imageSend(outImage.image, SIZE, SIZE, entry.data.data(), entry.data.size(),
+				vk::ImageLayout::eTransferDstOptimal);
+
+		rd.imageLayoutTransition(outImage.image, FORMAT, 1, 1,
+				vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		return outImage;
+	}
 
-	AllocatedImage outImage = rd.imageCreate(SIZE, SIZE, FORMAT, 1,
-			vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+	entry = {};
+	entry.format = static_cast<uint32_t>(FORMAT);
+	entry.texelSize = TEXEL_SIZE;
+	entry.size = SIZE;
+	entry.layerCount = 1;
+	entry.levelCount = 1;
+
+	VmaAllocationInfo readbackAllocInfo;
+	AllocatedBuffer readback = rd.bufferCreate(MemoryCategory::Staging, BufferClass::Readback,
+			vk::BufferUsageFlagBits::eTransferDst, EnvironmentCache::getDataSize(entry),
+			&readbackAllocInfo);
 
 	rd.imageLayoutTransition(
 			outImage.image, FORMAT, 1, 1, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
@@ -624,6 +1043,7 @@ AllocatedImage EnvironmentEffects::generateBRDF() {
 	vk::ImageView imageView = rd.imageViewCreate(outImage.image, FORMAT, 1);
 
 	_updateBrdfSet(imageView);
+	_waitPipelines();
 
 	vk::CommandBuffer commandBuffer = rd.beginSingleTimeCommands();
 
@@ -634,172 +1054,281 @@ AllocatedImage EnvironmentEffects::generateBRDF() {
 	commandBuffer.bindDescriptorSets(bindPoint, _brdfPipelineLayout, 0, _brdfSet, nullptr);
 	commandBuffer.dispatch(groupCount, groupCount, 1);
 
+	{
+		vk::ImageMemoryBarrier barrier = imageBarrier(outImage.image, 1, 1,
+				vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+				vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+		std::vector<vk::BufferImageCopy> regions = levelRegions(SIZE, 1, 1, TEXEL_SIZE);
+
+		commandBuffer.copyImageToBuffer(outImage.image, vk::ImageLayout::eTransferSrcOptimal,
+				readback.buffer, regions);
+
+		vk::MemoryBarrier hostBarrier;
+		hostBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		hostBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+
+		barrier = imageBarrier(outImage.image, 1, 1, vk::ImageLayout::eTransferSrcOptimal,
+				vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eNone,
+				vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eFragmentShader, {},
+				hostBarrier, nullptr, barrier);
+	}
+
 	rd.endSingleTimeCommands(commandBuffer);
 
 	rd.imageViewDestroy(imageView);
 
-	rd.imageLayoutTransition(outImage.image, FORMAT, 1, 1, vk::ImageLayout::eGeneral,
-			vk::ImageLayout::eShaderReadOnlyOptimal);
+	rd.bufferInvalidate(readback);
+
+	const uint8_t *pData = static_cast<const uint8_t *>(readbackAllocInfo.pMappedData);
+	entry.data.assign(pData, pData + EnvironmentCache::getDataSize(entry));
+
+	EnvironmentCache::save(key, entry);
+
+	rd.bufferDestroy(readback);
 
 	return outImage;
 }
 
-AllocatedImage EnvironmentEffects::cubemapCreate(vk::ImageView imageView, uint32_t size) {
-	RD &rd = RD::getSingleton();
+bool EnvironmentEffects::bakeBegin(const std::shared_ptr<Image> image, bool isProgressive) {
+	if (_isBaking)
+		return false;
 
-	const vk::Format FORMAT = vk::Format::eR32G32B32A32Sfloat;
+	uint32_t width = image->getWidth();
+	uint32_t height = image->getHeight();
 
+	// face spans a quarter of source around horizon, more texels than that would only be
+	// interpolated
+	uint32_t size = std::clamp(width / 4, 1u, _maxCubemapSize);
 	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(size))) + 1;
 
-	AllocatedImage outImage = rd.imageCubeCreate(size, FORMAT, mipLevels,
-			vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst |
-					vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+	// cubemap samples source at level of its texel footprint, levels past the next are not read
+	uint32_t sourceLevels =
+			static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	float footprint = std::log2(std::max(static_cast<float>(width) / (4.0f * size), 1.0f));
 
-	rd.imageLayoutTransition(outImage.image, FORMAT, mipLevels, 6, vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eGeneral);
+	_bake = {};
+	_bake.image = image;
+	_bake.size = size;
+	_bake.mipLevels = std::min(mipLevels, MAX_CUBEMAP_LEVELS);
+	_bake.specularSize = _specularSize;
+	_bake.equirectangularLevels = std::min(
+			{ static_cast<uint32_t>(footprint) + 2, sourceLevels, MAX_CUBEMAP_LEVELS });
+	_bake.isProgressive = isProgressive;
 
-	vk::ImageView outImageView =
-			rd.imageViewCreate(outImage.image, FORMAT, mipLevels, 6, vk::ImageViewType::eCube);
+	for (uint32_t level = 0; level < SPECULAR_LEVEL_COUNT; level++)
+		_bake.sampleCounts[level] = _sampleCounts[level];
 
-	_updateCubemapSet(imageView, outImageView);
+	size_t dataSize = static_cast<size_t>(width) * height *
+			Image::getFormatByteSize(Image::Format::RGBA16F);
 
-	vk::CommandBuffer commandBuffer = rd.beginSingleTimeCommands();
+	RD &rd = RD::getSingleton();
 
-	uint32_t groupCount = (size + 15) / 16;
-	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	_bake.staging = rd.bufferCreate(MemoryCategory::Staging, BufferClass::Staging,
+			vk::BufferUsageFlagBits::eTransferSrc, dataSize, &_bake.stagingAllocInfo);
+
+	// copying hundreds of megabytes would stall the frame
+	void *pStaging = _bake.stagingAllocInfo.pMappedData;
+	AllocatedBuffer staging = _bake.staging;
+
+	// bake output depends on source and parameters the bake was done with
+	uint32_t parameters[7 + SPECULAR_LEVEL_COUNT] = {
+		width,
+		height,
+		size,
+		_bake.mipLevels,
+		_bake.specularSize,
+		SPECULAR_LEVEL_COUNT,
+		SH_SAMPLE_SIZE,
+	};
 
-	commandBuffer.bindPipeline(bindPoint, _cubemapPipeline);
-	commandBuffer.bindDescriptorSets(bindPoint, _cubemapPipelineLayout, 0, _cubemapSet, nullptr);
-	commandBuffer.dispatch(groupCount, groupCount, 6);
+	// preview bake must not be picked up by full quality one
+	for (uint32_t level = 0; level < SPECULAR_LEVEL_COUNT; level++)
+		parameters[7 + level] = _bake.sampleCounts[level];
 
-	rd.endSingleTimeCommands(commandBuffer);
+	_bake.stagingCopy = std::async(std::launch::async,
+			[image, pStaging, dataSize, staging, parameters, isProgressive,
+					specularSize = _bake.specularSize]() {
+				// source in RGBA16F is copied to staging as is, others convert a copy first
+				std::shared_ptr<Image> converted = image;
 
-	rd.imageViewDestroy(outImageView);
+				if (image->getFormat() != Image::Format::RGBA16F) {
+					converted = std::make_shared<Image>(*image);
+					converted->convert(Image::Format::RGBA16F);
+				}
 
-	rd.imageLayoutTransition(outImage.image, FORMAT, mipLevels, 6, vk::ImageLayout::eGeneral,
-			vk::ImageLayout::eTransferDstOptimal);
+				const std::vector<uint8_t> &data = converted->getData();
+				memcpy(pStaging, data.data(), std::min(dataSize, data.size()));
+				RD::getSingleton().bufferFlush(staging);
 
-	rd.imageGenerateMipmaps(outImage.image, size, size, FORMAT, mipLevels, 6);
+				CacheLookup lookup = {};
 
-	return outImage;
-}
+				// animated skies rarely repeat, hashing and lookup would be wasted
+				if (isProgressive)
+					return lookup;
 
-AllocatedImage EnvironmentEffects::filterIrradiance(vk::ImageView imageView) {
-	vk::Sampler sampler = createSampler(_device, 1);
-	_updateFilterSet(imageView, sampler);
+				lookup.key = EnvironmentCache::hash(data.data(), data.size());
+				lookup.key = EnvironmentCache::hash(parameters, sizeof(parameters), lookup.key);
 
-	vk::Format format = vk::Format::eR32G32B32A32Sfloat;
+				EnvironmentCache::Entry expected = specularEntry(specularSize);
 
-	const uint32_t FILTERED_SIZE = 32;
+				lookup.isCached = EnvironmentCache::load(lookup.key, lookup.entry) &&
+						lookup.entry.format == expected.format &&
+						lookup.entry.texelSize == expected.texelSize &&
+						lookup.entry.size == expected.size &&
+						lookup.entry.layerCount == expected.layerCount &&
+						lookup.entry.levelCount == expected.levelCount;
 
-	RenderTarget rt = RenderTarget::create(_device, FILTERED_SIZE, _memProperties);
+				if (!lookup.isCached)
+					lookup.entry = {};
 
-	RD &rd = RD::getSingleton();
+				return lookup;
+			});
 
-	AllocatedImage outImage = rd.imageCubeCreate(FILTERED_SIZE, format, 1,
-			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+	_isBaking = true;
+	return true;
+}
 
-	rd.imageLayoutTransition(outImage.image, format, 1, 6, vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eTransferDstOptimal);
+bool EnvironmentEffects::bakePoll(vk::CommandBuffer graphicsCommands, EnvironmentData &data) {
+	if (!_isBaking)
+		return false;
 
-	{
-		vk::CommandBuffer commandBuffer = rd.beginSingleTimeCommands();
-		_drawIrradianceFilter(commandBuffer, rt);
-		rd.endSingleTimeCommands(commandBuffer);
-	}
+	if (!_bake.isSubmitted) {
+		std::future_status status = _bake.stagingCopy.wait_for(std::chrono::seconds(0));
 
-	vk::Image framebufferImage = rt.getColorAttachment().getImage();
+		if (status != std::future_status::ready)
+			return false;
 
-	// make framebuffer image valid source
-	rd.imageLayoutTransition(framebufferImage, format, 1, 6,
-			vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eTransferSrcOptimal);
+		_bake.cache = _bake.stagingCopy.get();
+		_submitBake();
+		return false;
+	}
 
-	vk::ImageSubresourceLayers subresource = {};
-	subresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
-	subresource.setMipLevel(0);
-	subresource.setBaseArrayLayer(0);
-	subresource.setLayerCount(6);
+	if (_device.getFenceStatus(_fence) != vk::Result::eSuccess)
+		return false;
 
-	vk::ImageCopy copyInfo = {};
-	copyInfo.setSrcSubresource(subresource);
-	copyInfo.setDstSubresource(subresource);
-	copyInfo.setExtent(vk::Extent3D(FILTERED_SIZE, FILTERED_SIZE, 1));
+	_device.resetFences(_fence);
+	_profiler.collect(0);
 
-	{
-		vk::CommandBuffer commandBuffer = rd.beginSingleTimeCommands();
+	if (_bake.slice < _getSliceCount()) {
+		_submitSlices(1);
+		return false;
+	}
 
-		commandBuffer.copyImage(framebufferImage, vk::ImageLayout::eTransferSrcOptimal,
-				outImage.image, vk::ImageLayout::eTransferDstOptimal, copyInfo);
+	data = _bake.data;
 
-		rd.endSingleTimeCommands(commandBuffer);
+	if (_bake.cache.isCached) {
+		data.irradianceSH = _bake.cache.entry.irradianceSH;
+	} else {
+		RD::getSingleton().bufferInvalidate(_bake.partials);
+		data.irradianceSH = reduceIrradiance(
+				reinterpret_cast<const glm::vec4 *>(_bake.partialsAllocInfo.pMappedData));
 	}
 
-	// render target is no longer needed
-	rt.destroy(_device);
-	_device.destroySampler(sampler);
+	if (_bake.isSaved) {
+		RD::getSingleton().bufferInvalidate(_bake.specularTransfer);
 
-	rd.imageLayoutTransition(outImage.image, format, 1, 6, vk::ImageLayout::eTransferDstOptimal,
-			vk::ImageLayout::eShaderReadOnlyOptimal);
+		EnvironmentCache::Entry entry = _bake.cache.entry;
+		entry.irradianceSH = data.irradianceSH;
 
-	return outImage;
-}
+		const uint8_t *pData =
+				static_cast<const uint8_t *>(_bake.specularTransferAllocInfo.pMappedData);
+		entry.data.assign(pData, pData + EnvironmentCache::getDataSize(entry));
 
-AllocatedImage EnvironmentEffects::filterSpecular(
-		vk::ImageView imageView, uint32_t size, uint32_t mipLevels) {
-	vk::Sampler sampler = createSampler(_device, mipLevels);
-	_updateFilterSet(imageView, sampler);
+		// disk write would stall the frame
+		if (_cacheSave.valid())
+			_cacheSave.wait();
 
-	vk::Format format = vk::Format::eR32G32B32A32Sfloat;
+		uint64_t key = _bake.cache.key;
+		_cacheSave = std::async(std::launch::async,
+				[key, entry]() { EnvironmentCache::save(key, entry); });
+	}
 
-	const uint32_t BASE_SIZE = 128;
-	const uint32_t LEVEL_COUNT = 5;
+	if (_computeQueueFamily != _graphicsQueueFamily) {
+		// has to match release at the end of the bake
+		std::array<vk::ImageMemoryBarrier, 2> barriers = {
+			imageBarrier(data.cubemap.image, _bake.mipLevels, 6,
+					vk::ImageLayout::eShaderReadOnlyOptimal,
+					vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eNone,
+					vk::AccessFlagBits::eShaderRead),
+			imageBarrier(data.specular.image, SPECULAR_LEVEL_COUNT, 6, _bake.specularLayout,
+					vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eNone,
+					vk::AccessFlagBits::eShaderRead),
+		};
+
+		for (vk::ImageMemoryBarrier &barrier : barriers) {
+			barrier.setSrcQueueFamilyIndex(_computeQueueFamily);
+			barrier.setDstQueueFamilyIndex(_graphicsQueueFamily);
+		}
 
-	uint32_t levelSize = BASE_SIZE;
+		graphicsCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barriers);
+	}
 
-	RD &rd = RD::getSingleton();
+	_releaseBake();
+	return true;
+}
 
-	AllocatedImage outImage = rd.imageCubeCreate(BASE_SIZE, format, LEVEL_COUNT,
-			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+void EnvironmentEffects::setSpecularSampleCount(uint32_t level, uint32_t sampleCount) {
+	if (level >= SPECULAR_LEVEL_COUNT) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Specular level (%u) out of range", level);
+		return;
+	}
 
-	rd.imageLayoutTransition(outImage.image, format, LEVEL_COUNT, 6, vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eTransferDstOptimal);
+	_sampleCounts[level] = std::max(sampleCount, 1u);
+}
 
-	for (uint32_t level = 0; level < LEVEL_COUNT; level++) {
-		float roughness = static_cast<float>(level) / static_cast<float>(LEVEL_COUNT - 1);
+void EnvironmentEffects::setMaxCubemapSize(uint32_t size) {
+	_maxCubemapSize = std::max(size, 1u);
+}
 
-		RenderTarget rt = RenderTarget::create(_device, levelSize, _memProperties);
+void EnvironmentEffects::setSpecularSize(uint32_t size) {
+	size = std::max(size, MIN_SPECULAR_SIZE);
+	_specularSize = 1u << static_cast<uint32_t>(std::floor(std::log2(size)));
+}
 
-		{
-			vk::CommandBuffer commandBuffer = rd.beginSingleTimeCommands();
-			_drawSpecularFilter(commandBuffer, rt, size, roughness);
-			rd.endSingleTimeCommands(commandBuffer);
-		}
+bool EnvironmentEffects::isBaking() const {
+	return _isBaking;
+}
 
-		vk::Image framebufferImage = rt.getColorAttachment().getImage();
+std::vector<GpuTiming> EnvironmentEffects::getTimings() const {
+	return _profiler.getTimings();
+}
 
-		rd.imageLayoutTransition(framebufferImage, format, 1, 6,
-				vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eTransferSrcOptimal);
+void EnvironmentEffects::init(
+		vk::Queue computeQueue, uint32_t computeQueueFamily, uint32_t graphicsQueueFamily) {
+	RD &rd = RD::getSingleton();
 
-		_copyImageToLevel(framebufferImage, outImage.image, level, levelSize);
+	_device = rd.getDevice();
 
-		// render target is no longer needed
-		rt.destroy(_device);
-		levelSize = levelSize >> 1;
-	}
+	_computeQueue = computeQueue;
+	_computeQueueFamily = computeQueueFamily;
+	_graphicsQueueFamily = graphicsQueueFamily;
 
-	_device.destroySampler(sampler);
+	for (uint32_t level = 0; level < SPECULAR_LEVEL_COUNT; level++)
+		_sampleCounts[level] = DEFAULT_SPECULAR_SAMPLE_COUNT;
 
-	rd.imageLayoutTransition(outImage.image, format, LEVEL_COUNT, 6,
-			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::CommandPoolCreateInfo createInfo = {};
+	createInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+	createInfo.setQueueFamilyIndex(computeQueueFamily);
 
-	return outImage;
-}
+	_commandPool = _device.createCommandPool(createInfo);
 
-void EnvironmentEffects::init() {
-	RD &rd = RD::getSingleton();
+	vk::CommandBufferAllocateInfo allocInfo = {};
+	allocInfo.setCommandPool(_commandPool);
+	allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+	allocInfo.setCommandBufferCount(1);
 
-	_device = rd.getDevice();
-	_memProperties = rd.getPhysicalDevice().getMemoryProperties();
+	_commandBuffer = _device.allocateCommandBuffers(allocInfo)[0];
+	_fence = _device.createFence({});
+
+	_profiler.initialize(_device, rd.getPhysicalDevice(), computeQueueFamily, 1, "compute queue");
 
 	vk::DescriptorPool descriptorPool = rd.getDescriptorPool();
 
@@ -813,19 +1342,50 @@ EnvironmentEffects::~EnvironmentEffects() {
 	if (!_initialized)
 		return;
 
+	if (_isBaking) {
+		if (_bake.isSubmitted) {
+			vk::Result result = _device.waitForFences(_fence, VK_TRUE, UINT64_MAX);
+
+			if (result != vk::Result::eSuccess)
+				SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for environment bake failed!");
+
+			RD &rd = RD::getSingleton();
+
+			rd.imageViewDestroy(_bake.data.cubemapView);
+			rd.imageDestroy(_bake.data.cubemap);
+
+			rd.imageViewDestroy(_bake.data.specularView);
+			rd.imageDestroy(_bake.data.specular);
+		} else {
+			_bake.stagingCopy.wait();
+		}
+
+		_releaseBake();
+	}
+
+	_waitPipelines();
+
+	_profiler.destroy();
+
+	_device.destroyFence(_fence);
+	_device.destroyCommandPool(_commandPool);
+
 	_device.destroyPipeline(_brdfPipeline);
 	_device.destroyPipelineLayout(_brdfPipelineLayout);
 	_device.destroyDescriptorSetLayout(_brdfSetLayout);
 
 	_device.destroyPipeline(_cubemapPipeline);
 	_device.destroyPipelineLayout(_cubemapPipelineLayout);
+
+	_device.destroyPipeline(_downsamplePipeline);
+	_device.destroyPipelineLayout(_downsamplePipelineLayout);
 	_device.destroyDescriptorSetLayout(_cubemapSetLayout);
 
-	_device.destroyPipeline(_irradiancePipeline);
-	_device.destroyPipelineLayout(_irradiancePipelineLayout);
+	_device.destroyPipeline(_projectPipeline);
+	_device.destroyPipelineLayout(_projectPipelineLayout);
+	_device.destroyDescriptorSetLayout(_projectSetLayout);
 
 	_device.destroyPipeline(_specularPipeline);
 	_device.destroyPipelineLayout(_specularPipelineLayout);
-
 	_device.destroyDescriptorSetLayout(_filterSetLayout);
 }
@@ -1,40 +1,76 @@
 #ifndef CUBEMAP_H
 #define CUBEMAP_H
 
+#include <array>
 #include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
 
-#include "../types/attachment.h"
+#include <io/environment_cache.h>
 
-class RenderTarget {
-private:
-	vk::Framebuffer _framebuffer;
-	vk::RenderPass _renderPass;
+#include "../gpu_profiler.h"
+#include "../shader_library.h"
+#include "../types/allocated.h"
 
-	Attachment _color;
-	uint32_t _size;
+// cubemap of 16K source has 15 levels
+const uint32_t MAX_CUBEMAP_LEVELS = 16;
 
-public:
-	static RenderTarget create(
-			vk::Device device, uint32_t size, vk::PhysicalDeviceMemoryProperties memProperties);
+// faces of cubemap sky is drawn from, 4K source has 1024 faces, larger ones are sampled down to
+// this from levels of source
+const uint32_t DEFAULT_MAX_CUBEMAP_SIZE = 2048;
+
+// faces of specular level 0, roughest level is still a texel wide at smallest one
+const uint32_t DEFAULT_SPECULAR_SIZE = 128;
+const uint32_t SPECULAR_LEVEL_COUNT = 5;
+const uint32_t MIN_SPECULAR_SIZE = 1 << (SPECULAR_LEVEL_COUNT - 1);
+
+// irradiance is projected from this mip size, low frequency signal needs no more
+const uint32_t SH_SAMPLE_SIZE = 64;
+// vec4 per coefficient and one for weight, per group of projection, matches sh_project.comp
+const uint32_t SH_PARTIAL_STRIDE = 10;
+const uint32_t SH_PARTIAL_COUNT = (SH_SAMPLE_SIZE / 8) * (SH_SAMPLE_SIZE / 8) * 6;
 
-	void destroy(vk::Device device);
+// importance samples per texel of rough specular levels, lower budget bakes faster
+const uint32_t DEFAULT_SPECULAR_SAMPLE_COUNT = 2048;
 
-	vk::Framebuffer getFramebuffer() const;
-	vk::RenderPass getRenderPass() const;
-	Attachment getColorAttachment() const;
-	uint32_t getSize() const;
+// everything sampled by lighting for one sky, ownership passes to caller once bake finishes
+struct EnvironmentData {
+	AllocatedImage cubemap;
+	vk::ImageView cubemapView;
+	vk::Sampler cubemapSampler;
 
-	RenderTarget(vk::Framebuffer framebuffer, vk::RenderPass renderPass, Attachment color,
-			uint32_t size);
+	AllocatedImage specular;
+	vk::ImageView specularView;
+	vk::Sampler specularSampler;
+	// faces of level 0
+	uint32_t specularSize;
+
+	// SH9 of irradiance divided by pi, cosine lobe is folded in, rgb per coefficient
+	std::array<glm::vec4, 9> irradianceSH;
 };
 
-class AllocatedImage;
+class Image;
 
+// Bakes environment of equirectangular sky. Every pass is compute, so the bake runs on async
+// compute queue when device has one and frames keep rendering with previous environment. Only
+// one bake is in flight, its descriptor sets are shared between bakes. Progressive bake submits
+// one slice per poll, for skies changing every frame.
 class EnvironmentEffects {
 private:
 	vk::Device _device;
-	vk::PhysicalDeviceMemoryProperties _memProperties;
+
+	vk::Queue _computeQueue;
+	uint32_t _computeQueueFamily;
+	uint32_t _graphicsQueueFamily;
+
+	vk::CommandPool _commandPool;
+	vk::CommandBuffer _commandBuffer;
+	vk::Fence _fence;
 
 	vk::PipelineLayout _brdfPipelineLayout;
 	vk::Pipeline _brdfPipeline;
@@ -48,43 +84,161 @@ private:
 	vk::DescriptorSetLayout _cubemapSetLayout;
 	vk::DescriptorSet _cubemapSet;
 
-	vk::PipelineLayout _irradiancePipelineLayout;
-	vk::Pipeline _irradiancePipeline;
+	// level i to level i + 1, same layout as cubemap set
+	vk::PipelineLayout _downsamplePipelineLayout;
+	vk::Pipeline _downsamplePipeline;
+
+	vk::DescriptorSet _downsampleSets[MAX_CUBEMAP_LEVELS - 1];
+	// levels of source, cubemap samples the one matching its texel size
+	vk::DescriptorSet _equirectangularDownsampleSets[MAX_CUBEMAP_LEVELS - 1];
+
+	typedef struct {
+		uint32_t sampleSize;
+		float lod;
+	} ProjectConstants;
+
+	vk::PipelineLayout _projectPipelineLayout;
+	vk::Pipeline _projectPipeline;
+
+	vk::DescriptorSetLayout _projectSetLayout;
+	vk::DescriptorSet _projectSet;
 
 	typedef struct {
 		uint32_t size;
 		float roughness;
+		uint32_t sampleCount;
+		uint32_t firstFace;
 	} SpecularFilterConstants;
 
 	vk::PipelineLayout _specularPipelineLayout;
 	vk::Pipeline _specularPipeline;
 
 	vk::DescriptorSetLayout _filterSetLayout;
-	vk::DescriptorSet _filterSet;
+	vk::DescriptorSet _filterSets[SPECULAR_LEVEL_COUNT];
+
+	// result of worker thread, specular and irradiance are not baked again on cache hit
+	typedef struct {
+		uint64_t key;
+		bool isCached;
+		EnvironmentCache::Entry entry;
+	} CacheLookup;
+
+	// transient resources are released once fence signals
+	typedef struct {
+		std::shared_ptr<Image> image;
+		uint32_t size;
+		uint32_t mipLevels;
+		uint32_t specularSize;
+
+		// budget is fixed when bake begins
+		uint32_t sampleCounts[SPECULAR_LEVEL_COUNT];
+
+		// next slice to submit, progressive bake is never cached
+		bool isProgressive;
+		bool isSaved;
+		uint32_t slice;
+
+		// filled on worker thread, commands are submitted once it is done
+		AllocatedBuffer staging;
+		VmaAllocationInfo stagingAllocInfo;
+		std::future<CacheLookup> stagingCopy;
+		bool isSubmitted;
+
+		CacheLookup cache;
+
+		// upload of cached specular levels or readback of baked ones
+		AllocatedBuffer specularTransfer;
+		VmaAllocationInfo specularTransferAllocInfo;
+		vk::ImageLayout specularLayout;
+
+		AllocatedImage equirectangular;
+		vk::ImageView equirectangularView;
+		uint32_t equirectangularLevels;
+		std::vector<vk::ImageView> equirectangularLevelViews;
+
+		std::vector<vk::ImageView> cubemapLevelViews;
+		std::vector<vk::ImageView> specularLevelViews;
+		vk::Sampler filterSampler;
+
+		AllocatedBuffer partials;
+		VmaAllocationInfo partialsAllocInfo;
+
+		EnvironmentData data;
+	} Bake;
+
+	Bake _bake;
+	bool _isBaking = false;
+
+	uint32_t _sampleCounts[SPECULAR_LEVEL_COUNT];
+	uint32_t _maxCubemapSize = DEFAULT_MAX_CUBEMAP_SIZE;
+	uint32_t _specularSize = DEFAULT_SPECULAR_SIZE;
+
+	// previous write has to finish before next one starts
+	std::future<void> _cacheSave;
+
+	std::vector<std::future<void>> _pipelineBuilds;
+	// every pipeline, built again when hot reload recompiles its shader
+	std::vector<PipelineRecipe> _pipelineRecipes;
+
+	// one submit of bake is in flight, its steps are read once fence signals
+	GpuProfiler _profiler;
 
 	bool _initialized = false;
 
 	void _createDescriptors(vk::DescriptorPool descriptorPool);
+	// layouts are created right away, pipelines are compiled in background since nothing needs
+	// them before first bake or BRDF cache miss
 	void _createPipelines();
+	// has to be called before any pipeline is bound
+	void _waitPipelines();
 
 	void _updateBrdfSet(vk::ImageView dstImageView);
-	void _updateCubemapSet(vk::ImageView srcImageView, vk::ImageView dstCubemapView);
-	void _updateFilterSet(vk::ImageView srcImageView, vk::Sampler sampler);
-
-	void _drawIrradianceFilter(vk::CommandBuffer commandBuffer, RenderTarget renderTarget);
-	void _drawSpecularFilter(vk::CommandBuffer commandBuffer, RenderTarget renderTarget,
-			uint32_t size, float roughness);
-
-	void _copyImageToLevel(vk::Image srcImage, vk::Image dstImage, uint32_t level, uint32_t size);
+	void _updateStorageSet(vk::DescriptorSet set, vk::ImageView srcImageView,
+			vk::ImageView dstImageView);
+	void _updateFilterSet(vk::DescriptorSet set, vk::ImageView srcImageView, vk::Sampler sampler,
+			vk::ImageView dstImageView);
+	void _updateProjectSet(vk::ImageView srcImageView, vk::Sampler sampler, vk::Buffer dstBuffer,
+			vk::DeviceSize size);
+
+	uint32_t _getSliceCount() const;
+	void _recordConvert(vk::CommandBuffer commandBuffer);
+	void _recordFilter(vk::CommandBuffer commandBuffer, uint32_t level, uint32_t firstFace,
+			uint32_t faceCount);
+	void _recordFinish(vk::CommandBuffer commandBuffer);
+	void _recordSlice(vk::CommandBuffer commandBuffer, uint32_t slice);
+	void _submitSlices(uint32_t sliceCount);
+	void _submitBake();
+	void _releaseBake();
 
 public:
+	// sums partials written by SH projection into irradiance, cosine lobe folded in
+	static std::array<glm::vec4, 9> reduceIrradiance(const glm::vec4 *pPartials);
+
+	// loaded from environment cache when available
 	AllocatedImage generateBRDF();
 
-	AllocatedImage cubemapCreate(vk::ImageView imageView, uint32_t size);
-	AllocatedImage filterIrradiance(vk::ImageView imageView);
-	AllocatedImage filterSpecular(vk::ImageView imageView, uint32_t size, uint32_t mipLevels);
+	// applies to bakes begun afterwards, level 0 is a mirror and takes no samples
+	void setSpecularSampleCount(uint32_t level, uint32_t sampleCount);
+	// applies to bakes begun afterwards, faces are a quarter of source width up to it
+	void setMaxCubemapSize(uint32_t size);
+	// applies to bakes begun afterwards, rounded down to power of two and MIN_SPECULAR_SIZE
+	void setSpecularSize(uint32_t size);
+
+	// image is converted to RGBA16F on worker thread, returns false while other bake is running
+	bool bakeBegin(const std::shared_ptr<Image> image, bool isProgressive = false);
+
+	// true once bake is finished, ownership of images is then acquired in graphics commands
+	bool bakePoll(vk::CommandBuffer graphicsCommands, EnvironmentData &data);
+	bool isBaking() const;
+
+	// pipelines of shaders are built again, no bake may be running, true when any was replaced,
+	// BRDF is generated once so its reload shows from next run
+	bool reloadShaders(const std::vector<std::string> &shaders);
+
+	// of conversion, filter slices and finishing step, averaged over bakes
+	std::vector<GpuTiming> getTimings() const;
 
-	void init();
+	void init(vk::Queue computeQueue, uint32_t computeQueueFamily, uint32_t graphicsQueueFamily);
 	~EnvironmentEffects();
 };
 
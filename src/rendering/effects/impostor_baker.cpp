@@ -0,0 +1,481 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/vertex.h>
+
+#include "shaders/impostor.gen.h"
+
+#include "impostor_baker.h"
+
+const vk::Format COLOR_FORMAT = vk::Format::eR8G8B8A8Srgb;
+const vk::Format DEPTH_FORMAT = vk::Format::eD32Sfloat;
+
+// bounds grow by it, coarse levels of atlas do not bleed cells into each other
+const float PADDING = 1.1f;
+
+// transparent texels this far from opaque ones get their color
+const uint32_t DILATION_PASSES = 4;
+
+static float _halfWidth(const AABB &aabb) {
+	glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+	return std::max(std::sqrt(extent.x * extent.x + extent.z * extent.z) * PADDING, 1e-4f);
+}
+
+static float _halfHeight(const AABB &aabb) {
+	return std::max((aabb.max.y - aabb.min.y) * 0.5f * PADDING, 1e-4f);
+}
+
+// covered by capture or given color by earlier dilation pass, cleared texels are black
+static bool _hasColor(const uint8_t *pTexel) {
+	return pTexel[3] != 0 || pTexel[0] != 0 || pTexel[1] != 0 || pTexel[2] != 0;
+}
+
+void ImpostorBaker::_createRenderPass() {
+	// copies of previous capture have read color by the time it is cleared again
+	std::array<vk::AttachmentDescription, 2> attachments = {};
+	attachments[0].setFormat(COLOR_FORMAT);
+	attachments[0].setSamples(vk::SampleCountFlagBits::e1);
+	attachments[0].setLoadOp(vk::AttachmentLoadOp::eClear);
+	attachments[0].setStoreOp(vk::AttachmentStoreOp::eStore);
+	attachments[0].setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+	attachments[0].setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+	attachments[0].setInitialLayout(vk::ImageLayout::eUndefined);
+	attachments[0].setFinalLayout(vk::ImageLayout::eTransferSrcOptimal);
+
+	attachments[1].setFormat(DEPTH_FORMAT);
+	attachments[1].setSamples(vk::SampleCountFlagBits::e1);
+	attachments[1].setLoadOp(vk::AttachmentLoadOp::eClear);
+	attachments[1].setStoreOp(vk::AttachmentStoreOp::eDontCare);
+	attachments[1].setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+	attachments[1].setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+	attachments[1].setInitialLayout(vk::ImageLayout::eUndefined);
+	attachments[1].setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+	vk::AttachmentReference colorRef(0, vk::ImageLayout::eColorAttachmentOptimal);
+	vk::AttachmentReference depthRef(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+	vk::SubpassDescription subpass = {};
+	subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+	subpass.setColorAttachments(colorRef);
+	subpass.setPDepthStencilAttachment(&depthRef);
+
+	vk::PipelineStageFlags outputStages = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+			vk::PipelineStageFlagBits::eEarlyFragmentTests |
+			vk::PipelineStageFlagBits::eLateFragmentTests;
+
+	std::array<vk::SubpassDependency, 2> dependencies = {};
+	dependencies[0].setSrcSubpass(VK_SUBPASS_EXTERNAL);
+	dependencies[0].setDstSubpass(0);
+	dependencies[0].setSrcStageMask(vk::PipelineStageFlagBits::eTransfer | outputStages);
+	dependencies[0].setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+	dependencies[0].setDstStageMask(outputStages);
+	dependencies[0].setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite |
+			vk::AccessFlagBits::eDepthStencilAttachmentRead |
+			vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+
+	dependencies[1].setSrcSubpass(0);
+	dependencies[1].setDstSubpass(VK_SUBPASS_EXTERNAL);
+	dependencies[1].setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+	dependencies[1].setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+	dependencies[1].setDstStageMask(vk::PipelineStageFlagBits::eTransfer);
+	dependencies[1].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+
+	uint32_t viewMask = (1u << IMPOSTOR_VIEW_COUNT) - 1;
+
+	vk::RenderPassMultiviewCreateInfo multiviewCreateInfo = {};
+	multiviewCreateInfo.setSubpassCount(1);
+	multiviewCreateInfo.setViewMasks(viewMask);
+	multiviewCreateInfo.setCorrelationMasks(viewMask);
+
+	vk::RenderPassCreateInfo createInfo = {};
+	createInfo.setAttachments(attachments);
+	createInfo.setSubpasses(subpass);
+	createInfo.setDependencies(dependencies);
+	createInfo.setPNext(&multiviewCreateInfo);
+
+	_renderPass = _device.createRenderPass(createInfo);
+}
+
+void ImpostorBaker::_createPipeline() {
+	ImpostorShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.vertexCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.vertexCode));
+
+	vk::ShaderModule vertexStage = _device.createShaderModule(moduleCreateInfo);
+
+	moduleCreateInfo.setPCode(shader.fragmentCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.fragmentCode));
+
+	vk::ShaderModule fragmentStage = _device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo vertexStageInfo;
+	vertexStageInfo.setModule(vertexStage);
+	vertexStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
+	vertexStageInfo.setPName("main");
+
+	vk::PipelineShaderStageCreateInfo fragmentStageInfo;
+	fragmentStageInfo.setModule(fragmentStage);
+	fragmentStageInfo.setStage(vk::ShaderStageFlagBits::eFragment);
+	fragmentStageInfo.setPName("main");
+
+	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertexStageInfo, fragmentStageInfo };
+
+	vk::PipelineVertexInputStateCreateInfo vertexInput = UVLayout::getInputState();
+
+	vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+	inputAssembly.setTopology(vk::PrimitiveTopology::eTriangleList);
+
+	vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(IMPOSTOR_CELL_SIZE),
+			static_cast<float>(IMPOSTOR_CELL_SIZE), 0.0f, 1.0f);
+	vk::Rect2D scissor({ 0, 0 }, { IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE });
+
+	vk::PipelineViewportStateCreateInfo viewportState;
+	viewportState.setViewports(viewport);
+	viewportState.setScissors(scissor);
+
+	// views see meshes from every side, back faces of open ones included
+	vk::PipelineRasterizationStateCreateInfo rasterizer;
+	rasterizer.setRasterizerDiscardEnable(VK_FALSE);
+	rasterizer.setPolygonMode(vk::PolygonMode::eFill);
+	rasterizer.setLineWidth(1.0f);
+	rasterizer.setCullMode(vk::CullModeFlagBits::eNone);
+	rasterizer.setFrontFace(vk::FrontFace::eCounterClockwise);
+
+	vk::PipelineMultisampleStateCreateInfo multisampling;
+	multisampling.setSampleShadingEnable(VK_FALSE);
+	multisampling.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+	vk::PipelineDepthStencilStateCreateInfo depthStencil;
+	depthStencil.setDepthTestEnable(VK_TRUE);
+	depthStencil.setDepthWriteEnable(VK_TRUE);
+	depthStencil.setDepthCompareOp(vk::CompareOp::eGreaterOrEqual);
+	depthStencil.setDepthBoundsTestEnable(VK_FALSE);
+	depthStencil.setStencilTestEnable(VK_FALSE);
+
+	vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+	colorBlendAttachment.setColorWriteMask(vk::ColorComponentFlagBits::eR |
+			vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
+			vk::ColorComponentFlagBits::eA);
+	colorBlendAttachment.setBlendEnable(VK_FALSE);
+
+	vk::PipelineColorBlendStateCreateInfo colorBlending;
+	colorBlending.setLogicOpEnable(VK_FALSE);
+	colorBlending.setAttachments(colorBlendAttachment);
+
+	vk::GraphicsPipelineCreateInfo createInfo;
+	createInfo.setStages(shaderStages);
+	createInfo.setPVertexInputState(&vertexInput);
+	createInfo.setPInputAssemblyState(&inputAssembly);
+	createInfo.setPViewportState(&viewportState);
+	createInfo.setPRasterizationState(&rasterizer);
+	createInfo.setPMultisampleState(&multisampling);
+	createInfo.setPDepthStencilState(&depthStencil);
+	createInfo.setPColorBlendState(&colorBlending);
+	createInfo.setLayout(_pipelineLayout);
+	createInfo.setRenderPass(_renderPass);
+	createInfo.setSubpass(0);
+
+	vk::ResultValue<vk::Pipeline> result = _device.createGraphicsPipeline(
+			RD::getSingleton().getPipelineCache(), createInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Impostor pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	_device.destroyShaderModule(vertexStage);
+	_device.destroyShaderModule(fragmentStage);
+}
+
+void ImpostorBaker::record(vk::CommandBuffer commandBuffer, const GeometryArena &geometryArena,
+		vk::IndexType indexType, const AABB &aabb, float quantizeScale,
+		const std::vector<Draw> &draws) {
+	uint32_t drawCount = std::min(static_cast<uint32_t>(draws.size()), MAX_IMPOSTOR_DRAW_COUNT);
+
+	// frame of previous capture finished, nothing reads sets anymore
+	std::array<vk::WriteDescriptorSet, MAX_IMPOSTOR_DRAW_COUNT> writeInfos = {};
+
+	for (uint32_t i = 0; i < drawCount; i++) {
+		writeInfos[i].setDstSet(_sets[i]);
+		writeInfos[i].setDstBinding(0);
+		writeInfos[i].setDstArrayElement(0);
+		writeInfos[i].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfos[i].setDescriptorCount(1);
+		writeInfos[i].setPImageInfo(&draws[i].albedo);
+	}
+
+	_device.updateDescriptorSets(drawCount, writeInfos.data(), 0, nullptr);
+
+	std::array<vk::ClearValue, 2> clearValues;
+	clearValues[0].color = vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 0.0f });
+	clearValues[1].depthStencil = vk::ClearDepthStencilValue(0.0f, 0);
+
+	vk::RenderPassBeginInfo renderPassInfo;
+	renderPassInfo.setRenderPass(_renderPass);
+	renderPassInfo.setFramebuffer(_framebuffer);
+	renderPassInfo.setRenderArea(vk::Rect2D({ 0, 0 }, { IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE }));
+	renderPassInfo.setClearValues(clearValues);
+
+	commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+
+	geometryArena.bind(commandBuffer);
+	geometryArena.bindIndices(commandBuffer, indexType);
+
+	CapturePushConstants constants = {};
+	constants.scale =
+			glm::vec2(quantizeScale / _halfWidth(aabb), quantizeScale / _halfHeight(aabb));
+
+	for (uint32_t i = 0; i < drawCount; i++) {
+		const Draw &draw = draws[i];
+
+		constants.albedoFactor = draw.albedoFactor;
+		constants.albedoRect = draw.albedoRect;
+		constants.alphaTest = draw.alphaTest ? 1 : 0;
+
+		commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _sets[i], nullptr);
+		commandBuffer.pushConstants(_pipelineLayout,
+				vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
+				sizeof(CapturePushConstants), &constants);
+
+		commandBuffer.drawIndexed(draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+	}
+
+	commandBuffer.endRenderPass();
+
+	// layer after layer, tightly packed
+	std::array<vk::BufferImageCopy, IMPOSTOR_VIEW_COUNT> regions = {};
+	vk::DeviceSize layerSize = IMPOSTOR_CELL_SIZE * IMPOSTOR_CELL_SIZE * 4;
+
+	for (uint32_t i = 0; i < IMPOSTOR_VIEW_COUNT; i++) {
+		regions[i].setBufferOffset(layerSize * i);
+		regions[i].setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, i, 1 });
+		regions[i].setImageExtent({ IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE, 1 });
+	}
+
+	commandBuffer.copyImageToBuffer(_color.getImage(), vk::ImageLayout::eTransferSrcOptimal,
+			_readback.buffer, regions);
+
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eHost, {}, barrier, nullptr, nullptr);
+
+	_isBaking = true;
+}
+
+bool ImpostorBaker::isBaking() const {
+	return _isBaking;
+}
+
+std::shared_ptr<Image> ImpostorBaker::collect() {
+	_isBaking = false;
+
+	vmaInvalidateAllocation(_allocator, _readback.allocation, 0, VK_WHOLE_SIZE);
+
+	const uint32_t width = IMPOSTOR_CELL_SIZE * IMPOSTOR_COLUMN_COUNT;
+	const uint32_t height = IMPOSTOR_CELL_SIZE * IMPOSTOR_ROW_COUNT;
+	const uint32_t rowSize = IMPOSTOR_CELL_SIZE * 4;
+
+	std::vector<uint8_t> data(width * height * 4);
+	const uint8_t *pLayers = static_cast<const uint8_t *>(_readbackAllocInfo.pMappedData);
+
+	for (uint32_t i = 0; i < IMPOSTOR_VIEW_COUNT; i++) {
+		uint32_t x = (i % IMPOSTOR_COLUMN_COUNT) * IMPOSTOR_CELL_SIZE;
+		uint32_t y = (i / IMPOSTOR_COLUMN_COUNT) * IMPOSTOR_CELL_SIZE;
+		const uint8_t *pLayer = pLayers + i * rowSize * IMPOSTOR_CELL_SIZE;
+
+		for (uint32_t row = 0; row < IMPOSTOR_CELL_SIZE; row++)
+			memcpy(&data[((y + row) * width + x) * 4], pLayer + row * rowSize, rowSize);
+	}
+
+	// alpha stays, alpha test keeps dilated texels out, neighbours are taken from same cell
+	std::vector<uint8_t> dilated = data;
+
+	for (uint32_t pass = 0; pass < DILATION_PASSES; pass++) {
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < width; x++) {
+				uint8_t *pTexel = &dilated[(y * width + x) * 4];
+
+				if (_hasColor(pTexel))
+					continue;
+
+				uint32_t cellX = x - x % IMPOSTOR_CELL_SIZE;
+				uint32_t cellY = y - y % IMPOSTOR_CELL_SIZE;
+
+				uint32_t sum[3] = {};
+				uint32_t count = 0;
+
+				for (int32_t dy = -1; dy <= 1; dy++) {
+					for (int32_t dx = -1; dx <= 1; dx++) {
+						int32_t nx = static_cast<int32_t>(x) + dx;
+						int32_t ny = static_cast<int32_t>(y) + dy;
+
+						if (nx < static_cast<int32_t>(cellX) || ny < static_cast<int32_t>(cellY) ||
+								nx >= static_cast<int32_t>(cellX + IMPOSTOR_CELL_SIZE) ||
+								ny >= static_cast<int32_t>(cellY + IMPOSTOR_CELL_SIZE))
+							continue;
+
+						const uint8_t *pNeighbour = &data[(ny * width + nx) * 4];
+
+						if (!_hasColor(pNeighbour))
+							continue;
+
+						for (uint32_t c = 0; c < 3; c++)
+							sum[c] += pNeighbour[c];
+
+						count++;
+					}
+				}
+
+				for (uint32_t c = 0; c < 3 && count > 0; c++)
+					pTexel[c] = static_cast<uint8_t>(sum[c] / count);
+			}
+		}
+
+		data = dilated;
+	}
+
+	std::shared_ptr<Image> image =
+			std::make_shared<Image>(width, height, Image::Format::RGBA8, std::move(data));
+	image->setSrgb(true);
+
+	return image;
+}
+
+void ImpostorBaker::buildQuads(
+		const AABB &aabb, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+	glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+	float halfWidth = _halfWidth(aabb);
+	float halfHeight = _halfHeight(aabb);
+
+	const glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+	for (uint32_t i = 0; i < IMPOSTOR_VIEW_COUNT; i++) {
+		// has to match view directions in shaders/impostor.vert
+		float azimuth = glm::two_pi<float>() * static_cast<float>(i) / IMPOSTOR_VIEW_COUNT;
+		glm::vec3 front(std::sin(azimuth), 0.0f, std::cos(azimuth));
+		glm::vec3 right = glm::cross(up, front);
+
+		glm::vec2 cell(static_cast<float>(i % IMPOSTOR_COLUMN_COUNT) / IMPOSTOR_COLUMN_COUNT,
+				static_cast<float>(i / IMPOSTOR_COLUMN_COUNT) / IMPOSTOR_ROW_COUNT);
+		glm::vec2 cellSize(1.0f / IMPOSTOR_COLUMN_COUNT, 1.0f / IMPOSTOR_ROW_COUNT);
+
+		uint32_t first = static_cast<uint32_t>(vertices.size());
+
+		// counter-clockwise seen from front, top row of cell is top of quad
+		const glm::vec2 corners[4] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f },
+			{ -1.0f, 1.0f } };
+
+		for (const glm::vec2 &corner : corners) {
+			Vertex vertex = {};
+			vertex.position =
+					center + right * corner.x * halfWidth + up * corner.y * halfHeight;
+			vertex.normal = front;
+			vertex.tangent = right;
+			vertex.uv = cell +
+					glm::vec2(corner.x * 0.5f + 0.5f, 0.5f - corner.y * 0.5f) * cellSize;
+
+			vertices.push_back(vertex);
+		}
+
+		indices.insert(indices.end(),
+				{ first, first + 1, first + 2, first, first + 2, first + 3 });
+	}
+}
+
+void ImpostorBaker::initialize(
+		vk::Device device, VmaAllocator allocator, vk::DescriptorPool descriptorPool) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_allocator = allocator;
+
+	_color = Attachment::create(allocator, device, IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE,
+			COLOR_FORMAT,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+			vk::ImageAspectFlagBits::eColor, IMPOSTOR_VIEW_COUNT, vk::ImageViewType::e2DArray);
+
+	_depth = Attachment::create(allocator, device, IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE,
+			DEPTH_FORMAT, vk::ImageUsageFlagBits::eDepthStencilAttachment,
+			vk::ImageAspectFlagBits::eDepth, IMPOSTOR_VIEW_COUNT, vk::ImageViewType::e2DArray);
+
+	_createRenderPass();
+
+	std::array<vk::ImageView, 2> views = { _color.getImageView(), _depth.getImageView() };
+
+	vk::FramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.setRenderPass(_renderPass);
+	framebufferInfo.setAttachments(views);
+	framebufferInfo.setWidth(IMPOSTOR_CELL_SIZE);
+	framebufferInfo.setHeight(IMPOSTOR_CELL_SIZE);
+	framebufferInfo.setLayers(1);
+
+	vk::Result err = device.createFramebuffer(&framebufferInfo, nullptr, &_framebuffer);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Impostor framebuffer creation failed!");
+
+	vk::DescriptorSetLayoutBinding binding = {};
+	binding.setBinding(0);
+	binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	binding.setDescriptorCount(1);
+	binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(binding);
+
+	err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Impostor descriptor set layout creation failed!");
+
+	std::vector<vk::DescriptorSetLayout> layouts(MAX_IMPOSTOR_DRAW_COUNT, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Impostor descriptor set allocation failed!");
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(
+			vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(CapturePushConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	_createPipeline();
+
+	_readback = AllocatedBuffer::create(allocator, MemoryCategory::Staging, BufferClass::Readback,
+			vk::BufferUsageFlagBits::eTransferDst,
+			IMPOSTOR_CELL_SIZE * IMPOSTOR_CELL_SIZE * 4 * IMPOSTOR_VIEW_COUNT,
+			&_readbackAllocInfo);
+
+	_initialized = true;
+}
@@ -0,0 +1,104 @@
+#ifndef IMPOSTOR_BAKER_H
+#define IMPOSTOR_BAKER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+#include <io/image.h>
+#include <io/mesh.h>
+#include <rendering/storage/geometry_arena.h>
+#include <rendering/types/aabb.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+
+// views around vertical axis, view k looks from azimuth k * 60 degrees, opposite views share a
+// plane, so impostor is three crossing planes with a quad on each side
+const uint32_t IMPOSTOR_VIEW_COUNT = 6;
+const uint32_t IMPOSTOR_CELL_SIZE = 128;
+const uint32_t IMPOSTOR_COLUMN_COUNT = 3;
+const uint32_t IMPOSTOR_ROW_COUNT = IMPOSTOR_VIEW_COUNT / IMPOSTOR_COLUMN_COUNT;
+
+// drawn primitives of a mesh a capture takes at most, meshes with more keep their geometry
+const uint32_t MAX_IMPOSTOR_DRAW_COUNT = 8;
+
+// Captures albedo of a mesh from IMPOSTOR_VIEW_COUNT sides into an atlas of cells, one
+// multiview pass renders every view like shadow atlas renders cube faces. Views are orthographic
+// and fit horizontal radius and height of bounds, so cells line up with quads of buildQuads.
+// Capture is copied to a host buffer, one capture is in flight at a time and is collected once
+// frame it was recorded in finished. Colors are unlit, impostors are shaded like flat cards.
+class ImpostorBaker {
+public:
+	typedef struct {
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+
+		vk::DescriptorImageInfo albedo;
+		glm::vec4 albedoFactor;
+		glm::vec4 albedoRect;
+		bool alphaTest;
+	} Draw;
+
+private:
+	// has to match push constants in shaders/impostor.vert and shaders/impostor.frag
+	struct CapturePushConstants {
+		glm::vec4 albedoFactor;
+		glm::vec4 albedoRect;
+		// quantized position to clip space, horizontal and vertical
+		glm::vec2 scale;
+		uint32_t alphaTest;
+		uint32_t padding;
+	};
+	static_assert(sizeof(CapturePushConstants) == 48, "CapturePushConstants is not 48 bytes");
+
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	// layer per view
+	Attachment _color;
+	Attachment _depth;
+
+	vk::RenderPass _renderPass;
+	vk::Framebuffer _framebuffer;
+
+	// sampler of albedo, set per draw, written only while no capture is in flight
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_IMPOSTOR_DRAW_COUNT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	AllocatedBuffer _readback;
+	VmaAllocationInfo _readbackAllocInfo;
+
+	bool _isBaking = false;
+	bool _initialized = false;
+
+	void _createRenderPass();
+	void _createPipeline();
+
+public:
+	// outside of render passes, draws are primitives of mesh with positions quantized into
+	// bounds centered on aabb, at most MAX_IMPOSTOR_DRAW_COUNT of them
+	void record(vk::CommandBuffer commandBuffer, const GeometryArena &geometryArena,
+			vk::IndexType indexType, const AABB &aabb, float quantizeScale,
+			const std::vector<Draw> &draws);
+	bool isBaking() const;
+
+	// commands capture was recorded to have to be finished, atlas is sRGB, transparent texels
+	// take color of opaque neighbours so filtering does not darken edges
+	std::shared_ptr<Image> collect();
+
+	// quads in mesh space of bounds, uv into cells of atlas
+	static void buildQuads(
+			const AABB &aabb, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+	void initialize(vk::Device device, VmaAllocator allocator, vk::DescriptorPool descriptorPool);
+};
+
+#endif // !IMPOSTOR_BAKER_H
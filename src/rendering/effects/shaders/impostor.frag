@@ -0,0 +1,29 @@
+#version 450
+
+layout(location = 0) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D albedoSampler;
+
+layout(push_constant) uniform CapturePushConstants {
+	vec4 albedoFactor;
+	vec4 albedoRect;
+	vec2 scale;
+	uint alphaTest;
+};
+
+// same as ALPHA_TEST_CUTOFF in shaders/include/permutation_incl.glsl
+const float ALPHA_TEST_CUTOFF = 0.5;
+
+void main() {
+	// repeats within rect like mapUV in shaders/include/material_data_incl.glsl, captures are
+	// too small for its margin to matter
+	vec4 texel = texture(albedoSampler, albedoRect.xy + fract(inUV) * albedoRect.zw);
+
+	if (alphaTest != 0u && texel.a < ALPHA_TEST_CUTOFF)
+		discard;
+
+	// unlit, impostor material shades it
+	outColor = vec4(texel.rgb * albedoFactor.rgb, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 450
+
+#extension GL_EXT_multiview : require
+
+// PackedVertex, position is in mesh bounds, centered on them
+layout(location = 0) in vec4 inPosition;
+layout(location = 3) in vec2 inUV;
+
+layout(location = 0) out vec2 outUV;
+
+// has to match ImpostorBaker::CapturePushConstants
+layout(push_constant) uniform CapturePushConstants {
+	vec4 albedoFactor;
+	vec4 albedoRect;
+	vec2 scale;
+	uint alphaTest;
+};
+
+const float TWO_PI = 6.28318530718;
+
+void main() {
+	// view looks back along front, same directions as ImpostorBaker::buildQuads
+	float azimuth = TWO_PI * float(gl_ViewIndex) / 6.0;
+	vec3 front = vec3(sin(azimuth), 0.0, cos(azimuth));
+	vec3 right = cross(vec3(0.0, 1.0, 0.0), front);
+
+	// orthographic, reverse depth, bounds of unit cube fit between planes
+	vec3 position = inPosition.xyz;
+	float depth = 0.5 + dot(position, front) / (2.0 * sqrt(3.0));
+
+	gl_Position = vec4(dot(position, right) * scale.x, -position.y * scale.y, depth, 1.0);
+	outUV = inUV;
+}
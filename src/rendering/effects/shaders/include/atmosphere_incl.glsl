@@ -0,0 +1,119 @@
+// has to match SkyAtmosphere::AtmosphereConstants, distances in kilometers, coefficients per
+// kilometer, heights above ground
+layout(push_constant) uniform AtmosphereConstants {
+	vec3 rayleighScattering;
+	float rayleighScaleHeight;
+	vec3 mieScattering;
+	float mieScaleHeight;
+	vec3 mieAbsorption;
+	float mieAnisotropy;
+	vec3 ozoneAbsorption;
+	float bottomRadius;
+	vec3 groundAlbedo;
+	float topRadius;
+	vec3 sunDirection;
+	float viewHeight;
+	vec3 sunIlluminance;
+	float _padding;
+} atmosphere;
+
+const float PI = 3.1415926535;
+
+// ozone density is a tent around its peak
+const float OZONE_CENTER_HEIGHT = 25.0;
+const float OZONE_HALF_WIDTH = 15.0;
+
+struct Medium {
+	vec3 rayleighScattering;
+	vec3 mieScattering;
+	vec3 scattering;
+	vec3 extinction;
+};
+
+Medium sampleMedium(float height) {
+	float rayleighDensity = exp(-height / atmosphere.rayleighScaleHeight);
+	float mieDensity = exp(-height / atmosphere.mieScaleHeight);
+	float ozoneDensity = max(1.0 - abs(height - OZONE_CENTER_HEIGHT) / OZONE_HALF_WIDTH, 0.0);
+
+	Medium medium;
+	medium.rayleighScattering = atmosphere.rayleighScattering * rayleighDensity;
+	medium.mieScattering = atmosphere.mieScattering * mieDensity;
+	medium.scattering = medium.rayleighScattering + medium.mieScattering;
+	medium.extinction = medium.scattering + atmosphere.mieAbsorption * mieDensity +
+			atmosphere.ozoneAbsorption * ozoneDensity;
+
+	return medium;
+}
+
+float rayleighPhase(float cosTheta) {
+	return 3.0 / (16.0 * PI) * (1.0 + cosTheta * cosTheta);
+}
+
+// Henyey-Greenstein
+float miePhase(float cosTheta, float g) {
+	float g2 = g * g;
+	return (1.0 - g2) / (4.0 * PI * pow(max(1.0 + g2 - 2.0 * g * cosTheta, 1e-4), 1.5));
+}
+
+// nearest hit in front of origin, negative when sphere around planet center is missed
+float raySphere(vec3 origin, vec3 dir, float radius) {
+	float b = dot(origin, dir);
+	float c = dot(origin, origin) - radius * radius;
+	float discriminant = b * b - c;
+
+	if (discriminant < 0.0)
+		return -1.0;
+
+	float root = sqrt(discriminant);
+	float near = -b - root;
+
+	return near >= 0.0 ? near : -b + root;
+}
+
+// Bruneton parametrization, horizon gets most texels, r is distance from planet center and mu
+// cosine of zenith angle
+vec2 transmittanceUv(float r, float mu) {
+	float bottom2 = atmosphere.bottomRadius * atmosphere.bottomRadius;
+	float h = sqrt(atmosphere.topRadius * atmosphere.topRadius - bottom2);
+	float rho = sqrt(max(r * r - bottom2, 0.0));
+
+	float discriminant = r * r * (mu * mu - 1.0) + atmosphere.topRadius * atmosphere.topRadius;
+	float d = max(-r * mu + sqrt(max(discriminant, 0.0)), 0.0);
+
+	float dMin = atmosphere.topRadius - r;
+	float dMax = rho + h;
+
+	return vec2((d - dMin) / (dMax - dMin), rho / h);
+}
+
+void transmittanceParameters(vec2 uv, out float r, out float mu) {
+	float bottom2 = atmosphere.bottomRadius * atmosphere.bottomRadius;
+	float h = sqrt(atmosphere.topRadius * atmosphere.topRadius - bottom2);
+	float rho = h * uv.y;
+	r = sqrt(rho * rho + bottom2);
+
+	float dMin = atmosphere.topRadius - r;
+	float dMax = rho + h;
+	float d = dMin + uv.x * (dMax - dMin);
+
+	mu = d == 0.0 ? 1.0 : (h * h - rho * rho - d * d) / (2.0 * r * d);
+	mu = clamp(mu, -1.0, 1.0);
+}
+
+// towards top of atmosphere, zero once planet is in the way
+vec3 sunTransmittance(sampler2D transmittanceLut, vec3 position) {
+	float r = length(position);
+	vec3 up = position / r;
+
+	if (raySphere(position, atmosphere.sunDirection, atmosphere.bottomRadius) > 0.0)
+		return vec3(0.0);
+
+	float mu = dot(up, atmosphere.sunDirection);
+	return textureLod(transmittanceLut, transmittanceUv(r, mu), 0.0).rgb;
+}
+
+// cosine of sun zenith angle across, height within atmosphere down
+vec2 multiScatteringUv(float r, float sunMu) {
+	float height = (r - atmosphere.bottomRadius) / (atmosphere.topRadius - atmosphere.bottomRadius);
+	return vec2(sunMu * 0.5 + 0.5, clamp(height, 0.0, 1.0));
+}
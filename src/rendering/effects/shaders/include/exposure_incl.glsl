@@ -0,0 +1,19 @@
+// bin zero counts pixels too dark to have a logarithm, the others span luminance range
+const uint BIN_COUNT = 256;
+
+const vec3 LUMINANCE_WEIGHTS = vec3(0.2126, 0.7152, 0.0722);
+
+layout(set = 0, binding = 1) buffer HistogramSSBO {
+	uint bins[BIN_COUNT];
+};
+
+layout(push_constant) uniform ExposureConstants {
+	// drawn part of scene color, at its top left
+	uvec2 inputSize;
+	float minLogLuminance;
+	float logLuminanceRange;
+	// fraction of way to target exposure covered this frame
+	float adaptation;
+	float middleGray;
+	uint isExposureValid;
+};
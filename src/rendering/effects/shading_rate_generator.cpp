@@ -0,0 +1,180 @@
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/attachment.h>
+
+#include "shaders/shading_rate.gen.h"
+
+#include "shading_rate_generator.h"
+
+void ShadingRateGenerator::ensure(vk::CommandBuffer commandBuffer, const Attachment &color,
+		const Attachment &shadingRate, vk::Extent2D attachmentExtent) {
+	if (color.getImageView() == _colorView && shadingRate.getImageView() == _shadingRateView)
+		return;
+
+	// earlier frames may still read set
+	RD::getSingleton().framesInFlightWait();
+
+	_colorView = color.getImageView();
+	_shadingRateView = shadingRate.getImageView();
+
+	_extent.width = (attachmentExtent.width + _texelSize.width - 1) / _texelSize.width;
+	_extent.height = (attachmentExtent.height + _texelSize.height - 1) / _texelSize.height;
+
+	vk::DescriptorImageInfo colorInfo;
+	colorInfo.setImageView(_colorView);
+	colorInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	colorInfo.setSampler(_sampler);
+
+	vk::DescriptorImageInfo shadingRateInfo;
+	shadingRateInfo.setImageView(_shadingRateView);
+	shadingRateInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+	for (uint32_t i = 0; i < writeInfos.size(); i++) {
+		writeInfos[i].setDstSet(_set);
+		writeInfos[i].setDstBinding(i);
+		writeInfos[i].setDstArrayElement(0);
+		writeInfos[i].setDescriptorCount(1);
+	}
+
+	writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfos[0].setImageInfo(colorInfo);
+	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+	writeInfos[1].setImageInfo(shadingRateInfo);
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
+
+	// zero is 1x1, render pass loads image in shading rate layout
+	vk::ImageSubresourceRange range = {};
+	range.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	range.setLevelCount(1);
+	range.setLayerCount(1);
+
+	vk::ImageMemoryBarrier barrier = {};
+	barrier.setImage(shadingRate.getImage());
+	barrier.setSubresourceRange(range);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setOldLayout(vk::ImageLayout::eUndefined);
+	barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+	vk::ClearColorValue clearValue;
+	clearValue.setUint32({ 0, 0, 0, 0 });
+
+	commandBuffer.clearColorImage(shadingRate.getImage(), vk::ImageLayout::eTransferDstOptimal,
+			clearValue, range);
+
+	barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setNewLayout(vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eFragmentShadingRateAttachmentReadKHR);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eFragmentShadingRateAttachmentKHR, {}, nullptr, nullptr,
+			barrier);
+}
+
+void ShadingRateGenerator::record(vk::CommandBuffer commandBuffer, vk::Extent2D inputExtent) {
+	ShadingRateConstants constants = {};
+	constants.inputSize[0] = inputExtent.width;
+	constants.inputSize[1] = inputExtent.height;
+	constants.texelSize[0] = _texelSize.width;
+	constants.texelSize[1] = _texelSize.height;
+	constants.coarseDeviation = SHADING_RATE_COARSE_DEVIATION;
+	constants.coarsestDeviation = SHADING_RATE_COARSEST_DEVIATION;
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _set, nullptr);
+	commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+			sizeof(ShadingRateConstants), &constants);
+
+	// tiles beyond render extent are written too, at full rate
+	commandBuffer.dispatch(_extent.width, _extent.height, 1);
+}
+
+void ShadingRateGenerator::initialize(vk::Device device, vk::DescriptorPool descriptorPool,
+		vk::Sampler colorSampler, vk::Extent2D texelSize) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_sampler = colorSampler;
+	_texelSize = texelSize;
+
+	std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Shading rate descriptor set layout creation failed!");
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(_setLayout);
+
+	err = device.allocateDescriptorSets(&allocInfo, &_set);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Shading rate descriptor set allocation failed!");
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(ShadingRateConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	ShadingRateShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Shading rate compute pipeline creation failed!");
+
+	device.destroyShaderModule(computeModule);
+
+	_pipeline = result.value;
+
+	_initialized = true;
+}
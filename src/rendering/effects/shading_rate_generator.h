@@ -0,0 +1,61 @@
+#ifndef SHADING_RATE_GENERATOR_H
+#define SHADING_RATE_GENERATOR_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/types/attachment.h>
+
+// deviation of luminance within tile, after compressing it to [0, 1), below which fragments of
+// tile are shaded at 2x2 and at 4x4 pixels
+const float SHADING_RATE_COARSE_DEVIATION = 0.02f;
+const float SHADING_RATE_COARSEST_DEVIATION = 0.005f;
+
+// Shading rate image of next frame from scene color of this one. Each tile of texel size gets
+// coarser rate the flatter its luminance is, smooth lighting and sky end up coarse while edges
+// and textured surfaces keep full rate. Image is cleared to full rate whenever it is allocated,
+// first frame drawn with it has no earlier one to learn from.
+class ShadingRateGenerator {
+private:
+	struct ShadingRateConstants {
+		uint32_t inputSize[2];
+		uint32_t texelSize[2];
+		float coarseDeviation;
+		float coarsestDeviation;
+	};
+
+	vk::Device _device;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _set;
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	vk::Sampler _sampler;
+
+	// set is written again when either changes
+	vk::ImageView _colorView;
+	vk::ImageView _shadingRateView;
+
+	vk::Extent2D _texelSize;
+	// of shading rate image
+	vk::Extent2D _extent;
+
+	bool _initialized = false;
+
+public:
+	// outside of render pass, before it begins, new shading rate image is cleared, frames in
+	// flight are waited for before set is written again
+	void ensure(vk::CommandBuffer commandBuffer, const Attachment &color,
+			const Attachment &shadingRate, vk::Extent2D attachmentExtent);
+
+	// pass of graph, color is sampled at render extent, shading rate image is written whole
+	void record(vk::CommandBuffer commandBuffer, vk::Extent2D inputExtent);
+
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool, vk::Sampler colorSampler,
+			vk::Extent2D texelSize);
+};
+
+#endif // !SHADING_RATE_GENERATOR_H
@@ -0,0 +1,614 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/allocated.h>
+
+#include "shaders/atmosphere_multiscattering.gen.h"
+#include "shaders/atmosphere_sky_view.gen.h"
+#include "shaders/atmosphere_transmittance.gen.h"
+#include "shaders/cubemap.gen.h"
+#include "shaders/cubemap_downsample.gen.h"
+#include "shaders/sh_project.gen.h"
+#include "shaders/specular_filter.gen.h"
+
+#include "sky_atmosphere.h"
+
+// matches environment of baked skies, storage support is mandatory for this format
+const vk::Format FORMAT = vk::Format::eR16G16B16A16Sfloat;
+
+static vk::ImageMemoryBarrier imageBarrier(vk::Image image, uint32_t mipLevels,
+		uint32_t arrayLayers, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask) {
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(0);
+	subresourceRange.setLevelCount(mipLevels);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(arrayLayers);
+
+	vk::ImageMemoryBarrier barrier;
+	barrier.setOldLayout(oldLayout);
+	barrier.setNewLayout(newLayout);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setSrcAccessMask(srcAccessMask);
+	barrier.setDstAccessMask(dstAccessMask);
+	barrier.setImage(image);
+	barrier.setSubresourceRange(subresourceRange);
+
+	return barrier;
+}
+
+// storage images are bound one level at a time
+static vk::ImageView createLevelView(vk::Device device, vk::Image image, uint32_t level,
+		vk::ImageViewType viewType, uint32_t layerCount = 6) {
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(level);
+	subresourceRange.setLevelCount(1);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(layerCount);
+
+	vk::ImageViewCreateInfo createInfo;
+	createInfo.setImage(image);
+	createInfo.setViewType(viewType);
+	createInfo.setFormat(FORMAT);
+	createInfo.setSubresourceRange(subresourceRange);
+
+	return device.createImageView(createInfo);
+}
+
+static void computeBarrier(vk::CommandBuffer commandBuffer) {
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+}
+
+vk::DescriptorSetLayout SkyAtmosphere::_createSetLayout(
+		const vk::DescriptorType *pTypes, uint32_t count) {
+	std::vector<vk::DescriptorSetLayoutBinding> bindings(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(pTypes[i]);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::DescriptorSetLayout setLayout;
+	vk::Result err = _device.createDescriptorSetLayout(&createInfo, nullptr, &setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Sky atmosphere descriptor set layout creation failed!");
+
+	return setLayout;
+}
+
+vk::Pipeline SkyAtmosphere::_createPipeline(
+		const uint32_t *pCode, size_t size, vk::PipelineLayout pipelineLayout) {
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(pCode);
+	moduleCreateInfo.setCodeSize(size);
+
+	vk::ShaderModule computeModule = _device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = _device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	_device.destroyShaderModule(computeModule);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Sky atmosphere compute pipeline creation failed!");
+
+	return result.value;
+}
+
+vk::PipelineLayout SkyAtmosphere::_createPipelineLayout(
+		vk::DescriptorSetLayout setLayout, uint32_t pushConstantsSize) {
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(pushConstantsSize);
+
+	vk::PipelineLayoutCreateInfo createInfo = {};
+	createInfo.setSetLayouts(setLayout);
+
+	if (pushConstantsSize > 0)
+		createInfo.setPushConstantRanges(pushConstant);
+
+	return _device.createPipelineLayout(createInfo);
+}
+
+void SkyAtmosphere::_updateImageSet(vk::DescriptorSet set, vk::ImageView srcImageView,
+		vk::ImageLayout srcLayout, vk::Sampler sampler, vk::ImageView dstImageView) {
+	std::array<vk::DescriptorImageInfo, 2> imageInfos = {};
+
+	imageInfos[0].setImageView(srcImageView);
+	imageInfos[0].setImageLayout(srcLayout);
+	imageInfos[0].setSampler(sampler);
+
+	imageInfos[1].setImageView(dstImageView);
+	imageInfos[1].setImageLayout(vk::ImageLayout::eGeneral);
+
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+	for (uint32_t i = 0; i < writeInfos.size(); i++) {
+		writeInfos[i].setDstSet(set);
+		writeInfos[i].setDstBinding(i);
+		writeInfos[i].setDescriptorType(i == 0 ? vk::DescriptorType::eCombinedImageSampler
+											   : vk::DescriptorType::eStorageImage);
+		writeInfos[i].setDescriptorCount(1);
+		writeInfos[i].setImageInfo(imageInfos[i]);
+	}
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
+}
+
+void SkyAtmosphere::_updateStorageSet(
+		vk::DescriptorSet set, vk::ImageView srcImageView, vk::ImageView dstImageView) {
+	std::array<vk::DescriptorImageInfo, 2> imageInfos = {};
+
+	imageInfos[0].setImageView(srcImageView);
+	imageInfos[0].setImageLayout(vk::ImageLayout::eGeneral);
+
+	imageInfos[1].setImageView(dstImageView);
+	imageInfos[1].setImageLayout(vk::ImageLayout::eGeneral);
+
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+	for (uint32_t i = 0; i < writeInfos.size(); i++) {
+		writeInfos[i].setDstSet(set);
+		writeInfos[i].setDstBinding(i);
+		writeInfos[i].setDescriptorType(vk::DescriptorType::eStorageImage);
+		writeInfos[i].setDescriptorCount(1);
+		writeInfos[i].setImageInfo(imageInfos[i]);
+	}
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
+}
+
+void SkyAtmosphere::update(const Atmosphere &atmosphere) {
+	AtmosphereConstants constants = {};
+	constants.rayleighScattering =
+			glm::vec4(atmosphere.rayleighScattering, atmosphere.rayleighScaleHeight);
+	constants.mieScattering = glm::vec4(atmosphere.mieScattering, atmosphere.mieScaleHeight);
+	constants.mieAbsorption = glm::vec4(atmosphere.mieAbsorption, atmosphere.mieAnisotropy);
+	constants.ozoneAbsorption = glm::vec4(atmosphere.ozoneAbsorption, atmosphere.bottomRadius);
+	constants.groundAlbedo = glm::vec4(atmosphere.groundAlbedo, atmosphere.topRadius);
+	float maxViewHeight = atmosphere.topRadius - atmosphere.bottomRadius;
+	constants.sunDirection = glm::vec4(glm::normalize(atmosphere.sunDirection),
+			std::clamp(atmosphere.viewHeight, 0.0f, maxViewHeight));
+	constants.sunIlluminance = glm::vec4(atmosphere.sunIlluminance, 0.0f);
+
+	if (memcmp(&constants, &_constants, LUT_CONSTANTS_SIZE) != 0)
+		_isLutStale = true;
+
+	if (memcmp(&constants, &_constants, sizeof(AtmosphereConstants)) != 0)
+		_isStale = true;
+
+	_constants = constants;
+}
+
+bool SkyAtmosphere::isStale() const {
+	return _isStale;
+}
+
+bool SkyAtmosphere::collect(uint32_t frame) {
+	if (!_isPartialsPending[frame])
+		return false;
+
+	_isPartialsPending[frame] = false;
+
+	RD::getSingleton().bufferInvalidate(_partials[frame]);
+
+	std::array<glm::vec4, 9> irradianceSH = EnvironmentEffects::reduceIrradiance(
+			reinterpret_cast<const glm::vec4 *>(_partialsAllocInfos[frame].pMappedData));
+
+	if (irradianceSH == _environment.irradianceSH)
+		return false;
+
+	_environment.irradianceSH = irradianceSH;
+	return true;
+}
+
+bool SkyAtmosphere::isPending() const {
+	for (uint32_t i = 0; i < _framesInFlight; i++) {
+		if (_isPartialsPending[i])
+			return true;
+	}
+
+	return false;
+}
+
+void SkyAtmosphere::_recordLuts(vk::CommandBuffer commandBuffer) {
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+
+	commandBuffer.bindDescriptorSets(bindPoint, _lutPipelineLayout, 0, _lutSet, nullptr);
+	commandBuffer.pushConstants(_lutPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+			sizeof(AtmosphereConstants), &_constants);
+
+	commandBuffer.bindPipeline(bindPoint, _transmittancePipeline);
+	commandBuffer.dispatch(
+			ATMOSPHERE_TRANSMITTANCE_WIDTH / 8, ATMOSPHERE_TRANSMITTANCE_HEIGHT / 8, 1);
+
+	computeBarrier(commandBuffer);
+
+	// group per texel
+	commandBuffer.bindPipeline(bindPoint, _multiScatteringPipeline);
+	commandBuffer.dispatch(ATMOSPHERE_MULTI_SCATTERING_SIZE, ATMOSPHERE_MULTI_SCATTERING_SIZE, 1);
+
+	computeBarrier(commandBuffer);
+
+	_isLutStale = false;
+}
+
+void SkyAtmosphere::_recordEnvironment(vk::CommandBuffer commandBuffer, uint32_t frame) {
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	vk::PipelineStageFlags computeStage = vk::PipelineStageFlagBits::eComputeShader;
+
+	vk::Image cubemap = _environment.cubemap.image;
+	vk::Image specular = _environment.specular.image;
+
+	// sky view
+
+	commandBuffer.bindPipeline(bindPoint, _skyViewPipeline);
+	commandBuffer.bindDescriptorSets(bindPoint, _lutPipelineLayout, 0, _lutSet, nullptr);
+	commandBuffer.pushConstants(_lutPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+			sizeof(AtmosphereConstants), &_constants);
+	commandBuffer.dispatch(ATMOSPHERE_SKY_VIEW_WIDTH / 8, ATMOSPHERE_SKY_VIEW_HEIGHT / 8, 1);
+
+	computeBarrier(commandBuffer);
+
+	// sky view to cubemap and its mip chain
+
+	{
+		uint32_t groupCount = (ATMOSPHERE_CUBEMAP_SIZE + 15) / 16;
+
+		commandBuffer.bindPipeline(bindPoint, _cubemapPipeline);
+		commandBuffer.bindDescriptorSets(
+				bindPoint, _cubemapPipelineLayout, 0, _cubemapSet, nullptr);
+		commandBuffer.dispatch(groupCount, groupCount, 6);
+
+		commandBuffer.bindPipeline(bindPoint, _downsamplePipeline);
+
+		for (uint32_t level = 1; level < ATMOSPHERE_CUBEMAP_LEVELS; level++) {
+			computeBarrier(commandBuffer);
+
+			uint32_t levelSize = std::max(ATMOSPHERE_CUBEMAP_SIZE >> level, 1u);
+			groupCount = (levelSize + 7) / 8;
+
+			commandBuffer.bindDescriptorSets(bindPoint, _downsamplePipelineLayout, 0,
+					_downsampleSets[level - 1], nullptr);
+			commandBuffer.dispatch(groupCount, groupCount, 6);
+		}
+
+		vk::ImageMemoryBarrier barrier = imageBarrier(cubemap, ATMOSPHERE_CUBEMAP_LEVELS, 6,
+				vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.pipelineBarrier(computeStage,
+				computeStage | vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr,
+				barrier);
+	}
+
+	// specular levels, level 0 is a mirror and takes no samples
+
+	commandBuffer.bindPipeline(bindPoint, _specularPipeline);
+
+	for (uint32_t level = 0; level < SPECULAR_LEVEL_COUNT; level++) {
+		uint32_t groupCount = ((ATMOSPHERE_SPECULAR_SIZE >> level) + 7) / 8;
+
+		SpecularFilterConstants constants = {};
+		constants.size = ATMOSPHERE_CUBEMAP_SIZE;
+		constants.roughness =
+				static_cast<float>(level) / static_cast<float>(SPECULAR_LEVEL_COUNT - 1);
+		constants.sampleCount = ATMOSPHERE_SPECULAR_SAMPLE_COUNT;
+		constants.firstFace = 0;
+
+		commandBuffer.bindDescriptorSets(
+				bindPoint, _specularPipelineLayout, 0, _filterSets[level], nullptr);
+		commandBuffer.pushConstants(_specularPipelineLayout, vk::ShaderStageFlagBits::eCompute,
+				0, sizeof(constants), &constants);
+		commandBuffer.dispatch(groupCount, groupCount, 6);
+	}
+
+	// irradiance projection, partials of this frame are read back once its fence signals
+
+	{
+		uint32_t groupCount = SH_SAMPLE_SIZE / 8;
+
+		ProjectConstants constants = {};
+		constants.sampleSize = SH_SAMPLE_SIZE;
+		constants.lod = std::max(
+				std::log2(static_cast<float>(ATMOSPHERE_CUBEMAP_SIZE) / SH_SAMPLE_SIZE), 0.0f);
+
+		commandBuffer.bindPipeline(bindPoint, _projectPipeline);
+		commandBuffer.bindDescriptorSets(
+				bindPoint, _projectPipelineLayout, 0, _projectSets[frame], nullptr);
+		commandBuffer.pushConstants(_projectPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+				sizeof(constants), &constants);
+		commandBuffer.dispatch(groupCount, groupCount, 6);
+	}
+
+	vk::MemoryBarrier hostBarrier;
+	hostBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	hostBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+
+	vk::ImageMemoryBarrier barrier = imageBarrier(specular, SPECULAR_LEVEL_COUNT, 6,
+			vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(computeStage,
+			vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eHost, {},
+			hostBarrier, nullptr, barrier);
+
+	_isPartialsPending[frame] = true;
+}
+
+void SkyAtmosphere::record(vk::CommandBuffer commandBuffer, uint32_t frame) {
+	// sky and lighting of earlier frames may still sample environment, sky view of previous
+	// record may still be read by cubemap
+	vk::ImageLayout oldLayout =
+			_isRecorded ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eUndefined;
+
+	std::array<vk::ImageMemoryBarrier, 2> barriers = {
+		imageBarrier(_environment.cubemap.image, ATMOSPHERE_CUBEMAP_LEVELS, 6, oldLayout,
+				vk::ImageLayout::eGeneral, {}, vk::AccessFlagBits::eShaderWrite),
+		imageBarrier(_environment.specular.image, SPECULAR_LEVEL_COUNT, 6, oldLayout,
+				vk::ImageLayout::eGeneral, {}, vk::AccessFlagBits::eShaderWrite),
+	};
+
+	commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, barriers);
+
+	if (_isLutStale)
+		_recordLuts(commandBuffer);
+
+	_recordEnvironment(commandBuffer, frame);
+
+	_isStale = false;
+	_isRecorded = true;
+}
+
+const EnvironmentData &SkyAtmosphere::getEnvironment() const {
+	return _environment;
+}
+
+void SkyAtmosphere::initialize(
+		vk::Device device, vk::DescriptorPool descriptorPool, uint32_t framesInFlight) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_framesInFlight = framesInFlight;
+
+	RD &rd = RD::getSingleton();
+
+	// set layouts
+
+	const std::array<vk::DescriptorType, 5> LUT_TYPES = {
+		vk::DescriptorType::eCombinedImageSampler,
+		vk::DescriptorType::eCombinedImageSampler,
+		vk::DescriptorType::eStorageImage,
+		vk::DescriptorType::eStorageImage,
+		vk::DescriptorType::eStorageImage,
+	};
+	const std::array<vk::DescriptorType, 2> FILTER_TYPES = {
+		vk::DescriptorType::eCombinedImageSampler,
+		vk::DescriptorType::eStorageImage,
+	};
+	const std::array<vk::DescriptorType, 2> DOWNSAMPLE_TYPES = {
+		vk::DescriptorType::eStorageImage,
+		vk::DescriptorType::eStorageImage,
+	};
+	const std::array<vk::DescriptorType, 2> PROJECT_TYPES = {
+		vk::DescriptorType::eCombinedImageSampler,
+		vk::DescriptorType::eStorageBuffer,
+	};
+
+	_lutSetLayout = _createSetLayout(LUT_TYPES.data(), LUT_TYPES.size());
+	_filterSetLayout = _createSetLayout(FILTER_TYPES.data(), FILTER_TYPES.size());
+	_downsampleSetLayout = _createSetLayout(DOWNSAMPLE_TYPES.data(), DOWNSAMPLE_TYPES.size());
+	_projectSetLayout = _createSetLayout(PROJECT_TYPES.data(), PROJECT_TYPES.size());
+
+	// sets
+
+	std::vector<vk::DescriptorSetLayout> layouts;
+	layouts.push_back(_lutSetLayout);
+	layouts.insert(layouts.end(), 1 + SPECULAR_LEVEL_COUNT, _filterSetLayout);
+	layouts.insert(layouts.end(), ATMOSPHERE_CUBEMAP_LEVELS - 1, _downsampleSetLayout);
+	layouts.insert(layouts.end(), framesInFlight, _projectSetLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	std::vector<vk::DescriptorSet> sets(layouts.size());
+	vk::Result err = device.allocateDescriptorSets(&allocInfo, sets.data());
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Sky atmosphere descriptor set allocation failed!");
+
+	size_t set = 0;
+	_lutSet = sets[set++];
+	_cubemapSet = sets[set++];
+
+	for (uint32_t i = 0; i < SPECULAR_LEVEL_COUNT; i++)
+		_filterSets[i] = sets[set++];
+
+	for (uint32_t i = 0; i < ATMOSPHERE_CUBEMAP_LEVELS - 1; i++)
+		_downsampleSets[i] = sets[set++];
+
+	for (uint32_t i = 0; i < framesInFlight; i++)
+		_projectSets[i] = sets[set++];
+
+	// tables, written by compute and sampled by it, they stay in general layout
+
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+
+	_transmittance = rd.imageCreate(MemoryCategory::Environment, ATMOSPHERE_TRANSMITTANCE_WIDTH,
+			ATMOSPHERE_TRANSMITTANCE_HEIGHT, FORMAT, 1, usage);
+	_transmittanceView = rd.imageViewCreate(_transmittance.image, FORMAT, 1);
+
+	_multiScattering = rd.imageCreate(MemoryCategory::Environment,
+			ATMOSPHERE_MULTI_SCATTERING_SIZE, ATMOSPHERE_MULTI_SCATTERING_SIZE, FORMAT, 1, usage);
+	_multiScatteringView = rd.imageViewCreate(_multiScattering.image, FORMAT, 1);
+
+	_skyView = rd.imageCreate(MemoryCategory::Environment, ATMOSPHERE_SKY_VIEW_WIDTH,
+			ATMOSPHERE_SKY_VIEW_HEIGHT, FORMAT, 1, usage);
+	_skyViewView = rd.imageViewCreate(_skyView.image, FORMAT, 1);
+
+	for (vk::Image image : { _transmittance.image, _multiScattering.image, _skyView.image })
+		rd.imageLayoutTransition(
+				image, FORMAT, 1, 1, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+
+	// environment, layout follows each record
+
+	_environment.cubemap = rd.imageCubeCreate(MemoryCategory::Environment,
+			ATMOSPHERE_CUBEMAP_SIZE, FORMAT, ATMOSPHERE_CUBEMAP_LEVELS, usage);
+	_environment.cubemapView = rd.imageViewCreate(_environment.cubemap.image, FORMAT,
+			ATMOSPHERE_CUBEMAP_LEVELS, 6, vk::ImageViewType::eCube);
+	_environment.cubemapSampler =
+			rd.samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge);
+
+	_environment.specular = rd.imageCubeCreate(MemoryCategory::Environment,
+			ATMOSPHERE_SPECULAR_SIZE, FORMAT, SPECULAR_LEVEL_COUNT, usage);
+	_environment.specularView = rd.imageViewCreate(_environment.specular.image, FORMAT,
+			SPECULAR_LEVEL_COUNT, 6, vk::ImageViewType::eCube);
+	_environment.specularSampler =
+			rd.samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge);
+	_environment.specularSize = ATMOSPHERE_SPECULAR_SIZE;
+
+	// descriptors, views of single levels live as long as the effect
+
+	vk::Sampler sampler = rd.samplerGet(
+			vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, 0.0f, false);
+
+	{
+		std::array<vk::DescriptorImageInfo, 5> imageInfos = {};
+		imageInfos[0].setImageView(_transmittanceView);
+		imageInfos[0].setSampler(sampler);
+		imageInfos[1].setImageView(_multiScatteringView);
+		imageInfos[1].setSampler(sampler);
+		imageInfos[2].setImageView(_transmittanceView);
+		imageInfos[3].setImageView(_multiScatteringView);
+		imageInfos[4].setImageView(_skyViewView);
+
+		std::array<vk::WriteDescriptorSet, 5> writeInfos = {};
+
+		for (uint32_t i = 0; i < writeInfos.size(); i++) {
+			imageInfos[i].setImageLayout(vk::ImageLayout::eGeneral);
+
+			writeInfos[i].setDstSet(_lutSet);
+			writeInfos[i].setDstBinding(i);
+			writeInfos[i].setDescriptorType(LUT_TYPES[i]);
+			writeInfos[i].setDescriptorCount(1);
+			writeInfos[i].setImageInfo(imageInfos[i]);
+		}
+
+		device.updateDescriptorSets(writeInfos, nullptr);
+	}
+
+	// cubemap level 0 is written as cube, downsample reads it and writes other levels as layers
+	vk::ImageView cubeView =
+			createLevelView(device, _environment.cubemap.image, 0, vk::ImageViewType::eCube);
+	_updateImageSet(_cubemapSet, _skyViewView, vk::ImageLayout::eGeneral, sampler, cubeView);
+
+	vk::ImageView srcView =
+			createLevelView(device, _environment.cubemap.image, 0, vk::ImageViewType::e2DArray);
+
+	for (uint32_t level = 1; level < ATMOSPHERE_CUBEMAP_LEVELS; level++) {
+		vk::ImageView dstView = createLevelView(
+				device, _environment.cubemap.image, level, vk::ImageViewType::e2DArray);
+		_updateStorageSet(_downsampleSets[level - 1], srcView, dstView);
+		srcView = dstView;
+	}
+
+	for (uint32_t level = 0; level < SPECULAR_LEVEL_COUNT; level++) {
+		vk::ImageView dstView = createLevelView(
+				device, _environment.specular.image, level, vk::ImageViewType::e2DArray);
+		_updateImageSet(_filterSets[level], _environment.cubemapView,
+				vk::ImageLayout::eShaderReadOnlyOptimal, sampler, dstView);
+	}
+
+	vk::DeviceSize partialsSize = sizeof(glm::vec4) * SH_PARTIAL_STRIDE * SH_PARTIAL_COUNT;
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_partials[i] = rd.bufferCreate(MemoryCategory::Environment, BufferClass::Readback,
+				vk::BufferUsageFlagBits::eStorageBuffer, partialsSize, &_partialsAllocInfos[i]);
+
+		vk::DescriptorImageInfo imageInfo = {};
+		imageInfo.setImageView(_environment.cubemapView);
+		imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		imageInfo.setSampler(sampler);
+
+		vk::DescriptorBufferInfo bufferInfo(_partials[i].buffer, 0, partialsSize);
+
+		std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+		writeInfos[0].setDstSet(_projectSets[i]);
+		writeInfos[0].setDstBinding(0);
+		writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfos[0].setDescriptorCount(1);
+		writeInfos[0].setImageInfo(imageInfo);
+
+		writeInfos[1].setDstSet(_projectSets[i]);
+		writeInfos[1].setDstBinding(1);
+		writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writeInfos[1].setDescriptorCount(1);
+		writeInfos[1].setBufferInfo(bufferInfo);
+
+		device.updateDescriptorSets(writeInfos, nullptr);
+	}
+
+	// pipelines
+
+	_lutPipelineLayout = _createPipelineLayout(_lutSetLayout, sizeof(AtmosphereConstants));
+	_transmittancePipeline = _createPipeline(AtmosphereTransmittanceShader::computeCode,
+			sizeof(AtmosphereTransmittanceShader::computeCode), _lutPipelineLayout);
+	_multiScatteringPipeline = _createPipeline(AtmosphereMultiscatteringShader::computeCode,
+			sizeof(AtmosphereMultiscatteringShader::computeCode), _lutPipelineLayout);
+	_skyViewPipeline = _createPipeline(AtmosphereSkyViewShader::computeCode,
+			sizeof(AtmosphereSkyViewShader::computeCode), _lutPipelineLayout);
+
+	_cubemapPipelineLayout = _createPipelineLayout(_filterSetLayout, 0);
+	_cubemapPipeline = _createPipeline(CubemapShader::computeCode,
+			sizeof(CubemapShader::computeCode), _cubemapPipelineLayout);
+
+	_downsamplePipelineLayout = _createPipelineLayout(_downsampleSetLayout, 0);
+	_downsamplePipeline = _createPipeline(CubemapDownsampleShader::computeCode,
+			sizeof(CubemapDownsampleShader::computeCode), _downsamplePipelineLayout);
+
+	_specularPipelineLayout =
+			_createPipelineLayout(_filterSetLayout, sizeof(SpecularFilterConstants));
+	_specularPipeline = _createPipeline(SpecularFilterShader::computeCode,
+			sizeof(SpecularFilterShader::computeCode), _specularPipelineLayout);
+
+	_projectPipelineLayout = _createPipelineLayout(_projectSetLayout, sizeof(ProjectConstants));
+	_projectPipeline = _createPipeline(ShProjectShader::computeCode,
+			sizeof(ShProjectShader::computeCode), _projectPipelineLayout);
+
+	_initialized = true;
+}
@@ -0,0 +1,155 @@
+#ifndef SKY_ATMOSPHERE_H
+#define SKY_ATMOSPHERE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/types/allocated.h>
+#include <rendering/types/atmosphere.h>
+#include <rendering/types/frame.h>
+
+#include "environment_effects.h"
+
+// of lookup tables, transmittance over height and zenith angle, multiple scattering over height
+// and sun angle, sky view equirectangular over directions
+const uint32_t ATMOSPHERE_TRANSMITTANCE_WIDTH = 256;
+const uint32_t ATMOSPHERE_TRANSMITTANCE_HEIGHT = 64;
+const uint32_t ATMOSPHERE_MULTI_SCATTERING_SIZE = 32;
+const uint32_t ATMOSPHERE_SKY_VIEW_WIDTH = 256;
+const uint32_t ATMOSPHERE_SKY_VIEW_HEIGHT = 128;
+
+// scattered sky has no detail a larger cubemap would show, sun disk is left out
+const uint32_t ATMOSPHERE_CUBEMAP_SIZE = 128;
+const uint32_t ATMOSPHERE_CUBEMAP_LEVELS = 8;
+const uint32_t ATMOSPHERE_SPECULAR_SIZE = 64;
+// importance samples per texel of rough specular levels, smooth sky needs few
+const uint32_t ATMOSPHERE_SPECULAR_SAMPLE_COUNT = 64;
+
+// Procedural sky after Hillaire 2020, in place of a baked one. Transmittance and multiple
+// scattering tables depend on planet and atmosphere alone and are written again only when those
+// change, moving sun or viewer renders the small sky view table from them. Environment of it is
+// filtered on graphics queue in the same frame at sizes cheap enough to do every frame, so there
+// is no bake and no source image. Specular is ready right away, irradiance is projected on GPU
+// and read back once the frame is finished, lighting uses previous one until then.
+class SkyAtmosphere {
+private:
+	// vec4 pairs of atmosphere_incl.glsl
+	typedef struct {
+		glm::vec4 rayleighScattering;
+		glm::vec4 mieScattering;
+		glm::vec4 mieAbsorption;
+		glm::vec4 ozoneAbsorption;
+		glm::vec4 groundAlbedo;
+		glm::vec4 sunDirection;
+		glm::vec4 sunIlluminance;
+	} AtmosphereConstants;
+
+	// leading part, tables of transmittance and multiple scattering are written from it alone
+	static const size_t LUT_CONSTANTS_SIZE = offsetof(AtmosphereConstants, sunDirection);
+
+	typedef struct {
+		uint32_t size;
+		float roughness;
+		uint32_t sampleCount;
+		uint32_t firstFace;
+	} SpecularFilterConstants;
+
+	typedef struct {
+		uint32_t sampleSize;
+		float lod;
+	} ProjectConstants;
+
+	vk::Device _device;
+
+	// samplers of transmittance and multiple scattering, storage images of all three tables
+	vk::DescriptorSetLayout _lutSetLayout;
+	vk::DescriptorSet _lutSet;
+
+	vk::PipelineLayout _lutPipelineLayout;
+	vk::Pipeline _transmittancePipeline;
+	vk::Pipeline _multiScatteringPipeline;
+	vk::Pipeline _skyViewPipeline;
+
+	// sampled source and written level, of cubemap and specular levels
+	vk::DescriptorSetLayout _filterSetLayout;
+	vk::DescriptorSet _cubemapSet;
+	vk::DescriptorSet _filterSets[SPECULAR_LEVEL_COUNT];
+
+	vk::DescriptorSetLayout _downsampleSetLayout;
+	vk::DescriptorSet _downsampleSets[ATMOSPHERE_CUBEMAP_LEVELS - 1];
+
+	// partials of frames in flight are read back independently
+	vk::DescriptorSetLayout _projectSetLayout;
+	vk::DescriptorSet _projectSets[MAX_FRAMES_IN_FLIGHT];
+
+	vk::PipelineLayout _cubemapPipelineLayout;
+	vk::Pipeline _cubemapPipeline;
+	vk::PipelineLayout _downsamplePipelineLayout;
+	vk::Pipeline _downsamplePipeline;
+	vk::PipelineLayout _specularPipelineLayout;
+	vk::Pipeline _specularPipeline;
+	vk::PipelineLayout _projectPipelineLayout;
+	vk::Pipeline _projectPipeline;
+
+	AllocatedImage _transmittance;
+	vk::ImageView _transmittanceView;
+	AllocatedImage _multiScattering;
+	vk::ImageView _multiScatteringView;
+	AllocatedImage _skyView;
+	vk::ImageView _skyViewView;
+
+	EnvironmentData _environment = {};
+
+	AllocatedBuffer _partials[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _partialsAllocInfos[MAX_FRAMES_IN_FLIGHT];
+	bool _isPartialsPending[MAX_FRAMES_IN_FLIGHT] = {};
+	uint32_t _framesInFlight = 0;
+
+	AtmosphereConstants _constants = {};
+	bool _isLutStale = true;
+	bool _isStale = true;
+	// cubemap and specular have undefined contents before first record
+	bool _isRecorded = false;
+
+	bool _initialized = false;
+
+	vk::DescriptorSetLayout _createSetLayout(const vk::DescriptorType *pTypes, uint32_t count);
+	// built in shaders, no hot reload
+	vk::Pipeline _createPipeline(
+			const uint32_t *pCode, size_t size, vk::PipelineLayout pipelineLayout);
+	vk::PipelineLayout _createPipelineLayout(
+			vk::DescriptorSetLayout setLayout, uint32_t pushConstantsSize);
+
+	void _updateImageSet(vk::DescriptorSet set, vk::ImageView srcImageView,
+			vk::ImageLayout srcLayout, vk::Sampler sampler, vk::ImageView dstImageView);
+	void _updateStorageSet(
+			vk::DescriptorSet set, vk::ImageView srcImageView, vk::ImageView dstImageView);
+
+	void _recordLuts(vk::CommandBuffer commandBuffer);
+	void _recordEnvironment(vk::CommandBuffer commandBuffer, uint32_t frame);
+
+public:
+	// tables are marked stale only when planet or atmosphere differ, environment on any change
+	void update(const Atmosphere &atmosphere);
+	bool isStale() const;
+
+	// after fence of frame signaled, true when irradiance it projected differs from current one
+	bool collect(uint32_t frame);
+	// irradiance of a recorded frame is not read back yet
+	bool isPending() const;
+
+	// outside of render passes before anything samples environment, it is readable by fragment
+	// shaders after it
+	void record(vk::CommandBuffer commandBuffer, uint32_t frame);
+
+	// owned by effect, bound in place of baked sky's
+	const EnvironmentData &getEnvironment() const;
+
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool, uint32_t framesInFlight);
+};
+
+#endif // !SKY_ATMOSPHERE_H
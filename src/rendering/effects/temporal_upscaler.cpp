@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+
+#include <rendering/shaders/temporal_resolve.gen.h>
+
+#include "temporal_upscaler.h"
+
+const vk::Format FORMAT = vk::Format::eR16G16B16A16Sfloat;
+const uint32_t GROUP_SIZE = 8;
+
+static float _halton(uint32_t index, uint32_t base) {
+	float fraction = 1.0f;
+	float result = 0.0f;
+
+	while (index > 0) {
+		fraction /= static_cast<float>(base);
+		result += fraction * static_cast<float>(index % base);
+		index /= base;
+	}
+
+	return result;
+}
+
+glm::vec2 TemporalUpscaler::getJitter(uint64_t frame, uint32_t phaseCount) {
+	// first element of both sequences is zero, it is skipped
+	uint32_t index = static_cast<uint32_t>(frame % std::max(phaseCount, 1u)) + 1;
+
+	return glm::vec2(_halton(index, 2) - 0.5f, _halton(index, 3) - 0.5f);
+}
+
+uint32_t TemporalUpscaler::getPhaseCount(vk::Extent2D inputExtent, vk::Extent2D outputExtent) {
+	float ratio = static_cast<float>(outputExtent.height) /
+			static_cast<float>(std::max(inputExtent.height, 1u));
+	float count = std::ceil(static_cast<float>(TEMPORAL_PHASES_PER_PIXEL) * ratio * ratio);
+
+	return std::clamp(static_cast<uint32_t>(count), TEMPORAL_PHASES_PER_PIXEL,
+			MAX_TEMPORAL_PHASE_COUNT);
+}
+
+void TemporalUpscaler::_create(vk::Extent2D extent) {
+	RD &rd = RD::getSingleton();
+
+	_extent = extent;
+
+	for (uint32_t i = 0; i < TEMPORAL_HISTORY_COUNT; i++) {
+		_images[i] = rd.imageCreate(MemoryCategory::RenderTarget, extent.width, extent.height,
+				FORMAT, 1, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+
+		rd.imageLayoutTransition(_images[i].image, FORMAT, 1, 1, vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eGeneral);
+
+		_imageViews[i] = rd.imageViewCreate(_images[i].image, FORMAT, 1);
+	}
+
+	_isHistoryValid = false;
+}
+
+void TemporalUpscaler::_destroy() {
+	if (!_imageViews[0])
+		return;
+
+	RD &rd = RD::getSingleton();
+
+	for (uint32_t i = 0; i < TEMPORAL_HISTORY_COUNT; i++) {
+		rd.imageViewDestroy(_imageViews[i]);
+		rd.imageDestroy(_images[i]);
+
+		_imageViews[i] = nullptr;
+	}
+
+	_isHistoryValid = false;
+}
+
+void TemporalUpscaler::_updateSets() {
+	for (uint32_t i = 0; i < TEMPORAL_HISTORY_COUNT; i++) {
+		uint32_t previous = (i + TEMPORAL_HISTORY_COUNT - 1) % TEMPORAL_HISTORY_COUNT;
+
+		std::array<vk::DescriptorImageInfo, 4> imageInfos;
+		imageInfos[0].setImageView(_colorView);
+		imageInfos[0].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		imageInfos[0].setSampler(_sampler);
+
+		imageInfos[1].setImageView(_depthView);
+		imageInfos[1].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		imageInfos[1].setSampler(_sampler);
+
+		imageInfos[2].setImageView(_imageViews[previous]);
+		imageInfos[2].setImageLayout(vk::ImageLayout::eGeneral);
+		imageInfos[2].setSampler(_sampler);
+
+		imageInfos[3].setImageView(_imageViews[i]);
+		imageInfos[3].setImageLayout(vk::ImageLayout::eGeneral);
+
+		std::array<vk::WriteDescriptorSet, 5> writeInfos = {};
+
+		for (uint32_t j = 0; j < imageInfos.size(); j++) {
+			writeInfos[j].setDstSet(_sets[i]);
+			writeInfos[j].setDstBinding(j);
+			writeInfos[j].setDstArrayElement(0);
+			writeInfos[j].setDescriptorType(j == 3 ? vk::DescriptorType::eStorageImage
+												   : vk::DescriptorType::eCombinedImageSampler);
+			writeInfos[j].setDescriptorCount(1);
+			writeInfos[j].setImageInfo(imageInfos[j]);
+		}
+
+		vk::DescriptorImageInfo outputInfo;
+		outputInfo.setImageView(_imageViews[i]);
+		outputInfo.setImageLayout(vk::ImageLayout::eGeneral);
+		outputInfo.setSampler(_outputSampler);
+
+		writeInfos[4].setDstSet(_outputSets[i]);
+		writeInfos[4].setDstBinding(0);
+		writeInfos[4].setDstArrayElement(0);
+		writeInfos[4].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfos[4].setDescriptorCount(1);
+		writeInfos[4].setImageInfo(outputInfo);
+
+		_device.updateDescriptorSets(writeInfos, nullptr);
+	}
+}
+
+bool TemporalUpscaler::ensure(
+		const Attachment &color, const Attachment &depth, vk::Extent2D extent) {
+	bool isSourceChanged =
+			color.getImageView() != _colorView || depth.getImageView() != _depthView;
+
+	if (!isSourceChanged && extent == _extent && _imageViews[0])
+		return false;
+
+	// earlier frames may still read history and sets
+	RD::getSingleton().framesInFlightWait();
+
+	if (extent != _extent || !_imageViews[0]) {
+		_destroy();
+		_create(extent);
+	}
+
+	_colorView = color.getImageView();
+	_depthView = depth.getImageView();
+
+	_updateSets();
+	return true;
+}
+
+void TemporalUpscaler::invalidate() {
+	_isHistoryValid = false;
+}
+
+GraphImage TemporalUpscaler::historyImport(RenderGraph &graph, bool isWritten) const {
+	uint32_t index = isWritten ? (_current + 1) % TEMPORAL_HISTORY_COUNT : _current;
+
+	// written and read by resolves, read by tonemap passes
+	RenderGraph::State state = { vk::ImageLayout::eGeneral,
+		vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
+		vk::AccessFlagBits::eShaderWrite };
+
+	return graph.imageImport(_images[index].image, vk::ImageAspectFlagBits::eColor, state);
+}
+
+void TemporalUpscaler::record(vk::CommandBuffer commandBuffer, const glm::mat4 &reprojection,
+		glm::vec2 jitter, vk::Extent2D inputExtent) {
+	uint32_t next = (_current + 1) % TEMPORAL_HISTORY_COUNT;
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _sets[next], nullptr);
+
+	ResolveConstants constants = {};
+	constants.reprojection = reprojection;
+	constants.jitter[0] = jitter.x;
+	constants.jitter[1] = jitter.y;
+	constants.inputSize[0] = static_cast<float>(inputExtent.width);
+	constants.inputSize[1] = static_cast<float>(inputExtent.height);
+	constants.isHistoryValid = _isHistoryValid ? 1 : 0;
+	constants.currentWeight = TEMPORAL_CURRENT_WEIGHT;
+
+	commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+			sizeof(ResolveConstants), &constants);
+
+	uint32_t groupCountX = (_extent.width + GROUP_SIZE - 1) / GROUP_SIZE;
+	uint32_t groupCountY = (_extent.height + GROUP_SIZE - 1) / GROUP_SIZE;
+	commandBuffer.dispatch(groupCountX, groupCountY, 1);
+
+	_current = next;
+	_isHistoryValid = true;
+}
+
+vk::DescriptorSet TemporalUpscaler::getOutputSet() const {
+	return _outputSets[_current];
+}
+
+void TemporalUpscaler::initialize(vk::Device device, vk::DescriptorPool descriptorPool,
+		vk::DescriptorSetLayout outputLayout, vk::Sampler outputSampler) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_outputSampler = outputSampler;
+
+	std::array<vk::DescriptorSetLayoutBinding, 4> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(i == 3 ? vk::DescriptorType::eStorageImage
+											 : vk::DescriptorType::eCombinedImageSampler);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Temporal resolve descriptor set layout creation failed!");
+
+	std::array<vk::DescriptorSetLayout, TEMPORAL_HISTORY_COUNT> layouts;
+	layouts.fill(_setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Temporal resolve descriptor set allocation failed!");
+
+	layouts.fill(outputLayout);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _outputSets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Temporal output descriptor set allocation failed!");
+
+	// current samples are fetched, history is reprojected between texels
+	vk::SamplerCreateInfo samplerInfo;
+	samplerInfo.setMagFilter(vk::Filter::eLinear);
+	samplerInfo.setMinFilter(vk::Filter::eLinear);
+	samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+	samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setMinLod(0.0f);
+	samplerInfo.setMaxLod(0.0f);
+
+	_sampler = device.createSampler(samplerInfo);
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(ResolveConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	TemporalResolveShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Temporal resolve compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
@@ -0,0 +1,96 @@
+#ifndef TEMPORAL_UPSCALER_H
+#define TEMPORAL_UPSCALER_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/render_graph.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+
+// one is written by resolve while the other is read as history
+const uint32_t TEMPORAL_HISTORY_COUNT = 2;
+
+// weight of current frame where one of its samples lands right on output pixel
+const float TEMPORAL_CURRENT_WEIGHT = 0.1f;
+
+// frames a jitter sequence spans per output pixel covered by one render texel
+const uint32_t TEMPORAL_PHASES_PER_PIXEL = 8;
+const uint32_t MAX_TEMPORAL_PHASE_COUNT = 64;
+
+// Accumulates jittered frames at render extent into history at output extent. Every output
+// pixel weighs current samples around it by distance, history is reprojected with camera
+// motion through depth and clipped to box of current neighborhood, so moving objects smear
+// only as far as their neighborhood allows.
+class TemporalUpscaler {
+private:
+	struct ResolveConstants {
+		glm::mat4 reprojection;
+		float jitter[2];
+		float inputSize[2];
+		uint32_t isHistoryValid;
+		float currentWeight;
+	};
+
+	vk::Device _device;
+
+	vk::DescriptorSetLayout _setLayout;
+	// by history written
+	vk::DescriptorSet _sets[TEMPORAL_HISTORY_COUNT];
+	// history sampled by tonemap pass, with its set layout
+	vk::DescriptorSet _outputSets[TEMPORAL_HISTORY_COUNT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	vk::Sampler _sampler;
+	vk::Sampler _outputSampler;
+
+	// always in general layout
+	AllocatedImage _images[TEMPORAL_HISTORY_COUNT];
+	vk::ImageView _imageViews[TEMPORAL_HISTORY_COUNT];
+	vk::Extent2D _extent;
+
+	// sets are written again when sources change
+	vk::ImageView _colorView;
+	vk::ImageView _depthView;
+
+	// written by last record
+	uint32_t _current = 0;
+	bool _isHistoryValid = false;
+
+	bool _initialized = false;
+
+	void _create(vk::Extent2D extent);
+	void _destroy();
+	void _updateSets();
+
+public:
+	// offset of render texel centers for frame, in render texels, Halton sequence in base 2 and 3
+	static glm::vec2 getJitter(uint64_t frame, uint32_t phaseCount);
+	// more phases as every render texel covers more output pixels
+	static uint32_t getPhaseCount(vk::Extent2D inputExtent, vk::Extent2D outputExtent);
+
+	// returns true when history was recreated, frames in flight are waited for before it is
+	bool ensure(const Attachment &color, const Attachment &depth, vk::Extent2D extent);
+	// next resolve starts over from current frame
+	void invalidate();
+
+	// history written by next record, otherwise one it reads, both stay in general layout
+	GraphImage historyImport(RenderGraph &graph, bool isWritten) const;
+	// pass of graph, color and depth are sampled and histories used as imported, reprojection
+	// takes unjittered clip space to that of previous frame
+	void record(vk::CommandBuffer commandBuffer, const glm::mat4 &reprojection, glm::vec2 jitter,
+			vk::Extent2D inputExtent);
+
+	// of history written by last record, readable by fragment shaders once it is recorded
+	vk::DescriptorSet getOutputSet() const;
+
+	// output sets are allocated with layout of single sampled image, read through sampler
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool,
+			vk::DescriptorSetLayout outputLayout, vk::Sampler outputSampler);
+};
+
+#endif // !TEMPORAL_UPSCALER_H
@@ -0,0 +1,194 @@
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/allocated.h>
+
+#include "shaders/tonemap_lut.gen.h"
+
+#include "tonemap_lut.h"
+
+const vk::Format FORMAT = vk::Format::eR16G16B16A16Sfloat;
+const uint32_t GROUP_SIZE = 4;
+
+void TonemapLut::update(float white, TonemapLook look) {
+	if (white == _white && look == _look)
+		return;
+
+	_white = white;
+	_look = look;
+	_isStale = true;
+}
+
+bool TonemapLut::isStale() const {
+	return _isStale;
+}
+
+void TonemapLut::record(vk::CommandBuffer commandBuffer) {
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setLevelCount(1);
+	subresourceRange.setLayerCount(1);
+
+	// tonemap passes of earlier frames may still sample it
+	vk::ImageMemoryBarrier barrier;
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setImage(_image.image);
+	barrier.setSubresourceRange(subresourceRange);
+	barrier.setOldLayout(vk::ImageLayout::eGeneral);
+	barrier.setNewLayout(vk::ImageLayout::eGeneral);
+	barrier.setSrcAccessMask({});
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+			vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, barrier);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _set, nullptr);
+
+	LutConstants constants = { _white, _look };
+	commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+			sizeof(LutConstants), &constants);
+
+	uint32_t groupCount = (TONEMAP_LUT_SIZE + GROUP_SIZE - 1) / GROUP_SIZE;
+	commandBuffer.dispatch(groupCount, groupCount, groupCount);
+
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+
+	_isStale = false;
+}
+
+vk::DescriptorSetLayout TonemapLut::getSampledSetLayout() const {
+	return _sampledSetLayout;
+}
+
+vk::DescriptorSet TonemapLut::getSampledSet() const {
+	return _sampledSet;
+}
+
+void TonemapLut::initialize(vk::Device device, vk::DescriptorPool descriptorPool) {
+	if (_initialized)
+		return;
+
+	_device = device;
+
+	vk::DescriptorSetLayoutBinding binding;
+	binding.setBinding(0);
+	binding.setDescriptorType(vk::DescriptorType::eStorageImage);
+	binding.setDescriptorCount(1);
+	binding.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(binding);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Tonemap LUT descriptor set layout creation failed!");
+
+	binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	err = device.createDescriptorSetLayout(&createInfo, nullptr, &_sampledSetLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Tonemap LUT sampled descriptor set layout creation failed!");
+
+	std::array<vk::DescriptorSetLayout, 2> layouts = { _setLayout, _sampledSetLayout };
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	std::array<vk::DescriptorSet, 2> sets;
+	err = device.allocateDescriptorSets(&allocInfo, sets.data());
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Tonemap LUT descriptor set allocation failed!");
+
+	_set = sets[0];
+	_sampledSet = sets[1];
+
+	RD &rd = RD::getSingleton();
+
+	_image = rd.imageVolumeCreate(MemoryCategory::RenderTarget, TONEMAP_LUT_SIZE,
+			TONEMAP_LUT_SIZE, TONEMAP_LUT_SIZE, FORMAT,
+			vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+
+	rd.imageLayoutTransition(
+			_image.image, FORMAT, 1, 1, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+
+	_imageView = rd.imageViewCreate(_image.image, FORMAT, 1, 1, vk::ImageViewType::e3D);
+
+	// trilinear between texels, edges hold ends of curve
+	vk::Sampler sampler =
+			rd.samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, 0.0f, false);
+
+	std::array<vk::DescriptorImageInfo, 2> imageInfos;
+	imageInfos[0].setImageView(_imageView);
+	imageInfos[0].setImageLayout(vk::ImageLayout::eGeneral);
+
+	imageInfos[1] = imageInfos[0];
+	imageInfos[1].setSampler(sampler);
+
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+
+	for (uint32_t i = 0; i < writeInfos.size(); i++) {
+		writeInfos[i].setDstSet(sets[i]);
+		writeInfos[i].setDstBinding(0);
+		writeInfos[i].setDstArrayElement(0);
+		writeInfos[i].setDescriptorType(i == 0 ? vk::DescriptorType::eStorageImage
+											   : vk::DescriptorType::eCombinedImageSampler);
+		writeInfos[i].setDescriptorCount(1);
+		writeInfos[i].setImageInfo(imageInfos[i]);
+	}
+
+	device.updateDescriptorSets(writeInfos, nullptr);
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(LutConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	TonemapLutShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result =
+			device.createComputePipeline(rd.getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Tonemap LUT compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
@@ -0,0 +1,65 @@
+#ifndef TONEMAP_LUT_H
+#define TONEMAP_LUT_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/types/allocated.h>
+
+// texels along each axis, matches size in tonemap_lut_incl.glsl
+const uint32_t TONEMAP_LUT_SIZE = 32;
+
+// grade applied after curve, before display transform
+enum class TonemapLook : uint32_t {
+	None,
+	// ASC CDL with more contrast and saturation
+	Punchy,
+};
+
+// AgX curve, look and display transform of tonemap pass baked into a volume over log2 of
+// exposed scene color, so the pass does one trilinear fetch per pixel. Exposure is applied
+// before the fetch, only white and look written into it make it stale. Volume stays in general
+// layout, it is written by compute and sampled by fragment shaders.
+class TonemapLut {
+private:
+	struct LutConstants {
+		float white;
+		TonemapLook look;
+	};
+
+	vk::Device _device;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _set;
+	// volume alone, sampled by fragment shader
+	vk::DescriptorSetLayout _sampledSetLayout;
+	vk::DescriptorSet _sampledSet;
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	AllocatedImage _image;
+	vk::ImageView _imageView;
+
+	float _white = 0.0f;
+	TonemapLook _look = TonemapLook::None;
+	bool _isStale = true;
+
+	bool _initialized = false;
+
+public:
+	// marks volume stale when either differs from those it was written with
+	void update(float white, TonemapLook look);
+	bool isStale() const;
+
+	// writes volume, outside of render passes, it is readable by fragment shaders after it
+	void record(vk::CommandBuffer commandBuffer);
+
+	vk::DescriptorSetLayout getSampledSetLayout() const;
+	vk::DescriptorSet getSampledSet() const;
+
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool);
+};
+
+#endif // !TONEMAP_LUT_H
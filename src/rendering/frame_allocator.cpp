@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "frame_allocator.h"
+
+FrameAllocator::Allocation FrameAllocator::allocate(
+		vk::DeviceSize size, vk::DeviceSize alignment) {
+	alignment = std::max(alignment, _alignment);
+
+	vk::DeviceSize head = _head.load();
+	vk::DeviceSize offset;
+
+	do {
+		offset = (head + alignment - 1) & ~(alignment - 1);
+
+		if (offset + size > FRAME_ALLOCATOR_SIZE)
+			return { nullptr, 0, 0 };
+	} while (!_head.compare_exchange_weak(head, offset + size));
+
+	uint8_t *pBuffer = static_cast<uint8_t *>(_allocInfos[_frame].pMappedData);
+
+	return { pBuffer + offset, static_cast<uint32_t>(offset), size };
+}
+
+FrameAllocator::Allocation FrameAllocator::write(
+		const void *pData, vk::DeviceSize size, vk::DeviceSize alignment) {
+	Allocation allocation = allocate(size, alignment);
+
+	if (allocation.pData != nullptr)
+		memcpy(allocation.pData, pData, size);
+
+	return allocation;
+}
+
+void FrameAllocator::reset(uint32_t frame) {
+	_peakSize = std::max(_peakSize, _head.load());
+
+	_frame = frame;
+	_head = 0;
+}
+
+void FrameAllocator::flush() {
+	vk::DeviceSize size = _head.load();
+
+	if (size > 0)
+		vmaFlushAllocation(_allocator, _buffers[_frame].allocation, 0, size);
+}
+
+vk::DescriptorBufferInfo FrameAllocator::getUniformInfo(uint32_t frame) const {
+	return vk::DescriptorBufferInfo(_buffers[frame].buffer, 0, _uniformRange);
+}
+
+vk::DescriptorBufferInfo FrameAllocator::getStorageInfo(uint32_t frame) const {
+	return vk::DescriptorBufferInfo(_buffers[frame].buffer, 0, FRAME_STORAGE_RANGE);
+}
+
+vk::DescriptorBufferInfo FrameAllocator::getBufferInfo(uint32_t frame) const {
+	return vk::DescriptorBufferInfo(_buffers[frame].buffer, 0, FRAME_ALLOCATOR_SIZE);
+}
+
+vk::DeviceSize FrameAllocator::getUsedSize() const {
+	return _head.load();
+}
+
+vk::DeviceSize FrameAllocator::getPeakSize() const {
+	return std::max(_peakSize, _head.load());
+}
+
+void FrameAllocator::initialize(
+		VmaAllocator allocator, vk::PhysicalDevice physicalDevice, uint32_t framesInFlight) {
+	if (_initialized)
+		return;
+
+	_allocator = allocator;
+
+	vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+
+	_alignment = std::max(
+			limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+	_uniformRange = std::min(
+			FRAME_UNIFORM_RANGE, static_cast<vk::DeviceSize>(limits.maxUniformBufferRange));
+
+	// any offset in frame can be bound with the widest range
+	vk::DeviceSize size = FRAME_ALLOCATOR_SIZE + std::max(FRAME_STORAGE_RANGE, _uniformRange);
+
+	vk::BufferUsageFlags usage =
+			vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+
+	for (uint32_t i = 0; i < framesInFlight; i++)
+		_buffers[i] = AllocatedBuffer::create(allocator, MemoryCategory::Other,
+				BufferClass::Dynamic, usage, size, &_allocInfos[i]);
+
+	_initialized = true;
+}
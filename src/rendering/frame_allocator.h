@@ -0,0 +1,79 @@
+#ifndef FRAME_ALLOCATOR_H
+#define FRAME_ALLOCATOR_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+#include "types/allocated.h"
+#include "types/frame.h"
+
+// transient data of one frame, allocations fail once it is used up
+const vk::DeviceSize FRAME_ALLOCATOR_SIZE = 8 * 1024 * 1024;
+// of dynamic storage bindings, larger allocations have to be bound with whole buffer
+const vk::DeviceSize FRAME_STORAGE_RANGE = 1024 * 1024;
+// of dynamic uniform bindings, lowered to maxUniformBufferRange of device
+const vk::DeviceSize FRAME_UNIFORM_RANGE = 64 * 1024;
+
+// Linear allocator of transient per frame data, instance data, joints and per draw parameters.
+// Each frame in flight has one large mapped buffer, all of it is free again once frame begins
+// and its previous submission has finished. Systems bind ranges through dynamic offset
+// descriptors written once against buffer of frame, so allocations need no descriptor writes
+// and no sets of their own. Buffer is padded past its size by the widest binding range, every
+// offset returned can be bound with full range. Safe to allocate from any thread.
+class FrameAllocator {
+public:
+	typedef struct {
+		// nullptr when frame is full
+		void *pData;
+		// dynamic offset, from start of buffer of frame
+		uint32_t offset;
+		vk::DeviceSize size;
+	} Allocation;
+
+private:
+	VmaAllocator _allocator;
+
+	AllocatedBuffer _buffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _allocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	std::atomic<vk::DeviceSize> _head{ 0 };
+	uint32_t _frame = 0;
+
+	// of dynamic offsets, both uniform and storage ones
+	vk::DeviceSize _alignment = 0;
+	vk::DeviceSize _uniformRange = 0;
+
+	// of any frame since initialization
+	vk::DeviceSize _peakSize = 0;
+
+	bool _initialized = false;
+
+public:
+	// alignment is raised to that of dynamic offsets, both are powers of two
+	Allocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 1);
+	// allocates and copies data into it
+	Allocation write(const void *pData, vk::DeviceSize size, vk::DeviceSize alignment = 1);
+
+	// frame has to be finished on device, its allocations are released
+	void reset(uint32_t frame);
+	// makes writes of frame visible to device, before it is submitted
+	void flush();
+
+	// for dynamic bindings, written once per frame
+	vk::DescriptorBufferInfo getUniformInfo(uint32_t frame) const;
+	vk::DescriptorBufferInfo getStorageInfo(uint32_t frame) const;
+	// for bindings indexed by offsets of allocations, not dynamic
+	vk::DescriptorBufferInfo getBufferInfo(uint32_t frame) const;
+
+	// of frame being recorded
+	vk::DeviceSize getUsedSize() const;
+	vk::DeviceSize getPeakSize() const;
+
+	void initialize(VmaAllocator allocator, vk::PhysicalDevice physicalDevice,
+			uint32_t framesInFlight);
+};
+
+#endif // !FRAME_ALLOCATOR_H
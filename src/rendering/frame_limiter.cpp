@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstdint>
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_timer.h>
+
+#include <profiler.h>
+
+#include "frame_limiter.h"
+
+void FrameLimiter::_waitUntil(uint64_t counter) {
+	double ticksPerMillisecond = static_cast<double>(SDL_GetPerformanceFrequency()) / 1000.0;
+	double margin = FRAME_LIMIT_SPIN_MARGIN_MILLISECONDS * ticksPerMillisecond;
+	double maxSpin = FRAME_LIMIT_MAX_SPIN_MILLISECONDS * ticksPerMillisecond;
+
+	for (;;) {
+		uint64_t now = SDL_GetPerformanceCounter();
+
+		if (now >= counter)
+			return;
+
+		double remaining = static_cast<double>(counter - now);
+		double spin = std::min(_oversleep + margin, maxSpin);
+
+		if (remaining <= spin)
+			break;
+
+		double request = remaining - spin;
+		SDL_DelayNS(static_cast<uint64_t>(request / ticksPerMillisecond * 1000000.0));
+
+		double slept = static_cast<double>(SDL_GetPerformanceCounter() - now);
+		double late = std::max(slept - request, 0.0);
+
+		// one late wake up is enough to miss deadline, estimate is pessimistic
+		_oversleep = late > _oversleep ? late : _oversleep * 0.95 + late * 0.05;
+	}
+
+	while (SDL_GetPerformanceCounter() < counter)
+		SDL_CPUPauseInstruction();
+}
+
+void FrameLimiter::setTargetRate(float rate) {
+	_rate = std::max(rate, 0.0f);
+	_period = _rate > 0.0f
+			? static_cast<uint64_t>(static_cast<double>(SDL_GetPerformanceFrequency()) / _rate)
+			: 0;
+	_deadline = 0;
+}
+
+float FrameLimiter::getTargetRate() const {
+	return _rate;
+}
+
+bool FrameLimiter::isEnabled() const {
+	return _period != 0;
+}
+
+void FrameLimiter::wait(float workMilliseconds) {
+	if (_period == 0)
+		return;
+
+	PROFILE_ZONE("frame limit");
+
+	double ticksPerMillisecond = static_cast<double>(SDL_GetPerformanceFrequency()) / 1000.0;
+	uint64_t work = static_cast<uint64_t>(
+			std::max(static_cast<double>(workMilliseconds), 0.0) * ticksPerMillisecond);
+	work = std::min(work, static_cast<uint64_t>(_period * FRAME_LIMIT_MAX_WORK));
+
+	uint64_t now = SDL_GetPerformanceCounter();
+	_deadline += _period;
+
+	// first frame and ones behind by a period start schedule from now, others keep it
+	if (_deadline + _period < now + work) {
+		_deadline = now + work;
+		return;
+	}
+
+	if (_deadline > now + work)
+		_waitUntil(_deadline - work);
+}
@@ -0,0 +1,44 @@
+#ifndef FRAME_LIMITER_H
+#define FRAME_LIMITER_H
+
+#include <cstdint>
+
+// input of frame is sampled no earlier than this fraction of period before its deadline, frames
+// taking longer are behind anyway
+const float FRAME_LIMIT_MAX_WORK = 0.75f;
+
+// remaining time is spun rather than slept once it is within oversleep estimate and margin,
+// never longer than maximum
+const float FRAME_LIMIT_SPIN_MARGIN_MILLISECONDS = 0.2f;
+const float FRAME_LIMIT_MAX_SPIN_MILLISECONDS = 2.0f;
+
+// Holds frames to a target rate without spinning through the idle part of each. Frames have
+// deadlines a period apart, a frame waits until its deadline less work expected of it, so input
+// is sampled as late as the deadline allows. Waits sleep while time remains and spin the last
+// part through, how long sleeps overshoot is measured on every one and spinning starts that
+// much earlier. Slightly late frames keep schedule, one behind by a whole period starts it anew
+// rather than hurrying after.
+class FrameLimiter {
+private:
+	// of performance counter, zero when off
+	uint64_t _period = 0;
+	uint64_t _deadline = 0;
+	float _rate = 0.0f;
+
+	// ticks sleeps returned late by, rises at once and falls off slowly
+	double _oversleep = 0.0;
+
+	void _waitUntil(uint64_t counter);
+
+public:
+	// frames per second, 0 turns limit off
+	void setTargetRate(float rate);
+	float getTargetRate() const;
+	bool isEnabled() const;
+
+	// returns once input of next frame is due, work is milliseconds its sampling takes to
+	// present
+	void wait(float workMilliseconds);
+};
+
+#endif // !FRAME_LIMITER_H
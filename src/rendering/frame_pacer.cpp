@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include <profiler.h>
+
+#include "frame_pacer.h"
+
+void FramePacer::_begin(uint64_t frameNumber) {
+	Frame &frame = _frames[frameNumber % FRAME_PACER_HISTORY];
+	frame = {};
+	frame.timing.frameNumber = frameNumber;
+	frame.timing.displayOffset = -1.0f;
+	frame.begin = SDL_GetPerformanceCounter();
+
+	_pFrame = &frame;
+}
+
+float FramePacer::_toMilliseconds(uint64_t begin, uint64_t end) const {
+	if (end <= begin)
+		return 0.0f;
+
+	double msPerTick = 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+	return static_cast<float>(static_cast<double>(end - begin) * msPerTick);
+}
+
+float FramePacer::_median() const {
+	if (_sampleCount == 0)
+		return 0.0f;
+
+	float samples[FRAME_PACING_WINDOW];
+	std::copy(_samples, _samples + _sampleCount, samples);
+
+	float *pMedian = samples + _sampleCount / 2;
+	std::nth_element(samples, pMedian, samples + _sampleCount);
+
+	return *pMedian;
+}
+
+void FramePacer::_report(const Hitch &hitch, const std::vector<GpuTiming> &gpuTimings) const {
+	const FrameTiming &timing = hitch.timing;
+
+	SDL_Log("hitch: frame %llu took %.2f ms (median %.2f ms), fence wait %.2f ms, acquire %.2f "
+			"ms, submit at %.2f ms, present at %.2f ms, shown at %.2f ms",
+			static_cast<unsigned long long>(timing.frameNumber), timing.milliseconds,
+			hitch.medianMilliseconds, timing.fenceWaitMilliseconds, timing.acquireMilliseconds,
+			timing.submitOffset, timing.presentOffset, timing.displayOffset);
+
+	for (const CpuZoneStats &zone : hitch.cpuZones)
+		SDL_Log("hitch cpu %s: %.3f ms in %u calls (%.3f ms average)", zone.name,
+				zone.milliseconds, zone.callCount, zone.averageMilliseconds);
+
+	// last sample of every scope is of hitch frame, scopes it did not record are stale
+	for (const GpuTiming &gpuTiming : gpuTimings)
+		SDL_Log("hitch gpu %s: %.3f ms (%.3f ms average)", gpuTiming.name.c_str(),
+				gpuTiming.milliseconds, gpuTiming.averageMilliseconds);
+}
+
+void FramePacer::frameBegin(uint64_t frameNumber) {
+	_begin(frameNumber);
+
+	// summary is of last iteration, that of hitch frame unless idle ones followed it
+	for (Hitch &hitch : _hitches) {
+		if (!hitch.hasCpuZones && hitch.timing.frameNumber < frameNumber) {
+			hitch.cpuZones = Profiler::getFrameSummary();
+			hitch.hasCpuZones = true;
+		}
+	}
+}
+
+void FramePacer::ensureBegun(uint64_t frameNumber) {
+	if (_pFrame == nullptr || _pFrame->timing.frameNumber != frameNumber)
+		_begin(frameNumber);
+}
+
+void FramePacer::fenceWaited(uint64_t begin, uint64_t end) {
+	if (_pFrame != nullptr)
+		_pFrame->timing.fenceWaitMilliseconds += _toMilliseconds(begin, end);
+}
+
+void FramePacer::acquired(uint64_t begin, uint64_t end) {
+	if (_pFrame != nullptr)
+		_pFrame->timing.acquireMilliseconds += _toMilliseconds(begin, end);
+}
+
+void FramePacer::submitted(uint64_t counter) {
+	if (_pFrame != nullptr)
+		_pFrame->timing.submitOffset = _toMilliseconds(_pFrame->begin, counter);
+}
+
+void FramePacer::presented(uint64_t counter) {
+	if (_pFrame == nullptr)
+		return;
+
+	Frame &frame = *_pFrame;
+	_pFrame = nullptr;
+
+	frame.timing.presentOffset = _toMilliseconds(frame.begin, counter);
+	frame.timing.milliseconds = frame.timing.presentOffset;
+	frame.isRecorded = true;
+
+	// against median of frames before, so a run of hitches does not hide the first ones
+	float median = _medianMilliseconds;
+	bool isHitch = _sampleCount >= FRAME_PACING_WINDOW / 2 &&
+			frame.timing.milliseconds > median * FRAME_HITCH_RATIO &&
+			frame.timing.milliseconds - median > FRAME_HITCH_MIN_MILLISECONDS;
+
+	_samples[_nextSample] = frame.timing.milliseconds;
+	_nextSample = (_nextSample + 1) % FRAME_PACING_WINDOW;
+	_sampleCount = std::min(_sampleCount + 1, FRAME_PACING_WINDOW);
+	_medianMilliseconds = _median();
+
+	_last = frame.timing;
+
+	if (!isHitch)
+		return;
+
+	_hitchCount++;
+
+	// hitches in a row are one stall, the first ones tell most about it
+	if (_isReporting && _hitches.size() < FRAME_PACER_HISTORY)
+		_hitches.push_back({ frame.timing, median, {}, false });
+}
+
+void FramePacer::displayed(uint64_t frameNumber, uint64_t counter) {
+	Frame &frame = _frames[frameNumber % FRAME_PACER_HISTORY];
+
+	if (!frame.isRecorded || frame.timing.frameNumber != frameNumber)
+		return;
+
+	frame.timing.displayOffset = _toMilliseconds(frame.begin, counter);
+
+	if (_last.frameNumber == frameNumber)
+		_last.displayOffset = frame.timing.displayOffset;
+
+	for (Hitch &hitch : _hitches) {
+		if (hitch.timing.frameNumber == frameNumber)
+			hitch.timing.displayOffset = frame.timing.displayOffset;
+	}
+}
+
+void FramePacer::collect(uint64_t frameNumber, uint32_t framesInFlight,
+		const std::vector<GpuTiming> &gpuTimings) {
+	while (isCollectDue(frameNumber, framesInFlight)) {
+		_report(_hitches.front(), gpuTimings);
+		_hitches.erase(_hitches.begin());
+	}
+}
+
+bool FramePacer::isCollectDue(uint64_t frameNumber, uint32_t framesInFlight) const {
+	return !_hitches.empty() && _hitches.front().timing.frameNumber + framesInFlight <= frameNumber;
+}
+
+void FramePacer::setReporting(bool isReporting) {
+	_isReporting = isReporting;
+
+	if (!_isReporting)
+		_hitches.clear();
+}
+
+FramePacingStats FramePacer::getStats() const {
+	FramePacingStats stats = {};
+	stats.last = _last;
+	stats.medianMilliseconds = _medianMilliseconds;
+	stats.hitchCount = _hitchCount;
+
+	return stats;
+}
+
+bool FramePacer::getTiming(uint64_t frameNumber, FrameTiming &timing) const {
+	const Frame &frame = _frames[frameNumber % FRAME_PACER_HISTORY];
+
+	if (!frame.isRecorded || frame.timing.frameNumber != frameNumber)
+		return false;
+
+	timing = frame.timing;
+	return true;
+}
@@ -0,0 +1,108 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <profiler.h>
+
+#include "gpu_profiler.h"
+
+// frames median of frame times is taken over
+const uint32_t FRAME_PACING_WINDOW = 64;
+
+// frame taking this many times median is a hitch, when it also exceeds median by minimum
+const float FRAME_HITCH_RATIO = 2.0f;
+const float FRAME_HITCH_MIN_MILLISECONDS = 4.0f;
+
+// frames recorded but not yet shown, displays of older ones are dropped
+const uint32_t FRAME_PACER_HISTORY = 8;
+
+// milliseconds, offsets are from begin of frame on CPU
+struct FrameTiming {
+	uint64_t frameNumber;
+	// begin of frame to return of present
+	float milliseconds;
+	float fenceWaitMilliseconds;
+	float acquireMilliseconds;
+	float submitOffset;
+	float presentOffset;
+	// negative without present wait or until frame is shown
+	float displayOffset;
+};
+
+struct FramePacingStats {
+	FrameTiming last;
+	float medianMilliseconds;
+	uint64_t hitchCount;
+};
+
+// Records when each frame begins, waits for its fence, acquires, submits, presents and, with
+// present wait, is shown. Frames taking far longer than rolling median are hitches, their
+// timings are kept with CPU zones of frame and GPU scopes once those are collected, which is as
+// many frames later as there are frames in flight, and logged then when reporting is enabled.
+class FramePacer {
+private:
+	typedef struct {
+		FrameTiming timing;
+		uint64_t begin;
+		bool isRecorded;
+	} Frame;
+
+	typedef struct {
+		FrameTiming timing;
+		float medianMilliseconds;
+		std::vector<CpuZoneStats> cpuZones;
+		bool hasCpuZones;
+	} Hitch;
+
+	Frame _frames[FRAME_PACER_HISTORY] = {};
+	// of frame being recorded
+	Frame *_pFrame = nullptr;
+
+	float _samples[FRAME_PACING_WINDOW] = {};
+	uint32_t _nextSample = 0;
+	uint32_t _sampleCount = 0;
+	float _medianMilliseconds = 0.0f;
+
+	// oldest first, waiting for zones of their frames
+	std::vector<Hitch> _hitches;
+	uint64_t _hitchCount = 0;
+
+	FrameTiming _last = {};
+	bool _isReporting = false;
+
+	void _begin(uint64_t frameNumber);
+
+	float _toMilliseconds(uint64_t begin, uint64_t end) const;
+	float _median() const;
+	void _report(const Hitch &hitch, const std::vector<GpuTiming> &gpuTimings) const;
+
+public:
+	// begin is taken again by every call until frame is presented, idle waits are left out,
+	// CPU zones of hitches are taken here, on thread and at time Profiler summary is stable
+	void frameBegin(uint64_t frameNumber);
+	// begins frame unless frameBegin did already
+	void ensureBegun(uint64_t frameNumber);
+	// counters of performance counter, within drawBegin
+	void fenceWaited(uint64_t begin, uint64_t end);
+	void acquired(uint64_t begin, uint64_t end);
+	void submitted(uint64_t counter);
+	// ends frame, hitch is kept until its zones are reported
+	void presented(uint64_t counter);
+	// through present wait, frames no longer in history are skipped
+	void displayed(uint64_t frameNumber, uint64_t counter);
+
+	// at drawBegin once GPU scopes of frame framesInFlight back are collected
+	void collect(uint64_t frameNumber, uint32_t framesInFlight,
+			const std::vector<GpuTiming> &gpuTimings);
+	// collect reads GPU timings only then
+	bool isCollectDue(uint64_t frameNumber, uint32_t framesInFlight) const;
+
+	void setReporting(bool isReporting);
+	FramePacingStats getStats() const;
+	// frames presented and still in history only
+	bool getTiming(uint64_t frameNumber, FrameTiming &timing) const;
+};
+
+#endif // !FRAME_PACER_H
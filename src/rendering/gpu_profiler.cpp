@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <SDL3/SDL_timer.h>
+
+#include <profiler.h>
+
+#include "gpu_profiler.h"
+
+uint32_t GpuProfiler::_getTiming(const char *name) {
+	for (uint32_t i = 0; i < _timings.size(); i++)
+		if (strcmp(_timings[i].name.c_str(), name) == 0)
+			return i;
+
+	Timing timing = {};
+	timing.name = name;
+
+	_timings.push_back(timing);
+
+	return static_cast<uint32_t>(_timings.size() - 1);
+}
+
+uint64_t GpuProfiler::_toCounter(uint64_t timestamp) const {
+	// difference within valid bits, sign extended
+	uint64_t ticks = (timestamp - _calibrationTimestamp) & _timestampMask;
+	int64_t signedTicks = static_cast<int64_t>(ticks);
+
+	if (ticks > (_timestampMask >> 1))
+		signedTicks -= static_cast<int64_t>(_timestampMask) + 1;
+
+	double seconds = static_cast<double>(signedTicks) * _timestampPeriod / 1000000000.0;
+	double counterTicks = seconds * static_cast<double>(SDL_GetPerformanceFrequency());
+
+	return _calibrationCounter + static_cast<int64_t>(counterTicks);
+}
+
+void GpuProfiler::collect(uint32_t pool) {
+	std::vector<Scope> &scopes = _scopes[pool];
+
+	if (scopes.empty())
+		return;
+
+	// value and availability of every query, scopes not recorded are skipped
+	uint32_t queryCount = static_cast<uint32_t>(scopes.size()) * 2;
+	std::vector<uint64_t> results(queryCount * 2);
+
+	vk::Result result = _device.getQueryPoolResults(_queryPools[pool], 0, queryCount,
+			results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+			vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+
+	if (result != vk::Result::eSuccess && result != vk::Result::eNotReady) {
+		scopes.clear();
+		return;
+	}
+
+	bool isTraced = Profiler::isTracing();
+
+	if (isTraced && !_isCalibrationExact) {
+		// work of pool can not begin before it was submitted
+		for (uint32_t i = 0; i < scopes.size(); i++) {
+			const uint64_t *pBegin = &results[i * 4];
+
+			if (pBegin[1] == 0)
+				continue;
+
+			if (!_isCalibrated || _toCounter(pBegin[0]) < _submitCounters[pool]) {
+				_calibrationTimestamp = pBegin[0];
+				_calibrationCounter = _submitCounters[pool];
+				_isCalibrated = true;
+			}
+
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < scopes.size(); i++) {
+		const uint64_t *pBegin = &results[i * 4];
+		const uint64_t *pEnd = &results[i * 4 + 2];
+
+		if (pBegin[1] == 0 || pEnd[1] == 0)
+			continue;
+
+		if (isTraced && _isCalibrated)
+			Profiler::traceGpuZone(_lane, _timings[scopes[i].timing].name.c_str(),
+					_toCounter(pBegin[0]), _toCounter(pEnd[0]));
+
+		// counter may wrap within its valid bits
+		uint64_t ticks = (pEnd[0] - pBegin[0]) & _timestampMask;
+		float milliseconds = static_cast<float>(ticks) * _timestampPeriod / 1000000.0f;
+
+		Timing &timing = _timings[scopes[i].timing];
+
+		if (timing.sampleCount == GPU_TIMING_WINDOW)
+			timing.sum -= timing.samples[timing.nextSample];
+		else
+			timing.sampleCount++;
+
+		timing.samples[timing.nextSample] = milliseconds;
+		timing.totalSampleCount++;
+		timing.sum += milliseconds;
+		timing.nextSample = (timing.nextSample + 1) % GPU_TIMING_WINDOW;
+	}
+
+	scopes.clear();
+}
+
+void GpuProfiler::begin(vk::CommandBuffer commandBuffer, uint32_t pool) {
+	if (!isSupported())
+		return;
+
+	collect(pool);
+	_pool = pool;
+
+	commandBuffer.resetQueryPool(_queryPools[pool], 0, MAX_GPU_PROFILER_SCOPES * 2);
+}
+
+uint32_t GpuProfiler::scopeCreate(const char *name) {
+	if (!isSupported() || _scopes[_pool].size() == MAX_GPU_PROFILER_SCOPES)
+		return GPU_PROFILER_NO_SCOPE;
+
+	_scopes[_pool].push_back({ _getTiming(name) });
+
+	return static_cast<uint32_t>(_scopes[_pool].size() - 1);
+}
+
+void GpuProfiler::scopeBegin(vk::CommandBuffer commandBuffer, uint32_t scope) {
+	if (scope == GPU_PROFILER_NO_SCOPE)
+		return;
+
+	// written once earlier commands finish, so overlapping work counts to scope after it
+	commandBuffer.writeTimestamp(
+			vk::PipelineStageFlagBits::eBottomOfPipe, _queryPools[_pool], scope * 2);
+}
+
+void GpuProfiler::scopeEnd(vk::CommandBuffer commandBuffer, uint32_t scope) {
+	if (scope == GPU_PROFILER_NO_SCOPE)
+		return;
+
+	commandBuffer.writeTimestamp(
+			vk::PipelineStageFlagBits::eBottomOfPipe, _queryPools[_pool], scope * 2 + 1);
+}
+
+void GpuProfiler::calibrate(uint64_t timestamp, uint64_t counter) {
+	_calibrationTimestamp = timestamp;
+	_calibrationCounter = counter;
+	_isCalibrated = true;
+	_isCalibrationExact = true;
+}
+
+void GpuProfiler::submitted(uint32_t pool) {
+	_submitCounters[pool] = SDL_GetPerformanceCounter();
+}
+
+std::vector<GpuTiming> GpuProfiler::getTimings() const {
+	std::vector<GpuTiming> timings;
+
+	for (const Timing &timing : _timings) {
+		if (timing.sampleCount == 0)
+			continue;
+
+		uint32_t last = (timing.nextSample + GPU_TIMING_WINDOW - 1) % GPU_TIMING_WINDOW;
+
+		GpuTiming gpuTiming;
+		gpuTiming.name = timing.name;
+		gpuTiming.milliseconds = timing.samples[last];
+		gpuTiming.averageMilliseconds = static_cast<float>(timing.sum / timing.sampleCount);
+		gpuTiming.sampleCount = timing.sampleCount;
+
+		timings.push_back(gpuTiming);
+	}
+
+	return timings;
+}
+
+bool GpuProfiler::getLastSample(
+		const char *name, float &milliseconds, uint64_t &sampleCount) const {
+	for (const Timing &timing : _timings) {
+		if (timing.sampleCount == 0 || strcmp(timing.name.c_str(), name) != 0)
+			continue;
+
+		uint32_t last = (timing.nextSample + GPU_TIMING_WINDOW - 1) % GPU_TIMING_WINDOW;
+
+		milliseconds = timing.samples[last];
+		sampleCount = timing.totalSampleCount;
+		return true;
+	}
+
+	return false;
+}
+
+bool GpuProfiler::isSupported() const {
+	return _initialized && _timestampMask != 0;
+}
+
+void GpuProfiler::initialize(vk::Device device, vk::PhysicalDevice physicalDevice,
+		uint32_t queueFamily, uint32_t poolCount, const char *lane) {
+	_device = device;
+	_lane = lane;
+	_poolCount = std::clamp(poolCount, 1u, MAX_FRAMES_IN_FLIGHT);
+
+	std::vector<vk::QueueFamilyProperties> families = physicalDevice.getQueueFamilyProperties();
+	uint32_t validBits = families[queueFamily].timestampValidBits;
+
+	_timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+	_timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+
+	_initialized = true;
+
+	if (validBits == 0)
+		return;
+
+	vk::QueryPoolCreateInfo createInfo;
+	createInfo.setQueryType(vk::QueryType::eTimestamp);
+	createInfo.setQueryCount(MAX_GPU_PROFILER_SCOPES * 2);
+
+	for (uint32_t i = 0; i < _poolCount; i++)
+		_queryPools[i] = _device.createQueryPool(createInfo);
+}
+
+void GpuProfiler::destroy() {
+	if (!_initialized)
+		return;
+
+	for (uint32_t i = 0; i < _poolCount; i++) {
+		if (_queryPools[i])
+			_device.destroyQueryPool(_queryPools[i]);
+
+		_queryPools[i] = nullptr;
+		_scopes[i].clear();
+	}
+
+	_initialized = false;
+}
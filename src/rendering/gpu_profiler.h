@@ -0,0 +1,109 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "types/frame.h"
+
+// begin and end timestamp of every scope, per pool
+const uint32_t MAX_GPU_PROFILER_SCOPES = 32;
+
+// samples rolling average of every scope is taken over
+const uint32_t GPU_TIMING_WINDOW = 64;
+
+// returned when profiling is not supported or pool is full, begin and end ignore it
+const uint32_t GPU_PROFILER_NO_SCOPE = UINT32_MAX;
+
+struct GpuTiming {
+	std::string name;
+	// of last collected sample and of window before it
+	float milliseconds;
+	float averageMilliseconds;
+	uint32_t sampleCount;
+};
+
+// Measures named scopes of command buffers with timestamp queries. Every pool is reused once
+// commands written to it are finished, so results are read without waiting, as many submits
+// later as there are pools. Scopes are created on one thread, begin and end may be recorded in
+// secondary buffers of workers. While CPU profiler traces, collected scopes are converted to
+// performance counter and traced on lane of the profiler.
+class GpuProfiler {
+private:
+	typedef struct {
+		// of timings
+		uint32_t timing;
+	} Scope;
+
+	typedef struct {
+		std::string name;
+		float samples[GPU_TIMING_WINDOW];
+		uint32_t nextSample;
+		uint32_t sampleCount;
+		// since timing was first seen, not capped by window
+		uint64_t totalSampleCount;
+		double sum;
+	} Timing;
+
+	vk::Device _device;
+
+	vk::QueryPool _queryPools[MAX_FRAMES_IN_FLIGHT];
+	// scopes of commands written to pool since it was reset
+	std::vector<Scope> _scopes[MAX_FRAMES_IN_FLIGHT];
+	uint32_t _poolCount = 0;
+	uint32_t _pool = 0;
+
+	// nanoseconds per tick and bits written by queue family, no bits means no support
+	float _timestampPeriod = 1.0f;
+	uint64_t _timestampMask = 0;
+
+	std::vector<Timing> _timings;
+
+	// trace lane, queue the pools are submitted to
+	const char *_lane = "";
+	// performance counter at submit of every pool
+	uint64_t _submitCounters[MAX_FRAMES_IN_FLIGHT] = {};
+
+	// timestamp known to match counter, bound from submits only ever moves later
+	uint64_t _calibrationTimestamp = 0;
+	uint64_t _calibrationCounter = 0;
+	bool _isCalibrated = false;
+	bool _isCalibrationExact = false;
+
+	bool _initialized = false;
+
+	uint32_t _getTiming(const char *name);
+	uint64_t _toCounter(uint64_t timestamp) const;
+
+public:
+	// commands written to pool have to be finished, scopes of pool are added to timings
+	void collect(uint32_t pool);
+	// collects and resets pool outside of render pass, scopes are created in it until next one
+	void begin(vk::CommandBuffer commandBuffer, uint32_t pool);
+
+	// name has to outlive recording of pool, literals are expected
+	uint32_t scopeCreate(const char *name);
+	void scopeBegin(vk::CommandBuffer commandBuffer, uint32_t scope);
+	void scopeEnd(vk::CommandBuffer commandBuffer, uint32_t scope);
+
+	// pair read at once through calibrated timestamps, replaces estimate from submits
+	void calibrate(uint64_t timestamp, uint64_t counter);
+	// right after pool is submitted, without calibration work is assumed to start no earlier
+	void submitted(uint32_t pool);
+
+	// in order scopes were first seen
+	std::vector<GpuTiming> getTimings() const;
+	// last sample of named scope, count tells callers polling every frame whether it is new
+	bool getLastSample(const char *name, float &milliseconds, uint64_t &sampleCount) const;
+	bool isSupported() const;
+
+	// pool per submit in flight, up to MAX_FRAMES_IN_FLIGHT
+	void initialize(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamily,
+			uint32_t poolCount, const char *lane);
+	void destroy();
+};
+
+#endif // !GPU_PROFILER_H
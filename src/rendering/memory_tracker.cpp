@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include <vma/vk_mem_alloc.h>
+
+#include "memory_tracker.h"
+
+typedef struct {
+	MemoryCategory category;
+	uint64_t size;
+} TrackedAllocation;
+
+const size_t CATEGORY_COUNT = static_cast<size_t>(MemoryCategory::Count);
+
+static std::mutex _mutex;
+static std::unordered_map<VmaAllocation, TrackedAllocation> _allocations;
+static MemoryCategoryStats _stats[CATEGORY_COUNT];
+static MemoryCategoryStats _total;
+
+void MemoryTracker::track(
+		VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category) {
+	if (allocation == VK_NULL_HANDLE)
+		return;
+
+	VmaAllocationInfo allocInfo;
+	vmaGetAllocationInfo(allocator, allocation, &allocInfo);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_allocations[allocation] = { category, allocInfo.size };
+
+	MemoryCategoryStats &stats = _stats[static_cast<size_t>(category)];
+	stats.bytes += allocInfo.size;
+	stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+	stats.allocationCount++;
+
+	_total.bytes += allocInfo.size;
+	_total.peakBytes = std::max(_total.peakBytes, _total.bytes);
+	_total.allocationCount++;
+}
+
+void MemoryTracker::untrack(VmaAllocation allocation) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto it = _allocations.find(allocation);
+
+	if (it == _allocations.end())
+		return;
+
+	MemoryCategoryStats &stats = _stats[static_cast<size_t>(it->second.category)];
+	stats.bytes -= it->second.size;
+	stats.allocationCount--;
+
+	_total.bytes -= it->second.size;
+	_total.allocationCount--;
+
+	_allocations.erase(it);
+}
+
+MemoryCategoryStats MemoryTracker::getStats(MemoryCategory category) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats[static_cast<size_t>(category)];
+}
+
+MemoryCategoryStats MemoryTracker::getTotalStats() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _total;
+}
+
+const char *MemoryTracker::getName(MemoryCategory category) {
+	switch (category) {
+		case MemoryCategory::Mesh:
+			return "mesh";
+		case MemoryCategory::Texture:
+			return "texture";
+		case MemoryCategory::Environment:
+			return "environment";
+		case MemoryCategory::Light:
+			return "light";
+		case MemoryCategory::RenderTarget:
+			return "render target";
+		case MemoryCategory::Staging:
+			return "staging";
+		case MemoryCategory::Other:
+			return "other";
+		default:
+			return "unknown";
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <cstdint>
+
+#include <vma/vk_mem_alloc.h>
+
+// what an allocation is for, every buffer and image made by the renderer is given one
+enum class MemoryCategory {
+	Mesh,
+	Texture,
+	// image based lighting, cubemaps and lookup tables
+	Environment,
+	// lights, clusters and shadow casters
+	Light,
+	RenderTarget,
+	// host visible copies on their way to or from device
+	Staging,
+	// uniforms, instances, materials and culling
+	Other,
+	Count,
+};
+
+struct MemoryCategoryStats {
+	// size allocator reserved for them, alignment included
+	uint64_t bytes = 0;
+	uint64_t peakBytes = 0;
+	uint32_t allocationCount = 0;
+};
+
+// Sums allocations by category, live and peak. Allocations are tracked by handle so moves of
+// defragmentation need no update, every tracked allocation has to be untracked before it is
+// freed. Safe to call from any thread.
+class MemoryTracker {
+public:
+	// null allocation of failed create is ignored
+	static void track(VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category);
+	static void untrack(VmaAllocation allocation);
+
+	static MemoryCategoryStats getStats(MemoryCategory category);
+	// of every category together
+	static MemoryCategoryStats getTotalStats();
+	static const char *getName(MemoryCategory category);
+};
+
+#endif // !MEMORY_TRACKER_H
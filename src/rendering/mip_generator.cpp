@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <rendering/memory_tracker.h>
+#include <rendering/rendering_device.h>
+
+#include <rendering/shaders/downsample.gen.h>
+
+#include "mip_generator.h"
+
+const uint32_t GROUP_TILE_SIZE = 64;
+
+bool MipGenerator::isSupported(vk::Format format, uint32_t width, uint32_t height) const {
+	if (!_isWriteWithoutFormatSupported)
+		return false;
+
+	if (std::max(width, height) > MAX_GENERATED_SIZE)
+		return false;
+
+	vk::FormatProperties properties = _physicalDevice.getFormatProperties(format);
+	return (bool)(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage);
+}
+
+MipGenerator::Target MipGenerator::targetCreate(vk::Image image, vk::Format format,
+		uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers) {
+	Target target = {};
+	target.image = image;
+	target.width = width;
+	target.height = height;
+	target.levelCount = std::min(mipLevels - 1, MAX_GENERATED_LEVELS);
+	target.arrayLayers = arrayLayers;
+
+	for (uint32_t i = 0; i <= target.levelCount; i++) {
+		vk::ImageSubresourceRange subresourceRange;
+		subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		subresourceRange.setBaseMipLevel(i);
+		subresourceRange.setLevelCount(1);
+		subresourceRange.setBaseArrayLayer(0);
+		subresourceRange.setLayerCount(arrayLayers);
+
+		vk::ImageViewCreateInfo createInfo;
+		createInfo.setImage(image);
+		createInfo.setViewType(vk::ImageViewType::e2DArray);
+		createInfo.setFormat(format);
+		createInfo.setSubresourceRange(subresourceRange);
+
+		vk::ImageView view = _device.createImageView(createInfo);
+
+		if (i == 0)
+			target.srcView = view;
+		else
+			target.levelViews[i - 1] = view;
+	}
+
+	uint32_t groupCountX = (width + GROUP_TILE_SIZE - 1) / GROUP_TILE_SIZE;
+	uint32_t groupCountY = (height + GROUP_TILE_SIZE - 1) / GROUP_TILE_SIZE;
+
+	vk::DeviceSize groupsSize = sizeof(float) * 4 * groupCountX * groupCountY * arrayLayers;
+
+	target.countersSize = sizeof(uint32_t) * arrayLayers;
+	target.groupsOffset =
+			(target.countersSize + _offsetAlignment - 1) / _offsetAlignment * _offsetAlignment;
+
+	target.buffer = AllocatedBuffer::create(_allocator, MemoryCategory::Other,
+			BufferClass::Static,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			target.groupsOffset + groupsSize);
+
+	DescriptorAllocator::Allocation allocation;
+
+	{
+		std::lock_guard<std::mutex> lock(_descriptorMutex);
+		allocation = _descriptorAllocator.allocate(_setLayout);
+	}
+
+	target.set = allocation.set;
+	target.pool = allocation.pool;
+
+	vk::DescriptorImageInfo srcInfo;
+	srcInfo.setSampler(_sampler);
+	srcInfo.setImageView(target.srcView);
+	srcInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+	// levels past last one are never written, slots repeat it to stay valid
+	std::array<vk::DescriptorImageInfo, MAX_GENERATED_LEVELS> levelInfos;
+
+	for (uint32_t i = 0; i < MAX_GENERATED_LEVELS; i++) {
+		levelInfos[i].setImageView(target.levelViews[std::min(i, target.levelCount - 1)]);
+		levelInfos[i].setImageLayout(vk::ImageLayout::eGeneral);
+	}
+
+	vk::DescriptorBufferInfo countersInfo(target.buffer.buffer, 0, target.countersSize);
+	vk::DescriptorBufferInfo groupsInfo(target.buffer.buffer, target.groupsOffset, groupsSize);
+
+	std::array<vk::WriteDescriptorSet, 4> writeInfos = {};
+	writeInfos[0].setDstSet(target.set);
+	writeInfos[0].setDstBinding(0);
+	writeInfos[0].setDstArrayElement(0);
+	writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfos[0].setDescriptorCount(1);
+	writeInfos[0].setImageInfo(srcInfo);
+
+	writeInfos[1].setDstSet(target.set);
+	writeInfos[1].setDstBinding(1);
+	writeInfos[1].setDstArrayElement(0);
+	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+	writeInfos[1].setImageInfo(levelInfos);
+
+	writeInfos[2].setDstSet(target.set);
+	writeInfos[2].setDstBinding(2);
+	writeInfos[2].setDstArrayElement(0);
+	writeInfos[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[2].setDescriptorCount(1);
+	writeInfos[2].setBufferInfo(countersInfo);
+
+	writeInfos[3].setDstSet(target.set);
+	writeInfos[3].setDstBinding(3);
+	writeInfos[3].setDstArrayElement(0);
+	writeInfos[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[3].setDescriptorCount(1);
+	writeInfos[3].setBufferInfo(groupsInfo);
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
+
+	return target;
+}
+
+void MipGenerator::targetDestroy(const Target &target) {
+	{
+		std::lock_guard<std::mutex> lock(_descriptorMutex);
+		_descriptorAllocator.free({ target.set, target.pool });
+	}
+
+	for (uint32_t i = 0; i < target.levelCount; i++)
+		_device.destroyImageView(target.levelViews[i]);
+
+	_device.destroyImageView(target.srcView);
+
+	MemoryTracker::untrack(target.buffer.allocation);
+	vmaDestroyBuffer(_allocator, target.buffer.buffer, target.buffer.allocation);
+}
+
+void MipGenerator::record(
+		vk::CommandBuffer commandBuffer, const std::vector<Target> &targets, Reduction reduction) {
+	if (targets.empty())
+		return;
+
+	for (const Target &target : targets)
+		commandBuffer.fillBuffer(target.buffer.buffer, 0, target.countersSize, 0);
+
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+
+	// images do not depend on each other, dispatches may overlap
+	for (const Target &target : targets) {
+		uint32_t groupCountX = (target.width + GROUP_TILE_SIZE - 1) / GROUP_TILE_SIZE;
+		uint32_t groupCountY = (target.height + GROUP_TILE_SIZE - 1) / GROUP_TILE_SIZE;
+
+		DownsampleConstants constants = {};
+		constants.srcSize[0] = target.width;
+		constants.srcSize[1] = target.height;
+		constants.groupCount[0] = groupCountX;
+		constants.groupCount[1] = groupCountY;
+		constants.levelCount = target.levelCount;
+		constants.reduction = static_cast<uint32_t>(reduction);
+
+		commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, target.set, nullptr);
+		commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+				sizeof(DownsampleConstants), &constants);
+
+		commandBuffer.dispatch(groupCountX, groupCountY, target.arrayLayers);
+	}
+}
+
+void MipGenerator::record(
+		vk::CommandBuffer commandBuffer, const Target &target, Reduction reduction) {
+	record(commandBuffer, std::vector<Target>{ target }, reduction);
+}
+
+void MipGenerator::initialize(
+		vk::Device device, vk::PhysicalDevice physicalDevice, VmaAllocator allocator) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_physicalDevice = physicalDevice;
+	_allocator = allocator;
+
+	// levels are written through one image array whatever their format is
+	vk::PhysicalDeviceFeatures features = physicalDevice.getFeatures();
+	_isWriteWithoutFormatSupported = features.shaderStorageImageWriteWithoutFormat;
+	_offsetAlignment = physicalDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+
+	std::array<vk::DescriptorSetLayoutBinding, 4> bindings = {};
+	bindings[0].setBinding(0);
+	bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	bindings[0].setDescriptorCount(1);
+	bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	bindings[1].setBinding(1);
+	bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+	bindings[1].setDescriptorCount(MAX_GENERATED_LEVELS);
+	bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	bindings[2].setBinding(2);
+	bindings[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	bindings[2].setDescriptorCount(1);
+	bindings[2].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	bindings[3].setBinding(3);
+	bindings[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	bindings[3].setDescriptorCount(1);
+	bindings[3].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Mip generator descriptor set layout creation failed!");
+
+	// targets of uploads are freed once their batch is finished
+	std::vector<vk::DescriptorPoolSize> setSizes = {
+		{ vk::DescriptorType::eCombinedImageSampler, 1 },
+		{ vk::DescriptorType::eStorageImage, MAX_GENERATED_LEVELS },
+		{ vk::DescriptorType::eStorageBuffer, 2 },
+	};
+
+	_descriptorAllocator.initialize(device, setSizes, MIP_GENERATOR_POOL_SET_COUNT, true);
+
+	// texels are fetched and reduced manually, sampler only has to be nearest
+	vk::SamplerCreateInfo samplerInfo;
+	samplerInfo.setMagFilter(vk::Filter::eNearest);
+	samplerInfo.setMinFilter(vk::Filter::eNearest);
+	samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+	samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setMinLod(0.0f);
+	samplerInfo.setMaxLod(0.0f);
+
+	_sampler = device.createSampler(samplerInfo);
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(DownsampleConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	DownsampleShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Downsample compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
@@ -0,0 +1,103 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "types/allocated.h"
+
+#include "descriptor_allocator.h"
+
+// levels after first one a single dispatch writes
+const uint32_t MAX_GENERATED_LEVELS = 12;
+
+// one group per 64x64 texels, level 6 of every group has to fit in last group
+const uint32_t MAX_GENERATED_SIZE = 4096;
+
+// sets per descriptor pool of targets
+const uint32_t MIP_GENERATOR_POOL_SET_COUNT = 64;
+
+// Generates whole mip chain of image in one compute dispatch, after AMD FidelityFX SPD. Groups
+// reduce their part of first level down to a single texel in shared memory and the last group
+// of each layer to finish reduces those to the smallest level. Every layer of array or cubemap
+// is generated by the same dispatch, many images are recorded with one pipeline bind.
+class MipGenerator {
+public:
+	enum class Reduction {
+		Average,
+		// hierarchical depth, with reverse Z the furthest depth
+		Min,
+	};
+
+	// descriptors and scratch memory of one image, kept while image is generated again
+	typedef struct {
+		vk::Image image;
+		uint32_t width;
+		uint32_t height;
+		// written levels, those after the first one
+		uint32_t levelCount;
+		uint32_t arrayLayers;
+
+		vk::ImageView srcView;
+		vk::ImageView levelViews[MAX_GENERATED_LEVELS];
+
+		// finished group count per layer, followed by last level each group reduced to
+		AllocatedBuffer buffer;
+		vk::DeviceSize countersSize;
+		vk::DeviceSize groupsOffset;
+
+		vk::DescriptorSet set;
+		vk::DescriptorPool pool;
+	} Target;
+
+private:
+	struct DownsampleConstants {
+		uint32_t srcSize[2];
+		uint32_t groupCount[2];
+		uint32_t levelCount;
+		uint32_t reduction;
+	};
+
+	vk::Device _device;
+	vk::PhysicalDevice _physicalDevice;
+	VmaAllocator _allocator;
+
+	vk::DescriptorSetLayout _setLayout;
+	DescriptorAllocator _descriptorAllocator;
+	// targets are created and destroyed by uploads of any thread
+	std::mutex _descriptorMutex;
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	vk::Sampler _sampler;
+
+	vk::DeviceSize _offsetAlignment = 1;
+	bool _isWriteWithoutFormatSupported = false;
+
+	bool _initialized = false;
+
+public:
+	// format has to be usable as storage image, image has to be created with storage usage
+	bool isSupported(vk::Format format, uint32_t width, uint32_t height) const;
+
+	Target targetCreate(vk::Image image, vk::Format format, uint32_t width, uint32_t height,
+			uint32_t mipLevels, uint32_t arrayLayers = 1);
+	// generation recorded with target has to be finished
+	void targetDestroy(const Target &target);
+
+	// images have to be in general layout with first level written, counters are cleared by
+	// transfer so earlier generation of same target has to be finished before transfer stage,
+	// writes have to be made visible by caller
+	void record(vk::CommandBuffer commandBuffer, const std::vector<Target> &targets,
+			Reduction reduction = Reduction::Average);
+	void record(vk::CommandBuffer commandBuffer, const Target &target,
+			Reduction reduction = Reduction::Average);
+
+	void initialize(vk::Device device, vk::PhysicalDevice physicalDevice, VmaAllocator allocator);
+};
+
+#endif // !MIP_GENERATOR_H
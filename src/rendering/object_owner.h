@@ -1,57 +1,166 @@
 #ifndef OBJECT_OWNER_H
 #define OBJECT_OWNER_H
 
+#include <atomic>
 #include <cstdint>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
+// generation in high 32 bits, slot in low 32 bits, 0 is never valid
 typedef uint64_t ObjectID;
 
+// Slot map, values are stored densely and removal moves last value into the hole. References
+// and iterators are invalidated by insert and free. Only reserve may be called from other threads,
+// everything else belongs to one owner thread.
 template <typename T> class ObjectOwner {
 private:
-	std::unordered_map<ObjectID, T> _map;
-	uint64_t _last = 0;
+	struct Slot {
+		uint32_t dense;
+		uint32_t generation;
+	};
+
+	std::vector<T> _dense;
+	std::vector<uint32_t> _denseToSlot;
+
+	std::vector<Slot> _slots;
+	std::vector<uint32_t> _freeSlots;
+
+	// slots handed out so far, _slots catches up on owner thread
+	std::atomic<uint32_t> _slotCount{ 0 };
+
+	static uint32_t _getSlot(ObjectID object) {
+		return static_cast<uint32_t>(object & 0xFFFFFFFF);
+	}
+
+	static uint32_t _getGeneration(ObjectID object) {
+		return static_cast<uint32_t>(object >> 32);
+	}
 
 public:
+	typedef typename std::vector<T>::iterator Iterator;
+	typedef typename std::vector<T>::const_iterator ConstIterator;
+
+	// object has to be valid
 	T &operator[](ObjectID object) {
-		return _map[object];
+		return _dense[_slots[_getSlot(object)].dense];
+	}
+
+	const T &operator[](ObjectID object) const {
+		return _dense[_slots[_getSlot(object)].dense];
+	}
+
+	Iterator begin() {
+		return _dense.begin();
+	}
+
+	Iterator end() {
+		return _dense.end();
+	}
+
+	ConstIterator begin() const {
+		return _dense.begin();
+	}
+
+	ConstIterator end() const {
+		return _dense.end();
 	}
 
-	std::unordered_map<ObjectID, T> &map() {
-		return _map;
+	// lock free, id stays invalid until owner thread inserts value with insertReserved, free
+	// slots are only reused by insert
+	ObjectID reserve() {
+		uint32_t slot = _slotCount.fetch_add(1, std::memory_order_relaxed);
+
+		// generation a fresh slot gets on insert
+		return (static_cast<ObjectID>(1) << 32) | slot;
 	}
 
-	uint64_t insert(T value) {
-		_last++;
-		_map[_last] = value;
+	ObjectID insertReserved(ObjectID object, T value) {
+		uint32_t slot = _getSlot(object);
+
+		if (slot >= _slots.size())
+			_slots.resize(slot + 1, { 0, 0 });
+
+		Slot &entry = _slots[slot];
+		entry.dense = static_cast<uint32_t>(_dense.size());
+		entry.generation++;
 
-		return _last;
+		_dense.push_back(value);
+		_denseToSlot.push_back(slot);
+
+		return (static_cast<ObjectID>(entry.generation) << 32) | slot;
+	}
+
+	ObjectID insert(T value) {
+		uint32_t slot;
+
+		if (!_freeSlots.empty()) {
+			slot = _freeSlots.back();
+			_freeSlots.pop_back();
+		} else {
+			slot = _slotCount.fetch_add(1, std::memory_order_relaxed);
+
+			if (slot >= _slots.size())
+				_slots.resize(slot + 1, { 0, 0 });
+		}
+
+		// generation is bumped on free, first one starts at 1 so id is never 0
+		Slot &entry = _slots[slot];
+		entry.dense = static_cast<uint32_t>(_dense.size());
+		entry.generation++;
+
+		_dense.push_back(value);
+		_denseToSlot.push_back(slot);
+
+		return (static_cast<ObjectID>(entry.generation) << 32) | slot;
 	}
 
 	bool has(ObjectID object) const {
-		auto iter = _map.find(object);
-		return iter != _map.end();
+		uint32_t slot = _getSlot(object);
+
+		if (slot >= _slots.size())
+			return false;
+
+		// odd generation is alive, stale handles have older generation
+		uint32_t generation = _slots[slot].generation;
+		return (generation & 1) == 1 && generation == _getGeneration(object);
 	}
 
-	T get_id_or_else(ObjectID object, T value) {
+	T get_id_or_else(ObjectID object, T value) const {
 		if (has(object))
-			return _map[object];
+			return (*this)[object];
 
 		return value;
 	}
 
 	uint64_t size() const {
-		return _map.size();
+		return _dense.size();
 	}
 
-	void free(ObjectID object) {
-		auto iter = _map.find(object);
-		bool isFound = iter != _map.end();
+	// of value at position in iteration order
+	ObjectID getObject(uint64_t index) const {
+		uint32_t slot = _denseToSlot[index];
+		return (static_cast<ObjectID>(_slots[slot].generation) << 32) | slot;
+	}
 
-		if (!isFound)
+	void free(ObjectID object) {
+		if (!has(object))
 			return;
 
-		// template should have viable destructor
-		_map.erase(iter);
+		Slot &entry = _slots[_getSlot(object)];
+		uint32_t last = static_cast<uint32_t>(_dense.size()) - 1;
+
+		if (entry.dense != last) {
+			// template should have viable move assignment
+			_dense[entry.dense] = std::move(_dense[last]);
+			_denseToSlot[entry.dense] = _denseToSlot[last];
+			_slots[_denseToSlot[last]].dense = entry.dense;
+		}
+
+		_dense.pop_back();
+		_denseToSlot.pop_back();
+
+		entry.generation++;
+		_freeSlots.push_back(_getSlot(object));
 	};
 };
 
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "pipeline_statistics.h"
+
+// statistics followed by availability
+const uint32_t PIPELINE_STATISTICS_RESULT_COUNT = 4;
+
+uint32_t PipelineStatistics::_getStats(const char *name) {
+	for (uint32_t i = 0; i < _stats.size(); i++)
+		if (strcmp(_stats[i].name.c_str(), name) == 0)
+			return i;
+
+	PipelineStats stats = {};
+	stats.name = name;
+
+	_stats.push_back(stats);
+
+	return static_cast<uint32_t>(_stats.size() - 1);
+}
+
+void PipelineStatistics::collect(uint32_t pool) {
+	std::vector<Scope> &scopes = _scopes[pool];
+
+	if (scopes.empty())
+		return;
+
+	uint32_t queryCount = static_cast<uint32_t>(scopes.size());
+	std::vector<uint64_t> results(queryCount * PIPELINE_STATISTICS_RESULT_COUNT);
+
+	vk::Result result = _device.getQueryPoolResults(_queryPools[pool], 0, queryCount,
+			results.size() * sizeof(uint64_t), results.data(),
+			PIPELINE_STATISTICS_RESULT_COUNT * sizeof(uint64_t),
+			vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+
+	// stats of disabled frames are dropped
+	if ((result != vk::Result::eSuccess && result != vk::Result::eNotReady) || !_isEnabled) {
+		scopes.clear();
+		return;
+	}
+
+	for (uint32_t i = 0; i < scopes.size(); i++) {
+		const uint64_t *pResult = &results[i * PIPELINE_STATISTICS_RESULT_COUNT];
+
+		if (pResult[3] == 0)
+			continue;
+
+		PipelineStats &stats = _stats[scopes[i].stats];
+		stats.vertexInvocations = pResult[0];
+		stats.clippingPrimitives = pResult[1];
+		stats.fragmentInvocations = pResult[2];
+	}
+
+	scopes.clear();
+}
+
+void PipelineStatistics::begin(vk::CommandBuffer commandBuffer, uint32_t pool) {
+	if (!_isSupported)
+		return;
+
+	collect(pool);
+	_pool = pool;
+	_isReset[pool] = _isEnabled;
+
+	if (_isEnabled)
+		commandBuffer.resetQueryPool(_queryPools[pool], 0, MAX_PIPELINE_STATISTICS_SCOPES);
+}
+
+uint32_t PipelineStatistics::scopeCreate(const char *name) {
+	if (!_isSupported || !_isEnabled || !_isReset[_pool] ||
+			_scopes[_pool].size() == MAX_PIPELINE_STATISTICS_SCOPES)
+		return PIPELINE_STATISTICS_NO_SCOPE;
+
+	_scopes[_pool].push_back({ _getStats(name) });
+
+	return static_cast<uint32_t>(_scopes[_pool].size() - 1);
+}
+
+void PipelineStatistics::scopeBegin(vk::CommandBuffer commandBuffer, uint32_t scope) {
+	if (scope == PIPELINE_STATISTICS_NO_SCOPE)
+		return;
+
+	commandBuffer.beginQuery(_queryPools[_pool], scope, {});
+}
+
+void PipelineStatistics::scopeEnd(vk::CommandBuffer commandBuffer, uint32_t scope) {
+	if (scope == PIPELINE_STATISTICS_NO_SCOPE)
+		return;
+
+	commandBuffer.endQuery(_queryPools[_pool], scope);
+}
+
+void PipelineStatistics::setEnabled(bool isEnabled) {
+	_isEnabled = isEnabled;
+
+	if (!isEnabled)
+		_stats.clear();
+}
+
+bool PipelineStatistics::isEnabled() const {
+	return _isEnabled;
+}
+
+bool PipelineStatistics::isSupported() const {
+	return _isSupported;
+}
+
+std::vector<PipelineStats> PipelineStatistics::getStats() const {
+	return _stats;
+}
+
+void PipelineStatistics::initialize(vk::Device device, bool isSupported, uint32_t poolCount) {
+	_device = device;
+	_poolCount = std::clamp(poolCount, 1u, MAX_FRAMES_IN_FLIGHT);
+	_isSupported = isSupported;
+
+	_initialized = true;
+
+	if (!isSupported)
+		return;
+
+	vk::QueryPoolCreateInfo createInfo;
+	createInfo.setQueryType(vk::QueryType::ePipelineStatistics);
+	createInfo.setQueryCount(MAX_PIPELINE_STATISTICS_SCOPES);
+	createInfo.setPipelineStatistics(PIPELINE_STATISTICS_FLAGS);
+
+	for (uint32_t i = 0; i < _poolCount; i++)
+		_queryPools[i] = _device.createQueryPool(createInfo);
+}
+
+void PipelineStatistics::destroy() {
+	if (!_initialized)
+		return;
+
+	for (uint32_t i = 0; i < _poolCount; i++) {
+		if (_queryPools[i])
+			_device.destroyQueryPool(_queryPools[i]);
+
+		_queryPools[i] = nullptr;
+		_scopes[i].clear();
+	}
+
+	_stats.clear();
+	_initialized = false;
+}
@@ -0,0 +1,84 @@
+#ifndef PIPELINE_STATISTICS_H
+#define PIPELINE_STATISTICS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "types/frame.h"
+
+// queries per pool, a pass takes one
+const uint32_t MAX_PIPELINE_STATISTICS_SCOPES = 8;
+
+// returned while disabled or when pool is full, begin and end ignore it
+const uint32_t PIPELINE_STATISTICS_NO_SCOPE = UINT32_MAX;
+
+// counted by every query, results are written in order of bits
+const vk::QueryPipelineStatisticFlags PIPELINE_STATISTICS_FLAGS =
+		vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+		vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+		vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+
+// of last collected frame
+struct PipelineStats {
+	std::string name;
+	uint64_t vertexInvocations;
+	// left after clipping, culled and clipped away ones are not counted
+	uint64_t clippingPrimitives;
+	uint64_t fragmentInvocations;
+};
+
+// Counts shader invocations of named passes with pipeline statistics queries. Works like
+// GpuProfiler, pools are read as many submits later as there are pools, but queries are begun
+// in primary buffer only, around secondary buffers passes are recorded to, since a query can
+// not span buffers. Off until enabled, counting may cost some GPU time on its own.
+class PipelineStatistics {
+private:
+	typedef struct {
+		// of stats
+		uint32_t stats;
+	} Scope;
+
+	vk::Device _device;
+
+	vk::QueryPool _queryPools[MAX_FRAMES_IN_FLIGHT];
+	std::vector<Scope> _scopes[MAX_FRAMES_IN_FLIGHT];
+	// pool was reset by begin, scopes of frames enabled midway wait for next one
+	bool _isReset[MAX_FRAMES_IN_FLIGHT] = {};
+	uint32_t _poolCount = 0;
+	uint32_t _pool = 0;
+
+	std::vector<PipelineStats> _stats;
+
+	bool _initialized = false;
+	bool _isSupported = false;
+	bool _isEnabled = false;
+
+	uint32_t _getStats(const char *name);
+
+public:
+	// commands written to pool have to be finished
+	void collect(uint32_t pool);
+	// collects and resets pool outside of render pass
+	void begin(vk::CommandBuffer commandBuffer, uint32_t pool);
+
+	// name has to outlive recording of pool, literals are expected
+	uint32_t scopeCreate(const char *name);
+	// primary buffer within subpass, end has to follow in same subpass
+	void scopeBegin(vk::CommandBuffer commandBuffer, uint32_t scope);
+	void scopeEnd(vk::CommandBuffer commandBuffer, uint32_t scope);
+
+	void setEnabled(bool isEnabled);
+	bool isEnabled() const;
+	bool isSupported() const;
+	// in order passes were first seen
+	std::vector<PipelineStats> getStats() const;
+
+	// without support every scope is none
+	void initialize(vk::Device device, bool isSupported, uint32_t poolCount);
+	void destroy();
+};
+
+#endif // !PIPELINE_STATISTICS_H
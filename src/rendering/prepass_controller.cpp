@@ -0,0 +1,77 @@
+#include <cstdint>
+
+#include "prepass_controller.h"
+
+void PrepassController::_switch() {
+	_isPrepass = !_isPrepass;
+	_settleCount = PREPASS_SETTLE_SAMPLES;
+	_sum = 0.0f;
+	_sampleCount = 0;
+}
+
+void PrepassController::setEnabled(bool isEnabled) {
+	_isEnabled = isEnabled;
+	reset();
+}
+
+bool PrepassController::isEnabled() const {
+	return _isEnabled;
+}
+
+bool PrepassController::update(float milliseconds) {
+	if (!_isEnabled || milliseconds <= 0.0f)
+		return _isPrepass;
+
+	if (_settleCount > 0) {
+		_settleCount--;
+		return _isPrepass;
+	}
+
+	if (_phase == Phase::Holding) {
+		if (++_holdCount >= PREPASS_PROBE_INTERVAL) {
+			_phase = Phase::Measuring;
+			_holdCount = 0;
+		}
+
+		return _isPrepass;
+	}
+
+	_sum += milliseconds;
+
+	if (++_sampleCount < PREPASS_MEASURE_SAMPLES)
+		return _isPrepass;
+
+	float average = _sum / static_cast<float>(_sampleCount);
+
+	if (_phase == Phase::Measuring) {
+		_measuredMilliseconds = average;
+		_phase = Phase::Probing;
+		_switch();
+
+		return _isPrepass;
+	}
+
+	// probed mode is kept only when clearly faster
+	if (average > _measuredMilliseconds * (1.0f - PREPASS_HYSTERESIS))
+		_switch();
+
+	_sum = 0.0f;
+	_sampleCount = 0;
+	_phase = Phase::Holding;
+
+	return _isPrepass;
+}
+
+bool PrepassController::isPrepass() const {
+	return _isPrepass;
+}
+
+void PrepassController::reset() {
+	_isPrepass = true;
+	_phase = Phase::Measuring;
+	_settleCount = 0;
+	_holdCount = 0;
+	_sum = 0.0f;
+	_sampleCount = 0;
+	_measuredMilliseconds = 0.0f;
+}
@@ -0,0 +1,57 @@
+#ifndef PREPASS_CONTROLLER_H
+#define PREPASS_CONTROLLER_H
+
+#include <cstdint>
+
+// samples averaged for each mode
+const uint32_t PREPASS_MEASURE_SAMPLES = 16;
+
+// samples dropped after mode changes, frames in flight were recorded in the one before
+const uint32_t PREPASS_SETTLE_SAMPLES = 4;
+
+// samples in picked mode before the other one is measured again, scene or view may have changed
+const uint32_t PREPASS_PROBE_INTERVAL = 600;
+
+// other mode has to be faster by this fraction to be picked, so noise does not flip modes
+const float PREPASS_HYSTERESIS = 0.05f;
+
+// Decides whether depth prepass is drawn from GPU time of depth and material passes. Prepass pays
+// off with overdraw, early depth test then rejects shading of hidden surfaces, with little of it
+// every triangle is only drawn twice. Both modes are measured in turn, faster one is kept and the
+// other one measured again after a while. Prepass stays on while controller is disabled.
+class PrepassController {
+private:
+	enum class Phase {
+		Measuring,
+		Probing,
+		Holding,
+	};
+
+	bool _isEnabled = false;
+	bool _isPrepass = true;
+
+	Phase _phase = Phase::Measuring;
+	uint32_t _settleCount = 0;
+	uint32_t _holdCount = 0;
+
+	float _sum = 0.0f;
+	uint32_t _sampleCount = 0;
+	// average of mode probe started from
+	float _measuredMilliseconds = 0.0f;
+
+	void _switch();
+
+public:
+	void setEnabled(bool isEnabled);
+	bool isEnabled() const;
+
+	// GPU time of depth and material passes of one frame, returns whether next frames draw
+	// prepass
+	bool update(float milliseconds);
+	bool isPrepass() const;
+
+	// measures from prepass again
+	void reset();
+};
+
+#endif // !PREPASS_CONTROLLER_H
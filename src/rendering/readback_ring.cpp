@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+#include "readback_ring.h"
+
+const uint32_t READBACK_TEXEL_SIZE = 4;
+
+void ReadbackRing::record(vk::CommandBuffer commandBuffer, uint32_t slot, vk::Image image,
+		vk::Extent2D extent, vk::Format format, vk::ImageLayout layout, uint64_t id) {
+	assert(slot < _slotCount && !_slots[slot].isPending);
+
+	Slot &pending = _slots[slot];
+	vk::DeviceSize size =
+			static_cast<vk::DeviceSize>(extent.width) * extent.height * READBACK_TEXEL_SIZE;
+
+	// previous copy of slot was collected, so its buffer is idle
+	if (pending.buffer.size < size) {
+		if (pending.buffer.buffer) {
+			MemoryTracker::untrack(pending.buffer.allocation);
+			vmaDestroyBuffer(_allocator, pending.buffer.buffer, pending.buffer.allocation);
+		}
+
+		pending.buffer = AllocatedBuffer::create(_allocator, MemoryCategory::Staging,
+				BufferClass::Readback, vk::BufferUsageFlagBits::eTransferDst, size,
+				&pending.allocInfo);
+	}
+
+	vk::ImageSubresourceRange subresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+	// offscreen images leave render pass in transfer layout, only its writes are waited for
+	if (layout == vk::ImageLayout::eTransferSrcOptimal) {
+		vk::MemoryBarrier colorBarrier;
+		colorBarrier.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+		colorBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::PipelineStageFlagBits::eTransfer, {}, colorBarrier, nullptr, nullptr);
+	} else {
+		vk::ImageMemoryBarrier barrier;
+		barrier.setImage(image);
+		barrier.setSubresourceRange(subresourceRange);
+		barrier.setOldLayout(layout);
+		barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+	}
+
+	vk::BufferImageCopy region;
+	region.setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 });
+	region.setImageExtent({ extent.width, extent.height, 1 });
+
+	commandBuffer.copyImageToBuffer(
+			image, vk::ImageLayout::eTransferSrcOptimal, pending.buffer.buffer, region);
+
+	vk::MemoryBarrier hostBarrier;
+	hostBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	hostBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eHost, {}, hostBarrier, nullptr, nullptr);
+
+	// presentation waits on semaphore, nothing has to be made visible to it
+	if (layout != vk::ImageLayout::eTransferSrcOptimal) {
+		vk::ImageMemoryBarrier barrier;
+		barrier.setImage(image);
+		barrier.setSubresourceRange(subresourceRange);
+		barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+		barrier.setNewLayout(layout);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, nullptr, barrier);
+	}
+
+	pending.width = extent.width;
+	pending.height = extent.height;
+	pending.format = format;
+	pending.id = id;
+	pending.isPending = true;
+}
+
+bool ReadbackRing::collect(uint32_t slot, Readback &readback) {
+	Slot &pending = _slots[slot];
+
+	if (!pending.isPending)
+		return false;
+
+	vmaInvalidateAllocation(_allocator, pending.buffer.allocation, 0, VK_WHOLE_SIZE);
+
+	const uint8_t *pData = static_cast<const uint8_t *>(pending.allocInfo.pMappedData);
+	size_t size = static_cast<size_t>(pending.width) * pending.height * READBACK_TEXEL_SIZE;
+
+	readback.id = pending.id;
+	readback.width = pending.width;
+	readback.height = pending.height;
+	readback.format = pending.format;
+	readback.pixels.assign(pData, pData + size);
+
+	pending.isPending = false;
+
+	return true;
+}
+
+bool ReadbackRing::isPending(uint32_t slot) const {
+	return _slots[slot].isPending;
+}
+
+void ReadbackRing::initialize(VmaAllocator allocator, uint32_t slotCount) {
+	_allocator = allocator;
+	_slotCount = std::clamp(slotCount, 1u, MAX_FRAMES_IN_FLIGHT);
+
+	for (uint32_t i = 0; i < _slotCount; i++)
+		_slots[i] = {};
+
+	_initialized = true;
+}
+
+void ReadbackRing::destroy() {
+	if (!_initialized)
+		return;
+
+	for (uint32_t i = 0; i < _slotCount; i++) {
+		Slot &slot = _slots[i];
+
+		if (!slot.buffer.buffer)
+			continue;
+
+		MemoryTracker::untrack(slot.buffer.allocation);
+		vmaDestroyBuffer(_allocator, slot.buffer.buffer, slot.buffer.allocation);
+	}
+
+	_slotCount = 0;
+	_initialized = false;
+}
@@ -0,0 +1,63 @@
+#ifndef READBACK_RING_H
+#define READBACK_RING_H
+
+#include <cstdint>
+#include <vector>
+
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+#include "types/allocated.h"
+#include "types/frame.h"
+
+// pixels of one finished frame, rows are tightly packed
+struct Readback {
+	uint64_t id;
+	uint32_t width;
+	uint32_t height;
+	// of image copied, four bytes per pixel
+	vk::Format format;
+	std::vector<uint8_t> pixels;
+};
+
+// Copies final color of a frame to host visible buffer of its slot, slot per frame in flight.
+// Copy is collected when fence of that frame has been waited for again, so frames pipeline as
+// deep as there are in flight and the CPU never stalls on a copy. Buffer of slot grows when
+// swapchain does, it is idle by the time it is recorded again.
+class ReadbackRing {
+private:
+	typedef struct {
+		AllocatedBuffer buffer;
+		VmaAllocationInfo allocInfo;
+
+		uint32_t width;
+		uint32_t height;
+		vk::Format format;
+
+		uint64_t id;
+		bool isPending;
+	} Slot;
+
+	VmaAllocator _allocator;
+
+	Slot _slots[MAX_FRAMES_IN_FLIGHT] = {};
+	uint32_t _slotCount = 0;
+
+	bool _initialized = false;
+
+public:
+	// image has to be four bytes per pixel, written by color attachment output and left in
+	// layout, which is restored after copy, previous copy of slot has to be collected
+	void record(vk::CommandBuffer commandBuffer, uint32_t slot, vk::Image image,
+			vk::Extent2D extent, vk::Format format, vk::ImageLayout layout, uint64_t id);
+	// commands of slot have to be finished, false when nothing was recorded to it
+	bool collect(uint32_t slot, Readback &readback);
+
+	bool isPending(uint32_t slot) const;
+
+	// slot per frame in flight, buffers are created once slot is first recorded
+	void initialize(VmaAllocator allocator, uint32_t slotCount);
+	void destroy();
+};
+
+#endif // !READBACK_RING_H
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "memory_tracker.h"
+#include "rendering_device.h"
+
+#include "render_graph.h"
+
+const vk::AccessFlags WRITE_ACCESS = vk::AccessFlagBits::eShaderWrite |
+		vk::AccessFlagBits::eColorAttachmentWrite |
+		vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite;
+
+static bool _isSame(const RenderGraph::State &a, const RenderGraph::State &b) {
+	return a.layout == b.layout && a.stages == b.stages && a.access == b.access;
+}
+
+RenderGraph::State RenderGraph::getState(GraphUsage usage) {
+	switch (usage) {
+		case GraphUsage::ComputeSampled:
+			return { vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead };
+		case GraphUsage::ComputeGeneralRead:
+			return { vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader,
+				vk::AccessFlagBits::eShaderRead };
+		case GraphUsage::ComputeGeneralWrite:
+			return { vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader,
+				vk::AccessFlagBits::eShaderWrite };
+		case GraphUsage::FragmentSampled:
+			return { vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead };
+		case GraphUsage::FragmentGeneralRead:
+			return { vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eFragmentShader,
+				vk::AccessFlagBits::eShaderRead };
+		case GraphUsage::ColorAttachment:
+			return { vk::ImageLayout::eColorAttachmentOptimal,
+				vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::AccessFlagBits::eColorAttachmentRead |
+						vk::AccessFlagBits::eColorAttachmentWrite };
+		case GraphUsage::DepthAttachment:
+			return { vk::ImageLayout::eDepthStencilAttachmentOptimal,
+				vk::PipelineStageFlagBits::eEarlyFragmentTests |
+						vk::PipelineStageFlagBits::eLateFragmentTests,
+				vk::AccessFlagBits::eDepthStencilAttachmentRead |
+						vk::AccessFlagBits::eDepthStencilAttachmentWrite };
+		case GraphUsage::TransferSrc:
+			return { vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer,
+				vk::AccessFlagBits::eTransferRead };
+		case GraphUsage::TransferDst:
+			return { vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer,
+				vk::AccessFlagBits::eTransferWrite };
+		case GraphUsage::ShadingRateAttachment:
+			return { vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR,
+				vk::PipelineStageFlagBits::eFragmentShadingRateAttachmentKHR,
+				vk::AccessFlagBits::eFragmentShadingRateAttachmentReadKHR };
+	}
+
+	throw std::invalid_argument("Unknown graph usage!");
+}
+
+void RenderGraph::_compile() {
+	for (uint32_t i = 0; i < _passes.size(); i++) {
+		for (const GraphAccess &access : _passes[i].accesses) {
+			const Image &image = _images[access.image];
+
+			if (!image.transient.has_value())
+				continue;
+
+			TransientDesc &desc = _transientDescs[image.transient.value()];
+			desc.firstPass = std::min(desc.firstPass, i);
+			desc.lastPass = std::max(desc.lastPass, i);
+		}
+	}
+
+	bool isSame = _transientDescs.size() == _transients.size();
+
+	for (uint32_t i = 0; isSame && i < _transients.size(); i++) {
+		const TransientDesc &a = _transientDescs[i];
+		const TransientDesc &b = _transients[i].desc;
+
+		isSame = a.width == b.width && a.height == b.height && a.format == b.format &&
+				a.usage == b.usage && a.aspect == b.aspect && a.firstPass == b.firstPass &&
+				a.lastPass == b.lastPass;
+	}
+
+	if (isSame)
+		return;
+
+	_destroyTransients();
+
+	std::vector<vk::MemoryRequirements> requirements;
+
+	for (const TransientDesc &desc : _transientDescs) {
+		vk::ImageCreateInfo createInfo;
+		createInfo.setImageType(vk::ImageType::e2D);
+		createInfo.setExtent(vk::Extent3D(desc.width, desc.height, 1));
+		createInfo.setMipLevels(1);
+		createInfo.setArrayLayers(1);
+		createInfo.setFormat(desc.format);
+		createInfo.setTiling(vk::ImageTiling::eOptimal);
+		createInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+		createInfo.setUsage(desc.usage);
+		createInfo.setSamples(vk::SampleCountFlagBits::e1);
+		createInfo.setSharingMode(vk::SharingMode::eExclusive);
+		// memory is bound by graph, possibly under other images
+		createInfo.setFlags(vk::ImageCreateFlagBits::eAlias);
+
+		vk::Image image = _device.createImage(createInfo);
+
+		_transients.push_back({ desc, image, nullptr, 0 });
+		requirements.push_back(_device.getImageMemoryRequirements(image));
+	}
+
+	// largest first, each goes to first block none of whose images overlap its passes
+	std::vector<uint32_t> order(_transients.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return requirements[a].size > requirements[b].size;
+	});
+
+	std::vector<vk::MemoryRequirements> blockRequirements;
+	std::vector<std::vector<uint32_t>> blockTransients;
+
+	for (uint32_t i : order) {
+		const TransientDesc &desc = _transients[i].desc;
+		uint32_t block = 0;
+
+		for (; block < blockRequirements.size(); block++) {
+			if ((blockRequirements[block].memoryTypeBits & requirements[i].memoryTypeBits) == 0)
+				continue;
+
+			bool isOverlapping = false;
+
+			for (uint32_t other : blockTransients[block]) {
+				const TransientDesc &otherDesc = _transients[other].desc;
+				isOverlapping = isOverlapping ||
+						(desc.firstPass <= otherDesc.lastPass &&
+								otherDesc.firstPass <= desc.lastPass);
+			}
+
+			if (!isOverlapping)
+				break;
+		}
+
+		if (block == blockRequirements.size()) {
+			blockRequirements.push_back(requirements[i]);
+			blockTransients.emplace_back();
+		}
+
+		vk::MemoryRequirements &blockRequirement = blockRequirements[block];
+		blockRequirement.size = std::max(blockRequirement.size, requirements[i].size);
+		blockRequirement.alignment =
+				std::max(blockRequirement.alignment, requirements[i].alignment);
+		blockRequirement.memoryTypeBits &= requirements[i].memoryTypeBits;
+
+		blockTransients[block].push_back(i);
+		_transients[i].block = block;
+	}
+
+	for (uint32_t i = 0; i < blockRequirements.size(); i++) {
+		VkMemoryRequirements memoryRequirements = blockRequirements[i];
+
+		VmaAllocationCreateInfo allocCreateInfo = {};
+		allocCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		allocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+		allocCreateInfo.priority = 1.0f;
+
+		VmaAllocation allocation;
+		VkResult err = vmaAllocateMemory(
+				_allocator, &memoryRequirements, &allocCreateInfo, &allocation, nullptr);
+
+		if (err != VK_SUCCESS)
+			throw std::runtime_error("Render graph transient memory allocation failed!");
+
+		MemoryTracker::track(_allocator, allocation, MemoryCategory::RenderTarget);
+
+		for (uint32_t transient : blockTransients[i])
+			vmaBindImageMemory(_allocator, allocation, _transients[transient].image);
+
+		_blocks.push_back({ allocation,
+				{ vk::ImageLayout::eUndefined, vk::PipelineStageFlagBits::eTopOfPipe, {} } });
+	}
+
+	for (Transient &transient : _transients) {
+		vk::ImageSubresourceRange subresourceRange;
+		subresourceRange.setAspectMask(transient.desc.aspect);
+		subresourceRange.setBaseMipLevel(0);
+		subresourceRange.setLevelCount(1);
+		subresourceRange.setBaseArrayLayer(0);
+		subresourceRange.setLayerCount(1);
+
+		vk::ImageViewCreateInfo createInfo;
+		createInfo.setImage(transient.image);
+		createInfo.setViewType(vk::ImageViewType::e2D);
+		createInfo.setFormat(transient.desc.format);
+		createInfo.setSubresourceRange(subresourceRange);
+
+		transient.view = _device.createImageView(createInfo);
+	}
+}
+
+void RenderGraph::_destroyTransients() {
+	if (_transients.empty())
+		return;
+
+	std::vector<Transient> transients;
+	std::vector<Block> blocks;
+	transients.swap(_transients);
+	blocks.swap(_blocks);
+
+	// frames in flight may still use them
+	vk::Device device = _device;
+	VmaAllocator allocator = _allocator;
+
+	RD::getSingleton().destroyDeferred([device, allocator, transients, blocks]() {
+		for (const Transient &transient : transients) {
+			device.destroyImageView(transient.view);
+			device.destroyImage(transient.image);
+		}
+
+		for (const Block &block : blocks) {
+			MemoryTracker::untrack(block.allocation);
+			vmaFreeMemory(allocator, block.allocation);
+		}
+	});
+}
+
+void RenderGraph::_transition(
+		vk::CommandBuffer commandBuffer, const std::vector<GraphAccess> &accesses) {
+	std::vector<vk::ImageMemoryBarrier> barriers;
+	vk::PipelineStageFlags srcStages;
+	vk::PipelineStageFlags dstStages;
+
+	for (const GraphAccess &access : accesses) {
+		Image &image = _images[access.image];
+		State target = getState(access.usage);
+		State source = image.state;
+
+		// first use of transient in frame waits for whichever image used its memory last
+		if (image.transient.has_value() && source.layout == vk::ImageLayout::eUndefined) {
+			const Block &block = _blocks[_transients[image.transient.value()].block];
+			source.stages = block.state.stages;
+			source.access = block.state.access;
+		}
+
+		bool isWrite = (bool)(target.access & WRITE_ACCESS);
+		bool wasWritten = (bool)(source.access & WRITE_ACCESS);
+
+		// reads after reads need nothing, later writes wait for all of them
+		if (source.layout == target.layout && !isWrite && !wasWritten) {
+			image.state.stages |= target.stages;
+			image.state.access |= target.access;
+		} else {
+			vk::ImageSubresourceRange subresourceRange;
+			subresourceRange.setAspectMask(image.aspect);
+			subresourceRange.setBaseMipLevel(0);
+			subresourceRange.setLevelCount(VK_REMAINING_MIP_LEVELS);
+			subresourceRange.setBaseArrayLayer(0);
+			subresourceRange.setLayerCount(VK_REMAINING_ARRAY_LAYERS);
+
+			vk::ImageMemoryBarrier barrier;
+			barrier.setOldLayout(source.layout);
+			barrier.setNewLayout(target.layout);
+			barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+			barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+			barrier.setImage(image.image);
+			barrier.setSubresourceRange(subresourceRange);
+			barrier.setSrcAccessMask(source.access & WRITE_ACCESS);
+			barrier.setDstAccessMask(target.access);
+
+			barriers.push_back(barrier);
+			srcStages |= source.stages;
+			dstStages |= target.stages;
+
+			image.state = target;
+		}
+
+		if (image.transient.has_value())
+			_blocks[_transients[image.transient.value()].block].state = image.state;
+	}
+
+	if (barriers.empty())
+		return;
+
+	if (!srcStages)
+		srcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+
+	commandBuffer.pipelineBarrier(srcStages, dstStages, {}, nullptr, nullptr, barriers);
+}
+
+GraphImage RenderGraph::imageImport(vk::Image image, vk::ImageAspectFlags aspect,
+		const State &current, std::optional<GraphUsage> finalUsage) {
+	_images.push_back({ image, aspect, current, finalUsage, std::nullopt });
+	return static_cast<GraphImage>(_images.size() - 1);
+}
+
+GraphImage RenderGraph::imageCreate(uint32_t width, uint32_t height, vk::Format format,
+		vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect) {
+	uint32_t transient = static_cast<uint32_t>(_transientDescs.size());
+	_transientDescs.push_back({ width, height, format, usage, aspect, UINT32_MAX, 0 });
+
+	State undefined = { vk::ImageLayout::eUndefined, {}, {} };
+	_images.push_back({ nullptr, aspect, undefined, std::nullopt, transient });
+
+	return static_cast<GraphImage>(_images.size() - 1);
+}
+
+vk::ImageView RenderGraph::getImageView(GraphImage image) const {
+	return _transients[_images[image].transient.value()].view;
+}
+
+void RenderGraph::passAdd(const char *pName, const std::vector<GraphAccess> &accesses,
+		const std::function<void(vk::CommandBuffer)> &record) {
+	_passes.push_back({ pName, accesses, record });
+}
+
+void RenderGraph::execute(vk::CommandBuffer commandBuffer) {
+	_compile();
+
+	for (Image &image : _images) {
+		if (image.transient.has_value())
+			image.image = _transients[image.transient.value()].image;
+	}
+
+	for (const Pass &pass : _passes) {
+		_transition(commandBuffer, pass.accesses);
+		pass.record(commandBuffer);
+	}
+
+	// imported images are handed back as asked, untouched ones need nothing
+	std::vector<GraphAccess> finals;
+
+	for (uint32_t i = 0; i < _images.size(); i++) {
+		const Image &image = _images[i];
+
+		if (image.finalUsage.has_value() &&
+				!_isSame(image.state, getState(image.finalUsage.value())))
+			finals.push_back({ i, image.finalUsage.value() });
+	}
+
+	_transition(commandBuffer, finals);
+
+	_passes.clear();
+	_images.clear();
+	_transientDescs.clear();
+}
+
+void RenderGraph::initialize(vk::Device device, VmaAllocator allocator) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_allocator = allocator;
+
+	_initialized = true;
+}
+
+void RenderGraph::destroy() {
+	for (const Transient &transient : _transients) {
+		_device.destroyImageView(transient.view);
+		_device.destroyImage(transient.image);
+	}
+
+	for (const Block &block : _blocks) {
+		MemoryTracker::untrack(block.allocation);
+		vmaFreeMemory(_allocator, block.allocation);
+	}
+
+	_transients.clear();
+	_blocks.clear();
+}
@@ -0,0 +1,134 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+
+// how a pass touches an image, picks layout, stages and access of barriers around it
+enum class GraphUsage {
+	ComputeSampled,
+	// general layout, for storage images and ones sampled while written by other passes
+	ComputeGeneralRead,
+	ComputeGeneralWrite,
+	FragmentSampled,
+	FragmentGeneralRead,
+	ColorAttachment,
+	DepthAttachment,
+	TransferSrc,
+	TransferDst,
+	// read by scene render pass of next frame
+	ShadingRateAttachment,
+};
+
+typedef uint32_t GraphImage;
+
+typedef struct {
+	GraphImage image;
+	GraphUsage usage;
+} GraphAccess;
+
+// Passes of a frame recorded outside render passes of context, in order they are added. Each
+// pass declares images it reads and writes, graph puts one barrier ahead of it with only the
+// transitions and hazards it has, and leaves imported images in final usage asked for. Transient
+// images live within a frame, those used by passes that do not overlap share memory. Passes are
+// declared anew every frame, transient memory is kept while declarations stay the same.
+class RenderGraph {
+public:
+	// last access of image, stages of every read since last write are gathered
+	typedef struct {
+		vk::ImageLayout layout;
+		vk::PipelineStageFlags stages;
+		vk::AccessFlags access;
+	} State;
+
+	static State getState(GraphUsage usage);
+
+private:
+	typedef struct {
+		const char *pName;
+		std::vector<GraphAccess> accesses;
+		std::function<void(vk::CommandBuffer)> record;
+	} Pass;
+
+	typedef struct {
+		uint32_t width;
+		uint32_t height;
+		vk::Format format;
+		vk::ImageUsageFlags usage;
+		vk::ImageAspectFlags aspect;
+
+		// passes using it, from first to last
+		uint32_t firstPass;
+		uint32_t lastPass;
+	} TransientDesc;
+
+	typedef struct {
+		vk::Image image;
+		vk::ImageAspectFlags aspect;
+		State state;
+		std::optional<GraphUsage> finalUsage;
+
+		// transient only, index into descriptions and images of last compile
+		std::optional<uint32_t> transient;
+	} Image;
+
+	typedef struct {
+		TransientDesc desc;
+		vk::Image image;
+		vk::ImageView view;
+		uint32_t block;
+	} Transient;
+
+	// memory shared by transient images whose passes do not overlap
+	typedef struct {
+		VmaAllocation allocation;
+		// last access of any image in it, first use of next one waits for that
+		State state;
+	} Block;
+
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	std::vector<Pass> _passes;
+	std::vector<Image> _images;
+	std::vector<TransientDesc> _transientDescs;
+
+	// of last compile, reused while descriptions match
+	std::vector<Transient> _transients;
+	std::vector<Block> _blocks;
+
+	bool _initialized = false;
+
+	// transient images and memory whose descriptions changed, old ones are destroyed deferred
+	void _compile();
+	void _destroyTransients();
+	// batches barrier of every access in one call, nothing is recorded where none is needed
+	void _transition(vk::CommandBuffer commandBuffer, const std::vector<GraphAccess> &accesses);
+
+public:
+	// caller tracks state of images outside graph, current is what they were last used as
+	GraphImage imageImport(vk::Image image, vk::ImageAspectFlags aspect, const State &current,
+			std::optional<GraphUsage> finalUsage = std::nullopt);
+	// contents are undefined at first use every frame
+	GraphImage imageCreate(uint32_t width, uint32_t height, vk::Format format,
+			vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect);
+	// of transient image, valid from when passes are recorded on
+	vk::ImageView getImageView(GraphImage image) const;
+
+	// record is called during execute, images are then in layouts accesses asked for
+	void passAdd(const char *pName, const std::vector<GraphAccess> &accesses,
+			const std::function<void(vk::CommandBuffer)> &record);
+
+	// records passes in order and forgets them, along with images of frame
+	void execute(vk::CommandBuffer commandBuffer);
+
+	void initialize(vk::Device device, VmaAllocator allocator);
+	void destroy();
+};
+
+#endif // !RENDER_GRAPH_H
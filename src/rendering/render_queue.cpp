@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_queue.h"
+
+const uint32_t PIPELINE_BITS = 5;
+const uint32_t MATERIAL_BITS = 24;
+const uint32_t MESH_BITS = 24;
+const uint32_t PRIMITIVE_BITS = 11;
+
+// exponent and four mantissa bits of float distance, 16 buckets per doubling of distance
+const uint32_t DISTANCE_BITS = 12;
+
+const uint32_t RADIX_BITS = 8;
+const uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+const uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+uint64_t RenderQueue::makeKey(
+		uint32_t pipeline, ObjectID material, ObjectID mesh, uint32_t primitive) {
+	uint64_t pipelineMask = (1ull << PIPELINE_BITS) - 1;
+	uint64_t materialMask = (1ull << MATERIAL_BITS) - 1;
+	uint64_t meshMask = (1ull << MESH_BITS) - 1;
+	uint64_t primitiveMask = (1ull << PRIMITIVE_BITS) - 1;
+
+	// ids overflowing their field only worsen grouping, binds still compare real handles
+	uint64_t key = 0;
+	key |= (pipeline & pipelineMask) << (MATERIAL_BITS + MESH_BITS + PRIMITIVE_BITS);
+	key |= (material & materialMask) << (MESH_BITS + PRIMITIVE_BITS);
+	key |= (mesh & meshMask) << PRIMITIVE_BITS;
+	key |= (primitive & primitiveMask);
+
+	return key;
+}
+
+uint64_t RenderQueue::makeDepthKey(float distance, ObjectID mesh, uint32_t primitive) {
+	// bits of positive float are ordered like its value
+	float clamped = std::max(distance, 0.0f);
+	uint32_t bits;
+	memcpy(&bits, &clamped, sizeof(bits));
+
+	uint64_t bucket = bits >> (31 - DISTANCE_BITS);
+
+	return (bucket << (MESH_BITS + PRIMITIVE_BITS)) | makeKey(0, 0, mesh, primitive);
+}
+
+void RenderQueue::clear() {
+	_items.clear();
+	_batches.clear();
+}
+
+void RenderQueue::add(const DrawItem &item) {
+	_items.push_back(item);
+}
+
+void RenderQueue::sort() {
+	size_t count = _items.size();
+
+	if (count < 2)
+		return;
+
+	_scratch.resize(count);
+
+	DrawItem *pSrc = _items.data();
+	DrawItem *pDst = _scratch.data();
+
+	// least significant digit first, stable
+	for (uint32_t pass = 0; pass < RADIX_PASSES; pass++) {
+		uint32_t shift = pass * RADIX_BITS;
+		uint32_t histogram[RADIX_SIZE] = {};
+
+		for (size_t i = 0; i < count; i++)
+			histogram[(pSrc[i].key >> shift) & (RADIX_SIZE - 1)]++;
+
+		// all keys share this digit, nothing to reorder
+		uint32_t digit = (pSrc[0].key >> shift) & (RADIX_SIZE - 1);
+		if (histogram[digit] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < RADIX_SIZE; i++) {
+			uint32_t binCount = histogram[i];
+			histogram[i] = offset;
+			offset += binCount;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			uint32_t bin = (pSrc[i].key >> shift) & (RADIX_SIZE - 1);
+			pDst[histogram[bin]++] = pSrc[i];
+		}
+
+		DrawItem *pTemp = pSrc;
+		pSrc = pDst;
+		pDst = pTemp;
+	}
+
+	if (pSrc != _items.data())
+		_items.swap(_scratch);
+}
+
+void RenderQueue::batch(std::vector<InstanceTransform> &transforms,
+		std::vector<uint32_t> &materials, uint32_t maxTransforms,
+		std::vector<InstanceTransform> *pNormals) {
+	_batches.clear();
+
+	for (const DrawItem &item : _items) {
+		if (transforms.size() >= maxTransforms)
+			break;
+
+		uint32_t instance = static_cast<uint32_t>(transforms.size());
+		transforms.push_back(item.isImpostor ? item.pMeshInstance->impostorTransform
+											 : item.pMeshInstance->drawTransform);
+		materials.push_back(item.materialIndex);
+
+		if (pNormals != nullptr)
+			pNormals->push_back(item.pMeshInstance->normalTransform);
+
+		if (!_batches.empty()) {
+			DrawBatch &last = _batches.back();
+
+			// posed instances of one mesh draw vertices of their own
+			bool isSameMesh = last.pMesh == item.pMesh && last.firstIndex == item.firstIndex &&
+					last.vertexOffset == item.vertexOffset;
+			bool isSameMaterial =
+					last.textureSetId == item.textureSetId && last.permutation == item.permutation;
+
+			// instances of batch have to stay contiguous
+			bool isContiguous = last.firstInstance + last.instanceCount == instance;
+
+			if (isSameMesh && isSameMaterial && isContiguous) {
+				last.instanceCount++;
+				last.isFar = last.isFar && item.isFar;
+				continue;
+			}
+		}
+
+		DrawBatch batch = {};
+		batch.pMesh = item.pMesh;
+		batch.pPrimitive = item.pPrimitive;
+		batch.indexCount = item.indexCount;
+		batch.firstIndex = item.firstIndex;
+		batch.vertexOffset = item.vertexOffset;
+		batch.firstInstance = instance;
+		batch.instanceCount = 1;
+		batch.textureSetId = item.textureSetId;
+		batch.permutation = item.permutation;
+		batch.isFar = item.isFar;
+
+		_batches.push_back(batch);
+	}
+}
+
+const std::vector<DrawItem> &RenderQueue::items() const {
+	return _items;
+}
+
+const std::vector<DrawBatch> &RenderQueue::batches() const {
+	return _batches;
+}
@@ -0,0 +1,118 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include "types/resource.h"
+
+struct DrawItem {
+	uint64_t key;
+
+	const MeshRD *pMesh;
+	const PrimitiveRD *pPrimitive;
+	const MeshInstanceRD *pMeshInstance;
+
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+
+	// 0 in bindless mode
+	ObjectID textureSetId;
+	uint32_t materialIndex;
+
+	// material bits of pipeline permutation
+	uint32_t permutation;
+
+	// beyond coarse shading distance
+	bool isFar;
+
+	// mesh is impostor of mesh of instance, drawn with impostor transform of instance
+	bool isImpostor;
+};
+
+// consecutive draw items sharing mesh, primitive and material
+struct DrawBatch {
+	const MeshRD *pMesh;
+	const PrimitiveRD *pPrimitive;
+
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+
+	ObjectID textureSetId;
+	uint32_t permutation;
+
+	// every instance is, batch is shaded coarse only then
+	bool isFar;
+};
+
+struct DrawStats {
+	uint32_t drawCount = 0;
+	uint32_t instanceCount = 0;
+
+	uint32_t meshBindCount = 0;
+	uint32_t meshBindSkipCount = 0;
+
+	uint32_t materialBindCount = 0;
+	uint32_t materialBindSkipCount = 0;
+
+	uint32_t pipelineBindCount = 0;
+	// every bindDescriptorSets call, material sets included
+	uint32_t setBindCount = 0;
+	uint32_t pushConstantCount = 0;
+
+	// unknown for indirect draws, their counts are on GPU
+	uint64_t triangleCount = 0;
+
+	DrawStats &operator+=(const DrawStats &other) {
+		drawCount += other.drawCount;
+		instanceCount += other.instanceCount;
+		meshBindCount += other.meshBindCount;
+		meshBindSkipCount += other.meshBindSkipCount;
+		materialBindCount += other.materialBindCount;
+		materialBindSkipCount += other.materialBindSkipCount;
+		pipelineBindCount += other.pipelineBindCount;
+		setBindCount += other.setBindCount;
+		pushConstantCount += other.pushConstantCount;
+		triangleCount += other.triangleCount;
+
+		return *this;
+	}
+};
+
+// Draw items sorted by packed state key, so consecutive items share as much state as possible.
+class RenderQueue {
+private:
+	std::vector<DrawItem> _items;
+	std::vector<DrawItem> _scratch;
+	std::vector<DrawBatch> _batches;
+
+public:
+	// pipeline permutation | material | mesh | primitive, most significant first
+	static uint64_t makeKey(
+			uint32_t pipeline, ObjectID material, ObjectID mesh, uint32_t primitive);
+	// view distance | mesh | primitive, front to back for early depth rejection, distance is
+	// bucketed logarithmically so instances of a mesh at similar distance still batch
+	static uint64_t makeDepthKey(float distance, ObjectID mesh, uint32_t primitive);
+
+	void clear();
+	void add(const DrawItem &item);
+	void sort();
+
+	// merges sorted items into instanced batches, appends their transforms and material indices,
+	// and normal transforms when given
+	void batch(std::vector<InstanceTransform> &transforms, std::vector<uint32_t> &materials,
+			uint32_t maxTransforms, std::vector<InstanceTransform> *pNormals = nullptr);
+
+	const std::vector<DrawItem> &items() const;
+	const std::vector<DrawBatch> &batches() const;
+};
+
+#endif // !RENDER_QUEUE_H
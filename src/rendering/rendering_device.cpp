@@ -1,26 +1,57 @@
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
 
 #include <io/image.h>
+#include <profiler.h>
 
 #include "shaders/depth.gen.h"
+#include "shaders/gbuffer.gen.h"
+#include "shaders/gbuffer_bindless.gen.h"
+#include "shaders/lighting.gen.h"
 #include "shaders/material.gen.h"
+#include "shaders/material_bindless.gen.h"
 #include "shaders/sky.gen.h"
+#include "shaders/terrain.gen.h"
+#include "shaders/terrain_gbuffer.gen.h"
 #include "shaders/tonemap.gen.h"
 
 #include "types/allocated.h"
 #include "types/vertex.h"
 
 #include "effects/environment_effects.h"
+#include "effects/impostor_baker.h"
 
+#include "memory_tracker.h"
 #include "rendering_device.h"
 
-static vk::Format getVkFormat(Image::Format format) {
+static vk::Format getVkFormat(Image::Format format, bool isSrgb = false) {
+	if (isSrgb) {
+		switch (format) {
+			case Image::Format::RGBA8:
+				return vk::Format::eR8G8B8A8Srgb;
+			case Image::Format::BC1:
+				return vk::Format::eBc1RgbaSrgbBlock;
+			case Image::Format::BC7:
+				return vk::Format::eBc7SrgbBlock;
+			default:
+				break;
+		}
+	}
+
 	switch (format) {
 		case Image::Format::R8:
 			return vk::Format::eR8Unorm;
@@ -30,8 +61,18 @@ static vk::Format getVkFormat(Image::Format format) {
 			return vk::Format::eR8G8B8Unorm;
 		case Image::Format::RGBA8:
 			return vk::Format::eR8G8B8A8Unorm;
+		case Image::Format::RGBA16F:
+			return vk::Format::eR16G16B16A16Sfloat;
 		case Image::Format::RGBA32F:
 			return vk::Format::eR32G32B32A32Sfloat;
+		case Image::Format::BC1:
+			return vk::Format::eBc1RgbaUnormBlock;
+		case Image::Format::BC4:
+			return vk::Format::eBc4UnormBlock;
+		case Image::Format::BC5:
+			return vk::Format::eBc5UnormBlock;
+		case Image::Format::BC7:
+			return vk::Format::eBc7UnormBlock;
 		default:
 			return vk::Format::eUndefined;
 	}
@@ -45,27 +86,75 @@ vk::ShaderModule createShaderModule(vk::Device device, const uint32_t *pCode, si
 	return device.createShaderModule(createInfo);
 }
 
-void updateInputAttachment(vk::Device device, vk::ImageView imageView, vk::DescriptorSet dstSet) {
+void updateSceneColor(vk::Device device, vk::ImageView imageView, vk::Sampler sampler,
+		vk::DescriptorSet dstSet) {
 	vk::DescriptorImageInfo imageInfo;
 	imageInfo.setImageView(imageView);
 	imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	imageInfo.setSampler(VK_NULL_HANDLE);
+	imageInfo.setSampler(sampler);
 
 	vk::WriteDescriptorSet writeInfo;
 	writeInfo.setDstSet(dstSet);
 	writeInfo.setDstBinding(0);
 	writeInfo.setDstArrayElement(0);
-	writeInfo.setDescriptorType(vk::DescriptorType::eInputAttachment);
+	writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
 	writeInfo.setDescriptorCount(1);
 	writeInfo.setImageInfo(imageInfo);
 
 	device.updateDescriptorSets(writeInfo, nullptr);
 }
 
+void updateGBufferAttachments(
+		vk::Device device, const VulkanContext *pContext, vk::DescriptorSet dstSet) {
+	std::array<vk::DescriptorImageInfo, 4> imageInfos;
+	imageInfos[0].setImageView(pContext->getAlbedoAttachment().getImageView());
+	imageInfos[1].setImageView(pContext->getNormalAttachment().getImageView());
+	imageInfos[2].setImageView(pContext->getMaterialAttachment().getImageView());
+	imageInfos[3].setImageView(pContext->getDepthAttachment().getImageView());
+
+	std::array<vk::WriteDescriptorSet, 4> writeInfos;
+
+	for (uint32_t i = 0; i < writeInfos.size(); i++) {
+		imageInfos[i].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		imageInfos[i].setSampler(VK_NULL_HANDLE);
+
+		writeInfos[i].setDstSet(dstSet);
+		writeInfos[i].setDstBinding(i);
+		writeInfos[i].setDstArrayElement(0);
+		writeInfos[i].setDescriptorType(vk::DescriptorType::eInputAttachment);
+		writeInfos[i].setDescriptorCount(1);
+		writeInfos[i].setImageInfo(imageInfos[i]);
+	}
+
+	imageInfos[3].setImageLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+
+	device.updateDescriptorSets(writeInfos, nullptr);
+}
+
+void setViewport(vk::CommandBuffer commandBuffer, vk::Extent2D extent) {
+	vk::Viewport viewport;
+	viewport.setX(0.0f);
+	viewport.setY(0.0f);
+	viewport.setWidth(extent.width);
+	viewport.setHeight(extent.height);
+	viewport.setMinDepth(0.0f);
+	viewport.setMaxDepth(1.0f);
+
+	vk::Rect2D scissor;
+	scissor.setOffset({ 0, 0 });
+	scissor.setExtent(extent);
+
+	commandBuffer.setViewport(0, viewport);
+	commandBuffer.setScissor(0, scissor);
+}
+
 vk::Pipeline createPipeline(vk::Device device, vk::ShaderModule vertexStage,
 		vk::ShaderModule fragmentStage, vk::PipelineLayout pipelineLayout,
 		vk::RenderPass renderPass, uint32_t subpass,
-		vk::PipelineVertexInputStateCreateInfo vertexInput, bool writeDepth = false) {
+		vk::PipelineVertexInputStateCreateInfo vertexInput, bool writeDepth = false,
+		uint32_t colorAttachmentCount = 1,
+		const vk::SpecializationInfo *pFragmentSpecialization = nullptr,
+		bool useShadingRate = false) {
 	vk::PipelineShaderStageCreateInfo vertexStageInfo;
 	vertexStageInfo.setModule(vertexStage);
 	vertexStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
@@ -75,6 +164,7 @@ vk::Pipeline createPipeline(vk::Device device, vk::ShaderModule vertexStage,
 	fragmentStageInfo.setModule(fragmentStage);
 	fragmentStageInfo.setStage(vk::ShaderStageFlagBits::eFragment);
 	fragmentStageInfo.setPName("main");
+	fragmentStageInfo.setPSpecializationInfo(pFragmentSpecialization);
 
 	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertexStageInfo, fragmentStageInfo };
 
@@ -113,10 +203,13 @@ vk::Pipeline createPipeline(vk::Device device, vk::ShaderModule vertexStage,
 	colorBlendAttachment.setColorWriteMask(colorWriteMask);
 	colorBlendAttachment.setBlendEnable(VK_FALSE);
 
+	std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachments(
+			colorAttachmentCount, colorBlendAttachment);
+
 	vk::PipelineColorBlendStateCreateInfo colorBlending;
 	colorBlending.setLogicOpEnable(VK_FALSE);
 	colorBlending.setLogicOp(vk::LogicOp::eCopy);
-	colorBlending.setAttachments(colorBlendAttachment);
+	colorBlending.setAttachments(colorBlendAttachments);
 	colorBlending.setBlendConstants({ 0.0f, 0.0f, 0.0f, 0.0f });
 
 	std::vector<vk::DynamicState> dynamicStates = {
@@ -124,6 +217,10 @@ vk::Pipeline createPipeline(vk::Device device, vk::ShaderModule vertexStage,
 		vk::DynamicState::eScissor,
 	};
 
+	// set by draws, rates of later pipelines carry over
+	if (useShadingRate)
+		dynamicStates.push_back(vk::DynamicState::eFragmentShadingRateKHR);
+
 	vk::PipelineDynamicStateCreateInfo dynamicState;
 	dynamicState.setDynamicStates(dynamicStates);
 
@@ -141,7 +238,8 @@ vk::Pipeline createPipeline(vk::Device device, vk::ShaderModule vertexStage,
 	createInfo.setRenderPass(renderPass);
 	createInfo.setSubpass(subpass);
 
-	vk::ResultValue<vk::Pipeline> result = device.createGraphicsPipeline(nullptr, createInfo);
+	vk::ResultValue<vk::Pipeline> result = device.createGraphicsPipeline(
+			RD::getSingleton().getPipelineCache(), createInfo);
 
 	if (result.result != vk::Result::eSuccess)
 		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Graphics pipeline creation failed!");
@@ -149,6 +247,63 @@ vk::Pipeline createPipeline(vk::Device device, vk::ShaderModule vertexStage,
 	return result.value;
 }
 
+// writes material textures from consecutive image infos, pushed ones into set of pipeline layout
+static vk::DescriptorUpdateTemplate _createTextureTemplate(vk::Device device,
+		vk::DescriptorSetLayout setLayout, vk::DescriptorUpdateTemplateType type,
+		vk::PipelineLayout pipelineLayout) {
+	std::array<vk::DescriptorUpdateTemplateEntry, MATERIAL_TEXTURE_COUNT> entries;
+
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		entries[i].setDstBinding(i);
+		entries[i].setDstArrayElement(0);
+		entries[i].setDescriptorCount(1);
+		entries[i].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		entries[i].setOffset(i * sizeof(vk::DescriptorImageInfo));
+		entries[i].setStride(sizeof(vk::DescriptorImageInfo));
+	}
+
+	vk::DescriptorUpdateTemplateCreateInfo templateInfo = {};
+	templateInfo.setDescriptorUpdateEntries(entries);
+	templateInfo.setTemplateType(type);
+	templateInfo.setDescriptorSetLayout(setLayout);
+
+	if (type == vk::DescriptorUpdateTemplateType::ePushDescriptorsKHR) {
+		templateInfo.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+		templateInfo.setPipelineLayout(pipelineLayout);
+		templateInfo.setSet(MATERIAL_TEXTURE_SET);
+	}
+
+	return device.createDescriptorUpdateTemplate(templateInfo);
+}
+
+// code comes from shader library, modules are destroyed once pipeline is built
+static vk::Pipeline _buildPipeline(vk::Device device, const std::string &shader,
+		const uint32_t *pVertexCode, size_t vertexCodeSize, const uint32_t *pFragmentCode,
+		size_t fragmentCodeSize, vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass,
+		uint32_t subpass, vk::PipelineVertexInputStateCreateInfo vertexInput,
+		bool writeDepth = false, uint32_t colorAttachmentCount = 1,
+		const vk::SpecializationInfo *pFragmentSpecialization = nullptr,
+		bool useShadingRate = false) {
+	std::vector<uint32_t> vertexCode =
+			ShaderLibrary::getCode(shader, ShaderStage::Vertex, pVertexCode, vertexCodeSize);
+	std::vector<uint32_t> fragmentCode =
+			ShaderLibrary::getCode(shader, ShaderStage::Fragment, pFragmentCode, fragmentCodeSize);
+
+	vk::ShaderModule vertexStage = createShaderModule(
+			device, vertexCode.data(), vertexCode.size() * sizeof(uint32_t));
+	vk::ShaderModule fragmentStage = createShaderModule(
+			device, fragmentCode.data(), fragmentCode.size() * sizeof(uint32_t));
+
+	vk::Pipeline pipeline = createPipeline(device, vertexStage, fragmentStage, pipelineLayout,
+			renderPass, subpass, vertexInput, writeDepth, colorAttachmentCount,
+			pFragmentSpecialization, useShadingRate);
+
+	device.destroyShaderModule(vertexStage);
+	device.destroyShaderModule(fragmentStage);
+
+	return pipeline;
+}
+
 vk::CommandBuffer RD::beginSingleTimeCommands() {
 	vk::CommandBufferAllocateInfo allocInfo;
 	allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
@@ -170,23 +325,32 @@ void RD::endSingleTimeCommands(vk::CommandBuffer commandBuffer) {
 	submitInfo.setCommandBufferCount(1);
 	submitInfo.setCommandBuffers(commandBuffer);
 
-	_pContext->getGraphicsQueue().submit(submitInfo, VK_NULL_HANDLE);
-	_pContext->getGraphicsQueue().waitIdle();
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		_pContext->getGraphicsQueue().submit(submitInfo, VK_NULL_HANDLE);
+		_pContext->getGraphicsQueue().waitIdle();
+	}
 
+	_singleTimeSubmitCount++;
 	_pContext->getDevice().freeCommandBuffers(_pContext->getCommandPool(), commandBuffer);
 }
 
-AllocatedBuffer RD::bufferCreate(
+uint64_t RD::getSingleTimeSubmitCount() const {
+	return _singleTimeSubmitCount;
+}
+
+AllocatedBuffer RD::bufferCreate(MemoryCategory category, BufferClass bufferClass,
 		vk::BufferUsageFlags usage, vk::DeviceSize size, VmaAllocationInfo *pAllocInfo) {
-	return AllocatedBuffer::create(_allocator, usage, size, pAllocInfo);
+	return AllocatedBuffer::create(_allocator, category, bufferClass, usage, size, pAllocInfo);
 }
 
-void RD::bufferCopy(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
+void RD::bufferCopy(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size,
+		vk::DeviceSize srcOffset, vk::DeviceSize dstOffset) {
 	vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
 
 	vk::BufferCopy bufferCopy;
-	bufferCopy.setSrcOffset(0);
-	bufferCopy.setDstOffset(0);
+	bufferCopy.setSrcOffset(srcOffset);
+	bufferCopy.setDstOffset(dstOffset);
 	bufferCopy.setSize(size);
 
 	commandBuffer.copyBuffer(srcBuffer, dstBuffer, bufferCopy);
@@ -217,33 +381,41 @@ void RD::bufferCopyToImage(vk::Buffer buffer, vk::Image image, uint32_t width, u
 	endSingleTimeCommands(commandBuffer);
 }
 
-void RD::bufferSend(vk::Buffer dstBuffer, uint8_t *pData, size_t size) {
-	vk::BufferUsageFlagBits usage = vk::BufferUsageFlagBits::eTransferSrc;
-
-	VmaAllocationInfo stagingAllocInfo;
-	AllocatedBuffer stagingBuffer = bufferCreate(usage, size, &stagingAllocInfo);
+void RD::bufferSend(
+		vk::Buffer dstBuffer, uint8_t *pData, size_t size, vk::DeviceSize dstOffset) {
+	_uploadManager.bufferUpload(dstBuffer, pData, size, dstOffset);
+}
 
-	memcpy(stagingAllocInfo.pMappedData, pData, size);
-	vmaFlushAllocation(_allocator, stagingBuffer.allocation, 0, VK_WHOLE_SIZE);
-	bufferCopy(stagingBuffer.buffer, dstBuffer, size);
+void RD::bufferInvalidate(AllocatedBuffer buffer) {
+	vmaInvalidateAllocation(_allocator, buffer.allocation, 0, VK_WHOLE_SIZE);
+}
 
-	vmaDestroyBuffer(_allocator, stagingBuffer.buffer, stagingBuffer.allocation);
+void RD::bufferFlush(AllocatedBuffer buffer) {
+	vmaFlushAllocation(_allocator, buffer.allocation, 0, VK_WHOLE_SIZE);
 }
 
 void RD::bufferDestroy(AllocatedBuffer buffer) {
+	MemoryTracker::untrack(buffer.allocation);
 	vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
 }
 
-AllocatedImage RD::imageCreate(uint32_t width, uint32_t height, vk::Format format,
-		uint32_t mipLevels, vk::ImageUsageFlags usage) {
-	return AllocatedImage::create(_allocator, width, height, mipLevels, 1, format, usage);
+AllocatedImage RD::imageCreate(MemoryCategory category, uint32_t width, uint32_t height,
+		vk::Format format, uint32_t mipLevels, vk::ImageUsageFlags usage) {
+	return AllocatedImage::create(
+			_allocator, category, width, height, mipLevels, 1, format, usage);
+}
+
+AllocatedImage RD::imageCubeCreate(MemoryCategory category, uint32_t size, vk::Format format,
+		uint32_t mipLevels, vk::ImageUsageFlags usage, uint32_t cubeCount) {
+	uint32_t arrayLayers = 6 * cubeCount;
+	return AllocatedImage::create(_allocator, category, size, size, mipLevels, arrayLayers,
+			format, usage, vk::ImageCreateFlagBits::eCubeCompatible);
 }
 
-AllocatedImage RD::imageCubeCreate(
-		uint32_t size, vk::Format format, uint32_t mipLevels, vk::ImageUsageFlags usage) {
-	uint32_t arrayLayers = 6;
-	return AllocatedImage::create(_allocator, size, size, mipLevels, arrayLayers, format, usage,
-			vk::ImageCreateFlagBits::eCubeCompatible);
+AllocatedImage RD::imageVolumeCreate(MemoryCategory category, uint32_t width, uint32_t height,
+		uint32_t depth, vk::Format format, vk::ImageUsageFlags usage) {
+	return AllocatedImage::create(_allocator, category, width, height, 1, 1, format, usage, {},
+			VK_NULL_HANDLE, depth);
 }
 
 void RD::imageGenerateMipmaps(vk::Image image, int32_t width, int32_t height, vk::Format format,
@@ -256,7 +428,12 @@ void RD::imageGenerateMipmaps(vk::Image image, int32_t width, int32_t height, vk
 	assert(isBlittingSupported);
 
 	vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
+	imageGenerateMipmaps(commandBuffer, image, width, height, format, mipLevels, arrayLayers);
+	endSingleTimeCommands(commandBuffer);
+}
 
+void RD::imageGenerateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, int32_t width,
+		int32_t height, vk::Format format, uint32_t mipLevels, uint32_t arrayLayers) {
 	vk::ImageSubresourceRange subresourceRange;
 	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
 	subresourceRange.setLevelCount(1);
@@ -336,8 +513,6 @@ void RD::imageGenerateMipmaps(vk::Image image, int32_t width, int32_t height, vk
 
 	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
 			vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
 void RD::imageLayoutTransition(vk::Image image, vk::Format format, uint32_t mipLevels,
@@ -417,7 +592,8 @@ void RD::imageSend(vk::Image image, uint32_t width, uint32_t height, uint8_t *pD
 	VmaAllocationInfo stagingAllocInfo;
 	vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eTransferSrc;
 
-	AllocatedBuffer stagingBuffer = bufferCreate(usage, size, &stagingAllocInfo);
+	AllocatedBuffer stagingBuffer = bufferCreate(
+			MemoryCategory::Staging, BufferClass::Staging, usage, size, &stagingAllocInfo);
 	memcpy(stagingAllocInfo.pMappedData, pData, size);
 	vmaFlushAllocation(_allocator, stagingBuffer.allocation, 0, VK_WHOLE_SIZE);
 
@@ -427,6 +603,7 @@ void RD::imageSend(vk::Image image, uint32_t width, uint32_t height, uint8_t *pD
 }
 
 void RD::imageDestroy(AllocatedImage image) {
+	MemoryTracker::untrack(image.allocation);
 	vmaDestroyImage(_allocator, image.image, image.allocation);
 }
 
@@ -452,18 +629,27 @@ void RD::imageViewDestroy(vk::ImageView imageView) {
 	_pContext->getDevice().destroyImageView(imageView);
 }
 
-vk::Sampler RD::samplerCreate(vk::Filter filter, vk::SamplerAddressMode repeatMode,
-		uint32_t mipLevels, float mipLodBias) {
+vk::Sampler RD::samplerGet(vk::Filter filter, vk::SamplerAddressMode addressMode,
+		float mipLodBias, bool anisotropy) {
+	SamplerKey key = { filter, addressMode, mipLodBias, anisotropy };
+
+	// textures created on loader threads look theirs up too
+	std::lock_guard<std::mutex> lock(_samplerMutex);
+
+	std::map<SamplerKey, vk::Sampler>::iterator it = _samplers.find(key);
+	if (it != _samplers.end())
+		return it->second;
+
 	vk::PhysicalDeviceProperties properties = _pContext->getPhysicalDevice().getProperties();
-	float maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+	float maxAnisotropy = anisotropy ? properties.limits.maxSamplerAnisotropy : 1.0f;
 
 	vk::SamplerCreateInfo createInfo;
 	createInfo.setMagFilter(filter);
 	createInfo.setMinFilter(filter);
-	createInfo.setAddressModeU(repeatMode);
-	createInfo.setAddressModeV(repeatMode);
-	createInfo.setAddressModeW(repeatMode);
-	createInfo.setAnisotropyEnable(true);
+	createInfo.setAddressModeU(addressMode);
+	createInfo.setAddressModeV(addressMode);
+	createInfo.setAddressModeW(addressMode);
+	createInfo.setAnisotropyEnable(anisotropy);
 	createInfo.setMaxAnisotropy(maxAnisotropy);
 	createInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
 	createInfo.setUnnormalizedCoordinates(false);
@@ -471,570 +657,2315 @@ vk::Sampler RD::samplerCreate(vk::Filter filter, vk::SamplerAddressMode repeatMo
 	createInfo.setCompareOp(vk::CompareOp::eAlways);
 	createInfo.setMipmapMode(vk::SamplerMipmapMode::eLinear);
 	createInfo.setMinLod(0.0f);
-	createInfo.setMaxLod(static_cast<float>(mipLevels));
+	createInfo.setMaxLod(VK_LOD_CLAMP_NONE);
 	createInfo.setMipLodBias(mipLodBias);
 
-	return _pContext->getDevice().createSampler(createInfo);
-}
+	vk::Sampler sampler = _pContext->getDevice().createSampler(createInfo);
+	_samplers[key] = sampler;
 
-void RD::samplerDestroy(vk::Sampler sampler) {
-	_pContext->getDevice().destroySampler(sampler);
+	return sampler;
 }
 
-TextureRD RD::textureCreate(std::shared_ptr<Image> image) {
-	uint32_t width = image->getWidth();
-	uint32_t height = image->getHeight();
-
-	vk::Format format = getVkFormat(image->getFormat());
-	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+bool RD::isTextureFormatSupported(Image::Format format) const {
+	vk::FormatProperties properties =
+			_pContext->getPhysicalDevice().getFormatProperties(getVkFormat(format));
 
-	AllocatedImage allocatedImage = imageCreate(width, height, format, mipLevels,
-			vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst |
-					vk::ImageUsageFlagBits::eSampled);
+	return (bool)(properties.optimalTilingFeatures &
+				  vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+}
 
-	std::vector<uint8_t> data = image->getData();
+// nanoseconds low latency mode waits for previous frame to be shown
+const uint64_t PRESENT_WAIT_TIMEOUT = 100000000;
 
-	VmaAllocationInfo stagingAllocInfo;
-	AllocatedBuffer stagingBuffer =
-			bufferCreate(vk::BufferUsageFlagBits::eTransferSrc, data.size(), &stagingAllocInfo);
-	memcpy(stagingAllocInfo.pMappedData, data.data(), data.size());
-	vmaFlushAllocation(_allocator, stagingBuffer.allocation, 0, VK_WHOLE_SIZE);
+// material sets per pool of texture set allocator
+const uint32_t TEXTURE_SET_POOL_SET_COUNT = 256;
 
-	imageLayoutTransition(allocatedImage.image, format, mipLevels, 1, vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eTransferDstOptimal);
+// generated levels are written by compute when format allows it, see MipGenerator
+static const vk::ImageUsageFlags TEXTURE_USAGE = vk::ImageUsageFlagBits::eTransferSrc |
+		vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
 
-	bufferCopyToImage(stagingBuffer.buffer, allocatedImage.image, width, height);
+TextureRD RD::textureCreate(std::shared_ptr<Image> image, uint32_t baseLevel) {
+	PROFILE_ZONE("texture create");
 
-	bufferDestroy(stagingBuffer);
+	uint32_t fullWidth = image->getWidth();
+	uint32_t fullHeight = image->getHeight();
 
-	// Transfers image layout to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-	imageGenerateMipmaps(allocatedImage.image, width, height, format, mipLevels);
+	uint32_t width = std::max(fullWidth >> baseLevel, 1u);
+	uint32_t height = std::max(fullHeight >> baseLevel, 1u);
 
-	vk::ImageView imageView = imageViewCreate(allocatedImage.image, format, mipLevels);
-	vk::Sampler sampler =
-			samplerCreate(vk::Filter::eLinear, vk::SamplerAddressMode::eRepeat, mipLevels);
+	Image::Format imageFormat = image->getFormat();
+	vk::Format format = getVkFormat(imageFormat, image->isSrgb());
 
-	return {
-		allocatedImage,
-		imageView,
-		sampler,
-	};
-}
+	assert(baseLevel < image->getMipLevels());
 
-void RD::textureDestroy(TextureRD texture) {
-	imageDestroy(texture.image);
-	imageViewDestroy(texture.imageView);
-	samplerDestroy(texture.sampler);
-}
+	// pre-built levels are uploaded as they are, compressed images without them get none
+	uint32_t mipLevels = image->getMipLevels() - baseLevel;
+	std::vector<vk::DeviceSize> levelOffsets(mipLevels);
 
-void RD::environmentSkyUpdate(const std::shared_ptr<Image> image) {
-	uint32_t width = image->getWidth();
-	uint32_t height = image->getHeight();
+	uint64_t baseOffset = Image::getLevelOffset(imageFormat, fullWidth, fullHeight, baseLevel);
 
-	vk::Format format = vk::Format::eR32G32B32A32Sfloat;
-	std::vector<uint8_t> data = image->getData();
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		levelOffsets[level] =
+				Image::getLevelOffset(imageFormat, fullWidth, fullHeight, baseLevel + level) -
+				baseOffset;
+	}
 
-	uint32_t size = std::min(width, height);
-	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(size))) + 1;
+	if (mipLevels == 1 && !Image::isFormatCompressed(imageFormat))
+		mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 
-	AllocatedImage staging = imageCreate(width, height, format, 1,
-			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eStorage);
+	vk::ImageUsageFlags usage = TEXTURE_USAGE;
 
-	imageLayoutTransition(
-			staging.image, format, 1, 1, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+	if (levelOffsets.size() < mipLevels && _mipGenerator.isSupported(format, width, height))
+		usage |= vk::ImageUsageFlagBits::eStorage;
 
-	imageSend(staging.image, width, height, data.data(), data.size(), vk::ImageLayout::eGeneral);
+	AllocatedImage allocatedImage = AllocatedImage::create(_allocator, MemoryCategory::Texture,
+			width, height, mipLevels, 1, format, usage, {}, _texturePool);
 
-	vk::ImageView stagingView = imageViewCreate(staging.image, format, 1);
+	const std::vector<uint8_t> &data = image->getData();
 
-	AllocatedImage cubemap = _environmentEffects.cubemapCreate(stagingView, size);
+	assert(isTextureFormatSupported(imageFormat));
 
-	vk::ImageView cubemapView =
-			imageViewCreate(cubemap.image, format, mipLevels, 6, vk::ImageViewType::eCube);
+	// image is usable by frames submitted after this call
+	_uploadManager.imageUpload(allocatedImage.image, width, height, format, mipLevels,
+			data.data() + baseOffset, data.size() - baseOffset, levelOffsets);
 
-	vk::Sampler cubemapSampler =
-			samplerCreate(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, mipLevels);
+	vk::ImageView imageView = imageViewCreate(allocatedImage.image, format, mipLevels);
+	vk::Sampler sampler = samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eRepeat);
 
-	AllocatedImage irradiance = _environmentEffects.filterIrradiance(cubemapView);
-	vk::ImageView irradianceView =
-			imageViewCreate(irradiance.image, format, 1, 6, vk::ImageViewType::eCube);
-	vk::Sampler irradianceSampler =
-			samplerCreate(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, 1);
+	uint32_t bindlessIndex = 0;
 
-	AllocatedImage specular = _environmentEffects.filterSpecular(cubemapView, size, mipLevels);
-	vk::ImageView specularView =
-			imageViewCreate(specular.image, format, 5, 6, vk::ImageViewType::eCube);
-	vk::Sampler specularSampler =
-			samplerCreate(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, 5);
+	if (isBindlessEnabled())
+		bindlessIndex = _bindlessStorage.textureAdd(imageView, sampler);
 
-	{
-		vk::DescriptorImageInfo imageInfo;
-		imageInfo.setImageView(cubemapView);
-		imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-		imageInfo.setSampler(cubemapSampler);
+	TextureRD texture = {};
+	texture.image = allocatedImage;
+	texture.imageView = imageView;
+	texture.sampler = sampler;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	texture.mipLevels = mipLevels;
+	texture.usage = usage;
+	texture.bindlessIndex = bindlessIndex;
 
-		vk::WriteDescriptorSet writeInfo;
-		writeInfo.setDstSet(_skySet);
-		writeInfo.setDstBinding(0);
-		writeInfo.setDstArrayElement(0);
-		writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		writeInfo.setDescriptorCount(1);
-		writeInfo.setImageInfo(imageInfo);
+	return texture;
+}
 
-		_pContext->getDevice().updateDescriptorSets(writeInfo, nullptr);
-	}
+void RD::textureDestroy(TextureRD texture) {
+	if (isBindlessEnabled())
+		_bindlessStorage.textureRemove(texture.bindlessIndex);
 
-	{
-		vk::DescriptorImageInfo irradianceImageInfo;
-		irradianceImageInfo.setImageView(irradianceView);
-		irradianceImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-		irradianceImageInfo.setSampler(irradianceSampler);
-
-		vk::DescriptorImageInfo specularImageInfo;
-		specularImageInfo.setImageView(specularView);
-		specularImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-		specularImageInfo.setSampler(specularSampler);
-
-		vk::WriteDescriptorSet irradianceWriteInfo;
-		irradianceWriteInfo.setDstSet(_iblSet);
-		irradianceWriteInfo.setDstBinding(0);
-		irradianceWriteInfo.setDstArrayElement(0);
-		irradianceWriteInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		irradianceWriteInfo.setDescriptorCount(1);
-		irradianceWriteInfo.setImageInfo(irradianceImageInfo);
-
-		vk::WriteDescriptorSet specularWriteInfo;
-		specularWriteInfo.setDstSet(_iblSet);
-		specularWriteInfo.setDstBinding(1);
-		specularWriteInfo.setDstArrayElement(0);
-		specularWriteInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		specularWriteInfo.setDescriptorCount(1);
-		specularWriteInfo.setImageInfo(specularImageInfo);
-
-		std::array<vk::WriteDescriptorSet, 2> writeInfos = {
-			irradianceWriteInfo,
-			specularWriteInfo,
-		};
+	imageDestroy(texture.image);
+	imageViewDestroy(texture.imageView);
+}
 
-		_pContext->getDevice().updateDescriptorSets(writeInfos, nullptr);
-	}
+TextureRD RD::textureCreateMoved(const TextureRD &texture, VmaAllocation allocation) {
+	vk::ImageCreateInfo createInfo = {};
+	createInfo.setImageType(vk::ImageType::e2D);
+	createInfo.setExtent(vk::Extent3D(texture.width, texture.height, 1));
+	createInfo.setMipLevels(texture.mipLevels);
+	createInfo.setArrayLayers(1);
+	createInfo.setFormat(texture.format);
+	createInfo.setTiling(vk::ImageTiling::eOptimal);
+	createInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+	createInfo.setUsage(texture.usage);
+	createInfo.setSamples(vk::SampleCountFlagBits::e1);
+	createInfo.setSharingMode(vk::SharingMode::eExclusive);
+
+	vk::Image image = _pContext->getDevice().createImage(createInfo);
+
+	if (vmaBindImageMemory(_allocator, allocation, image) != VK_SUCCESS)
+		throw std::runtime_error("Moved texture memory binding failed!");
+
+	// allocation of source holds moved memory once defragmentation pass ends
+	TextureRD moved = texture;
+	moved.image.image = image;
+	moved.imageView = imageViewCreate(image, texture.format, texture.mipLevels);
+
+	if (isBindlessEnabled())
+		moved.bindlessIndex = _bindlessStorage.textureAdd(moved.imageView, moved.sampler);
+
+	return moved;
+}
 
-	{
-		EnvironmentData data = _environmentData;
-
-		imageDestroy(data.cubemap);
-		imageViewDestroy(data.cubemapView);
-		samplerDestroy(data.cubemapSampler);
-
-		imageDestroy(data.irradiance);
-		imageViewDestroy(data.irradianceView);
-		samplerDestroy(data.irradianceSampler);
-
-		imageDestroy(data.specular);
-		imageViewDestroy(data.specularView);
-		samplerDestroy(data.specularSampler);
-
-		_environmentData = {
-			cubemap,
-			cubemapView,
-			cubemapSampler,
-			irradiance,
-			irradianceView,
-			irradianceSampler,
-			specular,
-			specularView,
-			specularSampler,
-		};
+void RD::textureRecordMove(
+		vk::CommandBuffer commandBuffer, const TextureRD &src, const TextureRD &dst) {
+	vk::ImageSubresourceRange subresourceRange = {};
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(0);
+	subresourceRange.setLevelCount(src.mipLevels);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(1);
+
+	// earlier frames only sampled source, it is not sampled after copy
+	std::array<vk::ImageMemoryBarrier, 2> barriers = {};
+	barriers[0].setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barriers[0].setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+	barriers[0].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+	barriers[0].setImage(src.image.image);
+	barriers[0].setSubresourceRange(subresourceRange);
+
+	barriers[1].setOldLayout(vk::ImageLayout::eUndefined);
+	barriers[1].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barriers[1].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barriers[1].setImage(dst.image.image);
+	barriers[1].setSubresourceRange(subresourceRange);
+
+	for (vk::ImageMemoryBarrier &barrier : barriers) {
+		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
 	}
-}
 
-void RD::updateUniformBuffer(const glm::vec3 &viewPosition) {
-	UniformBufferObject ubo{};
-	ubo.viewPosition = viewPosition;
-	ubo.directionalLightCount = _lightStorage.getDirectionalLightCount();
-	ubo.pointLightCount = _lightStorage.getPointLightCount();
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barriers);
 
-	memcpy(_uniformAllocInfos[_frame].pMappedData, &ubo, sizeof(ubo));
-}
+	std::vector<vk::ImageCopy> regions(src.mipLevels);
 
-LightStorage &RD::getLightStorage() {
-	return _lightStorage;
-}
+	for (uint32_t level = 0; level < src.mipLevels; level++) {
+		vk::ImageSubresourceLayers layers = {};
+		layers.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		layers.setMipLevel(level);
+		layers.setBaseArrayLayer(0);
+		layers.setLayerCount(1);
 
-vk::Instance RD::getInstance() const {
-	return _pContext->getInstance();
-}
+		regions[level].setSrcSubresource(layers);
+		regions[level].setDstSubresource(layers);
+		regions[level].setExtent(vk::Extent3D(
+				std::max(src.width >> level, 1u), std::max(src.height >> level, 1u), 1));
+	}
 
-vk::PhysicalDevice RD::getPhysicalDevice() const {
-	return _pContext->getPhysicalDevice();
-}
+	commandBuffer.copyImage(src.image.image, vk::ImageLayout::eTransferSrcOptimal,
+			dst.image.image, vk::ImageLayout::eTransferDstOptimal, regions);
 
-vk::Device RD::getDevice() const {
-	return _pContext->getDevice();
-}
+	vk::ImageMemoryBarrier barrier = {};
+	barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setImage(dst.image.image);
+	barrier.setSubresourceRange(subresourceRange);
 
-vk::Extent2D RD::getSwapchainExtent() const {
-	return _pContext->getSwapchainExtent();
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
 }
 
-vk::PipelineLayout RD::getDepthPipelineLayout() const {
-	return _depthLayout;
-}
+void RD::textureDestroyMoved(TextureRD texture) {
+	if (isBindlessEnabled())
+		_bindlessStorage.textureRemove(texture.bindlessIndex);
 
-vk::Pipeline RD::getDepthPipeline() const {
-	return _depthPipeline;
+	imageViewDestroy(texture.imageView);
+	_pContext->getDevice().destroyImage(texture.image.image);
 }
 
-vk::PipelineLayout RD::getSkyPipelineLayout() const {
-	return _skyLayout;
+void RD::destroyDeferred(const std::function<void()> &destroy) {
+	_deletionQueue.push_back({ _frameNumber, destroy });
 }
 
-vk::Pipeline RD::getSkyPipeline() const {
-	return _skyPipeline;
-}
+void RD::_environmentUpdate(vk::CommandBuffer commandBuffer) {
+	EnvironmentData data;
 
-vk::DescriptorSet RD::getSkySet() const {
-	return _skySet;
-}
+	bool isBaked = _environmentEffects.bakePoll(commandBuffer, data);
 
-vk::PipelineLayout RD::getMaterialPipelineLayout() const {
-	return _materialLayout;
-}
+	if (isBaked && _reflectionProbeBake >= 0) {
+		uint32_t index = static_cast<uint32_t>(_reflectionProbeBake);
+		_reflectionProbeBake = -1;
 
-vk::Pipeline RD::getMaterialPipeline() const {
-	return _materialPipeline;
-}
+		if (_reflectionProbes[index].version == _reflectionProbeBakeVersion) {
+			_reflectionProbeCopy(commandBuffer, data, index);
+			_reflectionProbes[index].isBaked = true;
+			_reflectionProbeBufferUpdate();
+		}
 
-std::array<vk::DescriptorSet, 3> RD::getMaterialSets() const {
-	return { _uniformSets[_frame], _iblSet, _lightStorage.getLightSet() };
-}
+		// copy is recorded in this frame
+		destroyDeferred([this, data]() {
+			imageDestroy(data.cubemap);
+			imageViewDestroy(data.cubemapView);
 
-vk::DescriptorPool RD::getDescriptorPool() const {
-	return _descriptorPool;
-}
+			imageDestroy(data.specular);
+			imageViewDestroy(data.specularView);
+		});
+	} else if (isBaked) {
+		EnvironmentData old = _environmentData;
 
-vk::DescriptorSetLayout RD::getTextureLayout() const {
-	return _textureLayout;
-}
+		// earlier frames in flight still sample previous environment
+		destroyDeferred([this, old]() {
+			imageDestroy(old.cubemap);
+			imageViewDestroy(old.cubemapView);
 
-void RD::setExposure(float exposure) {
-	_exposure = exposure;
-}
+			imageDestroy(old.specular);
+			imageViewDestroy(old.specularView);
+		});
 
-void RD::setWhite(float white) {
-	_white = white;
-}
+		_environmentData = data;
+		_environmentVersion++;
+	}
 
-vk::CommandBuffer RD::drawBegin() {
-	vk::CommandBuffer commandBuffer = _commandBuffers[_frame];
+	bool isProgressive = _isPendingSkyProgressive;
 
-	vk::Result result = _pContext->getDevice().waitForFences(_fences[_frame], VK_TRUE, UINT64_MAX);
+	if (_pendingSky != nullptr && _environmentEffects.bakeBegin(_pendingSky, isProgressive))
+		_pendingSky = nullptr;
+	else if (_pendingSky == nullptr)
+		_reflectionProbeBakeNext();
 
-	if (result != vk::Result::eSuccess)
-		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for fences failed!");
+	// fence of this frame signaled, irradiance it projected is readable
+	if (_skyAtmosphere.collect(_frame))
+		_environmentVersion++;
 
-	vk::ResultValue<uint32_t> image = _pContext->getDevice().acquireNextImageKHR(
-			_pContext->getSwapchain(), UINT64_MAX, _presentSemaphores[_frame], VK_NULL_HANDLE);
+	if (_isAtmosphere && _skyAtmosphere.isStale()) {
+		uint32_t atmosphereScope = _gpuProfiler.scopeCreate("sky atmosphere");
+		_gpuProfiler.scopeBegin(commandBuffer, atmosphereScope);
 
-	_imageIndex = image.value;
+		_skyAtmosphere.record(commandBuffer, _frame);
 
-	if (image.result == vk::Result::eErrorOutOfDateKHR) {
-		_pContext->recreateSwapchain(_width, _height);
-		updateInputAttachment(_pContext->getDevice(),
-				_pContext->getColorAttachment().getImageView(), _inputAttachmentSet);
-	} else if (image.result != vk::Result::eSuccess && image.result != vk::Result::eSuboptimalKHR) {
-		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Swapchain image acquire failed!");
+		_gpuProfiler.scopeEnd(commandBuffer, atmosphereScope);
 	}
 
-	_pContext->getDevice().resetFences(_fences[_frame]);
+	const EnvironmentData &environment = _getEnvironment();
 
-	_lightStorage.update();
+	// probes set before first bake wait for it, views are not there yet
+	if (_environmentSetVersions[_frame] == _environmentVersion || !environment.cubemapView)
+		return;
 
-	commandBuffer.reset();
+	// sets of this frame are no longer in use, other frames switch once they begin
+	vk::DescriptorImageInfo cubemapImageInfo;
+	cubemapImageInfo.setImageView(environment.cubemapView);
+	cubemapImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	cubemapImageInfo.setSampler(environment.cubemapSampler);
+
+	vk::DescriptorImageInfo specularImageInfo;
+	specularImageInfo.setImageView(environment.specularView);
+	specularImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	specularImageInfo.setSampler(environment.specularSampler);
+
+	vk::DescriptorBufferInfo probeBufferInfo = _probeBuffer.getBufferInfo();
+	vk::DescriptorBufferInfo reflectionProbeBufferInfo = _reflectionProbeBuffer.getBufferInfo();
+
+	std::array<vk::WriteDescriptorSet, 4> writeInfos;
+
+	writeInfos[0].setDstSet(_skySets[_frame]);
+	writeInfos[0].setDstBinding(0);
+	writeInfos[0].setDstArrayElement(0);
+	writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfos[0].setDescriptorCount(1);
+	writeInfos[0].setImageInfo(cubemapImageInfo);
+
+	writeInfos[1].setDstSet(_iblSets[_frame]);
+	writeInfos[1].setDstBinding(0);
+	writeInfos[1].setDstArrayElement(0);
+	writeInfos[1].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfos[1].setDescriptorCount(1);
+	writeInfos[1].setImageInfo(specularImageInfo);
+
+	writeInfos[2].setDstSet(_iblSets[_frame]);
+	writeInfos[2].setDstBinding(2);
+	writeInfos[2].setDstArrayElement(0);
+	writeInfos[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[2].setDescriptorCount(1);
+	writeInfos[2].setBufferInfo(probeBufferInfo);
+
+	writeInfos[3].setDstSet(_iblSets[_frame]);
+	writeInfos[3].setDstBinding(4);
+	writeInfos[3].setDstArrayElement(0);
+	writeInfos[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[3].setDescriptorCount(1);
+	writeInfos[3].setBufferInfo(reflectionProbeBufferInfo);
+
+	_pContext->getDevice().updateDescriptorSets(writeInfos, nullptr);
+
+	// uniform buffers of this frame were written before the switch
+	for (uint32_t i = 0; i < MAX_VIEW_COUNT; i++) {
+		uint8_t *pUniform = reinterpret_cast<uint8_t *>(_uniformAllocInfos[_frame][i].pMappedData);
+		memcpy(pUniform + offsetof(UniformBufferObject, irradianceSH),
+				environment.irradianceSH.data(), sizeof(UniformBufferObject::irradianceSH));
+	}
 
-	vk::CommandBufferBeginInfo beginInfo{};
+	_environmentSetVersions[_frame] = _environmentVersion;
+}
 
-	commandBuffer.begin(beginInfo);
+const EnvironmentData &RD::_getEnvironment() const {
+	return _isAtmosphere ? _skyAtmosphere.getEnvironment() : _environmentData;
+}
 
-	std::array<vk::ClearValue, 3> clearValues;
-	clearValues[0] = vk::ClearValue();
-	clearValues[1].color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
-	clearValues[2].depthStencil = vk::ClearDepthStencilValue(0.0f, 0);
+void RD::_reflectionProbeBakeNext() {
+	if (_reflectionProbeBake >= 0 || _environmentEffects.isBaking())
+		return;
 
-	vk::Extent2D extent = _pContext->getSwapchainExtent();
+	for (uint32_t i = 0; i < MAX_REFLECTION_PROBE_COUNT; i++) {
+		ReflectionProbeSlot &slot = _reflectionProbes[i];
 
-	vk::Viewport viewport;
-	viewport.setX(0.0f);
-	viewport.setY(0.0f);
-	viewport.setWidth(extent.width);
-	viewport.setHeight(extent.height);
-	viewport.setMinDepth(0.0f);
-	viewport.setMaxDepth(1.0f);
+		if (slot.image == nullptr)
+			continue;
 
-	vk::Rect2D scissor;
-	scissor.setOffset({ 0, 0 });
-	scissor.setExtent(extent);
+		if (!_environmentEffects.bakeBegin(slot.image))
+			return;
 
-	vk::Rect2D renderArea;
-	renderArea.setOffset({ 0, 0 });
-	renderArea.setExtent(extent);
+		slot.image = nullptr;
+		_reflectionProbeBake = static_cast<int32_t>(i);
+		_reflectionProbeBakeVersion = slot.version;
+		return;
+	}
+}
 
-	vk::RenderPassBeginInfo renderPassInfo;
-	renderPassInfo.setRenderPass(_pContext->getRenderPass());
-	renderPassInfo.setFramebuffer(_pContext->getFramebuffer(_imageIndex.value()));
-	renderPassInfo.setRenderArea(renderArea);
-	renderPassInfo.setClearValues(clearValues);
+void RD::_reflectionProbeCopy(
+		vk::CommandBuffer commandBuffer, const EnvironmentData &data, uint32_t index) {
+	vk::ImageSubresourceRange srcRange;
+	srcRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	srcRange.setBaseMipLevel(0);
+	srcRange.setLevelCount(SPECULAR_LEVEL_COUNT);
+	srcRange.setBaseArrayLayer(0);
+	srcRange.setLayerCount(6);
 
-	commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
+	vk::ImageSubresourceRange dstRange = srcRange;
+	dstRange.setBaseArrayLayer(index * 6);
 
-	commandBuffer.setViewport(0, viewport);
-	commandBuffer.setScissor(0, scissor);
+	std::array<vk::ImageMemoryBarrier, 2> barriers;
 
-	return commandBuffer;
-}
+	for (vk::ImageMemoryBarrier &barrier : barriers) {
+		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	}
 
-void RD::drawEnd(vk::CommandBuffer commandBuffer) {
-	bool isDrawStarted = _imageIndex.has_value();
-	assert(isDrawStarted);
+	barriers[0].setImage(data.specular.image);
+	barriers[0].setSubresourceRange(srcRange);
+	barriers[0].setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+	barriers[0].setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	barriers[0].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
 
-	commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+	// earlier frames in flight may still sample previous probe of slot
+	barriers[1].setImage(_reflectionProbeArray.image);
+	barriers[1].setSubresourceRange(dstRange);
+	barriers[1].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barriers[1].setSrcAccessMask({});
+	barriers[1].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
 
-	// tonemapping
+	commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barriers);
 
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _tonemapPipeline);
-	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _tonemapLayout, 0, 1,
-			&_inputAttachmentSet, 0, nullptr);
+	std::array<vk::ImageBlit, SPECULAR_LEVEL_COUNT> blits;
 
-	TonemapParameterConstants constants{};
-	constants.exposure = _exposure;
-	constants.white = _white;
+	for (uint32_t level = 0; level < SPECULAR_LEVEL_COUNT; level++) {
+		int32_t srcSize = static_cast<int32_t>(std::max(data.specularSize >> level, 1u));
+		int32_t dstSize = static_cast<int32_t>(std::max(REFLECTION_PROBE_SIZE >> level, 1u));
 
-	commandBuffer.pushConstants(
-			_tonemapLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(constants), &constants);
+		vk::ImageSubresourceLayers srcSubresource;
+		srcSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		srcSubresource.setMipLevel(level);
+		srcSubresource.setBaseArrayLayer(0);
+		srcSubresource.setLayerCount(6);
 
-	commandBuffer.draw(3, 1, 0, 0);
+		vk::ImageSubresourceLayers dstSubresource = srcSubresource;
+		dstSubresource.setBaseArrayLayer(index * 6);
 
-	commandBuffer.endRenderPass();
-	commandBuffer.end();
+		blits[level].setSrcOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(srcSize, srcSize, 1) });
+		blits[level].setDstOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(dstSize, dstSize, 1) });
+		blits[level].setSrcSubresource(srcSubresource);
+		blits[level].setDstSubresource(dstSubresource);
+	}
 
-	vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	commandBuffer.blitImage(data.specular.image, vk::ImageLayout::eTransferSrcOptimal,
+			_reflectionProbeArray.image, vk::ImageLayout::eTransferDstOptimal, blits,
+			vk::Filter::eLinear);
 
-	vk::SubmitInfo submitInfo;
-	submitInfo.setWaitSemaphores(_presentSemaphores[_frame]);
-	submitInfo.setWaitDstStageMask(waitStage);
-	submitInfo.setCommandBuffers(commandBuffer);
-	submitInfo.setSignalSemaphores(_renderSemaphores[_frame]);
+	barriers[1].setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+	barriers[1].setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barriers[1].setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barriers[1].setDstAccessMask(vk::AccessFlagBits::eShaderRead);
 
-	_pContext->getGraphicsQueue().submit(submitInfo, _fences[_frame]);
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barriers[1]);
+}
 
-	vk::SwapchainKHR swapchain = _pContext->getSwapchain();
+void RD::_reflectionProbeBufferUpdate() {
+	std::vector<ReflectionProbeData> probes;
 
-	vk::PresentInfoKHR presentInfo;
-	presentInfo.setWaitSemaphores(_renderSemaphores[_frame]);
-	presentInfo.setSwapchains(swapchain);
-	presentInfo.setImageIndices(_imageIndex.value());
+	for (uint32_t i = 0; i < MAX_REFLECTION_PROBE_COUNT; i++) {
+		const ReflectionProbeSlot &slot = _reflectionProbes[i];
 
-	vk::Result err = _pContext->getPresentQueue().presentKHR(presentInfo);
+		if (!slot.isBaked)
+			continue;
 
-	if (err == vk::Result::eErrorOutOfDateKHR || err == vk::Result::eSuboptimalKHR || _resized) {
-		_pContext->recreateSwapchain(_width, _height);
-		updateInputAttachment(_pContext->getDevice(),
-				_pContext->getColorAttachment().getImageView(), _inputAttachmentSet);
+		ReflectionProbeData data = {};
+		data.position = glm::vec4(slot.probe.position, static_cast<float>(i));
+		data.boxMin = glm::vec4(slot.probe.boxMin, slot.probe.blendDistance);
+		data.boxMax = glm::vec4(slot.probe.boxMax, 0.0f);
 
-		_resized = false;
-	} else if (err != vk::Result::eSuccess) {
-		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Swapchain image presentation failed!");
+		probes.push_back(data);
 	}
 
-	_imageIndex.reset();
-	_frame = (_frame + 1) % FRAMES_IN_FLIGHT;
-}
+	// shading takes first boxes around a point, so smaller rooms cover ones they are part of
+	std::stable_sort(probes.begin(), probes.end(),
+			[](const ReflectionProbeData &a, const ReflectionProbeData &b) {
+				glm::vec3 aSize = glm::vec3(a.boxMax - a.boxMin);
+				glm::vec3 bSize = glm::vec3(b.boxMax - b.boxMin);
+				return aSize.x * aSize.y * aSize.z < bSize.x * bSize.y * bSize.z;
+			});
 
-void RD::windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
-	_pContext->initialize(surface, width, height);
+	// empty buffer keeps an entry, so binding stays valid
+	size_t probeCount = std::max(probes.size(), static_cast<size_t>(1));
+	vk::DeviceSize size = sizeof(glm::uvec4) + probeCount * sizeof(ReflectionProbeData);
 
-	// allocator
+	VmaAllocationInfo allocInfo;
+	AllocatedBuffer buffer = bufferCreate(MemoryCategory::Environment, BufferClass::Dynamic,
+			vk::BufferUsageFlagBits::eStorageBuffer, size, &allocInfo);
 
-	VmaAllocatorCreateInfo allocatorCreateInfo = {};
-	allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_1;
-	allocatorCreateInfo.instance = _pContext->getInstance();
-	allocatorCreateInfo.physicalDevice = _pContext->getPhysicalDevice();
-	allocatorCreateInfo.device = _pContext->getDevice();
+	glm::uvec4 count = glm::uvec4(static_cast<uint32_t>(probes.size()), 0, 0, 0);
 
-	{
-		VkResult err = vmaCreateAllocator(&allocatorCreateInfo, &_allocator);
+	uint8_t *pData = reinterpret_cast<uint8_t *>(allocInfo.pMappedData);
+	memset(pData, 0, size);
+	memcpy(pData, &count, sizeof(glm::uvec4));
 
-		if (err != VK_SUCCESS)
-			throw std::runtime_error("VmaAllocator creation failed!");
+	if (!probes.empty()) {
+		memcpy(pData + sizeof(glm::uvec4), probes.data(),
+				probes.size() * sizeof(ReflectionProbeData));
 	}
 
-	// commands
+	bufferFlush(buffer);
 
-	vk::Device device = _pContext->getDevice();
+	// earlier frames in flight still read previous probes
+	if (_reflectionProbeBuffer.buffer) {
+		AllocatedBuffer old = _reflectionProbeBuffer;
+		destroyDeferred([this, old]() { bufferDestroy(old); });
+	}
 
-	vk::CommandBufferAllocateInfo allocInfo;
-	allocInfo.setCommandPool(_pContext->getCommandPool());
-	allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
-	allocInfo.setCommandBufferCount(static_cast<uint32_t>(FRAMES_IN_FLIGHT));
+	_reflectionProbeBuffer = buffer;
+	_environmentVersion++;
+}
 
-	for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
-		vk::Result err = device.allocateCommandBuffers(&allocInfo, _commandBuffers);
+void RD::_reloadShaders() {
+	std::vector<std::string> shaders = ShaderLibrary::poll();
 
-		if (err != vk::Result::eSuccess)
-			throw std::runtime_error("Command buffers allocation failed!");
-	}
+	if (!shaders.empty()) {
+		std::vector<vk::Pipeline> replaced = ShaderLibrary::rebuild(_pipelineRecipes, shaders);
 
-	// sync
+		if (!replaced.empty()) {
+			destroyDeferred([this, replaced]() {
+				for (vk::Pipeline pipeline : replaced)
+					_pContext->getDevice().destroyPipeline(pipeline);
+			});
 
-	vk::SemaphoreCreateInfo semaphoreInfo = {};
-	vk::FenceCreateInfo fenceInfo = { vk::FenceCreateFlagBits::eSignaled };
+			_pipelineVersion++;
+		}
 
-	for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-		_presentSemaphores[i] = device.createSemaphore(semaphoreInfo);
-		_renderSemaphores[i] = device.createSemaphore(semaphoreInfo);
-		_fences[i] = device.createFence(fenceInfo);
+		_pendingShaders.insert(_pendingShaders.end(), shaders.begin(), shaders.end());
 	}
 
-	// descriptor pool
+	// running bake has pipelines bound, progressive bake is never cached so sky is filtered anew
+	if (_pendingShaders.empty() || _environmentEffects.isBaking())
+		return;
 
-	std::array<vk::DescriptorPoolSize, 4> poolSizes;
-	poolSizes[0] = { vk::DescriptorType::eUniformBuffer, FRAMES_IN_FLIGHT };
-	poolSizes[1] = { vk::DescriptorType::eInputAttachment, 1 };
-	poolSizes[2] = { vk::DescriptorType::eStorageBuffer, 1 };
-	poolSizes[3] = { vk::DescriptorType::eCombinedImageSampler, 1000 };
+	if (_environmentEffects.reloadShaders(_pendingShaders) && _sky != nullptr)
+		environmentSkyUpdate(_sky, true);
 
-	uint32_t maxSets = 0;
+	_pendingShaders.clear();
+}
 
-	for (const vk::DescriptorPoolSize &poolSize : poolSizes) {
-		maxSets += poolSize.descriptorCount;
-	}
+void RD::environmentSkyUpdate(const std::shared_ptr<Image> image, bool isProgressive) {
+	_sky = image;
 
-	vk::DescriptorPoolCreateInfo createInfo;
-	createInfo.setMaxSets(maxSets);
-	createInfo.setPoolSizes(poolSizes);
+	// previous bake stays bound until this one finishes
+	if (_isAtmosphere) {
+		_isAtmosphere = false;
+		_environmentVersion++;
+	}
 
-	_descriptorPool = device.createDescriptorPool(createInfo);
+	// latest request wins, it starts once running bake is finished
+	if (!_environmentEffects.bakeBegin(image, isProgressive)) {
+		_pendingSky = image;
+		_isPendingSkyProgressive = isProgressive;
+	}
+}
 
-	// light
+void RD::environmentAtmosphereSet(const Atmosphere &atmosphere) {
+	_skyAtmosphere.update(atmosphere);
 
-	_lightStorage.initialize(_pContext->getDevice(), _allocator, _descriptorPool);
+	// bake requested earlier would replace it once finished
+	_sky = nullptr;
+	_pendingSky = nullptr;
+
+	if (!_isAtmosphere) {
+		_isAtmosphere = true;
+		_environmentVersion++;
+	}
+}
+
+bool RD::isEnvironmentBaking() const {
+	if (_environmentEffects.isBaking() || _pendingSky != nullptr || _skyAtmosphere.isPending())
+		return true;
+
+	for (const ReflectionProbeSlot &slot : _reflectionProbes) {
+		if (slot.image != nullptr)
+			return true;
+	}
+
+	return false;
+}
+
+void RD::reflectionProbeSet(
+		uint32_t index, const ReflectionProbe &probe, const std::shared_ptr<Image> image) {
+	ReflectionProbeSlot &slot = _reflectionProbes[index];
+	bool isBaked = slot.isBaked;
+
+	slot.probe = probe;
+	slot.image = image;
+	slot.isBaked = false;
+	slot.version++;
+
+	// previous capture is left out rather than shown in new box
+	if (isBaked)
+		_reflectionProbeBufferUpdate();
+}
+
+void RD::terrainSet(const Terrain &terrain, const std::shared_ptr<Image> heightmap,
+		const std::shared_ptr<Image> splatmap) {
+	_terrainStorage.set(terrain, heightmap, splatmap);
+}
+
+void RD::terrainLayerSet(uint32_t index, const std::shared_ptr<Image> image) {
+	_terrainStorage.layerSet(index, image);
+}
+
+void RD::environmentSetSpecularSampleCount(uint32_t level, uint32_t sampleCount) {
+	_environmentEffects.setSpecularSampleCount(level, sampleCount);
+}
+
+void RD::environmentSetMaxCubemapSize(uint32_t size) {
+	_environmentEffects.setMaxCubemapSize(size);
+}
+
+void RD::lightProbesSet(const LightProbeGrid &grid) {
+	// empty grid keeps a probe, so binding stays valid
+	size_t probeCount = std::max(grid.probes.size(), static_cast<size_t>(1));
+	vk::DeviceSize size = sizeof(LightProbeHeader) + probeCount * sizeof(glm::vec4);
+
+	VmaAllocationInfo allocInfo;
+	AllocatedBuffer buffer = bufferCreate(MemoryCategory::Environment, BufferClass::Dynamic,
+			vk::BufferUsageFlagBits::eStorageBuffer, size, &allocInfo);
+
+	LightProbeHeader header = {};
+
+	if (!grid.probes.empty()) {
+		header.origin = glm::vec4(grid.origin, 0.0f);
+		header.spacing = glm::vec4(grid.spacing, 0.0f);
+		header.counts = glm::uvec4(grid.counts, 0);
+	}
+
+	uint8_t *pData = reinterpret_cast<uint8_t *>(allocInfo.pMappedData);
+	memset(pData, 0, size);
+	memcpy(pData, &header, sizeof(LightProbeHeader));
+
+	if (!grid.probes.empty()) {
+		memcpy(pData + sizeof(LightProbeHeader), grid.probes.data(),
+				grid.probes.size() * sizeof(glm::vec4));
+	}
+
+	bufferFlush(buffer);
+
+	// earlier frames in flight still read previous grid
+	if (_probeBuffer.buffer) {
+		AllocatedBuffer old = _probeBuffer;
+		destroyDeferred([this, old]() { bufferDestroy(old); });
+	}
+
+	_probeBuffer = buffer;
+	_environmentVersion++;
+}
+
+void RD::updateUniformBuffer(const glm::vec3 &viewPosition, const glm::mat4 &view,
+		const glm::mat4 &proj, uint32_t viewIndex, vk::Rect2D rect) {
+	if (rect.extent.width == 0 || rect.extent.height == 0)
+		rect = vk::Rect2D({ 0, 0 }, getRenderExtent());
+
+	UniformBufferObject ubo{};
+	ubo.viewPosition = viewPosition;
+	ubo.directionalLightCount = _lightStorage.getDirectionalLightCount();
+	ubo.pointLightCount = _lightStorage.getPointLightCount();
+	ubo.debugView = _debugView;
+	// shaders count nothing without stride
+	ubo.overdrawStride =
+			_debugView == DebugView::Overdraw ? _pContext->getAttachmentExtent().width : 0;
+	ubo.mipScale = std::exp2(_quality.mipBias);
+
+	for (uint32_t i = 0; i < 9; i++)
+		ubo.irradianceSH[i] = _getEnvironment().irradianceSH[i];
+
+	ubo.projView = proj * view;
+	ubo.view = view;
+	ubo.proj = proj;
+	ubo.invProj = glm::inverse(proj);
+	ubo.invProjView = glm::inverse(ubo.projView);
+	ubo.jitter = getJitter();
+	ubo.viewIndex = viewIndex;
+	ubo.viewRect = glm::vec4(rect.offset.x, rect.offset.y, rect.extent.width, rect.extent.height);
+
+	memcpy(_uniformAllocInfos[_frame][viewIndex].pMappedData, &ubo, sizeof(ubo));
+}
+
+void RD::_overdrawUpdate(vk::CommandBuffer commandBuffer) {
+	vk::Extent2D extent = _pContext->getAttachmentExtent();
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(extent.width) * extent.height * 4;
+
+	if (_debugView == DebugView::Overdraw && _overdrawBuffer.size < size) {
+		// earlier frames in flight still count into previous buffer
+		AllocatedBuffer old = _overdrawBuffer;
+		destroyDeferred([this, old]() { bufferDestroy(old); });
+
+		_overdrawBuffer = bufferCreate(MemoryCategory::RenderTarget, BufferClass::Static,
+				vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+				size);
+		_overdrawVersion++;
+	}
+
+	// sets of every frame follow replaced buffer before it is destroyed, view on or not
+	if (_overdrawSetVersions[_frame] != _overdrawVersion) {
+		vk::DescriptorBufferInfo bufferInfo = _overdrawBuffer.getBufferInfo();
+
+		for (uint32_t i = 0; i < MAX_VIEW_COUNT; i++) {
+			vk::WriteDescriptorSet writeInfo;
+			writeInfo.setDstSet(_uniformSets[_frame][i]);
+			writeInfo.setDstBinding(4);
+			writeInfo.setDstArrayElement(0);
+			writeInfo.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			writeInfo.setDescriptorCount(1);
+			writeInfo.setBufferInfo(bufferInfo);
+
+			_pContext->getDevice().updateDescriptorSets(writeInfo, nullptr);
+		}
+
+		_overdrawSetVersions[_frame] = _overdrawVersion;
+	}
+
+	if (_debugView != DebugView::Overdraw)
+		return;
+
+	// counters are shared by frames, previous one may still be shading
+	vk::BufferMemoryBarrier barrier;
+	barrier.setBuffer(_overdrawBuffer.buffer);
+	barrier.setOffset(0);
+	barrier.setSize(VK_WHOLE_SIZE);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, barrier, nullptr);
+
+	commandBuffer.fillBuffer(_overdrawBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, barrier, nullptr);
+}
+
+void RD::setView(vk::CommandBuffer commandBuffer, uint32_t viewIndex, const vk::Rect2D &rect) {
+	_view = viewIndex;
+
+	vk::Viewport viewport(static_cast<float>(rect.offset.x), static_cast<float>(rect.offset.y),
+			static_cast<float>(rect.extent.width), static_cast<float>(rect.extent.height), 0.0f,
+			1.0f);
+
+	commandBuffer.setViewport(0, viewport);
+	commandBuffer.setScissor(0, rect);
+}
+
+void RD::updateInstanceBuffer(const InstanceTransform *pTransforms, uint32_t count) {
+	if (count > MAX_INSTANCE_COUNT)
+		count = MAX_INSTANCE_COUNT;
+
+	memcpy(_instanceAllocInfos[_frame].pMappedData, pTransforms,
+			sizeof(InstanceTransform) * count);
+}
+
+void RD::updateInstanceMaterialBuffer(const uint32_t *pMaterials, uint32_t count) {
+	if (count > MAX_INSTANCE_COUNT)
+		count = MAX_INSTANCE_COUNT;
+
+	memcpy(_instanceMaterialAllocInfos[_frame].pMappedData, pMaterials, sizeof(uint32_t) * count);
+}
+
+void RD::updateInstanceNormalBuffer(const InstanceTransform *pNormals, uint32_t count) {
+	if (count > MAX_INSTANCE_COUNT)
+		count = MAX_INSTANCE_COUNT;
+
+	memcpy(_instanceNormalAllocInfos[_frame].pMappedData, pNormals,
+			sizeof(InstanceTransform) * count);
+}
+
+LightStorage &RD::getLightStorage() {
+	return _lightStorage;
+}
+
+LightCuller &RD::getLightCuller() {
+	return _lightCuller;
+}
+
+ShadowAtlas &RD::getShadowAtlas() {
+	return _shadowAtlas;
+}
+
+GeometryArena &RD::getGeometryArena() {
+	return _geometryArena;
+}
+
+SkinStorage &RD::getSkinStorage() {
+	return _skinStorage;
+}
+
+MorphStorage &RD::getMorphStorage() {
+	return _morphStorage;
+}
+
+ParticleStorage &RD::getParticleStorage() {
+	return _particleStorage;
+}
+
+TerrainStorage &RD::getTerrainStorage() {
+	return _terrainStorage;
+}
+
+BindlessStorage &RD::getBindlessStorage() {
+	return _bindlessStorage;
+}
+
+MaterialStorage &RD::getMaterialStorage() {
+	return _materialStorage;
+}
+
+UploadManager &RD::getUploadManager() {
+	return _uploadManager;
+}
+
+FrameAllocator &RD::getFrameAllocator() {
+	return _frameAllocator;
+}
+
+MipGenerator &RD::getMipGenerator() {
+	return _mipGenerator;
+}
+
+std::mutex &RD::getQueueMutex() {
+	return _queueMutex;
+}
+
+GpuProfiler &RD::getGpuProfiler() {
+	return _gpuProfiler;
+}
+
+PipelineStatistics &RD::getPipelineStatistics() {
+	return _pipelineStatistics;
+}
+
+bool RD::getCalibratedTimestamp(uint64_t &timestamp, uint64_t &counter) const {
+	// counter of the moment is taken halfway through the call
+	uint64_t before = SDL_GetPerformanceCounter();
+
+	if (!_pContext->getDeviceTimestamp(timestamp))
+		return false;
+
+	uint64_t after = SDL_GetPerformanceCounter();
+	counter = before + (after - before) / 2;
+
+	return true;
+}
+
+FramePacingStats RD::getFramePacingStats() const {
+	return _framePacer.getStats();
+}
+
+FrameBoundStats RD::getFrameBoundStats() const {
+	return _boundAnalyzer.getStats();
+}
+
+StartupStats RD::getStartupStats() const {
+	return _startupStats;
+}
+
+void RD::setHitchReporting(bool isEnabled) {
+	_framePacer.setReporting(isEnabled);
+}
+
+std::vector<GpuTiming> RD::getGpuTimings() const {
+	std::vector<GpuTiming> timings = _gpuProfiler.getTimings();
+	std::vector<GpuTiming> bakeTimings = _environmentEffects.getTimings();
+
+	timings.insert(timings.end(), bakeTimings.begin(), bakeTimings.end());
+
+	return timings;
+}
+
+bool RD::isBindlessEnabled() const {
+	return _pContext->isBindlessEnabled();
+}
+
+bool RD::isPushDescriptorEnabled() const {
+	return _pContext->isPushDescriptorEnabled();
+}
+
+bool RD::isDeferredEnabled() const {
+	return _pContext->isDeferredEnabled();
+}
+
+bool RD::isAsyncComputeEnabled() const {
+	return _asyncCompute;
+}
+
+const std::vector<uint32_t> &RD::getSharedQueueFamilies() const {
+	return _sharedQueueFamilies;
+}
+
+MemoryBudget RD::getMemoryBudget() const {
+	const VkPhysicalDeviceMemoryProperties *pProperties;
+	vmaGetMemoryProperties(_allocator, &pProperties);
+
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetHeapBudgets(_allocator, budgets);
+
+	MemoryBudget budget = {};
+
+	for (uint32_t heap = 0; heap < pProperties->memoryHeapCount; heap++) {
+		if (!(pProperties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+			continue;
+
+		budget.usage += budgets[heap].usage;
+		budget.budget += budgets[heap].budget;
+	}
+
+	return budget;
+}
+
+float RD::getFragmentation() const {
+	VmaTotalStatistics statistics;
+	vmaCalculateStatistics(_allocator, &statistics);
+
+	const VmaStatistics &total = statistics.total.statistics;
+
+	if (total.blockBytes == 0)
+		return 0.0f;
+
+	return 1.0f - static_cast<float>(total.allocationBytes) / static_cast<float>(total.blockBytes);
+}
+
+VmaStatistics RD::getAllocatorStatistics() const {
+	VmaTotalStatistics statistics;
+	vmaCalculateStatistics(_allocator, &statistics);
+
+	return statistics.total.statistics;
+}
+
+VmaAllocator RD::getAllocator() const {
+	return _allocator;
+}
+
+VmaPool RD::getTexturePool() const {
+	return _texturePool;
+}
+
+vk::Instance RD::getInstance() const {
+	return _pContext->getInstance();
+}
+
+vk::PhysicalDevice RD::getPhysicalDevice() const {
+	return _pContext->getPhysicalDevice();
+}
+
+vk::Device RD::getDevice() const {
+	return _pContext->getDevice();
+}
+
+vk::PipelineCache RD::getPipelineCache() const {
+	return _pContext->getPipelineCache();
+}
+
+void RD::pipelineCacheSave() {
+	_pContext->savePipelineCache();
+}
+
+vk::Extent2D RD::getSwapchainExtent() const {
+	return _pContext->getSwapchainExtent();
+}
+
+vk::Extent2D RD::getRenderExtent() const {
+	return _renderExtent;
+}
+
+vk::Extent2D RD::getAttachmentExtent() const {
+	return _pContext->getAttachmentExtent();
+}
+
+Attachment RD::getDepthAttachment() const {
+	return _pContext->getDepthAttachment();
+}
+
+vk::PipelineLayout RD::getDepthPipelineLayout() const {
+	return _depthLayout;
+}
+
+vk::Pipeline RD::getDepthPipeline() const {
+	return _depthPipeline;
+}
+
+vk::DescriptorSet RD::getUniformSet() const {
+	return _uniformSets[_frame][_view];
+}
+
+AllocatedBuffer RD::getInstanceBuffer(uint32_t frame) const {
+	return _instanceBuffers[frame];
+}
+
+AllocatedBuffer RD::getInstanceMaterialBuffer(uint32_t frame) const {
+	return _instanceMaterialBuffers[frame];
+}
+
+AllocatedBuffer RD::getInstanceNormalBuffer(uint32_t frame) const {
+	return _instanceNormalBuffers[frame];
+}
+
+uint32_t RD::getFrame() const {
+	return _frame;
+}
+
+uint32_t RD::getView() const {
+	return _view;
+}
+
+uint32_t RD::getFramesInFlight() const {
+	return _framesInFlight;
+}
+
+uint32_t RD::getSettleFrameCount() const {
+	// one more for occlusion culling, it tests against depth of previous frame
+	uint32_t count = _framesInFlight + 1;
+
+	if (_upscaleFilter == UpscaleFilter::Temporal)
+		count += TemporalUpscaler::getPhaseCount(_renderExtent, _pContext->getSwapchainExtent());
+
+	return count;
+}
+
+vk::PipelineLayout RD::getSkyPipelineLayout() const {
+	return _skyLayout;
+}
+
+vk::Pipeline RD::getSkyPipeline() const {
+	return _skyPipeline;
+}
+
+vk::DescriptorSet RD::getSkySet() const {
+	return _skySets[_frame];
+}
+
+vk::PipelineLayout RD::getMaterialPipelineLayout() const {
+	return _materialLayout;
+}
+
+vk::Pipeline RD::getMaterialPipeline(uint32_t permutation) const {
+	if (isDeferredEnabled())
+		permutation &= ~MATERIAL_POINT_LIGHTS_BIT;
+
+	if (!isDepthPrepass() || (permutation & MATERIAL_ALPHA_TEST_BIT))
+		return _materialDepthPipelines[permutation];
+
+	return _materialPipelines[permutation];
+}
+
+uint32_t RD::getScenePermutation() const {
+	return _lightStorage.getPointLightCount() > 0 ? MATERIAL_POINT_LIGHTS_BIT : 0;
+}
+
+std::array<vk::DescriptorSet, 3> RD::getMaterialSets() const {
+	return { _uniformSets[_frame][_view], _iblSets[_frame], _lightStorage.getLightSet(_frame) };
+}
+
+uint64_t RD::getSetVersion() const {
+	// all only grow, sum changes with any of them
+	return _environmentSetVersions[_frame] + _lightStorage.getSetVersion(_frame) +
+			_pipelineVersion;
+}
+
+vk::PipelineLayout RD::getTerrainPipelineLayout() const {
+	return _terrainLayout;
+}
+
+vk::Pipeline RD::getTerrainPipeline() const {
+	return _terrainPipeline;
+}
+
+vk::PipelineLayout RD::getLightingPipelineLayout() const {
+	return _lightingLayout;
+}
+
+vk::Pipeline RD::getLightingPipeline() const {
+	return _lightingPipeline;
+}
+
+vk::DescriptorSet RD::getGBufferSet() const {
+	return _gbufferSets[_frame];
+}
+
+vk::DescriptorPool RD::getDescriptorPool() const {
+	return _descriptorPool;
+}
+
+vk::DescriptorSetLayout RD::getTextureLayout() const {
+	return _textureLayout;
+}
+
+DescriptorAllocator &RD::getTextureSetAllocator() {
+	return _textureSetAllocator;
+}
+
+vk::DescriptorUpdateTemplate RD::getTextureUpdateTemplate() const {
+	return _textureUpdateTemplate;
+}
+
+void RD::textureSetBind(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout,
+		const TextureSetRD &textureSet) const {
+	if (isPushDescriptorEnabled())
+		_pContext->pushDescriptorSet(commandBuffer, _textureUpdateTemplate, layout,
+				MATERIAL_TEXTURE_SET, textureSet.imageInfos.data());
+	else
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout,
+				MATERIAL_TEXTURE_SET, textureSet.set, nullptr);
+}
+
+void RD::setExposure(float exposure) {
+	_exposure = exposure;
+}
+
+void RD::setAutoExposure(bool isEnabled) {
+	// exposure of earlier run may be far from that of scene now
+	if (isEnabled && !_isAutoExposure)
+		_autoExposure.invalidate();
+
+	_isAutoExposure = isEnabled;
+}
+
+void RD::setSkyLod(float lod) {
+	_skyLod = std::max(lod, 0.0f);
+}
+
+float RD::getSkyLod() const {
+	return _skyLod;
+}
+
+void RD::setWhite(float white) {
+	_white = white;
+}
+
+void RD::setTonemapLook(TonemapLook look) {
+	_tonemapLook = look;
+}
+
+void RD::setTonemapLut(bool isEnabled) {
+	_isTonemapLut = isEnabled;
+}
+
+void RD::setUpscaleFilter(UpscaleFilter filter) {
+	// history of earlier run may be far behind camera
+	if (filter == UpscaleFilter::Temporal && _upscaleFilter != filter)
+		_temporalUpscaler.invalidate();
+
+	_upscaleFilter = filter;
+
+	if (_pContext->getSwapchain())
+		_resolutionUpdate();
+}
+
+void RD::setDebugView(DebugView view) {
+	if (view == DebugView::Overdraw &&
+			!_pContext->getPhysicalDevice().getFeatures().fragmentStoresAndAtomics) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Overdraw view needs fragment atomics!");
+		view = DebugView::None;
+	}
+
+	_debugView = view;
+}
+
+DebugView RD::getDebugView() const {
+	return _debugView;
+}
+
+glm::vec2 RD::getJitter() const {
+	return glm::vec2(2.0f * _jitter.x / static_cast<float>(_renderExtent.width),
+			2.0f * _jitter.y / static_cast<float>(_renderExtent.height));
+}
+
+void RD::setTemporalProjView(const glm::mat4 &projView) {
+	_previousProjView = _projView;
+	_projView = projView;
+}
+
+vk::CommandBuffer RD::drawBegin() {
+	PROFILE_ZONE("draw begin");
+
+	// without frameWait, frame begins here
+	_framePacer.ensureBegun(_frameNumber);
+
+	vk::CommandBuffer commandBuffer = _commandBuffers[_frame];
+
+	// budget is fetched again from driver on new frame index
+	vmaSetCurrentFrameIndex(_allocator, static_cast<uint32_t>(_frameNumber));
+
+	// uploads recorded since last frame are submitted ahead of it, in the same submit where
+	// timelines allow
+	_uploadManager.flushDeferred();
+	_uploadManager.collect();
+
+	{
+		PROFILE_ZONE("fence wait");
+
+		uint64_t waitBegin = SDL_GetPerformanceCounter();
+		vk::Result result =
+				_pContext->getDevice().waitForFences(_fences[_frame], VK_TRUE, UINT64_MAX);
+
+		_framePacer.fenceWaited(waitBegin, SDL_GetPerformanceCounter());
+
+		if (result != vk::Result::eSuccess)
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for fences failed!");
+	}
+
+	_readbackCollect(_frame);
+	_frameAllocator.reset(_frame);
+
+	if (_pContext->isHeadless()) {
+		// offscreen image of frame, its previous copy was just collected
+		_imageIndex = _frame;
+	} else {
+		vk::ResultValue<uint32_t> image(vk::Result::eSuccess, 0);
+
+		{
+			PROFILE_ZONE("acquire");
+
+			uint64_t acquireBegin = SDL_GetPerformanceCounter();
+			image = _pContext->getDevice().acquireNextImageKHR(_pContext->getSwapchain(),
+					UINT64_MAX, _presentSemaphores[_frame], VK_NULL_HANDLE);
+
+			_framePacer.acquired(acquireBegin, SDL_GetPerformanceCounter());
+		}
+
+		_imageIndex = image.value;
+
+		if (image.result == vk::Result::eErrorOutOfDateKHR) {
+			_presentId = 0;
+
+			_swapchainRecreate();
+		} else if (image.result != vk::Result::eSuccess &&
+				image.result != vk::Result::eSuboptimalKHR) {
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Swapchain image acquire failed!");
+		}
+	}
+
+	_pContext->getDevice().resetFences(_fences[_frame]);
+
+	// sets of this frame are no longer in use, others keep attachments their frames drew to
+	_attachmentSetsUpdate();
+
+	// frames up to _frameNumber - _framesInFlight are finished now
+	while (!_deletionQueue.empty() &&
+			_deletionQueue.front().frameNumber + _framesInFlight <= _frameNumber) {
+		_deletionQueue.front().destroy();
+		_deletionQueue.pop_front();
+	}
+
+	// secondary buffers of this frame are no longer pending
+	for (SecondaryCommands &secondary : _secondaryCommands[_frame]) {
+		if (!secondary.pool)
+			continue;
+
+		_pContext->getDevice().resetCommandPool(secondary.pool);
+		secondary.usedCount = 0;
+	}
+
+	_lightStorage.update(_frame);
+
+	commandBuffer.reset();
+
+	vk::CommandBufferBeginInfo beginInfo{};
+
+	commandBuffer.begin(beginInfo);
+
+	// clocks drift apart, traces are calibrated again every frame
+	uint64_t timestamp, counter;
+
+	if (Profiler::isTracing() && getCalibratedTimestamp(timestamp, counter))
+		_gpuProfiler.calibrate(timestamp, counter);
+
+	// fence of this frame was waited for, its timestamps are read without stalling
+	_gpuProfiler.begin(commandBuffer, _frame);
+	_pipelineStatistics.begin(commandBuffer, _frame);
+
+	// scopes of hitch frame were just collected once it is frames in flight back
+	if (_framePacer.isCollectDue(_frameNumber, _framesInFlight))
+		_framePacer.collect(_frameNumber, _framesInFlight, getGpuTimings());
+
+	// so was frame scope of frame that used pool before, samples not taken anew are stale
+	FrameTiming boundTiming;
+
+	if (_frameNumber >= _framesInFlight &&
+			_framePacer.getTiming(_frameNumber - _framesInFlight, boundTiming)) {
+		float gpuMilliseconds = -1.0f;
+		uint64_t sampleCount = 0;
+
+		if (!_gpuProfiler.getLastSample("frame", gpuMilliseconds, sampleCount) ||
+				sampleCount == _boundGpuSampleCount)
+			gpuMilliseconds = -1.0f;
+
+		_boundGpuSampleCount = sampleCount;
+		_boundAnalyzer.add(boundTiming, gpuMilliseconds);
+	}
+
+	_frameScope = _gpuProfiler.scopeCreate("frame");
+	_gpuProfiler.scopeBegin(commandBuffer, _frameScope);
+
+	_view = 0;
+
+	_reloadShaders();
+	_environmentUpdate(commandBuffer);
+	_overdrawUpdate(commandBuffer);
+
+	return commandBuffer;
+}
+
+void RD::renderPassBegin(vk::CommandBuffer commandBuffer, vk::SubpassContents contents) {
+	// g-buffer attachments are not cleared
+	std::array<vk::ClearValue, 5> clearValues;
+	clearValues[0].color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
+	clearValues[1].depthStencil = vk::ClearDepthStencilValue(0.0f, 0);
+
+	// attachments are not reallocated as dynamic resolution draws less of them
+	vk::Extent2D extent = _renderExtent;
+
+	// image of new attachments starts out at full rate
+	if (getShadingRateMode() == ShadingRateMode::Image)
+		_shadingRateGenerator.ensure(commandBuffer, _pContext->getColorAttachment(),
+				_pContext->getShadingRateAttachment(), _pContext->getAttachmentExtent());
+
+	vk::Rect2D renderArea;
+	renderArea.setOffset({ 0, 0 });
+	renderArea.setExtent(extent);
+
+	vk::RenderPassBeginInfo renderPassInfo;
+	renderPassInfo.setRenderPass(_pContext->getRenderPass());
+	renderPassInfo.setFramebuffer(_pContext->getFramebuffer());
+	renderPassInfo.setRenderArea(renderArea);
+	renderPassInfo.setClearValues(clearValues);
+
+	commandBuffer.beginRenderPass(&renderPassInfo, contents);
+
+	// secondary buffers set their own dynamic state
+	if (contents == vk::SubpassContents::eInline)
+		setViewport(commandBuffer, extent);
+}
+
+vk::CommandBuffer RD::asyncComputeBegin(vk::PipelineStageFlags waitStage) {
+	bool isDrawStarted = _imageIndex.has_value();
+	assert(isDrawStarted && _asyncCompute);
+
+	vk::CommandBuffer commandBuffer = _computeCommandBuffers[_frame];
+
+	// graphics fence of frame was waited for, it covers compute submit before it
+	if (!_computeWaitStages) {
+		vk::CommandBufferBeginInfo beginInfo = {};
+		beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+		commandBuffer.begin(beginInfo);
+	}
+
+	_computeWaitStages |= waitStage;
+
+	return commandBuffer;
+}
+
+vk::CommandBuffer RD::secondaryBegin(uint32_t thread, uint32_t subpass) {
+	assert(thread < MAX_RECORD_THREAD_COUNT);
+
+	vk::Device device = _pContext->getDevice();
+	SecondaryCommands &secondary = _secondaryCommands[_frame][thread];
+
+	if (!secondary.pool) {
+		vk::CommandPoolCreateInfo createInfo = {};
+		createInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+		createInfo.setQueueFamilyIndex(_pContext->getGraphicsQueueFamily());
+
+		secondary.pool = device.createCommandPool(createInfo);
+		secondary.usedCount = 0;
+	}
+
+	if (secondary.usedCount == secondary.buffers.size()) {
+		vk::CommandBufferAllocateInfo allocInfo = {};
+		allocInfo.setCommandPool(secondary.pool);
+		allocInfo.setLevel(vk::CommandBufferLevel::eSecondary);
+		allocInfo.setCommandBufferCount(1);
+
+		secondary.buffers.push_back(device.allocateCommandBuffers(allocInfo)[0]);
+	}
+
+	vk::CommandBuffer commandBuffer = secondary.buffers[secondary.usedCount++];
+
+	vk::CommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.setRenderPass(_pContext->getRenderPass());
+	inheritanceInfo.setSubpass(subpass);
+	inheritanceInfo.setFramebuffer(_pContext->getFramebuffer());
+
+	// statistics queries of passes are active in primary buffer
+	if (_pContext->isPipelineStatisticsEnabled())
+		inheritanceInfo.setPipelineStatistics(PIPELINE_STATISTICS_FLAGS);
+
+	vk::CommandBufferBeginInfo beginInfo = {};
+	beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+			vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+	beginInfo.setPInheritanceInfo(&inheritanceInfo);
+
+	commandBuffer.begin(beginInfo);
+
+	setViewport(commandBuffer, _renderExtent);
+
+	return commandBuffer;
+}
+
+vk::CommandBuffer RD::secondaryBeginCached(uint32_t slot, uint32_t subpass) {
+	assert(slot < MAX_CACHED_SECONDARY_COUNT);
+
+	vk::Device device = _pContext->getDevice();
+
+	if (!_cachedSecondaryPool) {
+		vk::CommandPoolCreateInfo createInfo = {};
+		createInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+		createInfo.setQueueFamilyIndex(_pContext->getGraphicsQueueFamily());
+
+		_cachedSecondaryPool = device.createCommandPool(createInfo);
+	}
+
+	vk::CommandBuffer &commandBuffer = _cachedSecondaries[_frame][slot];
+
+	if (!commandBuffer) {
+		vk::CommandBufferAllocateInfo allocInfo = {};
+		allocInfo.setCommandPool(_cachedSecondaryPool);
+		allocInfo.setLevel(vk::CommandBufferLevel::eSecondary);
+		allocInfo.setCommandBufferCount(1);
+
+		commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+	}
+
+	vk::CommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.setRenderPass(_pContext->getRenderPass());
+	inheritanceInfo.setSubpass(subpass);
+	inheritanceInfo.setFramebuffer(_pContext->getFramebuffer());
+
+	// cached buffers may be executed after statistics were enabled
+	if (_pContext->isPipelineStatisticsEnabled())
+		inheritanceInfo.setPipelineStatistics(PIPELINE_STATISTICS_FLAGS);
+
+	// frame using slot waited for its fence in drawBegin, begin resets buffer implicitly
+	vk::CommandBufferBeginInfo beginInfo = {};
+	beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue);
+	beginInfo.setPInheritanceInfo(&inheritanceInfo);
+
+	commandBuffer.begin(beginInfo);
+
+	setViewport(commandBuffer, _renderExtent);
+
+	return commandBuffer;
+}
+
+vk::Framebuffer RD::getFramebuffer() const {
+	return _pContext->getFramebuffer();
+}
+
+void RD::renderPassEnd(vk::CommandBuffer commandBuffer) {
+	bool isDrawStarted = _imageIndex.has_value();
+	assert(isDrawStarted);
+
+	commandBuffer.endRenderPass();
+
+	vk::Extent2D extent = _pContext->getSwapchainExtent();
+	bool isTemporal = _upscaleFilter == UpscaleFilter::Temporal;
+
+	// color is left in shader read only layout by render pass, depth is handed back to pyramid
+	RenderGraph::State colorState = { vk::ImageLayout::eShaderReadOnlyOptimal,
+		vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		vk::AccessFlagBits::eColorAttachmentWrite };
+	RenderGraph::State depthState = RenderGraph::getState(GraphUsage::DepthAttachment);
+
+	GraphImage color = _renderGraph.imageImport(_pContext->getColorAttachment().getImage(),
+			vk::ImageAspectFlagBits::eColor, colorState);
+	GraphImage depth = _renderGraph.imageImport(_pContext->getDepthAttachment().getImage(),
+			vk::ImageAspectFlagBits::eDepth, depthState, GraphUsage::DepthAttachment);
+
+	GraphAccess tonemapInput = { color, GraphUsage::FragmentSampled };
+
+	if (isTemporal) {
+		// history follows swapchain, frames in flight are waited for when it is recreated
+		_temporalUpscaler.ensure(
+				_pContext->getColorAttachment(), _pContext->getDepthAttachment(), extent);
+
+		GraphImage previous = _temporalUpscaler.historyImport(_renderGraph, false);
+		GraphImage next = _temporalUpscaler.historyImport(_renderGraph, true);
+
+		std::vector<GraphAccess> accesses = {
+			{ color, GraphUsage::ComputeSampled },
+			{ depth, GraphUsage::ComputeSampled },
+			{ previous, GraphUsage::ComputeGeneralRead },
+			{ next, GraphUsage::ComputeGeneralWrite },
+		};
+
+		_renderGraph.passAdd("temporal resolve", accesses, [this](vk::CommandBuffer commandBuffer) {
+			uint32_t resolveScope = _gpuProfiler.scopeCreate("temporal resolve");
+			_gpuProfiler.scopeBegin(commandBuffer, resolveScope);
+
+			glm::mat4 reprojection = _previousProjView * glm::inverse(_projView);
+			_temporalUpscaler.record(commandBuffer, reprojection, _jitter, _renderExtent);
+
+			_gpuProfiler.scopeEnd(commandBuffer, resolveScope);
+		});
+
+		tonemapInput = { next, GraphUsage::FragmentGeneralRead };
+	}
+
+	if (_isAutoExposure) {
+		_autoExposure.ensure(_pContext->getColorAttachment());
+
+		// reads scene color beside temporal resolve, exposure buffer is synchronized by pass
+		_renderGraph.passAdd("auto exposure", { { color, GraphUsage::ComputeSampled } },
+				[this](vk::CommandBuffer commandBuffer) {
+					uint32_t exposureScope = _gpuProfiler.scopeCreate("auto exposure");
+					_gpuProfiler.scopeBegin(commandBuffer, exposureScope);
+
+					_autoExposure.record(commandBuffer, _renderExtent);
+
+					_gpuProfiler.scopeEnd(commandBuffer, exposureScope);
+				});
+	}
+
+	if (getShadingRateMode() == ShadingRateMode::Image) {
+		GraphImage shadingRate = _renderGraph.imageImport(
+				_pContext->getShadingRateAttachment().getImage(), vk::ImageAspectFlagBits::eColor,
+				RenderGraph::getState(GraphUsage::ShadingRateAttachment),
+				GraphUsage::ShadingRateAttachment);
+
+		// tiles of next frame follow luminance of this one
+		std::vector<GraphAccess> accesses = {
+			{ color, GraphUsage::ComputeSampled },
+			{ shadingRate, GraphUsage::ComputeGeneralWrite },
+		};
+
+		_renderGraph.passAdd("shading rate", accesses, [this](vk::CommandBuffer commandBuffer) {
+			uint32_t shadingRateScope = _gpuProfiler.scopeCreate("shading rate");
+			_gpuProfiler.scopeBegin(commandBuffer, shadingRateScope);
+
+			_shadingRateGenerator.record(commandBuffer, _renderExtent);
+
+			_gpuProfiler.scopeEnd(commandBuffer, shadingRateScope);
+		});
+	}
+
+	if (_isTonemapLut) {
+		_tonemapLut.update(_white, _tonemapLook);
+
+		if (_tonemapLut.isStale())
+			_renderGraph.passAdd("tonemap lut", {}, [this](vk::CommandBuffer commandBuffer) {
+				_tonemapLut.record(commandBuffer);
+			});
+	}
+
+	// tonemapping, upscales scene color or resolved history to final image
+	_renderGraph.passAdd("tonemap", { tonemapInput }, [this](vk::CommandBuffer commandBuffer) {
+		_recordTonemap(commandBuffer);
+	});
+
+	_renderGraph.execute(commandBuffer);
+}
+
+void RD::_recordTonemap(vk::CommandBuffer commandBuffer) {
+	vk::Extent2D extent = _pContext->getSwapchainExtent();
+	bool isTemporal = _upscaleFilter == UpscaleFilter::Temporal;
+
+	vk::Rect2D renderArea;
+	renderArea.setOffset({ 0, 0 });
+	renderArea.setExtent(extent);
+
+	vk::RenderPassBeginInfo renderPassInfo;
+	renderPassInfo.setRenderPass(_pContext->getTonemapRenderPass());
+	renderPassInfo.setFramebuffer(_pContext->getTonemapFramebuffer(_imageIndex.value()));
+	renderPassInfo.setRenderArea(renderArea);
+
+	commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
+	setViewport(commandBuffer, extent);
+
+	uint32_t tonemapScope = _gpuProfiler.scopeCreate("tonemap");
+	_gpuProfiler.scopeBegin(commandBuffer, tonemapScope);
+
+	uint32_t tonemapStatsScope = _pipelineStatistics.scopeCreate("tonemap");
+	_pipelineStatistics.scopeBegin(commandBuffer, tonemapStatsScope);
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _tonemapPipeline);
+	vk::DescriptorSet colorSet =
+			isTemporal ? _temporalUpscaler.getOutputSet() : _sceneColorSets[_frame];
+	vk::Extent2D inputExtent = isTemporal ? extent : _renderExtent;
+
+	std::array<vk::DescriptorSet, 3> sets = { colorSet, _autoExposure.getExposureSet(),
+		_tonemapLut.getSampledSet() };
+
+	commandBuffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eGraphics, _tonemapLayout, 0, sets, nullptr);
+
+	TonemapParameterConstants constants{};
+	constants.exposure = _exposure;
+	constants.white = _white;
+	constants.outputSize[0] = static_cast<float>(extent.width);
+	constants.outputSize[1] = static_cast<float>(extent.height);
+	constants.inputSize[0] = static_cast<float>(inputExtent.width);
+	constants.inputSize[1] = static_cast<float>(inputExtent.height);
+	constants.upscaleFilter = isTemporal ? UpscaleFilter::Nearest : _upscaleFilter;
+	constants.isAutoExposure = _isAutoExposure ? 1 : 0;
+	constants.isTonemapLut = _isTonemapLut ? 1 : 0;
+	constants.look = _tonemapLook;
+	constants.isDebugView = _debugView != DebugView::None ? 1 : 0;
+
+	commandBuffer.pushConstants(
+			_tonemapLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(constants), &constants);
+
+	commandBuffer.draw(3, 1, 0, 0);
+
+	_pipelineStatistics.scopeEnd(commandBuffer, tonemapStatsScope);
+	_gpuProfiler.scopeEnd(commandBuffer, tonemapScope);
+
+	commandBuffer.endRenderPass();
+}
+
+void RD::drawEnd(vk::CommandBuffer commandBuffer) {
+	bool isDrawStarted = _imageIndex.has_value();
+	assert(isDrawStarted);
+
+	PROFILE_ZONE("draw end");
+
+	if (_readbackId.has_value()) {
+		vk::Image image = _pContext->getFinalImage(_imageIndex.value());
+		_readbackRing.record(commandBuffer, _frame, image, _pContext->getSwapchainExtent(),
+				_pContext->getFinalFormat(), _pContext->getFinalLayout(), _readbackId.value());
+
+		_readbackId.reset();
+	}
+
+	_recordWindows(commandBuffer);
+
+	_gpuProfiler.scopeEnd(commandBuffer, _frameScope);
+
+	commandBuffer.end();
+	_frameAllocator.flush();
+
+	{
+		PROFILE_ZONE("submit");
+
+		std::array<vk::Semaphore, 2 + MAX_WINDOW_COUNT> waitSemaphores;
+		std::array<vk::PipelineStageFlags, 2 + MAX_WINDOW_COUNT> waitStages;
+		uint32_t waitCount = 0;
+
+		vk::SubmitInfo computeSubmitInfo;
+		bool isComputeRecorded = static_cast<bool>(_computeWaitStages);
+
+		if (isComputeRecorded) {
+			_computeCommandBuffers[_frame].end();
+
+			computeSubmitInfo.setCommandBuffers(_computeCommandBuffers[_frame]);
+			computeSubmitInfo.setSignalSemaphores(_computeSemaphores[_frame]);
+
+			waitSemaphores[waitCount] = _computeSemaphores[_frame];
+			waitStages[waitCount++] = _computeWaitStages;
+			_computeWaitStages = {};
+		}
+
+		vk::SubmitInfo submitInfo;
+		submitInfo.setCommandBuffers(commandBuffer);
+
+		// offscreen image is not shared with presentation engine
+		if (!_pContext->isHeadless()) {
+			waitSemaphores[waitCount] = _presentSemaphores[_frame];
+			waitStages[waitCount++] = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+
+			submitInfo.setSignalSemaphores(_renderSemaphores[_frame]);
+		}
+
+		// blits into other windows wait for their images, present waits for all of them
+		for (const WindowTarget &window : _windows) {
+			if (!window.isAcquired())
+				continue;
+
+			waitSemaphores[waitCount] = window.getAcquireSemaphore(_frame);
+			waitStages[waitCount++] = vk::PipelineStageFlagBits::eTransfer;
+		}
+
+		submitInfo.setWaitSemaphoreCount(waitCount);
+		submitInfo.setPWaitSemaphores(waitSemaphores.data());
+		submitInfo.setPWaitDstStageMask(waitStages.data());
+
+		{
+			std::lock_guard<std::mutex> lock(_queueMutex);
+
+			if (isComputeRecorded)
+				_pContext->getComputeQueue().submit(computeSubmitInfo, VK_NULL_HANDLE);
+
+			// uploads held back by drawBegin go ahead of frame in the same submit
+			_uploadManager.submitFrame(submitInfo, _fences[_frame]);
+		}
+
+		_gpuProfiler.submitted(_frame);
+		_framePacer.submitted(SDL_GetPerformanceCounter());
+	}
+
+	if (!_pContext->isHeadless())
+		_present();
+
+	_framePacer.presented(SDL_GetPerformanceCounter());
+
+	_imageIndex.reset();
+	_frame = (_frame + 1) % _framesInFlight;
+	_frameNumber++;
+
+	_resolutionUpdate();
+	_prepassUpdate();
+}
+
+void RD::_present() {
+	std::array<vk::SwapchainKHR, 1 + MAX_WINDOW_COUNT> swapchains;
+	std::array<uint32_t, 1 + MAX_WINDOW_COUNT> imageIndices;
+	std::array<vk::Result, 1 + MAX_WINDOW_COUNT> results;
+	uint32_t swapchainCount = 0;
+
+	swapchains[swapchainCount] = _pContext->getSwapchain();
+	imageIndices[swapchainCount++] = _imageIndex.value();
+
+	// other windows go out with the same present, their results are handed back to them
+	for (const WindowTarget &window : _windows) {
+		if (!window.isAcquired())
+			continue;
+
+		swapchains[swapchainCount] = window.getSwapchain();
+		imageIndices[swapchainCount++] = window.getImageIndex();
+	}
+
+	results.fill(vk::Result::eSuccess);
+
+	vk::PresentInfoKHR presentInfo;
+	presentInfo.setWaitSemaphores(_renderSemaphores[_frame]);
+	presentInfo.setSwapchainCount(swapchainCount);
+	presentInfo.setPSwapchains(swapchains.data());
+	presentInfo.setPImageIndices(imageIndices.data());
+	presentInfo.setPResults(results.data());
+
+	// increasing per swapchain, frame number keeps it so across recreation and windows skipping
+	// frames, only the first swapchain is waited for
+	uint64_t presentId = _frameNumber + 1;
+
+	std::array<uint64_t, 1 + MAX_WINDOW_COUNT> presentIds;
+	presentIds.fill(presentId);
+
+	vk::PresentIdKHR presentIdInfo;
+	presentIdInfo.setSwapchainCount(swapchainCount);
+	presentIdInfo.setPPresentIds(presentIds.data());
+
+	if (_pContext->isPresentWaitEnabled())
+		presentInfo.setPNext(&presentIdInfo);
+
+	vk::Result err;
+
+	{
+		PROFILE_ZONE("present");
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		err = _pContext->getPresentQueue().presentKHR(presentInfo);
+	}
+	_presentId = _pContext->isPresentWaitEnabled() ? presentId : 0;
+
+	// worst of all swapchains, first one is judged by its own
+	err = results[0];
+
+	uint32_t result = 1;
+
+	for (WindowTarget &window : _windows) {
+		if (window.isAcquired())
+			window.presented(results[result++]);
+	}
+
+	if (err == vk::Result::eErrorOutOfDateKHR || err == vk::Result::eSuboptimalKHR || _resized) {
+		// presents of old swapchain can not be waited for
+		_presentId = 0;
+
+		_swapchainRecreate();
+		_resized = false;
+	} else if (err != vk::Result::eSuccess) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Swapchain image presentation failed!");
+	}
+}
+
+void RD::_swapchainRecreate() {
+	VulkanContext::RetiredSwapchain retired = _pContext->recreateSwapchain(_width, _height);
+
+	// frames in flight may still draw to old images and attachments
+	destroyDeferred([this, retired]() mutable { _pContext->destroyRetired(retired); });
+
+	_resolutionUpdate();
+}
+
+void RD::_recordWindows(vk::CommandBuffer commandBuffer) {
+	if (_windows.size() == 0)
+		return;
+
+	bool isAcquired = false;
+
+	for (WindowTarget &window : _windows) {
+		vk::SwapchainKHR retired = window.update(_pContext);
+
+		// frames in flight may still blit to images of old one
+		if (retired) {
+			vk::Device device = _pContext->getDevice();
+			destroyDeferred([device, retired]() { device.destroySwapchainKHR(retired); });
+		}
+
+		isAcquired |= window.acquire(_pContext, _frame);
+	}
+
+	if (!isAcquired)
+		return;
+
+	vk::Image finalImage = _pContext->getFinalImage(_imageIndex.value());
+	vk::ImageLayout finalLayout = _pContext->getFinalLayout();
+	vk::ImageSubresourceRange subresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+	vk::ImageMemoryBarrier barrier;
+	barrier.setImage(finalImage);
+	barrier.setSubresourceRange(subresourceRange);
+	barrier.setOldLayout(finalLayout);
+	barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+	for (WindowTarget &window : _windows) {
+		if (window.isAcquired())
+			window.record(commandBuffer, finalImage, _pContext->getSwapchainExtent());
+	}
+
+	barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+	barrier.setNewLayout(finalLayout);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+	barrier.setDstAccessMask({});
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, nullptr, barrier);
+}
+
+void RD::_prepassUpdate() {
+	float depthMilliseconds, materialMilliseconds;
+	uint64_t depthSampleCount, sampleCount;
+
+	// scopes of a frame are collected together, material one tells whether sample is new
+	bool isSampled = _prepassController.isEnabled() &&
+			_gpuProfiler.getLastSample("depth", depthMilliseconds, depthSampleCount) &&
+			_gpuProfiler.getLastSample("material", materialMilliseconds, sampleCount);
+
+	if (isSampled && sampleCount != _prepassSampleCount) {
+		_prepassSampleCount = sampleCount;
+		_prepassController.update(depthMilliseconds + materialMilliseconds);
+	}
+}
+
+void RD::_attachmentSetsUpdate() {
+	uint64_t version = _pContext->getAttachmentVersion();
+
+	if (_attachmentSetVersions[_frame] == version)
+		return;
+
+	updateSceneColor(_pContext->getDevice(), _pContext->getColorAttachment().getImageView(),
+			_sceneColorSampler, _sceneColorSets[_frame]);
+
+	if (isDeferredEnabled())
+		updateGBufferAttachments(_pContext->getDevice(), _pContext, _gbufferSets[_frame]);
+
+	_attachmentSetVersions[_frame] = version;
+}
+
+void RD::_resolutionUpdate() {
+	float milliseconds;
+	uint64_t sampleCount;
+
+	bool isSampled = _resolutionController.isEnabled() &&
+			_gpuProfiler.getLastSample("frame", milliseconds, sampleCount);
+
+	// frames of the same pool are collected only after their fence, a sample is fed once
+	if (isSampled && sampleCount != _resolutionSampleCount) {
+		_resolutionSampleCount = sampleCount;
+		_resolutionController.update(milliseconds);
+	}
+
+	vk::Extent2D extent = _pContext->getRenderExtent();
+	float scale = _resolutionController.getScale();
+
+	_renderExtent.width = std::clamp(
+			static_cast<uint32_t>(extent.width * scale + 0.5f), 1u, extent.width);
+	_renderExtent.height = std::clamp(
+			static_cast<uint32_t>(extent.height * scale + 0.5f), 1u, extent.height);
+
+	_jitter = glm::vec2(0.0f);
+
+	if (_upscaleFilter == UpscaleFilter::Temporal) {
+		uint32_t phaseCount =
+				TemporalUpscaler::getPhaseCount(_renderExtent, _pContext->getSwapchainExtent());
+		_jitter = TemporalUpscaler::getJitter(_frameNumber, phaseCount);
+	}
+}
+
+void RD::_readbackCollect(uint32_t frame) {
+	Readback readback;
+
+	if (_readbackRing.collect(frame, readback))
+		_readbacks.push_back(std::move(readback));
+}
+
+// milliseconds since counter, which is moved to now for next step
+static float _stepMilliseconds(uint64_t &counter) {
+	uint64_t now = SDL_GetPerformanceCounter();
+	float milliseconds = static_cast<float>(now - counter) * 1000.0f /
+			static_cast<float>(SDL_GetPerformanceFrequency());
+	counter = now;
+
+	return milliseconds;
+}
+
+void RD::windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
+	uint64_t counter = SDL_GetPerformanceCounter();
+
+	_pContext->initialize(
+			surface, width, height, _useBindless, _useDeferred, _shadingRateMode);
+	_startupStats.deviceMilliseconds = _stepMilliseconds(counter);
+
+	// attachments of context are allocated by same allocator
+	_allocator = _pContext->getAllocator();
+
+	_readbackRing.initialize(_allocator, _framesInFlight);
+	_renderGraph.initialize(_pContext->getDevice(), _allocator);
+	_resolutionUpdate();
+
+	{
+		// memory type optimal sampled images go to, formats sharing it end up in pool
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { 1024, 1024, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = static_cast<VkImageUsageFlags>(TEXTURE_USAGE);
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocCreateInfo = {};
+		allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+
+		VmaPoolCreateInfo poolCreateInfo = {};
+		VkResult err = vmaFindMemoryTypeIndexForImageInfo(
+				_allocator, &imageInfo, &allocCreateInfo, &poolCreateInfo.memoryTypeIndex);
+
+		if (err == VK_SUCCESS)
+			err = vmaCreatePool(_allocator, &poolCreateInfo, &_texturePool);
+
+		// textures then share default pools and are not defragmented
+		if (err != VK_SUCCESS) {
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Texture memory pool creation failed!");
+			_texturePool = VK_NULL_HANDLE;
+		}
+	}
+
+	// commands
+
+	vk::Device device = _pContext->getDevice();
+
+	_mipGenerator.initialize(device, _pContext->getPhysicalDevice(), _allocator);
+
+	_uploadManager.initialize(_pContext, _allocator);
+
+	_gpuProfiler.initialize(device, _pContext->getPhysicalDevice(),
+			_pContext->getGraphicsQueueFamily(), _framesInFlight, "graphics queue");
+	_pipelineStatistics.initialize(
+			device, _pContext->isPipelineStatisticsEnabled(), _framesInFlight);
+
+	// set before window init, frames would be measured by nothing
+	if (_resolutionController.isEnabled() && !_gpuProfiler.isSupported())
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Dynamic resolution needs GPU timestamps!");
+
+	if (_prepassController.isEnabled() && !_gpuProfiler.isSupported())
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Adaptive prepass needs GPU timestamps!");
+
+	vk::CommandBufferAllocateInfo allocInfo;
+	allocInfo.setCommandPool(_pContext->getCommandPool());
+	allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+	allocInfo.setCommandBufferCount(_framesInFlight);
+
+	{
+		vk::Result err = device.allocateCommandBuffers(&allocInfo, _commandBuffers);
+
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("Command buffers allocation failed!");
+	}
+
+	// sync
+
+	vk::SemaphoreCreateInfo semaphoreInfo = {};
+	vk::FenceCreateInfo fenceInfo = { vk::FenceCreateFlagBits::eSignaled };
+
+	for (uint32_t i = 0; i < _framesInFlight; i++) {
+		_presentSemaphores[i] = device.createSemaphore(semaphoreInfo);
+		_renderSemaphores[i] = device.createSemaphore(semaphoreInfo);
+		_fences[i] = device.createFence(fenceInfo);
+	}
+
+	// compute family aliases graphics one when device has no other
+	_asyncCompute = _pContext->getComputeQueueFamily() != _pContext->getGraphicsQueueFamily();
+
+	if (_asyncCompute) {
+		_sharedQueueFamilies = { _pContext->getGraphicsQueueFamily(),
+			_pContext->getComputeQueueFamily() };
+
+		vk::CommandPoolCreateInfo poolInfo = {};
+		poolInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+		poolInfo.setQueueFamilyIndex(_pContext->getComputeQueueFamily());
+
+		_computeCommandPool = device.createCommandPool(poolInfo);
+
+		vk::CommandBufferAllocateInfo computeAllocInfo;
+		computeAllocInfo.setCommandPool(_computeCommandPool);
+		computeAllocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+		computeAllocInfo.setCommandBufferCount(_framesInFlight);
+
+		vk::Result err = device.allocateCommandBuffers(&computeAllocInfo, _computeCommandBuffers);
+
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("Compute command buffers allocation failed!");
+
+		for (uint32_t i = 0; i < _framesInFlight; i++)
+			_computeSemaphores[i] = device.createSemaphore(semaphoreInfo);
+	}
+
+	// descriptor pool
+
+	// fixed sets of passes only, material texture sets come from their own allocator
+	std::array<vk::DescriptorPoolSize, 7> poolSizes;
+	poolSizes[0] = { vk::DescriptorType::eUniformBuffer, _framesInFlight * (3 + MAX_VIEW_COUNT) };
+	poolSizes[1] = { vk::DescriptorType::eInputAttachment, 4 };
+	poolSizes[2] = {
+		vk::DescriptorType::eStorageBuffer, _framesInFlight * (37 + 5 * MAX_VIEW_COUNT) + 4
+	};
+	poolSizes[3] = { vk::DescriptorType::eCombinedImageSampler,
+		128 + MAX_IMPOSTOR_DRAW_COUNT + SPECULAR_LEVEL_COUNT + MAX_FRAMES_IN_FLIGHT * 5 + 3 };
+	poolSizes[4] = { vk::DescriptorType::eStorageImage,
+		32 + MAX_CUBEMAP_LEVELS * 4 + SPECULAR_LEVEL_COUNT * 2 + TEMPORAL_HISTORY_COUNT +
+				ATMOSPHERE_CUBEMAP_LEVELS * 2 + 5 };
+	// ranges of frame allocator
+	poolSizes[5] = { vk::DescriptorType::eUniformBufferDynamic, _framesInFlight * 4 };
+	poolSizes[6] = { vk::DescriptorType::eStorageBufferDynamic, _framesInFlight * 5 };
+
+	uint32_t maxSets = 0;
+
+	for (const vk::DescriptorPoolSize &poolSize : poolSizes) {
+		maxSets += poolSize.descriptorCount;
+	}
+
+	vk::DescriptorPoolCreateInfo createInfo;
+	createInfo.setMaxSets(maxSets);
+	createInfo.setPoolSizes(poolSizes);
+
+	_descriptorPool = device.createDescriptorPool(createInfo);
+
+	// light
+
+	_lightStorage.initialize(_pContext->getDevice(), _allocator, _descriptorPool);
+	_lightCuller.initialize(_pContext->getDevice(), _allocator, _descriptorPool, _lightStorage);
+	_shadowAtlas.initialize(_pContext->getDevice(), _allocator, _descriptorPool, _lightStorage);
+
+	// geometry
+
+	_frameAllocator.initialize(_allocator, _pContext->getPhysicalDevice(), _framesInFlight);
+
+	_geometryArena.initialize(_allocator);
+	_skinStorage.initialize(_pContext->getDevice(), _allocator, _descriptorPool, _geometryArena);
+	_morphStorage.initialize(_pContext->getDevice(), _allocator, _descriptorPool, _geometryArena);
+
+	// bindless
+
+	if (isBindlessEnabled())
+		_bindlessStorage.initialize(device);
+
+	// material
+
+	_materialStorage.initialize(_allocator);
 
 	// uniform
 
-	{
-		vk::DescriptorSetLayoutBinding binding;
-		binding.setBinding(0);
-		binding.setDescriptorType(vk::DescriptorType::eUniformBuffer);
-		binding.setDescriptorCount(1);
-		binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+	{
+		std::array<vk::DescriptorSetLayoutBinding, 6> bindings;
+		bindings[0].setBinding(0);
+		bindings[0].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+		bindings[0].setDescriptorCount(1);
+		bindings[0].setStageFlags(
+				vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+
+		// instance transforms
+		bindings[1].setBinding(1);
+		bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[1].setDescriptorCount(1);
+		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eVertex);
+
+		// instance material indices
+		bindings[2].setBinding(2);
+		bindings[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[2].setDescriptorCount(1);
+		bindings[2].setStageFlags(vk::ShaderStageFlagBits::eVertex);
+
+		// material factors and bindless texture indices, shared by every frame
+		bindings[3].setBinding(3);
+		bindings[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[3].setDescriptorCount(1);
+		bindings[3].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+		// overdraw counters, shared by every frame
+		bindings[4].setBinding(4);
+		bindings[4].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[4].setDescriptorCount(1);
+		bindings[4].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+		// instance normal transforms
+		bindings[5].setBinding(5);
+		bindings[5].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[5].setDescriptorCount(1);
+		bindings[5].setStageFlags(vk::ShaderStageFlagBits::eVertex);
 
 		vk::DescriptorSetLayoutCreateInfo createInfo;
-		createInfo.setBindings(binding);
+		createInfo.setBindings(bindings);
 
 		vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_uniformLayout);
 
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("UBO descriptor set layout creation failed!");
 
-		std::vector<vk::DescriptorSetLayout> layouts(FRAMES_IN_FLIGHT, _uniformLayout);
+		std::vector<vk::DescriptorSetLayout> layouts(
+				_framesInFlight * MAX_VIEW_COUNT, _uniformLayout);
 
 		vk::DescriptorSetAllocateInfo allocInfo;
 		allocInfo.setDescriptorPool(_descriptorPool);
-		allocInfo.setDescriptorSetCount(static_cast<uint32_t>(FRAMES_IN_FLIGHT));
 		allocInfo.setSetLayouts(layouts);
 
-		std::array<vk::DescriptorSet, FRAMES_IN_FLIGHT> uniformSets{};
+		std::array<vk::DescriptorSet, MAX_FRAMES_IN_FLIGHT * MAX_VIEW_COUNT> uniformSets{};
 
 		err = device.allocateDescriptorSets(&allocInfo, uniformSets.data());
 
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("UBO descriptor set allocation failed!");
 
-		for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
-			_uniformBuffers[i] = bufferCreate(
-					vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst,
-					sizeof(UniformBufferObject), &_uniformAllocInfos[i]);
+		// single counter until overdraw view grows it, nothing is counted meanwhile
+		_overdrawBuffer = bufferCreate(MemoryCategory::RenderTarget, BufferClass::Static,
+				vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+				sizeof(uint32_t));
+		vk::DescriptorBufferInfo overdrawInfo = _overdrawBuffer.getBufferInfo();
 
-			_uniformSets[i] = uniformSets[i];
+		for (uint32_t i = 0; i < _framesInFlight; i++) {
+			// slots of particles follow those of instances, written by particle storage
+			_instanceBuffers[i] = bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+					vk::BufferUsageFlagBits::eStorageBuffer,
+					sizeof(InstanceTransform) * INSTANCE_SLOT_COUNT, &_instanceAllocInfos[i]);
 
-			vk::DescriptorBufferInfo bufferInfo = _uniformBuffers[i].getBufferInfo();
+			// zeroed, so instances not yet written read valid index
+			_instanceMaterialBuffers[i] = bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+					vk::BufferUsageFlagBits::eStorageBuffer,
+					sizeof(uint32_t) * INSTANCE_SLOT_COUNT, &_instanceMaterialAllocInfos[i]);
 
-			vk::WriteDescriptorSet writeInfo;
-			writeInfo.setDstSet(_uniformSets[i]);
-			writeInfo.setDstBinding(0);
-			writeInfo.setDstArrayElement(0);
-			writeInfo.setDescriptorType(vk::DescriptorType::eUniformBuffer);
-			writeInfo.setDescriptorCount(1);
-			writeInfo.setBufferInfo(bufferInfo);
+			memset(_instanceMaterialAllocInfos[i].pMappedData, 0,
+					sizeof(uint32_t) * INSTANCE_SLOT_COUNT);
+
+			_instanceNormalBuffers[i] = bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+					vk::BufferUsageFlagBits::eStorageBuffer,
+					sizeof(InstanceTransform) * INSTANCE_SLOT_COUNT, &_instanceNormalAllocInfos[i]);
+
+			vk::DescriptorBufferInfo instanceInfo = _instanceBuffers[i].getBufferInfo();
+			vk::DescriptorBufferInfo instanceMaterialInfo =
+					_instanceMaterialBuffers[i].getBufferInfo();
+			vk::DescriptorBufferInfo instanceNormalInfo = _instanceNormalBuffers[i].getBufferInfo();
+			vk::DescriptorBufferInfo materialInfo = _materialStorage.getBuffer().getBufferInfo();
+
+			// views share instance and material buffers of frame
+			for (uint32_t j = 0; j < MAX_VIEW_COUNT; j++) {
+				_uniformBuffers[i][j] = bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+						vk::BufferUsageFlagBits::eUniformBuffer |
+								vk::BufferUsageFlagBits::eTransferDst,
+						sizeof(UniformBufferObject), &_uniformAllocInfos[i][j]);
+
+				_uniformSets[i][j] = uniformSets[i * MAX_VIEW_COUNT + j];
+
+				vk::DescriptorBufferInfo bufferInfo = _uniformBuffers[i][j].getBufferInfo();
+
+				vk::WriteDescriptorSet writeInfo;
+				writeInfo.setDstSet(_uniformSets[i][j]);
+				writeInfo.setDstBinding(0);
+				writeInfo.setDstArrayElement(0);
+				writeInfo.setDescriptorType(vk::DescriptorType::eUniformBuffer);
+				writeInfo.setDescriptorCount(1);
+				writeInfo.setBufferInfo(bufferInfo);
+
+				device.updateDescriptorSets(writeInfo, nullptr);
+
+				writeInfo.setDstBinding(1);
+				writeInfo.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+				writeInfo.setBufferInfo(instanceInfo);
+
+				device.updateDescriptorSets(writeInfo, nullptr);
+
+				writeInfo.setDstBinding(2);
+				writeInfo.setBufferInfo(instanceMaterialInfo);
+
+				device.updateDescriptorSets(writeInfo, nullptr);
+
+				writeInfo.setDstBinding(3);
+				writeInfo.setBufferInfo(materialInfo);
+
+				device.updateDescriptorSets(writeInfo, nullptr);
+
+				writeInfo.setDstBinding(4);
+				writeInfo.setBufferInfo(overdrawInfo);
+
+				device.updateDescriptorSets(writeInfo, nullptr);
+
+				writeInfo.setDstBinding(5);
+				writeInfo.setBufferInfo(instanceNormalInfo);
 
-			device.updateDescriptorSets(writeInfo, nullptr);
+				device.updateDescriptorSets(writeInfo, nullptr);
+			}
 		}
 	}
 
-	// input attachment
+	// particles write instance buffers
+	_particleStorage.initialize(device, _descriptorPool);
+	_terrainStorage.initialize(device, _descriptorPool);
+
+	// scene color
 
 	{
 		vk::DescriptorSetLayoutBinding binding;
 		binding.setBinding(0);
-		binding.setDescriptorType(vk::DescriptorType::eInputAttachment);
+		binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
 		binding.setDescriptorCount(1);
 		binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
 		vk::DescriptorSetLayoutCreateInfo createInfo;
 		createInfo.setBindings(binding);
 
-		vk::Result err =
-				device.createDescriptorSetLayout(&createInfo, nullptr, &_inputAttachmentLayout);
+		vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_sceneColorLayout);
 
 		if (err != vk::Result::eSuccess)
-			throw std::runtime_error("Input attachment descriptor set layout creation failed!");
+			throw std::runtime_error("Scene color descriptor set layout creation failed!");
+
+		std::array<vk::DescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+		layouts.fill(_sceneColorLayout);
 
 		vk::DescriptorSetAllocateInfo allocInfo;
 		allocInfo.setDescriptorPool(_descriptorPool);
-		allocInfo.setDescriptorSetCount(1);
-		allocInfo.setSetLayouts(_inputAttachmentLayout);
+		allocInfo.setSetLayouts(layouts);
 
-		err = device.allocateDescriptorSets(&allocInfo, &_inputAttachmentSet);
+		err = device.allocateDescriptorSets(&allocInfo, _sceneColorSets);
 
 		if (err != vk::Result::eSuccess)
-			throw std::runtime_error("Input attachment descriptor set allocation failed!");
+			throw std::runtime_error("Scene color descriptor set allocation failed!");
 
-		updateInputAttachment(
-				device, _pContext->getColorAttachment().getImageView(), _inputAttachmentSet);
+		// both filters pick texel positions themselves
+		_sceneColorSampler = samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge,
+				0.0f, false);
+
+		_temporalUpscaler.initialize(device, _descriptorPool, _sceneColorLayout, _sceneColorSampler);
+		_autoExposure.initialize(device, _descriptorPool, _sceneColorSampler);
+
+		if (getShadingRateMode() == ShadingRateMode::Image)
+			_shadingRateGenerator.initialize(device, _descriptorPool, _sceneColorSampler,
+					_pContext->getShadingRateTexelSize());
+		_tonemapLut.initialize(device, _descriptorPool);
+		_skyAtmosphere.initialize(device, _descriptorPool, _framesInFlight);
 	}
 
-	// textures
+	// g-buffer
 
-	{
+	if (isDeferredEnabled()) {
 		std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
 
-		bindings[0].setBinding(0);
-		bindings[0].setDescriptorCount(1);
-		bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		bindings[0].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		for (uint32_t i = 0; i < bindings.size(); i++) {
+			bindings[i].setBinding(i);
+			bindings[i].setDescriptorType(vk::DescriptorType::eInputAttachment);
+			bindings[i].setDescriptorCount(1);
+			bindings[i].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		}
 
-		bindings[1].setBinding(1);
-		bindings[1].setDescriptorCount(1);
-		bindings[1].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		vk::DescriptorSetLayoutCreateInfo createInfo;
+		createInfo.setBindings(bindings);
 
-		bindings[2].setBinding(2);
-		bindings[2].setDescriptorCount(1);
-		bindings[2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		bindings[2].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_gbufferLayout);
 
-		bindings[3].setBinding(3);
-		bindings[3].setDescriptorCount(1);
-		bindings[3].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		bindings[3].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("G-buffer descriptor set layout creation failed!");
+
+		std::array<vk::DescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+		layouts.fill(_gbufferLayout);
+
+		vk::DescriptorSetAllocateInfo allocInfo;
+		allocInfo.setDescriptorPool(_descriptorPool);
+		allocInfo.setSetLayouts(layouts);
+
+		err = device.allocateDescriptorSets(&allocInfo, _gbufferSets);
+
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("G-buffer descriptor set allocation failed!");
+	}
+
+	// textures
+
+	{
+		// albedo, normal, metallic roughness, lightmap
+		std::array<vk::DescriptorSetLayoutBinding, MATERIAL_TEXTURE_COUNT> bindings;
+
+		for (uint32_t i = 0; i < bindings.size(); i++) {
+			bindings[i].setBinding(i);
+			bindings[i].setDescriptorCount(1);
+			bindings[i].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+			bindings[i].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		}
 
 		vk::DescriptorSetLayoutCreateInfo createInfo = {};
 		createInfo.setBindings(bindings);
 
+		if (isPushDescriptorEnabled())
+			createInfo.setFlags(vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR);
+
 		vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_textureLayout);
 
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("Texture descriptor set layout creation failed!");
+
+		// pushed template needs material pipeline layout, it is created with it
+		if (!isPushDescriptorEnabled())
+			_textureUpdateTemplate = _createTextureTemplate(device, _textureLayout,
+					vk::DescriptorUpdateTemplateType::eDescriptorSet, VK_NULL_HANDLE);
+
+		std::vector<vk::DescriptorPoolSize> setSizes = {
+			{ vk::DescriptorType::eCombinedImageSampler, MATERIAL_TEXTURE_COUNT },
+		};
+
+		_textureSetAllocator.initialize(device, setSizes, TEXTURE_SET_POOL_SET_COUNT, true);
 	}
 
 	// sky
@@ -1054,12 +2985,13 @@ void RD::windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("Sky descriptor set layout creation failed!");
 
+		std::vector<vk::DescriptorSetLayout> layouts(_framesInFlight, _skySetLayout);
+
 		vk::DescriptorSetAllocateInfo allocInfo;
 		allocInfo.setDescriptorPool(_descriptorPool);
-		allocInfo.setDescriptorSetCount(1);
-		allocInfo.setSetLayouts(_skySetLayout);
+		allocInfo.setSetLayouts(layouts);
 
-		err = device.allocateDescriptorSets(&allocInfo, &_skySet);
+		err = device.allocateDescriptorSets(&allocInfo, _skySets);
 
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("Sky descriptor set allocation failed!");
@@ -1068,7 +3000,7 @@ void RD::windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
 	// ibl
 
 	{
-		std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+		std::array<vk::DescriptorSetLayoutBinding, 5> bindings;
 		bindings[0].setBinding(0);
 		bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
 		bindings[0].setDescriptorCount(1);
@@ -1079,11 +3011,23 @@ void RD::windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
 		bindings[1].setDescriptorCount(1);
 		bindings[1].setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
+		// light probes
 		bindings[2].setBinding(2);
-		bindings[2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		bindings[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
 		bindings[2].setDescriptorCount(1);
 		bindings[2].setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
+		// reflection probe array and its boxes
+		bindings[3].setBinding(3);
+		bindings[3].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		bindings[3].setDescriptorCount(1);
+		bindings[3].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+		bindings[4].setBinding(4);
+		bindings[4].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[4].setDescriptorCount(1);
+		bindings[4].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
 		vk::DescriptorSetLayoutCreateInfo createInfo;
 		createInfo.setBindings(bindings);
 
@@ -1092,63 +3036,50 @@ void RD::windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("IBL descriptor set layout creation failed!");
 
+		std::vector<vk::DescriptorSetLayout> layouts(_framesInFlight, _iblSetLayout);
+
 		vk::DescriptorSetAllocateInfo allocInfo;
 		allocInfo.setDescriptorPool(_descriptorPool);
-		allocInfo.setDescriptorSetCount(1);
-		allocInfo.setSetLayouts(_iblSetLayout);
+		allocInfo.setSetLayouts(layouts);
 
-		err = device.allocateDescriptorSets(&allocInfo, &_iblSet);
+		err = device.allocateDescriptorSets(&allocInfo, _iblSets);
 
 		if (err != vk::Result::eSuccess)
 			throw std::runtime_error("IBL descriptor set allocation failed!");
 	}
 
-	vk::PushConstantRange pushConstant;
-	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eVertex);
-	pushConstant.setOffset(0);
-	pushConstant.setSize(sizeof(MeshPushConstants));
+	// one pipeline per layout, depth pass fetches position stream only
+	vk::PipelineVertexInputStateCreateInfo vertexInput = MaterialLayout::getInputState();
+	vk::PipelineVertexInputStateCreateInfo positionInput = PositionLayout::getInputState();
 
-	vk::VertexInputBindingDescription binding = Vertex::getBindingDescription();
-	std::array<vk::VertexInputAttributeDescription, 4> attribute =
-			Vertex::getAttributeDescriptions();
+	// each pipeline is compiled on its own thread into shared pipeline cache, recipe is kept to
+	// build it again once hot reload recompiles its shader
+	std::vector<std::pair<vk::Pipeline *, std::future<vk::Pipeline>>> pipelineBuilds;
 
-	vk::PipelineVertexInputStateCreateInfo vertexInput;
-	vertexInput.setVertexBindingDescriptions(binding);
-	vertexInput.setVertexAttributeDescriptions(attribute);
+	auto addPipeline = [&](const PipelineRecipe &recipe) {
+		_pipelineRecipes.push_back(recipe);
+		pipelineBuilds.emplace_back(recipe.pPipeline, std::async(std::launch::async, recipe.build));
+	};
 
 	// depth
 
 	{
-		DepthShader shader;
-
-		size_t codeSize = sizeof(shader.vertexCode);
-		vk::ShaderModule vertexStage = createShaderModule(device, shader.vertexCode, codeSize);
-
-		codeSize = sizeof(shader.fragmentCode);
-		vk::ShaderModule fragmentStage = createShaderModule(device, shader.fragmentCode, codeSize);
-
 		vk::PipelineLayoutCreateInfo createInfo = {};
-		createInfo.setPushConstantRanges(pushConstant);
+		createInfo.setSetLayouts(_uniformLayout);
 
 		_depthLayout = device.createPipelineLayout(createInfo);
-		_depthPipeline = createPipeline(device, vertexStage, fragmentStage, _depthLayout,
-				_pContext->getRenderPass(), 0, vertexInput, true);
 
-		device.destroyShaderModule(vertexStage);
-		device.destroyShaderModule(fragmentStage);
+		addPipeline({ &_depthPipeline, "depth", [this, device, positionInput]() {
+			return _buildPipeline(device, "depth", DepthShader::vertexCode,
+					sizeof(DepthShader::vertexCode), DepthShader::fragmentCode,
+					sizeof(DepthShader::fragmentCode), _depthLayout, _pContext->getRenderPass(),
+					0, positionInput, true);
+		} });
 	}
 
 	// sky
 
 	{
-		SkyShader shader;
-
-		size_t codeSize = sizeof(shader.vertexCode);
-		vk::ShaderModule vertexStage = createShaderModule(device, shader.vertexCode, codeSize);
-
-		codeSize = sizeof(shader.fragmentCode);
-		vk::ShaderModule fragmentStage = createShaderModule(device, shader.fragmentCode, codeSize);
-
 		vk::PushConstantRange pushConstant;
 		pushConstant.setStageFlags(vk::ShaderStageFlagBits::eFragment);
 		pushConstant.setOffset(0);
@@ -1158,106 +3089,314 @@ void RD::windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
 		createInfo.setSetLayouts(_skySetLayout);
 		createInfo.setPushConstantRanges(pushConstant);
 
+		// deferred path draws sky next to lighting, g-buffer pass has no color target for it
+		uint32_t subpass = isDeferredEnabled() ? LIGHTING_PASS : MAIN_PASS;
+
 		_skyLayout = device.createPipelineLayout(createInfo);
-		_skyPipeline = createPipeline(
-				device, vertexStage, fragmentStage, _skyLayout, _pContext->getRenderPass(), 1, {});
 
-		device.destroyShaderModule(vertexStage);
-		device.destroyShaderModule(fragmentStage);
+		addPipeline({ &_skyPipeline, "sky", [this, device, subpass]() {
+			return _buildPipeline(device, "sky", SkyShader::vertexCode,
+					sizeof(SkyShader::vertexCode), SkyShader::fragmentCode,
+					sizeof(SkyShader::fragmentCode), _skyLayout, _pContext->getRenderPass(),
+					subpass, {});
+		} });
 	}
 
 	// material
 
 	{
-		MaterialShader shader;
+		vk::DescriptorSetLayout materialSetLayout = _textureLayout;
+
+		if (isBindlessEnabled())
+			materialSetLayout = _bindlessStorage.getBindlessSetLayout();
+
+		// deferred variants write g-buffer, layout is kept so draws bind the same sets
+		std::string shader;
+		const uint32_t *pVertexCode;
+		const uint32_t *pFragmentCode;
+		size_t vertexCodeSize, fragmentCodeSize;
+
+		if (isDeferredEnabled() && isBindlessEnabled()) {
+			shader = "gbuffer_bindless";
+			pVertexCode = GbufferBindlessShader::vertexCode;
+			pFragmentCode = GbufferBindlessShader::fragmentCode;
+			vertexCodeSize = sizeof(GbufferBindlessShader::vertexCode);
+			fragmentCodeSize = sizeof(GbufferBindlessShader::fragmentCode);
+		} else if (isDeferredEnabled()) {
+			shader = "gbuffer";
+			pVertexCode = GbufferShader::vertexCode;
+			pFragmentCode = GbufferShader::fragmentCode;
+			vertexCodeSize = sizeof(GbufferShader::vertexCode);
+			fragmentCodeSize = sizeof(GbufferShader::fragmentCode);
+		} else if (isBindlessEnabled()) {
+			shader = "material_bindless";
+			pVertexCode = MaterialBindlessShader::vertexCode;
+			pFragmentCode = MaterialBindlessShader::fragmentCode;
+			vertexCodeSize = sizeof(MaterialBindlessShader::vertexCode);
+			fragmentCodeSize = sizeof(MaterialBindlessShader::fragmentCode);
+		} else {
+			shader = "material";
+			pVertexCode = MaterialShader::vertexCode;
+			pFragmentCode = MaterialShader::fragmentCode;
+			vertexCodeSize = sizeof(MaterialShader::vertexCode);
+			fragmentCodeSize = sizeof(MaterialShader::fragmentCode);
+		}
+
+		std::array<vk::DescriptorSetLayout, 4> layouts = {
+			_uniformLayout,
+			_iblSetLayout,
+			_lightStorage.getLightSetLayout(),
+			materialSetLayout,
+		};
+
+		vk::PipelineLayoutCreateInfo createInfo = {};
+		createInfo.setSetLayouts(layouts);
+
+		uint32_t colorAttachmentCount = isDeferredEnabled() ? 3 : 1;
+		bool useShadingRate = getShadingRateMode() != ShadingRateMode::Off;
+
+		_materialLayout = device.createPipelineLayout(createInfo);
+
+		if (isPushDescriptorEnabled())
+			_textureUpdateTemplate = _createTextureTemplate(device, _textureLayout,
+					vk::DescriptorUpdateTemplateType::ePushDescriptorsKHR, _materialLayout);
+
+		// constant id of each bit is its index, see shaders/include/permutation_incl.glsl
+		for (uint32_t j = 0; j < MATERIAL_PERMUTATION_BIT_COUNT; j++) {
+			_materialSpecializationEntries[j].setConstantID(j);
+			_materialSpecializationEntries[j].setOffset(j * sizeof(VkBool32));
+			_materialSpecializationEntries[j].setSize(sizeof(VkBool32));
+		}
+
+		for (uint32_t i = 0; i < MATERIAL_PERMUTATION_COUNT; i++) {
+			// g-buffer is shaded by lighting pass, point lights do not permute it
+			if (isDeferredEnabled() && (i & MATERIAL_POINT_LIGHTS_BIT))
+				continue;
+
+			// materials derive tangents for normal maps only
+			if ((i & MATERIAL_DERIVED_TANGENTS_BIT) && !(i & MATERIAL_NORMAL_MAP_BIT))
+				continue;
+
+			bool isAlphaTested = i & MATERIAL_ALPHA_TEST_BIT;
+
+			// alpha is tested for albedo maps of materials without normal map only
+			if (isAlphaTested && (!(i & MATERIAL_ALBEDO_MAP_BIT) || (i & MATERIAL_NORMAL_MAP_BIT)))
+				continue;
+
+			for (uint32_t j = 0; j < MATERIAL_PERMUTATION_BIT_COUNT; j++)
+				_materialSpecializationData[i][j] = (i >> j) & 1 ? VK_TRUE : VK_FALSE;
+
+			_materialSpecializations[i].setMapEntries(_materialSpecializationEntries);
+			_materialSpecializations[i].setDataSize(sizeof(_materialSpecializationData[i]));
+			_materialSpecializations[i].setPData(_materialSpecializationData[i].data());
+
+			addPipeline({ &_materialPipelines[i], shader, [=]() {
+				return _buildPipeline(device, shader, pVertexCode, vertexCodeSize, pFragmentCode,
+						fragmentCodeSize, _materialLayout, _pContext->getRenderPass(), MAIN_PASS,
+						vertexInput, false, colorAttachmentCount, &_materialSpecializations[i],
+						useShadingRate);
+			} });
+
+			// same compare, depth test alone rejects what is hidden by earlier draws, alpha
+			// tested draws write depth after prepass too
+			if (_prepassController.isEnabled() || isAlphaTested) {
+				addPipeline({ &_materialDepthPipelines[i], shader, [=]() {
+					return _buildPipeline(device, shader, pVertexCode, vertexCodeSize,
+							pFragmentCode, fragmentCodeSize, _materialLayout,
+							_pContext->getRenderPass(), MAIN_PASS, vertexInput, true,
+							colorAttachmentCount, &_materialSpecializations[i], useShadingRate);
+				} });
+			}
+		}
+	}
 
-		size_t codeSize = sizeof(shader.vertexCode);
-		vk::ShaderModule vertexStage = createShaderModule(device, shader.vertexCode, codeSize);
+	// terrain
 
-		codeSize = sizeof(shader.fragmentCode);
-		vk::ShaderModule fragmentStage = createShaderModule(device, shader.fragmentCode, codeSize);
+	{
+		// deferred path shades g-buffer it writes in lighting pass
+		bool isDeferred = isDeferredEnabled();
+		std::string shader = isDeferred ? "terrain_gbuffer" : "terrain";
+		const uint32_t *pVertexCode =
+				isDeferred ? TerrainGbufferShader::vertexCode : TerrainShader::vertexCode;
+		const uint32_t *pFragmentCode =
+				isDeferred ? TerrainGbufferShader::fragmentCode : TerrainShader::fragmentCode;
+		size_t vertexCodeSize = isDeferred ? sizeof(TerrainGbufferShader::vertexCode)
+										   : sizeof(TerrainShader::vertexCode);
+		size_t fragmentCodeSize = isDeferred ? sizeof(TerrainGbufferShader::fragmentCode)
+											 : sizeof(TerrainShader::fragmentCode);
+
+		vk::PushConstantRange pushConstant;
+		pushConstant.setStageFlags(
+				vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+		pushConstant.setOffset(0);
+		pushConstant.setSize(sizeof(TerrainStorage::TerrainConstants));
 
 		std::array<vk::DescriptorSetLayout, 4> layouts = {
 			_uniformLayout,
 			_iblSetLayout,
 			_lightStorage.getLightSetLayout(),
-			_textureLayout,
+			_terrainStorage.getSetLayout(),
 		};
 
 		vk::PipelineLayoutCreateInfo createInfo = {};
 		createInfo.setSetLayouts(layouts);
 		createInfo.setPushConstantRanges(pushConstant);
 
-		_materialLayout = device.createPipelineLayout(createInfo);
-		_materialPipeline = createPipeline(device, vertexStage, fragmentStage, _materialLayout,
-				_pContext->getRenderPass(), 1, vertexInput);
+		_terrainLayout = device.createPipelineLayout(createInfo);
+
+		uint32_t colorAttachmentCount = isDeferred ? 3 : 1;
+		vk::PipelineVertexInputStateCreateInfo gridInput = TerrainStorage::getInputState();
 
-		device.destroyShaderModule(vertexStage);
-		device.destroyShaderModule(fragmentStage);
+		// left out of depth prepass, writes depth of its own
+		addPipeline({ &_terrainPipeline, shader, [=]() {
+			return _buildPipeline(device, shader, pVertexCode, vertexCodeSize, pFragmentCode,
+					fragmentCodeSize, _terrainLayout, _pContext->getRenderPass(), MAIN_PASS,
+					gridInput, true, colorAttachmentCount);
+		} });
 	}
 
-	// tonemapping
+	// lighting
 
-	{
-		TonemapShader shader;
+	if (isDeferredEnabled()) {
+		// camera is read from uniform buffer, lighting pushes nothing
+		std::array<vk::DescriptorSetLayout, 4> layouts = {
+			_uniformLayout,
+			_iblSetLayout,
+			_lightStorage.getLightSetLayout(),
+			_gbufferLayout,
+		};
+
+		vk::PipelineLayoutCreateInfo createInfo = {};
+		createInfo.setSetLayouts(layouts);
 
-		size_t codeSize = sizeof(shader.vertexCode);
-		vk::ShaderModule vertexStage = createShaderModule(device, shader.vertexCode, codeSize);
+		_lightingLayout = device.createPipelineLayout(createInfo);
 
-		codeSize = sizeof(shader.fragmentCode);
-		vk::ShaderModule fragmentStage = createShaderModule(device, shader.fragmentCode, codeSize);
+		addPipeline({ &_lightingPipeline, "lighting", [this, device]() {
+			return _buildPipeline(device, "lighting", LightingShader::vertexCode,
+					sizeof(LightingShader::vertexCode), LightingShader::fragmentCode,
+					sizeof(LightingShader::fragmentCode), _lightingLayout,
+					_pContext->getRenderPass(), LIGHTING_PASS, {});
+		} });
+	}
+
+	// tonemapping
 
+	{
 		vk::PushConstantRange pushConstant;
 		pushConstant.setStageFlags(vk::ShaderStageFlagBits::eFragment);
 		pushConstant.setOffset(0);
 		pushConstant.setSize(sizeof(TonemapParameterConstants));
 
+		std::array<vk::DescriptorSetLayout, 3> setLayouts = { _sceneColorLayout,
+			_autoExposure.getExposureSetLayout(), _tonemapLut.getSampledSetLayout() };
+
 		vk::PipelineLayoutCreateInfo createInfo;
-		createInfo.setSetLayouts(_inputAttachmentLayout);
+		createInfo.setSetLayouts(setLayouts);
 		createInfo.setPushConstantRanges(pushConstant);
 
 		_tonemapLayout = device.createPipelineLayout(createInfo);
-		_tonemapPipeline = createPipeline(device, vertexStage, fragmentStage, _tonemapLayout,
-				_pContext->getRenderPass(), 2, {});
 
-		device.destroyShaderModule(vertexStage);
-		device.destroyShaderModule(fragmentStage);
+		addPipeline({ &_tonemapPipeline, "tonemap", [this, device]() {
+			return _buildPipeline(device, "tonemap", TonemapShader::vertexCode,
+					sizeof(TonemapShader::vertexCode), TonemapShader::fragmentCode,
+					sizeof(TonemapShader::fragmentCode), _tonemapLayout,
+					_pContext->getTonemapRenderPass(), 0, {});
+		} });
 	}
 
+	_startupStats.resourcesMilliseconds = _stepMilliseconds(counter);
+
 	{
-		_environmentEffects.init();
+		_environmentEffects.init(_pContext->getComputeQueue(), _pContext->getComputeQueueFamily(),
+				_pContext->getGraphicsQueueFamily());
 
 		_brdfLut = _environmentEffects.generateBRDF();
 		_brdfView = imageViewCreate(_brdfLut.image, vk::Format::eR16G16Sfloat, 1);
-		_brdfSampler = samplerCreate(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge, 1);
+		_brdfSampler = samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge);
 
 		vk::DescriptorImageInfo imageInfo;
 		imageInfo.setImageView(_brdfView);
 		imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
 		imageInfo.setSampler(_brdfSampler);
 
-		vk::WriteDescriptorSet writeInfo;
-		writeInfo.setDstSet(_iblSet);
-		writeInfo.setDstBinding(2);
-		writeInfo.setDstArrayElement(0);
-		writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-		writeInfo.setDescriptorCount(1);
-		writeInfo.setImageInfo(imageInfo);
-
-		device.updateDescriptorSets(writeInfo, nullptr);
+		// no probes until a scene brings them
+		lightProbesSet({});
+		vk::DescriptorBufferInfo probeBufferInfo = _probeBuffer.getBufferInfo();
+
+		// every slot is allocated up front, probes are copied into their cube once baked
+		vk::Format probeFormat = vk::Format::eR16G16B16A16Sfloat;
+		_reflectionProbeArray = imageCubeCreate(MemoryCategory::Environment,
+				REFLECTION_PROBE_SIZE, probeFormat, SPECULAR_LEVEL_COUNT,
+				vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+				MAX_REFLECTION_PROBE_COUNT);
+		imageLayoutTransition(_reflectionProbeArray.image, probeFormat, SPECULAR_LEVEL_COUNT,
+				6 * MAX_REFLECTION_PROBE_COUNT, vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eShaderReadOnlyOptimal);
+		_reflectionProbeView = imageViewCreate(_reflectionProbeArray.image, probeFormat,
+				SPECULAR_LEVEL_COUNT, 6 * MAX_REFLECTION_PROBE_COUNT, vk::ImageViewType::eCubeArray);
+		_reflectionProbeSampler =
+				samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge);
+
+		_reflectionProbeBufferUpdate();
+
+		vk::DescriptorImageInfo reflectionProbeImageInfo;
+		reflectionProbeImageInfo.setImageView(_reflectionProbeView);
+		reflectionProbeImageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		reflectionProbeImageInfo.setSampler(_reflectionProbeSampler);
+
+		vk::DescriptorBufferInfo reflectionProbeBufferInfo =
+				_reflectionProbeBuffer.getBufferInfo();
+
+		for (uint32_t i = 0; i < _framesInFlight; i++) {
+			std::array<vk::WriteDescriptorSet, 4> writeInfos;
+			writeInfos[0].setDstSet(_iblSets[i]);
+			writeInfos[0].setDstBinding(1);
+			writeInfos[0].setDstArrayElement(0);
+			writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+			writeInfos[0].setDescriptorCount(1);
+			writeInfos[0].setImageInfo(imageInfo);
+
+			writeInfos[1].setDstSet(_iblSets[i]);
+			writeInfos[1].setDstBinding(2);
+			writeInfos[1].setDstArrayElement(0);
+			writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			writeInfos[1].setDescriptorCount(1);
+			writeInfos[1].setBufferInfo(probeBufferInfo);
+
+			writeInfos[2].setDstSet(_iblSets[i]);
+			writeInfos[2].setDstBinding(3);
+			writeInfos[2].setDstArrayElement(0);
+			writeInfos[2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+			writeInfos[2].setDescriptorCount(1);
+			writeInfos[2].setImageInfo(reflectionProbeImageInfo);
+
+			writeInfos[3].setDstSet(_iblSets[i]);
+			writeInfos[3].setDstBinding(4);
+			writeInfos[3].setDstArrayElement(0);
+			writeInfos[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			writeInfos[3].setDescriptorCount(1);
+			writeInfos[3].setBufferInfo(reflectionProbeBufferInfo);
+
+			device.updateDescriptorSets(writeInfos, nullptr);
+		}
 	}
 
 	{
-		float pData[8] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+		// half float zero is all bits clear
+		std::vector<uint8_t> data(Image::getFormatByteSize(Image::Format::RGBA16F) * 2, 0);
 
-		std::vector<uint8_t> data;
-		data.resize(sizeof(float) * 8);
-		memcpy(data.data(), pData, sizeof(float) * 8);
-
-		std::shared_ptr<Image> image(new Image(2, 1, Image::Format::RGBA32F, data));
+		std::shared_ptr<Image> image(new Image(2, 1, Image::Format::RGBA16F, data));
 
 		environmentSkyUpdate(image);
 	}
+
+	_startupStats.environmentMilliseconds = _stepMilliseconds(counter);
+
+	// nothing has recorded with them yet
+	for (std::pair<vk::Pipeline *, std::future<vk::Pipeline>> &build : pipelineBuilds)
+		*build.first = build.second.get();
+
+	_startupStats.pipelineWaitMilliseconds = _stepMilliseconds(counter);
 }
 
 void RD::windowResize(uint32_t width, uint32_t height) {
@@ -1270,6 +3409,275 @@ void RD::windowResize(uint32_t width, uint32_t height) {
 	_resized = true;
 }
 
-void RD::init(bool useValidation) {
-	_pContext = new VulkanContext(useValidation);
+ObjectID RD::windowAdd(
+		vk::SurfaceKHR surface, uint32_t width, uint32_t height, const glm::vec4 &rect) {
+	WindowTarget window;
+
+	bool isAdded = _pContext->getSwapchain() && _pContext->isReadbackSupported() &&
+			_windows.size() < MAX_WINDOW_COUNT &&
+			window.initialize(_pContext, surface, width, height, _framesInFlight);
+
+	if (!isAdded) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Window can not be presented to!");
+		_pContext->getInstance().destroySurfaceKHR(surface);
+		return 0;
+	}
+
+	window.setRect(rect);
+
+	return _windows.insert(window);
+}
+
+void RD::windowRemove(ObjectID window) {
+	if (!_windows.has(window))
+		return;
+
+	WindowTarget target = _windows[window];
+	_windows.free(window);
+
+	// frames in flight may still blit to and present its images
+	destroyDeferred([this, target]() mutable { target.destroy(_pContext); });
+}
+
+void RD::windowSetSize(ObjectID window, uint32_t width, uint32_t height) {
+	if (_windows.has(window))
+		_windows[window].resize(width, height);
+}
+
+void RD::windowSetRect(ObjectID window, const glm::vec4 &rect) {
+	if (_windows.has(window))
+		_windows[window].setRect(rect);
+}
+
+void RD::setPresentMode(vk::PresentModeKHR presentMode) {
+	_pContext->setPresentMode(presentMode);
+
+	// before window init first swapchain is created with it anyway
+	if (_pContext->getSwapchain())
+		_resized = true;
+}
+
+vk::PresentModeKHR RD::getPresentMode() const {
+	return _pContext->getPresentMode();
+}
+
+void RD::setRenderScale(float scale) {
+	_pContext->setRenderScale(scale);
+
+	if (_pContext->getSwapchain())
+		_resized = true;
+}
+
+float RD::getRenderScale() const {
+	return _pContext->getRenderScale();
+}
+
+void RD::setDynamicResolution(float targetMilliseconds, float minScale) {
+	_resolutionController.setBounds(minScale, 1.0f);
+	_resolutionController.setTarget(targetMilliseconds);
+
+	if (_pContext->getSwapchain())
+		_resolutionUpdate();
+}
+
+float RD::getDynamicScale() const {
+	return _resolutionController.getScale();
+}
+
+void RD::setAdaptivePrepass(bool isEnabled) {
+	// pipelines writing depth exist only when enabled before they are built
+	if (isEnabled && _materialLayout)
+		return;
+
+	_prepassController.setEnabled(isEnabled);
+}
+
+bool RD::isAdaptivePrepass() const {
+	return _prepassController.isEnabled();
+}
+
+bool RD::isDepthPrepass() const {
+	return _prepassController.isPrepass();
+}
+
+void RD::setQuality(const QualitySettings &settings) {
+	QualitySettings previous = _quality;
+	_quality = settings;
+
+	_pContext->setAttachmentFormats(settings.colorFormat, settings.depthFormat);
+
+	if (settings.renderScale != previous.renderScale)
+		setRenderScale(settings.renderScale);
+
+	_lightStorage.setPointLightBudget(settings.pointLightBudget);
+
+	_environmentEffects.setMaxCubemapSize(settings.maxCubemapSize);
+	_environmentEffects.setSpecularSize(settings.specularSize);
+
+	// sky is baked again as any other update, current one stays bound until it is done
+	bool isSkyStale = settings.maxCubemapSize != previous.maxCubemapSize ||
+			settings.specularSize != previous.specularSize;
+
+	if (isSkyStale && _sky != nullptr)
+		environmentSkyUpdate(_sky);
+
+	if (settings.shadowAtlasSize != _shadowAtlas.getAtlasSize()) {
+		// atlas is bound in light sets of every frame, resize is rare enough to idle for
+		if (_materialLayout) {
+			std::lock_guard<std::mutex> lock(_queueMutex);
+			_pContext->getDevice().waitIdle();
+		}
+
+		_shadowAtlas.setAtlasSize(settings.shadowAtlasSize, _lightStorage);
+	}
+}
+
+QualitySettings RD::getQuality() const {
+	QualitySettings settings = _quality;
+	settings.renderScale = getRenderScale();
+	settings.colorFormat = _pContext->getColorFormat();
+	settings.depthFormat = _pContext->getDepthFormat();
+	settings.shadowAtlasSize = _shadowAtlas.getAtlasSize();
+
+	return settings;
+}
+
+void RD::setShadingRateMode(ShadingRateMode mode) {
+	// render pass and pipelines are built for mode of device
+	if (_materialLayout)
+		return;
+
+	_shadingRateMode = mode;
+}
+
+void RD::setDeviceSelection(const std::string &selection) {
+	_pContext->setDeviceSelection(selection);
+}
+
+ShadingRateMode RD::getShadingRateMode() const {
+	return _pContext->getShadingRateMode();
+}
+
+vk::Extent2D RD::getShadingRate(uint32_t permutation, bool isFar) const {
+	// smooth lighting of flat surfaces changes little across a few pixels
+	if (isFar || !(permutation & MATERIAL_NORMAL_MAP_BIT))
+		return vk::Extent2D(2, 2);
+
+	return vk::Extent2D(1, 1);
+}
+
+void RD::setShadingRate(vk::CommandBuffer commandBuffer, vk::Extent2D fragmentSize) const {
+	_pContext->setFragmentShadingRate(commandBuffer, fragmentSize);
+}
+
+void RD::frameWait() {
+	PROFILE_ZONE("frame wait");
+
+	vk::Result result = _pContext->getDevice().waitForFences(_fences[_frame], VK_TRUE, UINT64_MAX);
+
+	if (result != vk::Result::eSuccess)
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for fences failed!");
+
+	// hidden or minimized window may never show it, timeout keeps frames coming, present id is
+	// one past frame number
+	if (_presentId != 0 && _pContext->waitForPresent(_presentId, PRESENT_WAIT_TIMEOUT))
+		_framePacer.displayed(_presentId - 1, SDL_GetPerformanceCounter());
+
+	if (_frameLimiter.isEnabled()) {
+		vk::PresentModeKHR presentMode = _pContext->getPresentMode();
+		bool isVsync = presentMode == vk::PresentModeKHR::eFifo ||
+				presentMode == vk::PresentModeKHR::eFifoRelaxed;
+
+		// limited frames leave GPU idle anyway, frames queued ahead would only add latency
+		if (!isVsync && _frameNumber > 0) {
+			uint32_t previous = (_frame + _framesInFlight - 1) % _framesInFlight;
+			result = _pContext->getDevice().waitForFences(
+					_fences[previous], VK_TRUE, UINT64_MAX);
+
+			if (result != vk::Result::eSuccess)
+				SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for fences failed!");
+		}
+
+		// median of frames is from begin to present, input is sampled that long before deadline
+		_frameLimiter.wait(_framePacer.getStats().medianMilliseconds);
+	}
+
+	// input is sampled from now on
+	_framePacer.frameBegin(_frameNumber);
+}
+
+void RD::setFrameRateLimit(float rate) {
+	_frameLimiter.setTargetRate(rate);
+}
+
+float RD::getFrameRateLimit() const {
+	return _frameLimiter.getTargetRate();
+}
+
+void RD::framesInFlightWait() {
+	PROFILE_ZONE("frames in flight wait");
+
+	// fence of frame being recorded is reset, it would never signal
+	for (uint32_t i = 1; i < _framesInFlight; i++) {
+		uint32_t frame = (_frame + i) % _framesInFlight;
+
+		vk::Result result =
+				_pContext->getDevice().waitForFences(_fences[frame], VK_TRUE, UINT64_MAX);
+
+		if (result != vk::Result::eSuccess)
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for fences failed!");
+	}
+}
+
+void RD::readbackRequest(uint64_t id) {
+	if (!_pContext->isReadbackSupported()) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Swapchain images can not be read back!");
+		return;
+	}
+
+	_readbackId = id;
+}
+
+std::vector<Readback> RD::readbackCollect() {
+	std::vector<Readback> readbacks;
+	readbacks.swap(_readbacks);
+
+	return readbacks;
+}
+
+void RD::readbackWait() {
+	// oldest frame first, so readbacks stay in order they were requested
+	for (uint32_t i = 0; i < _framesInFlight; i++) {
+		uint32_t frame = (_frame + i) % _framesInFlight;
+
+		if (!_readbackRing.isPending(frame))
+			continue;
+
+		vk::Result result =
+				_pContext->getDevice().waitForFences(_fences[frame], VK_TRUE, UINT64_MAX);
+
+		if (result != vk::Result::eSuccess)
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for fences failed!");
+
+		_readbackCollect(frame);
+	}
+}
+
+bool RD::isHeadless() const {
+	return _pContext->isHeadless();
+}
+
+bool RD::isReadbackSupported() const {
+	return _pContext->isReadbackSupported();
+}
+
+void RD::init(bool useValidation, bool useBindless, bool useDeferred, uint32_t framesInFlight,
+		bool useHeadless) {
+	_useBindless = useBindless;
+	_useDeferred = useDeferred;
+	_framesInFlight = std::clamp(framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+
+	uint64_t counter = SDL_GetPerformanceCounter();
+	_pContext = new VulkanContext(useValidation, useHeadless);
+	_startupStats.instanceMilliseconds = _stepMilliseconds(counter);
 }
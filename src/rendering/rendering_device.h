@@ -1,41 +1,182 @@
 #ifndef RENDERING_DEVICE_H
 #define RENDERING_DEVICE_H
 
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include <io/light_probes.h>
+#include <io/reflection_probes.h>
+#include <job_system.h>
+
+#include "culling/light_culler.h"
+#include "shadows/shadow_atlas.h"
+#include "storage/bindless_storage.h"
+#include "storage/geometry_arena.h"
 #include "storage/light_storage.h"
+#include "storage/material_storage.h"
+#include "storage/morph_storage.h"
+#include "storage/particle_storage.h"
+#include "storage/skin_storage.h"
+#include "storage/terrain_storage.h"
 #include "types/allocated.h"
+#include "types/frame.h"
+#include "types/quality.h"
 #include "types/resource.h"
 
+#include "effects/auto_exposure.h"
 #include "effects/environment_effects.h"
-
+#include "effects/shading_rate_generator.h"
+#include "effects/sky_atmosphere.h"
+#include "effects/temporal_upscaler.h"
+#include "effects/tonemap_lut.h"
+
+#include "descriptor_allocator.h"
+#include "frame_allocator.h"
+#include "bound_analyzer.h"
+#include "frame_limiter.h"
+#include "frame_pacer.h"
+#include "gpu_profiler.h"
+#include "mip_generator.h"
+#include "pipeline_statistics.h"
+#include "readback_ring.h"
+#include "shader_library.h"
+#include "render_graph.h"
+#include "prepass_controller.h"
+#include "resolution_controller.h"
+#include "upload_manager.h"
 #include "vulkan_context.h"
-
-const int FRAMES_IN_FLIGHT = 2;
+#include "window_target.h"
+
+// per frame, shared by depth and material pass
+const uint32_t MAX_INSTANCE_COUNT = 65536;
+// of instance buffers, particle slots follow those of instances
+const uint32_t INSTANCE_SLOT_COUNT = MAX_INSTANCE_COUNT + MAX_PARTICLE_COUNT;
+
+// lowest fraction of attachments dynamic resolution draws unless asked otherwise
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+
+// threads recording secondary command buffers, any thread of job system may run a recording job
+const uint32_t MAX_RECORD_THREAD_COUNT = MAX_JOB_THREAD_COUNT;
+
+// secondary command buffers per frame in flight which are reused until recorded again
+const uint32_t MAX_CACHED_SECONDARY_COUNT = 2;
+
+// shading writes visualization in place of lit color, values match shaders/debug_incl.glsl
+enum class DebugView : uint32_t {
+	None,
+	// fragments shaded per pixel by forward material pass, needs fragment stores and atomics
+	Overdraw,
+	// lights evaluated per pixel, forward and deferred
+	LightComplexity,
+	// level of detail albedo map is sampled at by forward material pass
+	MipLevel,
+};
 
 struct UniformBufferObject {
 	glm::vec3 viewPosition;
 	uint32_t directionalLightCount;
 	uint32_t pointLightCount;
-};
+	DebugView debugView;
+	uint32_t overdrawStride;
+	// gradients of material maps are scaled by it, exp2 of mip bias
+	float mipScale;
+
+	// see EnvironmentData::irradianceSH
+	glm::vec4 irradianceSH[9];
 
-struct MeshPushConstants {
+	// camera, written per frame so recorded draws do not depend on it
 	glm::mat4 projView;
-	glm::mat4 model;
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 invProj;
+	glm::mat4 invProjView;
+	// see RD::getJitter, already applied to proj
+	glm::vec2 jitter;
+	// into clusters of LightCuller
+	uint32_t viewIndex;
+	uint32_t _padding2;
+	// region of view in pixels, offset and size
+	glm::vec4 viewRect;
+};
+
+// leads light probe buffer, probes of LightProbeGrid follow it
+struct LightProbeHeader {
+	glm::vec4 origin;
+	glm::vec4 spacing;
+	// zero for no grid, shading then sees full sky everywhere
+	glm::uvec4 counts;
+};
+
+// faces of level 0 of every reflection probe, bakes of other sizes are scaled to it
+const uint32_t REFLECTION_PROBE_SIZE = 128;
+
+// entry of reflection probe buffer, after a count in x of a uvec4, smallest boxes come first
+struct ReflectionProbeData {
+	// w is cube of probe array
+	glm::vec4 position;
+	// w is blend distance
+	glm::vec4 boxMin;
+	glm::vec4 boxMax;
+};
+
+// filter tonemap pass upscales scene color with, values match tonemap shader
+enum class UpscaleFilter : uint32_t {
+	Nearest,
+	// nearest within texels, blended across edges over one output pixel
+	SharpBilinear,
+	// jittered frames accumulated at output extent, tonemap pass then reads them one to one
+	Temporal,
 };
 
 struct TonemapParameterConstants {
 	float exposure;
 	float white;
+	float outputSize[2];
+	// drawn part of scene color, at its top left
+	float inputSize[2];
+	UpscaleFilter upscaleFilter;
+	// exposure scales adapted one read from buffer then, as compensation
+	uint32_t isAutoExposure;
+	// baked curve is fetched instead of evaluated
+	uint32_t isTonemapLut;
+	TonemapLook look;
+	// exposure and curve are skipped
+	uint32_t isDebugView;
 };
 
 struct SkyConstants {
 	glm::mat4 invProj;
 	glm::mat4 invView;
+	float lod;
+};
+
+// device local heaps summed, budget is estimated by allocator without VK_EXT_memory_budget
+struct MemoryBudget {
+	uint64_t usage = 0;
+	uint64_t budget = 0;
+};
+
+// milliseconds, steps of windowInit stay zero until it ran
+struct StartupStats {
+	float instanceMilliseconds = 0.0f;
+	float deviceMilliseconds = 0.0f;
+	// attachments, pools, layouts and fallbacks, pipelines build on workers meanwhile
+	float resourcesMilliseconds = 0.0f;
+	float environmentMilliseconds = 0.0f;
+	// left of pipeline builds once everything else is done
+	float pipelineWaitMilliseconds = 0.0f;
 };
 
 class Image;
@@ -51,36 +192,141 @@ private:
 	RenderingDevice() {}
 
 private:
+	struct SamplerKey {
+		vk::Filter filter;
+		vk::SamplerAddressMode addressMode;
+		float mipLodBias;
+		bool anisotropy;
+
+		bool operator<(const SamplerKey &other) const {
+			return std::tie(filter, addressMode, mipLodBias, anisotropy) <
+					std::tie(other.filter, other.addressMode, other.mipLodBias, other.anisotropy);
+		}
+	};
+
 	VulkanContext *_pContext;
 	LightStorage _lightStorage;
+	LightCuller _lightCuller;
+	ShadowAtlas _shadowAtlas;
+	GeometryArena _geometryArena;
+	SkinStorage _skinStorage;
+	MorphStorage _morphStorage;
+	ParticleStorage _particleStorage;
+	TerrainStorage _terrainStorage;
+	BindlessStorage _bindlessStorage;
+	MaterialStorage _materialStorage;
+	UploadManager _uploadManager;
+	FrameAllocator _frameAllocator;
+	MipGenerator _mipGenerator;
+	GpuProfiler _gpuProfiler;
+	PipelineStatistics _pipelineStatistics;
+	// whole command buffer of frame, from drawBegin to drawEnd
+	uint32_t _frameScope = GPU_PROFILER_NO_SCOPE;
+
+	// frame being recorded is read back under id when it has one
+	ReadbackRing _readbackRing;
+	std::optional<uint64_t> _readbackId;
+	std::vector<Readback> _readbacks;
+
+	// requested, context decides if it is supported
+	bool _useBindless = false;
+	bool _useDeferred = false;
+
+	// one has lowest input latency, three keep GPU busiest
+	uint32_t _framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
 
 	uint32_t _frame = 0;
+	// selected by setView, reset to first one every frame
+	uint32_t _view = 0;
+
+	// frames submitted so far
+	uint64_t _frameNumber = 0;
+
+	typedef struct {
+		uint64_t frameNumber;
+		std::function<void()> destroy;
+	} DeferredDestroy;
+
+	std::deque<DeferredDestroy> _deletionQueue;
 
 	uint32_t _width, _height;
-	bool _resized;
+	// swapchain is recreated after next present
+	bool _resized = false;
+
+	// id of last present on current swapchain, 0 when there is none to wait for
+	uint64_t _presentId = 0;
 
 	VmaAllocator _allocator;
-	vk::CommandBuffer _commandBuffers[FRAMES_IN_FLIGHT];
+	// sampled textures only, defragmentation moves everything in it
+	VmaPool _texturePool = VK_NULL_HANDLE;
+	vk::CommandBuffer _commandBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	vk::Semaphore _presentSemaphores[MAX_FRAMES_IN_FLIGHT];
+	vk::Semaphore _renderSemaphores[MAX_FRAMES_IN_FLIGHT];
+	vk::Fence _fences[MAX_FRAMES_IN_FLIGHT];
+
+	// besides the one of window init, shown by the same frames
+	ObjectOwner<WindowTarget> _windows;
+
+	// compute family of its own, raster independent work of frame runs beside depth pass and
+	// shadows, graphics submit of frame waits for it so its fence covers both
+	bool _asyncCompute = false;
+	vk::CommandPool _computeCommandPool;
+	vk::CommandBuffer _computeCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+	vk::Semaphore _computeSemaphores[MAX_FRAMES_IN_FLIGHT];
+	// graphics submit waits at them, none when nothing was recorded for frame
+	vk::PipelineStageFlags _computeWaitStages;
+	// graphics and compute, empty without async compute
+	std::vector<uint32_t> _sharedQueueFamilies;
+
+	// one pool per thread, pools are not thread safe
+	typedef struct {
+		vk::CommandPool pool;
+		std::vector<vk::CommandBuffer> buffers;
+		uint32_t usedCount;
+	} SecondaryCommands;
+
+	SecondaryCommands _secondaryCommands[MAX_FRAMES_IN_FLIGHT][MAX_RECORD_THREAD_COUNT] = {};
 
-	vk::Semaphore _presentSemaphores[FRAMES_IN_FLIGHT];
-	vk::Semaphore _renderSemaphores[FRAMES_IN_FLIGHT];
-	vk::Fence _fences[FRAMES_IN_FLIGHT];
+	// kept across frames and recorded again by their owner, render thread only
+	vk::CommandPool _cachedSecondaryPool;
+	vk::CommandBuffer _cachedSecondaries[MAX_FRAMES_IN_FLIGHT][MAX_CACHED_SECONDARY_COUNT] = {};
 
+	// sets of passes, made once
 	vk::DescriptorPool _descriptorPool;
 
+	// material texture sets, grows with scene and frees with material
+	DescriptorAllocator _textureSetAllocator;
+	vk::DescriptorUpdateTemplate _textureUpdateTemplate;
+
 	vk::DescriptorSetLayout _uniformLayout;
-	vk::DescriptorSetLayout _inputAttachmentLayout;
+	vk::DescriptorSetLayout _sceneColorLayout;
 	vk::DescriptorSetLayout _textureLayout;
 	vk::DescriptorSetLayout _skySetLayout;
 	vk::DescriptorSetLayout _iblSetLayout;
+	vk::DescriptorSetLayout _gbufferLayout;
+
+	// each view has its own camera uniforms
+	vk::DescriptorSet _uniformSets[MAX_FRAMES_IN_FLIGHT][MAX_VIEW_COUNT];
+	// rewritten when attachments are reallocated, once their frame is finished
+	vk::DescriptorSet _sceneColorSets[MAX_FRAMES_IN_FLIGHT];
+	vk::DescriptorSet _gbufferSets[MAX_FRAMES_IN_FLIGHT];
+	uint64_t _attachmentSetVersions[MAX_FRAMES_IN_FLIGHT] = {};
+	// rewritten when environment changes, once their frame is finished
+	vk::DescriptorSet _skySets[MAX_FRAMES_IN_FLIGHT];
+	vk::DescriptorSet _iblSets[MAX_FRAMES_IN_FLIGHT];
+
+	AllocatedBuffer _uniformBuffers[MAX_FRAMES_IN_FLIGHT][MAX_VIEW_COUNT];
+	VmaAllocationInfo _uniformAllocInfos[MAX_FRAMES_IN_FLIGHT][MAX_VIEW_COUNT];
+
+	AllocatedBuffer _instanceBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _instanceAllocInfos[MAX_FRAMES_IN_FLIGHT];
 
-	vk::DescriptorSet _uniformSets[FRAMES_IN_FLIGHT];
-	vk::DescriptorSet _inputAttachmentSet;
-	vk::DescriptorSet _skySet;
-	vk::DescriptorSet _iblSet;
+	AllocatedBuffer _instanceMaterialBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _instanceMaterialAllocInfos[MAX_FRAMES_IN_FLIGHT];
 
-	AllocatedBuffer _uniformBuffers[FRAMES_IN_FLIGHT];
-	VmaAllocationInfo _uniformAllocInfos[FRAMES_IN_FLIGHT];
+	AllocatedBuffer _instanceNormalBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _instanceNormalAllocInfos[MAX_FRAMES_IN_FLIGHT];
 
 	vk::PipelineLayout _depthLayout;
 	vk::Pipeline _depthPipeline;
@@ -88,60 +334,209 @@ private:
 	vk::PipelineLayout _skyLayout;
 	vk::Pipeline _skyPipeline;
 
+	// indexed by permutation, deferred path leaves point light ones null, lighting pass owns them
 	vk::PipelineLayout _materialLayout;
-	vk::Pipeline _materialPipeline;
+	vk::Pipeline _materialPipelines[MATERIAL_PERMUTATION_COUNT];
+	// write depth for frames without prepass, built only with adaptive prepass
+	vk::Pipeline _materialDepthPipelines[MATERIAL_PERMUTATION_COUNT];
 
 	vk::PipelineLayout _tonemapLayout;
 	vk::Pipeline _tonemapPipeline;
 
+	// g-buffer variant on deferred path, material sets and terrain set
+	vk::PipelineLayout _terrainLayout;
+	vk::Pipeline _terrainPipeline;
+
+	// deferred path only
+	vk::PipelineLayout _lightingLayout;
+	vk::Pipeline _lightingPipeline;
+
+	// fragment specialization of material permutations, read by their recipes
+	std::array<vk::SpecializationMapEntry, MATERIAL_PERMUTATION_BIT_COUNT>
+			_materialSpecializationEntries;
+	std::array<std::array<VkBool32, MATERIAL_PERMUTATION_BIT_COUNT>, MATERIAL_PERMUTATION_COUNT>
+			_materialSpecializationData = {};
+	std::array<vk::SpecializationInfo, MATERIAL_PERMUTATION_COUNT> _materialSpecializations;
+
+	// every pipeline above, built again when hot reload recompiles its shader
+	std::vector<PipelineRecipe> _pipelineRecipes;
+	// bumped once pipelines are replaced, secondaries recorded with old ones are invalid
+	uint64_t _pipelineVersion = 0;
+
 	std::optional<uint32_t> _imageIndex;
 
 	EnvironmentEffects _environmentEffects;
 
 	float _exposure = 1.25f;
+	AutoExposure _autoExposure;
+	bool _isAutoExposure = false;
+	// level of environment cubemap sky samples, zero for full detail
+	float _skyLod = 0.0f;
+	QualitySettings _quality = getQualitySettings(QualityPreset::High);
 	float _white = 8.0f;
+	TonemapLook _tonemapLook = TonemapLook::None;
+	TonemapLut _tonemapLut;
+	bool _isTonemapLut = false;
+
+	UpscaleFilter _upscaleFilter = UpscaleFilter::SharpBilinear;
+	vk::Sampler _sceneColorSampler;
+
+	DebugView _debugView = DebugView::None;
+	// shared by frames, grown to attachments once overdraw view is on, sets follow version
+	AllocatedBuffer _overdrawBuffer;
+	uint64_t _overdrawVersion = 0;
+	uint64_t _overdrawSetVersions[MAX_FRAMES_IN_FLIGHT] = {};
+
+	// requested one, context falls back to what device supports
+	ShadingRateMode _shadingRateMode = ShadingRateMode::Off;
+	ShadingRateGenerator _shadingRateGenerator;
+
+	// part of attachments drawn, picked for next frame once one is submitted
+	ResolutionController _resolutionController;
+	uint64_t _resolutionSampleCount = 0;
+
+	// whether frames recorded next draw depth prepass
+	PrepassController _prepassController;
+	uint64_t _prepassSampleCount = 0;
+
+	// CPU timeline of frames, finds hitches
+	FramePacer _framePacer;
+	FrameLimiter _frameLimiter;
+	// fed frames in flight late, with frame scope of GPU, last of it that was fed
+	BoundAnalyzer _boundAnalyzer;
+	uint64_t _boundGpuSampleCount = 0;
+	StartupStats _startupStats;
+	vk::Extent2D _renderExtent;
+
+	TemporalUpscaler _temporalUpscaler;
+	// passes between scene render pass and end of frame, declared again every frame
+	RenderGraph _renderGraph;
+	// of frame recorded next in render texels, zero unless upscaling is temporal
+	glm::vec2 _jitter = glm::vec2(0.0f);
+	glm::mat4 _projView = glm::mat4(1.0f);
+	glm::mat4 _previousProjView = glm::mat4(1.0f);
 
 	AllocatedImage _brdfLut;
 	vk::ImageView _brdfView;
 	vk::Sampler _brdfSampler;
 
-	typedef struct {
-		AllocatedImage cubemap;
-		vk::ImageView cubemapView;
-		vk::Sampler cubemapSampler;
+	// every sampler of device, drivers limit how many can exist
+	std::map<SamplerKey, vk::Sampler> _samplers;
+	std::mutex _samplerMutex;
+
+	// queues may alias each other, every submit, present and idle wait holds it
+	std::mutex _queueMutex;
+	// blocking submits of endSingleTimeCommands since initialization
+	std::atomic<uint64_t> _singleTimeSubmitCount{ 0 };
 
-		AllocatedImage irradiance;
-		vk::ImageView irradianceView;
-		vk::Sampler irradianceSampler;
+	EnvironmentData _environmentData = {};
+	std::shared_ptr<Image> _pendingSky;
+	bool _isPendingSkyProgressive = false;
+	// of latest bake request, baked again once environment shaders or its sizes change
+	std::shared_ptr<Image> _sky;
+	// reloaded environment shaders, pipelines of bake are replaced once no bake runs
+	std::vector<std::string> _pendingShaders;
 
-		AllocatedImage specular;
-		vk::ImageView specularView;
-		vk::Sampler specularSampler;
-	} EnvironmentData;
+	// bumped by every finished bake, sets of each frame follow it
+	uint64_t _environmentVersion = 0;
+	uint64_t _environmentSetVersions[MAX_FRAMES_IN_FLIGHT] = {};
 
-	EnvironmentData _environmentData;
+	// bound in place of baked environment while on, its irradiance arrives frames later
+	SkyAtmosphere _skyAtmosphere;
+	bool _isAtmosphere = false;
+
+	// replaced as a whole, ibl sets follow it along with environment
+	AllocatedBuffer _probeBuffer;
+
+	typedef struct {
+		ReflectionProbe probe;
+		// waits for bake, null once its bake began
+		std::shared_ptr<Image> image;
+		bool isBaked;
+		// bumped by every set, bake of an older one is dropped
+		uint64_t version;
+	} ReflectionProbeSlot;
+
+	// baked one at a time after sky bakes, specular is copied into its cube of probe array
+	std::array<ReflectionProbeSlot, MAX_REFLECTION_PROBE_COUNT> _reflectionProbes = {};
+	int32_t _reflectionProbeBake = -1;
+	uint64_t _reflectionProbeBakeVersion = 0;
+	AllocatedImage _reflectionProbeArray;
+	vk::ImageView _reflectionProbeView;
+	vk::Sampler _reflectionProbeSampler;
+	// of baked probes only, replaced as a whole like probe buffer
+	AllocatedBuffer _reflectionProbeBuffer;
+
+	// picks up finished bake, has to be recorded before anything samples environment
+	void _environmentUpdate(vk::CommandBuffer commandBuffer);
+	// procedural one while atmosphere is on, baked one otherwise
+	const EnvironmentData &_getEnvironment() const;
+	// begins bake of next waiting probe, only once no sky bake runs or waits
+	void _reflectionProbeBakeNext();
+	// scales every level of baked specular into cube of probe
+	void _reflectionProbeCopy(
+			vk::CommandBuffer commandBuffer, const EnvironmentData &data, uint32_t index);
+	void _reflectionProbeBufferUpdate();
+	// points sets of frame at counters and clears them while overdraw view is on
+	void _overdrawUpdate(vk::CommandBuffer commandBuffer);
+	// pipelines of recompiled shaders are replaced, old ones live until frames using them end
+	void _reloadShaders();
+
+	// swapchain is recreated when it went out of date or window was resized
+	void _present();
+	// pass of render graph, final image is written by tonemap render pass
+	void _recordTonemap(vk::CommandBuffer commandBuffer);
+	// has to follow wait for fence of frame
+	void _readbackCollect(uint32_t frame);
+	// old swapchain is destroyed once frames in flight are done with it
+	void _swapchainRecreate();
+	// acquires images of other windows and blits final image into those that have one
+	void _recordWindows(vk::CommandBuffer commandBuffer);
+	// sets of frame about to be recorded follow attachments reallocated since it last was
+	void _attachmentSetsUpdate();
+	// feeds GPU time of newest finished frame to controller, clamps extent to attachments
+	void _resolutionUpdate();
+	// GPU time of depth and material passes of newest finished frame to controller
+	void _prepassUpdate();
 
 public:
 	RenderingDevice(RenderingDevice const &) = delete;
 	void operator=(RenderingDevice const &) = delete;
 
 	vk::CommandBuffer beginSingleTimeCommands();
+	// submits and waits for graphics queue to idle
 	void endSingleTimeCommands(vk::CommandBuffer commandBuffer);
+	// monotonic, see UploadManager::getSubmittedBatchCount for asynchronous ones
+	uint64_t getSingleTimeSubmitCount() const;
 
-	AllocatedBuffer bufferCreate(
+	// allocations are tracked under category until destroyed
+	AllocatedBuffer bufferCreate(MemoryCategory category, BufferClass bufferClass,
 			vk::BufferUsageFlags usage, vk::DeviceSize size, VmaAllocationInfo *pAllocInfo = NULL);
-	void bufferCopy(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
+	void bufferCopy(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size,
+			vk::DeviceSize srcOffset = 0, vk::DeviceSize dstOffset = 0);
 	void bufferCopyToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height,
 			vk::ImageLayout layout = vk::ImageLayout::eTransferDstOptimal);
-	void bufferSend(vk::Buffer dstBuffer, uint8_t *pData, size_t size);
+	// asynchronous, ordered before next submitted frame
+	void bufferSend(vk::Buffer dstBuffer, uint8_t *pData, size_t size,
+			vk::DeviceSize dstOffset = 0);
+	// makes host writes visible to device, safe to call from any thread
+	void bufferFlush(AllocatedBuffer buffer);
+	// makes device writes to host visible memory readable
+	void bufferInvalidate(AllocatedBuffer buffer);
 	void bufferDestroy(AllocatedBuffer buffer);
 
-	AllocatedImage imageCreate(uint32_t width, uint32_t height, vk::Format format,
-			uint32_t mipLevels, vk::ImageUsageFlags usage);
-	AllocatedImage imageCubeCreate(
-			uint32_t size, vk::Format format, uint32_t mipLevels, vk::ImageUsageFlags usage);
+	AllocatedImage imageCreate(MemoryCategory category, uint32_t width, uint32_t height,
+			vk::Format format, uint32_t mipLevels, vk::ImageUsageFlags usage);
+	// cube count above one is viewed as cube array
+	AllocatedImage imageCubeCreate(MemoryCategory category, uint32_t size, vk::Format format,
+			uint32_t mipLevels, vk::ImageUsageFlags usage, uint32_t cubeCount = 1);
+	// single level, viewed with 3D view type
+	AllocatedImage imageVolumeCreate(MemoryCategory category, uint32_t width, uint32_t height,
+			uint32_t depth, vk::Format format, vk::ImageUsageFlags usage);
 	void imageGenerateMipmaps(vk::Image image, int32_t width, int32_t height, vk::Format format,
 			uint32_t mipLevels, uint32_t arrayLayers = 1);
+	void imageGenerateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, int32_t width,
+			int32_t height, vk::Format format, uint32_t mipLevels, uint32_t arrayLayers = 1);
 	void imageLayoutTransition(vk::Image image, vk::Format format, uint32_t mipLevels,
 			uint32_t arrayLayers, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
 	void imageSend(vk::Image image, uint32_t width, uint32_t height, uint8_t *pData, size_t size,
@@ -152,51 +547,294 @@ public:
 			uint32_t arrayLayers = 1, vk::ImageViewType viewType = vk::ImageViewType::e2D);
 	void imageViewDestroy(vk::ImageView imageView);
 
-	vk::Sampler samplerCreate(vk::Filter filter, vk::SamplerAddressMode repeatMode,
-			uint32_t mipLevels, float mipLodBias = 0.0f);
-	void samplerDestroy(vk::Sampler sampler);
+	// shared by every caller asking for same state and kept while device lives, level count is
+	// not clamped so one sampler serves images with any number of levels
+	vk::Sampler samplerGet(vk::Filter filter, vk::SamplerAddressMode addressMode,
+			float mipLodBias = 0.0f, bool anisotropy = true);
 
-	TextureRD textureCreate(const std::shared_ptr<Image> image);
+	// compressed formats need textureCompressionBC
+	bool isTextureFormatSupported(Image::Format format) const;
+	// levels before baseLevel are left out, image has to have pre-built levels for them
+	TextureRD textureCreate(const std::shared_ptr<Image> image, uint32_t baseLevel = 0);
 	void textureDestroy(TextureRD texture);
 
-	void environmentSkyUpdate(const std::shared_ptr<Image> image);
-
-	void updateUniformBuffer(const glm::vec3 &viewPosition);
+	// defragmentation, texture with same image is bound to memory move allocated for it and
+	// keeps allocation and sampler of source
+	TextureRD textureCreateMoved(const TextureRD &texture, VmaAllocation allocation);
+	// has to be recorded before texture is sampled by frame
+	void textureRecordMove(
+			vk::CommandBuffer commandBuffer, const TextureRD &src, const TextureRD &dst);
+	// memory and sampler went over to moved texture
+	void textureDestroyMoved(TextureRD texture);
+
+	// runs once every frame which could use the resource is finished
+	void destroyDeferred(const std::function<void()> &destroy);
+
+	// bakes in background, current environment stays bound until the new one is ready, progressive
+	// bake is spread over frames at a small fixed cost each
+	void environmentSkyUpdate(const std::shared_ptr<Image> image, bool isProgressive = false);
+	// procedural sky replaces baked one until next sky update, changes are filtered in the frame
+	// they are made in without a bake
+	void environmentAtmosphereSet(const Atmosphere &atmosphere);
+	// bake is running or waits for one, or irradiance of procedural sky is not read back yet
+	bool isEnvironmentBaking() const;
+	// used by bakes begun afterwards, bake again to replace preview with full quality
+	void environmentSetSpecularSampleCount(uint32_t level, uint32_t sampleCount);
+	void environmentSetMaxCubemapSize(uint32_t size);
+	// empty grid turns probes off
+	void lightProbesSet(const LightProbeGrid &grid);
+	// image is baked like a sky and kept on disk by environment cache, probe is left out of
+	// shading until its bake finishes, null image frees slot
+	void reflectionProbeSet(
+			uint32_t index, const ReflectionProbe &probe, const std::shared_ptr<Image> image);
+	// see TerrainStorage::set and TerrainStorage::layerSet
+	void terrainSet(const Terrain &terrain, const std::shared_ptr<Image> heightmap,
+			const std::shared_ptr<Image> splatmap);
+	void terrainLayerSet(uint32_t index, const std::shared_ptr<Image> image);
+
+	// proj is jittered already, by jitter of frame, rect of zero size covers whole render extent
+	void updateUniformBuffer(const glm::vec3 &viewPosition, const glm::mat4 &view,
+			const glm::mat4 &proj, uint32_t viewIndex = 0, vk::Rect2D rect = {});
+	// uniform and material sets of view are returned from then on, viewport and scissor of
+	// command buffer are set to rect of view
+	void setView(vk::CommandBuffer commandBuffer, uint32_t viewIndex, const vk::Rect2D &rect);
+
+	// has to be called after drawBegin, previous use of the buffer is then finished
+	void updateInstanceBuffer(const InstanceTransform *pTransforms, uint32_t count);
+	void updateInstanceMaterialBuffer(const uint32_t *pMaterials, uint32_t count);
+	void updateInstanceNormalBuffer(const InstanceTransform *pNormals, uint32_t count);
 
 	LightStorage &getLightStorage();
+	LightCuller &getLightCuller();
+	ShadowAtlas &getShadowAtlas();
+	GeometryArena &getGeometryArena();
+	SkinStorage &getSkinStorage();
+	MorphStorage &getMorphStorage();
+	ParticleStorage &getParticleStorage();
+	TerrainStorage &getTerrainStorage();
+	BindlessStorage &getBindlessStorage();
+	MaterialStorage &getMaterialStorage();
+	UploadManager &getUploadManager();
+	// ranges of frame being recorded, after drawBegin only
+	FrameAllocator &getFrameAllocator();
+	MipGenerator &getMipGenerator();
+	std::mutex &getQueueMutex();
+	GpuProfiler &getGpuProfiler();
+	// depth, sky or lighting, material and tonemap passes, while enabled and supported
+	PipelineStatistics &getPipelineStatistics();
+
+	// frame scopes followed by environment bake steps
+	std::vector<GpuTiming> getGpuTimings() const;
+	// timeline of last presented frame and rolling median
+	FramePacingStats getFramePacingStats() const;
+	// frames classified CPU, GPU or present bound, frames in flight behind
+	FrameBoundStats getFrameBoundStats() const;
+	// init and windowInit, headless init takes steps of windowInit too
+	StartupStats getStartupStats() const;
+	// hitches are logged with zones of their frames
+	void setHitchReporting(bool isEnabled);
+	// timestamp queries would write now and performance counter of same moment
+	bool getCalibratedTimestamp(uint64_t &timestamp, uint64_t &counter) const;
+
+	bool isBindlessEnabled() const;
+	// material textures go straight into command buffer, never with bindless
+	bool isPushDescriptorEnabled() const;
+	bool isDeferredEnabled() const;
+	bool isAsyncComputeEnabled() const;
+	// of concurrently shared buffers, which both graphics and async compute read
+	const std::vector<uint32_t> &getSharedQueueFamilies() const;
+
+	// refreshed once per frame by drawBegin
+	MemoryBudget getMemoryBudget() const;
+	// unused part of allocated memory blocks, 0 when they are full
+	float getFragmentation() const;
+	// of every heap, walks every allocation so it is too slow for every frame
+	VmaStatistics getAllocatorStatistics() const;
+
+	VmaAllocator getAllocator() const;
+	VmaPool getTexturePool() const;
 
 	vk::Instance getInstance() const;
 	vk::PhysicalDevice getPhysicalDevice() const;
 	vk::Device getDevice() const;
+	vk::PipelineCache getPipelineCache() const;
+	// only when pipelines were added since it was loaded or last saved
+	void pipelineCacheSave();
 
 	vk::Extent2D getSwapchainExtent() const;
+	// drawn by frame recorded next, at top left of attachments
+	vk::Extent2D getRenderExtent() const;
+	// depth and color attachments are allocated with it
+	vk::Extent2D getAttachmentExtent() const;
+	Attachment getDepthAttachment() const;
 
 	vk::PipelineLayout getDepthPipelineLayout() const;
 	vk::Pipeline getDepthPipeline() const;
 
+	vk::DescriptorSet getUniformSet() const;
+	AllocatedBuffer getInstanceBuffer(uint32_t frame) const;
+	AllocatedBuffer getInstanceMaterialBuffer(uint32_t frame) const;
+	AllocatedBuffer getInstanceNormalBuffer(uint32_t frame) const;
+
+	uint32_t getFrame() const;
+	// selected by setView
+	uint32_t getView() const;
+	uint32_t getFramesInFlight() const;
+	// frames drawn after a change until output stops changing, every frame in flight is
+	// presented and temporal history has seen every jitter phase
+	uint32_t getSettleFrameCount() const;
+
 	vk::PipelineLayout getSkyPipelineLayout() const;
 	vk::Pipeline getSkyPipeline() const;
 
 	vk::DescriptorSet getSkySet() const;
 
 	vk::PipelineLayout getMaterialPipelineLayout() const;
-	vk::Pipeline getMaterialPipeline() const;
+	// writes depth while frames are drawn without prepass
+	vk::Pipeline getMaterialPipeline(uint32_t permutation) const;
+
+	// permutation bits of scene, combined with those of material
+	uint32_t getScenePermutation() const;
 
 	std::array<vk::DescriptorSet, 3> getMaterialSets() const;
+	// changes once sets of this frame are written or pipelines are replaced, buffers recorded
+	// before are then invalid
+	uint64_t getSetVersion() const;
+
+	// material sets are bound by terrain as well, its own one at index 3
+	vk::PipelineLayout getTerrainPipelineLayout() const;
+	vk::Pipeline getTerrainPipeline() const;
+
+	// lighting pass uses material sets, g-buffer set is bound at index 3
+	vk::PipelineLayout getLightingPipelineLayout() const;
+	vk::Pipeline getLightingPipeline() const;
+
+	vk::DescriptorSet getGBufferSet() const;
 
 	vk::DescriptorPool getDescriptorPool() const;
 	vk::DescriptorSetLayout getTextureLayout() const;
 
+	// unused with push descriptors, texture sets have no sets then
+	DescriptorAllocator &getTextureSetAllocator();
+	// writes material textures from consecutive image infos, pushes them with push descriptors
+	vk::DescriptorUpdateTemplate getTextureUpdateTemplate() const;
+	// pushes image infos of set or binds it, layout has to be compatible with material one
+	void textureSetBind(vk::CommandBuffer commandBuffer, vk::PipelineLayout layout,
+			const TextureSetRD &textureSet) const;
+
 	void setExposure(float exposure);
+	// adapts exposure to scene color on device, set one stays applied on top of it
+	void setAutoExposure(bool isEnabled);
+	void setSkyLod(float lod);
+	float getSkyLod() const;
 	void setWhite(float white);
-
+	void setTonemapLook(TonemapLook look);
+	// tonemap pass fetches curve baked with white and look, baked again when either changes
+	void setTonemapLut(bool isEnabled);
+	void setUpscaleFilter(UpscaleFilter filter);
+	// taken by frames recorded after it, overdraw falls back to none without fragment atomics
+	void setDebugView(DebugView view);
+	DebugView getDebugView() const;
+	// offset projection of frame recorded next is translated by, in normalized device coordinates
+	glm::vec2 getJitter() const;
+	// unjittered, once per frame before it is recorded, history is reprojected with previous one
+	void setTemporalProjView(const glm::mat4 &projView);
+
+	// waits for frame and begins command buffer, compute work can be recorded before render pass
 	vk::CommandBuffer drawBegin();
+	// after drawBegin with async compute only, for work not reading anything raster work of
+	// frame writes, submitted with frame and its graphics commands wait for it at waitStage
+	vk::CommandBuffer asyncComputeBegin(vk::PipelineStageFlags waitStage);
+	void renderPassBegin(vk::CommandBuffer commandBuffer,
+			vk::SubpassContents contents = vk::SubpassContents::eInline);
+
+	// thread has to be unique per recording thread, buffer continues given subpass
+	vk::CommandBuffer secondaryBegin(uint32_t thread, uint32_t subpass);
+	// buffer of slot for this frame, previous recording is replaced, it may be executed by any
+	// later frame using same slot, framebuffer and render extent
+	vk::CommandBuffer secondaryBeginCached(uint32_t slot, uint32_t subpass);
+	vk::Framebuffer getFramebuffer() const;
+	void renderPassEnd(vk::CommandBuffer commandBuffer);
 	void drawEnd(vk::CommandBuffer commandBuffer);
 
+	// surface is null when headless, frames are then rendered to offscreen images
 	void windowInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height);
 	void windowResize(uint32_t width, uint32_t height);
 
-	void init(bool useValidation);
+	// another window sharing device and everything on it, rect of final image, normalized, is
+	// blitted to it after tonemap pass and presented with frame, needs window init and final
+	// images that can be read back, 0 otherwise and surface is destroyed
+	ObjectID windowAdd(vk::SurfaceKHR surface, uint32_t width, uint32_t height,
+			const glm::vec4 &rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	// surface of window goes too once frames in flight are done with it
+	void windowRemove(ObjectID window);
+	void windowSetSize(ObjectID window, uint32_t width, uint32_t height);
+	void windowSetRect(ObjectID window, const glm::vec4 &rect);
+
+	// takes effect once swapchain is recreated after next present
+	void setPresentMode(vk::PresentModeKHR presentMode);
+	vk::PresentModeKHR getPresentMode() const;
+	// fraction of swapchain extent scene is rendered at, same as present mode takes effect
+	void setRenderScale(float scale);
+	float getRenderScale() const;
+
+	// draws part of attachments so GPU frame time holds target, no target turns it off,
+	// needs timestamp queries
+	void setDynamicResolution(
+			float targetMilliseconds, float minScale = DYNAMIC_RESOLUTION_MIN_SCALE);
+	// fraction of attachments drawn, 1 without dynamic resolution
+	float getDynamicScale() const;
+
+	// depth prepass is skipped while frames are faster without it, material pipelines writing
+	// depth are built for that, before window init, needs timestamp queries
+	void setAdaptivePrepass(bool isEnabled);
+	bool isAdaptivePrepass() const;
+	// for frame recorded next, depth pass draws nothing otherwise
+	bool isDepthPrepass() const;
+
+	// every setting at once, only those which changed are applied, see QualitySettings,
+	// attachment formats only before window init
+	void setQuality(const QualitySettings &settings);
+	// formats are those of device once window is initialized
+	QualitySettings getQuality() const;
+
+	// material pass shades coarser where it shows little, before window init
+	void setShadingRateMode(ShadingRateMode mode);
+	// before window init, index among devices or part of their name, best scored otherwise
+	void setDeviceSelection(const std::string &selection);
+	// of device once window is initialized
+	ShadingRateMode getShadingRateMode() const;
+	// fragment size of material batch, coarse for far ones and those without normal map
+	vk::Extent2D getShadingRate(uint32_t permutation, bool isFar) const;
+	// with shading rate mode other than off, once material pipeline is bound
+	void setShadingRate(vk::CommandBuffer commandBuffer, vk::Extent2D fragmentSize) const;
+
+	// waits until frame to be recorded next is free and with present wait until previous frame
+	// is on screen, then with frame rate limit until input of it is due, input sampled after it
+	// is as fresh as possible
+	void frameWait();
+	// frames per second frameWait holds frames to, 0 for none, without vsync frames are then
+	// waited for until GPU has one queued at most
+	void setFrameRateLimit(float rate);
+	float getFrameRateLimit() const;
+	// waits for every frame in flight other than one being recorded, resources they read can
+	// then be replaced without idling device
+	void framesInFlightWait();
+
+	// final color of frame recorded next is read back under id, ignored when surface does not
+	// support it
+	void readbackRequest(uint64_t id);
+	// finished since last call, in order they were requested
+	std::vector<Readback> readbackCollect();
+	// waits for every frame in flight, their readbacks are then collected
+	void readbackWait();
+
+	bool isHeadless() const;
+	bool isReadbackSupported() const;
+
+	// framesInFlight is clamped to [1, MAX_FRAMES_IN_FLIGHT]
+	void init(bool useValidation, bool useBindless = false, bool useDeferred = false,
+			uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT, bool useHeadless = false);
 };
 
 typedef RenderingDevice RD;
@@ -1,16 +1,194 @@
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <utility>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
 
+#include <SDL3/SDL_timer.h>
 #include <SDL3/SDL_vulkan.h>
 
 #include <io/image.h>
+#include <job_system.h>
+#include <profiler.h>
 
 #include "rendering_device.h"
 #include "rendering_server.h"
 
+// pixels per mesh space unit at point of instance nearest to camera
+static float _getPixelScale(
+		const MeshInstanceRD &meshInstance, const glm::vec3 &cameraPosition, float lodScale) {
+	glm::mat3 basis = glm::mat3(meshInstance.transform);
+	float scale = glm::max(glm::max(glm::length(basis[0]), glm::length(basis[1])),
+			glm::length(basis[2]));
+
+	float distance = glm::max(meshInstance.aabb.distance(cameraPosition), 1e-6f);
+	return lodScale * scale / distance;
+}
+
+// coarsest level still larger than tail size, last level when image is small
+// posed and morphed instances draw their own vertices with indices of mesh, pose of morphed one
+// is skinned from its morph
+static int32_t _getVertexOffset(const MeshInstanceRD &meshInstance, const MeshRD &mesh) {
+	uint32_t offset = mesh.geometry.vertexOffset;
+
+	if (meshInstance.isPosed)
+		offset = meshInstance.pose.vertexOffset;
+	else if (meshInstance.isMorphed)
+		offset = meshInstance.morph.vertexOffset;
+
+	return static_cast<int32_t>(offset);
+}
+
+// headers of moved vertices of whole mesh followed by their deltas, grouped by vertex and
+// ordered by target, returns count of moved vertices
+static uint32_t _packMorphTargets(
+		const Mesh &mesh, float scale, std::vector<PackedMorph> &morphs) {
+	typedef struct {
+		uint32_t vertex;
+		uint32_t target;
+		const MorphDelta *pDelta;
+	} Entry;
+
+	std::vector<Entry> entries;
+	uint32_t vertexOffset = 0;
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const MorphTargetArray &targets = mesh.pPrimitives[i].morphTargets;
+
+		// target index has 16 bits
+		for (uint32_t j = 0; j < std::min(targets.count, static_cast<uint32_t>(UINT16_MAX)); j++) {
+			const MorphTarget &target = targets.pData[j];
+
+			for (uint32_t k = 0; k < target.deltaCount; k++) {
+				const MorphDelta &delta = target.pDeltas[k];
+				entries.push_back({ vertexOffset + delta.vertex, j, &delta });
+			}
+		}
+
+		vertexOffset += static_cast<uint32_t>(mesh.pPrimitives[i].vertices.count);
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+		return a.vertex != b.vertex ? a.vertex < b.vertex : a.target < b.target;
+	});
+
+	uint32_t movedCount = 0;
+
+	for (size_t i = 0; i < entries.size(); i++)
+		movedCount += i == 0 || entries[i].vertex != entries[i - 1].vertex ? 1 : 0;
+
+	morphs.resize(movedCount + entries.size());
+	uint32_t header = 0;
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		uint32_t delta = movedCount + static_cast<uint32_t>(i);
+
+		if (i == 0 || entries[i].vertex != entries[i - 1].vertex) {
+			morphs[header].vertex = { entries[i].vertex, delta, 0, 0 };
+			header++;
+		}
+
+		morphs[header - 1].vertex.deltaCount++;
+		morphs[delta].delta = PackedMorphDelta::pack(
+				entries[i].pDelta->position, entries[i].pDelta->normal, entries[i].target, scale);
+	}
+
+	return movedCount;
+}
+
+// impostors are a level of their own past every other one
+static uint32_t _getQueuedLod(const MeshInstanceRD &meshInstance) {
+	return meshInstance.isImpostor ? UINT32_MAX : meshInstance.lod;
+}
+
+static uint32_t _getTailLevel(const Image &image) {
+	uint32_t size = std::max(image.getWidth(), image.getHeight());
+	uint32_t level = 0;
+
+	while (level + 1 < image.getMipLevels() && (size >> level) > TEXTURE_TAIL_SIZE)
+		level++;
+
+	return level;
+}
+
+// bytes of levels from level to last
+static uint64_t _getResidentSize(const Image &image, uint32_t level) {
+	uint32_t width = std::max(image.getWidth() >> level, 1u);
+	uint32_t height = std::max(image.getHeight() >> level, 1u);
+
+	return Image::getDataSize(image.getFormat(), width, height, image.getMipLevels() - level);
+}
+
+// name as in VkPresentModeKHR without prefix, none when unknown
+static std::optional<vk::PresentModeKHR> _parsePresentMode(const char *name) {
+	if (strcmp("fifo", name) == 0)
+		return vk::PresentModeKHR::eFifo;
+	if (strcmp("fifo-relaxed", name) == 0)
+		return vk::PresentModeKHR::eFifoRelaxed;
+	if (strcmp("mailbox", name) == 0)
+		return vk::PresentModeKHR::eMailbox;
+	if (strcmp("immediate", name) == 0)
+		return vk::PresentModeKHR::eImmediate;
+
+	std::cout << "ERROR: " << name << " is not valid present mode!" << std::endl;
+
+	return std::nullopt;
+}
+
+static std::optional<UpscaleFilter> _parseUpscaleFilter(const char *name) {
+	if (strcmp("nearest", name) == 0)
+		return UpscaleFilter::Nearest;
+	if (strcmp("sharp", name) == 0)
+		return UpscaleFilter::SharpBilinear;
+	if (strcmp("temporal", name) == 0)
+		return UpscaleFilter::Temporal;
+
+	std::cout << "ERROR: " << name << " is not valid upscale filter!" << std::endl;
+
+	return std::nullopt;
+}
+
+static std::optional<QualityPreset> _parseQualityPreset(const char *name) {
+	if (strcmp("low", name) == 0)
+		return QualityPreset::Low;
+	if (strcmp("medium", name) == 0)
+		return QualityPreset::Medium;
+	if (strcmp("high", name) == 0)
+		return QualityPreset::High;
+	if (strcmp("ultra", name) == 0)
+		return QualityPreset::Ultra;
+
+	std::cout << "ERROR: " << name << " is not valid quality preset!" << std::endl;
+
+	return std::nullopt;
+}
+
+static std::optional<ShadingRateMode> _parseShadingRateMode(const char *name) {
+	if (strcmp("off", name) == 0)
+		return ShadingRateMode::Off;
+	if (strcmp("draw", name) == 0)
+		return ShadingRateMode::Draw;
+	if (strcmp("image", name) == 0)
+		return ShadingRateMode::Image;
+
+	std::cout << "ERROR: " << name << " is not valid shading rate mode!" << std::endl;
+
+	return std::nullopt;
+}
+
+// defragmentation finds texture of moved allocation through its user data
+static void _setTextureUserData(const TextureRD &texture, ObjectID id) {
+	vmaSetAllocationUserData(RD::getSingleton().getAllocator(), texture.image.allocation,
+			reinterpret_cast<void *>(static_cast<uintptr_t>(id)));
+}
+
 #define CHECK_IF_VALID(owner, id, what)                                                            \
 	if (!owner.has(id)) {                                                                          \
 		std::cout << "ERROR: " << what << ": " << id << " is not valid resource!" << std::endl;    \
@@ -18,24 +196,229 @@
 	}
 
 void RS::cameraSetTransform(const glm::mat4 &transform) {
-	_camera.transform = transform;
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::CameraSetTransform, transform);
+
+	if (_isClientCall()) {
+		_push([this, transform]() { cameraSetTransform(transform); });
+		return;
+	}
+
+	_views[0].camera.transform = transform;
 }
 
 void RS::cameraSetFovY(float fovY) {
-	_camera.fovY = fovY;
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::CameraSetFovY, fovY);
+
+	if (_isClientCall()) {
+		_push([this, fovY]() { cameraSetFovY(fovY); });
+		return;
+	}
+
+	_views[0].camera.fovY = fovY;
 }
 
 void RS::cameraSetZNear(float zNear) {
-	_camera.zNear = zNear;
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::CameraSetZNear, zNear);
+
+	if (_isClientCall()) {
+		_push([this, zNear]() { cameraSetZNear(zNear); });
+		return;
+	}
+
+	for (View &view : _views)
+		view.camera.zNear = zNear;
 }
 
 void RS::cameraSetZFar(float zFar) {
-	_camera.zFar = zFar;
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::CameraSetZFar, zFar);
+
+	if (_isClientCall()) {
+		_push([this, zFar]() { cameraSetZFar(zFar); });
+		return;
+	}
+
+	for (View &view : _views)
+		view.camera.zFar = zFar;
 }
 
-ObjectID RS::meshCreate(const Mesh &mesh) {
-	std::vector<Vertex> vertices;
+void RS::viewSetCount(uint32_t count) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ViewSetCount, count);
+
+	if (_isClientCall()) {
+		_push([this, count]() { viewSetCount(count); });
+		return;
+	}
+
+	count = std::clamp(count, 1u, MAX_VIEW_COUNT);
+
+	// culling pass and depth pyramid of gpu culling follow one camera
+	if (_useGpuCulling && count > 1) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "GPU culling draws one view only!");
+		count = 1;
+	}
+
+	if (count == _viewCount)
+		return;
+
+	_viewCount = count;
+	_isQueueDirty = true;
+}
+
+void RS::viewSetRect(uint32_t view, const glm::vec4 &rect) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ViewSetRect, view, rect);
+
+	if (_isClientCall()) {
+		_push([this, view, rect]() { viewSetRect(view, rect); });
+		return;
+	}
+
+	if (view >= MAX_VIEW_COUNT)
+		return;
+
+	_views[view].rect = glm::clamp(rect, glm::vec4(0.0f), glm::vec4(1.0f));
+}
+
+void RS::viewSetTransform(uint32_t view, const glm::mat4 &transform) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ViewSetTransform, view, transform);
+
+	if (_isClientCall()) {
+		_push([this, view, transform]() { viewSetTransform(view, transform); });
+		return;
+	}
+
+	if (view >= MAX_VIEW_COUNT)
+		return;
+
+	_views[view].camera.transform = transform;
+}
+
+void RS::viewSetFovY(uint32_t view, float fovY) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ViewSetFovY, view, fovY);
+
+	if (_isClientCall()) {
+		_push([this, view, fovY]() { viewSetFovY(view, fovY); });
+		return;
+	}
+
+	if (view >= MAX_VIEW_COUNT)
+		return;
+
+	_views[view].camera.fovY = fovY;
+}
+
+void RS::_mergePrimitives(PackedMesh &packed) {
+	const std::vector<PrimitiveRD> &primitives = packed.primitives;
+
+	// in order of their first primitive
+	std::vector<std::vector<uint32_t>> groups;
+	std::unordered_map<ObjectID, uint32_t> materialGroups;
+	std::vector<uint32_t> remap(primitives.size());
+
+	for (uint32_t i = 0; i < primitives.size(); i++) {
+		auto it = materialGroups.try_emplace(
+				primitives[i].material, static_cast<uint32_t>(groups.size())).first;
+
+		if (it->second == groups.size())
+			groups.emplace_back();
+
+		groups[it->second].push_back(i);
+		remap[i] = it->second;
+	}
+
+	if (groups.size() == primitives.size())
+		return;
+
 	std::vector<uint32_t> indices;
+	indices.reserve(packed.indices.size());
+
+	auto append = [&](uint32_t firstIndex, uint32_t indexCount) {
+		indices.insert(indices.end(), packed.indices.begin() + firstIndex,
+				packed.indices.begin() + firstIndex + indexCount);
+	};
+
+	std::vector<PrimitiveRD> merged;
+
+	for (const std::vector<uint32_t> &group : groups) {
+		PrimitiveRD primitive = {};
+		primitive.material = primitives[group[0]].material;
+		primitive.firstIndex = static_cast<uint32_t>(indices.size());
+
+		size_t levelCount = 0;
+
+		for (uint32_t i : group) {
+			const PrimitiveRD &source = primitives[i];
+			uint32_t offset = static_cast<uint32_t>(indices.size()) - primitive.firstIndex;
+
+			// relative to first index of primitive
+			for (Meshlet meshlet : source.meshlets) {
+				meshlet.firstIndex += offset;
+				primitive.meshlets.push_back(meshlet);
+			}
+
+			append(source.firstIndex, source.indexCount);
+			levelCount = std::max(levelCount, source.lods.size());
+		}
+
+		primitive.indexCount = static_cast<uint32_t>(indices.size()) - primitive.firstIndex;
+
+		for (size_t level = 0; level < levelCount; level++) {
+			LodRD lod = { 0, static_cast<uint32_t>(indices.size()) };
+
+			// like when drawing primitive alone, one without levels keeps full detail
+			for (uint32_t i : group) {
+				const PrimitiveRD &source = primitives[i];
+
+				if (source.lods.empty()) {
+					append(source.firstIndex, source.indexCount);
+					continue;
+				}
+
+				const LodRD &sourceLod = source.lods[std::min(level, source.lods.size() - 1)];
+				append(sourceLod.firstIndex, sourceLod.indexCount);
+			}
+
+			lod.indexCount = static_cast<uint32_t>(indices.size()) - lod.firstIndex;
+			primitive.lods.push_back(lod);
+		}
+
+		merged.push_back(std::move(primitive));
+	}
+
+	packed.indices = std::move(indices);
+	packed.primitives = std::move(merged);
+	packed.primitiveRemap = std::move(remap);
+}
+
+RS::PackedMesh RS::_packMesh(const Mesh &mesh, bool mergePrimitives, bool buildOccluder) {
+	PackedMesh packed;
+
+	std::vector<PackedPosition> &positions = packed.positions;
+	std::vector<PackedAttributes> &attributes = packed.attributes;
+	std::vector<uint32_t> &indices = packed.indices;
 
 	{
 		size_t totalVertexCount = 0;
@@ -44,9 +427,13 @@ ObjectID RS::meshCreate(const Mesh &mesh) {
 		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
 			totalVertexCount += mesh.pPrimitives[i].vertices.count;
 			totalIndexCount += mesh.pPrimitives[i].indices.count;
+
+			for (uint32_t j = 0; j < mesh.pPrimitives[i].lods.count; j++)
+				totalIndexCount += mesh.pPrimitives[i].lods.pData[j].indices.count;
 		}
 
-		vertices.resize(totalVertexCount);
+		positions.resize(totalVertexCount);
+		attributes.resize(totalVertexCount);
 		indices.resize(totalIndexCount);
 	}
 
@@ -54,16 +441,59 @@ ObjectID RS::meshCreate(const Mesh &mesh) {
 	uint32_t indexOffset = 0;
 
 	std::vector<PrimitiveRD> _primitives = {};
+	std::vector<float> lodErrors;
+
+	AABB aabb;
+	bool isAabbEmpty = true;
+	bool isSkinned = false;
+
+	// positions are quantized into bounds, so they are known before packing
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const Vertex *pSrc = mesh.pPrimitives[i].vertices.pData;
+
+		for (size_t j = 0; j < mesh.pPrimitives[i].vertices.count; j++) {
+			isSkinned = isSkinned || pSrc[j].weights != glm::vec4(0.0f);
+
+			if (isAabbEmpty) {
+				aabb = { pSrc[j].position, pSrc[j].position };
+				isAabbEmpty = false;
+				continue;
+			}
+
+			aabb.expand(pSrc[j].position);
+		}
+	}
+
+	// morphed vertices are written into quantized range of base shape, it leaves room for them
+	glm::vec3 morphExtent = getMorphExtent(mesh);
+	aabb = { aabb.min - morphExtent, aabb.max + morphExtent };
+
+	glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+	glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+	// uniform, degenerate mesh keeps valid transform
+	float scale = glm::max(glm::max(extent.x, extent.y), extent.z);
+	scale = scale > 0.0f ? scale : 1.0f;
+
+	// posed vertices are written into quantized range of bind pose, it leaves room for them
+	if (isSkinned) {
+		scale *= SKIN_BOUNDS_SCALE;
+		aabb = { center - glm::vec3(scale), center + glm::vec3(scale) };
+		packed.skins.resize(positions.size());
+	}
 
 	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
 		uint32_t indexCount = static_cast<uint32_t>(mesh.pPrimitives[i].indices.count);
 		uint32_t firstIndex = indexOffset;
 		ObjectID materialIndex = mesh.pPrimitives[i].materialIndex;
 
+		const MeshletArray &meshlets = mesh.pPrimitives[i].meshlets;
+
 		_primitives.push_back({
 				indexCount,
 				firstIndex,
 				materialIndex,
+				std::vector<Meshlet>(meshlets.pData, meshlets.pData + meshlets.count),
 		});
 
 		for (uint32_t j = 0; j < mesh.pPrimitives[i].indices.count; j++) {
@@ -71,289 +501,4152 @@ ObjectID RS::meshCreate(const Mesh &mesh) {
 			indexOffset++;
 		}
 
-		Vertex *pDst = vertices.data();
+		// coarser levels share vertices of primitive
+		const LodArray &lods = mesh.pPrimitives[i].lods;
+
+		for (uint32_t j = 0; j < lods.count; j++) {
+			const IndexArray &lodIndices = lods.pData[j].indices;
+			_primitives.back().lods.push_back({ lodIndices.count, indexOffset });
+
+			for (uint32_t k = 0; k < lodIndices.count; k++) {
+				indices[indexOffset] = vertexOffset + lodIndices.pData[k];
+				indexOffset++;
+			}
+
+			if (lodErrors.size() <= j)
+				lodErrors.resize(j + 1, 0.0f);
+
+			lodErrors[j] = glm::max(lodErrors[j], lods.pData[j].error);
+		}
+
 		const Vertex *pSrc = mesh.pPrimitives[i].vertices.pData;
 		size_t vertexCount = mesh.pPrimitives[i].vertices.count;
 
-		memcpy(&pDst[vertexOffset], pSrc, sizeof(Vertex) * vertexCount);
+		for (size_t j = 0; j < vertexCount; j++) {
+			PackedVertex packed = PackedVertex::pack(pSrc[j], center, scale);
+
+			positions[vertexOffset + j] = packed.position;
+			attributes[vertexOffset + j] = packed.attributes;
+		}
+
+		for (size_t j = 0; j < vertexCount && isSkinned; j++)
+			packed.skins[vertexOffset + j] = PackedSkin::pack(pSrc[j]);
 
 		vertexOffset += vertexCount;
 	}
 
-	RD &rd = RD::getSingleton();
+	packed.morphMovedCount = _packMorphTargets(mesh, scale, packed.morphs);
 
-	vk::DeviceSize vertexBufferSize = sizeof(Vertex) * vertices.size();
-	AllocatedBuffer vertexBuffer = rd.bufferCreate(
-			vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-			vertexBufferSize);
+	packed.primitives = std::move(_primitives);
+	packed.aabb = aabb;
+	packed.dequantize = PackedVertex::getDequantizeTransform(center, scale);
+	packed.lodErrors = std::move(lodErrors);
 
-	rd.bufferSend(vertexBuffer.buffer, (uint8_t *)vertices.data(), (size_t)vertexBufferSize);
+	std::shared_ptr<MeshBVH> pBvh = std::make_shared<MeshBVH>();
+	pBvh->build(mesh);
+	packed.bvh = pBvh;
 
-	vk::DeviceSize indexBufferSize = sizeof(uint32_t) * indices.size();
-	AllocatedBuffer indexBuffer = rd.bufferCreate(
-			vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-			indexBufferSize);
+	if (buildOccluder && !isSkinned && packed.morphs.empty())
+		packed.occluder = OcclusionRasterizer::buildOccluder(mesh);
 
-	rd.bufferSend(indexBuffer.buffer, (uint8_t *)indices.data(), (size_t)indexBufferSize);
+	// ray casts are answered in primitives mesh was created with
+	if (mergePrimitives)
+		_mergePrimitives(packed);
 
-	return _meshes.insert({
-			vertexBuffer,
-			indexBuffer,
-			_primitives,
-	});
+	return packed;
 }
 
-void RS::meshFree(ObjectID mesh) {
-	_meshes.free(mesh);
-}
+MeshRD RS::_meshUpload(PackedMesh &packed) {
+	GeometryRange geometry = RD::getSingleton().getGeometryArena().allocate(
+			packed.positions.data(), packed.attributes.data(),
+			static_cast<uint32_t>(packed.positions.size()), packed.indices.data(),
+			static_cast<uint32_t>(packed.indices.size()));
 
-ObjectID RenderingServer::meshInstanceCreate() {
-	return _meshInstances.insert({});
-}
+	// indices are relative to mesh, vertex offset is applied when drawing
+	for (PrimitiveRD &primitive : packed.primitives) {
+		for (Meshlet &meshlet : primitive.meshlets)
+			meshlet.firstIndex += primitive.firstIndex + geometry.indexOffset;
 
-void RS::meshInstanceSetMesh(ObjectID meshInstance, ObjectID mesh) {
-	CHECK_IF_VALID(_meshInstances, meshInstance, "MeshInstance");
-	CHECK_IF_VALID(_meshes, mesh, "Mesh")
+		for (LodRD &lod : primitive.lods)
+			lod.firstIndex += geometry.indexOffset;
 
-	_meshInstances[meshInstance].mesh = mesh;
-}
+		primitive.firstIndex += geometry.indexOffset;
+	}
 
-void RS::meshInstanceSetTransform(ObjectID meshInstance, const glm::mat4 &transform) {
-	CHECK_IF_VALID(_meshInstances, meshInstance, "MeshInstance");
+	uint32_t skinOffset = RD::getSingleton().getSkinStorage().allocate(
+			packed.skins.data(), static_cast<uint32_t>(packed.skins.size()));
 
-	_meshInstances[meshInstance].transform = transform;
-}
+	MeshRD mesh = {
+		geometry,
+		0,
+		0,
+		packed.aabb,
+		packed.dequantize,
+		std::move(packed.lodErrors),
+		std::move(packed.bvh),
+		skinOffset,
+		std::move(packed.primitiveRemap),
+	};
+	mesh.occluder = packed.occluder;
 
-void RS::meshInstanceFree(ObjectID meshInstance) {
-	_meshInstances.free(meshInstance);
-}
+	mesh.morphOffset = RD::getSingleton().getMorphStorage().allocate(
+			packed.morphs.data(), static_cast<uint32_t>(packed.morphs.size()));
+	mesh.morphSize = static_cast<uint32_t>(packed.morphs.size());
+	mesh.morphMovedCount = packed.morphMovedCount;
 
-ObjectID RS::lightCreate(LightType type) {
-	return RD::getSingleton().getLightStorage().lightCreate(type);
-}
+	_primitivesInsert(mesh, std::move(packed.primitives));
 
-void RS::lightSetTransform(ObjectID light, const glm::mat4 &transform) {
-	RD::getSingleton().getLightStorage().lightSetTransform(light, transform);
+	return mesh;
 }
 
-void RS::lightSetRange(ObjectID light, float range) {
-	RD::getSingleton().getLightStorage().lightSetRange(light, range);
-}
+void RS::_primitivesInsert(MeshRD &mesh, std::vector<PrimitiveRD> &&primitives) {
+	uint32_t count = static_cast<uint32_t>(primitives.size());
+	mesh.firstPrimitive = 0;
+	mesh.primitiveCount = count;
 
-void RS::lightSetColor(ObjectID light, const glm::vec3 &color) {
-	RD::getSingleton().getLightStorage().lightSetColor(light, color);
+	if (count == 0)
+		return;
+
+	uint32_t first = _primitiveRanges.allocate(count);
+
+	if (first == RangeAllocator::INVALID_OFFSET) {
+		uint32_t capacity = _primitiveRanges.getCapacity();
+		_primitiveRanges.grow(std::max(capacity * 2, capacity + count));
+		first = _primitiveRanges.allocate(count);
+	}
+
+	// draw items of queues point into table, which resize moved
+	if (_primitiveRanges.getCapacity() > _primitiveTable.size()) {
+		_primitiveTable.resize(_primitiveRanges.getCapacity());
+		_isQueueDirty = true;
+		_isShadowQueueDirty = true;
+	}
+
+	std::move(primitives.begin(), primitives.end(), _primitiveTable.begin() + first);
+	mesh.firstPrimitive = first;
 }
 
-void RS::lightSetIntensity(ObjectID light, float intensity) {
-	RD::getSingleton().getLightStorage().lightSetIntensity(light, intensity);
+void RS::_primitivesFree(MeshRD &mesh) {
+	if (mesh.primitiveCount == 0)
+		return;
+
+	// queues are built again before next draw, table is only read on CPU
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++)
+		_primitiveTable[mesh.firstPrimitive + i] = {};
+
+	_primitiveRanges.free(mesh.firstPrimitive, mesh.primitiveCount);
+	mesh.firstPrimitive = 0;
+	mesh.primitiveCount = 0;
 }
 
-void RS::lightFree(ObjectID light) {
-	RD::getSingleton().getLightStorage().lightFree(light);
+const PrimitiveRD *RS::_getPrimitives(const MeshRD &mesh) const {
+	return _primitiveTable.data() + mesh.firstPrimitive;
 }
 
-ObjectID RS::textureCreate(const std::shared_ptr<Image> image) {
-	if (image == nullptr)
-		return NULL_HANDLE;
+MeshRD RS::_meshEvicted(const PackedMesh &packed) {
+	MeshRD mesh = {};
+	mesh.aabb = packed.aabb;
+	mesh.dequantize = packed.dequantize;
+	mesh.lodErrors = packed.lodErrors;
+	mesh.bvh = packed.bvh;
+	mesh.primitiveRemap = packed.primitiveRemap;
+	mesh.occluder = packed.occluder;
 
-	TextureRD _texture = RD::getSingleton().textureCreate(image);
-	return _textures.insert(_texture);
+	return mesh;
 }
 
-void RS::textureFree(ObjectID texture) {
-	_textures.free(texture);
+uint64_t RS::_getPackedSize(const PackedMesh &packed) {
+	return packed.positions.size() * sizeof(PackedPosition) +
+			packed.attributes.size() * sizeof(PackedAttributes) +
+			packed.indices.size() * sizeof(uint32_t);
 }
 
-ObjectID RS::materialCreate(const MaterialInfo &info) {
-	TextureRD albedo = _textures.get_id_or_else(info.albedo, _albedoFallback);
-	TextureRD normal = _textures.get_id_or_else(info.normal, _normalFallback);
-	TextureRD metallic = _textures.get_id_or_else(info.metallic, _metallicFallback);
-	TextureRD roughness = _textures.get_id_or_else(info.roughness, _roughnessFallback);
-
-	RD &rd = RD::getSingleton();
-	vk::Device device = rd.getDevice();
-	vk::DescriptorPool descriptorPool = rd.getDescriptorPool();
+ObjectID RS::_meshInsert(PackedMesh &packed, ObjectID reserved) {
+	_isQueueDirty = true;
 
-	std::array<vk::DescriptorImageInfo, 4> imageInfos = {};
-	imageInfos[0].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	imageInfos[0].setImageView(albedo.imageView);
-	imageInfos[0].setSampler(albedo.sampler);
+	// skins and targets are applied from arena, skinned and morphed meshes stay resident
+	bool isStreamed = _useGeometryStreaming && packed.skins.empty() && packed.morphs.empty();
+	bool isImpostorCandidate = _isImpostorCandidate(packed);
+	MeshRD mesh = isStreamed ? _meshEvicted(packed) : _meshUpload(packed);
 
-	imageInfos[1].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	imageInfos[1].setImageView(normal.imageView);
-	imageInfos[1].setSampler(normal.sampler);
+	ObjectID id = reserved != NULL_HANDLE ? _meshes.insertReserved(reserved, std::move(mesh))
+										  : _meshes.insert(std::move(mesh));
 
-	imageInfos[2].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	imageInfos[2].setImageView(metallic.imageView);
-	imageInfos[2].setSampler(metallic.sampler);
+	if (isImpostorCandidate)
+		_impostorQueue.push_back(id);
 
-	imageInfos[3].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	imageInfos[3].setImageView(roughness.imageView);
-	imageInfos[3].setSampler(roughness.sampler);
+	// uploaded once an instance of it comes near camera
+	if (isStreamed) {
+		uint64_t size = _getPackedSize(packed);
+		_streamedMeshes[id] = { std::move(packed), size, false, 0, 0.0f, 0.0f };
+	}
 
-	vk::DescriptorSetLayout textureLayout = rd.getTextureLayout();
+	return id;
+}
 
-	vk::DescriptorSetAllocateInfo allocInfo = {};
-	allocInfo.setDescriptorPool(descriptorPool);
-	allocInfo.setDescriptorSetCount(1);
-	allocInfo.setSetLayouts(textureLayout);
+ObjectID RS::meshCreate(const Mesh &mesh) {
+	ObjectID id = _meshCreate(mesh);
 
-	VkDescriptorSet textureSet = device.allocateDescriptorSets(allocInfo)[0];
+	// ids are known once created, later calls refer to them
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshCreate, id, mesh);
 
-	std::array<vk::WriteDescriptorSet, 4> writeInfos = {};
-	writeInfos[0].setDstSet(textureSet);
-	writeInfos[0].setDstBinding(0);
-	writeInfos[0].setDstArrayElement(0);
-	writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-	writeInfos[0].setDescriptorCount(1);
-	writeInfos[0].setImageInfo(imageInfos[0]);
+	return id;
+}
 
-	writeInfos[1].setDstSet(textureSet);
-	writeInfos[1].setDstBinding(1);
-	writeInfos[1].setDstArrayElement(0);
-	writeInfos[1].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-	writeInfos[1].setDescriptorCount(1);
-	writeInfos[1].setImageInfo(imageInfos[1]);
+ObjectID RS::_meshCreate(const Mesh &mesh) {
+	_markChanged();
 
-	writeInfos[2].setDstSet(textureSet);
-	writeInfos[2].setDstBinding(2);
-	writeInfos[2].setDstArrayElement(0);
-	writeInfos[2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-	writeInfos[2].setDescriptorCount(1);
-	writeInfos[2].setImageInfo(imageInfos[2]);
+	// packing only reads mesh, render thread is left with upload and materials of primitives
+	if (_isClientCall()) {
+		ObjectID id = _nextClientId++;
+		std::shared_ptr<PackedMesh> pPacked = std::make_shared<PackedMesh>(
+				_packMesh(mesh, _useMergedPrimitives, _useOcclusionCulling));
 
-	writeInfos[3].setDstSet(textureSet);
-	writeInfos[3].setDstBinding(3);
-	writeInfos[3].setDstArrayElement(0);
-	writeInfos[3].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-	writeInfos[3].setDescriptorCount(1);
-	writeInfos[3].setImageInfo(imageInfos[3]);
+		_push([this, id, pPacked]() {
+			for (PrimitiveRD &primitive : pPacked->primitives)
+				primitive.material = _toObject(primitive.material);
 
-	device.updateDescriptorSets(writeInfos, nullptr);
+			_clientObjects[id] = _meshInsert(*pPacked);
+		});
 
-	return _materials.insert({ textureSet });
-}
+		return id;
+	}
 
-void RS::materialFree(ObjectID material) {
-	_materials.free(material);
-}
+	// arena growth replaces buffers owner thread records with, so loaders only pack
+	if (_isBackgroundCall()) {
+		ObjectID id = _meshes.reserve();
+		std::shared_ptr<PackedMesh> pPacked = std::make_shared<PackedMesh>(
+				_packMesh(mesh, _useMergedPrimitives, _useOcclusionCulling));
 
-void RS::setExposure(float exposure) {
-	RD::getSingleton().setExposure(exposure);
-}
+		_push([this, id, pPacked]() { _meshInsert(*pPacked, id); });
 
-void RS::setWhite(float white) {
-	RD::getSingleton().setWhite(white);
-}
+		return id;
+	}
 
-void RS::environmentSkyUpdate(const std::shared_ptr<Image> image) {
-	RD::getSingleton().environmentSkyUpdate(image);
+	PackedMesh packed = _packMesh(mesh, _useMergedPrimitives, _useOcclusionCulling);
+	return _meshInsert(packed);
 }
 
-void RenderingServer::draw() {
-	RD &rd = RD::getSingleton();
-	rd.updateUniformBuffer(_camera.transform[3]);
+void RS::_meshReplace(ObjectID mesh, PackedMesh &packed) {
+	CHECK_IF_VALID(_meshes, mesh, "Mesh");
 
-	vk::Extent2D extent = rd.getSwapchainExtent();
-	float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
 
-	glm::mat4 proj = _camera.projectionMatrix(aspect);
-	glm::mat4 view = _camera.viewMatrix();
+	LightStorage &lightStorage = RD::getSingleton().getLightStorage();
 
-	glm::mat4 invProj = glm::inverse(proj);
-	glm::mat4 invView = glm::inverse(view);
+	// poses and morphs of old mesh do not fit new one, joints and weights are kept for it
+	for (MeshInstanceRD &meshInstance : _meshInstances) {
+		if (meshInstance.mesh != mesh)
+			continue;
 
-	glm::mat4 projView = proj * view;
+		lightStorage.shadowInvalidate(meshInstance.aabb);
+		_freePose(meshInstance);
+		_freeMorph(meshInstance);
+	}
 
-	vk::CommandBuffer commandBuffer = rd.drawBegin();
+	// captured from old geometry, new one is captured again
+	_impostorFree(mesh);
 
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rd.getDepthPipeline());
+	if (_isImpostorCandidate(packed))
+		_impostorQueue.push_back(mesh);
 
-	for (const auto &[_, meshInstance] : _meshInstances.map()) {
-		const MeshRD &mesh = _meshes[meshInstance.mesh];
+	// range can not be reused while frames in flight still draw from it
+	GeometryRange geometry = _meshes[mesh].geometry;
+	uint32_t skinOffset = _meshes[mesh].skinOffset;
+	uint32_t morphOffset = _meshes[mesh].morphOffset;
+	uint32_t morphSize = _meshes[mesh].morphSize;
 
-		vk::PipelineLayout pipelineLayout = rd.getDepthPipelineLayout();
+	RD::getSingleton().destroyDeferred([geometry, skinOffset, morphOffset, morphSize] {
+		RD::getSingleton().getGeometryArena().free(geometry);
+		RD::getSingleton().getSkinStorage().free(skinOffset, geometry.vertexCount);
+		RD::getSingleton().getMorphStorage().free(morphOffset, morphSize);
+	});
 
-		vk::DeviceSize offset = 0;
-		commandBuffer.bindVertexBuffers(0, 1, &mesh.vertexBuffer.buffer, &offset);
-		commandBuffer.bindIndexBuffer(mesh.indexBuffer.buffer, 0, vk::IndexType::eUint32);
+	_primitivesFree(_meshes[mesh]);
 
-		MeshPushConstants constants{};
-		constants.projView = projView;
-		constants.model = meshInstance.transform;
+	auto streamed = _streamedMeshes.find(mesh);
 
-		commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0,
-				sizeof(MeshPushConstants), &constants);
+	if (streamed != _streamedMeshes.end() && packed.skins.empty() && packed.morphs.empty()) {
+		StreamedMeshRD &_streamed = streamed->second;
+		_streamed.source = packed;
+		_streamed.size = _getPackedSize(packed);
 
-		for (const PrimitiveRD &primitive : mesh.primitives) {
-			commandBuffer.drawIndexed(primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+		_meshes[mesh] = _streamed.isResident ? _meshUpload(packed) : _meshEvicted(packed);
+	} else {
+		// mesh which gained a skin or targets is resident from now on
+		if (streamed != _streamedMeshes.end()) {
+			_streamedMeshes.erase(streamed);
+			_uploadScheduler.cancel(UploadKind::Geometry, mesh);
 		}
-	}
 
-	commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+		_meshes[mesh] = _meshUpload(packed);
+	}
 
-	{
-		// sky
+	for (uint64_t i = 0; i < _meshInstances.size(); i++) {
+		ObjectID id = _meshInstances.getObject(i);
+		MeshInstanceRD &meshInstance = _meshInstances[id];
 
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rd.getSkyPipeline());
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-				rd.getSkyPipelineLayout(), 0, rd.getSkySet(), nullptr);
+		if (meshInstance.mesh != mesh)
+			continue;
 
-		SkyConstants constants{};
-		constants.invProj = invProj;
-		constants.invView = invView;
+		_updateInstance(id, meshInstance);
+		_requestMorph(id, meshInstance);
+		_requestPose(id, meshInstance);
 
-		commandBuffer.pushConstants(rd.getSkyPipelineLayout(), vk::ShaderStageFlagBits::eFragment,
-				0, sizeof(constants), &constants);
-		commandBuffer.draw(3, 1, 0, 0);
+		lightStorage.shadowInvalidate(meshInstance.aabb);
 	}
+}
 
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rd.getMaterialPipeline());
-	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			rd.getMaterialPipelineLayout(), 0, rd.getMaterialSets(), nullptr);
+void RS::meshUpdate(ObjectID mesh, const Mesh &sceneMesh) {
+	_markChanged();
 
-	for (const auto &[_, meshInstance] : _meshInstances.map()) {
-		const MeshRD &mesh = _meshes[meshInstance.mesh];
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshUpdate, mesh, sceneMesh);
 
-		vk::PipelineLayout pipelineLayout = rd.getMaterialPipelineLayout();
+	// packed on calling thread, like by meshCreate
+	if (_isClientCall()) {
+		std::shared_ptr<PackedMesh> pPacked = std::make_shared<PackedMesh>(
+				_packMesh(sceneMesh, _useMergedPrimitives, _useOcclusionCulling));
 
-		vk::DeviceSize offset = 0;
-		commandBuffer.bindVertexBuffers(0, 1, &mesh.vertexBuffer.buffer, &offset);
-		commandBuffer.bindIndexBuffer(mesh.indexBuffer.buffer, 0, vk::IndexType::eUint32);
+		_push([this, mesh, pPacked]() {
+			for (PrimitiveRD &primitive : pPacked->primitives)
+				primitive.material = _toObject(primitive.material);
 
-		MeshPushConstants constants{};
-		constants.projView = projView;
-		constants.model = meshInstance.transform;
+			_meshReplace(_toObject(mesh), *pPacked);
+		});
+		return;
+	}
 
-		commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0,
-				sizeof(MeshPushConstants), &constants);
+	_adoptBackground();
 
-		for (const PrimitiveRD &primitive : mesh.primitives) {
-			MaterialRD material = _materials[primitive.material];
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 3,
-					material.textureSet, nullptr);
+	PackedMesh packed = _packMesh(sceneMesh, _useMergedPrimitives, _useOcclusionCulling);
+	_meshReplace(mesh, packed);
+}
 
-			commandBuffer.drawIndexed(primitive.indexCount, 1, primitive.firstIndex, 0, 0);
-		}
+void RS::meshFree(ObjectID mesh) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshFree, mesh);
+
+	if (_isClientCall()) {
+		_push([this, mesh]() {
+			meshFree(_toObject(mesh));
+			_clientObjects.erase(mesh);
+		});
+		return;
 	}
 
-	rd.drawEnd(commandBuffer);
-}
+	_adoptBackground();
 
-vk::Instance RS::getVkInstance() const {
-	return RD::getSingleton().getInstance();
-}
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
 
-void RS::windowInit(SDL_Window *pWindow) {
-	RD &rd = RD::getSingleton();
+	CHECK_IF_VALID(_meshes, mesh, "Mesh");
 
-	VkSurfaceKHR surface;
-	SDL_Vulkan_CreateSurface(pWindow, rd.getInstance(), nullptr, &surface);
+	LightStorage &lightStorage = RD::getSingleton().getLightStorage();
 
-	int width, height;
-	SDL_GetWindowSizeInPixels(pWindow, &width, &height);
+	for (MeshInstanceRD &meshInstance : _meshInstances) {
+		if (meshInstance.mesh != mesh)
+			continue;
+
+		lightStorage.shadowInvalidate(meshInstance.aabb);
+
+		// instance keeps id of freed mesh, it is left out of culling until it gets a new one
+		if (meshInstance.proxy != AABB_TREE_NULL)
+			_instanceTree.remove(meshInstance.proxy);
+
+		meshInstance.proxy = AABB_TREE_NULL;
+		_freePose(meshInstance);
+		_freeMorph(meshInstance);
+	}
+
+	_impostorFree(mesh);
+
+	// range can not be reused while frames in flight still draw from it
+	GeometryRange geometry = _meshes[mesh].geometry;
+	uint32_t skinOffset = _meshes[mesh].skinOffset;
+	uint32_t morphOffset = _meshes[mesh].morphOffset;
+	uint32_t morphSize = _meshes[mesh].morphSize;
+
+	RD::getSingleton().destroyDeferred([geometry, skinOffset, morphOffset, morphSize] {
+		RD::getSingleton().getGeometryArena().free(geometry);
+		RD::getSingleton().getSkinStorage().free(skinOffset, geometry.vertexCount);
+		RD::getSingleton().getMorphStorage().free(morphOffset, morphSize);
+	});
+
+	_primitivesFree(_meshes[mesh]);
+	_streamedMeshes.erase(mesh);
+	_uploadScheduler.cancel(UploadKind::Geometry, mesh);
+	_meshes.free(mesh);
+}
+
+bool RS::_isImpostorCandidate(const PackedMesh &packed) const {
+	if (!_useImpostors || !packed.skins.empty() || !packed.morphs.empty() ||
+			packed.primitives.size() > MAX_IMPOSTOR_DRAW_COUNT)
+		return false;
+
+	uint64_t triangleCount = 0;
+
+	for (const PrimitiveRD &primitive : packed.primitives)
+		triangleCount += primitive.indexCount / 3;
+
+	return triangleCount >= IMPOSTOR_MIN_TRIANGLE_COUNT;
+}
+
+void RS::_recordImpostorBake(vk::CommandBuffer commandBuffer) {
+	// moved textures are sampled from new images only once pass ends
+	if (_impostorBaker.isBaking() || _impostorQueue.empty() ||
+			_defragmentation != VK_NULL_HANDLE)
+		return;
+
+	ObjectID id = _impostorQueue.front();
+	_impostorQueue.pop_front();
+
+	if (!_meshes.has(id))
+		return;
+
+	// evicted meshes wait until an instance brings them in
+	auto streamed = _streamedMeshes.find(id);
+
+	if (streamed != _streamedMeshes.end() && !streamed->second.isResident) {
+		_impostorQueue.push_back(id);
+		return;
+	}
+
+	const MeshRD &mesh = _meshes[id];
+	const PrimitiveRD *pPrimitives = _getPrimitives(mesh);
+	std::vector<ImpostorBaker::Draw> draws;
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const PrimitiveRD &primitive = pPrimitives[i];
+		const MaterialRD &material = _getMaterial(primitive.material);
+		const TextureRD &albedo = _getBoundTexture(material.albedo, _albedoFallback);
+
+		ImpostorBaker::Draw draw = {};
+		draw.indexCount = primitive.indexCount;
+		draw.firstIndex = primitive.firstIndex;
+		draw.vertexOffset = static_cast<int32_t>(mesh.geometry.vertexOffset);
+		draw.albedo = vk::DescriptorImageInfo(
+				albedo.sampler, albedo.imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+		draw.albedoFactor = material.albedoFactor;
+		draw.albedoRect = material.albedoRect;
+		draw.alphaTest = (material.permutation & MATERIAL_ALPHA_TEST_BIT) != 0;
+
+		draws.push_back(draw);
+	}
+
+	// dequantize is uniform scale, see PackedVertex::getDequantizeTransform
+	_impostorBaker.record(commandBuffer, RD::getSingleton().getGeometryArena(),
+			mesh.geometry.indexType, mesh.aabb, mesh.dequantize[0][0], draws);
+
+	_impostorBakeMesh = id;
+	_impostorBakeFrame = _frameCount;
+}
+
+void RS::_collectImpostor() {
+	if (!_impostorBaker.isBaking() ||
+			_frameCount - _impostorBakeFrame <= RD::getSingleton().getFramesInFlight())
+		return;
+
+	std::shared_ptr<Image> image = _impostorBaker.collect();
+	ObjectID id = _impostorBakeMesh;
+	_impostorBakeMesh = NULL_HANDLE;
+
+	if (!_meshes.has(id))
+		return;
+
+	// internal objects, calls creating them are not recorded, playback captures again
+	TextureRD texture = _createTexture(image);
+	ObjectID textureId = _textureInsert(texture);
+	_setTextureUserData(texture, textureId);
+
+	// cells are unlit albedo, quads are shaded as rough dielectric cards
+	MaterialInfo info = {};
+	info.albedo = textureId;
+	info.metallicFactor = 0.0f;
+	info.roughnessFactor = 1.0f;
+	info.alphaTest = true;
+
+	ObjectID material = _materials.insert(_createMaterial(info));
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	ImpostorBaker::buildQuads(_meshes[id].aabb, vertices, indices);
+
+	Primitive primitive = {};
+	primitive.vertices = { vertices.data(), static_cast<uint32_t>(vertices.size()) };
+	primitive.indices = { indices.data(), static_cast<uint32_t>(indices.size()) };
+	primitive.materialIndex = material;
+
+	Mesh quads = {};
+	quads.pPrimitives = &primitive;
+	quads.primitiveCount = 1;
+	quads.pName = "impostor";
+
+	// never streamed, quads are a fraction of what they stand for
+	PackedMesh packed = _packMesh(quads, false);
+	ObjectID impostor = _meshes.insert(_meshUpload(packed));
+
+	_meshes[id].impostor = impostor;
+	_impostors[id] = { impostor, material, textureId };
+
+	// queues point into meshes, which insert moved
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+
+	for (uint64_t i = 0; i < _meshInstances.size(); i++) {
+		ObjectID instanceId = _meshInstances.getObject(i);
+		MeshInstanceRD &meshInstance = _meshInstances[instanceId];
+
+		if (meshInstance.mesh == id)
+			_updateInstance(instanceId, meshInstance);
+	}
+}
+
+void RS::_impostorFree(ObjectID mesh) {
+	if (_impostorBakeMesh == mesh)
+		_impostorBakeMesh = NULL_HANDLE;
+
+	_impostorQueue.erase(
+			std::remove(_impostorQueue.begin(), _impostorQueue.end(), mesh), _impostorQueue.end());
+
+	auto it = _impostors.find(mesh);
+
+	if (it == _impostors.end())
+		return;
+
+	ImpostorRD impostor = it->second;
+	_impostors.erase(it);
+
+	if (_meshes.has(mesh))
+		_meshes[mesh].impostor = NULL_HANDLE;
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+
+	GeometryRange geometry = _meshes[impostor.mesh].geometry;
+	uint32_t skinOffset = _meshes[impostor.mesh].skinOffset;
+
+	RD::getSingleton().destroyDeferred([geometry, skinOffset] {
+		RD::getSingleton().getGeometryArena().free(geometry);
+		RD::getSingleton().getSkinStorage().free(skinOffset, geometry.vertexCount);
+	});
+
+	_primitivesFree(_meshes[impostor.mesh]);
+	_meshes.free(impostor.mesh);
+
+	_destroyMaterialDeferred(_materials[impostor.material]);
+	_materials.free(impostor.material);
+
+	_textureFree(impostor.texture);
+}
+
+ObjectID RS::meshInstanceCreate() {
+	ObjectID meshInstance = _meshInstanceCreate();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceCreate, meshInstance);
+
+	return meshInstance;
+}
+
+ObjectID RS::_meshInstanceCreate() {
+	_markChanged();
+
+	if (_isClientCall()) {
+		ObjectID id = _nextClientId++;
+		_push([this, id]() { _clientObjects[id] = _meshInstanceCreate(); });
+		return id;
+	}
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+
+	return _meshInstances.insert({});
+}
+
+std::vector<ObjectID> RS::meshInstanceCreateBatch(uint32_t count) {
+	std::vector<ObjectID> meshInstances = _meshInstanceCreateBatch(count);
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceCreateBatch, meshInstances);
+
+	return meshInstances;
+}
+
+std::vector<ObjectID> RS::_meshInstanceCreateBatch(uint32_t count) {
+	_markChanged();
+
+	std::vector<ObjectID> meshInstances(count);
+
+	if (_isClientCall()) {
+		ObjectID first = _nextClientId.fetch_add(count);
+
+		for (uint32_t i = 0; i < count; i++)
+			meshInstances[i] = first + i;
+
+		_push([this, first, count]() {
+			for (uint32_t i = 0; i < count; i++)
+				_clientObjects[first + i] = _meshInstances.insert({});
+		});
+
+		return meshInstances;
+	}
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+
+	for (uint32_t i = 0; i < count; i++)
+		meshInstances[i] = _meshInstances.insert({});
+
+	return meshInstances;
+}
+
+void RS::meshInstanceSetMesh(ObjectID meshInstance, ObjectID mesh) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceSetMesh, meshInstance, mesh);
+
+	if (_isClientCall()) {
+		_push([this, meshInstance, mesh]() {
+			meshInstanceSetMesh(_toObject(meshInstance), _toObject(mesh));
+		});
+		return;
+	}
+
+	_adoptBackground();
+
+	CHECK_IF_VALID(_meshInstances, meshInstance, "MeshInstance");
+	CHECK_IF_VALID(_meshes, mesh, "Mesh")
+
+	LightStorage &lightStorage = RD::getSingleton().getLightStorage();
+
+	// instance without mesh casts nothing, its bounds are not valid
+	if (_meshes.has(_meshInstances[meshInstance].mesh))
+		lightStorage.shadowInvalidate(_meshInstances[meshInstance].aabb);
+
+	// pose and morph of old mesh do not fit new one, joints and weights are kept for it
+	_freePose(_meshInstances[meshInstance]);
+	_freeMorph(_meshInstances[meshInstance]);
+
+	_meshInstances[meshInstance].mesh = mesh;
+	_updateInstance(meshInstance, _meshInstances[meshInstance]);
+	_requestMorph(meshInstance, _meshInstances[meshInstance]);
+	_requestPose(meshInstance, _meshInstances[meshInstance]);
+
+	lightStorage.shadowInvalidate(_meshInstances[meshInstance].aabb);
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+}
+
+void RS::meshInstanceSetTransform(ObjectID meshInstance, const glm::mat4 &transform) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceSetTransform, meshInstance, transform);
+
+	if (_isClientCall()) {
+		_push([this, meshInstance, transform]() {
+			meshInstanceSetTransform(_toObject(meshInstance), transform);
+		});
+		return;
+	}
+
+	CHECK_IF_VALID(_meshInstances, meshInstance, "MeshInstance");
+
+	LightStorage &lightStorage = RD::getSingleton().getLightStorage();
+	bool hasMesh = _meshes.has(_meshInstances[meshInstance].mesh);
+
+	// shadow is cast from old and new place
+	if (hasMesh)
+		lightStorage.shadowInvalidate(_meshInstances[meshInstance].aabb);
+
+	_meshInstances[meshInstance].transform = transform;
+	_updateInstance(meshInstance, _meshInstances[meshInstance]);
+
+	if (hasMesh)
+		lightStorage.shadowInvalidate(_meshInstances[meshInstance].aabb);
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+}
+
+void RS::meshInstanceSetTransforms(
+		const std::vector<ObjectID> &meshInstances, const std::vector<glm::mat4> &transforms) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceSetTransforms, meshInstances, transforms);
+
+	if (_isClientCall()) {
+		_push([this, meshInstances, transforms]() {
+			std::vector<ObjectID> objects(meshInstances.size());
+
+			for (size_t i = 0; i < objects.size(); i++)
+				objects[i] = _toObject(meshInstances[i]);
+
+			meshInstanceSetTransforms(objects, transforms);
+		});
+		return;
+	}
+
+	LightStorage &lightStorage = RD::getSingleton().getLightStorage();
+	size_t count = std::min(meshInstances.size(), transforms.size());
+
+	for (size_t i = 0; i < count; i++) {
+		if (!_meshInstances.has(meshInstances[i])) {
+			std::cout << "ERROR: MeshInstance: " << meshInstances[i] << " is not valid resource!"
+					  << std::endl;
+			continue;
+		}
+
+		MeshInstanceRD &meshInstance = _meshInstances[meshInstances[i]];
+		bool hasMesh = _meshes.has(meshInstance.mesh);
+
+		// shadow is cast from old and new place
+		if (hasMesh)
+			lightStorage.shadowInvalidate(meshInstance.aabb);
+
+		meshInstance.transform = transforms[i];
+		_updateInstance(meshInstances[i], meshInstance);
+
+		if (hasMesh)
+			lightStorage.shadowInvalidate(meshInstance.aabb);
+	}
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+}
+
+void RS::meshInstanceFree(ObjectID meshInstance) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceFree, meshInstance);
+
+	if (_isClientCall()) {
+		_push([this, meshInstance]() {
+			meshInstanceFree(_toObject(meshInstance));
+			_clientObjects.erase(meshInstance);
+		});
+		return;
+	}
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+
+	if (_meshInstances.has(meshInstance) && _meshes.has(_meshInstances[meshInstance].mesh))
+		RD::getSingleton().getLightStorage().shadowInvalidate(_meshInstances[meshInstance].aabb);
+
+	if (_meshInstances.has(meshInstance) && _meshInstances[meshInstance].proxy != AABB_TREE_NULL)
+		_instanceTree.remove(_meshInstances[meshInstance].proxy);
+
+	if (_meshInstances.has(meshInstance)) {
+		_freePose(_meshInstances[meshInstance]);
+		_freeMorph(_meshInstances[meshInstance]);
+	}
+
+	_meshInstances.free(meshInstance);
+}
+
+void RS::meshInstanceSetJoints(ObjectID meshInstance, const std::vector<glm::mat4> &joints) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceSetJoints, meshInstance, joints);
+
+	if (_isClientCall()) {
+		_push([this, meshInstance, joints]() {
+			meshInstanceSetJoints(_toObject(meshInstance), joints);
+		});
+		return;
+	}
+
+	CHECK_IF_VALID(_meshInstances, meshInstance, "MeshInstance");
+
+	_meshInstances[meshInstance].joints = joints;
+	_requestPose(meshInstance, _meshInstances[meshInstance]);
+}
+
+void RS::meshInstanceSetMorphWeights(ObjectID meshInstance, const std::vector<float> &weights) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MeshInstanceSetMorphWeights, meshInstance, weights);
+
+	if (_isClientCall()) {
+		_push([this, meshInstance, weights]() {
+			meshInstanceSetMorphWeights(_toObject(meshInstance), weights);
+		});
+		return;
+	}
+
+	CHECK_IF_VALID(_meshInstances, meshInstance, "MeshInstance");
+
+	std::vector<float> clamped(weights.size());
+
+	for (size_t i = 0; i < weights.size(); i++)
+		clamped[i] = std::clamp(weights[i], -1.0f, 1.0f);
+
+	if (clamped == _meshInstances[meshInstance].morphWeights)
+		return;
+
+	_meshInstances[meshInstance].morphWeights = std::move(clamped);
+	_requestMorph(meshInstance, _meshInstances[meshInstance]);
+}
+
+bool RS::raycast(const glm::vec3 &origin, const glm::vec3 &direction, RaycastHit &hit,
+		float maxDistance) const {
+	if (_isClientCall()) {
+		bool isHit = false;
+
+		_pushSync([&]() {
+			isHit = raycast(origin, direction, hit, maxDistance);
+
+			if (!isHit)
+				return;
+
+			// client knows instances by its own ids, reverse lookup is fine for a single hit
+			ObjectID meshInstance = hit.meshInstance;
+			hit.meshInstance = NULL_HANDLE;
+
+			for (const auto &[clientId, object] : _clientObjects) {
+				if (object == meshInstance)
+					hit.meshInstance = clientId;
+			}
+		});
+
+		return isHit;
+	}
+
+	float length = glm::length(direction);
+
+	if (length <= 0.0f)
+		return false;
+
+	glm::vec3 rayDirection = direction / length;
+
+	std::vector<uint64_t> candidates;
+	_instanceTree.queryRay(origin, rayDirection, maxDistance, candidates);
+
+	float closest = maxDistance;
+	bool isHit = false;
+
+	for (ObjectID id : candidates) {
+		const MeshInstanceRD &meshInstance = _meshInstances[id];
+		const MeshRD &mesh = _meshes[meshInstance.mesh];
+
+		if (mesh.bvh == nullptr)
+			continue;
+
+		// direction keeps its length through inverse, so distances compare across instances
+		glm::mat4 invTransform = glm::inverse(meshInstance.transform);
+		glm::vec3 meshOrigin = glm::vec3(invTransform * glm::vec4(origin, 1.0f));
+		glm::vec3 meshDirection = glm::mat3(invTransform) * rayDirection;
+
+		MeshBVH::Hit meshHit;
+
+		if (!mesh.bvh->raycast(meshOrigin, meshDirection, closest, meshHit))
+			continue;
+
+		closest = meshHit.distance;
+		isHit = true;
+
+		hit.meshInstance = id;
+		hit.primitive = meshHit.primitive;
+		hit.drawnPrimitive = mesh.primitiveRemap.empty() ? meshHit.primitive
+														  : mesh.primitiveRemap[meshHit.primitive];
+		hit.firstIndex = meshHit.firstIndex;
+		hit.normal = glm::inverseTranspose(glm::mat3(meshInstance.transform)) * meshHit.normal;
+	}
+
+	if (!isHit)
+		return false;
+
+	hit.distance = closest;
+	hit.position = origin + rayDirection * closest;
+	hit.normal = glm::normalize(hit.normal);
+
+	return true;
+}
+
+ObjectID RS::lightCreate(LightType type) {
+	ObjectID light = _lightCreate(type);
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightCreate, light, type);
+
+	return light;
+}
+
+ObjectID RS::_lightCreate(LightType type) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		ObjectID id = _nextClientId++;
+		_push([this, id, type]() { _clientObjects[id] = _lightCreate(type); });
+		return id;
+	}
+
+	return RD::getSingleton().getLightStorage().lightCreate(type);
+}
+
+void RS::lightSetTransform(ObjectID light, const glm::mat4 &transform) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetTransform, light, transform);
+
+	if (_isClientCall()) {
+		_push([this, light, transform]() { lightSetTransform(_toObject(light), transform); });
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetTransform(light, transform);
+}
+
+void RS::lightSetTransforms(
+		const std::vector<ObjectID> &lights, const std::vector<glm::mat4> &transforms) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetTransforms, lights, transforms);
+
+	if (_isClientCall()) {
+		_push([this, lights, transforms]() {
+			std::vector<ObjectID> objects(lights.size());
+
+			for (size_t i = 0; i < objects.size(); i++)
+				objects[i] = _toObject(lights[i]);
+
+			lightSetTransforms(objects, transforms);
+		});
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetTransforms(lights, transforms);
+}
+
+void RS::lightSetRange(ObjectID light, float range) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetRange, light, range);
+
+	if (_isClientCall()) {
+		_push([this, light, range]() { lightSetRange(_toObject(light), range); });
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetRange(light, range);
+}
+
+void RS::lightSetColor(ObjectID light, const glm::vec3 &color) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetColor, light, color);
+
+	if (_isClientCall()) {
+		_push([this, light, color]() { lightSetColor(_toObject(light), color); });
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetColor(light, color);
+}
+
+void RS::lightSetIntensity(ObjectID light, float intensity) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetIntensity, light, intensity);
+
+	if (_isClientCall()) {
+		_push([this, light, intensity]() {
+			lightSetIntensity(_toObject(light), intensity);
+		});
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetIntensity(light, intensity);
+}
+
+void RS::lightSetDrawDistance(ObjectID light, float distance) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetDrawDistance, light, distance);
+
+	if (_isClientCall()) {
+		_push([this, light, distance]() {
+			lightSetDrawDistance(_toObject(light), distance);
+		});
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetDrawDistance(light, distance);
+}
+
+void RS::lightSetShadow(ObjectID light, bool castsShadow) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetShadow, light, castsShadow);
+
+	if (_isClientCall()) {
+		_push([this, light, castsShadow]() {
+			lightSetShadow(_toObject(light), castsShadow);
+		});
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetShadow(light, castsShadow);
+}
+
+void RS::lightSetBaked(ObjectID light, bool isBaked) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightSetBaked, light, isBaked);
+
+	if (_isClientCall()) {
+		_push([this, light, isBaked]() { lightSetBaked(_toObject(light), isBaked); });
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightSetBaked(light, isBaked);
+}
+
+void RS::lightFree(ObjectID light) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightFree, light);
+
+	if (_isClientCall()) {
+		_push([this, light]() {
+			lightFree(_toObject(light));
+			_clientObjects.erase(light);
+		});
+		return;
+	}
+
+	RD::getSingleton().getLightStorage().lightFree(light);
+}
+
+ObjectID RS::textureCreate(const std::shared_ptr<Image> image) {
+	ObjectID texture = _textureCreate(image);
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::TextureCreate, texture, image);
+
+	return texture;
+}
+
+ObjectID RS::_textureCreate(const std::shared_ptr<Image> image) {
+	_markChanged();
+
+	if (image == nullptr)
+		return NULL_HANDLE;
+
+	// unsupported format leaves id without texture, materials fall back for it
+	if (_isClientCall()) {
+		ObjectID id = _nextClientId++;
+		_push([this, id, image]() { _clientObjects[id] = _textureCreate(image); });
+		return id;
+	}
+
+	Image::Format format = image->getFormat();
+
+	// material falls back, like for image which failed to load
+	if (!RD::getSingleton().isTextureFormatSupported(format)) {
+		std::cout << "ERROR: Texture format " << Image::getFormatName(format) << " is unsupported!"
+				  << std::endl;
+		return NULL_HANDLE;
+	}
+
+	TextureRD _texture = {};
+
+	// upload waits for first visible instance using texture
+	if (_useLazyTextures) {
+		_texture.source = image;
+		_texture.isPending = true;
+	} else {
+		_texture = _createTexture(image);
+	}
+
+	// loader thread records upload with its own pools, only bookkeeping is left to owner
+	if (_isBackgroundCall()) {
+		ObjectID texture = _textures.reserve();
+
+		if (!_texture.isPending)
+			_setTextureUserData(_texture, texture);
+
+		// submitted before owner thread can adopt texture and draw with it
+		RD::getSingleton().getUploadManager().flush();
+		_push([this, texture, _texture]() { _textureInsert(_texture, texture); });
+
+		return texture;
+	}
+
+	ObjectID texture = _textureInsert(_texture);
+
+	if (!_texture.isPending)
+		_setTextureUserData(_texture, texture);
+
+	return texture;
+}
+
+TextureRD RS::_createTexture(const std::shared_ptr<Image> image) {
+	// pre-built levels let texture start at its tail, streaming brings finer ones in
+	if (image->getMipLevels() <= 1)
+		return RD::getSingleton().textureCreate(image);
+
+	uint32_t tail = _getTailLevel(*image);
+
+	TextureRD texture = RD::getSingleton().textureCreate(image, tail);
+	texture.source = image;
+	texture.residentLevel = tail;
+	texture.requestedLevel = tail;
+
+	return texture;
+}
+
+ObjectID RS::_textureInsert(const TextureRD &_texture, ObjectID reserved) {
+	ObjectID texture = reserved != NULL_HANDLE ? _textures.insertReserved(reserved, _texture)
+											   : _textures.insert(_texture);
+
+	if (_texture.source != nullptr && !_texture.isPending)
+		_streamedTextures.push_back(texture);
+
+	return texture;
+}
+
+void RS::textureUpdate(ObjectID texture, const std::shared_ptr<Image> image) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::TextureUpdate, texture, image);
+
+	if (_isClientCall()) {
+		_push([this, texture, image]() { textureUpdate(_toObject(texture), image); });
+		return;
+	}
+
+	_adoptBackground();
+
+	CHECK_IF_VALID(_textures, texture, "Texture");
+
+	if (image == nullptr)
+		return;
+
+	Image::Format format = image->getFormat();
+
+	if (!RD::getSingleton().isTextureFormatSupported(format)) {
+		std::cout << "ERROR: Texture format " << Image::getFormatName(format) << " is unsupported!"
+				  << std::endl;
+		return;
+	}
+
+	// pass moves old image into place once it ends, update follows it
+	if (_isTextureMoving(texture)) {
+		_pendingTextureUpdates.push_back({ texture, image });
+		return;
+	}
+
+	TextureRD old = _textures[texture];
+
+	// texture not seen yet keeps waiting, with new source
+	if (old.isPending) {
+		_textures[texture].source = image;
+		return;
+	}
+
+	TextureRD updated = _createTexture(image);
+
+	// frames in flight may still sample old image
+	RD::getSingleton().destroyDeferred([old] { RD::getSingleton().textureDestroy(old); });
+	_textureDestroyFrame = _frameCount;
+
+	_textures[texture] = updated;
+	_setTextureUserData(updated, texture);
+
+	auto it = std::find(_streamedTextures.begin(), _streamedTextures.end(), texture);
+	bool isStreamed = it != _streamedTextures.end();
+
+	if (updated.source != nullptr && !isStreamed) {
+		_streamedTextures.push_back(texture);
+	} else if (updated.source == nullptr && isStreamed) {
+		*it = _streamedTextures.back();
+		_streamedTextures.pop_back();
+	}
+
+	_updateTextureMaterials(texture);
+}
+
+void RS::textureFree(ObjectID texture) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::TextureFree, texture);
+
+	if (_isClientCall()) {
+		_push([this, texture]() {
+			textureFree(_toObject(texture));
+			_clientObjects.erase(texture);
+		});
+		return;
+	}
+
+	_adoptBackground();
+	_textureFree(texture);
+}
+
+void RS::_textureFree(ObjectID texture) {
+	CHECK_IF_VALID(_textures, texture, "Texture");
+
+	if (_isTextureMoving(texture)) {
+		_pendingTextureFrees.push_back(texture);
+		return;
+	}
+
+	TextureRD _texture = _textures[texture];
+
+	// queue skips ids freed since they were queued
+	if (!_texture.isPending) {
+		RD::getSingleton().destroyDeferred(
+				[_texture] { RD::getSingleton().textureDestroy(_texture); });
+		_textureDestroyFrame = _frameCount;
+	}
+
+	_textures.free(texture);
+	_uploadScheduler.cancel(UploadKind::TextureCreate, texture);
+	_uploadScheduler.cancel(UploadKind::TextureLevels, texture);
+
+	auto it = std::find(_streamedTextures.begin(), _streamedTextures.end(), texture);
+
+	if (it != _streamedTextures.end()) {
+		*it = _streamedTextures.back();
+		_streamedTextures.pop_back();
+	}
+}
+
+void RS::_requestTextureLevels(
+		const MeshInstanceRD &meshInstance, float pixelScale, float distance, bool isVisible) {
+	const MeshRD &mesh = _meshes[meshInstance.mesh];
+
+	// texture is taken to span mesh once, its level is one with a texel per covered pixel
+	glm::vec3 extent = mesh.aabb.extent();
+	float pixels = 2.0f * glm::max(glm::max(extent.x, extent.y), extent.z) * pixelScale;
+	pixels = glm::max(pixels, 1.0f);
+
+	float priority = UploadScheduler::getPriority(pixels, distance, isVisible);
+
+	const PrimitiveRD *pPrimitives = _getPrimitives(mesh);
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const PrimitiveRD &primitive = pPrimitives[i];
+
+		if (!_materials.has(primitive.material))
+			continue;
+
+		const MaterialRD &material = _materials[primitive.material];
+		ObjectID textures[MATERIAL_TEXTURE_COUNT] = {
+			material.albedo,
+			material.normal,
+			material.metallicRoughness,
+			material.lightmap,
+		};
+
+		for (ObjectID id : textures) {
+			if (!_textures.has(id))
+				continue;
+
+			_queueTexture(id, priority);
+
+			TextureRD &texture = _textures[id];
+
+			if (texture.source == nullptr)
+				continue;
+
+			uint32_t tail = _getTailLevel(*texture.source);
+			uint32_t size = std::max(texture.source->getWidth(), texture.source->getHeight());
+
+			float level = glm::floor(glm::log2(static_cast<float>(size) / pixels));
+			uint32_t requested =
+					static_cast<uint32_t>(glm::clamp(level, 0.0f, static_cast<float>(tail)));
+
+			// first request this frame replaces older ones
+			if (texture.requestFrame != _frameCount || requested < texture.requestedLevel)
+				texture.requestedLevel = requested;
+
+			if (texture.requestFrame != _frameCount || priority > texture.requestPriority)
+				texture.requestPriority = priority;
+
+			texture.requestFrame = _frameCount;
+		}
+	}
+}
+
+uint32_t RS::_getStreamingTarget(const TextureRD &texture) const {
+	if (texture.requestFrame == 0 || _frameCount - texture.requestFrame > TEXTURE_REQUEST_FRAMES)
+		return _getTailLevel(*texture.source);
+
+	return texture.requestedLevel;
+}
+
+void RS::_setResidentLevel(ObjectID texture, uint32_t level) {
+	TextureRD &_texture = _textures[texture];
+
+	TextureRD streamed = RD::getSingleton().textureCreate(_texture.source, level);
+	streamed.source = _texture.source;
+	streamed.residentLevel = level;
+	streamed.requestedLevel = _texture.requestedLevel;
+	streamed.requestFrame = _texture.requestFrame;
+
+	// frames in flight may still sample old image
+	TextureRD old = _texture;
+	RD::getSingleton().destroyDeferred([old] { RD::getSingleton().textureDestroy(old); });
+	_textureDestroyFrame = _frameCount;
+
+	_texture = streamed;
+	_setTextureUserData(streamed, texture);
+
+	_updateTextureMaterials(texture);
+}
+
+void RS::_updateTextureMaterials(ObjectID texture) {
+	// sets holding old image stay with materials in flight, new ones are written for the rest
+	for (auto it = _textureSetIds.begin(); it != _textureSetIds.end();) {
+		const std::array<ObjectID, MATERIAL_TEXTURE_COUNT> &ids = it->first;
+
+		if (std::find(ids.begin(), ids.end(), texture) != ids.end())
+			it = _textureSetIds.erase(it);
+		else
+			it++;
+	}
+
+	for (MaterialRD &material : _materials) {
+		if (material.albedo != texture && material.normal != texture &&
+				material.metallicRoughness != texture && material.lightmap != texture)
+			continue;
+
+		MaterialInfo info = {};
+		info.albedo = material.albedo;
+		info.normal = material.normal;
+		info.metallicRoughness = material.metallicRoughness;
+		info.lightmap = material.lightmap;
+		info.albedoFactor = material.albedoFactor;
+		info.emissiveFactor = material.emissiveFactor;
+		info.metallicFactor = material.metallicFactor;
+		info.roughnessFactor = material.roughnessFactor;
+		info.albedoRect = material.albedoRect;
+		info.normalRect = material.normalRect;
+		info.metallicRoughnessRect = material.metallicRoughnessRect;
+		info.alphaTest = material.alphaTest;
+
+		_destroyMaterialDeferred(material);
+		material = _createMaterial(info);
+	}
+
+	_isQueueDirty = true;
+}
+
+uint64_t RS::_evictTextures(uint64_t size, bool dropRequested) {
+	std::vector<ObjectID> candidates;
+
+	for (ObjectID texture : _streamedTextures) {
+		const TextureRD &_texture = _textures[texture];
+
+		if (_getStreamingTarget(_texture) > _texture.residentLevel)
+			candidates.push_back(texture);
+		else if (dropRequested && _texture.residentLevel < _getTailLevel(*_texture.source))
+			candidates.push_back(texture);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [this](ObjectID a, ObjectID b) {
+		return _textures[a].requestFrame < _textures[b].requestFrame;
+	});
+
+	uint64_t freed = 0;
+
+	for (ObjectID texture : candidates) {
+		if (freed >= size)
+			break;
+
+		const TextureRD &_texture = _textures[texture];
+		uint32_t target = _getStreamingTarget(_texture);
+
+		// requested texture loses its finest level only, it is promoted back once budget allows
+		if (target <= _texture.residentLevel)
+			target = _texture.residentLevel + 1;
+
+		freed += _getResidentSize(*_texture.source, _texture.residentLevel) -
+				 _getResidentSize(*_texture.source, target);
+
+		_setResidentLevel(texture, target);
+	}
+
+	return freed;
+}
+
+void RS::_setMeshResident(ObjectID mesh, StreamedMeshRD &streamed, bool isResident) {
+	streamed.isResident = isResident;
+
+	// impostor was captured after mesh was packed, it is kept over residency changes
+	ObjectID impostor = _meshes[mesh].impostor;
+
+	// upload offsets primitives in place, source stays relative to mesh
+	if (isResident) {
+		PackedMesh packed = streamed.source;
+		_meshes[mesh] = _meshUpload(packed);
+		_meshes[mesh].impostor = impostor;
+		return;
+	}
+
+	// range can not be reused while frames in flight still draw from it
+	GeometryRange geometry = _meshes[mesh].geometry;
+	RD::getSingleton().destroyDeferred(
+			[geometry] { RD::getSingleton().getGeometryArena().free(geometry); });
+
+	_primitivesFree(_meshes[mesh]);
+	_meshes[mesh] = _meshEvicted(streamed.source);
+	_meshes[mesh].impostor = impostor;
+}
+
+void RS::_streamGeometry(const glm::vec3 &viewPosition, float lodScale) {
+	_staleMeshes.clear();
+	_evictedMeshCount = 0;
+	_geometryResidentSize = 0;
+
+	if (_streamedMeshes.empty())
+		return;
+
+	// camera is expected to keep its velocity, meshes it heads for are asked for early, jumps
+	// like that of first frame are no velocity
+	glm::vec3 ahead = (viewPosition - _streamingPosition) * GEOMETRY_STREAMING_LOOKAHEAD_FRAMES;
+	_streamingPosition = viewPosition;
+
+	if (glm::length(ahead) > GEOMETRY_STREAMING_RADIUS * 4.0f)
+		ahead = glm::vec3(0.0f);
+
+	glm::vec3 aheadPosition = viewPosition + ahead;
+
+	_treeResults.clear();
+	_instanceTree.querySphere(viewPosition, GEOMETRY_STREAMING_RADIUS, _treeResults);
+	_instanceTree.querySphere(aheadPosition, GEOMETRY_STREAMING_RADIUS, _treeResults);
+
+	for (uint64_t id : _treeResults) {
+		const MeshInstanceRD &meshInstance = _meshInstances[id];
+		auto it = _streamedMeshes.find(meshInstance.mesh);
+
+		if (it == _streamedMeshes.end())
+			continue;
+
+		StreamedMeshRD &streamed = it->second;
+		float distance = std::min(meshInstance.aabb.distance(viewPosition),
+				meshInstance.aabb.distance(aheadPosition));
+
+		// evicted meshes are culled as usual, ones their instances were seen in last frame come
+		// before those only near camera
+		glm::vec3 extent = meshInstance.aabb.extent();
+		float pixels = 2.0f * glm::max(glm::max(extent.x, extent.y), extent.z) * lodScale /
+				glm::max(distance, 1e-6f);
+		bool isVisible = meshInstance.visibleFrame + 1 >= _frameCount;
+		float priority = UploadScheduler::getPriority(pixels, distance, isVisible);
+
+		if (streamed.requestFrame != _frameCount) {
+			streamed.requestDistance = distance;
+			streamed.requestPriority = priority;
+		}
+
+		streamed.requestFrame = _frameCount;
+		streamed.requestDistance = std::min(streamed.requestDistance, distance);
+		streamed.requestPriority = std::max(streamed.requestPriority, priority);
+	}
+
+	for (auto &[mesh, streamed] : _streamedMeshes) {
+		if (streamed.isResident) {
+			_geometryResidentSize += streamed.size;
+
+			if (_frameCount - streamed.requestFrame > GEOMETRY_REQUEST_FRAMES)
+				_staleMeshes.push_back(mesh);
+		} else if (streamed.requestFrame == _frameCount) {
+			_uploadScheduler.request(UploadKind::Geometry, mesh, streamed.size,
+					streamed.requestPriority, _frameCount);
+		}
+	}
+
+	// mesh nobody came near for longest goes first
+	std::sort(_staleMeshes.begin(), _staleMeshes.end(), [this](ObjectID a, ObjectID b) {
+		return _streamedMeshes[a].requestFrame < _streamedMeshes[b].requestFrame;
+	});
+}
+
+bool RS::_loadMesh(ObjectID mesh) {
+	auto it = _streamedMeshes.find(mesh);
+
+	// freed, made resident for good or loaded since it asked
+	if (it == _streamedMeshes.end() || it->second.isResident)
+		return false;
+
+	StreamedMeshRD &streamed = it->second;
+
+	for (; _geometryResidentSize + streamed.size > GEOMETRY_STREAMING_BUDGET &&
+			_evictedMeshCount < _staleMeshes.size();
+			_evictedMeshCount++) {
+		ObjectID evicted = _staleMeshes[_evictedMeshCount];
+		StreamedMeshRD &_evicted = _streamedMeshes[evicted];
+
+		_setMeshResident(evicted, _evicted, false);
+		_geometryResidentSize -= _evicted.size;
+		_changedMeshes.push_back(evicted);
+	}
+
+	// everything resident is still asked for
+	if (_geometryResidentSize + streamed.size > GEOMETRY_STREAMING_BUDGET)
+		return false;
+
+	_setMeshResident(mesh, streamed, true);
+	_geometryResidentSize += streamed.size;
+	_changedMeshes.push_back(mesh);
+
+	return true;
+}
+
+void RS::_streamTextures() {
+	_canPromoteTextures = false;
+
+	// images of moving textures are owned by defragmentation pass
+	if (_defragmentationPassFrame != 0)
+		return;
+
+	ScratchVector<ObjectID> promotions(_scratch);
+	uint64_t residentSize = 0;
+
+	for (ObjectID texture : _streamedTextures) {
+		const TextureRD &_texture = _textures[texture];
+		residentSize += _getResidentSize(*_texture.source, _texture.residentLevel);
+
+		if (_getStreamingTarget(_texture) < _texture.residentLevel)
+			promotions.push_back(texture);
+	}
+
+	// streaming gets what device budget leaves after everything else, on small cards it shrinks
+	// below fixed budget
+	MemoryBudget memory = RD::getSingleton().getMemoryBudget();
+	uint64_t limit = static_cast<uint64_t>(memory.budget * MEMORY_BUDGET_USAGE);
+	uint64_t otherSize = memory.usage > residentSize ? memory.usage - residentSize : 0;
+
+	uint64_t budget = limit > otherSize ? limit - otherSize : 0;
+	budget = std::min(budget, TEXTURE_STREAMING_BUDGET);
+
+	// device usage drops only once frames in flight release evicted images, eviction waits for
+	// that instead of dropping more
+	if (residentSize > budget) {
+		if (_frameCount - _evictionFrame <= RD::getSingleton().getFramesInFlight())
+			return;
+
+		uint64_t freed = _evictTextures(residentSize - budget, false);
+
+		if (residentSize - freed > budget)
+			_evictTextures(residentSize - freed - budget, true);
+
+		_evictionFrame = _frameCount;
+		return;
+	}
+
+	_textureResidentSize = residentSize;
+	_textureStreamingBudget = budget;
+	_canPromoteTextures = true;
+
+	// ranked by what instances asking for levels covered last frame
+	for (ObjectID texture : promotions) {
+		const TextureRD &_texture = _textures[texture];
+		uint64_t size = _getResidentSize(*_texture.source, _getStreamingTarget(_texture));
+
+		_uploadScheduler.request(UploadKind::TextureLevels, texture, size,
+				_texture.requestPriority, _frameCount);
+	}
+}
+
+bool RS::_promoteTexture(ObjectID texture) {
+	if (!_canPromoteTextures || !_textures.has(texture) || _textures[texture].isPending)
+		return false;
+
+	const TextureRD &_texture = _textures[texture];
+
+	if (_texture.source == nullptr)
+		return false;
+
+	uint32_t target = _getStreamingTarget(_texture);
+
+	if (target >= _texture.residentLevel)
+		return false;
+
+	uint64_t size = _getResidentSize(*_texture.source, target);
+	uint64_t growth = size - _getResidentSize(*_texture.source, _texture.residentLevel);
+
+	if (_textureResidentSize + growth > _textureStreamingBudget)
+		_textureResidentSize -=
+				_evictTextures(_textureResidentSize + growth - _textureStreamingBudget, false);
+
+	// everything resident is still asked for
+	if (_textureResidentSize + growth > _textureStreamingBudget)
+		return false;
+
+	_setResidentLevel(texture, target);
+	_textureResidentSize += growth;
+
+	return true;
+}
+
+bool RS::_createQueuedTexture(ObjectID texture) {
+	// images of moving textures are owned by defragmentation pass, freed or updated into a
+	// texture of its own since it asked
+	if (_defragmentationPassFrame != 0 || !_textures.has(texture) ||
+			!_textures[texture].isPending)
+		return false;
+
+	const TextureRD &pending = _textures[texture];
+	std::shared_ptr<Image> source = pending.source;
+
+	// streaming brings in level instance asked for next frames
+	TextureRD created = _createTexture(source);
+	created.requestedLevel = pending.requestedLevel;
+	created.requestFrame = pending.requestFrame;
+	created.requestPriority = pending.requestPriority;
+
+	_textures[texture] = created;
+	_setTextureUserData(created, texture);
+
+	// texture uploaded whole drops its source with last reference to it
+	if (created.source != nullptr)
+		_streamedTextures.push_back(texture);
+
+	// created tail ends up in budget promotions of this frame check
+	if (created.source != nullptr && _canPromoteTextures)
+		_textureResidentSize += _getResidentSize(*source, created.residentLevel);
+
+	_updateTextureMaterials(texture);
+
+	return true;
+}
+
+void RS::_queueTexture(ObjectID texture, float priority) {
+	if (!_textures.has(texture))
+		return;
+
+	const TextureRD &_texture = _textures[texture];
+
+	if (!_texture.isPending)
+		return;
+
+	// first image holds levels from tail on, or every level without pre-built ones
+	const Image &source = *_texture.source;
+	uint32_t level = source.getMipLevels() > 1 ? _getTailLevel(source) : 0;
+
+	_uploadScheduler.request(UploadKind::TextureCreate, texture,
+			_getResidentSize(source, level), priority, _frameCount);
+}
+
+void RS::_drainUploads() {
+	// texture requests come from culling of last frame, geometry ones from this one
+	_drainedUploads.clear();
+	_uploadScheduler.drain(_frameCount - 1, STREAMING_UPLOAD_BUDGET, _drainedUploads);
+
+	_changedMeshes.clear();
+	uint64_t uploadSize = 0;
+
+	for (const UploadRequest &request : _drainedUploads) {
+		bool isUploaded = false;
+
+		switch (request.kind) {
+			case UploadKind::TextureCreate:
+				isUploaded = _createQueuedTexture(request.id);
+				break;
+			case UploadKind::TextureLevels:
+				isUploaded = _promoteTexture(request.id);
+				break;
+			case UploadKind::Geometry:
+				isUploaded = _loadMesh(request.id);
+				break;
+			default:
+				break;
+		}
+
+		if (isUploaded)
+			uploadSize += request.size;
+	}
+
+	// requests past budget of frame follow next ones
+	_isStreaming = uploadSize > 0 || _uploadScheduler.getRequestCount() > 0;
+
+	if (_changedMeshes.empty())
+		return;
+
+	_isQueueDirty = true;
+	_isShadowQueueDirty = true;
+
+	std::sort(_changedMeshes.begin(), _changedMeshes.end());
+	LightStorage &lightStorage = RD::getSingleton().getLightStorage();
+
+	// shadows cached without instances of loaded meshes, or with those of evicted ones
+	for (const MeshInstanceRD &meshInstance : _meshInstances) {
+		if (std::binary_search(_changedMeshes.begin(), _changedMeshes.end(), meshInstance.mesh))
+			lightStorage.shadowInvalidate(meshInstance.aabb);
+	}
+}
+
+const TextureRD &RS::_getBoundTexture(ObjectID texture, const TextureRD &fallback) const {
+	if (!_textures.has(texture) || _textures[texture].isPending)
+		return fallback;
+
+	return _textures[texture];
+}
+
+MaterialRD RS::_createMaterial(const MaterialInfo &info) {
+	TextureRD albedo = _getBoundTexture(info.albedo, _albedoFallback);
+	TextureRD normal = _getBoundTexture(info.normal, _normalFallback);
+	TextureRD metallicRoughness =
+			_getBoundTexture(info.metallicRoughness, _metallicRoughnessFallback);
+	// never sampled without lightmap, any valid texture keeps binding written
+	TextureRD lightmap = _getBoundTexture(info.lightmap, _albedoFallback);
+
+	MaterialRD material = {};
+	material.albedo = info.albedo;
+	material.normal = info.normal;
+	material.metallicRoughness = info.metallicRoughness;
+	material.lightmap = info.lightmap;
+	material.albedoFactor = info.albedoFactor;
+	material.emissiveFactor = info.emissiveFactor;
+	material.metallicFactor = info.metallicFactor;
+	material.roughnessFactor = info.roughnessFactor;
+	material.albedoRect = info.albedoRect;
+	material.normalRect = info.normalRect;
+	material.metallicRoughnessRect = info.metallicRoughnessRect;
+	material.alphaTest = info.alphaTest;
+
+	if (_textures.has(info.albedo))
+		material.permutation |= MATERIAL_ALBEDO_MAP_BIT;
+
+	if (_textures.has(info.normal))
+		material.permutation |= MATERIAL_NORMAL_MAP_BIT;
+
+	if (_textures.has(info.normal) && info.deriveTangents)
+		material.permutation |= MATERIAL_DERIVED_TANGENTS_BIT;
+
+	if (_textures.has(info.metallicRoughness))
+		material.permutation |= MATERIAL_METALLIC_ROUGHNESS_MAP_BIT;
+
+	// see MATERIAL_ALPHA_TEST_BIT
+	if (info.alphaTest && _textures.has(info.albedo) && !_textures.has(info.normal))
+		material.permutation |= MATERIAL_ALPHA_TEST_BIT;
+
+	RD &rd = RD::getSingleton();
+
+	MaterialStorage::MaterialData data = {};
+	data.albedoFactor = info.albedoFactor;
+	data.emissiveFactor = info.emissiveFactor;
+	data.metallicFactor = info.metallicFactor;
+	data.roughnessFactor = info.roughnessFactor;
+	data.albedo = albedo.bindlessIndex;
+	data.normal = normal.bindlessIndex;
+	data.metallicRoughness = metallicRoughness.bindlessIndex;
+	data.albedoRect = info.albedoRect;
+	data.normalRect = info.normalRect;
+	data.metallicRoughnessRect = info.metallicRoughnessRect;
+	data.lightmap = lightmap.bindlessIndex;
+	// pending lightmap would light with white fallback
+	data.hasLightmap = _textures.has(info.lightmap) && !_textures[info.lightmap].isPending;
+
+	material.index = rd.getMaterialStorage().materialAdd(data);
+
+	if (rd.isBindlessEnabled())
+		return material;
+
+	// fallbacks are keyed as 0, freed textures fall back too
+	std::array<ObjectID, MATERIAL_TEXTURE_COUNT> ids = {
+		_textures.has(info.albedo) ? info.albedo : 0,
+		_textures.has(info.normal) ? info.normal : 0,
+		_textures.has(info.metallicRoughness) ? info.metallicRoughness : 0,
+		_textures.has(info.lightmap) ? info.lightmap : 0,
+	};
+
+	material.textureSetId =
+			_acquireTextureSet({ albedo, normal, metallicRoughness, lightmap }, ids);
+
+	return material;
+}
+
+const MaterialRD &RS::_getMaterial(ObjectID material) const {
+	static const MaterialRD DEFAULT_MATERIAL = {};
+
+	return _materials.has(material) ? _materials[material] : DEFAULT_MATERIAL;
+}
+
+void RS::_destroyMaterialDeferred(const MaterialRD &material) {
+	RD::getSingleton().destroyDeferred([this, material] {
+		RD &rd = RD::getSingleton();
+		rd.getMaterialStorage().materialRemove(material.index);
+
+		if (rd.isBindlessEnabled())
+			return;
+
+		_releaseTextureSet(material.textureSetId);
+	});
+}
+
+ObjectID RS::_acquireTextureSet(const std::array<TextureRD, MATERIAL_TEXTURE_COUNT> &textures,
+		const std::array<ObjectID, MATERIAL_TEXTURE_COUNT> &ids) {
+	auto it = _textureSetIds.find(ids);
+
+	if (it != _textureSetIds.end()) {
+		_textureSets[it->second].materialCount++;
+		return it->second;
+	}
+
+	RD &rd = RD::getSingleton();
+
+	std::array<vk::DescriptorImageInfo, MATERIAL_TEXTURE_COUNT> imageInfos = {};
+
+	for (uint32_t i = 0; i < imageInfos.size(); i++) {
+		imageInfos[i].setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		imageInfos[i].setImageView(textures[i].imageView);
+		imageInfos[i].setSampler(textures[i].sampler);
+	}
+
+	TextureSetRD textureSet = {};
+	textureSet.imageInfos = imageInfos;
+	textureSet.textures = ids;
+	textureSet.materialCount = 1;
+
+	// pushed infos need no set
+	if (!rd.isPushDescriptorEnabled()) {
+		DescriptorAllocator::Allocation allocation =
+				rd.getTextureSetAllocator().allocate(rd.getTextureLayout());
+
+		rd.getDevice().updateDescriptorSetWithTemplate(
+				allocation.set, rd.getTextureUpdateTemplate(), imageInfos.data());
+
+		textureSet.set = allocation.set;
+		textureSet.pool = allocation.pool;
+	}
+
+	ObjectID id = _textureSets.insert(textureSet);
+	_textureSetIds[ids] = id;
+
+	return id;
+}
+
+void RS::_releaseTextureSet(ObjectID textureSet) {
+	TextureSetRD &_textureSet = _textureSets[textureSet];
+
+	if (--_textureSet.materialCount > 0)
+		return;
+
+	// set written before one of its textures was swapped is no longer keyed
+	auto it = _textureSetIds.find(_textureSet.textures);
+
+	if (it != _textureSetIds.end() && it->second == textureSet)
+		_textureSetIds.erase(it);
+
+	// materials holding it were destroyed deferred, no frame reads it anymore
+	if (_textureSet.set)
+		RD::getSingleton().getTextureSetAllocator().free({ _textureSet.set, _textureSet.pool });
+
+	_textureSets.free(textureSet);
+}
+
+ObjectID RS::materialCreate(const MaterialInfo &info) {
+	ObjectID material = _materialCreate(info);
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MaterialCreate, material, info);
+
+	return material;
+}
+
+ObjectID RS::_materialCreate(const MaterialInfo &info) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		ObjectID id = _nextClientId++;
+		_push([this, id, info]() {
+			_clientObjects[id] = _materialCreate(_toObjects(info));
+		});
+		return id;
+	}
+
+	_adoptBackground();
+	_isQueueDirty = true;
+
+	return _materials.insert(_createMaterial(info));
+}
+
+void RS::materialUpdate(ObjectID material, const MaterialInfo &info) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MaterialUpdate, material, info);
+
+	if (_isClientCall()) {
+		_push([this, material, info]() {
+			materialUpdate(_toObject(material), _toObjects(info));
+		});
+		return;
+	}
+
+	_adoptBackground();
+
+	CHECK_IF_VALID(_materials, material, "Material");
+
+	_isQueueDirty = true;
+
+	// frames in flight may still read old descriptors, they go once those frames finish
+	_destroyMaterialDeferred(_materials[material]);
+	_materials[material] = _createMaterial(info);
+}
+
+void RS::materialFree(ObjectID material) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::MaterialFree, material);
+
+	if (_isClientCall()) {
+		_push([this, material]() {
+			materialFree(_toObject(material));
+			_clientObjects.erase(material);
+		});
+		return;
+	}
+
+	_isQueueDirty = true;
+
+	CHECK_IF_VALID(_materials, material, "Material");
+
+	_destroyMaterialDeferred(_materials[material]);
+	_materials.free(material);
+}
+
+ObjectID RS::particleEmitterCreate() {
+	ObjectID emitter = _particleEmitterCreate();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ParticleEmitterCreate, emitter);
+
+	return emitter;
+}
+
+ObjectID RS::_particleEmitterCreate() {
+	_markChanged();
+
+	if (_isClientCall()) {
+		ObjectID id = _nextClientId++;
+		_push([this, id]() { _clientObjects[id] = _particleEmitterCreate(); });
+		return id;
+	}
+
+	return _particleEmitters.insert({});
+}
+
+void RS::particleEmitterSetMesh(ObjectID emitter, ObjectID mesh) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ParticleEmitterSetMesh, emitter, mesh);
+
+	if (_isClientCall()) {
+		_push([this, emitter, mesh]() {
+			particleEmitterSetMesh(_toObject(emitter), _toObject(mesh));
+		});
+		return;
+	}
+
+	_adoptBackground();
+
+	CHECK_IF_VALID(_particleEmitters, emitter, "ParticleEmitter");
+	CHECK_IF_VALID(_meshes, mesh, "Mesh");
+
+	_particleEmitters[emitter].mesh = mesh;
+	_allocateParticles(emitter, _particleEmitters[emitter]);
+}
+
+void RS::particleEmitterSetTransform(ObjectID emitter, const glm::mat4 &transform) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ParticleEmitterSetTransform, emitter, transform);
+
+	if (_isClientCall()) {
+		_push([this, emitter, transform]() {
+			particleEmitterSetTransform(_toObject(emitter), transform);
+		});
+		return;
+	}
+
+	CHECK_IF_VALID(_particleEmitters, emitter, "ParticleEmitter");
+
+	_particleEmitters[emitter].transform = transform;
+}
+
+void RS::particleEmitterSetInfo(ObjectID emitter, const ParticleEmitterInfo &info) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ParticleEmitterSetInfo, emitter, info);
+
+	if (_isClientCall()) {
+		_push([this, emitter, info]() { particleEmitterSetInfo(_toObject(emitter), info); });
+		return;
+	}
+
+	CHECK_IF_VALID(_particleEmitters, emitter, "ParticleEmitter");
+
+	ParticleEmitterRD &particleEmitter = _particleEmitters[emitter];
+	bool isResized = info.capacity != particleEmitter.info.capacity;
+
+	particleEmitter.info = info;
+
+	if (isResized)
+		_allocateParticles(emitter, particleEmitter);
+}
+
+void RS::particleEmitterFree(ObjectID emitter) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ParticleEmitterFree, emitter);
+
+	if (_isClientCall()) {
+		_push([this, emitter]() {
+			particleEmitterFree(_toObject(emitter));
+			_clientObjects.erase(emitter);
+		});
+		return;
+	}
+
+	CHECK_IF_VALID(_particleEmitters, emitter, "ParticleEmitter");
+
+	RD::getSingleton().getParticleStorage().free(_particleEmitters[emitter].range);
+	_particleEmitters.free(emitter);
+}
+
+void RS::setExposure(float exposure) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetExposure, exposure);
+
+	if (_isClientCall()) {
+		_push([this, exposure]() { setExposure(exposure); });
+		return;
+	}
+
+	RD::getSingleton().setExposure(exposure);
+}
+
+void RS::setAutoExposure(bool isEnabled) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetAutoExposure, isEnabled);
+
+	if (_isClientCall()) {
+		_push([this, isEnabled]() { setAutoExposure(isEnabled); });
+		return;
+	}
+
+	RD::getSingleton().setAutoExposure(isEnabled);
+}
+
+void RS::setSkyLod(float lod) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetSkyLod, lod);
+
+	if (_isClientCall()) {
+		_push([this, lod]() { setSkyLod(lod); });
+		return;
+	}
+
+	RD::getSingleton().setSkyLod(lod);
+}
+
+void RS::setWhite(float white) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetWhite, white);
+
+	if (_isClientCall()) {
+		_push([this, white]() { setWhite(white); });
+		return;
+	}
+
+	RD::getSingleton().setWhite(white);
+}
+
+void RS::setTonemapLook(TonemapLook look) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetTonemapLook, look);
+
+	if (_isClientCall()) {
+		_push([this, look]() { setTonemapLook(look); });
+		return;
+	}
+
+	RD::getSingleton().setTonemapLook(look);
+}
+
+void RS::setTonemapLut(bool isEnabled) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetTonemapLut, isEnabled);
+
+	if (_isClientCall()) {
+		_push([this, isEnabled]() { setTonemapLut(isEnabled); });
+		return;
+	}
+
+	RD::getSingleton().setTonemapLut(isEnabled);
+}
+
+void RS::setUpscaleFilter(UpscaleFilter filter) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetUpscaleFilter, filter);
+
+	if (_isClientCall()) {
+		_push([this, filter]() { setUpscaleFilter(filter); });
+		return;
+	}
+
+	RD::getSingleton().setUpscaleFilter(filter);
+}
+
+void RS::setDebugView(DebugView view) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetDebugView, view);
+
+	if (_isClientCall()) {
+		_push([this, view]() { setDebugView(view); });
+		return;
+	}
+
+	RD::getSingleton().setDebugView(view);
+}
+
+DebugView RS::getDebugView() const {
+	if (_isClientCall())
+		return _getSync(&RS::getDebugView);
+
+	return RD::getSingleton().getDebugView();
+}
+
+void RS::environmentSkyUpdate(const std::shared_ptr<Image> image, bool isProgressive) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::EnvironmentSkyUpdate, image, isProgressive);
+
+	if (_isClientCall()) {
+		_push([this, image, isProgressive]() {
+			environmentSkyUpdate(image, isProgressive);
+		});
+		return;
+	}
+
+	// bake reads texels on GPU, block compressed sky would need decoding first
+	if (Image::isFormatCompressed(image->getFormat())) {
+		std::cout << "ERROR: Compressed sky is unsupported!" << std::endl;
+		return;
+	}
+
+	RD::getSingleton().environmentSkyUpdate(image, isProgressive);
+}
+
+void RS::environmentAtmosphereSet(const Atmosphere &atmosphere) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::EnvironmentAtmosphereSet, atmosphere);
+
+	if (_isClientCall()) {
+		_push([this, atmosphere]() { environmentAtmosphereSet(atmosphere); });
+		return;
+	}
+
+	RD::getSingleton().environmentAtmosphereSet(atmosphere);
+}
+
+void RS::environmentSetSpecularSampleCount(uint32_t level, uint32_t sampleCount) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::EnvironmentSetSpecularSampleCount, level, sampleCount);
+
+	if (_isClientCall()) {
+		_push([this, level, sampleCount]() {
+			environmentSetSpecularSampleCount(level, sampleCount);
+		});
+		return;
+	}
+
+	RD::getSingleton().environmentSetSpecularSampleCount(level, sampleCount);
+}
+
+void RS::environmentSetMaxCubemapSize(uint32_t size) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::EnvironmentSetMaxCubemapSize, size);
+
+	if (_isClientCall()) {
+		_push([this, size]() { environmentSetMaxCubemapSize(size); });
+		return;
+	}
+
+	RD::getSingleton().environmentSetMaxCubemapSize(size);
+}
+
+void RS::lightProbesSet(const LightProbeGrid &grid) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::LightProbesSet, grid);
+
+	if (_isClientCall()) {
+		_push([this, grid]() { lightProbesSet(grid); });
+		return;
+	}
+
+	RD::getSingleton().lightProbesSet(grid);
+}
+
+void RS::reflectionProbeSet(
+		uint32_t index, const ReflectionProbe &probe, const std::shared_ptr<Image> image) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::ReflectionProbeSet, image, index, probe);
+
+	if (_isClientCall()) {
+		_push([this, index, probe, image]() { reflectionProbeSet(index, probe, image); });
+		return;
+	}
+
+	if (index >= MAX_REFLECTION_PROBE_COUNT) {
+		std::cout << "ERROR: Reflection probe index out of range!" << std::endl;
+		return;
+	}
+
+	// baked like a sky, which reads texels on GPU
+	if (image != nullptr && Image::isFormatCompressed(image->getFormat())) {
+		std::cout << "ERROR: Compressed reflection probe is unsupported!" << std::endl;
+		return;
+	}
+
+	RD::getSingleton().reflectionProbeSet(index, probe, image);
+}
+
+void RS::terrainSet(const Terrain &terrain, const std::shared_ptr<Image> heightmap,
+		const std::shared_ptr<Image> splatmap) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::TerrainSet, heightmap, splatmap, terrain);
+
+	if (_isClientCall()) {
+		_push([this, terrain, heightmap, splatmap]() { terrainSet(terrain, heightmap, splatmap); });
+		return;
+	}
+
+	// heights are read on CPU, clip levels are streamed from them
+	if (heightmap != nullptr && Image::isFormatCompressed(heightmap->getFormat())) {
+		std::cout << "ERROR: Compressed terrain heightmap is unsupported!" << std::endl;
+		return;
+	}
+
+	if (terrain.sampleSpacing <= 0.0f || terrain.layerScale <= 0.0f) {
+		std::cout << "ERROR: Terrain spacing and layer scale have to be positive!" << std::endl;
+		return;
+	}
+
+	RD::getSingleton().terrainSet(terrain, heightmap, splatmap);
+}
+
+void RS::terrainLayerSet(uint32_t index, const std::shared_ptr<Image> image) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::TerrainLayerSet, image, index);
+
+	if (_isClientCall()) {
+		_push([this, index, image]() { terrainLayerSet(index, image); });
+		return;
+	}
+
+	if (index >= MAX_TERRAIN_LAYER_COUNT) {
+		std::cout << "ERROR: Terrain layer index out of range!" << std::endl;
+		return;
+	}
+
+	// layers share one array, texels are converted on CPU
+	if (image == nullptr || image->getWidth() != TERRAIN_LAYER_SIZE ||
+			image->getHeight() != TERRAIN_LAYER_SIZE ||
+			Image::isFormatCompressed(image->getFormat())) {
+		std::cout << "ERROR: Terrain layer has to be uncompressed square of layer size!"
+				  << std::endl;
+		return;
+	}
+
+	RD::getSingleton().terrainLayerSet(index, image);
+}
+
+void RS::cellPortalsSet(const CellPortalGraph &graph) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::CellPortalsSet, graph);
+
+	if (_isClientCall()) {
+		_push([this, graph]() { cellPortalsSet(graph); });
+		return;
+	}
+
+	_portalCuller.set(graph);
+
+	for (MeshInstanceRD &meshInstance : _meshInstances)
+		meshInstance.cell = _portalCuller.findCell(meshInstance.aabb);
+}
+
+void RS::_updateInstance(ObjectID id, MeshInstanceRD &meshInstance) {
+	if (!_meshes.has(meshInstance.mesh)) {
+		if (meshInstance.proxy != AABB_TREE_NULL)
+			_instanceTree.remove(meshInstance.proxy);
+
+		meshInstance.proxy = AABB_TREE_NULL;
+		return;
+	}
+
+	const MeshRD &mesh = _meshes[meshInstance.mesh];
+	meshInstance.aabb = mesh.aabb.transformed(meshInstance.transform);
+	meshInstance.drawTransform = packInstanceTransform(meshInstance.transform * mesh.dequantize);
+	meshInstance.normalTransform = packNormalTransform(meshInstance.transform);
+	meshInstance.cell = _portalCuller.findCell(meshInstance.aabb);
+
+	if (_meshes.has(mesh.impostor)) {
+		const MeshRD &impostor = _meshes[mesh.impostor];
+		meshInstance.impostorTransform =
+				packInstanceTransform(meshInstance.transform * impostor.dequantize);
+	}
+
+	if (meshInstance.proxy == AABB_TREE_NULL)
+		meshInstance.proxy = _instanceTree.insert(meshInstance.aabb, id);
+	else
+		_instanceTree.update(meshInstance.proxy, meshInstance.aabb);
+}
+
+void RS::_requestPose(ObjectID id, MeshInstanceRD &meshInstance) {
+	if (!_meshes.has(meshInstance.mesh) || meshInstance.joints.empty())
+		return;
+
+	const MeshRD &mesh = _meshes[meshInstance.mesh];
+
+	if (mesh.skinOffset == RangeAllocator::INVALID_OFFSET)
+		return;
+
+	// allocated outside of frame recording, arena growth replaces buffers passes bind
+	if (meshInstance.pose.vertexCount == 0) {
+		meshInstance.pose = RD::getSingleton().getGeometryArena().allocate(
+				nullptr, nullptr, mesh.geometry.vertexCount, nullptr, 0);
+	}
+
+	// shadow is cast by new pose
+	RD::getSingleton().getLightStorage().shadowInvalidate(meshInstance.aabb);
+
+	if (!meshInstance.isPoseDirty) {
+		meshInstance.isPoseDirty = true;
+		_posingInstances.push_back(id);
+	}
+}
+
+void RS::_freePose(MeshInstanceRD &meshInstance) {
+	if (meshInstance.pose.vertexCount > 0) {
+		// range can not be reused while frames in flight still draw from it
+		GeometryRange pose = meshInstance.pose;
+		RD::getSingleton().destroyDeferred(
+				[pose] { RD::getSingleton().getGeometryArena().free(pose); });
+	}
+
+	meshInstance.pose = {};
+	meshInstance.isPosed = false;
+	meshInstance.isPoseDirty = false;
+}
+
+void RS::_requestMorph(ObjectID id, MeshInstanceRD &meshInstance) {
+	if (!_meshes.has(meshInstance.mesh) || meshInstance.morphWeights.empty())
+		return;
+
+	const MeshRD &mesh = _meshes[meshInstance.mesh];
+
+	if (mesh.morphOffset == RangeAllocator::INVALID_OFFSET)
+		return;
+
+	// allocated outside of frame recording, arena growth replaces buffers passes bind
+	if (meshInstance.morph.vertexCount == 0) {
+		meshInstance.morph = RD::getSingleton().getGeometryArena().allocate(
+				nullptr, nullptr, mesh.geometry.vertexCount, nullptr, 0);
+	}
+
+	// shadow is cast by new shape
+	RD::getSingleton().getLightStorage().shadowInvalidate(meshInstance.aabb);
+
+	if (!meshInstance.isMorphDirty) {
+		meshInstance.isMorphDirty = true;
+		_morphingInstances.push_back(id);
+	}
+}
+
+void RS::_freeMorph(MeshInstanceRD &meshInstance) {
+	if (meshInstance.morph.vertexCount > 0) {
+		// range can not be reused while frames in flight still draw from it
+		GeometryRange morph = meshInstance.morph;
+		RD::getSingleton().destroyDeferred(
+				[morph] { RD::getSingleton().getGeometryArena().free(morph); });
+	}
+
+	meshInstance.morph = {};
+	meshInstance.isMorphed = false;
+	meshInstance.isMorphDirty = false;
+}
+
+void RS::_recordMorphing(vk::CommandBuffer commandBuffer) {
+	RD &rd = RD::getSingleton();
+	MorphStorage &morphStorage = rd.getMorphStorage();
+
+	size_t morphedCount = 0;
+
+	for (; morphedCount < _morphingInstances.size(); morphedCount++) {
+		ObjectID id = _morphingInstances[morphedCount];
+
+		// freed or given another mesh since it was queued
+		if (!_meshInstances.has(id) || !_meshInstances[id].isMorphDirty)
+			continue;
+
+		MeshInstanceRD &meshInstance = _meshInstances[id];
+		const MeshRD &mesh = _meshes[meshInstance.mesh];
+
+		MorphStorage::Job job = {};
+		job.sourceOffset = mesh.geometry.vertexOffset;
+		job.outputOffset = meshInstance.morph.vertexOffset;
+		job.morphOffset = mesh.morphOffset;
+		job.movedCount = mesh.morphMovedCount;
+
+		if (!morphStorage.add(rd.getFrame(), job, meshInstance.morphWeights.data(),
+					static_cast<uint32_t>(meshInstance.morphWeights.size()),
+					!meshInstance.isMorphed, mesh.geometry.vertexCount))
+			break;
+
+		meshInstance.isMorphDirty = false;
+
+		// queues of this frame are built already, next ones draw from morph
+		if (!meshInstance.isMorphed) {
+			meshInstance.isMorphed = true;
+			_isQueueDirty = true;
+			_isShadowQueueDirty = true;
+		}
+
+		// skinned right after, from new shape, pose range exists once joints were set
+		if (meshInstance.pose.vertexCount > 0 && !meshInstance.isPoseDirty) {
+			meshInstance.isPoseDirty = true;
+			_posingInstances.push_back(id);
+		}
+	}
+
+	// the rest waits for next frame
+	_morphingInstances.erase(
+			_morphingInstances.begin(), _morphingInstances.begin() + morphedCount);
+
+	morphStorage.dispatch(commandBuffer, rd.getFrame(), rd.getGeometryArena());
+}
+
+void RS::_recordSkinning(vk::CommandBuffer commandBuffer) {
+	RD &rd = RD::getSingleton();
+	SkinStorage &skinStorage = rd.getSkinStorage();
+
+	ScratchVector<glm::mat4> joints(_scratch);
+	size_t posedCount = 0;
+
+	for (; posedCount < _posingInstances.size(); posedCount++) {
+		ObjectID id = _posingInstances[posedCount];
+
+		// freed or given another mesh since it was queued
+		if (!_meshInstances.has(id) || !_meshInstances[id].isPoseDirty)
+			continue;
+
+		MeshInstanceRD &meshInstance = _meshInstances[id];
+		const MeshRD &mesh = _meshes[meshInstance.mesh];
+
+		// shader poses packed positions as they are, joints go into quantized space of mesh
+		glm::mat4 quantize = glm::inverse(mesh.dequantize);
+		joints.resize(meshInstance.joints.size());
+
+		for (size_t i = 0; i < joints.size(); i++)
+			joints[i] = quantize * meshInstance.joints[i] * mesh.dequantize;
+
+		// morphed instance is skinned from its shape
+		SkinStorage::Job job = {};
+		job.sourceOffset = meshInstance.isMorphed ? meshInstance.morph.vertexOffset
+												  : mesh.geometry.vertexOffset;
+		job.outputOffset = meshInstance.pose.vertexOffset;
+		job.vertexCount = mesh.geometry.vertexCount;
+		job.skinOffset = mesh.skinOffset;
+
+		if (!skinStorage.add(rd.getFrame(), job, joints.data(),
+					static_cast<uint32_t>(joints.size())))
+			break;
+
+		meshInstance.isPoseDirty = false;
+
+		// queues of this frame are built already, next ones draw from pose
+		if (!meshInstance.isPosed) {
+			meshInstance.isPosed = true;
+			_isQueueDirty = true;
+			_isShadowQueueDirty = true;
+		}
+	}
+
+	// the rest waits for next frame
+	_posingInstances.erase(_posingInstances.begin(), _posingInstances.begin() + posedCount);
+
+	skinStorage.dispatch(commandBuffer, rd.getFrame(), rd.getGeometryArena());
+}
+
+void RS::_allocateParticles(ObjectID id, ParticleEmitterRD &emitter) {
+	ParticleStorage &particleStorage = RD::getSingleton().getParticleStorage();
+
+	particleStorage.free(emitter.range);
+	emitter.range = {};
+	emitter.isReset = true;
+
+	if (!_meshes.has(emitter.mesh))
+		return;
+
+	uint32_t primitiveCount = _meshes[emitter.mesh].primitiveCount;
+
+	if (!particleStorage.allocate(emitter.info.capacity, primitiveCount, emitter.range)) {
+		std::cout << "ERROR: ParticleEmitter: " << id << " has no room in particle pool!"
+				  << std::endl;
+		emitter.range = {};
+	}
+}
+
+void RS::_updateParticles(vk::CommandBuffer commandBuffer) {
+	RD &rd = RD::getSingleton();
+	ParticleStorage &particleStorage = rd.getParticleStorage();
+
+	// first step only places time, storage clamps long ones
+	uint64_t time = SDL_GetTicksNS();
+	float deltaTime = _particleTime != 0 ? static_cast<float>(time - _particleTime) * 1e-9f : 0.0f;
+	deltaTime = std::min(deltaTime, MAX_PARTICLE_STEP);
+	_particleTime = time;
+
+	ScratchVector<ParticleDraw> draws(_scratch);
+	std::array<vk::DrawIndexedIndirectCommand, MAX_PARTICLE_PRIMITIVE_COUNT> commands;
+
+	for (ParticleEmitterRD &emitter : _particleEmitters) {
+		if (emitter.range.capacity == 0 || !_meshes.has(emitter.mesh))
+			continue;
+
+		const MeshRD &mesh = _meshes[emitter.mesh];
+		const PrimitiveRD *pPrimitives = _getPrimitives(mesh);
+		const ParticleEmitterInfo &info = emitter.info;
+
+		// mesh may have been updated with fewer primitives than range was allocated for
+		uint32_t primitiveCount = std::min(emitter.range.primitiveCount, mesh.primitiveCount);
+
+		if (primitiveCount == 0)
+			continue;
+
+		float emitted = emitter.emitRemainder + std::max(info.rate, 0.0f) * deltaTime;
+		uint32_t emitCount = std::min(static_cast<uint32_t>(emitted), emitter.range.capacity);
+		emitter.emitRemainder = emitted - static_cast<float>(static_cast<uint32_t>(emitted));
+
+		ParticleStorage::Job job = {};
+		job.transform = emitter.transform;
+		job.dequantize = mesh.dequantize;
+		job.velocity = glm::vec4(glm::mat3(emitter.transform) * info.velocity, info.spread);
+		job.acceleration = glm::vec4(info.acceleration, info.drag);
+		job.lifetime = info.lifetime;
+		job.sizeBegin = info.sizeBegin;
+		job.sizeEnd = info.sizeEnd;
+		job.radius = info.radius;
+		job.particleOffset = emitter.range.particleOffset;
+		job.capacity = emitter.range.capacity;
+		job.counter = emitter.range.counter;
+		job.slotOffset = emitter.range.slotOffset;
+		job.primitiveCount = primitiveCount;
+		job.emitCount = emitCount;
+		job.seed = static_cast<uint32_t>(_frameCount) * 0x9e3779b9u ^ job.counter * 0x85ebca6bu;
+		job.reset = emitter.isReset ? 1 : 0;
+
+		for (uint32_t i = 0; i < primitiveCount; i++) {
+			const PrimitiveRD &primitive = pPrimitives[i];
+			const MaterialRD &material = _getMaterial(primitive.material);
+
+			job.materials[i] = material.index;
+
+			// particles are not culled, emitter asks for textures once it draws
+			_queueTexture(material.albedo, PARTICLE_UPLOAD_PRIORITY);
+			_queueTexture(material.normal, PARTICLE_UPLOAD_PRIORITY);
+			_queueTexture(material.metallicRoughness, PARTICLE_UPLOAD_PRIORITY);
+			_queueTexture(material.lightmap, PARTICLE_UPLOAD_PRIORITY);
+
+			commands[i] = {};
+			commands[i].indexCount = primitive.indexCount;
+			commands[i].firstIndex = primitive.firstIndex;
+			commands[i].vertexOffset = static_cast<int32_t>(mesh.geometry.vertexOffset);
+		}
+
+		uint32_t firstCommand = particleStorage.add(rd.getFrame(), job, commands.data());
+
+		if (firstCommand == ParticleStorage::INVALID_COMMAND)
+			break;
+
+		emitter.isReset = false;
+
+		for (uint32_t i = 0; i < primitiveCount; i++) {
+			const MaterialRD &material = _getMaterial(pPrimitives[i].material);
+			draws.push_back({ mesh.geometry.indexType, material.permutation,
+					material.textureSetId, firstCommand + i });
+		}
+	}
+
+	// cached passes hold draws they were recorded with, counts in commands are read by GPU
+	bool isChanged = draws.size() != _particleDraws.size() ||
+			!std::equal(draws.begin(), draws.end(), _particleDraws.begin(),
+					[](const ParticleDraw &a, const ParticleDraw &b) {
+						return a.indexType == b.indexType && a.permutation == b.permutation &&
+								a.textureSetId == b.textureSetId && a.command == b.command;
+					});
+
+	if (isChanged) {
+		_particleDraws.assign(draws.begin(), draws.end());
+		_particleVersion++;
+	}
+
+	particleStorage.dispatch(commandBuffer, rd.getFrame(), deltaTime);
+}
+
+void RS::_recordParticles(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout,
+		bool bindMaterials, bool bindPipelines, DrawStats &stats) {
+	if (_particleDraws.empty())
+		return;
+
+	RD &rd = RD::getSingleton();
+
+	const GeometryArena &geometryArena = rd.getGeometryArena();
+	geometryArena.bind(commandBuffer);
+	stats.meshBindCount++;
+
+	vk::IndexType boundIndexType = vk::IndexType::eUint32;
+	ObjectID boundTextureSet = 0;
+	vk::Pipeline boundPipeline = VK_NULL_HANDLE;
+
+	uint32_t scenePermutation = rd.getScenePermutation();
+	bool setShadingRate = bindPipelines && rd.getShadingRateMode() != ShadingRateMode::Off;
+	vk::Extent2D boundShadingRate = vk::Extent2D(0, 0);
+
+	vk::Buffer indirectBuffer = rd.getParticleStorage().getCommandBuffer(rd.getFrame());
+	uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+	for (const ParticleDraw &draw : _particleDraws) {
+		if (bindPipelines) {
+			vk::Pipeline pipeline = rd.getMaterialPipeline(draw.permutation | scenePermutation);
+
+			if (pipeline != boundPipeline) {
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+				boundPipeline = pipeline;
+				stats.pipelineBindCount++;
+			}
+		}
+
+		if (setShadingRate) {
+			vk::Extent2D shadingRate = rd.getShadingRate(draw.permutation, false);
+
+			if (shadingRate != boundShadingRate) {
+				rd.setShadingRate(commandBuffer, shadingRate);
+				boundShadingRate = shadingRate;
+			}
+		}
+
+		if (draw.indexType != boundIndexType) {
+			boundIndexType = draw.indexType;
+			geometryArena.bindIndices(commandBuffer, boundIndexType);
+			stats.meshBindCount++;
+		}
+
+		if (bindMaterials && draw.textureSetId != boundTextureSet) {
+			rd.textureSetBind(commandBuffer, pipelineLayout, _textureSets[draw.textureSetId]);
+
+			boundTextureSet = draw.textureSetId;
+			stats.materialBindCount++;
+			stats.setBindCount++;
+		}
+
+		// instance count is written by simulation, unknown here
+		commandBuffer.drawIndexedIndirect(
+				indirectBuffer, static_cast<vk::DeviceSize>(draw.command) * stride, 1, stride);
+		stats.drawCount++;
+	}
+}
+
+void RS::_cullInstances(const ViewState *pViews, uint32_t viewCount) {
+	_culler.clear();
+	_cullCandidates.clear();
+
+	// tree skips subtrees out of view, culler tests tight bounds of leaves it found
+	_treeResults.clear();
+
+	_portalCuller.clear();
+
+	for (uint32_t i = 0; i < viewCount; i++) {
+		glm::vec4 planes[6];
+		FrustumCuller::extractPlanes(pViews[i].projView, planes);
+
+		_instanceTree.queryFrustum(planes, _treeResults);
+		_portalCuller.addView(pViews[i].position, pViews[i].projView);
+	}
+
+	// instances in overlapping views are culled and drawn once
+	if (viewCount > 1) {
+		std::sort(_treeResults.begin(), _treeResults.end());
+		_treeResults.erase(
+				std::unique(_treeResults.begin(), _treeResults.end()), _treeResults.end());
+	}
+
+	for (uint64_t id : _treeResults) {
+		MeshInstanceRD &meshInstance = _meshInstances[id];
+
+		// behind walls of cells no view sees through
+		if (!_portalCuller.isVisible(meshInstance.cell))
+			continue;
+
+		_culler.add(meshInstance.aabb);
+		_cullCandidates.push_back(&meshInstance);
+	}
+
+	_culler.cull(pViews[0].projView, _visibleIndices);
+
+	if (viewCount > 1) {
+		for (uint32_t i = 1; i < viewCount; i++) {
+			_culler.cull(pViews[i].projView, _viewVisibleIndices);
+			_visibleIndices.insert(_visibleIndices.end(), _viewVisibleIndices.begin(),
+					_viewVisibleIndices.end());
+		}
+
+		std::sort(_visibleIndices.begin(), _visibleIndices.end());
+		_visibleIndices.erase(std::unique(_visibleIndices.begin(), _visibleIndices.end()),
+				_visibleIndices.end());
+	}
+
+	uint32_t inFrustumCount = static_cast<uint32_t>(_visibleIndices.size());
+
+	// views would need a buffer each, several of them are culled by frustum alone
+	if (_useOcclusionCulling && viewCount == 1)
+		_cullOccluded(pViews[0]);
+
+	_cullStats.drawnCount = static_cast<uint32_t>(_visibleIndices.size());
+	_cullStats.frustumCulledCount = static_cast<uint32_t>(_cullCandidates.size()) - inFrustumCount;
+	_cullStats.occlusionCulledCount = inFrustumCount - _cullStats.drawnCount;
+
+	_visibleInstances.clear();
+
+	for (uint32_t idx : _visibleIndices) {
+		MeshInstanceRD *pMeshInstance = _cullCandidates[idx];
+		const MeshRD &mesh = _meshes[pMeshInstance->mesh];
+
+		float pixelScale = 0.0f;
+
+		for (uint32_t i = 0; i < viewCount; i++)
+			pixelScale = std::max(pixelScale,
+					_getPixelScale(*pMeshInstance, pViews[i].position, pViews[i].lodScale));
+		pMeshInstance->lod = mesh.selectLod(pMeshInstance->lod, pixelScale);
+
+		float distance = pMeshInstance->aabb.distance(pViews[0].position);
+
+		for (uint32_t i = 1; i < viewCount; i++)
+			distance = std::min(distance, pMeshInstance->aabb.distance(pViews[i].position));
+
+		// nearest view decides, like level of detail it is kept within hysteresis
+		if (mesh.impostor != NULL_HANDLE) {
+			float hysteresis = pMeshInstance->isImpostor ? 1.0f / LOD_HYSTERESIS : 1.0f;
+			pMeshInstance->isImpostor = distance > _impostorDistance * hysteresis;
+		} else {
+			pMeshInstance->isImpostor = false;
+		}
+
+		_requestTextureLevels(*pMeshInstance, pixelScale, distance, true);
+		pMeshInstance->visibleFrame = _frameCount;
+
+		_visibleInstances.push_back(pMeshInstance);
+	}
+}
+
+void RS::_cullOccluded(const ViewState &view) {
+	PROFILE_ZONE("occlusion cull");
+
+	_occluders.clear();
+
+	for (uint32_t idx : _visibleIndices) {
+		const MeshInstanceRD *pMeshInstance = _cullCandidates[idx];
+		const MeshRD &mesh = _meshes[pMeshInstance->mesh];
+
+		if (mesh.occluder == nullptr)
+			continue;
+
+		// holes cut by alpha test would hide what is seen through them
+		bool isOpaque = true;
+		const PrimitiveRD *pPrimitives = _getPrimitives(mesh);
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			ObjectID material = pPrimitives[i].material;
+
+			if (_materials.has(material) && _materials[material].alphaTest)
+				isOpaque = false;
+		}
+
+		float distance = pMeshInstance->aabb.distance(view.position);
+		float size = glm::length(pMeshInstance->aabb.extent()) / std::max(distance, 0.01f);
+
+		if (!isOpaque || (size < OCCLUDER_MIN_SIZE && !mesh.occluder->isTagged))
+			continue;
+
+		// tagged ones go first whatever their size
+		_occluders.push_back({ mesh.occluder->isTagged ? INFINITY : size, idx });
+	}
+
+	if (_occluders.empty())
+		return;
+
+	size_t occluderCount = std::min(_occluders.size(), size_t(OCCLUSION_MAX_OCCLUDER_COUNT));
+	std::partial_sort(_occluders.begin(), _occluders.begin() + occluderCount, _occluders.end(),
+			[](const std::pair<float, uint32_t> &a, const std::pair<float, uint32_t> &b) {
+				return a.first > b.first;
+			});
+
+	_occlusionRasterizer.begin(view.projView);
+
+	for (size_t i = 0; i < occluderCount; i++) {
+		const MeshInstanceRD *pMeshInstance = _cullCandidates[_occluders[i].second];
+		const MeshRD &mesh = _meshes[pMeshInstance->mesh];
+
+		_occlusionRasterizer.rasterize(*mesh.occluder, pMeshInstance->transform);
+	}
+
+	// occluders pass their own test, nearest corner of bounds is in front of their surface
+	size_t visibleCount = 0;
+
+	for (uint32_t idx : _visibleIndices) {
+		if (_occlusionRasterizer.isVisible(_cullCandidates[idx]->aabb))
+			_visibleIndices[visibleCount++] = idx;
+	}
+
+	_visibleIndices.resize(visibleCount);
+}
+
+void RS::_defragmentationBeginPass() {
+	if (_defragmentation == VK_NULL_HANDLE || _defragmentationPassFrame != 0)
+		return;
+
+	// allocations of pass may not be freed before it ends, pass waits for textures still
+	// waiting for destruction
+	if (_frameCount - _textureDestroyFrame <= RD::getSingleton().getFramesInFlight() + 1u)
+		return;
+
+	RD &rd = RD::getSingleton();
+	VmaAllocator allocator = rd.getAllocator();
+
+	VkResult result =
+			vmaBeginDefragmentationPass(allocator, _defragmentation, &_defragmentationPass);
+
+	// nothing left to move
+	if (result == VK_SUCCESS) {
+		_defragmentationEnd();
+		return;
+	}
+
+	for (uint32_t i = 0; i < _defragmentationPass.moveCount; i++) {
+		VmaDefragmentationMove &move = _defragmentationPass.pMoves[i];
+
+		VmaAllocationInfo allocInfo;
+		vmaGetAllocationInfo(allocator, move.srcAllocation, &allocInfo);
+
+		ObjectID texture = static_cast<ObjectID>(reinterpret_cast<uintptr_t>(allocInfo.pUserData));
+
+		// fallbacks have no texture
+		if (!_textures.has(texture) || _textures[texture].image.allocation != move.srcAllocation) {
+			move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+			continue;
+		}
+
+		TextureRD src = _textures[texture];
+		TextureRD dst = rd.textureCreateMoved(src, move.dstTmpAllocation);
+
+		_textures[texture] = dst;
+		_updateTextureMaterials(texture);
+
+		_textureMoves.push_back({ texture, src, dst });
+	}
+
+	_defragmentationPassFrame = _frameCount;
+
+	// pass without moves has nothing to wait for
+	if (_textureMoves.empty())
+		_defragmentationEndPass();
+}
+
+void RS::_defragmentationRecord(vk::CommandBuffer commandBuffer) {
+	if (_defragmentationPassFrame == 0)
+		return;
+
+	if (_defragmentationPassFrame == _frameCount) {
+		for (const TextureMove &move : _textureMoves)
+			RD::getSingleton().textureRecordMove(commandBuffer, move.src, move.dst);
+
+		return;
+	}
+
+	// drawBegin waited for frame which copied, later ones sample moved images
+	if (_frameCount - _defragmentationPassFrame >= RD::getSingleton().getFramesInFlight())
+		_defragmentationEndPass();
+}
+
+void RS::_defragmentationEndPass() {
+	RD &rd = RD::getSingleton();
+
+	for (const TextureMove &move : _textureMoves)
+		rd.textureDestroyMoved(move.src);
+
+	VkResult result =
+			vmaEndDefragmentationPass(rd.getAllocator(), _defragmentation, &_defragmentationPass);
+
+	_textureMoves.clear();
+	_defragmentationPassFrame = 0;
+
+	// updates go first, texture may have been freed after them
+	std::vector<std::pair<ObjectID, std::shared_ptr<Image>>> updates;
+	updates.swap(_pendingTextureUpdates);
+
+	for (const auto &[texture, image] : updates)
+		textureUpdate(texture, image);
+
+	for (ObjectID texture : _pendingTextureFrees)
+		_textureFree(texture);
+
+	_pendingTextureFrees.clear();
+
+	if (result == VK_SUCCESS)
+		_defragmentationEnd();
+}
+
+void RS::_defragmentationEnd() {
+	RD &rd = RD::getSingleton();
+
+	VmaDefragmentationStats stats = {};
+	vmaEndDefragmentation(rd.getAllocator(), _defragmentation, &stats);
+
+	_defragmentation = VK_NULL_HANDLE;
+
+	_defragmentationStats.fragmentationAfter = rd.getFragmentation();
+	_defragmentationStats.bytesMoved = stats.bytesMoved;
+	_defragmentationStats.allocationsMoved = stats.allocationsMoved;
+}
+
+bool RS::_isTextureMoving(ObjectID texture) const {
+	for (const TextureMove &move : _textureMoves) {
+		if (move.texture == texture)
+			return true;
+	}
+
+	return false;
+}
+
+void RS::_buildQueues(const glm::vec3 &viewPosition) {
+	_depthQueue.clear();
+	_materialQueue.clear();
+
+	for (const MeshInstanceRD *pMeshInstance : _visibleInstances) {
+		ObjectID meshId = pMeshInstance->mesh;
+		bool isImpostor = pMeshInstance->isImpostor && _meshes.has(_meshes[meshId].impostor);
+
+		if (isImpostor)
+			meshId = _meshes[meshId].impostor;
+
+		const MeshRD &mesh = _meshes[meshId];
+
+		// nearest point of bounds, zero for instances around camera, which occlude most
+		float distance = pMeshInstance->aabb.distance(viewPosition);
+		const PrimitiveRD *pPrimitives = _getPrimitives(mesh);
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			const PrimitiveRD &primitive = pPrimitives[i];
+			const MaterialRD &material = _getMaterial(primitive.material);
+
+			// primitive with fewer levels draws its coarsest one
+			uint32_t lodCount = static_cast<uint32_t>(primitive.lods.size());
+			uint32_t lod = glm::min(pMeshInstance->lod, lodCount);
+			uint32_t primitiveKey = i * (MAX_LOD_COUNT + 1) + lod;
+
+			DrawItem item = {};
+			item.pMesh = &mesh;
+			item.pPrimitive = &primitive;
+			item.pMeshInstance = pMeshInstance;
+			item.indexCount = lod > 0 ? primitive.lods[lod - 1].indexCount : primitive.indexCount;
+			item.firstIndex = lod > 0 ? primitive.lods[lod - 1].firstIndex : primitive.firstIndex;
+			item.vertexOffset = _getVertexOffset(*pMeshInstance, mesh);
+			item.materialIndex = material.index;
+			item.isImpostor = isImpostor;
+
+			// depth pass has no material state, near draws go first and fill depth for later
+			// ones to be rejected early, alpha tested impostors write their own depth
+			item.key = RenderQueue::makeDepthKey(distance, meshId, primitiveKey);
+
+			if (!isImpostor)
+				_depthQueue.add(item);
+
+			// permutation is most significant, each pipeline is bound once per pass, materials
+			// sharing texture set follow each other, bindless ones have none and do not split
+			item.key = RenderQueue::makeKey(
+					material.permutation, material.textureSetId, meshId, primitiveKey);
+			item.textureSetId = material.textureSetId;
+			item.permutation = material.permutation;
+			item.isFar = distance >= SHADING_RATE_FAR_DISTANCE;
+			_materialQueue.add(item);
+		}
+	}
+
+	_depthQueue.sort();
+	_materialQueue.sort();
+
+	_instanceTransforms.clear();
+	_instanceNormals.clear();
+	_instanceMaterials.clear();
+	_depthQueue.batch(
+			_instanceTransforms, _instanceMaterials, MAX_INSTANCE_COUNT, &_instanceNormals);
+	_materialQueue.batch(
+			_instanceTransforms, _instanceMaterials, MAX_INSTANCE_COUNT, &_instanceNormals);
+
+	_queuedInstances.assign(_visibleInstances.begin(), _visibleInstances.end());
+	_queuedLods.clear();
+
+	for (const MeshInstanceRD *pMeshInstance : _visibleInstances)
+		_queuedLods.push_back(_getQueuedLod(*pMeshInstance));
+
+	_isQueueDirty = false;
+	_queueVersion++;
+}
+
+bool RS::_isVisibleSetChanged() const {
+	if (_visibleInstances != _queuedInstances)
+		return true;
+
+	for (size_t i = 0; i < _visibleInstances.size(); i++) {
+		if (_getQueuedLod(*_visibleInstances[i]) != _queuedLods[i])
+			return true;
+	}
+
+	return false;
+}
+
+void RS::_buildGpuQueue() {
+	_gpuQueue.clear();
+
+	for (const MeshInstanceRD &meshInstance : _meshInstances) {
+		if (!_meshes.has(meshInstance.mesh))
+			continue;
+
+		const MeshRD &mesh = _meshes[meshInstance.mesh];
+		const PrimitiveRD *pPrimitives = _getPrimitives(mesh);
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			const PrimitiveRD &primitive = pPrimitives[i];
+
+			const MaterialRD &material = _getMaterial(primitive.material);
+
+			DrawItem item = {};
+			item.key = RenderQueue::makeKey(
+					material.permutation, material.textureSetId, meshInstance.mesh, i);
+			item.pMesh = &mesh;
+			item.pPrimitive = &primitive;
+			item.pMeshInstance = &meshInstance;
+			item.indexCount = primitive.indexCount;
+			item.firstIndex = primitive.firstIndex;
+			item.vertexOffset = _getVertexOffset(meshInstance, mesh);
+			item.textureSetId = material.textureSetId;
+			item.materialIndex = material.index;
+			item.permutation = material.permutation;
+
+			_gpuQueue.add(item);
+		}
+	}
+
+	_gpuQueue.sort();
+
+	// transforms are written by cull shader, only slot assignment is needed here
+	_instanceTransforms.clear();
+	_instanceNormals.clear();
+	_instanceMaterials.clear();
+	_gpuQueue.batch(
+			_instanceTransforms, _instanceMaterials, MAX_INSTANCE_COUNT, &_instanceNormals);
+
+	_gpuCuller.update(_gpuQueue);
+	_isQueueDirty = false;
+	_queueVersion++;
+}
+
+void RS::_buildShadowQueue() {
+	_shadowQueue.clear();
+
+	for (const MeshInstanceRD &meshInstance : _meshInstances) {
+		if (!_meshes.has(meshInstance.mesh))
+			continue;
+
+		const MeshRD &mesh = _meshes[meshInstance.mesh];
+		const PrimitiveRD *pPrimitives = _getPrimitives(mesh);
+
+		for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+			const PrimitiveRD &primitive = pPrimitives[i];
+
+			// depth only, group by mesh like depth pass
+			DrawItem item = {};
+			item.key = RenderQueue::makeKey(0, 0, meshInstance.mesh, i);
+			item.pMesh = &mesh;
+			item.pPrimitive = &primitive;
+			item.pMeshInstance = &meshInstance;
+			item.indexCount = primitive.indexCount;
+			item.firstIndex = primitive.firstIndex;
+			item.vertexOffset = _getVertexOffset(meshInstance, mesh);
+
+			_shadowQueue.add(item);
+		}
+	}
+
+	_shadowQueue.sort();
+
+	_shadowTransforms.clear();
+	_shadowMaterials.clear();
+	_shadowQueue.batch(_shadowTransforms, _shadowMaterials, MAX_SHADOW_CASTER_COUNT);
+
+	RD::getSingleton().getShadowAtlas().updateCasters(_shadowTransforms);
+	_isShadowQueueDirty = false;
+}
+
+void RS::_recordQueue(vk::CommandBuffer commandBuffer, const RenderQueue &queue,
+		uint32_t firstBatch, uint32_t batchCount, vk::PipelineLayout pipelineLayout,
+		bool bindMaterials, bool bindPipelines, DrawStats &stats) {
+	stats = {};
+
+	RD &rd = RD::getSingleton();
+
+	// every mesh lives in geometry arena, bound once per pass, index buffer follows index type
+	const GeometryArena &geometryArena = rd.getGeometryArena();
+	geometryArena.bind(commandBuffer);
+	stats.meshBindCount = 1;
+
+	vk::IndexType boundIndexType = vk::IndexType::eUint32;
+	ObjectID boundTextureSet = 0;
+	vk::Pipeline boundPipeline = VK_NULL_HANDLE;
+
+	uint32_t scenePermutation = rd.getScenePermutation();
+
+	// material pipelines take rate as dynamic state, set before first draw of buffer
+	bool setShadingRate = bindPipelines && rd.getShadingRateMode() != ShadingRateMode::Off;
+	vk::Extent2D boundShadingRate = vk::Extent2D(0, 0);
+
+	const std::vector<DrawBatch> &batches = queue.batches();
+
+	for (uint32_t i = firstBatch; i < firstBatch + batchCount; i++) {
+		const DrawBatch &batch = batches[i];
+
+		if (bindPipelines) {
+			vk::Pipeline pipeline = rd.getMaterialPipeline(batch.permutation | scenePermutation);
+
+			if (pipeline != boundPipeline) {
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+				boundPipeline = pipeline;
+				stats.pipelineBindCount++;
+			}
+		}
+
+		if (setShadingRate) {
+			vk::Extent2D shadingRate = rd.getShadingRate(batch.permutation, batch.isFar);
+
+			if (shadingRate != boundShadingRate) {
+				rd.setShadingRate(commandBuffer, shadingRate);
+				boundShadingRate = shadingRate;
+			}
+		}
+
+		if (batch.pMesh->geometry.indexType != boundIndexType) {
+			boundIndexType = batch.pMesh->geometry.indexType;
+			geometryArena.bindIndices(commandBuffer, boundIndexType);
+			stats.meshBindCount++;
+		}
+
+		if (bindMaterials) {
+			if (batch.textureSetId != boundTextureSet) {
+				rd.textureSetBind(commandBuffer, pipelineLayout, _textureSets[batch.textureSetId]);
+
+				boundTextureSet = batch.textureSetId;
+				stats.materialBindCount++;
+				stats.setBindCount++;
+			} else {
+				stats.materialBindSkipCount++;
+			}
+		}
+
+		commandBuffer.drawIndexed(batch.indexCount, batch.instanceCount, batch.firstIndex,
+				batch.vertexOffset, batch.firstInstance);
+
+		stats.drawCount++;
+		stats.instanceCount += batch.instanceCount;
+		stats.triangleCount += static_cast<uint64_t>(batch.indexCount / 3) * batch.instanceCount;
+	}
+
+	if (stats.drawCount > stats.meshBindCount)
+		stats.meshBindSkipCount = stats.drawCount - stats.meshBindCount;
+}
+
+void RS::_recordDepthPass(vk::CommandBuffer commandBuffer, uint32_t firstBatch,
+		uint32_t batchCount, bool drawParticles, DrawStats &stats) {
+	RD &rd = RD::getSingleton();
+
+	// material pass writes depth itself, empty subpass keeps render pass as it is
+	if (!rd.isDepthPrepass()) {
+		stats = {};
+		return;
+	}
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rd.getDepthPipeline());
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+			rd.getDepthPipelineLayout(), 0, rd.getUniformSet(), nullptr);
+
+	if (_useGpuCulling) {
+		_gpuCuller.draw(commandBuffer, rd.getFrame(), _gpuQueue, rd.getDepthPipelineLayout(),
+				nullptr, false, stats);
+	} else {
+		_recordQueue(commandBuffer, _depthQueue, firstBatch, batchCount,
+				rd.getDepthPipelineLayout(), false, false, stats);
+	}
+
+	if (drawParticles)
+		_recordParticles(commandBuffer, rd.getDepthPipelineLayout(), false, false, stats);
+
+	// pipeline and uniform set of pass
+	stats.pipelineBindCount++;
+	stats.setBindCount++;
+}
+
+void RS::_recordSky(
+		vk::CommandBuffer commandBuffer, const glm::mat4 &invProj, const glm::mat4 &invView) {
+	RD &rd = RD::getSingleton();
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rd.getSkyPipeline());
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, rd.getSkyPipelineLayout(),
+			0, rd.getSkySet(), nullptr);
+
+	SkyConstants constants{};
+	constants.invProj = invProj;
+	constants.invView = invView;
+	constants.lod = rd.getSkyLod();
+
+	commandBuffer.pushConstants(rd.getSkyPipelineLayout(), vk::ShaderStageFlagBits::eFragment, 0,
+			sizeof(constants), &constants);
+	commandBuffer.draw(3, 1, 0, 0);
+}
+
+void RS::_recordMaterialPass(vk::CommandBuffer commandBuffer, uint32_t firstBatch,
+		uint32_t batchCount, bool drawParticles, DrawStats &stats) {
+	RD &rd = RD::getSingleton();
+
+	// permutations share layout, pipeline is bound by batches and sets stay bound
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+			rd.getMaterialPipelineLayout(), 0, rd.getMaterialSets(), nullptr);
+
+	// every material is reachable through one set, bound once per pass
+	bool bindMaterials = !rd.isBindlessEnabled();
+
+	if (!bindMaterials) {
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+				rd.getMaterialPipelineLayout(), 3, rd.getBindlessStorage().getBindlessSet(),
+				nullptr);
+	}
+
+	if (_useGpuCulling) {
+		_gpuCuller.draw(commandBuffer, rd.getFrame(), _gpuQueue, rd.getMaterialPipelineLayout(),
+				bindMaterials ? &_textureSets : nullptr, true, stats);
+	} else {
+		_recordQueue(commandBuffer, _materialQueue, firstBatch, batchCount,
+				rd.getMaterialPipelineLayout(), bindMaterials, true, stats);
+	}
+
+	if (drawParticles) {
+		_recordParticles(commandBuffer, rd.getMaterialPipelineLayout(), bindMaterials, true,
+				stats);
+		_recordTerrain(commandBuffer, stats);
+	}
+
+	// sets of pass
+	stats.setBindCount++;
+
+	if (!bindMaterials) {
+		stats.materialBindCount = 1;
+		stats.setBindCount++;
+	}
+}
+
+void RS::_recordTerrain(vk::CommandBuffer commandBuffer, DrawStats &stats) {
+	RD &rd = RD::getSingleton();
+	const TerrainStorage &terrainStorage = rd.getTerrainStorage();
+
+	if (!terrainStorage.isEnabled())
+		return;
+
+	// layout pushes constants, sets of material layout are not compatible with it
+	vk::PipelineLayout pipelineLayout = rd.getTerrainPipelineLayout();
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rd.getTerrainPipeline());
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0,
+			rd.getMaterialSets(), nullptr);
+
+	terrainStorage.draw(commandBuffer, rd.getFrame(), rd.getView(), pipelineLayout, stats);
+
+	stats.pipelineBindCount++;
+	stats.setBindCount++;
+}
+
+void RS::_recordLighting(
+		vk::CommandBuffer commandBuffer, const glm::mat4 &invProj, const glm::mat4 &invView) {
+	RD &rd = RD::getSingleton();
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, rd.getLightingPipeline());
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+			rd.getLightingPipelineLayout(), 0, rd.getMaterialSets(), nullptr);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+			rd.getLightingPipelineLayout(), 3, rd.getGBufferSet(), nullptr);
+
+	// position is rebuilt with camera of uniform buffer
+	commandBuffer.draw(3, 1, 0, 0);
+
+	// lighting discards background, sky fills it
+	_recordSky(commandBuffer, invProj, invView);
+}
+
+void RS::_recordThreaded(
+		vk::CommandBuffer commandBuffer, const glm::mat4 &invProj, const glm::mat4 &invView) {
+	RD &rd = RD::getSingleton();
+
+	// indirect draws are few commands, they are not worth splitting
+	uint32_t chunkCount = _useGpuCulling ? 1 : _recordThreadCount;
+
+	uint32_t depthBatchCount = static_cast<uint32_t>(_depthQueue.batches().size());
+	uint32_t materialBatchCount = static_cast<uint32_t>(_materialQueue.batches().size());
+
+	// depth chunks, sky (with lighting when deferred), material chunks
+	uint32_t jobCount = chunkCount * 2 + 1;
+	bool isDeferred = rd.isDeferredEnabled();
+
+	_secondaryBuffers.resize(jobCount);
+	_secondaryStats.assign(jobCount, {});
+
+	// chunks run in order, first one begins scope and last one ends it
+	GpuProfiler &profiler = rd.getGpuProfiler();
+	uint32_t depthScope = profiler.scopeCreate("depth");
+	uint32_t skyScope = profiler.scopeCreate(isDeferred ? "lighting" : "sky");
+	uint32_t materialScope = profiler.scopeCreate("material");
+
+	// thread index picks secondary command pool, jobs of one thread run one after another,
+	// calling thread does not record itself as it may be render thread outside of job system
+	auto record = [&](uint32_t job) {
+		uint32_t worker = JobSystem::getThreadIndex();
+
+		if (job < chunkCount) {
+			uint32_t first = job * depthBatchCount / chunkCount;
+			uint32_t last = (job + 1) * depthBatchCount / chunkCount;
+
+			vk::CommandBuffer secondary = rd.secondaryBegin(worker, DEPTH_PASS);
+
+			if (job == 0)
+				profiler.scopeBegin(secondary, depthScope);
+
+			_recordDepthPass(
+					secondary, first, last - first, job == chunkCount - 1, _secondaryStats[job]);
+
+			if (job == chunkCount - 1)
+				profiler.scopeEnd(secondary, depthScope);
+
+			secondary.end();
+
+			_secondaryBuffers[job] = secondary;
+		} else if (job == chunkCount && isDeferred) {
+			vk::CommandBuffer secondary = rd.secondaryBegin(worker, LIGHTING_PASS);
+			profiler.scopeBegin(secondary, skyScope);
+			_recordLighting(secondary, invProj, invView);
+			profiler.scopeEnd(secondary, skyScope);
+			secondary.end();
+
+			_secondaryBuffers[job] = secondary;
+		} else if (job == chunkCount) {
+			vk::CommandBuffer secondary = rd.secondaryBegin(worker, MAIN_PASS);
+			profiler.scopeBegin(secondary, skyScope);
+			_recordSky(secondary, invProj, invView);
+			profiler.scopeEnd(secondary, skyScope);
+			secondary.end();
+
+			_secondaryBuffers[job] = secondary;
+		} else {
+			uint32_t chunk = job - chunkCount - 1;
+			uint32_t first = chunk * materialBatchCount / chunkCount;
+			uint32_t last = (chunk + 1) * materialBatchCount / chunkCount;
+
+			vk::CommandBuffer secondary = rd.secondaryBegin(worker, MAIN_PASS);
+
+			if (chunk == 0)
+				profiler.scopeBegin(secondary, materialScope);
+
+			_recordMaterialPass(secondary, first, last - first, chunk == chunkCount - 1,
+					_secondaryStats[job]);
+
+			if (chunk == chunkCount - 1)
+				profiler.scopeEnd(secondary, materialScope);
+
+			secondary.end();
+
+			_secondaryBuffers[job] = secondary;
+		}
+	};
+
+	JobCounter counter;
+
+	for (uint32_t job = 0; job < jobCount; job++)
+		JobSystem::run([&record, job]() { record(job); }, &counter);
+
+	JobSystem::wait(counter);
+
+	_depthStats = {};
+	_materialStats = {};
+
+	for (uint32_t i = 0; i < chunkCount; i++) {
+		_depthStats += _secondaryStats[i];
+		_materialStats += _secondaryStats[chunkCount + 1 + i];
+	}
+
+	PipelineStatistics &statistics = rd.getPipelineStatistics();
+	uint32_t depthStatsScope = statistics.scopeCreate("depth");
+	uint32_t skyStatsScope = statistics.scopeCreate(isDeferred ? "lighting" : "sky");
+	uint32_t materialStatsScope = statistics.scopeCreate("material");
+
+	rd.renderPassBegin(commandBuffer, vk::SubpassContents::eSecondaryCommandBuffers);
+	statistics.scopeBegin(commandBuffer, depthStatsScope);
+	commandBuffer.executeCommands(chunkCount, &_secondaryBuffers[0]);
+	statistics.scopeEnd(commandBuffer, depthStatsScope);
+
+	commandBuffer.nextSubpass(vk::SubpassContents::eSecondaryCommandBuffers);
+
+	statistics.scopeBegin(commandBuffer, materialStatsScope);
+	commandBuffer.executeCommands(chunkCount, &_secondaryBuffers[chunkCount + 1]);
+	statistics.scopeEnd(commandBuffer, materialStatsScope);
+
+	// sky last when forward, its depth test passes only where no geometry was drawn
+	if (isDeferred)
+		commandBuffer.nextSubpass(vk::SubpassContents::eSecondaryCommandBuffers);
+
+	statistics.scopeBegin(commandBuffer, skyStatsScope);
+	commandBuffer.executeCommands(1, &_secondaryBuffers[chunkCount]);
+	statistics.scopeEnd(commandBuffer, skyStatsScope);
+}
+
+bool RS::_isCachedPassValid() const {
+	RD &rd = RD::getSingleton();
+	const CachedPasses &cache = _cachedPasses[rd.getFrame()];
+
+	vk::Extent2D extent = rd.getRenderExtent();
+
+	// pipelines of point light permutation are picked at record time
+	return cache.depth && cache.queueVersion == _queueVersion &&
+			cache.particleVersion == _particleVersion &&
+			cache.terrainVersion == rd.getTerrainStorage().getVersion() &&
+			cache.setVersion == rd.getSetVersion() &&
+			cache.framebuffer == rd.getFramebuffer() && cache.extent == extent &&
+			cache.scenePermutation == rd.getScenePermutation() &&
+			cache.isDepthPrepass == rd.isDepthPrepass();
+}
+
+void RS::_recordCached(vk::CommandBuffer commandBuffer, bool isValid, const glm::mat4 &invProj,
+		const glm::mat4 &invView) {
+	RD &rd = RD::getSingleton();
+	CachedPasses &cache = _cachedPasses[rd.getFrame()];
+
+	bool isDeferred = rd.isDeferredEnabled();
+
+	if (!isValid) {
+		PROFILE_ZONE("record cached passes");
+
+		uint32_t depthBatchCount = static_cast<uint32_t>(_depthQueue.batches().size());
+		uint32_t materialBatchCount = static_cast<uint32_t>(_materialQueue.batches().size());
+
+		cache.depth = rd.secondaryBeginCached(0, DEPTH_PASS);
+		_recordDepthPass(cache.depth, 0, depthBatchCount, true, cache.depthStats);
+		cache.depth.end();
+
+		cache.material = rd.secondaryBeginCached(1, MAIN_PASS);
+		_recordMaterialPass(cache.material, 0, materialBatchCount, true, cache.materialStats);
+		cache.material.end();
+
+		cache.queueVersion = _queueVersion;
+		cache.particleVersion = _particleVersion;
+		cache.terrainVersion = rd.getTerrainStorage().getVersion();
+		cache.setVersion = rd.getSetVersion();
+		cache.framebuffer = rd.getFramebuffer();
+		cache.extent = rd.getRenderExtent();
+		cache.scenePermutation = rd.getScenePermutation();
+		cache.isDepthPrepass = rd.isDepthPrepass();
+	}
+
+	_depthStats = cache.depthStats;
+	_materialStats = cache.materialStats;
+
+	// timestamps of cached buffers would be written to queries of frame they were recorded in,
+	// only sky and lighting are profiled
+	GpuProfiler &profiler = rd.getGpuProfiler();
+	uint32_t scope = profiler.scopeCreate(isDeferred ? "lighting" : "sky");
+
+	vk::CommandBuffer sky = rd.secondaryBegin(0, isDeferred ? LIGHTING_PASS : MAIN_PASS);
+	profiler.scopeBegin(sky, scope);
+
+	if (isDeferred)
+		_recordLighting(sky, invProj, invView);
+	else
+		_recordSky(sky, invProj, invView);
+
+	profiler.scopeEnd(sky, scope);
+	sky.end();
+
+	// queries are begun in primary buffer, cached buffers are counted too
+	PipelineStatistics &statistics = rd.getPipelineStatistics();
+	uint32_t depthStatsScope = statistics.scopeCreate("depth");
+	uint32_t skyStatsScope = statistics.scopeCreate(isDeferred ? "lighting" : "sky");
+	uint32_t materialStatsScope = statistics.scopeCreate("material");
+
+	rd.renderPassBegin(commandBuffer, vk::SubpassContents::eSecondaryCommandBuffers);
+	statistics.scopeBegin(commandBuffer, depthStatsScope);
+	commandBuffer.executeCommands(cache.depth);
+	statistics.scopeEnd(commandBuffer, depthStatsScope);
+
+	commandBuffer.nextSubpass(vk::SubpassContents::eSecondaryCommandBuffers);
+
+	statistics.scopeBegin(commandBuffer, materialStatsScope);
+	commandBuffer.executeCommands(cache.material);
+	statistics.scopeEnd(commandBuffer, materialStatsScope);
+
+	if (isDeferred)
+		commandBuffer.nextSubpass(vk::SubpassContents::eSecondaryCommandBuffers);
+
+	statistics.scopeBegin(commandBuffer, skyStatsScope);
+	commandBuffer.executeCommands(sky);
+	statistics.scopeEnd(commandBuffer, skyStatsScope);
+}
+
+void RenderingServer::draw() {
+	if (_isRecordedCall())
+		_recorder.frame();
+
+	if (_isClientCall()) {
+		PROFILE_ZONE("draw wait");
+
+		// frame before last one is recorded, client simulates next one while this one is
+		{
+			std::unique_lock<std::mutex> lock(_drawMutex);
+			_drawCondition.wait(lock, [this] { return _drawnCount == _queuedDrawCount; });
+		}
+
+		_queuedDrawCount++;
+
+		_push([this]() {
+			draw();
+
+			{
+				std::lock_guard<std::mutex> lock(_drawMutex);
+				_drawnCount++;
+			}
+
+			_drawCondition.notify_all();
+		});
+
+		_runClientCalls();
+		return;
+	}
+
+	PROFILE_ZONE("draw");
+
+	// lists of previous frame are gone by now
+	_scratch.reset();
+
+	// changes made while frame is recorded show up in next one
+	uint64_t changeCount = _changeCount.load();
+
+	_adoptBackground();
+
+	RD &rd = RD::getSingleton();
+
+	// scene is stretched over swapchain, rounding of render extent must not change aspect
+	vk::Extent2D swapchainExtent = rd.getSwapchainExtent();
+	float aspect = static_cast<float>(swapchainExtent.width) /
+			static_cast<float>(swapchainExtent.height);
+
+	vk::Extent2D extent = rd.getRenderExtent();
+
+	std::array<ViewState, MAX_VIEW_COUNT> views;
+
+	for (uint32_t i = 0; i < _viewCount; i++) {
+		const View &source = _views[i];
+		ViewState &state = views[i];
+
+		// edges are rounded, views tiling extent leave no gaps between them
+		uint32_t x0 = static_cast<uint32_t>(std::round(source.rect.x * extent.width));
+		uint32_t y0 = static_cast<uint32_t>(std::round(source.rect.y * extent.height));
+		uint32_t x1 = static_cast<uint32_t>(
+				std::round((source.rect.x + source.rect.z) * extent.width));
+		uint32_t y1 = static_cast<uint32_t>(
+				std::round((source.rect.y + source.rect.w) * extent.height));
+
+		x0 = std::min(x0, extent.width - 1);
+		y0 = std::min(y0, extent.height - 1);
+		x1 = std::clamp(x1, x0 + 1, extent.width);
+		y1 = std::clamp(y1, y0 + 1, extent.height);
+
+		state.rect = vk::Rect2D({ static_cast<int32_t>(x0), static_cast<int32_t>(y0) },
+				{ x1 - x0, y1 - y0 });
+
+		state.aspect = aspect * static_cast<float>(state.rect.extent.width) /
+				static_cast<float>(extent.width) * static_cast<float>(extent.height) /
+				static_cast<float>(state.rect.extent.height);
+
+		// jittered every frame only while temporal upscaling accumulates it
+		state.proj = source.camera.projectionMatrix(state.aspect, rd.getJitter());
+		state.view = source.camera.viewMatrix();
+
+		state.invProj = glm::inverse(state.proj);
+		state.invView = glm::inverse(state.view);
+
+		state.projView = state.proj * state.view;
+		state.position = glm::vec3(source.camera.transform[3]);
+
+		// bias of one level halves pixels mesh is thought to cover
+		state.lodScale = static_cast<float>(state.rect.extent.height) /
+				(2.0f * glm::tan(source.camera.fovY * 0.5f)) * std::exp2(-_lodBias);
+
+		// every pass reads camera from here, recorded draws stay valid while it moves
+		rd.updateUniformBuffer(state.position, state.view, state.proj, i, state.rect);
+	}
+
+	// shadows, temporal history and gpu culling follow first view
+	const ViewState &first = views[0];
+	bool isMultiView = _viewCount > 1;
+
+	rd.setTemporalProjView(_views[0].camera.projectionMatrix(first.aspect) * first.view);
+
+	// several views are recorded inline, once for each of them
+	bool useCachedCommands = _useCachedCommands && !isMultiView;
+
+	// swaps happen before queues are built, they pick up new materials
+	_frameCount++;
+	_streamTextures();
+	_streamGeometry(first.position, first.lodScale);
+	_drainUploads();
+	_collectImpostor();
+	_defragmentationBeginPass();
+
+	if (_useGpuCulling) {
+		// visibility is known only on GPU, every instance asks for its levels, ones in frustum
+		// of first view rank as visible
+		glm::vec4 planes[6];
+		FrustumCuller::extractPlanes(first.projView, planes);
+
+		_treeResults.clear();
+		_instanceTree.queryFrustum(planes, _treeResults);
+
+		for (uint64_t id : _treeResults)
+			_meshInstances[id].visibleFrame = _frameCount;
+
+		for (const MeshInstanceRD &meshInstance : _meshInstances) {
+			if (!_meshes.has(meshInstance.mesh))
+				continue;
+
+			float pixelScale = _getPixelScale(meshInstance, first.position, first.lodScale);
+			float distance = meshInstance.aabb.distance(first.position);
+			bool isVisible = meshInstance.visibleFrame == _frameCount;
+
+			_requestTextureLevels(meshInstance, pixelScale, distance, isVisible);
+		}
+
+		if (_isQueueDirty)
+			_buildGpuQueue();
+	} else {
+		_cullInstances(views.data(), _viewCount);
+
+		// cached passes replay queues as long as same instances are visible at same levels
+		if (!_useCachedCommands || _isQueueDirty || _isVisibleSetChanged())
+			_buildQueues(first.position);
+	}
+
+	if (_isShadowQueueDirty)
+		_buildShadowQueue();
+
+	vk::CommandBuffer commandBuffer = rd.drawBegin();
+	_defragmentationRecord(commandBuffer);
+
+	GpuProfiler &profiler = rd.getGpuProfiler();
+
+	// particles cast no shadows, draws they leave decide whether cached passes are still valid
+	uint32_t scope = profiler.scopeCreate("particles");
+	profiler.scopeBegin(commandBuffer, scope);
+	_updateParticles(commandBuffer);
+	profiler.scopeEnd(commandBuffer, scope);
+
+	// levels follow first view, tiles they moved onto are copied before passes read them
+	std::array<glm::mat4, MAX_VIEW_COUNT> terrainProjViews;
+
+	for (uint32_t i = 0; i < _viewCount; i++)
+		terrainProjViews[i] = views[i].projView;
+
+	rd.getTerrainStorage().update(
+			commandBuffer, rd.getFrame(), first.position, terrainProjViews.data(), _viewCount);
+
+	// after drawBegin, sets of frame are written by then
+	bool isCachedPassValid = useCachedCommands && _isCachedPassValid();
+
+	// drawBegin collected copies of frame it waited for
+	_deliverCaptures();
+
+	// reads nothing passes of frame write, overlaps them on queue of its own whose timestamps
+	// are not taken
+	LightCuller::View cullViews[MAX_VIEW_COUNT];
+
+	for (uint32_t i = 0; i < _viewCount; i++)
+		cullViews[i] = { views[i].view, views[i].proj };
+
+	const Camera &camera = _views[0].camera;
+
+	if (rd.isAsyncComputeEnabled()) {
+		vk::CommandBuffer computeBuffer =
+				rd.asyncComputeBegin(vk::PipelineStageFlagBits::eFragmentShader);
+		rd.getLightCuller().dispatch(computeBuffer, rd.getFrame(), cullViews, _viewCount,
+				camera.zNear, camera.zFar, rd.getLightStorage(), true);
+	} else {
+		scope = profiler.scopeCreate("light culling");
+		profiler.scopeBegin(commandBuffer, scope);
+		rd.getLightCuller().dispatch(commandBuffer, rd.getFrame(), cullViews, _viewCount,
+				camera.zNear, camera.zFar, rd.getLightStorage());
+		profiler.scopeEnd(commandBuffer, scope);
+	}
+
+	// skinning poses morphed vertices
+	scope = profiler.scopeCreate("morphing");
+	profiler.scopeBegin(commandBuffer, scope);
+	_recordMorphing(commandBuffer);
+	profiler.scopeEnd(commandBuffer, scope);
+
+	// shadows already draw posed instances
+	scope = profiler.scopeCreate("skinning");
+	profiler.scopeBegin(commandBuffer, scope);
+	_recordSkinning(commandBuffer);
+	profiler.scopeEnd(commandBuffer, scope);
+
+	scope = profiler.scopeCreate("impostors");
+	profiler.scopeBegin(commandBuffer, scope);
+	_recordImpostorBake(commandBuffer);
+	profiler.scopeEnd(commandBuffer, scope);
+
+	scope = profiler.scopeCreate("shadows");
+	profiler.scopeBegin(commandBuffer, scope);
+	rd.getShadowAtlas().render(commandBuffer, rd.getFrame(), camera, first.aspect,
+			rd.getLightStorage(), rd.getGeometryArena(), _shadowQueue);
+	profiler.scopeEnd(commandBuffer, scope);
+
+	if (_useGpuCulling) {
+		scope = profiler.scopeCreate("gpu culling");
+		profiler.scopeBegin(commandBuffer, scope);
+		_gpuCuller.dispatch(
+				commandBuffer, rd.getFrame(), first.projView, first.position, first.lodScale);
+		profiler.scopeEnd(commandBuffer, scope);
+	} else if (!isCachedPassValid) {
+		// buffers of frame still hold what its cached passes were recorded with otherwise
+		uint32_t instanceCount = static_cast<uint32_t>(_instanceTransforms.size());
+		rd.updateInstanceBuffer(_instanceTransforms.data(), instanceCount);
+		rd.updateInstanceNormalBuffer(_instanceNormals.data(), instanceCount);
+
+		if (rd.isBindlessEnabled())
+			rd.updateInstanceMaterialBuffer(_instanceMaterials.data(), instanceCount);
+	}
+
+	if (useCachedCommands) {
+		_recordCached(commandBuffer, isCachedPassValid, first.invProj, first.invView);
+	} else if (_recordThreadCount > 1 && !isMultiView) {
+		_recordThreaded(commandBuffer, first.invProj, first.invView);
+	} else {
+		uint32_t depthBatchCount = static_cast<uint32_t>(_depthQueue.batches().size());
+		uint32_t materialBatchCount = static_cast<uint32_t>(_materialQueue.batches().size());
+
+		// stats of queues recorded for each view add up
+		DrawStats viewStats;
+		_depthStats = {};
+		_materialStats = {};
+
+		rd.renderPassBegin(commandBuffer);
+
+		PipelineStatistics &statistics = rd.getPipelineStatistics();
+
+		scope = profiler.scopeCreate("depth");
+		profiler.scopeBegin(commandBuffer, scope);
+		uint32_t statsScope = statistics.scopeCreate("depth");
+		statistics.scopeBegin(commandBuffer, statsScope);
+
+		for (uint32_t i = 0; i < _viewCount; i++) {
+			if (isMultiView)
+				rd.setView(commandBuffer, i, views[i].rect);
+
+			_recordDepthPass(commandBuffer, 0, depthBatchCount, true, viewStats);
+			_depthStats += viewStats;
+		}
+
+		statistics.scopeEnd(commandBuffer, statsScope);
+		profiler.scopeEnd(commandBuffer, scope);
+
+		commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+
+		uint32_t materialScope = profiler.scopeCreate("material");
+		profiler.scopeBegin(commandBuffer, materialScope);
+		statsScope = statistics.scopeCreate("material");
+		statistics.scopeBegin(commandBuffer, statsScope);
+
+		for (uint32_t i = 0; i < _viewCount; i++) {
+			if (isMultiView)
+				rd.setView(commandBuffer, i, views[i].rect);
+
+			_recordMaterialPass(commandBuffer, 0, materialBatchCount, true, viewStats);
+			_materialStats += viewStats;
+		}
+
+		statistics.scopeEnd(commandBuffer, statsScope);
+		profiler.scopeEnd(commandBuffer, materialScope);
+
+		if (rd.isDeferredEnabled()) {
+			commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+
+			scope = profiler.scopeCreate("lighting");
+			profiler.scopeBegin(commandBuffer, scope);
+			statsScope = statistics.scopeCreate("lighting");
+			statistics.scopeBegin(commandBuffer, statsScope);
+
+			for (uint32_t i = 0; i < _viewCount; i++) {
+				if (isMultiView)
+					rd.setView(commandBuffer, i, views[i].rect);
+
+				_recordLighting(commandBuffer, views[i].invProj, views[i].invView);
+			}
+
+			statistics.scopeEnd(commandBuffer, statsScope);
+			profiler.scopeEnd(commandBuffer, scope);
+		} else {
+			// at far plane after opaque draws, shades only what depth left empty
+			scope = profiler.scopeCreate("sky");
+			profiler.scopeBegin(commandBuffer, scope);
+			statsScope = statistics.scopeCreate("sky");
+			statistics.scopeBegin(commandBuffer, statsScope);
+
+			for (uint32_t i = 0; i < _viewCount; i++) {
+				if (isMultiView)
+					rd.setView(commandBuffer, i, views[i].rect);
+
+				_recordSky(commandBuffer, views[i].invProj, views[i].invView);
+			}
+
+			statistics.scopeEnd(commandBuffer, statsScope);
+			profiler.scopeEnd(commandBuffer, scope);
+		}
+	}
+
+	rd.renderPassEnd(commandBuffer);
+
+	if (_useGpuCulling) {
+		scope = profiler.scopeCreate("depth pyramid");
+		profiler.scopeBegin(commandBuffer, scope);
+		_gpuCuller.buildDepthPyramid(commandBuffer, first.projView);
+		profiler.scopeEnd(commandBuffer, scope);
+	}
+
+	rd.drawEnd(commandBuffer);
+	_updateFrameStats();
+
+	// particles move every frame while any emitter exists
+	bool isBusy = _isStreaming || _defragmentation != VK_NULL_HANDLE ||
+			rd.isEnvironmentBaking() || _particleEmitters.size() > 0;
+
+	if (changeCount != _drawnChangeCount.load() || isBusy)
+		_settleFrameCount.store(rd.getSettleFrameCount());
+	else if (_settleFrameCount.load() > 0)
+		_settleFrameCount.store(_settleFrameCount.load() - 1);
+
+	_drawnChangeCount.store(changeCount);
+}
+
+void RS::_updateFrameStats() {
+	RD &rd = RD::getSingleton();
+
+	DrawStats draw = _depthStats;
+	draw += _materialStats;
+
+	FrameStats &stats = _frameStats;
+	stats.drawCount = draw.drawCount;
+	stats.instanceCount = draw.instanceCount;
+	stats.triangleCount = draw.triangleCount;
+	stats.pipelineBindCount = draw.pipelineBindCount;
+	stats.setBindCount = draw.setBindCount;
+	stats.pushConstantCount = draw.pushConstantCount;
+
+	if (_useGpuCulling) {
+		CullStats cull = _gpuCuller.getStats();
+
+		stats.culledInstanceCount = cull.frustumCulledCount + cull.occlusionCulledCount +
+				cull.backfaceCulledCount;
+		stats.submittedInstanceCount = cull.drawnCount + stats.culledInstanceCount;
+	} else {
+		stats.submittedInstanceCount = _instanceTree.getLeafCount();
+		stats.culledInstanceCount = _instanceTree.getLeafCount() -
+				static_cast<uint32_t>(_visibleInstances.size());
+	}
+
+	uint64_t uploadedBytes = rd.getUploadManager().getUploadedBytes();
+	stats.uploadedBytes = uploadedBytes - _uploadedBytes;
+	_uploadedBytes = uploadedBytes;
+
+	const LightStorage &lightStorage = rd.getLightStorage();
+	stats.directionalLightCount = lightStorage.getDirectionalLightCount();
+	stats.pointLightCount = lightStorage.getPointLightCount();
+	stats.shadowedLightCount = lightStorage.getShadowedLightCount();
+}
+
+DrawStats RS::getDepthDrawStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getDepthDrawStats);
+
+	return _depthStats;
+}
+
+DrawStats RS::getMaterialDrawStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getMaterialDrawStats);
+
+	return _materialStats;
+}
+
+CullStats RS::getCullStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getCullStats);
+
+	return _useGpuCulling ? _gpuCuller.getStats() : _cullStats;
+}
+
+FrameStats RS::getFrameStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getFrameStats);
+
+	return _frameStats;
+}
+
+std::vector<GpuTiming> RS::getGpuTimings() const {
+	if (_isClientCall())
+		return _getSync(&RS::getGpuTimings);
+
+	return RD::getSingleton().getGpuTimings();
+}
+
+FramePacingStats RS::getFramePacingStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getFramePacingStats);
+
+	return RD::getSingleton().getFramePacingStats();
+}
+
+FrameBoundStats RS::getFrameBoundStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getFrameBoundStats);
+
+	return RD::getSingleton().getFrameBoundStats();
+}
+
+bool RS::setPipelineStatistics(bool isEnabled) {
+	if (_isClientCall()) {
+		bool isSupported = false;
+		_pushSync([&]() { isSupported = setPipelineStatistics(isEnabled); });
+
+		return isSupported;
+	}
+
+	PipelineStatistics &statistics = RD::getSingleton().getPipelineStatistics();
+	statistics.setEnabled(isEnabled && statistics.isSupported());
+
+	return statistics.isSupported() || !isEnabled;
+}
+
+std::vector<PipelineStats> RS::getPipelineStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getPipelineStats);
+
+	return RD::getSingleton().getPipelineStatistics().getStats();
+}
+
+StartupStats RS::getStartupStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getStartupStats);
+
+	return RD::getSingleton().getStartupStats();
+}
+
+void RS::defragmentationStart() {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::DefragmentationStart);
+
+	if (_isClientCall()) {
+		_push([this]() { defragmentationStart(); });
+		return;
+	}
+
+	if (_defragmentation != VK_NULL_HANDLE)
+		return;
+
+	RD &rd = RD::getSingleton();
+
+	VmaPool pool = rd.getTexturePool();
+
+	if (pool == VK_NULL_HANDLE) {
+		std::cout << "ERROR: Defragmentation needs texture memory pool!" << std::endl;
+		return;
+	}
+
+	VmaDefragmentationInfo info = {};
+	info.pool = pool;
+	info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+	info.maxBytesPerPass = DEFRAGMENTATION_BYTES_PER_PASS;
+	info.maxAllocationsPerPass = DEFRAGMENTATION_MOVES_PER_PASS;
+
+	if (vmaBeginDefragmentation(rd.getAllocator(), &info, &_defragmentation) != VK_SUCCESS) {
+		std::cout << "ERROR: Defragmentation could not be started!" << std::endl;
+		_defragmentation = VK_NULL_HANDLE;
+		return;
+	}
+
+	_defragmentationStats = {};
+	_defragmentationStats.fragmentationBefore = rd.getFragmentation();
+}
+
+bool RS::isDefragmenting() const {
+	if (_isClientCall())
+		return _getSync(&RS::isDefragmenting);
+
+	return _defragmentation != VK_NULL_HANDLE;
+}
+
+DefragmentationStats RS::getDefragmentationStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getDefragmentationStats);
+
+	return _defragmentationStats;
+}
+
+MemoryStats RS::getMemoryStats() const {
+	if (_isClientCall())
+		return _getSync(&RS::getMemoryStats);
+
+	MemoryBudget memory = RD::getSingleton().getMemoryBudget();
+
+	MemoryStats stats = {};
+	stats.usage = memory.usage;
+	stats.budget = memory.budget;
+
+	for (ObjectID texture : _streamedTextures) {
+		const TextureRD &_texture = _textures[texture];
+
+		stats.textureResidentSize += _getResidentSize(*_texture.source, _texture.residentLevel);
+		stats.textureFullSize += _getResidentSize(*_texture.source, 0);
+	}
+
+	stats.streamedTextureCount = static_cast<uint32_t>(_streamedTextures.size());
+
+	for (const auto &[mesh, streamed] : _streamedMeshes) {
+		if (streamed.isResident) {
+			stats.geometryResidentSize += streamed.size;
+			stats.residentMeshCount++;
+		}
+
+		stats.geometryFullSize += streamed.size;
+	}
+
+	stats.streamedMeshCount = static_cast<uint32_t>(_streamedMeshes.size());
+	stats.uploadRequestCount = static_cast<uint32_t>(_uploadScheduler.getRequestCount());
+	stats.uploadCancelledCount = _uploadScheduler.getCancelledCount();
+
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++)
+		stats.categories[i] = MemoryTracker::getStats(static_cast<MemoryCategory>(i));
+
+	stats.tracked = MemoryTracker::getTotalStats();
+
+	VmaStatistics allocator = RD::getSingleton().getAllocatorStatistics();
+	stats.allocationBytes = allocator.allocationBytes;
+	stats.blockBytes = allocator.blockBytes;
+	stats.allocationCount = allocator.allocationCount;
+	stats.blockCount = allocator.blockCount;
+
+	return stats;
+}
+
+vk::Instance RS::getVkInstance() const {
+	return RD::getSingleton().getInstance();
+}
+
+void RS::_deviceInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
+	RD &rd = RD::getSingleton();
 	rd.windowInit(surface, width, height);
 
+	_ownerThreadId = std::this_thread::get_id();
+
+	if (_useGpuCulling) {
+		bool multiDraw = rd.getPhysicalDevice().getFeatures().multiDrawIndirect;
+		_gpuCuller.initialize(rd.getDevice(), rd.getDescriptorPool(), multiDraw);
+	}
+
+	if (_useImpostors)
+		_impostorBaker.initialize(rd.getDevice(), rd.getAllocator(), rd.getDescriptorPool());
+
 	{
 		std::vector<uint8_t> data = { 255, 255, 255, 255 };
 		std::shared_ptr<Image> albedo(new Image(1, 1, Image::Format::RGBA8, data));
@@ -369,31 +4662,671 @@ void RS::windowInit(SDL_Window *pWindow) {
 	}
 
 	{
-		std::vector<uint8_t> data = { 0 };
-		std::shared_ptr<Image> metallic(new Image(1, 1, Image::Format::R8, data));
+		// factors alone decide, as with glTF material without map
+		std::vector<uint8_t> data = { 255, 255 };
+		std::shared_ptr<Image> metallicRoughness(new Image(1, 1, Image::Format::RG8, data));
+
+		_metallicRoughnessFallback = rd.textureCreate(metallicRoughness);
+	}
+
+	// every pipeline exists by now, saved right away so later crash does not lose it
+	rd.pipelineCacheSave();
+}
+
+bool RS::_isClientCall() const {
+	return _isRenderThreadRunning.load(std::memory_order_acquire) &&
+			std::this_thread::get_id() != _renderThreadId;
+}
+
+bool RS::_isBackgroundCall() const {
+	return !_isRenderThreadRunning.load(std::memory_order_acquire) &&
+			_ownerThreadId != std::thread::id() && std::this_thread::get_id() != _ownerThreadId;
+}
+
+bool RS::_isRecordedCall() const {
+	if (!_recorder.isRecording())
+		return false;
+
+	// queued calls were recorded when they were made
+	return !_isRenderThreadRunning.load(std::memory_order_acquire) ||
+			std::this_thread::get_id() != _renderThreadId;
+}
+
+void RS::_adoptBackground() {
+	// render thread runs queued adoptions itself
+	if (_isRenderThreadRunning.load(std::memory_order_acquire))
+		return;
+
+	CommandQueue::Command command;
+
+	while (_commands.pop(command))
+		command();
+}
+
+void RS::_push(CommandQueue::Command command) const {
+	_commands.push(std::move(command));
+}
+
+void RS::_pushSync(const std::function<void()> &call) const {
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool isDone = false;
+
+	_commands.push([&]() {
+		call();
+
+		// caller may return as soon as flag is seen, condition is notified under lock
+		std::lock_guard<std::mutex> lock(mutex);
+		isDone = true;
+		condition.notify_one();
+	});
+
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [&isDone] { return isDone; });
+}
+
+ObjectID RS::_toObject(ObjectID id) const {
+	if (id == NULL_HANDLE)
+		return NULL_HANDLE;
+
+	auto it = _clientObjects.find(id);
+	return it != _clientObjects.end() ? it->second : NULL_HANDLE;
+}
+
+RS::MaterialInfo RS::_toObjects(const MaterialInfo &info) const {
+	MaterialInfo objects = info;
+	objects.albedo = _toObject(info.albedo);
+	objects.normal = _toObject(info.normal);
+	objects.metallicRoughness = _toObject(info.metallicRoughness);
+	objects.lightmap = _toObject(info.lightmap);
+
+	return objects;
+}
 
-		_metallicFallback = rd.textureCreate(metallic);
+void RS::_runOnClient(const std::function<void()> &call) {
+	if (!_isRenderThreadRunning.load(std::memory_order_acquire)) {
+		call();
+		return;
 	}
 
+	std::lock_guard<std::mutex> lock(_clientCallMutex);
+	_clientCalls.push_back(call);
+}
+
+void RS::_markChanged() {
+	_changeCount.fetch_add(1);
+}
+
+void RS::_runClientCalls() {
+	std::vector<std::function<void()>> calls;
+
 	{
-		std::vector<uint8_t> data = { 127 };
-		std::shared_ptr<Image> roughness(new Image(1, 1, Image::Format::R8, data));
+		std::lock_guard<std::mutex> lock(_clientCallMutex);
+		calls.swap(_clientCalls);
+	}
+
+	for (const std::function<void()> &call : calls)
+		call();
+}
+
+void RS::_renderThreadLoop() {
+	while (!_isRenderThreadStopping) {
+		CommandQueue::Command command;
+
+		if (!_commands.pop(command)) {
+			_commands.wait();
+			continue;
+		}
+
+		command();
+	}
+}
+
+void RS::_renderThreadStart() {
+	if (!_useRenderThread || _isRenderThreadRunning.load())
+		return;
+
+	_isRenderThreadStopping = false;
+	_renderThread = std::thread(&RS::_renderThreadLoop, this);
+	_renderThreadId = _renderThread.get_id();
+
+	_isRenderThreadRunning.store(true, std::memory_order_release);
+}
+
+bool RS::isThreaded() const {
+	return _isRenderThreadRunning.load(std::memory_order_acquire);
+}
+
+void RS::finish() {
+	_recorder.end();
+
+	if (!_isClientCall())
+		return;
+
+	_push([this]() { _isRenderThreadStopping = true; });
+	_renderThread.join();
+
+	_isRenderThreadRunning.store(false, std::memory_order_release);
+
+	// captures delivered by last frames
+	_runClientCalls();
+}
+
+void RS::windowInit(SDL_Window *pWindow) {
+	VkSurfaceKHR surface;
+	SDL_Vulkan_CreateSurface(pWindow, RD::getSingleton().getInstance(), nullptr, &surface);
+
+	int width, height;
+	SDL_GetWindowSizeInPixels(pWindow, &width, &height);
+	_deviceInit(surface, width, height);
+
+	_renderThreadStart();
+}
+
+void RS::headlessInit(uint32_t width, uint32_t height) {
+	_deviceInit(VK_NULL_HANDLE, width, height);
+
+	_renderThreadStart();
+}
+
+bool RS::isHeadless() const {
+	return RD::getSingleton().isHeadless();
+}
+
+void RS::_deliverCaptures() {
+	for (const Readback &readback : RD::getSingleton().readbackCollect()) {
+		auto it = _captures.find(readback.id);
+
+		if (it == _captures.end())
+			continue;
+
+		std::shared_ptr<Image> image;
+		std::vector<uint8_t> pixels = readback.pixels;
+
+		bool isBgra = readback.format == vk::Format::eB8G8R8A8Srgb ||
+				readback.format == vk::Format::eB8G8R8A8Unorm;
+		bool isRgba = readback.format == vk::Format::eR8G8B8A8Srgb ||
+				readback.format == vk::Format::eR8G8B8A8Unorm ||
+				readback.format == vk::Format::eA8B8G8R8SrgbPack32 ||
+				readback.format == vk::Format::eA8B8G8R8UnormPack32;
+
+		if (isBgra || isRgba) {
+			// alpha tonemap writes is not coverage
+			for (size_t i = 0; i < pixels.size(); i += 4) {
+				if (isBgra)
+					std::swap(pixels[i], pixels[i + 2]);
 
-		_roughnessFallback = rd.textureCreate(roughness);
+				pixels[i + 3] = 255;
+			}
+
+			image = std::make_shared<Image>(
+					readback.width, readback.height, Image::Format::RGBA8, std::move(pixels));
+		} else {
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Capture of %s can not be converted!",
+					vk::to_string(readback.format).c_str());
+		}
+
+		for (const CaptureCallback &callback : it->second)
+			_runOnClient([callback, image]() { callback(image); });
+
+		_captures.erase(it);
+	}
+}
+
+bool RS::requestCapture(const CaptureCallback &callback) {
+	_markChanged();
+
+	RD &rd = RD::getSingleton();
+
+	if (!rd.isReadbackSupported())
+		return false;
+
+	// frame counted next is the one of draw queued next
+	if (_isClientCall()) {
+		_push([this, callback]() { requestCapture(callback); });
+		return true;
+	}
+
+	// next draw counts its frame first
+	uint64_t frame = _frameCount + 1;
+
+	rd.readbackRequest(frame);
+	_captures[frame].push_back(callback);
+
+	return true;
+}
+
+void RS::captureWait() {
+	if (_isClientCall()) {
+		_pushSync([this]() { captureWait(); });
+		_runClientCalls();
+		return;
+	}
+
+	RD::getSingleton().readbackWait();
+	_deliverCaptures();
+}
+
+void RS::pipelineCacheSave() {
+	if (_isClientCall()) {
+		_pushSync([this]() { pipelineCacheSave(); });
+		return;
 	}
+
+	RD::getSingleton().pipelineCacheSave();
+}
+
+bool RS::isRedrawNeeded() const {
+	return _changeCount.load() != _drawnChangeCount.load() || _settleFrameCount.load() > 0;
+}
+
+void RS::requestRedraw() {
+	_markChanged();
 }
 
 void RS::windowResized(uint32_t width, uint32_t height) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		_push([this, width, height]() { windowResized(width, height); });
+		return;
+	}
+
 	RD::getSingleton().windowResize(width, height);
 }
 
+ObjectID RS::windowAdd(SDL_Window *pWindow, const glm::vec4 &rect) {
+	_markChanged();
+
+	VkSurfaceKHR surface;
+
+	if (!SDL_Vulkan_CreateSurface(pWindow, RD::getSingleton().getInstance(), nullptr, &surface))
+		return NULL_HANDLE;
+
+	int width, height;
+	SDL_GetWindowSizeInPixels(pWindow, &width, &height);
+
+	if (_isClientCall()) {
+		ObjectID id = _nextClientId++;
+		_push([this, id, surface, width, height, rect]() {
+			_clientObjects[id] = RD::getSingleton().windowAdd(surface, width, height, rect);
+		});
+		return id;
+	}
+
+	return RD::getSingleton().windowAdd(surface, width, height, rect);
+}
+
+void RS::windowRemove(ObjectID window) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		_push([this, window]() {
+			windowRemove(_toObject(window));
+			_clientObjects.erase(window);
+		});
+		return;
+	}
+
+	RD::getSingleton().windowRemove(window);
+}
+
+void RS::windowSetSize(ObjectID window, uint32_t width, uint32_t height) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		_push([this, window, width, height]() {
+			windowSetSize(_toObject(window), width, height);
+		});
+		return;
+	}
+
+	RD::getSingleton().windowSetSize(window, width, height);
+}
+
+void RS::windowSetRect(ObjectID window, const glm::vec4 &rect) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		_push([this, window, rect]() { windowSetRect(_toObject(window), rect); });
+		return;
+	}
+
+	RD::getSingleton().windowSetRect(window, rect);
+}
+
+void RS::setPresentMode(vk::PresentModeKHR presentMode) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		_push([this, presentMode]() { setPresentMode(presentMode); });
+		return;
+	}
+
+	RD::getSingleton().setPresentMode(presentMode);
+}
+
+vk::PresentModeKHR RS::getPresentMode() const {
+	if (_isClientCall())
+		return _getSync(&RS::getPresentMode);
+
+	return RD::getSingleton().getPresentMode();
+}
+
+void RS::setRenderScale(float scale) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetRenderScale, scale);
+
+	if (_isClientCall()) {
+		_push([this, scale]() { setRenderScale(scale); });
+		return;
+	}
+
+	RD::getSingleton().setRenderScale(scale);
+}
+
+float RS::getRenderScale() const {
+	if (_isClientCall())
+		return _getSync(&RS::getRenderScale);
+
+	return RD::getSingleton().getRenderScale();
+}
+
+void RS::setQuality(const QualitySettings &settings) {
+	_markChanged();
+
+	if (_isRecordedCall())
+		_recorder.record(CallRecorder::Op::SetQuality, settings);
+
+	if (_isClientCall()) {
+		_push([this, settings]() { setQuality(settings); });
+		return;
+	}
+
+	_lodBias = settings.lodBias;
+	RD::getSingleton().setQuality(settings);
+}
+
+std::vector<UploadBenchmarkCase> RS::measureUploads(const UploadBenchmarkSettings &settings) {
+	if (_isClientCall()) {
+		std::vector<UploadBenchmarkCase> cases;
+		_pushSync([&]() { cases = measureUploads(settings); });
+
+		return cases;
+	}
+
+	return UploadBenchmark::run(settings);
+}
+
+QualitySettings RS::getQuality() const {
+	if (_isClientCall())
+		return _getSync(&RS::getQuality);
+
+	return RD::getSingleton().getQuality();
+}
+
+void RS::setDynamicResolution(float targetMilliseconds, float minScale) {
+	_markChanged();
+
+	if (_isClientCall()) {
+		_push([this, targetMilliseconds, minScale]() {
+			setDynamicResolution(targetMilliseconds, minScale);
+		});
+		return;
+	}
+
+	RD::getSingleton().setDynamicResolution(targetMilliseconds, minScale);
+}
+
+float RS::getDynamicScale() const {
+	if (_isClientCall())
+		return _getSync(&RS::getDynamicScale);
+
+	return RD::getSingleton().getDynamicScale();
+}
+
+vk::Extent2D RS::getRenderExtent() const {
+	if (_isClientCall())
+		return _getSync(&RS::getRenderExtent);
+
+	return RD::getSingleton().getRenderExtent();
+}
+
+void RS::setLowLatency(bool isEnabled) {
+	if (_isClientCall()) {
+		_push([this, isEnabled]() { setLowLatency(isEnabled); });
+		return;
+	}
+
+	_isLowLatency = isEnabled;
+}
+
+bool RS::isLowLatencyEnabled() const {
+	if (_isClientCall())
+		return _getSync(&RS::isLowLatencyEnabled);
+
+	return _isLowLatency;
+}
+
+void RS::frameWait() {
+	// queued after last draw, returns once that is recorded and device waited for
+	if (_isClientCall()) {
+		_pushSync([this]() { frameWait(); });
+		return;
+	}
+
+	if (_isLowLatency || RD::getSingleton().getFrameRateLimit() > 0.0f)
+		RD::getSingleton().frameWait();
+}
+
+void RS::setFrameRateLimit(float rate) {
+	if (_isClientCall()) {
+		_push([this, rate]() { setFrameRateLimit(rate); });
+		return;
+	}
+
+	RD::getSingleton().setFrameRateLimit(rate);
+}
+
+float RS::getFrameRateLimit() const {
+	if (_isClientCall())
+		return _getSync(&RS::getFrameRateLimit);
+
+	return RD::getSingleton().getFrameRateLimit();
+}
+
 void RS::initialize(int argc, char **argv) {
 	bool useValidation = false;
+	bool useBindless = false;
+	bool useDeferred = false;
+	bool useHeadless = false;
+	uint32_t threadCount = 1;
+	uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	std::optional<vk::PresentModeKHR> presentMode;
+	std::optional<UpscaleFilter> upscaleFilter;
+	std::optional<ShadingRateMode> shadingRateMode;
+	std::optional<QualityPreset> qualityPreset;
+	std::optional<float> renderScale;
+	float targetMilliseconds = 0.0f;
+	float skyLod = 0.0f;
+	float frameRateLimit = 0.0f;
+	bool useAdaptivePrepass = false;
+	std::optional<uint32_t> lightBudget;
+	std::optional<uint32_t> cubemapSize;
+	std::optional<uint32_t> textureSize;
+	bool useHitchLog = false;
+	const char *pDeviceSelection = nullptr;
+	const char *pCallLog = nullptr;
 
 	for (int i = 1; i < argc; i++) {
 		if (strcmp("--validation", argv[i]) == 0)
 			useValidation = true;
+
+		if (strcmp("--bindless", argv[i]) == 0)
+			useBindless = true;
+
+		if (strcmp("--deferred", argv[i]) == 0)
+			useDeferred = true;
+
+		// --gpu <index|name>, part of name matches ignoring case, discrete GPUs are preferred
+		// otherwise
+		if (strcmp("--gpu", argv[i]) == 0 && i < argc - 1)
+			pDeviceSelection = argv[i + 1];
+
+		// --threads <count>
+		if (strcmp("--threads", argv[i]) == 0 && i < argc - 1)
+			threadCount = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+
+		if (strcmp("--gpu-culling", argv[i]) == 0)
+			_useGpuCulling = true;
+
+		// depth and material passes are recorded once per scene change, not per frame
+		if (strcmp("--cached-commands", argv[i]) == 0)
+			_useCachedCommands = true;
+
+		// textures are uploaded once an instance using them is first visible, materials sample
+		// fallbacks until then
+		if (strcmp("--lazy-textures", argv[i]) == 0)
+			_useLazyTextures = true;
+
+		// meshes are uploaded once an instance of them comes near camera and evicted once
+		// nobody was near them for a while, see GEOMETRY_STREAMING_BUDGET
+		if (strcmp("--geometry-streaming", argv[i]) == 0)
+			_useGeometryStreaming = true;
+
+		// primitives of a mesh sharing a material are drawn by one draw, fragmented exports
+		// draw far fewer
+		if (strcmp("--merge-primitives", argv[i]) == 0)
+			_useMergedPrimitives = true;
+
+		// instances hidden behind large opaque meshes are culled on the CPU before queues are
+		// built, see OcclusionRasterizer
+		if (strcmp("--occlusion-culling", argv[i]) == 0)
+			_useOcclusionCulling = true;
+
+		// far instances of detailed meshes draw captured quads, see IMPOSTOR_DISTANCE
+		if (strcmp("--impostors", argv[i]) == 0)
+			_useImpostors = true;
+
+		// --impostor-distance <meters>
+		if (strcmp("--impostor-distance", argv[i]) == 0 && i < argc - 1)
+			_impostorDistance = std::max(static_cast<float>(atof(argv[i + 1])), 0.0f);
+
+		// --frames-in-flight <count>, 1 for lowest latency, 3 for throughput
+		if (strcmp("--frames-in-flight", argv[i]) == 0 && i < argc - 1)
+			framesInFlight = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+
+		// --present-mode <fifo|fifo-relaxed|mailbox|immediate>
+		if (strcmp("--present-mode", argv[i]) == 0 && i < argc - 1)
+			presentMode = _parsePresentMode(argv[i + 1]);
+
+		if (strcmp("--low-latency", argv[i]) == 0)
+			_isLowLatency = true;
+
+		// --fps-limit <rate>, frames sleep until input of next one is due
+		if (strcmp("--fps-limit", argv[i]) == 0 && i < argc - 1)
+			frameRateLimit = std::max(static_cast<float>(atof(argv[i + 1])), 0.0f);
+
+		// --quality <low|medium|high|ultra>, flags below override single settings of preset
+		if (strcmp("--quality", argv[i]) == 0 && i < argc - 1)
+			qualityPreset = _parseQualityPreset(argv[i + 1]);
+
+		// --render-scale <fraction>, 0.25 renders a quarter of width and height
+		if (strcmp("--render-scale", argv[i]) == 0 && i < argc - 1)
+			renderScale = static_cast<float>(atof(argv[i + 1]));
+
+		// --dynamic-resolution <milliseconds>, GPU frame time resolution is lowered to hold
+		if (strcmp("--dynamic-resolution", argv[i]) == 0 && i < argc - 1)
+			targetMilliseconds = static_cast<float>(atof(argv[i + 1]));
+
+		// depth prepass is skipped while GPU time of scene is lower without it
+		if (strcmp("--adaptive-prepass", argv[i]) == 0)
+			useAdaptivePrepass = true;
+
+		// --shading-rate <off|draw|image>, coarse shading of far and flat draws, and of tiles
+		// with little luminance variance in previous frame with image
+		if (strcmp("--shading-rate", argv[i]) == 0 && i < argc - 1)
+			shadingRateMode = _parseShadingRateMode(argv[i + 1]);
+
+		// --light-budget <count>, least important point lights in view beyond it are not shaded
+		if (strcmp("--light-budget", argv[i]) == 0 && i < argc - 1)
+			lightBudget = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 0));
+
+		// --cubemap-size <size>, largest face of sky cubemap
+		if (strcmp("--cubemap-size", argv[i]) == 0 && i < argc - 1)
+			cubemapSize = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+
+		// --max-texture-size <size>, largest side of images loaded, 0 for no limit
+		if (strcmp("--max-texture-size", argv[i]) == 0 && i < argc - 1)
+			textureSize = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 0));
+
+		// frames far slower than median are logged with CPU and GPU zones of their own
+		if (strcmp("--hitch-log", argv[i]) == 0)
+			useHitchLog = true;
+
+		// --sky-lod <level>, blurrier sky for low detail look
+		if (strcmp("--sky-lod", argv[i]) == 0 && i < argc - 1)
+			skyLod = static_cast<float>(atof(argv[i + 1]));
+
+		// --upscale <nearest|sharp|temporal>
+		if (strcmp("--upscale", argv[i]) == 0 && i < argc - 1)
+			upscaleFilter = _parseUpscaleFilter(argv[i + 1]);
+
+		// batch renders and thumbnails run on servers without display
+		if (strcmp("--render-jobs", argv[i]) == 0 || strcmp("--thumbnails", argv[i]) == 0)
+			useHeadless = true;
+
+		// started once window or headless init is done
+		if (strcmp("--render-thread", argv[i]) == 0)
+			_useRenderThread = true;
+
+		// --record-calls <file>, for replay with --replay
+		if (strcmp("--record-calls", argv[i]) == 0 && i < argc - 1)
+			pCallLog = argv[i + 1];
 	}
 
-	RD::getSingleton().init(useValidation);
+	RD::getSingleton().init(
+			useValidation, useBindless, useDeferred, framesInFlight, useHeadless);
+
+	if (pDeviceSelection != nullptr)
+		RD::getSingleton().setDeviceSelection(pDeviceSelection);
+
+	if (presentMode.has_value())
+		RD::getSingleton().setPresentMode(presentMode.value());
+
+	QualitySettings quality = getQualitySettings(qualityPreset.value_or(QualityPreset::High));
+
+	if (renderScale.has_value())
+		quality.renderScale = renderScale.value();
+	if (lightBudget.has_value())
+		quality.pointLightBudget = lightBudget.value();
+	if (cubemapSize.has_value())
+		quality.maxCubemapSize = cubemapSize.value();
+	if (textureSize.has_value())
+		quality.maxTextureSize = textureSize.value();
+
+	// before window init, first swapchain and attachments are created with it
+	_lodBias = quality.lodBias;
+	RD::getSingleton().setQuality(quality);
+	RD::getSingleton().setDynamicResolution(targetMilliseconds);
+	RD::getSingleton().setAdaptivePrepass(useAdaptivePrepass);
+
+	if (shadingRateMode.has_value())
+		RD::getSingleton().setShadingRateMode(shadingRateMode.value());
+
+	if (upscaleFilter.has_value())
+		RD::getSingleton().setUpscaleFilter(upscaleFilter.value());
+
+	RD::getSingleton().setSkyLod(skyLod);
+	RD::getSingleton().setFrameRateLimit(frameRateLimit);
+	RD::getSingleton().setHitchReporting(useHitchLog);
+
+	// single thread records inline into primary buffer
+	_recordThreadCount = std::min(threadCount, JobSystem::getThreadCount());
+
+	// settings above come from flags replay is started with as well
+	if (pCallLog != nullptr)
+		_recorder.begin(pCallLog);
 }
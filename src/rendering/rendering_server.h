@@ -1,21 +1,180 @@
 #ifndef RENDERING_SERVER_H
 #define RENDERING_SERVER_H
 
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include <io/image.h>
+#include <io/light_probes.h>
+#include <io/reflection_probes.h>
 #include <io/mesh.h>
 
+#include "call_recorder.h"
+#include "culling/aabb_tree.h"
+#include "culling/frustum_culler.h"
+#include "culling/gpu_culler.h"
+#include "culling/occlusion_rasterizer.h"
+#include "culling/portal_culler.h"
+#include "command_queue.h"
+#include "effects/impostor_baker.h"
+#include "gpu_profiler.h"
+#include "memory_tracker.h"
 #include "object_owner.h"
+#include "readback_ring.h"
+#include "render_queue.h"
+#include "scratch_arena.h"
 #include "storage/light_storage.h"
+#include "storage/particle_storage.h"
+#include "upload_benchmark.h"
+#include "upload_scheduler.h"
 
+#include "types/atmosphere.h"
 #include "types/camera.h"
+#include "types/frame.h"
+#include "types/quality.h"
 #include "types/resource.h"
+#include "types/terrain.h"
 
 #define NULL_HANDLE 0
 
+// textures with pre-built levels start with levels up to this size only, finer ones are
+// streamed in as visible instances ask for them
+const uint32_t TEXTURE_TAIL_SIZE = 64;
+// memory streamed textures may take, levels nobody asked for lately are dropped to fit
+const uint64_t TEXTURE_STREAMING_BUDGET = 512 * 1024 * 1024;
+// frames request is kept for, texture not seen for longer can go back to its tail
+const uint64_t TEXTURE_REQUEST_FRAMES = 120;
+// --geometry-streaming, geometry streamed meshes may take, meshes nobody came near lately are
+// evicted to fit
+const uint64_t GEOMETRY_STREAMING_BUDGET = 256 * 1024 * 1024;
+// instances this close to camera, or to where its velocity takes it, ask for their mesh
+const float GEOMETRY_STREAMING_RADIUS = 128.0f;
+const float GEOMETRY_STREAMING_LOOKAHEAD_FRAMES = 60.0f;
+// frames request is kept for, mesh not asked for longer can be evicted
+const uint64_t GEOMETRY_REQUEST_FRAMES = 120;
+// bytes texture and geometry streaming upload per frame together, most important first, see
+// UploadScheduler
+const uint64_t STREAMING_UPLOAD_BUDGET = 16 * 1024 * 1024;
+// emitters are not culled, textures they draw with rank like a visible mesh covering this many
+// pixels at camera
+const float PARTICLE_UPLOAD_PRIORITY = 256.0f;
+// part of device budget renderer fills, rest is headroom for other applications and driver
+const float MEMORY_BUDGET_USAGE = 0.9f;
+
+// bounds of one defragmentation pass, pass ends once frames sampling moved textures finish
+const uint64_t DEFRAGMENTATION_BYTES_PER_PASS = 16 * 1024 * 1024;
+const uint32_t DEFRAGMENTATION_MOVES_PER_PASS = 64;
+
+// instances at least this far from view are shaded coarse with shading rate enabled
+const float SHADING_RATE_FAR_DISTANCE = 64.0f;
+
+// --impostors, instances of meshes with at least this many triangles are drawn as impostors
+// beyond this distance, --impostor-distance <meters> overrides it
+const float IMPOSTOR_DISTANCE = 150.0f;
+const uint32_t IMPOSTOR_MIN_TRIANGLE_COUNT = 256;
+
+// --occlusion-culling, occluders drawn into depth buffer per frame, instances are occluders
+// while their bounds radius is at least this fraction of their distance
+const uint32_t OCCLUSION_MAX_OCCLUDER_COUNT = 24;
+const float OCCLUDER_MIN_SIZE = 0.25f;
+
+// captured frame as RGBA8 of sRGB values, null when its format could not be converted
+typedef std::function<void(std::shared_ptr<Image>)> CaptureCallback;
+
+struct DefragmentationStats {
+	// see RenderingDevice::getFragmentation, measured when run starts and ends
+	float fragmentationBefore = 0.0f;
+	float fragmentationAfter = 0.0f;
+
+	uint64_t bytesMoved = 0;
+	uint32_t allocationsMoved = 0;
+};
+
+struct MemoryStats {
+	// device local heaps, whole process
+	uint64_t usage = 0;
+	uint64_t budget = 0;
+
+	// levels of streamed textures on GPU and size they would take whole
+	uint64_t textureResidentSize = 0;
+	uint64_t textureFullSize = 0;
+	uint32_t streamedTextureCount = 0;
+
+	// packed geometry of streamed meshes in arena and of all of them
+	uint64_t geometryResidentSize = 0;
+	uint64_t geometryFullSize = 0;
+	uint32_t streamedMeshCount = 0;
+	uint32_t residentMeshCount = 0;
+
+	// uploads waiting behind budget of frame and obsolete ones dropped by last frame
+	uint32_t uploadRequestCount = 0;
+	uint32_t uploadCancelledCount = 0;
+
+	// live and peak of allocations made by renderer, indexed by MemoryCategory
+	MemoryCategoryStats categories[static_cast<size_t>(MemoryCategory::Count)];
+	MemoryCategoryStats tracked;
+
+	// every allocation of allocator, tracked or not, and memory blocks holding them
+	uint64_t allocationBytes = 0;
+	uint64_t blockBytes = 0;
+	uint32_t allocationCount = 0;
+	uint32_t blockCount = 0;
+};
+
+// counts of last drawn frame, for regression triage
+struct FrameStats {
+	// depth and material passes together, fullscreen passes are not counted
+	uint32_t drawCount = 0;
+	uint32_t instanceCount = 0;
+	uint64_t triangleCount = 0;
+	uint32_t pipelineBindCount = 0;
+	uint32_t setBindCount = 0;
+	uint32_t pushConstantCount = 0;
+
+	// instances with a mesh and those rejected before drawing, with GPU culling read back
+	// frames in flight later
+	uint32_t submittedInstanceCount = 0;
+	uint32_t culledInstanceCount = 0;
+
+	// staged for transfer since previous frame
+	uint64_t uploadedBytes = 0;
+
+	uint32_t directionalLightCount = 0;
+	uint32_t pointLightCount = 0;
+	uint32_t shadowedLightCount = 0;
+};
+
+// closest surface ray cast found
+struct RaycastHit {
+	ObjectID meshInstance = 0;
+	// index into primitives of mesh of instance as it was created
+	uint32_t primitive = 0;
+	// primitive it was merged into with --merge-primitives, same as primitive otherwise
+	uint32_t drawnPrimitive = 0;
+	// first index of triangle in index array of primitive
+	uint32_t firstIndex = 0;
+
+	// along normalized ray direction
+	float distance = 0.0f;
+	glm::vec3 position = glm::vec3(0.0f);
+	// world space, follows triangle winding rather than facing ray
+	glm::vec3 normal = glm::vec3(0.0f);
+};
+
 struct SDL_Window;
 class Image;
 
@@ -33,23 +192,558 @@ public:
 	struct MaterialInfo {
 		ObjectID albedo;
 		ObjectID normal;
-		ObjectID metallic;
-		ObjectID roughness;
+		// metallic in red channel, roughness in green channel
+		ObjectID metallicRoughness;
+		// irradiance of baked lights, RGBA16F sampled with lightmap uv, none for dynamic lighting
+		ObjectID lightmap;
+
+		// maps are multiplied by factors, missing ones take factor alone, defaults match glTF
+		glm::vec4 albedoFactor = glm::vec4(1.0f);
+		glm::vec3 emissiveFactor = glm::vec3(0.0f);
+		float metallicFactor = 1.0f;
+		float roughnessFactor = 1.0f;
+
+		// offset and size of map within its texture, for textures packed into atlases
+		glm::vec4 albedoRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		glm::vec4 normalRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		glm::vec4 metallicRoughnessRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+		// normal map is applied in tangent frame derived per pixel, meshes drawn with material
+		// need no tangents then
+		bool deriveTangents = false;
+
+		// pixels with albedo alpha below half are discarded, with albedo map and without normal
+		// map only
+		bool alphaTest = false;
+	};
+
+	// emitter space is its transform, defaults emit nothing
+	struct ParticleEmitterInfo {
+		// particles per second
+		float rate = 0.0f;
+		// seconds
+		float lifetime = 1.0f;
+
+		// emitter space, spread is random speed added in any direction
+		glm::vec3 velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+		float spread = 0.0f;
+		// world space, drag takes its fraction of velocity every second
+		glm::vec3 acceleration = glm::vec3(0.0f);
+		float drag = 0.0f;
+
+		// scale of mesh at birth and death, linear in between
+		float sizeBegin = 1.0f;
+		float sizeEnd = 1.0f;
+		// particles spawn within it around emitter origin
+		float radius = 0.0f;
+
+		// particles alive at once, emission stalls while all of them are
+		uint32_t capacity = 1024;
 	};
 
 private:
 	// fallbacks
 	TextureRD _albedoFallback;
 	TextureRD _normalFallback;
-	TextureRD _metallicFallback;
-	TextureRD _roughnessFallback;
+	TextureRD _metallicRoughnessFallback;
+
+	typedef struct {
+		Camera camera;
+		// offset and size within render extent, normalized
+		glm::vec4 rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	} View;
+
+	// views share culling, queues and one render pass, shadows and temporal history follow
+	// the first one
+	std::array<View, MAX_VIEW_COUNT> _views;
+	uint32_t _viewCount = 1;
 
-	Camera _camera;
 	ObjectOwner<MeshRD> _meshes;
+	// primitives of every mesh in one array, each mesh owns a range, queues are built scanning
+	// it in place
+	std::vector<PrimitiveRD> _primitiveTable;
+	RangeAllocator _primitiveRanges;
 	ObjectOwner<MeshInstanceRD> _meshInstances;
 	ObjectOwner<TextureRD> _textures;
 	ObjectOwner<MaterialRD> _materials;
 
+	typedef struct {
+		ObjectID mesh = 0;
+		glm::mat4 transform = glm::mat4(1.0f);
+		ParticleEmitterInfo info;
+
+		// empty without mesh or room in particle pool
+		ParticleStorage::Range range = {};
+		// range is new, its lists start over next frame
+		bool isReset = false;
+		// fraction of particle emission owes next frame
+		float emitRemainder = 0.0f;
+	} ParticleEmitterRD;
+
+	ObjectOwner<ParticleEmitterRD> _particleEmitters;
+
+	// indirect draw of emitter primitive, command is in buffer of particle storage
+	typedef struct {
+		vk::IndexType indexType;
+		uint32_t permutation;
+		ObjectID textureSetId;
+		uint32_t command;
+	} ParticleDraw;
+
+	std::vector<ParticleDraw> _particleDraws;
+	// counts changes of draws above, passes cached with older ones are recorded again
+	uint64_t _particleVersion = 0;
+	// of last simulation step, 0 before first one
+	uint64_t _particleTime = 0;
+
+	// sets by textures they hold, sets written before a texture was swapped are left out
+	ObjectOwner<TextureSetRD> _textureSets;
+	std::map<std::array<ObjectID, MATERIAL_TEXTURE_COUNT>, ObjectID> _textureSetIds;
+
+	// textures with source kept on CPU, frame count ages their requests
+	std::vector<ObjectID> _streamedTextures;
+	bool _useLazyTextures = false;
+	uint64_t _frameCount = 0;
+	// lists of render thread built anew every frame, reset once draw begins
+	ScratchArena _scratch;
+	// of streamed textures and budget of this frame, promotions drained this frame check them
+	uint64_t _textureResidentSize = 0;
+	uint64_t _textureStreamingBudget = 0;
+	// false while eviction or defragmentation holds streaming back
+	bool _canPromoteTextures = false;
+	// last frame device budget forced eviction
+	uint64_t _evictionFrame = 0;
+
+	// by frame count of captured frame, every request of one frame shares its readback
+	std::map<uint64_t, std::vector<CaptureCallback>> _captures;
+
+	typedef struct {
+		ObjectID texture;
+		TextureRD src;
+		TextureRD dst;
+	} TextureMove;
+
+	// textures are moved by copy recorded in frame pass began in, frame 0 is no pass
+	VmaDefragmentationContext _defragmentation = VK_NULL_HANDLE;
+	VmaDefragmentationPassMoveInfo _defragmentationPass = {};
+	uint64_t _defragmentationPassFrame = 0;
+	std::vector<TextureMove> _textureMoves;
+
+	// memory of moving texture is owned by pass until it ends
+	std::vector<ObjectID> _pendingTextureFrees;
+	std::vector<std::pair<ObjectID, std::shared_ptr<Image>>> _pendingTextureUpdates;
+	// last frame texture memory was queued for destruction
+	uint64_t _textureDestroyFrame = 0;
+
+	DefragmentationStats _defragmentationStats;
+
+	// instances with mesh, user data is their id, frustum query narrows what culler tests
+	AABBTree _instanceTree;
+	std::vector<uint64_t> _treeResults;
+
+	FrustumCuller _culler;
+	std::vector<MeshInstanceRD *> _cullCandidates;
+	// cells seen from views, instances in other cells are left out before culler tests them
+	PortalCuller _portalCuller;
+
+	// --occlusion-culling, instances hidden behind largest occluders on screen are left out
+	// of queues, single view only
+	bool _useOcclusionCulling = false;
+	OcclusionRasterizer _occlusionRasterizer;
+	// size on screen and index into cull candidates
+	std::vector<std::pair<float, uint32_t>> _occluders;
+	// of CPU culling, GPU culler has its own
+	CullStats _cullStats;
+	std::vector<uint32_t> _visibleIndices;
+	std::vector<uint32_t> _viewVisibleIndices;
+
+	// instances surviving culling, shared by depth and material subpass
+	std::vector<const MeshInstanceRD *> _visibleInstances;
+
+	// skinned instances whose joints changed, posed by next frames as skin storage fits them
+	std::vector<ObjectID> _posingInstances;
+	// morphed instances whose weights changed, likewise
+	std::vector<ObjectID> _morphingInstances;
+
+	RenderQueue _depthQueue;
+	RenderQueue _materialQueue;
+
+	DrawStats _depthStats;
+	DrawStats _materialStats;
+	FrameStats _frameStats;
+	uint64_t _uploadedBytes = 0;
+
+	// instance transforms of both queues, uploaded once per frame
+	std::vector<InstanceTransform> _instanceTransforms;
+	std::vector<InstanceTransform> _instanceNormals;
+	std::vector<uint32_t> _instanceMaterials;
+
+	// gpu driven path, queue holds every instance and is rebuilt only on scene change
+	bool _useGpuCulling = false;
+	bool _isLowLatency = false;
+	// instances, meshes or materials changed since queues were built
+	bool _isQueueDirty = true;
+	// counts queue builds, passes cached from older queues are recorded again
+	uint64_t _queueVersion = 0;
+
+	GpuCuller _gpuCuller;
+	RenderQueue _gpuQueue;
+
+	// every instance casts shadow, rebuilt only on scene change like gpu queue
+	bool _isShadowQueueDirty = true;
+
+	RenderQueue _shadowQueue;
+	std::vector<InstanceTransform> _shadowTransforms;
+	std::vector<uint32_t> _shadowMaterials;
+
+	// secondary command buffers are recorded as jobs in this many chunks when more than one
+	uint32_t _recordThreadCount = 1;
+	std::vector<vk::CommandBuffer> _secondaryBuffers;
+	std::vector<DrawStats> _secondaryStats;
+
+	// --cached-commands keeps depth and material passes in secondary buffers per frame in flight,
+	// they are recorded again only once queues or state they were recorded with change
+	typedef struct {
+		vk::CommandBuffer depth;
+		vk::CommandBuffer material;
+		DrawStats depthStats;
+		DrawStats materialStats;
+
+		uint64_t queueVersion;
+		uint64_t particleVersion;
+		uint64_t terrainVersion;
+		uint64_t setVersion;
+		vk::Framebuffer framebuffer;
+		vk::Extent2D extent;
+		uint32_t scenePermutation;
+		bool isDepthPrepass;
+	} CachedPasses;
+
+	bool _useCachedCommands = false;
+	CachedPasses _cachedPasses[MAX_FRAMES_IN_FLIGHT] = {};
+
+	// visible instances and levels queues were built from, cpu culling path keeps queues while
+	// camera moves without changing them
+	std::vector<const MeshInstanceRD *> _queuedInstances;
+	std::vector<uint32_t> _queuedLods;
+
+	// counts calls changing what is drawn, draw remembers count it started with
+	std::atomic<uint64_t> _changeCount{ 1 };
+	std::atomic<uint64_t> _drawnChangeCount{ 0 };
+	// frames still drawn after last change or while work like texture streaming goes on
+	std::atomic<uint32_t> _settleFrameCount{ 0 };
+	// textures were promoted by last frame
+	bool _isStreaming = false;
+
+	// with render thread, calls from other threads are queued and run again on it
+	mutable CommandQueue _commands;
+	std::thread _renderThread;
+	std::thread::id _renderThreadId;
+	std::atomic<bool> _isRenderThreadRunning{ false };
+	bool _useRenderThread = false;
+	// render thread only
+	bool _isRenderThreadStopping = false;
+
+	// ids handed out by queued creates, render thread maps them to objects once it made them
+	std::atomic<ObjectID> _nextClientId{ 1 };
+	std::unordered_map<ObjectID, ObjectID> _clientObjects;
+
+	// draw waits for draw queued before it, so client is at most one frame ahead
+	uint64_t _queuedDrawCount = 0;
+	uint64_t _drawnCount = 0;
+	std::mutex _drawMutex;
+	std::condition_variable _drawCondition;
+
+	// capture callbacks of render thread, run by draw and captureWait of client
+	std::mutex _clientCallMutex;
+	std::vector<std::function<void()>> _clientCalls;
+
+	// --record-calls <file>, calls are recorded on thread making them, with ids it sees
+	CallRecorder _recorder;
+
+	// mesh ready for upload, indices relative to it until geometry arena places them
+	typedef struct {
+		std::vector<PackedPosition> positions;
+		std::vector<PackedAttributes> attributes;
+		// empty for mesh without skin
+		std::vector<PackedSkin> skins;
+		// headers of moved vertices followed by their deltas, empty for mesh without targets
+		std::vector<PackedMorph> morphs;
+		uint32_t morphMovedCount = 0;
+		std::vector<uint32_t> indices;
+
+		std::vector<PrimitiveRD> primitives;
+		AABB aabb;
+		glm::mat4 dequantize;
+		std::vector<float> lodErrors;
+		std::shared_ptr<const MeshBVH> bvh;
+		std::vector<uint32_t> primitiveRemap;
+		// null unless occlusion culling is on, see OcclusionRasterizer::buildOccluder
+		std::shared_ptr<const OccluderMesh> occluder;
+	} PackedMesh;
+
+	// --geometry-streaming, meshes without skin or targets keep packed geometry on CPU and have
+	// none in arena while evicted, their instances are culled as usual but draw nothing
+	typedef struct {
+		// indices and primitives relative to mesh
+		PackedMesh source;
+		uint64_t size;
+		bool isResident;
+
+		uint64_t requestFrame;
+		// of nearest instance asking for mesh this frame
+		float requestDistance;
+		// highest of instances asking for mesh this frame, see UploadScheduler::getPriority
+		float requestPriority;
+	} StreamedMeshRD;
+
+	bool _useGeometryStreaming = false;
+	std::unordered_map<ObjectID, StreamedMeshRD> _streamedMeshes;
+	// resident meshes nobody asked for lately, least recently asked first, loads of this frame
+	// evict them in order
+	std::vector<ObjectID> _staleMeshes;
+	size_t _evictedMeshCount = 0;
+	uint64_t _geometryResidentSize = 0;
+	// loaded or evicted this frame
+	std::vector<ObjectID> _changedMeshes;
+
+	// pending textures, finer texture levels and evicted meshes share upload budget of frame
+	UploadScheduler _uploadScheduler;
+	std::vector<UploadRequest> _drainedUploads;
+	// of first view last frame, velocity is taken from it
+	glm::vec3 _streamingPosition = glm::vec3(0.0f);
+
+	// creates loader threads made, owner thread adopts them before it looks objects up
+	std::thread::id _ownerThreadId;
+
+	// render thread runs and call is not made on it
+	bool _isClientCall() const;
+	// no render thread and call is not made on thread that initialized server
+	bool _isBackgroundCall() const;
+	// recording and call is not one render thread runs again
+	bool _isRecordedCall() const;
+	// owner thread only, no-op with render thread
+	void _adoptBackground();
+	void _push(CommandQueue::Command command) const;
+	// returns once render thread ran call
+	void _pushSync(const std::function<void()> &call) const;
+
+	template <typename T> T _getSync(T (RenderingServer::*getter)() const) const {
+		T value = {};
+		_pushSync([&]() { value = (this->*getter)(); });
+
+		return value;
+	}
+
+	// render thread only, ids not known yet or freed give null handle
+	ObjectID _toObject(ObjectID id) const;
+	MaterialInfo _toObjects(const MaterialInfo &info) const;
+	// without render thread call runs at once
+	void _runOnClient(const std::function<void()> &call);
+	void _runClientCalls();
+
+	void _renderThreadLoop();
+	void _renderThreadStart();
+	// called first by every call which changes what is drawn, on calling thread
+	void _markChanged();
+
+	// public creates record id they return
+	ObjectID _meshCreate(const Mesh &mesh);
+	ObjectID _meshInstanceCreate();
+	std::vector<ObjectID> _meshInstanceCreateBatch(uint32_t count);
+	ObjectID _lightCreate(LightType type);
+	ObjectID _textureCreate(const std::shared_ptr<Image> image);
+	ObjectID _materialCreate(const MaterialInfo &info);
+	ObjectID _particleEmitterCreate();
+
+	// --merge-primitives, primitives sharing a material are drawn as one
+	bool _useMergedPrimitives = false;
+
+	// --impostors, meshes without skin or targets with enough triangles are captured one at a
+	// time and get quads of ImpostorBaker::buildQuads, their instances beyond impostor distance
+	// draw those instead, shadows and gpu culling keep drawing meshes
+	typedef struct {
+		ObjectID mesh;
+		ObjectID material;
+		ObjectID texture;
+	} ImpostorRD;
+
+	bool _useImpostors = false;
+	float _impostorDistance = IMPOSTOR_DISTANCE;
+
+	// of quality settings, scales pixels views see instances cover
+	float _lodBias = 0.0f;
+	ImpostorBaker _impostorBaker;
+	std::deque<ObjectID> _impostorQueue;
+	// of source meshes
+	std::unordered_map<ObjectID, ImpostorRD> _impostors;
+	// mesh of capture in flight, null once it was freed or replaced meanwhile
+	ObjectID _impostorBakeMesh = NULL_HANDLE;
+	uint64_t _impostorBakeFrame = 0;
+
+	bool _isImpostorCandidate(const PackedMesh &packed) const;
+	// after drawBegin, next mesh of queue whose geometry is resident
+	void _recordImpostorBake(vk::CommandBuffer commandBuffer);
+	// before queues are built, once frame of capture finished
+	void _collectImpostor();
+	// impostor of mesh goes once no frame draws it, queued capture too
+	void _impostorFree(ObjectID mesh);
+
+	static PackedMesh _packMesh(
+			const Mesh &mesh, bool mergePrimitives, bool buildOccluder = false);
+	// indices are laid out again so every merged primitive is one range, levels missing in some
+	// of its primitives repeat their last one, meshlets keep their triangles
+	static void _mergePrimitives(PackedMesh &packed);
+	// uploads geometry, skins and morph targets, primitives are moved out of packed
+	MeshRD _meshUpload(PackedMesh &packed);
+	// table grows as needed, queues point into it and are built again then
+	void _primitivesInsert(MeshRD &mesh, std::vector<PrimitiveRD> &&primitives);
+	void _primitivesFree(MeshRD &mesh);
+	const PrimitiveRD *_getPrimitives(const MeshRD &mesh) const;
+	// reserved id is filled in instead of a new one
+	ObjectID _meshInsert(PackedMesh &packed, ObjectID reserved = NULL_HANDLE);
+	// streamed mesh while evicted, keeps bounds, levels and triangles of ray casts only
+	static MeshRD _meshEvicted(const PackedMesh &packed);
+	// of vertices and indices in arena
+	static uint64_t _getPackedSize(const PackedMesh &packed);
+	// uploads source or frees ranges once no frame draws from them
+	void _setMeshResident(ObjectID mesh, StreamedMeshRD &streamed, bool isResident);
+	// meshes of instances near camera and ahead of it ask to be loaded, ones seen last frame and
+	// covering more pixels first
+	void _streamGeometry(const glm::vec3 &viewPosition, float lodScale);
+	// within memory budget, evicts stale meshes to make room
+	bool _loadMesh(ObjectID mesh);
+	// old ranges are freed once no frame draws from them, instances are bound to new ones
+	void _meshReplace(ObjectID mesh, PackedMesh &packed);
+	// levels past tail are streamed when image has pre-built ones
+	TextureRD _createTexture(const std::shared_ptr<Image> image);
+	// waits for defragmentation when it moves texture, not recorded
+	void _textureFree(ObjectID texture);
+	ObjectID _textureInsert(const TextureRD &_texture, ObjectID reserved = NULL_HANDLE);
+
+	// bounds, tree leaf and draw transform follow transform and mesh
+	void _updateInstance(ObjectID id, MeshInstanceRD &meshInstance);
+	// queues instance for posing once both skinned mesh and joints are set
+	void _requestPose(ObjectID id, MeshInstanceRD &meshInstance);
+	// instance goes back to bind pose of its mesh until posed again
+	void _freePose(MeshInstanceRD &meshInstance);
+	// before any pass drawing instances
+	void _recordSkinning(vk::CommandBuffer commandBuffer);
+	// queues instance for morphing once both morphed mesh and weights are set
+	void _requestMorph(ObjectID id, MeshInstanceRD &meshInstance);
+	// instance goes back to base shape of its mesh until morphed again
+	void _freeMorph(MeshInstanceRD &meshInstance);
+	// before skinning, instances morphed here are posed again from their new shape
+	void _recordMorphing(vk::CommandBuffer commandBuffer);
+	// range follows mesh and capacity, emitter without room draws nothing
+	void _allocateParticles(ObjectID id, ParticleEmitterRD &emitter);
+	// emits and simulates every emitter, before any pass drawing particles
+	void _updateParticles(vk::CommandBuffer commandBuffer);
+	// after batches of pass, pipelines are bound as in _recordQueue
+	void _recordParticles(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout,
+			bool bindMaterials, bool bindPipelines, DrawStats &stats);
+	// missing textures fall back, old material is destroyed once no frame reads it
+	MaterialRD _createMaterial(const MaterialInfo &info);
+	void _destroyMaterialDeferred(const MaterialRD &material);
+	// defaults for freed materials, read in place instead of copied per primitive
+	const MaterialRD &_getMaterial(ObjectID material) const;
+	// texture set of material, shared with others sampling the same textures
+	ObjectID _acquireTextureSet(const std::array<TextureRD, MATERIAL_TEXTURE_COUNT> &textures,
+			const std::array<ObjectID, MATERIAL_TEXTURE_COUNT> &ids);
+	void _releaseTextureSet(ObjectID textureSet);
+	// camera of view as drawn this frame
+	typedef struct {
+		glm::mat4 proj;
+		glm::mat4 view;
+		glm::mat4 invProj;
+		glm::mat4 invView;
+		glm::mat4 projView;
+		glm::vec3 position;
+		float aspect;
+		// pixels covered by one unit at distance of one
+		float lodScale;
+		// in pixels of render extent
+		vk::Rect2D rect;
+	} ViewState;
+
+	// instances visible in any of the views, levels of detail are selected for the view
+	// seeing them largest
+	void _cullInstances(const ViewState *pViews, uint32_t viewCount);
+	// drops visible indices hidden behind occluders among them
+	void _cullOccluded(const ViewState &view);
+
+	// textures of instance ask for level matching pixels instance covers, ranked by them
+	void _requestTextureLevels(
+			const MeshInstanceRD &meshInstance, float pixelScale, float distance, bool isVisible);
+	// level texture should have resident, tail once its request is old
+	uint32_t _getStreamingTarget(const TextureRD &texture) const;
+	// swaps image and recreates materials sampling it
+	void _setResidentLevel(ObjectID texture, uint32_t level);
+	// materials sampling texture get new descriptors
+	void _updateTextureMaterials(ObjectID texture);
+	// returns bytes freed, least recently requested textures go first, requested levels are
+	// dropped too once stale ones are gone and device is still over budget
+	uint64_t _evictTextures(uint64_t size, bool dropRequested);
+	// evicts to memory budget, then asks for promotions, requests are from earlier frames
+	void _streamTextures();
+	// within memory budget of this frame
+	bool _promoteTexture(ObjectID texture);
+	// first upload of pending texture
+	bool _createQueuedTexture(ObjectID texture);
+	// pending texture asks to be created by next frames, others are left as they are
+	void _queueTexture(ObjectID texture, float priority);
+	// carries out requests of every streaming system in order of priority, within upload budget
+	// of frame
+	void _drainUploads();
+	// image materials bind for texture, fallback while it is missing or pending
+	const TextureRD &_getBoundTexture(ObjectID texture, const TextureRD &fallback) const;
+	// textures of pass swap to moved images before queues are built, copies are recorded once
+	// frame has begun
+	void _defragmentationBeginPass();
+	void _defragmentationRecord(vk::CommandBuffer commandBuffer);
+	void _defragmentationEndPass();
+	void _defragmentationEnd();
+	bool _isTextureMoving(ObjectID texture) const;
+
+	// surface is null when headless
+	void _deviceInit(vk::SurfaceKHR surface, uint32_t width, uint32_t height);
+	// runs callbacks of readbacks collected since last call
+	void _deliverCaptures();
+
+	// depth queue is sorted front to back from view position
+	void _buildQueues(const glm::vec3 &viewPosition);
+	bool _isVisibleSetChanged() const;
+	// after frame is recorded
+	void _updateFrameStats();
+	void _buildGpuQueue();
+	void _buildShadowQueue();
+	// with bindPipelines batches bind material pipeline of their permutation
+	void _recordQueue(vk::CommandBuffer commandBuffer, const RenderQueue &queue,
+			uint32_t firstBatch, uint32_t batchCount, vk::PipelineLayout pipelineLayout,
+			bool bindMaterials, bool bindPipelines, DrawStats &stats);
+
+	// batch range is ignored by gpu culling path, camera is read from uniform buffer, particles
+	// are drawn by one chunk of pass only
+	void _recordDepthPass(vk::CommandBuffer commandBuffer, uint32_t firstBatch,
+			uint32_t batchCount, bool drawParticles, DrawStats &stats);
+	void _recordSky(
+			vk::CommandBuffer commandBuffer, const glm::mat4 &invProj, const glm::mat4 &invView);
+	void _recordMaterialPass(vk::CommandBuffer commandBuffer, uint32_t firstBatch,
+			uint32_t batchCount, bool drawParticles, DrawStats &stats);
+	// after particles, pipeline and sets of its own
+	void _recordTerrain(vk::CommandBuffer commandBuffer, DrawStats &stats);
+
+	// deferred path, sky and g-buffer shading
+	void _recordLighting(
+			vk::CommandBuffer commandBuffer, const glm::mat4 &invProj, const glm::mat4 &invView);
+	void _recordThreaded(
+			vk::CommandBuffer commandBuffer, const glm::mat4 &invProj, const glm::mat4 &invView);
+	// passes cached for this frame, nothing they were recorded with changed since
+	bool _isCachedPassValid() const;
+	// sky and lighting are recorded every frame, their constants follow camera
+	void _recordCached(vk::CommandBuffer commandBuffer, bool isValid, const glm::mat4 &invProj,
+			const glm::mat4 &invView);
+
 public:
 	RenderingServer(RenderingServer const &) = delete;
 	void operator=(RenderingServer const &) = delete;
@@ -59,39 +753,233 @@ public:
 	void cameraSetZNear(float zNear);
 	void cameraSetZFar(float zFar);
 
+	// camera calls above change first view, views beyond count keep their state, near and far
+	// planes are shared by every view since clusters of light culling span one depth range
+	void viewSetCount(uint32_t count);
+	// offset and size within render extent, normalized
+	void viewSetRect(uint32_t view, const glm::vec4 &rect);
+	void viewSetTransform(uint32_t view, const glm::mat4 &transform);
+	void viewSetFovY(uint32_t view, float fovY);
+
+	// any thread, id made on loader thread is usable once handed to thread that drives server
 	ObjectID meshCreate(const Mesh &mesh);
+	// geometry is replaced in place, instances keep drawing mesh by same id
+	void meshUpdate(ObjectID mesh, const Mesh &sceneMesh);
 	void meshFree(ObjectID mesh);
 
 	ObjectID meshInstanceCreate();
+	std::vector<ObjectID> meshInstanceCreateBatch(uint32_t count);
 	void meshInstanceSetMesh(ObjectID meshInstance, ObjectID mesh);
 	void meshInstanceSetTransform(ObjectID meshInstance, const glm::mat4 &transform);
+	// pairs up instances and transforms, one queued call with render thread, invalid ones are
+	// skipped
+	void meshInstanceSetTransforms(
+			const std::vector<ObjectID> &meshInstances, const std::vector<glm::mat4> &transforms);
+	// joint matrices times inverse bind matrices, in space of instance, skinned mesh is drawn in
+	// bind pose until first call, see SceneGraph::meshInstanceSkin
+	void meshInstanceSetJoints(ObjectID meshInstance, const std::vector<glm::mat4> &joints);
+	// one per morph target of mesh, clamped to [-1, 1] so bounds of mesh hold every shape, mesh
+	// with targets is drawn in its base shape until first call, same weights cost nothing
+	void meshInstanceSetMorphWeights(ObjectID meshInstance, const std::vector<float> &weights);
 	void meshInstanceFree(ObjectID meshInstance);
+	// closest triangle of any instance along ray, instance tree gives candidates then their mesh
+	// trees are walked, false when nothing is closer than maxDistance
+	bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, RaycastHit &hit,
+			float maxDistance = INFINITY) const;
 
 	ObjectID lightCreate(LightType type);
 	void lightSetTransform(ObjectID light, const glm::mat4 &transform);
+	// like meshInstanceSetTransforms
+	void lightSetTransforms(
+			const std::vector<ObjectID> &lights, const std::vector<glm::mat4> &transforms);
 	void lightSetRange(ObjectID light, float range);
 	void lightSetColor(ObjectID light, const glm::vec3 &color);
 	void lightSetIntensity(ObjectID light, float intensity);
+	// see LightStorage::lightSetDrawDistance
+	void lightSetDrawDistance(ObjectID light, float distance);
+	// shadow atlas has MAX_SHADOW_COUNT tiles, light without free tile stays unshadowed
+	void lightSetShadow(ObjectID light, bool castsShadow);
+	// static light in lightmaps of materials, see LightStorage::lightSetBaked
+	void lightSetBaked(ObjectID light, bool isBaked);
 	void lightFree(ObjectID light);
 
+	// any thread, like meshCreate
 	ObjectID textureCreate(const std::shared_ptr<Image> image);
+	// image is swapped in place, materials sampling texture keep it, unsupported format keeps
+	// old image
+	void textureUpdate(ObjectID texture, const std::shared_ptr<Image> image);
 	void textureFree(ObjectID texture);
 
 	ObjectID materialCreate(const MaterialInfo &info);
+	// textures are swapped in place, meshes keep using the same material
+	void materialUpdate(ObjectID material, const MaterialInfo &info);
 	void materialFree(ObjectID material);
 
+	// particles of emitter are instances of mesh simulated on GPU, drawn opaque, cast no shadows
+	ObjectID particleEmitterCreate();
+	// primitives past MAX_PARTICLE_PRIMITIVE_COUNT are not drawn, particles alive start over
+	void particleEmitterSetMesh(ObjectID emitter, ObjectID mesh);
+	// particles already emitted keep moving in world space
+	void particleEmitterSetTransform(ObjectID emitter, const glm::mat4 &transform);
+	// new capacity starts particles over
+	void particleEmitterSetInfo(ObjectID emitter, const ParticleEmitterInfo &info);
+	void particleEmitterFree(ObjectID emitter);
+
 	void setExposure(float exposure);
+	// exposure follows average luminance of frames, one set above is applied on top of it
+	void setAutoExposure(bool isEnabled);
 	void setWhite(float white);
+	// grade of tonemap pass, applied after its curve
+	void setTonemapLook(TonemapLook look);
+	// tonemap pass fetches its curve from a small volume, baked when white or look changes
+	void setTonemapLut(bool isEnabled);
+	// sky samples blurrier cubemap level, for retro look, zero for full detail
+	void setSkyLod(float lod);
+	// scene color is stretched to swapchain with it, sharp bilinear unless set
+	void setUpscaleFilter(UpscaleFilter filter);
+	// overdraw and mip level views cover forward material pass, light complexity is shown by
+	// deferred lighting too, colors skip exposure and tonemap curve
+	void setDebugView(DebugView view);
+	DebugView getDebugView() const;
 
-	void environmentSkyUpdate(const std::shared_ptr<Image> image);
+	// progressive bake suits animated skies, it is spread over frames and never cached
+	void environmentSkyUpdate(const std::shared_ptr<Image> image, bool isProgressive = false);
+	// procedural sky in place of baked one until next sky update, moving sun costs a small
+	// filter pass in the frame rather than a bake
+	void environmentAtmosphereSet(const Atmosphere &atmosphere);
+	// per roughness level, low counts give fast preview bakes
+	void environmentSetSpecularSampleCount(uint32_t level, uint32_t sampleCount);
+	// faces of sky cubemap are a quarter of source width up to size, small ones bake faster and
+	// take less memory, applies to bakes begun afterwards
+	void environmentSetMaxCubemapSize(uint32_t size);
+	// sky visibility probes ambient and reflections are scaled by, empty grid turns them off
+	void lightProbesSet(const LightProbeGrid &grid);
+	// of slot below MAX_REFLECTION_PROBE_COUNT, capture is baked in background after sky bakes,
+	// null capture frees slot
+	void reflectionProbeSet(
+			uint32_t index, const ReflectionProbe &probe, const std::shared_ptr<Image> image);
+	// clipmap around first view, heightmap is kept in host memory and streamed, null heightmap
+	// turns terrain off, null splat map shows first layer alone
+	void terrainSet(const Terrain &terrain, const std::shared_ptr<Image> heightmap,
+			const std::shared_ptr<Image> splatmap = nullptr);
+	// albedo of splat map channel below MAX_TERRAIN_LAYER_COUNT, square of TERRAIN_LAYER_SIZE
+	void terrainLayerSet(uint32_t index, const std::shared_ptr<Image> image);
+	// cells and portals CPU culling sees interior through, see PortalCuller, empty graph turns
+	// it off, GPU culling ignores it
+	void cellPortalsSet(const CellPortalGraph &graph);
 
+	// with render thread waits until previous frame is recorded and queues this one, client
+	// simulates next frame while render thread records it
 	void draw();
 
+	// statistics of last drawn frame
+	DrawStats getDepthDrawStats() const;
+	DrawStats getMaterialDrawStats() const;
+	CullStats getCullStats() const;
+	// calculates allocator statistics, for reports rather than every frame
+	MemoryStats getMemoryStats() const;
+	FrameStats getFrameStats() const;
+	// rolling averages of passes after "frame" spanning all of them, read frames in flight
+	// later, empty without timestamp support
+	std::vector<GpuTiming> getGpuTimings() const;
+	// CPU timeline of last presented frame, median frame time and hitches so far
+	FramePacingStats getFramePacingStats() const;
+	// whether CPU, GPU or presentation paced last frames, classified frames in flight late, see
+	// BoundAnalyzer
+	FrameBoundStats getFrameBoundStats() const;
+	// shader invocations of depth, sky or lighting, material and tonemap passes, read frames in
+	// flight after enabling, cached passes are counted too, false without device support
+	bool setPipelineStatistics(bool isEnabled);
+	std::vector<PipelineStats> getPipelineStats() const;
+	// steps of initialize and windowInit, instance creation runs along with window creation
+	// when initialize is called off main thread
+	StartupStats getStartupStats() const;
+
+	// moves textures of texture pool a pass at a time until it is compacted, buffers and render
+	// targets stay where they are
+	void defragmentationStart();
+	bool isDefragmenting() const;
+	// of last run
+	DefragmentationStats getDefragmentationStats() const;
+
 	vk::Instance getVkInstance() const;
 
 	void windowInit(SDL_Window *pWindow);
 	void windowResized(uint32_t width, uint32_t height);
 
+	// after windowInit, another window shows rect of every frame, normalized within it, pass
+	// rect of a view to show that view alone, NULL_HANDLE when window can not be presented to
+	ObjectID windowAdd(
+			SDL_Window *pWindow, const glm::vec4 &rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	void windowRemove(ObjectID window);
+	void windowSetSize(ObjectID window, uint32_t width, uint32_t height);
+	void windowSetRect(ObjectID window, const glm::vec4 &rect);
+
+	// in place of windowInit, needs --render-jobs or --thumbnails at initialization, frames go to
+	// offscreen images of given size
+	void headlessInit(uint32_t width, uint32_t height);
+	bool isHeadless() const;
+
+	// tonemapped frame drawn next is copied to host and handed to callback on thread calling
+	// draw as many frames later as there are in flight, nothing waits for it, false when
+	// swapchain images can not be read back
+	bool requestCapture(const CaptureCallback &callback);
+	// blocks until callback of every requested capture has run
+	void captureWait();
+
+	// swapchain is recreated with it after next frame, fifo is used when surface lacks it
+	void setPresentMode(vk::PresentModeKHR presentMode);
+	vk::PresentModeKHR getPresentMode() const;
+
+	// fraction of swapchain extent scene is rendered at, 1/2, 1/3 and so on keep pixels square
+	// for pixel art, swapchain is recreated with it after next frame
+	void setRenderScale(float scale);
+	float getRenderScale() const;
+
+	// render scale, light budget and sizes of sky and shadow maps at once, see QualitySettings,
+	// only settings which differ from last call are applied, formats only before window init
+	void setQuality(const QualitySettings &settings);
+	QualitySettings getQuality() const;
+
+	// blocks until every case ran, nothing else is drawn meanwhile, see UploadBenchmark
+	std::vector<UploadBenchmarkCase> measureUploads(const UploadBenchmarkSettings &settings);
+
+	// scale drops below render scale, down to minScale of it, while GPU frame time is over
+	// target, no target turns it off
+	void setDynamicResolution(
+			float targetMilliseconds, float minScale = DYNAMIC_RESOLUTION_MIN_SCALE);
+	float getDynamicScale() const;
+	vk::Extent2D getRenderExtent() const;
+
+	// frameWait blocks until GPU is done with frame recorded next, and where present wait is
+	// supported until previous frame is on screen
+	void setLowLatency(bool isEnabled);
+	bool isLowLatencyEnabled() const;
+	// has to be called before input of frame is sampled, returns at once without low latency
+	// or frame rate limit
+	void frameWait();
+	// frames per second frameWait holds frames to, sleeping through idle time, 0 for none
+	void setFrameRateLimit(float rate);
+	float getFrameRateLimit() const;
+
+	// written to user cache directory, next start creates pipelines from it
+	void pipelineCacheSave();
+
+	// any thread, true once camera, a resource, the environment or window changed since last
+	// drawn frame, or while output still settles after that, clients drawing on demand skip
+	// draw otherwise
+	bool isRedrawNeeded() const;
+	// for changes server does not see, like exposed window contents
+	void requestRedraw();
+
+	// with --render-thread every call from another thread is queued and runs in order on
+	// render thread started by window or headless init, getters wait for calls before them,
+	// ids of queued creates are valid right away
+	bool isThreaded() const;
+	// render thread runs calls queued so far and exits, later calls run on calling thread, call
+	// log is closed
+	void finish();
+
 	void initialize(int argc, char **argv);
 };
 
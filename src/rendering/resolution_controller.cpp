@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "resolution_controller.h"
+
+void ResolutionController::setTarget(float milliseconds) {
+	_targetMilliseconds = std::max(milliseconds, 0.0f);
+	reset();
+}
+
+float ResolutionController::getTarget() const {
+	return _targetMilliseconds;
+}
+
+void ResolutionController::setBounds(float minScale, float maxScale) {
+	_maxScale = std::clamp(maxScale, 0.0f, 1.0f);
+	_minScale = std::clamp(minScale, 0.0f, _maxScale);
+	_scale = std::clamp(_scale, _minScale, _maxScale);
+}
+
+float ResolutionController::update(float milliseconds) {
+	if (!isEnabled() || milliseconds <= 0.0f)
+		return _scale;
+
+	// positive while under budget
+	float error = (_targetMilliseconds - milliseconds) / _targetMilliseconds;
+
+	if (std::abs(error) < RESOLUTION_DEADBAND) {
+		_headroomCount = 0;
+		return _scale;
+	}
+
+	if (error > 0.0f) {
+		_headroomCount++;
+
+		if (_headroomCount < RESOLUTION_RAISE_DELAY)
+			return _scale;
+	} else {
+		_headroomCount = 0;
+	}
+
+	// no windup while scale is held at a bound
+	bool isSaturated = (error > 0.0f && _scale >= _maxScale) ||
+			(error < 0.0f && _scale <= _minScale);
+
+	if (!isSaturated)
+		_integral = std::clamp(
+				_integral + error, -RESOLUTION_INTEGRAL_LIMIT, RESOLUTION_INTEGRAL_LIMIT);
+
+	float step = RESOLUTION_PROPORTIONAL_GAIN * error + RESOLUTION_INTEGRAL_GAIN * _integral;
+	step = std::clamp(step, -RESOLUTION_MAX_STEP, RESOLUTION_MAX_STEP);
+
+	float area = _scale * _scale * (1.0f + step);
+	_scale = std::clamp(std::sqrt(area), _minScale, _maxScale);
+
+	return _scale;
+}
+
+float ResolutionController::getScale() const {
+	return _scale;
+}
+
+void ResolutionController::reset() {
+	_scale = _maxScale;
+	_integral = 0.0f;
+	_headroomCount = 0;
+}
+
+bool ResolutionController::isEnabled() const {
+	return _targetMilliseconds > 0.0f;
+}
@@ -0,0 +1,49 @@
+#ifndef RESOLUTION_CONTROLLER_H
+#define RESOLUTION_CONTROLLER_H
+
+#include <cstdint>
+
+// error within this fraction of target leaves scale as it is
+const float RESOLUTION_DEADBAND = 0.05f;
+
+// samples under budget in a row before scale is raised, it is lowered right away
+const uint32_t RESOLUTION_RAISE_DELAY = 30;
+
+// largest change of rendered area per sample, as fraction of it
+const float RESOLUTION_MAX_STEP = 0.1f;
+
+const float RESOLUTION_PROPORTIONAL_GAIN = 0.5f;
+const float RESOLUTION_INTEGRAL_GAIN = 0.05f;
+const float RESOLUTION_INTEGRAL_LIMIT = 4.0f;
+
+// Picks fraction of render extent to draw so GPU frame time holds a target. PI controller on
+// relative error drives rendered area, which GPU time roughly follows. Dropping resolution
+// reacts at once while raising it waits for steady headroom, so scale does not oscillate.
+class ResolutionController {
+private:
+	float _targetMilliseconds = 0.0f;
+	float _minScale = 0.5f;
+	float _maxScale = 1.0f;
+
+	float _scale = 1.0f;
+	float _integral = 0.0f;
+	uint32_t _headroomCount = 0;
+
+public:
+	// no target disables control, scale then stays at maximum
+	void setTarget(float milliseconds);
+	float getTarget() const;
+
+	void setBounds(float minScale, float maxScale);
+
+	// GPU time of one frame, returns scale of frames recorded from now on
+	float update(float milliseconds);
+	float getScale() const;
+
+	// back to maximum scale with no history
+	void reset();
+
+	bool isEnabled() const;
+};
+
+#endif // !RESOLUTION_CONTROLLER_H
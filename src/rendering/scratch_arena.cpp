@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include "scratch_arena.h"
+
+void *ScratchArena::allocate(size_t size, size_t alignment) {
+	size_t head = _head.load(std::memory_order_relaxed);
+	size_t offset;
+
+	do {
+		offset = (head + alignment - 1) & ~(alignment - 1);
+
+		// heap is what a vector would have used, frame goes on and size is raised later
+		if (offset + size > _size) {
+			_overflowCount.fetch_add(1, std::memory_order_relaxed);
+			return ::operator new(size);
+		}
+	} while (!_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+	return _pData.get() + offset;
+}
+
+void ScratchArena::deallocate(void *p) {
+	// comparing unrelated pointers is unspecified, addresses are not
+	uintptr_t address = reinterpret_cast<uintptr_t>(p);
+	uintptr_t begin = reinterpret_cast<uintptr_t>(_pData.get());
+
+	if (address < begin || address >= begin + _size)
+		::operator delete(p);
+}
+
+void ScratchArena::reset() {
+	_peakSize = std::max(_peakSize, _head.load(std::memory_order_relaxed));
+	_head.store(0, std::memory_order_relaxed);
+}
+
+size_t ScratchArena::getUsedSize() const {
+	return _head.load(std::memory_order_relaxed);
+}
+
+size_t ScratchArena::getPeakSize() const {
+	return std::max(_peakSize, _head.load(std::memory_order_relaxed));
+}
+
+uint64_t ScratchArena::getOverflowCount() const {
+	return _overflowCount.load(std::memory_order_relaxed);
+}
+
+ScratchArena::ScratchArena(size_t size) : _pData(new uint8_t[size]), _size(size) {}
@@ -0,0 +1,85 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// CPU data of one frame, allocations past it fall back to heap
+const size_t SCRATCH_ARENA_SIZE = 4 * 1024 * 1024;
+
+// Linear allocator of CPU data that lives for one frame, lists built anew every frame like joints
+// of posed instances or draws of particle systems. Allocating bumps an atomic head, freeing does
+// nothing and reset releases everything at once, so steady frames never reach heap. Requests that
+// do not fit go to heap and are counted, size can be raised until none do. Containers use it
+// through ScratchAllocator, any thread may allocate between two resets of its owner.
+class ScratchArena {
+private:
+	std::unique_ptr<uint8_t[]> _pData;
+	size_t _size;
+
+	std::atomic<size_t> _head{ 0 };
+	// of any frame since start
+	size_t _peakSize = 0;
+	std::atomic<uint64_t> _overflowCount{ 0 };
+
+public:
+	// alignment is a power of two no larger than that of max_align_t, never nullptr
+	void *allocate(size_t size, size_t alignment);
+	// only heap fallbacks are freed, memory of arena waits for reset
+	void deallocate(void *p);
+
+	// owner only, nothing allocated before may be used after
+	void reset();
+
+	size_t getUsedSize() const;
+	size_t getPeakSize() const;
+	// allocations that went to heap since start
+	uint64_t getOverflowCount() const;
+
+	ScratchArena(size_t size = SCRATCH_ARENA_SIZE);
+
+	ScratchArena(const ScratchArena &) = delete;
+	ScratchArena &operator=(const ScratchArena &) = delete;
+};
+
+// standard allocator over arena, containers of it must not outlive frame they were filled in
+template <typename T>
+class ScratchAllocator {
+private:
+	template <typename U>
+	friend class ScratchAllocator;
+
+	ScratchArena *_pArena;
+
+public:
+	typedef T value_type;
+
+	T *allocate(size_t count) {
+		return static_cast<T *>(_pArena->allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	void deallocate(T *p, size_t) {
+		_pArena->deallocate(p);
+	}
+
+	bool operator==(const ScratchAllocator &other) const {
+		return _pArena == other._pArena;
+	}
+
+	bool operator!=(const ScratchAllocator &other) const {
+		return _pArena != other._pArena;
+	}
+
+	ScratchAllocator(ScratchArena &arena) : _pArena(&arena) {}
+
+	template <typename U>
+	ScratchAllocator(const ScratchAllocator<U> &other) : _pArena(other._pArena) {}
+};
+
+template <typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+#endif // !SCRATCH_ARENA_H
@@ -0,0 +1,328 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include <io/environment_cache.h>
+#include <io/file_watcher.h>
+
+#include "shader_library.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// searched in order, same as shader_gen.py
+static const char *SHADER_DIRECTORIES[] = {
+	"src/rendering/shaders",
+	"src/rendering/effects/shaders",
+};
+
+typedef struct {
+	std::filesystem::path source;
+	// canonical, source and every file it includes
+	std::vector<std::filesystem::path> dependencies;
+	std::vector<uint32_t> code;
+} CompiledShader;
+
+static std::mutex _mutex;
+static bool _isHotReload = false;
+static std::filesystem::path _root;
+static std::filesystem::path _cacheDirectory;
+static FileWatcher _watcher;
+// by name and stage, entry without code failed to compile and falls back to built in one
+static std::map<std::pair<std::string, ShaderStage>, CompiledShader> _shaders;
+
+static const char *_getExtension(ShaderStage stage) {
+	switch (stage) {
+		case ShaderStage::Vertex:
+			return ".vert";
+		case ShaderStage::Fragment:
+			return ".frag";
+		default:
+			return ".comp";
+	}
+}
+
+static std::string _quote(const std::filesystem::path &path) {
+	return "\"" + path.string() + "\"";
+}
+
+// standard output of command, false when it fails
+static bool _run(const std::string &command, std::string &output) {
+	FILE *pPipe = popen(command.c_str(), "r");
+
+	if (pPipe == nullptr)
+		return false;
+
+	char buffer[4096];
+	size_t size;
+
+	while ((size = fread(buffer, 1, sizeof(buffer), pPipe)) > 0)
+		output.append(buffer, size);
+
+	return pclose(pPipe) == 0;
+}
+
+static bool _readCode(const std::filesystem::path &path, std::vector<uint32_t> &code) {
+	size_t size;
+	void *pData = SDL_LoadFile(path.string().c_str(), &size);
+
+	if (pData == nullptr)
+		return false;
+
+	bool isValid = size > 0 && size % sizeof(uint32_t) == 0;
+
+	if (isValid) {
+		code.resize(size / sizeof(uint32_t));
+		memcpy(code.data(), pData, size);
+	}
+
+	SDL_free(pData);
+	return isValid;
+}
+
+// prerequisites of make rule written by glslc -M, target is left out
+static std::vector<std::filesystem::path> _parseDependencies(const std::string &rule) {
+	std::vector<std::filesystem::path> dependencies;
+
+	size_t colon = rule.find(": ");
+	if (colon == std::string::npos)
+		return dependencies;
+
+	std::istringstream stream(rule.substr(colon + 1));
+	std::string token;
+
+	while (stream >> token) {
+		if (token == "\\")
+			continue;
+
+		std::error_code error;
+		std::filesystem::path path = std::filesystem::canonical(token, error);
+
+		if (!error)
+			dependencies.push_back(path);
+	}
+
+	return dependencies;
+}
+
+// code is kept as it was when compilation fails, glslc reports errors on standard error
+static bool _compile(CompiledShader &shader, ShaderStage stage) {
+	std::string source = _quote(shader.source);
+
+	// stage is told by extension, it goes into hash since it changes code
+	std::string preprocessed;
+
+	if (!_run("glslc -E " + source, preprocessed)) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Shader preprocessing failed: %s",
+				shader.source.string().c_str());
+		return false;
+	}
+
+	uint64_t hash = EnvironmentCache::hash(preprocessed.data(), preprocessed.size(),
+			EnvironmentCache::hash(&stage, sizeof(stage)));
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(hash));
+
+	std::filesystem::path cached = _cacheDirectory / name;
+	std::vector<uint32_t> code;
+
+	if (!_readCode(cached, code)) {
+		std::filesystem::path compiled = cached;
+		compiled += ".tmp";
+
+		std::string output;
+		bool isCompiled = _run("glslc -c " + source + " -o " + _quote(compiled), output);
+
+		if (!isCompiled || !_readCode(compiled, code)) {
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Shader compilation failed: %s",
+					shader.source.string().c_str());
+			return false;
+		}
+
+		// renamed into place, other runs never read part of a file
+		std::error_code error;
+		std::filesystem::rename(compiled, cached, error);
+	}
+
+	// includes are read again, edit may have added or removed some
+	std::string rule;
+
+	if (_run("glslc -M " + source, rule))
+		shader.dependencies = _parseDependencies(rule);
+
+	if (shader.dependencies.empty()) {
+		std::error_code error;
+		shader.dependencies.push_back(std::filesystem::canonical(shader.source, error));
+	}
+
+	for (const std::filesystem::path &dependency : shader.dependencies)
+		_watcher.watch(dependency);
+
+	shader.code = std::move(code);
+	return true;
+}
+
+bool ShaderLibrary::enableHotReload(const std::filesystem::path &root) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::string version;
+
+	if (!_run("glslc --version", version)) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Shader hot reload needs glslc on PATH!");
+		return false;
+	}
+
+	// next to pipeline cache, survives runs so unchanged shaders are not compiled again
+	char *pPath = SDL_GetPrefPath("hayaku", "cache");
+
+	if (pPath == nullptr)
+		return false;
+
+	std::filesystem::path cacheDirectory = std::filesystem::path(pPath) / "shaders";
+	SDL_free(pPath);
+
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+
+	if (error) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Shader cache directory creation failed: %s",
+				cacheDirectory.string().c_str());
+		return false;
+	}
+
+	_root = root;
+	_cacheDirectory = cacheDirectory;
+	_isHotReload = true;
+
+	return true;
+}
+
+bool ShaderLibrary::isHotReload() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _isHotReload;
+}
+
+std::vector<uint32_t> ShaderLibrary::getCode(
+		const std::string &name, ShaderStage stage, const uint32_t *pCode, size_t size) {
+	std::vector<uint32_t> builtin(pCode, pCode + size / sizeof(uint32_t));
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (!_isHotReload)
+		return builtin;
+
+	auto it = _shaders.find({ name, stage });
+
+	if (it == _shaders.end()) {
+		CompiledShader shader;
+
+		for (const char *pDirectory : SHADER_DIRECTORIES) {
+			std::filesystem::path source = _root / pDirectory / (name + _getExtension(stage));
+
+			if (std::filesystem::exists(source)) {
+				shader.source = source;
+				break;
+			}
+		}
+
+		// source which is missing is not looked for again
+		if (!shader.source.empty())
+			_compile(shader, stage);
+
+		it = _shaders.emplace(std::make_pair(name, stage), std::move(shader)).first;
+	}
+
+	return it->second.code.empty() ? builtin : it->second.code;
+}
+
+std::vector<std::string> ShaderLibrary::poll() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::vector<std::string> names;
+
+	if (!_isHotReload)
+		return names;
+
+	std::vector<std::filesystem::path> changed = _watcher.poll();
+
+	if (changed.empty())
+		return names;
+
+	for (auto &[key, shader] : _shaders) {
+		bool isChanged = false;
+
+		for (const std::filesystem::path &dependency : shader.dependencies)
+			for (const std::filesystem::path &path : changed)
+				isChanged = isChanged || dependency == path;
+
+		if (!isChanged)
+			continue;
+
+		std::vector<uint32_t> code = shader.code;
+
+		// saving a file without changing code rebuilds nothing
+		if (!_compile(shader, key.second) || shader.code == code)
+			continue;
+
+		SDL_Log("Shader reloaded: %s%s", key.first.c_str(), _getExtension(key.second));
+
+		bool isListed = false;
+
+		for (const std::string &name : names)
+			isListed = isListed || name == key.first;
+
+		if (!isListed)
+			names.push_back(key.first);
+	}
+
+	return names;
+}
+
+std::vector<vk::Pipeline> ShaderLibrary::rebuild(
+		const std::vector<PipelineRecipe> &recipes, const std::vector<std::string> &shaders) {
+	std::vector<std::pair<const PipelineRecipe *, std::future<vk::Pipeline>>> builds;
+
+	for (const PipelineRecipe &recipe : recipes)
+		for (const std::string &shader : shaders)
+			if (recipe.shader == shader)
+				builds.emplace_back(&recipe, std::async(std::launch::async, recipe.build));
+
+	std::vector<vk::Pipeline> replaced;
+
+	for (auto &[pRecipe, build] : builds) {
+		vk::Pipeline pipeline;
+
+		// builds which throw on failure at initialization keep their pipeline here
+		try {
+			pipeline = build.get();
+		} catch (const std::exception &e) {
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "%s", e.what());
+		}
+
+		if (!pipeline)
+			continue;
+
+		replaced.push_back(*pRecipe->pPipeline);
+		*pRecipe->pPipeline = pipeline;
+	}
+
+	return replaced;
+}
@@ -0,0 +1,50 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+enum class ShaderStage {
+	Vertex,
+	Fragment,
+	Compute,
+};
+
+// how pipeline is built from code of its shader, built again once shader is recompiled
+struct PipelineRecipe {
+	vk::Pipeline *pPipeline;
+	std::string shader;
+	std::function<vk::Pipeline()> build;
+};
+
+// Code of shaders by name, their file name without extension. Code is built into binary by
+// shader_gen.py, with hot reload sources are read from shader directories of source tree and
+// compiled with glslc, the compiler shader_gen.py runs. SPIR-V is cached on disk by hash of
+// preprocessed source, so shaders unchanged since last run or saved back to an earlier state
+// are not compiled again. Shader failing to compile keeps code it had. Any thread.
+class ShaderLibrary {
+public:
+	// root of source tree, false when glslc can not be run, before renderer is initialized
+	static bool enableHotReload(const std::filesystem::path &root);
+	static bool isHotReload();
+
+	// built in code unless hot reload compiled source of shader, size in bytes
+	static std::vector<uint32_t> getCode(
+			const std::string &name, ShaderStage stage, const uint32_t *pCode, size_t size);
+
+	// shaders recompiled since last poll because their source or one of its includes changed
+	static std::vector<std::string> poll();
+
+	// pipelines of shaders are built again in parallel, failed builds keep pipeline they had,
+	// returns replaced pipelines, caller destroys them once no submission uses them
+	static std::vector<vk::Pipeline> rebuild(const std::vector<PipelineRecipe> &recipes,
+			const std::vector<std::string> &shaders);
+};
+
+#endif // !SHADER_LIBRARY_H
@@ -1,15 +1,19 @@
 #version 450
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inTangent;
-layout(location = 3) in vec2 inUV;
-
-layout(push_constant) uniform MeshPushConstants {
-	mat4 projView;
-	mat4 model;
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/uniforms_incl.glsl"
+
+// PackedVertex, only position is read
+layout(location = 0) in vec4 inPosition;
+
+layout(set = 0, binding = 1) readonly buffer InstanceBuffer {
+	mat3x4 transforms[];
 };
 
 void main() {
-	gl_Position = projView * model * vec4(inPosition, 1.0);
+	// rows of affine transform
+	vec3 position = inPosition * transforms[gl_InstanceIndex];
+
+	gl_Position = projView * vec4(position, 1.0);
 }
@@ -0,0 +1,43 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/gbuffer_frag_incl.glsl"
+#include "include/material_data_incl.glsl"
+#include "include/permutation_incl.glsl"
+
+layout(set = 3, binding = 0) uniform sampler2D albedoSampler;
+layout(set = 3, binding = 1) uniform sampler2D normalSampler;
+// metallic in red channel, roughness in green channel
+layout(set = 3, binding = 2) uniform sampler2D metallicRoughnessSampler;
+
+void main() {
+	MaterialData material = materials[inMaterial];
+
+	vec3 albedo = FALLBACK_ALBEDO;
+	vec2 packedNormal = FALLBACK_NORMAL;
+	vec2 metallicRoughness = FALLBACK_METALLIC_ROUGHNESS;
+
+	if (HAS_ALBEDO_MAP) {
+		vec4 texel = SAMPLE_MAP(albedoSampler, material.albedoRect, inUV);
+
+		if (HAS_ALPHA_TEST && texel.a < ALPHA_TEST_CUTOFF)
+			discard;
+
+		albedo = texel.rgb;
+	}
+
+	if (HAS_NORMAL_MAP)
+		packedNormal = SAMPLE_MAP(normalSampler, material.normalRect, inUV).rg;
+
+	if (HAS_METALLIC_ROUGHNESS_MAP) {
+		vec4 rect = material.metallicRoughnessRect;
+		metallicRoughness = SAMPLE_MAP(metallicRoughnessSampler, rect, inUV).rg;
+	}
+
+	albedo *= material.albedoFactor.rgb;
+	float metallic = metallicRoughness.r * material.metallicFactor;
+	float roughness = metallicRoughness.g * material.roughnessFactor;
+
+	writeGBuffer(albedo, packedNormal, metallic, roughness);
+}
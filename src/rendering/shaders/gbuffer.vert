@@ -0,0 +1,5 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/material_vert_incl.glsl"
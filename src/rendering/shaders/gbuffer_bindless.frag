@@ -0,0 +1,46 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+#include "include/gbuffer_frag_incl.glsl"
+#include "include/material_data_incl.glsl"
+#include "include/permutation_incl.glsl"
+
+layout(set = 3, binding = 0) uniform sampler2D textures[];
+
+void main() {
+	MaterialData material = materials[inMaterial];
+
+	vec3 albedo = FALLBACK_ALBEDO;
+	vec2 packedNormal = FALLBACK_NORMAL;
+	vec2 metallicRoughness = FALLBACK_METALLIC_ROUGHNESS;
+
+	if (HAS_ALBEDO_MAP) {
+		uint index = material.albedo;
+		vec4 rect = material.albedoRect;
+		vec4 texel = SAMPLE_MAP(textures[nonuniformEXT(index)], rect, inUV);
+
+		if (HAS_ALPHA_TEST && texel.a < ALPHA_TEST_CUTOFF)
+			discard;
+
+		albedo = texel.rgb;
+	}
+
+	if (HAS_NORMAL_MAP) {
+		uint index = material.normal;
+		packedNormal = SAMPLE_MAP(textures[nonuniformEXT(index)], material.normalRect, inUV).rg;
+	}
+
+	if (HAS_METALLIC_ROUGHNESS_MAP) {
+		uint index = material.metallicRoughness;
+		vec4 rect = material.metallicRoughnessRect;
+		metallicRoughness = SAMPLE_MAP(textures[nonuniformEXT(index)], rect, inUV).rg;
+	}
+
+	albedo *= material.albedoFactor.rgb;
+	float metallic = metallicRoughness.r * material.metallicFactor;
+	float roughness = metallicRoughness.g * material.roughnessFactor;
+
+	writeGBuffer(albedo, packedNormal, metallic, roughness);
+}
@@ -0,0 +1,34 @@
+// has to match culling/light_culler.h
+const uint CLUSTER_X = 16u;
+const uint CLUSTER_Y = 9u;
+const uint CLUSTER_Z = 24u;
+const uint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+const uint MAX_LIGHTS_PER_CLUSTER = 128u;
+
+// has to match types/frame.h
+const uint MAX_VIEW_COUNT = 4u;
+
+// each view has clusters of its own, following those of views before it
+struct ClusterParams {
+	mat4 views[MAX_VIEW_COUNT];
+	mat4 invProjs[MAX_VIEW_COUNT];
+	float zNear;
+	float zFar;
+	uint lightCount;
+	uint viewCount;
+};
+
+// slices are exponential, so clusters keep roughly cubic shape with distance
+uint clusterSlice(float viewDepth, ClusterParams params) {
+	float slice = log(viewDepth / params.zNear) / log(params.zFar / params.zNear);
+	return uint(clamp(slice * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+}
+
+float clusterSliceDepth(uint slice, ClusterParams params) {
+	return params.zNear * pow(params.zFar / params.zNear, float(slice) / float(CLUSTER_Z));
+}
+
+uint clusterIndex(uvec3 cluster) {
+	return cluster.x + CLUSTER_X * (cluster.y + CLUSTER_Y * cluster.z);
+}
@@ -0,0 +1,27 @@
+// needs std_incl.glsl, has to match DebugView in rendering_device.h
+const uint DEBUG_VIEW_NONE = 0u;
+const uint DEBUG_VIEW_OVERDRAW = 1u;
+const uint DEBUG_VIEW_LIGHT_COMPLEXITY = 2u;
+const uint DEBUG_VIEW_MIP_LEVEL = 3u;
+
+// fragments shaded per pixel taken as fully red
+const float DEBUG_MAX_OVERDRAW = 8.0;
+// lights evaluated per pixel taken as fully red
+const float DEBUG_MAX_LIGHT_COUNT = 32.0;
+
+// blue through green and yellow to red, t in zero to one
+vec3 debugHeat(float t) {
+	t = saturate(t);
+
+	return vec3(saturate(t * 2.0 - 0.5), saturate(1.0 - abs(t * 2.0 - 1.0) * 1.5 + 0.5),
+			saturate(1.0 - t * 2.0));
+}
+
+// level of detail texture is sampled at, below zero texels are magnified and blurry (blue),
+// zero to one samples about a texel per pixel (green), past it mips are skipped (to red)
+vec3 debugMipLevel(float lod) {
+	if (lod < 0.0)
+		return mix(vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0), saturate(-lod * 0.5));
+
+	return mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), saturate((lod - 1.0) * 0.25));
+}
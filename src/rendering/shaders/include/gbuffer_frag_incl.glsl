@@ -0,0 +1,25 @@
+#include "std_incl.glsl"
+#include "tangent_frame_incl.glsl"
+#include "uniforms_incl.glsl"
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inTangent;
+layout(location = 3) in vec2 inUV;
+layout(location = 4) in vec3 inBitangent;
+
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal;
+layout(location = 2) out vec2 outMaterial;
+
+layout(early_fragment_tests) in;
+
+// shared by g-buffer variants, lighting is evaluated later once per pixel
+void writeGBuffer(vec3 albedo, vec2 packedNormal, float metallic, float roughness) {
+	mat3 tbn = tangentFrame(inPosition, inNormal, inTangent, inBitangent, inUV);
+	vec3 normal = unpackNormal(packedNormal, tbn);
+
+	outAlbedo = vec4(albedo, 1.0);
+	outNormal = vec4(normal * 0.5 + 0.5, 0.0);
+	outMaterial = vec2(metallic, roughness);
+}
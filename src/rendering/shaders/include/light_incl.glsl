@@ -1,6 +1,6 @@
 struct DirectionalLight {
 	vec3 direction;
-	float _padding;
+	int shadow;
 
 	vec3 color;
 	float intensity;
@@ -12,4 +12,18 @@ struct PointLight {
 
 	vec3 color;
 	float intensity;
+
+	int shadow;
+	uint _padding[3];
+};
+
+// shadow atlas tile, view is cascade or cube face
+struct Shadow {
+	mat4 viewProj[6];
+
+	// uv offset in xy, uv scale in zw
+	vec4 tile;
+
+	// far view depth of every cascade
+	vec4 splits;
 };
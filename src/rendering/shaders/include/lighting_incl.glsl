@@ -0,0 +1,350 @@
+#include "cluster_incl.glsl"
+#include "light_incl.glsl"
+#include "std_incl.glsl"
+#include "debug_incl.glsl"
+#include "uniforms_incl.glsl"
+
+layout(set = 1, binding = 0) uniform samplerCube specularSampler;
+layout(set = 1, binding = 1) uniform sampler2D lutSampler;
+
+// see LightProbeGrid, zero counts for no grid
+layout(set = 1, binding = 2) readonly buffer LightProbeSSBO {
+	vec4 probeOrigin;
+	vec4 probeSpacing;
+	uvec4 probeCounts;
+	vec4 probes[];
+};
+
+// see ReflectionProbeData, w of position is cube, w of box minimum blend distance
+struct ReflectionProbe {
+	vec4 position;
+	vec4 boxMin;
+	vec4 boxMax;
+};
+
+layout(set = 1, binding = 3) uniform samplerCubeArray reflectionProbeSampler;
+
+layout(set = 1, binding = 4) readonly buffer ReflectionProbeSSBO {
+	uvec4 reflectionProbeCount;
+	ReflectionProbe reflectionProbes[];
+};
+
+layout(set = 2, binding = 0) readonly buffer DirectionalLightSSBO {
+	DirectionalLight directionalLights[];
+};
+
+layout(set = 2, binding = 1) readonly buffer PointLightSSBO {
+	PointLight pointLights[];
+};
+
+layout(set = 2, binding = 2) uniform ClusterUniforms {
+	ClusterParams clusterParams;
+};
+
+layout(set = 2, binding = 3) readonly buffer ClusterSSBO {
+	uint clusterLightCounts[CLUSTER_COUNT * MAX_VIEW_COUNT];
+	uint clusterLightIndices[];
+};
+
+layout(set = 2, binding = 4) readonly buffer ShadowSSBO {
+	Shadow shadows[];
+};
+
+layout(set = 2, binding = 5) uniform sampler2DArrayShadow shadowAtlas;
+
+// scene without point lights skips cluster lookup, deferred lighting keeps default
+layout(constant_id = 3) const bool HAS_POINT_LIGHTS = true;
+
+// basis has to match effects/shaders/sh_project.comp
+vec3 evaluateIrradiance(vec3 n) {
+	vec3 result = irradianceSH[0].rgb * 0.282095;
+
+	result += irradianceSH[1].rgb * 0.488603 * n.y;
+	result += irradianceSH[2].rgb * 0.488603 * n.z;
+	result += irradianceSH[3].rgb * 0.488603 * n.x;
+
+	result += irradianceSH[4].rgb * 1.092548 * n.x * n.y;
+	result += irradianceSH[5].rgb * 1.092548 * n.y * n.z;
+	result += irradianceSH[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0);
+	result += irradianceSH[7].rgb * 1.092548 * n.x * n.z;
+	result += irradianceSH[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+
+	return max(result, vec3(0.0));
+}
+
+// trilinear blend of the 8 probes around point, clamped to grid
+vec4 sampleProbes(vec3 position, vec3 normal) {
+	// pushed off surface, so probes behind wall do not darken it
+	vec3 offset = position + normal * 0.25 * probeSpacing.xyz - probeOrigin.xyz;
+	vec3 cell = clamp(offset / probeSpacing.xyz, vec3(0.0), vec3(probeCounts.xyz - 1u));
+
+	uvec3 base = uvec3(cell);
+	uvec3 next = min(base + 1u, probeCounts.xyz - 1u);
+	vec3 t = cell - vec3(base);
+
+	vec4 result = vec4(0.0);
+
+	for (uint i = 0u; i < 8u; i++) {
+		bvec3 corner = bvec3(uvec3(i, i >> 1, i >> 2) & 1u);
+		uvec3 probe = mix(base, next, corner);
+		vec3 weights = mix(1.0 - t, t, corner);
+
+		uint index = (probe.z * probeCounts.y + probe.y) * probeCounts.x + probe.x;
+		result += probes[index] * (weights.x * weights.y * weights.z);
+	}
+
+	return result;
+}
+
+// box projected captures of probes around point, smallest boxes first, alpha is their total
+// weight and the rest is left to sky
+vec4 sampleReflectionProbes(vec3 position, vec3 dir, float lod) {
+	vec4 result = vec4(0.0);
+
+	for (uint i = 0u; i < reflectionProbeCount.x && result.a < 1.0; i++) {
+		ReflectionProbe probe = reflectionProbes[i];
+
+		vec3 toMin = position - probe.boxMin.xyz;
+		vec3 toMax = probe.boxMax.xyz - position;
+		vec3 inside = min(toMin, toMax);
+		float edge = min(min(inside.x, inside.y), inside.z);
+
+		if (edge <= 0.0)
+			continue;
+
+		// exit point of reflected ray, capture is sampled towards it
+		vec3 first = toMax / dir;
+		vec3 second = -toMin / dir;
+		vec3 furthest = max(first, second);
+		float distance = min(min(furthest.x, furthest.y), furthest.z);
+		vec3 projected = position + dir * distance - probe.position.xyz;
+
+		vec3 color = textureLod(reflectionProbeSampler, vec4(projected, probe.position.w), lod).rgb;
+		float weight = saturate(edge / max(probe.boxMin.w, 1e-4)) * (1.0 - result.a);
+
+		result += vec4(color, 1.0) * weight;
+	}
+
+	return result;
+}
+
+// L1 coefficients are convolved already, 1.0 sees full sky
+float evaluateVisibility(vec4 probe, vec3 n) {
+	float result = probe.x * 0.282095;
+	result += 0.488603 * (probe.y * n.y + probe.z * n.z + probe.w * n.x);
+
+	return saturate(result);
+}
+
+// layer of atlas is view of shadow, 1.0 is lit
+float sampleShadow(Shadow shadow, uint view, vec3 position) {
+	vec4 clip = shadow.viewProj[view] * vec4(position, 1.0);
+	vec3 ndc = clip.xyz / clip.w;
+
+	vec2 uv = ndc.xy * 0.5 + 0.5;
+
+	if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+		return 1.0;
+
+	// keep bilinear footprint inside tile, neighbours belong to other lights
+	vec2 halfTexel = 0.5 / vec2(textureSize(shadowAtlas, 0).xy);
+	uv = clamp(shadow.tile.xy + uv * shadow.tile.zw, shadow.tile.xy + halfTexel, shadow.tile.xy + shadow.tile.zw - halfTexel);
+
+	return texture(shadowAtlas, vec4(uv, float(view), ndc.z));
+}
+
+float directionalShadow(int index, vec3 position, float viewDepth) {
+	if (index < 0)
+		return 1.0;
+
+	Shadow shadow = shadows[index];
+
+	for (uint i = 0u; i < 4u; i++) {
+		if (viewDepth < shadow.splits[i])
+			return sampleShadow(shadow, i, position);
+	}
+
+	return 1.0;
+}
+
+// +X, -X, +Y, -Y, +Z, -Z
+uint cubeFace(vec3 direction) {
+	vec3 a = abs(direction);
+
+	if (a.x >= a.y && a.x >= a.z)
+		return direction.x > 0.0 ? 0u : 1u;
+
+	if (a.y >= a.z)
+		return direction.y > 0.0 ? 2u : 3u;
+
+	return direction.z > 0.0 ? 4u : 5u;
+}
+
+float pointShadow(int index, vec3 position, vec3 lightPosition) {
+	if (index < 0)
+		return 1.0;
+
+	return sampleShadow(shadows[index], cubeFace(position - lightPosition), position);
+}
+
+float distributionGGX(float nDotH, float roughness) {
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float nDotH2 = nDotH * nDotH;
+
+	float num = a2;
+	float denom = (nDotH2 * (a2 - 1.0) + 1.0);
+	denom = PI * denom * denom;
+	return num / denom;
+}
+
+float geometrySchlickGGX(float nDotV, float roughness) {
+	float r = (roughness + 1.0);
+	float k = (r * r) / 8.0;
+
+	float num = nDotV;
+	float denom = nDotV * (1.0 - k) + k;
+	return num / denom;
+}
+
+float geometrySmith(float nDotV, float nDotL, float roughness) {
+	float ggx2 = geometrySchlickGGX(nDotV, roughness);
+	float ggx1 = geometrySchlickGGX(nDotL, roughness);
+	return ggx1 * ggx2;
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 f0) {
+	return f0 + (1.0 - f0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 f0, float roughness) {
+	return f0 + (max(vec3(1.0 - roughness), f0) - f0) * pow(saturate(1.0 - cosTheta), 5.0);
+}
+
+vec3 cookTorranceBRDF(float nDotV, float nDotL, float nDotH, float cosTheta, vec3 f0, float roughness, float metallic, vec3 albedo, vec3 radiance) {
+	float distribution = distributionGGX(nDotH, roughness);
+	float geometrySmith = geometrySmith(nDotV, nDotL, roughness);
+	vec3 fresnel = fresnelSchlick(cosTheta, f0);
+
+	vec3 kS = fresnel;
+	vec3 kD = vec3(1.0) - kS;
+	kD *= 1.0 - metallic;
+
+	vec3 numerator = distribution * geometrySmith * fresnel;
+	float denominator = 4.0 * nDotV * nDotL + 0.0001;
+	vec3 specular = numerator / denominator;
+
+	return (kD * albedo / PI + specular) * radiance * nDotL;
+}
+
+// shades surface point lit by every light and environment, fragment coordinate selects cluster,
+// baked irradiance comes from lightmap and stands in for lights left out of light loop
+vec3 shadeSurface(vec3 position, vec3 normal, vec3 albedo, float metallic, float roughness,
+		vec3 bakedIrradiance) {
+	// camera of view being drawn, before matrix is hidden by direction below
+	float viewDepth = -(view * vec4(position, 1.0)).z;
+
+	vec3 view = normalize(viewPosition - position);
+
+	float nDotV = max(dot(normal, view), 0.0);
+
+	vec3 f0 = vec3(0.04);
+	f0 = mix(f0, albedo, metallic);
+
+	vec3 lightValue = vec3(0.0);
+	uint lightCount = uint(directionalLightCount);
+
+	for (int i = 0; i < directionalLightCount; i++) {
+		DirectionalLight light = directionalLights[i];
+
+		vec3 lightDirection = normalize(-light.direction);
+		vec3 halfVector = normalize(view + lightDirection);
+
+		float nDotL = max(dot(normal, lightDirection), 0.0);
+		float nDotH = max(dot(normal, halfVector), 0.0);
+		float cosTheta = max(dot(halfVector, view), 0.0);
+
+		vec3 radiance = light.color * light.intensity;
+		radiance *= directionalShadow(light.shadow, position, viewDepth);
+
+		lightValue += cookTorranceBRDF(nDotV, nDotL, nDotH, cosTheta, f0, roughness, metallic, albedo, radiance);
+	}
+
+	if (HAS_POINT_LIGHTS) {
+		vec2 viewCoord = (gl_FragCoord.xy - viewRect.xy) / viewRect.zw;
+		uvec2 tile = uvec2(viewCoord * vec2(CLUSTER_X, CLUSTER_Y));
+		tile = min(tile, uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+
+		uint cluster = viewIndex * CLUSTER_COUNT +
+				clusterIndex(uvec3(tile, clusterSlice(viewDepth, clusterParams)));
+		uint clusterLightCount = clusterLightCounts[cluster];
+		lightCount += clusterLightCount;
+
+		for (uint i = 0; i < clusterLightCount; i++) {
+			PointLight light = pointLights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+
+			vec3 lightDirection = normalize(light.position - position);
+			vec3 halfVector = normalize(view + lightDirection);
+
+			float nDotL = max(dot(normal, lightDirection), 0.0);
+			float nDotH = max(dot(normal, halfVector), 0.0);
+			float cosTheta = max(dot(halfVector, view), 0.0);
+
+			float distance = length(light.position - position);
+			float attenuation = 1.0 / (distance * distance);
+
+			// fade to zero at range, so light does not end at cluster boundary
+			if (light.range > 0.0) {
+				float ratio = distance / light.range;
+				attenuation *= pow(saturate(1.0 - pow(ratio, 4.0)), 2.0);
+			}
+			vec3 radiance = (light.color * light.intensity) * attenuation;
+			radiance *= pointShadow(light.shadow, position, light.position);
+
+			lightValue += cookTorranceBRDF(nDotV, nDotL, nDotH, cosTheta, f0, roughness, metallic, albedo, radiance);
+		}
+	}
+
+	if (debugView == DEBUG_VIEW_LIGHT_COMPLEXITY)
+		return debugHeat(float(lightCount) / DEBUG_MAX_LIGHT_COUNT);
+
+	vec3 fresnel = fresnelSchlickRoughness(nDotV, f0, roughness);
+
+	vec3 kS = fresnel;
+	vec3 kD = vec3(1.0) - kS;
+	kD *= 1.0 - metallic;
+
+	vec3 irradiance = evaluateIrradiance(normal);
+	vec3 diffuse = irradiance * albedo;
+
+	// diffuse only, specular of baked lights is lost
+	lightValue += kD * albedo / PI * bakedIrradiance;
+
+	const float MAX_REFLECTION_LOD = 4.0;
+	float lod = roughness * MAX_REFLECTION_LOD;
+
+	vec3 reflect = 2.0 * dot(view, normal) * normal - view;
+	vec3 filteredColor = textureLod(specularSampler, reflect, lod).rgb;
+	vec2 brdf = texture(lutSampler, vec2(nDotV, roughness)).rg;
+
+	// baked sky visibility, environment is hidden where geometry blocks it
+	if (probeCounts.x > 0u) {
+		vec4 probe = sampleProbes(position, normal);
+
+		diffuse *= evaluateVisibility(probe, normal);
+		filteredColor *= evaluateVisibility(probe, normalize(reflect));
+	}
+
+	// captures see geometry already, they replace sky rather than being darkened
+	if (reflectionProbeCount.x > 0u) {
+		vec4 local = sampleReflectionProbes(position, normalize(reflect), lod);
+		filteredColor = filteredColor * (1.0 - local.a) + local.rgb;
+	}
+
+	vec3 specular = filteredColor * (fresnel * brdf.x + brdf.y);
+
+	vec3 ambient = (kD * diffuse + specular);
+	vec3 color = ambient + lightValue;
+
+	return color;
+}
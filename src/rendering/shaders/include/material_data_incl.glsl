@@ -0,0 +1,44 @@
+// has to match MaterialStorage::MaterialData in material_storage.h
+struct MaterialData {
+	vec4 albedoFactor;
+
+	vec3 emissiveFactor;
+	float metallicFactor;
+
+	float roughnessFactor;
+
+	// bindless texture indices
+	uint albedo;
+	uint normal;
+	uint metallicRoughness;
+
+	// offset and size of maps within their textures, whole texture unless packed into atlas
+	vec4 albedoRect;
+	vec4 normalRect;
+	vec4 metallicRoughnessRect;
+
+	// bindless index of lightmap, sampled with lightmap uv when hasLightmap is set
+	uint lightmap;
+	uint hasLightmap;
+};
+
+layout(location = 5) flat in uint inMaterial;
+
+layout(set = 0, binding = 3) readonly buffer MaterialSSBO {
+	MaterialData materials[];
+};
+
+// uv repeats within rect, half a texel from its edges filtering stays in tile of atlas
+vec2 mapUV(vec4 rect, vec2 uv, ivec2 size) {
+	// whole textures repeat through sampler
+	if (rect.zw == vec2(1.0))
+		return uv;
+
+	vec2 margin = 0.5 / (vec2(size) * rect.zw);
+	return rect.xy + clamp(fract(uv), margin, 1.0 - margin) * rect.zw;
+}
+
+// gradients of unwrapped uv, mip level does not jump where fract wraps, scaled gradients bias it
+#define SAMPLE_MAP(s, rect, uv) \
+	textureGrad(s, mapUV(rect, uv, textureSize(s, 0)), dFdx(uv) * (rect).zw * mipScale, \
+			dFdy(uv) * (rect).zw * mipScale)
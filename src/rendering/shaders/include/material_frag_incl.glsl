@@ -0,0 +1,48 @@
+#include "lighting_incl.glsl"
+#include "tangent_frame_incl.glsl"
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inTangent;
+layout(location = 3) in vec2 inUV;
+layout(location = 4) in vec3 inBitangent;
+layout(location = 6) in vec2 inLightmapUV;
+
+layout(location = 0) out vec4 outFragColor;
+
+layout(early_fragment_tests) in;
+
+// fragments shaded per pixel, cleared every frame while overdraw view is on
+layout(set = 0, binding = 4) buffer OverdrawSSBO {
+	uint overdrawCounts[];
+};
+
+// shared by material variants, they differ only in how textures are fetched
+vec3 shade(vec3 albedo, vec2 packedNormal, float metallic, float roughness,
+		vec3 bakedIrradiance) {
+	mat3 tbn = tangentFrame(inPosition, inNormal, inTangent, inBitangent, inUV);
+	vec3 normal = unpackNormal(packedNormal, tbn);
+
+	return shadeSurface(inPosition, normal, albedo, metallic, roughness, bakedIrradiance);
+}
+
+// fragment written last to pixel shows how many were shaded there up to it
+vec3 countOverdraw() {
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	uint index = pixel.y * overdrawStride + pixel.x;
+
+	if (pixel.x >= overdrawStride || index >= uint(overdrawCounts.length()))
+		return vec3(0.0);
+
+	uint count = atomicAdd(overdrawCounts[index], 1u) + 1u;
+
+	return debugHeat(float(count) / DEBUG_MAX_OVERDRAW);
+}
+
+// of map within atlas rect, see SAMPLE_MAP
+vec3 mipLevel(vec4 rect, vec2 uv, ivec2 size) {
+	vec2 texel = uv * rect.zw * vec2(size);
+	float density = max(length(dFdx(texel)), length(dFdy(texel)));
+
+	return debugMipLevel(log2(max(density, 1e-6)));
+}
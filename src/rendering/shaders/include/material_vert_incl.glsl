@@ -0,0 +1,66 @@
+#include "uniforms_incl.glsl"
+#include "vertex_incl.glsl"
+
+// PackedVertex, position is in mesh bounds, instance transform maps it back
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTangent;
+layout(location = 3) in vec2 inUV;
+layout(location = 4) in vec2 inLightmapUV;
+
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outTangent;
+layout(location = 3) out vec2 outUV;
+
+layout(location = 4) out vec3 outBitangent;
+layout(location = 5) flat out uint outMaterial;
+layout(location = 6) out vec2 outLightmapUV;
+
+layout(set = 0, binding = 1) readonly buffer InstanceBuffer {
+	mat3x4 transforms[];
+};
+
+// slot in material buffer, written per instance slot
+layout(set = 0, binding = 2) readonly buffer InstanceMaterialBuffer {
+	uint materials[];
+};
+
+// inverse transpose of instance transform up to scale, keeps normals perpendicular to surfaces
+// under non-uniform scale, written along with transforms
+layout(set = 0, binding = 5) readonly buffer InstanceNormalBuffer {
+	mat3x4 normals[];
+};
+
+void main() {
+	// rows of affine transform, vectors are multiplied from the left
+	mat3x4 model = transforms[gl_InstanceIndex];
+
+	vec4 vertPos4 = vec4(inPosition * model, 1.0);
+
+	vec3 T = normalize(vec4(decodeOctahedral(inTangent), 0.0) * model);
+	vec3 N = normalize(vec4(decodeOctahedral(inNormal), 0.0) * normals[gl_InstanceIndex]);
+
+	// re-orthogonalize T with respect to N, meshes without normal maps carry no tangent and any
+	// one perpendicular to N does for them
+	T = T - dot(T, N) * N;
+
+	if (dot(T, T) < 1e-6)
+		T = cross(N, abs(N.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0));
+
+	T = normalize(T);
+
+	// then retrieve perpendicular vector B with the cross product of T and N
+	vec3 B = cross(N, T);
+
+	outPosition = vertPos4.xyz;
+	outNormal = N;
+	outTangent = T;
+	outUV = inUV;
+
+	outBitangent = B;
+	outMaterial = materials[gl_InstanceIndex];
+	outLightmapUV = inLightmapUV;
+
+	gl_Position = projView * vertPos4;
+}
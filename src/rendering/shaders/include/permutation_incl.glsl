@@ -0,0 +1,15 @@
+// Material permutation, maps the material does not have are not fetched and take values of
+// fallback textures instead. Ids match order of MATERIAL_*_BIT, point light and derived tangent
+// bits are declared by includes reading them.
+layout(constant_id = 0) const bool HAS_ALBEDO_MAP = true;
+layout(constant_id = 1) const bool HAS_NORMAL_MAP = true;
+layout(constant_id = 2) const bool HAS_METALLIC_ROUGHNESS_MAP = true;
+layout(constant_id = 5) const bool HAS_ALPHA_TEST = false;
+
+// of albedo alpha, impostors are cleared to zero around what they captured
+const float ALPHA_TEST_CUTOFF = 0.5;
+
+// same texels as fallback textures, factors of material multiply them
+const vec3 FALLBACK_ALBEDO = vec3(1.0);
+const vec2 FALLBACK_NORMAL = vec2(127.0 / 255.0);
+const vec2 FALLBACK_METALLIC_ROUGHNESS = vec2(1.0);
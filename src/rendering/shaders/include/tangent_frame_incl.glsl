@@ -0,0 +1,34 @@
+// Material permutation bit MATERIAL_DERIVED_TANGENTS_BIT, meshes of material carry no tangents and
+// normal map is applied in frame rebuilt from screen space derivatives of position and uv.
+layout(constant_id = 4) const bool DERIVED_TANGENTS = false;
+
+// cotangent frame, scaled by larger of uv gradients so it stays invariant to uv scale, handles
+// mirrored uv which vertex tangents without sign cannot
+mat3 tangentFrame(vec3 position, vec3 normal, vec3 tangent, vec3 bitangent, vec2 uv) {
+	if (!DERIVED_TANGENTS)
+		return mat3(tangent, bitangent, normal);
+
+	vec3 N = normalize(normal);
+
+	vec3 dp1 = dFdx(position);
+	vec3 dp2 = dFdy(position);
+	vec2 duv1 = dFdx(uv);
+	vec2 duv2 = dFdy(uv);
+
+	vec3 dp2perp = cross(dp2, N);
+	vec3 dp1perp = cross(N, dp1);
+
+	vec3 T = dp2perp * duv1.x + dp1perp * duv2.x;
+	vec3 B = dp2perp * duv1.y + dp1perp * duv2.y;
+
+	// constant uv leaves geometric normal alone
+	float lengthSquared = max(dot(T, T), dot(B, B));
+
+	if (lengthSquared < 1e-20)
+		return mat3(vec3(0.0), vec3(0.0), N);
+
+	float invLength = inversesqrt(lengthSquared);
+
+	// v of glTF grows downwards, bitangent of normal maps points against it
+	return mat3(T * invLength, -B * invLength, N);
+}
@@ -0,0 +1,27 @@
+// channels weigh layers, covers heightmap
+layout(set = 3, binding = 2) uniform sampler2D splatSampler;
+layout(set = 3, binding = 3) uniform sampler2DArray layerSampler;
+
+// layers carry albedo alone
+const float TERRAIN_ROUGHNESS = 0.9;
+
+// weights are normalized, splat map painted with none shows first layer
+vec3 blendLayers(vec3 position, vec2 uv) {
+	vec2 splatUV = (position.xz - terrain.origin.xz) / terrain.extent;
+	vec4 weights = texture(splatSampler, splatUV);
+
+	float total = weights.r + weights.g + weights.b + weights.a;
+
+	if (total < 1e-4)
+		weights = vec4(1.0, 0.0, 0.0, 0.0);
+	else
+		weights /= total;
+
+	vec3 albedo = vec3(0.0);
+
+	// fetched in uniform control flow, gradients of layers stay defined
+	for (int i = 0; i < 4; i++)
+		albedo += weights[i] * texture(layerSampler, vec3(uv, float(i))).rgb;
+
+	return albedo;
+}
@@ -0,0 +1,15 @@
+// has to match TerrainConstants in storage/terrain_storage.h
+layout(push_constant) uniform TerrainConstants {
+	// w is sample spacing
+	vec4 origin;
+	// world size heightmap and splat map cover along x and z
+	vec2 extent;
+	float layerScale;
+	uint levelCount;
+	// first piece of mesh drawn
+	uint pieceOffset;
+} terrain;
+
+// has to match storage/terrain_storage.h
+const int TERRAIN_TILE_SIZE = 32;
+const int TERRAIN_LEVEL_TILE_COUNT = 9;
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "std_incl.glsl"
+#include "uniforms_incl.glsl"
+#include "terrain_incl.glsl"
+
+// quads from origin of piece
+layout(location = 0) in uvec2 inGrid;
+
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outTangent;
+layout(location = 3) out vec2 outUV;
+
+layout(location = 4) out vec3 outBitangent;
+layout(location = 6) out vec2 outLightmapUV;
+
+struct Piece {
+	// of first vertex, in samples of its level from terrain origin
+	ivec2 origin;
+	uint level;
+	uint _padding;
+};
+
+// layer per level, tiles of world are kept at their index modulo tile count
+layout(set = 3, binding = 0) uniform sampler2DArray heightSampler;
+
+layout(set = 3, binding = 1) readonly buffer TerrainPieceSSBO {
+	// first view in samples of finest level from origin
+	vec2 viewer;
+	vec2 _padding;
+	Piece pieces[];
+};
+
+// of morph towards coarser level, in its samples from viewer, reaches one at outer edge
+const float MORPH_START = 99.0;
+const float MORPH_WIDTH = 24.0;
+
+// >> and & on signed values floor, % is undefined for negative ones
+int clipTexel(int index) {
+	int tile = index >> 5;
+	int slot = tile - TERRAIN_LEVEL_TILE_COUNT *
+			int(floor(float(tile) / float(TERRAIN_LEVEL_TILE_COUNT)));
+
+	return slot * TERRAIN_TILE_SIZE + (index & (TERRAIN_TILE_SIZE - 1));
+}
+
+// world sample of level, has to be streamed
+float fetchHeight(ivec2 coord, uint level) {
+	ivec3 texel = ivec3(clipTexel(coord.x), clipTexel(coord.y), int(level));
+
+	return texelFetch(heightSampler, texel, 0).r;
+}
+
+// of coarser level along the edge between its samples, what its triangles show there
+float fetchCoarseHeight(ivec2 coord, uint level) {
+	ivec2 first = coord >> 1;
+	ivec2 last = (coord + 1) >> 1;
+	uint coarse = level + 1u;
+
+	return 0.25 * (fetchHeight(first, coarse) + fetchHeight(ivec2(last.x, first.y), coarse) +
+			fetchHeight(ivec2(first.x, last.y), coarse) + fetchHeight(last, coarse));
+}
+
+// central differences, spacing of samples in world units
+vec3 fetchNormal(ivec2 coord, uint level, float spacing) {
+	float dx = fetchHeight(coord + ivec2(1, 0), level) - fetchHeight(coord - ivec2(1, 0), level);
+	float dz = fetchHeight(coord + ivec2(0, 1), level) - fetchHeight(coord - ivec2(0, 1), level);
+
+	return normalize(vec3(-dx, 2.0 * spacing, -dz));
+}
+
+void main() {
+	Piece piece = pieces[terrain.pieceOffset + uint(gl_InstanceIndex)];
+
+	uint level = piece.level;
+	ivec2 coord = piece.origin + ivec2(inGrid);
+
+	float scale = exp2(float(level));
+	float spacing = terrain.origin.w * scale;
+
+	float height = fetchHeight(coord, level);
+	vec3 N = fetchNormal(coord, level, spacing);
+
+	// coarsest level has nothing to meet
+	if (level + 1u < terrain.levelCount) {
+		vec2 offset = abs(vec2(coord) - viewer / scale);
+		float alpha = saturate((max(offset.x, offset.y) - MORPH_START) / MORPH_WIDTH);
+
+		float coarseHeight = fetchCoarseHeight(coord, level);
+		vec3 coarseNormal = fetchNormal(coord >> 1, level + 1u, spacing * 2.0);
+
+		height = mix(height, coarseHeight, alpha);
+		N = normalize(mix(N, coarseNormal, alpha));
+	}
+
+	vec2 xz = terrain.origin.xz + vec2(coord) * spacing;
+	vec4 vertPos4 = vec4(xz.x, terrain.origin.y + height, xz.y, 1.0);
+
+	// heightfields are never vertical, layers run along x
+	vec3 T = normalize(cross(N, vec3(0.0, 0.0, 1.0)));
+	vec3 B = cross(N, T);
+
+	outPosition = vertPos4.xyz;
+	outNormal = N;
+	outTangent = T;
+	outUV = xz / terrain.layerScale;
+
+	outBitangent = B;
+	outLightmapUV = vec2(0.0);
+
+	gl_Position = projView * vertPos4;
+}
@@ -0,0 +1,32 @@
+// tonemap curve and look baked over exposed scene color, see TonemapLut
+const float TONEMAP_LUT_SIZE = 32.0;
+
+const float BLACK = 0.00017578;
+
+const uint LOOK_NONE = 0;
+const uint LOOK_PUNCHY = 1;
+
+// one stop past white, inset of curve mixes channels before they are clamped to it
+float tonemapLutMaxEv(float white) {
+	return log2(white) + 1.0;
+}
+
+// color to coordinate of texel centers, along log2 of each channel
+vec3 tonemapLutEncode(vec3 color, float white) {
+	float minEv = log2(BLACK);
+	float maxEv = tonemapLutMaxEv(white);
+
+	vec3 t = clamp((log2(max(color, vec3(BLACK))) - minEv) / (maxEv - minEv), 0.0, 1.0);
+
+	return t * ((TONEMAP_LUT_SIZE - 1.0) / TONEMAP_LUT_SIZE) + 0.5 / TONEMAP_LUT_SIZE;
+}
+
+// texel to color it holds
+vec3 tonemapLutDecode(uvec3 texel, float white) {
+	float minEv = log2(BLACK);
+	float maxEv = tonemapLutMaxEv(white);
+
+	vec3 t = vec3(texel) / (TONEMAP_LUT_SIZE - 1.0);
+
+	return exp2(minEv + t * (maxEv - minEv));
+}
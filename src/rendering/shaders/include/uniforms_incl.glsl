@@ -0,0 +1,29 @@
+// has to match UniformBufferObject in rendering_device.h
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+	vec3 viewPosition;
+
+	int directionalLightCount;
+	int pointLightCount;
+
+	// see debug_incl.glsl, shading writes its visualization in place of lit color
+	uint debugView;
+	// pixels per row of overdraw counters, width of attachments
+	uint overdrawStride;
+	// gradients of material maps are scaled by it, exp2 of mip bias of quality settings
+	float mipScale;
+
+	// rgb per coefficient, cosine lobe and 1/pi are already applied
+	vec4 irradianceSH[9];
+
+	mat4 projView;
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	mat4 invProjView;
+	// in normalized device coordinates, already applied to proj
+	vec2 jitter;
+
+	// of views drawn into frame, offset and size in pixels of region view covers
+	uint viewIndex;
+	vec4 viewRect;
+};
@@ -0,0 +1,27 @@
+// inverse of encodeOctahedral in types/vertex.h
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+	// lower hemisphere was folded over diagonals
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+
+	return normalize(n);
+}
+
+// same as encodeOctahedral in types/vertex.h, for vertices written on GPU
+vec2 encodeOctahedral(vec3 v) {
+	float length = abs(v.x) + abs(v.y) + abs(v.z);
+
+	if (length == 0.0)
+		return vec2(0.0);
+
+	vec3 n = v / length;
+
+	if (n.z >= 0.0)
+		return n.xy;
+
+	vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return (vec2(1.0) - abs(n.yx)) * signs;
+}
@@ -0,0 +1,32 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/lighting_incl.glsl"
+
+layout(location = 0) out vec4 outFragColor;
+
+layout(set = 3, binding = 0, input_attachment_index = 0) uniform subpassInput inputAlbedo;
+layout(set = 3, binding = 1, input_attachment_index = 1) uniform subpassInput inputNormal;
+layout(set = 3, binding = 2, input_attachment_index = 2) uniform subpassInput inputMaterial;
+layout(set = 3, binding = 3, input_attachment_index = 3) uniform subpassInput inputDepth;
+
+void main() {
+	float depth = subpassLoad(inputDepth).r;
+
+	// reverse z, nothing was drawn here
+	if (depth == 0.0)
+		discard;
+
+	vec2 ndc = (gl_FragCoord.xy - viewRect.xy) / viewRect.zw * 2.0 - 1.0;
+	vec4 position = invProjView * vec4(ndc, depth, 1.0);
+
+	vec3 albedo = subpassLoad(inputAlbedo).rgb;
+	vec3 normal = normalize(subpassLoad(inputNormal).xyz * 2.0 - 1.0);
+	vec2 material = subpassLoad(inputMaterial).rg;
+
+	// g-buffer has no room for lightmaps, lightmapped surfaces want forward path
+	vec3 color = shadeSurface(
+			position.xyz / position.w, normal, albedo, material.r, material.g, vec3(0.0));
+	outFragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 450
+
+#extension GL_EXT_multiview : require
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/light_incl.glsl"
+
+// PackedVertex, only position is read
+layout(location = 0) in vec4 inPosition;
+
+layout(set = 0, binding = 0) readonly buffer InstanceBuffer {
+	mat3x4 transforms[];
+};
+
+layout(set = 0, binding = 1) readonly buffer ShadowSSBO {
+	Shadow shadows[];
+};
+
+layout(push_constant) uniform ShadowPushConstants {
+	uint shadowIndex;
+};
+
+void main() {
+	// rows of affine transform
+	vec3 position = inPosition * transforms[gl_InstanceIndex];
+
+	// view is cascade of directional light or cube face of point light
+	gl_Position = shadows[shadowIndex].viewProj[gl_ViewIndex] * vec4(position, 1.0);
+}
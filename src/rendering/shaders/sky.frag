@@ -8,6 +8,8 @@ layout(binding = 0) uniform samplerCube environmentSampler;
 layout(push_constant) uniform SkyConstants {
 	mat4 invProj;
 	mat4 invView;
+	// blurrier levels of cubemap for low detail look, zero picks level by footprint
+	float lod;
 };
 
 void main() {
@@ -15,5 +17,8 @@ void main() {
 	vec3 viewRayDir = viewPos.xyz / viewPos.w;
 	vec3 rayDir = normalize((invView * vec4(viewRayDir, 0.0)).xyz);
 
-	outFragColor = texture(environmentSampler, rayDir);
+	if (lod > 0.0)
+		outFragColor = textureLod(environmentSampler, rayDir, lod);
+	else
+		outFragColor = texture(environmentSampler, rayDir);
 }
@@ -0,0 +1,26 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/material_frag_incl.glsl"
+#include "include/permutation_incl.glsl"
+#include "include/terrain_incl.glsl"
+#include "include/terrain_frag_incl.glsl"
+
+void main() {
+	if (debugView == DEBUG_VIEW_OVERDRAW) {
+		outFragColor = vec4(countOverdraw(), 1.0);
+		return;
+	}
+
+	// layers fill whole array layer
+	if (debugView == DEBUG_VIEW_MIP_LEVEL) {
+		ivec2 size = textureSize(layerSampler, 0).xy;
+		outFragColor = vec4(mipLevel(vec4(0.0, 0.0, 1.0, 1.0), inUV, size), 1.0);
+		return;
+	}
+
+	vec3 albedo = blendLayers(inPosition, inUV);
+	vec3 color = shade(albedo, FALLBACK_NORMAL, 0.0, TERRAIN_ROUGHNESS, vec3(0.0));
+	outFragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : enable
+
+#include "include/gbuffer_frag_incl.glsl"
+#include "include/permutation_incl.glsl"
+#include "include/terrain_incl.glsl"
+#include "include/terrain_frag_incl.glsl"
+
+void main() {
+	vec3 albedo = blendLayers(inPosition, inUV);
+	writeGBuffer(albedo, FALLBACK_NORMAL, 0.0, TERRAIN_ROUGHNESS);
+}
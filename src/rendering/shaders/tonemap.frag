@@ -3,25 +3,80 @@
 #extension GL_GOOGLE_include_directive : enable
 
 #include "include/tonemap_incl.glsl"
+#include "include/tonemap_lut_incl.glsl"
 
 layout(location = 0) out vec4 outFragColor;
 
-layout(set = 0, binding = 0, input_attachment_index = 0) uniform subpassInput inputColor;
+// scene color at render extent, sampled with linear filtering
+layout(set = 0, binding = 0) uniform sampler2D inputColor;
+// adapted to scene color by auto exposure passes, on device
+layout(set = 1, binding = 0) readonly buffer ExposureSSBO {
+	float adaptedExposure;
+};
+// curve and look for white of constants, written by compute when either changes
+layout(set = 2, binding = 0) uniform sampler3D tonemapLut;
 
 layout(push_constant) uniform TonemapParameterConstants {
 	float exposure;
 	float white;
+	vec2 outputSize;
+	// drawn part of scene color, at its top left
+	vec2 inputSize;
+	uint upscaleFilter;
+	// exposure is compensation on top of adapted one then
+	uint isAutoExposure;
+	// one trilinear fetch of baked curve instead of evaluating it
+	uint isTonemapLut;
+	uint look;
+	// colors of debug view are shown as they are
+	uint isDebugView;
 };
 
-const float BLACK = 0.00017578;
+const uint UPSCALE_NEAREST = 0;
+const uint UPSCALE_SHARP_BILINEAR = 1;
+
+// texel centers stay flat, only the output pixel straddling a texel edge blends
+vec2 sharpBilinear(vec2 texel, vec2 scale) {
+	vec2 texelFloored = floor(texel);
+	vec2 centerDistance = fract(texel) - 0.5;
+	vec2 region = 0.5 - 0.5 / scale;
+
+	vec2 f = (centerDistance - clamp(centerDistance, -region, region)) * scale + 0.5;
+
+	return texelFloored + f;
+}
 
 void main() {
-	vec3 color = subpassLoad(inputColor).rgb;
-	color *= exposure;
+	vec2 texel = gl_FragCoord.xy / outputSize * inputSize;
+
+	if (upscaleFilter == UPSCALE_SHARP_BILINEAR)
+		texel = sharpBilinear(texel, max(outputSize / inputSize, vec2(1.0)));
+	else
+		texel = floor(texel) + 0.5;
+
+	// texels outside of drawn part are left from larger frames
+	texel = clamp(texel, vec2(0.5), inputSize - 0.5);
+
+	vec2 colorSize = vec2(textureSize(inputColor, 0));
+	vec3 color = textureLod(inputColor, texel / colorSize, 0.0).rgb;
+
+	if (isDebugView != 0) {
+		outFragColor = vec4(color, 1.0);
+		return;
+	}
+
+	color *= isAutoExposure != 0 ? exposure * adaptedExposure : exposure;
+
+	if (isTonemapLut != 0) {
+		color = textureLod(tonemapLut, tonemapLutEncode(color, white), 0.0).rgb;
+	} else {
+		color = agx(color, white, BLACK);
+
+		if (look == LOOK_PUNCHY)
+			color = agxLookPunchy(color);
 
-	color = agx(color, white, BLACK);
-	// color = agxLookPunchy(color);
-	color = agxEotf(color);
+		color = agxEotf(color);
+	}
 
 	outFragColor = vec4(color, 1.0);
 }
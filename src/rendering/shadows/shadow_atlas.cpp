@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/rendering_device.h>
+#include <rendering/shaders/shadow.gen.h>
+#include <rendering/types/vertex.h>
+
+#include "shadow_atlas.h"
+
+// blend of uniform (0) and logarithmic (1) cascade splits
+const float SPLIT_BLEND = 0.75f;
+
+// casters this far behind cascade still reach it
+const float CASTER_DISTANCE = 100.0f;
+
+const float POINT_NEAR = 0.05f;
+
+// reverse depth, bias moves caster away from light
+const float DEPTH_BIAS_CONSTANT = -2.0f;
+const float DEPTH_BIAS_SLOPE = -2.0f;
+
+glm::vec4 ShadowAtlas::_tileRect(uint32_t tile) {
+	float scale = 1.0f / static_cast<float>(SHADOW_TILES_PER_ROW);
+
+	float x = static_cast<float>(tile % SHADOW_TILES_PER_ROW);
+	float y = static_cast<float>(tile / SHADOW_TILES_PER_ROW);
+
+	return glm::vec4(x * scale, y * scale, scale, scale);
+}
+
+void ShadowAtlas::_computeCascades(ShadowData &data, const glm::mat4 &transform,
+		const Camera &camera, float aspect, uint32_t tileSize) {
+	glm::vec3 direction = glm::normalize(glm::mat3(transform) * glm::vec3(0.0f, 0.0f, -1.0f));
+	glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : CAMERA_UP;
+
+	glm::mat4 lightRotation = glm::lookAtRH(glm::vec3(0.0f), direction, up);
+	glm::mat4 invLightRotation = glm::inverse(lightRotation);
+	glm::mat4 invView = glm::inverse(camera.viewMatrix());
+
+	float zNear = camera.zNear;
+	float zFar = std::min(camera.zFar, SHADOW_DISTANCE);
+
+	float tanY = std::tan(camera.fovY * 0.5f);
+	float tanX = tanY * aspect;
+
+	float sliceNear = zNear;
+
+	for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+		float p = static_cast<float>(i + 1) / static_cast<float>(SHADOW_CASCADE_COUNT);
+
+		float logSplit = zNear * std::pow(zFar / zNear, p);
+		float uniformSplit = zNear + (zFar - zNear) * p;
+		float sliceFar = glm::mix(uniformSplit, logSplit, SPLIT_BLEND);
+
+		std::array<glm::vec3, 8> corners;
+
+		for (uint32_t j = 0; j < 8; j++) {
+			float z = (j & 4) ? sliceFar : sliceNear;
+			float x = (j & 1) ? tanX * z : -tanX * z;
+			float y = (j & 2) ? tanY * z : -tanY * z;
+
+			corners[j] = glm::vec3(invView * glm::vec4(x, y, -z, 1.0f));
+		}
+
+		glm::vec3 center(0.0f);
+
+		for (const glm::vec3 &corner : corners)
+			center += corner / 8.0f;
+
+		float radius = 0.0f;
+
+		for (const glm::vec3 &corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+
+		// sphere does not change with camera rotation, rounding keeps it exact
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// snap center to texel grid of light, so cascade does not shimmer or re-render while
+		// camera moves inside one texel
+		float texel = 2.0f * radius / static_cast<float>(tileSize);
+
+		glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+		lightCenter = glm::floor(lightCenter / texel) * texel;
+		center = glm::vec3(invLightRotation * glm::vec4(lightCenter, 1.0f));
+
+		glm::vec3 eye = center - direction * (radius + CASTER_DISTANCE);
+		glm::mat4 view = glm::lookAtRH(eye, center, up);
+
+		float depth = 2.0f * radius + CASTER_DISTANCE;
+
+		glm::mat4 proj = glm::orthoRH(-radius, radius, -radius, radius, 0.0f, depth);
+		proj = REVERSE_Z_MATRIX * OPENGL_TO_VULKAN_MATRIX * proj;
+
+		data.viewProj[i] = proj * view;
+		data.splits[i] = sliceFar;
+
+		sliceNear = sliceFar;
+	}
+}
+
+void ShadowAtlas::_computeCube(ShadowData &data, const glm::mat4 &transform, float range) {
+	// +X, -X, +Y, -Y, +Z, -Z, has to match cubeFace in shaders/include/lighting_incl.glsl
+	const std::array<glm::vec3, 6> fronts = {
+		glm::vec3(1.0f, 0.0f, 0.0f),
+		glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f),
+	};
+
+	const std::array<glm::vec3, 6> ups = {
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f),
+	};
+
+	glm::vec3 position(transform[3]);
+
+	// light without range reaches as far as directional shadows
+	float zFar = range > 0.0f ? range : SHADOW_DISTANCE;
+
+	glm::mat4 proj = glm::perspectiveRH(glm::radians(90.0f), 1.0f, POINT_NEAR, zFar);
+	proj = REVERSE_Z_MATRIX * OPENGL_TO_VULKAN_MATRIX * proj;
+
+	for (uint32_t i = 0; i < SHADOW_LAYER_COUNT; i++) {
+		glm::mat4 view = glm::lookAtRH(position, position + fronts[i], ups[i]);
+		data.viewProj[i] = proj * view;
+	}
+}
+
+vk::RenderPass ShadowAtlas::_createRenderPass(uint32_t viewMask) {
+	// tiles outside render area keep their depth, atlas stays readable between passes
+	vk::AttachmentDescription depthAttachment = {};
+	depthAttachment.setFormat(_atlas.getFormat());
+	depthAttachment.setSamples(vk::SampleCountFlagBits::e1);
+	depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
+	depthAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
+	depthAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+	depthAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+	depthAttachment.setInitialLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	depthAttachment.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+	vk::AttachmentReference depthRef = {};
+	depthRef.setAttachment(0);
+	depthRef.setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+	vk::SubpassDescription subpass = {};
+	subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+	subpass.setPDepthStencilAttachment(&depthRef);
+
+	vk::PipelineStageFlags depthStages = vk::PipelineStageFlagBits::eEarlyFragmentTests |
+			vk::PipelineStageFlagBits::eLateFragmentTests;
+
+	// previous frames sample the atlas, this frame samples what was just written
+	std::array<vk::SubpassDependency, 2> dependencies = {};
+	dependencies[0].setSrcSubpass(VK_SUBPASS_EXTERNAL);
+	dependencies[0].setDstSubpass(0);
+	dependencies[0].setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader | depthStages);
+	dependencies[0].setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+	dependencies[0].setDstStageMask(depthStages);
+	dependencies[0].setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead |
+			vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+
+	dependencies[1].setSrcSubpass(0);
+	dependencies[1].setDstSubpass(VK_SUBPASS_EXTERNAL);
+	dependencies[1].setSrcStageMask(depthStages);
+	dependencies[1].setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+	dependencies[1].setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader | depthStages);
+	dependencies[1].setDstAccessMask(vk::AccessFlagBits::eShaderRead |
+			vk::AccessFlagBits::eDepthStencilAttachmentRead |
+			vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+
+	vk::RenderPassMultiviewCreateInfo multiviewCreateInfo = {};
+	multiviewCreateInfo.setSubpassCount(1);
+	multiviewCreateInfo.setViewMasks(viewMask);
+	multiviewCreateInfo.setCorrelationMasks(viewMask);
+
+	vk::RenderPassCreateInfo createInfo = {};
+	createInfo.setAttachments(depthAttachment);
+	createInfo.setSubpasses(subpass);
+	createInfo.setDependencies(dependencies);
+	createInfo.setPNext(&multiviewCreateInfo);
+
+	return _device.createRenderPass(createInfo);
+}
+
+vk::Pipeline ShadowAtlas::_createPipeline(vk::RenderPass renderPass) {
+	ShadowShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.vertexCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.vertexCode));
+
+	vk::ShaderModule vertexStage = _device.createShaderModule(moduleCreateInfo);
+
+	moduleCreateInfo.setPCode(shader.fragmentCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.fragmentCode));
+
+	vk::ShaderModule fragmentStage = _device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo vertexStageInfo;
+	vertexStageInfo.setModule(vertexStage);
+	vertexStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
+	vertexStageInfo.setPName("main");
+
+	vk::PipelineShaderStageCreateInfo fragmentStageInfo;
+	fragmentStageInfo.setModule(fragmentStage);
+	fragmentStageInfo.setStage(vk::ShaderStageFlagBits::eFragment);
+	fragmentStageInfo.setPName("main");
+
+	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertexStageInfo, fragmentStageInfo };
+
+	// shadows fetch position stream only
+	vk::PipelineVertexInputStateCreateInfo vertexInput = PositionLayout::getInputState();
+
+	vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+	inputAssembly.setTopology(vk::PrimitiveTopology::eTriangleList);
+
+	vk::PipelineViewportStateCreateInfo viewportState;
+	viewportState.setViewportCount(1);
+	viewportState.setScissorCount(1);
+
+	// both faces cast, open meshes would leak light otherwise
+	vk::PipelineRasterizationStateCreateInfo rasterizer;
+	rasterizer.setRasterizerDiscardEnable(VK_FALSE);
+	rasterizer.setPolygonMode(vk::PolygonMode::eFill);
+	rasterizer.setLineWidth(1.0f);
+	rasterizer.setCullMode(vk::CullModeFlagBits::eNone);
+	rasterizer.setFrontFace(vk::FrontFace::eCounterClockwise);
+	rasterizer.setDepthBiasEnable(VK_TRUE);
+	rasterizer.setDepthBiasConstantFactor(DEPTH_BIAS_CONSTANT);
+	rasterizer.setDepthBiasSlopeFactor(DEPTH_BIAS_SLOPE);
+
+	vk::PipelineMultisampleStateCreateInfo multisampling;
+	multisampling.setSampleShadingEnable(VK_FALSE);
+	multisampling.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+	vk::PipelineDepthStencilStateCreateInfo depthStencil;
+	depthStencil.setDepthTestEnable(VK_TRUE);
+	depthStencil.setDepthWriteEnable(VK_TRUE);
+	depthStencil.setDepthCompareOp(vk::CompareOp::eGreaterOrEqual);
+	depthStencil.setDepthBoundsTestEnable(VK_FALSE);
+	depthStencil.setStencilTestEnable(VK_FALSE);
+
+	vk::PipelineColorBlendStateCreateInfo colorBlending;
+	colorBlending.setLogicOpEnable(VK_FALSE);
+
+	std::vector<vk::DynamicState> dynamicStates = {
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor,
+	};
+
+	vk::PipelineDynamicStateCreateInfo dynamicState;
+	dynamicState.setDynamicStates(dynamicStates);
+
+	vk::GraphicsPipelineCreateInfo createInfo;
+	createInfo.setStages(shaderStages);
+	createInfo.setPVertexInputState(&vertexInput);
+	createInfo.setPInputAssemblyState(&inputAssembly);
+	createInfo.setPViewportState(&viewportState);
+	createInfo.setPRasterizationState(&rasterizer);
+	createInfo.setPMultisampleState(&multisampling);
+	createInfo.setPDepthStencilState(&depthStencil);
+	createInfo.setPColorBlendState(&colorBlending);
+	createInfo.setPDynamicState(&dynamicState);
+	createInfo.setLayout(_pipelineLayout);
+	createInfo.setRenderPass(renderPass);
+	createInfo.setSubpass(0);
+
+	vk::ResultValue<vk::Pipeline> result = _device.createGraphicsPipeline(
+			RD::getSingleton().getPipelineCache(), createInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Shadow pipeline creation failed!");
+
+	_device.destroyShaderModule(vertexStage);
+	_device.destroyShaderModule(fragmentStage);
+
+	return result.value;
+}
+
+void ShadowAtlas::_renderTile(vk::CommandBuffer commandBuffer, uint32_t frame, uint32_t tile,
+		LightType type, const GeometryArena &geometryArena, const RenderQueue &casters,
+		vk::IndexType &boundIndexType) {
+	bool isDirectional = type == LightType::Directional;
+
+	int32_t x = static_cast<int32_t>((tile % SHADOW_TILES_PER_ROW) * _tileSize);
+	int32_t y = static_cast<int32_t>((tile / SHADOW_TILES_PER_ROW) * _tileSize);
+
+	vk::Rect2D renderArea;
+	renderArea.setOffset({ x, y });
+	renderArea.setExtent({ _tileSize, _tileSize });
+
+	vk::ClearValue clearValue;
+	clearValue.depthStencil = vk::ClearDepthStencilValue(0.0f, 0);
+
+	vk::RenderPassBeginInfo renderPassInfo;
+	renderPassInfo.setRenderPass(isDirectional ? _cascadeRenderPass : _cubeRenderPass);
+	renderPassInfo.setFramebuffer(isDirectional ? _cascadeFramebuffer : _cubeFramebuffer);
+	renderPassInfo.setRenderArea(renderArea);
+	renderPassInfo.setClearValues(clearValue);
+
+	commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
+
+	vk::Viewport viewport;
+	viewport.setX(static_cast<float>(x));
+	viewport.setY(static_cast<float>(y));
+	viewport.setWidth(static_cast<float>(_tileSize));
+	viewport.setHeight(static_cast<float>(_tileSize));
+	viewport.setMinDepth(0.0f);
+	viewport.setMaxDepth(1.0f);
+
+	commandBuffer.setViewport(0, viewport);
+	commandBuffer.setScissor(0, renderArea);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
+
+	commandBuffer.bindPipeline(bindPoint, isDirectional ? _cascadePipeline : _cubePipeline);
+	commandBuffer.bindDescriptorSets(bindPoint, _pipelineLayout, 0, _sets[frame], nullptr);
+
+	ShadowPushConstants constants = {};
+	constants.shadow = tile;
+
+	commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0,
+			sizeof(ShadowPushConstants), &constants);
+
+	for (const DrawBatch &batch : casters.batches()) {
+		if (batch.pMesh->geometry.indexType != boundIndexType) {
+			boundIndexType = batch.pMesh->geometry.indexType;
+			geometryArena.bindIndices(commandBuffer, boundIndexType);
+		}
+
+		commandBuffer.drawIndexed(batch.indexCount, batch.instanceCount, batch.firstIndex,
+				batch.vertexOffset, batch.firstInstance);
+	}
+
+	commandBuffer.endRenderPass();
+}
+
+void ShadowAtlas::updateCasters(const std::vector<InstanceTransform> &transforms) {
+	_casterTransforms = transforms;
+
+	for (bool &isStale : _isCasterBufferStale)
+		isStale = true;
+}
+
+void ShadowAtlas::render(vk::CommandBuffer commandBuffer, uint32_t frame, const Camera &camera,
+		float aspect, LightStorage &lightStorage, const GeometryArena &geometryArena,
+		const RenderQueue &casters) {
+	if (!_isAtlasTransitioned) {
+		vk::ImageSubresourceRange subresourceRange;
+		subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eDepth);
+		subresourceRange.setBaseMipLevel(0);
+		subresourceRange.setLevelCount(1);
+		subresourceRange.setBaseArrayLayer(0);
+		subresourceRange.setLayerCount(SHADOW_LAYER_COUNT);
+
+		// tiles are never read before they are rendered, contents do not matter
+		vk::ImageMemoryBarrier barrier;
+		barrier.setOldLayout(vk::ImageLayout::eUndefined);
+		barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setImage(_atlas.getImage());
+		barrier.setSubresourceRange(subresourceRange);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+
+		_isAtlasTransitioned = true;
+	}
+
+	// casters of this frame are not in use, previous submission is finished
+	if (_isCasterBufferStale[frame]) {
+		size_t count = std::min(_casterTransforms.size(), size_t(MAX_SHADOW_CASTER_COUNT));
+		memcpy(_casterAllocInfos[frame].pMappedData, _casterTransforms.data(),
+				sizeof(InstanceTransform) * count);
+
+		_isCasterBufferStale[frame] = false;
+	}
+
+	bool isArenaBound = false;
+	vk::IndexType boundIndexType = vk::IndexType::eUint32;
+
+	for (uint32_t i = 0; i < MAX_SHADOW_COUNT; i++) {
+		LightStorage::ShadowLight light;
+
+		if (!lightStorage.getShadowLight(i, light))
+			continue;
+
+		ShadowData data = {};
+		data.tile = _tileRect(i);
+
+		if (light.type == LightType::Directional)
+			_computeCascades(data, light.transform, camera, aspect, _tileSize);
+		else
+			_computeCube(data, light.transform, light.range);
+
+		// cascades follow camera, unchanged placement keeps cached depth valid
+		bool isMoved = memcmp(&data, &_shadowData[i], sizeof(ShadowData)) != 0;
+
+		if (!light.isDirty && !isMoved)
+			continue;
+
+		_shadowData[i] = data;
+
+		if (!isArenaBound) {
+			geometryArena.bind(commandBuffer);
+			isArenaBound = true;
+		}
+
+		_renderTile(commandBuffer, frame, i, light.type, geometryArena, casters, boundIndexType);
+		lightStorage.shadowClearDirty(i);
+	}
+
+	// matrices of every tile, including ones rendered by other frames, has to be written before
+	// submission as shadow pipeline reads it too
+	memcpy(_shadowAllocInfos[frame].pMappedData, _shadowData, sizeof(_shadowData));
+}
+
+void ShadowAtlas::_createAtlas() {
+	vk::ImageUsageFlags usage =
+			vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
+
+	_atlas = Attachment::create(_allocator, _device, _atlasSize, _atlasSize,
+			vk::Format::eD16Unorm, usage, vk::ImageAspectFlagBits::eDepth, SHADOW_LAYER_COUNT,
+			vk::ImageViewType::e2DArray);
+
+	vk::ImageView atlasView = _atlas.getImageView();
+
+	vk::FramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.setAttachments(atlasView);
+	framebufferInfo.setWidth(_atlasSize);
+	framebufferInfo.setHeight(_atlasSize);
+	framebufferInfo.setLayers(1);
+
+	framebufferInfo.setRenderPass(_cascadeRenderPass);
+	vk::Result err = _device.createFramebuffer(&framebufferInfo, nullptr, &_cascadeFramebuffer);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Shadow cascade framebuffer creation failed!");
+
+	framebufferInfo.setRenderPass(_cubeRenderPass);
+	err = _device.createFramebuffer(&framebufferInfo, nullptr, &_cubeFramebuffer);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Shadow cube framebuffer creation failed!");
+
+	// tiles are empty, each is rendered again on next frame
+	_isAtlasTransitioned = false;
+	memset(_shadowData, 0, sizeof(_shadowData));
+}
+
+void ShadowAtlas::_destroyAtlas() {
+	_device.destroyFramebuffer(_cascadeFramebuffer);
+	_device.destroyFramebuffer(_cubeFramebuffer);
+	_atlas.destroy(_allocator, _device);
+}
+
+void ShadowAtlas::_writeAtlasSets(const LightStorage &lightStorage) {
+	vk::DescriptorImageInfo atlasInfo = {};
+	atlasInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	atlasInfo.setImageView(_atlas.getImageView());
+	atlasInfo.setSampler(_sampler);
+
+	// material shader samples atlas through light set
+	for (uint32_t i = 0; i < RD::getSingleton().getFramesInFlight(); i++) {
+		vk::WriteDescriptorSet writeInfo;
+		writeInfo.setDstSet(lightStorage.getLightSet(i));
+		writeInfo.setDstBinding(5);
+		writeInfo.setDstArrayElement(0);
+		writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfo.setDescriptorCount(1);
+		writeInfo.setImageInfo(atlasInfo);
+
+		_device.updateDescriptorSets(writeInfo, nullptr);
+	}
+}
+
+void ShadowAtlas::setAtlasSize(uint32_t size, const LightStorage &lightStorage) {
+	size = std::clamp(size, MIN_SHADOW_ATLAS_SIZE, MAX_SHADOW_ATLAS_SIZE);
+	size = 1u << static_cast<uint32_t>(std::floor(std::log2(size)));
+
+	if (size == _atlasSize)
+		return;
+
+	_atlasSize = size;
+	_tileSize = size / SHADOW_TILES_PER_ROW;
+
+	if (!_initialized)
+		return;
+
+	_destroyAtlas();
+	_createAtlas();
+	_writeAtlasSets(lightStorage);
+}
+
+uint32_t ShadowAtlas::getAtlasSize() const {
+	return _atlasSize;
+}
+
+void ShadowAtlas::initialize(vk::Device device, VmaAllocator allocator,
+		vk::DescriptorPool descriptorPool, const LightStorage &lightStorage) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_allocator = allocator;
+
+	// reverse depth, fragment is lit when it is at least as close to light as stored depth
+	vk::SamplerCreateInfo samplerInfo = {};
+	samplerInfo.setMagFilter(vk::Filter::eLinear);
+	samplerInfo.setMinFilter(vk::Filter::eLinear);
+	samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+	samplerInfo.setBorderColor(vk::BorderColor::eFloatOpaqueWhite);
+	samplerInfo.setUnnormalizedCoordinates(false);
+	samplerInfo.setCompareEnable(true);
+	samplerInfo.setCompareOp(vk::CompareOp::eGreaterOrEqual);
+	samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+	samplerInfo.setMinLod(0.0f);
+	samplerInfo.setMaxLod(0.0f);
+
+	_sampler = device.createSampler(samplerInfo);
+
+	// write from layer 0 (last bit) to last cascade or cube face
+	_cascadeRenderPass = _createRenderPass((1u << SHADOW_CASCADE_COUNT) - 1);
+	_cubeRenderPass = _createRenderPass((1u << SHADOW_LAYER_COUNT) - 1);
+
+	_createAtlas();
+
+	std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eVertex);
+	}
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Shadow descriptor set layout creation failed!");
+
+	uint32_t framesInFlight = RD::getSingleton().getFramesInFlight();
+
+	std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Shadow descriptor set allocation failed!");
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_casterBuffers[i] = AllocatedBuffer::create(allocator, MemoryCategory::Light,
+				BufferClass::Dynamic, vk::BufferUsageFlagBits::eStorageBuffer,
+				sizeof(InstanceTransform) * MAX_SHADOW_CASTER_COUNT, &_casterAllocInfos[i]);
+
+		_shadowBuffers[i] = AllocatedBuffer::create(allocator, MemoryCategory::Light,
+				BufferClass::Dynamic, vk::BufferUsageFlagBits::eStorageBuffer, sizeof(_shadowData),
+				&_shadowAllocInfos[i]);
+
+		vk::DescriptorBufferInfo casterInfo = _casterBuffers[i].getBufferInfo();
+		vk::DescriptorBufferInfo shadowInfo = _shadowBuffers[i].getBufferInfo();
+
+		std::array<vk::WriteDescriptorSet, 3> writeInfos = {};
+
+		for (uint32_t j = 0; j < bindings.size(); j++) {
+			writeInfos[j].setDstSet(_sets[i]);
+			writeInfos[j].setDstBinding(j);
+			writeInfos[j].setDstArrayElement(0);
+			writeInfos[j].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+			writeInfos[j].setDescriptorCount(1);
+		}
+
+		writeInfos[0].setBufferInfo(casterInfo);
+		writeInfos[1].setBufferInfo(shadowInfo);
+
+		// material shader samples atlas through light set
+		writeInfos[2].setDstSet(lightStorage.getLightSet(i));
+		writeInfos[2].setDstBinding(4);
+		writeInfos[2].setDstArrayElement(0);
+		writeInfos[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writeInfos[2].setDescriptorCount(1);
+		writeInfos[2].setBufferInfo(shadowInfo);
+
+		device.updateDescriptorSets(writeInfos, nullptr);
+	}
+
+	_writeAtlasSets(lightStorage);
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eVertex);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(ShadowPushConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	_cascadePipeline = _createPipeline(_cascadeRenderPass);
+	_cubePipeline = _createPipeline(_cubeRenderPass);
+
+	_initialized = true;
+}
@@ -0,0 +1,131 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/render_queue.h>
+#include <rendering/storage/geometry_arena.h>
+#include <rendering/storage/light_storage.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/attachment.h>
+#include <rendering/types/camera.h>
+#include <rendering/types/frame.h>
+
+// tiles are square, atlas holds MAX_SHADOW_COUNT of them in every layer
+const uint32_t DEFAULT_SHADOW_ATLAS_SIZE = 2048;
+const uint32_t MIN_SHADOW_ATLAS_SIZE = 256;
+const uint32_t MAX_SHADOW_ATLAS_SIZE = 8192;
+const uint32_t SHADOW_TILES_PER_ROW = 4;
+
+static_assert(SHADOW_TILES_PER_ROW * SHADOW_TILES_PER_ROW == MAX_SHADOW_COUNT,
+		"Shadow atlas does not fit MAX_SHADOW_COUNT tiles");
+
+// cube face per layer for point lights, cascade per layer for directional lights
+const uint32_t SHADOW_LAYER_COUNT = 6;
+const uint32_t SHADOW_CASCADE_COUNT = 4;
+
+// directional shadows end at this view distance
+const float SHADOW_DISTANCE = 50.0f;
+
+// per frame, every mesh instance casts shadow
+const uint32_t MAX_SHADOW_CASTER_COUNT = 65536;
+
+// Depth atlas of every shadowed light. A tile covers the same rectangle in all layers, multiview
+// renders cascades or cube faces of one light in single pass. Tiles keep their depth between
+// frames and are re-rendered only when light, cascade placement or casters in range change.
+class ShadowAtlas {
+private:
+	// has to match Shadow in shaders/include/light_incl.glsl
+	struct ShadowData {
+		glm::mat4 viewProj[SHADOW_LAYER_COUNT];
+
+		// uv offset in xy, uv scale in zw
+		glm::vec4 tile;
+
+		// far view depth of every cascade, directional only
+		glm::vec4 splits;
+	};
+	static_assert(sizeof(ShadowData) % 16 == 0, "ShadowData is not multiple of 16");
+
+	typedef struct {
+		uint32_t shadow;
+	} ShadowPushConstants;
+
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	uint32_t _atlasSize = DEFAULT_SHADOW_ATLAS_SIZE;
+	uint32_t _tileSize = DEFAULT_SHADOW_ATLAS_SIZE / SHADOW_TILES_PER_ROW;
+
+	Attachment _atlas;
+	vk::Sampler _sampler;
+	bool _isAtlasTransitioned = false;
+
+	// multiview masks are part of render pass, cascades and cube faces need one each
+	vk::RenderPass _cascadeRenderPass;
+	vk::RenderPass _cubeRenderPass;
+	vk::Framebuffer _cascadeFramebuffer;
+	vk::Framebuffer _cubeFramebuffer;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_FRAMES_IN_FLIGHT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _cascadePipeline;
+	vk::Pipeline _cubePipeline;
+
+	// matrices tiles were rendered with, uploaded whole every frame
+	ShadowData _shadowData[MAX_SHADOW_COUNT] = {};
+
+	AllocatedBuffer _shadowBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _shadowAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	std::vector<InstanceTransform> _casterTransforms;
+	bool _isCasterBufferStale[MAX_FRAMES_IN_FLIGHT] = {};
+
+	AllocatedBuffer _casterBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _casterAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	bool _initialized = false;
+
+	static glm::vec4 _tileRect(uint32_t tile);
+	static void _computeCascades(ShadowData &data, const glm::mat4 &transform,
+			const Camera &camera, float aspect, uint32_t tileSize);
+	static void _computeCube(ShadowData &data, const glm::mat4 &transform, float range);
+
+	// with framebuffers of both render passes
+	void _createAtlas();
+	void _destroyAtlas();
+	void _writeAtlasSets(const LightStorage &lightStorage);
+
+	vk::RenderPass _createRenderPass(uint32_t viewMask);
+	vk::Pipeline _createPipeline(vk::RenderPass renderPass);
+
+	// boundIndexType is index type bound to commandBuffer, updated on rebind
+	void _renderTile(vk::CommandBuffer commandBuffer, uint32_t frame, uint32_t tile,
+			LightType type, const GeometryArena &geometryArena, const RenderQueue &casters,
+			vk::IndexType &boundIndexType);
+
+public:
+	// transforms indexed by first instance of caster queue batches
+	void updateCasters(const std::vector<InstanceTransform> &transforms);
+
+	// has to be recorded before render pass, after light storage is updated
+	void render(vk::CommandBuffer commandBuffer, uint32_t frame, const Camera &camera,
+			float aspect, LightStorage &lightStorage, const GeometryArena &geometryArena,
+			const RenderQueue &casters);
+
+	// rounded down to power of two within MIN_SHADOW_ATLAS_SIZE and MAX_SHADOW_ATLAS_SIZE, every
+	// tile is rendered again, no frame in flight may use atlas once initialized
+	void setAtlasSize(uint32_t size, const LightStorage &lightStorage);
+	uint32_t getAtlasSize() const;
+
+	void initialize(vk::Device device, VmaAllocator allocator, vk::DescriptorPool descriptorPool,
+			const LightStorage &lightStorage);
+};
+
+#endif // !SHADOW_ATLAS_H
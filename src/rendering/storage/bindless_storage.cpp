@@ -0,0 +1,125 @@
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+#include "bindless_storage.h"
+
+uint32_t BindlessSlots::allocate() {
+	if (!_freeSlots.empty()) {
+		uint32_t slot = _freeSlots.front();
+		_freeSlots.pop_front();
+
+		return slot;
+	}
+
+	if (_next >= _capacity)
+		return INVALID_SLOT;
+
+	return _next++;
+}
+
+void BindlessSlots::free(uint32_t slot) {
+	if (slot >= _next)
+		return;
+
+	_freeSlots.push_back(slot);
+}
+
+BindlessSlots::BindlessSlots(uint32_t capacity) {
+	_capacity = capacity;
+}
+
+uint32_t BindlessStorage::textureAdd(vk::ImageView imageView, vk::Sampler sampler) {
+	std::lock_guard<std::mutex> lock(_textureMutex);
+	uint32_t texture = _textureSlots.allocate();
+
+	if (texture == BindlessSlots::INVALID_SLOT) {
+		std::cout << "ERROR: Bindless texture limit reached!" << std::endl;
+		return 0;
+	}
+
+	vk::DescriptorImageInfo imageInfo = {};
+	imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	imageInfo.setImageView(imageView);
+	imageInfo.setSampler(sampler);
+
+	vk::WriteDescriptorSet writeInfo = {};
+	writeInfo.setDstSet(_bindlessSet);
+	writeInfo.setDstBinding(0);
+	writeInfo.setDstArrayElement(texture);
+	writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfo.setDescriptorCount(1);
+	writeInfo.setImageInfo(imageInfo);
+
+	_device.updateDescriptorSets(writeInfo, nullptr);
+
+	return texture;
+}
+
+void BindlessStorage::textureRemove(uint32_t texture) {
+	std::lock_guard<std::mutex> lock(_textureMutex);
+	_textureSlots.free(texture);
+}
+
+vk::DescriptorSetLayout BindlessStorage::getBindlessSetLayout() const {
+	return _bindlessSetLayout;
+}
+
+vk::DescriptorSet BindlessStorage::getBindlessSet() const {
+	return _bindlessSet;
+}
+
+void BindlessStorage::initialize(vk::Device device) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_textureSlots = BindlessSlots(MAX_BINDLESS_TEXTURE_COUNT);
+
+	vk::DescriptorPoolSize poolSize = {
+		vk::DescriptorType::eCombinedImageSampler, MAX_BINDLESS_TEXTURE_COUNT
+	};
+
+	vk::DescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT);
+	poolCreateInfo.setMaxSets(1);
+	poolCreateInfo.setPoolSizes(poolSize);
+
+	_descriptorPool = device.createDescriptorPool(poolCreateInfo);
+
+	vk::DescriptorSetLayoutBinding binding = {};
+	binding.setBinding(0);
+	binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	binding.setDescriptorCount(MAX_BINDLESS_TEXTURE_COUNT);
+	binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	// textures are written while set is bound, unused slots stay empty
+	vk::DescriptorBindingFlagsEXT bindingFlags = vk::DescriptorBindingFlagBitsEXT::ePartiallyBound |
+			vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind;
+
+	vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.setBindingFlags(bindingFlags);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT);
+	createInfo.setBindings(binding);
+	createInfo.setPNext(&bindingFlagsInfo);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_bindlessSetLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Bindless descriptor set layout creation failed!");
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(_descriptorPool);
+	allocInfo.setDescriptorSetCount(1);
+	allocInfo.setSetLayouts(_bindlessSetLayout);
+
+	err = device.allocateDescriptorSets(&allocInfo, &_bindlessSet);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Bindless descriptor set allocation failed!");
+
+	_initialized = true;
+}
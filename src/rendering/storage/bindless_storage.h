@@ -0,0 +1,57 @@
+#ifndef BINDLESS_STORAGE_H
+#define BINDLESS_STORAGE_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include <vulkan/vulkan.hpp>
+
+const uint32_t MAX_BINDLESS_TEXTURE_COUNT = 4096;
+
+// Slot allocator, released slots are reused oldest first so frames in flight still see the
+// previous contents.
+class BindlessSlots {
+private:
+	std::deque<uint32_t> _freeSlots;
+	uint32_t _next = 0;
+	uint32_t _capacity = 0;
+
+public:
+	static const uint32_t INVALID_SLOT = UINT32_MAX;
+
+	uint32_t allocate();
+	void free(uint32_t slot);
+
+	BindlessSlots(uint32_t capacity = 0);
+};
+
+// Every texture in one descriptor array, material shader indexes it with texture indices of
+// MaterialStorage.
+class BindlessStorage {
+	vk::Device _device;
+
+	BindlessSlots _textureSlots;
+
+	// textures are added by loader threads too, set writes need external synchronization
+	std::mutex _textureMutex;
+
+	// update after bind sets need pool created with matching flag
+	vk::DescriptorPool _descriptorPool;
+
+	vk::DescriptorSetLayout _bindlessSetLayout;
+	vk::DescriptorSet _bindlessSet;
+
+	bool _initialized = false;
+
+public:
+	uint32_t textureAdd(vk::ImageView imageView, vk::Sampler sampler);
+	void textureRemove(uint32_t texture);
+
+	vk::DescriptorSetLayout getBindlessSetLayout() const;
+	vk::DescriptorSet getBindlessSet() const;
+
+	void initialize(vk::Device device);
+};
+
+#endif // !BINDLESS_STORAGE_H
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <rendering/rendering_device.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/vertex.h>
+
+#include "geometry_arena.h"
+
+const uint32_t INITIAL_VERTEX_CAPACITY = 1 << 18;
+const uint32_t INITIAL_INDEX_CAPACITY = 1 << 20;
+const uint32_t INITIAL_SHORT_INDEX_CAPACITY = 1 << 20;
+
+// mesh relative indices are below vertex count
+const uint32_t SHORT_INDEX_VERTEX_LIMIT = UINT16_MAX + 1;
+
+// skin shader reads bind pose and writes posed vertices through storage bindings
+const vk::BufferUsageFlags VERTEX_USAGE = vk::BufferUsageFlagBits::eVertexBuffer |
+										  vk::BufferUsageFlagBits::eStorageBuffer |
+										  vk::BufferUsageFlagBits::eTransferSrc |
+										  vk::BufferUsageFlagBits::eTransferDst;
+
+const vk::BufferUsageFlags INDEX_USAGE = vk::BufferUsageFlagBits::eIndexBuffer |
+										 vk::BufferUsageFlagBits::eTransferSrc |
+										 vk::BufferUsageFlagBits::eTransferDst;
+
+uint32_t RangeAllocator::allocate(uint32_t size) {
+	for (auto iter = _freeRanges.begin(); iter != _freeRanges.end(); iter++) {
+		uint32_t offset = iter->first;
+		uint32_t rangeSize = iter->second;
+
+		if (rangeSize < size)
+			continue;
+
+		_freeRanges.erase(iter);
+
+		if (rangeSize > size)
+			_freeRanges[offset + size] = rangeSize - size;
+
+		return offset;
+	}
+
+	return INVALID_OFFSET;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+	if (size == 0)
+		return;
+
+	auto next = _freeRanges.lower_bound(offset);
+
+	// merge with following range
+	if (next != _freeRanges.end() && offset + size == next->first) {
+		size += next->second;
+		next = _freeRanges.erase(next);
+	}
+
+	// merge with preceding range
+	if (next != _freeRanges.begin()) {
+		auto prev = std::prev(next);
+
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+
+	_freeRanges[offset] = size;
+}
+
+void RangeAllocator::grow(uint32_t capacity) {
+	if (capacity <= _capacity)
+		return;
+
+	uint32_t oldCapacity = _capacity;
+	_capacity = capacity;
+
+	free(oldCapacity, capacity - oldCapacity);
+}
+
+uint32_t RangeAllocator::getCapacity() const {
+	return _capacity;
+}
+
+void GeometryArena::_growVertexBuffer(uint32_t vertexCount) {
+	RD &rd = RD::getSingleton();
+
+	uint32_t oldCapacity = _vertexRanges.getCapacity();
+	uint32_t capacity = std::max(oldCapacity * 2, oldCapacity + vertexCount);
+
+	AllocatedBuffer positionBuffer = AllocatedBuffer::create(_allocator, MemoryCategory::Mesh,
+			BufferClass::Static, VERTEX_USAGE, sizeof(PackedPosition) * capacity);
+	AllocatedBuffer attributeBuffer = AllocatedBuffer::create(_allocator, MemoryCategory::Mesh,
+			BufferClass::Static, VERTEX_USAGE, sizeof(PackedAttributes) * capacity);
+
+	// old buffers may still be used by frames in flight and recorded uploads
+	rd.getUploadManager().flush();
+
+	{
+		std::lock_guard<std::mutex> lock(rd.getQueueMutex());
+		rd.getDevice().waitIdle();
+	}
+
+	rd.bufferCopy(_positionBuffer.buffer, positionBuffer.buffer,
+			sizeof(PackedPosition) * oldCapacity);
+	rd.bufferCopy(_attributeBuffer.buffer, attributeBuffer.buffer,
+			sizeof(PackedAttributes) * oldCapacity);
+
+	rd.bufferDestroy(_positionBuffer);
+	rd.bufferDestroy(_attributeBuffer);
+
+	_positionBuffer = positionBuffer;
+	_attributeBuffer = attributeBuffer;
+	_vertexRanges.grow(capacity);
+}
+
+void GeometryArena::_growIndexBuffer(vk::IndexType indexType, uint32_t indexCount) {
+	RD &rd = RD::getSingleton();
+
+	bool isShort = indexType == vk::IndexType::eUint16;
+
+	AllocatedBuffer &indexBuffer = isShort ? _shortIndexBuffer : _indexBuffer;
+	RangeAllocator &indexRanges = isShort ? _shortIndexRanges : _indexRanges;
+	size_t indexSize = isShort ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	uint32_t oldCapacity = indexRanges.getCapacity();
+	uint32_t capacity = std::max(oldCapacity * 2, oldCapacity + indexCount);
+
+	AllocatedBuffer buffer = AllocatedBuffer::create(_allocator, MemoryCategory::Mesh,
+			BufferClass::Static, INDEX_USAGE, indexSize * capacity);
+
+	rd.getUploadManager().flush();
+
+	{
+		std::lock_guard<std::mutex> lock(rd.getQueueMutex());
+		rd.getDevice().waitIdle();
+	}
+
+	rd.bufferCopy(indexBuffer.buffer, buffer.buffer, indexSize * oldCapacity);
+	rd.bufferDestroy(indexBuffer);
+
+	indexBuffer = buffer;
+	indexRanges.grow(capacity);
+}
+
+GeometryRange GeometryArena::allocate(const PackedPosition *pPositions,
+		const PackedAttributes *pAttributes, uint32_t vertexCount, const uint32_t *pIndices,
+		uint32_t indexCount) {
+	RD &rd = RD::getSingleton();
+
+	GeometryRange range = {};
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+
+	if (vertexCount > 0) {
+		range.vertexOffset = _vertexRanges.allocate(vertexCount);
+
+		if (range.vertexOffset == RangeAllocator::INVALID_OFFSET) {
+			_growVertexBuffer(vertexCount);
+			range.vertexOffset = _vertexRanges.allocate(vertexCount);
+		}
+	}
+
+	if (vertexCount > 0 && pPositions != nullptr && pAttributes != nullptr) {
+		rd.bufferSend(_positionBuffer.buffer, (uint8_t *)pPositions,
+				sizeof(PackedPosition) * vertexCount, sizeof(PackedPosition) * range.vertexOffset);
+		rd.bufferSend(_attributeBuffer.buffer, (uint8_t *)pAttributes,
+				sizeof(PackedAttributes) * vertexCount,
+				sizeof(PackedAttributes) * range.vertexOffset);
+	}
+
+	if (vertexCount <= SHORT_INDEX_VERTEX_LIMIT)
+		range.indexType = vk::IndexType::eUint16;
+
+	if (indexCount > 0 && range.indexType == vk::IndexType::eUint16) {
+		std::vector<uint16_t> shortIndices(pIndices, pIndices + indexCount);
+
+		range.indexOffset = _shortIndexRanges.allocate(indexCount);
+
+		if (range.indexOffset == RangeAllocator::INVALID_OFFSET) {
+			_growIndexBuffer(vk::IndexType::eUint16, indexCount);
+			range.indexOffset = _shortIndexRanges.allocate(indexCount);
+		}
+
+		rd.bufferSend(_shortIndexBuffer.buffer, (uint8_t *)shortIndices.data(),
+				sizeof(uint16_t) * indexCount, sizeof(uint16_t) * range.indexOffset);
+	} else if (indexCount > 0) {
+		range.indexOffset = _indexRanges.allocate(indexCount);
+
+		if (range.indexOffset == RangeAllocator::INVALID_OFFSET) {
+			_growIndexBuffer(vk::IndexType::eUint32, indexCount);
+			range.indexOffset = _indexRanges.allocate(indexCount);
+		}
+
+		rd.bufferSend(_indexBuffer.buffer, (uint8_t *)pIndices, sizeof(uint32_t) * indexCount,
+				sizeof(uint32_t) * range.indexOffset);
+	}
+
+	return range;
+}
+
+void GeometryArena::free(const GeometryRange &range) {
+	_vertexRanges.free(range.vertexOffset, range.vertexCount);
+
+	if (range.indexType == vk::IndexType::eUint16)
+		_shortIndexRanges.free(range.indexOffset, range.indexCount);
+	else
+		_indexRanges.free(range.indexOffset, range.indexCount);
+}
+
+void GeometryArena::bind(vk::CommandBuffer commandBuffer) const {
+	vk::Buffer buffers[] = { _positionBuffer.buffer, _attributeBuffer.buffer };
+	vk::DeviceSize offsets[] = { 0, 0 };
+
+	commandBuffer.bindVertexBuffers(0, 2, buffers, offsets);
+	commandBuffer.bindIndexBuffer(_indexBuffer.buffer, 0, vk::IndexType::eUint32);
+}
+
+void GeometryArena::bindIndices(vk::CommandBuffer commandBuffer, vk::IndexType indexType) const {
+	bool isShort = indexType == vk::IndexType::eUint16;
+	commandBuffer.bindIndexBuffer(isShort ? _shortIndexBuffer.buffer : _indexBuffer.buffer, 0,
+			indexType);
+}
+
+AllocatedBuffer GeometryArena::getPositionBuffer() const {
+	return _positionBuffer;
+}
+
+AllocatedBuffer GeometryArena::getAttributeBuffer() const {
+	return _attributeBuffer;
+}
+
+void GeometryArena::initialize(VmaAllocator allocator) {
+	if (_initialized)
+		return;
+
+	_allocator = allocator;
+
+	_positionBuffer = AllocatedBuffer::create(allocator, MemoryCategory::Mesh,
+			BufferClass::Static, VERTEX_USAGE, sizeof(PackedPosition) * INITIAL_VERTEX_CAPACITY);
+	_attributeBuffer = AllocatedBuffer::create(allocator, MemoryCategory::Mesh,
+			BufferClass::Static, VERTEX_USAGE, sizeof(PackedAttributes) * INITIAL_VERTEX_CAPACITY);
+	_indexBuffer = AllocatedBuffer::create(allocator, MemoryCategory::Mesh,
+			BufferClass::Static, INDEX_USAGE, sizeof(uint32_t) * INITIAL_INDEX_CAPACITY);
+	_shortIndexBuffer = AllocatedBuffer::create(allocator, MemoryCategory::Mesh,
+			BufferClass::Static, INDEX_USAGE, sizeof(uint16_t) * INITIAL_SHORT_INDEX_CAPACITY);
+
+	_vertexRanges.grow(INITIAL_VERTEX_CAPACITY);
+	_indexRanges.grow(INITIAL_INDEX_CAPACITY);
+	_shortIndexRanges.grow(INITIAL_SHORT_INDEX_CAPACITY);
+
+	_initialized = true;
+}
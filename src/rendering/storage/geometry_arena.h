@@ -0,0 +1,80 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <cstdint>
+#include <map>
+
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/types/allocated.h>
+#include <rendering/types/vertex.h>
+
+// First fit allocator over [0, capacity), free ranges are coalesced on release.
+class RangeAllocator {
+private:
+	// offset -> size
+	std::map<uint32_t, uint32_t> _freeRanges;
+	uint32_t _capacity = 0;
+
+public:
+	static const uint32_t INVALID_OFFSET = UINT32_MAX;
+
+	uint32_t allocate(uint32_t size);
+	void free(uint32_t offset, uint32_t size);
+
+	// extends last range or appends new one
+	void grow(uint32_t capacity);
+
+	uint32_t getCapacity() const;
+};
+
+struct GeometryRange {
+	uint32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+
+	// offset is into index buffer of this type
+	uint32_t indexOffset = 0;
+	uint32_t indexCount = 0;
+	vk::IndexType indexType = vk::IndexType::eUint32;
+};
+
+// Vertices and indices of all meshes, sub-allocated from vertex buffers and two index buffers.
+// Position and attribute streams are separate buffers sharing vertex ranges, so depth only
+// passes fetch positions alone. Meshes whose indices fit 16 bits store them in the short index
+// buffer, halving index fetch.
+class GeometryArena {
+private:
+	VmaAllocator _allocator;
+
+	AllocatedBuffer _positionBuffer;
+	AllocatedBuffer _attributeBuffer;
+	AllocatedBuffer _indexBuffer;
+	AllocatedBuffer _shortIndexBuffer;
+
+	RangeAllocator _vertexRanges;
+	RangeAllocator _indexRanges;
+	RangeAllocator _shortIndexRanges;
+
+	bool _initialized = false;
+
+	void _growVertexBuffer(uint32_t vertexCount);
+	void _growIndexBuffer(vk::IndexType indexType, uint32_t indexCount);
+
+public:
+	// null streams leave vertices unwritten, for ranges filled on GPU
+	GeometryRange allocate(const PackedPosition *pPositions, const PackedAttributes *pAttributes,
+			uint32_t vertexCount, const uint32_t *pIndices, uint32_t indexCount);
+	void free(const GeometryRange &range);
+
+	// binds both streams and 32 bit indices, pipelines without attribute binding never fetch it
+	void bind(vk::CommandBuffer commandBuffer) const;
+	void bindIndices(vk::CommandBuffer commandBuffer, vk::IndexType indexType) const;
+
+	// replaced as arena grows
+	AllocatedBuffer getPositionBuffer() const;
+	AllocatedBuffer getAttributeBuffer() const;
+
+	void initialize(VmaAllocator allocator);
+};
+
+#endif // !GEOMETRY_ARENA_H
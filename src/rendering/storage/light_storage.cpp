@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -5,6 +8,10 @@
 #include <stdexcept>
 #include <vector>
 
+#include <profiler.h>
+#include <rendering/memory_tracker.h>
+#include <rendering/rendering_device.h>
+
 #include "light_storage.h"
 
 #define CHECK_IF_VALID(owner, id, what)                                                            \
@@ -13,67 +20,540 @@
 		return;                                                                                    \
 	}
 
+void LightStorage::_markDirty(DirtyRange (&ranges)[MAX_FRAMES_IN_FLIGHT], uint32_t index) {
+	for (DirtyRange &range : ranges) {
+		if (range.begin == range.end) {
+			range = { index, index + 1 };
+			continue;
+		}
+
+		range.begin = std::min(range.begin, index);
+		range.end = std::max(range.end, index + 1);
+	}
+}
+
+void LightStorage::_pack(const LightRD &light) {
+	if (light.type == LightType::Directional) {
+		glm::vec3 direction(0.0, 0.0, -1.0);
+		direction = glm::mat3(light.transform) * direction;
+
+		DirectionalData &data = _directionalData[light.index];
+		memcpy(data.direction, &direction, sizeof(data.direction));
+		memcpy(data.color, &light.color, sizeof(data.color));
+		// entry stays packed, without intensity it adds nothing
+		data.intensity = light.isBaked ? 0.0f : light.intensity;
+		data.shadow = light.shadow;
+
+		_markDirty(_directionalDirty, light.index);
+		return;
+	}
+
+	if (light.type == LightType::Point) {
+		glm::vec3 position(light.transform[3]);
+
+		PunctualData &data = _pointData[light.index];
+		memcpy(data.position, &position, sizeof(data.position));
+		data.range = light.range;
+		memcpy(data.color, &light.color, sizeof(data.color));
+		data.intensity = light.intensity;
+		data.shadow = light.shadow;
+
+		// visible lights are copied out every frame, nothing to mark
+		return;
+	}
+}
+
+void LightStorage::_updateBounds(ObjectID id, LightRD &light) {
+	if (light.type != LightType::Point)
+		return;
+
+	auto unbounded = std::find(_unboundedPoints.begin(), _unboundedPoints.end(), id);
+
+	// never uploaded for clusters
+	if (light.isBaked) {
+		if (light.proxy != AABB_TREE_NULL)
+			_pointTree.remove(light.proxy);
+
+		light.proxy = AABB_TREE_NULL;
+
+		if (unbounded != _unboundedPoints.end())
+			_unboundedPoints.erase(unbounded);
+
+		return;
+	}
+
+	if (light.range <= 0.0f) {
+		if (light.proxy != AABB_TREE_NULL)
+			_pointTree.remove(light.proxy);
+
+		light.proxy = AABB_TREE_NULL;
+
+		if (unbounded == _unboundedPoints.end())
+			_unboundedPoints.push_back(id);
+
+		return;
+	}
+
+	if (unbounded != _unboundedPoints.end())
+		_unboundedPoints.erase(unbounded);
+
+	glm::vec3 position(light.transform[3]);
+	AABB aabb = { position - light.range, position + light.range };
+
+	if (light.proxy == AABB_TREE_NULL)
+		light.proxy = _pointTree.insert(aabb, id);
+	else
+		_pointTree.update(light.proxy, aabb);
+}
+
+float LightStorage::_getDrawDistance(const LightRD &light) {
+	if (light.range <= 0.0f)
+		return INFINITY;
+
+	if (light.drawDistance > 0.0f)
+		return light.drawDistance;
+
+	// importance falls with square of distance, it reaches cutoff here
+	return light.range * std::sqrt(std::max(light.intensity, 0.0f) / LIGHT_IMPORTANCE_CUTOFF);
+}
+
 ObjectID LightStorage::lightCreate(LightType type) {
-	LightRD light;
+	LightRD light = {};
 	light.type = type;
+	light.transform = glm::mat4(1.0f);
+	light.shadow = -1;
+	light.proxy = AABB_TREE_NULL;
+
+	if (type == LightType::Directional) {
+		light.index = static_cast<uint32_t>(_directionalData.size());
+		_directionalData.push_back({});
+	} else {
+		light.index = static_cast<uint32_t>(_pointData.size());
+		_pointData.push_back({});
+	}
+
+	ObjectID id = _lights.insert(light);
+
+	if (type == LightType::Directional)
+		_directionalOwners.push_back(id);
+	else
+		_pointOwners.push_back(id);
+
+	_pack(light);
+	_updateBounds(id, _lights[id]);
 
-	return _lights.insert(light);
+	return id;
 }
 
 void LightStorage::lightSetTransform(ObjectID light, const glm::mat4 &transform) {
 	CHECK_IF_VALID(_lights, light, "Light");
 	_lights[light].transform = transform;
+	_pack(_lights[light]);
+	_updateBounds(light, _lights[light]);
+
+	if (_lights[light].shadow >= 0)
+		_shadowDirty[_lights[light].shadow] = true;
+}
+
+void LightStorage::lightSetTransforms(
+		const std::vector<ObjectID> &lights, const std::vector<glm::mat4> &transforms) {
+	size_t count = std::min(lights.size(), transforms.size());
+
+	for (size_t i = 0; i < count; i++) {
+		if (!_lights.has(lights[i])) {
+			std::cout << "ERROR: Light: " << lights[i] << " is not valid resource!" << std::endl;
+			continue;
+		}
+
+		LightRD &light = _lights[lights[i]];
+		light.transform = transforms[i];
+		_pack(light);
+		_updateBounds(lights[i], light);
+
+		if (light.shadow >= 0)
+			_shadowDirty[light.shadow] = true;
+	}
 }
 
 void LightStorage::lightSetRange(ObjectID light, float range) {
 	CHECK_IF_VALID(_lights, light, "Light");
 	_lights[light].range = range;
+	_pack(_lights[light]);
+	_updateBounds(light, _lights[light]);
+
+	if (_lights[light].shadow >= 0)
+		_shadowDirty[_lights[light].shadow] = true;
 }
 
 void LightStorage::lightSetColor(ObjectID light, const glm::vec3 &color) {
 	CHECK_IF_VALID(_lights, light, "Light");
 	_lights[light].color = color;
+	_pack(_lights[light]);
 }
 
 void LightStorage::lightSetIntensity(ObjectID light, float intensity) {
 	CHECK_IF_VALID(_lights, light, "Light");
 	_lights[light].intensity = intensity;
+	_pack(_lights[light]);
+}
+
+void LightStorage::lightSetDrawDistance(ObjectID light, float distance) {
+	CHECK_IF_VALID(_lights, light, "Light");
+	_lights[light].drawDistance = std::max(distance, 0.0f);
+}
+
+void LightStorage::lightSetBaked(ObjectID light, bool isBaked) {
+	CHECK_IF_VALID(_lights, light, "Light");
+
+	if (isBaked)
+		lightSetShadow(light, false);
+
+	LightRD &data = _lights[light];
+	data.isBaked = isBaked;
+
+	_pack(data);
+	_updateBounds(light, data);
+}
+
+void LightStorage::lightSetShadow(ObjectID light, bool castsShadow) {
+	CHECK_IF_VALID(_lights, light, "Light");
+
+	LightRD &data = _lights[light];
+
+	// baked shadows are in lightmaps already
+	if (castsShadow && data.isBaked)
+		return;
+
+	if (castsShadow == (data.shadow >= 0))
+		return;
+
+	if (!castsShadow) {
+		_shadowOwners[data.shadow] = 0;
+		data.shadow = -1;
+
+		_pack(data);
+		return;
+	}
+
+	for (uint32_t i = 0; i < MAX_SHADOW_COUNT; i++) {
+		if (_shadowOwners[i] != 0)
+			continue;
+
+		_shadowOwners[i] = light;
+		_shadowDirty[i] = true;
+		data.shadow = static_cast<int32_t>(i);
+
+		_pack(data);
+		return;
+	}
+
+	std::cout << "ERROR: Light: " << light << " has no free shadow tile!" << std::endl;
 }
 
 void LightStorage::lightFree(ObjectID light) {
+	CHECK_IF_VALID(_lights, light, "Light");
+
+	LightRD removed = _lights[light];
 	_lights.free(light);
+
+	if (removed.shadow >= 0)
+		_shadowOwners[removed.shadow] = 0;
+
+	if (removed.proxy != AABB_TREE_NULL)
+		_pointTree.remove(removed.proxy);
+
+	auto unbounded = std::find(_unboundedPoints.begin(), _unboundedPoints.end(), light);
+
+	if (unbounded != _unboundedPoints.end())
+		_unboundedPoints.erase(unbounded);
+
+	bool isDirectional = removed.type == LightType::Directional;
+	std::vector<ObjectID> &owners = isDirectional ? _directionalOwners : _pointOwners;
+	uint32_t last = static_cast<uint32_t>(owners.size()) - 1;
+
+	// move last packed entry into the hole, entries past count are not read
+	if (removed.index != last) {
+		ObjectID moved = owners[last];
+		owners[removed.index] = moved;
+
+		_lights[moved].index = removed.index;
+
+		if (isDirectional)
+			_directionalData[removed.index] = _directionalData[last];
+		else
+			_pointData[removed.index] = _pointData[last];
+
+		if (isDirectional)
+			_markDirty(_directionalDirty, removed.index);
+	}
+
+	owners.pop_back();
+
+	if (isDirectional)
+		_directionalData.pop_back();
+	else
+		_pointData.pop_back();
 }
 
-uint32_t LightStorage::getDirectionalLightCount() {
-	uint32_t count = 0;
-	for (const auto &[_, light] : _lights.map()) {
-		if (light.type != LightType::Directional)
+void LightStorage::shadowInvalidate(const AABB &aabb) {
+	for (uint32_t i = 0; i < MAX_SHADOW_COUNT; i++) {
+		if (_shadowOwners[i] == 0)
 			continue;
 
-		count++;
+		const LightRD &light = _lights[_shadowOwners[i]];
+
+		// directional light and point light with unlimited range reach everything
+		if (light.type == LightType::Directional || light.range <= 0.0f) {
+			_shadowDirty[i] = true;
+			continue;
+		}
+
+		glm::vec3 position(light.transform[3]);
+		glm::vec3 closest = glm::clamp(position, aabb.min, aabb.max);
+		glm::vec3 offset = closest - position;
+
+		if (glm::dot(offset, offset) <= light.range * light.range)
+			_shadowDirty[i] = true;
 	}
+}
 
-	return count;
+void LightStorage::shadowInvalidateAll() {
+	for (uint32_t i = 0; i < MAX_SHADOW_COUNT; i++)
+		_shadowDirty[i] = true;
+}
+
+bool LightStorage::getShadowLight(uint32_t tile, ShadowLight &shadow) const {
+	if (_shadowOwners[tile] == 0)
+		return false;
+
+	const LightRD &light = _lights[_shadowOwners[tile]];
+
+	shadow.type = light.type;
+	shadow.transform = light.transform;
+	shadow.range = light.range;
+	shadow.isDirty = _shadowDirty[tile];
+
+	return true;
 }
 
-uint32_t LightStorage::getPointLightCount() {
+void LightStorage::shadowClearDirty(uint32_t tile) {
+	_shadowDirty[tile] = false;
+}
+
+uint32_t LightStorage::getDirectionalLightCount() const {
+	return static_cast<uint32_t>(_directionalData.size());
+}
+
+uint32_t LightStorage::getPointLightCount() const {
+	return static_cast<uint32_t>(_pointData.size());
+}
+
+uint32_t LightStorage::getShadowedLightCount() const {
 	uint32_t count = 0;
-	for (const auto &[_, light] : _lights.map()) {
-		if (light.type != LightType::Point)
-			continue;
 
-		count++;
+	for (uint32_t tile = 0; tile < MAX_SHADOW_COUNT; tile++)
+		if (_shadowOwners[tile] != 0)
+			count++;
+
+	return count;
+}
+
+AllocatedBuffer LightStorage::getPointBuffer(uint32_t frame) const {
+	return _pointBuffers[frame];
+}
+
+uint32_t LightStorage::updateVisible(uint32_t frame, const glm::vec4 *pPlanes,
+		const glm::vec3 *pViewPositions, uint32_t frustumCount) {
+	PROFILE_ZONE("light visibility");
+
+	_treeResults.clear();
+
+	for (uint32_t i = 0; i < frustumCount; i++)
+		_pointTree.queryFrustum(pPlanes + i * 6, _treeResults);
+
+	for (ObjectID light : _unboundedPoints)
+		_treeResults.push_back(light);
+
+	_visible.clear();
+
+	for (uint64_t id : _treeResults) {
+		const LightRD &light = _lights[id];
+
+		VisibleLight visible = { light.index, 1.0f, INFINITY };
+
+		// unlimited range lights everything in view, it is always kept
+		if (light.range > 0.0f) {
+			glm::vec3 position(light.transform[3]);
+			float distance = INFINITY;
+
+			for (uint32_t i = 0; i < frustumCount; i++)
+				distance = std::min(distance, glm::distance(position, pViewPositions[i]));
+
+			float drawDistance = _getDrawDistance(light);
+
+			if (distance >= drawDistance)
+				continue;
+
+			float t = std::min((drawDistance - distance) / (drawDistance * LIGHT_FADE_BAND), 1.0f);
+			visible.fade = t * t * (3.0f - 2.0f * t);
+
+			// inside its range light covers much of view whatever the distance
+			float ratio = light.range / std::max(distance, light.range);
+			visible.importance = light.intensity * visible.fade * ratio * ratio;
+		}
+
+		_visible.push_back(visible);
 	}
 
+	auto isBefore = [](const VisibleLight &a, const VisibleLight &b) { return a.index < b.index; };
+	auto isSame = [](const VisibleLight &a, const VisibleLight &b) { return a.index == b.index; };
+
+	// lights seen by overlapping frustums are listed once
+	if (frustumCount > 1) {
+		std::sort(_visible.begin(), _visible.end(), isBefore);
+		_visible.erase(std::unique(_visible.begin(), _visible.end(), isSame), _visible.end());
+	}
+
+	if (_pointBudget > 0 && _visible.size() > _pointBudget) {
+		std::nth_element(_visible.begin(), _visible.begin() + _pointBudget, _visible.end(),
+				[](const VisibleLight &a, const VisibleLight &b) {
+					return a.importance > b.importance;
+				});
+		_visible.resize(_pointBudget);
+	}
+
+	// packed order keeps indices of clusters from shuffling while set of visible lights stays
+	// the same
+	std::sort(_visible.begin(), _visible.end(), isBefore);
+
+	uint32_t count = static_cast<uint32_t>(_visible.size());
+
+	// frame of this buffer is finished, it is rewritten as a whole
+	if (_fitBuffer(_pointBuffers[frame], _pointAllocInfos[frame], _pointCapacities[frame], count,
+				sizeof(PunctualData)))
+		_updateLightSet(frame);
+
+	PunctualData *pPointLightData =
+			reinterpret_cast<PunctualData *>(_pointAllocInfos[frame].pMappedData);
+
+	for (uint32_t i = 0; i < count; i++) {
+		PunctualData data = _pointData[_visible[i].index];
+		data.intensity *= _visible[i].fade;
+		pPointLightData[i] = data;
+	}
+
+	_visibleCounts[frame] = count;
+
 	return count;
 }
 
+uint32_t LightStorage::getVisiblePointLightCount(uint32_t frame) const {
+	return _visibleCounts[frame];
+}
+
+void LightStorage::setPointLightBudget(uint32_t count) {
+	_pointBudget = count;
+}
+
+uint32_t LightStorage::getPointLightBudget() const {
+	return _pointBudget;
+}
+
 vk::DescriptorSetLayout LightStorage::getLightSetLayout() const {
 	return _lightSetLayout;
 }
 
-vk::DescriptorSet LightStorage::getLightSet() const {
-	return _lightSet;
+vk::DescriptorSet LightStorage::getLightSet(uint32_t frame) const {
+	return _lightSets[frame];
+}
+
+void LightStorage::bindClusters(
+		uint32_t frame, AllocatedBuffer uniformBuffer, AllocatedBuffer clusterBuffer) {
+	vk::DescriptorBufferInfo uniformInfo = uniformBuffer.getBufferInfo();
+	vk::DescriptorBufferInfo clusterInfo = clusterBuffer.getBufferInfo();
+
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+	writeInfos[0].setDstSet(_lightSets[frame]);
+	writeInfos[0].setDstBinding(2);
+	writeInfos[0].setDstArrayElement(0);
+	writeInfos[0].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+	writeInfos[0].setDescriptorCount(1);
+	writeInfos[0].setBufferInfo(uniformInfo);
+
+	writeInfos[1].setDstSet(_lightSets[frame]);
+	writeInfos[1].setDstBinding(3);
+	writeInfos[1].setDstArrayElement(0);
+	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[1].setDescriptorCount(1);
+	writeInfos[1].setBufferInfo(clusterInfo);
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
+	_lightSetVersions[frame]++;
+}
+
+uint64_t LightStorage::getSetVersion(uint32_t frame) const {
+	return _lightSetVersions[frame];
+}
+
+uint32_t LightStorage::_fitCapacity(uint32_t capacity, uint32_t count) {
+	capacity = std::max(capacity, MIN_LIGHT_CAPACITY);
+
+	while (capacity < count)
+		capacity *= 2;
+
+	// hysteresis, so count changing around a power of two does not reallocate every frame
+	while (capacity > MIN_LIGHT_CAPACITY && count <= capacity / 4)
+		capacity /= 2;
+
+	return capacity;
+}
+
+bool LightStorage::_fitBuffer(AllocatedBuffer &buffer, VmaAllocationInfo &allocInfo,
+		uint32_t &capacity, uint32_t count, size_t stride) {
+	uint32_t fitted = _fitCapacity(capacity, count);
+
+	if (fitted == capacity)
+		return false;
+
+	// frame of this buffer is finished, nothing else references it
+	if (capacity > 0) {
+		MemoryTracker::untrack(buffer.allocation);
+		vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
+	}
+
+	vk::BufferUsageFlags usage =
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+
+	// light culler reads them on async compute, material shader on graphics queue
+	buffer = AllocatedBuffer::create(_allocator, MemoryCategory::Light, BufferClass::Dynamic,
+			usage, stride * fitted, &allocInfo, RD::getSingleton().getSharedQueueFamilies());
+	capacity = fitted;
+
+	return true;
+}
+
+void LightStorage::_updateLightSet(uint32_t frame) {
+	vk::DescriptorBufferInfo directionalLightBufferInfo =
+			_directionalBuffers[frame].getBufferInfo();
+	vk::DescriptorBufferInfo pointLightBufferInfo = _pointBuffers[frame].getBufferInfo();
+
+	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
+	writeInfos[0].setDstSet(_lightSets[frame]);
+	writeInfos[0].setDstBinding(0);
+	writeInfos[0].setDstArrayElement(0);
+	writeInfos[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[0].setDescriptorCount(1);
+	writeInfos[0].setBufferInfo(directionalLightBufferInfo);
+
+	writeInfos[1].setDstSet(_lightSets[frame]);
+	writeInfos[1].setDstBinding(1);
+	writeInfos[1].setDstArrayElement(0);
+	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	writeInfos[1].setDescriptorCount(1);
+	writeInfos[1].setBufferInfo(pointLightBufferInfo);
+
+	_device.updateDescriptorSets(writeInfos, nullptr);
+	_lightSetVersions[frame]++;
 }
 
 void LightStorage::initialize(
@@ -81,7 +561,10 @@ void LightStorage::initialize(
 	if (_initialized)
 		return;
 
-	std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {};
+	_device = device;
+	_allocator = allocator;
+
+	std::array<vk::DescriptorSetLayoutBinding, 6> bindings = {};
 	bindings[0].setBinding(0);
 	bindings[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
 	bindings[0].setDescriptorCount(1);
@@ -92,6 +575,28 @@ void LightStorage::initialize(
 	bindings[1].setDescriptorCount(1);
 	bindings[1].setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
+	// cluster parameters and light lists, written by LightCuller
+	bindings[2].setBinding(2);
+	bindings[2].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+	bindings[2].setDescriptorCount(1);
+	bindings[2].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	bindings[3].setBinding(3);
+	bindings[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	bindings[3].setDescriptorCount(1);
+	bindings[3].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	// shadow tile matrices and atlas, written by ShadowAtlas
+	bindings[4].setBinding(4);
+	bindings[4].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	bindings[4].setDescriptorCount(1);
+	bindings[4].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	bindings[5].setBinding(5);
+	bindings[5].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	bindings[5].setDescriptorCount(1);
+	bindings[5].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
 	vk::DescriptorSetLayoutCreateInfo createInfo = {};
 	createInfo.setBindings(bindings);
 
@@ -100,96 +605,60 @@ void LightStorage::initialize(
 	if (err != vk::Result::eSuccess)
 		throw std::runtime_error("Light descriptor set layout creation failed!");
 
+	uint32_t framesInFlight = RD::getSingleton().getFramesInFlight();
+
+	std::vector<vk::DescriptorSetLayout> setLayouts(framesInFlight, _lightSetLayout);
+
 	vk::DescriptorSetAllocateInfo allocInfo = {};
 	allocInfo.setDescriptorPool(descriptorPool);
-	allocInfo.setDescriptorSetCount(1);
-	allocInfo.setSetLayouts(_lightSetLayout);
+	allocInfo.setSetLayouts(setLayouts);
 
-	err = device.allocateDescriptorSets(&allocInfo, &_lightSet);
+	err = device.allocateDescriptorSets(&allocInfo, _lightSets);
 
 	if (err != vk::Result::eSuccess)
 		throw std::runtime_error("Light descriptor set allocation failed!");
 
-	vk::BufferUsageFlags usage =
-			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
-
-	{
-		vk::DeviceSize size = sizeof(DirectionalData) * MAX_DIRECTIONAL_LIGHT_COUNT;
-		_directionalBuffer =
-				AllocatedBuffer::create(allocator, usage, size, &_directionalAllocInfo);
-	}
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_fitBuffer(_directionalBuffers[i], _directionalAllocInfos[i], _directionalCapacities[i],
+				0, sizeof(DirectionalData));
+		_fitBuffer(_pointBuffers[i], _pointAllocInfos[i], _pointCapacities[i], 0,
+				sizeof(PunctualData));
 
-	{
-		vk::DeviceSize size = sizeof(PunctualData) * MAX_POINT_LIGHT_COUNT;
-		_pointBuffer = AllocatedBuffer::create(allocator, usage, size, &_pointAllocInfo);
+		_updateLightSet(i);
 	}
 
-	vk::DescriptorBufferInfo directionalLightBufferInfo = _directionalBuffer.getBufferInfo();
-	vk::DescriptorBufferInfo pointLightBufferInfo = _pointBuffer.getBufferInfo();
-
-	std::array<vk::WriteDescriptorSet, 2> writeInfos = {};
-	writeInfos[0].setDstSet(_lightSet);
-	writeInfos[0].setDstBinding(0);
-	writeInfos[0].setDstArrayElement(0);
-	writeInfos[0].setDescriptorType(vk::DescriptorType::eStorageBuffer);
-	writeInfos[0].setDescriptorCount(1);
-	writeInfos[0].setBufferInfo(directionalLightBufferInfo);
-
-	writeInfos[1].setDstSet(_lightSet);
-	writeInfos[1].setDstBinding(1);
-	writeInfos[1].setDstArrayElement(0);
-	writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
-	writeInfos[1].setDescriptorCount(1);
-	writeInfos[1].setBufferInfo(pointLightBufferInfo);
-
-	device.updateDescriptorSets(writeInfos, nullptr);
+	_initialized = true;
 }
 
-void LightStorage::update() {
-	uint32_t directionalLightIndex = 0;
-	std::vector<DirectionalData> directionalLightData(MAX_DIRECTIONAL_LIGHT_COUNT);
-
-	uint32_t pointLightIndex = 0;
-	std::vector<PunctualData> pointLightData(MAX_POINT_LIGHT_COUNT);
+void LightStorage::update(uint32_t frame) {
+	PROFILE_ZONE("light storage update");
 
-	for (const auto &[_, light] : _lights.map()) {
-		if (light.type == LightType::Directional) {
-			glm::vec3 direction(0.0, 0.0, -1.0);
-			direction = glm::mat3(light.transform) * direction;
+	DirtyRange &directionalDirty = _directionalDirty[frame];
 
-			DirectionalData data;
-			memcpy(data.direction, &direction, sizeof(data.direction));
-			memcpy(data.color, &light.color, sizeof(data.color));
-			data.intensity = light.intensity;
+	uint32_t directionalCount = static_cast<uint32_t>(_directionalData.size());
 
-			directionalLightData[directionalLightIndex] = data;
-			directionalLightIndex++;
-			continue;
-		}
+	bool isDirectionalResized = _fitBuffer(_directionalBuffers[frame],
+			_directionalAllocInfos[frame], _directionalCapacities[frame], directionalCount,
+			sizeof(DirectionalData));
 
-		if (light.type == LightType::Point) {
-			glm::vec3 position(light.transform[3]);
+	// new buffer holds nothing yet
+	if (isDirectionalResized) {
+		directionalDirty = { 0, directionalCount };
+		_updateLightSet(frame);
+	}
 
-			PunctualData data;
-			memcpy(data.position, &position, sizeof(data.position));
-			memcpy(data.color, &light.color, sizeof(data.color));
-			data.intensity = light.intensity;
+	// dirty range may reach past count after free, those entries are never read
+	uint32_t directionalEnd =
+			std::min(directionalDirty.end, static_cast<uint32_t>(_directionalData.size()));
 
-			pointLightData[pointLightIndex] = data;
-			pointLightIndex++;
-			continue;
-		}
-	}
+	if (directionalDirty.begin < directionalEnd) {
+		size_t offset = sizeof(DirectionalData) * directionalDirty.begin;
+		size_t size = sizeof(DirectionalData) * (directionalEnd - directionalDirty.begin);
 
-	{
-		void *pDiretionalLightData = _directionalAllocInfo.pMappedData;
-		size_t size = sizeof(DirectionalData) * MAX_DIRECTIONAL_LIGHT_COUNT;
-		memcpy(pDiretionalLightData, directionalLightData.data(), size);
+		uint8_t *pDirectionalLightData =
+				reinterpret_cast<uint8_t *>(_directionalAllocInfos[frame].pMappedData);
+		memcpy(pDirectionalLightData + offset, &_directionalData[directionalDirty.begin], size);
 	}
 
-	{
-		void *pPointLightData = _pointAllocInfo.pMappedData;
-		size_t size = sizeof(PunctualData) * MAX_POINT_LIGHT_COUNT;
-		memcpy(pPointLightData, pointLightData.data(), size);
-	}
+	directionalDirty = { 0, 0 };
 }
@@ -1,13 +1,28 @@
 #ifndef LIGHT_STORAGE_H
 #define LIGHT_STORAGE_H
 
+#include <cstdint>
+#include <vector>
+
 #include <glm/glm.hpp>
 
+#include <rendering/culling/aabb_tree.h>
 #include <rendering/object_owner.h>
+#include <rendering/types/aabb.h>
 #include <rendering/types/allocated.h>
+#include <rendering/types/frame.h>
+
+// light buffers grow geometrically from this size and never shrink below it
+const uint32_t MIN_LIGHT_CAPACITY = 16;
+
+// tiles in shadow atlas, one per shadowed light
+const uint32_t MAX_SHADOW_COUNT = 16;
 
-const uint32_t MAX_DIRECTIONAL_LIGHT_COUNT = 8;
-const uint32_t MAX_POINT_LIGHT_COUNT = 2048;
+// importance of point light, intensity times squared ratio of range to view distance, below
+// which it is no longer drawn unless its draw distance is set
+const float LIGHT_IMPORTANCE_CUTOFF = 1.0f / 256.0f;
+// fraction of draw distance before it over which point lights fade out
+const float LIGHT_FADE_BAND = 0.25f;
 
 enum class LightType {
 	Directional,
@@ -15,9 +30,20 @@ enum class LightType {
 };
 
 class LightStorage {
+public:
+	typedef struct {
+		LightType type;
+		glm::mat4 transform;
+		float range;
+
+		// light or caster in its range changed since tile was rendered
+		bool isDirty;
+	} ShadowLight;
+
+private:
 	struct DirectionalData {
 		float direction[3];
-		float _padding;
+		int32_t shadow;
 
 		float color[3];
 		float intensity;
@@ -30,48 +56,171 @@ class LightStorage {
 
 		float color[3];
 		float intensity;
+
+		int32_t shadow;
+		uint32_t _padding[3];
 	};
 	static_assert(sizeof(PunctualData) % 16 == 0, "PunctualData is not multiple of 16");
 
 	struct LightRD {
 		LightType type;
 
+		// position in packed data of its type
+		uint32_t index;
+
 		glm::mat4 transform;
 		float range;
 
 		glm::vec3 color;
 		float intensity;
+
+		// tile in shadow atlas, -1 when light casts no shadow
+		int32_t shadow;
+
+		// leaf in point tree, AABB_TREE_NULL for directional, unlimited range and baked
+		uint32_t proxy;
+
+		// of point light, 0 derives it from intensity and range
+		float drawDistance;
+
+		// lit surfaces have it in lightmaps, light loop leaves it out
+		bool isBaked;
 	};
 
 	ObjectOwner<LightRD> _lights;
 
-	AllocatedBuffer _directionalBuffer;
-	VmaAllocationInfo _directionalAllocInfo;
-
-	AllocatedBuffer _pointBuffer;
-	VmaAllocationInfo _pointAllocInfo;
+	// bounds of point light ranges, lights of unlimited range reach everywhere and are listed
+	// aside
+	AABBTree _pointTree;
+	std::vector<ObjectID> _unboundedPoints;
+
+	typedef struct {
+		// packed index
+		uint32_t index;
+		// intensity scale within fade band
+		float fade;
+		// lights of least importance are dropped when over budget
+		float importance;
+	} VisibleLight;
+
+	std::vector<uint64_t> _treeResults;
+	// point lights reaching into view and within draw distance, in packed order
+	std::vector<VisibleLight> _visible;
+
+	// most point lights shaded in a frame, 0 for no limit
+	uint32_t _pointBudget = 0;
+
+	// light owning each atlas tile, 0 for free tile
+	ObjectID _shadowOwners[MAX_SHADOW_COUNT] = {};
+	bool _shadowDirty[MAX_SHADOW_COUNT] = {};
+
+	// [begin, end) of packed entries changed since last update
+	typedef struct {
+		uint32_t begin;
+		uint32_t end;
+	} DirtyRange;
+
+	// packed CPU mirrors of light buffers, owners map packed index back to light, only visible
+	// point lights are copied out
+	std::vector<DirectionalData> _directionalData;
+	std::vector<ObjectID> _directionalOwners;
+	DirtyRange _directionalDirty[MAX_FRAMES_IN_FLIGHT] = {};
+
+	std::vector<PunctualData> _pointData;
+	std::vector<ObjectID> _pointOwners;
+
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	// one copy per frame in flight, so the CPU never writes what the GPU reads, each copy is
+	// resized when its frame is updated
+	uint32_t _directionalCapacities[MAX_FRAMES_IN_FLIGHT] = {};
+	uint32_t _pointCapacities[MAX_FRAMES_IN_FLIGHT] = {};
+
+	AllocatedBuffer _directionalBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _directionalAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	// visible point lights compacted, rewritten every frame, clusters index into it
+	AllocatedBuffer _pointBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _pointAllocInfos[MAX_FRAMES_IN_FLIGHT];
+	uint32_t _visibleCounts[MAX_FRAMES_IN_FLIGHT] = {};
 
 	vk::DescriptorSetLayout _lightSetLayout;
-	vk::DescriptorSet _lightSet;
+	vk::DescriptorSet _lightSets[MAX_FRAMES_IN_FLIGHT];
+	uint64_t _lightSetVersions[MAX_FRAMES_IN_FLIGHT] = {};
 
 	bool _initialized = false;
 
+	static void _markDirty(DirtyRange (&ranges)[MAX_FRAMES_IN_FLIGHT], uint32_t index);
+	static uint32_t _fitCapacity(uint32_t capacity, uint32_t count);
+
+	// returns true when buffer was reallocated, its contents are then undefined
+	bool _fitBuffer(AllocatedBuffer &buffer, VmaAllocationInfo &allocInfo, uint32_t &capacity,
+			uint32_t count, size_t stride);
+	void _updateLightSet(uint32_t frame);
+	void _pack(const LightRD &light);
+	// keeps point tree in step with position and range of light
+	void _updateBounds(ObjectID id, LightRD &light);
+	// INFINITY for unlimited range
+	static float _getDrawDistance(const LightRD &light);
+
 public:
 	ObjectID lightCreate(LightType type);
 	void lightSetTransform(ObjectID light, const glm::mat4 &transform);
+	// pairs up lights and transforms, invalid lights are skipped
+	void lightSetTransforms(
+			const std::vector<ObjectID> &lights, const std::vector<glm::mat4> &transforms);
 	void lightSetRange(ObjectID light, float range);
 	void lightSetColor(ObjectID light, const glm::vec3 &color);
 	void lightSetIntensity(ObjectID light, float intensity);
+	// beyond it point light is not drawn, it fades out over LIGHT_FADE_BAND before, 0 derives it
+	// from intensity and range
+	void lightSetDrawDistance(ObjectID light, float distance);
+	// baked light gives up its shadow tile and is not shaded at runtime, so surfaces without
+	// lightmap do not see it
+	void lightSetBaked(ObjectID light, bool isBaked);
+	void lightSetShadow(ObjectID light, bool castsShadow);
 	void lightFree(ObjectID light);
 
-	uint32_t getDirectionalLightCount();
-	uint32_t getPointLightCount();
+	// marks tiles of lights which could be shadowed by geometry inside aabb
+	void shadowInvalidate(const AABB &aabb);
+	void shadowInvalidateAll();
+
+	// false for free tile
+	bool getShadowLight(uint32_t tile, ShadowLight &shadow) const;
+	void shadowClearDirty(uint32_t tile);
+
+	uint32_t getDirectionalLightCount() const;
+	// placed ones, visible or not
+	uint32_t getPointLightCount() const;
+	// lights owning a tile of shadow atlas
+	uint32_t getShadowedLightCount() const;
+
+	// buffer may be replaced by updateVisible of the same frame
+	AllocatedBuffer getPointBuffer(uint32_t frame) const;
+
+	// copies point lights whose range touches any of the frustums, six planes each, and which
+	// are within draw distance of closest view position into point buffer of frame, back to
+	// back in packed order, returns their count, frame has to be finished
+	uint32_t updateVisible(uint32_t frame, const glm::vec4 *pPlanes,
+			const glm::vec3 *pViewPositions, uint32_t frustumCount = 1);
+	// as of last updateVisible of frame
+	uint32_t getVisiblePointLightCount(uint32_t frame) const;
+	// least important visible lights beyond count are dropped, 0 for no limit
+	void setPointLightBudget(uint32_t count);
+	uint32_t getPointLightBudget() const;
 
 	vk::DescriptorSetLayout getLightSetLayout() const;
-	vk::DescriptorSet getLightSet() const;
+	vk::DescriptorSet getLightSet(uint32_t frame) const;
+	// cluster parameters and light lists of LightCuller, frame has to be finished
+	void bindClusters(uint32_t frame, AllocatedBuffer uniformBuffer, AllocatedBuffer clusterBuffer);
+	// counts writes of light set of frame
+	uint64_t getSetVersion(uint32_t frame) const;
 
 	void initialize(vk::Device device, VmaAllocator allocator, vk::DescriptorPool descriptorPool);
-	void update();
+	// uploads directional changes not yet seen by the buffers of this frame, point lights go
+	// with updateVisible
+	void update(uint32_t frame);
 };
 
 #endif // !LIGHT_STORAGE_H
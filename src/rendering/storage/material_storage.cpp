@@ -0,0 +1,40 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "material_storage.h"
+
+uint32_t MaterialStorage::materialAdd(const MaterialData &data) {
+	uint32_t material = _slots.allocate();
+
+	if (material == BindlessSlots::INVALID_SLOT) {
+		std::cout << "ERROR: Material limit reached!" << std::endl;
+		return 0;
+	}
+
+	uint8_t *pMaterials = reinterpret_cast<uint8_t *>(_allocInfo.pMappedData);
+	memcpy(pMaterials + sizeof(MaterialData) * material, &data, sizeof(MaterialData));
+
+	return material;
+}
+
+void MaterialStorage::materialRemove(uint32_t material) {
+	_slots.free(material);
+}
+
+AllocatedBuffer MaterialStorage::getBuffer() const {
+	return _buffer;
+}
+
+void MaterialStorage::initialize(VmaAllocator allocator) {
+	if (_initialized)
+		return;
+
+	_slots = BindlessSlots(MAX_MATERIAL_COUNT);
+
+	vk::DeviceSize size = sizeof(MaterialData) * MAX_MATERIAL_COUNT;
+	_buffer = AllocatedBuffer::create(allocator, MemoryCategory::Other, BufferClass::Dynamic,
+			vk::BufferUsageFlagBits::eStorageBuffer, size, &_allocInfo);
+
+	_initialized = true;
+}
@@ -0,0 +1,61 @@
+#ifndef MATERIAL_STORAGE_H
+#define MATERIAL_STORAGE_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include <rendering/types/allocated.h>
+
+#include "bindless_storage.h"
+
+const uint32_t MAX_MATERIAL_COUNT = 65536;
+
+// Factors and texture indices of every material in one buffer, material shaders index it with
+// material index of instance. Maps are multiplied by factors, absent ones take factor alone.
+class MaterialStorage {
+public:
+	struct MaterialData {
+		glm::vec4 albedoFactor;
+
+		glm::vec3 emissiveFactor;
+		float metallicFactor;
+
+		float roughnessFactor;
+
+		// bindless texture indices, unused without bindless
+		uint32_t albedo;
+		uint32_t normal;
+		uint32_t metallicRoughness;
+
+		// offset and size of maps within their textures, see TextureAtlas
+		glm::vec4 albedoRect;
+		glm::vec4 normalRect;
+		glm::vec4 metallicRoughnessRect;
+
+		// sampled with lightmap uv, index is unused without bindless
+		uint32_t lightmap;
+		uint32_t hasLightmap;
+		uint32_t _padding[2];
+	};
+	static_assert(sizeof(MaterialData) % 16 == 0, "MaterialData is not multiple of 16");
+
+private:
+	BindlessSlots _slots;
+
+	AllocatedBuffer _buffer;
+	VmaAllocationInfo _allocInfo;
+
+	bool _initialized = false;
+
+public:
+	// full buffer gives slot 0, freed slots are reused oldest first
+	uint32_t materialAdd(const MaterialData &data);
+	void materialRemove(uint32_t material);
+
+	AllocatedBuffer getBuffer() const;
+
+	void initialize(VmaAllocator allocator);
+};
+
+#endif // !MATERIAL_STORAGE_H
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <rendering/rendering_device.h>
+#include <rendering/shaders/morph.gen.h>
+
+#include "morph_storage.h"
+
+const uint32_t GROUP_SIZE = 64;
+
+const uint32_t INITIAL_MORPH_CAPACITY = 1 << 14;
+
+const vk::BufferUsageFlags MORPH_USAGE = vk::BufferUsageFlagBits::eStorageBuffer |
+										 vk::BufferUsageFlagBits::eTransferSrc |
+										 vk::BufferUsageFlagBits::eTransferDst;
+
+void MorphStorage::_growMorphBuffer(uint32_t count) {
+	RD &rd = RD::getSingleton();
+
+	uint32_t oldCapacity = _morphRanges.getCapacity();
+	uint32_t capacity = std::max(oldCapacity * 2, oldCapacity + count);
+
+	AllocatedBuffer buffer = AllocatedBuffer::create(_allocator, MemoryCategory::Mesh,
+			BufferClass::Static, MORPH_USAGE, sizeof(PackedMorph) * capacity);
+
+	// old buffer may still be read by frames in flight and recorded uploads
+	rd.getUploadManager().flush();
+
+	{
+		std::lock_guard<std::mutex> lock(rd.getQueueMutex());
+		rd.getDevice().waitIdle();
+	}
+
+	rd.bufferCopy(_morphBuffer.buffer, buffer.buffer, sizeof(PackedMorph) * oldCapacity);
+	rd.bufferDestroy(_morphBuffer);
+
+	_morphBuffer = buffer;
+	_morphRanges.grow(capacity);
+}
+
+void MorphStorage::_updateBinding(uint32_t frame, uint32_t binding,
+		vk::DescriptorBufferInfo bufferInfo, vk::DescriptorType type) {
+	vk::WriteDescriptorSet writeInfo;
+	writeInfo.setDstSet(_sets[frame]);
+	writeInfo.setDstBinding(binding);
+	writeInfo.setDstArrayElement(0);
+	writeInfo.setDescriptorType(type);
+	writeInfo.setDescriptorCount(1);
+	writeInfo.setBufferInfo(bufferInfo);
+
+	_device.updateDescriptorSets(writeInfo, nullptr);
+}
+
+uint32_t MorphStorage::allocate(const PackedMorph *pMorphs, uint32_t count) {
+	if (count == 0)
+		return RangeAllocator::INVALID_OFFSET;
+
+	uint32_t offset = _morphRanges.allocate(count);
+
+	if (offset == RangeAllocator::INVALID_OFFSET) {
+		_growMorphBuffer(count);
+		offset = _morphRanges.allocate(count);
+	}
+
+	RD::getSingleton().bufferSend(_morphBuffer.buffer, (uint8_t *)pMorphs,
+			sizeof(PackedMorph) * count, sizeof(PackedMorph) * offset);
+
+	return offset;
+}
+
+void MorphStorage::free(uint32_t offset, uint32_t count) {
+	if (offset == RangeAllocator::INVALID_OFFSET)
+		return;
+
+	_morphRanges.free(offset, count);
+}
+
+bool MorphStorage::add(uint32_t frame, Job job, const float *pWeights, uint32_t weightCount,
+		bool copyBase, uint32_t vertexCount) {
+	if (_jobCount >= MAX_MORPH_JOB_COUNT)
+		return false;
+
+	FrameAllocator &frameAllocator = RD::getSingleton().getFrameAllocator();
+
+	if (_jobs.pData == nullptr) {
+		_jobs = frameAllocator.allocate(sizeof(Job) * MAX_MORPH_JOB_COUNT);
+
+		if (_jobs.pData == nullptr)
+			return false;
+	}
+
+	// aligned to float, so offset is index into whole buffer, shader treats missing ones as 0
+	FrameAllocator::Allocation weights = {};
+
+	if (weightCount > 0) {
+		weights = frameAllocator.write(pWeights, sizeof(float) * weightCount, sizeof(float));
+
+		if (weights.pData == nullptr)
+			return false;
+	}
+
+	job.weightOffset = static_cast<uint32_t>(weights.offset / sizeof(float));
+	job.weightCount = weightCount;
+
+	// vertices no target moves are never written by shader
+	if (copyBase) {
+		_positionCopies.push_back({ sizeof(PackedPosition) * job.sourceOffset,
+				sizeof(PackedPosition) * job.outputOffset, sizeof(PackedPosition) * vertexCount });
+		_attributeCopies.push_back({ sizeof(PackedAttributes) * job.sourceOffset,
+				sizeof(PackedAttributes) * job.outputOffset,
+				sizeof(PackedAttributes) * vertexCount });
+	}
+
+	memcpy(static_cast<Job *>(_jobs.pData) + _jobCount, &job, sizeof(Job));
+
+	_jobCount++;
+	_maxMovedCount = std::max(_maxMovedCount, job.movedCount);
+
+	return true;
+}
+
+void MorphStorage::dispatch(
+		vk::CommandBuffer commandBuffer, uint32_t frame, const GeometryArena &arena) {
+	if (_jobCount == 0)
+		return;
+
+	// set of this frame is not in use, previous submission is finished
+	AllocatedBuffer positionBuffer = arena.getPositionBuffer();
+	AllocatedBuffer attributeBuffer = arena.getAttributeBuffer();
+
+	if (positionBuffer.buffer != _boundPositionBuffers[frame]) {
+		_updateBinding(frame, 0, positionBuffer.getBufferInfo());
+		_boundPositionBuffers[frame] = positionBuffer.buffer;
+	}
+
+	if (attributeBuffer.buffer != _boundAttributeBuffers[frame]) {
+		_updateBinding(frame, 1, attributeBuffer.getBufferInfo());
+		_boundAttributeBuffers[frame] = attributeBuffer.buffer;
+	}
+
+	if (_morphBuffer.buffer != _boundMorphBuffers[frame]) {
+		_updateBinding(frame, 2, _morphBuffer.getBufferInfo());
+		_boundMorphBuffers[frame] = _morphBuffer.buffer;
+	}
+
+	// new ranges are not drawn yet, base shape is in place before shader writes over it
+	if (!_positionCopies.empty()) {
+		commandBuffer.copyBuffer(positionBuffer.buffer, positionBuffer.buffer, _positionCopies);
+		commandBuffer.copyBuffer(
+				attributeBuffer.buffer, attributeBuffer.buffer, _attributeCopies);
+	}
+
+	// previous frame may still draw ranges morphed again here
+	vk::MemoryBarrier readBarrier;
+	readBarrier.setSrcAccessMask(
+			vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eTransferWrite);
+	readBarrier.setDstAccessMask(
+			vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eComputeShader, {}, readBarrier, nullptr, nullptr);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(
+			bindPoint, _pipelineLayout, 0, _sets[frame], _jobs.offset);
+
+	uint32_t groupCount = (_maxMovedCount + GROUP_SIZE - 1) / GROUP_SIZE;
+	commandBuffer.dispatch(std::max(groupCount, 1u), _jobCount, 1);
+
+	// skinning reads morphed vertices in place of bind pose
+	vk::MemoryBarrier writeBarrier;
+	writeBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	writeBarrier.setDstAccessMask(
+			vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eComputeShader,
+			{}, writeBarrier, nullptr, nullptr);
+
+	_jobs = {};
+	_jobCount = 0;
+	_maxMovedCount = 0;
+	_positionCopies.clear();
+	_attributeCopies.clear();
+}
+
+void MorphStorage::initialize(vk::Device device, VmaAllocator allocator,
+		vk::DescriptorPool descriptorPool, const GeometryArena &arena) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_allocator = allocator;
+
+	_morphBuffer = AllocatedBuffer::create(allocator, MemoryCategory::Mesh,
+			BufferClass::Static, MORPH_USAGE, sizeof(PackedMorph) * INITIAL_MORPH_CAPACITY);
+	_morphRanges.grow(INITIAL_MORPH_CAPACITY);
+
+	std::array<vk::DescriptorSetLayoutBinding, 5> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	bindings[4].setDescriptorType(vk::DescriptorType::eStorageBufferDynamic);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Morph descriptor set layout creation failed!");
+
+	uint32_t framesInFlight = RD::getSingleton().getFramesInFlight();
+
+	std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Morph descriptor set allocation failed!");
+
+	FrameAllocator &frameAllocator = RD::getSingleton().getFrameAllocator();
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_updateBinding(i, 0, arena.getPositionBuffer().getBufferInfo());
+		_updateBinding(i, 1, arena.getAttributeBuffer().getBufferInfo());
+		_updateBinding(i, 2, _morphBuffer.getBufferInfo());
+		_updateBinding(i, 3, frameAllocator.getBufferInfo(i));
+		_updateBinding(i, 4, frameAllocator.getStorageInfo(i),
+				vk::DescriptorType::eStorageBufferDynamic);
+
+		_boundPositionBuffers[i] = arena.getPositionBuffer().buffer;
+		_boundAttributeBuffers[i] = arena.getAttributeBuffer().buffer;
+		_boundMorphBuffers[i] = _morphBuffer.buffer;
+	}
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	MorphShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Morph compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
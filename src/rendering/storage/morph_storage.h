@@ -0,0 +1,91 @@
+#ifndef MORPH_STORAGE_H
+#define MORPH_STORAGE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/storage/geometry_arena.h>
+#include <rendering/frame_allocator.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/frame.h>
+#include <rendering/types/vertex.h>
+
+// instances morphed in one frame, the rest keep their shape until next one, jobs of frame are
+// bound in FRAME_STORAGE_RANGE
+const uint32_t MAX_MORPH_JOB_COUNT = 1024;
+
+// Applies morph target weights of instances on GPU. Base shape of mesh stays in geometry arena,
+// deltas of vertices its targets move live here, quantized, vertices no target moves have none.
+// Every morphed instance owns a vertex range of arena, base shape is copied into it once and
+// compute shader then writes moved vertices only, whenever weights of instance changed, so
+// depth, material and shadow passes draw it like any other mesh, skinning reads it in place of
+// bind pose. Instances morphed in a frame go into one dispatch, one row of groups each. Weights
+// and jobs of frame are ranges of frame allocator like joints and jobs of SkinStorage.
+class MorphStorage {
+public:
+	// has to match shaders/morph.comp
+	typedef struct {
+		// base shape and morphed vertices in geometry arena
+		uint32_t sourceOffset;
+		uint32_t outputOffset;
+		// headers of moved vertices, their deltas follow
+		uint32_t morphOffset;
+		uint32_t movedCount;
+
+		// assigned by add
+		uint32_t weightOffset;
+		uint32_t weightCount;
+		uint32_t _padding[2];
+	} Job;
+
+private:
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	AllocatedBuffer _morphBuffer;
+	RangeAllocator _morphRanges;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_FRAMES_IN_FLIGHT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	// arena and morph buffer are replaced as they grow
+	vk::Buffer _boundPositionBuffers[MAX_FRAMES_IN_FLIGHT];
+	vk::Buffer _boundAttributeBuffers[MAX_FRAMES_IN_FLIGHT];
+	vk::Buffer _boundMorphBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	// of frame being recorded, base shapes copied into ranges morphed for the first time
+	FrameAllocator::Allocation _jobs = {};
+	uint32_t _jobCount = 0;
+	uint32_t _maxMovedCount = 0;
+	std::vector<vk::BufferCopy> _positionCopies;
+	std::vector<vk::BufferCopy> _attributeCopies;
+
+	bool _initialized = false;
+
+	void _growMorphBuffer(uint32_t count);
+	void _updateBinding(uint32_t frame, uint32_t binding, vk::DescriptorBufferInfo bufferInfo,
+			vk::DescriptorType type = vk::DescriptorType::eStorageBuffer);
+
+public:
+	// returns offset of headers, RangeAllocator::INVALID_OFFSET for none
+	uint32_t allocate(const PackedMorph *pMorphs, uint32_t count);
+	void free(uint32_t offset, uint32_t count);
+
+	// output range is filled with base shape first when it was never morphed, vertex count is
+	// that of mesh, false once frame is full, after drawBegin only
+	bool add(uint32_t frame, Job job, const float *pWeights, uint32_t weightCount,
+			bool copyBase, uint32_t vertexCount);
+	// has to be recorded after adds of frame, before skinning and any pass drawing morphed
+	// instances
+	void dispatch(vk::CommandBuffer commandBuffer, uint32_t frame, const GeometryArena &arena);
+
+	void initialize(vk::Device device, VmaAllocator allocator, vk::DescriptorPool descriptorPool,
+			const GeometryArena &arena);
+};
+
+#endif // !MORPH_STORAGE_H
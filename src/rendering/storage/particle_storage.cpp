@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/rendering_device.h>
+#include <rendering/shaders/particle.gen.h>
+
+#include "particle_storage.h"
+
+const uint32_t GROUP_SIZE = 64;
+
+void ParticleStorage::_updateBinding(uint32_t frame, uint32_t binding,
+		vk::DescriptorBufferInfo bufferInfo, vk::DescriptorType type) {
+	vk::WriteDescriptorSet writeInfo;
+	writeInfo.setDstSet(_sets[frame]);
+	writeInfo.setDstBinding(binding);
+	writeInfo.setDstArrayElement(0);
+	writeInfo.setDescriptorType(type);
+	writeInfo.setDescriptorCount(1);
+	writeInfo.setBufferInfo(bufferInfo);
+
+	_device.updateDescriptorSets(writeInfo, nullptr);
+}
+
+bool ParticleStorage::allocate(uint32_t capacity, uint32_t primitiveCount, Range &range) {
+	if (capacity == 0 || primitiveCount == 0)
+		return false;
+
+	primitiveCount = std::min(primitiveCount, MAX_PARTICLE_PRIMITIVE_COUNT);
+
+	uint32_t counter = 0;
+
+	while (counter < MAX_PARTICLE_EMITTER_COUNT && _usedCounters[counter])
+		counter++;
+
+	if (counter == MAX_PARTICLE_EMITTER_COUNT)
+		return false;
+
+	uint32_t particleOffset = _particleRanges.allocate(capacity);
+
+	if (particleOffset == RangeAllocator::INVALID_OFFSET)
+		return false;
+
+	uint32_t slotOffset = _slotRanges.allocate(capacity * primitiveCount);
+
+	if (slotOffset == RangeAllocator::INVALID_OFFSET) {
+		_particleRanges.free(particleOffset, capacity);
+		return false;
+	}
+
+	_usedCounters[counter] = true;
+
+	range.particleOffset = particleOffset;
+	range.capacity = capacity;
+	range.slotOffset = slotOffset;
+	range.primitiveCount = primitiveCount;
+	range.counter = counter;
+
+	return true;
+}
+
+void ParticleStorage::free(const Range &range) {
+	if (range.capacity == 0)
+		return;
+
+	_particleRanges.free(range.particleOffset, range.capacity);
+	_slotRanges.free(range.slotOffset, range.capacity * range.primitiveCount);
+	_usedCounters[range.counter] = false;
+}
+
+uint32_t ParticleStorage::add(
+		uint32_t frame, Job job, const vk::DrawIndexedIndirectCommand *pCommands) {
+	if (_jobCount >= MAX_PARTICLE_EMITTER_COUNT)
+		return INVALID_COMMAND;
+
+	if (_jobs.pData == nullptr) {
+		_jobs = RD::getSingleton().getFrameAllocator().allocate(
+				sizeof(Job) * MAX_PARTICLE_EMITTER_COUNT);
+
+		if (_jobs.pData == nullptr)
+			return INVALID_COMMAND;
+	}
+
+	job.firstCommand = _commandCount;
+
+	// previous submission of frame is finished, its counts are not read again
+	vk::DrawIndexedIndirectCommand *pFrameCommands =
+			static_cast<vk::DrawIndexedIndirectCommand *>(_commandAllocInfos[frame].pMappedData);
+
+	for (uint32_t i = 0; i < job.primitiveCount; i++) {
+		vk::DrawIndexedIndirectCommand command = pCommands[i];
+		command.instanceCount = 0;
+		command.firstInstance = MAX_INSTANCE_COUNT + job.slotOffset + i * job.capacity;
+
+		pFrameCommands[_commandCount + i] = command;
+	}
+
+	memcpy(static_cast<Job *>(_jobs.pData) + _jobCount, &job, sizeof(Job));
+
+	_jobCount++;
+	_commandCount += job.primitiveCount;
+	_maxCapacity = std::max(_maxCapacity, job.capacity);
+	_maxEmitCount = std::max(_maxEmitCount, job.emitCount);
+	_hasReset = _hasReset || job.reset != 0;
+
+	return job.firstCommand;
+}
+
+void ParticleStorage::dispatch(vk::CommandBuffer commandBuffer, uint32_t frame, float deltaTime) {
+	if (_jobCount == 0)
+		return;
+
+	ParticleConstants constants = {};
+	constants.deltaTime = std::min(deltaTime, MAX_PARTICLE_STEP);
+	constants.firstSlot = MAX_INSTANCE_COUNT;
+
+	// lists are shared by frames, previous ones simulated them last
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(
+			bindPoint, _pipelineLayout, 0, _sets[frame], _jobs.offset);
+
+	uint32_t capacityGroups = (_maxCapacity + GROUP_SIZE - 1) / GROUP_SIZE;
+	uint32_t emitGroups = (_maxEmitCount + GROUP_SIZE - 1) / GROUP_SIZE;
+
+	// reset, emit, simulate and finish, as in shader, each stage reads what one before wrote,
+	// one row of groups per job, as wide as work of largest one
+	std::array<uint32_t, 4> groupCounts = {
+		_hasReset ? capacityGroups : 0,
+		emitGroups,
+		capacityGroups,
+		1,
+	};
+
+	for (uint32_t stage = 0; stage < groupCounts.size(); stage++) {
+		if (groupCounts[stage] == 0)
+			continue;
+
+		constants.stage = stage;
+		commandBuffer.pushConstants(_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+				sizeof(ParticleConstants), &constants);
+		commandBuffer.dispatch(groupCounts[stage], _jobCount, 1);
+
+		if (stage + 1 < groupCounts.size()) {
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+					vk::PipelineStageFlagBits::eComputeShader, {}, barrier, nullptr, nullptr);
+		}
+	}
+
+	barrier.setDstAccessMask(
+			vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader,
+			{}, barrier, nullptr, nullptr);
+
+	_jobs = {};
+	_jobCount = 0;
+	_commandCount = 0;
+	_maxCapacity = 0;
+	_maxEmitCount = 0;
+	_hasReset = false;
+}
+
+vk::Buffer ParticleStorage::getCommandBuffer(uint32_t frame) const {
+	return _commandBuffers[frame].buffer;
+}
+
+void ParticleStorage::initialize(vk::Device device, vk::DescriptorPool descriptorPool) {
+	if (_initialized)
+		return;
+
+	_device = device;
+
+	RD &rd = RD::getSingleton();
+
+	_particleBuffer = rd.bufferCreate(MemoryCategory::Other, BufferClass::Static,
+			vk::BufferUsageFlagBits::eStorageBuffer, sizeof(glm::vec4) * 2 * MAX_PARTICLE_COUNT);
+	_indexBuffer = rd.bufferCreate(MemoryCategory::Other, BufferClass::Static,
+			vk::BufferUsageFlagBits::eStorageBuffer, sizeof(uint32_t) * 3 * MAX_PARTICLE_COUNT);
+	_counterBuffer = rd.bufferCreate(MemoryCategory::Other, BufferClass::Static,
+			vk::BufferUsageFlagBits::eStorageBuffer,
+			sizeof(glm::uvec4) * MAX_PARTICLE_EMITTER_COUNT);
+
+	_particleRanges.grow(MAX_PARTICLE_COUNT);
+	_slotRanges.grow(MAX_PARTICLE_COUNT);
+
+	std::array<vk::DescriptorSetLayoutBinding, 8> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	bindings[6].setDescriptorType(vk::DescriptorType::eStorageBufferDynamic);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Particle descriptor set layout creation failed!");
+
+	uint32_t framesInFlight = rd.getFramesInFlight();
+
+	std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Particle descriptor set allocation failed!");
+
+	FrameAllocator &frameAllocator = rd.getFrameAllocator();
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_commandBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+				vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+				sizeof(vk::DrawIndexedIndirectCommand) * MAX_PARTICLE_EMITTER_COUNT *
+						MAX_PARTICLE_PRIMITIVE_COUNT,
+				&_commandAllocInfos[i]);
+
+		_updateBinding(i, 0, _particleBuffer.getBufferInfo());
+		_updateBinding(i, 1, _indexBuffer.getBufferInfo());
+		_updateBinding(i, 2, _counterBuffer.getBufferInfo());
+		_updateBinding(i, 3, rd.getInstanceBuffer(i).getBufferInfo());
+		_updateBinding(i, 4, rd.getInstanceMaterialBuffer(i).getBufferInfo());
+		_updateBinding(i, 5, _commandBuffers[i].getBufferInfo());
+		_updateBinding(i, 6, frameAllocator.getStorageInfo(i),
+				vk::DescriptorType::eStorageBufferDynamic);
+		_updateBinding(i, 7, rd.getInstanceNormalBuffer(i).getBufferInfo());
+	}
+
+	vk::PushConstantRange pushConstant;
+	pushConstant.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	pushConstant.setOffset(0);
+	pushConstant.setSize(sizeof(ParticleConstants));
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+	layoutCreateInfo.setPushConstantRanges(pushConstant);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	ParticleShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			rd.getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Particle compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
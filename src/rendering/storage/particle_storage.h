@@ -0,0 +1,142 @@
+#ifndef PARTICLE_STORAGE_H
+#define PARTICLE_STORAGE_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/frame_allocator.h>
+#include <rendering/storage/geometry_arena.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/frame.h>
+
+// particles alive at once over all emitters, draws of particles take instance slots past
+// MAX_INSTANCE_COUNT, as many as there are particles
+const uint32_t MAX_PARTICLE_COUNT = 65536;
+const uint32_t MAX_PARTICLE_EMITTER_COUNT = 256;
+// primitives of emitter mesh past it are not drawn
+const uint32_t MAX_PARTICLE_PRIMITIVE_COUNT = 4;
+
+// simulation step is clamped to it, particles do not jump after a stall
+const float MAX_PARTICLE_STEP = 0.1f;
+
+// Emits, simulates and compacts particles on GPU, CPU work is one job per emitter whatever
+// their particle count. Every emitter owns a range of particle pool with a dead list and two
+// alive lists of indices into it. Emitted particles are taken from dead list, simulated ones
+// are appended to alive list of next frame or pushed back to dead list, so lists stay
+// compacted without CPU ever reading them. Survivors write their transform and material into
+// instance slots of emitter, one range per primitive, and alive count into instanceCount of
+// indirect commands CPU filled in, draws of emitters are recorded like any other.
+class ParticleStorage {
+public:
+	// has to match shaders/particle.comp
+	typedef struct {
+		// emitter space to world, particles spawn within radius of its origin
+		glm::mat4 transform;
+		glm::mat4 dequantize;
+		// world space, w of velocity is random speed added in any direction, w of
+		// acceleration is drag
+		glm::vec4 velocity;
+		glm::vec4 acceleration;
+
+		float lifetime;
+		// scale of mesh at birth and at end of lifetime
+		float sizeBegin;
+		float sizeEnd;
+		float radius;
+
+		// assigned by allocate
+		uint32_t particleOffset;
+		uint32_t capacity;
+		uint32_t counter;
+		uint32_t slotOffset;
+
+		uint32_t primitiveCount;
+		uint32_t emitCount;
+		uint32_t seed;
+		// range was allocated again, lists start over
+		uint32_t reset;
+
+		uint32_t materials[MAX_PARTICLE_PRIMITIVE_COUNT];
+
+		// assigned by add
+		uint32_t firstCommand;
+		uint32_t _padding[3];
+	} Job;
+	static_assert(sizeof(Job) % 16 == 0, "Job is not multiple of 16");
+
+	typedef struct {
+		uint32_t particleOffset;
+		uint32_t capacity;
+		// after MAX_INSTANCE_COUNT, capacity slots for every primitive
+		uint32_t slotOffset;
+		uint32_t primitiveCount;
+		// lists and counts of emitter
+		uint32_t counter;
+	} Range;
+
+	static const uint32_t INVALID_COMMAND = UINT32_MAX;
+
+private:
+	typedef struct {
+		uint32_t stage;
+		float deltaTime;
+		uint32_t firstSlot;
+		uint32_t _padding;
+	} ParticleConstants;
+
+	vk::Device _device;
+
+	// position and age, velocity and lifetime of every particle
+	AllocatedBuffer _particleBuffer;
+	// dead list followed by both alive lists, MAX_PARTICLE_COUNT each
+	AllocatedBuffer _indexBuffer;
+	// dead count, both alive counts and current alive list of every emitter
+	AllocatedBuffer _counterBuffer;
+
+	RangeAllocator _particleRanges;
+	RangeAllocator _slotRanges;
+	bool _usedCounters[MAX_PARTICLE_EMITTER_COUNT] = {};
+
+	// templates of CPU, instance counts of GPU
+	AllocatedBuffer _commandBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _commandAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_FRAMES_IN_FLIGHT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	// of frame being recorded
+	FrameAllocator::Allocation _jobs = {};
+	uint32_t _jobCount = 0;
+	uint32_t _commandCount = 0;
+	uint32_t _maxCapacity = 0;
+	uint32_t _maxEmitCount = 0;
+	bool _hasReset = false;
+
+	bool _initialized = false;
+
+	void _updateBinding(uint32_t frame, uint32_t binding, vk::DescriptorBufferInfo bufferInfo,
+			vk::DescriptorType type = vk::DescriptorType::eStorageBuffer);
+
+public:
+	// false when pool, instance slots or emitters are used up
+	bool allocate(uint32_t capacity, uint32_t primitiveCount, Range &range);
+	// frames in flight may still simulate range, emitter getting it next resets it first
+	void free(const Range &range);
+
+	// one command per primitive of job, instanceCount is written by GPU, returns first of them,
+	// INVALID_COMMAND once frame is full, after drawBegin only
+	uint32_t add(uint32_t frame, Job job, const vk::DrawIndexedIndirectCommand *pCommands);
+	// has to be recorded after adds of frame, before render pass
+	void dispatch(vk::CommandBuffer commandBuffer, uint32_t frame, float deltaTime);
+
+	vk::Buffer getCommandBuffer(uint32_t frame) const;
+
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool);
+};
+
+#endif // !PARTICLE_STORAGE_H
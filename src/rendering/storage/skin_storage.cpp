@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/rendering_device.h>
+#include <rendering/shaders/skin.gen.h>
+
+#include "skin_storage.h"
+
+const uint32_t GROUP_SIZE = 64;
+
+const uint32_t INITIAL_SKIN_CAPACITY = 1 << 16;
+
+const vk::BufferUsageFlags SKIN_USAGE = vk::BufferUsageFlagBits::eStorageBuffer |
+										vk::BufferUsageFlagBits::eTransferSrc |
+										vk::BufferUsageFlagBits::eTransferDst;
+
+void SkinStorage::_growSkinBuffer(uint32_t count) {
+	RD &rd = RD::getSingleton();
+
+	uint32_t oldCapacity = _skinRanges.getCapacity();
+	uint32_t capacity = std::max(oldCapacity * 2, oldCapacity + count);
+
+	AllocatedBuffer buffer = AllocatedBuffer::create(_allocator, MemoryCategory::Mesh,
+			BufferClass::Static, SKIN_USAGE, sizeof(PackedSkin) * capacity);
+
+	// old buffer may still be read by frames in flight and recorded uploads
+	rd.getUploadManager().flush();
+
+	{
+		std::lock_guard<std::mutex> lock(rd.getQueueMutex());
+		rd.getDevice().waitIdle();
+	}
+
+	rd.bufferCopy(_skinBuffer.buffer, buffer.buffer, sizeof(PackedSkin) * oldCapacity);
+	rd.bufferDestroy(_skinBuffer);
+
+	_skinBuffer = buffer;
+	_skinRanges.grow(capacity);
+}
+
+void SkinStorage::_updateBinding(uint32_t frame, uint32_t binding,
+		vk::DescriptorBufferInfo bufferInfo, vk::DescriptorType type) {
+	vk::WriteDescriptorSet writeInfo;
+	writeInfo.setDstSet(_sets[frame]);
+	writeInfo.setDstBinding(binding);
+	writeInfo.setDstArrayElement(0);
+	writeInfo.setDescriptorType(type);
+	writeInfo.setDescriptorCount(1);
+	writeInfo.setBufferInfo(bufferInfo);
+
+	_device.updateDescriptorSets(writeInfo, nullptr);
+}
+
+uint32_t SkinStorage::allocate(const PackedSkin *pSkins, uint32_t count) {
+	if (count == 0)
+		return RangeAllocator::INVALID_OFFSET;
+
+	uint32_t offset = _skinRanges.allocate(count);
+
+	if (offset == RangeAllocator::INVALID_OFFSET) {
+		_growSkinBuffer(count);
+		offset = _skinRanges.allocate(count);
+	}
+
+	RD::getSingleton().bufferSend(_skinBuffer.buffer, (uint8_t *)pSkins,
+			sizeof(PackedSkin) * count, sizeof(PackedSkin) * offset);
+
+	return offset;
+}
+
+void SkinStorage::free(uint32_t offset, uint32_t count) {
+	if (offset == RangeAllocator::INVALID_OFFSET)
+		return;
+
+	_skinRanges.free(offset, count);
+}
+
+bool SkinStorage::add(uint32_t frame, Job job, const glm::mat4 *pJoints, uint32_t jointCount) {
+	if (_jobCount >= MAX_SKIN_JOB_COUNT)
+		return false;
+
+	// nothing to pose, shader clamps joints of vertices to last one of skin
+	if (job.vertexCount == 0 || jointCount == 0)
+		return true;
+
+	FrameAllocator &frameAllocator = RD::getSingleton().getFrameAllocator();
+
+	if (_jobs.pData == nullptr) {
+		_jobs = frameAllocator.allocate(sizeof(Job) * MAX_SKIN_JOB_COUNT);
+
+		if (_jobs.pData == nullptr)
+			return false;
+	}
+
+	// aligned to matrix, so offset is index into whole buffer
+	FrameAllocator::Allocation joints = frameAllocator.write(
+			pJoints, sizeof(glm::mat4) * jointCount, sizeof(glm::mat4));
+
+	if (joints.pData == nullptr)
+		return false;
+
+	job.jointOffset = joints.offset / sizeof(glm::mat4);
+	job.jointCount = jointCount;
+
+	memcpy(static_cast<Job *>(_jobs.pData) + _jobCount, &job, sizeof(Job));
+
+	_jobCount++;
+	_maxVertexCount = std::max(_maxVertexCount, job.vertexCount);
+
+	return true;
+}
+
+void SkinStorage::dispatch(
+		vk::CommandBuffer commandBuffer, uint32_t frame, const GeometryArena &arena) {
+	if (_jobCount == 0)
+		return;
+
+	// set of this frame is not in use, previous submission is finished
+	AllocatedBuffer positionBuffer = arena.getPositionBuffer();
+	AllocatedBuffer attributeBuffer = arena.getAttributeBuffer();
+
+	if (positionBuffer.buffer != _boundPositionBuffers[frame]) {
+		_updateBinding(frame, 0, positionBuffer.getBufferInfo());
+		_boundPositionBuffers[frame] = positionBuffer.buffer;
+	}
+
+	if (attributeBuffer.buffer != _boundAttributeBuffers[frame]) {
+		_updateBinding(frame, 1, attributeBuffer.getBufferInfo());
+		_boundAttributeBuffers[frame] = attributeBuffer.buffer;
+	}
+
+	if (_skinBuffer.buffer != _boundSkinBuffers[frame]) {
+		_updateBinding(frame, 2, _skinBuffer.getBufferInfo());
+		_boundSkinBuffers[frame] = _skinBuffer.buffer;
+	}
+
+	// previous frame may still draw ranges posed again here
+	vk::MemoryBarrier readBarrier;
+	readBarrier.setSrcAccessMask(vk::AccessFlagBits::eVertexAttributeRead);
+	readBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput,
+			vk::PipelineStageFlagBits::eComputeShader, {}, readBarrier, nullptr, nullptr);
+
+	vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+
+	commandBuffer.bindPipeline(bindPoint, _pipeline);
+	commandBuffer.bindDescriptorSets(
+			bindPoint, _pipelineLayout, 0, _sets[frame], _jobs.offset);
+
+	uint32_t groupCount = (_maxVertexCount + GROUP_SIZE - 1) / GROUP_SIZE;
+	commandBuffer.dispatch(groupCount, _jobCount, 1);
+
+	vk::MemoryBarrier writeBarrier;
+	writeBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+	writeBarrier.setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eVertexInput, {}, writeBarrier, nullptr, nullptr);
+
+	_jobs = {};
+	_jobCount = 0;
+	_maxVertexCount = 0;
+}
+
+void SkinStorage::initialize(vk::Device device, VmaAllocator allocator,
+		vk::DescriptorPool descriptorPool, const GeometryArena &arena) {
+	if (_initialized)
+		return;
+
+	_device = device;
+	_allocator = allocator;
+
+	_skinBuffer = AllocatedBuffer::create(allocator, MemoryCategory::Mesh,
+			BufferClass::Static, SKIN_USAGE, sizeof(PackedSkin) * INITIAL_SKIN_CAPACITY);
+	_skinRanges.grow(INITIAL_SKIN_CAPACITY);
+
+	std::array<vk::DescriptorSetLayoutBinding, 5> bindings = {};
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].setBinding(i);
+		bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		bindings[i].setDescriptorCount(1);
+		bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	bindings[4].setDescriptorType(vk::DescriptorType::eStorageBufferDynamic);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Skin descriptor set layout creation failed!");
+
+	uint32_t framesInFlight = RD::getSingleton().getFramesInFlight();
+
+	std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Skin descriptor set allocation failed!");
+
+	FrameAllocator &frameAllocator = RD::getSingleton().getFrameAllocator();
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_updateBinding(i, 0, arena.getPositionBuffer().getBufferInfo());
+		_updateBinding(i, 1, arena.getAttributeBuffer().getBufferInfo());
+		_updateBinding(i, 2, _skinBuffer.getBufferInfo());
+		_updateBinding(i, 3, frameAllocator.getBufferInfo(i));
+		_updateBinding(i, 4, frameAllocator.getStorageInfo(i),
+				vk::DescriptorType::eStorageBufferDynamic);
+
+		_boundPositionBuffers[i] = arena.getPositionBuffer().buffer;
+		_boundAttributeBuffers[i] = arena.getAttributeBuffer().buffer;
+		_boundSkinBuffers[i] = _skinBuffer.buffer;
+	}
+
+	vk::PipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.setSetLayouts(_setLayout);
+
+	_pipelineLayout = device.createPipelineLayout(layoutCreateInfo);
+
+	SkinShader shader;
+
+	vk::ShaderModuleCreateInfo moduleCreateInfo = {};
+	moduleCreateInfo.setPCode(shader.computeCode);
+	moduleCreateInfo.setCodeSize(sizeof(shader.computeCode));
+
+	vk::ShaderModule computeModule = device.createShaderModule(moduleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo computeStageInfo = {};
+	computeStageInfo.setModule(computeModule);
+	computeStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+	computeStageInfo.setPName("main");
+
+	vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.setStage(computeStageInfo);
+	pipelineCreateInfo.setLayout(_pipelineLayout);
+
+	vk::ResultValue<vk::Pipeline> result = device.createComputePipeline(
+			RD::getSingleton().getPipelineCache(), pipelineCreateInfo);
+
+	if (result.result != vk::Result::eSuccess)
+		throw std::runtime_error("Skin compute pipeline creation failed!");
+
+	_pipeline = result.value;
+
+	device.destroyShaderModule(computeModule);
+
+	_initialized = true;
+}
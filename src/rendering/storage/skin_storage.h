@@ -0,0 +1,89 @@
+#ifndef SKIN_STORAGE_H
+#define SKIN_STORAGE_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <rendering/storage/geometry_arena.h>
+#include <rendering/frame_allocator.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/frame.h>
+#include <rendering/types/vertex.h>
+
+// instances posed in one frame, the rest keep their last pose until next one, jobs of frame
+// are bound in FRAME_STORAGE_RANGE
+const uint32_t MAX_SKIN_JOB_COUNT = 1024;
+
+// quantized bounds of skinned mesh are this much larger than its bind pose, parts posed further
+// out are clamped
+const float SKIN_BOUNDS_SCALE = 2.0f;
+
+// Poses skinned mesh instances on GPU. Bind pose of mesh stays in geometry arena, joints and
+// weights of its vertices live here. Every skinned instance owns a vertex range of arena which
+// compute shader fills with posed positions and attributes, once per frame and only for
+// instances whose joints changed, so depth, material and shadow passes draw it like any other
+// mesh. Instances posed in a frame go into one dispatch, one row of groups each. Joints and jobs
+// of frame are ranges of frame allocator, joints are indexed in its whole buffer and jobs are
+// bound with dynamic offset, their range is allocated by first add of frame.
+class SkinStorage {
+public:
+	// has to match shaders/skin.comp
+	typedef struct {
+		// bind pose and posed vertices in geometry arena
+		uint32_t sourceOffset;
+		uint32_t outputOffset;
+		uint32_t vertexCount;
+		uint32_t skinOffset;
+
+		// assigned by add
+		uint32_t jointOffset;
+		uint32_t jointCount;
+		uint32_t _padding[2];
+	} Job;
+
+private:
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	AllocatedBuffer _skinBuffer;
+	RangeAllocator _skinRanges;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_FRAMES_IN_FLIGHT];
+
+	vk::PipelineLayout _pipelineLayout;
+	vk::Pipeline _pipeline;
+
+	// arena and skin buffer are replaced as they grow
+	vk::Buffer _boundPositionBuffers[MAX_FRAMES_IN_FLIGHT];
+	vk::Buffer _boundAttributeBuffers[MAX_FRAMES_IN_FLIGHT];
+	vk::Buffer _boundSkinBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	// of frame being recorded
+	FrameAllocator::Allocation _jobs = {};
+	uint32_t _jobCount = 0;
+	uint32_t _maxVertexCount = 0;
+
+	bool _initialized = false;
+
+	void _growSkinBuffer(uint32_t count);
+	void _updateBinding(uint32_t frame, uint32_t binding, vk::DescriptorBufferInfo bufferInfo,
+			vk::DescriptorType type = vk::DescriptorType::eStorageBuffer);
+
+public:
+	// returns offset of skin vertices, RangeAllocator::INVALID_OFFSET for none
+	uint32_t allocate(const PackedSkin *pSkins, uint32_t count);
+	void free(uint32_t offset, uint32_t count);
+
+	// joints are in quantized space of mesh, false once frame is full, after drawBegin only
+	bool add(uint32_t frame, Job job, const glm::mat4 *pJoints, uint32_t jointCount);
+	// has to be recorded after adds of frame, before any pass drawing skinned instances
+	void dispatch(vk::CommandBuffer commandBuffer, uint32_t frame, const GeometryArena &arena);
+
+	void initialize(vk::Device device, VmaAllocator allocator, vk::DescriptorPool descriptorPool,
+			const GeometryArena &arena);
+};
+
+#endif // !SKIN_STORAGE_H
@@ -0,0 +1,773 @@
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <rendering/rendering_device.h>
+
+#include "terrain_storage.h"
+
+typedef struct {
+	uint16_t x;
+	uint16_t z;
+} GridVertex;
+
+// no world tile has it, level holds nothing yet
+const glm::ivec2 INVALID_TILE = glm::ivec2(INT32_MIN);
+
+const vk::DeviceSize TILE_BYTE_SIZE = TERRAIN_TILE_SIZE * TERRAIN_TILE_SIZE * sizeof(float);
+// every tile of every level, a frame never copies more
+const uint32_t MAX_TILE_UPLOAD_COUNT =
+		TERRAIN_LEVEL_TILE_COUNT * TERRAIN_LEVEL_TILE_COUNT * MAX_TERRAIN_LEVEL_COUNT;
+
+static int32_t _floorDiv(int32_t value, int32_t divisor) {
+	return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+static int32_t _floorMod(int32_t value, int32_t divisor) {
+	return value - _floorDiv(value, divisor) * divisor;
+}
+
+float TerrainStorage::_sample(uint32_t level, int32_t x, int32_t z) const {
+	const HeightLevel &heightLevel = _levels[level];
+
+	x = std::clamp(x, 0, static_cast<int32_t>(heightLevel.width) - 1);
+	z = std::clamp(z, 0, static_cast<int32_t>(heightLevel.height) - 1);
+
+	return heightLevel.heights[static_cast<size_t>(z) * heightLevel.width + x];
+}
+
+void TerrainStorage::_buildLevels(const std::shared_ptr<Image> &heightmap) {
+	Image image = *heightmap;
+
+	if (image.getFormat() != Image::Format::RGBA32F)
+		image.convert(Image::Format::RGBA32F);
+
+	const float *pTexels = reinterpret_cast<const float *>(image.getData().data());
+
+	_levels.resize(_terrain.levelCount);
+
+	HeightLevel &first = _levels[0];
+	first.width = image.getWidth();
+	first.height = image.getHeight();
+	first.heights.resize(static_cast<size_t>(first.width) * first.height);
+
+	for (size_t i = 0; i < first.heights.size(); i++)
+		first.heights[i] = pTexels[i * 4] * _terrain.heightScale;
+
+	auto range = std::minmax_element(first.heights.begin(), first.heights.end());
+	_minHeight = *range.first;
+	_maxHeight = *range.second;
+
+	// sample j of a level sits on sample 2j of the one before, tent filter around it
+	const float weights[3] = { 0.25f, 0.5f, 0.25f };
+
+	for (uint32_t level = 1; level < _terrain.levelCount; level++) {
+		const HeightLevel &previous = _levels[level - 1];
+		HeightLevel &current = _levels[level];
+
+		current.width = (previous.width - 1) / 2 + 1;
+		current.height = (previous.height - 1) / 2 + 1;
+		current.heights.resize(static_cast<size_t>(current.width) * current.height);
+
+		for (uint32_t z = 0; z < current.height; z++) {
+			for (uint32_t x = 0; x < current.width; x++) {
+				float height = 0.0f;
+
+				for (int32_t dz = -1; dz <= 1; dz++) {
+					for (int32_t dx = -1; dx <= 1; dx++) {
+						float weight = weights[dx + 1] * weights[dz + 1];
+						height += weight * _sample(level - 1, 2 * x + dx, 2 * z + dz);
+					}
+				}
+
+				current.heights[static_cast<size_t>(z) * current.width + x] = height;
+			}
+		}
+	}
+}
+
+void TerrainStorage::_buildMeshes() {
+	const uint32_t size = TERRAIN_BLOCK_SIZE;
+
+	// quads along x and z, see PieceKind
+	const uint32_t sizes[PIECE_KIND_COUNT][2] = {
+		{ size, size },
+		{ size, 2 },
+		{ 2, size },
+		{ 2 * size + 1, 1 },
+		{ 1, 2 * size + 2 },
+		{ 2, 2 },
+	};
+
+	std::vector<GridVertex> vertices;
+	std::vector<uint16_t> indices;
+
+	for (uint32_t i = 0; i < PIECE_KIND_COUNT; i++) {
+		GridMesh &mesh = _meshes[i];
+		mesh.width = sizes[i][0];
+		mesh.height = sizes[i][1];
+		mesh.firstIndex = static_cast<uint32_t>(indices.size());
+		mesh.vertexOffset = static_cast<int32_t>(vertices.size());
+
+		uint32_t stride = mesh.width + 1;
+
+		for (uint32_t z = 0; z <= mesh.height; z++) {
+			for (uint32_t x = 0; x <= mesh.width; x++)
+				vertices.push_back({ static_cast<uint16_t>(x), static_cast<uint16_t>(z) });
+		}
+
+		// counter-clockwise seen from above
+		for (uint32_t z = 0; z < mesh.height; z++) {
+			for (uint32_t x = 0; x < mesh.width; x++) {
+				uint16_t a = static_cast<uint16_t>(z * stride + x);
+				uint16_t b = static_cast<uint16_t>(a + stride);
+				uint16_t c = static_cast<uint16_t>(a + 1);
+				uint16_t d = static_cast<uint16_t>(b + 1);
+
+				indices.insert(indices.end(), { a, b, c, c, b, d });
+			}
+		}
+
+		mesh.indexCount = static_cast<uint32_t>(indices.size()) - mesh.firstIndex;
+	}
+
+	RD &rd = RD::getSingleton();
+
+	vk::DeviceSize vertexSize = sizeof(GridVertex) * vertices.size();
+	vk::DeviceSize indexSize = sizeof(uint16_t) * indices.size();
+
+	_vertexBuffer = rd.bufferCreate(MemoryCategory::Mesh, BufferClass::Static,
+			vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			vertexSize);
+	_indexBuffer = rd.bufferCreate(MemoryCategory::Mesh, BufferClass::Static,
+			vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			indexSize);
+
+	rd.bufferSend(_vertexBuffer.buffer, reinterpret_cast<uint8_t *>(vertices.data()), vertexSize);
+	rd.bufferSend(_indexBuffer.buffer, reinterpret_cast<uint8_t *>(indices.data()), indexSize);
+}
+
+void TerrainStorage::_placeLevels(const glm::vec2 &viewer, glm::ivec2 *pOrigins) const {
+	// grids move by two of their samples, one of coarser level, so each one lands on samples of
+	// the next one and the finer grid sits one sample off center of hole at most
+	for (uint32_t level = 0; level < _terrain.levelCount; level++) {
+		glm::vec2 coarse = glm::floor(viewer / std::exp2(static_cast<float>(level + 1)));
+		glm::ivec2 center = 2 * glm::ivec2(coarse);
+
+		pOrigins[level] = center - glm::ivec2(TERRAIN_LEVEL_SIZE / 2 - 1);
+	}
+}
+
+void TerrainStorage::_addPiece(PieceKind kind, uint32_t level, glm::ivec2 origin) {
+	const GridMesh &mesh = _meshes[static_cast<uint32_t>(kind)];
+	float spacing = _terrain.sampleSpacing * std::exp2(static_cast<float>(level));
+
+	glm::vec2 min = glm::vec2(_terrain.origin.x, _terrain.origin.z) + glm::vec2(origin) * spacing;
+	glm::vec2 max = min + glm::vec2(mesh.width, mesh.height) * spacing;
+
+	AABB aabb;
+	aabb.min = glm::vec3(min.x, _terrain.origin.y + _minHeight, min.y);
+	aabb.max = glm::vec3(max.x, _terrain.origin.y + _maxHeight, max.y);
+
+	_pieces.push_back({ origin, level, 0 });
+	_pieceKinds.push_back(kind);
+	_culler.add(aabb);
+}
+
+void TerrainStorage::_addPieces(const glm::ivec2 *pOrigins) {
+	_pieces.clear();
+	_pieceKinds.clear();
+	_culler.clear();
+
+	const int32_t size = static_cast<int32_t>(TERRAIN_BLOCK_SIZE);
+	// starts of blocks along a side, fixups fill the two quads in middle
+	const int32_t starts[4] = { 0, size, 2 * size + 2, 3 * size + 2 };
+
+	// coarser levels leave out the middle, finer one fills it
+	auto isInner = [](uint32_t i) { return i == 1 || i == 2; };
+
+	// grouped by mesh, culled ones keep the order
+	for (uint32_t level = 0; level < _terrain.levelCount; level++) {
+		for (uint32_t z = 0; z < 4; z++) {
+			for (uint32_t x = 0; x < 4; x++) {
+				if (level > 0 && isInner(x) && isInner(z))
+					continue;
+
+				glm::ivec2 offset = glm::ivec2(starts[x], starts[z]);
+				_addPiece(PieceKind::Block, level, pOrigins[level] + offset);
+			}
+		}
+	}
+
+	for (uint32_t level = 0; level < _terrain.levelCount; level++) {
+		for (uint32_t i = 0; i < 4; i++) {
+			if (level > 0 && isInner(i))
+				continue;
+
+			glm::ivec2 offset = glm::ivec2(starts[i], 2 * size);
+			_addPiece(PieceKind::FixupX, level, pOrigins[level] + offset);
+		}
+	}
+
+	for (uint32_t level = 0; level < _terrain.levelCount; level++) {
+		for (uint32_t i = 0; i < 4; i++) {
+			if (level > 0 && isInner(i))
+				continue;
+
+			glm::ivec2 offset = glm::ivec2(2 * size, starts[i]);
+			_addPiece(PieceKind::FixupZ, level, pOrigins[level] + offset);
+		}
+	}
+
+	// hole is one sample wider than finer level, trim takes the side finer level left open
+	glm::ivec2 shifts[MAX_TERRAIN_LEVEL_COUNT] = {};
+
+	for (uint32_t level = 1; level < _terrain.levelCount; level++) {
+		glm::ivec2 hole = pOrigins[level] + glm::ivec2(size);
+		shifts[level] = pOrigins[level - 1] / 2 - hole;
+	}
+
+	for (uint32_t level = 1; level < _terrain.levelCount; level++) {
+		glm::ivec2 hole = pOrigins[level] + glm::ivec2(size);
+		glm::ivec2 shift = shifts[level];
+
+		int32_t z = hole.y + (shift.y == 1 ? 0 : 2 * size + 1);
+		// corner belongs to trim along z
+		int32_t x = hole.x + (shift.x == 1 ? 1 : 0);
+
+		_addPiece(PieceKind::TrimX, level, glm::ivec2(x, z));
+	}
+
+	for (uint32_t level = 1; level < _terrain.levelCount; level++) {
+		glm::ivec2 hole = pOrigins[level] + glm::ivec2(size);
+		glm::ivec2 shift = shifts[level];
+
+		int32_t x = hole.x + (shift.x == 1 ? 0 : 2 * size + 1);
+
+		_addPiece(PieceKind::TrimZ, level, glm::ivec2(x, hole.y));
+	}
+
+	_addPiece(PieceKind::Center, 0, pOrigins[0] + glm::ivec2(2 * size));
+}
+
+void TerrainStorage::_streamTiles(
+		vk::CommandBuffer commandBuffer, uint32_t frame, const glm::ivec2 *pOrigins) {
+	const int32_t tileSize = static_cast<int32_t>(TERRAIN_TILE_SIZE);
+	const int32_t tileCount = static_cast<int32_t>(TERRAIN_LEVEL_TILE_COUNT);
+
+	float *pStaging = static_cast<float *>(_stagingAllocInfos[frame].pMappedData);
+	std::vector<vk::BufferImageCopy> regions;
+
+	for (uint32_t level = 0; level < _terrain.levelCount; level++) {
+		// grid and one sample around it, normals read neighbours of edge vertices
+		glm::ivec2 first = pOrigins[level] - glm::ivec2(1);
+		glm::ivec2 last = pOrigins[level] + glm::ivec2(TERRAIN_LEVEL_SIZE + 1);
+
+		int32_t firstX = _floorDiv(first.x, tileSize);
+		int32_t firstZ = _floorDiv(first.y, tileSize);
+		int32_t lastX = _floorDiv(last.x, tileSize);
+		int32_t lastZ = _floorDiv(last.y, tileSize);
+
+		for (int32_t tileZ = firstZ; tileZ <= lastZ; tileZ++) {
+			for (int32_t tileX = firstX; tileX <= lastX; tileX++) {
+				int32_t slotX = _floorMod(tileX, tileCount);
+				int32_t slotZ = _floorMod(tileZ, tileCount);
+
+				glm::ivec2 &resident = _residentTiles[level][slotZ * tileCount + slotX];
+				glm::ivec2 tile = glm::ivec2(tileX, tileZ);
+
+				if (resident == tile)
+					continue;
+
+				resident = tile;
+
+				vk::DeviceSize offset = regions.size() * TILE_BYTE_SIZE;
+				float *pTile = pStaging + regions.size() * TERRAIN_TILE_SIZE * TERRAIN_TILE_SIZE;
+
+				for (int32_t z = 0; z < tileSize; z++) {
+					for (int32_t x = 0; x < tileSize; x++) {
+						pTile[z * tileSize + x] =
+								_sample(level, tileX * tileSize + x, tileZ * tileSize + z);
+					}
+				}
+
+				vk::ImageSubresourceLayers subresource;
+				subresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+				subresource.setMipLevel(0);
+				subresource.setBaseArrayLayer(level);
+				subresource.setLayerCount(1);
+
+				vk::BufferImageCopy region;
+				region.setBufferOffset(offset);
+				region.setImageSubresource(subresource);
+				region.setImageOffset(vk::Offset3D(slotX * tileSize, slotZ * tileSize, 0));
+				region.setImageExtent(vk::Extent3D(TERRAIN_TILE_SIZE, TERRAIN_TILE_SIZE, 1));
+
+				regions.push_back(region);
+			}
+		}
+	}
+
+	if (regions.empty())
+		return;
+
+	RD::getSingleton().bufferFlush(_stagingBuffers[frame]);
+
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(0);
+	subresourceRange.setLevelCount(1);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(MAX_TERRAIN_LEVEL_COUNT);
+
+	// earlier frames may still read heights of the tiles being replaced
+	vk::ImageMemoryBarrier barrier;
+	barrier.setImage(_clip.image);
+	barrier.setSubresourceRange(subresourceRange);
+	barrier.setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+	commandBuffer.copyBufferToImage(_stagingBuffers[frame].buffer, _clip.image,
+			vk::ImageLayout::eTransferDstOptimal, regions);
+
+	barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eVertexShader, {}, nullptr, nullptr, barrier);
+}
+
+void TerrainStorage::_updateSet(uint32_t frame) {
+	if (_setVersions[frame] == _version)
+		return;
+
+	const TextureRD &splat = _hasSplat ? _splat : _fallbackSplat;
+
+	vk::DescriptorImageInfo imageInfo;
+	imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	imageInfo.setImageView(splat.imageView);
+	imageInfo.setSampler(splat.sampler);
+
+	vk::WriteDescriptorSet writeInfo;
+	writeInfo.setDstSet(_sets[frame]);
+	writeInfo.setDstBinding(2);
+	writeInfo.setDstArrayElement(0);
+	writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	writeInfo.setDescriptorCount(1);
+	writeInfo.setImageInfo(imageInfo);
+
+	_device.updateDescriptorSets(writeInfo, nullptr);
+
+	_setVersions[frame] = _version;
+}
+
+vk::PipelineVertexInputStateCreateInfo TerrainStorage::getInputState() {
+	static const vk::VertexInputBindingDescription binding(
+			0, sizeof(GridVertex), vk::VertexInputRate::eVertex);
+	static const vk::VertexInputAttributeDescription attribute(
+			0, 0, vk::Format::eR16G16Uint, 0);
+
+	vk::PipelineVertexInputStateCreateInfo inputState;
+	inputState.setVertexBindingDescriptions(binding);
+	inputState.setVertexAttributeDescriptions(attribute);
+
+	return inputState;
+}
+
+void TerrainStorage::set(const Terrain &terrain, const std::shared_ptr<Image> &heightmap,
+		const std::shared_ptr<Image> &splatmap) {
+	RD &rd = RD::getSingleton();
+
+	// frames in flight still sample it
+	if (_hasSplat) {
+		TextureRD splat = _splat;
+		rd.destroyDeferred([splat]() { RD::getSingleton().textureDestroy(splat); });
+		_hasSplat = false;
+	}
+
+	_version++;
+
+	if (heightmap == nullptr) {
+		_isEnabled = false;
+		_levels.clear();
+		return;
+	}
+
+	_terrain = terrain;
+	_terrain.levelCount = std::clamp(terrain.levelCount, 1u, MAX_TERRAIN_LEVEL_COUNT);
+
+	_buildLevels(heightmap);
+
+	for (auto &tiles : _residentTiles)
+		tiles.fill(INVALID_TILE);
+
+	if (splatmap != nullptr) {
+		_splat = rd.textureCreate(splatmap);
+		_hasSplat = true;
+	}
+
+	_isEnabled = true;
+}
+
+void TerrainStorage::layerSet(uint32_t index, const std::shared_ptr<Image> &image) {
+	if (index >= MAX_TERRAIN_LAYER_COUNT)
+		return;
+
+	Image layer = *image;
+
+	if (layer.getFormat() != Image::Format::RGBA8)
+		layer.convert(Image::Format::RGBA8);
+
+	RD &rd = RD::getSingleton();
+
+	const std::vector<uint8_t> &data = layer.getData();
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(TERRAIN_LAYER_SIZE) * TERRAIN_LAYER_SIZE * 4;
+
+	VmaAllocationInfo stagingAllocInfo;
+	AllocatedBuffer staging = rd.bufferCreate(MemoryCategory::Staging, BufferClass::Staging,
+			vk::BufferUsageFlagBits::eTransferSrc, size, &stagingAllocInfo);
+	memcpy(stagingAllocInfo.pMappedData, data.data(), size);
+	rd.bufferFlush(staging);
+
+	vk::CommandBuffer commandBuffer = rd.beginSingleTimeCommands();
+
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(0);
+	subresourceRange.setLevelCount(_layerMipLevels);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(MAX_TERRAIN_LAYER_COUNT);
+
+	// levels of every layer are blitted again, contents of other layers stay
+	vk::ImageMemoryBarrier barrier;
+	barrier.setImage(_layers.image);
+	barrier.setSubresourceRange(subresourceRange);
+	barrier.setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+	vk::ImageSubresourceLayers subresource;
+	subresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresource.setMipLevel(0);
+	subresource.setBaseArrayLayer(index);
+	subresource.setLayerCount(1);
+
+	vk::BufferImageCopy region;
+	region.setImageSubresource(subresource);
+	region.setImageExtent(vk::Extent3D(TERRAIN_LAYER_SIZE, TERRAIN_LAYER_SIZE, 1));
+
+	commandBuffer.copyBufferToImage(
+			staging.buffer, _layers.image, vk::ImageLayout::eTransferDstOptimal, region);
+
+	rd.imageGenerateMipmaps(commandBuffer, _layers.image, TERRAIN_LAYER_SIZE, TERRAIN_LAYER_SIZE,
+			vk::Format::eR8G8B8A8Srgb, _layerMipLevels, MAX_TERRAIN_LAYER_COUNT);
+
+	rd.endSingleTimeCommands(commandBuffer);
+	rd.bufferDestroy(staging);
+}
+
+bool TerrainStorage::isEnabled() const {
+	return _isEnabled;
+}
+
+uint64_t TerrainStorage::getVersion() const {
+	return _version;
+}
+
+void TerrainStorage::update(vk::CommandBuffer commandBuffer, uint32_t frame,
+		const glm::vec3 &position, const glm::mat4 *pProjViews, uint32_t viewCount) {
+	_updateSet(frame);
+
+	if (!_isEnabled)
+		return;
+
+	glm::vec2 local = glm::vec2(position.x, position.z) -
+			glm::vec2(_terrain.origin.x, _terrain.origin.z);
+	glm::vec2 viewer = local / _terrain.sampleSpacing;
+
+	glm::ivec2 origins[MAX_TERRAIN_LEVEL_COUNT];
+	_placeLevels(viewer, origins);
+
+	_streamTiles(commandBuffer, frame, origins);
+	_addPieces(origins);
+
+	uint8_t *pMapped = static_cast<uint8_t *>(_pieceAllocInfos[frame].pMappedData);
+
+	PieceHeader *pHeader = reinterpret_cast<PieceHeader *>(pMapped);
+	pHeader->viewer = viewer;
+
+	Piece *pPieces = reinterpret_cast<Piece *>(pMapped + sizeof(PieceHeader));
+	vk::DrawIndexedIndirectCommand *pCommands =
+			static_cast<vk::DrawIndexedIndirectCommand *>(_commandAllocInfos[frame].pMappedData);
+
+	viewCount = std::min(viewCount, MAX_VIEW_COUNT);
+
+	for (uint32_t view = 0; view < viewCount; view++) {
+		_culler.cull(pProjViews[view], _visible);
+
+		std::array<uint32_t, PIECE_KIND_COUNT> counts = {};
+
+		for (uint32_t index : _visible) {
+			uint32_t kind = static_cast<uint32_t>(_pieceKinds[index]);
+			uint32_t range = view * PIECE_KIND_COUNT + kind;
+
+			pPieces[range * MAX_TERRAIN_PIECE_COUNT + counts[kind]] = _pieces[index];
+			counts[kind]++;
+		}
+
+		for (uint32_t kind = 0; kind < PIECE_KIND_COUNT; kind++) {
+			vk::DrawIndexedIndirectCommand &command = pCommands[view * PIECE_KIND_COUNT + kind];
+			command.indexCount = _meshes[kind].indexCount;
+			command.instanceCount = counts[kind];
+			command.firstIndex = _meshes[kind].firstIndex;
+			command.vertexOffset = _meshes[kind].vertexOffset;
+			command.firstInstance = 0;
+		}
+
+		_drawnCounts[frame][view] = static_cast<uint32_t>(_visible.size());
+	}
+}
+
+void TerrainStorage::draw(vk::CommandBuffer commandBuffer, uint32_t frame, uint32_t view,
+		vk::PipelineLayout pipelineLayout, DrawStats &stats) const {
+	if (!_isEnabled)
+		return;
+
+	vk::ShaderStageFlags stages =
+			vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+	TerrainConstants constants = {};
+	constants.origin = glm::vec4(_terrain.origin, _terrain.sampleSpacing);
+	constants.extent = glm::vec2(_levels[0].width - 1, _levels[0].height - 1) *
+			_terrain.sampleSpacing;
+	constants.layerScale = _terrain.layerScale;
+	constants.levelCount = _terrain.levelCount;
+	constants.pieceOffset = view * PIECE_KIND_COUNT * MAX_TERRAIN_PIECE_COUNT;
+
+	commandBuffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eGraphics, pipelineLayout, 3, _sets[frame], nullptr);
+	commandBuffer.pushConstants(pipelineLayout, stages, 0, sizeof(constants), &constants);
+
+	commandBuffer.bindVertexBuffers(0, _vertexBuffer.buffer, { 0 });
+	commandBuffer.bindIndexBuffer(_indexBuffer.buffer, 0, vk::IndexType::eUint16);
+
+	vk::DeviceSize stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+	// every mesh reads pieces of its own range, instance counts were written by update
+	for (uint32_t kind = 0; kind < PIECE_KIND_COUNT; kind++) {
+		if (kind > 0) {
+			uint32_t pieceOffset = constants.pieceOffset + kind * MAX_TERRAIN_PIECE_COUNT;
+			commandBuffer.pushConstants(pipelineLayout, stages,
+					offsetof(TerrainConstants, pieceOffset), sizeof(uint32_t), &pieceOffset);
+			stats.pushConstantCount++;
+		}
+
+		vk::DeviceSize offset = (view * PIECE_KIND_COUNT + kind) * stride;
+		commandBuffer.drawIndexedIndirect(_commandBuffers[frame].buffer, offset, 1, stride);
+		stats.drawCount++;
+	}
+
+	stats.instanceCount += _drawnCounts[frame][view];
+	stats.meshBindCount++;
+	stats.setBindCount++;
+	stats.pushConstantCount++;
+}
+
+vk::DescriptorSetLayout TerrainStorage::getSetLayout() const {
+	return _setLayout;
+}
+
+void TerrainStorage::initialize(vk::Device device, vk::DescriptorPool descriptorPool) {
+	if (_initialized)
+		return;
+
+	_device = device;
+
+	RD &rd = RD::getSingleton();
+	uint32_t framesInFlight = rd.getFramesInFlight();
+
+	_buildMeshes();
+
+	// heights are fetched, never filtered
+	_clip = AllocatedImage::create(rd.getAllocator(), MemoryCategory::Texture, TERRAIN_CLIP_SIZE,
+			TERRAIN_CLIP_SIZE, 1, MAX_TERRAIN_LEVEL_COUNT, vk::Format::eR32Sfloat,
+			vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+	_clipView = rd.imageViewCreate(_clip.image, vk::Format::eR32Sfloat, 1,
+			MAX_TERRAIN_LEVEL_COUNT, vk::ImageViewType::e2DArray);
+
+	rd.imageLayoutTransition(_clip.image, vk::Format::eR32Sfloat, 1, MAX_TERRAIN_LEVEL_COUNT,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+	rd.imageLayoutTransition(_clip.image, vk::Format::eR32Sfloat, 1, MAX_TERRAIN_LEVEL_COUNT,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+	for (auto &tiles : _residentTiles)
+		tiles.fill(INVALID_TILE);
+
+	// layers are white until set
+	_layerMipLevels = static_cast<uint32_t>(std::floor(std::log2(TERRAIN_LAYER_SIZE))) + 1;
+	_layers = AllocatedImage::create(rd.getAllocator(), MemoryCategory::Texture,
+			TERRAIN_LAYER_SIZE, TERRAIN_LAYER_SIZE, _layerMipLevels, MAX_TERRAIN_LAYER_COUNT,
+			vk::Format::eR8G8B8A8Srgb,
+			vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc |
+					vk::ImageUsageFlagBits::eTransferDst);
+	_layersView = rd.imageViewCreate(_layers.image, vk::Format::eR8G8B8A8Srgb, _layerMipLevels,
+			MAX_TERRAIN_LAYER_COUNT, vk::ImageViewType::e2DArray);
+
+	{
+		vk::CommandBuffer commandBuffer = rd.beginSingleTimeCommands();
+
+		vk::ImageSubresourceRange subresourceRange;
+		subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		subresourceRange.setBaseMipLevel(0);
+		subresourceRange.setLevelCount(_layerMipLevels);
+		subresourceRange.setBaseArrayLayer(0);
+		subresourceRange.setLayerCount(MAX_TERRAIN_LAYER_COUNT);
+
+		vk::ImageMemoryBarrier barrier;
+		barrier.setImage(_layers.image);
+		barrier.setSubresourceRange(subresourceRange);
+		barrier.setOldLayout(vk::ImageLayout::eUndefined);
+		barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+		subresourceRange.setLevelCount(1);
+		commandBuffer.clearColorImage(_layers.image, vk::ImageLayout::eTransferDstOptimal,
+				vk::ClearColorValue(std::array<float, 4>{ 1.0f, 1.0f, 1.0f, 1.0f }),
+				subresourceRange);
+
+		rd.imageGenerateMipmaps(commandBuffer, _layers.image, TERRAIN_LAYER_SIZE,
+				TERRAIN_LAYER_SIZE, vk::Format::eR8G8B8A8Srgb, _layerMipLevels,
+				MAX_TERRAIN_LAYER_COUNT);
+
+		rd.endSingleTimeCommands(commandBuffer);
+	}
+
+	std::vector<uint8_t> firstLayer = { 255, 0, 0, 0 };
+	_fallbackSplat = rd.textureCreate(
+			std::make_shared<Image>(1, 1, Image::Format::RGBA8, std::move(firstLayer)));
+
+	std::array<vk::DescriptorSetLayoutBinding, 4> bindings = {};
+
+	// heights of clip levels
+	bindings[0].setBinding(0);
+	bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	bindings[0].setDescriptorCount(1);
+	bindings[0].setStageFlags(vk::ShaderStageFlagBits::eVertex);
+
+	// pieces
+	bindings[1].setBinding(1);
+	bindings[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+	bindings[1].setDescriptorCount(1);
+	bindings[1].setStageFlags(vk::ShaderStageFlagBits::eVertex);
+
+	// splat map and layers
+	bindings[2].setBinding(2);
+	bindings[2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	bindings[2].setDescriptorCount(1);
+	bindings[2].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	bindings[3].setBinding(3);
+	bindings[3].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+	bindings[3].setDescriptorCount(1);
+	bindings[3].setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+	vk::DescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.setBindings(bindings);
+
+	vk::Result err = device.createDescriptorSetLayout(&createInfo, nullptr, &_setLayout);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Terrain descriptor set layout creation failed!");
+
+	std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, _setLayout);
+
+	vk::DescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.setDescriptorPool(descriptorPool);
+	allocInfo.setSetLayouts(layouts);
+
+	err = device.allocateDescriptorSets(&allocInfo, _sets);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Terrain descriptor set allocation failed!");
+
+	vk::Sampler clipSampler = rd.samplerGet(vk::Filter::eNearest, vk::SamplerAddressMode::eRepeat);
+	vk::Sampler layerSampler = rd.samplerGet(vk::Filter::eLinear, vk::SamplerAddressMode::eRepeat);
+
+	vk::DeviceSize pieceSize = sizeof(PieceHeader) +
+			sizeof(Piece) * MAX_TERRAIN_PIECE_COUNT * PIECE_KIND_COUNT * MAX_VIEW_COUNT;
+	vk::DeviceSize commandSize =
+			sizeof(vk::DrawIndexedIndirectCommand) * PIECE_KIND_COUNT * MAX_VIEW_COUNT;
+
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		_stagingBuffers[i] = rd.bufferCreate(MemoryCategory::Staging, BufferClass::Staging,
+				vk::BufferUsageFlagBits::eTransferSrc, TILE_BYTE_SIZE * MAX_TILE_UPLOAD_COUNT,
+				&_stagingAllocInfos[i]);
+		_pieceBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+				vk::BufferUsageFlagBits::eStorageBuffer, pieceSize, &_pieceAllocInfos[i]);
+		_commandBuffers[i] = rd.bufferCreate(MemoryCategory::Other, BufferClass::Dynamic,
+				vk::BufferUsageFlagBits::eIndirectBuffer, commandSize, &_commandAllocInfos[i]);
+
+		// views terrain was not culled for draw nothing
+		memset(_commandAllocInfos[i].pMappedData, 0, commandSize);
+
+		std::array<vk::DescriptorImageInfo, 2> imageInfos;
+		imageInfos[0] = vk::DescriptorImageInfo(
+				clipSampler, _clipView, vk::ImageLayout::eShaderReadOnlyOptimal);
+		imageInfos[1] = vk::DescriptorImageInfo(
+				layerSampler, _layersView, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		vk::DescriptorBufferInfo bufferInfo = _pieceBuffers[i].getBufferInfo();
+
+		std::array<vk::WriteDescriptorSet, 3> writeInfos;
+		writeInfos[0].setDstSet(_sets[i]);
+		writeInfos[0].setDstBinding(0);
+		writeInfos[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfos[0].setImageInfo(imageInfos[0]);
+
+		writeInfos[1].setDstSet(_sets[i]);
+		writeInfos[1].setDstBinding(1);
+		writeInfos[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+		writeInfos[1].setBufferInfo(bufferInfo);
+
+		writeInfos[2].setDstSet(_sets[i]);
+		writeInfos[2].setDstBinding(3);
+		writeInfos[2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+		writeInfos[2].setImageInfo(imageInfos[1]);
+
+		device.updateDescriptorSets(writeInfos, nullptr);
+
+		// splat binding is written by first update
+		_setVersions[i] = UINT64_MAX;
+	}
+
+	_initialized = true;
+}
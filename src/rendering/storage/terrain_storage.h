@@ -0,0 +1,203 @@
+#ifndef TERRAIN_STORAGE_H
+#define TERRAIN_STORAGE_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <io/image.h>
+#include <rendering/culling/frustum_culler.h>
+#include <rendering/render_queue.h>
+#include <rendering/types/allocated.h>
+#include <rendering/types/frame.h>
+#include <rendering/types/resource.h>
+#include <rendering/types/terrain.h>
+
+// quads along a side of clip level, four blocks of TERRAIN_BLOCK_SIZE quads with a cross of two
+// quad wide fixups between them
+const uint32_t TERRAIN_BLOCK_SIZE = 63;
+const uint32_t TERRAIN_LEVEL_SIZE = 4 * TERRAIN_BLOCK_SIZE + 2;
+
+// heights of clip levels are streamed in square tiles, a level keeps enough of them for its grid
+// and neighbours its normals read at any alignment
+const uint32_t TERRAIN_TILE_SIZE = 32;
+const uint32_t TERRAIN_LEVEL_TILE_COUNT = 9;
+const uint32_t TERRAIN_CLIP_SIZE = TERRAIN_TILE_SIZE * TERRAIN_LEVEL_TILE_COUNT;
+
+// blocks of finest level or ring of coarser one, fixups, trims and center
+const uint32_t MAX_TERRAIN_LEVEL_PIECE_COUNT = 16 + 8 + 2 + 1;
+// of one mesh in one view, each has a range of this size in piece buffer
+const uint32_t MAX_TERRAIN_PIECE_COUNT = MAX_TERRAIN_LEVEL_PIECE_COUNT * MAX_TERRAIN_LEVEL_COUNT;
+
+// Geometry clipmap terrain after Losasso and Hoppe 2004. Levels are nested square grids around
+// camera, each with twice the spacing of the one inside, drawn as instances of a few small grid
+// meshes whose vertices are placed and raised in vertex shader, so cost follows level count and
+// screen rather than size of heightmap. Grids move in steps of their coarser level, an L shaped
+// trim closes the gap it leaves, and vertices near the outer edge of a level morph towards
+// heights of the coarser one so levels meet without cracks. Heights stay in host memory as a
+// filtered chain, each level keeps a toroidal window of tiles in one layer of a texture array
+// and only tiles a move uncovers are copied. Pieces are frustum culled on CPU for every view and
+// drawn with one indirect command per mesh, so recorded draws stay valid while camera moves.
+// Splat map weighs albedo layers of a texture array.
+class TerrainStorage {
+public:
+	// has to match shaders/include/terrain_incl.glsl
+	typedef struct {
+		// w is sample spacing
+		glm::vec4 origin;
+		// world size heightmap and splat map cover along x and z
+		glm::vec2 extent;
+		float layerScale;
+		uint32_t levelCount;
+		// first piece of mesh drawn, pushed again for every one of them
+		uint32_t pieceOffset;
+		uint32_t _padding[3];
+	} TerrainConstants;
+
+private:
+	// order of meshes in grid buffers and of indirect commands of a view
+	enum class PieceKind : uint32_t {
+		Block,
+		// two quads across, along x or along z
+		FixupX,
+		FixupZ,
+		// one quad across, along x or along z
+		TrimX,
+		TrimZ,
+		// two by two quads in middle of finest level
+		Center,
+	};
+
+	static const uint32_t PIECE_KIND_COUNT = 6;
+
+	// has to match shaders/include/terrain_incl.glsl, leads piece buffer and moves with camera,
+	// so it is read there rather than pushed
+	typedef struct {
+		// first view in samples of finest level from origin, vertices morph by distance to it
+		glm::vec2 viewer;
+		glm::vec2 _padding;
+	} PieceHeader;
+
+	// has to match shaders/include/terrain_incl.glsl
+	typedef struct {
+		// of first vertex, in samples of its level from terrain origin
+		glm::ivec2 origin;
+		uint32_t level;
+		uint32_t _padding;
+	} Piece;
+
+	typedef struct {
+		uint32_t width;
+		uint32_t height;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t vertexOffset;
+	} GridMesh;
+
+	typedef struct {
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> heights;
+	} HeightLevel;
+
+	vk::Device _device;
+
+	Terrain _terrain;
+	bool _isEnabled = false;
+
+	// each one filtered from the one before, at level spacing
+	std::vector<HeightLevel> _levels;
+	float _minHeight = 0.0f;
+	float _maxHeight = 0.0f;
+
+	// layer per level, window of world tiles addressed modulo tile count
+	AllocatedImage _clip;
+	vk::ImageView _clipView;
+	std::array<std::array<glm::ivec2, TERRAIN_LEVEL_TILE_COUNT * TERRAIN_LEVEL_TILE_COUNT>,
+			MAX_TERRAIN_LEVEL_COUNT>
+			_residentTiles;
+
+	AllocatedBuffer _stagingBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _stagingAllocInfos[MAX_FRAMES_IN_FLIGHT];
+
+	// range of pieces and indirect command for every mesh of every view, commands of a view
+	// follow order of meshes
+	AllocatedBuffer _pieceBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _pieceAllocInfos[MAX_FRAMES_IN_FLIGHT];
+	AllocatedBuffer _commandBuffers[MAX_FRAMES_IN_FLIGHT];
+	VmaAllocationInfo _commandAllocInfos[MAX_FRAMES_IN_FLIGHT];
+	uint32_t _drawnCounts[MAX_FRAMES_IN_FLIGHT][MAX_VIEW_COUNT] = {};
+
+	AllocatedBuffer _vertexBuffer;
+	AllocatedBuffer _indexBuffer;
+	std::array<GridMesh, PIECE_KIND_COUNT> _meshes;
+
+	// fallback weighs first layer only
+	TextureRD _splat;
+	TextureRD _fallbackSplat;
+	bool _hasSplat = false;
+
+	AllocatedImage _layers;
+	vk::ImageView _layersView;
+	uint32_t _layerMipLevels = 1;
+
+	std::vector<Piece> _pieces;
+	std::vector<PieceKind> _pieceKinds;
+	FrustumCuller _culler;
+	std::vector<uint32_t> _visible;
+
+	vk::DescriptorSetLayout _setLayout;
+	vk::DescriptorSet _sets[MAX_FRAMES_IN_FLIGHT];
+
+	// splat map bindings of sets follow it
+	uint64_t _version = 0;
+	uint64_t _setVersions[MAX_FRAMES_IN_FLIGHT] = {};
+
+	bool _initialized = false;
+
+	// edges repeat past heightmap
+	float _sample(uint32_t level, int32_t x, int32_t z) const;
+	void _buildLevels(const std::shared_ptr<Image> &heightmap);
+	void _buildMeshes();
+
+	// first vertex of every level, finest one centered on viewer
+	void _placeLevels(const glm::vec2 &viewer, glm::ivec2 *pOrigins) const;
+	void _addPieces(const glm::ivec2 *pOrigins);
+	void _addPiece(PieceKind kind, uint32_t level, glm::ivec2 origin);
+
+	// copies tiles levels moved onto, before anything samples heights
+	void _streamTiles(vk::CommandBuffer commandBuffer, uint32_t frame, const glm::ivec2 *pOrigins);
+	void _updateSet(uint32_t frame);
+
+public:
+	// vertex of grid meshes, quads from origin of piece
+	static vk::PipelineVertexInputStateCreateInfo getInputState();
+
+	// replaces heightmap and splat map, null heightmap turns terrain off, null splat map shows
+	// first layer only
+	void set(const Terrain &terrain, const std::shared_ptr<Image> &heightmap,
+			const std::shared_ptr<Image> &splatmap);
+	// square image of TERRAIN_LAYER_SIZE, waits for device to copy it
+	void layerSet(uint32_t index, const std::shared_ptr<Image> &image);
+	bool isEnabled() const;
+	// changes once recorded draws of terrain are no longer valid
+	uint64_t getVersion() const;
+
+	// after drawBegin, before render pass, levels follow first view and pieces are culled
+	// against every one
+	void update(vk::CommandBuffer commandBuffer, uint32_t frame, const glm::vec3 &position,
+			const glm::mat4 *pProjViews, uint32_t viewCount);
+	// pipeline and material sets are bound, terrain set goes to index 3
+	void draw(vk::CommandBuffer commandBuffer, uint32_t frame, uint32_t view,
+			vk::PipelineLayout pipelineLayout, DrawStats &stats) const;
+
+	vk::DescriptorSetLayout getSetLayout() const;
+
+	void initialize(vk::Device device, vk::DescriptorPool descriptorPool);
+};
+
+#endif // !TERRAIN_STORAGE_H
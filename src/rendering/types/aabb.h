@@ -0,0 +1,41 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <glm/glm.hpp>
+
+struct AABB {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	glm::vec3 center() const {
+		return (min + max) * 0.5f;
+	}
+
+	glm::vec3 extent() const {
+		return (max - min) * 0.5f;
+	}
+
+	// 0 for point inside
+	float distance(const glm::vec3 &point) const {
+		return glm::length(point - glm::clamp(point, min, max));
+	}
+
+	void expand(const glm::vec3 &point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	// Arvo's method, transforms center and projects extent on world axes
+	AABB transformed(const glm::mat4 &transform) const {
+		glm::vec3 c = glm::vec3(transform * glm::vec4(center(), 1.0f));
+		glm::vec3 e = extent();
+
+		glm::mat3 basis = glm::mat3(transform);
+		glm::vec3 worldExtent = glm::abs(basis[0]) * e.x + glm::abs(basis[1]) * e.y +
+								glm::abs(basis[2]) * e.z;
+
+		return { c - worldExtent, c + worldExtent };
+	}
+};
+
+#endif // !AABB_H
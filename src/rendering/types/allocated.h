@@ -1,25 +1,103 @@
 #ifndef VK_TYPES_H
 #define VK_TYPES_H
 
+#include <cstdint>
+#include <vector>
+
 #include <vma/vk_mem_alloc.h>
 #include <vulkan/vulkan.hpp>
 
+#include <rendering/memory_tracker.h>
+
+// dynamic buffers up to it go to device local memory of BAR heap even when it is not resizable,
+// 256 MiB of it is shared with driver
+const vk::DeviceSize SMALL_DYNAMIC_BUFFER_SIZE = 64 * 1024;
+// heaps past it are taken for resizable BAR, whole device memory is host visible
+const vk::DeviceSize MAX_BAR_HEAP_SIZE = 256 * 1024 * 1024;
+
+// how memory of buffer is accessed, picks its memory type
+enum class BufferClass {
+	// written once through staging copies or by device only, not host visible
+	Static,
+	// written by host directly every frame, mapped, device local when BAR allows it
+	Dynamic,
+	// written by host, source of copies, mapped
+	Staging,
+	// written by device and read by host, mapped, has to be invalidated before reads
+	Readback,
+};
+
 struct AllocatedBuffer {
 	VmaAllocation allocation;
 	vk::Buffer buffer;
 	vk::DeviceSize size;
 
-	static AllocatedBuffer create(VmaAllocator allocator, vk::BufferUsageFlags usage,
-			vk::DeviceSize size, VmaAllocationInfo *pAllocInfo) {
+	// device local memory type which is host visible, in heap larger than MAX_BAR_HEAP_SIZE
+	// when isResizable
+	static bool hasBarMemory(VmaAllocator allocator, bool isResizable) {
+		const VkPhysicalDeviceMemoryProperties *pProperties;
+		vmaGetMemoryProperties(allocator, &pProperties);
+
+		VkMemoryPropertyFlags barFlags =
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+		for (uint32_t i = 0; i < pProperties->memoryTypeCount; i++) {
+			const VkMemoryType &type = pProperties->memoryTypes[i];
+
+			if ((type.propertyFlags & barFlags) != barFlags)
+				continue;
+
+			if (!isResizable || pProperties->memoryHeaps[type.heapIndex].size > MAX_BAR_HEAP_SIZE)
+				return true;
+		}
+
+		return false;
+	}
+
+	// tracked under category, has to be untracked before it is destroyed, pAllocInfo has mapped
+	// pointer of every class but static, buffer is shared concurrently by two or more
+	// sharedQueueFamilies and exclusive otherwise
+	static AllocatedBuffer create(VmaAllocator allocator, MemoryCategory category,
+			BufferClass bufferClass, vk::BufferUsageFlags usage, vk::DeviceSize size,
+			VmaAllocationInfo *pAllocInfo = nullptr,
+			const std::vector<uint32_t> &sharedQueueFamilies = {}) {
 		VkBufferCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		createInfo.size = size;
 		createInfo.usage = static_cast<VkBufferUsageFlags>(usage);
 
+		if (sharedQueueFamilies.size() > 1) {
+			createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			createInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+			createInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+		}
+
 		VmaAllocationCreateInfo allocCreateInfo{};
-		allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
-		allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-								VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		switch (bufferClass) {
+			case BufferClass::Static:
+				allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+				break;
+			case BufferClass::Dynamic:
+				// falls back to host memory once BAR heap is out of budget
+				allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+				allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+						VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+				if (hasBarMemory(allocator, size > SMALL_DYNAMIC_BUFFER_SIZE))
+					allocCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+				break;
+			case BufferClass::Staging:
+				allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+				allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+						VMA_ALLOCATION_CREATE_MAPPED_BIT;
+				break;
+			case BufferClass::Readback:
+				allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+				allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+						VMA_ALLOCATION_CREATE_MAPPED_BIT;
+				break;
+		}
 
 		VkBuffer buffer;
 		VmaAllocation allocation;
@@ -33,6 +111,8 @@ struct AllocatedBuffer {
 					allocator, &createInfo, &allocCreateInfo, &buffer, &allocation, pAllocInfo);
 		}
 
+		MemoryTracker::track(allocator, allocation, category);
+
 		return { allocation, buffer, size };
 	}
 
@@ -45,15 +125,17 @@ struct AllocatedImage {
 	VmaAllocation allocation;
 	vk::Image image;
 
-	static AllocatedImage create(VmaAllocator allocator, uint32_t width, uint32_t height,
-			uint32_t mipLevels, uint32_t arrayLayers, vk::Format format, vk::ImageUsageFlags usage,
-			vk::ImageCreateFlags flags = {}) {
+	static AllocatedImage create(VmaAllocator allocator, MemoryCategory category, uint32_t width,
+			uint32_t height, uint32_t mipLevels, uint32_t arrayLayers, vk::Format format,
+			vk::ImageUsageFlags usage, vk::ImageCreateFlags flags = {},
+			VmaPool pool = VK_NULL_HANDLE, uint32_t depth = 1) {
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		// volumes have a single array layer
+		imageInfo.imageType = depth > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
 		imageInfo.extent.width = width;
 		imageInfo.extent.height = height;
-		imageInfo.extent.depth = 1;
+		imageInfo.extent.depth = depth;
 		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = arrayLayers;
 		imageInfo.format = static_cast<VkFormat>(format);
@@ -64,15 +146,39 @@ struct AllocatedImage {
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.flags = static_cast<VkImageCreateFlags>(flags);
 
+		// sampled images share memory blocks, one allocation per image runs into
+		// maxMemoryAllocationCount with many small textures, render targets stay dedicated
+		vk::ImageUsageFlags targetUsage = vk::ImageUsageFlagBits::eColorAttachment |
+				vk::ImageUsageFlagBits::eDepthStencilAttachment;
+
 		VmaAllocationCreateInfo allocCreateInfo = {};
 		allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
-		allocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
 		allocCreateInfo.priority = 1.0f;
 
+		if (usage & targetUsage)
+			allocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
 		VmaAllocation allocation;
 		VkImage image;
+
+		// image whose memory type pool does not have goes to default pools
+		if (pool != VK_NULL_HANDLE) {
+			VmaAllocationCreateInfo poolCreateInfo = allocCreateInfo;
+			poolCreateInfo.pool = pool;
+
+			VkResult err = vmaCreateImage(
+					allocator, &imageInfo, &poolCreateInfo, &image, &allocation, nullptr);
+
+			if (err == VK_SUCCESS) {
+				MemoryTracker::track(allocator, allocation, category);
+				return { allocation, image };
+			}
+		}
+
 		vmaCreateImage(allocator, &imageInfo, &allocCreateInfo, &image, &allocation, nullptr);
 
+		MemoryTracker::track(allocator, allocation, category);
+
 		return { allocation, image };
 	}
 };
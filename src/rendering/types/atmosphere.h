@@ -0,0 +1,32 @@
+#ifndef ATMOSPHERE_H
+#define ATMOSPHERE_H
+
+#include <glm/glm.hpp>
+
+// Planet and its atmosphere the procedural sky is scattered through, distances in kilometers and
+// coefficients per kilometer. Defaults are Earth's. Sun direction points towards the sun in
+// world space, illuminance scales luminance like exposure of a baked sky would.
+struct Atmosphere {
+	glm::vec3 rayleighScattering = glm::vec3(5.802e-3f, 13.558e-3f, 33.1e-3f);
+	float rayleighScaleHeight = 8.0f;
+
+	glm::vec3 mieScattering = glm::vec3(3.996e-3f);
+	float mieScaleHeight = 1.2f;
+	glm::vec3 mieAbsorption = glm::vec3(4.4e-3f);
+	// of Henyey-Greenstein phase, towards 1 for a brighter halo around sun
+	float mieAnisotropy = 0.8f;
+
+	// tent shaped layer around 25 kilometers
+	glm::vec3 ozoneAbsorption = glm::vec3(0.65e-3f, 1.881e-3f, 0.085e-3f);
+
+	float bottomRadius = 6360.0f;
+	float topRadius = 6460.0f;
+	glm::vec3 groundAlbedo = glm::vec3(0.3f);
+
+	glm::vec3 sunDirection = glm::normalize(glm::vec3(0.0f, 0.5f, -1.0f));
+	glm::vec3 sunIlluminance = glm::vec3(20.0f);
+	// of viewer above ground, sky is seen from a single point
+	float viewHeight = 0.2f;
+};
+
+#endif // !ATMOSPHERE_H
@@ -2,62 +2,66 @@
 #define ATTACHMENT_H
 
 #include <cstdint>
+#include <stdexcept>
+
+#include <vma/vk_mem_alloc.h>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_handles.hpp>
 
+#include <rendering/memory_tracker.h>
+
 class Attachment {
 private:
 	vk::Image _image = {};
 	vk::ImageView _imageView = {};
-	vk::DeviceMemory _imageMemory = {};
+	VmaAllocation _allocation = {};
 	vk::Format _format = vk::Format::eUndefined;
 
-	static uint32_t _findMemoryType(uint32_t typeFilter,
-			vk::PhysicalDeviceMemoryProperties memProperties, vk::MemoryPropertyFlags properties) {
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) &&
-					(memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
-		}
-
-		throw std::runtime_error("Could not find suitable memory type!");
-	}
-
-	static vk::Image _createImage(vk::Device device, uint32_t width, uint32_t height,
+	// render targets are large and live as long as swapchain, they get memory of their own
+	static vk::Image _createImage(VmaAllocator allocator, uint32_t width, uint32_t height,
 			uint32_t arrayLayers, vk::Format format, vk::ImageUsageFlags usage,
-			vk::PhysicalDeviceMemoryProperties memProperties, vk::DeviceMemory *pMemory,
-			vk::ImageCreateFlags flags = {}) {
-		vk::ImageCreateInfo createInfo = {};
-		createInfo.setImageType(vk::ImageType::e2D);
-		createInfo.setExtent(vk::Extent3D(width, height, 1));
-		createInfo.setMipLevels(1);
-		createInfo.setArrayLayers(arrayLayers);
-		createInfo.setFormat(format);
-		createInfo.setTiling(vk::ImageTiling::eOptimal);
-		createInfo.setInitialLayout(vk::ImageLayout::eUndefined);
-		createInfo.setUsage(usage);
-		createInfo.setSamples(vk::SampleCountFlagBits::e1);
-		createInfo.setSharingMode(vk::SharingMode::eExclusive);
-		createInfo.setFlags(flags);
-
-		vk::Image image = device.createImage(createInfo);
-
-		vk::MemoryRequirements memRequirements = device.getImageMemoryRequirements(image);
-
-		uint32_t memoryTypeIndex = _findMemoryType(memRequirements.memoryTypeBits, memProperties,
-				vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-		vk::MemoryAllocateInfo allocInfo = {};
-		allocInfo.setAllocationSize(memRequirements.size);
-		allocInfo.setMemoryTypeIndex(memoryTypeIndex);
-
-		vk::Result err = device.allocateMemory(&allocInfo, nullptr, pMemory);
+			VmaAllocation *pAllocation, vk::ImageCreateFlags flags = {}) {
+		VkImageCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		createInfo.imageType = VK_IMAGE_TYPE_2D;
+		createInfo.extent.width = width;
+		createInfo.extent.height = height;
+		createInfo.extent.depth = 1;
+		createInfo.mipLevels = 1;
+		createInfo.arrayLayers = arrayLayers;
+		createInfo.format = static_cast<VkFormat>(format);
+		createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		createInfo.usage = static_cast<VkImageUsageFlags>(usage);
+		createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		createInfo.flags = static_cast<VkImageCreateFlags>(flags);
+
+		bool isTransient = (bool)(usage & vk::ImageUsageFlagBits::eTransientAttachment);
+
+		// transient ones never leave tile memory on tiled GPUs, which may then never back them
+		VmaAllocationCreateInfo allocCreateInfo = {};
+		allocCreateInfo.usage = isTransient ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED
+											: VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+		allocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+		allocCreateInfo.priority = 1.0f;
+
+		VkImage image;
+		VkResult err = vmaCreateImage(
+				allocator, &createInfo, &allocCreateInfo, &image, pAllocation, nullptr);
+
+		// desktop GPUs usually have no lazily allocated memory type
+		if (err == VK_ERROR_FEATURE_NOT_PRESENT && isTransient) {
+			allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+			err = vmaCreateImage(
+					allocator, &createInfo, &allocCreateInfo, &image, pAllocation, nullptr);
+		}
 
-		if (err != vk::Result::eSuccess)
+		if (err != VK_SUCCESS)
 			throw std::runtime_error("Attachment image memory allocation failed!");
 
-		device.bindImageMemory(image, *pMemory, 0);
+		MemoryTracker::track(allocator, *pAllocation, MemoryCategory::RenderTarget);
+
 		return image;
 	}
 
@@ -80,22 +84,22 @@ private:
 	}
 
 public:
-	static Attachment create(vk::Device device, uint32_t width, uint32_t height, vk::Format format,
-			vk::ImageUsageFlags usage, vk::ImageAspectFlagBits aspectFlags,
-			vk::PhysicalDeviceMemoryProperties memProperties, uint32_t arrayLayers = 1,
+	static Attachment create(VmaAllocator allocator, vk::Device device, uint32_t width,
+			uint32_t height, vk::Format format, vk::ImageUsageFlags usage,
+			vk::ImageAspectFlagBits aspectFlags, uint32_t arrayLayers = 1,
 			vk::ImageViewType viewType = vk::ImageViewType::e2D, vk::ImageCreateFlags flags = {}) {
-		vk::DeviceMemory memory;
+		VmaAllocation allocation;
 		vk::Image image = _createImage(
-				device, width, height, arrayLayers, format, usage, memProperties, &memory, flags);
+				allocator, width, height, arrayLayers, format, usage, &allocation, flags);
 		vk::ImageView view = _createView(device, image, viewType, format, aspectFlags, arrayLayers);
 
-		return Attachment(image, view, memory, format);
+		return Attachment(image, view, allocation, format);
 	}
 
-	void destroy(vk::Device device) {
+	void destroy(VmaAllocator allocator, vk::Device device) {
 		device.destroyImageView(_imageView, nullptr);
-		device.destroyImage(_image, nullptr);
-		device.freeMemory(_imageMemory, nullptr);
+		MemoryTracker::untrack(_allocation);
+		vmaDestroyImage(allocator, _image, _allocation);
 	}
 
 	vk::Image getImage() const {
@@ -112,10 +116,10 @@ public:
 
 	Attachment() {}
 
-	Attachment(vk::Image image, vk::ImageView view, vk::DeviceMemory memory, vk::Format format) {
+	Attachment(vk::Image image, vk::ImageView view, VmaAllocation allocation, vk::Format format) {
 		_image = image;
 		_imageView = view;
-		_imageMemory = memory;
+		_allocation = allocation;
 		_format = format;
 	}
 };
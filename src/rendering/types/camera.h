@@ -36,10 +36,14 @@ struct Camera {
 		return glm::lookAtRH(position, position + front, CAMERA_UP);
 	}
 
-	glm::mat4 projectionMatrix(float aspect) const {
+	// jitter offsets whole image in normalized device coordinates, for temporal upscaling
+	glm::mat4 projectionMatrix(float aspect, glm::vec2 jitter = glm::vec2(0.0f)) const {
 		glm::mat4 projection = glm::perspectiveRH(fovY, aspect, zNear, zFar);
 		projection = REVERSE_Z_MATRIX * OPENGL_TO_VULKAN_MATRIX * projection;
 
+		if (jitter != glm::vec2(0.0f))
+			projection = glm::translate(glm::mat4(1.0f), glm::vec3(jitter, 0.0f)) * projection;
+
 		return projection;
 	};
 };
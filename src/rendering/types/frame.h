@@ -0,0 +1,15 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstdint>
+
+// frames recorded while previous ones are still executing, chosen at start up, per frame
+// resources are sized for most of them and only those in flight are created
+const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+// cameras drawn into regions of one frame, for split-screen and side by side stereo, has to
+// match shaders/include/cluster_incl.glsl
+const uint32_t MAX_VIEW_COUNT = 4;
+
+#endif // !FRAME_H
@@ -0,0 +1,102 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+#if defined(__APPLE__)
+#include <TargetConditionals.h>
+#endif
+
+// largest side of images assets load with, handhelds keep less memory and bandwidth for them,
+// 0 for no limit
+#if defined(__ANDROID__) || (defined(TARGET_OS_IOS) && TARGET_OS_IOS)
+const uint32_t DEFAULT_MAX_TEXTURE_SIZE = 2048;
+#else
+const uint32_t DEFAULT_MAX_TEXTURE_SIZE = 0;
+#endif
+
+enum class QualityPreset {
+	Low,
+	Medium,
+	High,
+	Ultra,
+};
+
+// Settings trading image quality for GPU time and memory, set as a whole. Render scale, light
+// budget and biases apply from next frame, cubemap and specular sizes bake current sky again,
+// shadow atlas size renders every tile again. Max texture size applies to assets loaded after
+// it is set, see AssetLoader::setMaxImageSize. Attachment formats are fixed once window is
+// created, render passes and every pipeline are built for them.
+typedef struct {
+	float renderScale;
+
+	// largest face of sky cubemap and faces of specular level 0
+	uint32_t maxCubemapSize;
+	uint32_t specularSize;
+
+	vk::Format colorFormat;
+	vk::Format depthFormat;
+
+	// least important point lights in view beyond it are not shaded, 0 for no limit
+	uint32_t pointLightBudget;
+	uint32_t shadowAtlasSize;
+
+	// in levels, positive ones pick coarser mesh levels of detail and texture mips sooner
+	float lodBias;
+	float mipBias;
+
+	// larger images are resampled on import, 0 for no limit
+	uint32_t maxTextureSize;
+} QualitySettings;
+
+// high matches defaults of every setting
+inline QualitySettings getQualitySettings(QualityPreset preset) {
+	QualitySettings settings = {};
+	settings.renderScale = 1.0f;
+	settings.maxCubemapSize = 2048;
+	settings.specularSize = 128;
+	settings.colorFormat = vk::Format::eB10G11R11UfloatPack32;
+	settings.depthFormat = vk::Format::eD32Sfloat;
+	settings.pointLightBudget = 0;
+	settings.shadowAtlasSize = 2048;
+	settings.lodBias = 0.0f;
+	settings.mipBias = 0.0f;
+	settings.maxTextureSize = DEFAULT_MAX_TEXTURE_SIZE;
+
+	switch (preset) {
+		case QualityPreset::Low:
+			settings.renderScale = 0.5f;
+			settings.maxCubemapSize = 512;
+			settings.specularSize = 32;
+			settings.depthFormat = vk::Format::eX8D24UnormPack32;
+			settings.pointLightBudget = 16;
+			settings.shadowAtlasSize = 1024;
+			settings.lodBias = 1.0f;
+			settings.mipBias = 1.0f;
+			settings.maxTextureSize = 1024;
+			break;
+		case QualityPreset::Medium:
+			settings.renderScale = 0.75f;
+			settings.maxCubemapSize = 1024;
+			settings.specularSize = 64;
+			settings.pointLightBudget = 64;
+			settings.lodBias = 0.5f;
+			settings.mipBias = 0.5f;
+			settings.maxTextureSize = 2048;
+			break;
+		case QualityPreset::High:
+			break;
+		case QualityPreset::Ultra:
+			settings.specularSize = 256;
+			settings.colorFormat = vk::Format::eR16G16B16A16Sfloat;
+			settings.shadowAtlasSize = 4096;
+			settings.lodBias = -0.5f;
+			break;
+	}
+
+	return settings;
+}
+
+#endif // !QUALITY_H
@@ -1,38 +1,262 @@
 #ifndef RESOURCE_H
 #define RESOURCE_H
 
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <vector>
+
 #include <glm/glm.hpp>
 
+#include <io/mesh.h>
+#include <io/mesh_bvh.h>
+#include <rendering/culling/aabb_tree.h>
+#include <rendering/culling/occlusion_rasterizer.h>
+#include <rendering/storage/geometry_arena.h>
+
+#include "aabb.h"
 #include "allocated.h"
 
 typedef uint64_t ObjectID;
 
+class Image;
+
+// level of detail is coarsest one whose error stays below this many pixels on screen
+const float LOD_PIXEL_ERROR = 1.0f;
+
+// level changes once its error passes threshold by this factor, keeps it from popping back and
+// forth around threshold
+const float LOD_HYSTERESIS = 1.25f;
+
+struct LodRD {
+	uint32_t indexCount;
+	uint32_t firstIndex; // into geometry arena
+};
+
 struct PrimitiveRD {
 	uint32_t indexCount;
-	uint32_t firstIndex;
+	uint32_t firstIndex; // into geometry arena
 	ObjectID material;
+
+	// mesh space bounds, first index into geometry arena like primitive
+	std::vector<Meshlet> meshlets;
+
+	// levels after full detail one, primitive with fewer levels than mesh draws its last one
+	std::vector<LodRD> lods;
 };
 
 struct MeshRD {
-	AllocatedBuffer vertexBuffer;
-	AllocatedBuffer indexBuffer;
-	std::vector<PrimitiveRD> primitives;
+	GeometryRange geometry;
+	// range of primitive table of RS, none while evicted
+	uint32_t firstPrimitive = 0;
+	uint32_t primitiveCount = 0;
+	AABB aabb;
+
+	// vertex positions are quantized into aabb, see PackedVertex
+	glm::mat4 dequantize = glm::mat4(1.0f);
+
+	// mesh space error of every level after full detail one, largest one of its primitives
+	std::vector<float> lodErrors;
+
+	// triangles of full detail level for ray casts, mesh space, bind pose of skinned mesh and
+	// base shape of morphed one
+	std::shared_ptr<const MeshBVH> bvh;
+
+	// joints and weights of vertices in skin storage, INVALID_OFFSET for mesh without skin
+	uint32_t skinOffset = RangeAllocator::INVALID_OFFSET;
+
+	// drawn primitive of every primitive mesh was created with, empty while they are the same,
+	// see RS::_mergePrimitives
+	std::vector<uint32_t> primitiveRemap;
+
+	// headers and deltas of moved vertices in morph storage, INVALID_OFFSET for mesh without
+	// morph targets, see PackedMorph
+	uint32_t morphOffset = RangeAllocator::INVALID_OFFSET;
+	uint32_t morphSize = 0;
+	uint32_t morphMovedCount = 0;
+
+	// --impostors, quads drawn for far instances once mesh was captured, 0 until then
+	ObjectID impostor = 0;
+
+	// --occlusion-culling, mesh space triangles drawn into occlusion depth, null for meshes
+	// too detailed or skinned
+	std::shared_ptr<const OccluderMesh> occluder;
+
+	// coarsest level with error below threshold, scale is pixels per mesh space unit at
+	// instance, current level is kept while it is within hysteresis
+	uint32_t selectLod(uint32_t current, float scale) const {
+		uint32_t lodCount = static_cast<uint32_t>(lodErrors.size());
+		uint32_t lod = current < lodCount ? current : lodCount;
+
+		while (lod > 0 && lodErrors[lod - 1] * scale > LOD_PIXEL_ERROR * LOD_HYSTERESIS)
+			lod--;
+
+		while (lod < lodCount && lodErrors[lod] * scale <= LOD_PIXEL_ERROR / LOD_HYSTERESIS)
+			lod++;
+
+		return lod;
+	}
 };
 
+// affine transform as its three rows, what instance buffers hold, 48 bytes instead of 64 of
+// mat4, shaders multiply vec4 position by it from the left
+typedef glm::mat3x4 InstanceTransform;
+
+inline InstanceTransform packInstanceTransform(const glm::mat4 &transform) {
+	return InstanceTransform(glm::transpose(transform));
+}
+
+// inverse transpose of basis up to scale, normals stay perpendicular under non-uniform scale,
+// cofactors stay finite for flattened instances, shaders normalize what they get
+inline InstanceTransform packNormalTransform(const glm::mat4 &transform) {
+	glm::vec3 a(transform[0]);
+	glm::vec3 b(transform[1]);
+	glm::vec3 c(transform[2]);
+
+	glm::mat3 cofactor(glm::cross(b, c), glm::cross(c, a), glm::cross(a, b));
+
+	// mirrored basis would turn normals inside out
+	if (glm::dot(a, cofactor[0]) < 0.0f)
+		cofactor = -cofactor;
+
+	return InstanceTransform(glm::transpose(glm::mat4(cofactor)));
+}
+
 struct MeshInstanceRD {
-	glm::mat4 transform;
-	ObjectID mesh;
+	glm::mat4 transform = glm::mat4(1.0f);
+	ObjectID mesh = 0;
+
+	// world space bounds, updated when transform or mesh changes
+	AABB aabb;
+	// leaf in instance tree of server, AABB_TREE_NULL while instance has no mesh
+	uint32_t proxy = AABB_TREE_NULL;
+
+	// transform times dequantize of mesh, written to instance buffers
+	InstanceTransform drawTransform = InstanceTransform(1.0f);
+	// of transform, see packNormalTransform, written along with draw transform
+	InstanceTransform normalTransform = InstanceTransform(1.0f);
+	// transform times dequantize of impostor of mesh, while mesh has one
+	InstanceTransform impostorTransform = InstanceTransform(1.0f);
+	// beyond impostor distance last frame by CPU culling, mesh has impostor
+	bool isImpostor = false;
+
+	// level of detail drawn last frame by CPU culling
+	uint32_t lod = 0;
+	// frame culling last found instance in a view in, ranks uploads it asks for
+	uint64_t visibleFrame = 0;
+	// of portal culler containing bounds, PORTAL_NO_CELL when there is none
+	uint32_t cell = UINT32_MAX;
+
+	// vertices of skinned mesh posed for this instance alone, drawn from once posed
+	GeometryRange pose;
+	bool isPosed = false;
+	// space of instance, posed again by next frame once they change
+	std::vector<glm::mat4> joints;
+	bool isPoseDirty = false;
+
+	// vertices of morphed mesh shaped by weights of this instance alone, drawn from once
+	// morphed and skinned in place of bind pose
+	GeometryRange morph;
+	bool isMorphed = false;
+	// one per target, morphed again by next frame once they change
+	std::vector<float> morphWeights;
+	bool isMorphDirty = false;
+};
+
+// Bits of material pipeline permutation, each one keeps fetch or loop it stands for compiled in.
+// Map and tangent bits come from material, point light bit from scene.
+const uint32_t MATERIAL_ALBEDO_MAP_BIT = 1 << 0;
+const uint32_t MATERIAL_NORMAL_MAP_BIT = 1 << 1;
+const uint32_t MATERIAL_METALLIC_ROUGHNESS_MAP_BIT = 1 << 2;
+const uint32_t MATERIAL_POINT_LIGHTS_BIT = 1 << 3;
+// tangent frame of normal map is derived per pixel, only with normal map
+const uint32_t MATERIAL_DERIVED_TANGENTS_BIT = 1 << 4;
+// pixels with albedo alpha below cutoff are discarded, only with albedo map and without normal
+// map, drawn without depth prepass since it writes depth of whole triangles
+const uint32_t MATERIAL_ALPHA_TEST_BIT = 1 << 5;
+
+const uint32_t MATERIAL_PERMUTATION_BIT_COUNT = 6;
+const uint32_t MATERIAL_PERMUTATION_COUNT = 1 << MATERIAL_PERMUTATION_BIT_COUNT;
+
+// albedo, normal, metallic roughness and lightmap, bindings of material texture set
+const uint32_t MATERIAL_TEXTURE_COUNT = 4;
+// of material pipeline layout
+const uint32_t MATERIAL_TEXTURE_SET = 3;
+
+// descriptors of material textures, shared by materials sampling the same ones, which is
+// common once textures are packed into atlases
+struct TextureSetRD {
+	// null with push descriptors, image infos are pushed instead
+	vk::DescriptorSet set;
+	// set is freed back to it
+	vk::DescriptorPool pool;
+
+	std::array<vk::DescriptorImageInfo, MATERIAL_TEXTURE_COUNT> imageInfos = {};
+
+	// textures it was written with, fallbacks are 0
+	std::array<ObjectID, MATERIAL_TEXTURE_COUNT> textures = {};
+
+	// set is freed once last one is destroyed
+	uint32_t materialCount = 0;
 };
 
 struct MaterialRD {
-	vk::DescriptorSet textureSet;
+	// 0 in bindless mode
+	ObjectID textureSetId = 0;
+
+	// slot in material buffer
+	uint32_t index = 0;
+
+	// textures it samples, material is recreated when streaming swaps one of them
+	ObjectID albedo = 0;
+	ObjectID normal = 0;
+	ObjectID metallicRoughness = 0;
+	ObjectID lightmap = 0;
+
+	// kept for recreation, see RS::MaterialInfo
+	glm::vec4 albedoFactor = glm::vec4(1.0f);
+	glm::vec3 emissiveFactor = glm::vec3(0.0f);
+	float metallicFactor = 1.0f;
+	float roughnessFactor = 1.0f;
+	glm::vec4 albedoRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	glm::vec4 normalRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	glm::vec4 metallicRoughnessRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	bool alphaTest = false;
+
+	// map bits of textures that are not fallbacks
+	uint32_t permutation = 0;
 };
 
 struct TextureRD {
 	AllocatedImage image;
 	vk::ImageView imageView;
+	// shared, owned by sampler cache of RD
 	vk::Sampler sampler;
+
+	// image properties, defragmentation recreates image with them
+	vk::Format format = vk::Format::eUndefined;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mipLevels = 0;
+	vk::ImageUsageFlags usage;
+
+	// slot in bindless texture array
+	uint32_t bindlessIndex = 0;
+
+	// streamed texture keeps its levels on CPU, only ones from residentLevel to last are in
+	// image, null for texture uploaded whole
+	std::shared_ptr<Image> source;
+	uint32_t residentLevel = 0;
+
+	// finest level asked for by visible instances, reset once request is old
+	uint32_t requestedLevel = 0;
+	uint64_t requestFrame = 0;
+	// highest of instances asking for it in request frame, see UploadScheduler::getPriority
+	float requestPriority = 0.0f;
+
+	// --lazy-textures, no image until an instance using texture is visible, source is kept and
+	// materials sample fallback until then
+	bool isPending = false;
 };
 
 #endif // !RESOURCE_H
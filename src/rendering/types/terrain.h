@@ -0,0 +1,28 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// clip levels around camera at most, each one covers twice the extent of the one inside it
+const uint32_t MAX_TERRAIN_LEVEL_COUNT = 8;
+// channels of splat map, one albedo layer each
+const uint32_t MAX_TERRAIN_LAYER_COUNT = 4;
+// layer images are squares of this size
+const uint32_t TERRAIN_LAYER_SIZE = 512;
+
+// Heightmap placed in world space, first sample at origin, columns of image go along x and rows
+// along z. First channel from 0 to 1 is raised by height scale above origin. Splat map covers
+// the same area, its channels weigh albedo layers which repeat every layer scale.
+struct Terrain {
+	glm::vec3 origin = glm::vec3(0.0f);
+	// between neighbouring samples of heightmap, grid of finest level has it
+	float sampleSpacing = 1.0f;
+	float heightScale = 100.0f;
+	float layerScale = 8.0f;
+	// level L has 2^L times spacing of first one, levels reaching past heightmap repeat its edge
+	uint32_t levelCount = 6;
+};
+
+#endif // !TERRAIN_H
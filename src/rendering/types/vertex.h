@@ -1,60 +1,354 @@
 #ifndef VERTEX_H
 #define VERTEX_H
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
 #define GLM_FORCE_RADIANS
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <glm/gtx/hash.hpp>
 
 #include <vulkan/vulkan.hpp>
 
+// produced by asset loading, packed when mesh is created
 struct Vertex {
 	glm::vec3 position;
 	glm::vec3 normal;
 	glm::vec3 tangent;
 	glm::vec2 uv;
+	// unique across lightmap of scene, zero until unwrapped by LightmapBaker or loaded
+	glm::vec2 lightmapUV;
 
-	static vk::VertexInputBindingDescription getBindingDescription() {
-		vk::VertexInputBindingDescription bindingDescription;
-		bindingDescription.setBinding(0);
-		bindingDescription.setStride(sizeof(Vertex));
-		bindingDescription.setInputRate(vk::VertexInputRate::eVertex);
+	// into joints of skin of instance, zero weights for vertex of mesh without skin
+	glm::u16vec4 joints;
+	glm::vec4 weights;
 
-		return bindingDescription;
+	bool operator==(const Vertex &v) const {
+		return position == v.position && normal == v.normal && tangent == v.tangent &&
+				uv == v.uv && lightmapUV == v.lightmapUV && joints == v.joints &&
+				weights == v.weights;
 	}
+};
 
-	static std::array<vk::VertexInputAttributeDescription, 4> getAttributeDescriptions() {
-		std::array<vk::VertexInputAttributeDescription, 4> attributeDescriptions;
+// position stream, the only one read by depth and shadow passes
+struct PackedPosition {
+	// snorm, w is 1
+	int16_t position[4];
+};
+static_assert(sizeof(PackedPosition) == 8, "PackedPosition is not 8 bytes");
+
+// rest of vertex, read by material passes only
+struct PackedAttributes {
+	// octahedral snorm, decoded in shaders/include/vertex_incl.glsl
+	int16_t normal[2];
+	int16_t tangent[2];
 
-		// Position
-		attributeDescriptions[0].setLocation(0);
-		attributeDescriptions[0].setBinding(0);
-		attributeDescriptions[0].setFormat(vk::Format::eR32G32B32Sfloat);
-		attributeDescriptions[0].setOffset(offsetof(Vertex, position));
+	// half float
+	uint16_t uv[2];
+	uint16_t lightmapUV[2];
+};
+static_assert(sizeof(PackedAttributes) == 16, "PackedAttributes is not 16 bytes");
 
-		// Normal
-		attributeDescriptions[1].setLocation(1);
-		attributeDescriptions[1].setBinding(0);
-		attributeDescriptions[1].setFormat(vk::Format::eR32G32B32Sfloat);
-		attributeDescriptions[1].setOffset(offsetof(Vertex, normal));
+// read by skin shader only, never bound as vertex stream
+struct PackedSkin {
+	uint16_t joints[4];
+	// unorm, sum to one
+	uint16_t weights[4];
 
-		// Tangent
-		attributeDescriptions[2].setLocation(2);
-		attributeDescriptions[2].setBinding(0);
-		attributeDescriptions[2].setFormat(vk::Format::eR32G32B32Sfloat);
-		attributeDescriptions[2].setOffset(offsetof(Vertex, tangent));
+	// weights are normalized, vertex without any follows first joint of its list
+	static PackedSkin pack(const Vertex &v) {
+		float sum = v.weights.x + v.weights.y + v.weights.z + v.weights.w;
+		glm::vec4 weights = sum > 0.0f ? v.weights / sum : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
 
-		// TexCoord
-		attributeDescriptions[3].setLocation(3);
-		attributeDescriptions[3].setBinding(0);
-		attributeDescriptions[3].setFormat(vk::Format::eR32G32Sfloat);
-		attributeDescriptions[3].setOffset(offsetof(Vertex, uv));
+		PackedSkin packed;
 
-		return attributeDescriptions;
+		for (uint32_t i = 0; i < 4; i++) {
+			packed.joints[i] = v.joints[i];
+			packed.weights[i] = glm::packUnorm1x16(weights[i]);
+		}
+
+		return packed;
 	}
+};
+static_assert(sizeof(PackedSkin) == 16, "PackedSkin is not 16 bytes");
 
-	bool operator==(const Vertex &v) const {
-		return position == v.position && normal == v.normal && tangent == v.tangent && uv == v.uv;
+// read by morph shader only, one per vertex some target moves, its deltas follow headers of mesh
+struct PackedMorphVertex {
+	// relative to mesh
+	uint32_t vertex;
+	// relative to first header of mesh, deltas of vertex are ordered by target
+	uint32_t firstDelta;
+	uint32_t deltaCount;
+	uint32_t padding;
+};
+static_assert(sizeof(PackedMorphVertex) == 16, "PackedMorphVertex is not 16 bytes");
+
+struct PackedMorphDelta {
+	// snorm, half of offset in quantized space of mesh, which spans 2
+	int16_t position[3];
+	uint16_t target;
+	// snorm, half of offset of unit normal
+	int16_t normal[3];
+	uint16_t padding;
+
+	static PackedMorphDelta pack(const glm::vec3 &position, const glm::vec3 &normal,
+			uint32_t target, float scale) {
+		glm::vec3 p = glm::clamp(position / (scale * 2.0f), -1.0f, 1.0f);
+		glm::vec3 n = glm::clamp(normal * 0.5f, -1.0f, 1.0f);
+
+		PackedMorphDelta packed;
+
+		for (uint32_t i = 0; i < 3; i++) {
+			packed.position[i] = static_cast<int16_t>(glm::packSnorm1x16(p[i]));
+			packed.normal[i] = static_cast<int16_t>(glm::packSnorm1x16(n[i]));
+		}
+
+		packed.target = static_cast<uint16_t>(target);
+		packed.padding = 0;
+
+		return packed;
+	}
+};
+static_assert(sizeof(PackedMorphDelta) == 16, "PackedMorphDelta is not 16 bytes");
+
+// element of morph storage, headers and deltas of a mesh share one range
+union PackedMorph {
+	PackedMorphVertex vertex;
+	PackedMorphDelta delta;
+};
+static_assert(sizeof(PackedMorph) == 16, "PackedMorph is not 16 bytes");
+
+static glm::vec2 encodeOctahedral(const glm::vec3 &v) {
+	float length = glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z);
+
+	if (length == 0.0f)
+		return glm::vec2(0.0f);
+
+	glm::vec3 n = v / length;
+
+	if (n.z >= 0.0f)
+		return glm::vec2(n.x, n.y);
+
+	// lower hemisphere is folded over diagonals
+	glm::vec2 sign(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x))) * sign;
+}
+
+// Attributes of vertex layouts, each names stream and shader location it goes to, its packed
+// format and how it is encoded from Vertex. Stream 0 holds positions, read by every pass.
+struct PositionAttribute {
+	static constexpr uint32_t BINDING = 0;
+	static constexpr uint32_t LOCATION = 0;
+	static constexpr uint32_t SIZE = sizeof(int16_t) * 4;
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16B16A16Snorm;
+
+	static void pack(const Vertex &v, const glm::vec3 &center, float scale, uint8_t *pDst) {
+		glm::vec3 position = glm::clamp((v.position - center) / scale, -1.0f, 1.0f);
+		int16_t packed[4] = {
+			static_cast<int16_t>(glm::packSnorm1x16(position.x)),
+			static_cast<int16_t>(glm::packSnorm1x16(position.y)),
+			static_cast<int16_t>(glm::packSnorm1x16(position.z)),
+			static_cast<int16_t>(glm::packSnorm1x16(1.0f)),
+		};
+
+		memcpy(pDst, packed, SIZE);
+	}
+};
+
+struct NormalAttribute {
+	static constexpr uint32_t BINDING = 1;
+	static constexpr uint32_t LOCATION = 1;
+	static constexpr uint32_t SIZE = sizeof(int16_t) * 2;
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16Snorm;
+
+	static void pack(const Vertex &v, const glm::vec3 &, float, uint8_t *pDst) {
+		glm::vec2 normal = encodeOctahedral(v.normal);
+		int16_t packed[2] = {
+			static_cast<int16_t>(glm::packSnorm1x16(normal.x)),
+			static_cast<int16_t>(glm::packSnorm1x16(normal.y)),
+		};
+
+		memcpy(pDst, packed, SIZE);
+	}
+};
+
+// zero for meshes without normal maps, shaders pick any tangent then
+struct TangentAttribute {
+	static constexpr uint32_t BINDING = 1;
+	static constexpr uint32_t LOCATION = 2;
+	static constexpr uint32_t SIZE = sizeof(int16_t) * 2;
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16Snorm;
+
+	static void pack(const Vertex &v, const glm::vec3 &, float, uint8_t *pDst) {
+		glm::vec2 tangent = encodeOctahedral(v.tangent);
+		int16_t packed[2] = {
+			static_cast<int16_t>(glm::packSnorm1x16(tangent.x)),
+			static_cast<int16_t>(glm::packSnorm1x16(tangent.y)),
+		};
+
+		memcpy(pDst, packed, SIZE);
+	}
+};
+
+struct UVAttribute {
+	static constexpr uint32_t BINDING = 1;
+	static constexpr uint32_t LOCATION = 3;
+	static constexpr uint32_t SIZE = sizeof(uint16_t) * 2;
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16Sfloat;
+
+	static void pack(const Vertex &v, const glm::vec3 &, float, uint8_t *pDst) {
+		uint16_t packed[2] = { glm::packHalf1x16(v.uv.x), glm::packHalf1x16(v.uv.y) };
+		memcpy(pDst, packed, SIZE);
+	}
+};
+
+struct LightmapUVAttribute {
+	static constexpr uint32_t BINDING = 1;
+	static constexpr uint32_t LOCATION = 4;
+	static constexpr uint32_t SIZE = sizeof(uint16_t) * 2;
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16Sfloat;
+
+	static void pack(const Vertex &v, const glm::vec3 &, float, uint8_t *pDst) {
+		uint16_t packed[2] = {
+			glm::packHalf1x16(v.lightmapUV.x),
+			glm::packHalf1x16(v.lightmapUV.y),
+		};
+
+		memcpy(pDst, packed, SIZE);
+	}
+};
+
+// Vertex input of a pipeline, built at compile time from attributes it fetches. Attributes of one
+// binding follow each other in order of layout, so layout holding a subset of attributes reads
+// the same streams as long as it keeps their order. Pipelines take the smallest layout covering
+// attributes their shaders use, depth and shadow passes then never touch the attribute stream.
+template <typename... Attributes> class VertexLayout {
+public:
+	static constexpr uint32_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+	static constexpr uint32_t BINDING_COUNT = std::max({ Attributes::BINDING... }) + 1;
+
+private:
+	static constexpr std::array<uint32_t, ATTRIBUTE_COUNT> _computeOffsets() {
+		const uint32_t bindings[] = { Attributes::BINDING... };
+		const uint32_t sizes[] = { Attributes::SIZE... };
+
+		std::array<uint32_t, ATTRIBUTE_COUNT> offsets = {};
+		std::array<uint32_t, BINDING_COUNT> ends = {};
+
+		for (uint32_t i = 0; i < ATTRIBUTE_COUNT; i++) {
+			offsets[i] = ends[bindings[i]];
+			ends[bindings[i]] += sizes[i];
+		}
+
+		return offsets;
+	}
+
+public:
+	static constexpr uint32_t getStride(uint32_t binding) {
+		return ((Attributes::BINDING == binding ? Attributes::SIZE : 0) + ...);
+	}
+
+	static std::array<vk::VertexInputBindingDescription, BINDING_COUNT> getBindingDescriptions() {
+		std::array<vk::VertexInputBindingDescription, BINDING_COUNT> descriptions;
+
+		for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+			descriptions[i].setBinding(i);
+			descriptions[i].setStride(getStride(i));
+			descriptions[i].setInputRate(vk::VertexInputRate::eVertex);
+		}
+
+		return descriptions;
+	}
+
+	static std::array<vk::VertexInputAttributeDescription, ATTRIBUTE_COUNT>
+	getAttributeDescriptions() {
+		const uint32_t locations[] = { Attributes::LOCATION... };
+		const uint32_t bindings[] = { Attributes::BINDING... };
+		const vk::Format formats[] = { Attributes::FORMAT... };
+		constexpr std::array<uint32_t, ATTRIBUTE_COUNT> offsets = _computeOffsets();
+
+		std::array<vk::VertexInputAttributeDescription, ATTRIBUTE_COUNT> descriptions;
+
+		for (uint32_t i = 0; i < ATTRIBUTE_COUNT; i++) {
+			descriptions[i].setLocation(locations[i]);
+			descriptions[i].setBinding(bindings[i]);
+			descriptions[i].setFormat(formats[i]);
+			descriptions[i].setOffset(offsets[i]);
+		}
+
+		return descriptions;
+	}
+
+	// points into arrays built once, safe to hand to pipeline builds on other threads
+	static vk::PipelineVertexInputStateCreateInfo getInputState() {
+		static const std::array<vk::VertexInputBindingDescription, BINDING_COUNT> bindings =
+				getBindingDescriptions();
+		static const std::array<vk::VertexInputAttributeDescription, ATTRIBUTE_COUNT> attributes =
+				getAttributeDescriptions();
+
+		vk::PipelineVertexInputStateCreateInfo inputState;
+		inputState.setVertexBindingDescriptions(bindings);
+		inputState.setVertexAttributeDescriptions(attributes);
+
+		return inputState;
+	}
+
+	// one destination per binding, each at its vertex
+	static void pack(const Vertex &v, const glm::vec3 &center, float scale,
+			uint8_t *const *ppStreams) {
+		constexpr std::array<uint32_t, ATTRIBUTE_COUNT> offsets = _computeOffsets();
+		uint32_t i = 0;
+
+		(Attributes::pack(v, center, scale, ppStreams[Attributes::BINDING] + offsets[i++]), ...);
+	}
+};
+
+// depth prepass and shadows
+typedef VertexLayout<PositionAttribute> PositionLayout;
+
+// impostor captures, normal and tangent are fetched but not read, uv comes after them
+typedef VertexLayout<PositionAttribute, NormalAttribute, TangentAttribute, UVAttribute> UVLayout;
+
+// material passes, forward and g-buffer
+typedef VertexLayout<PositionAttribute, NormalAttribute, TangentAttribute, UVAttribute,
+		LightmapUVAttribute>
+		MaterialLayout;
+
+static_assert(MaterialLayout::getStride(0) == sizeof(PackedPosition),
+		"MaterialLayout does not match PackedPosition");
+static_assert(MaterialLayout::getStride(1) == sizeof(PackedAttributes),
+		"MaterialLayout does not match PackedAttributes");
+
+// Layout of vertex buffers, 24 bytes instead of 52 of Vertex, split into position and attribute
+// streams as MaterialLayout packs them. Position is quantized into bounds of its mesh, transform
+// written per instance scales it back. Bounds are scaled uniformly, so the same transform still
+// rotates normals and tangents correctly once normalized.
+struct PackedVertex {
+	PackedPosition position;
+	PackedAttributes attributes;
+
+	// folded into instance transform, maps [-1, 1] back to mesh space
+	static glm::mat4 getDequantizeTransform(const glm::vec3 &center, float scale) {
+		glm::mat4 transform(scale);
+		transform[3] = glm::vec4(center, 1.0f);
+
+		return transform;
+	}
+
+	static PackedVertex pack(const Vertex &v, const glm::vec3 &center, float scale) {
+		PackedVertex packed;
+		uint8_t *pStreams[2] = {
+			reinterpret_cast<uint8_t *>(&packed.position),
+			reinterpret_cast<uint8_t *>(&packed.attributes),
+		};
+
+		MaterialLayout::pack(v, center, scale, pStreams);
+		return packed;
 	}
 };
 
@@ -64,7 +358,8 @@ template <> struct hash<Vertex> {
 		return ((hash<glm::vec3>()(v.position) ^ (hash<glm::vec3>()(v.normal) << 1) ^
 						(hash<glm::vec3>()(v.tangent) << 1)) >>
 					   1) ^
-			   (hash<glm::vec2>()(v.uv) << 1);
+			   (hash<glm::vec2>()(v.uv) << 1) ^ (hash<glm::vec2>()(v.lightmapUV) << 2) ^
+			   (hash<glm::vec4>()(v.weights) << 3);
 	}
 };
 } // namespace std
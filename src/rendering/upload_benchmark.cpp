@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include <io/image.h>
+
+#include "rendering_device.h"
+#include "upload_manager.h"
+
+#include "upload_benchmark.h"
+
+static uint64_t _getSubmitCount() {
+	RD &rd = RD::getSingleton();
+	return rd.getSingleTimeSubmitCount() + rd.getUploadManager().getSubmittedBatchCount();
+}
+
+static double _toMilliseconds(uint64_t ticks) {
+	double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	return static_cast<double>(ticks) * 1000.0 / frequency;
+}
+
+// nearest rank, sorted
+static float _getPercentile(const std::vector<float> &values, float percentile) {
+	size_t index = static_cast<size_t>(percentile * static_cast<float>(values.size() - 1) + 0.5f);
+	return values[std::min(index, values.size() - 1)];
+}
+
+// any content uploads alike, texels only have to differ so nothing is special cased
+static std::vector<uint8_t> _getPattern(uint64_t size) {
+	std::vector<uint8_t> data(size);
+
+	for (uint64_t i = 0; i < size; i++)
+		data[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+
+	return data;
+}
+
+static void _writeString(SDL_IOStream *pStream, const std::string &string) {
+	SDL_IOprintf(pStream, "\"");
+
+	for (char c : string) {
+		if (c == '"' || c == '\\')
+			SDL_IOprintf(pStream, "\\%c", c);
+		else if (static_cast<unsigned char>(c) >= 0x20)
+			SDL_IOprintf(pStream, "%c", c);
+	}
+
+	SDL_IOprintf(pStream, "\"");
+}
+
+UploadBenchmarkCase UploadBenchmark::_measure(const std::string &name, uint64_t size,
+		uint32_t count, const std::function<void(uint32_t)> &upload,
+		const std::function<void()> &finish) {
+	for (uint32_t i = 0; i < UPLOAD_BENCHMARK_WARMUP; i++)
+		upload(count + i);
+
+	finish();
+
+	std::vector<float> latencies(count);
+	uint64_t submitCount = _getSubmitCount();
+	uint64_t start = SDL_GetPerformanceCounter();
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t begin = SDL_GetPerformanceCounter();
+		upload(i);
+		latencies[i] = static_cast<float>(_toMilliseconds(SDL_GetPerformanceCounter() - begin));
+	}
+
+	finish();
+
+	double milliseconds = _toMilliseconds(SDL_GetPerformanceCounter() - start);
+	std::sort(latencies.begin(), latencies.end());
+
+	UploadBenchmarkCase result = {};
+	result.name = name;
+	result.size = size;
+	result.count = count;
+	result.milliseconds = milliseconds;
+	result.megabytesPerSecond = milliseconds > 0.0
+			? static_cast<double>(size) * count / 1e6 / (milliseconds / 1000.0)
+			: 0.0;
+	result.latencyMedian = count > 0 ? _getPercentile(latencies, 0.5f) : 0.0f;
+	result.latencyP95 = count > 0 ? _getPercentile(latencies, 0.95f) : 0.0f;
+	result.latencyMax = count > 0 ? latencies.back() : 0.0f;
+	result.submitCount = _getSubmitCount() - submitCount;
+
+	return result;
+}
+
+UploadBenchmarkCase UploadBenchmark::_bufferBlocking(uint64_t size, uint32_t count) {
+	RD &rd = RD::getSingleton();
+	std::vector<uint8_t> data = _getPattern(size);
+
+	AllocatedBuffer buffer = rd.bufferCreate(MemoryCategory::Other, BufferClass::Static,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, size);
+
+	// staging buffer of its own per call, copy waits for queue to idle
+	auto upload = [&](uint32_t) {
+		VmaAllocationInfo stagingAllocInfo;
+		AllocatedBuffer stagingBuffer = rd.bufferCreate(MemoryCategory::Staging,
+				BufferClass::Staging, vk::BufferUsageFlagBits::eTransferSrc, size,
+				&stagingAllocInfo);
+
+		memcpy(stagingAllocInfo.pMappedData, data.data(), size);
+		rd.bufferFlush(stagingBuffer);
+
+		rd.bufferCopy(stagingBuffer.buffer, buffer.buffer, size);
+		rd.bufferDestroy(stagingBuffer);
+	};
+
+	UploadBenchmarkCase result = _measure("buffer blocking", size, count, upload, [] {});
+	rd.bufferDestroy(buffer);
+
+	return result;
+}
+
+UploadBenchmarkCase UploadBenchmark::_bufferRing(uint64_t size, uint32_t count) {
+	RD &rd = RD::getSingleton();
+	std::vector<uint8_t> data = _getPattern(size);
+
+	AllocatedBuffer buffer = rd.bufferCreate(MemoryCategory::Other, BufferClass::Static,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, size);
+
+	auto upload = [&](uint32_t) { rd.bufferSend(buffer.buffer, data.data(), size); };
+	auto finish = [&] { rd.getUploadManager().wait(); };
+
+	UploadBenchmarkCase result = _measure("buffer ring", size, count, upload, finish);
+	rd.bufferDestroy(buffer);
+
+	return result;
+}
+
+UploadBenchmarkCase UploadBenchmark::_textureBlocking(uint32_t side, uint32_t count) {
+	RD &rd = RD::getSingleton();
+
+	const vk::Format FORMAT = vk::Format::eR8G8B8A8Unorm;
+	uint64_t size = Image::getLevelSize(Image::Format::RGBA8, side, side);
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(side))) + 1;
+	std::vector<uint8_t> data = _getPattern(size);
+
+	std::vector<AllocatedImage> images(count + UPLOAD_BENCHMARK_WARMUP);
+
+	// transition, copy and blits submit and wait one after another
+	auto upload = [&](uint32_t i) {
+		images[i] = rd.imageCreate(MemoryCategory::Texture, side, side, FORMAT, mipLevels,
+				vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst |
+						vk::ImageUsageFlagBits::eSampled);
+
+		rd.imageLayoutTransition(images[i].image, FORMAT, mipLevels, 1,
+				vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+		rd.imageSend(images[i].image, side, side, data.data(), size,
+				vk::ImageLayout::eTransferDstOptimal);
+		rd.imageGenerateMipmaps(images[i].image, side, side, FORMAT, mipLevels);
+	};
+
+	UploadBenchmarkCase result = _measure("texture blocking", size, count, upload, [] {});
+
+	for (const AllocatedImage &image : images)
+		rd.imageDestroy(image);
+
+	return result;
+}
+
+UploadBenchmarkCase UploadBenchmark::_textureRing(uint32_t side, uint32_t count) {
+	RD &rd = RD::getSingleton();
+
+	uint64_t size = Image::getLevelSize(Image::Format::RGBA8, side, side);
+	std::shared_ptr<Image> image =
+			std::make_shared<Image>(side, side, Image::Format::RGBA8, _getPattern(size));
+
+	std::vector<TextureRD> textures(count + UPLOAD_BENCHMARK_WARMUP);
+
+	auto upload = [&](uint32_t i) { textures[i] = rd.textureCreate(image); };
+	auto finish = [&] { rd.getUploadManager().wait(); };
+
+	UploadBenchmarkCase result = _measure("texture ring", size, count, upload, finish);
+
+	for (const TextureRD &texture : textures)
+		rd.textureDestroy(texture);
+
+	return result;
+}
+
+std::vector<UploadBenchmarkCase> UploadBenchmark::run(const UploadBenchmarkSettings &settings) {
+	std::vector<UploadBenchmarkCase> cases;
+
+	// uploads of loading are not counted
+	RD::getSingleton().getUploadManager().wait();
+
+	for (uint64_t size : settings.bufferSizes) {
+		cases.push_back(_bufferBlocking(size, settings.count));
+		cases.push_back(_bufferRing(size, settings.count));
+	}
+
+	for (uint32_t side : settings.textureSizes) {
+		cases.push_back(_textureBlocking(side, settings.textureCount));
+		cases.push_back(_textureRing(side, settings.textureCount));
+	}
+
+	return cases;
+}
+
+void UploadBenchmark::log(const std::vector<UploadBenchmarkCase> &cases) {
+	for (const UploadBenchmarkCase &_case : cases) {
+		SDL_Log("%s of %llu bytes: %.1f MB/s, %.3f ms median, %.3f ms p95, %.3f ms max, %llu "
+				"submits for %u uploads",
+				_case.name.c_str(), static_cast<unsigned long long>(_case.size),
+				_case.megabytesPerSecond, _case.latencyMedian, _case.latencyP95, _case.latencyMax,
+				static_cast<unsigned long long>(_case.submitCount), _case.count);
+	}
+}
+
+bool UploadBenchmark::write(const char *pFile, const std::vector<UploadBenchmarkCase> &cases) {
+	SDL_IOStream *pStream = SDL_IOFromFile(pFile, "w");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Upload benchmark result %s can not be written!",
+				pFile);
+		return false;
+	}
+
+	RD &rd = RD::getSingleton();
+	vk::PhysicalDeviceProperties properties = rd.getPhysicalDevice().getProperties();
+
+	SDL_IOprintf(pStream, "{\n\t\"device\": ");
+	_writeString(pStream, properties.deviceName.data());
+	SDL_IOprintf(pStream, ",\n");
+	SDL_IOprintf(pStream, "\t\"transferQueue\": %s,\n",
+			rd.getUploadManager().isTransferDedicated() ? "true" : "false");
+	SDL_IOprintf(pStream, "\t\"cases\": [");
+
+	for (size_t i = 0; i < cases.size(); i++) {
+		const UploadBenchmarkCase &_case = cases[i];
+
+		SDL_IOprintf(pStream, "%s\n\t\t{ \"name\": ", i == 0 ? "" : ",");
+		_writeString(pStream, _case.name);
+		SDL_IOprintf(pStream,
+				", \"size\": %llu, \"count\": %u, \"milliseconds\": %.3f, "
+				"\"megabytesPerSecond\": %.1f, \"latencyMedian\": %.4f, \"latencyP95\": %.4f, "
+				"\"latencyMax\": %.4f, \"submits\": %llu }",
+				static_cast<unsigned long long>(_case.size), _case.count, _case.milliseconds,
+				_case.megabytesPerSecond, _case.latencyMedian, _case.latencyP95,
+				_case.latencyMax, static_cast<unsigned long long>(_case.submitCount));
+	}
+
+	SDL_IOprintf(pStream, "\n\t]\n}\n");
+
+	return SDL_CloseIO(pStream);
+}
@@ -0,0 +1,68 @@
+#ifndef UPLOAD_BENCHMARK_H
+#define UPLOAD_BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// untimed uploads run first in every case, pipelines and staging settle meanwhile
+const uint32_t UPLOAD_BENCHMARK_WARMUP = 2;
+
+struct UploadBenchmarkSettings {
+	// bytes of one buffer upload, one case per path and size
+	std::vector<uint64_t> bufferSizes = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+	// sides of square RGBA8 textures with one level, the rest is generated on device
+	std::vector<uint32_t> textureSizes = { 256, 1024, 2048 };
+	// timed uploads of every case, textures live until case ends and take fewer
+	uint32_t count = 64;
+	uint32_t textureCount = 16;
+};
+
+struct UploadBenchmarkCase {
+	// path and what it uploads
+	std::string name;
+	// of one upload, first level only for textures
+	uint64_t size;
+	uint32_t count;
+
+	// from first call until device finished last upload
+	double milliseconds;
+	double megabytesPerSecond;
+
+	// of single calls, device work is only part of them for blocking paths
+	float latencyMedian;
+	float latencyP95;
+	float latencyMax;
+
+	// blocking submits and batches of upload manager
+	uint64_t submitCount;
+};
+
+// Measures CPU to GPU paths of RenderingDevice one at a time on an otherwise idle device, so
+// every change to uploads can be quantified on every GPU. Blocking staging copies through
+// endSingleTimeCommands are kept as baseline, bufferCopy for buffers and imageSend followed by
+// imageGenerateMipmaps for textures, next to bufferSend and textureCreate going through staging
+// ring and transfer queue of UploadManager. Throughput counts bytes of calls over time until
+// device finished them, latency is that of each call alone.
+class UploadBenchmark {
+private:
+	// upload gets index of call, finish waits for device, both are timed
+	static UploadBenchmarkCase _measure(const std::string &name, uint64_t size, uint32_t count,
+			const std::function<void(uint32_t)> &upload, const std::function<void()> &finish);
+
+	static UploadBenchmarkCase _bufferBlocking(uint64_t size, uint32_t count);
+	static UploadBenchmarkCase _bufferRing(uint64_t size, uint32_t count);
+	static UploadBenchmarkCase _textureBlocking(uint32_t side, uint32_t count);
+	static UploadBenchmarkCase _textureRing(uint32_t side, uint32_t count);
+
+public:
+	// render thread only, nothing may be drawn meanwhile
+	static std::vector<UploadBenchmarkCase> run(const UploadBenchmarkSettings &settings);
+
+	static void log(const std::vector<UploadBenchmarkCase> &cases);
+	// JSON, device and whether it has a transfer queue of its own come first
+	static bool write(const char *pFile, const std::vector<UploadBenchmarkCase> &cases);
+};
+
+#endif // !UPLOAD_BENCHMARK_H
@@ -0,0 +1,625 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL3/SDL_log.h>
+
+#include "memory_tracker.h"
+#include "rendering_device.h"
+#include "vulkan_context.h"
+
+#include "upload_manager.h"
+
+UploadManager::Recorder &UploadManager::_getRecorder() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// node based, reference stays valid while other threads add theirs
+	auto it = _recorders.find(std::this_thread::get_id());
+
+	if (it != _recorders.end())
+		return it->second;
+
+	Recorder &recorder = _recorders[std::this_thread::get_id()];
+
+	vk::CommandPoolCreateInfo createInfo = {};
+	createInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+	createInfo.setQueueFamilyIndex(_graphicsQueueFamily);
+
+	recorder.graphicsPool = _device.createCommandPool(createInfo);
+
+	if (_isTransferDedicated) {
+		createInfo.setQueueFamilyIndex(_transferQueueFamily);
+		recorder.transferPool = _device.createCommandPool(createInfo);
+	}
+
+	return recorder;
+}
+
+void UploadManager::_begin(Recorder &recorder) {
+	if (recorder.isRecording)
+		return;
+
+	std::vector<vk::CommandBuffer> finishedGraphicsCommands;
+	std::vector<vk::CommandBuffer> finishedTransferCommands;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_collect();
+
+		finishedGraphicsCommands.swap(recorder.finishedGraphicsCommands);
+		finishedTransferCommands.swap(recorder.finishedTransferCommands);
+
+		recorder.batch = {};
+		recorder.batch.pRecorder = &recorder;
+
+		// timelines of queues stand in for both
+		if (!_useTimelines && _isTransferDedicated && _freeSemaphores.empty()) {
+			recorder.batch.semaphore = _device.createSemaphore({});
+		} else if (!_useTimelines && _isTransferDedicated) {
+			recorder.batch.semaphore = _freeSemaphores.back();
+			_freeSemaphores.pop_back();
+		}
+
+		if (!_useTimelines && _freeFences.empty()) {
+			recorder.batch.fence = _device.createFence({});
+		} else if (!_useTimelines) {
+			recorder.batch.fence = _freeFences.back();
+			_freeFences.pop_back();
+		}
+	}
+
+	// pools are externally synchronized, so only their thread frees into them
+	if (!finishedGraphicsCommands.empty())
+		_device.freeCommandBuffers(recorder.graphicsPool, finishedGraphicsCommands);
+
+	if (!finishedTransferCommands.empty())
+		_device.freeCommandBuffers(recorder.transferPool, finishedTransferCommands);
+
+	vk::CommandBufferAllocateInfo allocInfo = {};
+	allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+	allocInfo.setCommandBufferCount(1);
+
+	vk::CommandBufferBeginInfo beginInfo = { vk::CommandBufferUsageFlagBits::eOneTimeSubmit };
+
+	allocInfo.setCommandPool(recorder.graphicsPool);
+	recorder.batch.graphicsCommands = _device.allocateCommandBuffers(allocInfo)[0];
+	recorder.batch.graphicsCommands.begin(beginInfo);
+
+	if (_isTransferDedicated) {
+		allocInfo.setCommandPool(recorder.transferPool);
+		recorder.batch.transferCommands = _device.allocateCommandBuffers(allocInfo)[0];
+		recorder.batch.transferCommands.begin(beginInfo);
+	}
+
+	recorder.isRecording = true;
+}
+
+void UploadManager::_generateMipmaps(Recorder &recorder) {
+	if (recorder.batch.mipTargets.empty())
+		return;
+
+	std::vector<vk::ImageMemoryBarrier> barriers(recorder.batch.mipTargets.size());
+
+	for (size_t i = 0; i < barriers.size(); i++) {
+		const MipGenerator::Target &target = recorder.batch.mipTargets[i];
+
+		vk::ImageSubresourceRange subresourceRange;
+		subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		subresourceRange.setBaseMipLevel(0);
+		subresourceRange.setLevelCount(target.levelCount + 1);
+		subresourceRange.setBaseArrayLayer(0);
+		subresourceRange.setLayerCount(target.arrayLayers);
+
+		barriers[i].setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barriers[i].setNewLayout(vk::ImageLayout::eGeneral);
+		barriers[i].setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barriers[i].setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barriers[i].setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barriers[i].setDstAccessMask(
+				vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+		barriers[i].setImage(target.image);
+		barriers[i].setSubresourceRange(subresourceRange);
+	}
+
+	recorder.batch.graphicsCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, barriers);
+
+	RD::getSingleton().getMipGenerator().record(
+			recorder.batch.graphicsCommands, recorder.batch.mipTargets);
+
+	for (vk::ImageMemoryBarrier &barrier : barriers) {
+		barrier.setOldLayout(vk::ImageLayout::eGeneral);
+		barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+	}
+
+	recorder.batch.graphicsCommands.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barriers);
+}
+
+UploadManager::Staging UploadManager::_stage(
+		Recorder &recorder, const uint8_t *pData, size_t size) {
+	vk::DeviceSize alignedSize = (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+	if (alignedSize > STAGING_RING_SIZE) {
+		VmaAllocationInfo stagingAllocInfo;
+		AllocatedBuffer stagingBuffer = AllocatedBuffer::create(_allocator, MemoryCategory::Staging,
+				BufferClass::Staging, vk::BufferUsageFlagBits::eTransferSrc, size,
+				&stagingAllocInfo);
+
+		memcpy(stagingAllocInfo.pMappedData, pData, size);
+		vmaFlushAllocation(_allocator, stagingBuffer.allocation, 0, VK_WHOLE_SIZE);
+
+		_begin(recorder);
+		recorder.batch.stagingBuffers.push_back(stagingBuffer);
+		recorder.batchSize += size;
+		_uploadedBytes += size;
+
+		return { stagingBuffer.buffer, 0 };
+	}
+
+	uint64_t offset;
+	uint64_t allocation;
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		while (true) {
+			// idle ring starts over, so allocation fits without skipping
+			if (_ringAllocations.empty()) {
+				_ringHead = 0;
+				_ringTail = 0;
+			}
+
+			// allocation does not wrap, rest of ring is skipped instead
+			offset = _ringHead % STAGING_RING_SIZE;
+			uint64_t skip =
+					offset + alignedSize > STAGING_RING_SIZE ? STAGING_RING_SIZE - offset : 0;
+
+			if (_ringHead + skip + alignedSize - _ringTail <= STAGING_RING_SIZE) {
+				_ringHead += skip;
+				break;
+			}
+
+			// ring is taken by recorded or held back batches, they have to be submitted first
+			if (_pendingBatches.empty()) {
+				bool isDeferred = !_deferredBatches.empty();
+				lock.unlock();
+
+				if (isDeferred) {
+					std::lock_guard<std::mutex> queueLock(RD::getSingleton().getQueueMutex());
+					_submitDeferred();
+				} else if (recorder.isRecording) {
+					_flush(recorder);
+				} else {
+					std::this_thread::yield();
+				}
+
+				lock.lock();
+				continue;
+			}
+
+			_wait(_pendingBatches.front());
+			_collect();
+		}
+
+		offset = _ringHead % STAGING_RING_SIZE;
+		_ringHead += alignedSize;
+
+		allocation = _firstRingAllocation + _ringAllocations.size();
+		_ringAllocations.push_back({ _ringHead, false });
+	}
+
+	uint8_t *pRing = reinterpret_cast<uint8_t *>(_stagingRingAllocInfo.pMappedData);
+	memcpy(pRing + offset, pData, size);
+	vmaFlushAllocation(_allocator, _stagingRing.allocation, offset, size);
+
+	_begin(recorder);
+	recorder.batch.ringAllocations.push_back(allocation);
+	recorder.batchSize += size;
+	_uploadedBytes += size;
+
+	return { _stagingRing.buffer, offset };
+}
+
+void UploadManager::bufferUpload(
+		vk::Buffer dstBuffer, const uint8_t *pData, size_t size, vk::DeviceSize dstOffset) {
+	Recorder &recorder = _getRecorder();
+	Staging staging = _stage(recorder, pData, size);
+
+	vk::BufferCopy bufferCopy;
+	bufferCopy.setSrcOffset(staging.offset);
+	bufferCopy.setDstOffset(dstOffset);
+	bufferCopy.setSize(size);
+
+	recorder.batch.graphicsCommands.copyBuffer(staging.buffer, dstBuffer, bufferCopy);
+
+	if (recorder.batchSize >= MAX_UPLOAD_BATCH_SIZE)
+		_flush(recorder);
+}
+
+void UploadManager::imageUpload(vk::Image image, uint32_t width, uint32_t height,
+		vk::Format format, uint32_t mipLevels, const uint8_t *pData, size_t size,
+		const std::vector<vk::DeviceSize> &levelOffsets) {
+	Recorder &recorder = _getRecorder();
+	Staging staging = _stage(recorder, pData, size);
+
+	vk::CommandBuffer copyCommands =
+			_isTransferDedicated ? recorder.batch.transferCommands : recorder.batch.graphicsCommands;
+
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(0);
+	subresourceRange.setLevelCount(mipLevels);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(1);
+
+	vk::ImageMemoryBarrier barrier;
+	barrier.setOldLayout(vk::ImageLayout::eUndefined);
+	barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setImage(image);
+	barrier.setSubresourceRange(subresourceRange);
+
+	copyCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+	std::vector<vk::BufferImageCopy> regions(levelOffsets.size());
+
+	for (uint32_t level = 0; level < regions.size(); level++) {
+		vk::ImageSubresourceLayers imageSubresource;
+		imageSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+		imageSubresource.setMipLevel(level);
+		imageSubresource.setBaseArrayLayer(0);
+		imageSubresource.setLayerCount(1);
+
+		uint32_t levelWidth = std::max(width >> level, 1u);
+		uint32_t levelHeight = std::max(height >> level, 1u);
+
+		vk::BufferImageCopy &region = regions[level];
+		region.setBufferOffset(staging.offset + levelOffsets[level]);
+		region.setBufferRowLength(0);
+		region.setBufferImageHeight(0);
+		region.setImageSubresource(imageSubresource);
+		region.setImageOffset(vk::Offset3D{ 0, 0, 0 });
+		region.setImageExtent(vk::Extent3D{ levelWidth, levelHeight, 1 });
+	}
+
+	copyCommands.copyBufferToImage(
+			staging.buffer, image, vk::ImageLayout::eTransferDstOptimal, regions);
+
+	if (_isTransferDedicated) {
+		// release on transfer queue, acquire on graphics queue
+		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setSrcQueueFamilyIndex(_transferQueueFamily);
+		barrier.setDstQueueFamilyIndex(_graphicsQueueFamily);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eNone);
+
+		recorder.batch.transferCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, nullptr, barrier);
+
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
+		barrier.setDstAccessMask(
+				vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite);
+
+		recorder.batch.graphicsCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+	}
+
+	MipGenerator &mipGenerator = RD::getSingleton().getMipGenerator();
+
+	if (levelOffsets.size() < mipLevels && mipGenerator.isSupported(format, width, height)) {
+		// first level is all it has, whole batch is generated at once by flush
+		recorder.batch.mipTargets.push_back(
+				mipGenerator.targetCreate(image, format, width, height, mipLevels));
+	} else if (levelOffsets.size() < mipLevels) {
+		// transfers image layout to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		RD::getSingleton().imageGenerateMipmaps(recorder.batch.graphicsCommands, image,
+				static_cast<int32_t>(width), static_cast<int32_t>(height), format, mipLevels);
+	} else {
+		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+		recorder.batch.graphicsCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, barrier);
+	}
+
+	if (recorder.batchSize >= MAX_UPLOAD_BATCH_SIZE)
+		_flush(recorder);
+}
+
+void UploadManager::_end(Recorder &recorder) {
+	_generateMipmaps(recorder);
+
+	// buffer copies have to be visible to any later use
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eMemoryRead);
+
+	recorder.batch.graphicsCommands.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eAllCommands, {}, barrier, nullptr, nullptr);
+
+	recorder.batch.graphicsCommands.end();
+
+	if (_isTransferDedicated)
+		recorder.batch.transferCommands.end();
+
+	recorder.batchSize = 0;
+	recorder.isRecording = false;
+}
+
+void UploadManager::_flush(Recorder &recorder) {
+	if (!recorder.isRecording)
+		return;
+
+	_end(recorder);
+
+	std::vector<Batch> batches = { recorder.batch };
+
+	std::lock_guard<std::mutex> queueLock(RD::getSingleton().getQueueMutex());
+	_submit(batches);
+}
+
+void UploadManager::_submit(
+		std::vector<Batch> &batches, const vk::SubmitInfo *pFrameInfo, vk::Fence frameFence) {
+	size_t count = batches.size();
+
+	// submit infos point into these until queues took them
+	std::vector<vk::SubmitInfo> transferInfos(count);
+	std::vector<vk::SubmitInfo> graphicsInfos(count);
+	std::vector<vk::TimelineSemaphoreSubmitInfoKHR> transferTimelineInfos(count);
+	std::vector<vk::TimelineSemaphoreSubmitInfoKHR> graphicsTimelineInfos(count);
+
+	vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eTransfer;
+
+	for (size_t i = 0; i < count; i++) {
+		Batch &batch = batches[i];
+		graphicsInfos[i].setCommandBuffers(batch.graphicsCommands);
+
+		if (_useTimelines) {
+			batch.value = ++_timelineValue;
+
+			graphicsInfos[i].setSignalSemaphores(_graphicsTimeline);
+			graphicsTimelineInfos[i].setSignalSemaphoreValues(batch.value);
+			graphicsInfos[i].setPNext(&graphicsTimelineInfos[i]);
+		}
+
+		if (!_isTransferDedicated)
+			continue;
+
+		const vk::Semaphore &semaphore = _useTimelines ? _transferTimeline : batch.semaphore;
+
+		transferInfos[i].setCommandBuffers(batch.transferCommands);
+		transferInfos[i].setSignalSemaphores(semaphore);
+
+		graphicsInfos[i].setWaitSemaphores(semaphore);
+		graphicsInfos[i].setWaitDstStageMask(waitStage);
+
+		if (_useTimelines) {
+			transferTimelineInfos[i].setSignalSemaphoreValues(batch.value);
+			transferInfos[i].setPNext(&transferTimelineInfos[i]);
+
+			// graphics counter reaching value then means transfer of batch finished too
+			graphicsTimelineInfos[i].setWaitSemaphoreValues(batch.value);
+		}
+	}
+
+	if (_useTimelines) {
+		if (_isTransferDedicated && count > 0)
+			_transferQueue.submit(transferInfos, VK_NULL_HANDLE);
+
+		if (pFrameInfo != nullptr)
+			graphicsInfos.push_back(*pFrameInfo);
+
+		if (!graphicsInfos.empty())
+			_graphicsQueue.submit(graphicsInfos, frameFence);
+	} else {
+		// every batch is finished by fence of its own
+		for (size_t i = 0; i < count; i++) {
+			if (_isTransferDedicated)
+				_transferQueue.submit(transferInfos[i], VK_NULL_HANDLE);
+
+			_graphicsQueue.submit(graphicsInfos[i], batches[i].fence);
+		}
+
+		if (pFrameInfo != nullptr)
+			_graphicsQueue.submit(*pFrameInfo, frameFence);
+	}
+
+	_submittedBatchCount += count;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pendingBatches.insert(_pendingBatches.end(), batches.begin(), batches.end());
+}
+
+void UploadManager::_submitDeferred() {
+	std::vector<Batch> batches;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		batches.swap(_deferredBatches);
+	}
+
+	if (!batches.empty())
+		_submit(batches);
+}
+
+void UploadManager::_wait(const Batch &batch) {
+	bool isFinished = _useTimelines
+			? _pContext->waitSemaphore(_graphicsTimeline, batch.value, UINT64_MAX)
+			: _device.waitForFences(batch.fence, VK_TRUE, UINT64_MAX) == vk::Result::eSuccess;
+
+	if (!isFinished)
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Waiting for upload failed!");
+}
+
+void UploadManager::_collect() {
+	uint32_t finishedCount = 0;
+
+	// one read covers every batch, values rise in submission order
+	uint64_t finishedValue =
+			_useTimelines ? _pContext->getSemaphoreCounterValue(_graphicsTimeline) : 0;
+
+	// submission order is kept, later batches wait for earlier ones to be released
+	for (Batch &batch : _pendingBatches) {
+		bool isFinished = _useTimelines
+				? batch.value <= finishedValue
+				: _device.getFenceStatus(batch.fence) == vk::Result::eSuccess;
+
+		if (!isFinished)
+			break;
+
+		finishedCount++;
+
+		for (uint64_t allocation : batch.ringAllocations)
+			_ringAllocations[allocation - _firstRingAllocation].isReleased = true;
+
+		for (AllocatedBuffer &stagingBuffer : batch.stagingBuffers) {
+			MemoryTracker::untrack(stagingBuffer.allocation);
+			vmaDestroyBuffer(_allocator, stagingBuffer.buffer, stagingBuffer.allocation);
+		}
+
+		for (const MipGenerator::Target &target : batch.mipTargets)
+			RD::getSingleton().getMipGenerator().targetDestroy(target);
+
+		Recorder &recorder = *batch.pRecorder;
+		recorder.finishedGraphicsCommands.push_back(batch.graphicsCommands);
+
+		if (_isTransferDedicated)
+			recorder.finishedTransferCommands.push_back(batch.transferCommands);
+
+		if (_useTimelines)
+			continue;
+
+		if (_isTransferDedicated)
+			_freeSemaphores.push_back(batch.semaphore);
+
+		_device.resetFences(batch.fence);
+		_freeFences.push_back(batch.fence);
+	}
+
+	_pendingBatches.erase(_pendingBatches.begin(), _pendingBatches.begin() + finishedCount);
+
+	// ring is reclaimed up to first allocation still in use
+	while (!_ringAllocations.empty() && _ringAllocations.front().isReleased) {
+		_ringTail = _ringAllocations.front().end;
+		_ringAllocations.pop_front();
+		_firstRingAllocation++;
+	}
+}
+
+void UploadManager::flush() {
+	_flush(_getRecorder());
+}
+
+void UploadManager::flushDeferred() {
+	// fence of every batch would need a submit of its own anyway
+	if (!_useTimelines) {
+		flush();
+		return;
+	}
+
+	Recorder &recorder = _getRecorder();
+
+	if (!recorder.isRecording)
+		return;
+
+	_end(recorder);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_deferredBatches.push_back(recorder.batch);
+}
+
+void UploadManager::submitFrame(const vk::SubmitInfo &submitInfo, vk::Fence fence) {
+	std::vector<Batch> batches;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		batches.swap(_deferredBatches);
+	}
+
+	_submit(batches, &submitInfo, fence);
+}
+
+void UploadManager::wait() {
+	flush();
+
+	{
+		std::lock_guard<std::mutex> queueLock(RD::getSingleton().getQueueMutex());
+		_submitDeferred();
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// last one covers every batch before it
+	if (_useTimelines && !_pendingBatches.empty()) {
+		_wait(_pendingBatches.back());
+	} else {
+		for (const Batch &batch : _pendingBatches)
+			_wait(batch);
+	}
+
+	_collect();
+}
+
+void UploadManager::collect() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_collect();
+}
+
+uint64_t UploadManager::getUploadedBytes() const {
+	return _uploadedBytes;
+}
+
+uint64_t UploadManager::getSubmittedBatchCount() const {
+	return _submittedBatchCount;
+}
+
+bool UploadManager::isTransferDedicated() const {
+	return _isTransferDedicated;
+}
+
+void UploadManager::initialize(const VulkanContext *pContext, VmaAllocator allocator) {
+	if (_initialized)
+		return;
+
+	_pContext = pContext;
+	_device = pContext->getDevice();
+	_allocator = allocator;
+
+	_graphicsQueue = pContext->getGraphicsQueue();
+	_transferQueue = pContext->getTransferQueue();
+
+	_graphicsQueueFamily = pContext->getGraphicsQueueFamily();
+	_transferQueueFamily = pContext->getTransferQueueFamily();
+
+	_isTransferDedicated = _graphicsQueueFamily != _transferQueueFamily;
+
+	_useTimelines = pContext->isTimelineSemaphoreEnabled();
+
+	if (_useTimelines) {
+		_graphicsTimeline = pContext->createTimelineSemaphore();
+
+		if (_isTransferDedicated)
+			_transferTimeline = pContext->createTimelineSemaphore();
+	}
+
+	_stagingRing = AllocatedBuffer::create(allocator, MemoryCategory::Staging,
+			BufferClass::Staging, vk::BufferUsageFlagBits::eTransferSrc, STAGING_RING_SIZE,
+			&_stagingRingAllocInfo);
+
+	_initialized = true;
+}
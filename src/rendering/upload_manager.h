@@ -0,0 +1,200 @@
+#ifndef UPLOAD_MANAGER_H
+#define UPLOAD_MANAGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "mip_generator.h"
+#include "types/allocated.h"
+
+class VulkanContext;
+
+// staging memory recorded into one batch before it is submitted on its own
+const vk::DeviceSize MAX_UPLOAD_BATCH_SIZE = 32 * 1024 * 1024;
+
+// persistent staging memory, shared by batches in flight
+const vk::DeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+const vk::DeviceSize STAGING_ALIGNMENT = 16;
+
+// Records uploads into shared command buffers and submits them without waiting for the queue.
+// Image copies run on dedicated transfer queue when there is one, ownership is then handed to
+// graphics queue, which generates mipmaps unless image comes with them. Mipmaps of every image in
+// batch are generated by compute at submission, formats without storage support are blitted.
+// Buffer copies are recorded on graphics queue, so buffers shared with rendering need no
+// ownership transfer. Work submitted on graphics queue later is ordered after the batch. Staging
+// memory is taken from persistent ring, its range is reclaimed once batch fence signals. Every
+// thread records into a batch and command pools of its own, flush submits batch of calling thread.
+// With timeline semaphores each queue has one counter, batches signal its next value in place of
+// a fence and binary semaphore of their own and finish once counter reaches it, and flushes of
+// render thread are held back to go out in the same submit as graphics work of frame.
+class UploadManager {
+private:
+	struct Recorder;
+
+	typedef struct {
+		// thread batch was recorded on, its pools free command buffers
+		Recorder *pRecorder;
+
+		vk::CommandBuffer transferCommands;
+		vk::CommandBuffer graphicsCommands;
+
+		// without timeline semaphores
+		vk::Semaphore semaphore;
+		vk::Fence fence;
+
+		// signalled on timelines of both queues once submitted
+		uint64_t value;
+
+		// ring allocations released once batch finished
+		std::vector<uint64_t> ringAllocations;
+
+		// uploads larger than ring get their own staging buffer
+		std::vector<AllocatedBuffer> stagingBuffers;
+
+		// images waiting for their levels, still in transfer destination layout
+		std::vector<MipGenerator::Target> mipTargets;
+	} Batch;
+
+	// pools are only used by thread of recorder, finished command buffers wait there for it
+	struct Recorder {
+		vk::CommandPool graphicsPool;
+		vk::CommandPool transferPool;
+
+		Batch batch;
+		vk::DeviceSize batchSize = 0;
+		bool isRecording = false;
+
+		std::vector<vk::CommandBuffer> finishedGraphicsCommands;
+		std::vector<vk::CommandBuffer> finishedTransferCommands;
+	};
+
+	typedef struct {
+		// ring head after allocation
+		uint64_t end;
+		bool isReleased;
+	} RingAllocation;
+
+	typedef struct {
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+	} Staging;
+
+	const VulkanContext *_pContext;
+	vk::Device _device;
+	VmaAllocator _allocator;
+
+	vk::Queue _graphicsQueue;
+	vk::Queue _transferQueue;
+
+	uint32_t _graphicsQueueFamily;
+	uint32_t _transferQueueFamily;
+
+	// guards every member below, recorders are only touched by their own thread
+	std::mutex _mutex;
+
+	std::unordered_map<std::thread::id, Recorder> _recorders;
+
+	// submission order, finished batches are released from front
+	std::vector<Batch> _pendingBatches;
+
+	AllocatedBuffer _stagingRing;
+	VmaAllocationInfo _stagingRingAllocInfo;
+
+	// monotonic, position in ring is counter modulo size
+	uint64_t _ringHead = 0;
+	uint64_t _ringTail = 0;
+
+	// allocation order, batches of threads finish out of it, tail moves past released front
+	std::deque<RingAllocation> _ringAllocations;
+	uint64_t _firstRingAllocation = 0;
+
+	// staged since initialization
+	std::atomic<uint64_t> _uploadedBytes{ 0 };
+	std::atomic<uint64_t> _submittedBatchCount{ 0 };
+
+	std::vector<vk::Semaphore> _freeSemaphores;
+	std::vector<vk::Fence> _freeFences;
+
+	bool _useTimelines = false;
+	vk::Semaphore _graphicsTimeline;
+	vk::Semaphore _transferTimeline;
+	// last value signalled, assigned under queue mutex so values rise in submission order
+	uint64_t _timelineValue = 0;
+
+	// flushed by flushDeferred, not yet submitted
+	std::vector<Batch> _deferredBatches;
+
+	bool _isTransferDedicated = false;
+	bool _initialized = false;
+
+	// of calling thread, created on first use
+	Recorder &_getRecorder();
+
+	void _begin(Recorder &recorder);
+
+	// generates levels of every image recorded into batch
+	void _generateMipmaps(Recorder &recorder);
+
+	// may submit recorded batch to make space, begins batch
+	Staging _stage(Recorder &recorder, const uint8_t *pData, size_t size);
+
+	// ends command buffers, batch is then ready to submit
+	void _end(Recorder &recorder);
+	void _flush(Recorder &recorder);
+
+	// queue mutex has to be held, frame info goes last in the same graphics submit with
+	// timelines, on its own after batches without them
+	void _submit(std::vector<Batch> &batches, const vk::SubmitInfo *pFrameInfo = nullptr,
+			vk::Fence frameFence = VK_NULL_HANDLE);
+	// queue mutex has to be held
+	void _submitDeferred();
+
+	// _mutex has to be held
+	void _wait(const Batch &batch);
+	void _collect();
+
+public:
+	void bufferUpload(
+			vk::Buffer dstBuffer, const uint8_t *pData, size_t size, vk::DeviceSize dstOffset);
+
+	// levelOffsets locate levels in data, either first one only and the rest is generated, or
+	// every level, compressed images can not be blitted, image ends in shader read only layout,
+	// it needs storage usage when MipGenerator supports it
+	void imageUpload(vk::Image image, uint32_t width, uint32_t height, vk::Format format,
+			uint32_t mipLevels, const uint8_t *pData, size_t size,
+			const std::vector<vk::DeviceSize> &levelOffsets = { 0 });
+
+	// submits batch of calling thread, does not wait for it
+	void flush();
+	// like flush, but with timeline semaphores batch is held back until submitFrame of graphics
+	// work it is needed by
+	void flushDeferred();
+	// graphics work goes out together with deferred batches ahead of it, fence signals once all
+	// are finished, queue mutex has to be held
+	void submitFrame(const vk::SubmitInfo &submitInfo, vk::Fence fence);
+
+	// flushes and waits for every pending batch, batches other threads still record are left
+	void wait();
+
+	// releases batches which are finished
+	void collect();
+
+	// bytes copied to staging since initialization, monotonic
+	uint64_t getUploadedBytes() const;
+	// batches handed to queues since initialization, monotonic
+	uint64_t getSubmittedBatchCount() const;
+	// image copies run on transfer queue of their own
+	bool isTransferDedicated() const;
+
+	// queues, their families and timeline support are those of context
+	void initialize(const VulkanContext *pContext, VmaAllocator allocator);
+};
+
+#endif // !UPLOAD_MANAGER_H
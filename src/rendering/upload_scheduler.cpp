@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "upload_scheduler.h"
+
+void UploadScheduler::_reindex() {
+	for (auto &indices : _indices)
+		indices.clear();
+
+	for (size_t i = 0; i < _requests.size(); i++)
+		_indices[static_cast<size_t>(_requests[i].kind)][_requests[i].id] = i;
+}
+
+float UploadScheduler::getPriority(float pixels, float distance, bool isVisible) {
+	float weight = isVisible ? 1.0f : UPLOAD_HIDDEN_WEIGHT;
+
+	return pixels * weight / (1.0f + std::max(distance, 0.0f) / UPLOAD_DISTANCE_FALLOFF);
+}
+
+void UploadScheduler::request(
+		UploadKind kind, ObjectID id, uint64_t size, float priority, uint64_t frame) {
+	auto &indices = _indices[static_cast<size_t>(kind)];
+	auto it = indices.find(id);
+
+	if (it == indices.end()) {
+		indices[id] = _requests.size();
+		_requests.push_back({ kind, id, size, priority, frame });
+		return;
+	}
+
+	UploadRequest &request = _requests[it->second];
+
+	// first renewal of frame replaces what object was worth before
+	if (request.frame != frame || priority > request.priority)
+		request.priority = priority;
+
+	request.size = size;
+	request.frame = frame;
+}
+
+void UploadScheduler::cancel(UploadKind kind, ObjectID id) {
+	auto &indices = _indices[static_cast<size_t>(kind)];
+	auto it = indices.find(id);
+
+	if (it == indices.end())
+		return;
+
+	// last request takes its place
+	size_t index = it->second;
+	indices.erase(it);
+
+	if (index + 1 < _requests.size()) {
+		_requests[index] = _requests.back();
+		_indices[static_cast<size_t>(_requests[index].kind)][_requests[index].id] = index;
+	}
+
+	_requests.pop_back();
+}
+
+void UploadScheduler::drain(uint64_t frame, uint64_t budget, std::vector<UploadRequest> &drained) {
+	size_t count = _requests.size();
+
+	auto isObsolete = [frame](const UploadRequest &request) { return request.frame < frame; };
+	_requests.erase(std::remove_if(_requests.begin(), _requests.end(), isObsolete),
+			_requests.end());
+
+	_cancelledCount = static_cast<uint32_t>(count - _requests.size());
+
+	// ties broken by object, order does not depend on when requests came in
+	auto isBefore = [](const UploadRequest &a, const UploadRequest &b) {
+		if (a.priority != b.priority)
+			return a.priority > b.priority;
+
+		if (a.kind != b.kind)
+			return a.kind < b.kind;
+
+		return a.id < b.id;
+	};
+	std::sort(_requests.begin(), _requests.end(), isBefore);
+
+	uint64_t size = 0;
+	size_t drainedCount = 0;
+
+	for (; drainedCount < _requests.size(); drainedCount++) {
+		const UploadRequest &request = _requests[drainedCount];
+
+		if (drainedCount > 0 && size + request.size > budget)
+			break;
+
+		size += request.size;
+		drained.push_back(request);
+	}
+
+	_requests.erase(_requests.begin(), _requests.begin() + drainedCount);
+	_reindex();
+}
+
+size_t UploadScheduler::getRequestCount() const {
+	return _requests.size();
+}
+
+uint32_t UploadScheduler::getCancelledCount() const {
+	return _cancelledCount;
+}
+
+void UploadScheduler::clear() {
+	_requests.clear();
+
+	for (auto &indices : _indices)
+		indices.clear();
+
+	_cancelledCount = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "types/resource.h"
+
+// hidden requests rank like visible ones covering this fraction of their pixels
+const float UPLOAD_HIDDEN_WEIGHT = 0.25f;
+// of equal projected size, one this many units further ranks half as high
+const float UPLOAD_DISTANCE_FALLOFF = 256.0f;
+
+// what a request uploads once drained, server carries it out
+enum class UploadKind {
+	// first image of pending texture
+	TextureCreate,
+	// finer levels of streamed texture
+	TextureLevels,
+	// packed geometry of evicted mesh
+	Geometry,
+	Count,
+};
+
+typedef struct {
+	UploadKind kind;
+	ObjectID id;
+	// bytes staged once carried out
+	uint64_t size;
+	float priority;
+	// frame request was last renewed in
+	uint64_t frame;
+} UploadRequest;
+
+// Orders uploads of every streaming system by what they are worth on screen, so background
+// assets wait behind what is looked at rather than going out in submission order. Requesters
+// renew their requests every frame from culling results, each renewal replaces priority of
+// earlier frames and keeps the highest of this one. Draining hands out requests highest
+// priority first as long as they fit budget of frame, requests not renewed lately are obsolete
+// and cancelled first.
+class UploadScheduler {
+private:
+	std::vector<UploadRequest> _requests;
+	// positions in _requests by object, per kind
+	std::unordered_map<ObjectID, size_t> _indices[static_cast<size_t>(UploadKind::Count)];
+
+	uint32_t _cancelledCount = 0;
+
+	void _reindex();
+
+public:
+	// pixels object covers on screen, distance of its bounds to nearest view
+	static float getPriority(float pixels, float distance, bool isVisible);
+
+	void request(UploadKind kind, ObjectID id, uint64_t size, float priority, uint64_t frame);
+	// object was freed or no longer needs upload
+	void cancel(UploadKind kind, ObjectID id);
+
+	// drops requests last renewed before frame, then moves highest priority ones into drained
+	// until next one would pass budget, first one is handed out even past it
+	void drain(uint64_t frame, uint64_t budget, std::vector<UploadRequest> &drained);
+
+	// waiting for later frames
+	size_t getRequestCount() const;
+	// obsolete requests dropped by last drain
+	uint32_t getCancelledCount() const;
+
+	void clear();
+};
+
+#endif // !UPLOAD_SCHEDULER_H
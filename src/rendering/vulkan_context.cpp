@@ -1,12 +1,19 @@
+#include <algorithm>
+#include <cctype>
 #include <cstdint>
 #include <cstring>
+#include <cstdio>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <version.h>
 
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
 #include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
 #include <SDL3/SDL_vulkan.h>
 
 #include "vulkan_context.h"
@@ -15,11 +22,33 @@ struct QueueFamilyIndices {
 	uint32_t graphicsFamily = UINT32_MAX;
 	uint32_t presentFamily = UINT32_MAX;
 
+	// graphics family when device has no dedicated transfer family
+	uint32_t transferFamily = UINT32_MAX;
+
+	// graphics family when device has no async compute family
+	uint32_t computeFamily = UINT32_MAX;
+
 	bool isComplete() {
 		return graphicsFamily != UINT32_MAX && presentFamily != UINT32_MAX;
 	}
 };
 
+const char PIPELINE_CACHE_MAGIC[4] = { 'H', 'P', 'I', 'P' };
+
+// driver validates its own data too, header keeps foreign files from reaching it at all
+struct PipelineCacheHeader {
+	char magic[4];
+	uint32_t version;
+
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint32_t _padding;
+
+	uint64_t dataSize;
+};
+
 struct SwapchainSupportDetails {
 	vk::SurfaceCapabilitiesKHR capabilities;
 	std::vector<vk::SurfaceFormatKHR> surfaceFormats;
@@ -59,13 +88,17 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 	return VK_FALSE;
 }
 
-std::vector<const char *> requiredExtensions(bool validationEnabled) {
-	uint32_t count = 0;
-	const char *const *pExtensions = SDL_Vulkan_GetInstanceExtensions(&count);
+std::vector<const char *> requiredExtensions(bool validationEnabled, bool headless) {
+	std::vector<const char *> extensions;
+
+	if (!headless) {
+		uint32_t count = 0;
+		const char *const *pExtensions = SDL_Vulkan_GetInstanceExtensions(&count);
 
-	std::vector<const char *> extensions(count);
-	for (int i = 0; i < count; i++)
-		extensions[i] = pExtensions[i];
+		extensions.resize(count);
+		for (int i = 0; i < count; i++)
+			extensions[i] = pExtensions[i];
+	}
 
 	if (validationEnabled) {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -74,7 +107,8 @@ std::vector<const char *> requiredExtensions(bool validationEnabled) {
 	return extensions;
 }
 
-vk::Instance createInstance(bool useValidation, VkDebugUtilsMessengerEXT *pDebugMessenger) {
+vk::Instance createInstance(
+		bool useValidation, bool headless, VkDebugUtilsMessengerEXT *pDebugMessenger) {
 	uint32_t version = VK_MAKE_VERSION(VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH);
 
 	vk::ApplicationInfo appInfo{};
@@ -84,7 +118,7 @@ vk::Instance createInstance(bool useValidation, VkDebugUtilsMessengerEXT *pDebug
 	appInfo.setEngineVersion(version);
 	appInfo.setApiVersion(VK_API_VERSION_1_1);
 
-	std::vector<const char *> extensions = requiredExtensions(useValidation);
+	std::vector<const char *> extensions = requiredExtensions(useValidation, headless);
 
 	vk::InstanceCreateInfo createInfo = {};
 	createInfo.setPApplicationInfo(&appInfo);
@@ -137,7 +171,11 @@ QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice physicalDevice, vk::Surf
 			indices.graphicsFamily = i;
 		}
 
-		VkBool32 presentSupport = physicalDevice.getSurfaceSupportKHR(i, surface);
+		// without surface nothing is presented, graphics family stands in
+		bool presentSupport = (bool)(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics);
+
+		if (surface)
+			presentSupport = physicalDevice.getSurfaceSupportKHR(i, surface);
 
 		if (presentSupport) {
 			indices.presentFamily = i;
@@ -150,14 +188,51 @@ QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice physicalDevice, vk::Surf
 		i++;
 	}
 
+	indices.transferFamily = indices.graphicsFamily;
+
+	for (uint32_t j = 0; j < queueFamilies.size(); j++) {
+		vk::QueueFlags flags = queueFamilies[j].queueFlags;
+
+		bool isTransfer = (bool)(flags & vk::QueueFlagBits::eTransfer);
+		bool isGraphics = (bool)(flags & vk::QueueFlagBits::eGraphics);
+		bool isCompute = (bool)(flags & vk::QueueFlagBits::eCompute);
+
+		if (!isTransfer || isGraphics)
+			continue;
+
+		indices.transferFamily = j;
+
+		// copy engine only family is preferred
+		if (!isCompute)
+			break;
+	}
+
+	indices.computeFamily = indices.graphicsFamily;
+
+	for (uint32_t j = 0; j < queueFamilies.size(); j++) {
+		vk::QueueFlags flags = queueFamilies[j].queueFlags;
+
+		bool isGraphics = (bool)(flags & vk::QueueFlagBits::eGraphics);
+		bool isCompute = (bool)(flags & vk::QueueFlagBits::eCompute);
+
+		if (isCompute && !isGraphics) {
+			indices.computeFamily = j;
+			break;
+		}
+	}
+
 	return indices;
 }
 
-bool checkDeviceExtensionSupport(vk::PhysicalDevice physicalDevice) {
+bool checkDeviceExtensionSupport(vk::PhysicalDevice physicalDevice, bool headless) {
 	std::vector<vk::ExtensionProperties> extensions =
 			physicalDevice.enumerateDeviceExtensionProperties();
 	std::set<std::string> requiredExtensions(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
 
+	// compute only servers may lack it
+	if (headless)
+		requiredExtensions.erase(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
 	for (const auto &extension : extensions) {
 		requiredExtensions.erase(extension.extensionName);
 	}
@@ -165,6 +240,198 @@ bool checkDeviceExtensionSupport(vk::PhysicalDevice physicalDevice) {
 	return requiredExtensions.empty();
 }
 
+bool checkMemoryBudgetSupport(vk::PhysicalDevice physicalDevice) {
+	std::vector<vk::ExtensionProperties> extensions =
+			physicalDevice.enumerateDeviceExtensionProperties();
+
+	for (const auto &extension : extensions) {
+		if (std::string(extension.extensionName) == MEMORY_BUDGET_DEVICE_EXTENSION)
+			return true;
+	}
+
+	return false;
+}
+
+bool checkPushDescriptorSupport(vk::PhysicalDevice physicalDevice) {
+	std::vector<vk::ExtensionProperties> extensions =
+			physicalDevice.enumerateDeviceExtensionProperties();
+
+	for (const auto &extension : extensions) {
+		if (std::string(extension.extensionName) == PUSH_DESCRIPTOR_DEVICE_EXTENSION)
+			return true;
+	}
+
+	return false;
+}
+
+bool checkCalibratedTimestampsSupport(vk::Instance instance, vk::PhysicalDevice physicalDevice) {
+	std::vector<vk::ExtensionProperties> extensions =
+			physicalDevice.enumerateDeviceExtensionProperties();
+
+	bool isSupported = false;
+
+	for (const auto &extension : extensions) {
+		if (std::string(extension.extensionName) == CALIBRATED_TIMESTAMPS_DEVICE_EXTENSION)
+			isSupported = true;
+	}
+
+	if (!isSupported)
+		return false;
+
+	auto pfnGetTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+			vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+
+	if (pfnGetTimeDomains == nullptr)
+		return false;
+
+	uint32_t domainCount = 0;
+	pfnGetTimeDomains(physicalDevice, &domainCount, nullptr);
+
+	std::vector<VkTimeDomainEXT> domains(domainCount);
+	pfnGetTimeDomains(physicalDevice, &domainCount, domains.data());
+
+	// host domain is not needed, performance counter is read around the call instead
+	return std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+}
+
+bool checkTimelineSemaphoreSupport(vk::PhysicalDevice physicalDevice) {
+	std::vector<vk::ExtensionProperties> extensions =
+			physicalDevice.enumerateDeviceExtensionProperties();
+
+	bool isSupported = false;
+
+	for (const auto &extension : extensions) {
+		if (std::string(extension.extensionName) == TIMELINE_SEMAPHORE_DEVICE_EXTENSION)
+			isSupported = true;
+	}
+
+	if (!isSupported)
+		return false;
+
+	vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+
+	vk::PhysicalDeviceFeatures2 features = {};
+	features.setPNext(&timelineFeatures);
+
+	physicalDevice.getFeatures2(&features);
+
+	return timelineFeatures.timelineSemaphore;
+}
+
+// queries are begun in primary buffer around secondary buffers of passes
+bool checkAttachmentFormatSupport(
+		vk::PhysicalDevice physicalDevice, vk::Format format, vk::FormatFeatureFlags features) {
+	vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+
+	return (properties.optimalTilingFeatures & features) == features;
+}
+
+bool checkPipelineStatisticsSupport(vk::PhysicalDevice physicalDevice) {
+	vk::PhysicalDeviceFeatures features = physicalDevice.getFeatures();
+
+	return features.pipelineStatisticsQuery && features.inheritedQueries;
+}
+
+bool checkPresentWaitSupport(vk::PhysicalDevice physicalDevice) {
+	std::vector<vk::ExtensionProperties> extensions =
+			physicalDevice.enumerateDeviceExtensionProperties();
+	std::set<std::string> requiredExtensions(
+			PRESENT_WAIT_DEVICE_EXTENSIONS.begin(), PRESENT_WAIT_DEVICE_EXTENSIONS.end());
+
+	for (const auto &extension : extensions) {
+		requiredExtensions.erase(extension.extensionName);
+	}
+
+	if (!requiredExtensions.empty())
+		return false;
+
+	vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.setPNext(&presentIdFeatures);
+
+	vk::PhysicalDeviceFeatures2 features = {};
+	features.setPNext(&presentWaitFeatures);
+
+	physicalDevice.getFeatures2(&features);
+
+	return presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+}
+
+bool checkBindlessSupport(vk::PhysicalDevice physicalDevice) {
+	std::vector<vk::ExtensionProperties> extensions =
+			physicalDevice.enumerateDeviceExtensionProperties();
+	std::set<std::string> requiredExtensions(
+			BINDLESS_DEVICE_EXTENSIONS.begin(), BINDLESS_DEVICE_EXTENSIONS.end());
+
+	for (const auto &extension : extensions) {
+		requiredExtensions.erase(extension.extensionName);
+	}
+
+	if (!requiredExtensions.empty())
+		return false;
+
+	vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+
+	vk::PhysicalDeviceFeatures2 features = {};
+	features.setPNext(&indexingFeatures);
+
+	physicalDevice.getFeatures2(&features);
+
+	return indexingFeatures.runtimeDescriptorArray &&
+		   indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+		   indexingFeatures.descriptorBindingPartiallyBound &&
+		   indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+}
+
+// highest of requested mode and those below it device supports, texel size is set for image
+ShadingRateMode checkShadingRateSupport(vk::PhysicalDevice physicalDevice,
+		ShadingRateMode requested, vk::Extent2D &texelSize) {
+	if (requested == ShadingRateMode::Off)
+		return ShadingRateMode::Off;
+
+	std::vector<vk::ExtensionProperties> extensions =
+			physicalDevice.enumerateDeviceExtensionProperties();
+	std::set<std::string> requiredExtensions(
+			SHADING_RATE_DEVICE_EXTENSIONS.begin(), SHADING_RATE_DEVICE_EXTENSIONS.end());
+
+	for (const auto &extension : extensions) {
+		requiredExtensions.erase(extension.extensionName);
+	}
+
+	if (!requiredExtensions.empty())
+		return ShadingRateMode::Off;
+
+	vk::PhysicalDeviceFragmentShadingRateFeaturesKHR shadingRateFeatures = {};
+
+	vk::PhysicalDeviceFeatures2 features = {};
+	features.setPNext(&shadingRateFeatures);
+
+	physicalDevice.getFeatures2(&features);
+
+	// 2x2 is among rates every device with pipeline rates has
+	if (!shadingRateFeatures.pipelineFragmentShadingRate)
+		return ShadingRateMode::Off;
+
+	if (requested == ShadingRateMode::Draw || !shadingRateFeatures.attachmentFragmentShadingRate)
+		return ShadingRateMode::Draw;
+
+	vk::PhysicalDeviceFragmentShadingRatePropertiesKHR shadingRateProperties = {};
+
+	vk::PhysicalDeviceProperties2 properties = {};
+	properties.setPNext(&shadingRateProperties);
+
+	physicalDevice.getProperties2(&properties);
+
+	vk::Extent2D minSize = shadingRateProperties.minFragmentShadingRateAttachmentTexelSize;
+	vk::Extent2D maxSize = shadingRateProperties.maxFragmentShadingRateAttachmentTexelSize;
+
+	// limits are powers of two, so is clamped size
+	texelSize.width = std::clamp(SHADING_RATE_TEXEL_SIZE, minSize.width, maxSize.width);
+	texelSize.height = std::clamp(SHADING_RATE_TEXEL_SIZE, minSize.height, maxSize.height);
+
+	return ShadingRateMode::Image;
+}
+
 SwapchainSupportDetails querySwapchainSupport(
 		vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface) {
 	vk::SurfaceCapabilitiesKHR capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
@@ -177,10 +444,10 @@ SwapchainSupportDetails querySwapchainSupport(
 
 bool isDeviceSuitable(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface) {
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
-	bool extensionsSupported = checkDeviceExtensionSupport(physicalDevice);
+	bool extensionsSupported = checkDeviceExtensionSupport(physicalDevice, !surface);
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
+	bool swapChainAdequate = !surface;
+	if (extensionsSupported && surface) {
 		SwapchainSupportDetails swapChainSupport = querySwapchainSupport(physicalDevice, surface);
 		swapChainAdequate =
 				!swapChainSupport.surfaceFormats.empty() && !swapChainSupport.presentModes.empty();
@@ -188,11 +455,100 @@ bool isDeviceSuitable(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface)
 
 	vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice.getFeatures();
 
+	// reflection probes are sampled as one cube array
 	return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-		   supportedFeatures.samplerAnisotropy;
+		   supportedFeatures.samplerAnisotropy && supportedFeatures.imageCubeArray;
+}
+
+// type first, then size of largest device local heap, then optional features, of suitable
+// devices only
+uint64_t scoreDevice(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface) {
+	vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+
+	uint64_t typeScore = 0;
+
+	switch (properties.deviceType) {
+		case vk::PhysicalDeviceType::eDiscreteGpu:
+			typeScore = 4;
+			break;
+		case vk::PhysicalDeviceType::eIntegratedGpu:
+			typeScore = 3;
+			break;
+		case vk::PhysicalDeviceType::eVirtualGpu:
+			typeScore = 2;
+			break;
+		case vk::PhysicalDeviceType::eCpu:
+			typeScore = 1;
+			break;
+		default:
+			break;
+	}
+
+	// integrated GPUs report a share of system memory, it still ranks them among themselves
+	vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+	vk::DeviceSize heapSize = 0;
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		const vk::MemoryHeap &heap = memoryProperties.memoryHeaps[i];
+
+		if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+			heapSize = std::max(heapSize, heap.size);
+	}
+
+	uint64_t heapScore = std::min<uint64_t>(heapSize >> 20, (1ull << 48) - 1);
+
+	vk::PhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+
+	vk::PhysicalDeviceFeatures2 features = {};
+	features.setPNext(&timelineFeatures);
+
+	physicalDevice.getFeatures2(&features);
+
+	bool hasMeshShader = false;
+
+	for (const auto &extension : physicalDevice.enumerateDeviceExtensionProperties()) {
+		if (std::string(extension.extensionName) == VK_EXT_MESH_SHADER_EXTENSION_NAME)
+			hasMeshShader = true;
+	}
+
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
+
+	uint64_t featureScore = 0;
+	featureScore += checkBindlessSupport(physicalDevice) ? 1 : 0;
+	featureScore += timelineFeatures.timelineSemaphore ? 1 : 0;
+	featureScore += hasMeshShader ? 1 : 0;
+	featureScore += indices.transferFamily != indices.graphicsFamily ? 1 : 0;
+	featureScore += indices.computeFamily != indices.graphicsFamily ? 1 : 0;
+
+	return (typeScore << 56) | (heapScore << 8) | featureScore;
+}
+
+// of index when selection is a number, else first whose name contains it ignoring case
+static int32_t _findSelectedDevice(
+		const std::vector<vk::PhysicalDevice> &devices, const std::string &selection) {
+	bool isIndex = !selection.empty() &&
+			std::all_of(selection.begin(), selection.end(), [](char c) { return isdigit(c); });
+
+	if (isIndex) {
+		int32_t index = atoi(selection.c_str());
+		return index < static_cast<int32_t>(devices.size()) ? index : -1;
+	}
+
+	for (size_t i = 0; i < devices.size(); i++) {
+		std::string name = devices[i].getProperties().deviceName.data();
+
+		auto it = std::search(name.begin(), name.end(), selection.begin(), selection.end(),
+				[](char a, char b) { return tolower(a) == tolower(b); });
+
+		if (it != name.end())
+			return static_cast<int32_t>(i);
+	}
+
+	return -1;
 }
 
-vk::PhysicalDevice pickPhysicalDevice(vk::Instance instance, vk::SurfaceKHR surface) {
+vk::PhysicalDevice pickPhysicalDevice(
+		vk::Instance instance, vk::SurfaceKHR surface, const std::string &selection) {
 	vk::PhysicalDevice chosenDevice = {};
 	std::vector<vk::PhysicalDevice> devices = instance.enumeratePhysicalDevices();
 
@@ -200,18 +556,38 @@ vk::PhysicalDevice pickPhysicalDevice(vk::Instance instance, vk::SurfaceKHR surf
 		return chosenDevice;
 	}
 
+	if (!selection.empty()) {
+		int32_t selected = _findSelectedDevice(devices, selection);
+
+		if (selected >= 0 && isDeviceSuitable(devices[selected], surface))
+			return devices[selected];
+
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "GPU %s not found or not suitable!",
+				selection.c_str());
+	}
+
+	uint64_t bestScore = 0;
+
 	for (const vk::PhysicalDevice &device : devices) {
-		if (isDeviceSuitable(device, surface)) {
+		if (!isDeviceSuitable(device, surface))
+			continue;
+
+		// one above zero, unknown device types are still taken over nothing
+		uint64_t score = scoreDevice(device, surface) + 1;
+
+		if (score > bestScore) {
 			chosenDevice = device;
-			break;
+			bestScore = score;
 		}
 	}
 
 	return chosenDevice;
 }
 
-vk::Device createDevice(
-		vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, bool useValidation) {
+vk::Device createDevice(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface,
+		bool useValidation, bool useBindless, bool useMemoryBudget, bool usePresentWait,
+		bool useCalibratedTimestamps, bool usePushDescriptor, bool useTimelineSemaphore,
+		bool usePipelineStatistics, ShadingRateMode shadingRateMode) {
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
 
 	std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
@@ -219,6 +595,8 @@ vk::Device createDevice(
 	std::set<uint32_t> uniqueQueueFamilies = {
 		indices.graphicsFamily,
 		indices.presentFamily,
+		indices.transferFamily,
+		indices.computeFamily,
 	};
 
 	float queuePriority = 1.0f;
@@ -231,17 +609,94 @@ vk::Device createDevice(
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice.getFeatures();
+
 	vk::PhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.imageCubeArray = VK_TRUE;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	deviceFeatures.shaderStorageImageWriteWithoutFormat =
+			supportedFeatures.shaderStorageImageWriteWithoutFormat;
+	deviceFeatures.pipelineStatisticsQuery = usePipelineStatistics;
+	// overdraw view counts fragments with atomics
+	deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+	deviceFeatures.inheritedQueries = usePipelineStatistics;
 
 	vk::PhysicalDeviceMultiviewFeaturesKHR multiviewFeatures = {};
 	multiviewFeatures.multiview = VK_TRUE;
 
+	std::vector<const char *> extensions;
+
+	// headless device presents nothing
+	for (const char *pExtension : DEVICE_EXTENSIONS)
+		if (surface || strcmp(pExtension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0)
+			extensions.push_back(pExtension);
+
+	if (useMemoryBudget)
+		extensions.push_back(MEMORY_BUDGET_DEVICE_EXTENSION);
+
+	if (useCalibratedTimestamps)
+		extensions.push_back(CALIBRATED_TIMESTAMPS_DEVICE_EXTENSION);
+
+	if (usePushDescriptor)
+		extensions.push_back(PUSH_DESCRIPTOR_DEVICE_EXTENSION);
+
+	vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	if (useBindless) {
+		extensions.insert(extensions.end(), BINDLESS_DEVICE_EXTENSIONS.begin(),
+				BINDLESS_DEVICE_EXTENSIONS.end());
+
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+
+		multiviewFeatures.setPNext(&indexingFeatures);
+	}
+
+	vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	if (usePresentWait) {
+		extensions.insert(extensions.end(), PRESENT_WAIT_DEVICE_EXTENSIONS.begin(),
+				PRESENT_WAIT_DEVICE_EXTENSIONS.end());
+
+		presentIdFeatures.presentId = VK_TRUE;
+		presentWaitFeatures.presentWait = VK_TRUE;
+
+		presentIdFeatures.setPNext(multiviewFeatures.pNext);
+		presentWaitFeatures.setPNext(&presentIdFeatures);
+		multiviewFeatures.setPNext(&presentWaitFeatures);
+	}
+
+	vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	if (useTimelineSemaphore) {
+		extensions.push_back(TIMELINE_SEMAPHORE_DEVICE_EXTENSION);
+
+		timelineFeatures.timelineSemaphore = VK_TRUE;
+
+		timelineFeatures.setPNext(multiviewFeatures.pNext);
+		multiviewFeatures.setPNext(&timelineFeatures);
+	}
+
+	vk::PhysicalDeviceFragmentShadingRateFeaturesKHR shadingRateFeatures = {};
+	if (shadingRateMode != ShadingRateMode::Off) {
+		extensions.insert(extensions.end(), SHADING_RATE_DEVICE_EXTENSIONS.begin(),
+				SHADING_RATE_DEVICE_EXTENSIONS.end());
+
+		shadingRateFeatures.pipelineFragmentShadingRate = VK_TRUE;
+		shadingRateFeatures.attachmentFragmentShadingRate =
+				shadingRateMode == ShadingRateMode::Image;
+
+		shadingRateFeatures.setPNext(multiviewFeatures.pNext);
+		multiviewFeatures.setPNext(&shadingRateFeatures);
+	}
+
 	vk::DeviceCreateInfo createInfo = {};
 	createInfo.setQueueCreateInfos(queueCreateInfos);
 	createInfo.setPEnabledFeatures(&deviceFeatures);
-	createInfo.setEnabledExtensionCount(DEVICE_EXTENSIONS.size());
-	createInfo.setPpEnabledExtensionNames(DEVICE_EXTENSIONS.data());
+	createInfo.setEnabledExtensionCount(extensions.size());
+	createInfo.setPpEnabledExtensionNames(extensions.data());
 	createInfo.setPNext(&multiviewFeatures);
 
 	if (useValidation) {
@@ -300,19 +755,178 @@ vk::PresentModeKHR choosePresentMode(std::vector<vk::PresentModeKHR> presentMode
 	return vk::PresentModeKHR::eFifo;
 }
 
-void VulkanContext::_createSwapchain(uint32_t width, uint32_t height) {
-	SwapchainSupportDetails support = querySwapchainSupport(_physicalDevice, _surface);
+const vk::Format ALBEDO_FORMAT = vk::Format::eR8G8B8A8Srgb;
+const vk::Format NORMAL_FORMAT = vk::Format::eA2B10G10R10UnormPack32;
+const vk::Format MATERIAL_FORMAT = vk::Format::eR8G8Unorm;
+
+// width and height of fragment as log2 of each, height in low two bits
+const vk::Format SHADING_RATE_FORMAT = vk::Format::eR8Uint;
+
+void VulkanContext::_createSwapchain(
+		uint32_t width, uint32_t height, vk::SwapchainKHR oldSwapchain) {
+	vk::SurfaceFormatKHR surfaceFormat(HEADLESS_COLOR_FORMAT, vk::ColorSpaceKHR::eSrgbNonlinear);
+	std::vector<vk::Image> images;
+
+	if (_headless) {
+		_swapchainExtent = vk::Extent2D(width, height);
+
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			Attachment image = Attachment::create(_allocator, _device, width, height,
+					HEADLESS_COLOR_FORMAT,
+					vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+					vk::ImageAspectFlagBits::eColor);
+
+			_offscreenImages.push_back(image);
+			images.push_back(image.getImage());
+		}
+
+		_isReadbackSupported = true;
+	} else {
+		SwapchainSupportDetails support = querySwapchainSupport(_physicalDevice, _surface);
+
+		if (support.capabilities.currentExtent.width == UINT32_MAX) {
+			vk::Extent2D min = support.capabilities.minImageExtent;
+			vk::Extent2D max = support.capabilities.maxImageExtent;
+
+			uint32_t _width = std::clamp(width, min.width, max.width);
+			uint32_t _height = std::clamp(height, min.height, max.height);
+
+			_swapchainExtent = vk::Extent2D(_width, _height);
+		} else {
+			_swapchainExtent = support.capabilities.currentExtent;
+		}
+
+		uint32_t minImageCount = support.capabilities.minImageCount + 1;
+		if (support.capabilities.maxImageCount > 0 &&
+				minImageCount > support.capabilities.maxImageCount) {
+			minImageCount = support.capabilities.maxImageCount;
+		}
+
+		QueueFamilyIndices indices = findQueueFamilies(_physicalDevice, _surface);
+		vk::SharingMode sharingMode = vk::SharingMode::eExclusive;
+
+		std::array<uint32_t, 2> queueFamilyIndices = {};
+
+		if (indices.graphicsFamily != indices.presentFamily) {
+			sharingMode = vk::SharingMode::eConcurrent;
+
+			queueFamilyIndices[0] = indices.graphicsFamily;
+			queueFamilyIndices[1] = indices.presentFamily;
+		}
+
+		surfaceFormat = getSurfaceFormat(support.surfaceFormats);
+
+		// captures copy from swapchain images when surface allows it
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+		_isReadbackSupported = (bool)(support.capabilities.supportedUsageFlags &
+									  vk::ImageUsageFlagBits::eTransferSrc);
+
+		if (_isReadbackSupported)
+			usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+		vk::PresentModeKHR presentMode =
+				choosePresentMode(support.presentModes, _desiredPresentMode);
+		_presentMode = presentMode;
+
+		vk::SwapchainCreateInfoKHR createInfo = {};
+		createInfo.setSurface(_surface);
+		createInfo.setMinImageCount(minImageCount);
+		createInfo.setImageFormat(surfaceFormat.format);
+		createInfo.setImageColorSpace(surfaceFormat.colorSpace);
+		createInfo.setImageExtent(_swapchainExtent);
+		createInfo.setImageArrayLayers(1);
+		createInfo.setImageUsage(usage);
+		createInfo.setImageSharingMode(sharingMode);
+		createInfo.setQueueFamilyIndices(queueFamilyIndices);
+		createInfo.setPreTransform(support.capabilities.currentTransform);
+		createInfo.setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque);
+		createInfo.setPresentMode(presentMode);
+		createInfo.setClipped(true);
+		// images of old one still in flight are handed over, it is retired afterwards
+		createInfo.setOldSwapchain(oldSwapchain);
+
+		_swapchain = _device.createSwapchainKHR(createInfo);
+
+		images = _device.getSwapchainImagesKHR(_swapchain);
+	}
+
+	_swapchainImages.resize(images.size());
+	_finalFormat = surfaceFormat.format;
+
+	// scene is rendered at fraction of swapchain extent, tonemap pass upscales it
+	uint32_t _width = std::max(
+			static_cast<uint32_t>(_swapchainExtent.width * _renderScale + 0.5f), 1u);
+	uint32_t _height = std::max(
+			static_cast<uint32_t>(_swapchainExtent.height * _renderScale + 0.5f), 1u);
+
+	_renderExtent = vk::Extent2D(_width, _height);
+
+	// surface format is picked the same way every time, render passes outlive swapchains
+	if (!_renderPass)
+		_createRenderPasses();
+
+	vk::ImageSubresourceRange subresourceRange = {};
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+	subresourceRange.setBaseMipLevel(0);
+	subresourceRange.setLevelCount(1);
+	subresourceRange.setBaseArrayLayer(0);
+	subresourceRange.setLayerCount(1);
+
+	for (size_t i = 0; i < images.size(); i++) {
+		vk::ImageViewCreateInfo createInfo = {};
+		createInfo.setImage(images[i]);
+		createInfo.setViewType(vk::ImageViewType::e2D);
+		createInfo.setFormat(surfaceFormat.format);
+		createInfo.setSubresourceRange(subresourceRange);
+
+		vk::ImageView finalColorView;
+
+		// offscreen images come with view of their own
+		if (_headless)
+			finalColorView = _offscreenImages[i].getImageView();
+		else
+			finalColorView = _device.createImageView(createInfo);
+
+		vk::FramebufferCreateInfo tonemapFramebufferInfo = {};
+		tonemapFramebufferInfo.setRenderPass(_tonemapRenderPass);
+		tonemapFramebufferInfo.setAttachments(finalColorView);
+		tonemapFramebufferInfo.setWidth(_swapchainExtent.width);
+		tonemapFramebufferInfo.setHeight(_swapchainExtent.height);
+		tonemapFramebufferInfo.setLayers(1);
+
+		vk::Framebuffer framebuffer;
+		vk::Result err = _device.createFramebuffer(&tonemapFramebufferInfo, nullptr, &framebuffer);
+
+		if (err != vk::Result::eSuccess)
+			throw std::runtime_error("Swapchain framebuffer creation failed!");
+
+		_swapchainImages[i] = { images[i], _headless ? vk::ImageView() : finalColorView,
+			framebuffer };
+	}
+}
+
+bool VulkanContext::createWindowSwapchain(vk::SurfaceKHR surface, uint32_t width,
+		uint32_t height, vk::SwapchainKHR oldSwapchain, vk::SwapchainKHR &swapchain,
+		vk::Extent2D &extent, vk::Format &format) {
+	QueueFamilyIndices indices = findQueueFamilies(_physicalDevice, _surface);
+
+	// present queue was picked for first surface
+	if (_headless || !_physicalDevice.getSurfaceSupportKHR(indices.presentFamily, surface))
+		return false;
+
+	SwapchainSupportDetails support = querySwapchainSupport(_physicalDevice, surface);
+
+	if (!(support.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst))
+		return false;
 
 	if (support.capabilities.currentExtent.width == UINT32_MAX) {
 		vk::Extent2D min = support.capabilities.minImageExtent;
 		vk::Extent2D max = support.capabilities.maxImageExtent;
 
-		uint32_t _width = std::clamp(width, min.width, max.width);
-		uint32_t _height = std::clamp(height, min.height, max.height);
-
-		_swapchainExtent = vk::Extent2D(_width, _height);
+		extent = vk::Extent2D(std::clamp(width, min.width, max.width),
+				std::clamp(height, min.height, max.height));
 	} else {
-		_swapchainExtent = support.capabilities.currentExtent;
+		extent = support.capabilities.currentExtent;
 	}
 
 	uint32_t minImageCount = support.capabilities.minImageCount + 1;
@@ -321,9 +935,7 @@ void VulkanContext::_createSwapchain(uint32_t width, uint32_t height) {
 		minImageCount = support.capabilities.maxImageCount;
 	}
 
-	QueueFamilyIndices indices = findQueueFamilies(_physicalDevice, _surface);
 	vk::SharingMode sharingMode = vk::SharingMode::eExclusive;
-
 	std::array<uint32_t, 2> queueFamilyIndices = {};
 
 	if (indices.graphicsFamily != indices.presentFamily) {
@@ -334,71 +946,250 @@ void VulkanContext::_createSwapchain(uint32_t width, uint32_t height) {
 	}
 
 	vk::SurfaceFormatKHR surfaceFormat = getSurfaceFormat(support.surfaceFormats);
-
-	vk::PresentModeKHR presentMode =
-			choosePresentMode(support.presentModes, vk::PresentModeKHR::eMailbox);
+	format = surfaceFormat.format;
 
 	vk::SwapchainCreateInfoKHR createInfo = {};
-	createInfo.setSurface(_surface);
+	createInfo.setSurface(surface);
 	createInfo.setMinImageCount(minImageCount);
 	createInfo.setImageFormat(surfaceFormat.format);
 	createInfo.setImageColorSpace(surfaceFormat.colorSpace);
-	createInfo.setImageExtent(_swapchainExtent);
+	createInfo.setImageExtent(extent);
 	createInfo.setImageArrayLayers(1);
-	createInfo.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment);
+	// only ever blitted to
+	createInfo.setImageUsage(vk::ImageUsageFlagBits::eTransferDst);
 	createInfo.setImageSharingMode(sharingMode);
 	createInfo.setQueueFamilyIndices(queueFamilyIndices);
 	createInfo.setPreTransform(support.capabilities.currentTransform);
 	createInfo.setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque);
-	createInfo.setPresentMode(presentMode);
+	createInfo.setPresentMode(choosePresentMode(support.presentModes, _desiredPresentMode));
 	createInfo.setClipped(true);
+	createInfo.setOldSwapchain(oldSwapchain);
 
-	_swapchain = _device.createSwapchainKHR(createInfo);
+	swapchain = _device.createSwapchainKHR(createInfo);
 
-	std::vector<vk::Image> images = _device.getSwapchainImagesKHR(_swapchain);
-	_swapchainImages.resize(images.size());
+	return true;
+}
 
-	// Resources
+void VulkanContext::_createAttachments(uint32_t width, uint32_t height) {
+	_color = Attachment::create(_allocator, _device, width, height, _colorFormat,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+			vk::ImageAspectFlagBits::eColor);
 
-	uint32_t _width = _swapchainExtent.width;
-	uint32_t _height = _swapchainExtent.height;
+	// lighting pass reads depth to reconstruct position
+	vk::ImageUsageFlags depthUsage =
+			vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
 
-	vk::PhysicalDeviceMemoryProperties memProperties = _physicalDevice.getMemoryProperties();
+	if (_deferred)
+		depthUsage |= vk::ImageUsageFlagBits::eInputAttachment;
 
-	vk::Format colorFormat = vk::Format::eB10G11R11UfloatPack32;
-	_color = Attachment::create(_device, _width, _height, colorFormat,
-			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment,
-			vk::ImageAspectFlagBits::eColor, memProperties);
+	_depth = Attachment::create(_allocator, _device, width, height, _depthFormat, depthUsage,
+			vk::ImageAspectFlagBits::eDepth);
 
-	vk::Format depthFormat = vk::Format::eD32Sfloat;
-	_depth = Attachment::create(_device, _width, _height, depthFormat,
-			vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth,
-			memProperties);
+	if (_deferred) {
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment |
+				vk::ImageUsageFlagBits::eInputAttachment |
+				vk::ImageUsageFlagBits::eTransientAttachment;
 
-	// attachments
+		_albedo = Attachment::create(_allocator, _device, width, height, ALBEDO_FORMAT, usage,
+				vk::ImageAspectFlagBits::eColor);
+		_normal = Attachment::create(_allocator, _device, width, height, NORMAL_FORMAT, usage,
+				vk::ImageAspectFlagBits::eColor);
+		_material = Attachment::create(_allocator, _device, width, height, MATERIAL_FORMAT, usage,
+				vk::ImageAspectFlagBits::eColor);
+	}
+
+	// written by compute once scene is drawn, rounded up so tiles cover every pixel
+	if (_shadingRateMode == ShadingRateMode::Image) {
+		uint32_t rateWidth = (width + _shadingRateTexelSize.width - 1) / _shadingRateTexelSize.width;
+		uint32_t rateHeight =
+				(height + _shadingRateTexelSize.height - 1) / _shadingRateTexelSize.height;
+
+		_shadingRate = Attachment::create(_allocator, _device, rateWidth, rateHeight,
+				SHADING_RATE_FORMAT,
+				vk::ImageUsageFlagBits::eFragmentShadingRateAttachmentKHR |
+						vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst,
+				vk::ImageAspectFlagBits::eColor);
+	}
+
+	std::vector<vk::ImageView> attachmentViews = {
+		_color.getImageView(),
+		_depth.getImageView(),
+	};
+
+	if (_deferred) {
+		attachmentViews.push_back(_albedo.getImageView());
+		attachmentViews.push_back(_normal.getImageView());
+		attachmentViews.push_back(_material.getImageView());
+	}
+
+	if (_shadingRateMode == ShadingRateMode::Image)
+		attachmentViews.push_back(_shadingRate.getImageView());
+
+	vk::FramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.setRenderPass(_renderPass);
+	framebufferInfo.setAttachments(attachmentViews);
+	framebufferInfo.setWidth(width);
+	framebufferInfo.setHeight(height);
+	framebufferInfo.setLayers(1);
+
+	vk::Result err = _device.createFramebuffer(&framebufferInfo, nullptr, &_framebuffer);
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Scene framebuffer creation failed!");
+
+	_attachmentExtent = vk::Extent2D(width, height);
+	_attachmentVersion++;
+}
+
+// same passes as render pass 2, with shading rate image as last attachment read by one subpass
+static vk::RenderPass createRenderPass2(vk::Device device,
+		PFN_vkCreateRenderPass2KHR pfnCreateRenderPass2, const vk::RenderPassCreateInfo &info,
+		uint32_t shadingRateSubpass, vk::Extent2D texelSize) {
+	std::vector<vk::AttachmentDescription2> attachments;
+
+	for (uint32_t i = 0; i < info.attachmentCount; i++) {
+		const vk::AttachmentDescription &attachment = info.pAttachments[i];
+
+		vk::AttachmentDescription2 attachment2 = {};
+		attachment2.setFlags(attachment.flags);
+		attachment2.setFormat(attachment.format);
+		attachment2.setSamples(attachment.samples);
+		attachment2.setLoadOp(attachment.loadOp);
+		attachment2.setStoreOp(attachment.storeOp);
+		attachment2.setStencilLoadOp(attachment.stencilLoadOp);
+		attachment2.setStencilStoreOp(attachment.stencilStoreOp);
+		attachment2.setInitialLayout(attachment.initialLayout);
+		attachment2.setFinalLayout(attachment.finalLayout);
+
+		attachments.push_back(attachment2);
+	}
+
+	vk::ImageLayout shadingRateLayout = vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR;
+
+	// compute rewrites every texel after render pass, nothing is stored
+	vk::AttachmentDescription2 shadingRateAttachment = {};
+	shadingRateAttachment.setFormat(SHADING_RATE_FORMAT);
+	shadingRateAttachment.setSamples(vk::SampleCountFlagBits::e1);
+	shadingRateAttachment.setLoadOp(vk::AttachmentLoadOp::eLoad);
+	shadingRateAttachment.setStoreOp(vk::AttachmentStoreOp::eDontCare);
+	shadingRateAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+	shadingRateAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+	shadingRateAttachment.setInitialLayout(shadingRateLayout);
+	shadingRateAttachment.setFinalLayout(shadingRateLayout);
+
+	attachments.push_back(shadingRateAttachment);
+
+	// references of every subpass, reserved so pointers into them stay valid
+	std::vector<vk::AttachmentReference2> references;
+	references.reserve(info.attachmentCount * info.subpassCount * 2 + 1);
+
+	auto convert = [&](const vk::AttachmentReference *pReferences, uint32_t count) {
+		const vk::AttachmentReference2 *pFirst = references.data() + references.size();
+
+		for (uint32_t i = 0; i < count; i++) {
+			vk::Format format = info.pAttachments[pReferences[i].attachment].format;
+			bool isDepth = format == _depthFormat;
+
+			vk::AttachmentReference2 reference = {};
+			reference.setAttachment(pReferences[i].attachment);
+			reference.setLayout(pReferences[i].layout);
+			reference.setAspectMask(
+					isDepth ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor);
+
+			references.push_back(reference);
+		}
+
+		return count > 0 ? pFirst : nullptr;
+	};
+
+	vk::AttachmentReference2 shadingRateRef = {};
+	shadingRateRef.setAttachment(info.attachmentCount);
+	shadingRateRef.setLayout(shadingRateLayout);
+
+	vk::FragmentShadingRateAttachmentInfoKHR shadingRateInfo = {};
+	shadingRateInfo.setPFragmentShadingRateAttachment(&shadingRateRef);
+	shadingRateInfo.setShadingRateAttachmentTexelSize(texelSize);
+
+	std::vector<vk::SubpassDescription2> subpasses;
+
+	for (uint32_t i = 0; i < info.subpassCount; i++) {
+		const vk::SubpassDescription &subpass = info.pSubpasses[i];
+
+		vk::SubpassDescription2 subpass2 = {};
+		subpass2.setPipelineBindPoint(subpass.pipelineBindPoint);
+		subpass2.setInputAttachmentCount(subpass.inputAttachmentCount);
+		subpass2.setPInputAttachments(
+				convert(subpass.pInputAttachments, subpass.inputAttachmentCount));
+		subpass2.setColorAttachmentCount(subpass.colorAttachmentCount);
+		subpass2.setPColorAttachments(
+				convert(subpass.pColorAttachments, subpass.colorAttachmentCount));
+		subpass2.setPDepthStencilAttachment(
+				convert(subpass.pDepthStencilAttachment, subpass.pDepthStencilAttachment ? 1 : 0));
+
+		if (i == shadingRateSubpass)
+			subpass2.setPNext(&shadingRateInfo);
+
+		subpasses.push_back(subpass2);
+	}
+
+	std::vector<vk::SubpassDependency2> dependencies;
+
+	for (uint32_t i = 0; i < info.dependencyCount; i++) {
+		const vk::SubpassDependency &dependency = info.pDependencies[i];
+
+		vk::SubpassDependency2 dependency2 = {};
+		dependency2.setSrcSubpass(dependency.srcSubpass);
+		dependency2.setDstSubpass(dependency.dstSubpass);
+		dependency2.setSrcStageMask(dependency.srcStageMask);
+		dependency2.setDstStageMask(dependency.dstStageMask);
+		dependency2.setSrcAccessMask(dependency.srcAccessMask);
+		dependency2.setDstAccessMask(dependency.dstAccessMask);
+		dependency2.setDependencyFlags(dependency.dependencyFlags);
+
+		dependencies.push_back(dependency2);
+	}
+
+	vk::RenderPassCreateInfo2 createInfo = {};
+	createInfo.setAttachments(attachments);
+	createInfo.setSubpasses(subpasses);
+	createInfo.setDependencies(dependencies);
+
+	VkRenderPass renderPass;
+	VkResult err = pfnCreateRenderPass2(device,
+			&static_cast<const VkRenderPassCreateInfo2 &>(createInfo), nullptr, &renderPass);
+
+	if (err != VK_SUCCESS)
+		throw std::runtime_error("Scene render pass creation failed!");
+
+	return renderPass;
+}
+
+void VulkanContext::_createRenderPasses() {
+	// attachments
 
 	vk::AttachmentDescription finalColorAttachment = {};
-	finalColorAttachment.setFormat(surfaceFormat.format);
+	finalColorAttachment.setFormat(_finalFormat);
 	finalColorAttachment.setSamples(vk::SampleCountFlagBits::e1);
 	finalColorAttachment.setLoadOp(vk::AttachmentLoadOp::eDontCare);
 	finalColorAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
 	finalColorAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
 	finalColorAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
 	finalColorAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
-	finalColorAttachment.setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+	finalColorAttachment.setFinalLayout(getFinalLayout());
 
+	// sampled by tonemap pass once scene render pass ends
 	vk::AttachmentDescription colorAttachment = {};
-	colorAttachment.setFormat(colorFormat);
+	colorAttachment.setFormat(_colorFormat);
 	colorAttachment.setSamples(vk::SampleCountFlagBits::e1);
 	colorAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
 	colorAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
 	colorAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
 	colorAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
 	colorAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
-	colorAttachment.setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
+	colorAttachment.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
 
 	vk::AttachmentDescription depthAttachment = {};
-	depthAttachment.setFormat(depthFormat);
+	depthAttachment.setFormat(_depthFormat);
 	depthAttachment.setSamples(vk::SampleCountFlagBits::e1);
 	depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
 	depthAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
@@ -407,6 +1198,25 @@ void VulkanContext::_createSwapchain(uint32_t width, uint32_t height) {
 	depthAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
 	depthAttachment.setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
+	// g-buffer is consumed within render pass, contents are never stored
+	vk::AttachmentDescription gbufferAttachment = {};
+	gbufferAttachment.setSamples(vk::SampleCountFlagBits::e1);
+	gbufferAttachment.setLoadOp(vk::AttachmentLoadOp::eDontCare);
+	gbufferAttachment.setStoreOp(vk::AttachmentStoreOp::eDontCare);
+	gbufferAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+	gbufferAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+	gbufferAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
+	gbufferAttachment.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+	vk::AttachmentDescription albedoAttachment = gbufferAttachment;
+	albedoAttachment.setFormat(ALBEDO_FORMAT);
+
+	vk::AttachmentDescription normalAttachment = gbufferAttachment;
+	normalAttachment.setFormat(NORMAL_FORMAT);
+
+	vk::AttachmentDescription materialAttachment = gbufferAttachment;
+	materialAttachment.setFormat(MATERIAL_FORMAT);
+
 	// references
 
 	vk::AttachmentReference finalColorRef = {};
@@ -414,17 +1224,31 @@ void VulkanContext::_createSwapchain(uint32_t width, uint32_t height) {
 	finalColorRef.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
 
 	vk::AttachmentReference colorRef = {};
-	colorRef.setAttachment(1);
+	colorRef.setAttachment(0);
 	colorRef.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
 
-	vk::AttachmentReference colorShaderReadRef = {};
-	colorShaderReadRef.setAttachment(1);
-	colorShaderReadRef.setLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-
 	vk::AttachmentReference depthRef = {};
-	depthRef.setAttachment(2);
+	depthRef.setAttachment(1);
 	depthRef.setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
+	// read only depth is both tested by sky and loaded by lighting
+	vk::AttachmentReference depthReadRef = {};
+	depthReadRef.setAttachment(1);
+	depthReadRef.setLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+
+	std::array<vk::AttachmentReference, 3> gbufferRefs = {};
+	std::array<vk::AttachmentReference, 4> gbufferShaderReadRefs = {};
+
+	for (uint32_t i = 0; i < gbufferRefs.size(); i++) {
+		gbufferRefs[i].setAttachment(2 + i);
+		gbufferRefs[i].setLayout(vk::ImageLayout::eColorAttachmentOptimal);
+
+		gbufferShaderReadRefs[i].setAttachment(2 + i);
+		gbufferShaderReadRefs[i].setLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	}
+
+	gbufferShaderReadRefs[3] = depthReadRef;
+
 	// subpasses
 
 	vk::SubpassDescription depthPass = {};
@@ -436,13 +1260,33 @@ void VulkanContext::_createSwapchain(uint32_t width, uint32_t height) {
 	mainPass.setColorAttachments(colorRef);
 	mainPass.setPDepthStencilAttachment(&depthRef);
 
+	vk::SubpassDescription gbufferPass = {};
+	gbufferPass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+	gbufferPass.setColorAttachments(gbufferRefs);
+	gbufferPass.setPDepthStencilAttachment(&depthRef);
+
+	vk::SubpassDescription lightingPass = {};
+	lightingPass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+	lightingPass.setColorAttachments(colorRef);
+	lightingPass.setInputAttachments(gbufferShaderReadRefs);
+	lightingPass.setPDepthStencilAttachment(&depthReadRef);
+
 	vk::SubpassDescription tonemapPass = {};
 	tonemapPass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
 	tonemapPass.setColorAttachments(finalColorRef);
-	tonemapPass.setInputAttachments(colorShaderReadRef);
 
 	// dependencies
 
+	uint32_t colorPass = _deferred ? LIGHTING_PASS : MAIN_PASS;
+
+	// tonemap pass of previous frame has to be done sampling color before it is cleared
+	vk::SubpassDependency colorReuseDependency = {};
+	colorReuseDependency.setSrcSubpass(VK_SUBPASS_EXTERNAL);
+	colorReuseDependency.setDstSubpass(colorPass);
+	colorReuseDependency.setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader);
+	colorReuseDependency.setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+	colorReuseDependency.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+
 	vk::SubpassDependency depthDependency = {};
 	depthDependency.setSrcSubpass(DEPTH_PASS);
 	depthDependency.setDstSubpass(MAIN_PASS);
@@ -452,110 +1296,340 @@ void VulkanContext::_createSwapchain(uint32_t width, uint32_t height) {
 	depthDependency.setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite);
 	depthDependency.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
 
-	vk::SubpassDependency mainDependency = {};
-	mainDependency.setSrcSubpass(MAIN_PASS);
-	mainDependency.setDstSubpass(TONEMAP_PASS);
-	mainDependency.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-	mainDependency.setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader);
-	mainDependency.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
-	mainDependency.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-
-	// render pass
-
-	std::array<vk::AttachmentDescription, 3> attachments = {
-		finalColorAttachment,
+	// by region, so tiled GPUs can keep g-buffer on chip
+	vk::SubpassDependency gbufferDependency = {};
+	gbufferDependency.setSrcSubpass(GBUFFER_PASS);
+	gbufferDependency.setDstSubpass(LIGHTING_PASS);
+	gbufferDependency.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput |
+									  vk::PipelineStageFlagBits::eLateFragmentTests);
+	gbufferDependency.setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader |
+									  vk::PipelineStageFlagBits::eEarlyFragmentTests);
+	gbufferDependency.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite |
+									   vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+	gbufferDependency.setDstAccessMask(vk::AccessFlagBits::eInputAttachmentRead |
+									   vk::AccessFlagBits::eDepthStencilAttachmentRead);
+	gbufferDependency.setDependencyFlags(vk::DependencyFlagBits::eByRegion);
+
+	// upscale samples texels other than its own, so color leaves tile memory here
+	vk::SubpassDependency colorDependency = {};
+	colorDependency.setSrcSubpass(colorPass);
+	colorDependency.setDstSubpass(VK_SUBPASS_EXTERNAL);
+	colorDependency.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+	colorDependency.setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader);
+	colorDependency.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+	colorDependency.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+	// final image is written once acquire semaphore waited at color output
+	vk::SubpassDependency finalColorDependency = {};
+	finalColorDependency.setSrcSubpass(VK_SUBPASS_EXTERNAL);
+	finalColorDependency.setDstSubpass(0);
+	finalColorDependency.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+	finalColorDependency.setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+	finalColorDependency.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+
+	// render passes
+
+	std::vector<vk::AttachmentDescription> attachments = {
 		colorAttachment,
 		depthAttachment,
 	};
 
-	std::array<vk::SubpassDescription, 3> subpasses = {
-		depthPass,
-		mainPass,
-		tonemapPass,
-	};
+	std::vector<vk::SubpassDescription> subpasses;
+	std::vector<vk::SubpassDependency> dependencies;
 
-	std::array<vk::SubpassDependency, 2> dependencies = {
-		depthDependency,
-		mainDependency,
-	};
+	if (_deferred) {
+		attachments.push_back(albedoAttachment);
+		attachments.push_back(normalAttachment);
+		attachments.push_back(materialAttachment);
+
+		subpasses = { depthPass, gbufferPass, lightingPass };
+		dependencies = { colorReuseDependency, depthDependency, gbufferDependency,
+			colorDependency };
+	} else {
+		subpasses = { depthPass, mainPass };
+		dependencies = { colorReuseDependency, depthDependency, colorDependency };
+	}
 
 	vk::RenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.setAttachments(attachments);
 	renderPassInfo.setSubpasses(subpasses);
 	renderPassInfo.setDependencies(dependencies);
 
-	_renderPass = _device.createRenderPass(renderPassInfo);
-
-	// framebuffers
-
-	vk::ImageSubresourceRange subresourceRange = {};
-	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
-	subresourceRange.setBaseMipLevel(0);
-	subresourceRange.setLevelCount(1);
-	subresourceRange.setBaseArrayLayer(0);
-	subresourceRange.setLayerCount(1);
-
-	for (size_t i = 0; i < images.size(); i++) {
-		vk::ImageViewCreateInfo createInfo = {};
-		createInfo.setImage(images[i]);
-		createInfo.setViewType(vk::ImageViewType::e2D);
-		createInfo.setFormat(surfaceFormat.format);
-		createInfo.setSubresourceRange(subresourceRange);
+	// material pass of either path reads shading rate image
+	if (_shadingRateMode == ShadingRateMode::Image)
+		_renderPass = createRenderPass2(_device, _pfnCreateRenderPass2, renderPassInfo, MAIN_PASS,
+				_shadingRateTexelSize);
+	else
+		_renderPass = _device.createRenderPass(renderPassInfo);
 
-		vk::ImageView finalColorView = _device.createImageView(createInfo);
+	vk::RenderPassCreateInfo tonemapRenderPassInfo = {};
+	tonemapRenderPassInfo.setAttachments(finalColorAttachment);
+	tonemapRenderPassInfo.setSubpasses(tonemapPass);
+	tonemapRenderPassInfo.setDependencies(finalColorDependency);
 
-		std::array<vk::ImageView, 3> attachmentViews = {
-			finalColorView,
-			_color.getImageView(),
-			_depth.getImageView(),
-		};
+	_tonemapRenderPass = _device.createRenderPass(tonemapRenderPassInfo);
+}
 
-		vk::FramebufferCreateInfo framebufferInfo = {};
-		framebufferInfo.setRenderPass(_renderPass);
-		framebufferInfo.setAttachments(attachmentViews);
-		framebufferInfo.setWidth(_swapchainExtent.width);
-		framebufferInfo.setHeight(_swapchainExtent.height);
-		framebufferInfo.setLayers(1);
+void VulkanContext::_destroyAttachments() {
+	_color.destroy(_allocator, _device);
+	_depth.destroy(_allocator, _device);
 
-		vk::Framebuffer framebuffer;
-		vk::Result err = _device.createFramebuffer(&framebufferInfo, nullptr, &framebuffer);
+	if (_deferred) {
+		_albedo.destroy(_allocator, _device);
+		_normal.destroy(_allocator, _device);
+		_material.destroy(_allocator, _device);
+	}
 
-		if (err != vk::Result::eSuccess)
-			throw std::runtime_error("Swapchain framebuffer creation failed!");
+	if (_shadingRateMode == ShadingRateMode::Image)
+		_shadingRate.destroy(_allocator, _device);
 
-		_swapchainImages[i] = { finalColorView, framebuffer };
-	}
+	_device.destroyFramebuffer(_framebuffer, nullptr);
+	_attachmentExtent = vk::Extent2D(0, 0);
 }
 
 void VulkanContext::_destroySwapchain() {
-	_color.destroy(_device);
-	_depth.destroy(_device);
-
 	for (uint32_t i = 0; i < _swapchainImages.size(); i++) {
 		_device.destroyFramebuffer(_swapchainImages[i].framebuffer, nullptr);
 		_device.destroyImageView(_swapchainImages[i].view, nullptr);
 	}
 	_swapchainImages.clear();
 
+	for (Attachment &image : _offscreenImages)
+		image.destroy(_allocator, _device);
+	_offscreenImages.clear();
+
 	_device.destroySwapchainKHR(_swapchain, nullptr);
-	_device.destroyRenderPass(_renderPass, nullptr);
 }
 
-void VulkanContext::initialize(vk::SurfaceKHR surface, uint32_t width, uint32_t height) {
+static std::string _getPipelineCachePath() {
+	char *pPath = SDL_GetPrefPath("hayaku", "cache");
+
+	if (pPath == nullptr)
+		return std::string();
+
+	std::string path = pPath;
+	SDL_free(pPath);
+
+	return path + "pipelines.cache";
+}
+
+static PipelineCacheHeader _getPipelineCacheHeader(vk::PhysicalDevice physicalDevice) {
+	vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+
+	PipelineCacheHeader header = {};
+	memcpy(header.magic, PIPELINE_CACHE_MAGIC, sizeof(PIPELINE_CACHE_MAGIC));
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	return header;
+}
+
+void VulkanContext::_createPipelineCache() {
+	std::string path = _getPipelineCachePath();
+
+	size_t fileSize = 0;
+	uint8_t *pFile = nullptr;
+
+	if (!path.empty())
+		pFile = static_cast<uint8_t *>(SDL_LoadFile(path.c_str(), &fileSize));
+
+	PipelineCacheHeader expected = _getPipelineCacheHeader(_physicalDevice);
+	PipelineCacheHeader header;
+
+	bool isValid = pFile != nullptr && fileSize >= sizeof(PipelineCacheHeader);
+
+	if (isValid) {
+		memcpy(&header, pFile, sizeof(PipelineCacheHeader));
+		expected.dataSize = fileSize - sizeof(PipelineCacheHeader);
+
+		isValid = memcmp(&header, &expected, sizeof(PipelineCacheHeader)) == 0;
+	}
+
+	vk::PipelineCacheCreateInfo createInfo = {};
+
+	if (isValid) {
+		createInfo.setInitialDataSize(header.dataSize);
+		createInfo.setPInitialData(pFile + sizeof(PipelineCacheHeader));
+	}
+
+	vk::Result err = _device.createPipelineCache(&createInfo, nullptr, &_pipelineCache);
+
+	// rejected data, driver starts over with empty cache
+	if (err != vk::Result::eSuccess && isValid) {
+		createInfo = vk::PipelineCacheCreateInfo();
+		err = _device.createPipelineCache(&createInfo, nullptr, &_pipelineCache);
+	}
+
+	if (err != vk::Result::eSuccess)
+		throw std::runtime_error("Pipeline cache creation failed!");
+
+	_pipelineCacheSize = isValid ? header.dataSize : 0;
+
+	SDL_free(pFile);
+}
+
+void VulkanContext::savePipelineCache() {
+	std::vector<uint8_t> data = _device.getPipelineCacheData(_pipelineCache);
+
+	if (data.size() == _pipelineCacheSize)
+		return;
+
+	std::string path = _getPipelineCachePath();
+
+	if (path.empty())
+		return;
+
+	PipelineCacheHeader header = _getPipelineCacheHeader(_physicalDevice);
+	header.dataSize = data.size();
+
+	SDL_IOStream *pStream = SDL_IOFromFile(path.c_str(), "wb");
+
+	if (pStream == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Opening cache file (%s) failed", path.c_str());
+		return;
+	}
+
+	size_t written = SDL_WriteIO(pStream, &header, sizeof(PipelineCacheHeader));
+	written += SDL_WriteIO(pStream, data.data(), data.size());
+
+	SDL_CloseIO(pStream);
+
+	// partial file would be rejected on load, remove it right away
+	if (written != sizeof(PipelineCacheHeader) + data.size()) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Writing cache file (%s) failed", path.c_str());
+		remove(path.c_str());
+		return;
+	}
+
+	_pipelineCacheSize = data.size();
+}
+
+void VulkanContext::initialize(
+		vk::SurfaceKHR surface, uint32_t width, uint32_t height, bool bindless, bool deferred,
+		ShadingRateMode shadingRateMode) {
 	if (_initialized)
 		return;
 
+	_deferred = deferred;
+
+	if (!surface != _headless)
+		throw std::runtime_error("Surface does not match headless context!");
+
 	this->_surface = surface;
-	_physicalDevice = pickPhysicalDevice(_instance, surface);
-	_device = createDevice(_physicalDevice, surface, _validation);
+	_physicalDevice = pickPhysicalDevice(_instance, surface, _deviceSelection);
+
+	if (_physicalDevice)
+		SDL_Log("GPU: %s", _physicalDevice.getProperties().deviceName.data());
+
+	if (bindless && !checkBindlessSupport(_physicalDevice)) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Descriptor indexing not supported!");
+		bindless = false;
+	}
+
+	_bindless = bindless;
+	_memoryBudget = checkMemoryBudgetSupport(_physicalDevice);
+	_presentWait = checkPresentWaitSupport(_physicalDevice);
+	_calibratedTimestamps = checkCalibratedTimestampsSupport(_instance, _physicalDevice);
+	_pushDescriptor = !_bindless && checkPushDescriptorSupport(_physicalDevice);
+	_timelineSemaphore = checkTimelineSemaphoreSupport(_physicalDevice);
+	_pipelineStatistics = checkPipelineStatisticsSupport(_physicalDevice);
+	_shadingRateMode =
+			checkShadingRateSupport(_physicalDevice, shadingRateMode, _shadingRateTexelSize);
+
+	if (!checkAttachmentFormatSupport(_physicalDevice, _colorFormat,
+				vk::FormatFeatureFlagBits::eColorAttachment |
+						vk::FormatFeatureFlagBits::eSampledImage)) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Color format not supported!");
+		_colorFormat = DEFAULT_COLOR_FORMAT;
+	}
+
+	if (!checkAttachmentFormatSupport(_physicalDevice, _depthFormat,
+				vk::FormatFeatureFlagBits::eDepthStencilAttachment |
+						vk::FormatFeatureFlagBits::eSampledImage)) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Depth format not supported!");
+		_depthFormat = DEFAULT_DEPTH_FORMAT;
+	}
+
+	if (_shadingRateMode == ShadingRateMode::Off && shadingRateMode != ShadingRateMode::Off)
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Fragment shading rate not supported!");
+	else if (_shadingRateMode != shadingRateMode)
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Fragment shading rate attachment not supported!");
+
+	_device = createDevice(_physicalDevice, surface, _validation, _bindless, _memoryBudget,
+			_presentWait, _calibratedTimestamps, _pushDescriptor, _timelineSemaphore,
+			_pipelineStatistics, _shadingRateMode);
+
+	if (_presentWait) {
+		_pfnWaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+				vkGetDeviceProcAddr(_device, "vkWaitForPresentKHR"));
+		_presentWait = _pfnWaitForPresent != nullptr;
+	}
+
+	if (_calibratedTimestamps) {
+		_pfnGetCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+				vkGetDeviceProcAddr(_device, "vkGetCalibratedTimestampsEXT"));
+		_calibratedTimestamps = _pfnGetCalibratedTimestamps != nullptr;
+	}
+
+	if (_pushDescriptor) {
+		_pfnPushDescriptorSetWithTemplate =
+				reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+						vkGetDeviceProcAddr(_device, "vkCmdPushDescriptorSetWithTemplateKHR"));
+		_pushDescriptor = _pfnPushDescriptorSetWithTemplate != nullptr;
+	}
+
+	if (_timelineSemaphore) {
+		_pfnGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+				vkGetDeviceProcAddr(_device, "vkGetSemaphoreCounterValueKHR"));
+		_pfnWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+				vkGetDeviceProcAddr(_device, "vkWaitSemaphoresKHR"));
+		_timelineSemaphore = _pfnGetSemaphoreCounterValue != nullptr &&
+				_pfnWaitSemaphores != nullptr;
+	}
+
+	if (_shadingRateMode != ShadingRateMode::Off) {
+		_pfnSetFragmentShadingRate = reinterpret_cast<PFN_vkCmdSetFragmentShadingRateKHR>(
+				vkGetDeviceProcAddr(_device, "vkCmdSetFragmentShadingRateKHR"));
+		_pfnCreateRenderPass2 = reinterpret_cast<PFN_vkCreateRenderPass2KHR>(
+				vkGetDeviceProcAddr(_device, "vkCreateRenderPass2KHR"));
+
+		if (_pfnSetFragmentShadingRate == nullptr)
+			_shadingRateMode = ShadingRateMode::Off;
+		else if (_pfnCreateRenderPass2 == nullptr)
+			_shadingRateMode = ShadingRateMode::Draw;
+	}
 
 	QueueFamilyIndices indices = findQueueFamilies(_physicalDevice, surface);
 	_graphicsQueue = _device.getQueue(indices.graphicsFamily, 0);
 	_presentQueue = _device.getQueue(indices.presentFamily, 0);
+	_transferQueue = _device.getQueue(indices.transferFamily, 0);
+	_computeQueue = _device.getQueue(indices.computeFamily, 0);
 
 	_graphicsQueueFamily = indices.graphicsFamily;
+	_transferQueueFamily = indices.transferFamily;
+	_computeQueueFamily = indices.computeFamily;
+
+	VmaAllocatorCreateInfo allocatorCreateInfo = {};
+	allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+	allocatorCreateInfo.instance = _instance;
+	allocatorCreateInfo.physicalDevice = _physicalDevice;
+	allocatorCreateInfo.device = _device;
+
+	if (_memoryBudget)
+		allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+
+	{
+		VkResult err = vmaCreateAllocator(&allocatorCreateInfo, &_allocator);
+
+		if (err != VK_SUCCESS)
+			throw std::runtime_error("VmaAllocator creation failed!");
+	}
 
 	_createSwapchain(width, height);
+	_createAttachments(_renderExtent.width, _renderExtent.height);
 
 	vk::CommandPoolCreateInfo createInfo = {};
 	createInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
@@ -563,14 +1637,177 @@ void VulkanContext::initialize(vk::SurfaceKHR surface, uint32_t width, uint32_t
 
 	_commandPool = _device.createCommandPool(createInfo);
 
+	_createPipelineCache();
+
 	_initialized = true;
 }
 
-void VulkanContext::recreateSwapchain(uint32_t width, uint32_t height) {
-	_device.waitIdle();
+VulkanContext::RetiredSwapchain VulkanContext::recreateSwapchain(
+		uint32_t width, uint32_t height) {
+	RetiredSwapchain retired = {};
+	retired.swapchain = _swapchain;
+	retired.images = std::move(_swapchainImages);
+	retired.offscreenImages = std::move(_offscreenImages);
 
-	_destroySwapchain();
-	_createSwapchain(width, height);
+	_swapchainImages.clear();
+	_offscreenImages.clear();
+
+	_createSwapchain(width, height, retired.swapchain);
+
+	// attachments only grow, smaller render extent is drawn at their top left
+	if (_renderExtent.width > _attachmentExtent.width ||
+			_renderExtent.height > _attachmentExtent.height) {
+		retired.attachments = { _color, _depth };
+
+		if (_deferred) {
+			retired.attachments.push_back(_albedo);
+			retired.attachments.push_back(_normal);
+			retired.attachments.push_back(_material);
+		}
+
+		if (_shadingRateMode == ShadingRateMode::Image)
+			retired.attachments.push_back(_shadingRate);
+
+		retired.framebuffer = _framebuffer;
+
+		_createAttachments(std::max(_renderExtent.width, _attachmentExtent.width),
+				std::max(_renderExtent.height, _attachmentExtent.height));
+	}
+
+	return retired;
+}
+
+void VulkanContext::destroyRetired(RetiredSwapchain &retired) {
+	for (Attachment &attachment : retired.attachments)
+		attachment.destroy(_allocator, _device);
+	retired.attachments.clear();
+
+	if (retired.framebuffer)
+		_device.destroyFramebuffer(retired.framebuffer, nullptr);
+
+	for (SwapchainImageResource &image : retired.images) {
+		_device.destroyFramebuffer(image.framebuffer, nullptr);
+		_device.destroyImageView(image.view, nullptr);
+	}
+	retired.images.clear();
+
+	for (Attachment &image : retired.offscreenImages)
+		image.destroy(_allocator, _device);
+	retired.offscreenImages.clear();
+
+	if (retired.swapchain)
+		_device.destroySwapchainKHR(retired.swapchain, nullptr);
+
+	retired.framebuffer = nullptr;
+	retired.swapchain = nullptr;
+}
+
+void VulkanContext::setDeviceSelection(const std::string &selection) {
+	_deviceSelection = selection;
+}
+
+void VulkanContext::setPresentMode(vk::PresentModeKHR presentMode) {
+	_desiredPresentMode = presentMode;
+}
+
+void VulkanContext::setAttachmentFormats(vk::Format colorFormat, vk::Format depthFormat) {
+	// render passes and every pipeline are built for them
+	if (_initialized)
+		return;
+
+	_colorFormat = colorFormat;
+	_depthFormat = depthFormat;
+}
+
+vk::Format VulkanContext::getColorFormat() const {
+	return _colorFormat;
+}
+
+vk::Format VulkanContext::getDepthFormat() const {
+	return _depthFormat;
+}
+
+void VulkanContext::setRenderScale(float scale) {
+	_renderScale = std::clamp(scale, MIN_RENDER_SCALE, 1.0f);
+}
+
+float VulkanContext::getRenderScale() const {
+	return _renderScale;
+}
+
+vk::PresentModeKHR VulkanContext::getPresentMode() const {
+	return _presentMode;
+}
+
+bool VulkanContext::waitForPresent(uint64_t presentId, uint64_t timeout) {
+	if (!_presentWait)
+		return false;
+
+	VkResult result = _pfnWaitForPresent(_device, _swapchain, presentId, timeout);
+	return result == VK_SUCCESS;
+}
+
+vk::Semaphore VulkanContext::createTimelineSemaphore(uint64_t initialValue) const {
+	vk::SemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.setSemaphoreType(vk::SemaphoreType::eTimeline);
+	typeInfo.setInitialValue(initialValue);
+
+	vk::SemaphoreCreateInfo createInfo = {};
+	createInfo.setPNext(&typeInfo);
+
+	return _device.createSemaphore(createInfo);
+}
+
+uint64_t VulkanContext::getSemaphoreCounterValue(vk::Semaphore semaphore) const {
+	uint64_t value = 0;
+	_pfnGetSemaphoreCounterValue(_device, semaphore, &value);
+
+	return value;
+}
+
+bool VulkanContext::waitSemaphore(vk::Semaphore semaphore, uint64_t value, uint64_t timeout) const {
+	VkSemaphore handle = semaphore;
+
+	VkSemaphoreWaitInfoKHR waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &handle;
+	waitInfo.pValues = &value;
+
+	return _pfnWaitSemaphores(_device, &waitInfo, timeout) == VK_SUCCESS;
+}
+
+bool VulkanContext::getDeviceTimestamp(uint64_t &timestamp) const {
+	if (!_calibratedTimestamps)
+		return false;
+
+	VkCalibratedTimestampInfoEXT info = {};
+	info.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	info.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+
+	uint64_t maxDeviation = 0;
+	VkResult result = _pfnGetCalibratedTimestamps(_device, 1, &info, &timestamp, &maxDeviation);
+
+	return result == VK_SUCCESS;
+}
+
+void VulkanContext::pushDescriptorSet(vk::CommandBuffer commandBuffer,
+		vk::DescriptorUpdateTemplate updateTemplate, vk::PipelineLayout layout, uint32_t set,
+		const void *pData) const {
+	_pfnPushDescriptorSetWithTemplate(commandBuffer, updateTemplate, layout, set, pData);
+}
+
+void VulkanContext::setFragmentShadingRate(
+		vk::CommandBuffer commandBuffer, vk::Extent2D fragmentSize) const {
+	// rate of primitive is never written, rate of image is only there with one
+	VkFragmentShadingRateCombinerOpKHR combinerOps[2] = {
+		VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR,
+		_shadingRateMode == ShadingRateMode::Image ? VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MAX_KHR
+												   : VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR,
+	};
+
+	VkExtent2D size = fragmentSize;
+	_pfnSetFragmentShadingRate(commandBuffer, &size, combinerOps);
 }
 
 vk::Instance VulkanContext::getInstance() const {
@@ -601,6 +1838,22 @@ uint32_t VulkanContext::getGraphicsQueueFamily() const {
 	return _graphicsQueueFamily;
 }
 
+vk::Queue VulkanContext::getTransferQueue() const {
+	return _transferQueue;
+}
+
+uint32_t VulkanContext::getTransferQueueFamily() const {
+	return _transferQueueFamily;
+}
+
+vk::Queue VulkanContext::getComputeQueue() const {
+	return _computeQueue;
+}
+
+uint32_t VulkanContext::getComputeQueueFamily() const {
+	return _computeQueueFamily;
+}
+
 vk::SwapchainKHR VulkanContext::getSwapchain() const {
 	return _swapchain;
 }
@@ -609,11 +1862,47 @@ vk::Extent2D VulkanContext::getSwapchainExtent() const {
 	return _swapchainExtent;
 }
 
+vk::Extent2D VulkanContext::getRenderExtent() const {
+	return _renderExtent;
+}
+
 vk::RenderPass VulkanContext::getRenderPass() const {
 	return _renderPass;
 }
 
-vk::Framebuffer VulkanContext::getFramebuffer(uint32_t imageIndex) const {
+vk::Image VulkanContext::getFinalImage(uint32_t imageIndex) const {
+	return _swapchainImages[imageIndex].image;
+}
+
+vk::Format VulkanContext::getFinalFormat() const {
+	return _finalFormat;
+}
+
+vk::ImageLayout VulkanContext::getFinalLayout() const {
+	return _headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+}
+
+bool VulkanContext::isReadbackSupported() const {
+	return _isReadbackSupported;
+}
+
+vk::Extent2D VulkanContext::getAttachmentExtent() const {
+	return _attachmentExtent;
+}
+
+uint64_t VulkanContext::getAttachmentVersion() const {
+	return _attachmentVersion;
+}
+
+vk::Framebuffer VulkanContext::getFramebuffer() const {
+	return _framebuffer;
+}
+
+vk::RenderPass VulkanContext::getTonemapRenderPass() const {
+	return _tonemapRenderPass;
+}
+
+vk::Framebuffer VulkanContext::getTonemapFramebuffer(uint32_t imageIndex) const {
 	return _swapchainImages[imageIndex].framebuffer;
 }
 
@@ -621,24 +1910,104 @@ Attachment VulkanContext::getColorAttachment() const {
 	return _color;
 }
 
+Attachment VulkanContext::getDepthAttachment() const {
+	return _depth;
+}
+
+Attachment VulkanContext::getAlbedoAttachment() const {
+	return _albedo;
+}
+
+Attachment VulkanContext::getNormalAttachment() const {
+	return _normal;
+}
+
+Attachment VulkanContext::getMaterialAttachment() const {
+	return _material;
+}
+
+Attachment VulkanContext::getShadingRateAttachment() const {
+	return _shadingRate;
+}
+
+vk::Extent2D VulkanContext::getShadingRateTexelSize() const {
+	return _shadingRateTexelSize;
+}
+
 vk::CommandPool VulkanContext::getCommandPool() const {
 	return _commandPool;
 }
 
-VulkanContext::VulkanContext(bool validation) {
+vk::PipelineCache VulkanContext::getPipelineCache() const {
+	return _pipelineCache;
+}
+
+VmaAllocator VulkanContext::getAllocator() const {
+	return _allocator;
+}
+
+bool VulkanContext::isBindlessEnabled() const {
+	return _bindless;
+}
+
+bool VulkanContext::isDeferredEnabled() const {
+	return _deferred;
+}
+
+bool VulkanContext::isMemoryBudgetEnabled() const {
+	return _memoryBudget;
+}
+
+bool VulkanContext::isPresentWaitEnabled() const {
+	return _presentWait;
+}
+
+bool VulkanContext::isCalibratedTimestampsEnabled() const {
+	return _calibratedTimestamps;
+}
+
+bool VulkanContext::isTimelineSemaphoreEnabled() const {
+	return _timelineSemaphore;
+}
+
+bool VulkanContext::isPipelineStatisticsEnabled() const {
+	return _pipelineStatistics;
+}
+
+bool VulkanContext::isPushDescriptorEnabled() const {
+	return _pushDescriptor;
+}
+
+ShadingRateMode VulkanContext::getShadingRateMode() const {
+	return _shadingRateMode;
+}
+
+bool VulkanContext::isHeadless() const {
+	return _headless;
+}
+
+VulkanContext::VulkanContext(bool validation, bool headless) {
 	if (validation && !checkValidationLayerSupport()) {
 		SDL_LogWarn(SDL_LOG_PRIORITY_WARN, "Validation not supported!");
 		validation = false;
 	}
 
 	this->_validation = validation;
-	_instance = createInstance(validation, &_debugMessenger);
+	_headless = headless;
+	_instance = createInstance(validation, headless, &_debugMessenger);
 }
 
 VulkanContext::~VulkanContext() {
 	if (_initialized) {
 		_destroySwapchain();
+		_destroyAttachments();
+
+		_device.destroyRenderPass(_renderPass, nullptr);
+		_device.destroyRenderPass(_tonemapRenderPass, nullptr);
+
+		savePipelineCache();
 
+		_device.destroyPipelineCache(_pipelineCache);
 		_device.destroyCommandPool(_commandPool);
 		_device.destroy();
 
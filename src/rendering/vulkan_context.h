@@ -2,11 +2,13 @@
 #define VULKAN_CONTEXT_H
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include <vulkan/vulkan.hpp>
 
 #include "types/attachment.h"
+#include "types/frame.h"
 
 const std::vector<const char *> VALIDATION_LAYERS = { "VK_LAYER_KHRONOS_validation" };
 
@@ -15,13 +17,102 @@ const std::vector<const char *> DEVICE_EXTENSIONS = {
 	VK_KHR_MULTIVIEW_EXTENSION_NAME,
 };
 
+// optional, enabled with bindless materials
+const std::vector<const char *> BINDLESS_DEVICE_EXTENSIONS = {
+	VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+	VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+};
+
+// optional, lets allocator report budget driver actually grants instead of estimate
+const char *const MEMORY_BUDGET_DEVICE_EXTENSION = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+
+// optional, GPU timestamps are read without a submit so traces line up with CPU zones
+const char *const CALIBRATED_TIMESTAMPS_DEVICE_EXTENSION =
+		VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+
+// optional, material textures are pushed into command buffer instead of bound as sets, not used
+// with bindless materials, which have no per draw sets
+const char *const PUSH_DESCRIPTOR_DEVICE_EXTENSION = VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME;
+
+// optional, uploads signal one counter per queue instead of a fence and semaphore per batch,
+// and go out with graphics work of frame in one submit
+const char *const TIMELINE_SEMAPHORE_DEVICE_EXTENSION = VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME;
+
+// optional, low latency mode waits until previous frame is on screen
+const std::vector<const char *> PRESENT_WAIT_DEVICE_EXTENSIONS = {
+	VK_KHR_PRESENT_ID_EXTENSION_NAME,
+	VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+};
+
+// optional, coarse shading of whole draws, or of screen tiles through an image render pass 2
+// carries to subpass
+const std::vector<const char *> SHADING_RATE_DEVICE_EXTENSIONS = {
+	VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+	VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME,
+};
+
+// wanted size of pixel tile one texel of shading rate image covers, clamped to device limits
+const uint32_t SHADING_RATE_TEXEL_SIZE = 16;
+
+// final color of headless context, bytes match swapchain format usually picked
+const vk::Format HEADLESS_COLOR_FORMAT = vk::Format::eB8G8R8A8Srgb;
+
+// of scene color and depth, unsupported ones fall back to them
+const vk::Format DEFAULT_COLOR_FORMAT = vk::Format::eB10G11R11UfloatPack32;
+const vk::Format DEFAULT_DEPTH_FORMAT = vk::Format::eD32Sfloat;
+
+// bumped whenever file layout changes, older files are then ignored
+const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// smallest fraction of swapchain extent scene is rendered at
+const float MIN_RENDER_SCALE = 0.125f;
+
+// subpasses of scene render pass, tonemapping has a render pass of its own
 const uint32_t DEPTH_PASS = 0;
 const uint32_t MAIN_PASS = 1;
-const uint32_t TONEMAP_PASS = 2;
+
+// deferred path, g-buffer is written in place of main pass and shaded in lighting pass
+const uint32_t GBUFFER_PASS = 1;
+const uint32_t LIGHTING_PASS = 2;
+
+// how fragment shading rate of material pass is picked, lower mode where device lacks support
+enum class ShadingRateMode {
+	Off,
+	// by draw, from material and distance
+	Draw,
+	// by draw and by tile, coarsest of both, tiles from luminance variance of previous frame
+	Image,
+};
 
 class VulkanContext {
 private:
 	bool _validation = false;
+	bool _bindless = false;
+	bool _deferred = false;
+	bool _memoryBudget = false;
+	bool _presentWait = false;
+	bool _calibratedTimestamps = false;
+	bool _pushDescriptor = false;
+	bool _timelineSemaphore = false;
+	bool _pipelineStatistics = false;
+	ShadingRateMode _shadingRateMode = ShadingRateMode::Off;
+	// no surface, final color goes to offscreen images read back by caller
+	bool _headless = false;
+
+	PFN_vkWaitForPresentKHR _pfnWaitForPresent = nullptr;
+	PFN_vkGetCalibratedTimestampsEXT _pfnGetCalibratedTimestamps = nullptr;
+	PFN_vkCmdPushDescriptorSetWithTemplateKHR _pfnPushDescriptorSetWithTemplate = nullptr;
+	PFN_vkCmdSetFragmentShadingRateKHR _pfnSetFragmentShadingRate = nullptr;
+	PFN_vkCreateRenderPass2KHR _pfnCreateRenderPass2 = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR _pfnGetSemaphoreCounterValue = nullptr;
+	PFN_vkWaitSemaphoresKHR _pfnWaitSemaphores = nullptr;
+
+	// requested one, falls back to fifo where surface does not support it
+	vk::PresentModeKHR _desiredPresentMode = vk::PresentModeKHR::eMailbox;
+	vk::PresentModeKHR _presentMode = vk::PresentModeKHR::eFifo;
+
+	// index or part of name, best scored device is picked without it
+	std::string _deviceSelection;
 
 	vk::Instance _instance;
 	VkDebugUtilsMessengerEXT _debugMessenger;
@@ -29,35 +120,146 @@ private:
 	vk::SurfaceKHR _surface;
 	vk::PhysicalDevice _physicalDevice;
 	vk::Device _device;
+	VmaAllocator _allocator;
 
 	vk::Queue _graphicsQueue;
 	vk::Queue _presentQueue;
+	vk::Queue _transferQueue;
+	vk::Queue _computeQueue;
 
 	uint32_t _graphicsQueueFamily;
+	uint32_t _transferQueueFamily;
+	uint32_t _computeQueueFamily;
 
 	typedef struct {
+		vk::Image image;
 		vk::ImageView view;
+		// of tonemap pass
 		vk::Framebuffer framebuffer;
 	} SwapchainImageResource;
 
 	std::vector<SwapchainImageResource> _swapchainImages;
+	// in place of swapchain images when headless, one per frame in flight
+	std::vector<Attachment> _offscreenImages;
 	vk::SwapchainKHR _swapchain;
 	vk::Extent2D _swapchainExtent;
+	// of swapchain images or offscreen ones
+	vk::Format _finalFormat = HEADLESS_COLOR_FORMAT;
+	// swapchain images can be copied from, always true when headless
+	bool _isReadbackSupported = false;
+
+	// of color and depth attachments
+	vk::Format _colorFormat = DEFAULT_COLOR_FORMAT;
+	vk::Format _depthFormat = DEFAULT_DEPTH_FORMAT;
+
+	// swapchain extent scaled by it
+	float _renderScale = 1.0f;
+	vk::Extent2D _renderExtent;
+	// attachments below are at least render extent, they are reallocated only to grow
+	vk::Extent2D _attachmentExtent;
+	// bumped whenever they are
+	uint64_t _attachmentVersion = 0;
+
+	// created with first swapchain, kept across recreation
 	vk::RenderPass _renderPass;
+	vk::Framebuffer _framebuffer;
+	// upscales and tonemaps color to final image
+	vk::RenderPass _tonemapRenderPass;
 
 	Attachment _color;
 	Attachment _depth;
 
+	// only with deferred path, never leave tile memory
+	Attachment _albedo;
+	Attachment _normal;
+	Attachment _material;
+
+	// with shading rate image only, one texel per tile of texel size
+	Attachment _shadingRate;
+	vk::Extent2D _shadingRateTexelSize;
+
 	vk::CommandPool _commandPool;
 
+	// seeded from user cache directory, file of other device or driver is ignored
+	vk::PipelineCache _pipelineCache;
+	size_t _pipelineCacheSize = 0;
+
 	bool _initialized = false;
 
-	void _createSwapchain(uint32_t width, uint32_t height);
+	void _createSwapchain(
+			uint32_t width, uint32_t height, vk::SwapchainKHR oldSwapchain = nullptr);
+	void _createAttachments(uint32_t width, uint32_t height);
+	void _createRenderPasses();
+	void _destroyAttachments();
 	void _destroySwapchain();
 
+	void _createPipelineCache();
+
 public:
-	void initialize(vk::SurfaceKHR surface, uint32_t width, uint32_t height);
-	void recreateSwapchain(uint32_t width, uint32_t height);
+	// left behind by swapchain recreation, destroyed once frames which used it are finished
+	typedef struct {
+		vk::SwapchainKHR swapchain;
+		std::vector<SwapchainImageResource> images;
+		std::vector<Attachment> offscreenImages;
+		// empty unless attachments grew
+		std::vector<Attachment> attachments;
+		vk::Framebuffer framebuffer;
+	} RetiredSwapchain;
+
+	// surface is null when headless, swapchain extent is then width and height as given
+	void initialize(vk::SurfaceKHR surface, uint32_t width, uint32_t height, bool bindless = false,
+			bool deferred = false, ShadingRateMode shadingRateMode = ShadingRateMode::Off);
+	// device is not idled, old swapchain is chained into new one and returned to be destroyed
+	// with destroyRetired once frames in flight are done with it
+	RetiredSwapchain recreateSwapchain(uint32_t width, uint32_t height);
+	void destroyRetired(RetiredSwapchain &retired);
+
+	// of another window sharing device, images are only blitted to, in format written to
+	// format, false when headless or when present queue or blits can not reach surface
+	bool createWindowSwapchain(vk::SurfaceKHR surface, uint32_t width, uint32_t height,
+			vk::SwapchainKHR oldSwapchain, vk::SwapchainKHR &swapchain, vk::Extent2D &extent,
+			vk::Format &format);
+
+	// before initialize, index among devices or part of name ignoring case, unsuitable or
+	// missing one falls back to best scored device
+	void setDeviceSelection(const std::string &selection);
+
+	// used from next swapchain creation on
+	void setPresentMode(vk::PresentModeKHR presentMode);
+	// of current swapchain
+	vk::PresentModeKHR getPresentMode() const;
+
+	// before initialize, of color and depth attachments, ones device can not render to and
+	// sample fall back to defaults
+	void setAttachmentFormats(vk::Format colorFormat, vk::Format depthFormat);
+	vk::Format getColorFormat() const;
+	vk::Format getDepthFormat() const;
+
+	// used from next swapchain creation on, clamped to MIN_RENDER_SCALE and 1
+	void setRenderScale(float scale);
+	float getRenderScale() const;
+
+	// present has to have been given id through vk::PresentIdKHR, false on timeout or when
+	// swapchain is out of date
+	bool waitForPresent(uint64_t presentId, uint64_t timeout);
+
+	// with timeline semaphores only
+	vk::Semaphore createTimelineSemaphore(uint64_t initialValue = 0) const;
+	uint64_t getSemaphoreCounterValue(vk::Semaphore semaphore) const;
+	// false on timeout or failure
+	bool waitSemaphore(vk::Semaphore semaphore, uint64_t value, uint64_t timeout) const;
+
+	// current value of timestamp queries write, false without calibrated timestamps
+	bool getDeviceTimestamp(uint64_t &timestamp) const;
+
+	// template has to be of push descriptors type, with push descriptors enabled only
+	void pushDescriptorSet(vk::CommandBuffer commandBuffer,
+			vk::DescriptorUpdateTemplate updateTemplate, vk::PipelineLayout layout, uint32_t set,
+			const void *pData) const;
+
+	// dynamic state of pipelines drawn with shading rate, combined with rate of image when there
+	// is one, coarser of both wins
+	void setFragmentShadingRate(vk::CommandBuffer commandBuffer, vk::Extent2D fragmentSize) const;
 
 	vk::Instance getInstance() const;
 
@@ -70,17 +272,72 @@ public:
 
 	uint32_t getGraphicsQueueFamily() const;
 
+	// same as graphics queue when there is no dedicated transfer family
+	vk::Queue getTransferQueue() const;
+	uint32_t getTransferQueueFamily() const;
+
+	// same as graphics queue when there is no async compute family, shares queue with transfer
+	// when both use the same family
+	vk::Queue getComputeQueue() const;
+	uint32_t getComputeQueueFamily() const;
+
 	vk::SwapchainKHR getSwapchain() const;
 	vk::Extent2D getSwapchainExtent() const;
+	// drawn by scene render pass, at top left of its attachments
+	vk::Extent2D getRenderExtent() const;
+	// of scene framebuffer and its attachments
+	vk::Extent2D getAttachmentExtent() const;
+	// changes whenever attachments are reallocated, sets reading them are written again
+	uint64_t getAttachmentVersion() const;
 
+	// scene, color is left in shader read only layout for tonemap pass
 	vk::RenderPass getRenderPass() const;
-	vk::Framebuffer getFramebuffer(uint32_t imageIndex) const;
+	vk::Framebuffer getFramebuffer() const;
+	vk::RenderPass getTonemapRenderPass() const;
+	vk::Framebuffer getTonemapFramebuffer(uint32_t imageIndex) const;
+	// swapchain image or offscreen one, in getFinalLayout once render pass ended
+	vk::Image getFinalImage(uint32_t imageIndex) const;
+	vk::Format getFinalFormat() const;
+	vk::ImageLayout getFinalLayout() const;
+	// final images can be read back, surface may not allow transfer usage
+	bool isReadbackSupported() const;
 
 	Attachment getColorAttachment() const;
+	Attachment getDepthAttachment() const;
+
+	Attachment getAlbedoAttachment() const;
+	Attachment getNormalAttachment() const;
+	Attachment getMaterialAttachment() const;
+
+	// read by main pass, left in fragment shading rate attachment layout by it
+	Attachment getShadingRateAttachment() const;
+	// pixels one texel of it covers
+	vk::Extent2D getShadingRateTexelSize() const;
 
 	vk::CommandPool getCommandPool() const;
 
-	VulkanContext(bool validation = false);
+	// every pipeline is created with it
+	vk::PipelineCache getPipelineCache() const;
+	// written only when pipelines were added since it was loaded or saved, failure is logged
+	void savePipelineCache();
+
+	// created with device, shared by rendering device
+	VmaAllocator getAllocator() const;
+
+	bool isBindlessEnabled() const;
+	bool isDeferredEnabled() const;
+	bool isMemoryBudgetEnabled() const;
+	bool isPresentWaitEnabled() const;
+	bool isCalibratedTimestampsEnabled() const;
+	bool isPushDescriptorEnabled() const;
+	bool isTimelineSemaphoreEnabled() const;
+	// pipeline statistics queries, inherited by secondary buffers
+	bool isPipelineStatisticsEnabled() const;
+	ShadingRateMode getShadingRateMode() const;
+	bool isHeadless() const;
+
+	// headless instance does not ask SDL for surface extensions, video needs no display
+	VulkanContext(bool validation = false, bool headless = false);
 	~VulkanContext();
 };
 
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include <SDL3/SDL_log.h>
+
+#include "vulkan_context.h"
+
+#include "window_target.h"
+
+bool WindowTarget::initialize(VulkanContext *pContext, vk::SurfaceKHR surface, uint32_t width,
+		uint32_t height, uint32_t framesInFlight) {
+	if (!pContext->createWindowSwapchain(
+				surface, width, height, nullptr, _swapchain, _extent, _format))
+		return false;
+
+	vk::Device device = pContext->getDevice();
+
+	_surface = surface;
+	_images = device.getSwapchainImagesKHR(_swapchain);
+	_width = width;
+	_height = height;
+
+	vk::SemaphoreCreateInfo semaphoreInfo = {};
+
+	for (uint32_t i = 0; i < framesInFlight; i++)
+		_acquireSemaphores[i] = device.createSemaphore(semaphoreInfo);
+
+	return true;
+}
+
+void WindowTarget::destroy(VulkanContext *pContext) {
+	vk::Device device = pContext->getDevice();
+
+	for (vk::Semaphore semaphore : _acquireSemaphores) {
+		if (semaphore)
+			device.destroySemaphore(semaphore);
+	}
+
+	device.destroySwapchainKHR(_swapchain);
+	pContext->getInstance().destroySurfaceKHR(_surface);
+
+	_images.clear();
+}
+
+void WindowTarget::resize(uint32_t width, uint32_t height) {
+	if (_width == width && _height == height)
+		return;
+
+	_width = width;
+	_height = height;
+	_isOutOfDate = true;
+}
+
+void WindowTarget::setRect(const glm::vec4 &rect) {
+	_rect = glm::clamp(rect, glm::vec4(0.0f), glm::vec4(1.0f));
+}
+
+vk::SwapchainKHR WindowTarget::update(VulkanContext *pContext) {
+	if (!_isOutOfDate)
+		return nullptr;
+
+	vk::SwapchainKHR oldSwapchain = _swapchain;
+	vk::SwapchainKHR swapchain;
+
+	// window is skipped while surface refuses, tried again on next frame
+	if (!pContext->createWindowSwapchain(
+				_surface, _width, _height, oldSwapchain, swapchain, _extent, _format)) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Window swapchain recreation failed!");
+		return nullptr;
+	}
+
+	_swapchain = swapchain;
+	_images = pContext->getDevice().getSwapchainImagesKHR(_swapchain);
+	_isOutOfDate = false;
+
+	return oldSwapchain;
+}
+
+bool WindowTarget::acquire(VulkanContext *pContext, uint32_t frame) {
+	_imageIndex = UINT32_MAX;
+
+	// minimized windows have no extent to present at
+	if (_isOutOfDate || _extent.width == 0 || _extent.height == 0)
+		return false;
+
+	vk::ResultValue<uint32_t> image = pContext->getDevice().acquireNextImageKHR(
+			_swapchain, 0, _acquireSemaphores[frame], VK_NULL_HANDLE);
+
+	if (image.result == vk::Result::eErrorOutOfDateKHR) {
+		_isOutOfDate = true;
+		return false;
+	}
+
+	if (image.result == vk::Result::eTimeout || image.result == vk::Result::eNotReady)
+		return false;
+
+	if (image.result != vk::Result::eSuccess && image.result != vk::Result::eSuboptimalKHR) {
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Window swapchain image acquisition failed!");
+		return false;
+	}
+
+	_imageIndex = image.value;
+
+	return true;
+}
+
+void WindowTarget::record(
+		vk::CommandBuffer commandBuffer, vk::Image finalImage, vk::Extent2D finalExtent) {
+	vk::Image image = _images[_imageIndex];
+	vk::ImageSubresourceRange subresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+	// whatever was presented before is overwritten as a whole
+	vk::ImageMemoryBarrier barrier;
+	barrier.setImage(image);
+	barrier.setSubresourceRange(subresourceRange);
+	barrier.setOldLayout(vk::ImageLayout::eUndefined);
+	barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+	barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barrier);
+
+	int32_t x0 = static_cast<int32_t>(_rect.x * finalExtent.width);
+	int32_t y0 = static_cast<int32_t>(_rect.y * finalExtent.height);
+	int32_t x1 = std::max(static_cast<int32_t>((_rect.x + _rect.z) * finalExtent.width), x0 + 1);
+	int32_t y1 = std::max(static_cast<int32_t>((_rect.y + _rect.w) * finalExtent.height), y0 + 1);
+
+	vk::ImageBlit region;
+	region.setSrcSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 });
+	region.setSrcOffsets({ vk::Offset3D(x0, y0, 0), vk::Offset3D(x1, y1, 1) });
+	region.setDstSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 });
+	region.setDstOffsets({ vk::Offset3D(0, 0, 0),
+			vk::Offset3D(static_cast<int32_t>(_extent.width),
+					static_cast<int32_t>(_extent.height), 1) });
+
+	// region is stretched to window, aspect follows size of window
+	commandBuffer.blitImage(finalImage, vk::ImageLayout::eTransferSrcOptimal, image,
+			vk::ImageLayout::eTransferDstOptimal, region, vk::Filter::eLinear);
+
+	// presentation waits on semaphore, nothing has to be made visible to it
+	barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+	barrier.setNewLayout(vk::ImageLayout::ePresentSrcKHR);
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask({});
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, nullptr, barrier);
+}
+
+void WindowTarget::presented(vk::Result result) {
+	_imageIndex = UINT32_MAX;
+
+	if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
+		_isOutOfDate = true;
+	else if (result != vk::Result::eSuccess)
+		SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Window swapchain image presentation failed!");
+}
+
+bool WindowTarget::isAcquired() const {
+	return _imageIndex != UINT32_MAX;
+}
+
+uint32_t WindowTarget::getImageIndex() const {
+	return _imageIndex;
+}
+
+vk::SwapchainKHR WindowTarget::getSwapchain() const {
+	return _swapchain;
+}
+
+vk::Semaphore WindowTarget::getAcquireSemaphore(uint32_t frame) const {
+	return _acquireSemaphores[frame];
+}
@@ -0,0 +1,71 @@
+#ifndef WINDOW_TARGET_H
+#define WINDOW_TARGET_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include "types/frame.h"
+
+class VulkanContext;
+
+// windows besides the one of window init, each adds an image to wait for on every submit
+const uint32_t MAX_WINDOW_COUNT = 4;
+
+// Surface, swapchain and acquire sync of a window sharing device, pipelines and attachments
+// with the one frames are rendered for. Nothing is rendered to its images, region of final image
+// is blitted into them after tonemap pass in command buffer of frame, they are presented along
+// with it by the same present. A window whose image is not ready yet skips the frame rather than
+// stalling every other one.
+class WindowTarget {
+private:
+	vk::SurfaceKHR _surface;
+	vk::SwapchainKHR _swapchain;
+	std::vector<vk::Image> _images;
+	vk::Extent2D _extent;
+	vk::Format _format;
+
+	vk::Semaphore _acquireSemaphores[MAX_FRAMES_IN_FLIGHT];
+
+	// offset and size within final image, normalized
+	glm::vec4 _rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	// swapchain is recreated before next acquire
+	bool _isOutOfDate = false;
+
+	// of frame being recorded, none unless acquire succeeded
+	uint32_t _imageIndex = UINT32_MAX;
+
+public:
+	// false when context can not present blits to surface, surface is then left to caller
+	bool initialize(VulkanContext *pContext, vk::SurfaceKHR surface, uint32_t width,
+			uint32_t height, uint32_t framesInFlight);
+	// surface goes too, swapchain images may not be in use anymore
+	void destroy(VulkanContext *pContext);
+
+	void resize(uint32_t width, uint32_t height);
+	void setRect(const glm::vec4 &rect);
+
+	// recreates swapchain first when it went out of date, old one is returned to be destroyed
+	// once frames in flight are done with it, null otherwise
+	vk::SwapchainKHR update(VulkanContext *pContext);
+
+	// does not wait, false when no image is ready, frame then skips window
+	bool acquire(VulkanContext *pContext, uint32_t frame);
+	// final image has to be in transfer source layout, image of window is left presentable
+	void record(vk::CommandBuffer commandBuffer, vk::Image finalImage, vk::Extent2D finalExtent);
+	// result of present for swapchain, image of frame is given up either way
+	void presented(vk::Result result);
+
+	bool isAcquired() const;
+	uint32_t getImageIndex() const;
+	vk::SwapchainKHR getSwapchain() const;
+	// signalled by acquire of frame, blit waits for it
+	vk::Semaphore getAcquireSemaphore(uint32_t frame) const;
+};
+
+#endif // !WINDOW_TARGET_H
@@ -1,132 +1,954 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <future>
+#include <memory>
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_timer.h>
 
 #include "io/asset_loader.h"
+#include "io/cell_portal_baker.h"
+#include "io/environment_cache.h"
+#include "io/light_probe_baker.h"
+#include "io/lightmap_baker.h"
+#include "io/static_batcher.h"
+#include "io/texture_atlas.h"
 #include "rendering/rendering_server.h"
+#include "asset_cache.h"
+#include "profiler.h"
 
 #include "scene.h"
 
-bool Scene::load(const std::filesystem::path &path) {
-	AssetLoader::Scene scene = AssetLoader::loadGltf(path);
+// factors of material, textures are left to caller
+static RS::MaterialInfo _getMaterialInfo(const AssetLoader::Material &sceneMaterial) {
+	RS::MaterialInfo info = {};
+	info.albedoFactor = sceneMaterial.albedoFactor;
+	info.emissiveFactor = sceneMaterial.emissiveFactor;
+	info.metallicFactor = sceneMaterial.metallicFactor;
+	info.roughnessFactor = sceneMaterial.roughnessFactor;
+	info.albedoRect = sceneMaterial.albedoRect;
+	info.normalRect = sceneMaterial.normalRect;
+	info.metallicRoughnessRect = sceneMaterial.metallicRoughnessRect;
+	info.deriveTangents = sceneMaterial.deriveTangents;
+
+	return info;
+}
+
+// texture of image of prefab loaded with hot reload, none for missing map
+static ObjectID _getImageTexture(const Prefab &prefab, const std::optional<uint64_t> &index) {
+	if (!index.has_value() || index.value() >= prefab.imageTextures.size())
+		return NULL_HANDLE;
+
+	return prefab.imageTextures[index.value()];
+}
+
+static bool _isSameMaterial(const AssetLoader::Material &a, const AssetLoader::Material &b) {
+	return a.albedoIndex == b.albedoIndex && a.normalIndex == b.normalIndex &&
+			a.metallicRoughnessIndex == b.metallicRoughnessIndex &&
+			a.lightmapIndex == b.lightmapIndex && a.albedoFactor == b.albedoFactor &&
+			a.emissiveFactor == b.emissiveFactor && a.metallicFactor == b.metallicFactor &&
+			a.roughnessFactor == b.roughnessFactor && a.albedoRect == b.albedoRect &&
+			a.normalRect == b.normalRect && a.metallicRoughnessRect == b.metallicRoughnessRect &&
+			a.deriveTangents == b.deriveTangents;
+}
+
+// everything but node transforms, materials, images and geometry, which are updated in place
+static bool _isSameLayout(const Prefab &prefab, const AssetLoader::Scene &scene) {
+	bool isSameSize = scene.images.size() == prefab.imageTextures.size() &&
+			scene.imageSources.size() == prefab.imageSources.size() &&
+			scene.materials.size() == prefab.materials.size() &&
+			scene.meshes.size() == prefab.meshes.size() &&
+			scene.nodes.size() == prefab.nodes.size() &&
+			scene.meshInstances.size() == prefab.meshInstances.size() &&
+			scene.skins.size() == prefab.skins.size() && scene.lights.size() == prefab.lights.size();
+
+	if (!isSameSize)
+		return false;
+
+	for (size_t i = 0; i < scene.imageSources.size(); i++) {
+		const AssetLoader::ImageSource &a = scene.imageSources[i];
+		const AssetLoader::ImageSource &b = prefab.imageSources[i];
+
+		if (a.path != b.path || a.usage != b.usage)
+			return false;
+	}
+
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		if (scene.nodes[i].parentIndex != prefab.nodes[i].parentIndex)
+			return false;
+	}
+
+	for (size_t i = 0; i < scene.meshInstances.size(); i++) {
+		const AssetLoader::MeshInstance &a = scene.meshInstances[i];
+		const AssetLoader::MeshInstance &b = prefab.meshInstances[i];
+
+		if (a.nodeIndex != b.nodeIndex || a.meshIndex != b.meshIndex ||
+				a.skinIndex != b.skinIndex || a.morphWeights != b.morphWeights)
+			return false;
+	}
+
+	for (size_t i = 0; i < scene.skins.size(); i++) {
+		const AssetLoader::Skin &a = scene.skins[i];
+		const AssetLoader::Skin &b = prefab.skins[i];
+
+		if (a.joints != b.joints || a.inverseBindMatrices != b.inverseBindMatrices)
+			return false;
+	}
+
+	for (size_t i = 0; i < scene.lights.size(); i++) {
+		const AssetLoader::Light &a = scene.lights[i];
+		const AssetLoader::Light &b = prefab.lights[i];
+
+		bool isSame = a.nodeIndex == b.nodeIndex && a.type == b.type && a.color == b.color &&
+				a.intensity == b.intensity && a.range == b.range && a.isBaked == b.isBaked;
+
+		if (!isSame)
+			return false;
+	}
+
+	return true;
+}
+
+// of converted image, nullptr for one which failed to load
+static uint64_t _hashImage(const std::shared_ptr<Image> &image) {
+	if (image == nullptr)
+		return 0;
+
+	uint32_t header[3] = {
+		static_cast<uint32_t>(image->getFormat()),
+		image->getWidth(),
+		image->getHeight(),
+	};
+
+	const std::vector<uint8_t> &data = image->getData();
+	uint64_t hash = EnvironmentCache::hash(header, sizeof(header));
+
+	return EnvironmentCache::hash(data.data(), data.size(), hash);
+}
+
+// before materials are mapped to ids, meshlets and levels follow from what is hashed
+static uint64_t _hashMesh(const Mesh &mesh) {
+	uint64_t hash = EnvironmentCache::hash(&mesh.primitiveCount, sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const Primitive &primitive = mesh.pPrimitives[i];
+
+		hash = EnvironmentCache::hash(
+				primitive.vertices.pData, primitive.vertices.count * sizeof(Vertex), hash);
+		hash = EnvironmentCache::hash(
+				primitive.indices.pData, primitive.indices.count * sizeof(uint32_t), hash);
+		hash = EnvironmentCache::hash(&primitive.materialIndex, sizeof(uint64_t), hash);
+
+		for (uint32_t j = 0; j < primitive.morphTargets.count; j++) {
+			const MorphTarget &target = primitive.morphTargets.pData[j];
+			hash = EnvironmentCache::hash(
+					target.pDeltas, target.deltaCount * sizeof(MorphDelta), hash);
+		}
+	}
+
+	return hash;
+}
+
+// of every primitive, empty mesh gets a point at origin, morph targets at full weight each grow
+// it by their largest offset
+static AABB _getBounds(const Mesh &mesh) {
+	AABB bounds;
+	bool isEmpty = true;
+
+	for (uint32_t i = 0; i < mesh.primitiveCount; i++) {
+		const VertexArray &vertices = mesh.pPrimitives[i].vertices;
+
+		for (uint32_t j = 0; j < vertices.count; j++) {
+			if (isEmpty)
+				bounds = { vertices.pData[j].position, vertices.pData[j].position };
+
+			bounds.expand(vertices.pData[j].position);
+			isEmpty = false;
+		}
+	}
+
+	glm::vec3 morphExtent = getMorphExtent(mesh);
+	bounds = { bounds.min - morphExtent, bounds.max + morphExtent };
+
+	return bounds;
+}
+
+static void _hashScene(const AssetLoader::Scene &scene, std::vector<uint64_t> &imageHashes,
+		std::vector<uint64_t> &meshHashes) {
+	for (const std::shared_ptr<Image> &image : scene.images)
+		imageHashes.push_back(_hashImage(image));
+
+	for (const Mesh &mesh : scene.meshes)
+		meshHashes.push_back(_hashMesh(mesh));
+}
+
+uint64_t Scene::_createMaterialTextures(size_t material) {
+	const AssetLoader::Material &sceneMaterial = _decoded.materials[material];
+
+	std::optional<uint64_t> indices[MATERIAL_TEXTURE_COUNT] = {
+		sceneMaterial.albedoIndex,
+		sceneMaterial.normalIndex,
+		sceneMaterial.metallicRoughnessIndex,
+		sceneMaterial.lightmapIndex,
+	};
+
+	ObjectID textures[MATERIAL_TEXTURE_COUNT] = {};
+	uint64_t size = 0;
+	bool hasTextures = false;
+
+	for (size_t i = 0; i < MATERIAL_TEXTURE_COUNT; i++) {
+		if (!indices[i].has_value())
+			continue;
+
+		uint64_t imageIndex = indices[i].value();
+		ObjectID &texture = _imageTextures[imageIndex];
+
+		if (texture == NULL_HANDLE) {
+			std::shared_ptr<Image> image = _decoded.images[imageIndex];
+
+			// image that failed to decode keeps fallback
+			if (image == nullptr)
+				continue;
+
+			texture = RS::getSingleton().textureCreate(image);
+			_prefab->textures.push_back(texture);
+
+			size += image->getByteSize();
+
+			// RS holds image until it is staged, pixels go once upload is done with them
+			_decoded.images[imageIndex] = nullptr;
+		}
+
+		textures[i] = texture;
+		hasTextures = true;
+	}
+
+	// material without textures already has everything
+	if (!hasTextures)
+		return size;
+
+	RS::MaterialInfo info = _getMaterialInfo(sceneMaterial);
+	info.albedo = textures[0];
+	info.normal = textures[1];
+	info.metallicRoughness = textures[2];
+	info.lightmap = textures[3];
+
+	RS::getSingleton().materialUpdate(_prefab->materials[material], info);
+	return size;
+}
+
+uint64_t Scene::_createMesh(size_t mesh) {
+	const Mesh &sceneMesh = _decoded.meshes[mesh];
+	uint64_t size = 0;
+
+	for (uint32_t i = 0; i < sceneMesh.primitiveCount; i++) {
+		Primitive &primitive = sceneMesh.pPrimitives[i];
+		primitive.materialIndex = _prefab->materials[primitive.materialIndex];
+
+		size += primitive.vertices.count * sizeof(PackedVertex);
+		size += primitive.indices.count * sizeof(uint32_t);
+	}
+
+	ObjectID _mesh = RS::getSingleton().meshCreate(sceneMesh);
+	_prefab->meshes.push_back(_mesh);
+	_prefab->meshBounds.push_back(_getBounds(sceneMesh));
+
+	return size;
+}
+
+void Scene::_createMeshInstance(
+		const Prefab &prefab, const AssetLoader::MeshInstance &meshInstance, uint32_t first) {
+	uint32_t node = first + static_cast<uint32_t>(meshInstance.nodeIndex);
+
+	ObjectID _meshInstance = RS::getSingleton().meshInstanceCreate();
+	RS::getSingleton().meshInstanceSetMesh(_meshInstance, prefab.meshes[meshInstance.meshIndex]);
+	_graph.meshInstanceAttach(node, _meshInstance);
+
+	// mesh is drawn in its base shape without them
+	if (!meshInstance.morphWeights.empty())
+		RS::getSingleton().meshInstanceSetMorphWeights(_meshInstance, meshInstance.morphWeights);
+
+	bool isSkinned = meshInstance.skinIndex.has_value() &&
+			meshInstance.skinIndex.value() < prefab.skins.size();
+
+	// empty skin keeps bind pose
+	if (isSkinned) {
+		const AssetLoader::Skin &skin = prefab.skins[meshInstance.skinIndex.value()];
+		std::vector<uint32_t> joints;
+
+		for (uint64_t joint : skin.joints)
+			joints.push_back(first + static_cast<uint32_t>(joint));
+
+		_graph.meshInstanceSkin(node, _meshInstance, joints, skin.inverseBindMatrices);
+	}
+
+	_entities.meshInstanceCreate(
+			_graph, node, _meshInstance, prefab.meshBounds[meshInstance.meshIndex], isSkinned);
+}
+
+void Scene::_createLight(const AssetLoader::Light &sceneLight, uint32_t node) {
+	float range = sceneLight.range.value_or(0.0f);
+	glm::vec3 color = sceneLight.color;
+	float intensity = sceneLight.intensity;
+
+	ObjectID _light;
+
+	switch (sceneLight.type) {
+		case AssetLoader::LightType::Directional:
+			_light = RS::getSingleton().lightCreate(LightType::Directional);
+			break;
+		case AssetLoader::LightType::Point:
+			_light = RS::getSingleton().lightCreate(LightType::Point);
+			break;
+	}
+
+	_graph.lightAttach(node, _light);
+	RS::getSingleton().lightSetRange(_light, range);
+	RS::getSingleton().lightSetColor(_light, color);
+	RS::getSingleton().lightSetIntensity(_light, intensity);
+
+	// lightmap holds light and its shadows already
+	if (sceneLight.isBaked)
+		RS::getSingleton().lightSetBaked(_light, true);
+
+	// point lights are many, shadow atlas is reserved for sun
+	if (sceneLight.type == AssetLoader::LightType::Directional && !sceneLight.isBaked)
+		RS::getSingleton().lightSetShadow(_light, true);
+
+	_entities.lightCreate(_graph, node, _light, range);
+}
+
+uint32_t Scene::_addNodes(const std::vector<AssetLoader::Node> &nodes, uint32_t parent) {
+	uint32_t first = _graph.getNodeCount();
+
+	// one graph node per node, out of order ones are parented like roots
+	for (const AssetLoader::Node &node : nodes) {
+		uint32_t nodeParent = node.parentIndex.has_value()
+				? first + static_cast<uint32_t>(node.parentIndex.value())
+				: parent;
+
+		if (_graph.nodeAdd(node.transform, nodeParent) == SCENE_GRAPH_NO_NODE)
+			_graph.nodeAdd(node.transform, parent);
+	}
+
+	// world transforms are ready for instances attached later
+	_graph.update();
+
+	return first;
+}
+
+void Scene::_instantiate(const Prefab &prefab, uint32_t parent) {
+	uint32_t first = _addNodes(prefab.nodes, parent);
+
+	if (!prefab.animations.empty())
+		_animator.play(prefab.animations[0], first, _graph);
+
+	for (const AssetLoader::MeshInstance &meshInstance : prefab.meshInstances)
+		_createMeshInstance(prefab, meshInstance, first);
+
+	for (const AssetLoader::Light &light : prefab.lights)
+		_createLight(light, first + static_cast<uint32_t>(light.nodeIndex));
+}
+
+size_t Scene::_getStageSize() const {
+	switch (_stage) {
+		case LoadStage::Materials:
+			return _decoded.materials.size();
+		case LoadStage::Meshes:
+			return _decoded.meshes.size();
+		case LoadStage::MeshInstances:
+			return _decoded.meshInstances.size();
+		case LoadStage::Lights:
+			return _decoded.lights.size();
+		case LoadStage::Textures:
+			return _decoded.materials.size();
+		default:
+			return 0;
+	}
+}
+
+bool Scene::_load(const std::filesystem::path &path, const LoadOptions &options, bool isCached) {
+	PROFILE_ZONE("scene load");
+
+	// taken before clear, so loading same file again keeps its resources
+	std::string key = AssetCache::getKey(path);
+
+	// batched prefab has other meshes and instances, it is cached apart
+	if (!key.empty() && options.isStaticBatched)
+		key += "|static";
+
+	if (!key.empty() && options.isAtlased)
+		key += "|atlas";
+
+	if (!key.empty() && options.isProbed)
+		key += "|probes";
+
+	if (!key.empty() && options.isLightmapped)
+		key += "|lightmaps";
+
+	if (!key.empty() && options.isTangentDerived)
+		key += "|tangents";
+
+	std::shared_ptr<Prefab> cached = isCached ? AssetCache::acquire(key) : nullptr;
+
+	clear();
+
+	_loadPath = path;
+	_loadOptions = options;
+
+	if (cached != nullptr) {
+		_prefab = cached;
+		_prefabs.push_back(cached);
+		_nodeOffset = _graph.getNodeCount();
+		_instantiate(*cached, SCENE_GRAPH_NO_NODE);
+
+		if (!cached->lightProbes.probes.empty()) {
+			RS::getSingleton().lightProbesSet(cached->lightProbes);
+			_hasLightProbes = true;
+		}
+
+		if (!cached->cellPortals.cells.empty()) {
+			RS::getSingleton().cellPortalsSet(cached->cellPortals);
+			_hasCellPortals = true;
+		}
+
+		_watch();
+		return true;
+	}
+
+	_loadKey = key;
+
+	std::filesystem::path file = path;
+	bool isHashed = _isHotReload;
+
+	_decodeCancel = CancelToken();
+	CancelToken cancel = _decodeCancel;
+
+	// cancelled decode returns whatever it has, steps after loading are skipped
+	_decode = JobSystem::async([file, options, isHashed, cancel]() {
+		PROFILE_ZONE("scene decode");
 
-	for (const AssetLoader::Material &sceneMaterial : scene.materials) {
-		RS::MaterialInfo info;
+		Decoded decoded;
+		AssetLoader::Scene &scene = decoded.scene;
 
-		std::optional<size_t> albedoIndex = sceneMaterial.albedoIndex;
-		if (albedoIndex.has_value()) {
-			std::shared_ptr<Image> albedoMap = scene.images[albedoIndex.value()];
+		if (file.extension() == ".hyk")
+			scene = AssetLoader::loadCooked(file);
+		else
+			scene = AssetLoader::loadGltf(file, true, options.isTangentDerived, cancel);
 
-			ObjectID t = RS::getSingleton().textureCreate(albedoMap);
-			_textures.push_back(t);
+		if (cancel.isCancelled())
+			return decoded;
 
-			info.albedo = t;
+		if (options.isStaticBatched)
+			StaticBatcher::batch(scene);
+
+		if (options.isAtlased)
+			TextureAtlas::pack(scene);
+
+		// lightmap is appended after atlases, it is never packed
+		if (options.isLightmapped)
+			LightmapBaker::bake(scene);
+
+		// cooked scenes may carry probes baked already
+		if (options.isProbed && scene.lightProbes.probes.empty())
+			scene.lightProbes = LightProbeBaker::bake(scene);
+
+		// from nodes, cooked scenes carry graph and its set baked already
+		if (scene.cellPortals.cells.empty())
+			scene.cellPortals = CellPortalBaker::build(scene);
+
+		if (isHashed)
+			_hashScene(scene, decoded.imageHashes, decoded.meshHashes);
+
+		return decoded;
+	});
+
+	_stage = LoadStage::Decoding;
+	return true;
+}
+
+void Scene::_watch() {
+	_watcher.clear();
+	_scenePaths.clear();
+	_imagePaths.clear();
+
+	if (!_isHotReload || _prefab == nullptr)
+		return;
+
+	std::filesystem::path path = _watcher.watch(_loadPath);
+
+	if (!path.empty())
+		_scenePaths.push_back(path);
+
+	for (const std::filesystem::path &bufferPath : _prefab->bufferPaths) {
+		path = _watcher.watch(bufferPath);
+
+		if (!path.empty())
+			_scenePaths.push_back(path);
+	}
+
+	for (const AssetLoader::ImageSource &source : _prefab->imageSources) {
+		path = source.path.empty() ? std::filesystem::path() : _watcher.watch(source.path);
+		_imagePaths.push_back(path);
+	}
+}
+
+void Scene::_updateHotReload() {
+	if (_reload.valid()) {
+		if (_reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+
+		Decoded reloaded = _reload.get();
+		_applyReload(reloaded);
+
+		return;
+	}
+
+	bool isSceneChanged = false;
+
+	for (const std::filesystem::path &path : _watcher.poll()) {
+		// scene is being loaded whole, it watches its files again once done
+		if (_stage != LoadStage::Idle)
+			return;
+
+		if (std::find(_scenePaths.begin(), _scenePaths.end(), path) != _scenePaths.end())
+			isSceneChanged = true;
+		else
+			_reloadImage(path);
+	}
+
+	// images are decoded with it
+	if (isSceneChanged && _stage == LoadStage::Idle)
+		_reloadScene();
+}
+
+void Scene::_reloadImage(const std::filesystem::path &path) {
+	Prefab &prefab = *_prefab;
+
+	for (size_t i = 0; i < _imagePaths.size(); i++) {
+		if (_imagePaths[i] != path)
+			continue;
+
+		// materials fell back for image which failed to load, they get it by loading whole
+		if (i >= prefab.imageTextures.size() || prefab.imageTextures[i] == NULL_HANDLE) {
+			_load(_loadPath, _loadOptions, false);
+			return;
 		}
 
-		std::optional<size_t> normalIndex = sceneMaterial.normalIndex;
-		if (normalIndex.has_value()) {
-			std::shared_ptr<Image> normalMap = scene.images[normalIndex.value()];
+		// on main thread, one image is decoded per save
+		std::shared_ptr<Image> image = AssetLoader::loadImage(prefab.imageSources[i]);
 
-			ObjectID t = RS::getSingleton().textureCreate(normalMap);
-			_textures.push_back(t);
+		// file still being written keeps old image, its next write is seen again
+		if (image == nullptr)
+			continue;
 
-			info.normal = t;
+		uint64_t hash = _hashImage(image);
+
+		if (i < prefab.imageHashes.size()) {
+			if (prefab.imageHashes[i] == hash)
+				continue;
+
+			prefab.imageHashes[i] = hash;
 		}
 
-		std::optional<size_t> metallicIndex = sceneMaterial.metallicIndex;
-		if (metallicIndex.has_value()) {
-			std::shared_ptr<Image> metallicMap = scene.images[metallicIndex.value()];
+		RS::getSingleton().textureUpdate(prefab.imageTextures[i], image);
+	}
+}
+
+void Scene::_reloadScene() {
+	const Prefab &prefab = *_prefab;
+
+	// batching, atlases and lightmaps are built from whole scene, cooked scenes and prefabs
+	// loaded without hot reload have nothing to compare with
+	bool isRebuilt = _loadPath.extension() == ".hyk" || _loadOptions.isStaticBatched ||
+			_loadOptions.isAtlased || _loadOptions.isLightmapped ||
+			prefab.meshHashes.size() != prefab.meshes.size() ||
+			prefab.imageHashes.size() != prefab.imageTextures.size() ||
+			prefab.sceneMaterials.size() != prefab.materials.size();
+
+	// buffers may change while scene file keeps its key
+	if (isRebuilt) {
+		_load(_loadPath, _loadOptions, false);
+		return;
+	}
+
+	std::filesystem::path file = _loadPath;
+	bool isTangentDerived = _loadOptions.isTangentDerived;
+
+	_reloadCancel = CancelToken();
+	CancelToken cancel = _reloadCancel;
+
+	// probes baked on load are kept, they are baked again by loading whole
+	_reload = JobSystem::async([file, isTangentDerived, cancel]() {
+		PROFILE_ZONE("scene reload");
+
+		Decoded decoded;
+		decoded.scene = AssetLoader::loadGltf(file, true, isTangentDerived, cancel);
+
+		if (cancel.isCancelled())
+			return decoded;
+
+		_hashScene(decoded.scene, decoded.imageHashes, decoded.meshHashes);
+
+		return decoded;
+	});
+}
+
+void Scene::_applyReload(Decoded &reloaded) {
+	PROFILE_ZONE("scene reload apply");
+
+	AssetLoader::Scene &scene = reloaded.scene;
+	Prefab &prefab = *_prefab;
 
-			ObjectID t = RS::getSingleton().textureCreate(metallicMap);
-			_textures.push_back(t);
+	if (!_isSameLayout(prefab, scene)) {
+		_load(_loadPath, _loadOptions, false);
+		return;
+	}
+
+	// nodes of loaded file follow node offset, copies placed by instantiate keep old transforms
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		if (scene.nodes[i].transform == prefab.nodes[i].transform)
+			continue;
+
+		prefab.nodes[i].transform = scene.nodes[i].transform;
+		_graph.nodeSetTransform(_nodeOffset + static_cast<uint32_t>(i), scene.nodes[i].transform);
+	}
 
-			info.metallic = t;
+	std::vector<bool> isCreated(scene.images.size(), false);
+
+	for (size_t i = 0; i < scene.images.size(); i++) {
+		if (scene.images[i] == nullptr || reloaded.imageHashes[i] == prefab.imageHashes[i])
+			continue;
+
+		prefab.imageHashes[i] = reloaded.imageHashes[i];
+		ObjectID &texture = prefab.imageTextures[i];
+
+		if (texture != NULL_HANDLE) {
+			RS::getSingleton().textureUpdate(texture, scene.images[i]);
+			continue;
 		}
 
-		std::optional<size_t> roughnessIndex = sceneMaterial.roughnessIndex;
-		if (roughnessIndex.has_value()) {
-			std::shared_ptr<Image> roughnessMap = scene.images[roughnessIndex.value()];
+		// image failed to load before, materials sampling it are updated below
+		texture = RS::getSingleton().textureCreate(scene.images[i]);
+		prefab.textures.push_back(texture);
+		isCreated[i] = true;
+	}
+
+	for (size_t i = 0; i < scene.materials.size(); i++) {
+		const AssetLoader::Material &material = scene.materials[i];
+
+		std::optional<uint64_t> indices[MATERIAL_TEXTURE_COUNT] = {
+			material.albedoIndex,
+			material.normalIndex,
+			material.metallicRoughnessIndex,
+			material.lightmapIndex,
+		};
 
-			ObjectID t = RS::getSingleton().textureCreate(roughnessMap);
-			_textures.push_back(t);
+		bool isChanged = !_isSameMaterial(material, prefab.sceneMaterials[i]);
 
-			info.roughness = t;
+		for (const std::optional<uint64_t> &index : indices) {
+			if (index.has_value() && index.value() < isCreated.size() && isCreated[index.value()])
+				isChanged = true;
 		}
 
-		ObjectID material = RS::getSingleton().materialCreate(info);
-		_materials.push_back(material);
+		if (!isChanged)
+			continue;
+
+		prefab.sceneMaterials[i] = material;
+
+		RS::MaterialInfo info = _getMaterialInfo(material);
+		info.albedo = _getImageTexture(prefab, indices[0]);
+		info.normal = _getImageTexture(prefab, indices[1]);
+		info.metallicRoughness = _getImageTexture(prefab, indices[2]);
+		info.lightmap = _getImageTexture(prefab, indices[3]);
+
+		RS::getSingleton().materialUpdate(prefab.materials[i], info);
 	}
 
-	for (const Mesh &sceneMesh : scene.meshes) {
-		for (uint32_t i = 0; i < sceneMesh.primitiveCount; i++) {
-			sceneMesh.pPrimitives[i].materialIndex =
-					_materials[sceneMesh.pPrimitives[i].materialIndex];
+	for (size_t i = 0; i < scene.meshes.size(); i++) {
+		if (reloaded.meshHashes[i] == prefab.meshHashes[i])
+			continue;
+
+		const Mesh &sceneMesh = scene.meshes[i];
+
+		for (uint32_t j = 0; j < sceneMesh.primitiveCount; j++) {
+			Primitive &primitive = sceneMesh.pPrimitives[j];
+			primitive.materialIndex = prefab.materials[primitive.materialIndex];
 		}
 
-		ObjectID mesh = RS::getSingleton().meshCreate(sceneMesh);
-		_meshes.push_back(mesh);
+		// entities placed already keep bounds they were created with
+		RS::getSingleton().meshUpdate(prefab.meshes[i], sceneMesh);
+		prefab.meshBounds[i] = _getBounds(sceneMesh);
+		prefab.meshHashes[i] = reloaded.meshHashes[i];
+	}
+}
+
+bool Scene::load(const std::filesystem::path &path, bool isStaticBatched, bool isAtlased,
+		bool isProbed, bool isLightmapped, bool isTangentDerived) {
+	LoadOptions options = { isStaticBatched, isAtlased, isProbed, isLightmapped, isTangentDerived };
+	return _load(path, options, true);
+}
+
+std::future<std::shared_ptr<Prefab>> Scene::loadAsync(const std::filesystem::path &path,
+		bool isStaticBatched, bool isAtlased, bool isProbed, bool isLightmapped,
+		bool isTangentDerived) {
+	std::promise<std::shared_ptr<Prefab>> promise;
+	std::future<std::shared_ptr<Prefab>> future = promise.get_future();
+
+	// clears promise of load it replaces
+	bool isLoaded =
+			load(path, isStaticBatched, isAtlased, isProbed, isLightmapped, isTangentDerived);
+
+	// cached file is placed at once
+	if (!isLoaded || _stage == LoadStage::Idle)
+		promise.set_value(isLoaded ? _prefab : nullptr);
+	else
+		_loadPromise = std::move(promise);
+
+	return future;
+}
+
+void Scene::update(float timeBudget, uint64_t byteBudget) {
+	PROFILE_ZONE("scene update");
+
+	// nodes moved since last frame carry their instances and lights along
+	_graph.update();
+	_entities.update(_graph);
+
+	if (_stage == LoadStage::Idle) {
+		if (_isHotReload && _prefab != nullptr)
+			_updateHotReload();
+
+		return;
 	}
 
-	for (const AssetLoader::MeshInstance &sceneMeshInstance : scene.meshInstances) {
-		uint64_t meshIndex = sceneMeshInstance.meshIndex;
+	if (_stage == LoadStage::Decoding) {
+		if (_decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+
+		Decoded decoded = _decode.get();
+		_decoded = std::move(decoded.scene);
+		_imageTextures.assign(_decoded.images.size(), NULL_HANDLE);
+
+		// referenced by this scene until it is cleared, partial one is freed then
+		_prefab = std::make_shared<Prefab>();
+		_prefab->nodes = _decoded.nodes;
+		_prefab->meshInstances = _decoded.meshInstances;
+		_prefab->skins = _decoded.skins;
+		_prefab->lights = _decoded.lights;
+		_prefab->animations = std::move(_decoded.animations);
+		_prefab->lightProbes = std::move(_decoded.lightProbes);
+
+		if (!_prefab->lightProbes.probes.empty()) {
+			RS::getSingleton().lightProbesSet(_prefab->lightProbes);
+			_hasLightProbes = true;
+		}
+
+		_prefab->cellPortals = std::move(_decoded.cellPortals);
+
+		if (!_prefab->cellPortals.cells.empty()) {
+			RS::getSingleton().cellPortalsSet(_prefab->cellPortals);
+			_hasCellPortals = true;
+		}
+
+		if (_isHotReload) {
+			_prefab->imageSources = _decoded.imageSources;
+			_prefab->sceneMaterials = _decoded.materials;
+			_prefab->bufferPaths = _decoded.bufferPaths;
+			_prefab->imageHashes = std::move(decoded.imageHashes);
+			_prefab->meshHashes = std::move(decoded.meshHashes);
+		}
+
+		AssetCache::retain(_prefab);
+		_prefabs.push_back(_prefab);
 
-		ObjectID mesh = _meshes[meshIndex];
-		glm::mat4 transform = sceneMeshInstance.transform;
+		_nodeOffset = _addNodes(_decoded.nodes, SCENE_GRAPH_NO_NODE);
 
-		ObjectID meshInstance = RS::getSingleton().meshInstanceCreate();
-		RS::getSingleton().meshInstanceSetMesh(meshInstance, mesh);
-		RS::getSingleton().meshInstanceSetTransform(meshInstance, transform);
+		if (!_prefab->animations.empty())
+			_animator.play(_prefab->animations[0], _nodeOffset, _graph);
 
-		_meshInstances.push_back(meshInstance);
+		_stage = LoadStage::Materials;
+		_cursor = 0;
 	}
 
-	for (const AssetLoader::Light &sceneLight : scene.lights) {
-		glm::mat4 transform = sceneLight.transform;
-		float range = sceneLight.range.value_or(0.0f);
-		glm::vec3 color = sceneLight.color;
-		float intensity = sceneLight.intensity;
+	uint64_t start = SDL_GetPerformanceCounter();
+	uint64_t timeLimit = static_cast<uint64_t>(timeBudget * SDL_GetPerformanceFrequency());
+	uint64_t size = 0;
+
+	while (_stage != LoadStage::Idle) {
+		if (_cursor == _getStageSize()) {
+			_stage = static_cast<LoadStage>(static_cast<int>(_stage) + 1);
+			_cursor = 0;
+
+			// meshes are packed by RS as they are created, their arrays are not read again
+			if (_stage == LoadStage::MeshInstances) {
+				_decoded.meshes.clear();
+				_decoded.arena = nullptr;
+				_decoded.file = nullptr;
+			}
+
+			// textures are last, decoded scene is not needed anymore
+			if (_stage > LoadStage::Textures) {
+				_stage = LoadStage::Idle;
+				_decoded = {};
+
+				// textures are swapped by hot reload, others need no map of them
+				if (_isHotReload)
+					_prefab->imageTextures = std::move(_imageTextures);
+
+				_imageTextures.clear();
 
-		ObjectID light;
+				AssetCache::insert(_loadKey, _prefab);
+				_watch();
+
+				if (_loadPromise.has_value()) {
+					_loadPromise->set_value(_prefab);
+					_loadPromise.reset();
+				}
+			}
+
+			continue;
+		}
+
+		switch (_stage) {
+			case LoadStage::Materials: {
+				// fallbacks stand in, textures are swapped in by last stage
+				RS::MaterialInfo info = _getMaterialInfo(_decoded.materials[_cursor]);
+				_prefab->materials.push_back(RS::getSingleton().materialCreate(info));
+				break;
+			}
+			case LoadStage::Meshes:
+				size += _createMesh(_cursor);
+				break;
+			case LoadStage::MeshInstances: {
+				const AssetLoader::MeshInstance &meshInstance = _decoded.meshInstances[_cursor];
+
+				_createMeshInstance(*_prefab, meshInstance, _nodeOffset);
+				break;
+			}
+			case LoadStage::Lights: {
+				const AssetLoader::Light &light = _decoded.lights[_cursor];
 
-		switch (sceneLight.type) {
-			case AssetLoader::LightType::Directional:
-				light = RS::getSingleton().lightCreate(LightType::Directional);
+				_createLight(light, _nodeOffset + static_cast<uint32_t>(light.nodeIndex));
 				break;
-			case AssetLoader::LightType::Point:
-				light = RS::getSingleton().lightCreate(LightType::Point);
+			}
+			case LoadStage::Textures:
+				size += _createMaterialTextures(_cursor);
+				break;
+			default:
 				break;
 		}
 
-		RS::getSingleton().lightSetTransform(light, transform);
-		RS::getSingleton().lightSetRange(light, range);
-		RS::getSingleton().lightSetColor(light, color);
-		RS::getSingleton().lightSetIntensity(light, intensity);
+		_cursor++;
 
-		_lights.push_back(light);
+		if (size >= byteBudget || SDL_GetPerformanceCounter() - start >= timeLimit)
+			break;
 	}
+}
 
-	return true;
+void Scene::animate(float deltaTime, const glm::mat4 &cameraTransform) {
+	_animator.update(_graph, deltaTime, cameraTransform);
 }
 
 void Scene::clear() {
-	for (ObjectID meshInstance : _meshInstances)
-		RS::getSingleton().meshInstanceFree(meshInstance);
+	// jobs finish early, their futures are dropped without waiting
+	if (_decode.valid()) {
+		_decodeCancel.cancel();
+		_decode = {};
+	}
+
+	if (_reload.valid()) {
+		_reloadCancel.cancel();
+		_reload = {};
+	}
+
+	if (_loadPromise.has_value()) {
+		_loadPromise->set_value(nullptr);
+		_loadPromise.reset();
+	}
+
+	_watcher.clear();
+	_scenePaths.clear();
+	_imagePaths.clear();
+
+	_stage = LoadStage::Idle;
+	_cursor = 0;
+	_decoded = {};
+	_imageTextures.clear();
+
+	for (ObjectID meshInstance : _entities.getMeshInstances()) {
+		if (meshInstance != 0)
+			RS::getSingleton().meshInstanceFree(meshInstance);
+	}
+
+	for (ObjectID light : _entities.getLights()) {
+		if (light != 0)
+			RS::getSingleton().lightFree(light);
+	}
+
+	if (_hasLightProbes) {
+		RS::getSingleton().lightProbesSet({});
+		_hasLightProbes = false;
+	}
 
-	for (ObjectID light : _lights)
-		RS::getSingleton().lightFree(light);
+	if (_hasCellPortals) {
+		RS::getSingleton().cellPortalsSet({});
+		_hasCellPortals = false;
+	}
+
+	// other scenes may still place them
+	for (const std::shared_ptr<Prefab> &prefab : _prefabs)
+		AssetCache::release(prefab);
+
+	_entities.clear();
+	_animator.clear();
+	_graph.clear();
+	_prefabs.clear();
+	_prefab = nullptr;
+	_loadKey.clear();
+}
+
+uint32_t Scene::instantiate(const std::shared_ptr<Prefab> &prefab, const glm::mat4 &transform) {
+	if (prefab == nullptr)
+		return SCENE_GRAPH_NO_NODE;
+
+	PROFILE_ZONE("scene instantiate");
+
+	AssetCache::retain(prefab);
+	_prefabs.push_back(prefab);
+
+	uint32_t root = _graph.nodeAdd(transform);
+	_instantiate(*prefab, root);
 
-	for (ObjectID mesh : _meshes)
-		RS::getSingleton().meshFree(mesh);
+	return root;
+}
+
+void Scene::setHotReload(bool isEnabled) {
+	_isHotReload = isEnabled;
+
+	// prefab loaded without it is loaded whole once its file changes
+	if (_stage == LoadStage::Idle)
+		_watch();
+}
 
-	for (ObjectID material : _materials)
-		RS::getSingleton().materialFree(material);
+bool Scene::isLoading() const {
+	return _stage != LoadStage::Idle;
+}
+
+std::shared_ptr<Prefab> Scene::getPrefab() const {
+	return _stage == LoadStage::Idle ? _prefab : nullptr;
+}
 
-	for (ObjectID texture : _textures)
-		RS::getSingleton().textureFree(texture);
+SceneGraph &Scene::getGraph() {
+	return _graph;
+}
 
-	_meshInstances.clear();
-	_lights.clear();
-	_meshes.clear();
-	_materials.clear();
-	_textures.clear();
+const SceneEntities &Scene::getEntities() const {
+	return _entities;
 }
@@ -1,25 +1,175 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include <glm/glm.hpp>
+
+#include "io/asset_loader.h"
+#include "io/file_watcher.h"
+#include "job_system.h"
+#include "animator.h"
+#include "asset_cache.h"
+#include "scene_entities.h"
+#include "scene_graph.h"
+
 typedef uint64_t ObjectID;
 
+// work done by one update, step ends once either runs out, at least one resource is created
+const float LOAD_TIME_BUDGET = 0.004f;
+const uint64_t LOAD_BYTE_BUDGET = 16 * 1024 * 1024;
+
+// Scene is decoded on background thread, renderer resources are then created a few per frame
+// by update. Materials come first with fallback textures, geometry follows and real textures
+// replace fallbacks last, so scene shows up early and fills in. Nodes go into scene graph at
+// once, instances and lights follow their node from then on. Loaded file is kept in asset cache,
+// loading it again or instantiating it creates instances and lights only. With hot reload, files
+// of loaded scene are watched, a changed image is decoded and swapped into its texture, a changed
+// scene file updates meshes, materials and node transforms which differ in place, so every id
+// stays valid, scene is loaded again whole only once anything else changes. First animation of
+// every placed file loops on its nodes, see Animator.
 class Scene {
 private:
-	std::vector<ObjectID> _textures;
-	std::vector<ObjectID> _materials;
+	enum class LoadStage {
+		Idle,
+		Decoding,
+		Materials,
+		Meshes,
+		MeshInstances,
+		Lights,
+		Textures,
+	};
+
+	typedef struct {
+		bool isStaticBatched;
+		bool isAtlased;
+		bool isProbed;
+		bool isLightmapped;
+		bool isTangentDerived;
+	} LoadOptions;
+
+	// hashes are only taken for hot reload
+	typedef struct {
+		AssetLoader::Scene scene;
+		std::vector<uint64_t> imageHashes;
+		std::vector<uint64_t> meshHashes;
+	} Decoded;
+
+	LoadStage _stage = LoadStage::Idle;
+	size_t _cursor = 0;
+
+	// decoded on background job, clear cancels it and drops its future
+	std::future<Decoded> _decode;
+	CancelToken _decodeCancel;
+	AssetLoader::Scene _decoded;
+
+	// of loadAsync, kept until load finishes or is replaced
+	std::optional<std::promise<std::shared_ptr<Prefab>>> _loadPromise;
+
+	bool _isHotReload = false;
+	// file is loaded again with options it was loaded with
+	std::filesystem::path _loadPath;
+	LoadOptions _loadOptions = {};
+
+	FileWatcher _watcher;
+	// canonical, of scene file and its buffers, and per image, empty for embedded ones
+	std::vector<std::filesystem::path> _scenePaths;
+	std::vector<std::filesystem::path> _imagePaths;
+	// changed scene file read again, prefab is updated from it once ready
+	std::future<Decoded> _reload;
+	CancelToken _reloadCancel;
 
-	std::vector<ObjectID> _meshes;
-	std::vector<ObjectID> _meshInstances;
+	// per image, images shared by materials get one texture
+	std::vector<ObjectID> _imageTextures;
 
-	std::vector<ObjectID> _lights;
+	// of file being loaded, cached once its resources are all created
+	std::string _loadKey;
+	std::shared_ptr<Prefab> _prefab;
+	// first graph node of loaded file
+	uint32_t _nodeOffset = 0;
+
+	// one reference each, loaded one included
+	std::vector<std::shared_ptr<Prefab>> _prefabs;
+
+	// every instance and light placed, freed by clear
+	SceneEntities _entities;
+	// grid of loaded file is set on renderer, clear resets it
+	bool _hasLightProbes = false;
+	// like probes, graph of loaded file
+	bool _hasCellPortals = false;
+
+	SceneGraph _graph;
+	// first clip of every placed prefab
+	Animator _animator;
+
+	// returns bytes uploaded
+	uint64_t _createMaterialTextures(size_t material);
+	uint64_t _createMesh(size_t mesh);
+	// nodes of instance and its skin start at first node of prefab
+	void _createMeshInstance(
+			const Prefab &prefab, const AssetLoader::MeshInstance &meshInstance, uint32_t first);
+	void _createLight(const AssetLoader::Light &light, uint32_t node);
+
+	// returns first node, roots are parented to parent
+	uint32_t _addNodes(const std::vector<AssetLoader::Node> &nodes, uint32_t parent);
+	// every instance and light of prefab below parent
+	void _instantiate(const Prefab &prefab, uint32_t parent);
+
+	// size of stage of decoded scene
+	size_t _getStageSize() const;
+
+	// cache is skipped when files changed but scene file kept its key
+	bool _load(const std::filesystem::path &path, const LoadOptions &options, bool isCached);
+
+	// files of loaded prefab
+	void _watch();
+	// polls watcher, or applies reload once it is decoded
+	void _updateHotReload();
+	void _reloadImage(const std::filesystem::path &path);
+	// scene file read again, layout other than that of plain glTF scene is loaded whole
+	void _reloadScene();
+	void _applyReload(Decoded &reloaded);
 
 public:
-	bool load(const std::filesystem::path &path);
+	// returns once decoding has started, update creates resources, cached file is placed at once,
+	// static batching merges meshes drawn once into a few per grid cell, see StaticBatcher, atlas
+	// packs small textures together, see TextureAtlas, probes bake a grid of sky visibility for
+	// scenes without one, see LightProbeBaker, lightmaps bake lights of scenes without them into
+	// meshes drawn once, see LightmapBaker, derived tangents leave vertex tangents out of glTF
+	// scenes, cooked ones keep what they were cooked with
+	bool load(const std::filesystem::path &path, bool isStaticBatched = false,
+			bool isAtlased = false, bool isProbed = false, bool isLightmapped = false,
+			bool isTangentDerived = false);
+	// like load, future is ready once update created every resource, nullptr when load failed
+	// or was cleared or replaced by another one first
+	std::future<std::shared_ptr<Prefab>> loadAsync(const std::filesystem::path &path,
+			bool isStaticBatched = false, bool isAtlased = false, bool isProbed = false,
+			bool isLightmapped = false, bool isTangentDerived = false);
+	// places prefab again under new root node, returns root, meshes and materials are shared
+	uint32_t instantiate(const std::shared_ptr<Prefab> &prefab,
+			const glm::mat4 &transform = glm::mat4(1.0f));
+	void update(float timeBudget = LOAD_TIME_BUDGET, uint64_t byteBudget = LOAD_BYTE_BUDGET);
+	// before update, which then moves what animated nodes carry, camera picks update rates
+	void animate(float deltaTime, const glm::mat4 &cameraTransform);
 	void clear();
+
+	// for files loaded after call, prefabs keep what changed on disk in place, see Scene
+	void setHotReload(bool isEnabled);
+
+	bool isLoading() const;
+	// of file loaded last, nullptr while it is loading
+	std::shared_ptr<Prefab> getPrefab() const;
+	// moving a node moves its subtree on next update
+	SceneGraph &getGraph();
+	// world bounds and flags as of last update
+	const SceneEntities &getEntities() const;
 };
 
 #endif // !SCENE_H
@@ -0,0 +1,171 @@
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "profiler.h"
+#include "scene_graph.h"
+
+#include "scene_entities.h"
+
+EntityID SceneEntities::_create(const SceneGraph &graph, uint32_t node, ObjectID meshInstance,
+		ObjectID light, const AABB &bounds, uint32_t flags) {
+	uint32_t slot;
+
+	if (!_freeSlots.empty()) {
+		slot = _freeSlots.back();
+		_freeSlots.pop_back();
+	} else {
+		slot = static_cast<uint32_t>(_slotToRow.size());
+		_slotToRow.push_back(0);
+		_generations.push_back(0);
+	}
+
+	// generation is bumped on free, first one starts at 1 so id is never 0
+	_slotToRow[slot] = getCount();
+	_generations[slot]++;
+	_rowToSlot.push_back(slot);
+
+	_nodes.push_back(node);
+	_meshInstances.push_back(meshInstance);
+	_lights.push_back(light);
+	_localBounds.push_back(bounds);
+	_worldBounds.push_back(bounds.transformed(graph.nodeGetWorldTransform(node)));
+	_flags.push_back(flags);
+	_updatedAt.push_back(graph.getUpdateIndex());
+
+	return (static_cast<EntityID>(_generations[slot]) << 32) | slot;
+}
+
+EntityID SceneEntities::meshInstanceCreate(const SceneGraph &graph, uint32_t node,
+		ObjectID meshInstance, const AABB &bounds, bool isSkinned) {
+	return _create(graph, node, meshInstance, 0, bounds, isSkinned ? ENTITY_FLAG_SKINNED : 0);
+}
+
+EntityID SceneEntities::lightCreate(
+		const SceneGraph &graph, uint32_t node, ObjectID light, float range) {
+	AABB bounds = { glm::vec3(-range), glm::vec3(range) };
+	return _create(graph, node, 0, light, bounds, 0);
+}
+
+void SceneEntities::free(EntityID entity) {
+	if (!has(entity))
+		return;
+
+	uint32_t slot = _getSlot(entity);
+	uint32_t row = _slotToRow[slot];
+	uint32_t last = getCount() - 1;
+
+	if (_flags[row] & ENTITY_FLAG_DYNAMIC)
+		_dynamicCount--;
+
+	// last row fills the hole, rows stay dense
+	if (row != last) {
+		_nodes[row] = _nodes[last];
+		_meshInstances[row] = _meshInstances[last];
+		_lights[row] = _lights[last];
+		_localBounds[row] = _localBounds[last];
+		_worldBounds[row] = _worldBounds[last];
+		_flags[row] = _flags[last];
+		_updatedAt[row] = _updatedAt[last];
+		_rowToSlot[row] = _rowToSlot[last];
+		_slotToRow[_rowToSlot[row]] = row;
+	}
+
+	_nodes.pop_back();
+	_meshInstances.pop_back();
+	_lights.pop_back();
+	_localBounds.pop_back();
+	_worldBounds.pop_back();
+	_flags.pop_back();
+	_updatedAt.pop_back();
+	_rowToSlot.pop_back();
+
+	_generations[slot]++;
+	_freeSlots.push_back(slot);
+}
+
+bool SceneEntities::has(EntityID entity) const {
+	uint32_t slot = _getSlot(entity);
+	uint32_t generation = _getGeneration(entity);
+
+	return slot < _generations.size() && generation != 0 && _generations[slot] == generation;
+}
+
+void SceneEntities::update(const SceneGraph &graph) {
+	// graph skips updates without dirty nodes, nothing moved then
+	if (graph.getUpdateIndex() == _graphUpdate)
+		return;
+
+	PROFILE_ZONE("scene entities update");
+
+	_graphUpdate = graph.getUpdateIndex();
+
+	for (uint32_t row = 0; row < getCount(); row++) {
+		uint32_t updatedAt = graph.nodeGetUpdatedAt(_nodes[row]);
+
+		if (updatedAt <= _updatedAt[row])
+			continue;
+
+		_worldBounds[row] = _localBounds[row].transformed(graph.nodeGetWorldTransform(_nodes[row]));
+		_updatedAt[row] = updatedAt;
+
+		if (!(_flags[row] & ENTITY_FLAG_DYNAMIC)) {
+			_flags[row] |= ENTITY_FLAG_DYNAMIC;
+			_dynamicCount++;
+		}
+	}
+}
+
+void SceneEntities::clear() {
+	_nodes.clear();
+	_meshInstances.clear();
+	_lights.clear();
+	_localBounds.clear();
+	_worldBounds.clear();
+	_flags.clear();
+	_updatedAt.clear();
+
+	// ids handed out so far stay invalid
+	for (uint32_t slot : _rowToSlot) {
+		_generations[slot]++;
+		_freeSlots.push_back(slot);
+	}
+
+	_rowToSlot.clear();
+
+	_graphUpdate = 0;
+	_dynamicCount = 0;
+}
+
+uint32_t SceneEntities::getCount() const {
+	return static_cast<uint32_t>(_nodes.size());
+}
+
+uint32_t SceneEntities::getDynamicCount() const {
+	return _dynamicCount;
+}
+
+uint32_t SceneEntities::getRow(EntityID entity) const {
+	return _slotToRow[_getSlot(entity)];
+}
+
+const std::vector<uint32_t> &SceneEntities::getNodes() const {
+	return _nodes;
+}
+
+const std::vector<ObjectID> &SceneEntities::getMeshInstances() const {
+	return _meshInstances;
+}
+
+const std::vector<ObjectID> &SceneEntities::getLights() const {
+	return _lights;
+}
+
+const std::vector<AABB> &SceneEntities::getWorldBounds() const {
+	return _worldBounds;
+}
+
+const std::vector<uint32_t> &SceneEntities::getFlags() const {
+	return _flags;
+}
@@ -0,0 +1,86 @@
+#ifndef SCENE_ENTITIES_H
+#define SCENE_ENTITIES_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "rendering/types/aabb.h"
+
+class SceneGraph;
+
+typedef uint64_t ObjectID;
+
+// generation in high 32 bits, slot in low 32 bits, 0 is never valid
+typedef uint64_t EntityID;
+
+// node moved after entity was added, stays set
+const uint32_t ENTITY_FLAG_DYNAMIC = 1u << 0;
+// posed by joints, bounds are of bind pose
+const uint32_t ENTITY_FLAG_SKINNED = 1u << 1;
+
+// Instances and lights placed by scene, one row each. Components live in dense arrays indexed by
+// row, removal moves last row into the hole, systems walk them front to back. Node is transform
+// component, scene graph owns transforms and hands them to RS in batches, entities follow its
+// updates to keep world bounds and tell nodes which never moved from those which did.
+class SceneEntities {
+private:
+	std::vector<uint32_t> _nodes;
+	// 0 for none
+	std::vector<ObjectID> _meshInstances;
+	std::vector<ObjectID> _lights;
+	// of mesh or light range
+	std::vector<AABB> _localBounds;
+	std::vector<AABB> _worldBounds;
+	std::vector<uint32_t> _flags;
+	// graph update world bounds are of
+	std::vector<uint32_t> _updatedAt;
+
+	std::vector<uint32_t> _rowToSlot;
+	// row and generation per slot
+	std::vector<uint32_t> _slotToRow;
+	std::vector<uint32_t> _generations;
+	std::vector<uint32_t> _freeSlots;
+
+	uint32_t _graphUpdate = 0;
+	uint32_t _dynamicCount = 0;
+
+	static uint32_t _getSlot(EntityID entity) {
+		return static_cast<uint32_t>(entity & 0xFFFFFFFF);
+	}
+
+	static uint32_t _getGeneration(EntityID entity) {
+		return static_cast<uint32_t>(entity >> 32);
+	}
+
+	EntityID _create(const SceneGraph &graph, uint32_t node, ObjectID meshInstance,
+			ObjectID light, const AABB &bounds, uint32_t flags);
+
+public:
+	// node has to be in graph
+	EntityID meshInstanceCreate(const SceneGraph &graph, uint32_t node, ObjectID meshInstance,
+			const AABB &bounds, bool isSkinned);
+	EntityID lightCreate(const SceneGraph &graph, uint32_t node, ObjectID light, float range);
+	// objects are left to caller
+	void free(EntityID entity);
+	bool has(EntityID entity) const;
+
+	// recomputes world bounds of rows whose node moved since, after graph update
+	void update(const SceneGraph &graph);
+	void clear();
+
+	uint32_t getCount() const;
+	uint32_t getDynamicCount() const;
+	// entity has to be valid
+	uint32_t getRow(EntityID entity) const;
+
+	// indexed by row, as long as nothing is created or freed
+	const std::vector<uint32_t> &getNodes() const;
+	const std::vector<ObjectID> &getMeshInstances() const;
+	const std::vector<ObjectID> &getLights() const;
+	const std::vector<AABB> &getWorldBounds() const;
+	const std::vector<uint32_t> &getFlags() const;
+};
+
+#endif // !SCENE_ENTITIES_H
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "rendering/rendering_server.h"
+#include "profiler.h"
+
+#include "scene_graph.h"
+
+void SceneGraph::_collect(const std::vector<Attachment> &attachments, uint32_t begin,
+		uint32_t end, std::vector<ObjectID> &objects, std::vector<glm::mat4> &transforms) const {
+	auto it = std::lower_bound(attachments.begin(), attachments.end(), begin,
+			[](const Attachment &attachment, uint32_t node) { return attachment.node < node; });
+
+	for (; it != attachments.end() && it->node < end; it++) {
+		objects.push_back(it->object);
+		transforms.push_back(_worldTransforms[it->node]);
+	}
+}
+
+void SceneGraph::_pose(const Skin &skin) const {
+	glm::mat4 toInstance = glm::inverse(_worldTransforms[skin.node]);
+	std::vector<glm::mat4> joints(skin.joints.size());
+
+	for (size_t i = 0; i < joints.size(); i++)
+		joints[i] = toInstance * _worldTransforms[skin.joints[i]] * skin.inverseBindMatrices[i];
+
+	RS::getSingleton().meshInstanceSetJoints(skin.meshInstance, joints);
+}
+
+uint32_t SceneGraph::nodeAdd(const glm::mat4 &transform, uint32_t parent) {
+	uint32_t node = getNodeCount();
+
+	// subtree of parent has to end here, otherwise node would split a later one
+	if (parent != SCENE_GRAPH_NO_NODE && (parent >= node || _subtreeEnds[parent] != node)) {
+		std::cout << "ERROR: Scene graph node " << parent << " is not open parent!" << std::endl;
+		return SCENE_GRAPH_NO_NODE;
+	}
+
+	_parents.push_back(parent);
+	_subtreeEnds.push_back(node + 1);
+	_localTransforms.push_back(transform);
+	_worldTransforms.push_back(transform);
+	_isDirty.push_back(true);
+	_hasDirty = true;
+	_updatedAt.push_back(0);
+
+	for (uint32_t ancestor = parent; ancestor != SCENE_GRAPH_NO_NODE;
+			ancestor = _parents[ancestor])
+		_subtreeEnds[ancestor] = node + 1;
+
+	return node;
+}
+
+void SceneGraph::nodeSetTransform(uint32_t node, const glm::mat4 &transform) {
+	if (node >= getNodeCount())
+		return;
+
+	_localTransforms[node] = transform;
+	_isDirty[node] = true;
+	_hasDirty = true;
+}
+
+const glm::mat4 &SceneGraph::nodeGetTransform(uint32_t node) const {
+	return _localTransforms[node];
+}
+
+const glm::mat4 &SceneGraph::nodeGetWorldTransform(uint32_t node) const {
+	return _worldTransforms[node];
+}
+
+uint32_t SceneGraph::nodeGetUpdatedAt(uint32_t node) const {
+	return _updatedAt[node];
+}
+
+void SceneGraph::meshInstanceAttach(uint32_t node, ObjectID meshInstance) {
+	if (node >= getNodeCount())
+		return;
+
+	_isSorted = _isSorted && (_meshInstances.empty() || _meshInstances.back().node <= node);
+	_meshInstances.push_back({ node, meshInstance });
+
+	RS::getSingleton().meshInstanceSetTransform(meshInstance, _worldTransforms[node]);
+}
+
+void SceneGraph::lightAttach(uint32_t node, ObjectID light) {
+	if (node >= getNodeCount())
+		return;
+
+	_isSorted = _isSorted && (_lights.empty() || _lights.back().node <= node);
+	_lights.push_back({ node, light });
+
+	RS::getSingleton().lightSetTransform(light, _worldTransforms[node]);
+}
+
+void SceneGraph::meshInstanceSkin(uint32_t node, ObjectID meshInstance,
+		const std::vector<uint32_t> &joints, const std::vector<glm::mat4> &inverseBindMatrices) {
+	if (node >= getNodeCount() || joints.empty() || joints.size() != inverseBindMatrices.size())
+		return;
+
+	for (uint32_t joint : joints) {
+		if (joint >= getNodeCount())
+			return;
+	}
+
+	_skins.push_back({ node, meshInstance, joints, inverseBindMatrices });
+	_pose(_skins.back());
+}
+
+void SceneGraph::update() {
+	if (!_hasDirty)
+		return;
+
+	PROFILE_ZONE("scene graph update");
+
+	_updateIndex++;
+
+	if (!_isSorted) {
+		auto byNode = [](const Attachment &a, const Attachment &b) { return a.node < b.node; };
+
+		std::stable_sort(_meshInstances.begin(), _meshInstances.end(), byNode);
+		std::stable_sort(_lights.begin(), _lights.end(), byNode);
+		_isSorted = true;
+	}
+
+	std::vector<ObjectID> meshInstances;
+	std::vector<glm::mat4> meshInstanceTransforms;
+	std::vector<ObjectID> lights;
+	std::vector<glm::mat4> lightTransforms;
+
+	uint32_t node = 0;
+
+	// clean nodes are skipped one by one, dirty ones take their whole subtree along
+	while (node < getNodeCount()) {
+		if (!_isDirty[node]) {
+			node++;
+			continue;
+		}
+
+		uint32_t end = _subtreeEnds[node];
+
+		for (uint32_t i = node; i < end; i++) {
+			uint32_t parent = _parents[i];
+
+			_worldTransforms[i] = parent == SCENE_GRAPH_NO_NODE
+					? _localTransforms[i]
+					: _worldTransforms[parent] * _localTransforms[i];
+			_isDirty[i] = false;
+			_updatedAt[i] = _updateIndex;
+		}
+
+		_collect(_meshInstances, node, end, meshInstances, meshInstanceTransforms);
+		_collect(_lights, node, end, lights, lightTransforms);
+
+		node = end;
+	}
+
+	_hasDirty = false;
+
+	if (!meshInstances.empty())
+		RS::getSingleton().meshInstanceSetTransforms(meshInstances, meshInstanceTransforms);
+
+	if (!lights.empty())
+		RS::getSingleton().lightSetTransforms(lights, lightTransforms);
+
+	for (const Skin &skin : _skins) {
+		bool isMoved = _updatedAt[skin.node] == _updateIndex;
+
+		for (size_t i = 0; i < skin.joints.size() && !isMoved; i++)
+			isMoved = _updatedAt[skin.joints[i]] == _updateIndex;
+
+		if (isMoved)
+			_pose(skin);
+	}
+}
+
+void SceneGraph::clear() {
+	_parents.clear();
+	_subtreeEnds.clear();
+	_localTransforms.clear();
+	_worldTransforms.clear();
+	_isDirty.clear();
+	_hasDirty = false;
+	_updatedAt.clear();
+
+	_meshInstances.clear();
+	_lights.clear();
+	_isSorted = true;
+
+	_skins.clear();
+}
+
+uint32_t SceneGraph::getNodeCount() const {
+	return static_cast<uint32_t>(_parents.size());
+}
+
+uint32_t SceneGraph::getUpdateIndex() const {
+	return _updateIndex;
+}
@@ -0,0 +1,88 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+typedef uint64_t ObjectID;
+
+// parent of root nodes, returned for nodes which could not be added
+const uint32_t SCENE_GRAPH_NO_NODE = UINT32_MAX;
+
+// Nodes are stored depth first, every subtree is a contiguous range after its root, so world
+// transforms are updated in one linear pass with parent computed before children. Changed local
+// transform marks node dirty, update recomputes dirty subtrees only and hands world transforms
+// of instances and lights attached to them to RS in one batch each. Skinned instances get their
+// joints again once any of their joint nodes or their own node moved.
+class SceneGraph {
+private:
+	typedef struct {
+		uint32_t node;
+		ObjectID object;
+	} Attachment;
+
+	typedef struct {
+		uint32_t node;
+		ObjectID meshInstance;
+		std::vector<uint32_t> joints;
+		std::vector<glm::mat4> inverseBindMatrices;
+	} Skin;
+
+	std::vector<uint32_t> _parents;
+	// one past last node of subtree
+	std::vector<uint32_t> _subtreeEnds;
+
+	std::vector<glm::mat4> _localTransforms;
+	std::vector<glm::mat4> _worldTransforms;
+
+	std::vector<bool> _isDirty;
+	bool _hasDirty = false;
+
+	// update which last recomputed node, skins compare it against current one
+	std::vector<uint32_t> _updatedAt;
+	uint32_t _updateIndex = 0;
+
+	// sorted by node once update needs them, subtree owns a contiguous range
+	std::vector<Attachment> _meshInstances;
+	std::vector<Attachment> _lights;
+	bool _isSorted = true;
+
+	std::vector<Skin> _skins;
+
+	// appends objects attached to nodes in range and their world transforms
+	void _collect(const std::vector<Attachment> &attachments, uint32_t begin, uint32_t end,
+			std::vector<ObjectID> &objects, std::vector<glm::mat4> &transforms) const;
+	// joints relative to node of instance, which RS applies as instance transform
+	void _pose(const Skin &skin) const;
+
+public:
+	// depth first, parent has to be root of last subtree added or one of its ancestors
+	uint32_t nodeAdd(const glm::mat4 &transform, uint32_t parent = SCENE_GRAPH_NO_NODE);
+	// local to parent
+	void nodeSetTransform(uint32_t node, const glm::mat4 &transform);
+	const glm::mat4 &nodeGetTransform(uint32_t node) const;
+	// as of last update
+	const glm::mat4 &nodeGetWorldTransform(uint32_t node) const;
+	// update which last recomputed node, compared against getUpdateIndex
+	uint32_t nodeGetUpdatedAt(uint32_t node) const;
+
+	// object gets world transform of node right away and follows it on every update
+	void meshInstanceAttach(uint32_t node, ObjectID meshInstance);
+	void lightAttach(uint32_t node, ObjectID light);
+	// instance attached to node is posed by joint nodes, one inverse bind matrix per joint
+	void meshInstanceSkin(uint32_t node, ObjectID meshInstance,
+			const std::vector<uint32_t> &joints,
+			const std::vector<glm::mat4> &inverseBindMatrices);
+
+	// recomputes dirty subtrees and sets transforms of their objects
+	void update();
+	void clear();
+
+	uint32_t getNodeCount() const;
+	// advanced by every update which recomputed anything
+	uint32_t getUpdateIndex() const;
+};
+
+#endif // !SCENE_GRAPH_H
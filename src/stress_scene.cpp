@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <SDL3/SDL_log.h>
+
+#include "io/image.h"
+#include "io/mesh.h"
+#include "rendering/rendering_server.h"
+
+#include "stress_scene.h"
+
+// tessellation of generated spheres, chosen per mesh
+const uint32_t STRESS_MIN_RINGS = 4;
+const uint32_t STRESS_MAX_RINGS = 16;
+const uint32_t STRESS_MIN_SEGMENTS = 6;
+const uint32_t STRESS_MAX_SEGMENTS = 32;
+
+// of unit radius
+const float STRESS_DISPLACEMENT = 0.25f;
+
+// splitmix64, every draw advances state
+static uint64_t _next(uint64_t &state) {
+	state += 0x9e3779b97f4a7c15ull;
+
+	uint64_t z = state;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+
+	return z ^ (z >> 31);
+}
+
+static float _random(uint64_t &state, float min = 0.0f, float max = 1.0f) {
+	float t = static_cast<float>(_next(state) >> 40) / 16777216.0f;
+	return min + (max - min) * t;
+}
+
+static uint32_t _random(uint64_t &state, uint32_t min, uint32_t max) {
+	return min + static_cast<uint32_t>(_next(state) % (max - min + 1));
+}
+
+// stream of its own per kind, changing one count leaves everything else in place
+static uint64_t _stream(uint32_t seed, uint64_t kind) {
+	uint64_t state = (static_cast<uint64_t>(seed) << 32) ^ kind;
+	_next(state);
+
+	return state;
+}
+
+static std::shared_ptr<Image> _buildTexture(uint64_t &state) {
+	const uint32_t size = STRESS_SCENE_TEXTURE_SIZE;
+	uint32_t checkSize = 1u << _random(state, 3u, 6u);
+
+	uint8_t colors[2][4];
+
+	for (uint32_t i = 0; i < 2; i++) {
+		for (uint32_t c = 0; c < 3; c++)
+			colors[i][c] = static_cast<uint8_t>(_random(state, 0u, 255u));
+
+		colors[i][3] = 255;
+	}
+
+	std::vector<uint8_t> data(size * size * 4);
+
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			const uint8_t *pColor = colors[((x / checkSize) + (y / checkSize)) % 2];
+			std::copy(pColor, pColor + 4, &data[(y * size + x) * 4]);
+		}
+	}
+
+	std::shared_ptr<Image> image =
+			std::make_shared<Image>(size, size, Image::Format::RGBA8, std::move(data));
+	image->setSrgb(true);
+
+	return image;
+}
+
+// displaced sphere of unit radius
+static void _buildMesh(
+		uint64_t &state, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+	uint32_t rings = _random(state, STRESS_MIN_RINGS, STRESS_MAX_RINGS);
+	uint32_t segments = _random(state, STRESS_MIN_SEGMENTS, STRESS_MAX_SEGMENTS);
+
+	for (uint32_t ring = 0; ring <= rings; ring++) {
+		float v = static_cast<float>(ring) / rings;
+		float theta = v * glm::pi<float>();
+
+		for (uint32_t segment = 0; segment <= segments; segment++) {
+			float u = static_cast<float>(segment) / segments;
+			float phi = u * glm::two_pi<float>();
+
+			glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta),
+					std::sin(theta) * std::sin(phi));
+
+			// poles stay in place and seam repeats first vertex of ring, sphere stays closed
+			float displacement = 0.0f;
+
+			if (ring > 0 && ring < rings && segment < segments)
+				displacement = _random(state, -STRESS_DISPLACEMENT, STRESS_DISPLACEMENT);
+			else if (ring > 0 && ring < rings)
+				displacement = glm::length(vertices[ring * (segments + 1)].position) - 1.0f;
+
+			glm::vec3 tangent = glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), normal);
+
+			if (glm::dot(tangent, tangent) < 1e-6f)
+				tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+
+			Vertex vertex = {};
+			vertex.position = normal * (1.0f + displacement);
+			vertex.normal = normal;
+			vertex.tangent = glm::normalize(tangent);
+			vertex.uv = glm::vec2(u, v);
+
+			vertices.push_back(vertex);
+		}
+	}
+
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			uint32_t a = ring * (segments + 1) + segment;
+			uint32_t b = a + segments + 1;
+
+			indices.insert(indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+		}
+	}
+}
+
+void StressScene::build(const StressSceneSettings &settings) {
+	clear();
+
+	RS &rs = RS::getSingleton();
+
+	uint64_t textureState = _stream(settings.seed, 0);
+	uint64_t materialState = _stream(settings.seed, 1);
+	uint64_t meshState = _stream(settings.seed, 2);
+	uint64_t instanceState = _stream(settings.seed, 3);
+	uint64_t lightState = _stream(settings.seed, 4);
+
+	for (uint32_t i = 0; i < settings.textureCount; i++)
+		_textures.push_back(rs.textureCreate(_buildTexture(textureState)));
+
+	// every mesh needs a material
+	uint32_t materialCount = std::max(settings.materialCount, 1u);
+
+	for (uint32_t i = 0; i < materialCount; i++) {
+		RS::MaterialInfo info = {};
+		info.albedoFactor = glm::vec4(_random(materialState, 0.2f, 1.0f),
+				_random(materialState, 0.2f, 1.0f), _random(materialState, 0.2f, 1.0f), 1.0f);
+		info.metallicFactor = _random(materialState) < 0.3f ? 1.0f : 0.0f;
+		info.roughnessFactor = _random(materialState, 0.2f, 1.0f);
+
+		if (!_textures.empty())
+			info.albedo = _textures[i % _textures.size()];
+
+		_materials.push_back(rs.materialCreate(info));
+	}
+
+	for (uint32_t i = 0; i < settings.meshCount; i++) {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		_buildMesh(meshState, vertices, indices);
+
+		Primitive primitive = {};
+		primitive.vertices = { vertices.data(), static_cast<uint32_t>(vertices.size()) };
+		primitive.indices = { indices.data(), static_cast<uint32_t>(indices.size()) };
+		primitive.materialIndex = _materials[_random(meshState, 0u, materialCount - 1)];
+
+		Mesh mesh = {};
+		mesh.pPrimitives = &primitive;
+		mesh.primitiveCount = 1;
+		mesh.pName = "stress";
+
+		// packing reads mesh before returning
+		_meshes.push_back(rs.meshCreate(mesh));
+	}
+
+	// square grid, a cell per instance
+	uint32_t side = static_cast<uint32_t>(
+			std::ceil(std::sqrt(static_cast<float>(std::max(settings.instanceCount, 1u)))));
+	_extent = side * STRESS_SCENE_SPACING;
+
+	if (!_meshes.empty() && settings.instanceCount > 0) {
+		_meshInstances = rs.meshInstanceCreateBatch(settings.instanceCount);
+
+		std::vector<glm::mat4> transforms;
+		transforms.reserve(_meshInstances.size());
+
+		for (uint32_t i = 0; i < settings.instanceCount; i++) {
+			uint32_t mesh = _random(instanceState, 0u, static_cast<uint32_t>(_meshes.size() - 1));
+			rs.meshInstanceSetMesh(_meshInstances[i], _meshes[mesh]);
+
+			glm::vec3 position((i % side + 0.5f) * STRESS_SCENE_SPACING - _extent * 0.5f, 0.0f,
+					(i / side + 0.5f) * STRESS_SCENE_SPACING - _extent * 0.5f);
+			position.x += _random(instanceState, -0.25f, 0.25f) * STRESS_SCENE_SPACING;
+			position.z += _random(instanceState, -0.25f, 0.25f) * STRESS_SCENE_SPACING;
+			position.y = _random(instanceState, 0.5f, 1.5f);
+
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+			transform = glm::rotate(transform, _random(instanceState, 0.0f, glm::two_pi<float>()),
+					glm::vec3(0.0f, 1.0f, 0.0f));
+			transform = glm::scale(transform, glm::vec3(_random(instanceState, 0.5f, 1.0f)));
+
+			transforms.push_back(transform);
+		}
+
+		rs.meshInstanceSetTransforms(_meshInstances, transforms);
+	}
+
+	for (uint32_t i = 0; i < settings.directionalLightCount; i++) {
+		ObjectID light = rs.lightCreate(LightType::Directional);
+
+		// pointing down, from any side
+		glm::mat4 transform = glm::rotate(glm::mat4(1.0f),
+				_random(lightState, 0.0f, glm::two_pi<float>()), glm::vec3(0.0f, 1.0f, 0.0f));
+		transform = glm::rotate(transform, -_random(lightState, 0.5f, 1.3f),
+				glm::vec3(1.0f, 0.0f, 0.0f));
+
+		rs.lightSetTransform(light, transform);
+		rs.lightSetColor(light, glm::vec3(1.0f, 0.95f, 0.9f));
+		rs.lightSetIntensity(light, i == 0 ? 3.0f : 0.5f);
+		rs.lightSetShadow(light, i == 0);
+
+		_lights.push_back(light);
+	}
+
+	for (uint32_t i = 0; i < settings.pointLightCount; i++) {
+		ObjectID light = rs.lightCreate(LightType::Point);
+
+		glm::vec3 position(_random(lightState, -0.5f, 0.5f) * _extent,
+				_random(lightState, 1.0f, 4.0f), _random(lightState, -0.5f, 0.5f) * _extent);
+
+		rs.lightSetTransform(light, glm::translate(glm::mat4(1.0f), position));
+		rs.lightSetColor(light,
+				glm::vec3(_random(lightState, 0.2f, 1.0f), _random(lightState, 0.2f, 1.0f),
+						_random(lightState, 0.2f, 1.0f)));
+		rs.lightSetIntensity(light, _random(lightState, 5.0f, 20.0f));
+		rs.lightSetRange(light, STRESS_SCENE_SPACING * _random(lightState, 2.0f, 5.0f));
+
+		_lights.push_back(light);
+	}
+
+	SDL_Log("Stress scene: %u meshes, %u instances, %u materials, %u textures, %u point and %u "
+			"directional lights",
+			static_cast<uint32_t>(_meshes.size()), static_cast<uint32_t>(_meshInstances.size()),
+			static_cast<uint32_t>(_materials.size()), static_cast<uint32_t>(_textures.size()),
+			settings.pointLightCount, settings.directionalLightCount);
+}
+
+void StressScene::clear() {
+	RS &rs = RS::getSingleton();
+
+	for (ObjectID meshInstance : _meshInstances)
+		rs.meshInstanceFree(meshInstance);
+
+	for (ObjectID light : _lights)
+		rs.lightFree(light);
+
+	for (ObjectID mesh : _meshes)
+		rs.meshFree(mesh);
+
+	for (ObjectID material : _materials)
+		rs.materialFree(material);
+
+	for (ObjectID texture : _textures)
+		rs.textureFree(texture);
+
+	_meshInstances.clear();
+	_lights.clear();
+	_meshes.clear();
+	_materials.clear();
+	_textures.clear();
+
+	_extent = 0.0f;
+}
+
+void StressScene::getCameraPose(glm::vec3 &translation, glm::vec2 &rotation) const {
+	float extent = std::max(_extent, STRESS_SCENE_SPACING);
+
+	translation = glm::vec3(0.0f, extent * 0.35f, extent * 0.6f);
+	rotation = glm::vec2(0.0f, -std::atan2(0.35f, 0.6f));
+}
+
+std::string StressScene::getName(const StressSceneSettings &settings) {
+	return "stress-meshes" + std::to_string(settings.meshCount) + "-instances" +
+			std::to_string(settings.instanceCount) + "-materials" +
+			std::to_string(settings.materialCount) + "-textures" +
+			std::to_string(settings.textureCount) + "-points" +
+			std::to_string(settings.pointLightCount) + "-directionals" +
+			std::to_string(settings.directionalLightCount) + "-seed" +
+			std::to_string(settings.seed);
+}
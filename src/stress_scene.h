@@ -0,0 +1,58 @@
+#ifndef STRESS_SCENE_H
+#define STRESS_SCENE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+typedef uint64_t ObjectID;
+
+// distance between neighbouring instances of grid
+const float STRESS_SCENE_SPACING = 3.0f;
+
+// texels along side of generated textures
+const uint32_t STRESS_SCENE_TEXTURE_SIZE = 256;
+
+// same counts and seed build the same scene on every platform
+struct StressSceneSettings {
+	uint32_t meshCount = 16;
+	uint32_t instanceCount = 10000;
+	uint32_t materialCount = 64;
+	// albedo maps shared by materials, none leaves materials untextured
+	uint32_t textureCount = 16;
+	uint32_t pointLightCount = 256;
+	// first one casts shadows
+	uint32_t directionalLightCount = 1;
+	uint32_t seed = 1;
+};
+
+// Synthetic scene built through RenderingServer directly, for measuring how frame time scales
+// with counts of instances, lights and resources without shipping content. Meshes are spheres
+// of random tessellation with displaced vertices, instances are scattered over a square grid
+// sized to their count, point lights hover above it. Randomness comes from a hash of seed, not
+// from standard distributions, which differ between libraries.
+class StressScene {
+private:
+	std::vector<ObjectID> _textures;
+	std::vector<ObjectID> _materials;
+	std::vector<ObjectID> _meshes;
+	std::vector<ObjectID> _meshInstances;
+	std::vector<ObjectID> _lights;
+
+	float _extent = 0.0f;
+
+public:
+	// scene built before is freed first, everything is created at once
+	void build(const StressSceneSettings &settings);
+	void clear();
+
+	// above grid, looking down on its center
+	void getCameraPose(glm::vec3 &translation, glm::vec2 &rotation) const;
+
+	// counts and seed, names benchmark results
+	static std::string getName(const StressSceneSettings &settings);
+};
+
+#endif // !STRESS_SCENE_H
@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/glm.hpp>
+
+#include "io/environment_cache.h"
+#include "io/image_loader.h"
+#include "rendering/rendering_server.h"
+
+#include "thumbnail_cache.h"
+
+// of minimal environment, equirectangular
+const uint32_t STUDIO_SKY_WIDTH = 64;
+const uint32_t STUDIO_SKY_HEIGHT = 32;
+
+// cubemap of skies is sized so faces have at least as many texels per degree as thumbnails
+const uint32_t MAX_SKY_CUBEMAP_SIZE = 2048;
+
+static bool _parsePreset(const char *pName, ThumbnailPreset &preset) {
+	if (SDL_strcmp(pName, "front") == 0)
+		preset = ThumbnailPreset::Front;
+	else if (SDL_strcmp(pName, "three-quarter") == 0)
+		preset = ThumbnailPreset::ThreeQuarter;
+	else if (SDL_strcmp(pName, "top") == 0)
+		preset = ThumbnailPreset::Top;
+	else
+		return false;
+
+	return true;
+}
+
+// yaw and pitch
+static glm::vec2 _getPresetRotation(ThumbnailPreset preset) {
+	switch (preset) {
+		case ThumbnailPreset::Front:
+			return glm::vec2(0.0f);
+		case ThumbnailPreset::ThreeQuarter:
+			return glm::vec2(glm::radians(45.0f), glm::radians(-30.0f));
+		case ThumbnailPreset::Top:
+			return glm::vec2(0.0f, glm::radians(-89.9f));
+	}
+
+	return glm::vec2(0.0f);
+}
+
+// bright overcast top fading to dark ground, lights every side of models without hiding shape
+static std::shared_ptr<Image> _createStudioSky() {
+	std::vector<float> texels(STUDIO_SKY_WIDTH * STUDIO_SKY_HEIGHT * 4);
+
+	for (uint32_t y = 0; y < STUDIO_SKY_HEIGHT; y++) {
+		// 1 at zenith, -1 at nadir
+		float elevation = 1.0f - 2.0f * (y + 0.5f) / STUDIO_SKY_HEIGHT;
+		float radiance = glm::mix(0.6f, 1.2f, elevation);
+
+		if (elevation < 0.0f)
+			radiance = glm::mix(0.3f, 0.1f, -elevation);
+
+		for (uint32_t x = 0; x < STUDIO_SKY_WIDTH; x++) {
+			float *pTexel = texels.data() + (y * STUDIO_SKY_WIDTH + x) * 4;
+			pTexel[0] = radiance;
+			pTexel[1] = radiance;
+			pTexel[2] = radiance;
+			pTexel[3] = 1.0f;
+		}
+	}
+
+	std::vector<uint8_t> data(texels.size() * sizeof(float));
+	memcpy(data.data(), texels.data(), data.size());
+
+	return std::make_shared<Image>(
+			STUDIO_SKY_WIDTH, STUDIO_SKY_HEIGHT, Image::Format::RGBA32F, std::move(data));
+}
+
+uint64_t ThumbnailCache::hashFile(const std::string &file) {
+	size_t size;
+	void *pData = SDL_LoadFile(file.c_str(), &size);
+
+	if (pData == nullptr)
+		return 0;
+
+	uint64_t hash = EnvironmentCache::hash(pData, size);
+	SDL_free(pData);
+
+	return hash;
+}
+
+uint64_t ThumbnailCache::getKey(uint64_t contentHash, ThumbnailPreset preset, uint32_t size) {
+	uint32_t parameters[3] = { THUMBNAIL_CACHE_VERSION, static_cast<uint32_t>(preset), size };
+	return EnvironmentCache::hash(parameters, sizeof(parameters), contentHash);
+}
+
+std::string ThumbnailCache::getPath(uint64_t key) {
+	// resolved once, empty when there is no writable location
+	static const std::string DIRECTORY = []() {
+		char *pPath = SDL_GetPrefPath("hayaku", "thumbnails");
+
+		if (pPath == nullptr)
+			return std::string();
+
+		std::string path = pPath;
+		SDL_free(pPath);
+		return path;
+	}();
+
+	if (DIRECTORY.empty())
+		return std::string();
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016" PRIx64 ".png", key);
+
+	return DIRECTORY + name;
+}
+
+bool ThumbnailCache::loadJobs(const char *pFile, std::vector<ThumbnailJob> &jobs) {
+	size_t size;
+	char *pData = static_cast<char *>(SDL_LoadFile(pFile, &size));
+
+	if (pData == nullptr) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Thumbnail jobs %s can not be read!", pFile);
+		return false;
+	}
+
+	jobs.clear();
+
+	// loaded files are null terminated
+	const char *pLine = pData;
+
+	while (*pLine != '\0') {
+		char asset[1024];
+		char preset[32];
+		ThumbnailJob job = {};
+
+		if (*pLine != '#' &&
+				SDL_sscanf(pLine, "%1023s %31s %u", asset, preset, &job.size) == 3) {
+			if (_parsePreset(preset, job.preset) && job.size > 0) {
+				job.asset = asset;
+				jobs.push_back(job);
+			} else {
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+						"Thumbnail of %s is not valid, preset is front, three-quarter or top",
+						asset);
+			}
+		}
+
+		const char *pEnd = SDL_strchr(pLine, '\n');
+		pLine = pEnd != nullptr ? pEnd + 1 : pLine + SDL_strlen(pLine);
+	}
+
+	SDL_free(pData);
+
+	if (jobs.empty()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Thumbnail jobs %s has no jobs!", pFile);
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t ThumbnailCache::getRenderSize(const std::vector<ThumbnailJob> &jobs) {
+	uint32_t size = 1;
+
+	for (const ThumbnailJob &job : jobs)
+		size = std::max(size, job.size);
+
+	return size;
+}
+
+bool ThumbnailCache::initialize(const std::vector<ThumbnailJob> &jobs) {
+	RS &rs = RS::getSingleton();
+
+	if (!rs.isHeadless()) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Thumbnails need headless device!");
+		return false;
+	}
+
+	// every view of an asset shares one content hash
+	std::unordered_map<std::string, uint64_t> hashes;
+
+	_jobs.clear();
+	_cachedCount = 0;
+
+	for (ThumbnailJob job : jobs) {
+		auto it = hashes.find(job.asset);
+
+		if (it == hashes.end())
+			it = hashes.emplace(job.asset, hashFile(job.asset)).first;
+
+		if (it->second == 0) {
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Thumbnail: %s can not be read",
+					job.asset.c_str());
+			continue;
+		}
+
+		job.key = getKey(it->second, job.preset, job.size);
+		std::string path = getPath(job.key);
+
+		if (!path.empty() && SDL_GetPathInfo(path.c_str(), nullptr)) {
+			_cachedCount++;
+			continue;
+		}
+
+		job.isSky = ImageLoader::probe(job.asset.c_str()) != ImageLoader::Type::Unknown;
+		_jobs.push_back(job);
+	}
+
+	// models first and skies after them, so scene is cleared once, views of an asset in a row
+	std::stable_sort(_jobs.begin(), _jobs.end(),
+			[](const ThumbnailJob &a, const ThumbnailJob &b) {
+				return a.isSky != b.isSky ? b.isSky : a.asset < b.asset;
+			});
+
+	_job = 0;
+	_stage = Stage::Begin;
+	_asset.clear();
+
+	SDL_Log("Thumbnails: %u cached, %zu to render", _cachedCount, _jobs.size());
+
+	if (_jobs.empty())
+		return true;
+
+	// faces of sky cubemap cover 90 degrees, view of thumbnail less
+	float texelsPerFace =
+			static_cast<float>(getRenderSize(_jobs)) / std::tan(THUMBNAIL_FOV_Y * 0.5f);
+	uint32_t cubemapSize = 1;
+
+	while (cubemapSize < texelsPerFace && cubemapSize < MAX_SKY_CUBEMAP_SIZE)
+		cubemapSize *= 2;
+
+	QualitySettings quality = rs.getQuality();
+	quality.maxCubemapSize = cubemapSize;
+	quality.specularSize = THUMBNAIL_SPECULAR_SIZE;
+	rs.setQuality(quality);
+
+	rs.cameraSetFovY(THUMBNAIL_FOV_Y);
+
+	// bake of it is cached, later runs only load it
+	if (!_jobs.front().isSky)
+		rs.environmentSkyUpdate(_createStudioSky());
+
+	// first sky decodes while models are drawn
+	_skyLoadNext();
+
+	return true;
+}
+
+void ThumbnailCache::_skyLoadBegin(const std::string &asset) {
+	if (_skyLoadAsset == asset)
+		return;
+
+	_skyLoadAsset = asset;
+	_skyLoad = ImageLoader::loadFromFileAsync(asset);
+}
+
+void ThumbnailCache::_skyLoadNext() {
+	for (size_t i = _job; i < _jobs.size(); i++) {
+		if (_jobs[i].isSky && _jobs[i].asset != _asset) {
+			_skyLoadBegin(_jobs[i].asset);
+			return;
+		}
+	}
+}
+
+void ThumbnailCache::_skip(const std::string &asset) {
+	while (_job < _jobs.size() && _jobs[_job].asset == asset) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Thumbnail: %s skipped", asset.c_str());
+		_job++;
+	}
+
+	_asset.clear();
+	_stage = Stage::Begin;
+}
+
+void ThumbnailCache::_pose(CameraController &camera, const ThumbnailJob &job) {
+	RS &rs = RS::getSingleton();
+	glm::vec2 rotation = _getPresetRotation(job.preset);
+
+	if (job.isSky) {
+		camera.setPose(glm::vec3(0.0f), rotation);
+		return;
+	}
+
+	glm::mat4 orientation = glm::rotate(glm::mat4(1.0f), rotation.x, glm::vec3(0.0f, 1.0f, 0.0f));
+	orientation = glm::rotate(orientation, rotation.y, glm::vec3(1.0f, 0.0f, 0.0f));
+
+	glm::vec3 front = glm::vec3(orientation * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f));
+
+	// bounding sphere fits in view of any direction
+	float radius = std::max(glm::length(_bounds.max - _bounds.min) * 0.5f, 0.001f);
+	float distance = radius / (std::sin(THUMBNAIL_FOV_Y * 0.5f) * THUMBNAIL_FILL);
+
+	// depth range is kept tight around asset, precision of small and large ones alike
+	rs.cameraSetZNear(std::max(distance - radius, distance * 0.01f));
+	rs.cameraSetZFar(distance + radius);
+
+	glm::vec3 center = (_bounds.min + _bounds.max) * 0.5f;
+	camera.setPose(center - front * distance, rotation);
+}
+
+void ThumbnailCache::frameBegin(Scene &scene, CameraController &camera) {
+	if (_job == _jobs.size())
+		return;
+
+	const ThumbnailJob &job = _jobs[_job];
+
+	if (_stage == Stage::Begin) {
+		_frame = 0;
+		_isCaptured = false;
+
+		// consecutive views of one asset only move camera
+		if (job.asset == _asset) {
+			_stage = Stage::Settling;
+		} else if (job.isSky) {
+			// models are all done, skies follow each other
+			scene.clear();
+
+			_asset = job.asset;
+			_skyLoadBegin(job.asset);
+			_stage = Stage::Loading;
+		} else {
+			_isFramed = false;
+
+			if (!scene.load(job.asset)) {
+				_skip(job.asset);
+				return;
+			}
+
+			_asset = job.asset;
+			_stage = Stage::Loading;
+		}
+	}
+
+	if (_stage == Stage::Loading && job.isSky && _skyLoadAsset == job.asset) {
+		if (_skyLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+
+		std::shared_ptr<Image> image = _skyLoad.get();
+		_skyLoadAsset.clear();
+
+		if (image == nullptr) {
+			_skip(job.asset);
+			return;
+		}
+
+		RS::getSingleton().environmentSkyUpdate(image);
+
+		// next sky decodes while this one bakes and is drawn
+		_skyLoadNext();
+	}
+
+	if (_stage != Stage::Settling)
+		return;
+
+	if (!job.isSky && !_isFramed) {
+		const SceneEntities &entities = scene.getEntities();
+		const std::vector<ObjectID> &meshInstances = entities.getMeshInstances();
+		const std::vector<AABB> &worldBounds = entities.getWorldBounds();
+
+		bool isEmpty = true;
+
+		for (size_t i = 0; i < meshInstances.size(); i++) {
+			if (meshInstances[i] == 0)
+				continue;
+
+			if (isEmpty)
+				_bounds = worldBounds[i];
+
+			_bounds.expand(worldBounds[i].min);
+			_bounds.expand(worldBounds[i].max);
+			isEmpty = false;
+		}
+
+		if (isEmpty)
+			_bounds = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+
+		_isFramed = true;
+	}
+
+	_pose(camera, job);
+
+	// first frame moves camera, later ones wait for streaming, bakes and temporal history
+	bool isSettled = _frame > 0 && !RS::getSingleton().isRedrawNeeded();
+
+	if (!isSettled && _frame + 1 < THUMBNAIL_MAX_SETTLE_FRAMES)
+		return;
+
+	std::string path = getPath(job.key);
+	uint32_t size = job.size;
+
+	bool isRequested = RS::getSingleton().requestCapture(
+			[this, path, size](std::shared_ptr<Image> image) {
+				_writer.write(path, image, size, size);
+			});
+
+	if (!isRequested)
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Thumbnail: %s can not be read back",
+				job.asset.c_str());
+
+	_isCaptured = true;
+}
+
+bool ThumbnailCache::frameEnd(bool isLoading) {
+	_writer.collect();
+
+	switch (_stage) {
+		case Stage::Begin:
+			break;
+		case Stage::Loading:
+			// sky is decoding until it is handed to renderer
+			if (isLoading || _skyLoadAsset == _asset)
+				break;
+
+			_stage = Stage::Settling;
+			_frame = 0;
+			break;
+		case Stage::Settling:
+			if (!_isCaptured) {
+				_frame++;
+				break;
+			}
+
+			_stage = Stage::Begin;
+			_job++;
+			break;
+	}
+
+	if (_job < _jobs.size())
+		return true;
+
+	// copies of last frames in flight, then their encoding
+	RS::getSingleton().captureWait();
+	_writer.wait();
+
+	SDL_Log("Thumbnails: %u of %zu written, %u cached", _writer.getWrittenCount(), _jobs.size(),
+			_cachedCount);
+	return false;
+}
+
+bool ThumbnailCache::isWritten() const {
+	return _writer.getWrittenCount() == _jobs.size();
+}
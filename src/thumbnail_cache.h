@@ -0,0 +1,117 @@
+#ifndef THUMBNAIL_CACHE_H
+#define THUMBNAIL_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "camera_controller.h"
+#include "capture_writer.h"
+#include "io/image.h"
+#include "rendering/types/aabb.h"
+#include "scene.h"
+
+// bumped whenever framing, lighting or encoding changes, older thumbnails are then rendered again
+const uint32_t THUMBNAIL_CACHE_VERSION = 1;
+
+// job waits no longer for output to settle, particles never do
+const uint32_t THUMBNAIL_MAX_SETTLE_FRAMES = 120;
+
+// of square frames, bounding sphere of asset fills this fraction of height
+const float THUMBNAIL_FOV_Y = 0.7853982f;
+const float THUMBNAIL_FILL = 0.9f;
+
+// specular level 0 of minimal environment, thumbnails are too small for a sharper one
+const uint32_t THUMBNAIL_SPECULAR_SIZE = 32;
+
+enum class ThumbnailPreset {
+	Front,
+	ThreeQuarter,
+	Top,
+};
+
+struct ThumbnailJob {
+	// glTF, GLB or package, a sky for HDRI and other images
+	std::string asset;
+	ThumbnailPreset preset;
+	// of square image
+	uint32_t size;
+
+	bool isSky;
+	// of asset content, preset and size, cached image is named by it
+	uint64_t key;
+};
+
+// Renders thumbnails of assets on headless device and keeps them in user cache directory as PNG
+// files named by key of asset content, camera preset and size. Jobs whose file already exists are
+// dropped at initialization, so only new and changed assets are rendered. The rest run back to
+// back on one device with pipelines of first one, models in front of a small gradient sky whose
+// bake is cached after first run, skies with scene cleared. Jobs are ordered so views of one
+// asset follow each other and next sky decodes while current one is drawn, every job is captured
+// once renderer reports output settled rather than after fixed frame count, image is shrunk to
+// job size and encoded on background threads.
+class ThumbnailCache {
+private:
+	enum class Stage {
+		Begin,
+		Loading,
+		Settling,
+	};
+
+	std::vector<ThumbnailJob> _jobs;
+	size_t _job = 0;
+	uint32_t _cachedCount = 0;
+
+	Stage _stage = Stage::Begin;
+	uint32_t _frame = 0;
+
+	// last one asked to load, empty when load failed
+	std::string _asset;
+	// world bounds of model, taken once it finished loading
+	AABB _bounds;
+	bool _isFramed = false;
+	bool _isCaptured = false;
+
+	// of one sky at a time, empty once handed to renderer
+	std::future<std::shared_ptr<Image>> _skyLoad;
+	std::string _skyLoadAsset;
+
+	CaptureWriter _writer;
+
+	// unless sky is already decoding
+	void _skyLoadBegin(const std::string &asset);
+	// first sky after job with another asset
+	void _skyLoadNext();
+	// jobs of asset which failed to load
+	void _skip(const std::string &asset);
+	void _pose(CameraController &camera, const ThumbnailJob &job);
+
+public:
+	// of file content, 0 when file can not be read
+	static uint64_t hashFile(const std::string &file);
+	// content hash chained with preset and size
+	static uint64_t getKey(uint64_t contentHash, ThumbnailPreset preset, uint32_t size);
+	// cached image of key, empty when there is no writable location
+	static std::string getPath(uint64_t key);
+
+	// line per job of asset, front, three-quarter or top and size, paths without spaces
+	static bool loadJobs(const char *pFile, std::vector<ThumbnailJob> &jobs);
+	// largest size of jobs, headless device renders at it
+	static uint32_t getRenderSize(const std::vector<ThumbnailJob> &jobs);
+
+	// drops cached jobs, sets camera and minimal environment up
+	bool initialize(const std::vector<ThumbnailJob> &jobs);
+
+	// before scene is updated and drawn, loads asset of job and poses camera
+	void frameBegin(Scene &scene, CameraController &camera);
+	// after frame is drawn, returns false once every job is written or failed
+	bool frameEnd(bool isLoading);
+
+	// every job not cached before was written
+	bool isWritten() const;
+};
+
+#endif // !THUMBNAIL_CACHE_H
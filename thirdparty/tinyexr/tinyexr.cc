@@ -6,6 +6,7 @@
 
 // -- Edit Start --
 #define TINYEXR_USE_MINIZ 0
+#define TINYEXR_USE_THREAD 1
 #include <zlib.h>
 // -- Edit End --
 